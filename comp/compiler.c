@@ -38,6 +38,8 @@
 	#include <fcntl.h>
 #endif
 
+#include "umr_regdb.h"
+
 #define MAXLEN 256
 
 enum regtype {
@@ -446,6 +448,103 @@ static int reg_sort(const void *a, const void *b)
 	return istr_cmp((*A)->name, (*B)->name);
 }
 
+// append a NUL terminated string to a growing string table
+static uint32_t strtab_add(char **strtab, uint32_t *size, uint32_t *alloc, const char *str)
+{
+	uint32_t len = strlen(str) + 1, off = *size;
+
+	if (*size + len > *alloc) {
+		*alloc = (*size + len) * 2;
+		*strtab = realloc(*strtab, *alloc);
+	}
+	memcpy(*strtab + off, str, len);
+	*size += len;
+	return off;
+}
+
+/* compile a .reg text file into the binary format described in umr_regdb.h */
+int compile_regdb(const char *regfile, const char *outfile)
+{
+	struct umr_regdb_header hdr;
+	struct umr_regdb_reg *rr;
+	struct umr_regdb_bit *rb;
+	struct stat st;
+	char linebuf[512], name[MAXLEN], *strtab = NULL;
+	uint32_t x, y, nbits = 0, bits_alloc = 0, strtab_size = 0, strtab_alloc = 0;
+	FILE *f;
+
+	f = fopen(regfile, "r");
+	if (!f || fstat(fileno(f), &st)) {
+		fprintf(stderr, "[ERROR]: Could not open file '%s'\n", regfile);
+		return EXIT_FAILURE;
+	}
+
+	memset(&hdr, 0, sizeof hdr);
+	hdr.magic = UMR_REGDB_MAGIC;
+	hdr.version = UMR_REGDB_VERSION;
+	hdr.src_size = st.st_size;
+	hdr.src_mtime = st.st_mtime;
+	if (!fgets(linebuf, sizeof linebuf, f) || sscanf(linebuf, "%"SCNu32, &hdr.no_regs) != 1) {
+		fprintf(stderr, "[ERROR]: Could not read register count from '%s'\n", regfile);
+		fclose(f);
+		return EXIT_FAILURE;
+	}
+
+	rr = calloc(hdr.no_regs ? hdr.no_regs : 1, sizeof *rr);
+	rb = NULL;
+	for (x = 0; x < hdr.no_regs; x++) {
+		if (!fgets(linebuf, sizeof linebuf, f) ||
+		    sscanf(linebuf, "%255s %"SCNu32" 0x%"SCNx64" %"SCNu32" %"SCNu32" %"SCNu32,
+			   name, &rr[x].type, &rr[x].addr, &rr[x].no_bits, &rr[x].bit64, &rr[x].idx) != 6) {
+			fprintf(stderr, "[ERROR]: Invalid register line %"PRIu32" in '%s'\n", x + 2, regfile);
+			goto error;
+		}
+		rr[x].name = strtab_add(&strtab, &strtab_size, &strtab_alloc, name);
+		rr[x].first_bit = nbits;
+		for (y = 0; y < rr[x].no_bits; y++, nbits++) {
+			if (nbits == bits_alloc) {
+				bits_alloc = bits_alloc ? bits_alloc * 2 : 1024;
+				rb = realloc(rb, bits_alloc * sizeof *rb);
+			}
+			if (!fgets(linebuf, sizeof linebuf, f) ||
+			    sscanf(linebuf, "\t%255s %"SCNd32" %"SCNd32, name, &rb[nbits].start, &rb[nbits].stop) != 3) {
+				fprintf(stderr, "[ERROR]: Invalid bitfield line for register '%s' in '%s'\n", &strtab[rr[x].name], regfile);
+				goto error;
+			}
+			rb[nbits].name = strtab_add(&strtab, &strtab_size, &strtab_alloc, name);
+		}
+	}
+	fclose(f);
+	hdr.no_bits = nbits;
+	hdr.strtab_size = strtab_size;
+
+	f = fopen(outfile, "wb");
+	if (!f) {
+		fprintf(stderr, "[ERROR]: Could not create file '%s'\n", outfile);
+		f = NULL;
+		goto error;
+	}
+	if (fwrite(&hdr, sizeof hdr, 1, f) != 1 ||
+	    fwrite(rr, sizeof *rr, hdr.no_regs, f) != hdr.no_regs ||
+	    fwrite(rb, sizeof *rb, hdr.no_bits, f) != hdr.no_bits ||
+	    fwrite(strtab, 1, strtab_size, f) != strtab_size) {
+		fprintf(stderr, "[ERROR]: Could not write to file '%s'\n", outfile);
+		goto error;
+	}
+	fclose(f);
+	free(rr);
+	free(rb);
+	free(strtab);
+	return 0;
+error:
+	if (f)
+		fclose(f);
+	free(rr);
+	free(rb);
+	free(strtab);
+	return EXIT_FAILURE;
+}
+
 int main(int argc, char **argv)
 {
 	char *rf, *bf;
@@ -458,11 +557,15 @@ int main(int argc, char **argv)
 	int x, y;
 	size_t read_size;
 
+	if (argc == 4 && !strcmp(argv[1], "-b"))
+		return compile_regdb(argv[2], argv[3]);
+
 	if (argc != 3 && argc != 2) {
 		fprintf(stderr, "Usage:\n"
 "\tTo compile a register file:\n\t\t%s offset_header sh_mask_header\n\n"
-"\tTo compile a SOC15 ASIC offset file:\n\t\t%s ipoffset_header\n\n\n"
-"\tBoth commands output the compiled output to 'stdout' and messages/errors to 'stderr'.\n", argv[0], argv[0]);
+"\tTo compile a SOC15 ASIC offset file:\n\t\t%s ipoffset_header\n\n"
+"\tTo compile a register file into the binary database format:\n\t\t%s -b file.reg file.rdb\n\n\n"
+"\tThe first two commands output the compiled output to 'stdout' and messages/errors to 'stderr'.\n", argv[0], argv[0], argv[0]);
 		return EXIT_FAILURE;
 	}
 
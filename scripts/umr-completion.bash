@@ -18,7 +18,7 @@ fi
 
 _umr_comp_option_flags()
 {
-    local FLAGS=(bits bitsfull empty_log follow no_follow_ib use_pci use_colour read_smc quiet no_kernel verbose halt_waves disasm_early_term no_disasm disasm_anyways wave64 full_shader no_fold_vm_decode)
+    local FLAGS=(bits bitsfull empty_log follow no_follow_ib use_pci use_colour read_smc quiet no_kernel verbose halt_waves disasm_early_term no_disasm disasm_anyways wave64 full_shader no_fold_vm_decode use_io_uring)
     local F G CURR_OPTIONS
     local ACTIVE_OPTIONS=()
     local ACTIVE_FLAGS=()
@@ -333,7 +333,7 @@ _umr_comp_ring_stream()
 
 _umr_completion()
 {
-    local ALL_LONG_ARGS=(--database-path --option --gpu --instance --force --pci --gfxoff --vm-partition --bank --sbank --cbank --config --enumerate --list-blocks --list-regs --dump-discovery-table --lookup --write --writebit --read --logscan --top --waves --profiler --vm-decode --vm-read --vm-write --vm-write-word --vm-disasm --ring-stream --dump-ib --dump-ib-file --header-dump --power --clock-scan --clock-manual --clock-high --clock-low --clock-auto --ppt-read --gpu-metrics --power --vbios-info --test-log --test-harness --server --gui)
+    local ALL_LONG_ARGS=(--database-path --option --gpu --instance --force --pci --gfxoff --vm-partition --bank --sbank --cbank --config --enumerate --list-blocks --list-regs --dump-discovery-table --lookup --write --writebit --read --snapshot --snapshot-diff --logscan --logscan-file --logscan-histogram --top --top-all --top-export --top-log-csv --waves --profiler --vm-decode --vm-map --vm-read --vm-write --vm-write-word --vm-disasm --ring-stream --dump-ib --dump-ib-file --header-dump --power --clock-scan --clock-manual --clock-high --clock-low --clock-auto --ppt-read --gpu-metrics --power --vbios-info --test-log --test-log-binary --test-harness --test-vector-convert --server --gui)
 
     local cur prev
 
@@ -347,7 +347,7 @@ _umr_completion()
 	--database-path|-dbp)
 	    compopt -o default -o dirnames
 	    ;;
-	--option|-O|bits|bitsfull|empty_log|follow|no_follow_ib|use_pci|use_colour|read_smc|quiet|no_kernel|verbose|halt_waves|disasm_early_term|no_disasm|disasm_anyways|wave64|full_shader|no_fold_vm_decode|,)
+	--option|-O|bits|bitsfull|empty_log|follow|no_follow_ib|use_pci|use_colour|read_smc|quiet|no_kernel|verbose|halt_waves|disasm_early_term|no_disasm|disasm_anyways|wave64|full_shader|no_fold_vm_decode|use_io_uring|,)
 	    _umr_comp_option_flags
 	    ;;
 	--force|-f)
@@ -374,6 +374,9 @@ _umr_completion()
 	-r|--read|-w|--write|--writebit|-wb)
 	    _umr_comp_asic_ipblock_registers
 	    ;;
+	--snapshot|-snap|--snapshot-diff|-sdiff)
+	    _umr_comp_ipblock
+	    ;;
 	--waves|-wa)
 	    _umr_comp_ring
 	    ;;
@@ -383,7 +386,7 @@ _umr_completion()
 	pixel=*|vertex=*|compute=*)
 	    _umr_comp_ring
 	    ;;
-	--dump-ib-file|-df|--test-log|-tl|--test-harness|-th)
+	--dump-ib-file|-df|--test-log|-tl|--test-log-binary|-tlb|--test-harness|-th|--test-vector-convert|-tvc)
 	    compopt -o default -o filenames
 	    ;;
 	--clock-scan|-cs|--clock-manual|-cm)
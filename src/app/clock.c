@@ -49,20 +49,19 @@ static void print_clock(struct umr_clock_source clock_source, struct umr_asic *a
 
 static void print_pcie_clock(struct umr_asic *asic)
 {
-	FILE* fp = NULL;
-	char name[256];
+	char name[256], buf[4096], *line, *next;
 	snprintf(name, sizeof(name)-1, \
 		"/sys/class/drm/card%d/device/pp_dpm_pcie", asic->instance);
-	fp = fopen(name, "r");
-	if (fp) {
+	if (umr_sysfs_read(asic, name, buf, sizeof buf) >= 0) {
 		printf("pcie:\n");
-		while (fgets(name, sizeof(name)-1, fp)) {
-			if (strstr(name, "*"))
-				printf("\t%s %s %s", YELLOW, name, RST);
+		for (line = buf; *line; line = next) {
+			next = strchr(line, '\n');
+			next = next ? next + 1 : line + strlen(line);
+			if (memchr(line, '*', next - line))
+				printf("\t%s %.*s %s", YELLOW, (int)(next - line), line, RST);
 			else
-				printf("\t %s", name);
+				printf("\t %.*s", (int)(next - line), line);
 		}
-		fclose(fp);
 	}
 }
 
@@ -73,15 +72,14 @@ void umr_clock_scan(struct umr_asic *asic, const char* clock_name)
 
 	asic_clocks.asic = asic;
 	if (clock_name == NULL){
-		for (i = 0; i < UMR_CLOCK_MAX && strlen(asic_clocks.clocks[i].clock_name); i++) {
-			if (umr_read_clock(asic, asic_clocks.clocks[i].clock_name, &asic_clocks.clocks[i]) == 0) {
-				if (strcmp(asic_clocks.clocks[i].clock_name, "pcie"))
-					print_clock(asic_clocks.clocks[i], asic);
-				else {
-					if (asic_clocks.clocks[i].clock_level != 0)
-						print_pcie_clock(asic);
-				}
-			}
+		struct umr_clock_snapshot snap;
+
+		umr_read_clock_snapshot(asic, &snap);
+		for (i = 0; i < UMR_CLOCK_MAX; i++) {
+			if (i != UMR_CLOCK_PCIE)
+				print_clock(snap.clocks[i], asic);
+			else if (snap.clocks[i].clock_level != 0)
+				print_pcie_clock(asic);
 		}
 		input_flag = 1;
 	} else {
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umrapp.h"
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+/*
+ * A daemon keeps a discovered asic with all of its registers loaded and
+ * runs each command line it is sent in a fork()ed child, which starts from
+ * that state and exits when the command is done.  The child writes to the
+ * client's own stdio (passed over the socket) and the daemon answers with
+ * the exit status.  Commands run one at a time as they share the asic's
+ * debugfs files (and their offsets) with each other.
+ */
+
+#define DAEMON_MAX_ARGS 4096
+#define DAEMON_MAX_ARG  65536
+
+static volatile sig_atomic_t daemon_quit;
+
+static void daemon_signal(int signo)
+{
+	(void)signo;
+	daemon_quit = 1;
+}
+
+static int read_full(int fd, void *buf, size_t len)
+{
+	char *p = buf;
+	ssize_t r;
+
+	while (len) {
+		r = read(fd, p, len);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			return -1;
+		p += r;
+		len -= r;
+	}
+	return 0;
+}
+
+static char *read_string(int fd, uint32_t len)
+{
+	char *s;
+
+	if (len > DAEMON_MAX_ARG)
+		return NULL;
+	s = calloc(1, len + 1);
+	if (s && read_full(fd, s, len)) {
+		free(s);
+		return NULL;
+	}
+	return s;
+}
+
+/*
+ * run_client - read a command line from a connection and run it, returns
+ * the exit status to send back or -1 if the request was malformed.
+ */
+static int run_client(int conn, int (*run)(int argc, char **argv))
+{
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cm;
+	union {
+		char buf[CMSG_SPACE(3 * sizeof(int))];
+		struct cmsghdr align;
+	} ctl;
+	uint32_t hdr[4], len;
+	int fds[3] = { -1, -1, -1 }, argc = 0, i, status = -1;
+	char **argv = NULL, *cwd = NULL;
+	pid_t pid;
+
+	memset(&msg, 0, sizeof msg);
+	iov.iov_base = hdr;
+	iov.iov_len = sizeof hdr;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = ctl.buf;
+	msg.msg_controllen = sizeof ctl.buf;
+	if (recvmsg(conn, &msg, MSG_CMSG_CLOEXEC) != sizeof hdr || hdr[0] != UMR_DAEMON_MAGIC)
+		return -1;
+	for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+		if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS &&
+		    cm->cmsg_len == CMSG_LEN(sizeof fds))
+			memcpy(fds, CMSG_DATA(cm), sizeof fds);
+	if (fds[0] < 0 || hdr[1] > DAEMON_MAX_ARGS)
+		goto out;
+
+	cwd = read_string(conn, hdr[2]);
+	argv = calloc(hdr[1] + 2, sizeof *argv);
+	if (!cwd || !argv)
+		goto out;
+	argv[argc++] = "umr";
+	for (i = 0; i < (int)hdr[1]; i++) {
+		if (read_full(conn, &len, sizeof len) || !(argv[argc] = read_string(conn, len)))
+			goto out;
+		++argc;
+	}
+
+	fflush(NULL);
+	pid = fork();
+	if (pid == 0) {
+		// the client's stdio and directory, the connection only carries the status
+		for (i = 0; i < 3; i++)
+			dup2(fds[i], i);
+		signal(SIGINT, SIG_DFL);
+		signal(SIGTERM, SIG_DFL);
+		signal(SIGPIPE, SIG_DFL);
+		if (cwd[0] && chdir(cwd))
+			fprintf(stderr, "[WARNING]: Could not change to directory '%s'\n", cwd);
+		status = run(argc, argv);
+		fflush(NULL);
+		_exit(status);
+	} else if (pid > 0) {
+		while (waitpid(pid, &status, 0) < 0 && errno == EINTR);
+		status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+	} else {
+		fprintf(stderr, "[ERROR]: Could not fork to run a command: %s\n", strerror(errno));
+		status = EXIT_FAILURE;
+	}
+
+out:
+	for (i = 0; i < 3; i++)
+		if (fds[i] >= 0)
+			close(fds[i]);
+	if (argv)
+		for (i = 1; i < argc; i++)
+			free(argv[i]);
+	free(argv);
+	free(cwd);
+	return status;
+}
+
+/**
+ * umr_daemon_run - Serve command lines on a unix socket until interrupted
+ *
+ * @asic: The device the commands run on
+ * @path: The socket to create, only root can connect to it
+ * @run: Runs a command line (main()) in the child, returns its exit status
+ *
+ * Returns 0 when stopped by SIGINT/SIGTERM, -1 if the socket could not be
+ * created.
+ */
+int umr_daemon_run(struct umr_asic *asic, const char *path, int (*run)(int argc, char **argv))
+{
+	struct sockaddr_un sa;
+	struct sigaction sa_quit, old_int, old_term;
+	void (*old_pipe)(int);
+	int fd, conn;
+	int32_t status;
+
+	if (strlen(path) >= sizeof(sa.sun_path)) {
+		asic->err_msg("[ERROR]: The daemon socket path '%s' is too long\n", path);
+		return -1;
+	}
+
+	// what a command would otherwise load for itself every time
+	umr_load_ip_blocks(asic, NULL);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		asic->err_msg("[ERROR]: Could not create a socket: %s\n", strerror(errno));
+		return -1;
+	}
+	memset(&sa, 0, sizeof sa);
+	sa.sun_family = AF_UNIX;
+	strcpy(sa.sun_path, path);
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&sa, sizeof sa) || chmod(path, 0600) || listen(fd, 16)) {
+		asic->err_msg("[ERROR]: Could not listen on '%s': %s\n", path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	daemon_quit = 0;
+	// no SA_RESTART so a signal breaks out of accept()
+	memset(&sa_quit, 0, sizeof sa_quit);
+	sa_quit.sa_handler = daemon_signal;
+	sigaction(SIGINT, &sa_quit, &old_int);
+	sigaction(SIGTERM, &sa_quit, &old_term);
+	old_pipe = signal(SIGPIPE, SIG_IGN); // a client that went away
+	asic->std_msg("[NOTE]: umr daemon for %s listening on '%s'\n", asic->asicname, path);
+	while (!daemon_quit) {
+		conn = accept(fd, NULL, NULL);
+		if (conn < 0)
+			continue;
+		status = run_client(conn, run);
+		if (status >= 0 && write(conn, &status, sizeof status) != sizeof status)
+			asic->err_msg("[WARNING]: A daemon client went away before its status was sent\n");
+		close(conn);
+	}
+	sigaction(SIGINT, &old_int, NULL);
+	sigaction(SIGTERM, &old_term, NULL);
+	signal(SIGPIPE, old_pipe);
+	close(fd);
+	unlink(path);
+	return 0;
+}
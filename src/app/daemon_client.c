@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umrapp.h"
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/*
+ * The client side of --daemon, it only uses libc so the thin umrc
+ * client can be built from this file alone.
+ */
+
+static int write_full(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+	ssize_t r;
+
+	while (len) {
+		r = write(fd, p, len);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			return -1;
+		p += r;
+		len -= r;
+	}
+	return 0;
+}
+
+/**
+ * umr_daemon_forward - Run a command line on a umr daemon
+ *
+ * @path: The unix socket the daemon listens on
+ * @argc, @argv: The command line, argv[0] is not sent
+ *
+ * The stdin/stdout/stderr of this process are passed to the daemon which
+ * runs the command with them so the output is written straight to them.
+ *
+ * Returns the exit status of the command or -1 if the daemon could not
+ * be reached (nothing was run).
+ */
+int umr_daemon_forward(const char *path, int argc, char **argv)
+{
+	struct sockaddr_un sa;
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cm;
+	union {
+		char buf[CMSG_SPACE(3 * sizeof(int))];
+		struct cmsghdr align;
+	} ctl;
+	uint32_t hdr[4], len;
+	char cwd[4096];
+	int fd, i, fds[3] = { 0, 1, 2 };
+	int32_t status;
+	ssize_t r;
+
+	if (strlen(path) >= sizeof(sa.sun_path))
+		return -1;
+	if (!getcwd(cwd, sizeof cwd))
+		cwd[0] = 0;
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+	memset(&sa, 0, sizeof sa);
+	sa.sun_family = AF_UNIX;
+	strcpy(sa.sun_path, path);
+	if (connect(fd, (struct sockaddr *)&sa, sizeof sa)) {
+		close(fd);
+		return -1;
+	}
+
+	// the header carries our stdio descriptors
+	hdr[0] = UMR_DAEMON_MAGIC;
+	hdr[1] = argc - 1;
+	hdr[2] = strlen(cwd);
+	hdr[3] = 0;
+	iov.iov_base = hdr;
+	iov.iov_len = sizeof hdr;
+	memset(&msg, 0, sizeof msg);
+	memset(&ctl, 0, sizeof ctl);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = ctl.buf;
+	msg.msg_controllen = sizeof ctl.buf;
+	cm = CMSG_FIRSTHDR(&msg);
+	cm->cmsg_level = SOL_SOCKET;
+	cm->cmsg_type = SCM_RIGHTS;
+	cm->cmsg_len = CMSG_LEN(sizeof fds);
+	memcpy(CMSG_DATA(cm), fds, sizeof fds);
+	if (sendmsg(fd, &msg, 0) != sizeof hdr)
+		goto error;
+
+	if (write_full(fd, cwd, hdr[2]))
+		goto error;
+	for (i = 1; i < argc; i++) {
+		len = strlen(argv[i]);
+		if (write_full(fd, &len, sizeof len) || write_full(fd, argv[i], len))
+			goto error;
+	}
+
+	// the command has run once the daemon answers
+	do {
+		r = read(fd, &status, sizeof status);
+	} while (r < 0 && errno == EINTR);
+	close(fd);
+	return r == sizeof status ? status : EXIT_FAILURE;
+error:
+	close(fd);
+	return -1;
+}
@@ -227,6 +227,55 @@ struct DrmEvent : public Event {
 		}
 	}
 
+	void handle_binary_field(const char *name, uint64_t value, const char *str, int str_len) {
+		/* The fence an event is about is fence_context:fence_seqno, the one it
+		 * waits for ctx:seqno. */
+		DmaFence *fence = NULL, *other = NULL;
+
+		switch (type) {
+			case EventType::DrmSchedJobQueue:
+				fence = &u.drm_sched_job_queue.fence;
+				if (!strcmp(name, "job_count"))
+					u.drm_sched_job_queue.sw_job_count = value;
+				else if (!strcmp(name, "client_id"))
+					u.drm_sched_job_queue.client_id = value;
+				break;
+			case EventType::DrmSchedJobRun:
+				fence = &u.drm_sched_job_run.fence;
+				if (!strcmp(name, "name") && str)
+					u.drm_sched_job_run.ring = strndup(str, str_len);
+				else if (!strcmp(name, "dev") && str)
+					u.drm_sched_job_run.device = strndup(str, str_len);
+				else if (!strcmp(name, "hw_job_count"))
+					u.drm_sched_job_run.hw_job_count = value;
+				else if (!strcmp(name, "client_id"))
+					u.drm_sched_job_run.client_id = value;
+				break;
+			case EventType::DrmSchedJobDone:
+				fence = &u.drm_sched_job_done.signaled;
+				break;
+			case EventType::DrmSchedJobAddDep:
+				fence = &u.drm_sched_job_add_dep.fence;
+				other = &u.drm_sched_job_add_dep.dep_fence;
+				break;
+			case EventType::DrmSchedJobUnschedulable:
+				fence = &u.drm_sched_job_unschedulable.fence;
+				other = &u.drm_sched_job_unschedulable.wait_fence;
+				break;
+			default:
+				return;
+		}
+
+		if (!strcmp(name, "fence_context"))
+			fence->context = value;
+		else if (!strcmp(name, "fence_seqno"))
+			fence->seqno = value;
+		else if (other && !strcmp(name, "ctx"))
+			other->context = value;
+		else if (other && !strcmp(name, "seqno"))
+			other->seqno = value;
+	}
+
 	union {
 		struct {
 			DmaFence fence;
@@ -649,6 +698,308 @@ void Timeline::sort_timelines(Timelines& timelines, const std::set<DrmSchedJob*>
 	});
 }
 
+/* Columnar copy of the jobs of a capture, to draw long captures.
+ *
+ * The jobs are ordered by end timestamp (post_process_capture() sorts them
+ * that way too), so the first job visible at a given time is found with a
+ * binary search on "end", and "min_start" (the smallest start of the jobs
+ * from there on) bounds the last one.
+ *
+ * When zoomed out, the timelines are drawn from pyramids of time buckets
+ * instead of job by job.  Each hardware timeline has one for the execution
+ * of its jobs and each submitting timeline one for the scheduler wait.
+ * Level 0 has at least 2 buckets per job, each level above merges 2.
+ *
+ * The store of the capture being recorded is filled as its jobs complete
+ * instead (begin_live(), add() and refresh()): level 0 of its pyramids
+ * grows with the capture and its buckets are merged 2 by 2 when there are
+ * too many of them, refresh() only merges again the buckets added to.
+ */
+struct JobStore {
+	/* Draw from the pyramids when more jobs than this are visible. */
+	static const size_t LOD_MIN_JOBS = 10000;
+	/* Level 0 of the pyramids of a live capture. */
+	static const size_t LIVE_MAX_BUCKETS = 1 << 20;
+	static constexpr double LIVE_BUCKET_WIDTH = 10e-6;
+
+	struct Bucket {
+		uint32_t count;		/* jobs starting in this bucket */
+		float busy;			/* seconds covered by jobs */
+		float min_dur, max_dur;	/* get_job_duration() of the jobs starting here */
+	};
+
+	struct Pyramid {
+		double bucket_width;	/* of level 0 */
+		std::vector<std::vector<Bucket>> levels;
+		size_t dirty = SIZE_MAX;	/* live: first level 0 bucket changed since refresh() */
+	};
+
+	void build(const std::vector<DrmSchedJob*>& sched_jobs, JobDurationMode::Enum duration_mode) {
+		job.assign(sched_jobs.begin(), sched_jobs.end());
+		if (!std::is_sorted(job.begin(), job.end(), compare_end))
+			std::stable_sort(job.begin(), job.end(), compare_end);
+
+		const size_t n = job.size();
+		start.resize(n);
+		end.resize(n);
+		hw_submit.resize(n);
+		hw_exec.resize(n);
+		min_start.resize(n);
+		submit_tl.resize(n);
+		exec_tl.resize(n);
+		exec_pyramids.clear();
+		submit_pyramids.clear();
+
+		t0 = n ? DBL_MAX : 0;
+		double t1 = 0;
+		std::map<Timeline*, size_t> exec_jobs, submit_jobs;
+		for (size_t i = 0; i < n; i++) {
+			DrmSchedJob *j = job[i];
+			start[i] = j->start_ts();
+			end[i] = j->end_ts();
+			hw_submit[i] = j->hw_submit_ts() > 0 ? j->hw_submit_ts() : end[i];
+			hw_exec[i] = j->hw_exec_ts() > 0 ? j->hw_exec_ts() : end[i];
+			submit_tl[i] = j->submit_timeline;
+			exec_tl[i] = j->execute_timeline;
+			t0 = std::min(t0, start[i]);
+			t1 = std::max(t1, end[i]);
+			if (exec_tl[i])
+				exec_jobs[exec_tl[i]]++;
+			if (submit_tl[i])
+				submit_jobs[submit_tl[i]]++;
+		}
+		for (size_t i = n; i-- > 0;)
+			min_start[i] = (i + 1 < n) ? std::min(start[i], min_start[i + 1]) : start[i];
+
+		const double span = std::max(t1 - t0, 1e-6);
+		for (auto& it: exec_jobs)
+			init_pyramid(exec_pyramids[it.first], span, it.second);
+		for (auto& it: submit_jobs)
+			init_pyramid(submit_pyramids[it.first], span, it.second);
+
+		/* Fill level 0, then merge the levels above. */
+		std::map<Timeline*, std::vector<int>> exec_cover, submit_cover;
+		for (size_t i = 0; i < n; i++) {
+			const float dur = get_job_duration(job[i], duration_mode);
+			if (exec_tl[i])
+				add_job(exec_pyramids[exec_tl[i]], &exec_cover[exec_tl[i]], hw_exec[i], end[i], dur);
+			if (submit_tl[i])
+				add_job(submit_pyramids[submit_tl[i]], &submit_cover[submit_tl[i]], start[i], hw_submit[i], dur);
+		}
+		for (auto& it: exec_pyramids)
+			finish_pyramid(it.second, exec_cover[it.first]);
+		for (auto& it: submit_pyramids)
+			finish_pyramid(it.second, submit_cover[it.first]);
+
+		mode = duration_mode;
+		live = false;
+		valid = true;
+	}
+
+	/* Empties the store of a capture starting at @ts. */
+	void begin_live(double ts, JobDurationMode::Enum duration_mode) {
+		job.clear();
+		start.clear();
+		end.clear();
+		hw_submit.clear();
+		hw_exec.clear();
+		min_start.clear();
+		submit_tl.clear();
+		exec_tl.clear();
+		exec_pyramids.clear();
+		submit_pyramids.clear();
+		t0 = ts;
+		mode = duration_mode;
+		live = true;
+		valid = true;
+	}
+
+	/* Adds a completed job to a live store.  Jobs complete in about the
+	 * order they end so they are almost always appended. */
+	void add(DrmSchedJob *j) {
+		const double s = j->start_ts(), e = j->end_ts();
+		size_t i = end.size();
+		if (i && e < end.back())
+			i = std::upper_bound(end.begin(), end.end(), e) - end.begin();
+
+		job.insert(job.begin() + i, j);
+		start.insert(start.begin() + i, s);
+		end.insert(end.begin() + i, e);
+		hw_submit.insert(hw_submit.begin() + i, j->hw_submit_ts() > 0 ? j->hw_submit_ts() : e);
+		hw_exec.insert(hw_exec.begin() + i, j->hw_exec_ts() > 0 ? j->hw_exec_ts() : e);
+		submit_tl.insert(submit_tl.begin() + i, j->submit_timeline);
+		exec_tl.insert(exec_tl.begin() + i, j->execute_timeline);
+		min_start.insert(min_start.begin() + i, i < min_start.size() ? std::min(s, min_start[i]) : s);
+		for (size_t k = i; k-- > 0 && min_start[k] > s;)
+			min_start[k] = s;
+
+		const float dur = get_job_duration(j, mode);
+		if (exec_tl[i])
+			add_job(live_pyramid(exec_pyramids, exec_tl[i]), NULL, hw_exec[i], e, dur);
+		if (submit_tl[i])
+			add_job(live_pyramid(submit_pyramids, submit_tl[i]), NULL, s, hw_submit[i], dur);
+	}
+
+	/* Merges the levels above the buckets add() changed. */
+	void refresh() {
+		for (auto *pyramids: { &exec_pyramids, &submit_pyramids }) {
+			for (auto& it: *pyramids) {
+				if (it.second.dirty == SIZE_MAX)
+					continue;
+				merge_levels(it.second, it.second.dirty);
+				it.second.dirty = SIZE_MAX;
+			}
+		}
+	}
+
+	/* Jobs [first, last) are the only ones that can overlap [ts_start, ts_end]. */
+	void visible_range(double ts_start, double ts_end, size_t& first, size_t& last) const {
+		first = std::lower_bound(end.begin(), end.end(), ts_start) - end.begin();
+		last = std::upper_bound(min_start.begin(), min_start.end(), ts_end) - min_start.begin();
+		last = std::max(first, last);
+	}
+
+	/* Finest level whose buckets are at least @width seconds wide. */
+	static int pick_level(const Pyramid& p, double width, double *bucket_width) {
+		int level = 0;
+		double w = p.bucket_width;
+		while (w < width && level + 1 < (int)p.levels.size()) {
+			w *= 2;
+			level++;
+		}
+		*bucket_width = w;
+		return level;
+	}
+
+	std::vector<DrmSchedJob*> job;
+	std::vector<double> start, end, hw_submit, hw_exec;
+	std::vector<double> min_start;
+	std::vector<Timeline*> submit_tl, exec_tl;
+
+	double t0 = 0;
+	std::map<Timeline*, Pyramid> exec_pyramids, submit_pyramids;
+
+	bool valid = false;
+	bool live = false;
+	JobDurationMode::Enum mode;
+
+private:
+	static bool compare_end(const DrmSchedJob *a, const DrmSchedJob *b) {
+		return a->end_ts() < b->end_ts();
+	}
+
+	static void init_pyramid(Pyramid& p, double span, size_t n_jobs) {
+		size_t n_buckets = 4096;
+		while (n_buckets < 2 * n_jobs && n_buckets < (1u << 22))
+			n_buckets *= 2;
+		p.bucket_width = span / n_buckets;
+		p.levels.assign(1, std::vector<Bucket>(n_buckets, empty_bucket()));
+	}
+
+	static Pyramid& live_pyramid(std::map<Timeline*, Pyramid>& pyramids, Timeline *tl) {
+		auto it = pyramids.find(tl);
+		if (it != pyramids.end())
+			return it->second;
+		Pyramid& p = pyramids[tl];
+		p.bucket_width = LIVE_BUCKET_WIDTH;
+		p.levels.assign(1, std::vector<Bucket>());
+		return p;
+	}
+
+	static Bucket empty_bucket() {
+		return Bucket { 0, 0, FLT_MAX, 0 };
+	}
+
+	static Bucket merge(const Bucket& a, const Bucket& b) {
+		return Bucket { a.count + b.count, a.busy + b.busy,
+						std::min(a.min_dur, b.min_dur), std::max(a.max_dur, b.max_dur) };
+	}
+
+	/* Level 0 of a live pyramid with buckets twice as wide. */
+	static void coarsen(Pyramid& p) {
+		std::vector<Bucket>& b = p.levels[0];
+		const size_t n = (b.size() + 1) / 2;
+		for (size_t i = 0; i < n; i++)
+			b[i] = merge(b[2 * i], 2 * i + 1 < b.size() ? b[2 * i + 1] : empty_bucket());
+		b.resize(n);
+		p.bucket_width *= 2;
+		p.levels.resize(1);
+		p.dirty = 0;
+	}
+
+	/* Without @cover (live pyramids), the buckets covered by the job are
+	 * added to right away. */
+	void add_job(Pyramid& p, std::vector<int> *cover, double s, double e, float dur) {
+		long bs, be;
+		if (live) {
+			while ((e - t0) / p.bucket_width >= LIVE_MAX_BUCKETS)
+				coarsen(p);
+			bs = std::max(0L, (long)((s - t0) / p.bucket_width));
+			be = std::max(bs, (long)((e - t0) / p.bucket_width));
+			if ((size_t)be >= p.levels[0].size())
+				p.levels[0].resize(be + 1, empty_bucket());
+			p.dirty = std::min(p.dirty, (size_t)bs);
+		} else {
+			const long last = p.levels[0].size() - 1;
+			bs = std::min(last, std::max(0L, (long)((s - t0) / p.bucket_width)));
+			be = std::min(last, std::max(bs, (long)((e - t0) / p.bucket_width)));
+		}
+		std::vector<Bucket>& b = p.levels[0];
+		const double w = p.bucket_width;
+
+		b[bs].count++;
+		b[bs].min_dur = std::min(b[bs].min_dur, dur);
+		b[bs].max_dur = std::max(b[bs].max_dur, dur);
+
+		if (bs == be) {
+			b[bs].busy += std::max(0.0, e - s);
+			return;
+		}
+		/* Partial buckets at both ends, the ones in between are covered. */
+		b[bs].busy += t0 + (bs + 1) * w - s;
+		b[be].busy += e - (t0 + be * w);
+		if (be > bs + 1) {
+			if (!cover) {
+				for (long k = bs + 1; k < be; k++)
+					b[k].busy += w;
+				return;
+			}
+			if (cover->empty())
+				cover->resize(b.size() + 1);
+			(*cover)[bs + 1]++;
+			(*cover)[be]--;
+		}
+	}
+
+	static void finish_pyramid(Pyramid& p, const std::vector<int>& cover) {
+		if (!cover.empty()) {
+			int covered = 0;
+			for (size_t i = 0; i < p.levels[0].size(); i++) {
+				covered += cover[i];
+				p.levels[0][i].busy += covered * p.bucket_width;
+			}
+		}
+		merge_levels(p, 0);
+	}
+
+	/* (Re)computes the buckets of the levels above level 0 bucket @from. */
+	static void merge_levels(Pyramid& p, size_t from) {
+		size_t l;
+		for (l = 1; p.levels[l - 1].size() > 1; l++) {
+			if (p.levels.size() <= l)
+				p.levels.emplace_back();
+			const std::vector<Bucket>& below = p.levels[l - 1];
+			std::vector<Bucket>& above = p.levels[l];
+			above.resize((below.size() + 1) / 2, empty_bucket());
+			from /= 2;
+			for (size_t i = from; i < above.size(); i++)
+				above[i] = merge(below[2 * i], 2 * i + 1 < below.size() ? below[2 * i + 1] : empty_bucket());
+		}
+		p.levels.resize(l);
+	}
+
+};
+
 /* Support multiple captures in a single run. To achieve this, the Capture struct
  * holds a list of DrmSchedJob.
  */
@@ -671,7 +1022,69 @@ struct Capture {
 		return sched_jobs.back()->end_ts();
 	}
 
+	/* The job at position @i of the last drawn range, the pending jobs
+	 * of a live capture come after the ones of the store. */
+	DrmSchedJob *visible_job(size_t i) const {
+		if (!store.valid)
+			return sched_jobs[i];
+		return i < visible.last ? store.job[i] : live_pending[i - visible.last];
+	}
+
+	/* Adds the jobs completed since the last call to the store of the
+	 * capture being recorded. */
+	void update_live_store(JobDurationMode::Enum mode) {
+		if (sched_jobs.empty())
+			return;
+		if (!store.valid || store.mode != mode) {
+			store.begin_live(sched_jobs.front()->start_ts(), mode);
+			live_pending.clear();
+			live_seen = 0;
+		}
+		live_pending.insert(live_pending.end(), sched_jobs.begin() + live_seen, sched_jobs.end());
+		live_seen = sched_jobs.size();
+
+		std::vector<DrmSchedJob*> done;
+		size_t n = 0;
+		for (auto *j: live_pending) {
+			if (j->events.back().is(EventType::DrmSchedJobDone))
+				done.push_back(j);
+			else
+				live_pending[n++] = j;
+		}
+		live_pending.resize(n);
+		if (done.empty())
+			return;
+
+		std::stable_sort(done.begin(), done.end(), [](const DrmSchedJob *a, const DrmSchedJob *b) {
+			return a->end_ts() < b->end_ts();
+		});
+		for (auto *j: done)
+			store.add(j);
+		store.refresh();
+	}
+
+	/* Drops the store of the capture being recorded, after jobs were
+	 * deleted from it. */
+	void reset_live_store() {
+		store.valid = false;
+		live_pending.clear();
+		live_seen = 0;
+	}
+
 	std::vector<DrmSchedJob*> sched_jobs;
+	JobStore store;
+	/* Live capture: the jobs not done yet and how many of sched_jobs were
+	 * looked at. */
+	std::vector<DrmSchedJob*> live_pending;
+	size_t live_seen = 0;
+
+	/* Updated each frame: the jobs that may be visible, the pending ones
+	 * after them, and whether they were drawn from the pyramids. */
+	struct {
+		size_t first, last, pending;
+		double view_start, view_end;
+		bool lod;
+	} visible = { 0, 0, 0, 0, 0, false };
 
 	float ts_shift;
 };
@@ -895,7 +1308,7 @@ static double parse_raw_event_buffer(void *raw_data, unsigned raw_data_size,
 		DrmEvent event(bp.type, bp.timestamp);
 
 		/* Parse the fields. */
-		consumed += Event::parse_event_fields(input + consumed, &event);
+		consumed += Event::parse_fields(bp, input + consumed, &event, names);
 
 		/* If this a gpu_scheduler event (except drm_sched_job_done that is handled below)? */
 		if (event.is(EventType::DrmSchedJobQueue) || event.is(EventType::DrmSchedJobUnschedulable) ||
@@ -986,6 +1399,8 @@ public:
 
 	/* Called once at the end of the capture process. */
 	void kick_off_post_processing() {
+		if (!captures.empty())
+			captures.back()->reset_live_store();
 		tracing_status = TracingStatus::PostProcessing;
 		cancel_post_processing = false;
 
@@ -1171,8 +1586,12 @@ public:
 					} while (true);
 					if (drop_count > 0) {
 						sched_jobs.erase(sched_jobs.begin(), sched_jobs.begin() + drop_count);
+						active_capture->reset_live_store();
 					}
 				}
+				/* The store is rebuilt once the capture is post-processed,
+				 * until then the completed jobs are added to it. */
+				active_capture->update_live_store(job_duration_tab.mode);
 			}
 			last_reply_parsed = true;
 		}
@@ -1296,6 +1715,18 @@ public:
 			}
 		}
 
+		/* (Re)build the job stores of the post-processed captures. */
+		for (size_t i = 0; i < captures.size(); i++) {
+			auto *capture = captures[i];
+			if (i + 1 == captures.size() && tracing_status != TracingStatus::Off) {
+				if (capture->store.valid && capture->store.mode != job_duration_tab.mode)
+					capture->update_live_store(job_duration_tab.mode);
+				continue;
+			}
+			if (!capture->store.valid || capture->store.mode != job_duration_tab.mode)
+				capture->store.build(capture->sched_jobs, job_duration_tab.mode);
+		}
+
 		const float u64_input_size = ImGui::CalcTextSize("00000000000000000").x;
 		double min_ts = FLT_MAX, max_ts = -1;
 		for (auto &capture: captures) {
@@ -1734,8 +2165,28 @@ end:
 
 			drawable_area.set_extra_timestamp_offset(capture->ts_shift);
 
-			auto& sched_jobs = capture->sched_jobs;
-			for (auto *job: sched_jobs) {
+			/* Only walk the jobs that may be visible, or draw them from the
+			 * pyramids if there are too many of them. */
+			const double view_start = drawable_area.get_timestamp_offset();
+			const double view_end = view_start + displayed_duration;
+			if (capture->store.valid) {
+				capture->store.visible_range(view_start, view_end, capture->visible.first, capture->visible.last);
+			} else {
+				capture->visible.first = 0;
+				capture->visible.last = capture->sched_jobs.size();
+			}
+			capture->visible.pending = capture->store.valid ? capture->live_pending.size() : 0;
+			capture->visible.view_start = view_start;
+			capture->visible.view_end = view_end;
+			capture->visible.lod = capture->store.valid &&
+				capture->visible.last - capture->visible.first > JobStore::LOD_MIN_JOBS;
+
+			if (capture->visible.lod)
+				draw_capture_lod(capture, row_size, gpu_timelines_area.w, view_start, view_end);
+
+			const size_t first_job = capture->visible.lod ? capture->visible.last : capture->visible.first;
+			for (size_t k = first_job; k < capture->visible.last + capture->visible.pending; k++) {
+				auto *job = capture->visible_job(k);
 				job->drawn = false;
 				if (!job->execute_timeline || !job->execute_timeline->visible)
 					continue;
@@ -2038,6 +2489,63 @@ end:
 	}
 
 private:
+	/* Draws the jobs of @capture from its pyramids: one box per bucket of
+	 * at least a pixel, more opaque when the timeline was busier.
+	 */
+	void draw_capture_lod(Capture *capture, float row_size, float top_y,
+						  double view_start, double view_end) {
+		const JobStore& store = capture->store;
+		const double pixel = 1 / drawable_area.get_scale();
+
+		for (int exec = 1; exec >= 0; exec--) {
+			for (const auto& it: exec ? store.exec_pyramids : store.submit_pyramids) {
+				Timeline *tl = it.first;
+				if (!tl->visible)
+					continue;
+				/* Submit rows scroll under the hardware timelines. */
+				const float y = exec ? tl->draw_y : std::max(tl->draw_y, top_y);
+				if (!exec && tl->draw_y + row_size < top_y)
+					continue;
+
+				double w;
+				const int level = JobStore::pick_level(it.second, pixel, &w);
+				const auto& buckets = it.second.levels[level];
+				const long first = std::max(0L, (long)((view_start - store.t0) / w));
+				const long last = std::min((long)buckets.size(), (long)((view_end - store.t0) / w) + 1);
+
+				for (long b = first; b < last; b++) {
+					const JobStore::Bucket& bucket = buckets[b];
+					if (!bucket.count && bucket.busy <= 0)
+						continue;
+
+					const double ts = store.t0 + b * w;
+					ImVec2 bl, tr;
+					if (!compute_job_rect(drawable_area, y, row_size, ts, ts + w, bl, tr))
+						continue;
+
+					ImColor c(tl->color);
+					c.Value.w = 0.25 + 0.75 * std::min(1.0, bucket.busy / w);
+					ImGui::GetWindowDrawList()->AddRectFilled(bl, tr, c);
+					if (ImGui::IsMouseHoveringRect(bl, tr))
+						ImGui::SetTooltip("%s\n%u jobs, %d %% busy", exec ? "exec" : "sched wait",
+										  bucket.count, (int)(std::min(1.0, bucket.busy / w) * 100));
+
+					if (!exec)
+						continue;
+
+					/* Only count the visible part of the bucket. */
+					const double overlap = std::min(ts + w, view_end) - std::max(ts, view_start);
+					tl->usage += bucket.busy * std::max(0.0, overlap) / w;
+					if (bucket.count) {
+						job_duration_tab.min_job_duration = std::min(job_duration_tab.min_job_duration, (double)bucket.min_dur);
+						job_duration_tab.max_job_duration = std::max(job_duration_tab.max_job_duration, (double)bucket.max_dur);
+						job_duration_tab.n_visible_jobs += bucket.count;
+					}
+				}
+			}
+		}
+	}
+
 	void draw_job_duration(const ImVec2& avail,
 						  const ImColor& hw_timeline_bg) {
 		const float padding = ImGui::GetStyle().FramePadding.x;
@@ -2074,22 +2582,22 @@ private:
 		/* Store the number of submissions from each timeline in each bucket. */
 		std::vector<std::map<Timeline *, int>> values(n_buckets * n_hw_timelines);
 		int largest_value = 0;
-		bool added_at_least_one = false;
 
 		for (size_t i = 0; i < captures.size(); i++) {
 			auto *capture = captures[i];
 			if (capture->sched_jobs.empty())
 				continue;
-			auto& sched_jobs = capture->sched_jobs;
-			for (auto *job: sched_jobs) {
+			const double view_start = capture->visible.view_start;
+			const double view_end = capture->visible.view_end;
+			for (size_t k = capture->visible.first; k < capture->visible.last + capture->visible.pending; k++) {
+				auto *job = capture->visible_job(k);
 				if (!job->execute_timeline || !job->execute_timeline->visible)
 					continue;
-				if (!job->drawn) {
-					if (added_at_least_one)
-						break;
+				/* Jobs drawn from the pyramids have no drawn flag. */
+				if (capture->visible.lod && k < capture->visible.last ?
+						(capture->store.hw_exec[k] > view_end || capture->store.end[k] < view_start) :
+						!job->drawn)
 					continue;
-				}
-				added_at_least_one = true;
 
 				int idx = tl_to_idx[job->execute_timeline];
 
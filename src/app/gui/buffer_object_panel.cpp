@@ -25,6 +25,8 @@
 #include "imgui/imgui.h"
 #include "panels.h"
 
+#include <map>
+
 static struct umr_bitfield alloc_flag_bitfields[] = {
 	{ .regname = (char*)"CPU_ACCESS_REQUIRED", .start = 0, .stop = 0 },
 	{ .regname = (char*)"NO_CPU_ACCESS", .start = 1, .stop = 1 },
@@ -75,11 +77,16 @@ class BufferObjectPanel : public Panel {
 public:
 	BufferObjectPanel(struct umr_asic *asic) : Panel(asic), last_answer_gem_info(NULL),
 											   last_answer_peak_bo(NULL), texture_id(0),
+											   texture_width(0), texture_height(0),
 											   raw_data(NULL), zoom_to_fit(false),
-											   last_error_peak_bo(NULL), zoom(1) { }
+											   last_error_peak_bo(NULL), zoom(1),
+											   live(false), live_md(NULL), view_width(0),
+											   full_frame_needed(true) { }
 	~BufferObjectPanel() {
 		if (last_answer_gem_info)
 			json_value_free(json_object_get_wrapping_value(last_answer_gem_info));
+		if (live_md)
+			json_value_free(live_md);
 	}
 
 	void process_server_message(JSON_Object *response, void *_raw_data, unsigned _raw_data_size) {
@@ -92,6 +99,9 @@ public:
 			if (last_answer_gem_info)
 				json_value_free(json_object_get_wrapping_value(last_answer_gem_info));
 			last_answer_gem_info = json_object(json_value_deep_copy(answer));
+			index_bos();
+			if (displayed.is == 1)
+				displayed.bo.bo = find_displayed_bo();
 		}
 		if (!strcmp(command, "peak-bo")) {
 			if (last_answer_peak_bo) {
@@ -106,13 +116,18 @@ public:
 				displayed.is = -1;
 			} else {
 				last_answer_peak_bo = json_object(json_value_deep_copy(answer));
-				if (this->raw_data)
+				if (this->raw_data) {
+					/* The previous tiles were never uploaded, so the texture
+					 * can't be patched anymore: the next frame must be complete.
+					 */
 					free(this->raw_data);
+					full_frame_needed = true;
+				}
 				if (!json_object_has_value(request, "metadata")) {
 					displayed.bo.pid = json_object_get_number(request, "pid");
 					displayed.bo.handle = json_object_get_number(request, "handle");
 					displayed.bo.gpu_fd = json_object_get_number(request, "gpu-fd");
-					displayed.bo.bo = NULL;
+					displayed.bo.bo = find_displayed_bo();
 					displayed.is = 1;
 				} else {
 					displayed.is = 2;
@@ -133,10 +148,21 @@ public:
 			 */
 			int width = json_object_get_number(last_answer_peak_bo, "width");
 			int height = json_object_get_number(last_answer_peak_bo, "height");
-			if (texture_id)
+			bool delta = json_object_get_boolean(last_answer_peak_bo, "delta") == 1;
+			if (texture_id && (!delta || width != texture_width || height != texture_height)) {
 				glDeleteTextures(1, &texture_id);
-			texture_id = texture_from_qoi_buffer(width, height,
-												 this->raw_data, this->raw_data_size);
+				texture_id = 0;
+			}
+			if (texture_id || !delta) {
+				texture_id = texture_from_qoi_tiles(texture_id, width, height,
+													json_object_get_array(last_answer_peak_bo, "tiles"),
+													this->raw_data, this->raw_data_size);
+				texture_width = width;
+				texture_height = height;
+				full_frame_needed = false;
+			} else {
+				full_frame_needed = true;
+			}
 			free(raw_data);
 			this->raw_data_size = 0;
 			this->raw_data = NULL;
@@ -145,6 +171,8 @@ public:
 		if (can_send_request) {
 			if (!last_answer_gem_info)
 				send_gem_info_command();
+			else if (live && live_md && displayed.is == 2)
+				send_peak_bo_command2(live_md, true);
 		}
 
 		if (ImGui::Button("Refresh List")) {
@@ -159,6 +187,13 @@ public:
 				ImGui::SliderFloat("Zoom", &zoom, 0.1, 10, "%.1f");
 			}
 		}
+		if (displayed.is == 2 || live) {
+			ImGui::SameLine();
+			ImGui::Checkbox("Live", &live);
+			if (ImGui::IsItemHovered())
+				ImGui::SetTooltip("Keep refreshing the framebuffer.\n"
+				                  "Only the areas that changed are transferred.");
+		}
 
 		ImGui::Separator();
 
@@ -203,16 +238,8 @@ public:
 						continue;
 
 					JSON_Array *bos = json_object_get_array(json_object(client), "bos");
-
-					int bo_count = 0;
-					for (int k = 0; k < json_array_get_count(bos); k++) {
-						JSON_Value *_bo = json_array_get_value(bos, k);
-						if (json_value_get_type(_bo) == JSONNull)
-							continue;
-						JSON_Object *bo = json_object(_bo);
-						bo_count++;
-					}
-					if (bo_count == 0)
+					const std::vector<int> &rows = bo_rows[bos];
+					if (rows.empty())
 						continue;
 
 					ImGui::Unindent();
@@ -224,12 +251,13 @@ public:
 					ImGui::TableSetupColumn("  ");
 					ImGui::TableHeadersRow();
 
-					for (int k = 0; k < json_array_get_count(bos); k++) {
-						JSON_Value *_bo = json_array_get_value(bos, k);
-						if (json_value_get_type(_bo) == JSONNull)
-							continue;
-
-						JSON_Object *bo = json_object(_bo);
+					/* Only the visible rows are drawn. */
+					ImGuiListClipper clipper;
+					clipper.Begin(rows.size());
+					while (clipper.Step())
+					for (int r = clipper.DisplayStart; r < clipper.DisplayEnd; r++) {
+						const int k = rows[r];
+						JSON_Object *bo = json_array_get_object(bos, k);
 						const uint32_t handle = json_object_get_number(bo, "handle");
 
 						ImGui::PushID(k);
@@ -256,6 +284,7 @@ public:
 								glDeleteTextures(1, &texture_id);
 								texture_id = 0;
 							}
+							live = false;
 							send_peak_bo_command(pid, handle, gpu_fd);
 							displayed.bo.bo = bo;
 							displayed.is = -1;
@@ -346,7 +375,10 @@ public:
 					glDeleteTextures(1, &texture_id);
 					texture_id = 0;
 				}
-				send_peak_bo_command2(json_object_get_wrapping_value(md));
+				if (live_md)
+					json_value_free(live_md);
+				live_md = json_value_deep_copy(json_object_get_wrapping_value(md));
+				send_peak_bo_command2(live_md, false);
 				displayed.fb = fb;
 			}
 			ImGui::TableSetColumnIndex(4);
@@ -368,8 +400,13 @@ public:
 														ImGuiWindowFlags_HorizontalScrollbar);
 		if (last_answer_peak_bo && texture_id) {
 			float w, h;
-			int width = json_object_get_number(last_answer_peak_bo, "width");
-			int height = json_object_get_number(last_answer_peak_bo, "height");
+			/* The image may have been downscaled by the server. */
+			int width = json_object_get_number(last_answer_peak_bo, "source_width");
+			int height = json_object_get_number(last_answer_peak_bo, "source_height");
+			if (!width || !height) {
+				width = json_object_get_number(last_answer_peak_bo, "width");
+				height = json_object_get_number(last_answer_peak_bo, "height");
+			}
 			if (zoom_to_fit) {
 				float ratio = height / (float) width;
 				w = ImGui::GetContentRegionAvail().x - ImGui::GetStyle().FramePadding.x;
@@ -383,6 +420,7 @@ public:
 				w = width * zoom;
 				h = height * zoom;
 			}
+			view_width = w;
 
 			ImGui::Image((ImTextureID) (intptr_t) texture_id, ImVec2(w, h),
 										ImVec2(0, 0), ImVec2(1, 1),
@@ -390,35 +428,8 @@ public:
 
 			ImGui::Separator();
 
-			if (displayed.is == 1 && !displayed_bo) {
-				for (int i = 0; i < json_array_get_count(apps) && !displayed_bo; i++) {
-					JSON_Object *app = json_array_get_object(apps, i);
-					JSON_Array *clients = json_object_get_array(app, "clients");
-					const uint32_t pid = json_object_get_number(app, "pid");
-					for (int j = 0; j < json_array_get_count(clients) && !displayed_bo; j++) {
-						JSON_Value *client = json_array_get_value(clients, j);
-						const uint32_t gpu_fd = json_object_get_number(json_object(client), "gpu-fd");
-
-						if (json_value_get_type(client) == JSONNull)
-							continue;
-
-						JSON_Array *bos = json_object_get_array(json_object(client), "bos");
-
-						for (int k = 0; k < json_array_get_count(bos); k++) {
-							JSON_Value *_bo = json_array_get_value(bos, k);
-							if (json_value_get_type(_bo) == JSONNull)
-								continue;
-							JSON_Object *bo = json_object(_bo);
-							const uint32_t handle = json_object_get_number(bo, "handle");
-
-							if (displayed.bo.pid == pid && displayed.bo.gpu_fd == gpu_fd && displayed.bo.handle == handle) {
-								displayed_bo  = bo;
-								break;
-							}
-						}
-					}
-				}
-			}
+			if (displayed.is == 1 && !displayed_bo)
+				displayed_bo = displayed.bo.bo;
 			if (displayed_bo) {
 				display_bo_details(displayed_bo);
 			}
@@ -450,12 +461,59 @@ private:
 		displayed.is = -1;
 	}
 
-	void send_peak_bo_command2(JSON_Value *md) {
+	void send_peak_bo_command2(JSON_Value *md, bool refresh) {
 		JSON_Value *req = json_value_init_object();
 		json_object_set_string(json_object(req), "command", "peak-bo");
 		json_object_set_value(json_object(req), "metadata", json_value_deep_copy(md));
+		/* Let the server downscale the image to what's actually displayed. */
+		if (zoom_to_fit && view_width > 0)
+			json_object_set_number(json_object(req), "max_width", (int)view_width);
+		if (refresh) {
+			/* Keep showing the current frame until the update arrives. */
+			json_object_set_boolean(json_object(req), "delta", !full_frame_needed);
+		} else {
+			displayed.is = -1;
+		}
 		send_request(req);
-		displayed.is = -1;
+	}
+
+	/* List the non-null BOs of each client once per gem-info answer. */
+	void index_bos() {
+		bo_rows.clear();
+		JSON_Array *apps = json_object_get_array(last_answer_gem_info, "apps");
+		for (size_t i = 0; i < json_array_get_count(apps); i++) {
+			JSON_Array *clients = json_object_get_array(json_array_get_object(apps, i), "clients");
+			for (size_t j = 0; j < json_array_get_count(clients); j++) {
+				JSON_Array *bos = json_object_get_array(json_array_get_object(clients, j), "bos");
+				std::vector<int> &rows = bo_rows[bos];
+				for (size_t k = 0; k < json_array_get_count(bos); k++) {
+					if (json_value_get_type(json_array_get_value(bos, k)) != JSONNull)
+						rows.push_back(k);
+				}
+			}
+		}
+	}
+
+	JSON_Object *find_displayed_bo() {
+		JSON_Array *apps = json_object_get_array(last_answer_gem_info, "apps");
+		for (size_t i = 0; i < json_array_get_count(apps); i++) {
+			JSON_Object *app = json_array_get_object(apps, i);
+			if ((uint32_t)json_object_get_number(app, "pid") != displayed.bo.pid)
+				continue;
+			JSON_Array *clients = json_object_get_array(app, "clients");
+			for (size_t j = 0; j < json_array_get_count(clients); j++) {
+				JSON_Object *client = json_array_get_object(clients, j);
+				if (!client || (uint32_t)json_object_get_number(client, "gpu-fd") != displayed.bo.gpu_fd)
+					continue;
+				JSON_Array *bos = json_object_get_array(client, "bos");
+				for (int k : bo_rows[bos]) {
+					JSON_Object *bo = json_array_get_object(bos, k);
+					if ((uint32_t)json_object_get_number(bo, "handle") == displayed.bo.handle)
+						return bo;
+				}
+			}
+		}
+		return NULL;
 	}
 
 	void display_bo_details(JSON_Object *bo) {
@@ -500,6 +558,7 @@ private:
 private:
 	JSON_Object *last_answer_gem_info;
 	JSON_Object *last_answer_peak_bo;
+	std::map<JSON_Array *, std::vector<int>> bo_rows;
 	struct {
 		union {
 			struct {
@@ -512,9 +571,15 @@ private:
 	} displayed;
 
 	GLuint texture_id;
+	int texture_width, texture_height;
 	void *raw_data;
 	unsigned raw_data_size;
 	bool zoom_to_fit;
 	float zoom;
 	char *last_error_peak_bo;
+
+	bool live;
+	JSON_Value *live_md;	/* metadata of the framebuffer being refreshed */
+	float view_width;
+	bool full_frame_needed;
 };
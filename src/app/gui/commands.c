@@ -35,6 +35,10 @@
 #include <errno.h>
 #include <ctype.h>
 #include <assert.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
 
 #include "parson.h"
 
@@ -87,7 +91,7 @@ static char * _read_file(const char *path, char **buffer, unsigned *buffer_size)
 
 static const char *uint64_to_str(uint64_t m)
 {
-	static char tmp[128];
+	static __thread char tmp[128];
 	sprintf(tmp, "%0lx", m);
 	return tmp;
 }
@@ -101,9 +105,10 @@ static uint64_t str_to_uint64(const char *s)
 		return (uint64_t)-1;
 }
 
+/* The buffers are per thread as requests for different asics run at once. */
 static char *read_file(const char *format, ...) {
-	static char *buffer = NULL;
-	static unsigned buffer_size = 0;
+	static __thread char *buffer = NULL;
+	static __thread unsigned buffer_size = 0;
 	char path[PATH_MAX];
 	va_list args;
 	va_start (args, format);
@@ -114,7 +119,7 @@ static char *read_file(const char *format, ...) {
 }
 
 static char *read_file_n(const char *format, unsigned *buffer_size, ...) {
-	static char *buffer = NULL;
+	static __thread char *buffer = NULL;
 	char path[PATH_MAX];
 	va_list args;
 	va_start (args, buffer_size);
@@ -175,74 +180,389 @@ static int get_pid_name(int pid, char process_name[32]);
 static void parse_drm_clients(struct umr_asic *asic, JSON_Array * clients);
 static bool parse_fdinfo_entry(const char *content, const char *dev_id, bool limit_to_drm_engines, JSON_Object *out);
 
-static int find_amdgpu_fd(unsigned pid, const char *pci_name, int *result, int max_fd, int *drm_client_ids) {
-	char folder[PATH_MAX], node[512];
+/*
+ * DRM client tracker.
+ *
+ * accumulate, memory-usage and gem-info need the DRM fds of the GPU
+ * processes along with their drm-client-id.  Finding them means walking
+ * /proc/<pid>/fd and reading the fdinfo of the fds pointing at the device
+ * nodes, so the result is kept per (device, pid) and reused until:
+ *   - the process exits (reported by the proc connector) or, without the
+ *     connector, the start time in /proc/<pid>/stat changes;
+ *   - the clients debugfs file lists a different set of client ids for
+ *     the pid;
+ *   - one of the cached fds no longer points at the device.
+ * Kernels whose clients file has no id column can't tell if the fds of a
+ * process changed, there every lookup rescans the pid.
+ */
+#define DRM_CLIENTS_MAX_AGE_NS	100000000LL
+#define DRM_PROC_IDLE_NS	60000000000LL
+
+struct drm_client_fd {
+	int fd;
+	ino_t ino;
+	int client_id;
+};
+
+struct drm_client_proc {
+	unsigned pid;
+	unsigned long long start_time;
+	uint64_t clients_hash;
+	int64_t used_ns;
+	int nfds;
+	struct drm_client_fd *fds;
+	struct drm_client_proc *next;
+};
+
+struct drm_client_tracker {
+	char pci_name[32];
+	ino_t render_ino, card_ino;
+	bool have_nodes;
+
+	/* (tgid, id) pairs of the clients file, clients_ok if it has ids */
+	unsigned *clients;
+	int nclients;
+	bool clients_ok;
+	int64_t clients_ns;
+
+	struct drm_client_proc *procs;
+	struct drm_client_tracker *next;
+};
+
+static struct drm_client_tracker *drm_trackers;
+static pthread_mutex_t drm_trackers_lock = PTHREAD_MUTEX_INITIALIZER;
+static int proc_connector_fd = -2; /* -2 = not opened yet, -1 = unavailable */
+
+static void drm_client_proc_free(struct drm_client_proc *p)
+{
+	free(p->fds);
+	free(p);
+}
+
+// forget @pid on all devices, or every process if @pid is 0
+static void drm_trackers_forget(unsigned pid)
+{
+	struct drm_client_tracker *t;
+	struct drm_client_proc **pp, *p;
+
+	for (t = drm_trackers; t; t = t->next) {
+		for (pp = &t->procs; (p = *pp);) {
+			if (!pid || p->pid == pid) {
+				*pp = p->next;
+				drm_client_proc_free(p);
+			} else {
+				pp = &p->next;
+			}
+		}
+	}
+}
+
+// subscribe to the process events of the proc connector (needs CAP_NET_ADMIN)
+static int proc_connector_open(void)
+{
+	struct sockaddr_nl addr = { .nl_family = AF_NETLINK, .nl_groups = CN_IDX_PROC };
+	struct __attribute__((packed)) {
+		struct nlmsghdr hdr;
+		struct cn_msg msg;
+		enum proc_cn_mcast_op op;
+	} req;
+	int fd;
+
+	fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+	if (fd < 0)
+		return -1;
+
+	memset(&req, 0, sizeof req);
+	req.hdr.nlmsg_len = sizeof req;
+	req.hdr.nlmsg_type = NLMSG_DONE;
+	req.msg.id.idx = CN_IDX_PROC;
+	req.msg.id.val = CN_VAL_PROC;
+	req.msg.len = sizeof req.op;
+	req.op = PROC_CN_MCAST_LISTEN;
+	if (bind(fd, (struct sockaddr *)&addr, sizeof addr) ||
+	    send(fd, &req, sizeof req, 0) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+// drop the processes that exited since the last call
+static void proc_connector_drain(void)
+{
+	char buf[8192] __attribute__((aligned(NLMSG_ALIGNTO)));
+	struct nlmsghdr *nlh;
+	ssize_t len;
+
+	if (proc_connector_fd == -2)
+		proc_connector_fd = proc_connector_open();
+	if (proc_connector_fd < 0)
+		return;
+
+	for (;;) {
+		len = recv(proc_connector_fd, buf, sizeof buf, 0);
+		if (len < 0 && errno == ENOBUFS) {
+			// events were lost, we can't tell who exited
+			drm_trackers_forget(0);
+			continue;
+		}
+		if (len <= 0)
+			return;
+
+		for (nlh = (struct nlmsghdr *)buf; NLMSG_OK(nlh, (size_t)len); nlh = NLMSG_NEXT(nlh, len)) {
+			struct cn_msg *msg = NLMSG_DATA(nlh);
+			struct proc_event *ev = (struct proc_event *)msg->data;
+
+			if (ev->what == PROC_EVENT_EXIT &&
+			    ev->event_data.exit.process_pid == ev->event_data.exit.process_tgid)
+				drm_trackers_forget(ev->event_data.exit.process_tgid);
+		}
+	}
+}
+
+// field 22 of /proc/<pid>/stat, 0 if the process is gone
+static unsigned long long proc_start_time(unsigned pid)
+{
+	unsigned long long start_time = 0;
+	char *stat = read_file("/proc/%u/stat", pid);
+	char *p;
+	int i;
+
+	if (!stat || !(p = strrchr(stat, ')')))
+		return 0;
+	// the field after the command is 3 (state)
+	for (i = 2; i < 22 && p; i++)
+		p = strchr(p + 1, ' ');
+	if (p)
+		sscanf(p + 1, "%llu", &start_time);
+	return start_time;
+}
+
+// find the columns in the header of the clients file
+static void drm_clients_columns(char *header, int *tgid_col, int *id_col)
+{
+	char *tok, *save;
+	int col;
+
+	*tgid_col = *id_col = -1;
+	for (col = 0, tok = strtok_r(header, " ", &save); tok; tok = strtok_r(NULL, " ", &save), col++) {
+		if (!strcmp(tok, "tgid"))
+			*tgid_col = col;
+		else if (!strcmp(tok, "id"))
+			*id_col = col;
+	}
+}
+
+static void drm_tracker_read_clients(struct drm_client_tracker *t, int instance)
+{
+	char *content = read_file_a(SYSFS_PATH_DEBUG_DRI "%d/clients", instance);
+	char **lines, *tok, *save;
+	unsigned i, n_lines, tgid, id;
+	int col, tgid_col, id_col;
+
+	t->nclients = 0;
+	t->clients_ok = false;
+	t->clients_ns = time_ns();
+	if (!content)
+		return;
+
+	lines = parse_lines(content, &n_lines);
+	if (n_lines)
+		drm_clients_columns(lines[0], &tgid_col, &id_col);
+	if (n_lines && tgid_col >= 0 && id_col >= 0) {
+		t->clients = realloc(t->clients, 2 * n_lines * sizeof(unsigned));
+		for (i = 1; i < n_lines; i++) {
+			tgid = id = 0;
+			for (col = 0, tok = strtok_r(lines[i], " ", &save); tok; tok = strtok_r(NULL, " ", &save), col++) {
+				if (col == tgid_col)
+					tgid = strtoul(tok, NULL, 10);
+				else if (col == id_col)
+					id = strtoul(tok, NULL, 10);
+			}
+			t->clients[2 * t->nclients] = tgid;
+			t->clients[2 * t->nclients + 1] = id;
+			t->nclients++;
+		}
+		t->clients_ok = true;
+	}
+	free(lines);
+	free(content);
+}
+
+// order independent hash of the client ids of @pid in the clients file
+static uint64_t drm_tracker_clients_hash(struct drm_client_tracker *t, unsigned pid)
+{
+	uint64_t hash = 0, x;
+	int i;
+
+	for (i = 0; i < t->nclients; i++) {
+		if (t->clients[2 * i] != pid)
+			continue;
+		x = t->clients[2 * i + 1] + 0x9e3779b97f4a7c15ULL;
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+		hash += x ^ (x >> 31);
+	}
+	return hash;
+}
+
+static bool drm_client_proc_fds_valid(struct drm_client_proc *p)
+{
+	char path[64];
 	struct stat statbuf;
-	__ino_t render_ino, card_ino;
 	int i;
-	sprintf(folder, "/proc/%d/fd", pid);
 
-	int num_fds = 0;
+	for (i = 0; i < p->nfds; i++) {
+		sprintf(path, "/proc/%u/fd/%d", p->pid, p->fds[i].fd);
+		if (stat(path, &statbuf) || statbuf.st_ino != p->fds[i].ino)
+			return false;
+	}
+	return true;
+}
+
+// walk /proc/<pid>/fd for the fds of the device, one per drm-client-id
+static void drm_client_proc_scan(struct drm_client_tracker *t, struct drm_client_proc *p)
+{
+	char folder[64];
+	struct stat statbuf;
+	struct dirent *entry;
+	int dfd, i, cap = 0;
+	DIR *d;
 
-	int dirfd = open(folder, O_DIRECTORY);
-	if (dirfd < 0)
-		return 0;
+	p->nfds = 0;
+	sprintf(folder, "/proc/%u/fd", p->pid);
+	d = opendir(folder);
+	if (!d)
+		return;
+	dfd = dirfd(d);
 
-	/* Find the ino of the render/card nodes. */
-	sprintf(node, "/dev/dri/by-path/pci-%s-render", pci_name);
-	if (stat(node, &statbuf) < 0)
-		return 0;
-	render_ino = statbuf.st_ino;
-	sprintf(node, "/dev/dri/by-path/pci-%s-card", pci_name);
-	if (stat(node, &statbuf) < 0)
-		return 0;
-	card_ino = statbuf.st_ino;
+	while ((entry = readdir(d))) {
+		const char *v;
+		int client_id = 0;
 
-	DIR *d = opendir(folder);
-	if (d) {
-		struct dirent *entry;
-		drm_client_ids = drm_client_ids ? drm_client_ids : malloc(max_fd * sizeof(int));
-		while ((entry = readdir(d))) {
-			int r = fstatat(dirfd, entry->d_name, &statbuf, 0);
+		if (fstatat(dfd, entry->d_name, &statbuf, 0))
+			continue;
+		if (statbuf.st_ino != t->card_ino && statbuf.st_ino != t->render_ino)
+			continue;
 
-			if (r)
-				continue;
+		v = read_file("/proc/%u/fdinfo/%s", p->pid, entry->d_name);
+		if (v && (v = strstr(v, "drm-client-id:")))
+			client_id = strtol(v + strlen("drm-client-id:"), NULL, 10);
 
-			/* Find if this fd points to the GPU nodes. */
-			if (statbuf.st_ino == card_ino || statbuf.st_ino == render_ino) {
-				JSON_Object *fdinfo = json_object(json_value_init_object());
-				/* Filter out fd pointing out to the same drm-client-id. */
-				char *fdinfoc = read_file_a("/proc/%d/fdinfo/%s", pid, entry->d_name);
+		/* Filter out fd pointing out to the same drm-client-id. */
+		for (i = 0; i < p->nfds && p->fds[i].client_id != client_id; i++);
+		if (i < p->nfds)
+			continue;
 
-				if (!parse_fdinfo_entry(fdinfoc, pci_name, true, fdinfo)) {
-					free(fdinfoc);
-					json_value_free(json_object_get_wrapping_value(fdinfo));
-					continue;
-				}
+		if (p->nfds == cap) {
+			cap = cap ? 2 * cap : 4;
+			p->fds = realloc(p->fds, cap * sizeof(*p->fds));
+		}
+		p->fds[p->nfds].fd = atoi(entry->d_name);
+		p->fds[p->nfds].ino = statbuf.st_ino;
+		p->fds[p->nfds].client_id = client_id;
+		p->nfds++;
+	}
+	closedir(d);
+}
 
-				int drm_client_id = json_object_get_number(fdinfo, "drm-client-id");
-				free(fdinfoc);
-				json_value_free(json_object_get_wrapping_value(fdinfo));
+static struct drm_client_tracker *drm_tracker_get(struct umr_asic *asic)
+{
+	struct drm_client_tracker *t;
+	struct stat statbuf;
+	char node[PATH_MAX];
+
+	for (t = drm_trackers; t && strcmp(t->pci_name, asic->options.pci.name); t = t->next);
+	if (!t) {
+		t = calloc(1, sizeof *t);
+		strcpy(t->pci_name, asic->options.pci.name);
+		t->next = drm_trackers;
+		drm_trackers = t;
+	}
 
-				for (i = 0; i < num_fds; i++) {
-					if (drm_client_ids[i] == drm_client_id) {
-						break;
-					}
-				}
+	/* Find the ino of the render/card nodes. */
+	if (!t->have_nodes) {
+		sprintf(node, "/dev/dri/by-path/pci-%s-render", t->pci_name);
+		if (stat(node, &statbuf) < 0)
+			return NULL;
+		t->render_ino = statbuf.st_ino;
+		sprintf(node, "/dev/dri/by-path/pci-%s-card", t->pci_name);
+		if (stat(node, &statbuf) < 0)
+			return NULL;
+		t->card_ino = statbuf.st_ino;
+		t->have_nodes = true;
+	}
+	return t;
+}
 
-				if (i == num_fds) {
-					drm_client_ids[num_fds] = drm_client_id;
-					result[num_fds++] = atoi(entry->d_name);
-				}
+/**
+ * find_amdgpu_fd - Find the DRM fds a process has open on a device
+ * @asic: The device
+ * @pid: The process
+ * @result: Receives up to @max_fd fds, one per drm-client-id
+ * @max_fd: Size of @result and @drm_client_ids
+ * @drm_client_ids: Receives the client id of each fd (can be NULL)
+ *
+ * Returns the number of fds found.
+ */
+static int find_amdgpu_fd(struct umr_asic *asic, unsigned pid, int *result, int max_fd, int *drm_client_ids)
+{
+	struct drm_client_tracker *t;
+	struct drm_client_proc **pp, *p, *found = NULL;
+	unsigned long long start_time = 0;
+	uint64_t hash = 0;
+	int64_t now = time_ns();
+	int n = 0;
 
-				if (num_fds == max_fd)
-					break;
-			}
+	pthread_mutex_lock(&drm_trackers_lock);
+	proc_connector_drain();
+	t = drm_tracker_get(asic);
+	if (!t)
+		goto out;
+	if (now - t->clients_ns > DRM_CLIENTS_MAX_AGE_NS)
+		drm_tracker_read_clients(t, asic->instance);
+
+	// look for @pid and drop the processes nobody asked about in a while
+	for (pp = &t->procs; (p = *pp);) {
+		if (p->pid == pid) {
+			found = p;
+		} else if (now - p->used_ns > DRM_PROC_IDLE_NS) {
+			*pp = p->next;
+			drm_client_proc_free(p);
+			continue;
+		}
+		pp = &p->next;
+	}
+	p = found;
+
+	if (proc_connector_fd < 0)
+		start_time = proc_start_time(pid);
+	if (t->clients_ok)
+		hash = drm_tracker_clients_hash(t, pid);
+
+	if (!p || !t->clients_ok || p->clients_hash != hash ||
+	    (proc_connector_fd < 0 && p->start_time != start_time) ||
+	    !drm_client_proc_fds_valid(p)) {
+		if (!p) {
+			p = calloc(1, sizeof *p);
+			p->pid = pid;
+			p->next = t->procs;
+			t->procs = p;
 		}
-		closedir(d);
+		p->start_time = start_time;
+		p->clients_hash = hash;
+		drm_client_proc_scan(t, p);
 	}
-	close(dirfd);
-	return num_fds;
+	p->used_ns = now;
+
+	for (n = 0; n < p->nfds && n < max_fd; n++) {
+		result[n] = p->fds[n].fd;
+		if (drm_client_ids)
+			drm_client_ids[n] = p->fds[n].client_id;
+	}
+out:
+	pthread_mutex_unlock(&drm_trackers_lock);
+	return n;
 }
 
 #if CAN_IMPORT_BO
@@ -264,6 +584,37 @@ static uint64_t read_sysfs_uint64(const char *path, ...) {
 	return 0;
 }
 
+/* The files polled by the power panels stay open, see umr_sysfs_read(). */
+static char *read_asic_file(struct umr_asic *asic, const char *format, ...) {
+	static __thread char buffer[4096];
+	char path[PATH_MAX];
+	va_list args;
+	va_start (args, format);
+	int r = vsnprintf(path, sizeof path, format, args);
+	va_end (args);
+	if (r < 0 || r >= (int)sizeof path) {
+		buffer[0] = '\0';
+		return buffer;
+	}
+	umr_sysfs_read(asic, path, buffer, sizeof buffer);
+	return buffer;
+}
+
+static uint64_t read_asic_uint64(struct umr_asic *asic, const char *format, ...) {
+	char path[PATH_MAX];
+	va_list args;
+	va_start (args, format);
+	int r = vsnprintf(path, sizeof path, format, args);
+	va_end (args);
+	if (r < 0 || r >= (int)sizeof path)
+		return 0;
+
+	uint64_t v;
+	if (sscanf(read_asic_file(asic, "%s", path), "%lu", &v) == 1)
+		return v;
+	return 0;
+}
+
 void parse_sysfs_clock_file(char *content, int *min, int *max) {
 	*min = 100000;
 	*max = 0;
@@ -281,7 +632,7 @@ void parse_sysfs_clock_file(char *content, int *min, int *max) {
 }
 
 static const char * lookup_field(const char **in, const char *field, char separator) {
-	static char value[2048];
+	static __thread char value[2048];
 	const char *input = *in;
 	input = strstr(input, field);
 	if (!input)
@@ -568,59 +919,54 @@ JSON_Object *parse_kms_state_sysfs_file(const char *content) {
 
 JSON_Array *get_rings_last_signaled_fences(const char *fence_info, const char *ring_filter) {
 	JSON_Array *fences = json_array(json_value_init_array());
-	int cursor = 0;
-	while (1) {
-		char *next_ring = strstr(&fence_info[cursor], "--- ring");
-		if (!next_ring)
-			break;
-		char *next_ring_start = strchr(next_ring, '(');
-		if (!next_ring_start)
-			break;
-		next_ring_start++;
-		char *next_ring_end = strchr(next_ring_start, ')');
-		int len = next_ring_end - next_ring_start;
-		char ring_name[128];
-		strncpy(ring_name, next_ring_start, len);
-		ring_name[len] = '\0';
-
-		char *next_line = strstr(next_ring_end + 1, "0x");
-		if (!next_line)
-			break;
+	struct umr_fence_snapshot snap;
 
-		int c = next_line - fence_info;
-		unsigned long last_signaled;
-		if (sscanf(&fence_info[c], "0x%08lx", &last_signaled) == 1) {
-			if (!ring_filter || strcmp(ring_filter, ring_name) == 0) {
-				JSON_Value *fence = json_value_init_object();
-				json_object_set_string(json_object(fence), "name", ring_name);
-				json_object_set_number(json_object(fence), "value", last_signaled);
-				json_array_append_value(fences, fence);
-			}
-		}
-		cursor = c + strlen("0x00000000") + 1;
+	memset(&snap, 0, sizeof snap);
+	if (fence_info)
+		umr_fence_info_parse(fence_info, &snap);
+	for (int i = 0; i < snap.no_rings; i++) {
+		if (ring_filter && strcmp(ring_filter, snap.rings[i].name))
+			continue;
+		JSON_Value *fence = json_value_init_object();
+		json_object_set_string(json_object(fence), "name", snap.rings[i].name);
+		json_object_set_number(json_object(fence), "value", snap.rings[i].signaled);
+		json_array_append_value(fences, fence);
 	}
+	umr_fence_snapshot_free(&snap);
 	return fences;
 }
 
-JSON_Value *compare_fence_infos(const char *fence_info_before, const char *fence_info_after) {
+/* The fences signaled by every ring between two snapshots. */
+static JSON_Value *fence_deltas(const struct umr_fence_snapshot *before, const struct umr_fence_snapshot *after) {
 	JSON_Value *fences = json_value_init_array();
-	JSON_Array *before = get_rings_last_signaled_fences(fence_info_before, NULL);
-	JSON_Array *after = get_rings_last_signaled_fences(fence_info_after, NULL);
-	for (size_t i = 0; i < json_array_get_count(before); i++) {
+	struct umr_ring_fence_delta *deltas = calloc(after->no_rings + 1, sizeof *deltas);
+
+	if (!deltas)
+		return fences;
+	int n = umr_fence_snapshot_delta(before, after, deltas);
+	for (int i = 0; i < n; i++) {
 		JSON_Value *fence = json_value_init_object();
-		JSON_Object *b = json_object(json_array_get_value(before, i));
-		JSON_Object *a = json_object(json_array_get_value(after, i));
-
-		const char *ring_name = json_object_get_string(b, "name");
-		uint32_t v1 = (uint32_t)json_object_get_number(b, "value");
-		uint32_t v2 = (uint32_t)json_object_get_number(a, "value");
-		json_object_set_string(json_object(fence), "name", ring_name);
-		json_object_set_number(json_object(fence), "delta", v2 - v1);
+		json_object_set_string(json_object(fence), "name", deltas[i].name);
+		json_object_set_number(json_object(fence), "delta", deltas[i].signaled);
 		json_array_append_value(json_array(fences), fence);
 	}
-	json_value_free(json_array_get_wrapping_value(before));
-	json_value_free(json_array_get_wrapping_value(after));
+	free(deltas);
+	return fences;
+}
 
+JSON_Value *compare_fence_infos(const char *fence_info_before, const char *fence_info_after) {
+	struct umr_fence_snapshot before, after;
+	JSON_Value *fences;
+
+	memset(&before, 0, sizeof before);
+	memset(&after, 0, sizeof after);
+	if (fence_info_before)
+		umr_fence_info_parse(fence_info_before, &before);
+	if (fence_info_after)
+		umr_fence_info_parse(fence_info_after, &after);
+	fences = fence_deltas(&before, &after);
+	umr_fence_snapshot_free(&before);
+	umr_fence_snapshot_free(&after);
 	return fences;
 }
 
@@ -694,43 +1040,33 @@ static bool parse_fdinfo_entry(const char *content, const char *dev_id, bool lim
 	return true;
 }
 
-static void read_fdinfo(JSON_Value *container, JSON_Object *pid, const char *dev_id) {
+static void read_fdinfo(struct umr_asic *asic, JSON_Value *container, JSON_Object *pid, const char *dev_id) {
 	/* Read fdinfo for each client. */
-	char fd_info_path[1024], fd_info[4096], lbl[64];
-	DIR *dir;
-	struct dirent *entry;
+	int gpu_fds[64], n, i;
+	char lbl[64];
 	int app_pid = (int)json_object_get_number(pid, "pid");
 
-	/* Parse the /proc/$fd tree, and find amdgpu's fd. */
-	sprintf(fd_info_path, "/proc/%d/fdinfo", app_pid);
-
-	dir = opendir(fd_info_path);
-	if (!dir)
-		return;
-
-	/* Process all fds. */
-	while ((entry = readdir(dir))) {
-		sprintf(fd_info, "%s/%s", fd_info_path, entry->d_name);
+	/* Only the fds on this device, see find_amdgpu_fd(). */
+	n = find_amdgpu_fd(asic, app_pid, gpu_fds, ARRAY_SIZE(gpu_fds), NULL);
 
+	for (i = 0; i < n; i++) {
 		JSON_Value *fdinfo = json_value_init_object();
-		int64_t n = time_ns();
+		int64_t ts = time_ns();
+		char *content = read_file("/proc/%d/fdinfo/%d", app_pid, gpu_fds[i]);
 
-		unsigned long gpu_fd = strtol(entry->d_name, NULL, 10);
-		if (!parse_fdinfo_entry(read_file(fd_info), dev_id, true, json_object(fdinfo))) {
+		if (!content || !parse_fdinfo_entry(content, dev_id, true, json_object(fdinfo))) {
 			json_value_free(fdinfo);
 			continue;
 		}
 
 		sprintf(lbl, "%ld", (long)json_object_get_number(json_object(fdinfo), "drm-client-id"));
-		json_object_set_number(json_object(fdinfo), "ts", n);
+		json_object_set_number(json_object(fdinfo), "ts", ts);
 		json_object_set_string(json_object(fdinfo), "command", json_object_get_string(pid, "app"));
 		json_object_set_number(json_object(fdinfo), "pid", app_pid);
 		json_object_set_number(json_object(fdinfo), "tgid", get_tgid_for_tid(app_pid));
-		json_object_set_number(json_object(fdinfo), "gpu-fd", gpu_fd);
+		json_object_set_number(json_object(fdinfo), "gpu-fd", gpu_fds[i]);
 		json_object_set_value(json_object(container), lbl, fdinfo);
 	}
-	
-	closedir(dir);
 }
 
 static void parse_drm_clients(struct umr_asic *asic, JSON_Array * clients)
@@ -834,143 +1170,7 @@ JSON_Array *get_active_amdgpu_clients(struct umr_asic *asic)
 	return pids;
 }
 
-JSON_Array *parse_buffer_object_info(char *content, bool is_vm_info)
-{
-	JSON_Array *apps = json_array(json_value_init_array());
-
-	unsigned nlines = 0;
-	char **lines = parse_lines(content, &nlines);
-
-	for (unsigned i = 0; i < nlines;) {
-		if (strncmp(lines[i], "pid", 3) != 0) {
-			printf("Incorrect line start %d '%s'. Aborting\n", i, lines[i]);
-			return NULL;
-		}
-		const char *cursor = lines[i] + 3;
-
-		if (is_vm_info) {
-			if (*cursor != ':')
-				return NULL;
-			cursor++;
-		}
-		while (isspace(*cursor)) cursor++;
-
-		unsigned pid;
-		sscanf(cursor, "%u", &pid);
-
-		/* vm_info uses the tid, not the pid. */
-		if (is_vm_info)
-			pid = get_tgid_for_tid(pid);
-
-		/* Do we already know about this pid? */
-		JSON_Object *p = NULL;
-		for (size_t j = 0; j < json_array_get_count(apps); j++) {
-			JSON_Object *q = json_object(json_array_get_value(apps, i));
-			if (json_object_get_number(q, "pid") == pid) {
-				p = q;
-				break;
-			}
-		}
-
-		if (p == NULL) {
-			p = json_object(json_value_init_object());
-			json_object_set_number(p, "pid", pid);
-
-			/* Set the main process command based on the real comm, and fallback
-			 * on the value we parsed if it fails.
-			 */
-			char *cmd = read_file("/proc/%d/comm", pid);
-			if (cmd && strlen(cmd)) {
-				json_object_set_string_with_len(p, "command", cmd, strlen(cmd) - 1);
-			} else {
-				const char *cmd_prefix = is_vm_info ? "Process:" : "command ";
-				const char *cmd_end = is_vm_info ? " ----------" : ":";
-				cursor = strstr(cursor, cmd_prefix);
-				if (cursor == NULL)
-					return NULL;
-				cursor += strlen(cmd_prefix);
-				char *end = strstr(cursor, cmd_end);
-				json_object_set_string_with_len(p, "command", cursor, end - cursor);
-			}
-			json_object_set_value(p, "clients", json_value_init_array());
-		}
-
-		JSON_Object *client = json_object(json_value_init_object());
-		JSON_Array *bos = json_array(json_value_init_array());
-		json_object_set_value(client, "bos", json_array_get_wrapping_value(bos));
-
-		/* Now parse lines belonging to this pid */
-		for (i = i + 1; i < nlines; i++) {
-			/* Break if we're starting a new one. */
-			if (strncmp(lines[i], "pid", 3) == 0)
-				break;
-
-			cursor = lines[i];
-
-			unsigned kms_handle;
-			long unsigned size;
-			if (sscanf(cursor, "0x%x", &kms_handle) != 1)
-				continue;
-
-			cursor += strlen("0x00000000:");
-			while (isspace(*cursor)) cursor++;
-
-			sscanf(cursor, "%" PRIu64, &size);
-
-			JSON_Object *bo = json_object(json_value_init_object());
-			json_object_set_number(bo, "handle", kms_handle);
-			json_object_set_number(bo, "size", size);
-			json_array_append_value(bos, json_object_get_wrapping_value(bo));
-
-			/* Parse attributes. */
-			const char *attributes[] = {
-				" pin count %lu", " GTT", " CPU_ACCESS_REQUIRED", " VRAM_CLEARED",
-				" VRAM", " CPU_GTT_USWC", " exported as ino:%lu", " VRAM VISIBLE",
-				" NONE", " DOORBELL", " CPU", " UNKNOWN", " imported from ino:%lu",
-				" EXPLICIT_SYNC", " VM_ALWAYS_VALID", " VRAM_CONTIGUOUS",
-				" NO_CPU_ACCESS"
-			};
-			const size_t len = strlen(lines[i]);
-			JSON_Object *attr = json_object(json_value_init_object());
-			for (size_t j = 0; j < ARRAY_SIZE(attributes); j++) {
-				const int attr_len = strlen(attributes[j]);
-				char *pct = strchr(attributes[j], '%');
-
-				char *found = memmem(lines[i], len, attributes[j],
-									 pct ? (pct - attributes[j]) : attr_len);
-
-				if (found) {
-					if (pct) {
-						unsigned long v;
-						if (sscanf(found, attributes[j], &v) == 1) {
-							char attr_name[64] = {0};
-							strncpy(attr_name, attributes[j] + 1, pct - attributes[j] - 2);
-							json_object_set_number(attr, attr_name, v);
-						}
-					} else {
-						/* Make sure we match the whole word. */
-						char *end = found + attr_len;
-						if (*end == '\0' || *end == ' ')
-							json_object_set_number(attr, attributes[j] + 1, 1);
-					}
-				}
-			}
-			json_object_set_value(bo, "attributes", json_object_get_wrapping_value(attr));
-			if (json_object_has_value(attr, "exported as ino"))
-				json_object_set_number(bo, "ino", json_object_get_number(attr, "exported as ino"));
-		}
-
-		if (json_array_get_count(bos)) {
-			json_array_append_value(apps, json_object_get_wrapping_value(p));
-			json_array_append_value(json_array(json_object_get_value(p, "clients")),
-									json_object_get_wrapping_value(client));
-		}
-	}
-
-	free(lines);
-
-	return apps;
-}
+#include "commands_gem.c"
 
 /* A single pid can have multiple drm_client_id. This functions identifies the gpu's fd of
  * each client.
@@ -985,7 +1185,7 @@ static bool assign_gpu_fd_to_clients(struct umr_asic *asic, int pid, JSON_Array
 		return false;
 
 	/* Get all the open fd (drm client) for this pid. */
-	gpu_fds_count = find_amdgpu_fd(pid, asic->options.pci.name,
+	gpu_fds_count = find_amdgpu_fd(asic, pid,
 								   gpu_fds, ARRAY_SIZE(gpu_fds), client_ids);
 	if (gpu_fds_count == 0) {
 		close(pid_fd);
@@ -1013,41 +1213,43 @@ static bool assign_gpu_fd_to_clients(struct umr_asic *asic, int pid, JSON_Array
 #endif
 }
 
+static int compare_int64_pairs(const void *a, const void *b)
+{
+	const int64_t *x = a, *y = b;
+	if (x[0] != y[0])
+		return x[0] < y[0] ? -1 : 1;
+	return x[1] < y[1] ? -1 : x[1] > y[1];
+}
+
 static void postprocess_gem_info(struct umr_asic *asic, JSON_Array *apps, JSON_Array *apps_from_vm)
 {
-	size_t i, j, k;
+	size_t i, k;
 
-	size_t max_drm_client_id_to_vm_apps = 8;
+	/* drm-client-id -> index in apps_from_vm pairs, sorted to look them up. */
+	size_t n_drm_client_id_to_vm_apps = 0, max_drm_client_id_to_vm_apps = 8;
 	int64_t *drm_client_id_to_vm_apps =
 		malloc(sizeof(int64_t) * 2 * max_drm_client_id_to_vm_apps);
-	size_t n_drm_client_id_to_vm_apps = 0;
 	for (i = 0; i < json_array_get_count(apps_from_vm); i++) {
 		JSON_Object *vm_app = json_array_get_object(apps_from_vm, i);
 
 		int gpu_fds[1024], drm_clients_id[1024];
 		uint32_t pid = json_object_get_number(vm_app, "pid");
-		int gpu_fds_count = find_amdgpu_fd(pid, asic->options.pci.name,
+		int gpu_fds_count = find_amdgpu_fd(asic, pid,
 										   gpu_fds, ARRAY_SIZE(gpu_fds),
 										   drm_clients_id);
 		for (int j = 0; j < gpu_fds_count; j++) {
-			bool found = false;
-			for (k = 0; k < n_drm_client_id_to_vm_apps && !found; k++) {
-				if (drm_client_id_to_vm_apps[2 * k] == drm_clients_id[j])
-					found = true;
-			}
-			if (!found) {
-				drm_client_id_to_vm_apps[2 * n_drm_client_id_to_vm_apps] = drm_clients_id[j];
-				drm_client_id_to_vm_apps[2 * n_drm_client_id_to_vm_apps + 1] = i;
-				n_drm_client_id_to_vm_apps++;
-
-				if (n_drm_client_id_to_vm_apps == max_drm_client_id_to_vm_apps) {
-					max_drm_client_id_to_vm_apps *= 2;
-					drm_client_id_to_vm_apps = realloc(drm_client_id_to_vm_apps,
-													   sizeof(int64_t) * 2 * max_drm_client_id_to_vm_apps);
-				}
+			if (n_drm_client_id_to_vm_apps == max_drm_client_id_to_vm_apps) {
+				max_drm_client_id_to_vm_apps *= 2;
+				drm_client_id_to_vm_apps = realloc(drm_client_id_to_vm_apps,
+												   sizeof(int64_t) * 2 * max_drm_client_id_to_vm_apps);
 			}
+			drm_client_id_to_vm_apps[2 * n_drm_client_id_to_vm_apps] = drm_clients_id[j];
+			drm_client_id_to_vm_apps[2 * n_drm_client_id_to_vm_apps + 1] = i;
+			n_drm_client_id_to_vm_apps++;
 		}
 	}
+	/* The first vm app using an id wins. */
+	qsort(drm_client_id_to_vm_apps, n_drm_client_id_to_vm_apps, 2 * sizeof(int64_t), compare_int64_pairs);
 
 	/* The goal here is to find the real app pid and the gpu fd owning the buffers.
 	 * amdgpu_gem_info and amdgpu_vm_info both have deficiencies:
@@ -1076,17 +1278,24 @@ static void postprocess_gem_info(struct umr_asic *asic, JSON_Array *apps, JSON_A
 			/* So far so good. Now check if vm_info gave us a better hint of who's the actual user
 			 * of the drm-client-id for this fd.
 			 */
-			int64_t drm_client_id = json_object_get_number(client, "drm-client-id");
-			for (j = 0; drm_client_id && j < n_drm_client_id_to_vm_apps; j++) {
-				if (drm_client_id_to_vm_apps[2 * j] == drm_client_id) {
-					JSON_Object *vm_app = json_array_get_object(apps_from_vm, drm_client_id_to_vm_apps[2 * j + 1]);
-					int p = json_object_get_number(vm_app, "pid");
-					if (p != pid) {
-						json_object_set_number(app, "pid", json_object_get_number(vm_app, "pid"));
-						json_object_set_string(app, "command", json_object_get_string(vm_app, "command"));
-						assign_gpu_fd_to_clients(asic, p, clients);
-					}
-					break;
+			int64_t key[2] = { (int64_t)json_object_get_number(client, "drm-client-id"), -1 };
+			if (!key[0])
+				continue;
+			size_t lo = 0, hi = n_drm_client_id_to_vm_apps;
+			while (lo < hi) {
+				size_t mid = (lo + hi) / 2;
+				if (compare_int64_pairs(&drm_client_id_to_vm_apps[2 * mid], key) < 0)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			if (lo < n_drm_client_id_to_vm_apps && drm_client_id_to_vm_apps[2 * lo] == key[0]) {
+				JSON_Object *vm_app = json_array_get_object(apps_from_vm, drm_client_id_to_vm_apps[2 * lo + 1]);
+				int p = json_object_get_number(vm_app, "pid");
+				if (p != pid) {
+					json_object_set_number(app, "pid", json_object_get_number(vm_app, "pid"));
+					json_object_set_string(app, "command", json_object_get_string(vm_app, "command"));
+					assign_gpu_fd_to_clients(asic, p, clients);
 				}
 			}
 		}
@@ -1107,12 +1316,21 @@ JSON_Array *get_bo_infos(struct umr_asic *asic) {
 		return NULL;
 	}
 
-	JSON_Array *apps_gem_info = parse_buffer_object_info(data_gem_info, false);
-	JSON_Array *apps_vm_info = parse_buffer_object_info(data_vm_info, true);
+	struct gem_info gem_info = { 0 }, vm_info = { 0 };
+	JSON_Array *apps_gem_info = NULL;
+
+	if (gem_info_parse(&gem_info, data_gem_info, false) == 0 &&
+		gem_info_parse(&vm_info, data_vm_info, true) == 0) {
+		/* Only the pids and commands of vm_info are used. */
+		JSON_Array *apps_vm_info = gem_info_to_json(&vm_info, false);
 
-	postprocess_gem_info(asic, apps_gem_info, apps_vm_info);
+		apps_gem_info = gem_info_to_json(&gem_info, true);
+		postprocess_gem_info(asic, apps_gem_info, apps_vm_info);
+		json_value_free(json_array_get_wrapping_value(apps_vm_info));
+	}
 
-	json_value_free(json_array_get_wrapping_value(apps_vm_info));
+	gem_info_free(&gem_info);
+	gem_info_free(&vm_info);
 	free(data_gem_info);
 	free(data_vm_info);
 
@@ -1277,7 +1495,8 @@ JSON_Object *parse_pp_features_sysfs_file(const char *content)
 	return out;
 }
 
-struct {
+/* Filled by my_va_decode() for the request being processed by this thread. */
+static __thread struct {
 	uint64_t pba;
 	uint64_t va_mask;
 
@@ -1286,7 +1505,7 @@ struct {
 	int system, tmz, mtype;
 	int pte;
 } page_table[64];
-int num_page_table_entries;
+static __thread int num_page_table_entries;
 
 static void my_va_decode(pde_fields_t *pdes, int num_pde, pte_fields_t pte) {
 	for (int i = 0; i < num_pde; i++) {
@@ -1306,6 +1525,9 @@ static void my_va_decode(pde_fields_t *pdes, int num_pde, pte_fields_t pte) {
 	}
 }
 
+/* Page size of the batched "vm-read" requests. */
+#define VM_READ_PAGE_SIZE 4096
+
 static int dummy_printf(const char *fmt, ...) {
 	(void)fmt;
 	return 0;
@@ -1329,20 +1551,26 @@ static JSON_Value *shader_pgm_to_json(struct umr_asic *asic, uint32_t vmid, uint
 	return json_object_get_wrapping_value(res);
 }
 
-static JSON_Value *vcn_pgm_to_json(struct umr_asic *asic, uint32_t type, uint32_t vmid, uint64_t addr, uint32_t size) {
+static JSON_Value *vcn_pgm_to_json(struct umr_asic *asic, uint32_t type, uint32_t vmid, uint64_t addr, uint32_t size, const uint32_t *buf) {
 	JSON_Object *res = NULL;
-	uint32_t *opcodes = calloc(size / 4, sizeof(uint32_t));
+	uint32_t *opcodes = NULL;
 	res = json_object(json_value_init_object());
 	json_object_set_number(res, "address", addr);
 	json_object_set_number(res, "vmid", vmid);
 	json_object_set_number(res, "type", type);
-	if (umr_read_vram(asic, asic->options.vm_partition, vmid, addr, size, (void*)opcodes) == 0) {
+	/* use the copy the decoder read the message into if there is one */
+	if (!buf) {
+		opcodes = calloc(size / 4, sizeof(uint32_t));
+		if (umr_read_vram(asic, asic->options.vm_partition, vmid, addr, size, (void*)opcodes) == 0)
+			buf = opcodes;
+		else
+			printf("Reading vram failed (%d@%" PRIx64" size: %d)\n", vmid, addr, size);
+	}
+	if (buf) {
 		JSON_Array *op = json_array(json_value_init_array());
 		for (unsigned i = 0; i < size / 4; i++)
-			json_array_append_number(op, opcodes[i]);
+			json_array_append_number(op, buf[i]);
 		json_object_set_value(res, "opcodes", json_array_get_wrapping_value(op));
-	} else {
-		printf("Reading vram failed (%d@%" PRIx64" size: %d)\n", vmid, addr, size);
 	}
 	free(opcodes);
 	return json_object_get_wrapping_value(res);
@@ -1464,13 +1692,18 @@ static void ring_add_shader(struct umr_stream_decode_ui *ui, struct umr_asic *as
 
 static void ring_add_vcn(struct umr_stream_decode_ui *ui, struct umr_asic *asic, struct umr_vcn_cmd_message *vcn) {
 	struct ring_decoding_data *data = (struct ring_decoding_data*) ui->data;
-
-	JSON_Value *sh = vcn_pgm_to_json(asic, vcn->type, vcn->vmid, vcn->addr, vcn->size);
-	if (sh)
-		json_array_append_value(data->vcns, sh);
-
-	if (vcn->next)
-		ring_add_vcn(ui, asic, vcn->next);
+	struct umr_vcn_cmd_message *p;
+
+	/* the messages (and the buffers read with them) belong to the UI */
+	while (vcn) {
+		JSON_Value *sh = vcn_pgm_to_json(asic, vcn->type, vcn->vmid, vcn->addr, vcn->size, vcn->buf);
+		if (sh)
+			json_array_append_value(data->vcns, sh);
+		p = vcn;
+		vcn = vcn->next;
+		free(p->buf);
+		free(p);
+	}
 }
 
 static void ring_add_data(struct umr_stream_decode_ui *ui, struct umr_asic *asic, uint64_t ib_addr, uint32_t ib_vmid, uint64_t buf_addr, uint32_t buf_vmid, enum UMR_DATABLOCK_ENUM type, uint64_t etype) {
@@ -1522,6 +1755,8 @@ void init_asics(void) {
 
 		/* Assign linux callbacks */
 		asics[i]->ring_func.read_ring_data = umr_read_ring_data;
+		asics[i]->ring_func.read_ring_header = umr_read_ring_header;
+		asics[i]->ring_func.read_ring_window = umr_read_ring_window;
 
 		asics[i]->mem_funcs.vm_message = dummy_printf;
 		asics[i]->mem_funcs.gpu_bus_to_cpu_address = umr_vm_dma_to_phys;
@@ -1531,14 +1766,21 @@ void init_asics(void) {
 
 		if (asics[i]->options.use_pci == 0)
 			asics[i]->mem_funcs.access_linear_vram = umr_access_linear_vram;
-		else
+		else {
 			asics[i]->mem_funcs.access_linear_vram = umr_access_vram_via_mmio;
+			asics[i]->mem_funcs.no_readahead = 1;
+		}
+		if (asics[i]->options.use_vram_bar)
+			asics[i]->mem_funcs.access_linear_vram = umr_access_linear_vram_via_bar;
 
 		asics[i]->reg_funcs.read_reg = umr_read_reg;
 		asics[i]->reg_funcs.write_reg = umr_write_reg;
+		asics[i]->reg_funcs.read_reg64 = umr_read_reg64;
+		asics[i]->reg_funcs.write_reg64 = umr_write_reg64;
 
 		asics[i]->wave_funcs.get_wave_sq_info = umr_get_wave_sq_info;
 		asics[i]->wave_funcs.get_wave_status = umr_get_wave_status;
+		asics[i]->wave_funcs.get_wave_status_bulk = umr_get_wave_status_bulk;
 
 		/* Default shader options */
 		if (asics[i]->family <= FAMILY_VI) {
@@ -1560,6 +1802,11 @@ void init_asics(void) {
 			asics[i]->options.shader_enable.enable_es_ls_swap = 1;
 
 		umr_scan_config(asics[i], 1);
+		/* The power panels poll their files every 100ms or so. */
+		if (!opt.test_log_fd)
+			umr_sysfs_cache_refresh_start(asics[i], 100000000ULL);
+		/* Requests come in bursts, keep GFXOFF off in between. */
+		umr_gfxoff_set_linger(asics[i], 500000000ULL);
 		if (asics[i]->fd.drm < 0) {
 			char devname[PATH_MAX];
 			sprintf(devname, "/dev/dri/card%d", asics[i]->instance);
@@ -1596,6 +1843,32 @@ static bool is_thread_alive(struct umr_asic *asic, struct umr_wave_data *wd, int
 	return exec_mask & (1u << (tid % 32));
 }
 
+static JSON_Value *wave_reg_to_json(struct umr_asic *asic, struct umr_wave_data *wd, int x) {
+	int no_bits;
+	struct umr_bitfield *bits;
+	JSON_Object *r;
+
+	r = json_object(json_value_init_object());
+	json_object_set_number(r, "raw", wd->ws.reg_values[x]);
+
+	umr_wave_data_get_bit_info(asic, wd, wd->reg_names[x], &no_bits, &bits);
+	for (int y = 0; y < no_bits; y++) {
+		json_object_set_number(r, bits[y].regname,
+							   umr_wave_data_get_bits(asic, wd, wd->reg_names[x], bits[y].regname));
+	}
+	return json_object_get_wrapping_value(r);
+}
+
+static JSON_Value *wave_threads_to_json(struct umr_asic *asic, struct umr_wave_data *wd) {
+	JSON_Value *threads = json_value_init_array();
+	int num_threads = wd->num_threads;
+	for (int thread = 0; thread < num_threads; thread++) {
+		bool live = is_thread_alive(asic, wd, thread);
+		json_array_append_boolean(json_array(threads), live ? 1 : 0);
+	}
+	return threads;
+}
+
 static JSON_Value *wave_to_json(struct umr_asic *asic, struct umr_wave_data *wd, int gfx_maj_version,
 				struct umr_packet_stream *stream, JSON_Value *shaders) {
 	uint64_t pc;
@@ -1613,32 +1886,14 @@ static JSON_Value *wave_to_json(struct umr_asic *asic, struct umr_wave_data *wd,
 	JSON_Object *registers = json_object(json_value_init_object());
 	json_object_set_value(json_object(wave), "registers",
 		json_object_get_wrapping_value(registers));
-	for (int x = 0; wd->reg_names[x]; x++) {
-		int no_bits;
-		struct umr_bitfield *bits;
-		JSON_Object *r;
-
-		r = json_object(json_value_init_object());
-		json_object_set_number(r, "raw", wd->ws.reg_values[x]);
-
-		umr_wave_data_get_bit_info(asic, wd, wd->reg_names[x], &no_bits, &bits);
-		for (int y = 0; y < no_bits; y++) {
-			json_object_set_number(r, bits[y].regname,
-								   umr_wave_data_get_bits(asic, wd, wd->reg_names[x], bits[y].regname));
-		}
-
-		json_object_set_value(registers, wd->reg_names[x], json_object_get_wrapping_value(r));
-	}
+	for (int x = 0; wd->reg_names[x]; x++)
+		json_object_set_value(registers, wd->reg_names[x], wave_reg_to_json(asic, wd, x));
 
-	JSON_Value *threads = json_value_init_array();
 	int num_threads = wd->num_threads;
-	for (int thread = 0; thread < num_threads; thread++) {
-		bool live = is_thread_alive(asic, wd, thread);
-		json_array_append_boolean(json_array(threads), live ? 1 : 0);
-	}
-	json_object_set_value(json_object(wave), "threads", threads);
+	json_object_set_value(json_object(wave), "threads", wave_threads_to_json(asic, wd));
 
-	if (!asic->options.skip_gprs && (umr_wave_data_get_flag_halt(asic, wd) || umr_wave_data_get_flag_fatal_halt(asic, wd))) {
+	if ((umr_wave_data_get_flag_halt(asic, wd) || umr_wave_data_get_flag_fatal_halt(asic, wd)) &&
+	    !umr_wave_data_fetch_gprs(asic, wd)) {
 		int sgpr_count = umr_wave_data_num_of_sgprs(asic, wd);
 		JSON_Value *sgpr = json_value_init_array();
 		for (int x = 0; x < sgpr_count; x++)
@@ -1703,10 +1958,76 @@ static JSON_Value *wave_to_json(struct umr_asic *asic, struct umr_wave_data *wd,
 	return wave;
 }
 
+/* The wave last single stepped on each asic as it was sent to the client. */
+static struct umr_wave_snapshot step_snapshot[ARRAY_SIZE(asics)];
+
+/* Only what changed since the previous step of the wave, GPRs are sent
+ * by blocks of UMR_WAVE_GPR_BLOCK registers. */
+static JSON_Value *wave_delta_to_json(struct umr_asic *asic, struct umr_wave_data *wd,
+				      struct umr_wave_delta *delta) {
+	uint64_t pc;
+	uint32_t vmid;
+
+	JSON_Value *wave = json_value_init_object();
+	umr_wave_data_get_shader_pc_vmid(asic, wd, &vmid, &pc);
+	json_object_set_number(json_object(wave), "PC", pc);
+	json_object_set_value(json_object(wave), "threads", wave_threads_to_json(asic, wd));
+
+	JSON_Object *registers = json_object(json_value_init_object());
+	json_object_set_value(json_object(wave), "registers",
+		json_object_get_wrapping_value(registers));
+	for (int x = 0; wd->reg_names[x]; x++)
+		if (delta->regs & (1ULL << x))
+			json_object_set_value(registers, wd->reg_names[x], wave_reg_to_json(asic, wd, x));
+
+	/* SGPRs in use plus the trap temporaries */
+	int sgpr_count = umr_wave_data_num_of_sgprs(asic, wd);
+	int trap = umr_wave_data_get_flag_trap_en(asic, wd) || umr_wave_data_get_flag_priv(asic, wd);
+	JSON_Value *sgpr_blocks = json_value_init_array();
+	for (int b = 0; b < 1024 / UMR_WAVE_GPR_BLOCK; b++) {
+		int start = b * UMR_WAVE_GPR_BLOCK;
+		if (!(delta->sgpr_blocks & (1ULL << b)))
+			continue;
+		if (start >= sgpr_count && !(trap && start < 0x6C + 16 && start + UMR_WAVE_GPR_BLOCK > 0x6C))
+			continue;
+		JSON_Value *block = json_value_init_object();
+		JSON_Value *values = json_value_init_array();
+		for (int x = 0; x < UMR_WAVE_GPR_BLOCK; x++)
+			json_array_append_number(json_array(values), wd->sgprs[start + x]);
+		json_object_set_number(json_object(block), "start", start);
+		json_object_set_value(json_object(block), "values", values);
+		json_array_append_value(json_array(sgpr_blocks), block);
+	}
+	json_object_set_value(json_object(wave), "sgpr_blocks", sgpr_blocks);
+
+	JSON_Value *vgpr_blocks = json_value_init_array();
+	for (int b = 0; b < 256 / UMR_WAVE_GPR_BLOCK; b++) {
+		int start = b * UMR_WAVE_GPR_BLOCK;
+		if (!(delta->vgpr_blocks & (1U << b)))
+			continue;
+		int vgpr_count =
+			(umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_GPR_ALLOC", "VGPR_SIZE") + 1) << asic->parameters.vgpr_granularity;
+		JSON_Value *block = json_value_init_object();
+		JSON_Value *rows = json_value_init_array();
+		for (int x = start; x < start + UMR_WAVE_GPR_BLOCK && x < vgpr_count; x++) {
+			JSON_Value *v = json_value_init_array();
+			for (unsigned thread = 0; thread < wd->num_threads; thread++)
+				json_array_append_number(json_array(v), wd->vgprs[thread * 256 + x]);
+			json_array_append_value(json_array(rows), v);
+		}
+		json_object_set_number(json_object(block), "start", start);
+		json_object_set_value(json_object(block), "rows", rows);
+		json_array_append_value(json_array(vgpr_blocks), block);
+	}
+	json_object_set_value(json_object(wave), "vgpr_blocks", vgpr_blocks);
+
+	return wave;
+}
+
 static void read_clock_min_max(struct umr_asic *asic, const char *clk_name, int *min, int *max)
 {
 	parse_sysfs_clock_file(
-		read_file(SYSFS_PATH_DRM "card%d/device/pp_dpm_%s", asic->instance, clk_name),
+		read_asic_file(asic, SYSFS_PATH_DRM "card%d/device/pp_dpm_%s", asic->instance, clk_name),
 		min, max);
 }
 
@@ -1735,6 +2056,7 @@ struct pid_tgid_mapping {
 	int pid;
 	int tgid;
 	char process_name[32];
+	char task_name[32];
 };
 
 struct string_array {
@@ -1815,6 +2137,9 @@ struct activity_capture_data {
 	struct pid_tgid_mapping* mapping;
 	int mapping_count, mapping_capacity;
 
+	/* Per CPU trace_pipe_raw readers, NULL if trace_pipe is used. */
+	struct raw_trace *raw;
+
 	int lost_events;
 	int8_t *event_buffer;
 	int event_buffer_size;
@@ -1827,6 +2152,8 @@ struct activity_capture_data {
 struct activity_capture_data *__sensor_data = NULL;
 
 static void* read_trace_buffer_thread(void *in);
+static struct raw_trace *raw_trace_start(struct activity_capture_data *data, int mode);
+static void raw_trace_stop(struct activity_capture_data *data);
 static bool events_tracing_helper(int mode, bool verbose, struct umr_asic *asic,
 											 JSON_Object *request) {
 	write_str_to_file(SYSFS_PATH_TRACING "trace_clock", "mono");
@@ -1890,29 +2217,37 @@ static bool events_tracing_helper(int mode, bool verbose, struct umr_asic *asic,
 		struct activity_capture_data *data = calloc(1, sizeof(struct activity_capture_data));
 		data->run = true;
 		data->verbose = verbose;
-		data->tracing_pipe_fd = fopen(SYSFS_PATH_TRACING "trace_pipe", "r");
-		if (!data->tracing_pipe_fd) {
-			fprintf(stderr, "Failed to open " SYSFS_PATH_TRACING "trace_pipe\n");
-			free(data);
-			return false;
-		}
-		fcntl(fileno(data->tracing_pipe_fd), F_SETFL, O_NONBLOCK);
 		data->mapping = calloc(8, sizeof(struct activity_capture_data));
 		data->mapping_count = 0;
 		data->mapping_capacity = 8;
 		data->client_names = mode == 1;
 		string_array_init(&data->tasks);
+		pthread_mutex_init(&data->mtx, NULL);
 
+		/* Prefer the binary per CPU buffers, trace_pipe is the fallback. */
+		if (!raw_trace_start(data, mode)) {
+			data->tracing_pipe_fd = fopen(SYSFS_PATH_TRACING "trace_pipe", "r");
+			if (!data->tracing_pipe_fd) {
+				fprintf(stderr, "Failed to open " SYSFS_PATH_TRACING "trace_pipe\n");
+				free(data->mapping);
+				string_array_deinit(&data->tasks);
+				free(data);
+				return false;
+			}
+			fcntl(fileno(data->tracing_pipe_fd), F_SETFL, O_NONBLOCK);
+			data->event_thread_is_valid = pthread_create(&data->event_thread, NULL, read_trace_buffer_thread, data) == 0;
+		}
 		__sensor_data = data;
-		pthread_mutex_init(&data->mtx, NULL);
-		data->event_thread_is_valid = pthread_create(&__sensor_data->event_thread, NULL, read_trace_buffer_thread, data) == 0;
 	} else if (__sensor_data) {
 		__sensor_data->run = false;
 		if (__sensor_data->event_thread_is_valid)
 			pthread_join(__sensor_data->event_thread, NULL);
+		if (__sensor_data->raw)
+			raw_trace_stop(__sensor_data);
 		free(__sensor_data->mapping);
 		free(__sensor_data->event_buffer);
-		fclose(__sensor_data->tracing_pipe_fd);
+		if (__sensor_data->tracing_pipe_fd)
+			fclose(__sensor_data->tracing_pipe_fd);
 		string_array_deinit(&__sensor_data->tasks);
 		free(__sensor_data);
 		__sensor_data = NULL;
@@ -1989,6 +2324,48 @@ static int8_t *ensure_capacity(int8_t *buffer, int *capacity, int used, int extr
 	return buffer;
 }
 
+/* Find (or add) the tgid and process name of the thread @pid.  @task_name
+ * is its name if the caller knows it, otherwise it's read from /proc.
+ */
+static struct pid_tgid_mapping *lookup_pid_mapping(struct activity_capture_data *data, int pid,
+												   const char *task_name, int task_name_len)
+{
+	struct pid_tgid_mapping *m;
+
+	for (int i = 0; i < data->mapping_count; i++) {
+		if (data->mapping[i].pid == pid)
+			return &data->mapping[i];
+	}
+
+	if (data->mapping_count == data->mapping_capacity) {
+		data->mapping_capacity *= 2;
+		data->mapping = realloc(data->mapping, data->mapping_capacity * sizeof(struct pid_tgid_mapping));
+	}
+	m = &data->mapping[data->mapping_count++];
+	m->pid = pid;
+	m->tgid = get_tgid_for_tid(pid);
+
+	if (!task_name) {
+		/* Same names as the text trace. */
+		task_name = pid ? read_file("/proc/%d/comm", pid) : "<idle>";
+		task_name_len = strcspn(task_name, "\n");
+		if (!task_name_len) {
+			task_name = "<...>";
+			task_name_len = strlen(task_name);
+		}
+	}
+	if (task_name_len > 31)
+		task_name_len = 31;
+	memcpy(m->task_name, task_name, task_name_len);
+	m->task_name[task_name_len] = '\0';
+
+	if (get_pid_name(m->tgid, m->process_name) < 0) {
+		/* Maybe the process exited early. */
+		strcpy(m->process_name, m->task_name);
+	}
+	return m;
+}
+
 static bool parse_one_event(struct activity_capture_data *data, char *buffer,
 									 int len, int8_t **out,
 									 int *raw_data_used, int *raw_data_capacity) {
@@ -2029,35 +2406,9 @@ static bool parse_one_event(struct activity_capture_data *data, char *buffer,
 	int pid = strtol(cursor, NULL, 10);
 
 	/* Figure out the tgid */
-	int tgid = -1;
-	for (int i = 0; i < data->mapping_count; i++) {
-		if (data->mapping[i].pid == pid) {
-			tgid = data->mapping[i].tgid;
-			process_name = data->mapping[i].process_name;
-			break;
-		}
-	}
-	if (tgid < 0) {
-		if (data->mapping_count == data->mapping_capacity) {
-			data->mapping_capacity *= 2;
-			data->mapping = realloc(data->mapping, data->mapping_capacity * sizeof(struct pid_tgid_mapping));
-		}
-
-		data->mapping[data->mapping_count].pid = pid;
-		tgid = data->mapping[data->mapping_count].tgid = get_tgid_for_tid(pid);
-		if (get_pid_name(tgid, data->mapping[data->mapping_count].process_name) < 0) {
-			/* Maybe the process exited early. */
-			int len = task_name_end - task_name_start;
-			if (len > 31)
-				len = 31;
-			strncpy(data->mapping[data->mapping_count].process_name, task_name_start, sizeof(data->mapping[data->mapping_count].process_name) - 1);
-			data->mapping[data->mapping_count].process_name[len] = '\0';
-		}
-
-		process_name = data->mapping[data->mapping_count].process_name;
-
-		data->mapping_count++;
-	}
+	struct pid_tgid_mapping *m = lookup_pid_mapping(data, pid, task_name_start, task_name_end - task_name_start);
+	int tgid = m->tgid;
+	process_name = m->process_name;
 
 	/* Skip the CPU section */
 	cursor = pid_end;
@@ -2153,6 +2504,7 @@ static bool parse_one_event(struct activity_capture_data *data, char *buffer,
 	return true;
 }
 
+#include "commands_trace.c"
 
 static void* read_trace_buffer_thread(void *in) {
 	char buffer[4096];
@@ -2269,7 +2621,7 @@ static void waves_to_json(struct umr_asic *asic, JSON_Object *out) {
 		asic, NULL, asic->options.ring_name, 0, &start, &stop, UMR_RING_GUESS, NULL);
 
 	/* Get wave data. */
-	wd = umr_scan_wave_data(asic);
+	owd = wd = umr_scan_wave_data(asic);
 
 	JSON_Value *shaders = json_value_init_object();
 	JSON_Value *waves = json_value_init_array();
@@ -2278,11 +2630,9 @@ static void waves_to_json(struct umr_asic *asic, JSON_Object *out) {
 		JSON_Value *wave = wave_to_json(asic, wd, maj, stream, shaders);
 
 		json_array_append_value(json_array(waves), wave);
-
-		owd = wd;
 		wd = wd->next;
-		free(owd);
 	}
+	umr_free_wave_data(owd);
 
 	json_object_set_value(out, "waves", waves);
 	json_object_set_value(out, "shaders", shaders);
@@ -2308,45 +2658,567 @@ error:
 	return name;
 }
 
+/* "accumulate" requests sample their registers with a umr_reg_sampler, a
+ * streamed one stays here between its "accumulate-poll" requests. */
+struct accumulate_session {
+	int id;
+	struct umr_asic *asic;
+	struct umr_reg_sampler *sampler;
+	struct umr_reg **reg;
+	int num_reg;
+	char *dev_name;
+	struct umr_fence_tracker *fences;
+	struct umr_fence_snapshot fences_before;
+	JSON_Array *pids;
+	JSON_Value *fdinfo_start;
+	struct umr_gpu_clock clock;
+	struct accumulate_session *next;
+};
+#define ACCUMULATE_MAX_SESSIONS 16
+static struct accumulate_session *accumulate_sessions;
+static int accumulate_next_id;
+
+static struct accumulate_session *accumulate_begin(struct umr_asic *asic, JSON_Object *request, const char **error)
+{
+	JSON_Array *regs = json_object_get_array(request, "registers");
+	const int num_reg = json_array_get_count(regs);
+	char *ipname = (char*) json_object_get_string(request, "block");
+	int step_ms = json_object_get_number(request, "step_ms");
+	int period_ms = json_object_get_number(request, "period");
+	struct accumulate_session *as = calloc(1, sizeof *as);
+
+	as->asic = asic;
+	as->num_reg = num_reg;
+	as->reg = malloc(num_reg * sizeof(struct umr_reg*));
+	for (int i = 0; i < num_reg; i++) {
+		as->reg[i] = umr_find_reg_data_by_ip(asic, ipname, json_array_get_string(regs, i));
+		if (!as->reg[i]) {
+			printf("Inconsistent state detected: server and client disagree on ASIC definition.\n");
+			*error = "unknown register";
+			free(as->reg);
+			free(as);
+			return NULL;
+		}
+	}
+
+	/* Disable GFXOFF */
+	umr_gfxoff_hold(asic);
+
+	/* Get our ID. */
+	as->dev_name = get_asic_devname(asic);
+
+	as->pids = get_active_amdgpu_clients(asic);
+	/* Read fdinfo for each client. */
+	as->fdinfo_start = json_value_init_object();
+	for (size_t i = 0; i < json_array_get_count(as->pids); i++) {
+		JSON_Object *pid = json_object(json_array_get_value(as->pids, i));
+		read_fdinfo(asic, as->fdinfo_start, pid, as->dev_name);
+	}
+	as->fences = umr_fence_tracker_open(asic);
+	if (as->fences)
+		umr_fence_tracker_read(as->fences, &as->fences_before);
+	umr_gpu_clock_init(asic, &as->clock);
+
+	/* "adaptive" lets the step go from a tenth to ten times step_ms */
+	if (json_object_get_boolean(request, "adaptive") == 1) {
+		struct umr_sample_rate rate;
+		int budget = json_object_has_value(request, "cpu_budget") ?
+			json_object_get_number(request, "cpu_budget") : 5;
+
+		umr_sample_rate_init(&rate, (uint64_t)step_ms * 100000, (uint64_t)step_ms * 10000000,
+				     budget > 0 ? budget : 0);
+		as->sampler = umr_reg_sampler_start_adaptive(asic, as->reg, num_reg,
+							     &rate, (uint64_t)period_ms * 1000000);
+	} else {
+		as->sampler = umr_reg_sampler_start(asic, as->reg, num_reg,
+						    (uint64_t)step_ms * 1000000, (uint64_t)period_ms * 1000000);
+	}
+	if (!as->sampler) {
+		*error = "failed to start the register sampler";
+		json_value_free(as->fdinfo_start);
+		json_value_free(json_array_get_wrapping_value(as->pids));
+		umr_fence_tracker_close(as->fences);
+		umr_fence_snapshot_free(&as->fences_before);
+		free(as->dev_name);
+		free(as->reg);
+		free(as);
+		return NULL;
+	}
+	as->id = __atomic_add_fetch(&accumulate_next_id, 1, __ATOMIC_RELAXED);
+	return as;
+}
+
+/* Add the counters sampled so far to @answer, returns 1 once all are in. */
+static int accumulate_values(struct accumulate_session *as, JSON_Object *answer)
+{
+	uint64_t *counters = calloc(umr_reg_sampler_fields(as->sampler) + 1, sizeof(uint64_t));
+	uint64_t samples, missed;
+	int done, f = 0;
+
+	done = umr_reg_sampler_read(as->sampler, counters, &samples, &missed);
+
+	JSON_Value *values = json_value_init_array();
+	for (int j = 0; j < as->num_reg; j++) {
+		JSON_Value *regvalue = json_value_init_array();
+		for (int k = 0; k < as->reg[j]->no_bits; k++, f++) {
+			JSON_Value *v = json_value_init_object();
+			json_object_set_string(json_object(v), "name", as->reg[j]->bits[k].regname);
+			json_object_set_number(json_object(v), "counter", counters[f]);
+			json_array_append_value(json_array(regvalue), v);
+		}
+		json_array_append_value(json_array(values), regvalue);
+	}
+	json_object_set_value(answer, "values", values);
+	json_object_set_number(answer, "samples", samples);
+	json_object_set_number(answer, "missed", missed);
+	/* CLOCK_MONOTONIC_RAW, read from the GPU where it can be so the
+	 * answers of the workers of several GPUs line up */
+	json_object_set_number(answer, "time_ns", umr_gpu_clock_now(as->asic, &as->clock));
+	json_object_set_boolean(answer, "gpu_time", as->clock.valid);
+	json_object_set_boolean(answer, "done", done);
+	free(counters);
+	return done;
+}
+
+/* Stop sampling, add the final counters, fences and fdinfo to @answer. */
+static void accumulate_end(struct accumulate_session *as, JSON_Object *answer)
+{
+	struct umr_asic *asic = as->asic;
+
+	accumulate_values(as, answer);
+	umr_reg_sampler_stop(as->sampler);
+
+	/* Read fdinfo for each client. */
+	JSON_Value *end = json_value_init_object();
+	for (size_t i = 0; i < json_array_get_count(as->pids); i++) {
+		JSON_Object *pid = json_object(json_array_get_value(as->pids, i));
+		read_fdinfo(asic, end, pid, as->dev_name);
+	}
+
+	free(as->dev_name);
+
+	/* Re-enable GFXOFF */
+	umr_gfxoff_release(asic);
+
+	struct umr_fence_snapshot fences_after;
+	memset(&fences_after, 0, sizeof fences_after);
+	if (as->fences)
+		umr_fence_tracker_read(as->fences, &fences_after);
+	json_object_set_value(answer, "fences", fence_deltas(&as->fences_before, &fences_after));
+	umr_fence_tracker_close(as->fences);
+	umr_fence_snapshot_free(&as->fences_before);
+	umr_fence_snapshot_free(&fences_after);
+
+	JSON_Object *fdinfo = json_object(json_value_init_object());
+	json_object_set_value(answer, "fdinfo", json_object_get_wrapping_value(fdinfo));
+	json_object_set_value(fdinfo, "start", as->fdinfo_start);
+	json_object_set_value(fdinfo, "end", end);
+	json_value_free(json_array_get_wrapping_value(as->pids));
+	free(as->reg);
+	free(as);
+}
+
+/* Requests for different asics may be processed at once (by the lanes of
+ * the GUI or the workers of the server).  Each asic has its own lock, the
+ * requests without one take the shared lock, which can be held while
+ * taking the lock of an asic (subscriptions evaluate their sources) but
+ * not the other way around.  accumulate_lock only guards the list of
+ * accumulate sessions. */
+static pthread_once_t request_locks_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t asic_request_locks[ARRAY_SIZE(asics)];
+static pthread_mutex_t shared_request_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t init_asics_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t accumulate_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void request_locks_init(void)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(asic_request_locks); i++)
+		pthread_mutex_init(&asic_request_locks[i], NULL);
+}
+
+/* Subscriptions.  A client (subscriber) asks for the answer of a read-only
+ * request (source) every period_ms and fetches whatever is due with an
+ * "updates" request when the server tells it to, instead of re-sending
+ * each request itself.  Subscriptions to the same source share its last
+ * answer so several panels or clients watching it cost one evaluation
+ * per period, and "changes_only" ones are only sent when it changed.
+ * Subscribers that stop asking for updates are dropped, and a source goes
+ * with its last subscription. */
+struct subscription_source {
+	char *key; /* the serialized request */
+	JSON_Value *response;
+	uint64_t hash; /* of the serialized answer */
+	int64_t eval_ns;
+	int refs;
+	struct subscription_source *next;
+};
+
+struct subscription {
+	char *name;
+	struct subscription_source *source;
+	int64_t period_ns, next_ns;
+	uint64_t sent_hash;
+	bool changes_only;
+	struct subscription *next;
+};
+
+struct subscriber {
+	int id;
+	int64_t seen_ns;
+	struct subscription *subs;
+	struct subscriber *next;
+};
+#define SUBSCRIBER_TIMEOUT_NS (10 * 1000000000LL)
+#define SUBSCRIPTION_MIN_PERIOD_MS 50
+static struct subscriber *subscribers;
+static struct subscription_source *subscription_sources;
+static int subscriber_next_id;
+
+JSON_Value *umr_process_json_request(JSON_Object *request, void **raw_data, unsigned *raw_data_size);
+
+static const char *subscribable_commands[] = {
+	"sensors", "runtimepm", "pp_features", "hwmon", "power", "memory-usage", "drm-counters", "io-stats"
+};
+
+static struct subscription_source *subscription_source_get(JSON_Value *request)
+{
+	char *key = json_serialize_to_string(request);
+	struct subscription_source *src;
+
+	for (src = subscription_sources; src; src = src->next) {
+		if (!strcmp(src->key, key)) {
+			json_free_serialized_string(key);
+			src->refs++;
+			return src;
+		}
+	}
+	src = calloc(1, sizeof *src);
+	src->key = key;
+	src->refs = 1;
+	src->next = subscription_sources;
+	subscription_sources = src;
+	return src;
+}
+
+static void subscription_free(struct subscription *sub)
+{
+	struct subscription_source **psrc, *src = sub->source;
+
+	if (--src->refs == 0) {
+		for (psrc = &subscription_sources; *psrc != src; psrc = &(*psrc)->next);
+		*psrc = src->next;
+		json_free_serialized_string(src->key);
+		json_value_free(src->response);
+		free(src);
+	}
+	free(sub->name);
+	free(sub);
+}
+
+static void subscriber_free(struct subscriber *s)
+{
+	while (s->subs) {
+		struct subscription *sub = s->subs;
+		s->subs = sub->next;
+		subscription_free(sub);
+	}
+	free(s);
+}
+
+/* Find subscriber @id (a new one if 0) and forget those gone quiet. */
+static struct subscriber *subscriber_get(int id, bool create, int64_t now)
+{
+	struct subscriber **ps = &subscribers, *s;
+
+	while ((s = *ps)) {
+		if (s->id != id && now - s->seen_ns > SUBSCRIBER_TIMEOUT_NS) {
+			*ps = s->next;
+			subscriber_free(s);
+			continue;
+		}
+		if (s->id == id) {
+			s->seen_ns = now;
+			return s;
+		}
+		ps = &s->next;
+	}
+	if (!create || id)
+		return NULL;
+
+	s = calloc(1, sizeof *s);
+	s->id = ++subscriber_next_id;
+	s->seen_ns = now;
+	s->next = subscribers;
+	subscribers = s;
+	return s;
+}
+
+static void subscription_source_evaluate(struct subscription_source *src, int64_t now)
+{
+	JSON_Value *request = json_parse_string(src->key);
+	void *raw_data = NULL;
+	unsigned raw_data_size = 0;
+	uint64_t h = 0xcbf29ce484222325ULL;
+
+	json_value_free(src->response);
+	src->response = umr_process_json_request(json_object(request), &raw_data, &raw_data_size);
+	free(raw_data);
+
+	char *s = json_serialize_to_string(json_object_get_value(json_object(src->response), "answer"));
+	for (const char *c = s; c && *c; c++)
+		h = (h ^ (uint8_t)*c) * 0x100000001b3ULL;
+	json_free_serialized_string(s);
+	src->hash = h;
+	src->eval_ns = now;
+}
+
+/* Add the responses of the subscriptions of @s that are due to @answer,
+ * and when the next one will be. */
+static void subscriber_updates(struct subscriber *s, JSON_Object *answer, int64_t now)
+{
+	JSON_Value *updates = json_value_init_array();
+	int64_t next = -1;
+
+	for (struct subscription *sub = s->subs; sub; sub = sub->next) {
+		struct subscription_source *src = sub->source;
+
+		if (sub->next_ns <= now) {
+			/* an answer younger than half our period is fresh enough */
+			if (!src->response || now - src->eval_ns >= sub->period_ns / 2)
+				subscription_source_evaluate(src, now);
+			if (!sub->changes_only || src->hash != sub->sent_hash) {
+				json_array_append_value(json_array(updates), json_value_deep_copy(src->response));
+				sub->sent_hash = src->hash;
+			}
+			sub->next_ns += sub->period_ns;
+			if (sub->next_ns <= now)
+				sub->next_ns = now + sub->period_ns;
+		}
+		if (next < 0 || sub->next_ns < next)
+			next = sub->next_ns;
+	}
+	json_object_set_value(answer, "updates", updates);
+	json_object_set_number(answer, "next_ms", next < 0 ? -1 : (next - now) / 1000000);
+}
+
+/* Answers that rarely change are kept for a while, tagged with a hash of
+ * their content.  A request carrying the "etag" of the current answer gets
+ * "not_modified" instead of the answer (and its raw data) again. */
+struct cached_response {
+	const char *command;
+	char *key;
+	JSON_Value *answer;
+	void *raw_data;
+	unsigned raw_data_size;
+	char etag[17];
+	int64_t expires_ns;
+	struct cached_response *next;
+};
+
+static const struct {
+	const char *command;
+	int ttl_ms;
+	const char *write_field; /* requests with it change the state: not cached */
+} cacheable_commands[] = {
+	{ "enumerate", 60000, NULL },
+	{ "pp_features", 1000, "set" },
+	{ "kms", 1000, "dm_visual_confirm" },
+};
+static struct cached_response *cached_responses;
+static pthread_mutex_t cached_responses_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* How long the answer to @request can be kept, 0 if it can't. */
+static int response_cache_ttl_ms(const char *command, JSON_Object *request)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(cacheable_commands); i++) {
+		if (strcmp(command, cacheable_commands[i].command))
+			continue;
+		if (cacheable_commands[i].write_field &&
+		    json_object_has_value(request, cacheable_commands[i].write_field))
+			return 0;
+		return cacheable_commands[i].ttl_ms;
+	}
+	return 0;
+}
+
+/* Forget the answers to @command, e.g. because a request changed them. */
+void response_cache_drop(const char *command)
+{
+	struct cached_response **pc, *c;
+
+	pthread_mutex_lock(&cached_responses_lock);
+	for (pc = &cached_responses; (c = *pc);) {
+		if (!strcmp(c->command, command)) {
+			*pc = c->next;
+			free(c->key);
+			json_value_free(c->answer);
+			free(c->raw_data);
+			free(c);
+		} else {
+			pc = &c->next;
+		}
+	}
+	pthread_mutex_unlock(&cached_responses_lock);
+}
+
+/**
+ * response_cache_lookup - Find the cached answer to a request
+ *
+ * @key: The serialized request, without its "etag"
+ * @etag: The tag of the answer the client has, or NULL
+ * @answer: Gets a copy of the answer, unless the client has it already
+ * @raw_data, @raw_data_size: Get a copy of the raw data, likewise
+ * @out_etag: Gets the tag of the cached answer
+ *
+ * Returns false if there's no fresh answer to the request.
+ */
+bool response_cache_lookup(const char *key, const char *etag, JSON_Value **answer,
+				  void **raw_data, unsigned *raw_data_size, char *out_etag)
+{
+	struct cached_response *c;
+	int64_t now = time_ns();
+
+	pthread_mutex_lock(&cached_responses_lock);
+	for (c = cached_responses; c && strcmp(c->key, key); c = c->next);
+	if (!c || c->expires_ns <= now) {
+		pthread_mutex_unlock(&cached_responses_lock);
+		return false;
+	}
+	strcpy(out_etag, c->etag);
+	*answer = NULL;
+	if (!etag || strcmp(etag, c->etag)) {
+		*answer = json_value_deep_copy(c->answer);
+		if (c->raw_data_size) {
+			*raw_data = malloc(c->raw_data_size);
+			memcpy(*raw_data, c->raw_data, c->raw_data_size);
+			*raw_data_size = c->raw_data_size;
+		}
+	}
+	pthread_mutex_unlock(&cached_responses_lock);
+	return true;
+}
+
+/* Keep @answer to the request @key for @ttl_ms, its tag goes to @etag. */
+void response_cache_store(const char *command, const char *key, JSON_Value *answer,
+				 void *raw_data, unsigned raw_data_size, int ttl_ms, char *etag)
+{
+	struct cached_response **pc, *c;
+	uint64_t h = 0xcbf29ce484222325ULL;
+	char *s = json_serialize_to_string(answer);
+
+	for (const char *p = s; p && *p; p++)
+		h = (h ^ (uint8_t)*p) * 0x100000001b3ULL;
+	for (unsigned i = 0; i < raw_data_size; i++)
+		h = (h ^ ((uint8_t*)raw_data)[i]) * 0x100000001b3ULL;
+	json_free_serialized_string(s);
+	sprintf(etag, "%016" PRIx64, h);
+
+	pthread_mutex_lock(&cached_responses_lock);
+	for (pc = &cached_responses; (c = *pc) && strcmp(c->key, key); pc = &c->next);
+	if (c) {
+		json_value_free(c->answer);
+		free(c->raw_data);
+	} else {
+		c = calloc(1, sizeof *c);
+		for (size_t i = 0; i < ARRAY_SIZE(cacheable_commands); i++) {
+			if (!strcmp(command, cacheable_commands[i].command))
+				c->command = cacheable_commands[i].command;
+		}
+		c->key = strdup(key);
+		c->next = cached_responses;
+		cached_responses = c;
+	}
+	c->answer = json_value_deep_copy(answer);
+	c->raw_data = NULL;
+	c->raw_data_size = raw_data_size;
+	if (raw_data_size) {
+		c->raw_data = malloc(raw_data_size);
+		memcpy(c->raw_data, raw_data, raw_data_size);
+	}
+	strcpy(c->etag, etag);
+	c->expires_ns = time_ns() + (int64_t)ttl_ms * 1000000;
+	pthread_mutex_unlock(&cached_responses_lock);
+}
+
 JSON_Value *umr_process_json_request(JSON_Object *request, void **raw_data, unsigned *raw_data_size)
 {
 	JSON_Value *answer = NULL;
 	const char *last_error = NULL;
 	const char *command = json_object_get_string(request, "command");
+	pthread_mutex_t *lock = NULL;
+	char *cache_key = NULL, etag[17] = "";
+	int ttl_ms = 0;
 
 	if (!command) {
 		last_error = "missing command";
 		goto error;
 	}
 
+	pthread_once(&request_locks_once, request_locks_init);
+	pthread_mutex_lock(&init_asics_lock);
 	if (asics[0] == NULL) {
 		init_asics();
 	}
+	pthread_mutex_unlock(&init_asics_lock);
 
 	struct umr_asic *asic = NULL;
+	int asic_idx = -1;
 	JSON_Object *asc = json_object_get_object(request, "asic");
 	if (asc) {
 		unsigned did = json_object_get_number(asc, "did");
 		int instance = json_object_get_number(asc, "instance");
-		for (int i = 0; !asic; i++) {
-			if (asics[i] && asics[i]->did == did && asics[i]->instance == instance)
+		for (int i = 0; i < (int)ARRAY_SIZE(asics) && !asic; i++) {
+			if (asics[i] && asics[i]->did == did && asics[i]->instance == instance) {
 				asic = asics[i];
+				asic_idx = i;
+			}
 		}
 	}
 
 	const char *asicless_commands[] = {
-		"enumerate", "ping", "tracing", "read-trace-buffer"
+		"enumerate", "ping", "tracing", "read-trace-buffer", "wire-format",
+		"subscribe", "unsubscribe", "updates"
 	};
+	bool asicless = false;
+	for (size_t i = 0; i < ARRAY_SIZE(asicless_commands) && !asicless; i++)
+		asicless = strcmp(command, asicless_commands[i]) == 0;
 
-	if (!asic) {
-		bool ok = false;
-		for (size_t i = 0; i < ARRAY_SIZE(asicless_commands) && !ok; i++)
-			ok = strcmp(command, asicless_commands[i]) == 0;
+	if (!asic && !asicless) {
+		last_error = "asic not found";
+		goto error;
+	}
 
-		if (!ok) {
-			last_error = "asic not found";
-			goto error;
+	lock = asicless ? &shared_request_lock : &asic_request_locks[asic_idx];
+	pthread_mutex_lock(lock);
+
+	// the page tables may have changed since the last request
+	if (asic)
+		umr_vm_tlb_flush(asic);
+
+	ttl_ms = response_cache_ttl_ms(command, request);
+	if (ttl_ms) {
+		char *client_etag = json_object_has_value(request, "etag") ?
+			strdup(json_object_get_string(request, "etag")) : NULL;
+
+		json_object_remove(request, "etag");
+		cache_key = json_serialize_to_string(json_object_get_wrapping_value(request));
+		if (response_cache_lookup(cache_key, client_etag, &answer, raw_data, raw_data_size, etag)) {
+			free(client_etag);
+			json_free_serialized_string(cache_key);
+			JSON_Value *out = json_value_init_object();
+			if (answer)
+				json_object_set_value(json_object(out), "answer", answer);
+			else
+				json_object_set_boolean(json_object(out), "not_modified", true);
+			json_object_set_string(json_object(out), "etag", etag);
+			json_object_set_value(json_object(out), "request", json_object_get_wrapping_value(request));
+			json_object_set_boolean(json_object(out), "has_raw_data", *raw_data != NULL && *raw_data_size);
+			pthread_mutex_unlock(lock);
+			return out;
 		}
+		free(client_etag);
+	} else if (json_object_has_value(request, "set") || json_object_has_value(request, "dm_visual_confirm")) {
+		response_cache_drop(command);
 	}
 
 	if (strcmp(command, "enumerate") == 0) {
@@ -2354,6 +3226,9 @@ JSON_Value *umr_process_json_request(JSON_Object *request, void **raw_data, unsi
 		answer = json_value_init_array();
 		while (asics[i]) {
 			JSON_Value *as = json_value_init_object ();
+			// the versions are not read at startup
+			if (asics[i]->config.scanned)
+				umr_scan_config_fields(asics[i], 0, UMR_CONFIG_SCAN_VBIOS | UMR_CONFIG_SCAN_FW);
 			json_object_set_string(json_object(as), "name", asics[i]->asicname);
 			json_object_set_string(json_object(as), "pci_name", asics[i]->options.pci.name);
 			json_object_set_number(json_object(as), "index", i);
@@ -2363,6 +3238,15 @@ JSON_Value *umr_process_json_request(JSON_Object *request, void **raw_data, unsi
 			json_object_set_number(json_object(as), "vram_size", asics[i]->config.vram_size);
 			json_object_set_number(json_object(as), "vis_vram_size", asics[i]->config.vis_vram_size);
 			json_object_set_string(json_object(as), "vbios_version", asics[i]->config.vbios_version);
+			{
+				// decoded once per device, see umr_pp_cache_get()
+				const struct umr_pp_cache *pp = umr_pp_cache_get(asics[i], 0);
+				if (pp && pp->have_vbios) {
+					json_object_set_string(json_object(as), "vbios_name", (const char *)pp->vbios.name);
+					json_object_set_string(json_object(as), "vbios_pn", (const char *)pp->vbios.vbios_pn);
+					json_object_set_string(json_object(as), "vbios_date", (const char *)pp->vbios.date);
+				}
+			}
 			JSON_Value *fws = json_value_init_array();
 			j = 0;
 			while (asics[i]->config.fw[j].name[0] != '\0') {
@@ -2375,6 +3259,20 @@ JSON_Value *umr_process_json_request(JSON_Object *request, void **raw_data, unsi
 			}
 			json_object_set_value(json_object(as), "firmwares", fws);
 
+			/* Time spent bringing up the device, per startup phase */
+			{
+				JSON_Value *timing = json_value_init_object();
+				for (j = 0; j < UMR_TIMING_MAX; j++) {
+					JSON_Value *ph = json_value_init_object();
+					json_object_set_number(json_object(ph), "ms", asics[i]->startup_timing.phase[j].ns / 1000000.0);
+					json_object_set_number(json_object(ph), "calls", asics[i]->startup_timing.phase[j].calls);
+					json_object_set_number(json_object(ph), "files", asics[i]->startup_timing.phase[j].files);
+					json_object_set_number(json_object(ph), "bytes", asics[i]->startup_timing.phase[j].bytes);
+					json_object_set_value(json_object(timing), umr_timing_phase_name(j), ph);
+				}
+				json_object_set_value(json_object(as), "timing", timing);
+			}
+
 			/* Discover the rings */
 			{
 				JSON_Value *rings = json_value_init_array();
@@ -2430,6 +3328,89 @@ JSON_Value *umr_process_json_request(JSON_Object *request, void **raw_data, unsi
 		}
 	} else if (strcmp(command, "ping") == 0) {
 		answer = json_value_init_object();
+	} else if (strcmp(command, "wire-format") == 0) {
+		// replies come in the framing of their request (see wire.h), this
+		// only tells the client the binary one is understood
+		const char *format = json_object_get_string(request, "format");
+
+		answer = json_value_init_object();
+		json_object_set_string(json_object(answer), "format",
+			(format && !strcmp(format, "binary")) ? "binary" : "json");
+	} else if (strcmp(command, "subscribe") == 0) {
+		JSON_Object *source = json_object_get_object(request, "source");
+		const char *name = json_object_get_string(request, "name");
+		const char *source_command = json_object_get_string(source, "command");
+		int period_ms = json_object_get_number(request, "period_ms");
+		bool ok = false;
+
+		for (size_t i = 0; source_command && i < ARRAY_SIZE(subscribable_commands) && !ok; i++)
+			ok = strcmp(source_command, subscribable_commands[i]) == 0;
+		if (!ok || !name || json_object_has_value(source, "set")) {
+			last_error = "cannot subscribe to this request";
+			goto error;
+		}
+
+		int64_t now = time_ns();
+		struct subscriber *s = subscriber_get(json_object_get_number(request, "subscriber"), true, now);
+		if (!s) {
+			last_error = "unknown subscriber";
+			goto error;
+		}
+
+		/* the source reads the asic of the subscription */
+		JSON_Value *src_request = json_value_deep_copy(json_object_get_wrapping_value(source));
+		if (asc && !json_object_has_value(json_object(src_request), "asic"))
+			json_object_set_value(json_object(src_request), "asic",
+				json_value_deep_copy(json_object_get_wrapping_value(asc)));
+
+		struct subscription **psub = &s->subs, *sub;
+		while (*psub && strcmp((*psub)->name, name))
+			psub = &(*psub)->next;
+		if (*psub) {
+			sub = *psub;
+			*psub = sub->next;
+			subscription_free(sub);
+		}
+		sub = calloc(1, sizeof *sub);
+		sub->name = strdup(name);
+		sub->source = subscription_source_get(src_request);
+		sub->period_ns = (int64_t)(period_ms < SUBSCRIPTION_MIN_PERIOD_MS ? SUBSCRIPTION_MIN_PERIOD_MS : period_ms) * 1000000;
+		sub->next_ns = now;
+		sub->changes_only = json_object_get_boolean(request, "changes_only") == 1;
+		sub->next = s->subs;
+		s->subs = sub;
+		json_value_free(src_request);
+
+		answer = json_value_init_object();
+		json_object_set_number(json_object(answer), "subscriber", s->id);
+		json_object_set_string(json_object(answer), "name", name);
+	} else if (strcmp(command, "unsubscribe") == 0) {
+		const char *name = json_object_get_string(request, "name");
+		struct subscriber *s = subscriber_get(json_object_get_number(request, "subscriber"), false, time_ns());
+		if (!s) {
+			last_error = "unknown subscriber";
+			goto error;
+		}
+
+		struct subscription **psub = &s->subs;
+		while (*psub && name && strcmp((*psub)->name, name))
+			psub = &(*psub)->next;
+		if (*psub) {
+			struct subscription *sub = *psub;
+			*psub = sub->next;
+			subscription_free(sub);
+		}
+		answer = json_value_init_object();
+	} else if (strcmp(command, "updates") == 0) {
+		int64_t now = time_ns();
+		struct subscriber *s = subscriber_get(json_object_get_number(request, "subscriber"), false, now);
+		if (!s) {
+			last_error = "unknown subscriber";
+			goto error;
+		}
+
+		answer = json_value_init_object();
+		subscriber_updates(s, json_object(answer), now);
 	} else if (strcmp(command, "read") == 0) {
 		const char *block = json_object_get_string(request, "block");
 		struct umr_reg *r = umr_find_reg_data_by_ip(
@@ -2456,104 +3437,55 @@ JSON_Value *umr_process_json_request(JSON_Object *request, void **raw_data, unsi
 			json_object_set_value(json_object(answer), "value", values);
 		}
 	} else if (strcmp(command, "accumulate") == 0) {
-		JSON_Array *regs = json_object_get_array(request, "registers");
-		const int num_reg = json_array_get_count(regs);
-		char *ipname = (char*) json_object_get_string(request, "block");
-		struct umr_reg **reg = malloc(num_reg * sizeof(struct umr_reg*));
-		for (int i = 0; i < num_reg; i++) {
-			reg[i] = umr_find_reg_data_by_ip(asic, ipname, json_array_get_string(regs, i));
-			if (!reg[i]) {
-				printf("Inconsistent state detected: server and client disagree on ASIC definition.\n");
-				free(reg);
-				goto error;
-			}
-		}
+		struct accumulate_session *as = accumulate_begin(asic, request, &last_error);
+		if (!as)
+			goto error;
 
 		answer = json_value_init_object();
-		int step_ms = json_object_get_number(request, "step_ms");
-		int period_ms = json_object_get_number(request, "period");
-		unsigned *counters = calloc(32 * num_reg, sizeof(unsigned));
-
-		/* Disable GFXOFF */
-		if (asic->fd.gfxoff >= 0) {
-			uint32_t value = 0;
-			value = write(asic->fd.gfxoff, &value, sizeof(value));
-		}
-
-		/* Get our ID. */
-		char *dev_name = get_asic_devname(asic);
-
-		JSON_Array *pids = get_active_amdgpu_clients(asic);
-		/* Read fdinfo for each client. */
-		JSON_Value *start = json_value_init_object();
-		for (size_t i = 0; i < json_array_get_count(pids); i++) {
-			JSON_Object *pid = json_object(json_array_get_value(pids, i));
-			read_fdinfo(start, pid, dev_name);
-		}
-		char *content_before =
-			read_file_a(SYSFS_PATH_DEBUG_DRI "%d/amdgpu_fence_info", asic->instance);
-
-		struct timespec req, rem;
-		int steps = period_ms / step_ms;
-		for (int i = 0; i < steps; i++) {
-			req.tv_sec = 0;
-			req.tv_nsec = step_ms * 1000000;
-
-			for (int j = 0; j < num_reg; j++) {
-				uint64_t value = (uint64_t)asic->reg_funcs.read_reg(asic,
-																	reg[j]->addr * (reg[j]->type == REG_MMIO ? 4 : 1),
-																	reg[j]->type);
-				for (int k = 0; k < reg[j]->no_bits; k++) {
-					uint64_t v = umr_bitslice_reg_quiet(asic, reg[j], reg[j]->bits[k].regname, value);
-					counters[32 * j + k] += (unsigned)v;
+		if (json_object_get_boolean(request, "stream") == 1) {
+			/* partial counters are returned by "accumulate-poll", the
+			 * oldest session goes if clients left too many behind */
+			pthread_mutex_lock(&accumulate_lock);
+			struct accumulate_session **pas = &accumulate_sessions;
+			for (int n = 1; *pas && (*pas)->next; n++) {
+				if (n == ACCUMULATE_MAX_SESSIONS - 1) {
+					JSON_Value *dropped = json_value_init_object();
+					accumulate_end((*pas)->next, json_object(dropped));
+					json_value_free(dropped);
+					(*pas)->next = NULL;
+					break;
 				}
+				pas = &(*pas)->next;
 			}
-
-			while (nanosleep(&req, &rem) == EINTR) {
-				req = rem;
-			}
+			as->next = accumulate_sessions;
+			accumulate_sessions = as;
+			json_object_set_number(json_object(answer), "id", as->id);
+			accumulate_values(as, json_object(answer));
+			pthread_mutex_unlock(&accumulate_lock);
+		} else {
+			umr_reg_sampler_wait(as->sampler);
+			accumulate_end(as, json_object(answer));
 		}
-
-		/* Read fdinfo for each client. */
-		JSON_Value *end = json_value_init_object();
-		for (size_t i = 0; i < json_array_get_count(pids); i++) {
-			JSON_Object *pid = json_object(json_array_get_value(pids, i));
-			read_fdinfo(end, pid, dev_name);
+	} else if (strcmp(command, "accumulate-poll") == 0) {
+		int id = json_object_get_number(request, "id");
+		pthread_mutex_lock(&accumulate_lock);
+		struct accumulate_session **pas = &accumulate_sessions;
+		while (*pas && (*pas)->id != id)
+			pas = &(*pas)->next;
+		if (!*pas) {
+			pthread_mutex_unlock(&accumulate_lock);
+			last_error = "unknown accumulate id";
+			goto error;
 		}
 
-		free(dev_name);
-
-		/* Re-enable GFXOFF */
-		if (asic->fd.gfxoff >= 0) {
-			uint32_t value = 1;
-			value = write(asic->fd.gfxoff, &value, sizeof(value));
+		answer = json_value_init_object();
+		json_object_set_number(json_object(answer), "id", id);
+		if (accumulate_values(*pas, json_object(answer)) || json_object_get_boolean(request, "stop") == 1) {
+			struct accumulate_session *as = *pas;
+			*pas = as->next;
+			accumulate_end(as, json_object(answer));
 		}
-
-		JSON_Value *fences = compare_fence_infos(
-			content_before,
-			read_file("/sys/kernel/debug/dri/%d/amdgpu_fence_info", asic->instance));
-		free(content_before);
-		json_object_set_value(json_object(answer), "fences", fences);
-
-		JSON_Value *values = json_value_init_array();
-		for (int j = 0; j < num_reg; j++) {
-			JSON_Value *regvalue = json_value_init_array();
-			for (int k = 0; k < reg[j]->no_bits; k++) {
-				JSON_Value *v = json_value_init_object();
-				json_object_set_string(json_object(v), "name", reg[j]->bits[k].regname);
-				json_object_set_number(json_object(v), "counter", counters[num_reg * j + k]);
-				json_array_append_value(json_array(regvalue), v);
-			}
-			json_array_append_value(json_array(values), regvalue);
-		}
-		json_object_set_value(json_object(answer), "values", values);
-		JSON_Object *fdinfo = json_object(json_value_init_object());
-		json_object_set_value(json_object(answer), "fdinfo", json_object_get_wrapping_value(fdinfo));
-		json_object_set_value(fdinfo, "start", start);
-		json_object_set_value(fdinfo, "end", end);
-		json_value_free(json_array_get_wrapping_value(pids));
-		free(counters);
-		free(reg);
+		pthread_mutex_unlock(&accumulate_lock);
 	} else if (strcmp(command, "write") == 0) {
 		struct umr_reg *r = umr_find_reg_data_by_ip(
 			asic, json_object_get_string(request, "block"), json_object_get_string(request, "register"));
@@ -2567,10 +3499,67 @@ JSON_Value *umr_process_json_request(JSON_Object *request, void **raw_data, unsi
 
 		char *block = (char*) json_object_get_string(request, "block");
 		unsigned value = json_object_get_number(request, "value");
-		if (umr_write_reg_by_name_by_ip(asic, block, r->regname, value)) {
+		JSON_Array *fields = json_object_get_array(request, "fields");
+		if (fields) {
+			/* only the edited fields, merged into the current value */
+			size_t n = json_array_get_count(fields), i;
+			struct umr_field_update *u = calloc(n ? n : 1, sizeof *u);
+			for (i = 0; i < n; i++) {
+				JSON_Object *f = json_array_get_object(fields, i);
+				u[i].reg = r;
+				u[i].bitname = json_object_get_string(f, "name");
+				u[i].value = json_object_get_number(f, "value");
+				u[i].use_bank = asic->options.use_bank;
+				u[i].bank = asic->options.bank;
+			}
+			if (!n)
+				value = umr_read_reg_by_name_by_ip(asic, block, r->regname);
+			else if (umr_write_fields(asic, u, n, UMR_WRITE_FIELDS_VERIFY) >= 0)
+				value = u[0].result;
+			else
+				value = umr_read_reg_by_name_by_ip(asic, block, r->regname);
+			free(u);
+		} else if (umr_write_reg_by_name_by_ip(asic, block, r->regname, value)) {
 			value = umr_read_reg_by_name_by_ip(asic, block, r->regname);
 		}
 		json_object_set_number(json_object(answer), "value", value);
+	} else if (strcmp(command, "vm-read") == 0 && json_object_has_value(request, "pages")) {
+		/* A list of 4KB pages (see the memory debug panel) returned back to
+		 * back, adjacent pages are read together.  A page that can't be read
+		 * is returned as zeros and listed in "failed". */
+		JSON_Array *pages = json_object_get_array(request, "pages");
+		JSON_Value *vmidv = json_object_get_value(request, "vmid");
+		uint32_t vmid = UMR_LINEAR_HUB;
+		size_t n = json_array_get_count(pages), i, j, k;
+		uint64_t addr;
+		if (vmidv)
+			vmid = json_number(vmidv);
+
+		uint8_t *buf = calloc(n ? n : 1, VM_READ_PAGE_SIZE);
+		JSON_Value *failed = json_value_init_array();
+
+		asic->mem_funcs.vm_message = dummy_printf;
+		umr_vm_context_begin(asic);
+		for (i = 0; i < n; i = j) {
+			addr = (uint64_t)json_array_get_number(pages, i) & ~(uint64_t)(VM_READ_PAGE_SIZE - 1);
+			for (j = i + 1; j < n; j++) {
+				if ((uint64_t)json_array_get_number(pages, j) != addr + (j - i) * VM_READ_PAGE_SIZE)
+					break;
+			}
+			if (umr_read_vram(asic, asic->options.vm_partition, vmid, addr,
+					  (j - i) * VM_READ_PAGE_SIZE, buf + i * VM_READ_PAGE_SIZE)) {
+				memset(buf + i * VM_READ_PAGE_SIZE, 0, (j - i) * VM_READ_PAGE_SIZE);
+				for (k = i; k < j; k++)
+					json_array_append_number(json_array(failed), json_array_get_number(pages, k));
+			}
+		}
+		umr_vm_context_end(asic);
+		asic->mem_funcs.vm_message = NULL;
+
+		answer = json_value_init_object();
+		*raw_data = buf;
+		*raw_data_size = n * VM_READ_PAGE_SIZE;
+		json_object_set_value(json_object(answer), "failed", failed);
 	} else if (strcmp(command, "vm-read") == 0 || strcmp(command, "vm-decode") == 0) {
 		uint64_t address = json_object_get_number(request, "address");
 		JSON_Value *vmidv = json_object_get_value(request, "vmid");
@@ -2632,14 +3621,15 @@ JSON_Value *umr_process_json_request(JSON_Object *request, void **raw_data, unsi
 		int capture_gprs = json_object_get_boolean(request, "capture_gprs");
 		strcpy(asic->options.ring_name, json_object_get_string(request, "ring"));
 
-		if (disable_gfxoff && asic->fd.gfxoff >= 0) {
-			uint32_t value = 0;
-			value = write(asic->fd.gfxoff, &value, sizeof(value));
-		}
+		if (disable_gfxoff)
+			umr_gfxoff_hold(asic);
 
 		asic->options.verbose = 0;
 		asic->options.skip_gprs = !capture_gprs;
 
+		/* the client replaces all of its waves */
+		memset(&step_snapshot[asic_idx], 0, sizeof step_snapshot[asic_idx]);
+
 		int ring_is_halted = umr_sq_cmd_halt_waves(asic, UMR_SQ_CMD_HALT, 100) == 0;
 
 		if (ring_is_halted) {
@@ -2652,10 +3642,8 @@ JSON_Value *umr_process_json_request(JSON_Object *request, void **raw_data, unsi
 		if (resume_waves)
 			umr_sq_cmd_halt_waves(asic, UMR_SQ_CMD_RESUME, 0);
 
-		if (disable_gfxoff && asic->fd.gfxoff >= 0) {
-			uint32_t value = 1;
-			value = write(asic->fd.gfxoff, &value, sizeof(value));
-		}
+		if (disable_gfxoff)
+			umr_gfxoff_release(asic);
 
 		if (!ring_is_halted) {
 			last_error = "Failed to halt the ring (or GPU is idle?)";
@@ -2669,6 +3657,7 @@ JSON_Value *umr_process_json_request(JSON_Object *request, void **raw_data, unsi
 		unsigned wgp = (unsigned)json_object_get_number(request, "wgp");
 		unsigned simd_id = (unsigned)json_object_get_number(request, "simd_id");
 		unsigned wave_id = (unsigned)json_object_get_number(request, "wave_id");
+		int incremental = json_object_get_boolean(request, "incremental") == 1;
 
 		asic->options.skip_gprs = 0;
 		asic->options.verbose = 0;
@@ -2694,10 +3683,17 @@ JSON_Value *umr_process_json_request(JSON_Object *request, void **raw_data, unsi
 		answer = json_value_init_object();
 
 		if (r == 1) {
-			JSON_Value *shaders = json_value_init_object();
-			JSON_Value *wave = wave_to_json(asic, &wd, 1, /* todo: stream */NULL, shaders);
-			json_object_set_value(json_object(answer), "wave", wave);
-			json_object_set_value(json_object(answer), "shaders", shaders);
+			struct umr_wave_delta delta;
+
+			umr_wave_snapshot_update(asic, &step_snapshot[asic_idx], &wd, &delta);
+			if (incremental) {
+				json_object_set_value(json_object(answer), "wave_delta", wave_delta_to_json(asic, &wd, &delta));
+			} else {
+				JSON_Value *shaders = json_value_init_object();
+				JSON_Value *wave = wave_to_json(asic, &wd, 1, /* todo: stream */NULL, shaders);
+				json_object_set_value(json_object(answer), "wave", wave);
+				json_object_set_value(json_object(answer), "shaders", shaders);
+			}
 		}
 	} else if (strcmp(command, "resume-waves") == 0) {
 		strcpy(asic->options.ring_name, json_object_get_string(request, "ring"));
@@ -2705,16 +3701,14 @@ JSON_Value *umr_process_json_request(JSON_Object *request, void **raw_data, unsi
 		answer = json_value_init_object();
 	} else if (strcmp(command, "ring") == 0) {
 		char *ring_name = (char*)json_object_get_string(request, "ring");
-		uint32_t wptr, rptr, drv_wptr, ringsize, value, *ring_data;
+		uint32_t wptr, rptr, drv_wptr, ringsize, *ring_data;
 		int halt_waves = json_object_get_boolean(request, "halt_waves");
 		enum umr_ring_type rt;
 		asic->options.halt_waves = halt_waves;
 		strcpy(asic->options.ring_name, ring_name);
 
 		/* Disable gfxoff */
-		value = 0;
-		if (asic->fd.gfxoff >= 0)
-			value = write(asic->fd.gfxoff, &value, sizeof(value));
+		umr_gfxoff_hold(asic);
 
 		if (halt_waves)
 			umr_sq_cmd_halt_waves(asic, UMR_SQ_CMD_HALT, 100);
@@ -2818,9 +3812,7 @@ JSON_Value *umr_process_json_request(JSON_Object *request, void **raw_data, unsi
 		if (halt_waves)
 			umr_sq_cmd_halt_waves(asic, UMR_SQ_CMD_RESUME, 0);
 		/* Reenable gfxoff */
-		value = 1;
-		if (asic->fd.gfxoff >= 0)
-			value = write(asic->fd.gfxoff, &value, sizeof(value));
+		umr_gfxoff_release(asic);
 
 	} else if (strcmp(command, "power") == 0) {
 		const char *profiles[] = {
@@ -2844,7 +3836,7 @@ JSON_Value *umr_process_json_request(JSON_Object *request, void **raw_data, unsi
 		char path[512];
 		sprintf(path, SYSFS_PATH_DRM "card%d/device/power_dpm_force_performance_level", asic->instance);
 		if (!write) {
-			char *content = read_file(path);
+			char *content = read_asic_file(asic, "%s", path);
 			size_t s = strlen(content);
 
 			if (s > 0 && content[s - 1] == '\n')
@@ -2876,7 +3868,7 @@ JSON_Value *umr_process_json_request(JSON_Object *request, void **raw_data, unsi
 			{NULL, 0, 0, 0},
 		};
 		answer = json_value_init_object();
-		if (asic->fd.sensors) {
+		if (asic->fd.sensors >= 0) {
 			uint32_t gpu_power_data[32];
 			JSON_Array *values = json_array(json_value_init_array());
 			for (int i = 0; p_info[i].regname; i++){
@@ -2935,12 +3927,12 @@ JSON_Value *umr_process_json_request(JSON_Object *request, void **raw_data, unsi
 		};
 		answer = json_value_init_object();
 		for (size_t i = 0; i < ARRAY_SIZE(int_attr); i++) {
-			uint64_t v = read_sysfs_uint64(SYSFS_PATH_DRM "card%d/device/power/runtime_%s",
+			uint64_t v = read_asic_uint64(asic, SYSFS_PATH_DRM "card%d/device/power/runtime_%s",
 													 asic->instance, int_attr[i]);
 			json_object_set_number(json_object(answer), int_attr[i], (double)v);
 		}
 		for (size_t i = 0; i < ARRAY_SIZE(str_attr); i++) {
-			const char *s = read_file(SYSFS_PATH_DRM "card%d/device/power/%s",
+			const char *s = read_asic_file(asic, SYSFS_PATH_DRM "card%d/device/power/%s",
 											  asic->instance, str_attr[i]);
 			size_t len = strlen(s);
 			if (len > 0) {
@@ -3008,7 +4000,7 @@ JSON_Value *umr_process_json_request(JSON_Object *request, void **raw_data, unsi
 						JSON_Object *hwmon = json_object(json_value_init_object());
 						/* Read fan1 data */
 						for (int i = 0; i < 4 && r == i; i++) {
-							r += sscanf(read_file("%s/%s/%s", dname, dir->d_name, files[i]),
+							r += sscanf(read_asic_file(asic, "%s/%s/%s", dname, dir->d_name, files[i]),
 											"%d", &values[i]);
 						}
 						if (r == 4) {
@@ -3030,12 +4022,12 @@ JSON_Value *umr_process_json_request(JSON_Object *request, void **raw_data, unsi
 						/* Read temp data */
 						for (int i = 1;; i++) {
 							int r = 0;
-							r += sscanf(read_file("%s/%s/temp%d_input", dname, dir->d_name, i),
+							r += sscanf(read_asic_file(asic, "%s/%s/temp%d_input", dname, dir->d_name, i),
 											"%d", &values[0]);
-							r += sscanf(read_file("%s/%s/temp%d_crit", dname, dir->d_name, i),
+							r += sscanf(read_asic_file(asic, "%s/%s/temp%d_crit", dname, dir->d_name, i),
 											"%d", &values[1]);
 							if (r == 2) {
-								const char *label = read_file("%s/%s/temp%d_label", dname, dir->d_name, i);
+								const char *label = read_asic_file(asic, "%s/%s/temp%d_label", dname, dir->d_name, i);
 
 								JSON_Object *temp = json_object(json_value_init_object());
 								json_object_set_string_with_len(temp, "label", label, strlen(label) - 1);
@@ -3063,7 +4055,7 @@ JSON_Value *umr_process_json_request(JSON_Object *request, void **raw_data, unsi
 		char path[512];
 		sprintf(path, SYSFS_PATH_DRM "card%d/device/pp_features", asic->instance);
 		if (!json_object_has_value(request, "set")) {
-			char *content = read_file(path);
+			char *content = read_asic_file(asic, "%s", path);
 			if (content && strlen(content) > 1) {
 				answer = json_object_get_wrapping_value(parse_pp_features_sysfs_file(content));
 			} else {
@@ -3097,22 +4089,48 @@ JSON_Value *umr_process_json_request(JSON_Object *request, void **raw_data, unsi
 			JSON_Value *m = json_value_init_object();
 			for (int j = 0; suffixes[j]; j++) {
 				sprintf(path, SYSFS_PATH_DRM "card%d/device/mem_info_%s_%s", asic->instance, names[i], suffixes[j]);
-				uint64_t v = read_sysfs_uint64(path);
+				uint64_t v = read_asic_uint64(asic, "%s", path);
 				json_object_set_number(json_object(m), suffixes[j], v);
 			}
 			json_object_set_value(json_object(answer), names[i], m);
 		}
 
-		json_object_set_value(json_object(answer), "apps",  json_array_get_wrapping_value(get_bo_infos(asic)));
+		JSON_Array *apps = get_bo_infos(asic);
+		if (apps) {
+			uint64_t base;
+			uint64_t generation = gem_snapshot_update(asic, apps, json_object_get_boolean(request, "delta") == 1, &base);
+			json_object_set_number(json_object(answer), "generation", generation);
+			if (base)
+				json_object_set_number(json_object(answer), "base", base);
+			json_object_set_value(json_object(answer), "apps", json_array_get_wrapping_value(apps));
+		}
 	} else if (!strcmp(command, "drm-counters")) {
 		uint64_t values[3] = { 0 };
-		umr_query_drm(asic, 0x0f /* AMDGPU_INFO_NUM_BYTES_MOVED */, &values[0], sizeof(values[0]));
-		umr_query_drm(asic, 0x18 /* AMDGPU_INFO_NUM_EVICTIONS */, &values[1], sizeof(values[0]));
-		umr_query_drm(asic, 0x1E /* AMDGPU_INFO_NUM_VRAM_CPU_PAGE_FAULTS */, &values[2], sizeof(values[0]));
+		struct umr_drm_query q[3] = {
+			{ 0x0f /* AMDGPU_INFO_NUM_BYTES_MOVED */, 0, &values[0], sizeof(values[0]), 0 },
+			{ 0x18 /* AMDGPU_INFO_NUM_EVICTIONS */, 0, &values[1], sizeof(values[0]), 0 },
+			{ 0x1E /* AMDGPU_INFO_NUM_VRAM_CPU_PAGE_FAULTS */, 0, &values[2], sizeof(values[0]), 0 },
+		};
+		umr_query_drm_batch(asic, q, 3);
 		answer = json_value_init_object();
 		json_object_set_number(json_object(answer), "bytes-moved", (double)values[0]);
 		json_object_set_number(json_object(answer), "num-evictions", (double)values[1]);
 		json_object_set_number(json_object(answer), "cpu-page-faults", (double)values[2]);
+	} else if (!strcmp(command, "io-stats")) {
+		struct umr_io_stats st;
+
+		umr_io_stats_get(asic, &st);
+		answer = json_value_init_object();
+		for (int i = 0; i < UMR_IO_MAX; i++) {
+			JSON_Value *c = json_value_init_object();
+			json_object_set_number(json_object(c), "reads", (double)st.cls[i].reads);
+			json_object_set_number(json_object(c), "writes", (double)st.cls[i].writes);
+			json_object_set_number(json_object(c), "ioctls", (double)st.cls[i].ioctls);
+			json_object_set_number(json_object(c), "bytes-read", (double)st.cls[i].bytes_read);
+			json_object_set_number(json_object(c), "bytes-written", (double)st.cls[i].bytes_written);
+			json_object_set_number(json_object(c), "ms", st.cls[i].ns / 1000000.0);
+			json_object_set_value(json_object(answer), umr_io_class_name(i), c);
+		}
 	} else if (!strcmp(command, "evict")) {
 		int type = json_object_get_number(request, "type");
 		const char *mem = type == 0 ? "vram" : "gtt";
@@ -3169,6 +4187,8 @@ JSON_Value *umr_process_json_request(JSON_Object *request, void **raw_data, unsi
 
 		if (__sensor_data) {
 			pthread_mutex_lock(&__sensor_data->mtx);
+			if (__sensor_data->raw)
+				raw_trace_collect(__sensor_data);
 			if (__sensor_data->event_buffer) {
 				*raw_data = __sensor_data->event_buffer;
 				*raw_data_size = __sensor_data->event_buffer_size;
@@ -3213,15 +4233,20 @@ JSON_Value *umr_process_json_request(JSON_Object *request, void **raw_data, unsi
 	} else if (!strcmp(command, "peak-bo")) {
 		answer = json_value_init_object();
 
+		/* A live view asks for a smaller frame or only the changed tiles. */
+		int max_width = json_object_get_number(request, "max_width");
+		bool delta = json_object_get_boolean(request, "delta") == 1;
 		char *error;
 		if (json_object_has_value(request, "handle"))
 			error = peak_bo_using_metadata(asic, json_object_get_number(request, "pid"),
 										   json_object_get_number(request, "gpu-fd"),
 										   json_object_get_number(request, "handle"),
+										   max_width, delta,
 										   answer, raw_data, raw_data_size);
 		else if (json_object_has_value(request, "metadata"))
 			error = peak_bo_using_fb_metadata(asic,
 											  json_object(json_object_get_value(request, "metadata")),
+											  max_width, delta,
 											  answer, raw_data, raw_data_size);
 		else
 			error = "Invalid peak-bo request";
@@ -3237,9 +4262,15 @@ JSON_Value *umr_process_json_request(JSON_Object *request, void **raw_data, unsi
 	}
 
 	JSON_Value *out = json_value_init_object();
+	if (cache_key) {
+		response_cache_store(command, cache_key, answer, *raw_data, *raw_data_size, ttl_ms, etag);
+		json_free_serialized_string(cache_key);
+		json_object_set_string(json_object(out), "etag", etag);
+	}
 	json_object_set_value(json_object(out), "answer", answer);
 	json_object_set_value(json_object(out), "request", json_object_get_wrapping_value(request));
 	json_object_set_boolean(json_object(out), "has_raw_data", *raw_data != NULL && *raw_data_size);
+	pthread_mutex_unlock(lock);
 	return out;
 
 error:
@@ -3247,5 +4278,8 @@ error:
 	json_object_set_string(json_object(answer), "error", last_error);
 	json_object_set_value(json_object(answer), "request", json_object_get_wrapping_value(request));
 	json_object_set_boolean(json_object(answer), "has_raw_data", false);
+	if (lock)
+		pthread_mutex_unlock(lock);
+	json_free_serialized_string(cache_key);
 	return answer;
 }
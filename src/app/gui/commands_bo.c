@@ -69,75 +69,6 @@ const char *fullscreen_fs =
 	"  fragColor = texture(tex, texcoord);\n"
    "}";
 
-static
-void* read_gl_tex_as_rgba(GLuint texture, int width, int height) {
-	GLuint fbo = 0, tex = 0, vao = 0, fs = 0, vs = 0, prog = 0;
-	void *pixels = NULL;
-
-	glGenTextures(1, &tex);
-
-	/* Create a FBO */
-	glGenFramebuffers(1, &fbo);
-	glBindTexture(GL_TEXTURE_2D, tex);
-	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0);
-
-	fs = glCreateShader(GL_FRAGMENT_SHADER);
-	vs = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(fs, 1, &fullscreen_fs, NULL);
-	glShaderSource(vs, 1, &fullscreen_vs, NULL);
-	glCompileShader(fs);
-	glCompileShader(vs);
-	prog = glCreateProgram();
-	glAttachShader(prog, fs);
-	glAttachShader(prog, vs);
-
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-
-	glLinkProgram(prog);
-
-	if (glGetError() != GL_NO_ERROR)
-		goto end;
-
-	glUseProgram(prog);
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texture);
-	glUniform1i(glGetUniformLocation(prog, "tex"), 0);
-
-	glViewport(0, 0, width, height);
-
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-
-	pixels = malloc(width * height * 4);
-
-	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-end:
-	if (vao)
-		glDeleteVertexArrays(1, &vao);
-	if (fbo)
-		glDeleteFramebuffers(1, &fbo);
-	if (tex)
-		glDeleteTextures(1, &tex);
-	if (fs)
-		glDeleteShader(fs);
-	if (vs)
-		glDeleteShader(vs);
-	if (prog)
-		glDeleteProgram(prog);
-
-	return pixels;
-}
-
 static void read_size_from_md(struct umr_asic *asic, unsigned *metadata,
 							  int *width, int *height)
 {
@@ -213,18 +144,70 @@ static void check_peak_bo_metadata(struct umr_asic *asic, int gpu_fd, int bo_cou
 	}
 }
 
-static char * peak_bo(struct umr_asic *asic, int dmabuf_fd,
-				      int width, int height, unsigned fourcc,
-				      uint64_t modifier, int nplanes,
-				      unsigned *offsets, unsigned *pitches,
-				      void **raw_data, unsigned *size)
+/* An imported buffer object and the texture it is copied to, kept while
+ * the same buffer object is asked for again: a live view only pays for
+ * the copy and the readback.  The key is the one of peak_bo_encode(), the
+ * inode of the dma-buf tells a GEM handle reused for another BO apart. */
+#define PEAK_BO_MAX_IMAGES 8
+
+struct peak_bo_image {
+	char key[64];
+	ino_t ino;
+	uint64_t modifier;
+	unsigned fourcc;
+	int width, height, levels;
+	EGLImage image;
+	GLuint tex[2];	/* the external texture of image, the copy */
+	uint64_t last_use;
+
+	/* readback of the last frame, see peak_bo_readback_start() */
+	GLuint pbo;
+	GLsync fence;	/* signaled when pbo holds the frame, NULL if none is pending */
+	int pbo_width, pbo_height;
+};
+
+/* EGL state of an asic, kept from one peak-bo request to the next: a live
+ * view asks for a frame many times per second. */
+struct peak_bo_egl {
+	char pci_name[32];
+	int fd;
+	struct gbm_device *gbm;
+	EGLDisplay display;
+	EGLContext context;
+	PFNGLEGLIMAGETARGETTEXTURE2DOESPROC image_target_texture_2d;
+	pthread_mutex_t lock; /* the context is current in one thread at a time */
+
+	struct peak_bo_image images[PEAK_BO_MAX_IMAGES];
+	uint64_t use_clock;
+
+	/* what read_gl_tex_as_rgba() draws with, made on first use */
+	GLuint prog, vao, fbo, rgba_tex;
+	int rgba_width, rgba_height;
+
+	struct peak_bo_egl *next;
+};
+
+static pthread_mutex_t peak_bo_egl_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct peak_bo_egl *peak_bo_egls;
+
+static struct peak_bo_egl *peak_bo_egl_get(struct umr_asic *asic, char **error)
 {
+	struct peak_bo_egl *egl;
 	char pci_path[512];
+
+	pthread_mutex_lock(&peak_bo_egl_lock);
+	for (egl = peak_bo_egls; egl; egl = egl->next) {
+		if (!strcmp(egl->pci_name, asic->options.pci.name))
+			goto out;
+	}
+
+	egl = calloc(1, sizeof(*egl));
+	snprintf(egl->pci_name, sizeof(egl->pci_name), "%s", asic->options.pci.name);
 	sprintf(pci_path, "/dev/dri/by-path/pci-%s-render", asic->options.pci.name);
-	int fd = open(pci_path, O_RDWR | O_CLOEXEC);
-	struct gbm_device *gbm = gbm_create_device(fd);
-	EGLDisplay display = eglGetPlatformDisplay (EGL_PLATFORM_GBM_MESA, gbm, NULL);
-	eglInitialize(display, NULL, NULL);
+	egl->fd = open(pci_path, O_RDWR | O_CLOEXEC);
+	egl->gbm = gbm_create_device(egl->fd);
+	egl->display = eglGetPlatformDisplay(EGL_PLATFORM_GBM_MESA, egl->gbm, NULL);
+	eglInitialize(egl->display, NULL, NULL);
 	EGLConfig config;
 	EGLint num_config;
 	EGLint const attribute_list_config[] = {
@@ -233,20 +216,165 @@ static char * peak_bo(struct umr_asic *asic, int dmabuf_fd,
 		EGL_BLUE_SIZE, 8,
 		EGL_NONE
 	};
-	eglChooseConfig(display, attribute_list_config, &config, 1, &num_config);
+	eglChooseConfig(egl->display, attribute_list_config, &config, 1, &num_config);
 	eglBindAPI(EGL_OPENGL_ES_API);
 	EGLint const attrib_list[] = {
 		EGL_CONTEXT_MAJOR_VERSION, 3,
 		EGL_NONE
 	};
-	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, attrib_list);
-	if (context == EGL_NO_CONTEXT) {
-		gbm_device_destroy(gbm);
-		close(fd);
-		return "EGL init failure";
+	egl->context = eglCreateContext(egl->display, config, EGL_NO_CONTEXT, attrib_list);
+	if (egl->context == EGL_NO_CONTEXT) {
+		eglTerminate(egl->display);
+		gbm_device_destroy(egl->gbm);
+		close(egl->fd);
+		free(egl);
+		egl = NULL;
+		*error = "EGL init failure";
+		goto out;
+	}
+	egl->image_target_texture_2d =
+		(PFNGLEGLIMAGETARGETTEXTURE2DOESPROC)eglGetProcAddress("glEGLImageTargetTexture2DOES");
+	pthread_mutex_init(&egl->lock, NULL);
+
+	egl->next = peak_bo_egls;
+	peak_bo_egls = egl;
+out:
+	pthread_mutex_unlock(&peak_bo_egl_lock);
+	return egl;
+}
+
+/* Draws texture as RGBA into pbo.  The context of egl must be current. */
+static int read_gl_tex_as_rgba(struct peak_bo_egl *egl, GLuint texture, int width, int height, GLuint pbo) {
+	GLuint fs, vs;
+
+	if (!egl->prog) {
+		fs = glCreateShader(GL_FRAGMENT_SHADER);
+		vs = glCreateShader(GL_VERTEX_SHADER);
+		glShaderSource(fs, 1, &fullscreen_fs, NULL);
+		glShaderSource(vs, 1, &fullscreen_vs, NULL);
+		glCompileShader(fs);
+		glCompileShader(vs);
+		egl->prog = glCreateProgram();
+		glAttachShader(egl->prog, fs);
+		glAttachShader(egl->prog, vs);
+		glLinkProgram(egl->prog);
+		/* the program keeps them */
+		glDeleteShader(fs);
+		glDeleteShader(vs);
+		glGenVertexArrays(1, &egl->vao);
+		glGenFramebuffers(1, &egl->fbo);
+		if (glGetError() != GL_NO_ERROR) {
+			glDeleteVertexArrays(1, &egl->vao);
+			glDeleteFramebuffers(1, &egl->fbo);
+			glDeleteProgram(egl->prog);
+			egl->prog = egl->vao = egl->fbo = 0;
+			return -1;
+		}
+	}
+
+	/* Only made again when the size of the frame changes. */
+	if (!egl->rgba_tex || egl->rgba_width != width || egl->rgba_height != height) {
+		if (egl->rgba_tex)
+			glDeleteTextures(1, &egl->rgba_tex);
+		glGenTextures(1, &egl->rgba_tex);
+		glBindTexture(GL_TEXTURE_2D, egl->rgba_tex);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindFramebuffer(GL_FRAMEBUFFER, egl->fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, egl->rgba_tex, 0);
+		if (glGetError() != GL_NO_ERROR) {
+			glDeleteTextures(1, &egl->rgba_tex);
+			egl->rgba_tex = 0;
+			return -1;
+		}
+		egl->rgba_width = width;
+		egl->rgba_height = height;
 	}
 
-	eglMakeCurrent (display, EGL_NO_SURFACE, EGL_NO_SURFACE, context);
+	glBindFramebuffer(GL_FRAMEBUFFER, egl->fbo);
+	glBindVertexArray(egl->vao);
+	glUseProgram(egl->prog);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glUniform1i(glGetUniformLocation(egl->prog, "tex"), 0);
+
+	glViewport(0, 0, width, height);
+
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+	/* Into the buffer: the call returns before the GPU is done. */
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	return glGetError() == GL_NO_ERROR ? 0 : -1;
+}
+
+static void peak_bo_image_drop(struct peak_bo_egl *egl, struct peak_bo_image *img)
+{
+	if (img->fence)
+		glDeleteSync(img->fence);
+	if (img->pbo)
+		glDeleteBuffers(1, &img->pbo);
+	if (img->tex[0])
+		glDeleteTextures(2, img->tex);
+	if (img->image != EGL_NO_IMAGE)
+		eglDestroyImage(egl->display, img->image);
+	memset(img, 0, sizeof(*img));
+}
+
+/**
+ * peak_bo_image_get - The imported buffer object and its copy texture
+ *
+ * @key: See peak_bo_encode()
+ * @levels: The number of mipmap levels of the copy
+ *
+ * A cached image is returned if the same buffer object was imported with
+ * the same layout, otherwise the least recently used slot is imported
+ * again.  The context of @egl must be current.
+ */
+static struct peak_bo_image *peak_bo_image_get(struct peak_bo_egl *egl, const char *key, int dmabuf_fd,
+					       int width, int height, unsigned fourcc,
+					       uint64_t modifier, int nplanes,
+					       unsigned *offsets, unsigned *pitches,
+					       int levels, char **error)
+{
+	struct peak_bo_image *img = NULL;
+	struct stat st;
+	int i;
+
+	if (fstat(dmabuf_fd, &st)) {
+		*error = "fstat of the dmabuf failed";
+		return NULL;
+	}
+
+	for (i = 0; i < PEAK_BO_MAX_IMAGES; i++) {
+		struct peak_bo_image *c = &egl->images[i];
+		if (c->tex[0] && !strcmp(c->key, key) && c->ino == st.st_ino &&
+		    c->modifier == modifier && c->fourcc == fourcc &&
+		    c->width == width && c->height == height && c->levels == levels) {
+			c->last_use = ++egl->use_clock;
+			return c;
+		}
+	}
+
+	/* the same source with another layout, a free slot or the oldest */
+	for (i = 0; i < PEAK_BO_MAX_IMAGES; i++) {
+		struct peak_bo_image *c = &egl->images[i];
+		if (c->tex[0] && !strcmp(c->key, key)) {
+			img = c;
+			break;
+		}
+		if (!img || (img->tex[0] && (!c->tex[0] || c->last_use < img->last_use)))
+			img = c;
+	}
+	peak_bo_image_drop(egl, img);
 
 	const int base_attrib_cnt = 3;
 	const int per_plane_attrib_cnt = 5;
@@ -286,13 +414,13 @@ static char * peak_bo(struct umr_asic *asic, int dmabuf_fd,
 	}
 	attrs[nattrib++] = EGL_NONE;
 
-	EGLImage image = eglCreateImage(display,
+	img->image = eglCreateImage(egl->display,
 		NULL,
 		EGL_LINUX_DMA_BUF_EXT,
 		(EGLClientBuffer)NULL,
 		attrs);
 
-	if (image == EGL_NO_IMAGE) {
+	if (img->image == EGL_NO_IMAGE) {
 		/* The 'modifier' might be incorrect: we get this information from the kernel,
 		 * but if the userspace application doesn't use modifier, amdgpu will infer the
 		 * modifier matching the layout being used.
@@ -302,7 +430,7 @@ static char * peak_bo(struct umr_asic *asic, int dmabuf_fd,
 			/* Remove the modifier attribs. */
 			for (int a = 12; a < nattrib; a++)
 				attrs[a] = EGL_NONE;
-			image = eglCreateImage(display,
+			img->image = eglCreateImage(egl->display,
 				NULL,
 				EGL_LINUX_DMA_BUF_EXT,
 				(EGLClientBuffer)NULL,
@@ -310,75 +438,388 @@ static char * peak_bo(struct umr_asic *asic, int dmabuf_fd,
 		}
 	}
 
-	if (image == EGL_NO_IMAGE)
-		return "EGL failure (unhandled format?)";
-	PFNGLEGLIMAGETARGETTEXTURE2DOESPROC imageTargetTexture2DProc = (PFNGLEGLIMAGETARGETTEXTURE2DOESPROC)eglGetProcAddress("glEGLImageTargetTexture2DOES");
-	if (!imageTargetTexture2DProc)
-	    return "EGL failure (glEGLImageTargetTexture2DOES not available from extension)";
+	if (img->image == EGL_NO_IMAGE) {
+		*error = "EGL failure (unhandled format?)";
+		return NULL;
+	}
+	if (!egl->image_target_texture_2d) {
+		peak_bo_image_drop(egl, img);
+		*error = "EGL failure (glEGLImageTargetTexture2DOES not available from extension)";
+		return NULL;
+	}
 
-	GLuint tex[2];
-	glGenTextures(2, tex);
-	glBindTexture(GL_TEXTURE_EXTERNAL_OES, tex[0]);
-	imageTargetTexture2DProc(GL_TEXTURE_EXTERNAL_OES, image);
+	glGenTextures(2, img->tex);
+	glBindTexture(GL_TEXTURE_EXTERNAL_OES, img->tex[0]);
+	egl->image_target_texture_2d(GL_TEXTURE_EXTERNAL_OES, img->image);
 	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-	glBindTexture(GL_TEXTURE_2D, tex[1]);
+	glBindTexture(GL_TEXTURE_2D, img->tex[1]);
 	if (fourcc == DRM_FORMAT_XRGB2101010) {
-		glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB10, width, height);
+		glTexStorage2D(GL_TEXTURE_2D, levels, GL_RGB10, width, height);
 	} else if (fourcc == DRM_FORMAT_ARGB2101010) {
-		glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB10_A2, width, height);
+		glTexStorage2D(GL_TEXTURE_2D, levels, GL_RGB10_A2, width, height);
 	} else if (fourcc == DRM_FORMAT_XRGB8888) {
-		glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB8, width, height);
+		glTexStorage2D(GL_TEXTURE_2D, levels, GL_RGB8, width, height);
 	} else if (fourcc == DRM_FORMAT_R8) {
-		glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8, width, height);
+		glTexStorage2D(GL_TEXTURE_2D, levels, GL_R8, width, height);
 	} else {
 		/* default is DRM_FORMAT_ARGB8888 */
-		glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+		glTexStorage2D(GL_TEXTURE_2D, levels, GL_RGBA8, width, height);
+	}
+	if (glGetError() != GL_NO_ERROR) {
+		peak_bo_image_drop(egl, img);
+		*error = "glTexStorage2D failed";
+		return NULL;
 	}
-	if (glGetError() != GL_NO_ERROR)
-		return "glTexStorage2D failed";
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-	glCopyImageSubData(tex[0], GL_TEXTURE_EXTERNAL_OES, 0,
-					   0, 0, 0,
-					   tex[1], GL_TEXTURE_2D, 0,
-					   0, 0, 0,
-					   width, height, 1);
-	if (glGetError() != GL_NO_ERROR)
-		return "glCopyImageSubData failed";
+	snprintf(img->key, sizeof(img->key), "%s", key);
+	img->ino = st.st_ino;
+	img->modifier = modifier;
+	img->fourcc = fourcc;
+	img->width = width;
+	img->height = height;
+	img->levels = levels;
+	img->last_use = ++egl->use_clock;
+	return img;
+}
+
+/* How long a readback may take before the request fails, in ns */
+#define PEAK_BO_READBACK_TIMEOUT 2000000000ULL
+
+/**
+ * peak_bo_readback_start - Start reading the copy of an image back
+ *
+ * The copy (img->tex[1]) is drawn as RGBA into the pixel buffer of @img
+ * and a fence is put behind it, nothing waits for the GPU.
+ */
+static int peak_bo_readback_start(struct peak_bo_egl *egl, struct peak_bo_image *img, int width, int height)
+{
+	if (!img->pbo)
+		glGenBuffers(1, &img->pbo);
+	if (img->pbo_width != width || img->pbo_height != height) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, img->pbo);
+		glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 4, NULL, GL_STREAM_READ);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		img->pbo_width = width;
+		img->pbo_height = height;
+	}
+	if (read_gl_tex_as_rgba(egl, img->tex[1], width, height, img->pbo))
+		return -1;
+	img->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	/* so the GPU starts on it before the next request */
+	glFlush();
+	return img->fence ? 0 : -1;
+}
+
+/**
+ * peak_bo_readback_finish - The pixels of the readback pending on an image
+ *
+ * Waits for the fence of peak_bo_readback_start() and copies the pixel
+ * buffer out.  Returns NULL on error or if the GPU did not finish in time.
+ */
+static void *peak_bo_readback_finish(struct peak_bo_image *img)
+{
+	size_t len = (size_t)img->pbo_width * img->pbo_height * 4;
+	void *pixels = NULL, *map;
+	GLenum r;
+
+	if (!img->fence)
+		return NULL;
+	r = glClientWaitSync(img->fence, GL_SYNC_FLUSH_COMMANDS_BIT, PEAK_BO_READBACK_TIMEOUT);
+	glDeleteSync(img->fence);
+	img->fence = NULL;
+	if (r != GL_ALREADY_SIGNALED && r != GL_CONDITION_SATISFIED)
+		return NULL;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, img->pbo);
+	map = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, len, GL_MAP_READ_BIT);
+	if (map) {
+		pixels = malloc(len);
+		if (pixels)
+			memcpy(pixels, map, len);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	return pixels;
+}
+
+/* Frames are sent as QOI images of PEAK_BO_TILE_W x PEAK_BO_TILE_H tiles
+ * (smaller on the right and bottom edges), encoded by several threads.
+ * The hashes of the tiles of the last frame of each source are kept so
+ * that a "delta" request only gets the tiles that changed.
+ */
+#define PEAK_BO_TILE_W 256
+#define PEAK_BO_TILE_H 64
+#define PEAK_BO_MAX_FRAMES 8
+#define PEAK_BO_MAX_THREADS 8
+
+struct peak_bo_frame {
+	char key[64];
+	int width, height;
+	uint64_t *hashes;
+	struct peak_bo_frame *next;
+};
+
+static pthread_mutex_t peak_bo_frames_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct peak_bo_frame *peak_bo_frames;
+
+struct peak_bo_tile {
+	int x, y, w, h;
+	uint64_t hash;
+	void *qoi;
+	int qoi_size;
+};
+
+struct peak_bo_encoder {
+	const uint8_t *pixels;
+	int width;
+	struct peak_bo_tile *tiles;
+	int ntiles;
+	const uint64_t *previous;	/* hashes of the tiles of the last frame */
+	int next_tile;
+};
+
+static void *peak_bo_encode_tiles(void *data)
+{
+	struct peak_bo_encoder *enc = data;
+	int i;
+
+	while ((i = __atomic_fetch_add(&enc->next_tile, 1, __ATOMIC_RELAXED)) < enc->ntiles) {
+		struct peak_bo_tile *t = &enc->tiles[i];
+		uint64_t *rows = malloc((size_t)t->w * t->h * 4 + 8);
+		uint64_t h = 0xcbf29ce484222325ULL;
+
+		/* The hash reads whole words. */
+		rows[(size_t)t->w * t->h / 2] = 0;
+
+		for (int y = 0; y < t->h; y++)
+			memcpy((uint8_t *)rows + (size_t)y * t->w * 4,
+				   enc->pixels + ((size_t)(t->y + y) * enc->width + t->x) * 4, t->w * 4);
+		for (size_t k = 0; k < ((size_t)t->w * t->h + 1) / 2; k++)
+			h = (h ^ rows[k]) * 0x100000001b3ULL;
+		t->hash = h;
+
+		if (!enc->previous || enc->previous[i] != t->hash) {
+			qoi_desc desc = {
+				.width = t->w, .height = t->h, .channels = 4, .colorspace = QOI_LINEAR
+			};
+			t->qoi = qoi_encode(rows, &desc, &t->qoi_size);
+		}
+		free(rows);
+	}
+	return NULL;
+}
+
+/**
+ * peak_bo_encode - Encode the changed tiles of a frame
+ *
+ * @pixels: The RGBA frame
+ * @width, @height: Its size
+ * @key: Identifies the source of the frame
+ * @delta: Whether to only encode the tiles that changed since the last
+ *         frame of @key
+ * @answer: Gets the "tiles" array ([x, y, w, h, size] for each tile sent)
+ *          and "delta" (false if all the tiles were sent)
+ * @raw_data, @size: The QOI images of the tiles sent, one after the other
+ */
+static void peak_bo_encode(const uint8_t *pixels, int width, int height, const char *key, bool delta,
+						   JSON_Value *answer, void **raw_data, unsigned *size)
+{
+	const int tiles_x = (width + PEAK_BO_TILE_W - 1) / PEAK_BO_TILE_W;
+	const int tiles_y = (height + PEAK_BO_TILE_H - 1) / PEAK_BO_TILE_H;
+	struct peak_bo_encoder enc = { pixels, width, NULL, tiles_x * tiles_y, NULL, 0 };
+	struct peak_bo_frame *frame, **pframe;
+	pthread_t threads[PEAK_BO_MAX_THREADS];
+	int nthreads, i, n;
+
+	enc.tiles = calloc(enc.ntiles, sizeof(*enc.tiles));
+	for (i = 0; i < enc.ntiles; i++) {
+		struct peak_bo_tile *t = &enc.tiles[i];
+		t->x = (i % tiles_x) * PEAK_BO_TILE_W;
+		t->y = (i / tiles_x) * PEAK_BO_TILE_H;
+		t->w = width - t->x < PEAK_BO_TILE_W ? width - t->x : PEAK_BO_TILE_W;
+		t->h = height - t->y < PEAK_BO_TILE_H ? height - t->y : PEAK_BO_TILE_H;
+	}
 
-	void *pixels = read_gl_tex_as_rgba(tex[1], width, height);
+	/* Most recently used first. */
+	pthread_mutex_lock(&peak_bo_frames_lock);
+	for (pframe = &peak_bo_frames, n = 0; *pframe && strcmp((*pframe)->key, key); pframe = &(*pframe)->next, n++);
+	frame = *pframe;
+	if (frame) {
+		*pframe = frame->next;
+	} else {
+		frame = calloc(1, sizeof(*frame));
+		snprintf(frame->key, sizeof(frame->key), "%s", key);
+		/* Forget the oldest source. */
+		if (n >= PEAK_BO_MAX_FRAMES) {
+			for (pframe = &peak_bo_frames; (*pframe)->next; pframe = &(*pframe)->next);
+			free((*pframe)->hashes);
+			free(*pframe);
+			*pframe = NULL;
+		}
+	}
+	frame->next = peak_bo_frames;
+	peak_bo_frames = frame;
+
+	delta = delta && frame->hashes && frame->width == width && frame->height == height;
+	if (delta)
+		enc.previous = frame->hashes;
+
+	nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads > PEAK_BO_MAX_THREADS)
+		nthreads = PEAK_BO_MAX_THREADS;
+	if (nthreads > enc.ntiles / 4)
+		nthreads = enc.ntiles / 4;
+	if (nthreads < 1)
+		nthreads = 1;
+	for (i = 1; i < nthreads; i++) {
+		if (pthread_create(&threads[i], NULL, peak_bo_encode_tiles, &enc))
+			break;
+	}
+	nthreads = i;
+	peak_bo_encode_tiles(&enc);
+	for (i = 1; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+
+	free(frame->hashes);
+	frame->hashes = malloc(enc.ntiles * sizeof(*frame->hashes));
+	frame->width = width;
+	frame->height = height;
+	for (i = 0; i < enc.ntiles; i++)
+		frame->hashes[i] = enc.tiles[i].hash;
+	pthread_mutex_unlock(&peak_bo_frames_lock);
+
+	JSON_Value *tiles = json_value_init_array();
+	*size = 0;
+	for (i = 0; i < enc.ntiles; i++)
+		*size += enc.tiles[i].qoi_size;
+	*raw_data = *size ? malloc(*size) : NULL;
+	for (i = 0, n = 0; i < enc.ntiles; i++) {
+		struct peak_bo_tile *t = &enc.tiles[i];
+		if (!t->qoi)
+			continue;
+		json_array_append_number(json_array(tiles), t->x);
+		json_array_append_number(json_array(tiles), t->y);
+		json_array_append_number(json_array(tiles), t->w);
+		json_array_append_number(json_array(tiles), t->h);
+		json_array_append_number(json_array(tiles), t->qoi_size);
+		memcpy((uint8_t *)*raw_data + n, t->qoi, t->qoi_size);
+		n += t->qoi_size;
+		free(t->qoi);
+	}
+	json_object_set_value(json_object(answer), "tiles", tiles);
+	json_object_set_boolean(json_object(answer), "delta", delta);
+	free(enc.tiles);
+}
 
-	eglMakeCurrent (display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
-	eglDestroyImage(display, image);
-	eglTerminate(display);
+/**
+ * peak_bo - Read a buffer object as RGBA pixels
+ *
+ * @max_width: If not 0, the frame is downscaled to be at most this wide
+ * @key, @delta: See peak_bo_encode()
+ *
+ * The buffer object is imported as an EGL image and drawn into an RGBA
+ * texture, which detiles and converts it on the GPU.  Both are kept for
+ * the next request of the same buffer object, see peak_bo_image_get().
+ * The pixels are read back through a pixel buffer and a fence; a @delta
+ * request gets the frame read back for the previous one so it does not
+ * wait for the GPU.  @answer gets the size of the frame ("width" and
+ * "height") and of the buffer object ("source_width" and "source_height").
+ */
+static char * peak_bo(struct umr_asic *asic, int dmabuf_fd,
+				      int width, int height, unsigned fourcc,
+				      uint64_t modifier, int nplanes,
+				      unsigned *offsets, unsigned *pitches,
+				      int max_width, const char *key, bool delta,
+				      JSON_Value *answer, void **raw_data, unsigned *size)
+{
+	char *error = NULL;
+	struct peak_bo_egl *egl = peak_bo_egl_get(asic, &error);
+	if (!egl)
+		return error;
+
+	/* Downscale on the GPU, through mipmaps. */
+	int out_width = width, out_height = height, levels = 1;
+	if (max_width > 0 && max_width < width) {
+		out_width = max_width;
+		out_height = (int)((int64_t)height * max_width / width);
+		if (out_height < 1)
+			out_height = 1;
+		while ((out_width << levels) < width)
+			levels++;
+	}
 
-	gbm_device_destroy(gbm);
-	close(fd);
+	pthread_mutex_lock(&egl->lock);
+	eglMakeCurrent(egl->display, EGL_NO_SURFACE, EGL_NO_SURFACE, egl->context);
 
+	void *pixels = NULL;
+	struct peak_bo_image *img = peak_bo_image_get(egl, key, dmabuf_fd, width, height, fourcc,
+						      modifier, nplanes, offsets, pitches, levels, &error);
+	if (!img)
+		goto out;
+
+	/* A live view gets the frame the last request started reading back
+	 * (done by now, the GPU had the time the answer took) and this
+	 * request's frame is read back for the next one. */
+	bool pipelined = delta && img->fence &&
+			 img->pbo_width == out_width && img->pbo_height == out_height;
+	if (pipelined) {
+		pixels = peak_bo_readback_finish(img);
+	} else if (img->fence) {
+		glDeleteSync(img->fence);
+		img->fence = NULL;
+	}
+
+	glCopyImageSubData(img->tex[0], GL_TEXTURE_EXTERNAL_OES, 0,
+					   0, 0, 0,
+					   img->tex[1], GL_TEXTURE_2D, 0,
+					   0, 0, 0,
+					   width, height, 1);
 	if (glGetError() != GL_NO_ERROR) {
-		free(pixels);
-		return "Error while downloading the pixels";
+		peak_bo_image_drop(egl, img);
+		error = "glCopyImageSubData failed";
+		goto out;
+	}
+	if (levels > 1) {
+		glBindTexture(GL_TEXTURE_2D, img->tex[1]);
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+
+	if (peak_bo_readback_start(egl, img, out_width, out_height)) {
+		error = "Error while downloading the pixels";
+		goto out;
+	}
+	/* the first frame of a view, or the previous readback failed */
+	if (!pixels)
+		pixels = peak_bo_readback_finish(img);
+
+	if (!pixels) {
+		error = "Error while downloading the pixels";
 	} else {
-		int out_len;
-		qoi_desc desc;
-		desc.width = width;
-		desc.height = height;
-		desc.channels = 4;
-		desc.colorspace = QOI_LINEAR;
-		*raw_data = qoi_encode(pixels, &desc, &out_len);
-		*size = out_len;
+		json_object_set_number(json_object(answer), "width", out_width);
+		json_object_set_number(json_object(answer), "height", out_height);
+		json_object_set_number(json_object(answer), "source_width", width);
+		json_object_set_number(json_object(answer), "source_height", height);
 	}
 
+out:
+	eglMakeCurrent(egl->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	pthread_mutex_unlock(&egl->lock);
+
+	/* The encoding doesn't need the context. */
+	if (!error)
+		peak_bo_encode(pixels, out_width, out_height, key, delta, answer, raw_data, size);
 	free(pixels);
-	return NULL;
+	return error;
 }
 
 static
 char * peak_bo_using_metadata(struct umr_asic *asic, unsigned pid, int remote_gpu_fd, unsigned kms_handle,
+							  int max_width, bool delta,
 							  JSON_Value *answer, void **raw_data, unsigned *size)
 {
 	uint64_t modifier;
@@ -455,16 +896,16 @@ char * peak_bo_using_metadata(struct umr_asic *asic, unsigned pid, int remote_gp
 		}
 	}
 
+	char key[64];
+	sprintf(key, "bo:%u:%d:%u", pid, remote_gpu_fd, kms_handle);
+
 	void *error = NULL;
 	error = peak_bo(asic, dmabuf_fd,
 					width, height, fourcc, modifier,
 					nplanes,
 					offsets, pitches,
-					raw_data, size);
-	if (error == NULL) {
-		json_object_set_number(json_object(answer), "width", width);
-		json_object_set_number(json_object(answer), "height", height);
-	}
+					max_width, key, delta,
+					answer, raw_data, size);
 	close(dmabuf_fd);
 	close(gpu_fd);
 	close(pid_fd);
@@ -473,6 +914,7 @@ char * peak_bo_using_metadata(struct umr_asic *asic, unsigned pid, int remote_gp
 
 static
 char * peak_bo_using_fb_metadata(struct umr_asic *asic, JSON_Object *md,
+								 int max_width, bool delta,
 								 JSON_Value *answer, void **raw_data, unsigned *size)
 {
 	int gpu_fd;
@@ -515,20 +957,18 @@ char * peak_bo_using_fb_metadata(struct umr_asic *asic, JSON_Object *md,
 	for (size_t i = 0; i < json_array_get_count(j_pitches); i++)
 		pitches[i] = (int) json_array_get_number(j_pitches, i);
 
+	char key[64];
+	sprintf(key, "fb:%d:%d", (int) json_object_get_number(md, "pid"), (int) json_object_get_number(md, "fb_id"));
+
 	void *error;
 	error = peak_bo(asic, dmabuf_fd,
 					width, height, fourcc, modifier,
 					nplanes,
 					offsets, pitches,
-					raw_data, size);
-	close(dmabuf_fd);
-	close(gpu_fd);
-	close(pid_fd);
-
-	if (error == NULL) {
-		json_object_set_number(json_object(answer), "width", width);
-		json_object_set_number(json_object(answer), "height", height);
-	}
+					max_width, key, delta,
+					answer, raw_data, size);
+	drmCloseBufferHandle(gpu_fd, fb2->handles[0]);
+	drmModeFreeFB2(fb2);
 	close(dmabuf_fd);
 	close(gpu_fd);
 	close(pid_fd);
@@ -548,7 +988,7 @@ char * get_bo_md_using_fb_id(struct umr_asic *asic, unsigned pid, int fb_id,
 	if (pid_fd < 0)
 		return "SYS_pidfd_open failed";
 
-	int remote_gpu_fds_count = find_amdgpu_fd(pid, asic->options.pci.name, remote_gpu_fd, 1, NULL);
+	int remote_gpu_fds_count = find_amdgpu_fd(asic, pid, remote_gpu_fd, 1, NULL);
 	if (remote_gpu_fds_count == 0)
 		return "Couldn't find amdgpu fd";
 
@@ -0,0 +1,497 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * amdgpu_gem_info / amdgpu_vm_info parsing, included by commands.c.
+ *
+ * Both files list the drm clients ("pid ... command ...:" lines) followed
+ * by one line per buffer object.  They are parsed in a single pass into
+ * gem_client / gem_bo arrays, then turned into the "apps" JSON the GUI
+ * knows about:
+ *
+ *   apps: [ { pid, command, clients: [ { key, bos: [ { handle, size, attributes, ino } ] } ] } ]
+ *
+ * "key" identifies a client across reads of the files: the pid of its
+ * section and the index of that section among the ones of this pid.
+ *
+ * memory-usage requests with "delta" set only get what changed since the
+ * previous memory-usage answer for the same asic (see gem_snapshot_update()).
+ */
+
+/* Flags printed after the size of a buffer object. */
+static const char *gem_bo_flag_names[] = {
+	"GTT", "CPU_ACCESS_REQUIRED", "VRAM_CLEARED", "VRAM", "CPU_GTT_USWC",
+	"VRAM VISIBLE", "NONE", "DOORBELL", "CPU", "UNKNOWN", "EXPLICIT_SYNC",
+	"VM_ALWAYS_VALID", "VRAM_CONTIGUOUS", "NO_CPU_ACCESS",
+};
+#define GEM_BO_FLAG_VRAM_VISIBLE	(1u << 5)
+
+struct gem_bo {
+	uint64_t size;
+	uint32_t handle;
+	uint32_t flags;		/* bit i is gem_bo_flag_names[i] */
+	uint32_t pin_count;	/* 0 if not pinned */
+	uint32_t exported_ino, imported_ino; /* 0 if not exported/imported */
+};
+
+struct gem_client {
+	uint32_t pid;
+	uint32_t section;	/* index among the sections of this pid */
+	char command[64];	/* as printed, see gem_info_to_json() */
+	size_t first_bo, nbos;
+};
+
+struct gem_info {
+	struct gem_client *clients;
+	size_t nclients, max_clients;
+	struct gem_bo *bos;
+	size_t nbos, max_bos;
+};
+
+static void gem_info_free(struct gem_info *gi)
+{
+	free(gi->clients);
+	free(gi->bos);
+	memset(gi, 0, sizeof(*gi));
+}
+
+/* Next word of a line (NUL terminated), words are separated by spaces. */
+static const char *gem_next_word(const char *p, size_t *len)
+{
+	while (*p == ' ' || *p == '\t')
+		p++;
+	*len = strcspn(p, " \t");
+	return p;
+}
+
+static void gem_parse_bo_flags(const char *p, struct gem_bo *bo)
+{
+	size_t len;
+
+	for (p = gem_next_word(p, &len); len; p = gem_next_word(p + len, &len)) {
+		if (len == 3 && !strncmp(p, "pin", 3)) {
+			p = gem_next_word(p + len, &len);
+			if (len == 5 && !strncmp(p, "count", 5))
+				bo->pin_count = strtoul(p + len, NULL, 10);
+		} else if (len == 8 && (!strncmp(p, "exported", 8) || !strncmp(p, "imported", 8))) {
+			uint32_t *ino = p[0] == 'e' ? &bo->exported_ino : &bo->imported_ino;
+			/* "exported as ino:%lu" / "imported from ino:%lu" */
+			p = gem_next_word(p + len, &len);
+			p = gem_next_word(p + len, &len);
+			if (!strncmp(p, "ino:", 4))
+				*ino = strtoul(p + 4, NULL, 10);
+		} else {
+			for (size_t i = 0; i < ARRAY_SIZE(gem_bo_flag_names); i++) {
+				if (strlen(gem_bo_flag_names[i]) == len && !strncmp(p, gem_bo_flag_names[i], len)) {
+					bo->flags |= 1u << i;
+					break;
+				}
+			}
+			/* "VRAM VISIBLE" counts as both. */
+			if (len == 4 && !strncmp(p, "VRAM", 4)) {
+				const char *q = gem_next_word(p + len, &len);
+				if (len == 7 && !strncmp(q, "VISIBLE", 7)) {
+					bo->flags |= GEM_BO_FLAG_VRAM_VISIBLE;
+					p = q;
+				} else {
+					len = 4;
+				}
+			}
+		}
+	}
+}
+
+/* Parse the "pid" line @line starting a client, false if it's malformed. */
+static bool gem_parse_client(const char *line, bool is_vm_info, struct gem_client *c)
+{
+	const char *cursor, *end;
+	const char *cmd_prefix = is_vm_info ? "Process:" : "command ";
+	const char *cmd_end = is_vm_info ? " ----------" : ":";
+
+	cursor = line + 3;
+	if (is_vm_info) {
+		if (*cursor != ':')
+			return false;
+		cursor++;
+	}
+	memset(c, 0, sizeof(*c));
+	c->pid = strtoul(cursor, NULL, 10);
+
+	/* vm_info uses the tid, not the pid. */
+	if (is_vm_info)
+		c->pid = get_tgid_for_tid(c->pid);
+
+	cursor = strstr(cursor, cmd_prefix);
+	if (cursor) {
+		cursor += strlen(cmd_prefix);
+		end = strstr(cursor, cmd_end);
+		if (!end)
+			end = cursor + strlen(cursor);
+		snprintf(c->command, sizeof(c->command), "%.*s", (int)(end - cursor), cursor);
+	}
+	return true;
+}
+
+/**
+ * gem_info_parse - Parse amdgpu_gem_info or amdgpu_vm_info
+ *
+ * @gi: Where to add the clients and buffer objects
+ * @content: The file content, modified by the parsing
+ * @is_vm_info: Whether @content comes from amdgpu_vm_info
+ *
+ * Returns 0 on success, -1 if @content doesn't look like either file.
+ */
+static int gem_info_parse(struct gem_info *gi, char *content, bool is_vm_info)
+{
+	struct gem_client *client = NULL;
+	char *line, *next;
+
+	for (line = content; line && *line; line = next) {
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+
+		if (!strncmp(line, "pid", 3)) {
+			if (gi->nclients == gi->max_clients) {
+				gi->max_clients = gi->max_clients ? gi->max_clients * 2 : 32;
+				gi->clients = realloc(gi->clients, gi->max_clients * sizeof(*gi->clients));
+			}
+			client = &gi->clients[gi->nclients];
+			if (!gem_parse_client(line, is_vm_info, client))
+				return -1;
+			client->first_bo = gi->nbos;
+			for (size_t i = 0; i < gi->nclients; i++) {
+				if (gi->clients[i].pid == client->pid)
+					client->section++;
+			}
+			gi->nclients++;
+			continue;
+		}
+
+		const char *cursor = line;
+		while (*cursor == ' ' || *cursor == '\t')
+			cursor++;
+		if (!*cursor)
+			continue;
+		if (!client) {
+			printf("Incorrect line start '%s'. Aborting\n", line);
+			return -1;
+		}
+		/* Only buffer object lines matter within a client. */
+		if (cursor[0] != '0' || cursor[1] != 'x')
+			continue;
+
+		struct gem_bo bo = { 0 };
+		char *end;
+
+		bo.handle = strtoul(cursor, &end, 16);
+		if (*end != ':')
+			continue;
+		bo.size = strtoull(end + 1, &end, 10);
+		gem_parse_bo_flags(end, &bo);
+
+		if (gi->nbos == gi->max_bos) {
+			gi->max_bos = gi->max_bos ? gi->max_bos * 2 : 1024;
+			gi->bos = realloc(gi->bos, gi->max_bos * sizeof(*gi->bos));
+		}
+		gi->bos[gi->nbos++] = bo;
+		client->nbos++;
+	}
+	return 0;
+}
+
+static JSON_Value *gem_bo_to_json(const struct gem_bo *b)
+{
+	JSON_Value *bo = json_value_init_object();
+	JSON_Value *attr = json_value_init_object();
+
+	json_object_set_number(json_object(bo), "handle", b->handle);
+	json_object_set_number(json_object(bo), "size", b->size);
+
+	if (b->pin_count)
+		json_object_set_number(json_object(attr), "pin count", b->pin_count);
+	for (size_t i = 0; i < ARRAY_SIZE(gem_bo_flag_names); i++) {
+		if (b->flags & (1u << i))
+			json_object_set_number(json_object(attr), gem_bo_flag_names[i], 1);
+	}
+	if (b->exported_ino)
+		json_object_set_number(json_object(attr), "exported as ino", b->exported_ino);
+	if (b->imported_ino)
+		json_object_set_number(json_object(attr), "imported from ino", b->imported_ino);
+
+	json_object_set_value(json_object(bo), "attributes", attr);
+	if (b->exported_ino)
+		json_object_set_number(json_object(bo), "ino", b->exported_ino);
+	return bo;
+}
+
+/**
+ * gem_info_to_json - Group the clients of @gi by process
+ *
+ * @gi: The parsed file
+ * @with_bos: Whether to add the buffer objects of each client
+ *
+ * Clients without buffer objects are left out.  The command of an app is
+ * read from /proc/<pid>/comm, falling back to the one printed in the file.
+ */
+static JSON_Array *gem_info_to_json(const struct gem_info *gi, bool with_bos)
+{
+	JSON_Array *apps = json_array(json_value_init_array());
+	uint32_t *app_pids = calloc(gi->nclients + 1, sizeof(*app_pids));
+	size_t napps = 0;
+
+	for (size_t i = 0; i < gi->nclients; i++) {
+		const struct gem_client *c = &gi->clients[i];
+		JSON_Object *app = NULL;
+
+		if (!c->nbos)
+			continue;
+
+		for (size_t j = 0; j < napps && !app; j++) {
+			if (app_pids[j] == c->pid)
+				app = json_array_get_object(apps, j);
+		}
+		if (!app) {
+			app = json_object(json_value_init_object());
+			json_object_set_number(app, "pid", c->pid);
+
+			const char *cmd = read_file("/proc/%d/comm", c->pid);
+			if (cmd && strlen(cmd))
+				json_object_set_string_with_len(app, "command", cmd, strlen(cmd) - 1);
+			else
+				json_object_set_string(app, "command", c->command);
+			json_object_set_value(app, "clients", json_value_init_array());
+			json_array_append_value(apps, json_object_get_wrapping_value(app));
+			app_pids[napps++] = c->pid;
+		}
+
+		JSON_Object *client = json_object(json_value_init_object());
+		json_object_set_number(client, "key", (double)(((uint64_t)c->pid << 16) | c->section));
+		if (with_bos) {
+			JSON_Array *bos = json_array(json_value_init_array());
+			for (size_t k = 0; k < c->nbos; k++)
+				json_array_append_value(bos, gem_bo_to_json(&gi->bos[c->first_bo + k]));
+			json_object_set_value(client, "bos", json_array_get_wrapping_value(bos));
+		}
+		json_array_append_value(json_object_get_array(app, "clients"),
+								json_object_get_wrapping_value(client));
+	}
+	free(app_pids);
+	return apps;
+}
+
+JSON_Array *parse_buffer_object_info(char *content, bool is_vm_info)
+{
+	struct gem_info gi = { 0 };
+	JSON_Array *apps = NULL;
+
+	if (gem_info_parse(&gi, content, is_vm_info) == 0)
+		apps = gem_info_to_json(&gi, true);
+	gem_info_free(&gi);
+	return apps;
+}
+
+/* The buffer objects of the last memory-usage answer of an asic. */
+struct gem_snapshot_bo {
+	uint64_t client_key;
+	uint64_t hash;		/* of the bo JSON, 0 for an empty slot */
+	uint32_t handle;
+};
+
+struct gem_snapshot {
+	int instance;
+	uint64_t generation;
+	struct gem_snapshot_bo *bos;	/* open addressing */
+	size_t size;			/* a power of 2 */
+	struct gem_snapshot *next;
+};
+
+static pthread_mutex_t gem_snapshots_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct gem_snapshot *gem_snapshots;
+
+static uint64_t gem_hash_bytes(uint64_t h, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+	for (size_t i = 0; i < len; i++)
+		h = (h ^ p[i]) * 0x100000001b3ULL;
+	return h;
+}
+
+static uint64_t gem_bo_hash(JSON_Object *bo)
+{
+	JSON_Object *attr = json_object_get_object(bo, "attributes");
+	uint64_t h = 0xcbf29ce484222325ULL;
+	double v[3] = {
+		json_object_get_number(bo, "size"),
+		json_object_get_number(bo, "ino"),
+		json_object_get_number(bo, "has_metadata"),
+	};
+
+	h = gem_hash_bytes(h, v, sizeof(v));
+	for (size_t i = 0; i < json_object_get_count(attr); i++) {
+		const char *name = json_object_get_name(attr, i);
+		double n = json_number(json_object_get_value_at(attr, i));
+		h = gem_hash_bytes(h, name, strlen(name));
+		h = gem_hash_bytes(h, &n, sizeof(n));
+	}
+	return h ? h : 1;
+}
+
+static struct gem_snapshot_bo *gem_snapshot_slot(struct gem_snapshot_bo *bos, size_t size,
+												 uint64_t client_key, uint32_t handle)
+{
+	size_t i = (client_key * 0x9e3779b97f4a7c15ULL ^ handle * 0xff51afd7ed558ccdULL) & (size - 1);
+
+	while (bos[i].hash && (bos[i].client_key != client_key || bos[i].handle != handle))
+		i = (i + 1) & (size - 1);
+	return &bos[i];
+}
+
+struct gem_client_ref {
+	uint64_t key;
+	JSON_Object *client;
+};
+
+static int gem_client_ref_cmp(const void *a, const void *b)
+{
+	const struct gem_client_ref *x = a, *y = b;
+	return x->key < y->key ? -1 : x->key > y->key;
+}
+
+/**
+ * gem_snapshot_update - Remember the buffer objects of @apps for @asic
+ *
+ * @asic: The asic @apps were read from
+ * @apps: The output of get_bo_infos()
+ * @delta: Whether to reduce @apps to the changes since the previous call
+ * @base: Set to the generation the changes apply to
+ *
+ * With @delta, the "bos" of each client of @apps only keep the added or
+ * modified buffer objects, and the handles of the removed ones are listed
+ * in "removed".  @base is 0 when there is no previous snapshot, @apps is
+ * then left complete.
+ *
+ * Returns the generation of @apps, which only changes with the buffer
+ * objects.
+ */
+uint64_t gem_snapshot_update(struct umr_asic *asic, JSON_Array *apps, bool delta, uint64_t *base)
+{
+	struct gem_snapshot *snap;
+	size_t i, j, k, nbos = 0, size = 64;
+	bool changed;
+
+	pthread_mutex_lock(&gem_snapshots_lock);
+	for (snap = gem_snapshots; snap && snap->instance != asic->instance; snap = snap->next);
+	if (!snap) {
+		snap = calloc(1, sizeof(*snap));
+		snap->instance = asic->instance;
+		snap->next = gem_snapshots;
+		gem_snapshots = snap;
+	}
+	pthread_mutex_unlock(&gem_snapshots_lock);
+
+	for (i = 0; i < json_array_get_count(apps); i++) {
+		JSON_Array *clients = json_object_get_array(json_array_get_object(apps, i), "clients");
+		for (j = 0; j < json_array_get_count(clients); j++)
+			nbos += json_array_get_count(json_object_get_array(json_array_get_object(clients, j), "bos"));
+	}
+	while (size < 2 * nbos)
+		size *= 2;
+
+	struct gem_snapshot_bo *bos = calloc(size, sizeof(*bos));
+	size_t nchanged = 0;
+
+	for (i = 0; i < json_array_get_count(apps); i++) {
+		JSON_Array *clients = json_object_get_array(json_array_get_object(apps, i), "clients");
+		for (j = 0; j < json_array_get_count(clients); j++) {
+			JSON_Object *client = json_array_get_object(clients, j);
+			JSON_Array *client_bos = json_object_get_array(client, "bos");
+			const uint64_t key = json_object_get_number(client, "key");
+			JSON_Array *changes = delta && snap->bos ? json_array(json_value_init_array()) : NULL;
+
+			for (k = 0; k < json_array_get_count(client_bos); k++) {
+				JSON_Object *bo = json_array_get_object(client_bos, k);
+				const uint32_t handle = json_object_get_number(bo, "handle");
+				struct gem_snapshot_bo *s = gem_snapshot_slot(bos, size, key, handle);
+
+				s->client_key = key;
+				s->handle = handle;
+				s->hash = gem_bo_hash(bo);
+
+				const struct gem_snapshot_bo *old = snap->bos ?
+					gem_snapshot_slot(snap->bos, snap->size, key, handle) : NULL;
+				if (old && old->hash == s->hash)
+					continue;
+				nchanged++;
+				if (changes)
+					json_array_append_value(changes, json_value_deep_copy(json_object_get_wrapping_value(bo)));
+			}
+			if (changes)
+				json_object_set_value(client, "bos", json_array_get_wrapping_value(changes));
+		}
+	}
+
+	/* Removed buffer objects, reported to their client if it's still there. */
+	struct gem_client_ref *refs = NULL;
+	size_t nrefs = 0;
+	if (delta && snap->bos) {
+		for (i = 0; i < json_array_get_count(apps); i++)
+			nrefs += json_array_get_count(json_object_get_array(json_array_get_object(apps, i), "clients"));
+		refs = calloc(nrefs + 1, sizeof(*refs));
+		for (i = 0, k = 0; i < json_array_get_count(apps); i++) {
+			JSON_Array *clients = json_object_get_array(json_array_get_object(apps, i), "clients");
+			for (j = 0; j < json_array_get_count(clients); j++, k++) {
+				refs[k].client = json_array_get_object(clients, j);
+				refs[k].key = json_object_get_number(refs[k].client, "key");
+			}
+		}
+		qsort(refs, nrefs, sizeof(*refs), gem_client_ref_cmp);
+	}
+	for (i = 0; i < snap->size; i++) {
+		const struct gem_snapshot_bo *old = &snap->bos[i];
+		if (!old->hash || gem_snapshot_slot(bos, size, old->client_key, old->handle)->hash)
+			continue;
+		nchanged++;
+		if (!delta)
+			continue;
+		struct gem_client_ref ref = { old->client_key, NULL }, *found =
+			bsearch(&ref, refs, nrefs, sizeof(*refs), gem_client_ref_cmp);
+		if (!found)
+			continue;
+		JSON_Object *client = found->client;
+		if (!json_object_has_value(client, "removed"))
+			json_object_set_value(client, "removed", json_value_init_array());
+		json_array_append_number(json_object_get_array(client, "removed"), old->handle);
+	}
+
+	free(refs);
+
+	changed = nchanged || !snap->bos;
+	*base = delta && snap->bos ? snap->generation : 0;
+	if (changed)
+		snap->generation++;
+	free(snap->bos);
+	snap->bos = bos;
+	snap->size = size;
+	return snap->generation;
+}
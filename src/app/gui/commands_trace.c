@@ -0,0 +1,683 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Binary trace ingestion, included by commands.c.
+ *
+ * Instead of the text trace_pipe each CPU's ring buffer is read from
+ * per_cpu/cpuN/trace_pipe_raw by a thread of its own.  The pages hold the
+ * events in the layout described by events/<system>/<event>/format, which
+ * is parsed once when tracing starts.
+ *
+ * Events are handed to the GUI in the usual read-trace-buffer records
+ * (see parse_one_event()) with TRACE_EVENT_BINARY_FIELDS set in their type
+ * and the fields following in binary form instead of text:
+ *
+ *   int nfields, int nframes
+ *   nfields x { int name_id, int len, then a uint64_t if len < 0 or len bytes }
+ *   nframes x int name_id (the stacktrace, innermost first)
+ *
+ * Field names and stack frames are ids in the "names" array like the task
+ * and process names.
+ */
+#include <poll.h>
+
+#define TRACE_EVENT_BINARY_FIELDS	0x100
+#define RAW_TRACE_MAX_FIELDS		16
+#define RAW_TRACE_KERNEL_STACK		-1
+
+/* ring buffer event header, see include/linux/ring_buffer.h */
+#define RB_TYPE_PADDING		29
+#define RB_TYPE_TIME_EXTEND	30
+#define RB_TYPE_TIME_STAMP	31
+#define RB_TS_SHIFT		27
+#define RB_COMMIT_MASK		((1ULL << 27) - 1)
+#define RB_MISSED_EVENTS	(1ULL << 31)
+#define RB_MISSED_STORED	(1ULL << 30)
+
+enum raw_trace_field_kind {
+	RAW_FIELD_INT,
+	RAW_FIELD_STR,		/* char name[N] */
+	RAW_FIELD_STR_LOC,	/* __data_loc char[] name */
+	RAW_FIELD_ARRAY,	/* anything else, only used by kernel_stack */
+};
+
+struct raw_trace_field {
+	char name[32];
+	int offset, size;
+	bool is_signed;
+	enum raw_trace_field_kind kind;
+	int name_id;
+};
+
+struct raw_trace_format {
+	int id;
+	int event_type;
+	int nfields;
+	struct raw_trace_field fields[RAW_TRACE_MAX_FIELDS];
+};
+
+struct raw_trace_cpu {
+	struct raw_trace *rt;
+	int cpu, fd;
+	pthread_t thread;
+	bool thread_is_valid;
+
+	/* Records not yet collected by read-trace-buffer, under data->mtx. */
+	int8_t *out;
+	int used, capacity;
+	struct {
+		double ts;
+		int offset;
+	} *index;
+	int nindex, index_capacity;
+
+	/* nframes of the last record, -1 if a stack can't be attached to it. */
+	int last_nframes;
+
+	/* ip -> name id of recent stack frames */
+	struct {
+		uint64_t ip;
+		int name_id;
+	} frames[256];
+};
+
+struct raw_trace {
+	struct activity_capture_data *data;
+	int page_size, commit_size, data_offset;
+	int nformats;
+	struct raw_trace_format formats[8];
+	int ncpus;
+	struct raw_trace_cpu *cpus;
+};
+
+/* The events each tracing mode enables, with their type for the GUI. */
+static const struct {
+	int mode;
+	const char *path;
+	int event_type;
+} raw_trace_events[] = {
+	{ 1, "gpu_scheduler/drm_sched_job_queue", 1 },
+	{ 1, "gpu_scheduler/drm_sched_job_run", 2 },
+	{ 1, "gpu_scheduler/drm_sched_job_done", 3 },
+	{ 1, "gpu_scheduler/drm_sched_job_unschedulable", 4 },
+	{ 1, "gpu_scheduler/drm_sched_job_add_dep", 5 },
+	{ 2, "amdgpu/amdgpu_device_wreg", 7 },
+	{ 2, "ftrace/kernel_stack", RAW_TRACE_KERNEL_STACK },
+};
+
+/* /proc/kallsyms, loaded on the first stacktrace */
+static struct {
+	pthread_once_t once;
+	struct {
+		uint64_t addr;
+		int name;
+	} *syms;
+	int nsyms;
+	char *names;
+} kallsyms = { PTHREAD_ONCE_INIT };
+
+static int ksym_cmp(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+static void kallsyms_load(void)
+{
+	char line[512], type, name[256], module[128];
+	unsigned long long addr;
+	int cap = 0, names_used = 0, names_cap = 0, len;
+	FILE *f = fopen("/proc/kallsyms", "r");
+
+	if (!f)
+		return;
+	while (fgets(line, sizeof line, f)) {
+		module[0] = 0;
+		if (sscanf(line, "%llx %c %255s %127s", &addr, &type, name, module) < 3 || !addr)
+			continue;
+		if (tolower(type) != 't' && tolower(type) != 'w')
+			continue;
+		// named like the text trace does
+		if (module[0])
+			sprintf(name + strlen(name), " %.127s", module);
+		len = strlen(name) + 1;
+
+		if (kallsyms.nsyms == cap) {
+			cap = cap ? 2 * cap : 4096;
+			kallsyms.syms = realloc(kallsyms.syms, cap * sizeof(*kallsyms.syms));
+		}
+		if (names_used + len > names_cap) {
+			names_cap = names_cap ? 2 * names_cap : 65536;
+			kallsyms.names = realloc(kallsyms.names, names_cap);
+		}
+		kallsyms.syms[kallsyms.nsyms].addr = addr;
+		kallsyms.syms[kallsyms.nsyms].name = names_used;
+		kallsyms.nsyms++;
+		memcpy(kallsyms.names + names_used, name, len);
+		names_used += len;
+	}
+	fclose(f);
+	qsort(kallsyms.syms, kallsyms.nsyms, sizeof(*kallsyms.syms), ksym_cmp);
+}
+
+static const char *kallsyms_lookup(uint64_t ip)
+{
+	int lo = 0, hi;
+
+	pthread_once(&kallsyms.once, kallsyms_load);
+	hi = kallsyms.nsyms - 1;
+	if (hi < 0 || ip < kallsyms.syms[0].addr)
+		return NULL;
+	// last symbol at or below ip
+	while (lo < hi) {
+		int mid = (lo + hi + 1) / 2;
+		if (kallsyms.syms[mid].addr <= ip)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return kallsyms.names + kallsyms.syms[lo].name;
+}
+
+// "\tfield:unsigned int foo;\toffset:8;\tsize:4;\tsigned:0;"
+static bool raw_trace_parse_field(const char *line, struct raw_trace_field *f)
+{
+	char decl[128], *name, *bracket;
+	int is_signed = 0;
+
+	if (sscanf(line, " field:%127[^;]; offset:%d; size:%d; signed:%d;", decl, &f->offset, &f->size, &is_signed) < 3)
+		return false;
+	f->is_signed = is_signed;
+
+	bracket = strchr(decl, '[');
+	if (strstr(decl, "__data_loc"))
+		f->kind = RAW_FIELD_STR_LOC;
+	else if (bracket && !strncmp(decl, "char", 4))
+		f->kind = RAW_FIELD_STR;
+	else if (bracket)
+		f->kind = RAW_FIELD_ARRAY;
+	else
+		f->kind = RAW_FIELD_INT;
+
+	// the name is the last word, without its dimension
+	if (bracket && f->kind != RAW_FIELD_STR_LOC)
+		*bracket = 0;
+	while (strlen(decl) && isspace(decl[strlen(decl) - 1]))
+		decl[strlen(decl) - 1] = 0;
+	name = strrchr(decl, ' ');
+	name = name ? name + 1 : decl;
+	if ((bracket = strchr(name, '[')))
+		*bracket = 0;
+	snprintf(f->name, sizeof f->name, "%s", name);
+	return true;
+}
+
+static bool raw_trace_parse_format(struct raw_trace *rt, const char *path, int event_type)
+{
+	struct raw_trace_format *fmt = &rt->formats[rt->nformats];
+	struct raw_trace_field field;
+	char *content, *line, *save;
+
+	content = read_file_a(SYSFS_PATH_TRACING "events/%s/format", path);
+	if (!content)
+		return false;
+
+	memset(fmt, 0, sizeof *fmt);
+	fmt->id = -1;
+	fmt->event_type = event_type;
+	for (line = strtok_r(content, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+		if (sscanf(line, "ID: %d", &fmt->id) == 1)
+			continue;
+		if (!raw_trace_parse_field(line, &field) || !strncmp(field.name, "common_", 7))
+			continue;
+		if (fmt->nfields == RAW_TRACE_MAX_FIELDS)
+			break;
+		field.name_id = string_array_lookup_or_push(&rt->data->tasks, field.name, strlen(field.name));
+		fmt->fields[fmt->nfields++] = field;
+	}
+	free(content);
+
+	if (fmt->id < 0)
+		return false;
+	rt->nformats++;
+	return true;
+}
+
+// where the page header keeps the commit count and the events
+static void raw_trace_parse_header_page(struct raw_trace *rt)
+{
+	struct raw_trace_field field;
+	char *content, *line, *save;
+
+	rt->commit_size = 8;
+	rt->data_offset = 16;
+	content = read_file_a(SYSFS_PATH_TRACING "events/header_page");
+	if (!content)
+		return;
+	for (line = strtok_r(content, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+		if (!raw_trace_parse_field(line, &field))
+			continue;
+		if (!strcmp(field.name, "commit"))
+			rt->commit_size = field.size;
+		else if (!strcmp(field.name, "data"))
+			rt->data_offset = field.offset;
+	}
+	free(content);
+}
+
+static int8_t *raw_trace_reserve(struct raw_trace_cpu *c, int size)
+{
+	if (!c->out) {
+		c->capacity = 32768;
+		c->out = malloc(c->capacity);
+	}
+	c->out = ensure_capacity(c->out, &c->capacity, c->used, size);
+	c->used += size;
+	return &c->out[c->used - size];
+}
+
+static void raw_trace_put_int(struct raw_trace_cpu *c, int v)
+{
+	memcpy(raw_trace_reserve(c, 4), &v, 4);
+}
+
+// append the frames of a kernel_stack event to the previous record
+static void raw_trace_add_stack(struct raw_trace_cpu *c, const struct raw_trace_format *fmt,
+				const uint8_t *rec, int len)
+{
+	struct activity_capture_data *data = c->rt->data;
+	const struct raw_trace_field *size_f = NULL, *caller_f = NULL;
+	int i, n = 0, nframes;
+	char name[32];
+
+	if (c->last_nframes < 0)
+		return;
+	for (i = 0; i < fmt->nfields; i++) {
+		if (!strcmp(fmt->fields[i].name, "size"))
+			size_f = &fmt->fields[i];
+		else if (!strcmp(fmt->fields[i].name, "caller"))
+			caller_f = &fmt->fields[i];
+	}
+	if (!size_f || !caller_f || size_f->offset + 4 > len)
+		return;
+	memcpy(&n, rec + size_f->offset, 4);
+	if (n > (len - caller_f->offset) / 8)
+		n = (len - caller_f->offset) / 8;
+
+	memcpy(&nframes, &c->out[c->last_nframes], 4);
+	for (i = 0; i < n; i++) {
+		uint64_t ip;
+		const char *sym;
+		int slot, id;
+
+		memcpy(&ip, rec + caller_f->offset + 8 * i, 8);
+		if (!ip || ip == ~0ULL)
+			break;
+		slot = (ip >> 4) % ARRAY_SIZE(c->frames);
+		if (c->frames[slot].ip == ip) {
+			id = c->frames[slot].name_id;
+		} else {
+			sym = kallsyms_lookup(ip);
+			if (!sym) {
+				sprintf(name, "0x%" PRIx64, ip);
+				sym = name;
+			}
+			id = string_array_lookup_or_push(&data->tasks, (char *)sym, strlen(sym));
+			c->frames[slot].ip = ip;
+			c->frames[slot].name_id = id;
+		}
+		// the tracing code itself isn't interesting
+		if (!strncmp(&data->tasks.strings.ptr[data->tasks.len_off.ptr[id].offset], "trace_event", 11))
+			continue;
+		raw_trace_put_int(c, id);
+		nframes++;
+	}
+	memcpy(&c->out[c->last_nframes], &nframes, 4);
+	// a second stacktrace would belong to another event
+	c->last_nframes = -1;
+}
+
+static void raw_trace_add_event(struct raw_trace_cpu *c, const uint8_t *rec, int len, uint64_t ts_ns)
+{
+	struct activity_capture_data *data = c->rt->data;
+	const struct raw_trace_format *fmt = NULL;
+	struct pid_tgid_mapping *m;
+	uint16_t type;
+	int i, pid, process_name_id, task_name_id, event_type;
+	double ts = ts_ns / 1000000000.0;
+
+	if (len < 8)
+		return;
+	memcpy(&type, rec, 2);
+	for (i = 0; i < c->rt->nformats && !fmt; i++)
+		if (c->rt->formats[i].id == type)
+			fmt = &c->rt->formats[i];
+	if (!fmt)
+		return;
+	if (fmt->event_type == RAW_TRACE_KERNEL_STACK) {
+		raw_trace_add_stack(c, fmt, rec, len);
+		return;
+	}
+
+	memcpy(&pid, rec + 4, 4);
+	m = lookup_pid_mapping(data, pid, NULL, 0);
+	task_name_id = string_array_lookup_or_push(&data->tasks, m->task_name, strlen(m->task_name));
+	process_name_id = string_array_lookup_or_push(&data->tasks, m->process_name, strlen(m->process_name));
+	if (data->verbose)
+		printf("cpu%d %.6f %s-%d type %d\n", c->cpu, ts, m->task_name, pid, fmt->event_type);
+
+	if (c->nindex == c->index_capacity) {
+		c->index_capacity = c->index_capacity ? 2 * c->index_capacity : 256;
+		c->index = realloc(c->index, c->index_capacity * sizeof(*c->index));
+	}
+	c->index[c->nindex].ts = ts;
+	c->index[c->nindex].offset = c->used;
+	c->nindex++;
+
+	event_type = fmt->event_type | TRACE_EVENT_BINARY_FIELDS;
+	raw_trace_put_int(c, task_name_id);
+	raw_trace_put_int(c, process_name_id);
+	raw_trace_put_int(c, pid);
+	raw_trace_put_int(c, m->tgid);
+	memcpy(raw_trace_reserve(c, 8), &ts, 8);
+	raw_trace_put_int(c, event_type);
+	raw_trace_put_int(c, fmt->nfields);
+	c->last_nframes = c->used;
+	raw_trace_put_int(c, 0);
+
+	for (i = 0; i < fmt->nfields; i++) {
+		const struct raw_trace_field *f = &fmt->fields[i];
+		const char *str = NULL;
+		int slen = 0;
+
+		raw_trace_put_int(c, f->name_id);
+		if (f->kind == RAW_FIELD_INT && f->offset + f->size <= len) {
+			uint64_t v = 0;
+
+			memcpy(&v, rec + f->offset, f->size);
+			// sign extend
+			if (f->is_signed && f->size < 8 && (v >> (8 * f->size - 1)) & 1)
+				v |= ~0ULL << (8 * f->size);
+			raw_trace_put_int(c, -1);
+			memcpy(raw_trace_reserve(c, 8), &v, 8);
+			continue;
+		}
+		if (f->kind == RAW_FIELD_STR_LOC && f->offset + 4 <= len) {
+			uint32_t loc;
+
+			memcpy(&loc, rec + f->offset, 4);
+			if ((loc & 0xffff) + (loc >> 16) <= (uint32_t)len) {
+				str = (const char *)rec + (loc & 0xffff);
+				slen = strnlen(str, loc >> 16);
+			}
+		} else if (f->kind == RAW_FIELD_STR && f->offset + f->size <= len) {
+			str = (const char *)rec + f->offset;
+			slen = strnlen(str, f->size);
+		}
+		raw_trace_put_int(c, slen);
+		if (slen)
+			memcpy(raw_trace_reserve(c, slen), str, slen);
+	}
+}
+
+// walk the events of a ring buffer page, see tools/lib/traceevent/kbuffer
+static void raw_trace_parse_page(struct raw_trace_cpu *c, const uint8_t *page, int page_len)
+{
+	struct raw_trace *rt = c->rt;
+	const uint8_t *p, *end;
+	uint64_t ts, commit = 0, size;
+	uint32_t hdr, type_len, delta, len;
+
+	if (page_len < rt->data_offset)
+		return;
+	memcpy(&ts, page, 8);
+	memcpy(&commit, page + 8, rt->commit_size);
+	size = commit & RB_COMMIT_MASK;
+	if (size > (uint64_t)(page_len - rt->data_offset))
+		size = page_len - rt->data_offset;
+
+	if (commit & RB_MISSED_EVENTS) {
+		long missed = 1;
+
+		// the count follows the events if the kernel had room for it
+		if ((commit & RB_MISSED_STORED) && rt->data_offset + size + sizeof(long) <= (uint64_t)page_len)
+			memcpy(&missed, page + rt->data_offset + size, sizeof(long));
+		rt->data->lost_events += missed;
+	}
+
+	p = page + rt->data_offset;
+	end = p + size;
+	while (p + 4 <= end) {
+		memcpy(&hdr, p, 4);
+		p += 4;
+		type_len = hdr & 0x1f;
+		delta = hdr >> 5;
+
+		switch (type_len) {
+			case RB_TYPE_PADDING:
+				// the rest of the page is unused
+				if (!delta || p + 4 > end)
+					return;
+				memcpy(&len, p, 4);
+				ts += delta;
+				p += len;
+				continue;
+			case RB_TYPE_TIME_EXTEND:
+			case RB_TYPE_TIME_STAMP:
+				if (p + 4 > end)
+					return;
+				memcpy(&len, p, 4);
+				p += 4;
+				if (type_len == RB_TYPE_TIME_STAMP)
+					ts = ((uint64_t)len << RB_TS_SHIFT) + delta;
+				else
+					ts += ((uint64_t)len << RB_TS_SHIFT) + delta;
+				continue;
+			case 0:
+				if (p + 4 > end)
+					return;
+				memcpy(&len, p, 4);
+				p += 4;
+				len = (len - 4 + 3) & ~3;
+				break;
+			default:
+				len = type_len * 4;
+				break;
+		}
+		ts += delta;
+		if (len > end - p)
+			return;
+		raw_trace_add_event(c, p, len, ts);
+		p += len;
+	}
+}
+
+static void *raw_trace_cpu_thread(void *in)
+{
+	struct raw_trace_cpu *c = in;
+	struct activity_capture_data *data = c->rt->data;
+	struct pollfd pfd = { .fd = c->fd, .events = POLLIN };
+	uint8_t *page = malloc(c->rt->page_size);
+
+	while (data->run) {
+		ssize_t n = read(c->fd, page, c->rt->page_size);
+
+		if (n <= 0) {
+			if (n < 0 && errno != EAGAIN && errno != EINTR) {
+				printf("cpu%d trace_pipe_raw: %s\n", c->cpu, strerror(errno));
+				break;
+			}
+			// poll only wakes up past buffer_percent, so don't wait too long
+			poll(&pfd, 1, 10);
+			continue;
+		}
+
+		pthread_mutex_lock(&data->mtx);
+		raw_trace_parse_page(c, page, n);
+		pthread_mutex_unlock(&data->mtx);
+	}
+	free(page);
+	return NULL;
+}
+
+/**
+ * raw_trace_collect - Move the records of all CPUs to data->event_buffer
+ * @data: The capture, data->mtx held
+ *
+ * The records are merged in timestamp order since follow up events (e.g.
+ * drm_sched_job_run) are matched with the ones before them.
+ */
+static void raw_trace_collect(struct activity_capture_data *data)
+{
+	struct raw_trace *rt = data->raw;
+	int *next = calloc(rt->ncpus, sizeof(int));
+	int8_t *out = NULL;
+	int used = 0, capacity = 0, total = 0, i;
+
+	for (i = 0; i < rt->ncpus; i++)
+		total += rt->cpus[i].used;
+	if (!total || data->event_buffer) {
+		free(next);
+		return;
+	}
+	capacity = total + 1;
+	out = malloc(capacity);
+
+	for (;;) {
+		struct raw_trace_cpu *c, *best = NULL;
+		int end;
+
+		for (i = 0; i < rt->ncpus; i++) {
+			c = &rt->cpus[i];
+			if (next[i] < c->nindex &&
+			    (!best || c->index[next[i]].ts < best->index[next[best - rt->cpus]].ts))
+				best = c;
+		}
+		if (!best)
+			break;
+		i = best - rt->cpus;
+		end = next[i] + 1 < best->nindex ? best->index[next[i] + 1].offset : best->used;
+		memcpy(out + used, best->out + best->index[next[i]].offset, end - best->index[next[i]].offset);
+		used += end - best->index[next[i]].offset;
+		next[i]++;
+	}
+
+	for (i = 0; i < rt->ncpus; i++) {
+		rt->cpus[i].used = 0;
+		rt->cpus[i].nindex = 0;
+		rt->cpus[i].last_nframes = -1;
+	}
+	free(next);
+
+	data->event_buffer = out;
+	data->event_buffer_size = used;
+}
+
+static void raw_trace_stop(struct activity_capture_data *data)
+{
+	struct raw_trace *rt = data->raw;
+	int i;
+
+	for (i = 0; i < rt->ncpus; i++) {
+		if (rt->cpus[i].thread_is_valid)
+			pthread_join(rt->cpus[i].thread, NULL);
+		close(rt->cpus[i].fd);
+		free(rt->cpus[i].out);
+		free(rt->cpus[i].index);
+	}
+	free(rt->cpus);
+	free(rt);
+	data->raw = NULL;
+}
+
+/**
+ * raw_trace_start - Start a reader thread per CPU
+ * @data: The capture, data->run must be set
+ * @mode: The tracing mode (see events_tracing_helper())
+ *
+ * Returns NULL if the raw buffers or the formats of the events of @mode
+ * can't be read, the text trace_pipe should be used instead.
+ */
+static struct raw_trace *raw_trace_start(struct activity_capture_data *data, int mode)
+{
+	struct raw_trace *rt = calloc(1, sizeof *rt);
+	struct dirent *entry;
+	char path[PATH_MAX];
+	unsigned long long subbuf_kb = 0;
+	size_t i;
+	int cpu;
+	DIR *d;
+
+	rt->data = data;
+	raw_trace_parse_header_page(rt);
+	for (i = 0; i < ARRAY_SIZE(raw_trace_events); i++) {
+		if (raw_trace_events[i].mode != mode)
+			continue;
+		if (!raw_trace_parse_format(rt, raw_trace_events[i].path, raw_trace_events[i].event_type) &&
+		    raw_trace_events[i].event_type != RAW_TRACE_KERNEL_STACK) {
+			free(rt);
+			return NULL;
+		}
+	}
+
+	// the sub-buffers can be bigger than a page on recent kernels
+	rt->page_size = getpagesize();
+	if (sscanf(read_file(SYSFS_PATH_TRACING "buffer_subbuf_size_kb"), "%llu", &subbuf_kb) == 1 &&
+	    subbuf_kb * 1024 > (unsigned long long)rt->page_size)
+		rt->page_size = subbuf_kb * 1024;
+
+	d = opendir(SYSFS_PATH_TRACING "per_cpu");
+	if (!d) {
+		free(rt);
+		return NULL;
+	}
+	while ((entry = readdir(d))) {
+		int fd;
+
+		if (sscanf(entry->d_name, "cpu%d", &cpu) != 1)
+			continue;
+		snprintf(path, sizeof path, SYSFS_PATH_TRACING "per_cpu/%s/trace_pipe_raw", entry->d_name);
+		fd = open(path, O_RDONLY | O_NONBLOCK);
+		if (fd < 0)
+			continue;
+		rt->cpus = realloc(rt->cpus, (rt->ncpus + 1) * sizeof(*rt->cpus));
+		memset(&rt->cpus[rt->ncpus], 0, sizeof(*rt->cpus));
+		rt->cpus[rt->ncpus].rt = rt;
+		rt->cpus[rt->ncpus].cpu = cpu;
+		rt->cpus[rt->ncpus].fd = fd;
+		rt->cpus[rt->ncpus].last_nframes = -1;
+		rt->ncpus++;
+	}
+	closedir(d);
+	if (!rt->ncpus) {
+		free(rt);
+		return NULL;
+	}
+
+	data->raw = rt;
+	for (cpu = 0; cpu < rt->ncpus; cpu++)
+		rt->cpus[cpu].thread_is_valid =
+			pthread_create(&rt->cpus[cpu].thread, NULL, raw_trace_cpu_thread, &rt->cpus[cpu]) == 0;
+	return rt;
+}
@@ -61,6 +61,14 @@ public:
 		ImGui::TableNextRow();
 		ImGui::TableSetColumnIndex(0); ImGui::Text("vBios version");
 		ImGui::TableSetColumnIndex(1); ImGui::Text("#b58900%s", json_object_get_string(info, "vbios_version"));
+		if (json_object_has_value(info, "vbios_pn")) {
+			ImGui::TableNextRow();
+			ImGui::TableSetColumnIndex(0); ImGui::Text("vBios part number");
+			ImGui::TableSetColumnIndex(1); ImGui::Text("#b58900%s", json_object_get_string(info, "vbios_pn"));
+			ImGui::TableNextRow();
+			ImGui::TableSetColumnIndex(0); ImGui::Text("vBios date");
+			ImGui::TableSetColumnIndex(1); ImGui::Text("#b58900%s", json_object_get_string(info, "vbios_date"));
+		}
 		ImGui::EndTable();
 
 		if (ImGui::TreeNode("Firmware versions")) {
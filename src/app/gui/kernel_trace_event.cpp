@@ -55,9 +55,11 @@ int Event::parse_raw_event_buffer(void *raw_data, unsigned raw_data_size,
 		memcpy(&out->timestamp, &input[consumed], 8);
 		consumed += 8;
 
-		EventType::Enum type;
-		memcpy(&type, &input[consumed], 4);
+		int type_and_flags;
+		memcpy(&type_and_flags, &input[consumed], 4);
 		consumed += 4;
+		out->binary_fields = type_and_flags & EventType::BinaryFields;
+		EventType::Enum type = static_cast<EventType::Enum>(type_and_flags & ~EventType::BinaryFields);
 
 		// printf("%16s | %12s | %5d | %5d | %s | %lf | %s\n",
 		//  	   out->task, out->process, out->pid, out->tgid, EventType::to_str(type), out->timestamp, &input[consumed]);
@@ -148,4 +150,53 @@ int Event::parse_event_fields(char *cursor, Event *event) {
 	}
 
 	return 1 + line_len;
-}
\ No newline at end of file
+}
+int Event::parse_binary_fields(char *cursor, Event *event, JSON_Array *names) {
+	int consumed = 0, nfields, nframes;
+	size_t n_names = json_array_get_count(names);
+
+	memcpy(&nfields, cursor, 4);
+	memcpy(&nframes, cursor + 4, 4);
+	consumed += 8;
+
+	for (int i = 0; i < nfields; i++) {
+		int name_id, len;
+		memcpy(&name_id, cursor + consumed, 4);
+		memcpy(&len, cursor + consumed + 4, 4);
+		consumed += 8;
+		assert(name_id < n_names);
+		const char *name = json_array_get_string(names, name_id);
+
+		if (len < 0) {
+			uint64_t value;
+			memcpy(&value, cursor + consumed, 8);
+			consumed += 8;
+			event->handle_binary_field(name, value, NULL, 0);
+		} else {
+			event->handle_binary_field(name, 0, cursor + consumed, len);
+			consumed += len;
+		}
+	}
+
+	if (nframes) {
+		/* Same form as the text stacktraces: "frame|frame|..." */
+		size_t total = 0;
+		for (int i = 0; i < nframes; i++) {
+			int id;
+			memcpy(&id, cursor + consumed + 4 * i, 4);
+			total += strlen(json_array_get_string(names, id)) + 1;
+		}
+		event->stacktrace = static_cast<char*>(malloc(total));
+		event->stacktrace[0] = '\0';
+		for (int i = 0; i < nframes; i++) {
+			int id;
+			memcpy(&id, cursor + consumed + 4 * i, 4);
+			if (i)
+				strcat(event->stacktrace, "|");
+			strcat(event->stacktrace, json_array_get_string(names, id));
+		}
+		consumed += 4 * nframes;
+	}
+
+	return consumed;
+}
@@ -27,6 +27,7 @@
 #include <cstddef>
 #include <cstring>
 #include <cstdlib>
+#include <cstdint>
 #include "parson.h"
 
 namespace EventType
@@ -41,6 +42,9 @@ namespace EventType
 		DrmSchedJobAddDep,
 		AmdgpuSchedRunJob,
 		AmdgpuDeviceWreg,
+
+		/* Flag: the fields are in binary form (see Event::parse_binary_fields). */
+		BinaryFields = 0x100,
 	};
 
 	inline const char *to_str(enum Enum t) {
@@ -79,6 +83,7 @@ struct EventBase {
 	const char *stacktrace; /* owned */
 	int tgid;
 	int pid;
+	bool binary_fields;
 };
 
 struct Event {
@@ -114,6 +119,10 @@ struct Event {
 
 	virtual void handle_field(int field_idx, char *name, int name_len, char *value, int value_len) = 0;
 
+	/* Fields decoded from the raw trace buffers, named as in the event's format
+	 * file.  Integers come in @value, strings in @str (not 0-terminated). */
+	virtual void handle_binary_field(const char *name, uint64_t value, const char *str, int str_len) { }
+
 	EventType::Enum type;
 	double timestamp;
 	char *stacktrace;
@@ -123,4 +132,10 @@ struct Event {
 									  JSON_Array *names, EventBase* out);
 
 	static int parse_event_fields(char *cursor, Event *event);
+	static int parse_binary_fields(char *cursor, Event *event, JSON_Array *names);
+
+	/* Parses the fields following the header @b, returns the bytes consumed. */
+	static int parse_fields(const EventBase &b, char *cursor, Event *event, JSON_Array *names) {
+		return b.binary_fields ? parse_binary_fields(cursor, event, names) : parse_event_fields(cursor, event);
+	}
 };
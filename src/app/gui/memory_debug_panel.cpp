@@ -25,35 +25,77 @@
 #include "panels.h"
 #include "imgui_memory_editor.h"
 
+#include <algorithm>
+#include <map>
+#include <vector>
+
+/* The memory is read in pages of this size, only the ones that are drawn
+ * (and a few ahead in the direction of the scrolling) are asked for. */
+#define MEM_PAGE_SIZE 4096
+#define MEM_PREFETCH_PAGES 8
+#define MEM_MAX_PAGES_PER_REQUEST 64
+#define MEM_MAX_CACHED_PAGES 4096
+
 class MemoryDebugPanel : public Panel {
 public:
 	MemoryDebugPanel(struct umr_asic *asic) : Panel(asic), use_linear(true) {
 		strcpy(vram_address, "00100000000");
-		vram_content = NULL;
 		vram_size = 1024;
 		vmid = 1;
-		valid_content_size = 0;
 		num_page_table_entries = 0;
-	}
-	~MemoryDebugPanel() {
-		free(vram_content);
+		view_addr = 0;
+		view_size = 0;
+		view_vmid = -1;
+		generation = 0;
+		use_clock = 0;
+		last_first_page = 0;
+		direction = 1;
+		request_pending = false;
+		/* edits would only change the local copy */
+		mem_edit.ReadOnly = true;
+		mem_edit.ReadFn = read_byte;
 	}
 
 	void process_server_message(JSON_Object *response, void *raw_data, unsigned raw_data_size) {
 		JSON_Value *error = json_object_get_value(response, "error");
-		if (error)
-			return;
-
 		JSON_Object *request = json_object(json_object_get_value(response, "request"));
 		JSON_Value *answer = json_object_get_value(response, "answer");
 		const char *command = json_object_get_string(request, "command");
 
-		if (!strcmp(command, "vm-decode") || !strcmp(command, "vm-read")) {
-			if (raw_data_size) {
-				vram_content = realloc(vram_content, raw_data_size);
-				memcpy(vram_content, raw_data, raw_data_size);
-				valid_content_size = raw_data_size;
+		if (error) {
+			/* the pages asked for can be asked for again */
+			if (!strcmp(command, "vm-read") && json_object_has_value(request, "pages")) {
+				request_pending = false;
+				for (auto it = cache.begin(); it != cache.end();)
+					it = it->second.data.empty() ? cache.erase(it) : std::next(it);
+			}
+			return;
+		}
+
+		if (!strcmp(command, "vm-read") && json_object_has_value(request, "pages")) {
+			request_pending = false;
+			/* the view was refreshed or moved to another VM meanwhile */
+			if ((int)json_object_get_number(request, "generation") != generation)
+				return;
+			JSON_Array *pages = json_object_get_array(request, "pages");
+			JSON_Array *failed = json_object_get_array(json_object(answer), "failed");
+			size_t n = json_array_get_count(pages);
+			if (raw_data_size < n * MEM_PAGE_SIZE)
+				return;
+			for (size_t i = 0; i < n; i++) {
+				Page &page = cache[(uint64_t)json_array_get_number(pages, i)];
+				page.data.assign((uint8_t*)raw_data + i * MEM_PAGE_SIZE,
+								 (uint8_t*)raw_data + (i + 1) * MEM_PAGE_SIZE);
+				page.failed = false;
+				page.last_use = ++use_clock;
 			}
+			for (size_t i = 0; i < json_array_get_count(failed); i++)
+				cache[(uint64_t)json_array_get_number(failed, i)].failed = true;
+			evict_pages();
+			return;
+		}
+
+		if (!strcmp(command, "vm-decode") || !strcmp(command, "vm-read")) {
 
 			JSON_Array *pt = json_array(json_object_get_value(json_object(answer), "page_table"));
 			if (pt) {
@@ -97,7 +139,11 @@ public:
 		ImGui::SameLine();
 		ImGui::BeginDisabled(!can_send_request || dt < 0);
 		if (ImGui::Button("Read")) {
-			send_vm_read_command(use_linear);
+			/* a refresh: the pages are read again as they are drawn */
+			sscanf(vram_address, "%" SCNx64, &view_addr);
+			view_size = vram_size > 0 ? vram_size : 0;
+			view_vmid = use_linear ? -1 : vmid;
+			invalidate_pages();
 		}
 		ImGui::SameLine();
 		if (!use_linear && ImGui::Button("Decode 1 page")) {
@@ -108,13 +154,16 @@ public:
 
 		/* Split pane */
 		ImGui::BeginChild("Memory Viewer", ImVec2(avail.x / 2, 0), false, ImGuiWindowFlags_NoTitleBar);
-		if (valid_content_size) {
+		if (view_size) {
 			mem_edit.OptShowDataPreview = true;
 			mem_edit.OptShowAscii = false;
 
-			mem_edit.DrawContents(vram_content,
-								  valid_content_size,
-								  (size_t)0);
+			drawn_first = drawn_last = UINT64_MAX;
+			missing.clear();
+			use_clock++;
+			mem_edit.DrawContents(this, view_size, view_addr);
+			if (can_send_request && dt >= 0)
+				request_pages();
 		}
 		ImGui::EndChild();
 		ImGui::SameLine();
@@ -171,6 +220,104 @@ public:
 		return false;
 	}
 private:
+	struct Page {
+		std::vector<uint8_t> data; /* empty until read */
+		bool failed;
+		uint64_t last_use;
+		Page() : failed(false), last_use(0) {}
+	};
+
+	/* Called by the memory editor for every byte it draws, the pages that
+	 * aren't there yet are drawn as zeros and asked for after the draw. */
+	static ImU8 read_byte(const ImU8 *data, size_t off) {
+		MemoryDebugPanel *p = (MemoryDebugPanel*)data;
+		uint64_t addr = p->view_addr + off;
+		uint64_t page_addr = addr & ~(uint64_t)(MEM_PAGE_SIZE - 1);
+
+		if (p->drawn_first == UINT64_MAX || page_addr < p->drawn_first)
+			p->drawn_first = page_addr;
+		if (p->drawn_last == UINT64_MAX || page_addr > p->drawn_last)
+			p->drawn_last = page_addr;
+
+		auto it = p->cache.find(page_addr);
+		if (it == p->cache.end() || it->second.data.empty()) {
+			if (p->missing.empty() || p->missing.back() != page_addr)
+				p->missing.push_back(page_addr);
+			return 0;
+		}
+		it->second.last_use = p->use_clock;
+		return it->second.data[addr - page_addr];
+	}
+
+	void invalidate_pages() {
+		cache.clear();
+		generation++;
+		request_pending = false;
+	}
+
+	void evict_pages() {
+		while (cache.size() > MEM_MAX_CACHED_PAGES) {
+			auto oldest = cache.begin();
+			for (auto it = cache.begin(); it != cache.end(); ++it) {
+				if (it->second.last_use < oldest->second.last_use)
+					oldest = it;
+			}
+			cache.erase(oldest);
+		}
+	}
+
+	bool wanted(uint64_t page_addr) {
+		if (page_addr + MEM_PAGE_SIZE <= view_addr || page_addr >= view_addr + view_size)
+			return false;
+		return cache.find(page_addr) == cache.end();
+	}
+
+	/* The missing drawn pages and the ones after (or before, when scrolling
+	 * up) the drawn ones in a single request. */
+	void request_pages() {
+		if (request_pending || drawn_first == UINT64_MAX)
+			return;
+		if (drawn_first != last_first_page)
+			direction = drawn_first > last_first_page ? 1 : -1;
+		last_first_page = drawn_first;
+
+		std::vector<uint64_t> pages;
+		for (uint64_t page_addr : missing) {
+			if (pages.size() < MEM_MAX_PAGES_PER_REQUEST && wanted(page_addr) &&
+			    (pages.empty() || pages.back() != page_addr))
+				pages.push_back(page_addr);
+		}
+		for (int i = 1; i <= MEM_PREFETCH_PAGES && pages.size() < MEM_MAX_PAGES_PER_REQUEST; i++) {
+			uint64_t page_addr;
+			if (direction > 0)
+				page_addr = drawn_last + (uint64_t)i * MEM_PAGE_SIZE;
+			else if (drawn_first >= (uint64_t)i * MEM_PAGE_SIZE)
+				page_addr = drawn_first - (uint64_t)i * MEM_PAGE_SIZE;
+			else
+				break;
+			if (wanted(page_addr))
+				pages.push_back(page_addr);
+		}
+		if (pages.empty())
+			return;
+		std::sort(pages.begin(), pages.end());
+
+		JSON_Value *req = json_value_init_object();
+		json_object_set_string(json_object(req), "command", "vm-read");
+		JSON_Value *list = json_value_init_array();
+		for (uint64_t page_addr : pages) {
+			json_array_append_number(json_array(list), page_addr);
+			/* so it's not asked for again while the answer is on its way */
+			cache[page_addr].last_use = ++use_clock;
+		}
+		json_object_set_value(json_object(req), "pages", list);
+		json_object_set_number(json_object(req), "generation", generation);
+		if (view_vmid >= 0)
+			json_object_set_number(json_object(req), "vmid", view_vmid);
+		send_request(req);
+		request_pending = true;
+	}
+
 	void send_vm_read_command(bool use_linear, bool decode_only = false) {
 		JSON_Value *req = json_value_init_object();
 		json_object_set_string(json_object(req), "command", decode_only ? "vm-decode" : "vm-read");
@@ -184,11 +331,20 @@ private:
 	}
 
 private:
-	void *vram_content;
 	char vram_address[32];
 	int vram_size;
 	int vmid;
-	int valid_content_size;
+
+	/* what the memory editor shows, set by "Read" */
+	uint64_t view_addr, view_size;
+	int view_vmid; /* -1: linear */
+	std::map<uint64_t, Page> cache;
+	int generation; /* bumped when the cache is dropped */
+	uint64_t use_clock;
+	uint64_t drawn_first, drawn_last, last_first_page;
+	std::vector<uint64_t> missing;
+	int direction;
+	bool request_pending;
 	struct {
 		uint64_t va_mask;
 		uint64_t pba;
@@ -32,6 +32,8 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <map>
+#include <set>
 
 #define NUM_DRM_COUNTERS            3
 #define NUM_DRM_COUNTERS_VALUES   100
@@ -128,7 +130,7 @@ static void draw_rectangle(const ImVec2& bl, const ImVec2& tr, const ImColor& c1
 
 class MemoryUsagePanel : public Panel {
 public:
-	MemoryUsagePanel(struct umr_asic *asic) : Panel(asic), last_answer(NULL), last_vm_read(10), autorefresh(1) {
+	MemoryUsagePanel(struct umr_asic *asic) : Panel(asic), last_answer(NULL), autorefresh(1) {
 		got_first_drm_counters = false;
 		show_gtt = true;
 		show_vram = true;
@@ -144,6 +146,7 @@ public:
 	~MemoryUsagePanel() {
 		if (last_answer)
 			json_value_free(json_object_get_wrapping_value(last_answer));
+		clear_gem_clients();
 	}
 
 	void process_server_message(JSON_Object *response, void *raw_data, unsigned raw_data_size) {
@@ -156,11 +159,16 @@ public:
 		const char *command = json_object_get_string(request, "command");
 
 		if (!strcmp(command, "memory-usage")) {
+			if (!apply_gem_answer(json_object(answer))) {
+				/* We missed some changes, start over. */
+				send_memory_usage_command();
+				return;
+			}
 			if (last_answer)
 				json_value_free(json_object_get_wrapping_value(last_answer));
 			last_answer = json_object(json_value_deep_copy(answer));
 
-			prepare_memory_usage_data(last_answer);
+			prepare_memory_usage_data();
 		} else if (!strcmp(command, "drm-counters")) {
 			double values[3];
 			values[0] = json_object_get_number(json_object(answer), "bytes-moved") / (1024.0 * 1024.0 * 1024);
@@ -194,19 +202,19 @@ public:
 		if (icons[0] == 0)
 			init_icons();
 
-		if (can_send_request) {
-			if (!last_answer || (autorefresh_enabled && last_vm_read > autorefresh)) {
-				send_memory_usage_command();
-				send_drm_counters_command();
-				last_vm_read = 0;
-			}
-			last_vm_read += dt;
+		if (autorefresh_enabled) {
+			/* The server sends these on its own while the panel is shown. */
+			const int period_ms = autorefresh * 1000;
+			subscribe("memory-usage", period_ms, true, "{\"delta\":true}");
+			subscribe("drm-counters", period_ms, false);
+		} else if (!last_answer && can_send_request) {
+			send_memory_usage_command();
+			send_drm_counters_command();
 		}
 
 		if (ImGui::Button("Refresh")) {
 			send_memory_usage_command();
 			send_drm_counters_command();
-			last_vm_read = 0;
 		}
 		ImGui::SameLine();
 		ImGui::Text("Auto-refresh");
@@ -377,28 +385,121 @@ private:
 	bool show_mem_type[ARRAY_SIZE(mem_type_title)];
 	float zoom = 1.0;
 
-	void prepare_memory_usage_data(JSON_Object *data) {
-		std::vector<uint32_t> exported_ino;
+	/* The buffer objects of the memory-usage answers.  Each answer lists
+	 * all the apps and their clients, but with "base" set a client only
+	 * has the buffer objects that were added or changed since the answer
+	 * of that generation and the handles of the "removed" ones.
+	 */
+	struct gem_client {
+		JSON_Value *info = NULL;	/* the client without its buffer objects */
+		std::map<uint32_t, JSON_Value*> bos;
+	};
+	struct gem_app {
+		uint32_t pid;
+		std::string command;
+		std::vector<uint64_t> clients;
+	};
+	std::map<uint64_t, gem_client> gem_clients;
+	std::vector<gem_app> gem_apps;
+	uint64_t gem_generation = 0;
+
+	void free_gem_client(gem_client& c) {
+		json_value_free(c.info);
+		for (auto& it: c.bos)
+			json_value_free(it.second);
+	}
+	void clear_gem_clients() {
+		for (auto& it: gem_clients)
+			free_gem_client(it.second);
+		gem_clients.clear();
+		gem_apps.clear();
+	}
+
+	/* Returns false if @answer holds changes to a generation we don't have. */
+	bool apply_gem_answer(JSON_Object *answer) {
+		const bool delta = json_object_has_value(answer, "base");
+		if (delta && (uint64_t)json_object_get_number(answer, "base") != gem_generation)
+			return false;
+		if (!delta)
+			clear_gem_clients();
+		gem_generation = json_object_get_number(answer, "generation");
+
+		std::set<uint64_t> listed;
+		JSON_Array *apps = json_object_get_array(answer, "apps");
+		gem_apps.resize(json_array_get_count(apps));
+		for (size_t i = 0; i < json_array_get_count(apps); i++) {
+			JSON_Object *app = json_array_get_object(apps, i);
+			gem_app& a = gem_apps[i];
+			const char *name = json_object_get_string(app, "command");
+			a.pid = json_object_get_number(app, "pid");
+			a.command = name ? name : "";
+			a.clients.clear();
+
+			JSON_Array *clients = json_object_get_array(app, "clients");
+			for (size_t j = 0; j < json_array_get_count(clients); j++) {
+				JSON_Object *client = json_array_get_object(clients, j);
+				uint64_t key = json_object_has_value(client, "key") ?
+					(uint64_t)json_object_get_number(client, "key") : ((uint64_t)i << 16 | j);
+				gem_client& c = gem_clients[key];
+
+				JSON_Array *removed = json_object_get_array(client, "removed");
+				for (size_t k = 0; k < json_array_get_count(removed); k++) {
+					auto it = c.bos.find(json_array_get_number(removed, k));
+					if (it != c.bos.end()) {
+						json_value_free(it->second);
+						c.bos.erase(it);
+					}
+				}
+				JSON_Array *bos = json_object_get_array(client, "bos");
+				for (size_t k = 0; k < json_array_get_count(bos); k++) {
+					JSON_Value *bo = json_array_get_value(bos, k);
+					JSON_Value *&slot = c.bos[json_object_get_number(json_object(bo), "handle")];
+					json_value_free(slot);
+					slot = json_value_deep_copy(bo);
+				}
+
+				json_value_free(c.info);
+				c.info = json_value_init_object();
+				for (size_t k = 0; k < json_object_get_count(client); k++) {
+					const char *field = json_object_get_name(client, k);
+					if (strcmp(field, "bos") && strcmp(field, "removed"))
+						json_object_set_value(json_object(c.info), field,
+											  json_value_deep_copy(json_object_get_value_at(client, k)));
+				}
+
+				a.clients.push_back(key);
+				listed.insert(key);
+			}
+		}
+
+		/* The clients that aren't listed anymore are gone. */
+		for (auto it = gem_clients.begin(); it != gem_clients.end();) {
+			if (listed.count(it->first)) {
+				++it;
+				continue;
+			}
+			free_gem_client(it->second);
+			it = gem_clients.erase(it);
+		}
+		return true;
+	}
+
+	void prepare_memory_usage_data() {
+		std::set<uint32_t> exported_ino;
 
 		mem_app_snapshot snapshot;
 		auto &memory_usage_data = snapshot.bos;
 
-		JSON_Array *apps = json_object_get_array(data, "apps");
-		for (int i = 0; i < json_array_get_count(apps); i++) {
-			uint64_t total = 0;
-			JSON_Object *app = json_object(json_array_get_value(apps, i));
-			uint32_t pid = json_object_get_number(app, "pid");
+		for (size_t i = 0; i < gem_apps.size(); i++) {
+			const gem_app& app = gem_apps[i];
 
 			struct mem_app app_stat;
-			app_stat.pid = pid;
-			const char *name = json_object_get_string(app, "command");
-			if (name)
-				app_stat.name = name;
+			app_stat.pid = app.pid;
+			app_stat.name = app.command;
 
-			JSON_Array* clients = json_object_get_array(app, "clients");
-			for (size_t j = 0; j < json_array_get_count(clients); j++) {
-				JSON_Object *client = json_object(json_array_get_value(clients, j));
-				JSON_Array* bos = json_object_get_array(client, "bos");
+			for (size_t j = 0; j < app.clients.size(); j++) {
+				const gem_client& c = gem_clients[app.clients[j]];
+				JSON_Object *client = json_object(c.info);
 
 				struct mem_file file;
 				const char *drm_client_name = json_object_get_string(client, "drm-client-name");
@@ -407,19 +508,16 @@ private:
 				file.drm_client_id = json_object_get_number(client, "drm-client-id");
 				file.gpu_fd = json_object_get_number(client, "gpu-fd");
 
-				const int bo_count = json_array_get_count(bos);
-				for (int k = 0; k < bo_count; k++) {
-					JSON_Object *bo = json_object(json_array_get_value(bos, k));
+				for (const auto& it: c.bos) {
+					JSON_Object *bo = json_object(it.second);
 
 					/* The same bo may endup being exported multiple times. Only
 					 * consider the first one.
 					 */
 					if (json_object_has_value(bo, "ino")) {
 						uint32_t ino = json_object_get_number(bo, "ino");
-						if (std::find(exported_ino.begin(), exported_ino.end(), ino) != exported_ino.end()) {
+						if (!exported_ino.insert(ino).second)
 							continue;
-						}
-						exported_ino.push_back(ino);
 					}
 
 					struct mem_data m(bo);
@@ -951,7 +1049,6 @@ private:
 private:
 	JSON_Object *last_answer;
 	float drm_counters[NUM_DRM_COUNTERS * NUM_DRM_COUNTERS_VALUES];
-	float last_vm_read;
 	float autorefresh;
 	bool autorefresh_enabled;
 	bool got_first_drm_counters;
@@ -32,7 +32,7 @@ struct ImVec2;
 
 class Panel {
 public:
-	Panel(struct umr_asic *_asic) : asic(_asic), info(NULL) {}
+	Panel(struct umr_asic *_asic) : asic(_asic), info(NULL), num_subscriptions(0) {}
 	virtual ~Panel() {
 		if (info)
 			json_value_free(json_object_get_wrapping_value(info));
@@ -43,6 +43,13 @@ public:
 
 	void send_request(JSON_Value *req);
 
+	/* Have the server send the answer of @command every @period_ms (or
+	 * only when it changed) for as long as this is called every frame.
+	 * @params is a JSON object whose fields are added to the request. */
+	void subscribe(const char *command, int period_ms, bool changes_only, const char *params = NULL);
+	/* Unsubscribe from what wasn't subscribed to since the last call. */
+	void end_frame();
+
 	void store_info(JSON_Value *answer) {
 		if (info)
 			json_value_free(json_object_get_wrapping_value(info));
@@ -64,6 +71,16 @@ public:
 
 protected:
 	JSON_Object *info;
+
+private:
+	struct Subscription {
+		const char *command, *params;
+		int period_ms;
+		bool changes_only, watched;
+		int epoch;
+	};
+	Subscription subscriptions[8];
+	int num_subscriptions;
 };
 
 static inline const char *color_to_hex_str(const ImColor& color) {
@@ -74,6 +91,30 @@ static inline const char *color_to_hex_str(const ImColor& color) {
 	return tmp;
 }
 
+/* Submit @count rows, only drawing the visible ones. Rows listed in the
+ * sorted @expanded array (e.g. open tree nodes) can have any height and
+ * are always drawn; the runs of rows between them must have the same height
+ * and are clipped with an ImGuiListClipper.
+ */
+template<typename DrawRow>
+static void draw_clipped_rows(int count, const std::vector<int>& expanded, DrawRow draw_row) {
+	int row = 0;
+	for (size_t e = 0; e <= expanded.size() && row < count; e++) {
+		int end = e < expanded.size() ? std::min(expanded[e], count) : count;
+		if (end > row) {
+			ImGuiListClipper clipper;
+			clipper.Begin(end - row);
+			while (clipper.Step()) {
+				for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+					draw_row(row + i);
+			}
+			row = end;
+		}
+		if (e < expanded.size() && expanded[e] == row)
+			draw_row(row++);
+	}
+}
+
 /* Solarized palette (MIT License), https://github.com/altercation/solarized */
 ImColor palette[] = {
 	ImColor(181, 137,   0),
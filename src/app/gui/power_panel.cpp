@@ -23,6 +23,10 @@
  * of the Software.
  */
 #include "panels.h"
+#include "time_series.h"
+
+#include <map>
+#include <string>
 
 /* from print_config.c */
 extern "C" struct {
@@ -41,8 +45,7 @@ public:
 		runtimepm_last_answer(NULL),
 		pp_last_answer(NULL),
 		hwmon_last_answer(NULL),
-		consumed(true),
-		sensor_previous_values(NULL) {}
+		history_window(0) {}
 
 	~PowerPanel() {
 		if (last_answer)
@@ -55,7 +58,6 @@ public:
 			json_value_free(json_object_get_wrapping_value(pp_last_answer));
 		if (hwmon_last_answer)
 			json_value_free(json_object_get_wrapping_value(hwmon_last_answer));
-		free(sensor_previous_values);
 	}
 
 	void process_server_message(JSON_Object *response, void *raw_data, unsigned raw_data_size) {
@@ -75,7 +77,14 @@ public:
 			if (sensors_last_answer)
 				json_value_free(json_object_get_wrapping_value(sensors_last_answer));
 			sensors_last_answer = json_object(json_value_deep_copy(answer));
-			consumed = false;
+
+			double now = TimeSeries::now();
+			JSON_Array *values = json_object_get_array(sensors_last_answer, "values");
+			sensor_history.resize(json_array_get_count(values));
+			for (size_t i = 0; i < sensor_history.size(); i++) {
+				JSON_Object *v = json_object(json_array_get_value(values, i));
+				sensor_history[i].add(now, (int)json_object_get_number(v, "value"));
+			}
 		} else if (!strcmp(command, "runtimepm")) {
 			if (runtimepm_last_answer)
 				json_value_free(json_object_get_wrapping_value(runtimepm_last_answer));
@@ -90,6 +99,18 @@ public:
 			hwmon_last_answer = NULL;
 			if (json_object_has_value(json_object(answer), "hwmons"))
 				hwmon_last_answer = json_object(json_value_deep_copy(answer));
+
+			double now = TimeSeries::now();
+			JSON_Array *hwmons = json_object_get_array(hwmon_last_answer, "hwmons");
+			for (size_t i = 0; i < json_array_get_count(hwmons); i++) {
+				JSON_Object *hwmon = json_object(json_array_get_value(hwmons, i));
+				JSON_Array *temps = json_object_get_array(hwmon, "temp");
+				for (size_t j = 0; j < json_array_get_count(temps); j++) {
+					JSON_Object *temp = json_object(json_array_get_value(temps, j));
+					temp_history[temp_key(hwmon, temp)].add(
+						now, json_object_get_number(temp, "value") / 1000);
+				}
+			}
 		}
 	}
 
@@ -97,13 +118,10 @@ public:
 		const float gui_scale = get_gui_scale();
 
 		ImGui::BeginChild("power profiles", ImVec2(avail.x / 5, 0), false, ImGuiWindowFlags_NoTitleBar);
-		static float last_sensor_read = 0;
 		static float sensor_read_interval = 0.5;
 		if (!last_answer) {
-			if (can_send_request) {
+			if (can_send_request)
 				send_power_command(NULL);
-				last_sensor_read = 0;
-			}
 		} else {
 			ImGui::Text("Select DPM profile :");
 			ImGui::Indent();
@@ -114,7 +132,7 @@ public:
 				const char *profile = json_array_get_string(profiles, i);
 				if (ImGui::RadioButton(profile, !strcmp(current, profile))) {
 					send_power_command(profile);
-					last_sensor_read = 10;
+					send_sensors_command();
 				}
 			}
 			ImGui::EndDisabled();
@@ -196,35 +214,32 @@ public:
 			ImGui::Separator();
 		}
 
-		if (last_sensor_read > sensor_read_interval) {
-			if (can_send_request) {
-				send_runtimepm_command();
-				send_pp_features_command(0, false);
-				if (!suspended) {
-					send_sensors_command();
-					send_fans_command(-1, -1, -1);
-				}
-				last_sensor_read = 0;
-			}
-		} else {
-			last_sensor_read += dt;
+		/* The server sends these on its own while the panel is shown. */
+		const int period_ms = sensor_read_interval * 1000;
+		subscribe("runtimepm", period_ms, true);
+		subscribe("pp_features", period_ms, true);
+		if (!suspended) {
+			subscribe("sensors", period_ms, false);
+			subscribe("hwmon", period_ms, true);
 		}
 		if (sensors_last_answer && !suspended) {
 			ImGui::Text("Sensors values:");
-			const int old_value_count = 100;
-			JSON_Array *values = json_object_get_array(sensors_last_answer, "values");
-			int sensors_count = json_array_get_count(values);
-
-			if (!sensor_previous_values) {
-				sensor_previous_values = (float *)calloc(sensors_count * old_value_count, sizeof(float));
-				sensor_values_offset = 0;
+			ImGui::SameLine();
+			ImGui::SetNextItemWidth(100 * gui_scale);
+			if (ImGui::BeginCombo("History", time_series_windows[history_window].label)) {
+				for (int i = 0; i < ARRAY_SIZE(time_series_windows); i++) {
+					if (ImGui::Selectable(time_series_windows[i].label, i == history_window))
+						history_window = i;
+				}
+				ImGui::EndCombo();
 			}
+			JSON_Array *values = json_object_get_array(sensors_last_answer, "values");
+			int sensors_count = std::min(json_array_get_count(values), sensor_history.size());
+			double now = TimeSeries::now();
 
 			ImVec2 previous_cursor;
 			for (int i = 0; i < sensors_count; i++) {
 				JSON_Object *v = json_object(json_array_get_value(values, i));
-				sensor_previous_values[i * old_value_count + sensor_values_offset] =
-					(int)json_object_get_number(v, "value");
 
 				int same_graph = 0;
 
@@ -235,16 +250,12 @@ public:
 					ImGui::SetCursorScreenPos(previous_cursor);
 				}
 
-				ImGui::PlotLines(json_object_get_string(v, "name"),
-								 &sensor_previous_values[i * old_value_count],
-								  old_value_count,
-								  sensor_values_offset + 1,
-								  NULL,
-								  json_object_get_number(v, "min"),
-								  json_object_get_number(v, "max"),
-								  ImVec2(0, avail.y / (2 + sensors_count)),
-								  sizeof(float),
-								  same_graph);
+				sensor_history[i].plot(json_object_get_string(v, "name"),
+									   now, time_series_windows[history_window].seconds,
+									   json_object_get_number(v, "min"),
+									   json_object_get_number(v, "max"),
+									   ImVec2(ImGui::CalcItemWidth(), avail.y / (2 + sensors_count)),
+									   same_graph);
 				ImGui::SameLine();
 				if (same_graph) {
 					ImVec2 c = ImGui::GetCursorScreenPos();
@@ -253,13 +264,9 @@ public:
 				}
 				ImGui::Text("%s: %d %s",
 					json_object_get_string(v, "name"),
-					(int)sensor_previous_values[i * old_value_count + sensor_values_offset],
+					(int)sensor_history[i].last(),
 					json_object_get_string(v, "unit"));
 			}
-			if (!consumed) {
-				sensor_values_offset = (sensor_values_offset + 1) % old_value_count;
-				consumed = true;
-			}
 		}
 
 		if (hwmon_last_answer) {
@@ -303,10 +310,11 @@ public:
 
 				JSON_Array *temps = json_object_get_array(hwmon, "temp");
 				ImGui::Text("   Temperatures:");
-				ImGui::BeginTable("temps", 3, ImGuiTableFlags_Borders);
+				ImGui::BeginTable("temps", 4, ImGuiTableFlags_Borders);
 				ImGui::TableSetupColumn("Label");
 				ImGui::TableSetupColumn("Value (°C)");
 				ImGui::TableSetupColumn("Critical (°C)");
+				ImGui::TableSetupColumn("History");
 				ImGui::TableHeadersRow();
 				for (int j = 0; j < json_array_get_count(temps); j++) {
 					JSON_Object *temp = json_object(json_array_get_value(temps, j));
@@ -317,6 +325,17 @@ public:
 					ImGui::Text("%d", (int) json_object_get_number(temp, "value") / 1000);
 					ImGui::TableSetColumnIndex(2);
 					ImGui::Text("%d", (int) json_object_get_number(temp, "critical") / 1000);
+					ImGui::TableSetColumnIndex(3);
+					auto h = temp_history.find(temp_key(hwmon, temp));
+					if (h != temp_history.end()) {
+						ImGui::PushID(j);
+						h->second.plot("", TimeSeries::now(),
+									   time_series_windows[history_window].seconds,
+									   FLT_MAX, FLT_MAX,
+									   ImVec2(ImGui::GetContentRegionAvail().x,
+											  ImGui::GetTextLineHeight()));
+						ImGui::PopID();
+					}
 				}
 				ImGui::EndTable();
 			}
@@ -360,12 +379,6 @@ public:
 	}
 
 private:
-	void send_runtimepm_command() {
-		JSON_Value *req = json_value_init_object();
-		json_object_set_string(json_object(req), "command", "runtimepm");
-		send_request(req);
-	}
-
 	void send_sensors_command() {
 		JSON_Value *req = json_value_init_object();
 		json_object_set_string(json_object(req), "command", "sensors");
@@ -413,8 +426,13 @@ private:
 	JSON_Object *runtimepm_last_answer;
 	JSON_Object *pp_last_answer;
 	JSON_Object *hwmon_last_answer;
-	bool consumed;
-	float *sensor_previous_values;
-	int sensor_values_offset;
+	std::vector<TimeSeries> sensor_history;
+	std::map<std::string, TimeSeries> temp_history;
+	int history_window;
+
+	static std::string temp_key(JSON_Object *hwmon, JSON_Object *temp) {
+		const char *label = json_object_get_string(temp, "label");
+		return std::to_string((int)json_object_get_number(hwmon, "id")) + "/" + (label ? label : "");
+	}
 };
 
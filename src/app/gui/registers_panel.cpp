@@ -24,6 +24,7 @@
  */
 #include "panels.h"
 
+#include <algorithm>
 #include <ctype.h>
 #include <SDL.h>
 #include <set>
@@ -69,6 +70,13 @@ struct RegisterEvent : public Event {
 			value = strtoll(v, NULL, 16);
 	}
 
+	void handle_binary_field(const char *name, uint64_t v, const char *str, int str_len) {
+		if (!strcmp(name, "reg"))
+			regaddr = v;
+		else if (!strcmp(name, "value"))
+			value = v;
+	}
+
 	uint32_t regaddr;
 	uint32_t value;
 
@@ -77,6 +85,193 @@ struct RegisterEvent : public Event {
 
 #define ALL_REGISTERS ((umr_reg*)0xffffffff)
 
+/* Search index over the "ip.register" and "ip.register.field" names of an
+ * asic, built the first time the registers are searched.
+ *
+ * The names are lowercased in one buffer and each trigram of them lists
+ * the entries it appears in.  A query is made of space separated terms
+ * that must all appear in the name: the candidates come from the rarest
+ * trigram of the terms and are checked with strstr().  Only when nothing
+ * matches are the terms matched as subsequences, as a scan.  Matches are
+ * ranked (whole name parts first, then name part prefixes, registers
+ * before their fields, shorter names first) a page at a time.
+ */
+struct RegisterIndex {
+	static const size_t PAGE = 256;
+
+	struct Entry {
+		int blk, reg, field;	/* field is -1 for the register itself */
+		uint32_t name;			/* offset in names */
+	};
+
+	void build(struct umr_asic *asic) {
+		entries.clear();
+		names.clear();
+		for (int i = 0; i < (int) asic->no_blocks; i++) {
+			struct umr_ip_block *b = asic->blocks[i];
+			for (int j = 0; j < b->no_regs; j++) {
+				add_name(i, j, -1, b->ipname, skip_register_prefix(b->regs[j].regname), NULL);
+				for (int k = 0; k < b->regs[j].no_bits; k++)
+					if (b->regs[j].bits[k].regname)
+						add_name(i, j, k, b->ipname, skip_register_prefix(b->regs[j].regname),
+								 b->regs[j].bits[k].regname);
+			}
+		}
+
+		/* Counting sort of the (trigram, entry) pairs, each entry once per trigram. */
+		std::vector<uint32_t> last(NUM_TRIGRAMS, UINT32_MAX);
+		trigram_offset.assign(NUM_TRIGRAMS + 1, 0);
+		for (int pass = 0; pass < 2; pass++) {
+			std::vector<uint32_t> pos;
+			if (pass) {
+				for (uint32_t t = 0; t < NUM_TRIGRAMS; t++)
+					trigram_offset[t + 1] += trigram_offset[t];
+				trigram_entries.resize(trigram_offset[NUM_TRIGRAMS]);
+				pos.assign(trigram_offset.begin(), trigram_offset.end() - 1);
+				last.assign(NUM_TRIGRAMS, UINT32_MAX);
+			}
+			for (uint32_t e = 0; e < entries.size(); e++) {
+				const char *n = &names[entries[e].name];
+				if (!n[0] || !n[1])
+					continue;
+				uint32_t t = code(n[0]) * 40 + code(n[1]);
+				for (n += 2; *n; n++) {
+					t = (t % (40 * 40)) * 40 + code(*n);
+					if (last[t] == e)
+						continue;
+					last[t] = e;
+					if (pass)
+						trigram_entries[pos[t]++] = e;
+					else
+						trigram_offset[t + 1]++;
+				}
+			}
+		}
+		built = true;
+	}
+
+	/* Ranks the entries matching @query, the first page is sorted. */
+	void search(const char *query) {
+		char buf[128];
+		std::vector<const char*> terms;
+
+		snprintf(buf, sizeof buf, "%s", query);
+		for (char *p = buf; *p; p++)
+			*p = tolower(*p);
+		for (char *save, *t = strtok_r(buf, " ", &save); t; t = strtok_r(NULL, " ", &save))
+			terms.push_back(t);
+
+		/* The candidates are the entries of the rarest trigram. */
+		const uint32_t *cand = NULL;
+		size_t no_cand = entries.size();
+		for (const char *t: terms) {
+			for (const char *n = t; n[0] && n[1] && n[2]; n++) {
+				const uint32_t tr = trigram(n);
+				const size_t count = trigram_offset[tr + 1] - trigram_offset[tr];
+				if (!cand || count < no_cand) {
+					cand = &trigram_entries[trigram_offset[tr]];
+					no_cand = count;
+				}
+			}
+		}
+
+		results.clear();
+		for (size_t i = 0; i < no_cand; i++) {
+			const uint32_t e = cand ? cand[i] : i;
+			const char *n = &names[entries[e].name];
+			uint32_t score = 0;
+			size_t k;
+			for (k = 0; k < terms.size(); k++) {
+				const char *m = strstr(n, terms[k]);
+				if (!m)
+					break;
+				const char end = m[strlen(terms[k])];
+				if (m > n && m[-1] != '.' && m[-1] != '_')
+					score += 2;
+				else if (end && end != '.' && end != '_')
+					score += 1;
+			}
+			if (k == terms.size())
+				results.push_back(key(e, score));
+		}
+
+		/* Fall back to the terms as subsequences of the names. */
+		if (results.empty() && !terms.empty()) {
+			for (uint32_t e = 0; e < entries.size(); e++) {
+				const char *n = &names[entries[e].name];
+				size_t k;
+				for (k = 0; k < terms.size(); k++) {
+					const char *t = terms[k];
+					for (; *t && *n; n++)
+						if (*t == *n)
+							t++;
+					if (*t)
+						break;
+				}
+				if (k == terms.size())
+					results.push_back(key(e, 64));
+			}
+		}
+
+		shown = 0;
+		show_more();
+	}
+
+	/* Sorts the next page of results. */
+	void show_more() {
+		const size_t n = std::min(shown + PAGE, results.size());
+		std::partial_sort(results.begin() + shown, results.begin() + n, results.end());
+		shown = n;
+	}
+
+	const Entry& result(size_t i) const {
+		return entries[(uint32_t)results[i]];
+	}
+
+	bool built = false;
+	std::vector<uint64_t> results;	/* rank key | entry */
+	size_t shown = 0;
+
+private:
+	/* a-z, 0-9, '_', '.' and anything else. */
+	static const uint32_t NUM_TRIGRAMS = 40 * 40 * 40;
+
+	static uint32_t code(char c) {
+		if (c >= 'a' && c <= 'z')
+			return c - 'a';
+		if (c >= '0' && c <= '9')
+			return 26 + c - '0';
+		return c == '_' ? 36 : c == '.' ? 37 : 38;
+	}
+
+	static uint32_t trigram(const char *n) {
+		return (code(n[0]) * 40 + code(n[1])) * 40 + code(n[2]);
+	}
+
+	uint64_t key(uint32_t e, uint32_t score) const {
+		const Entry& en = entries[e];
+		const uint64_t len = std::min<size_t>(strlen(&names[en.name]), 0xffff);
+		return ((uint64_t)(2 * score + (en.field >= 0)) << 48) | (len << 32) | e;
+	}
+
+	void add_name(int blk, int reg, int field, const char *ip, const char *regname, const char *fieldname) {
+		const char *parts[] = { ip, regname, fieldname };
+
+		entries.push_back(Entry { blk, reg, field, (uint32_t)names.size() });
+		for (int i = 0; i < 3 && parts[i]; i++) {
+			if (i)
+				names.push_back('.');
+			for (const char *c = parts[i]; *c; c++)
+				names.push_back(tolower(*c));
+		}
+		names.push_back('\0');
+	}
+
+	std::vector<Entry> entries;
+	std::vector<char> names;
+	std::vector<uint32_t> trigram_offset, trigram_entries;
+};
+
 static void parse_raw_event_buffer(struct umr_asic *asic,
 								   void *raw_data, unsigned raw_data_size,
 								   std::vector<RegisterEvent>& events,
@@ -107,7 +302,7 @@ static void parse_raw_event_buffer(struct umr_asic *asic,
 		RegisterEvent event(bp);
 
 		/* Parse the fields. */
-		consumed += Event::parse_event_fields(input + consumed, &event);
+		consumed += Event::parse_fields(bp, input + consumed, &event, names);
 
 		umr_reg *reg = umr_find_reg_by_addr(asic, event.regaddr, NULL);
 		if (reg) {
@@ -121,7 +316,10 @@ static void parse_raw_event_buffer(struct umr_asic *asic,
 
 class RegistersPanel : public Panel {
 public:
-	RegistersPanel(struct umr_asic *asic) : Panel(asic), hightlighted_field(NULL), active_tracking(NULL) {}
+	RegistersPanel(struct umr_asic *asic) : Panel(asic), hightlighted_field(NULL), active_tracking(NULL) {
+		// the panel lists every register of every block
+		umr_load_ip_blocks(asic, NULL);
+	}
 
 	~RegistersPanel() {}
 
@@ -136,9 +334,12 @@ public:
 
 		if (strcmp(command, "read") && strcmp(command, "write")) {
 			if (str_is(command, "read-trace-buffer")) {
+				size_t first = events.size();
 				parse_raw_event_buffer(asic,
 					raw_data, raw_data_size, events,
 					json_object_get_array(json_object(answer), "names"));
+				for (size_t i = first; i < events.size(); i++)
+					written_registers.insert(events[i].reg);
 			}
 			return;
 		}
@@ -185,68 +386,43 @@ public:
 		ImGui::BeginChild("Registers list", ImVec2(avail.x / 4, drawable_area.get_top_row_height()), false,
 							ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_HorizontalScrollbar);
 
-		ImGui::Text("Registers per block");
-		ImGui::Separator();
-		char details[128];
-		for (int i = 0; i < (int) asic->no_blocks; i++) {
-			unsigned matching = 0;
-			struct umr_ip_block *b = asic->blocks[i];
-			if (filter[0] != '\0' || field_filter[0] != '\0') {
-				for (int j = 0; j < b->no_regs; j++) {
-					if (filter[0] != '\0' && !fuzzy_match_simple(filter, skip_register_prefix(b->regs[j].regname))) {
-						continue;
-					} else if (field_filter[0] != '\0') {
-						for (int k = 0; k < b->regs[j].no_bits; k++) {
-							if (b->regs[j].bits[k].regname &&
-								  fuzzy_match_simple(field_filter, b->regs[j].bits[k].regname)) {
-								matching++;
-								break;
-							}
-						}
-					} else {
-						matching++;
+		update_search();
+		if (filter[0] == '\0') {
+			ImGui::Text("Registers per block");
+			ImGui::Separator();
+			for (int i = 0; i < (int) asic->no_blocks; i++) {
+				struct umr_ip_block *b = asic->blocks[i];
+				if (ImGui::TreeNodeEx(b->ipname, 0, "%12s (%d registers)", b->ipname, b->no_regs)) {
+					/* Only the visible registers of the block are drawn. */
+					ImGuiListClipper clipper;
+					clipper.Begin(b->no_regs);
+					while (clipper.Step()) {
+						for (int j = clipper.DisplayStart; j < clipper.DisplayEnd; j++)
+							register_button(b, &b->regs[j], skip_register_prefix(b->regs[j].regname));
 					}
+					ImGui::TreePop();
 				}
-				sprintf(details, "%d/%d matches", matching, b->no_regs);
-			} else {
-				sprintf(details, "%d registers", b->no_regs);
 			}
-			if (ImGui::TreeNodeEx(b->ipname, (matching && matching < 10) ? ImGuiTreeNodeFlags_Leaf : 0, "%12s (%s)", b->ipname, details)) {
-				bool at_least_one = matching > 0;
-				for (int j = 0; j < b->no_regs; j++) {
-					bool pinned = false;
-					for (int k = 0; k < (int) pinned_registers.size() && !pinned; k++)
-						pinned = pinned_registers[k].reg == &b->regs[j];
-
-					if (filter[0] != '\0' && !fuzzy_match_simple(filter, skip_register_prefix(b->regs[j].regname)))
-						continue;
-
-					if (field_filter[0] != '\0') {
-						bool show = false;
-						for (int k = 0; k < b->regs[j].no_bits; k++) {
-							if (b->regs[j].bits[k].regname &&
-								  fuzzy_match_simple(field_filter, b->regs[j].bits[k].regname)) {
-								show = true;
-								break;
-							}
-						}
-
-						if (!show)
-							continue;
-					}
-					at_least_one = true;
-					if (pinned) {
-						ImGui::TextUnformatted(skip_register_prefix(b->regs[j].regname));
-					} else if (ImGui::Button(skip_register_prefix(b->regs[j].regname))) {
-						pinned_registers.push_back(PinnedRegister(b, &b->regs[j]));
-						send_read_reg_command(&pinned_registers.back());
-					}
-				}
-				if (!at_least_one) {
-					ImGui::Text("No matching registers");
+		} else {
+			ImGui::Text("%d matches", (int) index.results.size());
+			ImGui::Separator();
+			ImGuiListClipper clipper;
+			clipper.Begin(index.shown);
+			while (clipper.Step()) {
+				for (int r = clipper.DisplayStart; r < clipper.DisplayEnd; r++) {
+					const RegisterIndex::Entry& e = index.result(r);
+					struct umr_ip_block *b = asic->blocks[e.blk];
+					struct umr_reg *reg = &b->regs[e.reg];
+					char label[256];
+					snprintf(label, sizeof label, "%s.%s%s%s", b->ipname, skip_register_prefix(reg->regname),
+							 e.field >= 0 ? "." : "", e.field >= 0 ? reg->bits[e.field].regname : "");
+					ImGui::PushID(r);
+					register_button(b, reg, label);
+					ImGui::PopID();
 				}
-				ImGui::TreePop();
 			}
+			if (index.shown < index.results.size() && ImGui::Button("Show more"))
+				index.show_more();
 		}
 		ImGui::EndChild();
 		ImGui::SameLine();
@@ -261,6 +437,7 @@ public:
 				active_tracking = NULL;
 			} else {
 				events.clear();
+				written_registers.clear();
 				send_start_register_tracking(0);
 				active_tracking = ALL_REGISTERS;
 			}
@@ -269,26 +446,17 @@ public:
 		ImGui::Separator();
 
 		ImGui::PushStyleColor(ImGuiCol_Text, ImU32(palette[4]));
-		ImGui::Text("Search register by:");
+		ImGui::Text("Search registers and fields:");
 		ImGui::PopStyleColor();
 		if (kb_shortcut(SDLK_f))
 			ImGui::SetKeyboardFocusHere();
-		ImGui::BulletText("Name:      ");
+		ImGui::BulletText("Name:");
 		ImGui::SameLine();
 		ImGui::InputText("", filter, sizeof(filter));
 		ImGui::SameLine();
 		if (ImGui::Button("Clear") || (kb_shortcut(SDLK_BACKSPACE)))
 			filter[0] = '\0';
-		ImGui::BulletText("Field Name:");
-		ImGui::SameLine();
-		ImGui::PushID("field");
-		ImGui::InputText("", field_filter, sizeof(field_filter));
-		ImGui::PopID();
-		ImGui::SameLine();
-		ImGui::PushID("Field");
-		if (ImGui::Button("Clear") || (ImGui::GetIO().KeyCtrl && ImGui::IsKeyReleased(SDLK_BACKSPACE)))
-			field_filter[0] = '\0';
-		ImGui::PopID();
+		ImGui::TextDisabled("(space separated parts of ip.register.field)");
 		ImGui::Separator();
 
 		if (pinned_registers.empty()) {
@@ -359,16 +527,21 @@ public:
 			const float spacing = ImGui::GetStyle().FramePadding.x;
 			float previous_title_ended_at = -1000;
 
-			std::set<umr_reg*> unique_registers;
+			/* The events are sorted by timestamp: only draw the visible ones. */
+			auto visible_begin = std::lower_bound(events.begin(), events.end(),
+				drawable_area.x_to_timestamp(drawable_area.get_extent().x - bar_width) + min_ts,
+				[](const RegisterEvent& evt, double ts) { return evt.timestamp < ts; });
+			auto visible_end = std::upper_bound(visible_begin, events.end(),
+				drawable_area.x_to_timestamp(drawable_area.get_extent().z) + min_ts,
+				[](double ts, const RegisterEvent& evt) { return ts < evt.timestamp; });
 
 			bool tooltip = false;
-			for (const auto& evt: events) {
+			for (auto it = visible_begin; it != visible_end; ++it) {
+				const RegisterEvent& evt = *it;
 				double x = drawable_area.timestamp_to_x(evt.timestamp - min_ts);
 
 				assert(evt.reg);
 
-				unique_registers.insert(evt.reg);
-
 				const char *name = skip_register_prefix(evt.reg->regname);
 				float w = ImGui::CalcTextSize(name).x;
 				float xa = previous_title_ended_at + spacing;
@@ -447,7 +620,7 @@ public:
 			}
 
 			char label[512];
-			sprintf(label, "%ld writes to %ld unique registers", events.size(), unique_registers.size());
+			sprintf(label, "%ld writes to %ld unique registers", events.size(), written_registers.size());
 			float w = ImGui::CalcTextSize(label).x;
 			ImGui::GetWindowDrawList()->AddText(
 				ImVec2(
@@ -535,7 +708,7 @@ private:
 			ImGui::BeginDisabled(!can_send_request || value == pinned->new_value);
 			ImGui::SameLine();
 			if (ImGui::Button("Write")) {
-				send_write_reg_command(pinned, pinned->new_value);
+				send_write_reg_command(pinned, value, pinned->new_value);
 			}
 			ImGui::EndDisabled();
 
@@ -547,6 +720,7 @@ private:
 				}
 				if (active_tracking != reg) {
 					events.clear();
+					written_registers.clear();
 					send_start_register_tracking(reg->addr);
 					active_tracking = reg;
 				} else {
@@ -585,23 +759,58 @@ private:
 		send_request(req);
 	}
 
-	void send_write_reg_command(PinnedRegister *pinned, unsigned value) {
+	/* Only the fields that were edited are sent so that the server merges
+	 * them into the current value of the register (with a single
+	 * read-modify-write) instead of writing back a stale copy. */
+	void send_write_reg_command(PinnedRegister *pinned, uint64_t old_value, uint64_t value) {
 		JSON_Value *req = json_value_init_object();
 		json_object_set_string(json_object(req), "command", "write");
 		json_object_set_string(json_object(req), "block", pinned->blk->ipname);
 		json_object_set_string(json_object(req), "register", pinned->reg->regname);
 		json_object_set_number(json_object(req), "value", value);
+
+		struct umr_reg *reg = pinned->reg;
+		if (reg->no_bits > 1) {
+			JSON_Value *fields = json_value_init_array();
+			for (int i = 0; i < reg->no_bits; i++) {
+				int width = reg->bits[i].stop - reg->bits[i].start + 1;
+				uint64_t mask = width >= 64 ? ~0ULL : ((1ULL << width) - 1);
+				uint64_t v = (value >> reg->bits[i].start) & mask;
+				if (v == ((old_value >> reg->bits[i].start) & mask))
+					continue;
+				JSON_Value *f = json_value_init_object();
+				json_object_set_string(json_object(f), "name", reg->bits[i].regname);
+				json_object_set_number(json_object(f), "value", v);
+				json_array_append_value(json_array(fields), f);
+			}
+			json_object_set_value(json_object(req), "fields", fields);
+		}
 		send_request(req);
 	}
 
-	/* From fts_fuzzy_match */
-	bool fuzzy_match_simple(char const * pattern, char const * str) {
-		while (*pattern != '\0' && *str != '\0')  {
-			if (tolower(*pattern) == tolower(*str))
-				++pattern;
-			++str;
+	/* Pins @reg when clicked, unless it already is. */
+	void register_button(struct umr_ip_block *b, struct umr_reg *reg, const char *label) {
+		bool pinned = false;
+		for (int k = 0; k < (int) pinned_registers.size() && !pinned; k++)
+			pinned = pinned_registers[k].reg == reg;
+
+		if (pinned) {
+			ImGui::AlignTextToFramePadding();
+			ImGui::TextUnformatted(label);
+		} else if (ImGui::Button(label)) {
+			pinned_registers.push_back(PinnedRegister(b, reg));
+			send_read_reg_command(&pinned_registers.back());
 		}
-		return *pattern == '\0' ? true : false;
+	}
+
+	/* The index is only searched when the filter changes, not every frame. */
+	void update_search() {
+		if (filter[0] == '\0' || !strcmp(filter, searched_filter))
+			return;
+		if (!index.built)
+			index.build(asic);
+		strcpy(searched_filter, filter);
+		index.search(filter);
 	}
 
 private:
@@ -609,11 +818,13 @@ private:
 
 	struct umr_bitfield *hightlighted_field;
 
-	char filter[32] = {};
-	char field_filter[32] = {};
+	char filter[64] = {};
+	char searched_filter[64] = {};
+	RegisterIndex index;
 
 	umr_reg *active_tracking;
 	std::vector<RegisterEvent> events;
+	std::set<umr_reg*> written_registers;
 
 	DrawableArea drawable_area;
 };
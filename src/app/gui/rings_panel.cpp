@@ -23,6 +23,10 @@
  * of the Software.
  */
 #include "panels.h"
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
 
 static const char * get_ring_name(JSON_Array *rings, int idx) {
 	assert(idx >= 0 && idx < json_array_get_count(rings));
@@ -49,24 +53,6 @@ static void _done(struct umr_stream_decode_ui *ui) {
 	/* no-op */
 }
 
-static void _start_opcode(struct umr_stream_decode_ui *ui, uint64_t ib_addr,
-						 uint32_t ib_vmid, int pkttype,
-						 uint32_t opcode, uint32_t subop, uint32_t nwords,
-						 const char *opcode_name, uint32_t header, const uint32_t* raw_data) {
-	ImGui::TableNextRow();
-	ImGui::TableSetColumnIndex(0);
-	ImGui::Text("#0083d80x%" PRIx64, ib_addr);
-	ImGui::TableSetColumnIndex(1);
-	ImGui::Text("%08x", header);
-	ImGui::TableSetColumnIndex(2);
-	if (ImGui::TreeNode((void*)ib_addr, "#8f979c%s", opcode_name)) {
-		*((bool*)ui->data) = true;
-		ImGui::TreePop();
-	} else {
-		*((bool*)ui->data) = false;
-	}
-}
-
 static void _add_field(struct umr_stream_decode_ui *ui, uint64_t ib_addr,
 					  uint32_t ib_vmid, const char *field_name,
 					  uint64_t value, char *str, int ideal_radix, int field_size)
@@ -126,6 +112,7 @@ public:
 			json_value_free(json_object_get_wrapping_value(last_answer));
 			free(raw_data);
 		}
+		free_logs();
 	}
 
 	void process_server_message(JSON_Object *response, void *_raw_data, unsigned raw_data_size) {
@@ -144,6 +131,7 @@ public:
 			free(this->raw_data);
 			this->raw_data = (uint32_t*)malloc(raw_data_size);
 			memcpy(this->raw_data, _raw_data, raw_data_size);
+			free_logs();
 		}
 	}
 
@@ -253,12 +241,7 @@ public:
 				ImGui::PushID(i);
 				if (ImGui::BeginTabItem(tmp)) {
 					JSON_Array *op = json_object_get_array(shader, "opcodes");
-					uint32_t *copy = new uint32_t[json_array_get_count(op)];
-					for (size_t j = 0; j < json_array_get_count(op); j++)
-						copy[j] = (uint32_t)json_array_get_number(op, j);
-
-					char **opcode_strs = NULL;
-					umr_shader_disasm(asic, (uint8_t *)copy, json_array_get_count(op) * 4, base, &opcode_strs);
+					const std::vector<std::string> &lines = shader_disassembly(i, shader);
 
 					sprintf(tmp, "0x%" PRIx64, base);
 
@@ -268,10 +251,13 @@ public:
 					ImGui::TableSetupColumn("Raw Value", ImGuiTableColumnFlags_WidthFixed, ImGui::CalcTextSize("0x00000000  ").x);
 					ImGui::TableSetupColumn("Disassembly");
 					ImGui::TableHeadersRow();
-					for (size_t j = 0; j < json_array_get_count(op); j++) {
+					ImGuiListClipper clipper;
+					clipper.Begin(lines.size());
+					while (clipper.Step())
+					for (int j = clipper.DisplayStart; j < clipper.DisplayEnd; j++) {
 						ImGui::TableNextRow();
 						ImGui::TableSetColumnIndex(0);
-						ImGui::Text("+ 0x%lx", j * 4);
+						ImGui::Text("+ 0x%x", j * 4);
 						if (ImGui::IsItemHovered()) {
 							ImGui::BeginTooltip();
 							ImGui::Text("0x%" PRIx64, base + j * 4);
@@ -280,14 +266,9 @@ public:
 						ImGui::TableSetColumnIndex(1);
 						ImGui::Text("0x%08x", (uint32_t)json_array_get_number(op, j));
 						ImGui::TableSetColumnIndex(2);
-						if (opcode_strs) {
-							ImGui::Text("%s", shader_syntax.transform(opcode_strs[j]));
-							free(opcode_strs[j]);
-						}
+						ImGui::TextUnformatted(lines[j].c_str());
 					}
 					ImGui::EndTable();
-					free(opcode_strs);
-					delete[] copy;
 					ImGui::EndChild();
 					ImGui::EndTabItem();
 				}
@@ -298,19 +279,12 @@ public:
 				JSON_Object *vcn = json_object(json_array_get_value(vcns, i));
 				uint64_t base = (uint64_t) json_object_get_number(vcn, "address");
 				uint64_t vmid = (uint64_t) json_object_get_number(vcn, "vmid");
-				uint32_t type = (uint64_t) json_object_get_number(vcn, "type");
 				char tmp[128];
 				sprintf(tmp, "IB 0x%" PRIx64"@0x%" PRIx64, vmid, base);
 				ImGui::PushID(i);
 				if (ImGui::BeginTabItem(tmp)) {
 					JSON_Array *op = json_object_get_array(vcn, "opcodes");
-					uint32_t *copy = new uint32_t[json_array_get_count(op)];
-					for (size_t j = 0; j < json_array_get_count(op); j++)
-						copy[j] = (uint32_t)json_array_get_number(op, j);
-
-					char **opcode_strs = NULL;
-
-					umr_vcn_decode(asic, copy, json_array_get_count(op) * 4, base, type, &opcode_strs);
+					const std::vector<std::string> &lines = vcn_decoding(i, vcn);
 
 					sprintf(tmp, "0x%" PRIx64, base);
 
@@ -320,10 +294,13 @@ public:
 					ImGui::TableSetupColumn("Raw Value", ImGuiTableColumnFlags_WidthFixed, ImGui::CalcTextSize("0x00000000  ").x);
 					ImGui::TableSetupColumn("Decoded IB");
 					ImGui::TableHeadersRow();
-					for (size_t j = 0; j < json_array_get_count(op); j++) {
+					ImGuiListClipper clipper;
+					clipper.Begin(lines.size());
+					while (clipper.Step())
+					for (int j = clipper.DisplayStart; j < clipper.DisplayEnd; j++) {
 						ImGui::TableNextRow();
 						ImGui::TableSetColumnIndex(0);
-						ImGui::Text("+ 0x%lx", j * 4);
+						ImGui::Text("+ 0x%x", j * 4);
 						if (ImGui::IsItemHovered()) {
 							ImGui::BeginTooltip();
 							ImGui::Text("0x%" PRIx64, base + j * 4);
@@ -332,13 +309,9 @@ public:
 						ImGui::TableSetColumnIndex(1);
 						ImGui::Text("0x%08x", (uint32_t)json_array_get_number(op, j));
 						ImGui::TableSetColumnIndex(2);
-						ImGui::Text("%s", opcode_strs && opcode_strs[j] ?opcode_strs[j]:"...");
-						if (opcode_strs && opcode_strs[j])
-							free(opcode_strs[j]);
+						ImGui::TextUnformatted(lines[j].c_str());
 					}
 					ImGui::EndTable();
-					free(opcode_strs);
-					delete[] copy;
 					ImGui::EndChild();
 					ImGui::EndTabItem();
 				}
@@ -384,11 +357,11 @@ private:
 
 		int draw_dispatch_count = 0;
 
-		bool opcode_verbose = false;
+		/* the fields of a packet are only decoded once it is expanded */
+		bool opcode_verbose = true;
 		struct umr_stream_decode_ui ui = { };
 		ui.rt = type;
 		ui.start_ib = _start_ib;
-		ui.start_opcode = _start_opcode;
 		ui.add_field = _add_field;
 		ui.add_shader = _add_shader;
 		ui.add_data = _add_data;
@@ -396,22 +369,143 @@ private:
 		ui.done = _done;
 		ui.data = &opcode_verbose;
 
-		struct umr_packet_stream *str = umr_packet_decode_buffer(
-			asic, &ui, 0, base,
-			&buffer[start], ndwords,
-			type,
-			NULL);
-
-		if (str)
-			umr_packet_disassemble_stream(str, base, 0, 0, 0, ~0UL, 0, 0);
-		umr_packet_free(str);
+		struct umr_packet_index *idx = ib_index(type, &buffer[start], start, ndwords);
+		const std::vector<uint32_t> &rows = packet_rows[start];
+		std::set<uint32_t> &open = open_packets[start];
+
+		/* Only the visible collapsed packets are drawn, the expanded ones
+		 * are replayed from their log. */
+		std::vector<int> expanded;
+		for (uint32_t r : open)
+			expanded.push_back(r);
+		draw_clipped_rows(rows.size(), expanded, [&](int r) {
+			const uint32_t i = rows[r];
+			const struct umr_packet_index_entry *e = &idx->entries[i];
+			uint64_t addr = base + 4ULL * e->offset;
+
+			ImGui::TableNextRow();
+			ImGui::TableSetColumnIndex(0);
+			ImGui::Text("#0083d80x%" PRIx64, addr);
+			ImGui::TableSetColumnIndex(1);
+			ImGui::Text("%08x", e->header);
+			ImGui::TableSetColumnIndex(2);
+			if (ImGui::TreeNode((void*)addr, "#8f979c%s", e->name)) {
+				ImGui::TreePop();
+				open.insert(r);
+				struct umr_packet_log *log = packet_log(idx, i, type, base, &buffer[start], start);
+				if (log)
+					umr_packet_log_replay(log, asic, &ui);
+			} else {
+				open.erase(r);
+			}
+		});
 
 		ImGui::EndTable();
 
 		return addr_lo_ib;
 	}
+
+	/* The IBs are only framed when an answer is shown, each packet is
+	 * decoded into a packet log the first time it is expanded. */
+	struct umr_packet_index *ib_index(enum umr_ring_type type, uint32_t *words, uint32_t start, uint32_t ndwords) {
+		auto it = indices.find(start);
+		if (it != indices.end())
+			return it->second;
+
+		struct umr_packet_index *idx = umr_packet_index_buffer(asic, words, ndwords, type);
+		indices[start] = idx;
+
+		/* Packets without a name aren't listed. */
+		std::vector<uint32_t> &rows = packet_rows[start];
+		for (uint32_t i = 0; idx && i < idx->no_entries; i++) {
+			if (idx->entries[i].name)
+				rows.push_back(i);
+		}
+		return idx;
+	}
+
+	struct umr_packet_log *packet_log(struct umr_packet_index *idx, uint32_t i, enum umr_ring_type type, uint64_t base, uint32_t *words, uint32_t start) {
+		std::pair<uint32_t, uint32_t> key(start, i);
+		auto it = logs.find(key);
+		if (it != logs.end())
+			return it->second;
+
+		struct umr_packet_log *log = umr_packet_log_create(type);
+		if (log)
+			umr_packet_decode_index(asic, &log->ui, idx, i, 1, words, 0, base, 0);
+		logs[key] = log;
+		return log;
+	}
+
+	const std::vector<std::string> &shader_disassembly(int i, JSON_Object *shader) {
+		auto it = shader_lines.find(i);
+		if (it != shader_lines.end())
+			return it->second;
+
+		JSON_Array *op = json_object_get_array(shader, "opcodes");
+		const size_t nops = json_array_get_count(op);
+		uint32_t *copy = new uint32_t[nops];
+		for (size_t j = 0; j < nops; j++)
+			copy[j] = (uint32_t)json_array_get_number(op, j);
+
+		struct umr_disasm_block *text = umr_shader_disasm_block_cached(asic, json_object_get_number(shader, "vmid"), copy, nops * 4,
+																	   json_object_get_number(shader, "address"));
+		std::vector<std::string> &lines = shader_lines[i];
+		for (size_t j = 0; j < nops; j++)
+			lines.push_back(text ? shader_syntax.transform(umr_disasm_line(text, j)) : "");
+		free(text);
+		delete[] copy;
+		return lines;
+	}
+
+	const std::vector<std::string> &vcn_decoding(int i, JSON_Object *vcn) {
+		auto it = vcn_lines.find(i);
+		if (it != vcn_lines.end())
+			return it->second;
+
+		JSON_Array *op = json_object_get_array(vcn, "opcodes");
+		const size_t nops = json_array_get_count(op);
+		uint32_t *copy = new uint32_t[nops];
+		for (size_t j = 0; j < nops; j++)
+			copy[j] = (uint32_t)json_array_get_number(op, j);
+
+		char **opcode_strs = NULL;
+		umr_vcn_decode(asic, copy, nops * 4, (uint64_t)json_object_get_number(vcn, "address"),
+					   (uint32_t)json_object_get_number(vcn, "type"), &opcode_strs);
+
+		std::vector<std::string> &lines = vcn_lines[i];
+		for (size_t j = 0; j < nops; j++) {
+			lines.push_back(opcode_strs && opcode_strs[j] ? opcode_strs[j] : "...");
+			if (opcode_strs)
+				free(opcode_strs[j]);
+		}
+		free(opcode_strs);
+		delete[] copy;
+		return lines;
+	}
+
+	void free_logs() {
+		for (auto& it : logs)
+			umr_packet_log_free(it.second);
+		logs.clear();
+		for (auto& it : indices)
+			umr_packet_index_free(it.second);
+		indices.clear();
+		packet_rows.clear();
+		open_packets.clear();
+		shader_lines.clear();
+		vcn_lines.clear();
+	}
 private:
 	JSON_Object *last_answer;
+	std::map<uint32_t, struct umr_packet_index *> indices;
+	std::map<std::pair<uint32_t, uint32_t>, struct umr_packet_log *> logs;
+	/* Per IB: the index entries that are listed, and the expanded rows. */
+	std::map<uint32_t, std::vector<uint32_t>> packet_rows;
+	std::map<uint32_t, std::set<uint32_t>> open_packets;
+	/* Text of the shader and VCN tabs, per tab. */
+	std::map<int, std::vector<std::string>> shader_lines;
+	std::map<int, std::vector<std::string>> vcn_lines;
 	uint32_t *raw_data;
 	SyntaxHighlighter ib_syntax;
 	SyntaxHighlighter shader_syntax;
@@ -0,0 +1,524 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <endian.h>
+#include <pthread.h>
+#include <time.h>
+#include "session.h"
+#include "wire.h"
+
+/*
+ * The file is SESSION_MAGIC and SESSION_VERSION followed by the records,
+ * each one is
+ *
+ *   RECORD_MAGIC, the message index, the time in ns since the recording
+ *   started (64-bit) and the size of the message
+ *   the message: a rumr header word (SESSION_BINARY if the answer is in
+ *   the wire format), the size of the answer, the answer, the size of the
+ *   raw data and the raw data, compressed by rumr_buffer_compress()
+ *
+ * and on close the index: one entry per record (message index, size,
+ * offset and time), the number of entries and INDEX_MAGIC.  A recording
+ * that was not closed has no index, the records are then scanned.  All
+ * the words are little endian.
+ */
+#define SESSION_MAGIC	0x53524D55UL // "UMRS"
+#define SESSION_VERSION	1
+#define RECORD_MAGIC	0x52524D55UL // "UMRR"
+#define INDEX_MAGIC	0x49524D55UL // "UMRI"
+
+#define SESSION_BINARY	(1UL << 0)
+
+#define RECORD_HEADER_SIZE	20
+#define INDEX_ENTRY_SIZE	24
+
+// the lanes wait for the writer past this much queued
+#define SESSION_MAX_PENDING	(256UL << 20)
+
+struct session_entry {
+	uint32_t msg_idx, size;
+	uint64_t offset, time_ns;
+};
+
+struct session_msg {
+	struct session_msg *next;
+	struct rumr_buffer *buf;
+	uint32_t msg_idx;
+	uint64_t time_ns;
+};
+
+struct umr_session_log {
+	FILE *f;
+	uint64_t start_ns, offset;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond, drained;
+	struct session_msg *head, **tail;
+	uint64_t pending;
+	int stop;
+
+	// written by the writer thread only
+	struct session_entry *entries;
+	uint32_t no_entries, max_entries;
+};
+
+struct umr_session_replay {
+	FILE *f;
+	struct session_entry *entries; // by message index
+	int no_entries;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+	v = htole32(v);
+	memcpy(p, &v, 4);
+}
+
+static void put64(uint8_t *p, uint64_t v)
+{
+	v = htole64(v);
+	memcpy(p, &v, 8);
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, 4);
+	return le32toh(v);
+}
+
+static uint64_t get64(const uint8_t *p)
+{
+	uint64_t v;
+
+	memcpy(&v, p, 8);
+	return le64toh(v);
+}
+
+static void write_msg(struct umr_session_log *log, struct session_msg *m)
+{
+	struct session_entry *e;
+	uint8_t hdr[RECORD_HEADER_SIZE];
+
+	if (log->no_entries == log->max_entries) {
+		uint32_t n = log->max_entries ? 2 * log->max_entries : 1024;
+
+		e = realloc(log->entries, n * sizeof *e);
+		if (!e)
+			return;
+		log->entries = e;
+		log->max_entries = n;
+	}
+
+	rumr_buffer_compress(m->buf, RUMR_CODEC_ZSTD | RUMR_CODEC_RLE32);
+	put32(hdr, RECORD_MAGIC);
+	put32(hdr + 4, m->msg_idx);
+	put64(hdr + 8, m->time_ns);
+	put32(hdr + 16, m->buf->woffset);
+	if (fwrite(hdr, 1, sizeof hdr, log->f) != sizeof hdr ||
+	    fwrite(m->buf->data, 1, m->buf->woffset, log->f) != m->buf->woffset)
+		return;
+
+	e = &log->entries[log->no_entries++];
+	e->msg_idx = m->msg_idx;
+	e->size = m->buf->woffset;
+	e->offset = log->offset;
+	e->time_ns = m->time_ns;
+	log->offset += sizeof hdr + m->buf->woffset;
+}
+
+static void *writer_thread(void *arg)
+{
+	struct umr_session_log *log = arg;
+	struct session_msg *m, *next;
+	uint64_t bytes;
+
+	pthread_mutex_lock(&log->lock);
+	for (;;) {
+		while (!log->head && !log->stop)
+			pthread_cond_wait(&log->cond, &log->lock);
+		if (!log->head)
+			break;
+
+		// write everything queued so far without the lock
+		m = log->head;
+		log->head = NULL;
+		log->tail = &log->head;
+		pthread_mutex_unlock(&log->lock);
+
+		for (bytes = 0; m; m = next) {
+			next = m->next;
+			bytes += m->buf->woffset;
+			write_msg(log, m);
+			rumr_buffer_free(m->buf);
+			free(m);
+		}
+		fflush(log->f);
+
+		pthread_mutex_lock(&log->lock);
+		log->pending -= bytes;
+		pthread_cond_broadcast(&log->drained);
+	}
+	pthread_mutex_unlock(&log->lock);
+	return NULL;
+}
+
+/**
+ * umr_session_log_open - Start recording a session
+ *
+ * @path: The file to record to, truncated
+ *
+ * Returns the recording or NULL if the file cannot be created.
+ */
+struct umr_session_log *umr_session_log_open(const char *path)
+{
+	struct umr_session_log *log;
+	uint8_t hdr[8];
+
+	log = calloc(1, sizeof *log);
+	if (!log)
+		return NULL;
+	log->f = fopen(path, "wb");
+	if (!log->f) {
+		free(log);
+		return NULL;
+	}
+	put32(hdr, SESSION_MAGIC);
+	put32(hdr + 4, SESSION_VERSION);
+	fwrite(hdr, 1, sizeof hdr, log->f);
+	log->offset = sizeof hdr;
+	log->start_ns = now_ns();
+	log->tail = &log->head;
+	pthread_mutex_init(&log->lock, NULL);
+	pthread_cond_init(&log->cond, NULL);
+	pthread_cond_init(&log->drained, NULL);
+	if (pthread_create(&log->thread, NULL, writer_thread, log)) {
+		fclose(log->f);
+		free(log);
+		return NULL;
+	}
+	return log;
+}
+
+/**
+ * umr_session_log_append - Queue an answer to be recorded
+ *
+ * @log: The recording
+ * @msg_idx: The index of the message, replayed in that order
+ * @binary: Non-zero if @answer is in the wire format (see wire.h), JSON
+ *          text otherwise
+ * @answer: The answer as received
+ * @answer_len: Its size in bytes
+ * @raw_data: The raw data that came with it (if any)
+ * @raw_data_size: Its size in bytes
+ *
+ * The answer and raw data are copied, they are compressed and written by
+ * the writer thread.  Only waits if the writer fell far behind.
+ */
+void umr_session_log_append(struct umr_session_log *log, uint32_t msg_idx, int binary,
+			    const void *answer, uint32_t answer_len,
+			    const void *raw_data, uint32_t raw_data_size)
+{
+	struct session_msg *m;
+
+	m = calloc(1, sizeof *m);
+	if (!m)
+		return;
+	m->buf = rumr_buffer_init();
+	if (!m->buf || rumr_buffer_reserve(m->buf, 12 + answer_len + raw_data_size)) {
+		rumr_buffer_free(m->buf);
+		free(m);
+		return;
+	}
+	m->msg_idx = msg_idx;
+	m->time_ns = now_ns() - log->start_ns;
+	rumr_buffer_add_uint32(m->buf, binary ? SESSION_BINARY : 0);
+	rumr_buffer_add_uint32(m->buf, answer_len);
+	rumr_buffer_add_data(m->buf, (void *)answer, answer_len);
+	rumr_buffer_add_uint32(m->buf, raw_data_size);
+	if (raw_data_size)
+		rumr_buffer_add_data(m->buf, (void *)raw_data, raw_data_size);
+
+	pthread_mutex_lock(&log->lock);
+	while (log->pending > SESSION_MAX_PENDING && !log->stop)
+		pthread_cond_wait(&log->drained, &log->lock);
+	log->pending += m->buf->woffset;
+	*log->tail = m;
+	log->tail = &m->next;
+	pthread_cond_signal(&log->cond);
+	pthread_mutex_unlock(&log->lock);
+}
+
+/**
+ * umr_session_log_close - Write what is queued and the index, then close
+ */
+void umr_session_log_close(struct umr_session_log *log)
+{
+	uint8_t buf[INDEX_ENTRY_SIZE];
+	uint32_t i;
+
+	if (!log)
+		return;
+	pthread_mutex_lock(&log->lock);
+	log->stop = 1;
+	pthread_cond_signal(&log->cond);
+	pthread_cond_broadcast(&log->drained);
+	pthread_mutex_unlock(&log->lock);
+	pthread_join(log->thread, NULL);
+
+	for (i = 0; i < log->no_entries; i++) {
+		put32(buf, log->entries[i].msg_idx);
+		put32(buf + 4, log->entries[i].size);
+		put64(buf + 8, log->entries[i].offset);
+		put64(buf + 16, log->entries[i].time_ns);
+		fwrite(buf, 1, INDEX_ENTRY_SIZE, log->f);
+	}
+	put32(buf, log->no_entries);
+	put32(buf + 4, INDEX_MAGIC);
+	fwrite(buf, 1, 8, log->f);
+	fclose(log->f);
+
+	pthread_mutex_destroy(&log->lock);
+	pthread_cond_destroy(&log->cond);
+	pthread_cond_destroy(&log->drained);
+	free(log->entries);
+	free(log);
+}
+
+// the index written on close, 0 if there is none
+static int read_index(struct umr_session_replay *r, uint64_t file_size)
+{
+	uint8_t buf[INDEX_ENTRY_SIZE];
+	uint64_t start;
+	uint32_t n, i;
+
+	if (file_size < 16 || fseeko(r->f, file_size - 8, SEEK_SET) || fread(buf, 1, 8, r->f) != 8 ||
+	    get32(buf + 4) != INDEX_MAGIC)
+		return 0;
+	n = get32(buf);
+	if ((uint64_t)n * INDEX_ENTRY_SIZE > file_size - 16)
+		return 0;
+	start = file_size - 8 - (uint64_t)n * INDEX_ENTRY_SIZE;
+	r->entries = calloc(n ? n : 1, sizeof *r->entries);
+	if (!r->entries || fseeko(r->f, start, SEEK_SET))
+		return 0;
+	for (i = 0; i < n; i++) {
+		if (fread(buf, 1, INDEX_ENTRY_SIZE, r->f) != INDEX_ENTRY_SIZE)
+			return 0;
+		r->entries[i].msg_idx = get32(buf);
+		r->entries[i].size = get32(buf + 4);
+		r->entries[i].offset = get64(buf + 8);
+		r->entries[i].time_ns = get64(buf + 16);
+		if (r->entries[i].offset + RECORD_HEADER_SIZE + r->entries[i].size > start)
+			return 0;
+	}
+	r->no_entries = n;
+	return 1;
+}
+
+// walk the records of a recording that was not closed, up to the first torn one
+static void scan_records(struct umr_session_replay *r, uint64_t file_size)
+{
+	uint8_t hdr[RECORD_HEADER_SIZE];
+	uint64_t offset = 8;
+	struct session_entry *e;
+	int max = 0;
+
+	free(r->entries);
+	r->entries = NULL;
+	r->no_entries = 0;
+	while (offset + RECORD_HEADER_SIZE <= file_size && !fseeko(r->f, offset, SEEK_SET) &&
+	       fread(hdr, 1, sizeof hdr, r->f) == sizeof hdr && get32(hdr) == RECORD_MAGIC &&
+	       offset + RECORD_HEADER_SIZE + get32(hdr + 16) <= file_size) {
+		if (r->no_entries == max) {
+			max = max ? 2 * max : 1024;
+			e = realloc(r->entries, max * sizeof *e);
+			if (!e)
+				return;
+			r->entries = e;
+		}
+		e = &r->entries[r->no_entries++];
+		e->msg_idx = get32(hdr + 4);
+		e->time_ns = get64(hdr + 8);
+		e->size = get32(hdr + 16);
+		e->offset = offset;
+		offset += RECORD_HEADER_SIZE + e->size;
+	}
+}
+
+static int entry_cmp(const void *a, const void *b)
+{
+	const struct session_entry *x = a, *y = b;
+
+	return x->msg_idx < y->msg_idx ? -1 : x->msg_idx > y->msg_idx;
+}
+
+/**
+ * umr_session_replay_open - Open a recording made by umr_session_log_open()
+ *
+ * Returns the recording with its messages in message index order, or NULL
+ * if @path is not a recording.
+ */
+struct umr_session_replay *umr_session_replay_open(const char *path)
+{
+	struct umr_session_replay *r;
+	uint8_t hdr[8];
+	uint64_t file_size;
+
+	r = calloc(1, sizeof *r);
+	if (!r)
+		return NULL;
+	r->f = fopen(path, "rb");
+	if (!r->f || fread(hdr, 1, sizeof hdr, r->f) != sizeof hdr ||
+	    get32(hdr) != SESSION_MAGIC || get32(hdr + 4) != SESSION_VERSION ||
+	    fseeko(r->f, 0, SEEK_END)) {
+		umr_session_replay_close(r);
+		return NULL;
+	}
+	file_size = ftello(r->f);
+	if (!read_index(r, file_size))
+		scan_records(r, file_size);
+	qsort(r->entries, r->no_entries, sizeof *r->entries, entry_cmp);
+	return r;
+}
+
+/**
+ * umr_session_replay_count - Number of messages in a recording
+ */
+int umr_session_replay_count(struct umr_session_replay *r)
+{
+	return r->no_entries;
+}
+
+/**
+ * umr_session_replay_time - When the message @n was received, in ns since
+ * the recording started
+ */
+uint64_t umr_session_replay_time(struct umr_session_replay *r, int n)
+{
+	return (n >= 0 && n < r->no_entries) ? r->entries[n].time_ns : 0;
+}
+
+/**
+ * umr_session_replay_find_time - The last message received at or before @time_ns
+ *
+ * Returns its position (as used by umr_session_replay_read()), or -1 if
+ * every message came later.
+ */
+int umr_session_replay_find_time(struct umr_session_replay *r, uint64_t time_ns)
+{
+	int n, best = -1;
+
+	// the lanes answer out of order, the times are not sorted
+	for (n = 0; n < r->no_entries; n++)
+		if (r->entries[n].time_ns <= time_ns &&
+		    (best < 0 || r->entries[n].time_ns >= r->entries[best].time_ns))
+			best = n;
+	return best;
+}
+
+/**
+ * umr_session_replay_read - Read a recorded answer
+ *
+ * @r: The recording
+ * @n: Which message, 0 is the one with the lowest message index
+ * @raw_data: Receives the raw data (to be freed with free()) or NULL
+ * @raw_data_size: Receives its size
+ *
+ * Returns the answer or NULL if the message is corrupt.
+ */
+JSON_Value *umr_session_replay_read(struct umr_session_replay *r, int n,
+				    void **raw_data, uint32_t *raw_data_size)
+{
+	struct session_entry *e;
+	struct rumr_buffer *buf;
+	JSON_Value *msg = NULL;
+	uint32_t flags, answer_len, raw_len;
+	char *text;
+
+	*raw_data = NULL;
+	*raw_data_size = 0;
+	if (n < 0 || n >= r->no_entries)
+		return NULL;
+	e = &r->entries[n];
+
+	buf = rumr_buffer_init();
+	if (!buf || rumr_buffer_reserve(buf, e->size) ||
+	    fseeko(r->f, e->offset + RECORD_HEADER_SIZE, SEEK_SET) ||
+	    fread(buf->data, 1, e->size, r->f) != e->size)
+		goto out;
+	buf->woffset = e->size;
+	if (rumr_buffer_decompress(buf) || buf->woffset < 12)
+		goto out;
+
+	flags = get32(buf->data);
+	answer_len = get32(buf->data + 4);
+	if (answer_len > buf->woffset - 12)
+		goto out;
+	raw_len = get32(buf->data + 8 + answer_len);
+	if (raw_len > buf->woffset - 12 - answer_len)
+		goto out;
+
+	if (flags & SESSION_BINARY) {
+		msg = umr_wire_decode(buf->data + 8, answer_len, NULL);
+	} else {
+		text = strndup((char *)buf->data + 8, answer_len);
+		if (text)
+			msg = json_parse_string(text);
+		free(text);
+	}
+	if (msg && raw_len) {
+		*raw_data = malloc(raw_len);
+		if (*raw_data) {
+			memcpy(*raw_data, buf->data + 12 + answer_len, raw_len);
+			*raw_data_size = raw_len;
+		}
+	}
+out:
+	rumr_buffer_free(buf);
+	return msg;
+}
+
+/**
+ * umr_session_replay_close - Close a recording opened by umr_session_replay_open()
+ */
+void umr_session_replay_close(struct umr_session_replay *r)
+{
+	if (!r)
+		return;
+	if (r->f)
+		fclose(r->f);
+	free(r->entries);
+	free(r);
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+#ifndef UMR_GUI_SESSION_H_
+#define UMR_GUI_SESSION_H_
+
+#include <stdint.h>
+#include "parson.h"
+
+/*
+ * Recording of the answers the GUI received, replayed with 'umr --gui
+ * <folder>'.  The answers are appended to one file, UMR_SESSION_FILE in
+ * the session folder, by a thread of its own so that the lanes never wait
+ * for the disk.  Each one is compressed (see rumr_buffer_compress()) and
+ * tagged with its message index and the time it was received, an index
+ * of them all is written at the end when the recording is closed.
+ */
+#define UMR_SESSION_FILE	"session.umrs"
+
+struct umr_session_log;
+struct umr_session_log *umr_session_log_open(const char *path);
+void umr_session_log_append(struct umr_session_log *log, uint32_t msg_idx, int binary,
+			    const void *answer, uint32_t answer_len,
+			    const void *raw_data, uint32_t raw_data_size);
+void umr_session_log_close(struct umr_session_log *log);
+
+struct umr_session_replay;
+struct umr_session_replay *umr_session_replay_open(const char *path);
+int umr_session_replay_count(struct umr_session_replay *r);
+uint64_t umr_session_replay_time(struct umr_session_replay *r, int n);
+int umr_session_replay_find_time(struct umr_session_replay *r, uint64_t time_ns);
+JSON_Value *umr_session_replay_read(struct umr_session_replay *r, int n,
+				    void **raw_data, uint32_t *raw_data_size);
+void umr_session_replay_close(struct umr_session_replay *r);
+
+#endif
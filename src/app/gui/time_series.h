@@ -0,0 +1,200 @@
+/*
+ * Copyright © 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NON-INFRINGEMENT. IN NO EVENT SHALL THE COPYRIGHT HOLDERS, AUTHORS
+ * AND/OR ITS SUPPLIERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ */
+#pragma once
+
+#include <math.h>
+#include <time.h>
+#include <vector>
+
+/* Fixed-capacity history of a value, so that long sessions don't grow
+ * memory.  It is kept at 3 resolutions: the last raw samples, 1 second
+ * buckets for an hour and 1 minute buckets for a day, the buckets holding
+ * the min / max / average of their samples.
+ */
+class TimeSeries {
+public:
+	struct Sample {
+		double t; /* seconds, the start of the bucket if it is one */
+		float min, max, avg;
+	};
+
+	TimeSeries() {
+		levels.push_back(Level(0, 1200));
+		levels.push_back(Level(1, 3600));
+		levels.push_back(Level(60, 24 * 60));
+	}
+
+	void add(double t, float v) {
+		for (auto& l : levels)
+			l.add(t, v);
+		last_value = v;
+	}
+
+	bool empty() const {
+		return levels[0].count == 0;
+	}
+
+	float last() const {
+		return last_value;
+	}
+
+	/* Get the samples of [t0, t1] from the finest resolution that still
+	 * has t0 and doesn't give more than @max_points of them.
+	 */
+	void query(double t0, double t1, int max_points, std::vector<Sample>& out) const {
+		out.clear();
+		const Level *level = &levels.back();
+		for (const auto& l : levels) {
+			if (!l.covers(t0))
+				continue;
+			double points = l.period > 0 ? (t1 - t0) / l.period : l.count_between(t0, t1);
+			if (points <= max_points) {
+				level = &l;
+				break;
+			}
+		}
+		level->get(t0, t1, out);
+	}
+
+	/* Plot the average values of [now - duration, now]. */
+	void plot(const char *label, double now, double duration, float min, float max,
+			  ImVec2 size, bool no_frame = false) const {
+		std::vector<Sample> samples;
+		query(now - duration, now, std::max(16, (int)size.x), samples);
+
+		std::vector<float> values(samples.size());
+		for (size_t i = 0; i < samples.size(); i++)
+			values[i] = samples[i].avg;
+		ImGui::PlotLines(label, values.data(), values.size(), 0, NULL, min, max, size, sizeof(float), no_frame);
+	}
+
+	/* The highest average value plot() would draw. */
+	float peak(double now, double duration, int width) const {
+		std::vector<Sample> samples;
+		query(now - duration, now, std::max(16, width), samples);
+
+		float m = 0;
+		for (const auto& s : samples)
+			m = std::max(m, s.avg);
+		return m;
+	}
+
+	static double now() {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec + ts.tv_nsec * 1e-9;
+	}
+
+private:
+	struct Level {
+		Level(double _period, int capacity) : period(_period), samples(capacity), first(0), count(0),
+											  bucket_samples(0) { }
+
+		void add(double t, float v) {
+			if (period == 0) {
+				push({ t, v, v, v });
+				return;
+			}
+			double start = floor(t / period) * period;
+			if (bucket_samples && start != bucket.t) {
+				push(bucket);
+				bucket_samples = 0;
+			}
+			if (!bucket_samples) {
+				bucket = { start, v, v, v };
+				bucket_sum = 0;
+			}
+			bucket_samples++;
+			bucket_sum += v;
+			bucket.min = std::min(bucket.min, v);
+			bucket.max = std::max(bucket.max, v);
+			bucket.avg = bucket_sum / bucket_samples;
+		}
+
+		void push(const Sample& s) {
+			samples[(first + count) % samples.size()] = s;
+			if (count < (int)samples.size())
+				count++;
+			else
+				first = (first + 1) % samples.size();
+		}
+
+		const Sample& at(int i) const {
+			return samples[(first + i) % samples.size()];
+		}
+
+		/* Whether no sample since @t was dropped. */
+		bool covers(double t) const {
+			return count < (int)samples.size() || at(0).t <= t;
+		}
+
+		/* Index of the first sample at or after @t. */
+		int lower_bound(double t) const {
+			int lo = 0, hi = count;
+			while (lo < hi) {
+				int mid = (lo + hi) / 2;
+				if (at(mid).t < t)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			return lo;
+		}
+
+		int count_between(double t0, double t1) const {
+			return lower_bound(t1) - lower_bound(t0);
+		}
+
+		void get(double t0, double t1, std::vector<Sample>& out) const {
+			/* the bucket that has t0 started before it */
+			for (int i = lower_bound(t0 - period); i < count && at(i).t <= t1; i++)
+				out.push_back(at(i));
+			if (bucket_samples && bucket.t <= t1)
+				out.push_back(bucket);
+		}
+
+		double period; /* 0 for the raw samples */
+		std::vector<Sample> samples;
+		int first, count;
+		/* the bucket being filled */
+		Sample bucket;
+		int bucket_samples;
+		double bucket_sum;
+	};
+
+	std::vector<Level> levels;
+	float last_value = 0;
+};
+
+/* Window of history shown by the plots. */
+static const struct {
+	const char *label;
+	double seconds;
+} time_series_windows[] = {
+	{ "1 min", 60 },
+	{ "10 min", 600 },
+	{ "1 hour", 3600 },
+	{ "1 day", 24 * 3600 },
+};
@@ -23,13 +23,13 @@
  * of the Software.
  */
 #include "panels.h"
+#include "time_series.h"
 
 class TopPanel : public Panel {
 public:
 	TopPanel(struct umr_asic *asic) : Panel(asic), last_accumulate_answer(NULL),
-		fences_deltas(NULL),
-		consumed(false), top_read_interval(0.5),
-		last_sensor_read(0) {
+		history_window(0), top_read_interval(0.5),
+		last_sensor_read(0), stream_id(-1), last_poll(0) {
 		ipname = find_ip_name("mmGRBM_STATUS");
 		if (ipname == NULL)
 			ipname = find_ip_name("regGRBM_STATUS");
@@ -41,19 +41,44 @@ public:
 	}
 
 	void process_server_message(JSON_Object *response, void *raw_data, unsigned raw_data_size) {
+		JSON_Object *request = json_object(json_object_get_value(response, "request"));
 		JSON_Value *error = json_object_get_value(response, "error");
-		if (error)
+		if (error) {
+			/* the server forgot our session, start a new one */
+			if (!strcmp(json_object_get_string(request, "command"), "accumulate-poll"))
+				stream_id = -1;
 			return;
+		}
 
-		JSON_Object *request = json_object(json_object_get_value(response, "request"));
 		JSON_Value *answer = json_object_get_value(response, "answer");
 		const char *command = json_object_get_string(request, "command");
 
-		if (!strcmp(command, "accumulate")) {
+		if (!strcmp(command, "accumulate") || !strcmp(command, "accumulate-poll")) {
+			JSON_Object *a = json_object(answer);
+			if (!json_object_has_value(a, "fences")) {
+				/* partial counters: keep showing the last fences */
+				stream_id = json_object_get_number(a, "id");
+				if (last_accumulate_answer) {
+					json_object_set_value(last_accumulate_answer, "values",
+						json_value_deep_copy(json_object_get_value(a, "values")));
+					json_object_set_number(last_accumulate_answer, "samples",
+						json_object_get_number(a, "samples"));
+					return;
+				}
+			} else {
+				stream_id = -1;
+
+				double now = TimeSeries::now();
+				JSON_Array *fences = json_object_get_array(a, "fences");
+				fence_history.resize(json_array_get_count(fences));
+				for (size_t i = 0; i < fence_history.size(); i++) {
+					JSON_Object *fence = json_object(json_array_get_value(fences, i));
+					fence_history[i].add(now, json_object_get_number(fence, "delta") / top_read_interval);
+				}
+			}
 			if (last_accumulate_answer)
 				json_value_free(json_object_get_wrapping_value(last_accumulate_answer));
 			last_accumulate_answer = json_object(json_value_deep_copy(answer));
-			consumed = false;
 		}
 	}
 
@@ -70,7 +95,18 @@ public:
 			ImColor(80, 210, 156),
 		};
 
-		if (last_sensor_read > top_read_interval) {
+		if (stream_id >= 0) {
+			/* a sampling period is running, fetch its counters so far */
+			last_poll += dt;
+			if (last_poll > 0.1 && can_send_request) {
+				JSON_Value *req = json_value_init_object();
+				json_object_set_string(json_object(req), "command", "accumulate-poll");
+				json_object_set_number(json_object(req), "id", stream_id);
+				send_request(req);
+				last_poll = 0;
+			}
+			last_sensor_read += dt;
+		} else if (last_sensor_read > top_read_interval) {
 			if (can_send_request) {
 				const char *regs[] = {"mmGRBM_STATUS", "mmGRBM_STATUS2", NULL};
 				if (ipname == NULL) {
@@ -105,7 +141,9 @@ public:
 			ImGui::BeginChild("grbm bits", ImVec2(0, box_size * 2), false, ImGuiWindowFlags_NoTitleBar);
 			if (last_accumulate_answer) {
 				JSON_Array *values = json_object_get_array(last_accumulate_answer, "values");
-				int max_counter_value = (top_read_interval * 1000) / 10;
+				double max_counter_value = json_object_get_number(last_accumulate_answer, "samples");
+				if (max_counter_value <= 0)
+					max_counter_value = (top_read_interval * 1000) / 10;
 				ImVec2 text_base = ImGui::GetCursorScreenPos();
 				ImGui::NewLine();
 				ImVec2 base = ImGui::GetCursorScreenPos();
@@ -211,21 +249,27 @@ public:
 		}
 
 		if (ImGui::TreeNode("Fences count")) {
-			if (!fences_deltas) {
-				num_rings = json_array_get_count(json_object_get_array(info, "rings"));
-				fences_deltas = (float *)calloc(num_rings * 100, sizeof(float));
-				fence_deltas_offset = 0;
-			}
-
 			ImGui::Text("Number of fences signaled per second for each hardware queue:");
+			ImGui::SameLine();
+			ImGui::SetNextItemWidth(100 * get_gui_scale());
+			if (ImGui::BeginCombo("History", time_series_windows[history_window].label)) {
+				for (int i = 0; i < ARRAY_SIZE(time_series_windows); i++) {
+					if (ImGui::Selectable(time_series_windows[i].label, i == history_window))
+						history_window = i;
+				}
+				ImGui::EndCombo();
+			}
 			ImGui::Separator();
 			JSON_Array *fences = json_object_get_array(last_accumulate_answer, "fences");
+			int num_rings = std::min(json_array_get_count(fences), fence_history.size());
+			double now = TimeSeries::now();
+			double window = time_series_windows[history_window].seconds;
 
 			ImVec2 sc = ImGui::GetCursorScreenPos();
 
 			float max_value = 100;
-			for (int i = 0; i < num_rings * 100; i++)
-				max_value = std::max(max_value, fences_deltas[i]);
+			for (int i = 0; i < num_rings; i++)
+				max_value = std::max(max_value, fence_history[i].peak(now, window, avail.x));
 
 			if (max_value > 10000) {
 				max_value = 10000 * ceil(max_value / 10000);
@@ -236,10 +280,8 @@ public:
 			}
 
 			/* Draw graph (1 per queue) */
-			for (int i = 0; i < json_array_get_count(fences); i++) {
+			for (int i = 0; i < num_rings; i++) {
 				JSON_Object *fence = json_object(json_array_get_value(fences, i));
-				int delta = json_object_get_number(fence, "delta");
-				fences_deltas[i * 100 + fence_deltas_offset] = delta / top_read_interval;
 
 				ImGui::SetCursorScreenPos(sc);
 				const char *ring_name = json_object_get_string(fence, "name");
@@ -258,16 +300,8 @@ public:
 				ImGui::PushStyleColor(ImGuiCol_Text, (ImU32)color);
 
 				ImGui::PushID(ring_name);
-				ImGui::PlotLines(ring_name,
-					 &fences_deltas[i * 100],
-					 100,
-					 fence_deltas_offset + 1,
-					 NULL,
-					 0,
-					 max_value * 1.05,
-					 ImVec2(avail.x, avail.y / 2),
-					 sizeof(float),
-					 i != 0);
+				fence_history[i].plot(ring_name, now, window, 0, max_value * 1.05,
+									  ImVec2(avail.x, avail.y / 2), i != 0);
 
 				ImGui::PopID();
 
@@ -322,10 +356,6 @@ public:
 				ImGui::PopStyleColor(1);
 			}
 
-			if (!consumed) {
-				fence_deltas_offset = (fence_deltas_offset + 1) % 100;
-				consumed = true;
-			}
 			ImGui::TreePop();
 		}
 		ImGui::EndChild();
@@ -344,12 +374,14 @@ private:
 		json_object_set_value(json_object(req), "registers", regs);
 		json_object_set_number(json_object(req), "period", ms);
 		json_object_set_number(json_object(req), "step_ms", 10);
+		json_object_set_boolean(json_object(req), "stream", 1);
 		send_request(req);
 	}
 
 	const char *find_ip_name(const char *reg) {
 		for (int i = 0; i < (int) asic->no_blocks; i++) {
 			struct umr_ip_block *b = asic->blocks[i];
+			umr_load_ip_block(asic, b);
 			for (int j = 0; j < b->no_regs; j++) {
 				if (!strcmp(b->regs[j].regname, reg)) {
 					return b->ipname;
@@ -362,10 +394,10 @@ private:
 private:
 	JSON_Object *last_accumulate_answer;
 	const char *ipname;
-	float *fences_deltas;
-	int fence_deltas_offset;
-	bool consumed;
+	std::vector<TimeSeries> fence_history;
+	int history_window;
 	float last_sensor_read;
 	float top_read_interval;
-	int num_rings;
+	int stream_id;
+	float last_poll;
 };
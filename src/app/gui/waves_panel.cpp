@@ -25,6 +25,7 @@
 #include "panels.h"
 
 #include <regex.h>
+#include <set>
 #include <string>
 #include <unordered_map>
 
@@ -55,6 +56,7 @@ public:
 		for (const auto &entry : shaders)
 			json_value_free(json_object_get_wrapping_value(entry.second));
 		shaders.clear();
+		shader_lines.clear();
 	}
 
 	std::string get_wave_id(JSON_Object *wave) {
@@ -84,6 +86,33 @@ public:
 		return i;
 	}
 
+	/* The tree node labels are only formatted when a wave changes. */
+	void update_wave_label(size_t i) {
+		auto &w = waves[i];
+		int active_threads = -1;
+		JSON_Array *threads = json_object_get_array(w.wave, "threads");
+		w.exec = 0;
+		if (threads) {
+			active_threads = 0;
+			int s = json_array_get_count(threads);
+			for (int i = 0; i < s; i++) {
+				bool active = json_array_get_boolean(threads, i) == 1;
+				active_threads += active ? 1 : 0;
+				if (active)
+					w.exec |= (uint64_t)1 << i;
+			}
+		}
+
+		char label[256];
+		if (active_threads < 0)
+			sprintf(label, "Wave %s", w.id.c_str());
+		else if (json_object_get_string(w.wave, "shader"))
+			sprintf(label, "Wave %s (#dbde79%d threads, valid PC)", w.id.c_str(), active_threads);
+		else
+			sprintf(label, "Wave %s (#dbde79%d threads)", w.id.c_str(), active_threads);
+		w.label = label;
+	}
+
 	void update_shaders(JSON_Object *shaders_dict) {
 		int shaders_count = json_object_get_count(shaders_dict);
 		for (int i = 0; i < shaders_count; ++i) {
@@ -102,6 +131,12 @@ public:
 		const char *command = json_object_get_string(request, "command");
 
 		if (strcmp(command, "waves") == 0) {
+			std::set<std::string> open;
+			for (const auto &wave : waves) {
+				if (wave.open)
+					open.insert(wave.id);
+			}
+
 			active_shader_wave.clear();
 			clear_waves_and_shaders();
 
@@ -110,24 +145,35 @@ public:
 			for (int i = 0; i < wave_count; ++i) {
 				JSON_Object *wave = json_object(json_value_deep_copy(json_array_get_value(waves_array, i)));
 				waves.emplace_back(get_wave_id(wave), wave);
+				waves.back().open = open.count(waves.back().id) > 0;
+				update_wave_label(waves.size() - 1);
 			}
 
 			JSON_Object *shaders_dict = json_object_get_object(json_object(answer), "shaders");
 			update_shaders(shaders_dict);
 		} else if (strcmp(command, "singlestep") == 0) {
+			JSON_Object *delta = json_object_get_object(json_object(answer), "wave_delta");
 			JSON_Object *wave = json_object(json_value_deep_copy(json_object_get_value(json_object(answer), "wave")));
 			std::string id = get_wave_id(wave ? wave : request);
 			size_t i = find_wave_by_id(id);
-			if (i < waves.size()) {
+			if (delta) {
+				if (i < waves.size()) {
+					merge_wave_delta(waves[i].wave, delta);
+					update_wave_label(i);
+				}
+			} else if (i < waves.size()) {
 				json_value_free(json_object_get_wrapping_value(waves[i].wave));
 				if (wave) {
 					waves[i].wave = wave;
+					update_wave_label(i);
 				} else {
 					waves.erase(waves.begin() + i);
 				}
 			} else {
-				if (wave)
+				if (wave) {
 					waves.emplace_back(id, wave);
+					update_wave_label(waves.size() - 1);
+				}
 			}
 
 			JSON_Object *shaders_dict = json_object_get_object(json_object(answer), "shaders");
@@ -154,34 +200,21 @@ public:
 		if (!waves.empty()) {
 			ImGui::BeginChild("Waves", ImVec2(avail.x / 2, 0), false, ImGuiWindowFlags_NoTitleBar);
 			bool force_scroll = false;
+			/* Only the visible collapsed waves are drawn. */
+			std::vector<int> expanded;
 			for (size_t i = 0; i < waves.size(); ++i) {
+				if (waves[i].open)
+					expanded.push_back(i);
+			}
+			draw_clipped_rows(waves.size(), expanded, [&](int i) {
 				JSON_Object *wave = waves[i].wave;
-
-				int active_threads = -1;
-				uint64_t exec = 0;
 				JSON_Array *threads = json_object_get_array(wave, "threads");
-				if (threads) {
-					active_threads = 0;
-					int s = json_array_get_count(threads);
-					for (int i = 0; i < s; i++) {
-						bool active = json_array_get_boolean(threads, i) == 1;
-						active_threads += active ? 1 : 0;
-						if (active)
-							exec |= (uint64_t)1 << i;
-					}
-				}
+				const uint64_t exec = waves[i].exec;
 				const char *shader_address_str = json_object_get_string(wave, "shader");
 
-				char label[256];
-				if (active_threads < 0)
-					sprintf(label, "Wave %s", waves[i].id.c_str());
-				else if (shader_address_str)
-					sprintf(label, "Wave %s (#dbde79%d threads, valid PC)", waves[i].id.c_str(), active_threads);
-				else
-					sprintf(label, "Wave %s (#dbde79%d threads)", waves[i].id.c_str(), active_threads);
-
 				ImGui::PushID(i);
-				if (ImGui::TreeNode(waves[i].id.c_str(), "%s", label)) {
+				waves[i].open = ImGui::TreeNode(waves[i].id.c_str(), "%s", waves[i].label.c_str());
+				if (waves[i].open) {
 					ImGui::NextColumn();
 					ImGui::Text("PC: #b589000x%" PRIx64, (uint64_t)json_object_get_number(wave, "PC"));
 					if (shader_address_str) {
@@ -341,7 +374,7 @@ public:
 					ImGui::TreePop();
 				}
 				ImGui::PopID();
-			}
+			});
 			ImGui::EndChild();
 			ImGui::SameLine();
 			ImGui::BeginChild("Shaders", ImVec2(avail.x / 2, 0), false, ImGuiWindowFlags_NoTitleBar);
@@ -378,13 +411,9 @@ public:
 
 		int scroll = 0;
 		JSON_Array *op = json_object_get_array(shader, "opcodes");
-		uint32_t *copy = new uint32_t[json_array_get_count(op)];
-		for (size_t j = 0; j < json_array_get_count(op); j++)
-			copy[j] = (uint32_t)json_array_get_number(op, j);
-
 		uint64_t base_address = json_object_get_number(shader, "address");
-		char **opcode_strs = NULL;
-		umr_shader_disasm(asic, (uint8_t *)copy, json_array_get_count(op) * 4, base_address, &opcode_strs);
+		const int nops = json_array_get_count(op);
+		const std::vector<std::string> &lines = disassembly(shader_address_str, shader);
 
 		char tmp[128];
 		sprintf(tmp, "0x%" PRIx64, base_address);
@@ -394,7 +423,15 @@ public:
 		ImGui::TableSetupColumn("Raw Value", ImGuiTableColumnFlags_WidthFixed, ImGui::CalcTextSize(  "0x00000000  ").x);
 		ImGui::TableSetupColumn("Disassembly");
 		ImGui::TableHeadersRow();
-		for (size_t j = 0; j < json_array_get_count(op); j++) {
+		ImGuiListClipper clipper;
+		clipper.Begin(nops);
+		if (force_scroll && pc >= base_address && pc < base_address + nops * 4) {
+			/* Make sure the PC row is submitted to learn its position. */
+			int pc_row = (pc - base_address) / 4;
+			clipper.ForceDisplayRangeByIndices(pc_row, pc_row + 1);
+		}
+		while (clipper.Step())
+		for (int j = clipper.DisplayStart; j < clipper.DisplayEnd; j++) {
 			uint64_t addr = base_address + j * 4;
 			bool is_pc = pc == addr;
 			if (is_pc) {
@@ -405,7 +442,7 @@ public:
 
 			ImGui::TableNextRow();
 			ImGui::TableSetColumnIndex(0);
-			ImGui::Text("+ 0x%lx", j * 4);
+			ImGui::Text("+ 0x%x", j * 4);
 			if (ImGui::IsItemHovered()) {
 				ImGui::BeginTooltip();
 				ImGui::Text("0x%" PRIx64, base_address + j * 4);
@@ -414,14 +451,11 @@ public:
 			ImGui::TableSetColumnIndex(1);
 			ImGui::Text("0x%08x", (uint32_t)json_array_get_number(op, j));
 			ImGui::TableSetColumnIndex(2);
-			ImGui::Text("%s", shader_syntax.transform(opcode_strs[j]));
-			free(opcode_strs[j]);
+			ImGui::TextUnformatted(lines[j].c_str());
 			if (is_pc)
 				ImGui::PopStyleColor(1);
 		}
 		ImGui::EndTable();
-		free(opcode_strs);
-		delete[] copy;
 
 		if (force_scroll) {
 			ImGui::SetScrollY(scroll - avail.y / 2);
@@ -430,6 +464,28 @@ public:
 	}
 
 private:
+	/* Disassemble and highlight a shader once, not every frame. */
+	const std::vector<std::string> &disassembly(const char *address, JSON_Object *shader) {
+		auto it = shader_lines.find(address);
+		if (it != shader_lines.end())
+			return it->second;
+
+		JSON_Array *op = json_object_get_array(shader, "opcodes");
+		const size_t nops = json_array_get_count(op);
+		uint32_t *copy = new uint32_t[nops];
+		for (size_t j = 0; j < nops; j++)
+			copy[j] = (uint32_t)json_array_get_number(op, j);
+
+		struct umr_disasm_block *text = umr_shader_disasm_block_cached(asic, json_object_get_number(shader, "vmid"), copy, nops * 4,
+																	   json_object_get_number(shader, "address"));
+		std::vector<std::string> &lines = shader_lines[address];
+		for (size_t j = 0; j < nops; j++)
+			lines.push_back(text ? shader_syntax.transform(umr_disasm_line(text, j)) : "...");
+		free(text);
+		delete[] copy;
+		return lines;
+	}
+
 	void send_waves_command(bool resume_waves, bool disable_gfxoff, bool capture_gprs) {
 		JSON_Value *req = json_value_init_object();
 		json_object_set_string(json_object(req), "command", "waves");
@@ -444,6 +500,8 @@ private:
 		assert(asic->family >= FAMILY_NV);
 		JSON_Value *req = json_value_init_object();
 		json_object_set_string(json_object(req), "command", "singlestep");
+		// only the changes can be merged into a wave that has its GPRs
+		json_object_set_boolean(json_object(req), "incremental", json_object_get_array(wave, "sgpr") != NULL);
 		json_object_set_string(json_object(req), "ring", asic->family >= FAMILY_NV ? "gfx_0.0.0" : "gfx");
 		json_object_set_number(json_object(req), "se", json_object_get_number(wave, "se"));
 		json_object_set_number(json_object(req), "sh", json_object_get_number(wave, "sh"));
@@ -453,10 +511,55 @@ private:
 		send_request(req);
 	}
 
+	// apply the changes sent by an incremental singlestep
+	void merge_wave_delta(JSON_Object *wave, JSON_Object *delta) {
+		json_object_set_number(wave, "PC", json_object_get_number(delta, "PC"));
+		json_object_set_value(wave, "threads", json_value_deep_copy(json_object_get_value(delta, "threads")));
+
+		JSON_Object *registers = json_object_get_object(wave, "registers");
+		JSON_Object *changed = json_object_get_object(delta, "registers");
+		for (size_t j = 0; j < json_object_get_count(changed); j++)
+			json_object_set_value(registers, json_object_get_name(changed, j),
+								  json_value_deep_copy(json_object_get_value_at(changed, j)));
+
+		// SGPR numbers from 0x6C on are the trap temporaries
+		JSON_Array *sgpr = json_object_get_array(wave, "sgpr");
+		JSON_Array *extra_sgpr = json_object_get_array(wave, "extra_sgpr");
+		JSON_Array *blocks = json_object_get_array(delta, "sgpr_blocks");
+		for (size_t b = 0; b < json_array_get_count(blocks); b++) {
+			JSON_Object *block = json_array_get_object(blocks, b);
+			JSON_Array *values = json_object_get_array(block, "values");
+			size_t start = (size_t)json_object_get_number(block, "start");
+			for (size_t x = 0; x < json_array_get_count(values); x++) {
+				size_t r = start + x;
+				double v = json_array_get_number(values, x);
+				if (r < json_array_get_count(sgpr))
+					json_array_replace_number(sgpr, r, v);
+				else if (r >= 0x6C && r - 0x6C < json_array_get_count(extra_sgpr))
+					json_array_replace_number(extra_sgpr, r - 0x6C, v);
+			}
+		}
+
+		JSON_Array *vgpr = json_object_get_array(wave, "vgpr");
+		blocks = json_object_get_array(delta, "vgpr_blocks");
+		for (size_t b = 0; b < json_array_get_count(blocks); b++) {
+			JSON_Object *block = json_array_get_object(blocks, b);
+			JSON_Array *rows = json_object_get_array(block, "rows");
+			size_t start = (size_t)json_object_get_number(block, "start");
+			for (size_t x = 0; x < json_array_get_count(rows); x++) {
+				if (start + x < json_array_get_count(vgpr))
+					json_array_replace_value(vgpr, start + x, json_value_deep_copy(json_array_get_value(rows, x)));
+			}
+		}
+	}
+
 private:
 	struct Wave {
 		std::string id; // "seN.saN.etc"
+		std::string label;
 		JSON_Object *wave;
+		uint64_t exec = 0;
+		bool open = false;
 		int vgpr_view[512] = {};
 
 		Wave(std::string id, JSON_Object *wave) : id(id), wave(wave) {}
@@ -465,6 +568,7 @@ private:
 	SyntaxHighlighter shader_syntax;
 	std::vector<Wave> waves;
 	std::unordered_map<std::string, JSON_Object *> shaders;
+	std::unordered_map<std::string, std::vector<std::string>> shader_lines;
 	std::string active_shader_wave;
 	bool resume = true;
 	bool turn_off_gfxoff = true;
@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "wire.h"
+
+/*
+ * Each value is a tag byte followed by:
+ *
+ *   WIRE_NULL, WIRE_FALSE, WIRE_TRUE	nothing
+ *   WIRE_U32				the number as a 32-bit word
+ *   WIRE_DOUBLE			the number as a 64-bit double
+ *   WIRE_STRING			the length and the bytes (no NUL)
+ *   WIRE_ARRAY				the count and that many values
+ *   WIRE_OBJECT			the count and that many names (length
+ *					with the NUL and the bytes) and values
+ *   WIRE_U32_ARRAY			the count and that many 32-bit words
+ *
+ * Arrays of whole numbers that fit in 32 bits (GPRs, register values,
+ * ring words, ...) go as one block of words rather than element by
+ * element, no number is ever formatted or parsed as text.  Everything
+ * is little endian like the rest of rumr.
+ */
+enum {
+	WIRE_NULL = 0,
+	WIRE_FALSE,
+	WIRE_TRUE,
+	WIRE_U32,
+	WIRE_DOUBLE,
+	WIRE_STRING,
+	WIRE_ARRAY,
+	WIRE_OBJECT,
+	WIRE_U32_ARRAY,
+};
+
+// nesting allowed when decoding, the GUI messages are a few levels deep
+#define WIRE_MAX_DEPTH	64
+
+static int is_u32(double d)
+{
+	return d >= 0 && d <= 0xFFFFFFFFUL && d == (double)(uint32_t)d;
+}
+
+static void add_tag(struct rumr_buffer *buf, uint8_t tag)
+{
+	rumr_buffer_add_data(buf, &tag, 1);
+}
+
+// are all the elements of @array numbers that fit WIRE_U32?
+static int u32_array(const JSON_Array *array, size_t count)
+{
+	const JSON_Value *v;
+	size_t x;
+
+	for (x = 0; x < count; x++) {
+		v = json_array_get_value(array, x);
+		if (json_value_get_type(v) != JSONNumber || !is_u32(json_value_get_number(v)))
+			return 0;
+	}
+	return count > 0;
+}
+
+/**
+ * umr_wire_encode - Append the binary encoding of a JSON value
+ * @buf: Where to append it
+ * @value: The value (a NULL value is encoded as null)
+ *
+ * Returns 0 on success, -1 if @buf ran out of memory.
+ */
+int umr_wire_encode(struct rumr_buffer *buf, const JSON_Value *value)
+{
+	const JSON_Object *obj;
+	const JSON_Array *array;
+	const char *name;
+	size_t count, x;
+	uint32_t w;
+	double d;
+
+	switch (value ? json_value_get_type(value) : JSONNull) {
+		case JSONBoolean:
+			add_tag(buf, json_value_get_boolean(value) ? WIRE_TRUE : WIRE_FALSE);
+			break;
+		case JSONNumber:
+			d = json_value_get_number(value);
+			if (is_u32(d)) {
+				add_tag(buf, WIRE_U32);
+				rumr_buffer_add_uint32(buf, (uint32_t)d);
+			} else {
+				add_tag(buf, WIRE_DOUBLE);
+				rumr_buffer_add_data(buf, &d, sizeof d);
+			}
+			break;
+		case JSONString:
+			add_tag(buf, WIRE_STRING);
+			rumr_buffer_add_uint32(buf, json_value_get_string_len(value));
+			rumr_buffer_add_data(buf, (void *)json_value_get_string(value), json_value_get_string_len(value));
+			break;
+		case JSONArray:
+			array = json_value_get_array(value);
+			count = json_array_get_count(array);
+			if (u32_array(array, count)) {
+				add_tag(buf, WIRE_U32_ARRAY);
+				rumr_buffer_add_uint32(buf, count);
+				if (rumr_buffer_reserve(buf, buf->woffset + 4 * count))
+					return -1;
+				for (x = 0; x < count; x++) {
+					w = json_array_get_number(array, x);
+					memcpy(&buf->data[buf->woffset + 4 * x], &w, 4);
+				}
+				buf->woffset += 4 * count;
+				break;
+			}
+			add_tag(buf, WIRE_ARRAY);
+			rumr_buffer_add_uint32(buf, count);
+			for (x = 0; x < count; x++)
+				umr_wire_encode(buf, json_array_get_value(array, x));
+			break;
+		case JSONObject:
+			obj = json_value_get_object(value);
+			count = json_object_get_count(obj);
+			add_tag(buf, WIRE_OBJECT);
+			rumr_buffer_add_uint32(buf, count);
+			for (x = 0; x < count; x++) {
+				name = json_object_get_name(obj, x);
+				rumr_buffer_add_uint32(buf, strlen(name) + 1);
+				rumr_buffer_add_data(buf, (void *)name, strlen(name) + 1);
+				umr_wire_encode(buf, json_object_get_value_at(obj, x));
+			}
+			break;
+		default:
+			add_tag(buf, WIRE_NULL);
+			break;
+	}
+	return buf->failed ? -1 : 0;
+}
+
+struct wire_reader {
+	const uint8_t *data;
+	uint32_t size, off;
+	int failed;
+};
+
+static const uint8_t *wire_take(struct wire_reader *r, uint32_t n)
+{
+	const uint8_t *p;
+
+	if (r->failed || r->size - r->off < n) {
+		r->failed = 1;
+		return NULL;
+	}
+	p = r->data + r->off;
+	r->off += n;
+	return p;
+}
+
+static uint32_t wire_u32(struct wire_reader *r)
+{
+	const uint8_t *p = wire_take(r, 4);
+	uint32_t w = 0;
+
+	if (p)
+		memcpy(&w, p, 4);
+	return w;
+}
+
+static JSON_Value *wire_value(struct wire_reader *r, int depth)
+{
+	const uint8_t *p;
+	JSON_Value *v = NULL, *e;
+	uint32_t count, len, x, w;
+	double d;
+
+	p = wire_take(r, 1);
+	if (!p || depth > WIRE_MAX_DEPTH)
+		return NULL;
+
+	switch (*p) {
+		case WIRE_NULL:
+			return json_value_init_null();
+		case WIRE_FALSE:
+		case WIRE_TRUE:
+			return json_value_init_boolean(*p == WIRE_TRUE);
+		case WIRE_U32:
+			w = wire_u32(r);
+			return r->failed ? NULL : json_value_init_number(w);
+		case WIRE_DOUBLE:
+			p = wire_take(r, sizeof d);
+			if (!p)
+				return NULL;
+			memcpy(&d, p, sizeof d);
+			return json_value_init_number(d);
+		case WIRE_STRING:
+			len = wire_u32(r);
+			p = wire_take(r, len);
+			return p ? json_value_init_string_with_len((const char *)p, len) : NULL;
+		case WIRE_U32_ARRAY:
+			count = wire_u32(r);
+			if (r->failed || count > (r->size - r->off) / 4)
+				return NULL;
+			p = wire_take(r, 4 * count);
+			v = json_value_init_array();
+			for (x = 0; v && x < count; x++) {
+				memcpy(&w, p + 4 * x, 4);
+				if (json_array_append_number(json_array(v), w) != JSONSuccess)
+					goto fail;
+			}
+			return v;
+		case WIRE_ARRAY:
+			count = wire_u32(r);
+			v = json_value_init_array();
+			for (x = 0; v && x < count && !r->failed; x++) {
+				e = wire_value(r, depth + 1);
+				if (!e || json_array_append_value(json_array(v), e) != JSONSuccess) {
+					json_value_free(e);
+					goto fail;
+				}
+			}
+			break;
+		case WIRE_OBJECT:
+			count = wire_u32(r);
+			v = json_value_init_object();
+			for (x = 0; v && x < count && !r->failed; x++) {
+				len = wire_u32(r);
+				p = wire_take(r, len);
+				if (!p || !len || p[len - 1])
+					goto fail;
+				e = wire_value(r, depth + 1);
+				if (!e || json_object_set_value(json_object(v), (const char *)p, e) != JSONSuccess) {
+					json_value_free(e);
+					goto fail;
+				}
+			}
+			break;
+		default:
+			return NULL;
+	}
+	if (!r->failed)
+		return v;
+fail:
+	json_value_free(v);
+	return NULL;
+}
+
+/**
+ * umr_wire_decode - Decode a value encoded by umr_wire_encode()
+ * @data: The encoding
+ * @size: Bytes available at @data
+ * @used: Set to the bytes the value took (may be NULL)
+ *
+ * Returns the value or NULL if @data is truncated or corrupt.
+ */
+JSON_Value *umr_wire_decode(const uint8_t *data, uint32_t size, uint32_t *used)
+{
+	struct wire_reader r = { data, size, 0, 0 };
+	JSON_Value *v;
+
+	v = wire_value(&r, 0);
+	if (v && used)
+		*used = r.off;
+	return v;
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+#ifndef UMR_GUI_WIRE_H_
+#define UMR_GUI_WIRE_H_
+
+#include <stdint.h>
+#include "parson.h"
+#include "umr_rumr.h"
+
+/*
+ * Binary framing of the GUI/server messages, used instead of JSON text
+ * once the client asked for it with a "wire-format" request.
+ *
+ * A binary request is UMR_WIRE_MAGIC followed by the encoded request, a
+ * binary reply is UMR_WIRE_MAGIC, the size of the raw data, the encoded
+ * reply and the raw data.  Text requests (starting with '{') get text
+ * replies as before: the size of the raw data, the JSON text with its
+ * terminating NUL and the raw data.
+ */
+#define UMR_WIRE_MAGIC	0x42524D55UL // "UMRB"
+
+int umr_wire_encode(struct rumr_buffer *buf, const JSON_Value *value);
+JSON_Value *umr_wire_decode(const uint8_t *data, uint32_t size, uint32_t *used);
+
+#endif
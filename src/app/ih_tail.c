@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umrapp.h"
+#include <signal.h>
+#include <time.h>
+
+// each vector on one line
+static void start_vector(struct umr_ih_decode_ui *ui, uint32_t offset)
+{
+	struct umr_asic *asic = ui->data;
+
+	asic->std_msg("IH[0x%04"PRIx32"]:", offset * 4);
+}
+
+static void add_field(struct umr_ih_decode_ui *ui, uint32_t offset, const char *field_name, uint32_t value, char *str, int ideal_radix)
+{
+	struct umr_asic *asic = ui->data;
+
+	(void)offset;
+	if (str)
+		asic->std_msg(" %s=%s", field_name, str);
+	else if (ideal_radix == 16)
+		asic->std_msg(" %s=0x%"PRIx32, field_name, value);
+	else
+		asic->std_msg(" %s=%"PRIu32, field_name, value);
+}
+
+static void done(struct umr_ih_decode_ui *ui)
+{
+	struct umr_asic *asic = ui->data;
+
+	asic->std_msg("\n");
+}
+
+static volatile sig_atomic_t tail_quit;
+
+static void tail_sigint(int signo)
+{
+	(void)signo;
+	tail_quit = 1;
+}
+
+/*
+ * parse_filter - parse "client=N,source=N,vmid=N,pasid=N" (any subset,
+ * numbers in C notation) into 'f'.  Returns -1 on an unknown key.
+ */
+static int parse_filter(const char *spec, struct umr_ih_filter *f)
+{
+	char key[16];
+	long val;
+	int n;
+
+	while (*spec) {
+		if (sscanf(spec, "%15[a-z]=%li%n", key, &val, &n) != 2)
+			return -1;
+		if (!strcmp(key, "client"))
+			f->client_id = val;
+		else if (!strcmp(key, "source"))
+			f->source_id = val;
+		else if (!strcmp(key, "vmid"))
+			f->vmid = val;
+		else if (!strcmp(key, "pasid"))
+			f->pasid = val;
+		else
+			return -1;
+		spec += n;
+		if (*spec == ',')
+			++spec;
+	}
+	return 0;
+}
+
+/**
+ * umr_ih_tail - print the IH vectors as they arrive until interrupted
+ *
+ * @asic: The device
+ * @filter: NULL or the vectors to print (see parse_filter())
+ *
+ * Every second the sources with vectors in the last few seconds are listed
+ * with their rate so a storm shows up even when its vectors are filtered.
+ */
+int umr_ih_tail(struct umr_asic *asic, const char *filter)
+{
+	struct umr_ih_decode_ui ui = { &start_vector, &add_field, &done, asic };
+	struct umr_ih_ring ih;
+	struct timespec req = { 0, 100000000 };
+	void (*old_sigint)(int);
+	uint64_t last_sec = 0;
+	uint32_t rate;
+	int x;
+
+	if (umr_ih_ring_init(asic, &ih, 0))
+		return -1;
+	if (filter && parse_filter(filter, &ih.filter)) {
+		asic->err_msg("[ERROR]: Invalid --ih-tail filter '%s'\n", filter);
+		umr_ih_ring_free(&ih);
+		return -1;
+	}
+
+	asic->std_msg("-- following the IH ring (%"PRIu32" bytes at 0x%"PRIx64"), ^C to stop\n", ih.size, ih.addr);
+	tail_quit = 0;
+	old_sigint = signal(SIGINT, tail_sigint);
+	while (!tail_quit) {
+		// the ring may have been remapped since the last poll
+		umr_vm_tlb_flush(asic);
+		if (umr_ih_ring_poll(asic, &ih, &ui) < 0)
+			break;
+		if (ih.now_sec != last_sec) {
+			if (last_sec) {
+				asic->std_msg("-- %"PRIu64" vectors, %"PRIu64" filtered, %"PRIu64" overflows\n", ih.vectors, ih.filtered, ih.overflows);
+				for (x = 0; x < ih.no_rates; x++) {
+					rate = umr_ih_source_rate(&ih.rates[x]);
+					if (rate)
+						asic->std_msg("--   client %3"PRIu32" source %3"PRIu32": %8"PRIu32"/s (%"PRIu64" total)\n",
+							ih.rates[x].client_id, ih.rates[x].source_id, rate, ih.rates[x].total);
+				}
+			}
+			last_sec = ih.now_sec;
+		}
+		fflush(stdout);
+		nanosleep(&req, NULL);
+	}
+	signal(SIGINT, old_sigint);
+	umr_ih_ring_free(&ih);
+	return 0;
+}
@@ -186,5 +186,5 @@ struct smu_11_0_powerplay_table
 	struct smu_11_0_overdrive_table               overdrive_table;
 } __attribute__((packed));
 
-int umr_navi10_pptable_print(const char* param, FILE* fp);
+int umr_navi10_pptable_print(const char* param, const uint8_t *raw, uint32_t size, uint64_t hash);
 #endif
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umrapp.h"
+
+/*
+ * JSON Lines output (--jsonl).  Every record is one compact JSON object
+ * on a line of its own with a "type" member naming what it describes.
+ * Records are built straight into a buffer that is written to stdout when
+ * it fills up, by umr_jsonl_flush() and at exit.  Addresses are strings
+ * ("0x...") so they survive consumers that parse numbers as doubles.
+ */
+
+#define JSONL_BUFSIZE (256 * 1024)
+#define JSONL_DEPTH   8
+
+static struct {
+	char *buf;
+	size_t used;
+	int depth;
+	int first[JSONL_DEPTH];     // nothing was written at this depth yet
+	int array[JSONL_DEPTH];     // the depth is an array rather than an object
+} jsonl;
+
+void umr_jsonl_flush(void)
+{
+	if (jsonl.used) {
+		fwrite(jsonl.buf, 1, jsonl.used, stdout);
+		jsonl.used = 0;
+	}
+	fflush(stdout);
+}
+
+static void jsonl_putn(const char *s, size_t len)
+{
+	if (!jsonl.buf) {
+		jsonl.buf = malloc(JSONL_BUFSIZE);
+		if (!jsonl.buf) {
+			fwrite(s, 1, len, stdout);
+			return;
+		}
+		atexit(umr_jsonl_flush);
+	}
+	if (jsonl.used + len > JSONL_BUFSIZE)
+		umr_jsonl_flush();
+	if (len > JSONL_BUFSIZE) {
+		fwrite(s, 1, len, stdout);
+		return;
+	}
+	memcpy(jsonl.buf + jsonl.used, s, len);
+	jsonl.used += len;
+}
+
+static void jsonl_puts(const char *s)
+{
+	jsonl_putn(s, strlen(s));
+}
+
+static void jsonl_string(const char *s)
+{
+	char esc[8];
+	const char *p;
+
+	jsonl_putn("\"", 1);
+	for (p = s; *p; p++) {
+		if (*p == '"' || *p == '\\' || (unsigned char)*p < 0x20) {
+			jsonl_putn(s, p - s);
+			if (*p == '"' || *p == '\\')
+				snprintf(esc, sizeof esc, "\\%c", *p);
+			else if (*p == '\n')
+				strcpy(esc, "\\n");
+			else
+				snprintf(esc, sizeof esc, "\\u%04x", (unsigned char)*p);
+			jsonl_puts(esc);
+			s = p + 1;
+		}
+	}
+	jsonl_putn(s, p - s);
+	jsonl_putn("\"", 1);
+}
+
+// the separator and name of the next member
+static void jsonl_key(const char *key)
+{
+	if (!jsonl.first[jsonl.depth])
+		jsonl_putn(",", 1);
+	jsonl.first[jsonl.depth] = 0;
+	if (key) {
+		jsonl_string(key);
+		jsonl_putn(":", 1);
+	}
+}
+
+/**
+ * umr_jsonl_begin - Start a record
+ * @type: The value of its "type" member, e.g. "reg" or "wave"
+ */
+void umr_jsonl_begin(const char *type)
+{
+	jsonl.depth = 0;
+	jsonl.first[0] = 1;
+	jsonl_putn("{", 1);
+	umr_jsonl_str("type", type);
+	// the records of -vmp all are tagged with their XCC
+	if (umr_xcc_current() >= 0)
+		umr_jsonl_int("xcc", umr_xcc_current());
+}
+
+/**
+ * umr_jsonl_end - Finish the record (and any object or array still open)
+ */
+void umr_jsonl_end(void)
+{
+	while (jsonl.depth > 0)
+		umr_jsonl_close();
+	jsonl_putn("}\n", 2);
+}
+
+/**
+ * umr_jsonl_object - Open a nested object (@array = 0) or array
+ * @key: Its name, NULL inside an array
+ *
+ * Close it with umr_jsonl_close(), at most JSONL_DEPTH - 1 can be open.
+ */
+void umr_jsonl_object(const char *key, int array)
+{
+	jsonl_key(key);
+	jsonl_putn(array ? "[" : "{", 1);
+	++jsonl.depth;
+	jsonl.first[jsonl.depth] = 1;
+	jsonl.array[jsonl.depth] = array;
+}
+
+void umr_jsonl_close(void)
+{
+	jsonl_putn(jsonl.array[jsonl.depth] ? "]" : "}", 1);
+	--jsonl.depth;
+}
+
+void umr_jsonl_str(const char *key, const char *value)
+{
+	jsonl_key(key);
+	jsonl_string(value ? value : "");
+}
+
+void umr_jsonl_u64(const char *key, uint64_t value)
+{
+	char buf[32];
+
+	jsonl_key(key);
+	snprintf(buf, sizeof buf, "%" PRIu64, value);
+	jsonl_puts(buf);
+}
+
+void umr_jsonl_int(const char *key, int64_t value)
+{
+	char buf[32];
+
+	jsonl_key(key);
+	snprintf(buf, sizeof buf, "%" PRId64, value);
+	jsonl_puts(buf);
+}
+
+void umr_jsonl_hex(const char *key, uint64_t value)
+{
+	char buf[32];
+
+	jsonl_key(key);
+	snprintf(buf, sizeof buf, "\"0x%" PRIx64 "\"", value);
+	jsonl_puts(buf);
+}
+
+void umr_jsonl_bool(const char *key, int value)
+{
+	jsonl_key(key);
+	jsonl_puts(value ? "true" : "false");
+}
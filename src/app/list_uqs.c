@@ -28,6 +28,32 @@
 #include <time.h>
 #include <stdarg.h>
 
+/*
+ * print_client - print the queues of a client, only those that changed in
+ * generation 'gen' if 'generation' is not NULL.  Returns 1 if anything was printed.
+ */
+static int print_client(struct umr_asic *asic, struct umr_user_queue *uq, const uint64_t *generation, uint64_t gen)
+{
+    int x, first = 1;
+
+    for (x = 0; x < UMR_MAX_MQD_QUEUES; x++) {
+        if (uq->client_info.queue[x].mqd_gpu_address && (!generation || generation[x] == gen)) {
+            if (first) {
+                asic->std_msg("Client #%s: comm=[%s] tgid=%s type=%s\n",
+                    uq->client_line.id, uq->client_line.command, uq->client_line.tgid, uq->client_type == UMR_CLIENT_KFD ? "kfd" : "kgd");
+                first = 0;
+            }
+            asic->std_msg("%s   queue=%d type=%d mqd_gpu_addr=0x%"PRIx64" rptr=0x%"PRIx64" wptr=0x%"PRIx64"\n",
+                uq->client_info.queue[x].hqd_rptr_value != uq->client_info.queue[x].rb_wptr_poll_value ? "**" : "  ",
+                uq->client_info.queue[x].queue_id, uq->client_info.queue[x].queue_type,
+                uq->client_info.queue[x].mqd_gpu_address,
+                uq->client_info.queue[x].hqd_rptr_value, 
+                uq->client_info.queue[x].rb_wptr_poll_value);
+        }
+    }
+    return !first;
+}
+
 /**
  * umr_list_uqs - list the user queues for the user
  */
@@ -37,25 +63,56 @@ void umr_list_uqs(struct umr_asic *asic)
 
     tq = uq = umr_enumerate_user_queue_clients(asic);
     while (uq) {
-        int x, first = 1;
-        for (x = 0; x < UMR_MAX_MQD_QUEUES; x++) {
-            if (uq->client_info.queue[x].mqd_gpu_address) {
-                if (first) {
-                    asic->std_msg("Client #%s: comm=[%s] tgid=%s type=%s\n",
-                        uq->client_line.id, uq->client_line.command, uq->client_line.tgid, uq->client_type == UMR_CLIENT_KFD ? "kfd" : "kgd");
-                    first = 0;
-                }
-                asic->std_msg("%s   queue=%d type=%d mqd_gpu_addr=0x%"PRIx64" rptr=0x%"PRIx64" wptr=0x%"PRIx64"\n",
-                    uq->client_info.queue[x].hqd_rptr_value != uq->client_info.queue[x].rb_wptr_poll_value ? "**" : "  ",
-                    uq->client_info.queue[x].queue_id, uq->client_info.queue[x].queue_type,
-                    uq->client_info.queue[x].mqd_gpu_address,
-                    uq->client_info.queue[x].hqd_rptr_value, 
-                    uq->client_info.queue[x].rb_wptr_poll_value);
-            }
-        }
-        if (!first && uq->next)
+        if (print_client(asic, uq, NULL, 0) && uq->next)
             asic->std_msg("\n");
         uq = uq->next;
     }
     umr_user_queue_free(tq);
+}
+
+static volatile sig_atomic_t follow_quit;
+
+static void follow_sigint(int signo)
+{
+    (void)signo;
+    follow_quit = 1;
+}
+
+/**
+ * umr_follow_uqs - list the user queues and then every second the queues that changed
+ *
+ * The clients are kept in asic->uq_registry so a poll only re-reads the
+ * rptr/wptr of the known queues (see umr_uq_registry_refresh()).
+ */
+void umr_follow_uqs(struct umr_asic *asic)
+{
+    struct umr_uq_registry *reg;
+    struct timespec req = { 1, 0 };
+    void (*old_sigint)(int);
+    int n, r, first = 1;
+
+    follow_quit = 0;
+    old_sigint = signal(SIGINT, follow_sigint);
+    while (!follow_quit) {
+        // the MQDs may have been remapped since the last refresh
+        umr_vm_tlb_flush(asic);
+        r = umr_uq_registry_refresh(asic);
+        if (r < 0)
+            break;
+        reg = asic->uq_registry;
+        if (first) {
+            for (n = 0; n < reg->no_entries; n++)
+                if (print_client(asic, &reg->entries[n].uq, NULL, 0) && n + 1 < reg->no_entries)
+                    asic->std_msg("\n");
+            asic->std_msg("-- following %d clients, ^C to stop\n", reg->no_entries);
+            first = 0;
+        } else if (r) {
+            for (n = 0; n < reg->no_entries; n++)
+                print_client(asic, &reg->entries[n].uq, reg->entries[n].generation, reg->generation);
+            asic->std_msg("-- %d queue(s) changed\n", r);
+        }
+        fflush(stdout);
+        nanosleep(&req, NULL);
+    }
+    signal(SIGINT, old_sigint);
 }
\ No newline at end of file
@@ -38,7 +38,12 @@ void sigint(int signo)
 
 struct umr_options options;
 static struct umr_asic *asic;
+static struct umr_asic *daemon_asic; // set in the children of --daemon
 static struct umr_test_harness *th = NULL;
+static struct umr_capture_bundle *bundle = NULL;
+static char *capture_path = NULL;
+static int profiler_export_format;
+static char profiler_export_path[256];
 
 static int std_printf(const char *fmt, ...)
 {
@@ -69,24 +74,45 @@ static int err_printf(const char *fmt, ...)
 
 static struct rumr_comm_funcs *rumr_get_cf(char *arg, char **addr)
 {
+	const struct rumr_comm_funcs *funcs = rumr_comm_lookup(arg, addr);
 	struct rumr_comm_funcs *cf;
-	*addr = arg;
-
-	if (!memcmp(arg, "tcp://", 6)) {
-		cf = calloc(1, sizeof rumr_tcp_funcs);
-		*cf = rumr_tcp_funcs;
-		cf->log_msg = err_printf;
-		*addr = &arg[6];
-		return cf;
-	}
-	return NULL;
+
+	if (!funcs)
+		return NULL;
+	cf = calloc(1, sizeof *cf);
+	*cf = *funcs;
+	cf->log_msg = err_printf;
+	return cf;
 }
 
 static struct umr_asic *get_asic(void)
 {
 	struct umr_options topt;
 
-	if (th && th->discovery.contents) {
+	if (daemon_asic) {
+		// the device (and how it was set up) is the daemon's, the rest of the options the command's
+		options.instance = daemon_asic->options.instance;
+		options.pci = daemon_asic->options.pci;
+		options.use_xgmi = daemon_asic->options.use_xgmi;
+		options.shader_enable = daemon_asic->options.shader_enable;
+		memcpy(options.database_path, daemon_asic->options.database_path, sizeof options.database_path);
+		daemon_asic->options = options;
+		// the regs2 file is shared with the daemon and the other
+		// children, its bank state may not be what this copy cached
+		umr_mmio2_invalidate_bank(daemon_asic);
+		return daemon_asic;
+	} else if (bundle) {
+		// there is no device to look for an instance on
+		if (options.instance < 0)
+			options.instance = 0;
+		asic = umr_discover_asic_by_name(&options, strlen(options.dev_name) ? options.dev_name : (char *)umr_capture_bundle_asicname(bundle), std_printf);
+		if (!asic)
+			exit(EXIT_FAILURE);
+		umr_attach_capture_bundle(bundle, asic);
+		asic->err_msg = std_printf;
+		asic->std_msg = std_printf;
+		return asic;
+	} else if (th && th->discovery.contents) {
 		asic = umr_discover_asic_by_discovery_table("emulated", &options, std_printf);
 		umr_attach_test_harness(th, asic);
 		asic->err_msg = std_printf;
@@ -135,26 +161,50 @@ retry:
 
 	if (asic->options.use_pci == 0)
 		asic->mem_funcs.access_linear_vram = umr_access_linear_vram;
-	else
+	else {
 		asic->mem_funcs.access_linear_vram = umr_access_vram_via_mmio;
+		asic->mem_funcs.no_readahead = 1;
+	}
 
 	asic->reg_funcs.read_reg = umr_read_reg;
 	asic->reg_funcs.write_reg = umr_write_reg;
+	asic->reg_funcs.read_reg64 = umr_read_reg64;
+	asic->reg_funcs.write_reg64 = umr_write_reg64;
 	asic->ring_func.read_ring_data = umr_read_ring_data;
+	asic->ring_func.read_ring_header = umr_read_ring_header;
+	asic->ring_func.read_ring_window = umr_read_ring_window;
 
 	asic->wave_funcs.get_wave_sq_info = umr_get_wave_sq_info;
 	if (options.no_kernel) {
 		asic->gpr_read_funcs.read_sgprs = umr_read_sgprs_via_mmio;
 		asic->gpr_read_funcs.read_vgprs = umr_read_vgprs_via_mmio;
 		asic->wave_funcs.get_wave_status = umr_get_wave_status_via_mmio;
+		asic->wave_funcs.get_wave_status_bulk = umr_get_wave_status_via_mmio_bulk;
 	} else {
 		asic->gpr_read_funcs.read_sgprs = umr_read_sgprs;
 		asic->gpr_read_funcs.read_vgprs = umr_read_vgprs;
 		asic->wave_funcs.get_wave_status = umr_get_wave_status;
+		asic->wave_funcs.get_wave_status_bulk = umr_get_wave_status_bulk;
 	}
 
 	asic->shader_disasm_funcs.disasm = umr_shader_disasm;
 
+	if (asic->options.use_io_uring && !asic->options.no_kernel) {
+		if (!umr_uring_init(asic)) {
+			asic->reg_funcs.read_reg = umr_read_reg_uring;
+			asic->reg_funcs.write_reg = umr_write_reg_uring;
+			asic->mem_funcs.access_sram = umr_access_sram_uring;
+			if (asic->options.use_pci == 0)
+				asic->mem_funcs.access_linear_vram = umr_access_linear_vram_uring;
+		} else {
+			asic->err_msg("[WARNING]: io_uring is not available, using regular debugfs access\n");
+		}
+	}
+
+	// direct copies through the VRAM BAR, other addresses use the accessor chosen above
+	if (asic->options.use_vram_bar)
+		asic->mem_funcs.access_linear_vram = umr_access_linear_vram_via_bar;
+
 	// default shader options
 	if (asic->family <= FAMILY_VI) { // on gfx9+ hs/gs are opaque
 		asic->options.shader_enable.enable_gs_shader = 1;
@@ -175,7 +225,7 @@ retry:
 		asic->parameters.vgpr_granularity = asic->options.vgpr_granularity;
 
 	// sanity check if they didn't specify a partition
-	if (asic->options.vm_partition < 0) {
+	if (asic->options.vm_partition < 0 && !asic->options.all_xcc) {
 		int n;
 		for (n = 0; n < asic->no_blocks; n++) {
 			if ((!memcmp(asic->blocks[n]->ipname, "gfx", 3) && strstr(asic->blocks[n]->ipname, "{")) ||
@@ -197,6 +247,10 @@ retry:
 		}
 	}
 
+	// record every access from here on, written out when umr exits
+	if (capture_path && umr_capture_start(asic))
+		exit(EXIT_FAILURE);
+
 	return asic;
 }
 
@@ -224,76 +278,6 @@ static char *get_block_name(struct umr_asic *asic, char *path)
 	return block;
 }
 
-static void parse_options(char *str)
-{
-	char option[64], *p;
-
-	while (*str) {
-		p = &option[0];
-		while (*str && *str != ',' && p != &option[sizeof(option)-1])
-			*p++ = *str++;
-		*p = 0;
-		if (*str == ',')
-			++str;
-		if (!strcmp(option, "bits")) {
-			options.bitfields = 1;
-		} else if (!strcmp(option, "skip_gprs")) {
-			options.skip_gprs = 1;
-		} else if (!strcmp(option, "empty_log")) {
-			options.empty_log = 1;
-		} else if (!strcmp(option, "use_pci")) {
-			options.use_pci = 1;
-		} else if (!strcmp(option, "use_colour") || !strcmp(option, "use_color")) {
-			options.use_colour = 1;
-		} else if (!strcmp(option, "bitsfull")) {
-			options.bitfields = 1;
-			options.bitfields_full = 1;
-		} else if (!strcmp(option, "read_smc")) {
-			options.read_smc = 1;
-		} else if (!strcmp(option, "quiet")) {
-			options.quiet = 1;
-		} else if (!strcmp(option, "full_shader")) {
-			options.full_shader = 1;
-		} else if (!strcmp(option, "filter_shader_registers")) {
-			options.filter_shader_registers = 1;
-		} else if (!strcmp(option, "no_follow_ib")) {
-			options.no_follow_ib = 1;
-			options.no_follow_shader = 1;
-			options.no_follow_loadx = 1;
-		} else if (!strcmp(option, "no_follow_chained_ib")) {
-			options.no_follow_chained_ib = 1;
-		} else if (!strcmp(option, "verbose")) {
-			options.verbose = 1;
-		} else if (!strcmp(option, "halt_waves")) {
-			options.halt_waves = 1;
-		} else if (!strcmp(option, "wave64")) {
-			options.wave64 = 1;
-		} else if (!strcmp(option, "disasm_early_term")) {
-			options.disasm_early_term = 1;
-		} else if (!strcmp(option, "no_kernel")) {
-			options.no_kernel = 1;
-			options.use_pci = 1;
-		} else if (!strcmp(option, "no_disasm")) {
-			options.no_disasm = 1;
-		} else if (!strcmp(option, "disasm_anyways")) {
-			options.disasm_anyways = 1;
-		} else if (!strcmp(option, "no_fold_vm_decode")) {
-			options.no_fold_vm_decode = 1;
-		} else if (!strcmp(option, "force_asic_file")) {
-			options.force_asic_file = 1;
-		} else if (!strcmp(option, "export_model")) {
-			options.export_model = 1;
-		} else if (!strcmp(option, "use_full_user_queue")) {
-			options.use_full_user_queue = 1;
-		} else if (!strcmp(option, "aql_heuristic")) {
-			options.aql_heuristic = 1;
-		} else {
-			printf("error: Unknown option [%s]\n", option);
-			exit(EXIT_FAILURE);
-		}
-	}
-}
-
 #define MIN(x, y) ((x) < (y) ? (x) : (y))
 
 enum {
@@ -305,6 +289,13 @@ enum {
 	PASS_MAX
 };
 
+// writes what --dump-bo reads to stdout
+static int stdout_sink(void *data, const void *buf, uint64_t len)
+{
+	(void)data;
+	return fwrite(buf, 1, len, stdout) != len;
+}
+
 static void do_help(void)
 {
 	printf("User Mode Register debugger v%s for AMDGPU devices (build: %s [%s], date: %s), Copyright (c) 2025, AMD Inc.\n"
@@ -315,7 +306,11 @@ static void do_help(void)
 		"\n\t\t\tbits, bitsfull, empty_log, follow, no_follow_ib, no_follow_chained_ib, "
 		"\n\t\t\tuse_pci, use_colour, read_smc, quiet, no_kernel, verbose, halt_waves,"
 		"\n\t\t\tdisasm_early_term, no_disasm, disasm_anyways, wave64, filter_shader_registers,"
-		"\n\t\t\tfull_shader, skip_gprs, no_fold_vm_decode, force_asic_file, use_full_user_queue, aql_heuristic\n"
+		"\n\t\t\tfull_shader, skip_gprs, no_fold_vm_decode, force_asic_file, use_full_user_queue, aql_heuristic,"
+		"\n\t\t\tuse_io_uring, no_lazy_regs, use_vram_bar, parallel_waves, prefetch_gprs,"
+		"\n\t\t\tparallel_ibs, vcn_summary, ring_halt_timeout=<usecs>, rumr_cache, metrics_changed,"
+		"\n\t\t\tcpu_affinity=<off|cpus>, wave_se=<list>, wave_sh=<list>, wave_cu=<list>,"
+		"\n\t\t\tmax_waves=<n>\n"
 	"\n\t--gpu, -g <asicname>(@<instance> | =<pcidevice>)"
 		"\n\t\tSelect a gpu by ASIC name and either the instance number or the PCI bus identifier.\n"
 	"\n\t--instance, -i <number>\n\t\tSelect a device instance to investigate. (default: 0)"
@@ -340,12 +335,22 @@ static void do_help(void)
 	"\n\t--gfxoff, -go <0 | 1>"
 		"\n\t\tEnable GFXOFF with a non-zero value or disable with a 0.  Used to control the GFXOFF feature on"
 		"\n\t\tselect hardware. Command without parameter will check GFXOFF status.\n"
-	"\n\t--vm-partition, -vmp <-1, 0...n>"
+	"\n\t--vm-partition, -vmp <-1, 0...n, all>"
 		"\n\t\tSelect a VM partition for all GPUVM accesses.  Default is -1 which"
 		"\n\t\trefers to the 0'th instance of the VM hub which is not the same as"
-		"\n\t\tspecifying '0'.  Values above -1 are for ASICs with multiple IP instances.\n"
+		"\n\t\tspecifying '0'.  Values above -1 are for ASICs with multiple IP instances."
+		"\n\t\t'all' runs --read, --waves and --print-cpc on every XCC at once, the output"
+		"\n\t\tof each XCC is printed in order under a '=== XCC n ===' line.\n"
 	"\n\t--vgpr-granularity, -vgpr <-1, 0...n>"
-		"\n\t\tSpecify the VGPR size granularity as a power of 2, e.g., '2' means 4 DWORDs per increment.\n",
+		"\n\t\tSpecify the VGPR size granularity as a power of 2, e.g., '2' means 4 DWORDs per increment.\n"
+	"\n\t--timing"
+		"\n\t\tPrint the time spent (and files/bytes read) in each startup phase to stderr on exit.\n"
+	"\n\t--stats"
+		"\n\t\tPrint the reads, writes, ioctls, bytes and time spent in them per kind of file"
+		"\n\t\t(mmio, vram, iomem, gprwave, sensors, rumr, other) to stderr on exit.\n"
+	"\n\t--jsonl"
+		"\n\t\tPrint --read, --waves, --ring-stream, --vm-decode and --top-log-csv records as"
+		"\n\t\tone JSON object per line instead of text.\n",
 		UMR_BUILD_VER, UMR_BUILD_REV, UMR_BUILD_BRANCH, __DATE__);
 
 	printf(
@@ -368,17 +373,47 @@ static void do_help(void)
 		"\n\t\tspecify * for asicname and/or ipname to simplify scripts.\n"
 	"\n\t--writebit, -wb <string> <number>\n\t\tWrite a value in hex to a register bitfield specified as in --write but"
 		"\n\t\tthe addition of the bitfield name.  For instance: \"*.gfx80.mmRLC_PG_CNTL.PG_OVERRIDE\"\n"
+	"\n\t--writebits, -wbs <string> <field=number>[,<field=number>,...]\n\t\tWrite values in hex to several bitfields of a register specified as in --write"
+		"\n\t\twith a single read-modify-write.  For instance: \"*.gfx80.mmRLC_PG_CNTL\" \"PG_OVERRIDE=1,SMU_HANDSHAKE_ENABLE=0\""
+		"\n\t\tWith -O verbose the register is read back and checked.\n"
 	"\n\t--read, -r <string>\n\t\tRead a value from a register and print it to stdout.  This command"
 		"\n\t\tuses the same path notation as --write.  It also accepts * for regname."
 		"\n\t\tA trailing * on a regname will read any register that has a name that contains the"
-		"\n\t\tremainder of the name specified.\n");
+		"\n\t\tremainder of the name specified.\n"
+	"\n\t--snapshot, -snap <ipname> <file>\n\t\tRead every register of all IP blocks whose name starts with <ipname> (or * for"
+		"\n\t\tall blocks) and save them to <file>.\n"
+	"\n\t--snapshot-diff, -sdiff <ipname> <file>\n\t\tCapture the same registers as --snapshot and print any that differ from"
+		"\n\t\tthe values saved in <file>.  Can use '-O bits' to show the bitfields that changed.\n"
+	"\n\t--reg-watch <trigger>[,<trigger>...] <capture>[,<capture>...] <ms>"
+		"\n\t\tPoll the trigger registers back to back for <ms> milliseconds.  A trigger is"
+		"\n\t\t'[ip.]reg[:mask]=value' followed by '/rise' (default), '/fall', '/change' or '/level'"
+		"\n\t\tand optionally '/stop' to end the watch when it fires.  On every hit the captures,"
+		"\n\t\tregisters, 'ring:<name>' pointers or 'waves', are read right away ('-' for none) and"
+		"\n\t\tthe last 256 hits are printed at the end.\n"
+	"\n\t--sriov-sample <ms> <count>"
+		"\n\t\tSample the VFs of an SR-IOV device from the PF through its RLC GPU_IOV registers"
+		"\n\t\tand print, every <ms> milliseconds for <count> intervals, how long each VF owned"
+		"\n\t\tthe GFX engine, had its VM or SDMA queues busy or a doorbell pending, its world"
+		"\n\t\tswitches and the fences signaled on its rings (VFs bound to amdgpu on the host).\n");
 
 	printf(
 	"\n\t--logscan, -ls\n\t\tRead and display contents of the MMIO register log (usually specified with"
 		"\n\t\t'-O bits,empty_log' to continually dump bitfields and empty the trace after.)\n"
+	"\n\t--logscan, -ls --follow [<n>]\n\t\tCount the traced register accesses instead of printing them and every second"
+		"\n\t\tprint the 'n' (default 20) most accessed registers with their last value.\n"
+	"\n\t--logscan-file, -lsf <file> [<ip>[.<reg>]]\n\t\tPrint the register accesses of a saved trace like --logscan, scanned by"
+		"\n\t\tseveral threads.  The optional filter selects IP blocks and registers, both"
+		"\n\t\tparts can be shell patterns (e.g. 'gfx*.mmGRBM_*').\n"
+	"\n\t--logscan-histogram, -lsh <file> [<ip>[.<reg>]]\n\t\tLike --logscan-file but print how often each register was read and written.\n"
 	"\n*** Device Utilization ***\n"
 	"\n\t--top, -t\n\t\tSummarize GPU utilization.  Can select a SE block with --bank.  Can use"
 		"\n\t\toptions 'use_colour' to colourize output and 'use_pci' to improve efficiency.\n"
+	"\n\t--top-all, -ta\n\t\tLike --top but for every device at once, a line per device is shown above"
+		"\n\t\tthe details of the selected one ('<' and '>' select the device).\n"
+	"\n\t--top-export <sink>[,<sink>]\n\t\tSample every device like --top-all without a display and export the counters"
+		"\n\t\tof each window.  A sink is 'http:[<addr>:]<port>' to serve OpenMetrics on /metrics"
+		"\n\t\tor 'statsd:[<host>:]<port>' to push statsd gauges over UDP.\n"
+	"\n\t--top-log-csv <file>\n\t\tPrint a binary --top log (UMR_LOGGER_FORMAT=binary or samples) as CSV.\n"
 	"\n\t--waves, -wa [<none> | <uq> | <ring_name> | <vmid>@<addr>.<size>]\n\t\tPrint out information about any active CU waves.  Can use '-O bits'"
 		"\n\t\tto see decoding of various wave fields.  Can use the '-O halt_waves' option"
 		"\n\t\tto halt the SQ while reading registers.  An optional ring name can be specified"
@@ -388,10 +423,17 @@ static void do_help(void)
 		"\n\t\tbe specified by passing 'uq'.\n"
 	"\n\t--singlestep, -ss <se>,<sh>,<wgp>,<simd>,<wave>\n\t\tSingle-step one wave."
 	"\n\t\tTries advancing execution on the specified wave by one instruction."
-	"\n\t--profiler, -prof [pixel= | vertex= | compute=]<nsamples> [ring]"
+	"\n\t--profiler, -prof [pixel= | vertex= | compute=]<nsamples>[@<rate> | @auto] [ring]"
 		"\n\t\tCapture 'nsamples' samples of wave data. Optionally specify a ring to search"
 		"\n\t\tfor IBs that point to shaders.  Defaults to 'gfx'.  Additionally, the type"
-		"\n\t\tof shader can be selected for as well to only profile a given type.\n"
+		"\n\t\tof shader can be selected for as well to only profile a given type."
+		"\n\t\tWith '@<rate>' the PCs of the running waves are sampled 'rate' times per"
+		"\n\t\tsecond (0 for as fast as possible) instead of halting the waves for every sample."
+		"\n\t\t'@auto' samples every 100us while waves are running and backs off to every"
+		"\n\t\t10ms while none are, keeping umr under 10%% of a CPU.\n"
+	"\n\t--profiler-export, -profx <pprof | collapsed>:<file>"
+		"\n\t\tAlso write the hits of --profiler to 'file' as an (uncompressed) pprof profile"
+		"\n\t\tor in the collapsed stack format used by flamegraph tools.\n"
 	"\n*** Virtual Memory Access ***\n"
 	"\n\tVMIDs are specified in umr as 16 bit numbers where the lower 8 bits"
 	"\n\tindicate the hardware VMID and the upper 8 bits indicate the which VM space to use."
@@ -404,7 +446,11 @@ static void do_help(void)
 		"\n\t\tDecode page mappings at a specified address (in hex) from the VMID specified."
 		"\n\t\tThe VMID can be specified in hexadecimal (with leading '0x') or in decimal."
 		"\n\t\tImplies '-O verbose' for the duration of the command so does not require it"
-		"\n\t\tto be manually specified.\n");
+		"\n\t\tto be manually specified.\n"
+	"\n\t--vm-map, -vmm vmid"
+		"\n\t\tList every valid mapping of the VMID specified with a single walk of its page"
+		"\n\t\ttables.  Pages that are contiguous both virtually and physically are printed"
+		"\n\t\tas one range.\n");
 
 	printf(
 	"\n\t--vm-read, -vr [<vmid>@]<address> <size>"
@@ -412,6 +458,12 @@ static void do_help(void)
 		"\n\t\tspecify the VMID (in decimal or in hex with a '0x' prefix) treating the address"
 		"\n\t\tas a virtual address instead.  Can use 'verbose' option to print out PDE/PTE"
 		"\n\t\tdecodings.\n"
+	"\n\t--dump-bo, -db <pid>[@<fd>] <handle> [<offset> <size>]"
+		"\n\t\tRead the buffer object with the GEM handle of a process (see amdgpu_gem_info) to"
+		"\n\t\tstdout by having SDMA copy it through GTT, which is much faster than --vm-read for"
+		"\n\t\tlarge buffers.  The fd is only needed if the process has several open on the device."
+		"\n\t\tAn optional byte range (in hex) reads part of the buffer.  Needs the kernel driver"
+		"\n\t\tand a GPU that is not hung.\n"
 	"\n\t--vm-write, -vw [<vmid>@]<address> <size>"
 		"\n\t\tWrite 'size' bytes (in hex) to a given address (in hex) from stdin.\n"
 	"\n\t--vm-write-word, -vww [<vmid>@]<address> <word>"
@@ -420,20 +472,32 @@ static void do_help(void)
 		"\n\t\tDisassemble 'size' bytes (in hex) from a given address (in hex).  The size can"
 		"\n\t\tbe specified as zero to have umr try and compute the shader size.\n"
 	"\n*** Packet Decoding and User Queue Commands ***\n"
-	"\n\t--list-uq"
-		"\n\t\tList out brief information about all of the KFD and KGD clients and their queues.\n"
+	"\n\t--list-uq [--follow]"
+		"\n\t\tList out brief information about all of the KFD and KGD clients and their queues."
+		"\n\t\tWith '--follow' keep the clients cached and every second list the queues whose"
+		"\n\t\trptr/wptr or MQD changed until interrupted.\n"
 	"\n\t--print-uq"
 		"\n\t\tPrint out all of the user queue information decoded for a specified --user-queue.\n"
 	"\n\t--dump-uq, -du"
 		"\n\t\tDump the command submission attached to a given user queue selected with --user-queue.\n"
-	"\n\t--ring-stream, -RS <string>([from:to])\n\t\tRead the contents of a ring named by the string without the amdgpu_ring_ prefix. "
+	"\n\t--ring-stream, -RS <string>([from:to]) [--follow]\n\t\tRead the contents of a ring named by the string without the amdgpu_ring_ prefix. "
 		"\n\t\tBy default it will read and display the entire ring.  A starting and ending "
 		"\n\t\taddress can be specified in decimal or a '.' can be used to indicate relative "
 		"\n\t\tto the current wptr pointer.  For example, \"-RS gfx\" would read the entire gfx "
 		"\n\t\tring, \"-RS gfx[0:16]\" would display the contents from address 0 to 16 inclusively, and "
 		"\n\t\t\"-RS gfx[.]\" or \"-RS gfx[.:.]\" would display contents from the ring READ pointer to "
 		"\n\t\tthe ring WRITE pointer.  Specifying 'uq' as the ringname will make it read from any"
-		"\n\t\tattached user queue client space instead of a kernel ring.\n"
+		"\n\t\tattached user queue client space instead of a kernel ring.  Adding '--follow'"
+		"\n\t\t(e.g. \"-RS gfx --follow\") keeps printing newly submitted packets until interrupted.\n"
+	"\n\t--packet-filter <spec>"
+		"\n\t\tOnly keep the PM4 packets matching <spec> in the ring and IB decodes that follow,"
+		"\n\t\te.g. \"op=DISPATCH_DIRECT,vmid=3\".  Terms are op=<name|number> (repeatable),"
+		"\n\t\treg=<reg>[-<reg>], va=<addr>[-<addr>] and vmid=<n>, all of them must match.  IBs"
+		"\n\t\tleading to kept packets are kept too.  An empty <spec> removes the filter.\n"
+	"\n\t--ring-capture <ring>[,<ring>...]"
+		"\n\t\tRead several rings (e.g. \"gfx_0.0.0,comp_1.0.0,sdma0\") along with the compute and gfx"
+		"\n\t\tHQD state in a single wave halt, then decode the packets between the rptr and wptr"
+		"\n\t\tof each ring once the waves are resumed.\n"
 	"\n\t--dump-ib, -di [vmid@]address length [pm]"
 		"\n\t\tDump an IB packet at an address with an optional VMID.  The length is specified"
 		"\n\t\tin bytes.  The type of decoder <pm> is optional and defaults to PM4 packets."
@@ -467,21 +531,33 @@ static void do_help(void)
 	"\n\t--ppt-read, -pptr [ppt_field_name]\n\t\tRead powerplay table value and print it to stdout."
 		"\n\t\tThis command will print all the powerplay table information or the corresponding string in powerplay table.\n"
 	"\n\t--gpu-metrics, -gm [delay]"
-		"\n\t\tPrint the GPU metrics table for the device, optionally continuously read every 'delay' milliseconds.\n"
+		"\n\t\tPrint the GPU metrics table for the device, optionally continuously read every 'delay' milliseconds."
+		"\n\t\tWith '-O metrics_changed' only the fields that changed are printed after the first read.\n"
 	"\n\t--power, -p \n\t\tRead the conetent of clocks, temperature, gpu loading at runtime"
 		"\n\t\toptions 'use_colour' to colourize output \n"
 	"\n*** Video BIOS Information ***\n"
 		"\n\t--vbios-info, -vi \n\t\tPrint Video BIOS information\n"
 	"\n*** Test Vector Generation ***\n"
 		"\n\t--test-log, -tl <filename>\n\t\tLog all MMIO/memory reads to a file\n"
+		"\n\t--test-log-binary, -tlb <filename>\n\t\tLog all MMIO/memory reads to a binary test vector, much faster to write and replay\n"
+		"\n\t--test-vector-convert, -tvc <input> <output>\n\t\tConvert a test vector from text to binary or from binary to text\n"
 		"\n\t--test-harness, -th <filename>\n\t\tUse a test harness file instead of reading from hardware\n"
+		"\n\t--capture, -cap <filename>\n\t\tRecord everything read from the hardware into a binary capture bundle\n"
+		"\n\t--load-capture, -lc <filename>\n\t\tUse a capture bundle instead of reading from hardware\n"
 	"\n*** RUMR Commands ***\n"
-		"\n\t--rumr-client <server>\n\t\tRun as a RUMR client connecting to 'server', e.g. tcp://127.0.0.1:9000\n"
-		"\n\t--rumr-server <server>\n\t\tRun as a RUMR server binding to 'server', e.g. tcp://127.0.0.1:9000\n"
+		"\n\t--rumr-client <server>\n\t\tRun as a RUMR client connecting to 'server', e.g. tcp://127.0.0.1:9000,\n\t\tunix:///run/umr.sock or shm:///run/umr.sock (same host)\n"
+		"\n\t--daemon <socket>\n\t\tKeep this device resident and run the command lines sent to the unix socket 'socket'"
+		"\n\t\tby umr (with UMR_DAEMON=socket in its environment) or umrc, one at a time, each in"
+		"\n\t\ta child that starts from the discovered device and loaded registers.\n"
+		"\n\t--rumr-server <server>\n\t\tRun as a RUMR server binding to 'server', e.g. tcp://127.0.0.1:9000,\n\t\tunix:///run/umr.sock or shm:///run/umr.sock (same host)\n"
+		"\n\t--rumr-stats\n\t\tPrint the calls, latency and bytes of each RUMR opcode, as seen by the client\n\t\tand the server, to stderr on exit.\n"
 	"\n*** KFD Support ***\n"
-		"\n\t--runlist, -rls <node>\n\t\tDump any runlists for a given KFD node specified\n"
+		"\n\t--runlist, -rls <node | all>\n\t\tDump any runlists for a given KFD node specified, or for every node with 'all'\n"
 		"\n\t--dump-mqd vmid@virtualaddr engsel\n\t\tDump an MQD from a given VMID and virtual address for a given engine and asic family."
 		"\n\t\tEngines are 0=compute, 2=sdma0, 3=sdma1, 4=gfx, 5=mes.\n"
+		"\n\t--ih-tail [client=N,source=N,vmid=N,pasid=N]\n\t\tPrint the interrupt vectors written to the IH ring until interrupted, optionally"
+		"\n\t\tonly those matching the filter.  Every second the rate of each ClientID/SourceID"
+		"\n\t\tis listed, filtered or not.\n"
 	"\n*** Scriptware Support ***\n"
 		"\n\t--script [commands]\n\t\tRun a script helper command.  Run without parameters to see list of commands.\n"
 	);
@@ -496,7 +572,9 @@ static void do_help(void)
 	#endif
 	#if UMR_GUI
 	printf(
-		"\n\t--gui [url] \n\t\tRun umr in GUI mode. An optional url can be supplied to connect to a remote instance (see --server)\n");
+		"\n\t--gui [url] \n\t\tRun umr in GUI mode. An optional url can be supplied to connect to a remote instance (see --server)"
+		"\n\t\tThe answers are recorded in /tmp/umr_session.N/session.umrs, giving that folder or file"
+		"\n\t\tas the url replays them.\n");
 	#endif
 	exit(EXIT_SUCCESS);
 }
@@ -515,6 +593,30 @@ static void umr_start_rumr_client(struct rumr_client_state *cs, char *server)
 	free(cf);
 }
 
+// --timing, printed at exit so registers loaded on first use are included
+static void print_timing(void)
+{
+	struct umr_timing t;
+
+	umr_timing_get(&t);
+	umr_timing_print(&t, stderr);
+}
+
+// --rumr-stats, printed before the client disconnects
+static int print_rumr_stats;
+
+// --stats, printed before the asic is closed
+static int print_io_stats;
+
+static void print_asic_io_stats(struct umr_asic *asic)
+{
+	struct umr_io_stats st;
+
+	umr_io_stats_get(asic, &st);
+	fprintf(stderr, "%s syscalls:\n", asic->asicname);
+	umr_io_stats_print(&st, stderr);
+}
+
 static void check_lockdown(void)
 {
 	FILE *f;
@@ -528,6 +630,42 @@ static void check_lockdown(void)
 	}
 }
 
+// --vm-decode with --jsonl, a record per page translated in batches
+static void vm_decode_jsonl(struct umr_asic *asic, uint32_t vmid, uint64_t address, uint32_t pages)
+{
+	struct umr_vm_translation xl[64];
+	uint64_t va[64];
+	uint32_t n, x, y;
+
+	address &= ~0xFFFULL;
+	while (pages) {
+		n = pages < 64 ? pages : 64;
+		for (x = 0; x < n; x++)
+			va[x] = address + 0x1000ULL * x;
+		if (umr_vm_translate(asic, asic->options.vm_partition, vmid, va, n, xl) < 0)
+			return;
+		for (x = 0; x < n; x++) {
+			umr_jsonl_begin("pte");
+			umr_jsonl_u64("vmid", vmid);
+			umr_jsonl_hex("va", xl[x].va);
+			umr_jsonl_bool("valid", xl[x].flags & UMR_VM_XLATE_VALID);
+			umr_jsonl_bool("system", xl[x].flags & UMR_VM_XLATE_SYSTEM);
+			umr_jsonl_bool("prt", xl[x].flags & UMR_VM_XLATE_PRT);
+			umr_jsonl_bool("linear", xl[x].flags & UMR_VM_XLATE_LINEAR);
+			umr_jsonl_hex("pa", xl[x].pa);
+			umr_jsonl_u64("page_size", xl[x].page_size);
+			umr_jsonl_hex("pte", xl[x].pte);
+			umr_jsonl_object("pde", 1);
+			for (y = 0; y < xl[x].levels && y < 8; y++)
+				umr_jsonl_hex(NULL, xl[x].pde[y]);
+			umr_jsonl_close();
+			umr_jsonl_end();
+		}
+		address += 0x1000ULL * n;
+		pages -= n;
+	}
+}
+
 int main(int argc, char **argv)
 {
 	int pass, i, j, k, l;
@@ -561,6 +699,21 @@ int main(int argc, char **argv)
 	}
 #endif
 
+	// a daemon child picks the device up again in get_asic() with its own options
+	if (daemon_asic)
+		asic = NULL;
+
+	str = getenv("UMR_DAEMON");
+	if (str && !daemon_asic) {
+		for (i = 1; i < argc && strcmp(argv[i], "--daemon"); i++);
+		if (i == argc) {
+			i = umr_daemon_forward(str, argc, argv);
+			if (i >= 0)
+				return i;
+			fprintf(stderr, "[WARNING]: Could not reach the umr daemon at '%s', running the command here\n", str);
+		}
+	}
+
 	memset(&options, 0, sizeof options);
 
 	/* defaults */
@@ -571,6 +724,15 @@ int main(int argc, char **argv)
 	options.vgpr_granularity = -1;
 	options.forced_instance = 0;
 
+	// --jsonl changes how every command prints, even the ones before it
+	for (i = 1; i < argc; i++)
+		if (!strcmp(argv[i], "--jsonl"))
+			options.jsonl = 1;
+
+	// dumps redirected to a file or a pipe are written in large chunks by a thread
+	if (!options.jsonl && !isatty(STDOUT_FILENO))
+		options.output = umr_output_open(STDOUT_FILENO, 1UL << 20, 1);
+
 	argflags = calloc(1, argc+1);
 
 	str = getenv("RUMR_SERVER_ADDR");
@@ -647,12 +809,31 @@ int main(int argc, char **argv)
 					if (i + 1 < argc) {
 						argflags[i] = 1;
 						argflags[i+1] = 1;
-						parse_options(argv[i+1]);
+						if (umr_parse_options(&options, argv[i+1]))
+							return EXIT_FAILURE;
 						++i;
 					} else {
 						fprintf(stderr, "[ERROR]: --option requires one parameter\n");
 						return EXIT_FAILURE;
 					}
+				} else if (!strcmp(argv[i], "--profiler-export") || !strcmp(argv[i], "-profx")) {
+					if (i + 1 < argc) {
+						argflags[i] = 1;
+						argflags[i+1] = 1;
+						if (!strncmp(argv[i+1], "pprof:", 6)) {
+							profiler_export_format = UMR_PROFILER_EXPORT_PPROF;
+						} else if (!strncmp(argv[i+1], "collapsed:", 10)) {
+							profiler_export_format = UMR_PROFILER_EXPORT_COLLAPSED;
+						} else {
+							fprintf(stderr, "[ERROR]: --profiler-export format must be 'pprof' or 'collapsed'\n");
+							return EXIT_FAILURE;
+						}
+						snprintf(profiler_export_path, sizeof profiler_export_path, "%s", strchr(argv[i+1], ':') + 1);
+						++i;
+					} else {
+						fprintf(stderr, "[ERROR]: --profiler-export requires one parameter\n");
+						return EXIT_FAILURE;
+					}
 				} else if (!strcmp(argv[i], "--database-path") || !strcmp(argv[i], "-dbp")) {
 					if (i + 1 < argc) {
 						argflags[i] = 1;
@@ -669,7 +850,13 @@ int main(int argc, char **argv)
 					if (i + 1 < argc) {
 						argflags[i] = 1;
 						argflags[i+1] = 1;
-						options.vm_partition = atoi(argv[i+1]);
+						if (!strcmp(argv[i+1], "all")) {
+							options.all_xcc = 1;
+							options.vm_partition = -1;
+						} else {
+							options.all_xcc = 0;
+							options.vm_partition = atoi(argv[i+1]);
+						}
 						++i;
 					} else {
 						fprintf(stderr, "[ERROR]: --vm-partition requires a number\n");
@@ -721,6 +908,24 @@ int main(int argc, char **argv)
 						fprintf(stderr, "[ERROR]: --cbank requires one parameters\n");
 						return EXIT_FAILURE;
 					}
+				} else if (!strcmp(argv[i], "--timing")) {
+					argflags[i] = 1;
+					atexit(print_timing);
+				} else if (!strcmp(argv[i], "--stats")) {
+					argflags[i] = 1;
+					print_io_stats = 1;
+				} else if (!strcmp(argv[i], "--jsonl")) {
+					argflags[i] = 1;
+				} else if (!strcmp(argv[i], "--top-log-csv")) {
+					if (i + 1 < argc) {
+						return umr_top_log_to_csv(argv[i+1]) ? EXIT_FAILURE : EXIT_SUCCESS;
+					} else {
+						fprintf(stderr, "[ERROR]: --top-log-csv requires one parameter\n");
+						return EXIT_FAILURE;
+					}
+				} else if (!strcmp(argv[i], "--rumr-stats")) {
+					argflags[i] = 1;
+					print_rumr_stats = 1;
 				} else if (!strcmp(argv[i], "--help") || !strcmp(argv[i], "-h")) {
 					do_help();
 				}
@@ -842,6 +1047,30 @@ int main(int argc, char **argv)
 						fprintf(stderr, "[ERROR]: --test-log requires one parameter\n");
 						return EXIT_FAILURE;
 					}
+				} else if (!strcmp(argv[i], "--test-log-binary") || !strcmp(argv[i], "-tlb")) {
+					if (i + 1 < argc) {
+						argflags[i] = 1;
+						argflags[i+1] = 1;
+						options.test_log_bin = umr_test_vector_open(argv[i + 1]);
+						if (!options.test_log_bin)
+							return EXIT_FAILURE;
+						options.test_log_fd = umr_test_vector_stream(options.test_log_bin);
+						options.test_log = 1;
+						++i;
+					} else {
+						fprintf(stderr, "[ERROR]: --test-log-binary requires one parameter\n");
+						return EXIT_FAILURE;
+					}
+				} else if (!strcmp(argv[i], "--test-vector-convert") || !strcmp(argv[i], "-tvc")) {
+					if (i + 2 < argc) {
+						argflags[i] = 1;
+						argflags[i+1] = 1;
+						argflags[i+2] = 1;
+						return umr_test_vector_convert(argv[i + 1], argv[i + 2]) ? EXIT_FAILURE : EXIT_SUCCESS;
+					} else {
+						fprintf(stderr, "[ERROR]: --test-vector-convert requires two parameters\n");
+						return EXIT_FAILURE;
+					}
 				} else if (!strcmp(argv[i], "--test-harness") || !strcmp(argv[i], "-th")) {
 					if (i + 1 < argc) {
 						argflags[i] = 1;
@@ -855,17 +1084,62 @@ int main(int argc, char **argv)
 						fprintf(stderr, "[ERROR]: --test-harness requires one parameter\n");
 						return EXIT_FAILURE;
 					}
+				} else if (!strcmp(argv[i], "--capture") || !strcmp(argv[i], "-cap")) {
+					if (i + 1 < argc) {
+						argflags[i] = 1;
+						argflags[i+1] = 1;
+						capture_path = argv[i + 1];
+						++i;
+					} else {
+						fprintf(stderr, "[ERROR]: --capture requires one parameter\n");
+						return EXIT_FAILURE;
+					}
+				} else if (!strcmp(argv[i], "--load-capture") || !strcmp(argv[i], "-lc")) {
+					if (i + 1 < argc) {
+						argflags[i] = 1;
+						argflags[i+1] = 1;
+						bundle = umr_load_capture_bundle(argv[i + 1]);
+						if (!bundle)
+							return EXIT_FAILURE;
+						options.is_virtual = 1;
+						options.force_asic_file = 1;
+						++i;
+					} else {
+						fprintf(stderr, "[ERROR]: --load-capture requires one parameter\n");
+						return EXIT_FAILURE;
+					}
 				} else if (!strcmp(argv[i], "--enumerate") || !strcmp(argv[i], "-e")) {
 					// not a test harness command but we want to run this before
 					// we hit the ASIC_MODEL step
 					argflags[i] = 1;
 					umr_enumerate_devices(std_printf, options.database_path);
 					goto stopprocessingcommands;
+				} else if (!strcmp(argv[i], "--top-all") || !strcmp(argv[i], "-ta")) {
+					// runs on every device so like --enumerate it comes
+					// before the ASIC_MODEL step
+					argflags[i] = 1;
+					umr_top_all(&options);
+					goto stopprocessingcommands;
+				} else if (!strcmp(argv[i], "--top-export")) {
+					if (i + 1 < argc) {
+						argflags[i] = argflags[i + 1] = 1;
+						if (umr_top_export(&options, argv[i + 1]))
+							return EXIT_FAILURE;
+						goto stopprocessingcommands;
+					} else {
+						fprintf(stderr, "[ERROR]: --top-export requires one parameter\n");
+						return EXIT_FAILURE;
+					}
 				}
 			} else if (pass == PASS_COMMANDS) {
 				if (!strcmp(argv[i], "--list-uq")) {
 					argflags[i] = 1;
-					umr_list_uqs(asic);
+					if (i + 1 < argc && !strcmp(argv[i+1], "--follow")) {
+						argflags[++i] = 1;
+						umr_follow_uqs(asic);
+					} else {
+						umr_list_uqs(asic);
+					}
 				} else if (!strcmp(argv[i], "--print-uq")) {
 					argflags[i] = 1;
 					umr_print_uq_info(asic);
@@ -882,22 +1156,32 @@ int main(int argc, char **argv)
 						if (umr_read_vram(asic, asic->options.vm_partition, vmid, va, 512*4, &mqdbuf) < 0) {
 							asic->err_msg("[ERROR]: Could not read MQD buffer\n");
 						} else {
-							char **mqd_txt;
-							mqd_txt = umr_mqd_decode_data(engsel, asic->family, mqdbuf, "*");
-							if (mqd_txt) {
-								int x;
-								for (x = 0; mqd_txt[x]; x++) {
-									asic->std_msg("%s\n", mqd_txt[x]);
-									free(mqd_txt[x]);
+							struct umr_mqd_filter filt;
+							struct umr_mqd_field field;
+							uint32_t row = 0;
+							char line[256];
+
+							if (!umr_mqd_filter_init(&filt, engsel, asic->family, "*")) {
+								while (umr_mqd_field_next(&filt, mqdbuf, 512, NULL, &row, &field)) {
+									umr_mqd_field_format(&field, line, sizeof line);
+									asic->std_msg("%s\n", line);
 								}
-								free(mqd_txt);
 							}
+							umr_mqd_filter_free(&filt);
 						}
 						i += 2;
 					} else {
 						fprintf(stderr, "[ERROR]: --dump-mqd requires two parameters\n");
 						return EXIT_FAILURE;
 					}
+				} else if (!strcmp(argv[i], "--ih-tail")) {
+					argflags[i] = 1;
+					if (i + 1 < argc && argv[i+1][0] != '-') {
+						argflags[++i] = 1;
+						umr_ih_tail(asic, argv[i]);
+					} else {
+						umr_ih_tail(asic, NULL);
+					}
 				} else if (!strcmp(argv[i], "--config") || !strcmp(argv[i], "-c")) {
 					argflags[i] = 1;
 					umr_apply_callbacks(asic, &asic->mem_funcs, &asic->reg_funcs);
@@ -916,7 +1200,7 @@ int main(int argc, char **argv)
 						if (!blockname)
 							return EXIT_FAILURE;
 						for (j = 0; j < asic->no_blocks; j++)
-							if (!strcmp(asic->blocks[j]->ipname, blockname))
+							if (!strcmp(asic->blocks[j]->ipname, blockname) && !umr_load_ip_block(asic, asic->blocks[j]))
 								for (k = 0; k < asic->blocks[j]->no_regs; k++) {
 									printf("\t%s.%s.%s (%d) => 0x%05lx\n", asic->asicname, asic->blocks[j]->ipname, asic->blocks[j]->regs[k].regname, (int)asic->blocks[j]->regs[k].type, (unsigned long)asic->blocks[j]->regs[k].addr);
 									if (options.bitfields) {
@@ -968,6 +1252,17 @@ int main(int argc, char **argv)
 						fprintf(stderr, "[ERROR]: --write requires two parameters\n");
 						return EXIT_FAILURE;
 					}
+				} else if (!strcmp(argv[i], "--writebits") || !strcmp(argv[i], "-wbs")) {
+					if (i + 2 < argc) {
+						argflags[i] = 1;
+						argflags[i+1] = 1;
+						argflags[i+2] = 1;
+						umr_set_register_bits(asic, argv[i+1], argv[i+2]);
+						i += 2;
+					} else {
+						fprintf(stderr, "[ERROR]: --writebits requires two parameters\n");
+						return EXIT_FAILURE;
+					}
 				} else if (!strcmp(argv[i], "--waves") || !strcmp(argv[i], "-wa")) {
 					if (i + 1 < argc) {
 						argflags[i] = 1;
@@ -1044,7 +1339,14 @@ int main(int argc, char **argv)
 						argflags[i+1] = 1;
 
 						if (!memcmp(argv[i+1], "0x", 2) && sscanf(argv[i+1], "%"SCNx32, &reg) == 1) {
-							printf("0x%08lx\n", (unsigned long)asic->reg_funcs.read_reg(asic, reg, REG_MMIO));
+							if (asic->options.jsonl) {
+								umr_jsonl_begin("reg");
+								umr_jsonl_hex("addr", reg);
+								umr_jsonl_u64("value", asic->reg_funcs.read_reg(asic, reg, REG_MMIO));
+								umr_jsonl_end();
+							} else {
+								printf("0x%08lx\n", (unsigned long)asic->reg_funcs.read_reg(asic, reg, REG_MMIO));
+							}
 						} else {
 							str = strstr(argv[i+1], ".");
 							str2 = str ? strstr(str+1, ".") : NULL;
@@ -1068,28 +1370,120 @@ int main(int argc, char **argv)
 						fprintf(stderr, "[ERROR]: --read requires one parameter\n");
 						return EXIT_FAILURE;
 					}
+				} else if (!strcmp(argv[i], "--snapshot") || !strcmp(argv[i], "-snap")) {
+					if (i + 2 < argc) {
+						struct umr_reg_snapshot *snap;
+
+						argflags[i] = 1;
+						argflags[i+1] = 1;
+						argflags[i+2] = 1;
+						snap = umr_reg_snapshot_capture(asic, argv[i+1]);
+						if (!snap || umr_reg_snapshot_save(asic, snap, argv[i+2])) {
+							umr_reg_snapshot_free(snap);
+							return EXIT_FAILURE;
+						}
+						umr_reg_snapshot_free(snap);
+						i += 2;
+					} else {
+						fprintf(stderr, "[ERROR]: --snapshot requires two parameters\n");
+						return EXIT_FAILURE;
+					}
+				} else if (!strcmp(argv[i], "--snapshot-diff") || !strcmp(argv[i], "-sdiff")) {
+					if (i + 2 < argc) {
+						struct umr_reg_snapshot *before, *after;
+
+						argflags[i] = 1;
+						argflags[i+1] = 1;
+						argflags[i+2] = 1;
+						before = umr_reg_snapshot_load(asic, argv[i+1], argv[i+2]);
+						after = before ? umr_reg_snapshot_capture(asic, argv[i+1]) : NULL;
+						if (!after) {
+							umr_reg_snapshot_free(before);
+							return EXIT_FAILURE;
+						}
+						printf("%d registers differ\n", umr_reg_snapshot_diff(asic, before, after, stdout));
+						umr_reg_snapshot_free(before);
+						umr_reg_snapshot_free(after);
+						i += 2;
+					} else {
+						fprintf(stderr, "[ERROR]: --snapshot-diff requires two parameters\n");
+						return EXIT_FAILURE;
+					}
+				} else if (!strcmp(argv[i], "--reg-watch")) {
+					if (i + 3 < argc) {
+						argflags[i] = 1;
+						argflags[i+1] = 1;
+						argflags[i+2] = 1;
+						argflags[i+3] = 1;
+						if (umr_reg_watch_print(asic, argv[i+1], argv[i+2], atoi(argv[i+3])))
+							return EXIT_FAILURE;
+						i += 3;
+					} else {
+						fprintf(stderr, "[ERROR]: --reg-watch requires three parameters\n");
+						return EXIT_FAILURE;
+					}
+				} else if (!strcmp(argv[i], "--sriov-sample")) {
+					if (i + 2 < argc) {
+						argflags[i] = 1;
+						argflags[i+1] = 1;
+						argflags[i+2] = 1;
+						if (umr_sriov_sample_print(asic, atoi(argv[i+1]), atoi(argv[i+2])))
+							return EXIT_FAILURE;
+						i += 2;
+					} else {
+						fprintf(stderr, "[ERROR]: --sriov-sample requires two parameters\n");
+						return EXIT_FAILURE;
+					}
+				} else if (!strcmp(argv[i], "--packet-filter")) {
+					if (i + 1 < argc) {
+						static struct umr_packet_filter packet_filter;
+						argflags[i] = 1;
+						argflags[i+1] = 1;
+						if (umr_packet_filter_parse(asic, argv[i+1], &packet_filter))
+							return EXIT_FAILURE;
+						asic->packet_filter = packet_filter.flags ? &packet_filter : NULL;
+						++i;
+					} else {
+						fprintf(stderr, "[ERROR]: --packet-filter requires one parameter\n");
+						return EXIT_FAILURE;
+					}
 				} else if (!strcmp(argv[i], "--ring-stream") || !strcmp(argv[i], "-RS")) {
 					if (i + 1 < argc) {
 						argflags[i] = 1;
 						argflags[i+1] = 1;
-						umr_read_ring_stream(asic, argv[i+1]);
+						if (i + 2 < argc && !strcmp(argv[i+2], "--follow")) {
+							argflags[i+2] = 1;
+							umr_follow_ring_stream(asic, argv[i+1]);
+							++i;
+						} else {
+							umr_read_ring_stream(asic, argv[i+1]);
+						}
 						++i;
 					} else {
 						fprintf(stderr, "[ERROR]: --ring-stream requires one parameter\n");
 						return EXIT_FAILURE;
 					}
+				} else if (!strcmp(argv[i], "--ring-capture")) {
+					if (i + 1 < argc) {
+						argflags[i] = 1;
+						argflags[i+1] = 1;
+						umr_ring_capture_print(asic, argv[i+1]);
+						++i;
+					} else {
+						fprintf(stderr, "[ERROR]: --ring-capture requires one parameter\n");
+						return EXIT_FAILURE;
+					}
 				} else if (!strcmp(argv[i], "--dump-uq") || !strcmp(argv[i], "-du")) {
-						uint32_t *buf, start, end, len;
+						struct umr_ring_view rv;
+						uint32_t start = 0, end = 0;
+						int have_span = 1;
 						argflags[i] = 1;
 
 						if (asic->options.user_queue.state.active) {
-							buf = calloc(asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].rb_buf_size, sizeof *buf);
 							if (!asic->options.use_full_user_queue) {
 								if (asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].rb_wptr_poll_value == asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].hqd_rptr_value) {
 									asic->err_msg("[ERROR]: The user queue's RPTR and WPTR are equal.  You can try using -O use_full_user_queue instead to read the entire queue.\n");
-									// free the buffer so we don't decode garbage
-									free(buf);
-									buf = NULL;
+									have_span = 0;
 								} else {
 									start = asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].hqd_rptr_value;
 									end = asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].rb_wptr_poll_value;
@@ -1098,7 +1492,7 @@ int main(int argc, char **argv)
 								start = 0;
 								end = asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].rb_wptr_poll_value;
 							}
-							if (buf) {
+							if (have_span) {
 								// AQL RPTR/WPTR is in terms of 64-byte (16 dword) packets
 								// we need to do AQL math in 32-bit word terms because other
 								// queues are all in terms of 32-bits
@@ -1110,7 +1504,7 @@ int main(int argc, char **argv)
 									asic->options.disasm_early_term = 1;
 								}
 								// continue, so at this point we read the queue like a ring (allowing start > end)
-								if (umr_read_user_queue_buffer(asic, start, end, buf, &len)) {
+								if (umr_user_queue_view(asic, start, end, &rv)) {
 									asic->err_msg("[ERROR]: Could not decode packet stream fetched from the user queue.");
 								} else {
 									uint32_t rt = UMR_RING_UNK;
@@ -1125,18 +1519,39 @@ int main(int argc, char **argv)
 									if (rt != UMR_RING_UNK) {
 										// decode and diassemble the command submission packets
 										asic->std_msg("Dumping 0x%"PRIx32" words from user queue-%"PRIu64" (from word 0x%"PRIx32" to 0x%"PRIx32"):\n",
-											len,
+											rv.nwords,
 											asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].queue_id,
 											start, end);
-										umr_ring_stream_present(asic,
-											NULL, 0, 0, // ring
-											0, // vmid
-											asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].hqd_base_addr + start * 4, // addr
-											buf, len, // words, length
-											rt);
+										if (rt == UMR_RING_HSA && asic->options.use_full_user_queue && !asic->options.aql_heuristic) {
+											// a full AQL queue is mostly packets the CP has stamped
+											// INVALID, only decode the runs of active ones, a run
+											// ends where the view wraps around the end of the queue
+											struct umr_aql_view view;
+											uint32_t slot = 0, first = 0, n = 0, wrap = rv.seg[0].nwords / 16;
+											int more;
+
+											do {
+												more = umr_aql_view_next(rv.words, rv.nwords, &slot, UMR_AQL_VIEW_ACTIVE, &view);
+												if (n && (!more || view.slot != first + n || view.slot == wrap)) {
+													umr_ring_stream_present(asic, NULL, 0, 0, 0,
+														umr_ring_view_addr(&rv, first * 16),
+														&rv.words[first * 16], n * 16, rt);
+													n = 0;
+												}
+												if (more && !n++)
+													first = view.slot;
+											} while (more);
+										} else {
+											umr_ring_stream_present(asic,
+												NULL, 0, 0, // ring
+												0, // vmid
+												rv.seg[0].addr, // addr
+												rv.words, rv.nwords, // words, length
+												rt);
+										}
 									}
+									umr_ring_view_free(&rv);
 								}
-								free(buf);
 							}
 						} else {
 							asic->err_msg("[ERROR]: User Queue VM state is not active, did you use a --user-queue command?\n");
@@ -1209,10 +1624,34 @@ int main(int argc, char **argv)
 						fprintf(stderr, "[ERROR]: --dump-ib-file requires two parameters\n");
 						return EXIT_FAILURE;
 					}
+				} else if (!strcmp(argv[i], "--logscan-file") || !strcmp(argv[i], "-lsf") ||
+					   !strcmp(argv[i], "--logscan-histogram") || !strcmp(argv[i], "-lsh")) {
+					int histogram = !strcmp(argv[i], "--logscan-histogram") || !strcmp(argv[i], "-lsh");
+					const char *filter = NULL;
+
+					if (i + 1 < argc) {
+						argflags[i] = argflags[i + 1] = 1;
+						if (i + 2 < argc && argv[i + 2][0] != '-') {
+							filter = argv[i + 2];
+							argflags[i + 2] = 1;
+						}
+						if (umr_scan_log_file(asic, argv[i + 1], filter, histogram))
+							return EXIT_FAILURE;
+						i += filter ? 2 : 1;
+					} else {
+						fprintf(stderr, "[ERROR]: %s requires a file\n", argv[i]);
+						return EXIT_FAILURE;
+					}
 				} else if (!strcmp(argv[i], "--logscan") || !strcmp(argv[i], "-ls")) {
-					int r, new = 0;
+					int r, new = 0, follow = 0, top_n = 20;
 
 					argflags[i] = 1;
+					if (i + 1 < argc && !strcmp(argv[i+1], "--follow")) {
+						argflags[++i] = 1;
+						follow = 1;
+						if (i + 1 < argc && sscanf(argv[i+1], "%d", &top_n) == 1)
+							argflags[++i] = 1;
+					}
 
 					signal(SIGINT, sigint);
 					r = system("echo 1 > /sys/kernel/debug/tracing/events/amdgpu/amdgpu_mm_wreg/enable");
@@ -1226,11 +1665,15 @@ int main(int argc, char **argv)
 						}
 						new = 1;
 					}
-					req.tv_sec = 0;
-					req.tv_nsec = 1000000000/10; // 100ms
-					while (!quit) {
-						nanosleep(&req, NULL);
-						umr_scan_log(asic, new);
+					if (follow) {
+						umr_follow_log(asic, new, top_n);
+					} else {
+						req.tv_sec = 0;
+						req.tv_nsec = 1000000000/10; // 100ms
+						while (!quit) {
+							nanosleep(&req, NULL);
+							umr_scan_log(asic, new);
+						}
 					}
 					if (new) {
 						r = system("echo 0 > /sys/kernel/debug/tracing/events/amdgpu/amdgpu_device_wreg/enable");
@@ -1244,15 +1687,10 @@ int main(int argc, char **argv)
 						return EXIT_FAILURE;
 					}
 				} else if (!strcmp(argv[i], "--top") || !strcmp(argv[i], "-t")) {
-					uint32_t value;
 					argflags[i] = 1;
-					value = 0;
-					if (asic->fd.gfxoff >= 0)
-						value = write(asic->fd.gfxoff, &value, sizeof(value));
+					umr_gfxoff_hold(asic);
 					umr_top(asic);
-					value = 1;
-					if (asic->fd.gfxoff >= 0)
-						value = write(asic->fd.gfxoff, &value, sizeof(value));
+					umr_gfxoff_release(asic);
 				} else if (!strcmp(argv[i], "-mm")) {
 					if (i + 1 < argc) {
 						argflags[i] = 1;
@@ -1295,7 +1733,10 @@ int main(int argc, char **argv)
 						if (asic->options.hub_name[0])
 							vmid |= UMR_USER_HUB;
 
-						umr_read_vram(asic, asic->options.vm_partition, vmid, address, 0x1000UL * size, NULL);
+						if (asic->options.jsonl)
+							vm_decode_jsonl(asic, vmid, address, size);
+						else
+							umr_read_vram(asic, asic->options.vm_partition, vmid, address, 0x1000UL * size, NULL);
 						i += 2;
 
 						asic->options.verbose = overbose;
@@ -1303,6 +1744,41 @@ int main(int argc, char **argv)
 						fprintf(stderr, "[ERROR]: --vm-decode requires two parameters\n");
 						return EXIT_FAILURE;
 					}
+				} else if (!strcmp(argv[i], "--vm-map") || !strcmp(argv[i], "-vmm")) {
+					if (i + 1 < argc) {
+						struct umr_vm_mapping *maps;
+						uint64_t no_maps, n;
+						uint32_t vmid;
+
+						argflags[i] = 1;
+						argflags[i+1] = 1;
+
+						if ((sscanf(argv[i+1], "0x%"SCNx32, &vmid)) != 1)
+							if ((sscanf(argv[i+1], "%"SCNu32, &vmid)) != 1) {
+								fprintf(stderr, "[ERROR]: Must specify a VMID for the --vm-map command\n");
+								exit(EXIT_FAILURE);
+							}
+
+						// imply user hub if hub name specified
+						if (asic->options.hub_name[0])
+							vmid |= UMR_USER_HUB;
+
+						if (umr_vm_map(asic, asic->options.vm_partition, vmid, &maps, &no_maps) == 0) {
+							for (n = 0; n < no_maps; n++)
+								printf("0x%012" PRIx64 "-0x%012" PRIx64 " => %s:0x%012" PRIx64 " (%" PRIu64 " KiB) V=%" PRIu64 " R=%" PRIu64 " W=%" PRIu64 " X=%" PRIu64 " T=%" PRIu64 " MTYPE=%" PRIu64 "\n",
+									maps[n].va, maps[n].va + maps[n].size - 1,
+									maps[n].system ? "sys" : "vram", maps[n].pa,
+									maps[n].size >> 10,
+									maps[n].pte_fields.valid, maps[n].pte_fields.read,
+									maps[n].pte_fields.write, maps[n].pte_fields.execute,
+									maps[n].pte_fields.tmz, maps[n].pte_fields.mtype);
+							free(maps);
+						}
+						++i;
+					} else {
+						fprintf(stderr, "[ERROR]: --vm-map requires a parameter\n");
+						return EXIT_FAILURE;
+					}
 				} else if (!strcmp(argv[i], "-vr") || !strcmp(argv[i], "--vm-read")) {
 					if (i + 2 < argc) {
 						unsigned char buf[256];
@@ -1344,6 +1820,39 @@ int main(int argc, char **argv)
 						fprintf(stderr, "[ERROR]: --vm-read requires two parameters\n");
 						return EXIT_FAILURE;
 					}
+				} else if (!strcmp(argv[i], "-db") || !strcmp(argv[i], "--dump-bo")) {
+					if (i + 2 < argc) {
+						uint64_t offset = 0, size = 0;
+						uint32_t handle;
+						int pid, fd = -1, dmabuf_fd, r;
+
+						argflags[i] = 1;
+						argflags[i+1] = 1;
+						argflags[i+2] = 1;
+						if (sscanf(argv[i+1], "%d@%d", &pid, &fd) < 1 ||
+						    sscanf(argv[i+2], "%"SCNu32, &handle) != 1) {
+							fprintf(stderr, "[ERROR]: --dump-bo expects <pid>[@<fd>] <handle>\n");
+							return EXIT_FAILURE;
+						}
+						// optional byte range in hex
+						if (i + 4 < argc && sscanf(argv[i+3], "%"SCNx64, &offset) == 1 &&
+						    sscanf(argv[i+4], "%"SCNx64, &size) == 1) {
+							argflags[i+3] = 1;
+							argflags[i+4] = 1;
+							i += 2;
+						}
+						dmabuf_fd = umr_sdma_export_client_bo(asic, pid, fd, handle);
+						if (dmabuf_fd < 0)
+							return EXIT_FAILURE;
+						r = umr_sdma_read_dmabuf(asic, dmabuf_fd, offset, size, stdout_sink, NULL);
+						close(dmabuf_fd);
+						if (r)
+							return EXIT_FAILURE;
+						i += 2;
+					} else {
+						fprintf(stderr, "[ERROR]: --dump-bo requires two parameters\n");
+						return EXIT_FAILURE;
+					}
 				} else if (!strcmp(argv[i], "-vw") || !strcmp(argv[i], "--vm-write")) {
 					if (i + 2 < argc) {
 						unsigned char buf[256];
@@ -1457,7 +1966,8 @@ int main(int argc, char **argv)
 					}
 				} else if (!strcmp(argv[i], "-prof") || !strcmp(argv[i], "--profiler")) {
 					if (i + 1 < argc) {
-						int n = 0, samples = -1, type = -1;
+						int n = 0, samples = -1, type = -1, rate = -1;
+						char *at;
 
 						argflags[i] = 1;
 						argflags[i+1] = 1;
@@ -1475,7 +1985,10 @@ int main(int argc, char **argv)
 							type = 2;
 						else
 							samples = atoi(argv[i+1]);
-						umr_profiler(asic, samples, type);
+						at = strchr(argv[i+1], '@');
+						if (at)
+							rate = strcmp(at + 1, "auto") ? atoi(at + 1) : UMR_PROFILER_RATE_AUTO;
+						umr_profiler(asic, samples, type, rate, profiler_export_format, profiler_export_path);
 						i += 1 + n;
 					} else {
 						fprintf(stderr, "[ERROR]: --profiler requires one parameter\n");
@@ -1583,13 +2096,16 @@ int main(int argc, char **argv)
 				} else if (!strcmp(argv[i], "--runlist") || !strcmp(argv[i], "-rls")) {
 					char busaddr[64];
 					if (i + 1 < argc) {
-						int node = atoi(argv[i + 1]); ++i;
+						// every node in the dump is decoded with 'all'
+						int node = strcmp(argv[i + 1], "all") ? atoi(argv[i + 1]) : -1; ++i;
 						argflags[i] = 1;
 						argflags[i+1] = 1;
-						if (umr_kfd_topo_get_pci_busaddr(node, busaddr)) {
-							return EXIT_FAILURE;
+						if (node >= 0) {
+							if (umr_kfd_topo_get_pci_busaddr(node, busaddr)) {
+								return EXIT_FAILURE;
+							}
+							sscanf(busaddr, "%04x:%02x:%02x.%01x", &options.pci.domain, &options.pci.bus, &options.pci.slot, &options.pci.func);
 						}
-						sscanf(busaddr, "%04x:%02x:%02x.%01x", &options.pci.domain, &options.pci.bus, &options.pci.slot, &options.pci.func);
 						asic->options.use_pci = 0;
 						// TODO: it'd be nice to get VMID from the PASID so we can enable these
 						asic->options.no_follow_ib = 1;
@@ -1620,6 +2136,17 @@ int main(int argc, char **argv)
 					buf = rumr_serialize_asic(asic);
 					rumr_save_serialized_asic(asic, buf);
 					rumr_buffer_free(buf);
+				} else if (!strcmp(argv[i], "--daemon")) {
+					argflags[i] = 1;
+					if (i + 1 < argc && !daemon_asic) {
+						if (!asic)
+							asic = get_asic();
+						daemon_asic = asic;
+						return umr_daemon_run(asic, argv[i+1], main) ? EXIT_FAILURE : EXIT_SUCCESS;
+					} else {
+						fprintf(stderr, "[ERROR]: --daemon requires one parameter (and cannot be sent to a daemon)\n");
+						return EXIT_FAILURE;
+					}
 				} else if (!strcmp(argv[i], "--rumr-server")) {
 					struct rumr_comm_funcs *cf;
 					char *cfp;
@@ -1630,14 +2157,13 @@ int main(int argc, char **argv)
 					if (i + 1 < argc) {
 						cf = rumr_get_cf(argv[i+1], &cfp);
 						++i;
+						memset(&st, 0, sizeof st);
 						st.asic = asic;
 						if (rumr_server_bind(&st, cf, cfp)) {
 							return EXIT_FAILURE;
 						}
-						for (;;) {
-							rumr_server_accept(&st);
-							while (!rumr_server_loop(&st));
-						}
+						rumr_server_run(&st);
+						return EXIT_FAILURE;
 					} else {
 						fprintf(stderr, "[ERROR]: --rumr-server requires one parameter\n");
 						return EXIT_FAILURE;
@@ -1668,13 +2194,33 @@ stopprocessingcommands:
 			    UMR_BUILD_VER, UMR_BUILD_REV, UMR_BUILD_BRANCH, __DATE__);
 	}
 
-	if (options.use_xgmi) {
-		// the parent 'asic' is included in the nodes array
-		int n;
-		for (n = 0; asic->config.xgmi.nodes[n].asic; n++)
-			umr_close_asic(asic->config.xgmi.nodes[n].asic);
+	if (asic && asic->capture && umr_capture_write(asic, capture_path))
+		fprintf(stderr, "[ERROR]: The capture bundle was not written\n");
+
+	if (asic && asic == daemon_asic) {
+		// a daemon child, it exits right after so nothing needs freeing
+		if (print_io_stats)
+			print_asic_io_stats(asic);
+	} else if (options.use_xgmi) {
+		// the parent 'asic' is included in the nodes array, nodes
+		// that were never used were not opened
+		struct umr_asic *nodes[UMR_MAX_XGMI_DEVICES];
+		int n, no_nodes = umr_xgmi_no_nodes(asic);
+		for (n = 0; n < no_nodes; n++)
+			nodes[n] = asic->config.xgmi.nodes[n].asic;
+		for (n = 0; n < no_nodes; n++) {
+			if (!nodes[n])
+				continue;
+			if (print_io_stats)
+				print_asic_io_stats(nodes[n]);
+			umr_close_asic(nodes[n]);
+		}
 	} else if (asic) {
+		if (print_io_stats)
+			print_asic_io_stats(asic);
 		if (client_st.asic == asic) {
+			if (print_rumr_stats)
+				rumr_client_print_stats(&client_st, stderr);
 			rumr_client_close(&client_st);
 		} else {
 			umr_close_asic(asic);
@@ -1684,6 +2230,8 @@ stopprocessingcommands:
 	if (th) {
 		umr_free_test_harness(th);
 	}
+	umr_test_vector_close(options.test_log_bin);
+	umr_free_capture_bundle(bundle);
 
 	if (options.export_model) {
 		fprintf(stderr, "[NOTE]: ASIC model exported uses FAMILY_NV family and IS_APU=0 flag, change these as appropriate.\n");
@@ -313,13 +313,15 @@ struct {
 	{ NULL, NULL, 0},
 };
 
-int umr_navi10_pptable_print(const char* param, FILE* fp)
+// hash of the table pp_table_header/pp_table were last decoded from
+static uint64_t decoded_hash;
+static int decoded;
+
+int umr_navi10_pptable_print(const char* param, const uint8_t *raw, uint32_t size, uint64_t hash)
 {
 	uint32_t  table_header_len = 0;
 	uint32_t  table_len = 0;
-	void* table_container = NULL;
 	uint32_t  table_container_len = 0;
-	uint32_t r = 0;
 	int i = 0;
 	int flag = 0;
 
@@ -327,19 +329,13 @@ int umr_navi10_pptable_print(const char* param, FILE* fp)
 	table_len = sizeof(pp_table);
 	table_container_len = table_header_len + table_len;
 
-	table_container = calloc(1, table_container_len);
-	if (table_container == NULL) {
-		fprintf(stderr, "[ERROR]: Out of memory\n");
+	if (size < table_container_len)
 		return -1;
-	}
-
-	r = fread(table_container, 1, table_container_len, fp);
-	if (r != table_container_len) {
-		free(table_container);
-		return -1;
-	} else {
-		memcpy(&pp_table_header, table_container, table_header_len);
-		memcpy(&pp_table, (char*)table_container + table_header_len, table_len);
+	if (!decoded || decoded_hash != hash) {
+		memcpy(&pp_table_header, raw, table_header_len);
+		memcpy(&pp_table, raw + table_header_len, table_len);
+		decoded_hash = hash;
+		decoded = 1;
 	}
 
 	if (param == NULL) {
@@ -367,11 +363,9 @@ int umr_navi10_pptable_print(const char* param, FILE* fp)
 		}
 		if (flag == 0) {
 			printf("Can not find %s in pptable\n", param);
-			free(table_container);
 			return -1;
 		}
 	}
 
-	free(table_container);
 	return 0;
 }
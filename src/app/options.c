@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umrapp.h"
+
+// "2" or "0-3+8", the bits of the listed units
+static uint64_t parse_unit_mask(const char *str)
+{
+	uint64_t mask = 0;
+	unsigned lo, hi;
+	char *end;
+
+	while (*str) {
+		lo = hi = strtoul(str, &end, 10);
+		if (*end == '-')
+			hi = strtoul(end + 1, &end, 10);
+		while (lo <= hi && lo < 64)
+			mask |= 1ULL << lo++;
+		if (*end != '+')
+			break;
+		str = end + 1;
+	}
+	return mask;
+}
+
+/**
+ * umr_parse_options - Apply a comma separated list of -O options
+ * @options: The options to update
+ * @str: The list, e.g. "bits,use_colour"
+ *
+ * Returns 0 on success, -1 if an option is unknown.
+ */
+int umr_parse_options(struct umr_options *options, char *str)
+{
+	char option[64], *p;
+
+	while (*str) {
+		p = &option[0];
+		while (*str && *str != ',' && p != &option[sizeof(option)-1])
+			*p++ = *str++;
+		*p = 0;
+		if (*str == ',')
+			++str;
+		if (!strcmp(option, "bits")) {
+			options->bitfields = 1;
+		} else if (!strcmp(option, "skip_gprs")) {
+			options->skip_gprs = 1;
+		} else if (!strcmp(option, "empty_log")) {
+			options->empty_log = 1;
+		} else if (!strcmp(option, "use_pci")) {
+			options->use_pci = 1;
+		} else if (!strcmp(option, "use_colour") || !strcmp(option, "use_color")) {
+			options->use_colour = 1;
+		} else if (!strcmp(option, "bitsfull")) {
+			options->bitfields = 1;
+			options->bitfields_full = 1;
+		} else if (!strcmp(option, "read_smc")) {
+			options->read_smc = 1;
+		} else if (!strcmp(option, "quiet")) {
+			options->quiet = 1;
+		} else if (!strcmp(option, "full_shader")) {
+			options->full_shader = 1;
+		} else if (!strcmp(option, "filter_shader_registers")) {
+			options->filter_shader_registers = 1;
+		} else if (!strcmp(option, "no_follow_ib")) {
+			options->no_follow_ib = 1;
+			options->no_follow_shader = 1;
+			options->no_follow_loadx = 1;
+		} else if (!strcmp(option, "no_follow_chained_ib")) {
+			options->no_follow_chained_ib = 1;
+		} else if (!strcmp(option, "verbose")) {
+			options->verbose = 1;
+		} else if (!strcmp(option, "halt_waves")) {
+			options->halt_waves = 1;
+		} else if (!strcmp(option, "wave64")) {
+			options->wave64 = 1;
+		} else if (!strcmp(option, "disasm_early_term")) {
+			options->disasm_early_term = 1;
+		} else if (!strcmp(option, "no_kernel")) {
+			options->no_kernel = 1;
+			options->use_pci = 1;
+		} else if (!strcmp(option, "no_disasm")) {
+			options->no_disasm = 1;
+		} else if (!strcmp(option, "disasm_anyways")) {
+			options->disasm_anyways = 1;
+		} else if (!strcmp(option, "no_fold_vm_decode")) {
+			options->no_fold_vm_decode = 1;
+		} else if (!strcmp(option, "force_asic_file")) {
+			options->force_asic_file = 1;
+		} else if (!strcmp(option, "export_model")) {
+			options->export_model = 1;
+		} else if (!strcmp(option, "use_full_user_queue")) {
+			options->use_full_user_queue = 1;
+		} else if (!strcmp(option, "aql_heuristic")) {
+			options->aql_heuristic = 1;
+		} else if (!strcmp(option, "use_io_uring")) {
+			options->use_io_uring = 1;
+		} else if (!strcmp(option, "no_lazy_regs")) {
+			options->no_lazy_regs = 1;
+		} else if (!strcmp(option, "use_vram_bar")) {
+			options->use_vram_bar = 1;
+		} else if (!strcmp(option, "parallel_waves")) {
+			options->parallel_waves = 1;
+		} else if (!strcmp(option, "prefetch_gprs")) {
+			options->prefetch_gprs = 1;
+		} else if (!strcmp(option, "parallel_ibs")) {
+			options->parallel_ibs = 1;
+		} else if (!strcmp(option, "vcn_summary")) {
+			options->vcn_summary = 1;
+		} else if (!strcmp(option, "metrics_changed")) {
+			options->metrics_changed = 1;
+		} else if (!strcmp(option, "rumr_cache")) {
+			options->rumr_cache = 1;
+		} else if (!strncmp(option, "ring_halt_timeout=", 18)) {
+			options->ring_halt_timeout = atoi(option + 18);
+		} else if (!strncmp(option, "cpu_affinity=", 13)) {
+			snprintf(options->cpu_affinity, sizeof(options->cpu_affinity), "%s", option + 13);
+		} else if (!strncmp(option, "wave_se=", 8)) {
+			options->wave_filter.se = parse_unit_mask(option + 8);
+		} else if (!strncmp(option, "wave_sh=", 8)) {
+			options->wave_filter.sh = parse_unit_mask(option + 8);
+		} else if (!strncmp(option, "wave_cu=", 8)) {
+			options->wave_filter.cu = parse_unit_mask(option + 8);
+		} else if (!strncmp(option, "max_waves=", 10)) {
+			options->wave_filter.max_waves = atoi(option + 10);
+		} else {
+			printf("error: Unknown option [%s]\n", option);
+			return -1;
+		}
+	}
+	return 0;
+}
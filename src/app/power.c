@@ -205,10 +205,14 @@ void umr_power(struct umr_asic *asic)
 	req.tv_sec = 1;
 	req.tv_nsec = 0;
 
-	while (!quit) {
+	// the sensors are re-read in place every refresh
+	if (asic->fd.sensors < 0) {
 		snprintf(fname, sizeof(fname)-1, "/sys/kernel/debug/dri/%d/amdgpu_sensors", asic->instance);
 		asic->fd.sensors = open(fname, O_RDWR);
-		if (asic->fd.sensors) {
+	}
+
+	while (!quit) {
+		if (asic->fd.sensors >= 0) {
 			for ( i = 0; p_info[i].regname != NULL; i++){
 				size = 4;
 				p_info[i].value = 0;
@@ -219,7 +223,6 @@ void umr_power(struct umr_asic *asic)
 					p_info[i].value = parse_sensor_value(p_info[i].map, p_info[i].value);
 				}
 			}
-			close(asic->fd.sensors);
 		} else {
 			printf("failed to open amdgpu_sensors!");
 			break;
@@ -27,25 +27,17 @@
 
 int umr_print_pp_table(struct umr_asic *asic, const char *param)
 {
-	FILE *fp;
-	int res;
-	char name[256];
+	const struct umr_pp_cache *pp;
 
-	snprintf(name, sizeof(name)-1, \
-		 "/sys/class/drm/card%d/device/pp_table", asic->instance);
-	fp = fopen(name, "r");
-	if (!fp) {
-		asic->err_msg("fopen: %s: %d\n", strerror(errno), errno);
-		return -errno;
+	pp = umr_pp_cache_get(asic, 1);
+	if (!pp || !pp->pp_table) {
+		asic->err_msg("[ERROR]: Could not read the powerplay table of card%d\n", asic->instance);
+		return -1;
 	}
 	if (strcmp(asic->asicname, "navi10") == 0 ||
-	    strcmp(asic->asicname, "navi14") == 0) {
-		res = umr_navi10_pptable_print(param, fp);
-	} else {
-		asic->err_msg("The powerplay table feature is currently supported only on Navi10/Navi14.\n");
-		res = -1;
-	}
-	fclose(fp);
+	    strcmp(asic->asicname, "navi14") == 0)
+		return umr_navi10_pptable_print(param, pp->pp_table, pp->pp_table_size, pp->hash);
 
-	return res;
+	asic->err_msg("The powerplay table feature is currently supported only on Navi10/Navi14.\n");
+	return -1;
 }
@@ -120,6 +120,10 @@ void umr_print_config(struct umr_asic *asic)
 {
 	int r, x;
 
+	// the versions are not read at startup, only for a device that was scanned
+	if (asic->config.scanned)
+		umr_scan_config_fields(asic, 0, UMR_CONFIG_SCAN_VBIOS | UMR_CONFIG_SCAN_FW);
+
 	printf("\tasic.instance == %d\n", asic->instance);
 	printf("\tasic.devname == %s\n", asic->options.pci.name);
 	printf("\tasic.family == %d\n", (int)asic->family);
@@ -132,12 +136,15 @@ void umr_print_config(struct umr_asic *asic)
 	if (asic->options.use_xgmi) {
 		printf("\tasic.xgmi_hive_id == %llu\n", (unsigned long long)asic->config.xgmi.hive_id);
 		printf("\tasic.xgmi_device_id == %llu\n", (unsigned long long)asic->config.xgmi.device_id);
-		for (x = 0; asic->config.xgmi.nodes[x].asic; x++) {
-			printf("\tasic.xgmi.node[%d].asicname == %s\n", x, asic->config.xgmi.nodes[x].asic->asicname);
-			printf("\tasic.xgmi.node[%d].devname == %s\n", x, asic->config.xgmi.nodes[x].asic->options.pci.name);
+		for (x = 0; x < umr_xgmi_no_nodes(asic); x++) {
+			struct umr_asic *node = umr_xgmi_node(asic, x);
+			if (!node)
+				continue;
+			printf("\tasic.xgmi.node[%d].asicname == %s\n", x, node->asicname);
+			printf("\tasic.xgmi.node[%d].devname == %s\n", x, node->options.pci.name);
 			printf("\tasic.xgmi.node[%d].device_id == %llu\n", x, (unsigned long long)asic->config.xgmi.nodes[x].node_id);
 			printf("\tasic.xgmi.node[%d].hive_position == %d\n", x, asic->config.xgmi.nodes[x].hive_position);
-			printf("\tasic.xgmi.node[%d].vram_mib == %llu\n", x, (unsigned long long)asic->config.xgmi.nodes[x].asic->config.vram_size >> 20ULL);
+			printf("\tasic.xgmi.node[%d].vram_mib == %llu\n", x, (unsigned long long)node->config.vram_size >> 20ULL);
 		}
 	}
 
@@ -3,22 +3,34 @@
 #include <inttypes.h>
 #include <stdio.h>
 
-uint32_t read_sdma_reg(struct umr_asic *asic, char *ipname,
-                       char *prefix,
-                       char *suffix)
-{
-	char name[256];
+enum {
+	SDMA_RB_CNTL = 0,
+	SDMA_RB_BASE,
+	SDMA_RB_BASE_HI,
+	SDMA_RB_RPTR,
+	SDMA_RB_RPTR_HI,
+	SDMA_RB_WPTR,
+	SDMA_RB_WPTR_HI,
+	SDMA_RB_RPTR_ADDR_LO,
+	SDMA_RB_RPTR_ADDR_HI,
+	SDMA_RB_REGS,
+};
 
-	sprintf(name, "%s%s", prefix, suffix);
-	return umr_read_reg_by_name_by_ip_by_instance(asic, ipname, asic->options.vm_partition, name);
-}
+static const char *sdma_suffix[SDMA_RB_REGS] = {
+	"RB_CNTL", "RB_BASE", "RB_BASE_HI", "RB_RPTR", "RB_RPTR_HI",
+	"RB_WPTR", "RB_WPTR_HI", "RB_RPTR_ADDR_LO", "RB_RPTR_ADDR_HI",
+};
 
 void umr_print_sdma(struct umr_asic *asic)
 {
-	uint32_t rings_per_eng;
+	struct umr_reg_batch batch[2 * 8 * SDMA_RB_REGS];
+	struct umr_reg *reg;
+	uint32_t rings_per_eng, v[SDMA_RB_REGS];
 	int use_queue = 0;
-	int maj, min;
+	int maj, min, n, x;
 	char *ipname = "sdma";
+	char name[64];
+	int8_t slot[2][8][SDMA_RB_REGS];
 
 	umr_gfx_get_ip_ver(asic, &maj, &min);
 	if (maj >= 10)
@@ -32,38 +44,42 @@ void umr_print_sdma(struct umr_asic *asic)
 		use_queue = 1;
 	}
 
+	// the ring registers of every engine are read in one batch
+	n = 0;
 	for (uint32_t eng = 0; eng < 2; ++ eng) {
 		for (uint32_t ring = 0; ring < rings_per_eng; ++ ring) {
-			char prefix[64];
-			if (!use_queue) {
-				strcpy(prefix, "mmSDMAx_RLCx_");
-				prefix[6] = '0' + eng;
-				prefix[11] = '0' + ring;
-			} else {
-				strcpy(prefix, "mmSDMAx_QUEUEx_");
-				prefix[6] = '0' + eng;
-				prefix[13] = '0' + ring;
+			for (x = 0; x < SDMA_RB_REGS; x++) {
+				sprintf(name, "@mmSDMA%u_%s%u_%s", eng, use_queue ? "QUEUE" : "RLC", ring, sdma_suffix[x]);
+				reg = umr_find_reg_data_by_ip_by_instance(asic, ipname, asic->options.vm_partition, name);
+				slot[eng][ring][x] = -1;
+				if (!reg)
+					continue;
+				slot[eng][ring][x] = n;
+				batch[n].addr = reg->type == REG_MMIO ? reg->addr * 4 : reg->addr;
+				batch[n].type = reg->type;
+				batch[n].use_bank = asic->options.use_bank;
+				batch[n].bank = asic->options.bank;
+				++n;
 			}
+		}
+	}
+	if (umr_read_regs_batch(asic, batch, n))
+		return;
 
-			uint32_t rb_cntl = read_sdma_reg(asic, ipname, prefix, "RB_CNTL");
+	for (uint32_t eng = 0; eng < 2; ++ eng) {
+		for (uint32_t ring = 0; ring < rings_per_eng; ++ ring) {
+			for (x = 0; x < SDMA_RB_REGS; x++)
+				v[x] = slot[eng][ring][x] < 0 ? 0 : batch[slot[eng][ring][x]].value;
 
-			if (rb_cntl & (1 << 12)) {
-				uint32_t rb_base_lo = read_sdma_reg(asic, ipname, prefix, "RB_BASE");
-				uint32_t rb_base_hi = read_sdma_reg(asic, ipname, prefix, "RB_BASE_HI");
-				uint64_t rb_base = (((uint64_t)rb_base_hi << 0x20) | rb_base_lo) << 0x8;
-				uint32_t rb_rptr_lo = read_sdma_reg(asic, ipname, prefix, "RB_RPTR");
-				uint32_t rb_rptr_hi = read_sdma_reg(asic, ipname, prefix, "RB_RPTR_HI");
-				uint64_t rb_rptr = ((uint64_t)rb_rptr_hi << 0x20) | rb_rptr_lo;
-				uint32_t rb_wptr_lo = read_sdma_reg(asic, ipname, prefix, "RB_WPTR");
-				uint32_t rb_wptr_hi = read_sdma_reg(asic, ipname, prefix, "RB_WPTR_HI");
-				uint64_t rb_wptr = ((uint64_t)rb_wptr_hi << 0x20) | rb_wptr_lo;
-				uint32_t rb_rptr_addr_lo = read_sdma_reg(asic, ipname, prefix, "RB_RPTR_ADDR_LO");
-				uint32_t rb_rptr_addr_hi = read_sdma_reg(asic, ipname, prefix, "RB_RPTR_ADDR_HI");
-				uint64_t rb_rptr_addr = ((uint64_t)rb_rptr_addr_hi << 0x20) | rb_rptr_addr_lo;
+			if (v[SDMA_RB_CNTL] & (1 << 12)) {
+				uint64_t rb_base = (((uint64_t)v[SDMA_RB_BASE_HI] << 0x20) | v[SDMA_RB_BASE]) << 0x8;
+				uint64_t rb_rptr = ((uint64_t)v[SDMA_RB_RPTR_HI] << 0x20) | v[SDMA_RB_RPTR];
+				uint64_t rb_wptr = ((uint64_t)v[SDMA_RB_WPTR_HI] << 0x20) | v[SDMA_RB_WPTR];
+				uint64_t rb_rptr_addr = ((uint64_t)v[SDMA_RB_RPTR_ADDR_HI] << 0x20) | v[SDMA_RB_RPTR_ADDR_LO];
 
 				printf("SDMA %u  RLC %u\n", eng, ring);
 				printf("  RB BASE 0x%" PRIx64 "  RPTR 0x%" PRIx64 "  WPTR 0x%" PRIx64 "  RPTR_ADDR 0x%" PRIx64 "  CNTL 0x%x\n\n",
-				rb_base, rb_rptr, rb_wptr, rb_rptr_addr, rb_cntl);
+				rb_base, rb_rptr, rb_wptr, rb_rptr_addr, v[SDMA_RB_CNTL]);
 			}
 		}
 	}
@@ -76,8 +76,10 @@ void umr_print_uq_info(struct umr_asic *asic)
 
     for (x = 0; x < UMR_MAX_MQD_QUEUES; x++) {
         if (asic->options.user_queue.client_info.queue[x].mqd_gpu_address) {
-            char **mqd_txt;
-            uint32_t qt;
+            struct umr_mqd_filter filt;
+            struct umr_mqd_field field;
+            char line[256];
+            uint32_t qt, row;
 
             asic->std_msg("Queue #%d:\n\tqueue_id: %"PRIu32"\n", x, asic->options.user_queue.client_info.queue[x].queue_id);
             asic->std_msg("\tqueue_type: %"PRIu32" (%s)\n",
@@ -107,20 +109,16 @@ void umr_print_uq_info(struct umr_asic *asic)
                     asic->err_msg("[BUG]: Invalid queue type [%d] in --print-uq\n", (int)asic->options.user_queue.client_info.queue[x].queue_type);
                     return;
             }
-            mqd_txt = umr_mqd_decode_data(
-                qt,
-                asic->family,
-                asic->options.user_queue.client_info.queue[x].mqd_words,
-                "*");
-
-            if (mqd_txt) {
-                int y;
-                for (y = 0; mqd_txt[y]; y++) {
-                    asic->std_msg("\t\tqueue.%"PRIu32".%s\n", asic->options.user_queue.client_info.queue[x].queue_id, mqd_txt[y]);
-                    free(mqd_txt[y]);
+            if (!umr_mqd_filter_init(&filt, qt, asic->family, "*")) {
+                row = 0;
+                while (umr_mqd_field_next(&filt,
+                                          asic->options.user_queue.client_info.queue[x].mqd_words,
+                                          UMR_MAX_MQD_SIZE, NULL, &row, &field)) {
+                    umr_mqd_field_format(&field, line, sizeof line);
+                    asic->std_msg("\t\tqueue.%"PRIu32".%s\n", asic->options.user_queue.client_info.queue[x].queue_id, line);
                 }
-                free(mqd_txt);
             }
+            umr_mqd_filter_free(&filt);
 
             asic->std_msg("\n");
         }
@@ -32,6 +32,61 @@
 
 #define NUM_OPCODE_WORDS 16
 
+// a wave as a JSON line: its slot and status registers (and their fields with -O bits)
+static void jsonl_wave(struct umr_asic *asic, struct umr_wave_data *wd)
+{
+	struct umr_bitfield *bits;
+	int x, y, no_bits;
+
+	umr_jsonl_begin("wave");
+	umr_jsonl_int("se", wd->se);
+	umr_jsonl_int("sh", wd->sh);
+	umr_jsonl_int("cu", wd->cu);
+	umr_jsonl_int("simd", wd->simd);
+	umr_jsonl_int("wave", wd->wave);
+	if (asic->options.all_xcc)
+		umr_jsonl_int("xcc", wd->xcc);
+	umr_jsonl_bool("tainted", wd->tainted);
+	umr_jsonl_object("regs", 0);
+	for (x = 0; wd->reg_names[x]; x++)
+		umr_jsonl_u64(wd->reg_names[x], wd->ws.reg_values[x]);
+	umr_jsonl_close();
+	if (asic->options.bitfields) {
+		umr_jsonl_object("bits", 0);
+		for (x = 0; wd->reg_names[x]; x++) {
+			umr_wave_data_get_bit_info(asic, wd, wd->reg_names[x], &no_bits, &bits);
+			umr_jsonl_object(wd->reg_names[x], 0);
+			for (y = 0; y < no_bits; y++)
+				umr_jsonl_u64(bits[y].regname, umr_wave_data_get_bits(asic, wd, wd->reg_names[x], bits[y].regname));
+			umr_jsonl_close();
+		}
+		umr_jsonl_close();
+	}
+	umr_jsonl_end();
+}
+
+struct halt_req {
+	enum umr_sq_cmd_halt_resume mode;
+	int max_retries;
+};
+
+static int halt_waves_xcc(struct umr_asic *asic, void *data)
+{
+	struct halt_req *req = data;
+
+	return umr_sq_cmd_halt_waves(asic, req->mode, req->max_retries);
+}
+
+// halt or resume the waves, of every XCC with -vmp all
+static int halt_waves(struct umr_asic *asic, enum umr_sq_cmd_halt_resume mode, int max_retries)
+{
+	struct halt_req req = { mode, max_retries };
+
+	if (asic->options.all_xcc)
+		return umr_xcc_run(asic, halt_waves_xcc, &req);
+	return umr_sq_cmd_halt_waves(asic, mode, max_retries);
+}
+
 void umr_print_waves(struct umr_asic *asic)
 {
 	uint32_t x, y, thread;
@@ -45,24 +100,32 @@ void umr_print_waves(struct umr_asic *asic)
 		uint64_t addr;
 	} ib_addr;
 	int start = -1, stop = -1;
-	int gfx_maj, gfx_min;
+	int gfx_maj, gfx_min, vm_partition = asic->options.vm_partition;
 	FILE *output = NULL;
-	char *wavefront_desc;
+	char *wavefront_desc, *text = NULL;
+	size_t text_size = 0;
 	int no_bits;
 	struct umr_bitfield *bits;
-	char linebuf[256];
 	struct umr_shader_reg_pair *regs;
 
 	umr_gfx_get_ip_ver(asic, &gfx_maj, &gfx_min);
 
 	if (asic->options.halt_waves) {
-		if (umr_sq_cmd_halt_waves(asic, UMR_SQ_CMD_HALT, 100) != 0) {
+		if (halt_waves(asic, UMR_SQ_CMD_HALT, 100) != 0) {
 			fprintf(stderr, "[WARNING]: Halting waves failed.\n");
 		}
 	} else {
 		fprintf(stderr, "[WARNING]: Wave listing is unreliable if waves aren't halted; use -O halt_waves\n");
 	}
 
+	// no shader disassembly, so no packet stream to attach to
+	if (asic->options.jsonl) {
+		owd = umr_scan_wave_data(asic);
+		for (wd = owd; wd; wd = wd->next)
+			jsonl_wave(asic, wd);
+		goto cleanup;
+	}
+
 	// attach to a PM4 stream "of some providence" so we can find shaders which is handy
 	// since without knowing the start address of the shader we have to guess and guessing can
 	// go wrong...
@@ -70,16 +133,15 @@ void umr_print_waves(struct umr_asic *asic)
 		if (!strcmp(asic->options.ring_name, "uq")) {
 			// user wants to attach to the user queue for wave debugging
 			if (asic->options.user_queue.state.active) {
-				uint32_t start=0, end=0, *buf=NULL, len;
+				struct umr_ring_view rv;
+				uint32_t start=0, end=0;
 				uint32_t rt;
+				int have_span = 1;
 				ib_addr.vmid = 0; // doesn't matter
-				buf = calloc(asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].rb_buf_size, sizeof *buf);
 				if (!asic->options.use_full_user_queue) {
 					if (asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].rb_wptr_poll_value == asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].hqd_rptr_value) {
 						asic->err_msg("[ERROR]: The user queue's RPTR and WPTR are equal.  You can try using -O use_full_user_queue instead to read the entire queue.\n");
-						// free the buffer so we don't decode garbage
-						free(buf);
-						buf = NULL;
+						have_span = 0;
 					} else {
 						start = asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].hqd_rptr_value;
 						end = asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].rb_wptr_poll_value;
@@ -98,26 +160,25 @@ void umr_print_waves(struct umr_asic *asic)
 					// enable disasm_early_term because they don't use the same terminals as mesa
 					asic->options.disasm_early_term = 1;
 				}
-				if (buf) {
-					// read the user queue like a ring
-					if (umr_read_user_queue_buffer(asic, start, end, buf, &len)) {
+				if (have_span) {
+					// read the span of the user queue like a ring
+					if (umr_user_queue_view(asic, start, end, &rv)) {
 						asic->err_msg("[ERROR]: Could not read user queue packet stream.\n");
-						free(buf);
 						goto cleanup;
 					}
-					ib_addr.size = len;
-					// decode the stream copied from the queue
+					ib_addr.size = rv.nwords;
+					// decode the stream read from the queue
 					switch (asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].queue_type) {
 						case UMR_QUEUE_COMPUTE_PM4:
 						case UMR_QUEUE_GFX: rt = UMR_RING_PM4; break;
 						case UMR_QUEUE_COMPUTE: rt = UMR_RING_HSA; break;
 						default:
 							asic->err_msg("[BUG]: Unsupported queue type [%d] (%s:%d)\n", asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].queue_type, __FILE__, __LINE__);
-							free(buf);
+							umr_ring_view_free(&rv);
 							goto cleanup;
 					}
-					stream = umr_packet_decode_buffer(asic, NULL, 0, ib_addr.addr, buf, ib_addr.size, rt, NULL);
-					free(buf);
+					stream = umr_packet_decode_view(asic, NULL, 0, &rv, rt, NULL, UMR_PACKET_IP_VERSION_AUTO);
+					umr_ring_view_free(&rv);
 					if (!stream) {
 						asic->err_msg("[ERROR]: Could not decode packet stream fetched from the user queue.");
 						goto cleanup;
@@ -168,12 +229,20 @@ void umr_print_waves(struct umr_asic *asic)
 
 	owd = wd = umr_scan_wave_data(asic);
 
-	output = tmpfile();
+	// kept in memory until the waves are resumed
+	output = open_memstream(&text, &text_size);
+	if (!output) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		goto cleanup;
+	}
 	while (wd) {
 		uint64_t pc;
 		uint32_t vmid;
 		uint32_t shader_size = NUM_OPCODE_WORDS*4;
 
+		// the GPRs and the shader are read on the XCC of the wave
+		if (asic->options.all_xcc)
+			asic->options.vm_partition = wd->xcc;
 		first = 0;
 		wavefront_desc = umr_wave_data_describe_wavefront(asic, wd);
 		fprintf(output, "\n------------------------------------------------------\n%s\n", wavefront_desc);
@@ -202,6 +271,7 @@ void umr_print_waves(struct umr_asic *asic)
 		}
 
 		if (umr_wave_data_get_flag_halt(asic, wd) || umr_wave_data_get_flag_fatal_halt(asic, wd)) {
+			umr_wave_data_fetch_gprs(asic, wd);
 			for (x = 0; x < umr_wave_data_num_of_sgprs(asic, wd); x += 4)
 				fprintf(output, ">SGPRS[%s%u%s..%s%u%s] = { %s%08lx%s, %s%08lx%s, %s%08lx%s, %s%08lx%s }\n",
 					YELLOW, (unsigned)(x), RST,
@@ -332,8 +402,7 @@ void umr_print_waves(struct umr_asic *asic)
 							int k;
 							for (k = 0; k < reg->no_bits; k++) {
 								uint32_t v;
-								v = (1UL << (reg->bits[k].stop + 1 - reg->bits[k].start)) - 1;
-								v &= (regs->value >> reg->bits[k].start);
+								v = (regs->value >> reg->bits[k].start) & umr_bitfield_mask(&reg->bits[k]);
 								fprintf(output, "         %s[%u:%u] == 0x%"PRIx32"\n",
 									reg->bits[k].regname, reg->bits[k].start, reg->bits[k].stop, v);
 							}
@@ -373,25 +442,20 @@ void umr_print_waves(struct umr_asic *asic)
 		fprintf(output, "No active waves! (or GFXOFF was not disabled)\n");
 
 cleanup:
-	wd = owd;
-	while (wd) {
-		owd = wd->next;
-		free(wd);
-		wd = owd;
-	}
+	umr_free_wave_data(owd);
 
 	if (stream)
 		umr_packet_free(stream);
 
+	asic->options.vm_partition = vm_partition;
 	if (asic->options.halt_waves)
-		umr_sq_cmd_halt_waves(asic, UMR_SQ_CMD_RESUME, 0);
+		halt_waves(asic, UMR_SQ_CMD_RESUME, 0);
 
 	// dump output to stdout
 	if (output) {
-		fseek(output, 0, SEEK_SET);
-		while (fgets(linebuf, sizeof linebuf, output)) {
-			fputs(linebuf, stdout);
-		}
 		fclose(output);
+		fwrite(text, 1, text_size, umr_output_begin(asic));
+		umr_output_end(asic);
+		free(text);
 	}
 }
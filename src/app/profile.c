@@ -24,6 +24,7 @@
  */
 #include "umrapp.h"
 #include <signal.h>
+#include <time.h>
 
 struct umr_profiler_hit {
 	uint32_t
@@ -43,8 +44,8 @@ struct umr_profiler_rle {
 };
 
 struct umr_profiler_shaders {
-	uint32_t total_cnt, nhits;
-	struct umr_profiler_rle *hits;
+	uint32_t vmid, size, total_cnt;
+	uint64_t base_addr;
 };
 
 struct umr_profiler_text {
@@ -59,10 +60,20 @@ struct umr_profiler_text {
 	struct umr_profiler_text *next;
 };
 
-static int comp_hits(const void *A, const void *B)
-{
-	return memcmp(A, B, sizeof(struct umr_profiler_hit));
-}
+// hit counts by (vmid, base_addr, shader_size, pc), cnt == 0 marks a free slot
+struct umr_profiler_hits {
+	struct umr_profiler_rle *slot;
+	unsigned n, size;
+};
+
+// captured shader texts in capture order, indexed by (vmid, addr, size)
+struct umr_profiler_texts {
+	struct umr_profiler_text *head;
+	struct umr_profiler_text **slot;
+	unsigned n, size;
+};
+
+static const char *shader_names[9] = { "pixel", "vertex", "compute", "hs", "gs", "es", "ls", "opaque", "unknown" };
 
 static int comp_shaders(const void *A, const void *B)
 {
@@ -80,40 +91,173 @@ static void sigint_handler(int n)
 	exit(EXIT_FAILURE);
 }
 
-void umr_profiler(struct umr_asic *asic, int samples, int shader_target)
+static uint64_t hash_key(uint64_t a, uint64_t b, uint64_t c)
 {
-	struct umr_profiler_hit *ophit, *phit;
-	struct umr_profiler_rle *prle;
-	struct umr_profiler_shaders *shaders;
-	struct umr_profiler_text *texts, *otext;
-	struct umr_wave_data *owd, *wd;
-	struct umr_packet_stream *stream;
-	struct umr_shaders_pgm *shader;
-	unsigned nitems, nmax, nshaders, x, y, z, found;
-	char *ringname;
-	uint32_t total_hits_by_type[8], total_hits;
-	const char *shader_names[8] = { "pixel", "vertex", "compute", "hs", "gs", "es", "ls", "opaque" };
-	int sample_hit, gprs;
+	uint64_t h = a;
 
-	kill_asic = asic;
-	signal(SIGINT, &sigint_handler);
+	h = (h ^ (h >> 30) ^ b) * 0xbf58476d1ce4e5b9ULL;
+	h = (h ^ (h >> 27) ^ c) * 0x94d049bb133111ebULL;
+	return h ^ (h >> 31);
+}
 
-	memset(&total_hits_by_type, 0, sizeof total_hits_by_type);
+static struct umr_profiler_rle *hits_slot(struct umr_profiler_rle *slot, unsigned size,
+					  const struct umr_profiler_hit *hit)
+{
+	unsigned x;
+
+	x = hash_key(((uint64_t)hit->vmid << 32) | hit->shader_size, hit->base_addr, hit->pc) & (size - 1);
+	while (slot[x].cnt &&
+	       (slot[x].data.pc != hit->pc || slot[x].data.base_addr != hit->base_addr ||
+		slot[x].data.vmid != hit->vmid || slot[x].data.shader_size != hit->shader_size))
+		x = (x + 1) & (size - 1);
+	return &slot[x];
+}
+
+// count a hit, the first hit at a PC supplies the opcodes
+static int add_hit(struct umr_asic *asic, struct umr_profiler_hits *hits, const struct umr_profiler_hit *hit)
+{
+	struct umr_profiler_rle *slot, *rle;
+	unsigned x, size;
+
+	if (2 * (hits->n + 1) > hits->size) {
+		size = hits->size ? 2 * hits->size : 1024;
+		slot = calloc(size, sizeof *slot);
+		if (!slot) {
+			asic->err_msg("[ERROR]: Out of memory\n");
+			return -1;
+		}
+		for (x = 0; x < hits->size; x++)
+			if (hits->slot[x].cnt)
+				*hits_slot(slot, size, &hits->slot[x].data) = hits->slot[x];
+		free(hits->slot);
+		hits->slot = slot;
+		hits->size = size;
+	}
+
+	rle = hits_slot(hits->slot, hits->size, hit);
+	if (!rle->cnt++) {
+		rle->data = *hit;
+		++hits->n;
+	}
+	return 0;
+}
+
+static struct umr_profiler_text **texts_slot(struct umr_profiler_text **slot, unsigned size,
+					     uint32_t vmid, uint64_t addr, uint32_t tsize)
+{
+	unsigned x;
+
+	x = hash_key(vmid, addr, tsize) & (size - 1);
+	while (slot[x] && (slot[x]->vmid != vmid || slot[x]->addr != addr || slot[x]->size != tsize))
+		x = (x + 1) & (size - 1);
+	return &slot[x];
+}
+
+static struct umr_profiler_text *texts_find(struct umr_profiler_texts *texts, uint32_t vmid, uint64_t addr, uint32_t size)
+{
+	return texts->size ? *texts_slot(texts->slot, texts->size, vmid, addr, size) : NULL;
+}
+
+static int texts_add(struct umr_asic *asic, struct umr_profiler_texts *texts, struct umr_profiler_text *text)
+{
+	struct umr_profiler_text **slot;
+	unsigned x, size;
+
+	if (2 * (texts->n + 1) > texts->size) {
+		size = texts->size ? 2 * texts->size : 64;
+		slot = calloc(size, sizeof *slot);
+		if (!slot) {
+			asic->err_msg("[ERROR]: Out of memory\n");
+			return -1;
+		}
+		for (x = 0; x < texts->size; x++)
+			if (texts->slot[x])
+				*texts_slot(slot, size, texts->slot[x]->vmid, texts->slot[x]->addr, texts->slot[x]->size) = texts->slot[x];
+		free(texts->slot);
+		texts->slot = slot;
+		texts->size = size;
+	}
+	*texts_slot(texts->slot, texts->size, text->vmid, text->addr, text->size) = text;
+	++texts->n;
+	text->next = texts->head;
+	texts->head = text;
+	return 0;
+}
+
+// find the captured text of @shader or read it from VRAM and add it
+static struct umr_profiler_text *shader_text(struct umr_asic *asic, struct umr_profiler_texts *texts,
+					      struct umr_shaders_pgm *shader)
+{
+	struct umr_profiler_text *text;
+	void *data;
 
-	nmax = samples;
-	nitems = 0;
-	phit = calloc(nmax, sizeof *phit);
-	otext = texts = calloc(1, sizeof *texts);
+	text = texts_find(texts, shader->vmid, shader->addr, shader->size);
+	if (text)
+		return text;
 
-	if (!phit || !texts) {
-		free(phit);
-		free(texts);
+	data = calloc(1, shader->size);
+	text = calloc(1, sizeof *text);
+	if (!data || !text) {
 		asic->err_msg("[ERROR]: Out of memory\n");
-		return;
+		goto error;
+	}
+	if (umr_read_vram(asic, asic->options.vm_partition, shader->vmid, shader->addr, shader->size, data) < 0) {
+		fprintf(stderr, "[ERROR]: Could not read shader text at address 0x%"PRIx32":0x%llx\n", shader->vmid, (unsigned long long)shader->addr);
+		goto error;
+	}
+	text->vmid = shader->vmid;
+	text->size = shader->size;
+	text->addr = shader->addr;
+	text->type = shader->type;
+	text->text = data;
+	if (texts_add(asic, texts, text))
+		goto error;
+	return text;
+error:
+	free(data);
+	free(text);
+	return NULL;
+}
+
+// fill in the shader of a hit, @text is NULL if its text could not be read
+static void hit_shader(struct umr_profiler_hit *phit, uint64_t base_addr, uint32_t size,
+		       struct umr_profiler_text *text)
+{
+	// grab info about shader including the opcodes
+	// since the WAVE_STATUS INST_DWx registers might
+	// suffer from race conditions
+	phit->base_addr = base_addr;
+	phit->shader_size = size;
+	if (text && text->text) {
+		uint32_t *data = text->text;
+		phit->inst_dw0 = data[(phit->pc - text->addr) / 4];
+		phit->inst_dw1 = data[((phit->pc - text->addr) / 4) + 1];
 	}
+}
+
+/*
+ * profile_halted - Sample by halting every wave
+ *
+ * Each sample resumes and halts the waves, scans them and decodes the
+ * ring to find their shaders.
+ */
+static void profile_halted(struct umr_asic *asic, int samples, int shader_target, char *ringname,
+			   struct umr_profiler_hits *hits, struct umr_profiler_texts *texts)
+{
+	struct umr_profiler_hit hit;
+	struct umr_wave_data *owd, *wd;
+	struct umr_decode_session *sess;
+	struct umr_packet_stream *stream;
+	struct umr_shaders_pgm *shader;
+	int sample_hit, gprs;
 
-	ringname = asic->options.ring_name[0] ? asic->options.ring_name : "gfx";
 	gprs = asic->options.skip_gprs;
+	// the ring runs between samples so only the stream memory is reused
+	sess = umr_decode_session_create(asic, NULL, UMR_RING_GUESS, UMR_PACKET_IP_VERSION_AUTO, 0);
+	if (!sess) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return;
+	}
 
 	while (samples--) {
 		int start = -1, stop = -1;
@@ -132,237 +276,574 @@ void umr_profiler(struct umr_asic *asic, int samples, int shader_target)
 			wd = umr_scan_wave_data(asic);
 			asic->options.skip_gprs = gprs;
 		} while (!wd);
+		owd = wd;
 
 		// grab PM4 stream for these halted waves
 		// in theory if waves are halted the packet
 		// processor is also halted so we can grab the
 		// stream.  This isn't 100% though it seems so race
 		// conditions might occur.
-		stream = umr_packet_decode_ring(asic, NULL, ringname, 0, &start, &stop, UMR_RING_GUESS, NULL);
+		stream = umr_decode_session_ring(sess, ringname, 0, &start, &stop, NULL);
 
 		// loop through data ...
 		sample_hit = 0;
-		while (wd) {
-			uint32_t w_vmid;
-			uint64_t w_pc;
-
-			umr_wave_data_get_shader_pc_vmid(asic, wd, &w_vmid, &w_pc);
-			phit[nitems].vmid = w_vmid;
-			phit[nitems].pc = w_pc;
+		for (; wd; wd = wd->next) {
+			memset(&hit, 0, sizeof hit);
+			umr_wave_data_get_shader_pc_vmid(asic, wd, &hit.vmid, &hit.pc);
 
 			// try to find shader in PM4 stream
 			shader = NULL;
 			if (stream)
-				shader = umr_packet_find_shader(asic, stream, phit[nitems].vmid, phit[nitems].pc);
+				shader = umr_packet_find_shader(asic, stream, hit.vmid, hit.pc);
 			if (shader) {
-				struct umr_profiler_text *shader_text;
-
 				// toss out if shader doesn't match desired target
 				if (shader_target != -1 && shader_target != shader->type) {
 					free(shader);
-					goto throw_back;
-				}
-
-
-				// capture shader text, first see if we can find it
-				texts = otext;
-				shader_text = NULL;
-				while (texts) {
-					if (texts->vmid == shader->vmid &&
-						texts->size == shader->size &&
-						texts->addr == shader->addr) {
-							shader_text = texts;
-							break;
-						}
-					if (texts->next)
-						texts = texts->next;
-					else
-						break;
-				}
-
-				if (!shader_text) {
-					void *data = calloc(1, shader->size);
-					if (umr_read_vram(asic, asic->options.vm_partition, shader->vmid, shader->addr, shader->size, data) < 0) {
-						fprintf(stderr, "[ERROR]: Could not read shader text at address 0x%"PRIx32":0x%llx\n", shader->vmid, (unsigned long long)shader->addr);
-						free(data);
-					} else {
-						texts->next = calloc(1, sizeof *texts);
-						// only move to next if we're not adding the first shader
-						if (texts != otext)
-							texts = texts->next;
-						texts->vmid = shader->vmid;
-						texts->size = shader->size;
-						texts->addr = shader->addr;
-						texts->type = shader->type;
-						texts->text = data;
-						shader_text = texts;
-					}
+					continue;
 				}
 
-				// grab info about shader including the opcodes
-				// since the WAVE_STATUS INST_DWx registers might
-				// suffer from race conditions
-				phit[nitems].base_addr = shader->addr;
-				phit[nitems].shader_size = shader->size;
-				if (shader_text && shader_text->text) {
-					uint32_t *data = shader_text->text;
-					phit[nitems].inst_dw0 = data[(phit[nitems].pc - shader_text->addr) / 4];
-					phit[nitems].inst_dw1 = data[((phit[nitems].pc - shader_text->addr) / 4) + 1];
-				}
+				hit_shader(&hit, shader->addr, shader->size, shader_text(asic, texts, shader));
 
 				// shader is a copy of the shader data from the stream
 				free(shader);
-			} else {
-				phit[nitems].base_addr = 0;
-				phit[nitems].shader_size = 0;
-			}
-			++nitems;
-
-			// grow the hit array as needed by steps of 1000 entries
-			if (nitems == nmax) {
-				nmax += 1000;
-				ophit = realloc(phit, nmax * sizeof(*phit));
-				phit = ophit;
-				memset(&phit[nitems], 0, (nmax - nitems) * sizeof(phit[0]));
 			}
+			if (add_hit(asic, hits, &hit))
+				break;
 
 			sample_hit = 1;
-throw_back:
-			owd = wd->next;
-			free(wd);
-			wd = owd;
 		}
+		umr_free_wave_data(owd);
 
 		if (!sample_hit)
 			++samples;
 
-		if (stream)
-			umr_packet_free(stream);
+		umr_decode_session_release(sess, stream);
 	}
+	umr_decode_session_free(sess);
 
 	// we're done scanning so resume the waves
 	// at this point the jobs could in theory be terminated
 	// and the shaders unmapped which is why we captured
 	// them in the 'texts' list
 	umr_sq_cmd_halt_waves(asic, UMR_SQ_CMD_RESUME, 0);
-	signal(SIGINT, NULL);
+}
 
-	// sort all hits by address/size/etc so we can
-	// RLE compress them.  The compression tells us how often
-	// a particular 'hit' occurs.
-	qsort(phit, nitems, sizeof(*phit), comp_hits);
-	prle = calloc(nitems, sizeof *prle);
-	for (z = y = 0, x = 1; x < nitems; x++) {
-		if (memcmp(&phit[x], &phit[y], sizeof(*phit))) {
-			prle[z].data = phit[y];
-			prle[z++].cnt = x - y;
-			y = x;
-		}
+// shader lookups of the sampling profiler by vmid/PC
+#define PC_CACHE_SIZE 4096
+
+struct pc_cache_entry {
+	uint64_t pc;
+	uint32_t vmid;
+	int valid;
+	struct umr_profiler_text *text; // NULL if the PC is in no shader found so far
+};
+
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+// the captured shader @pc of @vmid is in, looked up in the texts, then the stream
+static struct umr_profiler_text *find_pc_text(struct umr_asic *asic, struct umr_profiler_texts *texts,
+					       struct umr_packet_stream *stream, uint32_t vmid, uint64_t pc)
+{
+	struct umr_profiler_text *text;
+	struct umr_shaders_pgm *shader;
+
+	for (text = texts->head; text; text = text->next)
+		if (text->vmid == vmid && pc >= text->addr && pc < text->addr + text->size)
+			return text;
+
+	if (!stream)
+		return NULL;
+	shader = umr_packet_find_shader(asic, stream, vmid, pc);
+	if (!shader)
+		return NULL;
+	text = shader_text(asic, texts, shader);
+	free(shader);
+	return text;
+}
+
+/*
+ * profile_sampled - Sample the PCs of running waves
+ *
+ * The waves are never halted, only the WAVE STATUS of busy slots is read
+ * (see umr_sample_wave_pcs()).  The ring is decoded once up front and
+ * again (at most once a second) when a PC is in no shader found so far.
+ * The shader of a PC is remembered so each PC is only looked up once
+ * per decode.  @rate is the number of sweeps per second, 0 sweeps as
+ * fast as possible.  With UMR_PROFILER_RATE_AUTO the sweeps follow a
+ * umr_sample_rate, every 100us while waves are resident backing off to
+ * every 10ms while there are none.
+ */
+static void profile_sampled(struct umr_asic *asic, int samples, int shader_target, int rate, char *ringname,
+			    struct umr_profiler_hits *hits, struct umr_profiler_texts *texts)
+{
+	struct umr_profiler_hit hit;
+	struct umr_wave_pc_sample *pcs;
+	struct pc_cache_entry *cache, *ce;
+	struct umr_decode_session *sess;
+	struct umr_packet_stream *stream;
+	struct umr_wave_data *wd;
+	struct umr_sample_rate sr;
+	uint64_t next, now, last_decode;
+	int npcs, max_pcs, start, stop, x, sample_hit;
+
+	max_pcs = asic->config.gfx.max_shader_engines * asic->config.gfx.max_sh_per_se *
+		  asic->config.gfx.max_cu_per_sh * 4 * 20;
+	pcs = calloc(max_pcs ? max_pcs : 1, sizeof *pcs);
+	cache = calloc(PC_CACHE_SIZE, sizeof *cache);
+	wd = calloc(1, sizeof *wd);
+	sess = umr_decode_session_create(asic, NULL, UMR_RING_GUESS, UMR_PACKET_IP_VERSION_AUTO, 0);
+	if (!pcs || !cache || !wd || !sess) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		goto out;
+	}
+	if (umr_wave_data_init(asic, wd) < 0) {
+		asic->err_msg("[BUG]: Unsupported ASIC IP version in umr_profiler()\n");
+		goto out;
 	}
 
-	// group RLE hits by what shader they belong to
-	shaders = calloc(z, sizeof(shaders[0]));
-	for (nshaders = x = 0; x < z; x++) {
-		found = 0;
-
-		// find a home for this RLE hit
-		for (y = 0; y < nshaders; y++) {
-			if (shaders[y].hits) {
-				if (shaders[y].hits[0].data.vmid == prle[x].data.vmid &&
-				    shaders[y].hits[0].data.base_addr == prle[x].data.base_addr &&
-				    shaders[y].hits[0].data.shader_size == prle[x].data.shader_size) {
-						// this is a match so append to end of list
-						shaders[y].hits[shaders[y].nhits++] = prle[x];
-						shaders[y].total_cnt += prle[x].cnt;
-						found = 1;
-						break; // don't need to compare any more
-					}
+	umr_sample_rate_init(&sr, 100000, 10000000, 10);
+	start = stop = -1;
+	stream = umr_decode_session_ring(sess, ringname, 0, &start, &stop, NULL);
+	last_decode = next = now_us();
+
+	while (samples > 0) {
+		npcs = umr_sample_wave_pcs(asic, wd, pcs, max_pcs);
+		if (npcs < 0)
+			break;
+
+		sample_hit = 0;
+		for (x = 0; x < npcs; x++) {
+			ce = &cache[((pcs[x].pc >> 2) ^ ((uint64_t)pcs[x].vmid << 20)) % PC_CACHE_SIZE];
+			if (!ce->valid || ce->pc != pcs[x].pc || ce->vmid != pcs[x].vmid) {
+				ce->text = find_pc_text(asic, texts, stream, pcs[x].vmid, pcs[x].pc);
+				if (!ce->text && now_us() - last_decode > 1000000) {
+					// the shader may be newer than the stream
+					umr_decode_session_release(sess, stream);
+					umr_vm_tlb_flush(asic);
+					start = stop = -1;
+					stream = umr_decode_session_ring(sess, ringname, 0, &start, &stop, NULL);
+					last_decode = now_us();
+					memset(cache, 0, PC_CACHE_SIZE * sizeof *cache);
+					ce->text = find_pc_text(asic, texts, stream, pcs[x].vmid, pcs[x].pc);
+				}
+				ce->pc = pcs[x].pc;
+				ce->vmid = pcs[x].vmid;
+				ce->valid = 1;
 			}
+
+			// toss out if shader doesn't match desired target
+			if (shader_target != -1 && (!ce->text || ce->text->type != shader_target))
+				continue;
+
+			memset(&hit, 0, sizeof hit);
+			hit.vmid = pcs[x].vmid;
+			hit.pc = pcs[x].pc;
+			if (ce->text)
+				hit_shader(&hit, ce->text->addr, ce->text->size, ce->text);
+			if (add_hit(asic, hits, &hit))
+				goto done;
+			sample_hit = 1;
+		}
+
+		if (sample_hit && !(--samples & 255)) {
+			fprintf(stderr, "%5u samples left\r", samples);
+			fflush(stderr);
+		}
+
+		if (rate == UMR_PROFILER_RATE_AUTO) {
+			next += umr_sample_rate_update(&sr, npcs ? 1.0 : 0.0) / 1000;
+			now = now_us();
+			if (next > now)
+				usleep(next - now);
+			else
+				next = now;
+		} else if (rate > 0) {
+			next += 1000000 / rate;
+			now = now_us();
+			if (next > now)
+				usleep(next - now);
+			else
+				next = now;
 		}
+	}
+done:
+	umr_decode_session_release(sess, stream);
+out:
+	umr_decode_session_free(sess);
+	free(wd);
+	free(cache);
+	free(pcs);
+}
+
+/*
+ * Export of the aggregated hits.
+ *
+ * The pprof profile is written as an uncompressed protobuf 'Profile'
+ * message.  Its repeated fields may come in any order so every string,
+ * function, location and sample is written as soon as it is known
+ * instead of building the whole message in memory.  Each hit PC is a
+ * location with two frames, the instruction and the shader it is in.
+ * The collapsed stack format is one "type;shader;instruction count"
+ * line per hit PC.
+ */
+struct umr_profiler_export {
+	int format;
+	FILE *f;
+	uint64_t nstrings, nfunctions, nlocations;
+
+	// string table indexes of the fixed strings
+	uint64_t str_type, str_vmid, str_shader_types[9];
+
+	// current shader
+	uint64_t shader_function, str_shader_type;
+	char shader_name[96];
+	const char *shader_type;
+};
+
+// protobuf wire types
+#define PB_VARINT 0
+#define PB_BYTES  2
+
+struct pb_buf {
+	uint8_t data[128];
+	unsigned len;
+};
+
+static void pb_varint(struct pb_buf *b, uint64_t v)
+{
+	while (v >= 0x80) {
+		b->data[b->len++] = (v & 0x7F) | 0x80;
+		v >>= 7;
+	}
+	b->data[b->len++] = v;
+}
+
+static void pb_field(struct pb_buf *b, unsigned field, uint64_t v)
+{
+	pb_varint(b, (field << 3) | PB_VARINT);
+	pb_varint(b, v);
+}
+
+static void pb_message(struct pb_buf *b, unsigned field, const struct pb_buf *msg)
+{
+	pb_varint(b, (field << 3) | PB_BYTES);
+	pb_varint(b, msg->len);
+	memcpy(&b->data[b->len], msg->data, msg->len);
+	b->len += msg->len;
+}
+
+// write a length delimited top level field of the Profile
+static void export_bytes(struct umr_profiler_export *ex, unsigned field, const void *data, unsigned len)
+{
+	struct pb_buf b = { .len = 0 };
+
+	pb_varint(&b, (field << 3) | PB_BYTES);
+	pb_varint(&b, len);
+	fwrite(b.data, 1, b.len, ex->f);
+	fwrite(data, 1, len, ex->f);
+}
+
+// append to the string table, returns the index of the string
+static uint64_t export_string(struct umr_profiler_export *ex, const char *str)
+{
+	export_bytes(ex, 6, str, strlen(str));
+	return ex->nstrings++;
+}
+
+static uint64_t export_function(struct umr_profiler_export *ex, const char *name)
+{
+	struct pb_buf fn = { .len = 0 };
+	uint64_t str;
+
+	str = export_string(ex, name);
+	pb_field(&fn, 1, ++ex->nfunctions);
+	pb_field(&fn, 2, str);
+	pb_field(&fn, 3, str);
+	export_bytes(ex, 5, fn.data, fn.len);
+	return ex->nfunctions;
+}
+
+static int export_open(struct umr_asic *asic, struct umr_profiler_export *ex, int format, const char *path)
+{
+	struct pb_buf b = { .len = 0 };
+	unsigned x;
+
+	memset(ex, 0, sizeof *ex);
+	ex->format = format;
+	if (format == UMR_PROFILER_EXPORT_NONE)
+		return 0;
+
+	ex->f = fopen(path, format == UMR_PROFILER_EXPORT_PPROF ? "wb" : "w");
+	if (!ex->f) {
+		asic->err_msg("[ERROR]: Could not open profiler export file '%s'\n", path);
+		return -1;
+	}
+
+	if (format == UMR_PROFILER_EXPORT_PPROF) {
+		// string 0 must be the empty string
+		export_string(ex, "");
+
+		// sample_type = { "samples", "count" }
+		pb_field(&b, 1, export_string(ex, "samples"));
+		pb_field(&b, 2, export_string(ex, "count"));
+		export_bytes(ex, 1, b.data, b.len);
+
+		ex->str_type = export_string(ex, "shader_type");
+		ex->str_vmid = export_string(ex, "vmid");
+		for (x = 0; x < 9; x++)
+			ex->str_shader_types[x] = export_string(ex, shader_names[x]);
+	}
+	return 0;
+}
+
+/* start the hits of a shader, @type is -1 if the shader is unknown */
+static void export_shader(struct umr_profiler_export *ex, uint32_t vmid, uint64_t base_addr, uint32_t size, int type)
+{
+	if (!ex->f)
+		return;
+
+	if (type < 0 || type > 7)
+		type = 8;
+	if (type == 8)
+		snprintf(ex->shader_name, sizeof ex->shader_name, "shader 0x%"PRIx32"@unknown", vmid);
+	else
+		snprintf(ex->shader_name, sizeof ex->shader_name, "shader 0x%"PRIx32"@0x%llx (%lu bytes)",
+			 vmid, (unsigned long long)base_addr, (unsigned long)size);
+	ex->shader_type = shader_names[type];
+
+	if (ex->format == UMR_PROFILER_EXPORT_PPROF) {
+		ex->shader_function = export_function(ex, ex->shader_name);
+		ex->str_shader_type = ex->str_shader_types[type];
+	}
+}
+
+/* add the @cnt hits at @pc of the current shader, @disasm may be NULL */
+static void export_pc(struct umr_profiler_export *ex, uint32_t vmid, uint64_t pc, uint64_t offset,
+		      const char *disasm, uint32_t cnt)
+{
+	struct pb_buf loc = { .len = 0 }, sample = { .len = 0 }, line, label;
+	char name[128], *p;
+	uint64_t fn;
+
+	if (!ex->f)
+		return;
+
+	if (disasm) {
+		snprintf(name, sizeof name, "0x%04llx: %s", (unsigned long long)offset, disasm);
+		// trailing padding of the disassembly
+		for (p = name + strlen(name); p > name && p[-1] == ' '; )
+			*--p = 0;
+	} else {
+		snprintf(name, sizeof name, "0x%llx", (unsigned long long)pc);
+	}
+
+	if (ex->format == UMR_PROFILER_EXPORT_COLLAPSED) {
+		// ';' separates the frames
+		for (p = name; *p; p++)
+			if (*p == ';')
+				*p = ':';
+		fprintf(ex->f, "%s;%s;%s %lu\n", ex->shader_type, ex->shader_name, name, (unsigned long)cnt);
+		return;
+	}
+
+	fn = export_function(ex, name);
+
+	// location = { id, address, line = { instruction }, line = { shader } }
+	pb_field(&loc, 1, ++ex->nlocations);
+	pb_field(&loc, 3, pc);
+	line.len = 0;
+	pb_field(&line, 1, fn);
+	pb_message(&loc, 4, &line);
+	line.len = 0;
+	pb_field(&line, 1, ex->shader_function);
+	pb_message(&loc, 4, &line);
+	export_bytes(ex, 4, loc.data, loc.len);
+
+	// sample = { location_id, value, label = { shader_type }, label = { vmid } }
+	pb_field(&sample, 1, ex->nlocations);
+	pb_field(&sample, 2, cnt);
+	label.len = 0;
+	pb_field(&label, 1, ex->str_type);
+	pb_field(&label, 2, ex->str_shader_type);
+	pb_message(&sample, 3, &label);
+	label.len = 0;
+	pb_field(&label, 1, ex->str_vmid);
+	pb_field(&label, 3, vmid);
+	pb_message(&sample, 3, &label);
+	export_bytes(ex, 2, sample.data, sample.len);
+}
+
+static void export_close(struct umr_profiler_export *ex)
+{
+	if (ex->f)
+		fclose(ex->f);
+	ex->f = NULL;
+}
 
-		if (!found) {
-			shaders[nshaders].hits = calloc(z, sizeof(shaders[nshaders].hits[0]));
-			shaders[nshaders].hits[shaders[nshaders].nhits++] = prle[x];
-			shaders[nshaders++].total_cnt = prle[x].cnt;
+/**
+ * umr_profiler - Profile the shaders running on the device
+ *
+ * @asic: The device to profile
+ * @samples: The number of samples with at least one hit to take
+ * @shader_target: Only count hits in shaders of this type (-1 for any)
+ * @rate: If >= 0 the waves are sampled while running at this many
+ *        samples per second (0 for as fast as possible, or
+ *        UMR_PROFILER_RATE_AUTO to follow the activity), otherwise
+ *        every sample halts the waves.
+ * @export_format: One of UMR_PROFILER_EXPORT_* to also write the hits to
+ * @export_path in that format.
+ *
+ * Hits are counted per PC as they come in so the memory used depends
+ * on the number of distinct PCs hit rather than on the number of samples.
+ */
+void umr_profiler(struct umr_asic *asic, int samples, int shader_target, int rate, int export_format, const char *export_path)
+{
+	struct umr_profiler_export ex;
+	struct umr_profiler_shaders *shaders, *group;
+	struct umr_profiler_text *text, *next;
+	struct umr_profiler_texts texts;
+	struct umr_profiler_hits hits;
+	struct umr_profiler_hit key;
+	struct umr_profiler_rle *rle;
+	unsigned nshaders, size, x, y, z;
+	uint32_t total_hits_by_type[8], total_hits;
+	char *ringname;
+
+	kill_asic = asic;
+	signal(SIGINT, &sigint_handler);
+
+	memset(&total_hits_by_type, 0, sizeof total_hits_by_type);
+	memset(&hits, 0, sizeof hits);
+	memset(&texts, 0, sizeof texts);
+	shaders = NULL;
+
+	if (export_open(asic, &ex, export_format, export_path))
+		return;
+
+	ringname = asic->options.ring_name[0] ? asic->options.ring_name : "gfx";
+
+	if (rate >= 0 || rate == UMR_PROFILER_RATE_AUTO)
+		profile_sampled(asic, samples, shader_target, rate, ringname, &hits, &texts);
+	else
+		profile_halted(asic, samples, shader_target, ringname, &hits, &texts);
+	signal(SIGINT, NULL);
+
+	// group the hits by what shader they belong to, the groups are
+	// indexed by (vmid, base_addr, size) while being built
+	for (size = 16; size < 2 * hits.n; size <<= 1);
+	shaders = calloc(size, sizeof(shaders[0]));
+	if (!shaders) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		goto out;
+	}
+	for (nshaders = x = 0; x < hits.size; x++) {
+		rle = &hits.slot[x];
+		if (!rle->cnt)
+			continue;
+		y = hash_key(rle->data.vmid, rle->data.base_addr, rle->data.shader_size) & (size - 1);
+		for (;;) {
+			group = &shaders[y];
+			if (!group->total_cnt) {
+				group->vmid = rle->data.vmid;
+				group->base_addr = rle->data.base_addr;
+				group->size = rle->data.shader_size;
+				++nshaders;
+				break;
+			}
+			if (group->vmid == rle->data.vmid && group->base_addr == rle->data.base_addr &&
+			    group->size == rle->data.shader_size)
+				break;
+			y = (y + 1) & (size - 1);
 		}
+		group->total_cnt += rle->cnt;
 	}
 
 	// sort shaders so the busiest are first
+	for (y = x = 0; x < size; x++)
+		if (shaders[x].total_cnt)
+			shaders[y++] = shaders[x];
 	qsort(shaders, nshaders, sizeof(shaders[0]), comp_shaders);
 	for (x = 0; x < nshaders; x++) {
 		uint32_t sum = 0;
-		if (shaders[x].hits) {
-			char **strs;
-			uint32_t *data;
-
-			// try to find shader
-			texts = otext;
-			while (texts) {
-				if (texts->vmid == shaders[x].hits[0].data.vmid &&
-					texts->size == shaders[x].hits[0].data.shader_size &&
-					texts->addr == shaders[x].hits[0].data.base_addr)
-					break;
-				texts = texts->next;
+		struct umr_disasm_block *strs;
+		uint32_t *data;
+
+		// shader not found so skip, only its PCs can be exported
+		text = texts_find(&texts, shaders[x].vmid, shaders[x].base_addr, shaders[x].size);
+		if (!text) {
+			if (ex.f) {
+				export_shader(&ex, shaders[x].vmid, shaders[x].base_addr, shaders[x].size, -1);
+				for (y = 0; y < hits.size; y++) {
+					rle = &hits.slot[y];
+					if (rle->cnt && rle->data.vmid == shaders[x].vmid &&
+					    rle->data.base_addr == shaders[x].base_addr &&
+					    rle->data.shader_size == shaders[x].size)
+						export_pc(&ex, rle->data.vmid, rle->data.pc, rle->data.pc, NULL, rle->cnt);
+				}
 			}
-
-			// shader not found so skip
-			if (!texts)
-				continue;
-
-			printf("\n\nShader 0x%"PRIx32"@0x%llx (%lu bytes, type: %s): total hits: %lu\n",
-				shaders[x].hits[0].data.vmid,
-				(unsigned long long)shaders[x].hits[0].data.base_addr,
-				(unsigned long)shaders[x].hits[0].data.shader_size,
-				shader_names[texts->type],
-				(unsigned long)shaders[x].total_cnt);
-
-			total_hits_by_type[texts->type] += shaders[x].total_cnt;
-
-			// disasm shader
-			strs = NULL;
-			data = texts->text;
-
-			if (data) {
-				umr_shader_disasm(asic, (uint8_t *)data, texts->size, 0xFFFFFFFF, &strs);
-
-				for (z = 0; z < shaders[x].hits[0].data.shader_size; z += 4) {
-					unsigned cnt=0, pct;
-
-					// find this offset in the hits so we know the hit count
-					for (y = 0; y < shaders[x].nhits; y++) {
-						if (shaders[x].hits[y].data.pc == (shaders[x].hits[0].data.base_addr + z)) {
-							cnt = shaders[x].hits[y].cnt;
-							break;
-						}
-					}
-
-					// compute percentage for this address and then
-					// colour code the line
-					pct = (1000 * cnt) / shaders[x].total_cnt;
-					if (pct >= 300)
-						printf(RED);
-					else if (pct >= 200)
-						printf(YELLOW);
-					else if (pct >= 100)
-						printf(GREEN);
-
-					printf("\tshader[0x%llx + 0x%04llx] = 0x%08lx %-60s ",
-						(unsigned long long)shaders[x].hits[0].data.base_addr,
-						(unsigned long long)z,
-						(unsigned long)data[z/4],
-						strs[z/4]);
-					free(strs[z/4]);
-
-					if (cnt)
-						printf("(%5u hits, %3u.%01u %%)", cnt, pct/10, pct%10);
-					sum += cnt;
-
-					printf("\n%s", RST);
+			continue;
+		}
+		export_shader(&ex, shaders[x].vmid, shaders[x].base_addr, shaders[x].size, text->type);
+
+		printf("\n\nShader 0x%"PRIx32"@0x%llx (%lu bytes, type: %s): total hits: %lu\n",
+			shaders[x].vmid,
+			(unsigned long long)shaders[x].base_addr,
+			(unsigned long)shaders[x].size,
+			shader_names[text->type],
+			(unsigned long)shaders[x].total_cnt);
+
+		total_hits_by_type[text->type] += shaders[x].total_cnt;
+
+		// disasm shader
+		strs = NULL;
+		data = text->text;
+
+		if (data) {
+			strs = umr_shader_disasm_block_cached(asic, shaders[x].vmid, data, text->size, 0xFFFFFFFF);
+
+			key.vmid = shaders[x].vmid;
+			key.base_addr = shaders[x].base_addr;
+			key.shader_size = shaders[x].size;
+			for (z = 0; z < shaders[x].size; z += 4) {
+				unsigned cnt, pct;
+
+				// find this offset in the hits so we know the hit count
+				key.pc = shaders[x].base_addr + z;
+				cnt = hits_slot(hits.slot, hits.size, &key)->cnt;
+
+				// compute percentage for this address and then
+				// colour code the line
+				pct = (1000 * cnt) / shaders[x].total_cnt;
+				if (pct >= 300)
+					printf(RED);
+				else if (pct >= 200)
+					printf(YELLOW);
+				else if (pct >= 100)
+					printf(GREEN);
+
+				printf("\tshader[0x%llx + 0x%04llx] = 0x%08lx %-60s ",
+					(unsigned long long)shaders[x].base_addr,
+					(unsigned long long)z,
+					(unsigned long)data[z/4],
+					umr_disasm_line(strs, z/4));
+
+				if (cnt) {
+					printf("(%5u hits, %3u.%01u %%)", cnt, pct/10, pct%10);
+					export_pc(&ex, key.vmid, key.pc, z, umr_disasm_line(strs, z/4), cnt);
 				}
-				if (sum != shaders[x].total_cnt)
-					printf("Sum mismatch: %lu != %lu\n", (unsigned long)sum, (unsigned long)shaders[x].total_cnt);
-				free(strs);
+				sum += cnt;
+
+				printf("\n%s", RST);
 			}
+			if (sum != shaders[x].total_cnt)
+				printf("Sum mismatch: %lu != %lu\n", (unsigned long)sum, (unsigned long)shaders[x].total_cnt);
+			free(strs);
 		}
 	}
 	total_hits = total_hits_by_type[0] + total_hits_by_type[1] +
@@ -382,17 +863,14 @@ throw_back:
 		printf("LS Shaders: %3u.%01u %%\n", ((1000 * total_hits_by_type[UMR_SHADER_LS]) / total_hits) / 10, ((1000 * total_hits_by_type[UMR_SHADER_LS]) / total_hits) % 10);
 	}
 
-	texts = otext;
-	while (texts) {
-		otext = texts->next;
-		free(texts->text);
-		free(texts);
-		texts = otext;
+out:
+	for (text = texts.head; text; text = next) {
+		next = text->next;
+		free(text->text);
+		free(text);
 	}
-
-	for (x = 0; x < nshaders; x++)
-		free(shaders[x].hits);
+	free(texts.slot);
 	free(shaders);
-	free(prle);
-	free(phit);
+	free(hits.slot);
+	export_close(&ex);
 }
@@ -24,55 +24,90 @@
  */
 #include "umrapp.h"
 
+/**
+ * umr_print_gpu_metrics - Print the GPU metrics table of a device
+ *
+ * @asic: The device
+ * @delay: If not zero read the table again every @delay milliseconds
+ *
+ * The file is kept open and read with pread(), the fields are only looked
+ * up again when the revision or size of the table changes.  With '-O
+ * metrics_changed' the reads after the first only print the fields that
+ * changed.
+ */
 int umr_print_gpu_metrics(struct umr_asic *asic, int delay)
 {
-	FILE *f;
-	uint8_t *pp_data;
-	uint32_t size;
-	char pp_name[128];
-	int r;
+	struct umr_metrics_layout *layout;
+	struct stat st;
+	uint64_t *values;
+	uint8_t *pp_data, *changed, *tmp;
+	size_t cap;
+	ssize_t size;
+	char pp_name[128], name[128];
+	int fd, r, x, all;
 
 	snprintf(pp_name, sizeof(pp_name), "/sys/class/drm/card%d/device/gpu_metrics", asic->instance);
-	f = fopen(pp_name, "rb");
-	if (!f) {
+	fd = open(pp_name, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
 		fprintf(stderr, "[ERROR]:  Cannot open gpu_metrics file %s\n", pp_name);
 		return -1;
 	}
-	fseek(f, 0, SEEK_END);
-	size = ftell(f);
-	fseek(f, 0, SEEK_SET);
-	pp_data = calloc(1, size);
-	if (!pp_data) {
+	cap = 4096;
+	if (!fstat(fd, &st) && st.st_size > (off_t)cap)
+		cap = st.st_size;
+	pp_data = malloc(cap);
+	layout = calloc(1, sizeof *layout);
+	values = calloc(UMR_MAX_KEYS, sizeof *values);
+	changed = calloc(UMR_MAX_KEYS, sizeof *changed);
+	if (!pp_data || !layout || !values || !changed) {
 		fprintf(stderr, "[ERROR]: Out of memory\n");
-		fclose(f);
-		return -1;
+		r = -1;
+		goto error;
 	}
 
 	r = 0;
 	do {
-		struct umr_key_value *kv;
-		int x;
-		if (fread(pp_data, 1, size, f) == size) {
-			kv = umr_dump_metrics(asic, pp_data, size);
-			if (!kv) {
+		// a full buffer means the table may be larger, grow it and retry
+		while ((size = pread(fd, pp_data, cap, 0)) == (ssize_t)cap) {
+			tmp = realloc(pp_data, cap * 2);
+			if (!tmp) {
+				fprintf(stderr, "[ERROR]: Out of memory\n");
 				r = -1;
 				goto error;
 			}
-			for (x = 0; x < kv->used; x++) {
-				asic->std_msg("%-30s: %s\n", kv->keys[x].name, kv->keys[x].value);
+			pp_data = tmp;
+			cap *= 2;
+		}
+		if (size > 0) {
+			all = 0;
+			if (umr_metrics_decode(layout, pp_data, size, values, changed) < 0) {
+				if (umr_metrics_resolve_layout(asic, pp_data, size, layout)) {
+					r = -1;
+					goto error;
+				}
+				memset(values, 0, UMR_MAX_KEYS * sizeof *values);
+				umr_metrics_decode(layout, pp_data, size, values, changed);
+				all = 1;
+			}
+			for (x = 0; x < layout->no_fields; x++) {
+				if (all || changed[x] || !asic->options.metrics_changed) {
+					snprintf(name, sizeof name, "%s%s", layout->fields[x].prefix, layout->fields[x].name);
+					asic->std_msg("%-30s: %" PRIu64 "\n", name, values[x]);
+				}
 			}
-			free(kv);
 		}
 		if (delay) {
 			usleep(abs(delay) * 1000UL);
-			fseek(f, 0, SEEK_SET);
 			if (delay > 0) {
 				delay = -delay;
 			}
 		}
 	} while (delay);
 error:
-	fclose(f);
+	close(fd);
 	free(pp_data);
+	free(layout);
+	free(values);
+	free(changed);
 	return r;
 }
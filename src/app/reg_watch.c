@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umrapp.h"
+
+#define REG_WATCH_MAX 32
+
+static uint64_t watch_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// 'ip.reg' or 'reg'
+static struct umr_reg *watch_find_reg(struct umr_asic *asic, char *name)
+{
+	struct umr_reg *reg;
+	char *dot = strchr(name, '.');
+
+	if (dot) {
+		*dot = 0;
+		reg = umr_find_reg_data_by_ip(asic, name, dot + 1);
+		*dot = '.';
+	} else {
+		reg = umr_find_reg_by_name(asic, name, NULL);
+	}
+	if (!reg)
+		asic->err_msg("[ERROR]: Register '%s' not found\n", name);
+	return reg;
+}
+
+// add @reg to @regs unless already there, returns its index
+static int watch_add_reg(struct umr_reg **regs, int *no_regs, struct umr_reg *reg)
+{
+	int i;
+
+	for (i = 0; i < *no_regs; i++)
+		if (regs[i] == reg)
+			return i;
+	regs[(*no_regs)++] = reg;
+	return i;
+}
+
+// reg[:mask]=value[/rise|/fall|/change|/level][/stop]
+static int parse_trigger(struct umr_asic *asic, char *spec, struct umr_reg_watch_config *cfg, struct umr_reg_watch_trigger *t)
+{
+	struct umr_reg *reg;
+	char *eq, *colon, *opt;
+
+	memset(t, 0, sizeof *t);
+	t->mask = ~0ULL;
+	t->edge = UMR_REG_WATCH_RISING;
+
+	opt = strchr(spec, '/');
+	if (opt)
+		*opt++ = 0;
+	eq = strchr(spec, '=');
+	if (!eq) {
+		asic->err_msg("[ERROR]: Trigger '%s' has no '=value'\n", spec);
+		return -1;
+	}
+	*eq = 0;
+	colon = strchr(spec, ':');
+	if (colon) {
+		*colon = 0;
+		t->mask = strtoull(colon + 1, NULL, 0);
+	}
+	t->match = strtoull(eq + 1, NULL, 0) & t->mask;
+
+	while (opt) {
+		char *next = strchr(opt, '/');
+
+		if (next)
+			*next++ = 0;
+		if (!strcmp(opt, "rise"))
+			t->edge = UMR_REG_WATCH_RISING;
+		else if (!strcmp(opt, "fall"))
+			t->edge = UMR_REG_WATCH_FALLING;
+		else if (!strcmp(opt, "change"))
+			t->edge = UMR_REG_WATCH_CHANGE;
+		else if (!strcmp(opt, "level"))
+			t->edge = UMR_REG_WATCH_LEVEL;
+		else if (!strcmp(opt, "stop"))
+			t->stop = 1;
+		else {
+			asic->err_msg("[ERROR]: Unknown trigger option '%s'\n", opt);
+			return -1;
+		}
+		opt = next;
+	}
+
+	reg = watch_find_reg(asic, spec);
+	if (!reg)
+		return -1;
+	t->reg = watch_add_reg(cfg->regs, &cfg->no_regs, reg);
+	return 0;
+}
+
+static void print_hit(FILE *out, struct umr_reg_watch_config *cfg, const struct umr_reg_watch_hit *h, uint64_t start)
+{
+	struct umr_wave_data *wd;
+	int i, n;
+
+	fprintf(out, "+%" PRIu64 " us  poll %" PRIu64 "  trigger %d (%s)  captured in %" PRIu64 " ns\n",
+		(h->time_ns - start) / 1000, h->poll, h->trigger, cfg->regs[cfg->triggers[h->trigger].reg]->regname,
+		h->capture_ns);
+	if (h->gpu_ns)
+		fprintf(out, "    gpu time %" PRIu64 ".%09" PRIu64 "\n", h->gpu_ns / 1000000000, h->gpu_ns % 1000000000);
+	for (i = 0; i < cfg->no_regs; i++)
+		fprintf(out, "    %s = 0x%" PRIx64 "\n", cfg->regs[i]->regname, h->values[i]);
+	for (i = 0; i < cfg->no_snap_regs; i++)
+		fprintf(out, "    %s = 0x%" PRIx64 "\n", cfg->snap_regs[i]->regname, h->snap_values[i]);
+	for (i = 0; i < cfg->no_rings; i++)
+		fprintf(out, "    %s: rptr 0x%" PRIx32 "  wptr 0x%" PRIx32 "  dwptr 0x%" PRIx32 "\n",
+			cfg->rings[i], h->ring_ptrs[i][0], h->ring_ptrs[i][1], h->ring_ptrs[i][2]);
+	if (cfg->waves) {
+		for (n = 0, wd = h->waves; wd; wd = wd->next)
+			++n;
+		fprintf(out, "    %d waves\n", n);
+		for (wd = h->waves; wd; wd = wd->next)
+			fprintf(out, "        se%d.sh%d.cu%d.simd%d.wave%d\n", wd->se, wd->sh, wd->cu, wd->simd, wd->wave);
+	}
+}
+
+static void jsonl_hit(struct umr_reg_watch_config *cfg, const struct umr_reg_watch_hit *h, uint64_t start)
+{
+	struct umr_wave_data *wd;
+	char key[96];
+	int i, n;
+
+	umr_jsonl_begin("reg_watch_hit");
+	umr_jsonl_u64("time_us", (h->time_ns - start) / 1000);
+	umr_jsonl_u64("poll", h->poll);
+	umr_jsonl_str("trigger", cfg->regs[cfg->triggers[h->trigger].reg]->regname);
+	umr_jsonl_u64("capture_ns", h->capture_ns);
+	if (h->gpu_ns)
+		umr_jsonl_u64("gpu_ns", h->gpu_ns);
+	for (i = 0; i < cfg->no_regs; i++)
+		umr_jsonl_hex(cfg->regs[i]->regname, h->values[i]);
+	for (i = 0; i < cfg->no_snap_regs; i++)
+		umr_jsonl_hex(cfg->snap_regs[i]->regname, h->snap_values[i]);
+	for (i = 0; i < cfg->no_rings; i++) {
+		snprintf(key, sizeof key, "%s.rptr", cfg->rings[i]);
+		umr_jsonl_hex(key, h->ring_ptrs[i][0]);
+		snprintf(key, sizeof key, "%s.wptr", cfg->rings[i]);
+		umr_jsonl_hex(key, h->ring_ptrs[i][1]);
+	}
+	if (cfg->waves) {
+		for (n = 0, wd = h->waves; wd; wd = wd->next)
+			++n;
+		umr_jsonl_int("waves", n);
+	}
+	umr_jsonl_end();
+}
+
+/**
+ * umr_reg_watch_print - Watch registers for trigger conditions and print the hits
+ *
+ * @asic: The device to watch
+ * @triggers: Comma separated triggers, reg[:mask]=value[/rise|/fall|/change|/level][/stop]
+ * @captures: Comma separated registers, 'ring:<name>' or 'waves' to capture
+ *            on every hit, or '-' for none
+ * @ms: How long to watch for
+ *
+ * The registers are polled back to back, the hits kept in the ring buffer
+ * are printed once the watch is done.
+ */
+int umr_reg_watch_print(struct umr_asic *asic, char *triggers, char *captures, unsigned ms)
+{
+	struct umr_reg *regs[REG_WATCH_MAX], *snap_regs[REG_WATCH_MAX], *reg;
+	struct umr_reg_watch_trigger trig[REG_WATCH_MAX];
+	struct umr_reg_watch_config cfg;
+	struct umr_reg_watch *w;
+	const struct umr_reg_watch_hit *h;
+	char *rings[REG_WATCH_MAX], *tlist, *clist, *p, *save;
+	uint64_t polls, hits, start, elapsed;
+	int i, r = -1;
+	FILE *out;
+
+	memset(&cfg, 0, sizeof cfg);
+	cfg.regs = regs;
+	cfg.triggers = trig;
+	cfg.snap_regs = snap_regs;
+	cfg.rings = rings;
+	cfg.period_ns = (uint64_t)ms * 1000000ULL;
+	cfg.capacity = 256;
+
+	tlist = strdup(triggers);
+	clist = strdup(captures);
+	if (!tlist || !clist) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		goto out;
+	}
+	for (p = strtok_r(tlist, ",", &save); p && cfg.no_triggers < REG_WATCH_MAX; p = strtok_r(NULL, ",", &save))
+		if (parse_trigger(asic, p, &cfg, &trig[cfg.no_triggers++]))
+			goto out;
+	if (strcmp(clist, "-"))
+		for (p = strtok_r(clist, ",", &save); p; p = strtok_r(NULL, ",", &save)) {
+			if (!strcmp(p, "waves")) {
+				cfg.waves = 1;
+			} else if (!memcmp(p, "ring:", 5)) {
+				if (cfg.no_rings < REG_WATCH_MAX)
+					rings[cfg.no_rings++] = p + 5;
+			} else {
+				reg = watch_find_reg(asic, p);
+				if (!reg)
+					goto out;
+				if (cfg.no_snap_regs < REG_WATCH_MAX)
+					watch_add_reg(snap_regs, &cfg.no_snap_regs, reg);
+			}
+		}
+
+	start = watch_now_ns();
+	w = umr_reg_watch_start(asic, &cfg);
+	if (!w)
+		goto out;
+	umr_reg_watch_wait(w);
+	elapsed = watch_now_ns() - start;
+	umr_reg_watch_status(w, &polls, &hits);
+
+	out = umr_output_begin(asic);
+	if (!asic->options.jsonl)
+		fprintf(out, "%" PRIu64 " polls in %" PRIu64 " us (%.1f ns/poll), %" PRIu64 " hits%s\n",
+			polls, elapsed / 1000, polls ? (double)elapsed / polls : 0.0, hits,
+			hits > (uint64_t)cfg.capacity ? " (only the last ones are kept)" : "");
+	for (i = 0; (h = umr_reg_watch_get(w, i)); i++) {
+		if (asic->options.jsonl)
+			jsonl_hit(&cfg, h, start);
+		else
+			print_hit(out, &cfg, h, start);
+	}
+	umr_output_end(asic);
+	umr_reg_watch_free(w);
+	r = 0;
+out:
+	free(tlist);
+	free(clist);
+	return r;
+}
@@ -24,6 +24,7 @@
  */
 #include "umrapp.h"
 #include <inttypes.h>
+#include <signal.h>
 
 /* NOTE: This stream based presentation will eventually replace the existing
  * umr_read_ring() --ring, -R code since having duplicate opcode decoding is
@@ -36,18 +37,56 @@ struct ui_data {
 		const uint32_t *rawdata;
 		uint32_t off;
 		FILE *f;
+		int level;
 	} stack[32];
 	int sp, no, tainted;
 	struct umr_asic *asic;
+
+	// text of every IB in the order they were started, printed once the decode is done
+	// (each level is allocated on its own, its memstream points into it)
+	struct {
+		char *buf;
+		size_t size;
+		FILE *f;
+	} **levels;
+	int max_levels;
+	FILE *out;
+
+	int jsonl_open;             // a --jsonl packet record is still open
 };
 
 static void next_level(struct umr_stream_decode_ui *ui)
 {
 	struct ui_data *data = ui->data;
-	char tmpname[64];
-	sprintf(tmpname, "/tmp/umr_ring_out.%d", (data->no)++);
+	void *t;
+	int no = data->no;
+
+	if (data->no == data->max_levels) {
+		t = realloc(data->levels, (data->max_levels + 16) * sizeof data->levels[0]);
+		if (!t) {
+			fprintf(stderr, "[ERROR]: Out of memory\n");
+			exit(EXIT_FAILURE);
+		}
+		data->levels = t;
+		data->max_levels += 16;
+	}
+	data->levels[no] = calloc(1, sizeof *data->levels[no]);
+	if (!data->levels[no]) {
+		fprintf(stderr, "[ERROR]: Out of memory\n");
+		exit(EXIT_FAILURE);
+	}
+	data->levels[no]->f = open_memstream(&data->levels[no]->buf, &data->levels[no]->size);
 	++(data->sp);
-	data->stack[data->sp].f = fopen(tmpname, "w");
+	data->stack[data->sp].f = data->levels[no]->f;
+	data->stack[data->sp].level = (data->no)++;
+}
+
+// finish the innermost level, present_stream() closes whatever is left open
+static void close_level(struct ui_data *data)
+{
+	fclose(data->stack[data->sp].f);
+	data->levels[data->stack[data->sp].level]->f = NULL;
+	--(data->sp);
 }
 
 static void start_ib(struct umr_stream_decode_ui *ui, uint64_t ib_addr, uint32_t ib_vmid, uint64_t from_addr, uint32_t from_vmid, uint32_t size, int type)
@@ -222,8 +261,7 @@ static void add_shader(struct umr_stream_decode_ui *ui, struct umr_asic *asic, u
 						int k;
 						for (k = 0; k < reg->no_bits; k++) {
 							uint32_t v;
-							v = (1UL << (reg->bits[k].stop + 1 - reg->bits[k].start)) - 1;
-							v &= (regs->value >> reg->bits[k].start);
+							v = (regs->value >> reg->bits[k].start) & umr_bitfield_mask(&reg->bits[k]);
 							fprintf(data->stack[data->sp].f, "\t\t%s[%u:%u] == 0x%"PRIx32"\n",
 								reg->bits[k].regname, reg->bits[k].start, reg->bits[k].stop, v);
 						}
@@ -242,8 +280,7 @@ static void add_shader(struct umr_stream_decode_ui *ui, struct umr_asic *asic, u
 	}
 	free(str);
 	fprintf(data->stack[data->sp].f, "Done disassembly of shader\n\n");
-	fclose(data->stack[data->sp].f);
-	--(data->sp);
+	close_level(data);
 }
 
 static void add_vcn(struct umr_stream_decode_ui *ui, struct umr_asic *asic, struct umr_vcn_cmd_message *vcn)
@@ -265,14 +302,12 @@ static void add_vcn(struct umr_stream_decode_ui *ui, struct umr_asic *asic, stru
 		vcn = vcn->next;
 		free(p);
 	}
-	fclose(data->stack[data->sp].f);
-	--(data->sp);
+	close_level(data);
 }
 
 static void add_data(struct umr_stream_decode_ui *ui, struct umr_asic *asic, uint64_t ib_addr, uint32_t ib_vmid, uint64_t buf_addr, uint32_t buf_vmid, enum UMR_DATABLOCK_ENUM type, uint64_t etype)
 {
 	struct ui_data *data = ui->data;
-	char **txt;
 
 	// don't fetch data blocks if no_follow is enabled
 	if (asic->options.no_follow_ib)
@@ -307,19 +342,22 @@ static void add_data(struct umr_stream_decode_ui *ui, struct umr_asic *asic, uin
 				eng = UMR_MQD_ENGINE_INVALID; break;
 		}
 		if (!umr_read_vram(asic, asic->options.vm_partition, buf_vmid, buf_addr, 512 * 4, &mqd[0])) {
-			txt = umr_mqd_decode_data(eng, asic->family, mqd, "*");
-			if (txt) {
-				for (x = 0; txt[x]; x++) {
-					fprintf(data->stack[data->sp].f, "\t%s\n", txt[x]);
-					free(txt[x]);
+			struct umr_mqd_filter filt;
+			struct umr_mqd_field field;
+			char line[256];
+
+			x = 0;
+			if (!umr_mqd_filter_init(&filt, eng, asic->family, "*")) {
+				while (umr_mqd_field_next(&filt, mqd, 512, NULL, &x, &field)) {
+					umr_mqd_field_format(&field, line, sizeof line);
+					fprintf(data->stack[data->sp].f, "\t%s\n", line);
 				}
-				free(txt);
 			}
+			umr_mqd_filter_free(&filt);
 		}
 		fprintf(data->stack[data->sp].f, "Done output of block\n\n");
 	}
-	fclose(data->stack[data->sp].f);
-	--(data->sp);
+	close_level(data);
 }
 
 
@@ -363,94 +401,155 @@ static void done(struct umr_stream_decode_ui *ui)
 {
 	struct ui_data *data = ui->data;
 	fprintf(data->stack[data->sp].f, "\nDone decoding IB\n\n");
-	fclose(data->stack[data->sp].f);
-	--(data->sp);
+	close_level(data);
 }
 
 static struct umr_stream_decode_ui umr_ui = { UMR_RING_UNK, start_ib, NULL, start_opcode, add_field, add_shader, add_vcn, add_data, unhandled, unhandled_size, unhandled_subop, taint, done, NULL };
 
-static uint32_t *read_ib_file(struct umr_asic *asic, char *filename, uint32_t *nwords)
+/*
+ * With --jsonl every IB and packet is a JSON line instead.  The fields of
+ * a packet arrive after it started so its record is finished when the
+ * next IB or packet starts or the IB is done.
+ */
+static void jsonl_finish_packet(struct ui_data *data)
 {
-	FILE *infile;
-	char buf[128];
-	uint32_t  *data, x;
-
-	infile = fopen(filename, "rb");
-	if (!infile) {
-		asic->err_msg("Cannot open IB file");
-		return NULL;
+	if (data->jsonl_open) {
+		umr_jsonl_end();
+		data->jsonl_open = 0;
 	}
+}
 
-	if (strstr(filename, ".ring")) {
-		uint32_t size;
-		fseek(infile, 0, SEEK_END);
-		size = ftell(infile) - 12;
-		fseek(infile, 12, SEEK_SET);
-		data = calloc(1, size);
-		if (fread(data, 1, size, infile) != size) {
-			free(data);
-			fclose(infile);
-			return NULL;
-		}
-		*nwords = size / 4;
-		fclose(infile);
-		return data;
-	}
+static void jsonl_start_ib(struct umr_stream_decode_ui *ui, uint64_t ib_addr, uint32_t ib_vmid, uint64_t from_addr, uint32_t from_vmid, uint32_t size, int type)
+{
+	struct ui_data *data = ui->data;
 
-	if (strstr(filename, ".bin")) {
-		uint32_t size;
-		fseek(infile, 0, SEEK_END);
-		size = ftell(infile) ;
-		fseek(infile, 0, SEEK_SET);
-		data = calloc(1, size);
-		if (fread(data, 1, size, infile) != size) {
-			free(data);
-			fclose(infile);
-			return NULL;
-		}
-		*nwords = size / 4;
-		fclose(infile);
-		return data;
-	}
+	jsonl_finish_packet(data);
+	umr_jsonl_begin("ib");
+	umr_jsonl_u64("vmid", ib_vmid);
+	umr_jsonl_hex("addr", ib_addr);
+	umr_jsonl_u64("from_vmid", from_vmid);
+	umr_jsonl_hex("from_addr", from_addr);
+	umr_jsonl_u64("size", size);
+	umr_jsonl_int("ib_type", type);
+	umr_jsonl_end();
+}
 
-	data = calloc(1024, sizeof(*data));
-	if (!data) {
-		fclose(infile);
-		asic->err_msg("[ERROR]: Out of memory\n");
-		return NULL;
-	}
+static void jsonl_start_opcode(struct umr_stream_decode_ui *ui, uint64_t ib_addr, uint32_t ib_vmid, int pkttype, uint32_t opcode, uint32_t subop, uint32_t nwords, const char *opcode_name, uint32_t header, const uint32_t* raw_data)
+{
+	struct ui_data *data = ui->data;
+	(void)raw_data;
 
+	jsonl_finish_packet(data);
+	umr_jsonl_begin("packet");
+	umr_jsonl_u64("vmid", ib_vmid);
+	umr_jsonl_hex("addr", ib_addr);
+	umr_jsonl_str("name", opcode_name);
+	umr_jsonl_u64("opcode", opcode);
+	if (ui->rt == UMR_RING_SDMA)
+		umr_jsonl_u64("subop", subop);
+	umr_jsonl_int("pkttype", pkttype);
+	umr_jsonl_hex("header", header);
+	umr_jsonl_u64("words", nwords);
+	if (data->tainted)
+		umr_jsonl_bool("tainted", 1);
+	umr_jsonl_object("fields", 1);
+	data->jsonl_open = 1;
+}
 
-	x = 0;
-	while (fgets(buf, sizeof(buf)-1, infile) != NULL) {
-		// skip any line that isn't just a hex value
-		if (sscanf(buf, "%"SCNx32, &data[x]) == 1) {
-			++x;
-			if (!(x & 1023)) {
-				void *tmp = realloc(data, sizeof(*data) * (x + 1024));
-				if (tmp) {
-					data = tmp;
-				} else {
-					asic->err_msg("[ERROR]: Out of memory\n");
-					free(data);
-					fclose(infile);
-					return NULL;
-				}
-			}
-		}
+static void jsonl_add_field(struct umr_stream_decode_ui *ui, uint64_t ib_addr, uint32_t ib_vmid, const char *field_name, uint64_t value, char *str, int ideal_radix, int field_size)
+{
+	struct ui_data *data = ui->data;
+	(void)ib_vmid;
+	(void)field_size;
+
+	if (!data->jsonl_open)
+		return;
+	umr_jsonl_object(NULL, 0);
+	umr_jsonl_hex("addr", ib_addr);
+	umr_jsonl_str("name", field_name);
+	if (str)
+		umr_jsonl_str("str", str);
+	if (!str || ideal_radix == 10 || ideal_radix == 16)
+		umr_jsonl_u64("value", value);
+	umr_jsonl_close();
+}
+
+static void jsonl_add_shader(struct umr_stream_decode_ui *ui, struct umr_asic *asic, uint64_t ib_addr, uint32_t ib_vmid, struct umr_shaders_pgm *shader)
+{
+	struct ui_data *data = ui->data;
+	(void)asic;
+	(void)ib_vmid;
+
+	if (!data->jsonl_open)
+		return;
+	umr_jsonl_object(NULL, 0);
+	umr_jsonl_hex("addr", ib_addr);
+	umr_jsonl_str("name", "shader");
+	umr_jsonl_u64("shader_vmid", shader->vmid);
+	umr_jsonl_hex("shader_addr", shader->addr);
+	umr_jsonl_u64("shader_size", shader->size);
+	umr_jsonl_int("shader_type", shader->type);
+	umr_jsonl_close();
+}
+
+// data blocks are not followed in JSON Lines output
+static void jsonl_add_data(struct umr_stream_decode_ui *ui, struct umr_asic *asic, uint64_t ib_addr, uint32_t ib_vmid, uint64_t buf_addr, uint32_t buf_vmid, enum UMR_DATABLOCK_ENUM type, uint64_t etype)
+{
+	(void)ui;
+	(void)asic;
+	(void)ib_addr;
+	(void)ib_vmid;
+	(void)buf_addr;
+	(void)buf_vmid;
+	(void)type;
+	(void)etype;
+}
+
+static void jsonl_done(struct umr_stream_decode_ui *ui)
+{
+	jsonl_finish_packet(ui->data);
+}
+
+static struct umr_stream_decode_ui jsonl_ui = { UMR_RING_UNK, jsonl_start_ib, NULL, jsonl_start_opcode, jsonl_add_field, jsonl_add_shader, NULL, jsonl_add_data, unhandled, unhandled_size, unhandled_subop, taint, jsonl_done, NULL };
+
+/* disassemble a decoded stream through the ui callbacks and print it */
+static void present_stream(struct umr_asic *asic, struct ui_data *data, struct umr_packet_stream *str, uint64_t addr, uint32_t vmid)
+{
+	int x;
+
+	switch (str->type) {
+		case UMR_RING_PM4:
+		case UMR_RING_PM4_LITE:
+		case UMR_RING_SDMA:
+		case UMR_RING_MES:
+		case UMR_RING_VPE:
+		case UMR_RING_UMSCH:
+		case UMR_RING_HSA:
+		case UMR_RING_VCN_ENC:
+		case UMR_RING_VCN_DEC:
+			umr_packet_disassemble_stream(str, addr, vmid, 0, 0, ~0UL, 1, 0);
+			jsonl_finish_packet(data);
+			break;
+		case UMR_RING_GUESS:
+		case UMR_RING_UNK:
+			asic->err_msg("[BUG]: Unknown ring type passed to ring stream present()\n");
+			break;
+	}
+
+	for (x = 0; x < data->no; x++) {
+		// an IB the decoder gave up on is never done()
+		if (data->levels[x]->f)
+			fclose(data->levels[x]->f);
+		fwrite(data->levels[x]->buf, 1, data->levels[x]->size, data->out);
+		free(data->levels[x]->buf);
+		free(data->levels[x]);
 	}
-	fclose(infile);
-	*nwords = x;
-	return data;
 }
 
-void umr_ring_stream_present(struct umr_asic *asic, char *ringname, int start, int end, uint32_t vmid, uint64_t addr, uint32_t *words, uint32_t nwords, enum umr_ring_type rt)
+static void ring_stream_present(struct umr_asic *asic, char *ringname, int start, int end, uint32_t vmid, uint64_t addr, uint32_t *words, uint32_t nwords, enum umr_ring_type rt, FILE *out)
 {
 	struct umr_packet_stream *str = NULL;
 	struct umr_stream_decode_ui ui;
-	int x;
-	char tmpname[64], buf[256];
-	FILE *f;
 	struct ui_data *data;
 	int is_uq = 0; // TODO: right now we're doing a bit of hack where we treat non uq "rings" differently, it would be nice to unify these all properly
 
@@ -458,11 +557,12 @@ void umr_ring_stream_present(struct umr_asic *asic, char *ringname, int start, i
 		return;
 
 	// print decode str
-	ui = umr_ui;
+	ui = asic->options.jsonl ? jsonl_ui : umr_ui;
 	ui.rt = rt;
 	data = ui.data = calloc(1, sizeof(struct ui_data));
 	data->sp = -1;
 	data->asic = asic;
+	data->out = out;
 
 	switch (rt) {
 		case UMR_RING_PM4:
@@ -500,61 +600,71 @@ void umr_ring_stream_present(struct umr_asic *asic, char *ringname, int start, i
 	}
 
 	if (str) {
-		switch (str->type) {
-			case UMR_RING_PM4:
-			case UMR_RING_PM4_LITE:
-			case UMR_RING_SDMA:
-			case UMR_RING_MES:
-			case UMR_RING_VPE:
-			case UMR_RING_UMSCH:
-			case UMR_RING_HSA:
-			case UMR_RING_VCN_ENC:
-			case UMR_RING_VCN_DEC:
-				umr_packet_disassemble_stream(str, (ringname && !is_uq) ? (uint64_t)(start * 4) : addr, vmid, 0, 0, ~0UL, 1, 0);
-				break;
-			case UMR_RING_GUESS:
-			case UMR_RING_UNK:
-				asic->err_msg("[BUG]: Unknown ring type passed to ring stream present()\n");
-				break;
-		}
+		present_stream(asic, data, str, (ringname && !is_uq) ? (uint64_t)(start * 4) : addr, vmid);
+		umr_packet_free(str);
+	}
+	free(data->levels);
+	free(ui.data);
+}
 
-		for (x = 0; x < data->no; x++) {
-			sprintf(tmpname, "/tmp/umr_ring_out.%d", x);
-			f = fopen(tmpname, "r");
-			while (fgets(buf, sizeof buf, f)) {
-				printf("%s", buf);
-			}
-			fclose(f);
-			remove(tmpname);
-		}
+// each run of packets of an IB file is printed as soon as it is decoded
+static void present_feed(struct umr_packet_stream *str, uint64_t addr, uint32_t vmid, void *ptr)
+{
+	struct ui_data *data = ptr;
 
-		switch (str->type) {
-			case UMR_RING_PM4:
-			case UMR_RING_PM4_LITE:
-			case UMR_RING_SDMA:
-			case UMR_RING_MES:
-			case UMR_RING_VPE:
-			case UMR_RING_UMSCH:
-			case UMR_RING_HSA:
-			case UMR_RING_VCN_ENC:
-			case UMR_RING_VCN_DEC:
-				umr_packet_free(str);
-				break;
-			case UMR_RING_GUESS:
-			case UMR_RING_UNK:
-				asic->err_msg("[BUG]: Unknown ring type passed to ring stream present()\n");
-				break;
-		}
+	data->sp = -1;
+	data->no = 0;
+	data->tainted = 0;
+	present_stream(data->asic, data, str, addr, vmid);
+}
+
+// an IB file is streamed through a feed rather than read whole
+static void ring_stream_file(struct umr_asic *asic, char *fname, enum umr_ring_type rt, FILE *out)
+{
+	struct umr_packet_feed *feed;
+	struct umr_stream_decode_ui ui;
+	struct ui_data *data;
 
+	ui = asic->options.jsonl ? jsonl_ui : umr_ui;
+	ui.rt = rt;
+	data = ui.data = calloc(1, sizeof(struct ui_data));
+	if (!data) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return;
 	}
-	free(ui.data);
+	data->sp = -1;
+	data->asic = asic;
+	data->out = out;
+
+	feed = umr_packet_feed_create(asic, &ui, rt, UMR_PACKET_IP_VERSION_AUTO, 0, 0, present_feed, data);
+	if (feed) {
+		umr_packet_feed_file(feed, fname);
+		umr_packet_feed_free(feed);
+	}
+	free(data->levels);
+	free(data);
 }
 
-void umr_read_ring_stream(struct umr_asic *asic, char *ringpath)
+void umr_ring_stream_present(struct umr_asic *asic, char *ringname, int start, int end, uint32_t vmid, uint64_t addr, uint32_t *words, uint32_t nwords, enum umr_ring_type rt)
+{
+	ring_stream_present(asic, ringname, start, end, vmid, addr, words, nwords, rt, umr_output_begin(asic));
+	umr_output_end(asic);
+}
+
+/**
+ * umr_read_ring_stream_to - Decode a ring or IB and write the text to a stream
+ * @asic: The ASIC to read from
+ * @ringpath: The ring, VM buffer or IB file as given to --ring-stream
+ * @out: Where to write the decode
+ *
+ * Nothing is written anywhere else so several decodes can run at once
+ * on different ASICs.
+ */
+void umr_read_ring_stream_to(struct umr_asic *asic, char *ringpath, FILE *out)
 {
 	char ringname[32], from[32], to[32], fname[128];
 	int  enable_decoder, start, end, ring_or_file = 0;
-	uint32_t vmid = 0, nwords, *words = NULL;
+	uint32_t vmid = 0, nwords;
 	uint64_t addr = 0;
 	int rts[] = {
 		UMR_RING_GUESS, UMR_RING_VPE, UMR_RING_MES, UMR_RING_SDMA,
@@ -573,7 +683,7 @@ void umr_read_ring_stream(struct umr_asic *asic, char *ringpath)
 		memset(from, 0, sizeof from);
 		memset(to, 0, sizeof to);
 		if (sscanf(ringpath, "%[a-z0-9._][%[.0-9]:%[.0-9]]", ringname, from, to) < 1) {
-			printf("Invalid ringpath\n");
+			fprintf(out, "Invalid ringpath\n");
 			return;
 		}
 
@@ -615,15 +725,214 @@ void umr_read_ring_stream(struct umr_asic *asic, char *ringpath)
 		}
 	}
 
-	if (!ring_or_file && fname[0]) {
-		vmid = addr = 0;
-		words = read_ib_file(asic, fname, &nwords);
-	}
-
 	if (enable_decoder < 0 || enable_decoder >= (int)(sizeof(rts)/sizeof(rts[0]))) {
 		fprintf(stderr, "[BUG]: Unknown ring type for [%s]\n", ringname);
+	} else if (!ring_or_file && fname[0]) {
+		ring_stream_file(asic, fname, rts[enable_decoder], out);
 	} else {
-		umr_ring_stream_present(asic, nwords ? NULL : ringname, start, end, vmid, addr, words, nwords, rts[enable_decoder]);
+		ring_stream_present(asic, nwords ? NULL : ringname, start, end, vmid, addr, NULL, nwords, rts[enable_decoder], out);
+	}
+}
+
+void umr_read_ring_stream(struct umr_asic *asic, char *ringpath)
+{
+	umr_read_ring_stream_to(asic, ringpath, umr_output_begin(asic));
+	umr_output_end(asic);
+}
+
+#define RING_CAPTURE_MAX 32
+
+static void print_captured_queues(FILE *out, const char *kind, const struct umr_cp_queues *cq)
+{
+	const struct umr_cp_queue_state *q;
+	int x;
+
+	fprintf(out, "Active %s queues:\n", kind);
+	for (x = 0; x < cq->no_queues; x++) {
+		q = &cq->queues[x];
+		if (q->active)
+			fprintf(out, "  ME %u Pipe %u Queue %u  VMID %u  BASE 0x%" PRIx64 "  RPTR 0x%x  WPTR 0x%" PRIx64 "  MQD 0x%" PRIx64 "\n",
+				q->me, q->pipe, q->queue, q->vmid, q->base, q->rptr, q->wptr, q->mqd_base);
+	}
+}
+
+/**
+ * umr_ring_capture_print - Capture several rings at once and decode them
+ *
+ * @asic: The device the rings belong to
+ * @ringlist: Comma separated ring names (without the amdgpu_ring_ prefix)
+ *
+ * The rings and the CP queue state are read in one wave halt (see
+ * umr_ring_capture()), the pending packets of each ring are decoded after
+ * the waves were resumed.
+ */
+void umr_ring_capture_print(struct umr_asic *asic, char *ringlist)
+{
+	struct umr_ring_capture *cap;
+	struct umr_ring_capture_ring *ring;
+	char *names[RING_CAPTURE_MAX], *list, *p, *save;
+	uint32_t *words, nwords;
+	int n = 0, x;
+	FILE *out;
+
+	list = strdup(ringlist);
+	if (!list) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return;
+	}
+	for (p = strtok_r(list, ",", &save); p && n < RING_CAPTURE_MAX; p = strtok_r(NULL, ",", &save))
+		names[n++] = p;
+
+	cap = umr_ring_capture(asic, names, n, 0);
+	free(list);
+	if (!cap)
+		return;
+
+	out = umr_output_begin(asic);
+	if (!asic->options.jsonl) {
+		if (!asic->options.halt_waves)
+			fprintf(out, "Captured %d rings (waves not halted)\n", cap->no_rings);
+		else
+			fprintf(out, "Captured %d rings (waves %s for %" PRIu64 " us)\n", cap->no_rings,
+				cap->halted ? "halted" : "not confirmed halted", cap->halt_us);
+		for (x = 0; x < cap->no_rings; x++) {
+			ring = &cap->rings[x];
+			if (ring->ok)
+				fprintf(out, "  %s: rptr 0x%" PRIx32 "  wptr 0x%" PRIx32 "  dwptr 0x%" PRIx32 "  size 0x%" PRIx32 " words\n",
+					ring->name, ring->rptr, ring->wptr, ring->dwptr, ring->nwords);
+			else
+				fprintf(out, "  %s: could not be read\n", ring->name);
+		}
+		if (cap->have_compute)
+			print_captured_queues(out, "compute", &cap->compute);
+		if (cap->have_gfx)
+			print_captured_queues(out, "gfx", &cap->gfx);
+	}
+
+	for (x = 0; x < cap->no_rings; x++) {
+		ring = &cap->rings[x];
+		if (ring->rt == UMR_RING_UNK) {
+			asic->err_msg("[ERROR]: Unknown ring type <%s>\n", ring->name);
+			continue;
+		}
+		words = umr_ring_capture_span(ring, &nwords);
+		if (!words)
+			continue;
+		if (!asic->options.jsonl)
+			fprintf(out, "\nDecoding %s [0x%" PRIx32 ":0x%" PRIx32 "]:\n", ring->name, ring->rptr, ring->wptr);
+		ring_stream_present(asic, NULL, 0, 0, 0, (uint64_t)ring->rptr * 4, words, nwords, ring->rt, out);
+		free(words);
 	}
-	free(words);
+	umr_output_end(asic);
+	umr_ring_capture_free(cap);
+}
+
+static volatile sig_atomic_t follow_quit;
+
+static void follow_sigint(int signo)
+{
+	(void)signo;
+	follow_quit = 1;
+}
+
+// wait between polls of a followed ring (microseconds), doubled while it is idle
+#define FOLLOW_MIN_DELAY 1000
+#define FOLLOW_MAX_DELAY 100000
+
+/**
+ * umr_follow_ring_stream - Print the packets of a ring as they are submitted
+ *
+ * @asic: The device the ring belongs to
+ * @ringname: The name of the ring (without the amdgpu_ring_ prefix)
+ *
+ * Decodes the packets between the rptr and wptr of the ring and then
+ * polls the wptr until interrupted, decoding only the words submitted
+ * since the last poll.  With the windowed ring readers (see
+ * umr_read_ring_window()) a poll costs a read of the ring header plus a
+ * read of the new words.
+ */
+void umr_follow_ring_stream(struct umr_asic *asic, char *ringname)
+{
+	struct umr_packet_stream *str;
+	struct umr_stream_decode_ui ui;
+	struct ui_data *data;
+	uint32_t ptrs[3], *ringdata, ringsize, last, delay;
+	int start, stop;
+	void (*old_sigint)(int);
+
+	if (!strcmp(ringname, "uq")) {
+		asic->err_msg("[ERROR]: Only kernel rings can be followed\n");
+		return;
+	}
+
+	ui = asic->options.jsonl ? jsonl_ui : umr_ui;
+	ui.rt = UMR_RING_GUESS;
+	data = ui.data = calloc(1, sizeof(struct ui_data));
+	if (!data) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return;
+	}
+	data->asic = asic;
+	data->out = stdout;
+
+	follow_quit = 0;
+	old_sigint = signal(SIGINT, follow_sigint);
+
+	delay = FOLLOW_MIN_DELAY;
+	last = ~0U;
+	while (!follow_quit) {
+		// IBs of new packets may live in freshly mapped pages
+		umr_vm_tlb_flush(asic);
+		if (asic->ring_func.read_ring_header) {
+			if (asic->ring_func.read_ring_header(asic, ringname, ptrs, &ringsize))
+				break;
+		} else {
+			ringdata = asic->ring_func.read_ring_data(asic, ringname, &ringsize);
+			if (!ringdata)
+				break;
+			memcpy(ptrs, ringdata, sizeof ptrs);
+			free(ringdata);
+		}
+		ringsize /= 4;
+		if (!ringsize)
+			break;
+		ptrs[0] %= ringsize;
+		ptrs[1] %= ringsize;
+
+		// start with whatever is still pending
+		if (last == ~0U) {
+			last = ptrs[0];
+			if (!asic->options.jsonl)
+				printf("Following ring %s from rptr 0x%"PRIx32" (wptr 0x%"PRIx32"), ^C to stop\n", ringname, ptrs[0], ptrs[1]);
+			fflush(stdout);
+		}
+
+		if (ptrs[1] == last) {
+			usleep(delay);
+			if (delay < FOLLOW_MAX_DELAY)
+				delay <<= 1;
+			continue;
+		}
+		delay = FOLLOW_MIN_DELAY;
+
+		// decode [last, wptr) only
+		start = last;
+		stop = ptrs[1];
+		data->sp = -1;
+		data->no = 0;
+		data->tainted = 0;
+		str = umr_packet_decode_ring(asic, &ui, ringname, 0, &start, &stop, UMR_RING_GUESS, NULL);
+		if (str) {
+			present_stream(asic, data, str, (uint64_t)last * 4, 0);
+			umr_packet_free(str);
+		}
+		if (asic->options.jsonl)
+			umr_jsonl_flush();
+		fflush(stdout);
+		last = ptrs[1];
+	}
+
+	signal(SIGINT, old_sigint);
+	free(data->levels);
+	free(data);
 }
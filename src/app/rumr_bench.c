@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+#include "umr_rumr.h"
+#include <stdarg.h>
+
+/*
+ * rumr_bench - Measure what a rumr server can do
+ *
+ * Connects to a server and runs register reads, 4 KiB and 1 MiB VRAM
+ * reads and wave scans back to back for a while each, then prints the
+ * rates and the per opcode stats of both ends.
+ */
+
+static int err_printf(const char *fmt, ...)
+{
+	va_list ap;
+	int r;
+
+	va_start(ap, fmt);
+	r = vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	return r;
+}
+
+struct bench {
+	const char *name;
+	uint32_t size; // bytes moved per iteration, 0 for none
+	int (*run)(struct umr_asic *asic, void *ctx);
+	void *ctx;
+};
+
+static int run_reg_read(struct umr_asic *asic, void *ctx)
+{
+	struct umr_reg *reg = ctx;
+
+	umr_read_reg(asic, reg->addr * 4, reg->type);
+	return 0;
+}
+
+static uint8_t vram_buf[1024 * 1024];
+
+static int run_vram_read(struct umr_asic *asic, void *ctx)
+{
+	return asic->mem_funcs.access_linear_vram(asic, 0, (uintptr_t)ctx, vram_buf, 0);
+}
+
+static int run_wave_scan(struct umr_asic *asic, void *ctx)
+{
+	(void)ctx;
+	umr_free_wave_data(umr_scan_wave_data(asic));
+	return 0;
+}
+
+// run @b for @seconds and print how many times a second it went
+static void run_bench(struct umr_asic *asic, struct bench *b, double seconds)
+{
+	uint64_t start, end, n = 0;
+
+	start = rumr_stats_now();
+	end = start + (uint64_t)(seconds * 1000000000.0);
+	do {
+		if (b->run(asic, b->ctx)) {
+			printf("%-14s failed\n", b->name);
+			return;
+		}
+		++n;
+	} while (rumr_stats_now() < end);
+	seconds = (rumr_stats_now() - start) / 1000000000.0;
+
+	printf("%-14s %10"PRIu64" %12.1f/s %10.1f us", b->name, n, n / seconds, seconds * 1000000.0 / n);
+	if (b->size)
+		printf(" %10.1f MiB/s", (double)n * b->size / seconds / (1024.0 * 1024.0));
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct rumr_client_state state;
+	struct rumr_comm_funcs cf;
+	const struct rumr_comm_funcs *funcs;
+	struct umr_options options;
+	struct umr_reg *reg;
+	double seconds = 1.0;
+	char *addr;
+	int i;
+
+	struct bench benches[] = {
+		{ "reg_read", 0, run_reg_read, NULL },
+		{ "vram_4k", 4096, run_vram_read, (void *)(uintptr_t)4096 },
+		{ "vram_1m", sizeof vram_buf, run_vram_read, (void *)(uintptr_t)sizeof vram_buf },
+		{ "wave_scan", 0, run_wave_scan, NULL },
+	};
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <server> [seconds per test]\n"
+				"\te.g. %s tcp://127.0.0.1:9000 2\n", argv[0], argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (argc > 2)
+		seconds = atof(argv[2]);
+
+	funcs = rumr_comm_lookup(argv[1], &addr);
+	if (!funcs) {
+		fprintf(stderr, "[ERROR]: Unknown server address <%s>\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+	cf = *funcs;
+	cf.log_msg = err_printf;
+
+	memset(&options, 0, sizeof options);
+	options.vm_partition = -1;
+	memset(&state, 0, sizeof state);
+	if (rumr_client_connect(&state, &cf, addr, &options))
+		return EXIT_FAILURE;
+
+	// any register every ASIC has will do for the round trip
+	reg = umr_find_reg_by_name(state.asic, "mmGRBM_STATUS", NULL);
+	if (!reg)
+		reg = umr_find_reg_by_name(state.asic, "regGRBM_STATUS", NULL);
+	if (!reg) {
+		fprintf(stderr, "[WARNING]: GRBM_STATUS not found, skipping register reads\n");
+		benches[0].run = NULL;
+	}
+	benches[0].ctx = reg;
+
+	printf("%-14s %10s %14s %10s %16s\n", "test", "calls", "rate", "latency", "throughput");
+	for (i = 0; i < (int)(sizeof benches / sizeof benches[0]); i++)
+		if (benches[i].run)
+			run_bench(state.asic, &benches[i], seconds);
+
+	printf("\n");
+	rumr_client_print_stats(&state, stdout);
+	rumr_client_close(&state);
+	return EXIT_SUCCESS;
+}
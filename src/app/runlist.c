@@ -26,19 +26,28 @@
 #include <signal.h>
 #include <time.h>
 #include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
 
-int umr_kfd_topo_get_pci_busaddr(int node, char *busaddr)
+#define KFD_TOPO_NODES "/sys/devices/virtual/kfd/kfd/topology/nodes"
+
+// bus address of every KFD node, read once ("" for nodes without one)
+static struct {
+	int loaded, no_nodes;
+	char (*busaddr)[32];
+} kfd_topo;
+
+static int kfd_topo_read_node(int node, char *busaddr)
 {
 	FILE *topo;
 	char linebuf[256];
 	uint32_t location, domain, mask=0;
 
-	sprintf(linebuf, "/sys/devices/virtual/kfd/kfd/topology/nodes/%d/properties", node);
+	busaddr[0] = 0;
+	sprintf(linebuf, KFD_TOPO_NODES "/%d/properties", node);
 	topo = fopen(linebuf, "r");
-	if (!topo) {
-		fprintf(stderr, "[ERROR]: Could not open KFD topology file for this node\n");
+	if (!topo)
 		return -1;
-	}
 	while (fgets(linebuf, sizeof linebuf, topo)) {
 		if (sscanf(linebuf, "location_id %"SCNu32, &location) == 1) {
 			mask |= 1;
@@ -47,74 +56,127 @@ int umr_kfd_topo_get_pci_busaddr(int node, char *busaddr)
 			mask |= 2;
 		}
 		if (mask == 3) {
-			sprintf(busaddr, "%04" PRIx32 ":%02" PRIx32 ":%02" PRIx32".0", domain, (location&0xFF00)>>8, (location&0xFF));
-			fclose(topo);
-			return 0;
+			snprintf(busaddr, 32, "%04" PRIx32 ":%02" PRIx32 ":%02" PRIx32".0", domain, (location&0xFF00)>>8, (location&0xFF));
+			break;
 		}
 	}
 	fclose(topo);
-	return -1;
+	return 0;
 }
 
+static void kfd_topo_load(void)
+{
+	char buf[32];
+	void *t;
 
-void umr_dump_runlists(struct umr_asic *asic, int node)
+	kfd_topo.loaded = 1;
+	while (!kfd_topo_read_node(kfd_topo.no_nodes, buf)) {
+		t = realloc(kfd_topo.busaddr, (kfd_topo.no_nodes + 1) * sizeof kfd_topo.busaddr[0]);
+		if (!t)
+			return;
+		kfd_topo.busaddr = t;
+		strcpy(kfd_topo.busaddr[kfd_topo.no_nodes++], buf);
+	}
+}
+
+/**
+ * umr_kfd_topo_get_pci_busaddr - PCI bus address of a KFD node
+ *
+ * @node: The KFD topology node
+ * @busaddr: Receives the address as "dddd:bb:ss.0"
+ *
+ * The topology is read the first time and looked up afterwards.
+ *
+ * Returns 0 on success, -1 if the node does not exist or is not a device.
+ */
+int umr_kfd_topo_get_pci_busaddr(int node, char *busaddr)
 {
-	FILE *rls;
-	unsigned char *rlsbuf;
-	char linebuf[256];
-	uint32_t linenums[9], rlssize, rlsofs;
-	int nv, x, words;
+	if (!kfd_topo.loaded)
+		kfd_topo_load();
+	if (node < 0 || node >= kfd_topo.no_nodes || !kfd_topo.busaddr[node][0]) {
+		fprintf(stderr, "[ERROR]: Could not open KFD topology file for this node\n");
+		return -1;
+	}
+	strcpy(busaddr, kfd_topo.busaddr[node]);
+	return 0;
+}
 
-	rlsofs = 0;
-	rlssize = 4096;
-	rlsbuf = calloc(1, rlssize);
+// debugfs files have no size, read until EOF doubling the buffer
+static char *read_rls(size_t *len)
+{
+	char *buf = NULL, *t;
+	size_t size = 0;
+	ssize_t r;
+	int fd;
 
-	if (!rlsbuf) {
-		asic->err_msg("[ERROR]: Out of memory\n");
-		return;
+	*len = 0;
+	fd = open("/sys/kernel/debug/kfd/rls", O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+	for (;;) {
+		if (*len == size) {
+			size = size ? size * 2 : 65536;
+			t = realloc(buf, size);
+			if (!t) {
+				free(buf);
+				close(fd);
+				return NULL;
+			}
+			buf = t;
+		}
+		r = read(fd, buf + *len, size - *len);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			break;
+		*len += r;
 	}
+	close(fd);
+	return buf;
+}
+
+/**
+ * umr_dump_runlists - Decode the runlists KFD has submitted
+ *
+ * @asic: The device used to decode the packets
+ * @node: The KFD node to decode or -1 for every node in the dump
+ */
+void umr_dump_runlists(struct umr_asic *asic, int node)
+{
+	struct umr_kfd_runlist *rls;
+	char *text, busaddr[32];
+	size_t len;
+	int n, x;
 
-	rls = fopen("/sys/kernel/debug/kfd/rls", "r");
-	if (!rls) {
+	text = read_rls(&len);
+	if (!text) {
 		asic->err_msg("[ERROR]: Could not open RLS file from KFD debug tree\n");
-		free(rlsbuf);
 		return;
 	}
-	while (fgets(linebuf, sizeof linebuf, rls)) {
-		if (sscanf(linebuf, "Node %d, gpu_id", &nv) == 1 && nv == node) {
-			// parse data in
-			while (fgets(linebuf, sizeof linebuf, rls)) {
-				if ((words = sscanf(linebuf, "%"SCNx32": %"SCNx32" %"SCNx32" %"SCNx32" %"SCNx32" %"SCNx32" %"SCNx32" %"SCNx32" %"SCNx32"\n",
-					&linenums[0], &linenums[1], &linenums[2], &linenums[3], &linenums[4], &linenums[5], &linenums[6], &linenums[7],
-					&linenums[8])) >= 2) {
-						words--; // skip offset
-						if ((words * 4 + rlsofs) > rlssize) {
-							void *t = realloc(rlsbuf, rlssize + 4096);
-							if (!t) {
-								asic->err_msg("[ERROR]: Out of memory\n");
-								free(rlsbuf);
-								return;
-							}
-							rlssize += 4096;
-							rlsbuf = t;
-						}
-						for (x = 0; x < words; x++) {
-							memcpy(&rlsbuf[rlsofs], &linenums[1 + x], 4);
-							rlsofs += 4;
-						}
-				} else {
-					break;
-				}
-			}
-
-			// now rlsbuf has a PM4 IB of size rlsofs bytes
-			if (rlsofs)
-				umr_ring_stream_present(asic, NULL, -1, -1, 0, 0, (uint32_t *)rlsbuf, rlsofs>>2, UMR_RING_PM4);
+	n = umr_kfd_rls_parse(text, len, &rls);
+	free(text);
+	if (n < 0) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return;
+	}
 
-			// we're done
-			break;
+	for (x = 0; x < n; x++) {
+		if (node >= 0 && rls[x].node != node)
+			continue;
+		if (node < 0) {
+			if (!kfd_topo.loaded)
+				kfd_topo_load();
+			busaddr[0] = 0;
+			if (rls[x].node < kfd_topo.no_nodes)
+				strcpy(busaddr, kfd_topo.busaddr[rls[x].node]);
+			asic->std_msg("Node %d, gpu_id 0x%"PRIx32" (%s), %"PRIu32" words\n",
+				rls[x].node, rls[x].gpu_id, busaddr[0] ? busaddr : "unknown", rls[x].no_words);
 		}
+		// a PM4 IB
+		if (rls[x].no_words)
+			umr_ring_stream_present(asic, NULL, -1, -1, 0, 0, rls[x].words, rls[x].no_words, UMR_RING_PM4);
+		if (node >= 0)
+			break;
 	}
-	free(rlsbuf);
-	fclose(rls);
+	umr_kfd_rls_free(rls, n);
 }
@@ -25,13 +25,50 @@
 #include "umrapp.h"
 #include <regex.h>
 
+// a register read by --read as a JSON line, with its fields if -O bits is set
+static void jsonl_reg(struct umr_asic *asic, struct umr_ip_block *ip, struct umr_reg *reg, uint64_t value)
+{
+	int k;
+
+	umr_jsonl_begin("reg");
+	umr_jsonl_str("ip", ip->ipname);
+	umr_jsonl_str("reg", reg->regname);
+	umr_jsonl_hex("addr", reg->addr);
+	umr_jsonl_u64("value", value);
+	if (asic->options.bitfields) {
+		umr_jsonl_object("bits", 0);
+		for (k = 0; k < reg->no_bits; k++)
+			umr_jsonl_u64(reg->bits[k].regname, (value >> reg->bits[k].start) & umr_bitfield_mask(&reg->bits[k]));
+		umr_jsonl_close();
+	}
+	umr_jsonl_end();
+}
+
+struct scan_path {
+	char *asicname, *ipname, *regname;
+};
+
+static int scan_asic_xcc(struct umr_asic *asic, void *data)
+{
+	struct scan_path *path = data;
+
+	return umr_scan_asic(asic, path->asicname, path->ipname, path->regname);
+}
+
 int umr_scan_asic(struct umr_asic *asic, char *asicname, char *ipname, char *regname)
 {
-	int r, i, j, k, count = 0, noipreg = 1;
-	uint64_t scale;
+	int r, i, j, count = 0, noipreg = 1;
 	char regname_copy[256], ipname_esc[256], ipnametmp[256], *p;
-	uint32_t v32;
 	regex_t ip_regex, reg_regex;
+	uint64_t value;
+	FILE *out;
+
+	// -vmp all: read the registers on every XCC
+	if (asic->options.all_xcc && umr_xcc_current() < 0) {
+		struct scan_path path = { asicname, ipname, regname };
+
+		return umr_xcc_run(asic, scan_asic_xcc, &path);
+	}
 
 	// handle {-1} in the ipname
 	strcpy(ipnametmp, ipname);
@@ -69,51 +106,49 @@ int umr_scan_asic(struct umr_asic *asic, char *asicname, char *ipname, char *reg
 	}
 
 	/* scan them all in order */
+	out = umr_output_begin(asic);
 	if (!asicname[0] || !strcmp(asicname, "*") || !strcmp(asicname, asic->asicname)) {
 		for (i = 0; i < asic->no_blocks; i++) {
 			if (!ipname[0] || ipname[0] == '*' || !regexec(&ip_regex, asic->blocks[i]->ipname, 0, NULL, 0)) {
+				umr_load_ip_block(asic, asic->blocks[i]);
 				for (j = 0; j < asic->blocks[i]->no_regs; j++) {
 					if (!regname[0] || !strcmp(regname, "*") ||
 					    !regexec(&reg_regex, asic->blocks[i]->regs[j].regname, 0, NULL, 0)) {
 						++count;
 
 						switch(asic->blocks[i]->regs[j].type) {
-							case REG_MMIO: scale = 4; break;
-							case REG_DIDT: scale = 1; break;
-							case REG_PCIE: scale = 1; break;
+							case REG_MMIO:
+							case REG_DIDT:
+							case REG_PCIE:
+								break;
 							case REG_SMC:
-								if (asic->options.read_smc) {
-									scale = 1;
-								} else {
+								if (!asic->options.read_smc)
 									continue;
-								}
 								break;
-							default: return -1;
+							default:
+								umr_output_end(asic);
+								return -1;
 						}
 
-						v32 = asic->reg_funcs.read_reg(asic, asic->blocks[i]->regs[j].addr*scale, asic->blocks[i]->regs[j].type);
-						asic->blocks[i]->regs[j].value = v32;
-						if (asic->blocks[i]->regs[j].bit64) {
-							v32 = asic->reg_funcs.read_reg(asic, (asic->blocks[i]->regs[j].addr+1)*scale, asic->blocks[i]->regs[j].type);
-							asic->blocks[i]->regs[j].value |= (uint64_t)v32 << 32;
-						}
+						value = umr_read_reg_by_reg(asic, &asic->blocks[i]->regs[j]);
+						// the register tables are shared by the XCCs
+						if (umr_xcc_current() < 0)
+							asic->blocks[i]->regs[j].value = value;
 
-						if (regname[0]) {
-							printf("%s%s.%s%s => ", CYAN, asic->blocks[i]->ipname,  asic->blocks[i]->regs[j].regname, RST);
-							printf("%s0x%08lx%s\n", YELLOW, (unsigned long)asic->blocks[i]->regs[j].value, RST);
+						if (regname[0] && asic->options.jsonl) {
+							jsonl_reg(asic, asic->blocks[i], &asic->blocks[i]->regs[j], value);
+						} else if (regname[0]) {
+							fprintf(out, "%s%s.%s%s => ", CYAN, asic->blocks[i]->ipname,  asic->blocks[i]->regs[j].regname, RST);
+							fprintf(out, "%s0x%08lx%s\n", YELLOW, (unsigned long)value, RST);
 							if (asic->options.bitfields)
-								for (k = 0; k < asic->blocks[i]->regs[j].no_bits; k++) {
-									uint32_t v;
-									v = (1UL << (asic->blocks[i]->regs[j].bits[k].stop + 1 - asic->blocks[i]->regs[j].bits[k].start)) - 1;
-									v &= (asic->blocks[i]->regs[j].value >> asic->blocks[i]->regs[j].bits[k].start);
-									asic->blocks[i]->regs[j].bits[k].bitfield_print(asic, asic->asicname, asic->blocks[i]->ipname, asic->blocks[i]->regs[j].regname, asic->blocks[i]->regs[j].bits[k].regname, asic->blocks[i]->regs[j].bits[k].start, asic->blocks[i]->regs[j].bits[k].stop, v);
-								}
+								umr_bitfield_print_all(asic, asic->blocks[i], &asic->blocks[i]->regs[j], value);
 						}
 					}
 				}
 			}
 		}
 	}
+	umr_output_end(asic);
 
 	if (count == 0) {
 		if (!memcmp(regname_copy, "reg", 3)) {
@@ -22,13 +22,21 @@
  * Authors: Tom St Denis <tom.stdenis@amd.com>
  *
  */
+#define _GNU_SOURCE
 #include "umrapp.h"
+#include <errno.h>
+#include <fnmatch.h>
+#include <dirent.h>
+#include <poll.h>
+#include <signal.h>
+#include <linux/limits.h>
+#include <sys/mman.h>
 
 void umr_scan_log(struct umr_asic *asic, int use_new)
 {
 	char line[256], *chr;
 	FILE *f;
-	int k, found;
+	int found;
 	unsigned long delta, did, regno, value, write;
 	struct umr_reg *reg;
 	struct umr_ip_block *ip;
@@ -81,12 +89,7 @@ void umr_scan_log(struct umr_asic *asic, int use_new)
 								(unsigned long)delta,
 								(unsigned long)value);
 						if (asic->options.bitfields)
-							for (k = 0; k < reg->no_bits; k++) {
-								uint32_t v;
-								v = (1UL << (reg->bits[k].stop + 1 - reg->bits[k].start)) - 1;
-								v &= (value >> reg->bits[k].start);
-								reg->bits[k].bitfield_print(asic, asic->asicname, ip->ipname, reg->regname, reg->bits[k].regname, reg->bits[k].start, reg->bits[k].stop, v);
-							}
+							umr_bitfield_print_all(asic, ip, reg, value);
 						found = 1;
 					}
 					regno -= 1;
@@ -103,3 +106,928 @@ void umr_scan_log(struct umr_asic *asic, int use_new)
 	}
 }
 
+
+/*
+ * Saved traces
+ *
+ * umr_scan_log_file() maps a saved trace and splits it into line aligned
+ * chunks scanned by worker threads.  Each chunk is formatted into a buffer
+ * of its own and the buffers are written in file order, at most a few
+ * chunks ahead of the writer are kept in memory.
+ */
+#define SCAN_CHUNK_SIZE		(4UL << 20)
+#define SCAN_CACHE_SIZE		4096
+
+struct scan_chunk {
+	const char *start, *end;
+	char *out;
+	size_t out_len;
+	int done;
+};
+
+struct scan_hist_entry {
+	struct umr_reg *reg;
+	struct umr_ip_block *ip;
+	uint64_t reads, writes, recent;
+	unsigned long last;
+};
+
+struct scan_hist {
+	struct scan_hist_entry *entries;
+	uint32_t size, used;
+};
+
+struct scan_file {
+	struct umr_asic *asic;
+	char ip_filter[64], reg_filter[128];
+	int histogram;
+
+	struct scan_chunk *chunks;
+	int no_chunks, next, written, ahead;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+
+	struct scan_hist hist;
+};
+
+// register found for a logged address, the trace logs the address of the access
+struct scan_lookup {
+	unsigned long regno, delta;
+	struct umr_reg *reg;
+	struct umr_ip_block *ip;
+	int valid;
+};
+
+static int scan_hex(const char **p, const char *end, unsigned long *value)
+{
+	const char *s = *p;
+	unsigned long v = 0;
+	int c, n = 0;
+
+	if (end - s < 3 || s[0] != '0' || s[1] != 'x')
+		return -1;
+	for (s += 2; s < end; s++, n++) {
+		c = *s;
+		if (c >= '0' && c <= '9')
+			c -= '0';
+		else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+			c = (c | 0x20) - 'a' + 10;
+		else
+			break;
+		v = (v << 4) | c;
+	}
+	if (!n)
+		return -1;
+	*value = v;
+	*p = s;
+	return 0;
+}
+
+/*
+ * Parse "<rreg|wreg>: 0x<did>, 0x<regno>, 0x<value>" following the
+ * amdgpu_device_ or amdgpu_mm_ prefix of an event
+ */
+static int scan_event(const char *p, const char *end, int *write, unsigned long *did, unsigned long *regno, unsigned long *value)
+{
+	if (end - p < 6 || p[1] != 'r' || p[2] != 'e' || p[3] != 'g' || p[4] != ':' || p[5] != ' ')
+		return -1;
+	if (p[0] == 'w')
+		*write = 1;
+	else if (p[0] == 'r')
+		*write = 0;
+	else
+		return -1;
+	p += 6;
+	if (scan_hex(&p, end, did) || end - p < 2 || p[0] != ',' || p[1] != ' ')
+		return -1;
+	p += 2;
+	if (scan_hex(&p, end, regno) || end - p < 2 || p[0] != ',' || p[1] != ' ')
+		return -1;
+	p += 2;
+	return scan_hex(&p, end, value);
+}
+
+// the register at or below @regno like umr_scan_log() looks it up
+static struct scan_lookup *scan_find_reg(struct umr_asic *asic, struct scan_lookup *cache, unsigned long regno)
+{
+	struct scan_lookup *l = &cache[regno % SCAN_CACHE_SIZE];
+	unsigned long r;
+
+	if (l->valid && l->regno == regno)
+		return l;
+
+	l->valid = 1;
+	l->regno = regno;
+	l->reg = NULL;
+	l->ip = NULL;
+	for (r = regno;; r--) {
+		l->reg = umr_find_reg_by_addr(asic, r, &l->ip);
+		if (l->reg || !r)
+			break;
+	}
+	l->delta = regno - r;
+	return l;
+}
+
+// the entry of a register, added if it isn't there yet, NULL if out of memory
+static struct scan_hist_entry *scan_hist_get(struct scan_hist *h, struct umr_reg *reg, struct umr_ip_block *ip)
+{
+	struct scan_hist_entry *old, *e;
+	uint32_t x, i, mask;
+
+	if ((h->used + 1) * 2 > h->size) {
+		old = h->entries;
+		x = h->size;
+		h->size = h->size ? h->size * 2 : 256;
+		h->entries = calloc(h->size, sizeof *h->entries);
+		if (!h->entries) {
+			h->entries = old;
+			h->size = x;
+			return NULL;
+		}
+		h->used = 0;
+		for (i = 0; i < x; i++) {
+			if (old[i].reg) {
+				e = scan_hist_get(h, old[i].reg, old[i].ip);
+				*e = old[i];
+			}
+		}
+		free(old);
+	}
+
+	mask = h->size - 1;
+	for (i = ((uintptr_t)reg >> 4) & mask; h->entries[i].reg && h->entries[i].reg != reg; i = (i + 1) & mask);
+	if (!h->entries[i].reg) {
+		h->entries[i].reg = reg;
+		h->entries[i].ip = ip;
+		++h->used;
+	}
+	return &h->entries[i];
+}
+
+static void scan_hist_add(struct scan_hist *h, struct umr_reg *reg, struct umr_ip_block *ip, uint64_t reads, uint64_t writes)
+{
+	struct scan_hist_entry *e = scan_hist_get(h, reg, ip);
+
+	if (e) {
+		e->reads += reads;
+		e->writes += writes;
+	}
+}
+
+static int scan_filter(struct scan_file *sf, struct scan_lookup *l)
+{
+	return (sf->ip_filter[0] && fnmatch(sf->ip_filter, l->ip->ipname, 0)) ||
+	       (sf->reg_filter[0] && fnmatch(sf->reg_filter, l->reg->regname, 0));
+}
+
+static void scan_chunk(struct scan_file *sf, struct scan_chunk *c, struct scan_lookup *cache, struct scan_hist *hist)
+{
+	struct umr_asic *asic = sf->asic;
+	const char *p = c->start, *eol, *ev;
+	unsigned long did, regno, value;
+	struct scan_lookup *l;
+	FILE *out = NULL;
+	int write, k;
+
+	if (!sf->histogram && !(out = open_memstream(&c->out, &c->out_len)))
+		return;
+
+	while (p < c->end && (p = memmem(p, c->end - p, "amdgpu_", 7))) {
+		eol = memchr(p, '\n', c->end - p);
+		if (!eol)
+			eol = c->end;
+		ev = p + 7;
+		if (eol - ev > 7 && !memcmp(ev, "device_", 7))
+			ev += 7;
+		else if (eol - ev > 3 && !memcmp(ev, "mm_", 3))
+			ev += 3;
+		else
+			ev = NULL;
+		// the event name can only come once per line
+		p = eol;
+
+		if (!ev || scan_event(ev, eol, &write, &did, &regno, &value) || did != asic->did)
+			continue;
+		l = scan_find_reg(asic, cache, regno);
+		if (!l->reg || scan_filter(sf, l))
+			continue;
+
+		if (sf->histogram) {
+			scan_hist_add(hist, l->reg, l->ip, !write, write);
+			continue;
+		}
+		fprintf(out, "%s.%s.%s +0x%04lx %s 0x%08lx\n",
+			asic->asicname, l->ip->ipname, l->reg->regname,
+			l->delta, write ? "<=" : "=>", value);
+		if (asic->options.bitfields) {
+			// as umr_bitfield_default() prints them
+			for (k = 0; k < l->reg->no_bits; k++) {
+				char buf[512], fpath[256];
+				uint32_t v;
+
+				v = (value >> l->reg->bits[k].start) & umr_bitfield_mask(&l->reg->bits[k]);
+				snprintf(fpath, sizeof(fpath)-1, "%s.%s.%s%s%s.", asic->asicname, l->ip->ipname, CYAN, l->reg->regname, RST);
+				snprintf(buf, sizeof(buf)-1, "\t%s%s%s%s[%s%d:%d%s]",
+					asic->options.bitfields_full ? fpath : ".",
+					RED, l->reg->bits[k].regname, RST,
+					BLUE, l->reg->bits[k].start, l->reg->bits[k].stop, RST);
+				fprintf(out, "%-65s == %s%8lu%s (%s0x%08lx%s)\n", buf,
+					YELLOW, (unsigned long)v, RST,
+					YELLOW, (unsigned long)v, RST);
+			}
+		}
+	}
+	if (out)
+		fclose(out);
+}
+
+static void *scan_thread(void *data)
+{
+	struct scan_file *sf = data;
+	struct scan_lookup *cache;
+	struct scan_hist hist = { 0 };
+	uint32_t i;
+	int n;
+
+	cache = calloc(SCAN_CACHE_SIZE, sizeof *cache);
+	if (!cache)
+		return NULL;
+
+	pthread_mutex_lock(&sf->lock);
+	for (;;) {
+		// don't run too far ahead of the chunks that were written
+		while (sf->next < sf->no_chunks && sf->next >= sf->written + sf->ahead)
+			pthread_cond_wait(&sf->cond, &sf->lock);
+		if (sf->next >= sf->no_chunks)
+			break;
+		n = sf->next++;
+		pthread_mutex_unlock(&sf->lock);
+
+		scan_chunk(sf, &sf->chunks[n], cache, &hist);
+
+		pthread_mutex_lock(&sf->lock);
+		sf->chunks[n].done = 1;
+		pthread_cond_broadcast(&sf->cond);
+	}
+	for (i = 0; i < hist.size; i++)
+		if (hist.entries[i].reg)
+			scan_hist_add(&sf->hist, hist.entries[i].reg, hist.entries[i].ip, hist.entries[i].reads, hist.entries[i].writes);
+	pthread_mutex_unlock(&sf->lock);
+
+	free(hist.entries);
+	free(cache);
+	return NULL;
+}
+
+static int scan_hist_cmp(const void *a, const void *b)
+{
+	const struct scan_hist_entry *x = a, *y = b;
+	uint64_t tx = x->reads + x->writes, ty = y->reads + y->writes;
+
+	if (tx != ty)
+		return tx < ty ? 1 : -1;
+	return strcmp(x->reg->regname, y->reg->regname);
+}
+
+static void scan_print_hist(struct scan_file *sf)
+{
+	struct scan_hist_entry *e = sf->hist.entries;
+	uint32_t i, n;
+
+	for (i = n = 0; i < sf->hist.size; i++)
+		if (e[i].reg)
+			e[n++] = e[i];
+	qsort(e, n, sizeof *e, scan_hist_cmp);
+	printf("%12s %12s  %s\n", "reads", "writes", "register");
+	for (i = 0; i < n; i++)
+		printf("%12" PRIu64 " %12" PRIu64 "  %s.%s.%s\n", e[i].reads, e[i].writes,
+			sf->asic->asicname, e[i].ip->ipname, e[i].reg->regname);
+}
+
+/**
+ * umr_scan_log_file - Print the register accesses of a saved ftrace log
+ *
+ * @asic: The device whose accesses are printed
+ * @path: The saved trace (a copy of /sys/kernel/debug/tracing/trace)
+ * @filter: NULL or "<ip>[.<reg>]" where either part can be a shell pattern
+ * @histogram: Print how often each register was read and written instead
+ *
+ * The output is the same as --logscan's for the accesses in the file.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int umr_scan_log_file(struct umr_asic *asic, const char *path, const char *filter, int histogram)
+{
+	struct scan_file sf;
+	struct stat st;
+	pthread_t *threads;
+	const char *map, *p, *end;
+	int fd, no_threads, x, r = -1;
+	const char *dot;
+
+	memset(&sf, 0, sizeof sf);
+	sf.asic = asic;
+	sf.histogram = histogram;
+	if (filter) {
+		dot = strchr(filter, '.');
+		snprintf(sf.ip_filter, sizeof sf.ip_filter, "%.*s", dot ? (int)(dot - filter) : (int)strlen(filter), filter);
+		if (dot)
+			snprintf(sf.reg_filter, sizeof sf.reg_filter, "%s", dot + 1);
+	}
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0 || fstat(fd, &st)) {
+		asic->err_msg("[ERROR]: Cannot open trace file '%s': %s\n", path, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+	if (!st.st_size) {
+		close(fd);
+		return 0;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		asic->err_msg("[ERROR]: Cannot map trace file '%s': %s\n", path, strerror(errno));
+		return -1;
+	}
+	madvise((void *)map, st.st_size, MADV_SEQUENTIAL);
+	end = map + st.st_size;
+
+	// line aligned chunks
+	sf.chunks = calloc(st.st_size / SCAN_CHUNK_SIZE + 1, sizeof *sf.chunks);
+	if (!sf.chunks)
+		goto out;
+	for (p = map; p < end; sf.no_chunks++) {
+		sf.chunks[sf.no_chunks].start = p;
+		if ((size_t)(end - p) <= SCAN_CHUNK_SIZE) {
+			p = end;
+		} else {
+			p += SCAN_CHUNK_SIZE;
+			p = memchr(p, '\n', end - p);
+			p = p ? p + 1 : end;
+		}
+		sf.chunks[sf.no_chunks].end = p;
+	}
+
+	// load the register database before the workers look registers up
+	umr_find_reg_by_addr(asic, 0, NULL);
+
+	no_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (no_threads < 1)
+		no_threads = 1;
+	if (no_threads > 64)
+		no_threads = 64;
+	if (no_threads > sf.no_chunks)
+		no_threads = sf.no_chunks;
+	sf.ahead = no_threads * 2;
+	threads = calloc(no_threads, sizeof *threads);
+	if (!threads)
+		goto out;
+	pthread_mutex_init(&sf.lock, NULL);
+	pthread_cond_init(&sf.cond, NULL);
+	for (x = 0; x < no_threads; x++)
+		if (pthread_create(&threads[x], NULL, scan_thread, &sf))
+			break;
+	if (!x) {
+		asic->err_msg("[ERROR]: Cannot create the trace scanning threads\n");
+		free(threads);
+		goto out;
+	}
+	no_threads = x;
+
+	// write the chunks in order as they complete
+	pthread_mutex_lock(&sf.lock);
+	while (sf.written < sf.no_chunks) {
+		while (!sf.chunks[sf.written].done)
+			pthread_cond_wait(&sf.cond, &sf.lock);
+		pthread_mutex_unlock(&sf.lock);
+		if (sf.chunks[sf.written].out) {
+			fwrite(sf.chunks[sf.written].out, 1, sf.chunks[sf.written].out_len, stdout);
+			free(sf.chunks[sf.written].out);
+			sf.chunks[sf.written].out = NULL;
+		}
+		pthread_mutex_lock(&sf.lock);
+		sf.written++;
+		pthread_cond_broadcast(&sf.cond);
+	}
+	pthread_mutex_unlock(&sf.lock);
+
+	for (x = 0; x < no_threads; x++)
+		pthread_join(threads[x], NULL);
+	free(threads);
+
+	if (histogram)
+		scan_print_hist(&sf);
+	fflush(stdout);
+	r = 0;
+out:
+	free(sf.hist.entries);
+	free(sf.chunks);
+	munmap((void *)map, st.st_size);
+	return r;
+}
+
+/*
+ * Following the live trace
+ *
+ * umr_follow_log() reads the register events as they are traced, from the
+ * binary per CPU ring buffers (per_cpu/cpuN/trace_pipe_raw) with a thread
+ * per CPU or from the text trace_pipe if those can't be used.  Only counts
+ * and the last value of every register are kept.
+ */
+#define TRACING_PATH		"/sys/kernel/debug/tracing/"
+
+/* ring buffer event header, see include/linux/ring_buffer.h */
+#define RB_TYPE_PADDING		29
+#define RB_TYPE_TIME_EXTEND	30
+#define RB_TYPE_TIME_STAMP	31
+#define RB_COMMIT_MASK		((1ULL << 27) - 1)
+#define RB_MISSED_EVENTS	(1ULL << 31)
+#define RB_MISSED_STORED	(1ULL << 30)
+
+struct follow_field {
+	int offset, size;
+};
+
+// where the fields of an rreg or wreg event are
+struct follow_format {
+	int id, write;
+	struct follow_field did, reg, value;
+};
+
+struct follow_log;
+
+struct follow_cpu {
+	struct follow_log *fl;
+	int fd;
+	pthread_t thread;
+	int has_thread;
+	struct scan_lookup *cache;
+};
+
+struct follow_log {
+	struct umr_asic *asic;
+	pthread_mutex_t lock;
+	struct scan_hist hist;
+	uint64_t lost;
+
+	int page_size, commit_size, data_offset;
+	struct follow_format formats[2];
+	int no_formats;
+	struct follow_cpu *cpus;
+	int no_cpus;
+};
+
+static volatile sig_atomic_t follow_quit;
+
+static void follow_sigint(int signo)
+{
+	(void)signo;
+	follow_quit = 1;
+}
+
+static char *follow_read_file(const char *path)
+{
+	char *buf;
+	ssize_t n;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+	buf = calloc(1, 16384);
+	if (buf) {
+		n = read(fd, buf, 16383);
+		if (n <= 0) {
+			free(buf);
+			buf = NULL;
+		}
+	}
+	close(fd);
+	return buf;
+}
+
+// "\tfield:unsigned int did;\toffset:8;\tsize:4;\tsigned:0;"
+static int follow_parse_field(const char *line, char *name, int namelen, struct follow_field *f)
+{
+	char decl[128], *p;
+
+	if (sscanf(line, " field:%127[^;]; offset:%d; size:%d;", decl, &f->offset, &f->size) != 3)
+		return -1;
+	p = strrchr(decl, ' ');
+	// a name that doesn't fit can't be one we look for
+	if (snprintf(name, namelen, "%s", p ? p + 1 : decl) >= namelen)
+		return -1;
+	return 0;
+}
+
+static int follow_parse_format(struct follow_log *fl, const char *event, int write)
+{
+	struct follow_format *fmt = &fl->formats[fl->no_formats];
+	struct follow_field field, *args[3];
+	char path[256], name[64], *content, *line, *save;
+	int n = 0;
+
+	snprintf(path, sizeof path, TRACING_PATH "events/amdgpu/%s/format", event);
+	content = follow_read_file(path);
+	if (!content)
+		return -1;
+
+	memset(fmt, 0, sizeof *fmt);
+	fmt->id = -1;
+	fmt->write = write;
+	args[0] = &fmt->did;
+	args[1] = &fmt->reg;
+	args[2] = &fmt->value;
+	for (line = strtok_r(content, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+		if (sscanf(line, "ID: %d", &fmt->id) == 1)
+			continue;
+		// did, reg and value follow the common fields in that order
+		if (follow_parse_field(line, name, sizeof name, &field) || !strncmp(name, "common_", 7) || n == 3)
+			continue;
+		if (field.size != 4 && field.size != 8)
+			break;
+		*args[n++] = field;
+	}
+	free(content);
+
+	if (fmt->id < 0 || n != 3)
+		return -1;
+	fl->no_formats++;
+	return 0;
+}
+
+static void follow_parse_header_page(struct follow_log *fl)
+{
+	struct follow_field field;
+	char name[64], *content, *line, *save;
+
+	fl->commit_size = 8;
+	fl->data_offset = 16;
+	content = follow_read_file(TRACING_PATH "events/header_page");
+	if (!content)
+		return;
+	for (line = strtok_r(content, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+		if (follow_parse_field(line, name, sizeof name, &field))
+			continue;
+		if (!strcmp(name, "commit"))
+			fl->commit_size = field.size;
+		else if (!strcmp(name, "data"))
+			fl->data_offset = field.offset;
+	}
+	free(content);
+}
+
+// count an access, fl->lock held
+static void follow_add(struct follow_log *fl, struct scan_lookup *cache, unsigned long did, unsigned long regno, unsigned long value, int write)
+{
+	struct scan_hist_entry *e;
+	struct scan_lookup *l;
+
+	if (did != fl->asic->did)
+		return;
+	l = scan_find_reg(fl->asic, cache, regno);
+	if (!l->reg || !(e = scan_hist_get(&fl->hist, l->reg, l->ip)))
+		return;
+	e->reads += !write;
+	e->writes += write;
+	e->recent++;
+	e->last = value;
+}
+
+static unsigned long follow_field_value(const uint8_t *rec, const struct follow_field *f)
+{
+	uint32_t v32;
+	uint64_t v64;
+
+	if (f->size == 4) {
+		memcpy(&v32, rec + f->offset, 4);
+		return v32;
+	}
+	memcpy(&v64, rec + f->offset, 8);
+	return v64;
+}
+
+// walk the events of a ring buffer page, see tools/lib/traceevent/kbuffer
+static void follow_parse_page(struct follow_cpu *c, const uint8_t *page, int page_len)
+{
+	struct follow_log *fl = c->fl;
+	const struct follow_format *fmt;
+	const uint8_t *p, *end;
+	uint64_t commit = 0, size;
+	uint32_t hdr, type_len, len;
+	uint16_t type;
+	long missed;
+	int i;
+
+	if (page_len < fl->data_offset)
+		return;
+	memcpy(&commit, page + 8, fl->commit_size);
+	size = commit & RB_COMMIT_MASK;
+	if (size > (uint64_t)(page_len - fl->data_offset))
+		size = page_len - fl->data_offset;
+	if (commit & RB_MISSED_EVENTS) {
+		missed = 1;
+		if ((commit & RB_MISSED_STORED) && fl->data_offset + size + sizeof(long) <= (uint64_t)page_len)
+			memcpy(&missed, page + fl->data_offset + size, sizeof(long));
+		fl->lost += missed;
+	}
+
+	p = page + fl->data_offset;
+	end = p + size;
+	while (p + 4 <= end) {
+		memcpy(&hdr, p, 4);
+		p += 4;
+		type_len = hdr & 0x1f;
+		switch (type_len) {
+		case RB_TYPE_PADDING:
+			// the rest of the page is unused
+			if (!(hdr >> 5) || p + 4 > end)
+				return;
+			memcpy(&len, p, 4);
+			p += len;
+			continue;
+		case RB_TYPE_TIME_EXTEND:
+		case RB_TYPE_TIME_STAMP:
+			p += 4;
+			continue;
+		case 0:
+			if (p + 4 > end)
+				return;
+			memcpy(&len, p, 4);
+			p += 4;
+			len = (len - 4 + 3) & ~3;
+			break;
+		default:
+			len = type_len * 4;
+			break;
+		}
+		if (len > end - p)
+			return;
+		memcpy(&type, p, 2);
+		for (i = 0; i < fl->no_formats; i++) {
+			fmt = &fl->formats[i];
+			if (fmt->id == type && fmt->value.offset + fmt->value.size <= (int)len &&
+			    fmt->reg.offset + fmt->reg.size <= (int)len && fmt->did.offset + fmt->did.size <= (int)len) {
+				follow_add(fl, c->cache, follow_field_value(p, &fmt->did), follow_field_value(p, &fmt->reg),
+					   follow_field_value(p, &fmt->value), fmt->write);
+				break;
+			}
+		}
+		p += len;
+	}
+}
+
+static void *follow_cpu_thread(void *data)
+{
+	struct follow_cpu *c = data;
+	struct pollfd pfd = { .fd = c->fd, .events = POLLIN };
+	uint8_t *page;
+	ssize_t n;
+
+	page = malloc(c->fl->page_size);
+	if (!page)
+		return NULL;
+	while (!follow_quit) {
+		n = read(c->fd, page, c->fl->page_size);
+		if (n <= 0) {
+			if (n < 0 && errno != EAGAIN && errno != EINTR)
+				break;
+			// poll only wakes up past buffer_percent, so don't wait too long
+			poll(&pfd, 1, 10);
+			continue;
+		}
+		pthread_mutex_lock(&c->fl->lock);
+		follow_parse_page(c, page, n);
+		pthread_mutex_unlock(&c->fl->lock);
+	}
+	free(page);
+	return NULL;
+}
+
+// start a reader per CPU, -1 if the binary buffers can't be used
+static int follow_start_raw(struct follow_log *fl, int use_new)
+{
+	struct dirent *entry;
+	char path[PATH_MAX], *subbuf;
+	unsigned long long subbuf_kb = 0;
+	int cpu, fd;
+	DIR *d;
+
+	if (follow_parse_format(fl, use_new ? "amdgpu_device_rreg" : "amdgpu_mm_rreg", 0) ||
+	    follow_parse_format(fl, use_new ? "amdgpu_device_wreg" : "amdgpu_mm_wreg", 1))
+		return -1;
+	follow_parse_header_page(fl);
+
+	// the sub-buffers can be bigger than a page on recent kernels
+	fl->page_size = getpagesize();
+	subbuf = follow_read_file(TRACING_PATH "buffer_subbuf_size_kb");
+	if (subbuf && sscanf(subbuf, "%llu", &subbuf_kb) == 1 && subbuf_kb * 1024 > (unsigned long long)fl->page_size)
+		fl->page_size = subbuf_kb * 1024;
+	free(subbuf);
+
+	d = opendir(TRACING_PATH "per_cpu");
+	if (!d)
+		return -1;
+	while ((entry = readdir(d))) {
+		struct follow_cpu *cpus;
+
+		if (sscanf(entry->d_name, "cpu%d", &cpu) != 1)
+			continue;
+		snprintf(path, sizeof path, TRACING_PATH "per_cpu/%s/trace_pipe_raw", entry->d_name);
+		fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+		if (fd < 0)
+			continue;
+		cpus = realloc(fl->cpus, (fl->no_cpus + 1) * sizeof *cpus);
+		if (!cpus) {
+			close(fd);
+			break;
+		}
+		fl->cpus = cpus;
+		memset(&fl->cpus[fl->no_cpus], 0, sizeof *fl->cpus);
+		fl->cpus[fl->no_cpus].fl = fl;
+		fl->cpus[fl->no_cpus].fd = fd;
+		fl->cpus[fl->no_cpus].cache = calloc(SCAN_CACHE_SIZE, sizeof(struct scan_lookup));
+		fl->no_cpus++;
+	}
+	closedir(d);
+
+	for (cpu = 0; cpu < fl->no_cpus; cpu++)
+		if (fl->cpus[cpu].cache)
+			fl->cpus[cpu].has_thread = !pthread_create(&fl->cpus[cpu].thread, NULL, follow_cpu_thread, &fl->cpus[cpu]);
+	for (cpu = 0; cpu < fl->no_cpus; cpu++)
+		if (fl->cpus[cpu].has_thread)
+			return 0;
+	return -1;
+}
+
+static void follow_stop_raw(struct follow_log *fl)
+{
+	int cpu;
+
+	for (cpu = 0; cpu < fl->no_cpus; cpu++) {
+		if (fl->cpus[cpu].has_thread)
+			pthread_join(fl->cpus[cpu].thread, NULL);
+		close(fl->cpus[cpu].fd);
+		free(fl->cpus[cpu].cache);
+	}
+	free(fl->cpus);
+	fl->cpus = NULL;
+	fl->no_cpus = 0;
+}
+
+// decode the complete lines of the text trace_pipe, returns how many bytes were used
+static size_t follow_parse_text(struct follow_log *fl, struct scan_lookup *cache, const char *buf, size_t len)
+{
+	const char *p = buf, *eol, *ev, *end = buf + len;
+	unsigned long did, regno, value;
+	int write;
+
+	pthread_mutex_lock(&fl->lock);
+	while (p < end && (eol = memchr(p, '\n', end - p))) {
+		ev = memmem(p, eol - p, "amdgpu_", 7);
+		if (ev) {
+			ev += 7;
+			if (eol - ev > 7 && !memcmp(ev, "device_", 7))
+				ev += 7;
+			else if (eol - ev > 3 && !memcmp(ev, "mm_", 3))
+				ev += 3;
+			else
+				ev = NULL;
+			if (ev && !scan_event(ev, eol, &write, &did, &regno, &value))
+				follow_add(fl, cache, did, regno, value, write);
+		}
+		p = eol + 1;
+	}
+	pthread_mutex_unlock(&fl->lock);
+	return p - buf;
+}
+
+// print the registers with the most accesses so far
+static void follow_print(struct follow_log *fl, int top_n, double seconds)
+{
+	struct scan_hist_entry *e;
+	uint64_t reads = 0, writes = 0, recent = 0;
+	uint32_t i, n;
+
+	pthread_mutex_lock(&fl->lock);
+	e = calloc(fl->hist.used + 1, sizeof *e);
+	for (i = n = 0; e && i < fl->hist.size; i++) {
+		if (fl->hist.entries[i].reg) {
+			e[n++] = fl->hist.entries[i];
+			reads += fl->hist.entries[i].reads;
+			writes += fl->hist.entries[i].writes;
+			recent += fl->hist.entries[i].recent;
+			fl->hist.entries[i].recent = 0;
+		}
+	}
+	pthread_mutex_unlock(&fl->lock);
+	if (!e)
+		return;
+
+	qsort(e, n, sizeof *e, scan_hist_cmp);
+	printf("\n%" PRIu64 " reads, %" PRIu64 " writes, %.0f accesses/s, %" PRIu64 " events lost\n",
+		reads, writes, seconds > 0 ? recent / seconds : 0.0, fl->lost);
+	printf("%12s %12s %10s %10s  %s\n", "reads", "writes", "per sec", "last", "register");
+	for (i = 0; i < n && (int)i < top_n; i++)
+		printf("%12" PRIu64 " %12" PRIu64 " %10.0f 0x%08lx  %s.%s.%s\n", e[i].reads, e[i].writes,
+			seconds > 0 ? e[i].recent / seconds : 0.0, e[i].last,
+			fl->asic->asicname, e[i].ip->ipname, e[i].reg->regname);
+	fflush(stdout);
+	free(e);
+}
+
+/**
+ * umr_follow_log - Count the register accesses traced until interrupted
+ *
+ * @asic: The device whose accesses are counted
+ * @use_new: Whether the events are amdgpu_device_[rw]reg (else amdgpu_mm_[rw]reg)
+ * @top_n: How many registers to print each second
+ *
+ * The rreg/wreg events must be enabled.  Every second the @top_n most
+ * accessed registers are printed with their read/write counts so far, how
+ * often they were accessed in the last second and their last value.
+ *
+ * Returns 0 on success, -1 if the trace can't be read.
+ */
+int umr_follow_log(struct umr_asic *asic, int use_new, int top_n)
+{
+	struct follow_log fl;
+	struct scan_lookup *cache = NULL;
+	struct timespec last, now;
+	struct pollfd pfd;
+	void (*old_sigint)(int);
+	char *buf = NULL;
+	size_t used = 0;
+	ssize_t n;
+	double seconds;
+	int fd = -1, raw, r = -1;
+
+	memset(&fl, 0, sizeof fl);
+	fl.asic = asic;
+	pthread_mutex_init(&fl.lock, NULL);
+
+	// load the register database before the readers look registers up
+	umr_find_reg_by_addr(asic, 0, NULL);
+
+	follow_quit = 0;
+	old_sigint = signal(SIGINT, follow_sigint);
+
+	raw = !follow_start_raw(&fl, use_new);
+	if (!raw) {
+		follow_stop_raw(&fl);
+		fd = open(TRACING_PATH "trace_pipe", O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+		buf = malloc(65536);
+		cache = calloc(SCAN_CACHE_SIZE, sizeof *cache);
+		if (fd < 0 || !buf || !cache) {
+			asic->err_msg("[ERROR]: Cannot read " TRACING_PATH "trace_pipe\n");
+			goto out;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &last);
+	while (!follow_quit) {
+		if (raw) {
+			usleep(100000);
+		} else {
+			pfd.fd = fd;
+			pfd.events = POLLIN;
+			if (poll(&pfd, 1, 100) > 0) {
+				n = read(fd, buf + used, 65536 - used);
+				if (n < 0 && errno != EAGAIN && errno != EINTR)
+					break;
+				if (n > 0) {
+					used += n;
+					n = follow_parse_text(&fl, cache, buf, used);
+					// a line longer than the buffer is dropped
+					if (!n && used == 65536)
+						n = used;
+					memmove(buf, buf + n, used - n);
+					used -= n;
+				}
+			}
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		seconds = (now.tv_sec - last.tv_sec) + (now.tv_nsec - last.tv_nsec) / 1000000000.0;
+		if (seconds >= 1.0) {
+			follow_print(&fl, top_n, seconds);
+			last = now;
+		}
+	}
+	r = 0;
+out:
+	follow_quit = 1;
+	follow_stop_raw(&fl);
+	signal(SIGINT, old_sigint);
+	if (fd >= 0)
+		close(fd);
+	free(buf);
+	free(cache);
+	free(fl.hist.entries);
+	pthread_mutex_destroy(&fl.lock);
+	return r;
+}
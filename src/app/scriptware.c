@@ -40,36 +40,67 @@ static void helptext(umr_err_output errout)
     errout("\tpci-bus-to-instxcc <busno>\n\t\tTranslate a PCI bus address with XCC encoded PCI function into a pair of -i and -vmp\n\n");
     errout("\txcds <instance>\n\t\tList all GC partitions for a given device\n\n");
     errout("\tgfxname <instance>\n\t\tOutputs the base name for the GC IP block of a given GPU instance\n\n");
+    errout("\tbatch\n\t\tRead commands from stdin, one or more per line, and answer each line as it is read\n\n");
 }
 
-void umr_handle_scriptware(umr_err_output errout, char *database_path, char **argv, int argc)
+/*
+ * The devices are only listed (PCI bus address, DID and instance), a
+ * device is discovered the first time a command needs its IP blocks and
+ * kept for the rest of the commands.
+ */
+struct script_state {
+    umr_err_output errout;
+    char *database_path;
+    struct umr_device_id *ids;
+    int no_ids;
+    struct umr_asic **asics;    // asics[i] is ids[i] once discovered
+};
+
+static struct umr_asic *script_asic(struct script_state *s, int inst)
 {
-    struct umr_asic **devices;
-    int x, y, no_asics;
+    struct umr_options *options;
+    int y;
 
-    if (argc == 0) {
-        helptext(errout);
-        return;
-    }
+    for (y = 0; y < s->no_ids; y++)
+        if (s->ids[y].instance == inst)
+            break;
+    if (y == s->no_ids)
+        return NULL;
+    if (s->asics[y])
+        return s->asics[y];
 
-    if (umr_enumerate_device_list(errout, database_path, NULL, &devices, &no_asics, 0)) {
-        errout("[ERROR]: Could not enumerate AMDGPU devices on this host.\n");
-        return;
-    }
+    options = calloc(1, sizeof *options);
+    if (!options)
+        return NULL;
+    options->quiet = 1;
+    strncpy(options->database_path, s->database_path, sizeof(options->database_path) - 1);
+    if (sscanf(s->ids[y].pci_name, "%04x:%02x:%02x.%01x",
+            &options->pci.domain, &options->pci.bus, &options->pci.slot, &options->pci.func) == 4)
+        s->asics[y] = umr_discover_asic(options, s->errout);
+    free(options);
+    return s->asics[y];
+}
+
+// run the commands in argv[0..argc-1]
+static void script_commands(struct script_state *s, char **argv, int argc)
+{
+    umr_err_output errout = s->errout;
+    struct umr_asic *asic;
+    int x, y;
 
     for (x = 0; x < argc; x++) {
         if (!strcmp(argv[x], "instances")) {
-            for (y = 0; y < no_asics; y++) {
-                errout("%d ", devices[y]->instance);
+            for (y = 0; y < s->no_ids; y++) {
+                errout("%d ", s->ids[y].instance);
             }
             errout("\n");
         } else if (!strcmp(argv[x], "pci-instances")) {
             if (x + 1 < argc) {
                 uint32_t did;
                 sscanf(argv[x+1], "%"SCNx32, &did);
-                for (y = 0; y < no_asics; y++) {
-                    if (devices[y]->did == did) {
-                        errout("%d ", devices[y]->instance);
+                for (y = 0; y < s->no_ids; y++) {
+                    if (s->ids[y].did == did) {
+                        errout("%d ", s->ids[y].instance);
                     }
                 }
                 errout("\n");
@@ -81,9 +112,9 @@ void umr_handle_scriptware(umr_err_output errout, char *database_path, char **ar
             if (x + 1 < argc) {
                 int inst;
                 sscanf(argv[x+1], "%d", &inst);
-                for (y = 0; y < no_asics; y++) {
-                    if (devices[y]->instance == inst) {
-                        errout("0x%x ", devices[y]->did);
+                for (y = 0; y < s->no_ids; y++) {
+                    if (s->ids[y].instance == inst) {
+                        errout("0x%x ", s->ids[y].did);
                     }
                 }
                 errout("\n");
@@ -93,10 +124,9 @@ void umr_handle_scriptware(umr_err_output errout, char *database_path, char **ar
             }
         } else if (!strcmp(argv[x], "pci-bus-to-instance")) {
             if (x + 1 < argc) {
-                int y;
-                for (y = 0; y < no_asics; y++) {
-                    if (!strcmp(devices[y]->options.pci.name, argv[x+1])) {
-                        errout("%d ", devices[y]->instance);
+                for (y = 0; y < s->no_ids; y++) {
+                    if (!strcmp(s->ids[y].pci_name, argv[x+1])) {
+                        errout("%d ", s->ids[y].instance);
                         break;
                     }
                 }
@@ -107,16 +137,16 @@ void umr_handle_scriptware(umr_err_output errout, char *database_path, char **ar
             }
         } else if (!strcmp(argv[x], "pci-bus-to-instxcc")) {
             if (x + 1 < argc) {
-                int y, xcc = -1;
+                int xcc = -1;
                 char tmp[64];
-                strcpy(tmp, argv[x+1]);
+                snprintf(tmp, sizeof tmp, "%s", argv[x+1]);
                 if (isdigit(tmp[strlen(tmp)-1])) {
                     xcc = atoi(&tmp[strlen(tmp)-1]);
                     tmp[strlen(tmp)-1] = '0';
                 }
-                for (y = 0; y < no_asics; y++) {
-                    if (!strcmp(devices[y]->options.pci.name, tmp)) {
-                        errout("-i %d -vmp %d ", devices[y]->instance, xcc);
+                for (y = 0; y < s->no_ids; y++) {
+                    if (!strcmp(s->ids[y].pci_name, tmp)) {
+                        errout("-i %d -vmp %d ", s->ids[y].instance, xcc);
                         break;
                     }
                 }
@@ -129,9 +159,9 @@ void umr_handle_scriptware(umr_err_output errout, char *database_path, char **ar
             if (x + 1 < argc) {
                 int inst;
                 sscanf(argv[x+1], "%d", &inst);
-                for (y = 0; y < no_asics; y++) {
-                    if (devices[y]->instance == inst) {
-                        errout(devices[y]->options.pci.name);
+                for (y = 0; y < s->no_ids; y++) {
+                    if (s->ids[y].instance == inst) {
+                        errout("%s", s->ids[y].pci_name);
                     }
                 }
                 errout("\n");
@@ -143,21 +173,18 @@ void umr_handle_scriptware(umr_err_output errout, char *database_path, char **ar
             if (x + 1 < argc) {
                 int inst, z;
                 sscanf(argv[x+1], "%d", &inst);
-                for (y = 0; y < no_asics; y++) {
-                    if (devices[y]->instance == inst) {
-                        for (z = 0; z < devices[y]->no_blocks; z++) {
-                            if (strstr(devices[y]->blocks[z]->ipname, "gfx")) {
-                                uint32_t inst;
-                                char name[64];
-                                if (sscanf(devices[y]->blocks[z]->ipname, "%[0-9a-z]{%"SCNu32"}", name, &inst) == 2) {
-                                    errout("%s", name);
-                                    break;
-                                }
-                                // must be only GC instance
-                                errout("%s", devices[y]->blocks[z]->ipname);
-                                break;
-                            }
+                asic = script_asic(s, inst);
+                for (z = 0; asic && z < asic->no_blocks; z++) {
+                    if (strstr(asic->blocks[z]->ipname, "gfx")) {
+                        uint32_t inst;
+                        char name[64];
+                        if (sscanf(asic->blocks[z]->ipname, "%[0-9a-z]{%"SCNu32"}", name, &inst) == 2) {
+                            errout("%s", name);
+                            break;
                         }
+                        // must be only GC instance
+                        errout("%s", asic->blocks[z]->ipname);
+                        break;
                     }
                 }
                 errout("\n");
@@ -169,18 +196,15 @@ void umr_handle_scriptware(umr_err_output errout, char *database_path, char **ar
             if (x + 1 < argc) {
                 int inst, z;
                 sscanf(argv[x+1], "%d", &inst);
-                for (y = 0; y < no_asics; y++) {
-                    if (devices[y]->instance == inst) {
-                        for (z = 0; z < devices[y]->no_blocks; z++) {
-                            if (strstr(devices[y]->blocks[z]->ipname, "gfx")) {
-                                uint32_t inst;
-                                char name[64];
-                                if (sscanf(devices[y]->blocks[z]->ipname, "%[0-9a-z]{%"SCNu32"}", name, &inst) == 2) {
-                                    errout("%d ", inst);
-                                } else {
-                                    errout("-1 "); // support devices with only 1 GC IP block
-                                }
-                            }
+                asic = script_asic(s, inst);
+                for (z = 0; asic && z < asic->no_blocks; z++) {
+                    if (strstr(asic->blocks[z]->ipname, "gfx")) {
+                        uint32_t inst;
+                        char name[64];
+                        if (sscanf(asic->blocks[z]->ipname, "%[0-9a-z]{%"SCNu32"}", name, &inst) == 2) {
+                            errout("%d ", inst);
+                        } else {
+                            errout("-1 "); // support devices with only 1 GC IP block
                         }
                     }
                 }
@@ -190,6 +214,56 @@ void umr_handle_scriptware(umr_err_output errout, char *database_path, char **ar
                 errout("[ERROR]: 'xcds' --script command requires one parameter.\n");
             }
         }
-   }
+    }
+}
+
+// answer the commands read from stdin line by line until EOF
+static void script_batch(struct script_state *s)
+{
+    char line[1024], *argv[64], *p;
+    int argc;
+
+    while (fgets(line, sizeof line, stdin)) {
+        argc = 0;
+        for (p = strtok(line, " \t\r\n"); p && argc < 64; p = strtok(NULL, " \t\r\n"))
+            argv[argc++] = p;
+        if (argc && strcmp(argv[0], "batch"))
+            script_commands(s, argv, argc);
+        fflush(stdout);
+    }
+}
+
+void umr_handle_scriptware(umr_err_output errout, char *database_path, char **argv, int argc)
+{
+    struct script_state s;
+    int x;
+
+    if (argc == 0) {
+        helptext(errout);
+        return;
+    }
+
+    memset(&s, 0, sizeof s);
+    s.errout = errout;
+    s.database_path = database_path;
+    if (umr_enumerate_device_ids(errout, &s.ids, &s.no_ids)) {
+        errout("[ERROR]: Could not enumerate AMDGPU devices on this host.\n");
+        return;
+    }
+    s.asics = calloc(s.no_ids + 1, sizeof *s.asics);
+    if (!s.asics) {
+        free(s.ids);
+        return;
+    }
+
+    if (!strcmp(argv[0], "batch"))
+        script_batch(&s);
+    else
+        script_commands(&s, argv, argc);
+
+    for (x = 0; x < s.no_ids; x++)
+        if (s.asics[x])
+            umr_close_asic(s.asics[x]);
+    free(s.asics);
+    free(s.ids);
 }
- 
\ No newline at end of file
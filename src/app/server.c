@@ -25,6 +25,7 @@
 #include <string.h>
 #include "parson.h"
 #include "umr_rumr.h"
+#include "gui/wire.h"
 
 extern JSON_Value *umr_process_json_request(JSON_Object *request, void **raw_data, unsigned *raw_data_size);
 extern void init_asics(void);
@@ -32,23 +33,92 @@ extern struct umr_asic *asics[16];
 
 static struct rumr_comm_funcs *rumr_get_cf(char *arg, char **addr)
 {
+	const struct rumr_comm_funcs *funcs = rumr_comm_lookup(arg, addr);
 	struct rumr_comm_funcs *cf;
-	*addr = arg;
-
-	if (!memcmp(arg, "tcp://", 6)) {
-		cf = (struct rumr_comm_funcs *) calloc(1, sizeof rumr_tcp_funcs);
-		*cf = rumr_tcp_funcs;
-		cf->log_msg = printf;
-		*addr = &arg[6];
-		return cf;
+
+	if (!funcs)
+		return NULL;
+	cf = (struct rumr_comm_funcs *) calloc(1, sizeof *cf);
+	*cf = *funcs;
+	cf->log_msg = printf;
+	return cf;
+}
+
+// handle one JSON request of a client, see rumr_server_run()
+static int serve_json_request(struct rumr_server_state *state)
+{
+	struct rumr_comm_funcs *cf = &state->comm;
+	struct rumr_buffer *buffer;
+	JSON_Value *request;
+	uint32_t magic = UMR_WIRE_MAGIC;
+	char* buf;
+	int r, binary;
+
+	r = cf->rx(cf, &buffer);
+	if (r)
+		return (r < 0) ? -1 : 0; // 1 == nothing to receive after all
+
+	if (buffer->woffset == 0) {
+		rumr_buffer_free(buffer);
+		return 0;
+	}
+
+	// binary requests get binary replies, see wire.h
+	binary = buffer->woffset >= 4 && !memcmp(buffer->data, &magic, 4);
+	if (binary) {
+		request = umr_wire_decode(buffer->data + 4, buffer->woffset - 4, NULL);
+	} else {
+		buf = (char *)buffer->data;
+		buf[buffer->woffset - 1] = '\0';
+		request = json_parse_string(buf);
+	}
+
+	if (request == NULL || json_value_get_type(request) != JSONObject) {
+		printf("ERROR parsing %d bytes\n", buffer->woffset);
+		json_value_free(request);
+		rumr_buffer_free(buffer);
+		return 0;
+	}
+
+	rumr_buffer_free(buffer);
+
+	void *raw_data = NULL;
+	unsigned raw_data_size = 0;
+
+	// requests pick their own asic, umr_process_json_request() locks it
+	// (rather than rumr_server_lock()) so different asics are served at once
+	JSON_Value *answer = umr_process_json_request(
+		json_object(request), &raw_data, &raw_data_size);
+
+	buffer = rumr_buffer_init();
+	if (binary) {
+		rumr_buffer_add_uint32(buffer, magic);
+		rumr_buffer_add_uint32(buffer, raw_data_size);
+		umr_wire_encode(buffer, answer);
+	} else {
+		char* s = json_serialize_to_string(answer);
+
+		rumr_buffer_add_uint32(buffer, raw_data_size);
+		rumr_buffer_add_data(buffer, s, strlen(s) + 1);
+		json_free_serialized_string(s);
 	}
-	return NULL;
+	if (raw_data_size)
+		rumr_buffer_add_data(buffer, raw_data, raw_data_size);
+
+	if (buffer->failed || cf->tx(cf, buffer) < 0)
+		printf("tx failed\n");
+
+	json_value_free(answer);
+	free(raw_data);
+	rumr_buffer_free(buffer);
+	return 0;
 }
 
 void run_server_loop(const char *url, struct umr_asic * asic)
 {
 	char *cfp;
 	struct rumr_comm_funcs *cf = rumr_get_cf((char *)url, &cfp);
+	struct rumr_server_state state;
 
 	if (cf == NULL)
 		return;
@@ -64,60 +134,12 @@ void run_server_loop(const char *url, struct umr_asic * asic)
 		init_asics();
 	}
 
-	for (;;) {
-		if (cf->accept(cf) < 0) {
-			printf("TCP accept failed\n");
-			return;
-		}
-
-		/* Everything is ready. Wait for commands */
-		printf("Waiting for commands.\n");
-
-		struct rumr_buffer *buffer;
-		for (;;) {
-			char* buf;
-
-			if (cf->rx(cf, &buffer) < 0) {
-				cf->closeconn(cf);
-				break;
-			}
-
-			if (buffer->size == 0)
-				continue;
-
-			buf = (char *)buffer->data;
-			buf[buffer->woffset - 1] = '\0';
-			JSON_Value *request = json_parse_string(buf);
-
-			if (request == NULL) {
-				printf("ERROR parsing %d bytes\n", buffer->woffset);
-				rumr_buffer_free(buffer);
-				continue;
-			}
-
-			rumr_buffer_free(buffer);
-
-			void *raw_data = NULL;
-			unsigned raw_data_size = 0;
-			JSON_Value *answer = umr_process_json_request(
-				json_object(request), &raw_data, &raw_data_size);
-
-			char* s = json_serialize_to_string(answer);
-			size_t len = strlen(s) + 1;
-
-			buffer = rumr_buffer_init();
-			rumr_buffer_add_uint32(buffer, raw_data_size);
-			rumr_buffer_add_data(buffer, s, len);
-			if (raw_data_size)
-				rumr_buffer_add_data(buffer, raw_data, raw_data_size);
-
-			if (cf->tx(cf, buffer) < 0)
-				printf("tx failed\n");
-
-			json_free_serialized_string(s);
-			json_value_free(answer);
-			free(raw_data);
-			rumr_buffer_free(buffer);
-		}
-	}
+	/* Everything is ready. Wait for clients, several can be connected at once */
+	printf("Waiting for commands.\n");
+
+	memset(&state, 0, sizeof state);
+	state.comm = *cf;
+	state.log_msg = cf->log_msg;
+	state.handle = serve_json_request;
+	rumr_server_run(&state);
 }
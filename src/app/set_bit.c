@@ -25,18 +25,60 @@
 #include "umrapp.h"
 #include <inttypes.h>
 
-/* set a register based on regpath e.g.
+// write "FIELD=value[,FIELD=value...]" (values in hex) of @reg with one read-modify-write
+static int write_fields(struct umr_asic *asic, const char *regpath, struct umr_reg *reg, const char *fields)
+{
+	struct umr_field_update *updates;
+	char *list, *p, *eq, *save;
+	int n, r = -1;
+
+	for (n = 1, p = (char *)fields; (p = strchr(p, ',')); p++, n++);
+	updates = calloc(n, sizeof *updates);
+	list = strdup(fields);
+	if (!updates || !list)
+		goto out;
+
+	n = 0;
+	for (p = strtok_r(list, ",", &save); p; p = strtok_r(NULL, ",", &save)) {
+		eq = strchr(p, '=');
+		if (!eq) {
+			fprintf(stderr, "[ERROR]: Field '%s' has no '=value'\n", p);
+			goto out;
+		}
+		*eq = 0;
+		updates[n].reg = reg;
+		updates[n].bitname = p;
+		updates[n].value = strtoull(eq + 1, NULL, 16);
+		updates[n].use_bank = asic->options.use_bank;
+		updates[n].bank = asic->options.bank;
+		++n;
+	}
+
+	r = umr_write_fields(asic, updates, n, asic->options.verbose ? UMR_WRITE_FIELDS_VERIFY : 0);
+	if (r >= 0 && !asic->options.quiet)
+		printf("%s <= 0x%" PRIx64 "\n", regpath, updates[0].result);
+	if (r == 1) {
+		fprintf(stderr, "[WARNING]: %s did not read back as written\n", regpath);
+		r = 0;
+	}
+out:
+	free(updates);
+	free(list);
+	return r;
+}
+
+/* set bitfields of a register based on regpath e.g.
  *
- * stoney.uvd6.mmFOO.bit
+ * stoney.uvd6.mmFOO  FIELD=1,OTHER=3
+ *
+ * All the fields are written with one read-modify-write.
  */
-int umr_set_register_bit(struct umr_asic *asic, char *regpath, char *regvalue)
+int umr_set_register_bits(struct umr_asic *asic, char *regpath, char *fields)
 {
-	char asicname[128], ipname[128], regname[128], bitname[128], *p;
-	int i, j, k;
-	uint32_t value;
-	uint64_t scale, copy, mask;
+	char asicname[128], ipname[128], regname[128], *p;
+	int i, j;
 
-	if (sscanf(regpath, "%[^.].%[^.].%[^.].%[^.]", asicname, ipname, regname, bitname) != 4) {
+	if (sscanf(regpath, "%127[^.].%127[^.].%127[^.]", asicname, ipname, regname) != 3) {
 		fprintf(stderr, "[ERROR]: Invalid regpath for bit write\n");
 		return -1;
 	}
@@ -50,42 +92,10 @@ int umr_set_register_bit(struct umr_asic *asic, char *regpath, char *regvalue)
 		/* scan until we compare with regpath... */
 		for (i = 0; i < asic->no_blocks; i++) {
 			if (ipname[0] == '*' || !strcmp(ipname, asic->blocks[i]->ipname)) {
+				umr_load_ip_block(asic, asic->blocks[i]);
 				for (j = 0; j < asic->blocks[i]->no_regs; j++) {
-					if (!strcmp(regname, asic->blocks[i]->regs[j].regname) && asic->blocks[i]->regs[j].bits) {
-						for (k = 0; k < asic->blocks[i]->regs[j].no_bits; k++) {
-							if (!strcmp(bitname, asic->blocks[i]->regs[j].bits[k].regname)) {
-								sscanf(regvalue, "%"SCNx32, &value);
-
-								mask = (1ULL<<((1+asic->blocks[i]->regs[j].bits[k].stop)-asic->blocks[i]->regs[j].bits[k].start))-1;
-								mask <<= asic->blocks[i]->regs[j].bits[k].start;
-
-								// set this register
-								switch (asic->blocks[i]->regs[j].type){
-									case REG_MMIO: scale = 4; break;
-									case REG_DIDT: scale = 1; break;
-									case REG_PCIE: scale = 1; break;
-									case REG_SMC:  scale = 1; break;
-									default: return -1;
-								}
-
-								copy = asic->reg_funcs.read_reg(asic, asic->blocks[i]->regs[j].addr*scale, asic->blocks[i]->regs[j].type);
-								if (asic->blocks[i]->regs[j].bit64) {
-									copy |= (uint64_t)asic->reg_funcs.read_reg(asic, (asic->blocks[i]->regs[j].addr+1)*scale, asic->blocks[i]->regs[j].type) << 32;
-								}
-								// read-modify-write value back
-								copy &= ~mask;
-								value = ((uint64_t)value << asic->blocks[i]->regs[j].bits[k].start) & mask;
-								copy |= value;
-								asic->reg_funcs.write_reg(asic, asic->blocks[i]->regs[j].addr*scale, copy & 0xFFFFFFFFUL, asic->blocks[i]->regs[j].type);
-								if (asic->blocks[i]->regs[j].bit64) {
-									asic->reg_funcs.write_reg(asic, (asic->blocks[i]->regs[j].addr+1)*scale, copy>>32UL, asic->blocks[i]->regs[j].type);
-								}
-
-								if (!asic->options.quiet) printf("%s <= 0x%" PRIx64 "\n", regpath, (unsigned long)copy);
-								return 0;
-							}
-						}
-					}
+					if (!strcmp(regname, asic->blocks[i]->regs[j].regname) && asic->blocks[i]->regs[j].bits)
+						return write_fields(asic, regpath, &asic->blocks[i]->regs[j], fields);
 				}
 			}
 		}
@@ -96,9 +106,29 @@ int umr_set_register_bit(struct umr_asic *asic, char *regpath, char *regvalue)
 	} else {
 		char newregpath[768];
 		memset(newregpath, 0, sizeof newregpath);
-		snprintf(newregpath, sizeof(newregpath) - 1, "%s.%s.reg%s.%s", asicname, ipname, regname + 2, bitname);
+		snprintf(newregpath, sizeof(newregpath) - 1, "%s.%s.reg%s", asicname, ipname, regname + 2);
 		fprintf(stderr, "[WARNING]: Retrying operation with new 'reg' prefix path <%s>.\n", newregpath);
-		return umr_set_register_bit(asic, newregpath, regvalue);
+		return umr_set_register_bits(asic, newregpath, fields);
 	}
 }
 
+/* set a register based on regpath e.g.
+ *
+ * stoney.uvd6.mmFOO.bit
+ */
+int umr_set_register_bit(struct umr_asic *asic, char *regpath, char *regvalue)
+{
+	char path[512], field[256], *dot;
+	int n;
+
+	snprintf(path, sizeof path, "%s", regpath);
+	for (n = 0, dot = path; (dot = strchr(dot, '.')); dot++, n++);
+	if (n != 3) {
+		fprintf(stderr, "[ERROR]: Invalid regpath for bit write\n");
+		return -1;
+	}
+	dot = strrchr(path, '.');
+	*dot = 0;
+	snprintf(field, sizeof field, "%s=%s", dot + 1, regvalue);
+	return umr_set_register_bits(asic, path, field);
+}
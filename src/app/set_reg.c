@@ -50,6 +50,7 @@ int umr_set_register(struct umr_asic *asic, char *regpath, char *regvalue)
 		// scan all ip blocks for matching entry
 		for (i = 0; i < asic->no_blocks; i++) {
 			if (ipname[0] == '*' || !strcmp(ipname, asic->blocks[i]->ipname)) {
+				umr_load_ip_block(asic, asic->blocks[i]);
 				for (j = 0; j < asic->blocks[i]->no_regs; j++) {
 					if (!strcmp(regname, asic->blocks[i]->regs[j].regname)) {
 						sscanf(regvalue, "%"SCNx64, &value);
@@ -67,7 +68,7 @@ int umr_set_register(struct umr_asic *asic, char *regpath, char *regvalue)
 						asic->reg_funcs.write_reg(asic, asic->blocks[i]->regs[j].addr*scale, v32, asic->blocks[i]->regs[j].type);
 						if (asic->blocks[i]->regs[j].bit64) {
 							v32 = value >> 32;
-							asic->reg_funcs.write_reg(asic, (asic->blocks[i]->regs[j].addr+1)*scale, v32, asic->blocks[i]->regs[j].type);
+							asic->reg_funcs.write_reg(asic, asic->blocks[i]->regs[j].addr*scale + 4, v32, asic->blocks[i]->regs[j].type);
 						}
 
 						return 0;
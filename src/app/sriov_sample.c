@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umrapp.h"
+#include <time.h>
+#include <errno.h>
+
+// samples taken per interval
+#define SRIOV_SAMPLES_PER_INTERVAL 200
+
+static void sriov_add_ns(struct timespec *ts, uint64_t ns)
+{
+	ns += ts->tv_nsec;
+	ts->tv_sec += ns / 1000000000ULL;
+	ts->tv_nsec = ns % 1000000000ULL;
+}
+
+static double pct(uint64_t n, uint64_t samples)
+{
+	return samples ? 100.0 * n / samples : 0.0;
+}
+
+static void print_interval(FILE *out, const struct umr_sriov_vf *vfs, int no_vfs,
+			   const struct umr_sriov_fcn_stats *st, uint64_t samples, uint64_t t_ms)
+{
+	char name[16], fences[24];
+	int i;
+
+	for (i = 0; i <= no_vfs; i++) {
+		if (i < no_vfs)
+			snprintf(name, sizeof name, "VF%02d", vfs[i].index);
+		else
+			strcpy(name, "PF");
+		if (st[i].has_rings)
+			snprintf(fences, sizeof fences, "%" PRIu64, st[i].fences);
+		else
+			strcpy(fences, "-");
+		fprintf(out, "%8" PRIu64 " %-5s %6.1f%% %6.1f%% %6.1f%% %6.1f%% %8" PRIu64 " %8s\n",
+			t_ms, name, pct(st[i].active, samples), pct(st[i].gfx_busy, samples),
+			pct(st[i].sdma_busy, samples), pct(st[i].doorbell, samples), st[i].switches, fences);
+	}
+}
+
+static void jsonl_interval(const struct umr_sriov_vf *vfs, int no_vfs,
+			   const struct umr_sriov_fcn_stats *st, uint64_t samples, uint64_t t_ms)
+{
+	int i;
+
+	for (i = 0; i <= no_vfs; i++) {
+		umr_jsonl_begin("sriov_sample");
+		umr_jsonl_u64("time_ms", t_ms);
+		if (i < no_vfs) {
+			umr_jsonl_int("vf", vfs[i].index);
+			umr_jsonl_str("pci", vfs[i].pci_name);
+		} else {
+			umr_jsonl_bool("pf", 1);
+		}
+		umr_jsonl_u64("samples", samples);
+		umr_jsonl_u64("active", st[i].active);
+		umr_jsonl_u64("gfx_busy", st[i].gfx_busy);
+		umr_jsonl_u64("sdma_busy", st[i].sdma_busy);
+		umr_jsonl_u64("doorbell", st[i].doorbell);
+		umr_jsonl_u64("switches", st[i].switches);
+		if (st[i].has_rings)
+			umr_jsonl_u64("fences", st[i].fences);
+		umr_jsonl_end();
+	}
+}
+
+/**
+ * umr_sriov_sample_print - Print the activity of the VFs of a PF over time
+ *
+ * @asic: The PF
+ * @ms: Length of an interval
+ * @count: Number of intervals to print
+ *
+ * The VFs are found through sysfs and sampled together from the RLC IOV
+ * registers of the PF, SRIOV_SAMPLES_PER_INTERVAL times per interval on
+ * absolute deadlines.  Every interval prints one line per VF and one for
+ * the PF: the share of samples the function owned the GFX engine, had
+ * its VM busy, had an SDMA queue busy or a doorbell pending, the number
+ * of world switches to it and, for VFs bound to amdgpu on the host, the
+ * fences signaled on its rings.
+ */
+int umr_sriov_sample_print(struct umr_asic *asic, unsigned ms, unsigned count)
+{
+	struct umr_sriov_vf vfs[UMR_SRIOV_MAX_VFS];
+	struct umr_sriov_fcn_stats st[UMR_SRIOV_MAX_VFS + 1];
+	struct umr_sriov_sampler *s;
+	struct timespec deadline;
+	uint64_t step_ns, samples;
+	unsigned n, k;
+	int no_vfs, i;
+	FILE *out;
+
+	no_vfs = umr_sriov_list_vfs(asic, vfs, UMR_SRIOV_MAX_VFS);
+	if (no_vfs < 0)
+		return -1;
+	if (!no_vfs)
+		asic->err_msg("[WARNING]: SR-IOV is not enabled on %s, only the PF is sampled\n", asic->options.pci.name);
+
+	s = umr_sriov_sampler_open(asic, vfs, no_vfs);
+	if (!s)
+		return -1;
+
+	if (!asic->options.jsonl) {
+		out = umr_output_begin(asic);
+		for (i = 0; i < no_vfs; i++)
+			if (vfs[i].instance >= 0)
+				fprintf(out, "VF%02d %s (dri instance %d)\n", vfs[i].index, vfs[i].pci_name, vfs[i].instance);
+			else
+				fprintf(out, "VF%02d %s\n", vfs[i].index, vfs[i].pci_name);
+		fprintf(out, "%8s %-5s %7s %7s %7s %7s %8s %8s\n",
+			"time_ms", "fcn", "active", "gfx", "sdma", "db", "switches", "fences");
+		umr_output_end(asic);
+	}
+
+	step_ns = (uint64_t)ms * 1000000ULL / SRIOV_SAMPLES_PER_INTERVAL;
+	if (!step_ns)
+		step_ns = 1;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	for (n = 0; n < count; n++) {
+		for (k = 0; k < SRIOV_SAMPLES_PER_INTERVAL; k++) {
+			umr_sriov_sampler_sample(s);
+			sriov_add_ns(&deadline, step_ns);
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR);
+		}
+		umr_sriov_sampler_take(s, st, &samples);
+		if (asic->options.jsonl) {
+			jsonl_interval(vfs, no_vfs, st, samples, (uint64_t)(n + 1) * ms);
+		} else {
+			out = umr_output_begin(asic);
+			print_interval(out, vfs, no_vfs, st, samples, (uint64_t)(n + 1) * ms);
+			umr_output_end(asic);
+		}
+	}
+	umr_sriov_sampler_close(s);
+	return 0;
+}
@@ -26,6 +26,11 @@
 #include <linux/pci_regs.h>
 #include <ncurses.h>
 #include <time.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <netdb.h>
+#include <sys/socket.h>
 
 #define REG_USE_PG_LOCK (1UL)
 
@@ -35,6 +40,8 @@ static struct {
 	    vram,
 	    high_precision,
 	    high_frequency,
+	    turbo,
+	    adaptive,
 	    all,
 	    logger,
 	    drm;
@@ -51,10 +58,6 @@ static struct {
 	} vi;
 	char *helptext;
 	void (*handle_key)(int ch);
-	struct {
-		int num_vf,
-		    active_vf;
-	} sriov;
 } top_options;
 
 enum sensor_maps {
@@ -83,227 +86,227 @@ enum iov_print {
 };
 
 static struct umr_bitfield stat_grbm_bits[] = {
-	 { "TA_BUSY", 255, 255, &umr_bitfield_default },
-	 { "GDS_BUSY", 255, 255, &umr_bitfield_default },
-	 { "WD_BUSY_NO_DMA", 255, 255, &umr_bitfield_default },
-	 { "VGT_BUSY", 255, 255, &umr_bitfield_default },
-	 { "IA_BUSY_NO_DMA", 255, 255, &umr_bitfield_default },
-	 { "IA_BUSY", 255, 255, &umr_bitfield_default },
-	 { "SX_BUSY", 255, 255, &umr_bitfield_default },
-	 { "WD_BUSY", 255, 255, &umr_bitfield_default },
-	 { "SPI_BUSY", 255, 255, &umr_bitfield_default },
-	 { "BCI_BUSY", 255, 255, &umr_bitfield_default },
-	 { "SC_BUSY", 255, 255, &umr_bitfield_default },
-	 { "PA_BUSY", 255, 255, &umr_bitfield_default },
-	 { "DB_BUSY", 255, 255, &umr_bitfield_default },
-	 { "CP_COHERENCY_BUSY", 255, 255, &umr_bitfield_default },
-	 { "CP_BUSY", 255, 255, &umr_bitfield_default },
-	 { "CB_BUSY", 255, 255, &umr_bitfield_default },
-	 { "GUI_ACTIVE", 255, 255, &umr_bitfield_default },
-	 { "GE_BUSY",  255, 255, &umr_bitfield_default },
-	 { NULL, 0, 0, NULL },
+	 { "TA_BUSY", 255, 255 },
+	 { "GDS_BUSY", 255, 255 },
+	 { "WD_BUSY_NO_DMA", 255, 255 },
+	 { "VGT_BUSY", 255, 255 },
+	 { "IA_BUSY_NO_DMA", 255, 255 },
+	 { "IA_BUSY", 255, 255 },
+	 { "SX_BUSY", 255, 255 },
+	 { "WD_BUSY", 255, 255 },
+	 { "SPI_BUSY", 255, 255 },
+	 { "BCI_BUSY", 255, 255 },
+	 { "SC_BUSY", 255, 255 },
+	 { "PA_BUSY", 255, 255 },
+	 { "DB_BUSY", 255, 255 },
+	 { "CP_COHERENCY_BUSY", 255, 255 },
+	 { "CP_BUSY", 255, 255 },
+	 { "CB_BUSY", 255, 255 },
+	 { "GUI_ACTIVE", 255, 255 },
+	 { "GE_BUSY",  255, 255 },
+	 { NULL, 0, 0 },
 };
 
 static struct umr_bitfield stat_grbm2_bits[] = {
-	 { "RLC_BUSY", 255, 255, &umr_bitfield_default },
-	 { "TC_BUSY", 255, 255, &umr_bitfield_default },
-	 { "CPF_BUSY", 255, 255, &umr_bitfield_default },
-	 { "CPC_BUSY", 255, 255, &umr_bitfield_default },
-	 { "CPG_BUSY", 255, 255, &umr_bitfield_default },
-	 { NULL, 0, 0, NULL },
+	 { "RLC_BUSY", 255, 255 },
+	 { "TC_BUSY", 255, 255 },
+	 { "CPF_BUSY", 255, 255 },
+	 { "CPC_BUSY", 255, 255 },
+	 { "CPG_BUSY", 255, 255 },
+	 { NULL, 0, 0 },
 };
 
 // The VF virtual bits are remapped from the active VF field
 static struct umr_bitfield stat_rlc_iov_bits[] = {
-	 { "VF00", 0, IOV_VF, &umr_bitfield_default },
-	 { "VF01", 1, IOV_VF, &umr_bitfield_default },
-	 { "VF02", 2, IOV_VF, &umr_bitfield_default },
-	 { "VF03", 3, IOV_VF, &umr_bitfield_default },
-	 { "VF04", 4, IOV_VF, &umr_bitfield_default },
-	 { "VF05", 5, IOV_VF, &umr_bitfield_default },
-	 { "VF06", 6, IOV_VF, &umr_bitfield_default },
-	 { "VF07", 7, IOV_VF, &umr_bitfield_default },
-	 { "VF08", 8, IOV_VF, &umr_bitfield_default },
-	 { "VF09", 9, IOV_VF, &umr_bitfield_default },
-	 { "VF0A", 10, IOV_VF, &umr_bitfield_default },
-	 { "VF0B", 11, IOV_VF, &umr_bitfield_default },
-	 { "VF0C", 12, IOV_VF, &umr_bitfield_default },
-	 { "VF0D", 13, IOV_VF, &umr_bitfield_default },
-	 { "VF0E", 14, IOV_VF, &umr_bitfield_default },
-	 { "VF0F", 15, IOV_VF, &umr_bitfield_default },
-	 { "PF_VF", 0, IOV_PF, &umr_bitfield_default },
-	 { NULL, 0, 0, NULL },
+	 { "VF00", 0, IOV_VF },
+	 { "VF01", 1, IOV_VF },
+	 { "VF02", 2, IOV_VF },
+	 { "VF03", 3, IOV_VF },
+	 { "VF04", 4, IOV_VF },
+	 { "VF05", 5, IOV_VF },
+	 { "VF06", 6, IOV_VF },
+	 { "VF07", 7, IOV_VF },
+	 { "VF08", 8, IOV_VF },
+	 { "VF09", 9, IOV_VF },
+	 { "VF0A", 10, IOV_VF },
+	 { "VF0B", 11, IOV_VF },
+	 { "VF0C", 12, IOV_VF },
+	 { "VF0D", 13, IOV_VF },
+	 { "VF0E", 14, IOV_VF },
+	 { "VF0F", 15, IOV_VF },
+	 { "PF_VF", 0, IOV_PF },
+	 { NULL, 0, 0 },
 };
 
 static struct umr_bitfield stat_uvdclk_bits[] = {
-	 { "UDEC_SCLK", 255, 255, &umr_bitfield_default },
-	 { "MPEG2_SCLK", 255, 255, &umr_bitfield_default },
-	 { "IDCT_SCLK", 255, 255, &umr_bitfield_default },
-	 { "MPRD_SCLK", 255, 255, &umr_bitfield_default },
-	 { "MPC_SCLK", 255, 255, &umr_bitfield_default },
-	 { NULL, 0, 0, NULL },
+	 { "UDEC_SCLK", 255, 255 },
+	 { "MPEG2_SCLK", 255, 255 },
+	 { "IDCT_SCLK", 255, 255 },
+	 { "MPRD_SCLK", 255, 255 },
+	 { "MPC_SCLK", 255, 255 },
+	 { NULL, 0, 0 },
 };
 
 static struct umr_bitfield stat_ta_bits[] = {
-	 { "IN_BUSY", 255, 255, &umr_bitfield_default },
-	 { "FG_BUSY", 255, 255, &umr_bitfield_default },
-	 { "LA_BUSY", 255, 255, &umr_bitfield_default },
-	 { "FL_BUSY", 255, 255, &umr_bitfield_default },
-	 { "TA_BUSY", 255, 255, &umr_bitfield_default },
-	 { "FA_BUSY", 255, 255, &umr_bitfield_default },
-	 { "AL_BUSY", 255, 255, &umr_bitfield_default },
-	 { NULL, 0, 0, NULL },
+	 { "IN_BUSY", 255, 255 },
+	 { "FG_BUSY", 255, 255 },
+	 { "LA_BUSY", 255, 255 },
+	 { "FL_BUSY", 255, 255 },
+	 { "TA_BUSY", 255, 255 },
+	 { "FA_BUSY", 255, 255 },
+	 { "AL_BUSY", 255, 255 },
+	 { NULL, 0, 0 },
 };
 
 static struct umr_bitfield stat_vgt_bits[] = {
-	 { "VGT_BUSY", 255, 255, &umr_bitfield_default },
-	 { "VGT_OUT_INDX_BUSY", 255, 255, &umr_bitfield_default },
-	 { "VGT_OUT_BUSY", 255, 255, &umr_bitfield_default },
-	 { "VGT_PT_BUSY", 255, 255, &umr_bitfield_default },
-	 { "VGT_TE_BUSY", 255, 255, &umr_bitfield_default },
-	 { "VGT_VR_BUSY", 255, 255, &umr_bitfield_default },
-	 { "VGT_PI_BUSY", 255, 255, &umr_bitfield_default },
-	 { "VGT_GS_BUSY", 255, 255, &umr_bitfield_default },
-	 { "VGT_HS_BUSY", 255, 255, &umr_bitfield_default },
-	 { "VGT_TE11_BUSY", 255, 255, &umr_bitfield_default },
-	 { NULL, 0, 0, NULL },
+	 { "VGT_BUSY", 255, 255 },
+	 { "VGT_OUT_INDX_BUSY", 255, 255 },
+	 { "VGT_OUT_BUSY", 255, 255 },
+	 { "VGT_PT_BUSY", 255, 255 },
+	 { "VGT_TE_BUSY", 255, 255 },
+	 { "VGT_VR_BUSY", 255, 255 },
+	 { "VGT_PI_BUSY", 255, 255 },
+	 { "VGT_GS_BUSY", 255, 255 },
+	 { "VGT_HS_BUSY", 255, 255 },
+	 { "VGT_TE11_BUSY", 255, 255 },
+	 { NULL, 0, 0 },
 };
 
 static struct umr_bitfield stat_rlc_gpm_bits[] = {
-	 { "GFX_POWER_STATUS", 255, 255, &umr_bitfield_default },
-	 { "GFX_CLOCK_STATUS", 255, 255, &umr_bitfield_default },
-	 { "GFX_LS_STATUS", 255, 255, &umr_bitfield_default },
-	 { "GFX_PIPELINE_POWER_STATUS",255, 255, &umr_bitfield_default },
-	 { NULL, 0, 0, NULL },
+	 { "GFX_POWER_STATUS", 255, 255 },
+	 { "GFX_CLOCK_STATUS", 255, 255 },
+	 { "GFX_LS_STATUS", 255, 255 },
+	 { "GFX_PIPELINE_POWER_STATUS",255, 255 },
+	 { NULL, 0, 0 },
 };
 
 static struct umr_bitfield stat_uvd_pgfsm1_bits[] = {
-	 { "UVD_PGFSM_READ_TILE1_VALUE", 255, 255, &umr_bitfield_default },
-	 { NULL, 0, 0, NULL },
+	 { "UVD_PGFSM_READ_TILE1_VALUE", 255, 255 },
+	 { NULL, 0, 0 },
 };
 static struct umr_bitfield stat_uvd_pgfsm2_bits[] = {
-	 { "UVD_PGFSM_READ_TILE2_VALUE", 255, 255, &umr_bitfield_default },
-	 { NULL, 0, 0, NULL },
+	 { "UVD_PGFSM_READ_TILE2_VALUE", 255, 255 },
+	 { NULL, 0, 0 },
 };
 static struct umr_bitfield stat_uvd_pgfsm3_bits[] = {
-	 { "UVD_PGFSM_READ_TILE3_VALUE", 255, 255, &umr_bitfield_default },
-	 { NULL, 0, 0, NULL },
+	 { "UVD_PGFSM_READ_TILE3_VALUE", 255, 255 },
+	 { NULL, 0, 0 },
 };
 static struct umr_bitfield stat_uvd_pgfsm4_bits[] = {
-	 { "UVD_PGFSM_READ_TILE4_VALUE", 255, 255, &umr_bitfield_default },
-	 { NULL, 0, 0, NULL },
+	 { "UVD_PGFSM_READ_TILE4_VALUE", 255, 255 },
+	 { NULL, 0, 0 },
 };
 static struct umr_bitfield stat_uvd_pgfsm5_bits[] = {
-	 { "UVD_PGFSM_READ_TILE5_VALUE", 255, 255, &umr_bitfield_default },
-	 { NULL, 0, 0, NULL },
+	 { "UVD_PGFSM_READ_TILE5_VALUE", 255, 255 },
+	 { NULL, 0, 0 },
 };
 static struct umr_bitfield stat_uvd_pgfsm6_bits[] = {
-	 { "UVD_PGFSM_READ_TILE6_VALUE", 255, 255, &umr_bitfield_default },
-	 { NULL, 0, 0, NULL },
+	 { "UVD_PGFSM_READ_TILE6_VALUE", 255, 255 },
+	 { NULL, 0, 0 },
 };
 static struct umr_bitfield stat_uvd_pgfsm7_bits[] = {
-	 { "UVD_PGFSM_READ_TILE7_VALUE", 255, 255, &umr_bitfield_default },
-	 { NULL, 0, 0, NULL },
+	 { "UVD_PGFSM_READ_TILE7_VALUE", 255, 255 },
+	 { NULL, 0, 0 },
 };
 static struct umr_bitfield stat_mc_hub_bits[] = {
-	 { "OUTSTANDING_READ", 255, 255, &umr_bitfield_default },
-	 { "OUTSTANDING_WRITE", 255, 255, &umr_bitfield_default },
-	 { "OUTSTANDING_HUB_RDREQ", 255, 255, &umr_bitfield_default },
-	 { "OUTSTANDING_HUB_RDRET", 255, 255, &umr_bitfield_default },
-	 { "OUTSTANDING_HUB_WRREQ", 255, 255, &umr_bitfield_default },
-	 { "OUTSTANDING_HUB_WRRET", 255, 255, &umr_bitfield_default },
-	 { "OUTSTANDING_RPB_READ", 255, 255, &umr_bitfield_default },
-	 { "OUTSTANDING_RPB_WRITE", 255, 255, &umr_bitfield_default },
-	 { "OUTSTANDING_MCD_READ", 255, 255, &umr_bitfield_default },
-	 { "OUTSTANDING_MCD_WRITE", 255, 255, &umr_bitfield_default },
-	 { NULL, 0, 0, NULL },
+	 { "OUTSTANDING_READ", 255, 255 },
+	 { "OUTSTANDING_WRITE", 255, 255 },
+	 { "OUTSTANDING_HUB_RDREQ", 255, 255 },
+	 { "OUTSTANDING_HUB_RDRET", 255, 255 },
+	 { "OUTSTANDING_HUB_WRREQ", 255, 255 },
+	 { "OUTSTANDING_HUB_WRRET", 255, 255 },
+	 { "OUTSTANDING_RPB_READ", 255, 255 },
+	 { "OUTSTANDING_RPB_WRITE", 255, 255 },
+	 { "OUTSTANDING_MCD_READ", 255, 255 },
+	 { "OUTSTANDING_MCD_WRITE", 255, 255 },
+	 { NULL, 0, 0 },
 };
 
 static struct umr_bitfield stat_sdma_bits[] = {
-	{ "SDMA_RQ_PENDING", 255, 255, &umr_bitfield_default },
-	{ "SDMA1_RQ_PENDING", 255, 255, &umr_bitfield_default },
-	{ "SDMA_BUSY", 255, 255, &umr_bitfield_default },
-	{ "SDMA1_BUSY",255, 255, &umr_bitfield_default },
-	{ "SDMA2_BUSY", 255, 255, &umr_bitfield_default },
-	{ "SDMA3_BUSY", 255, 255, &umr_bitfield_default },
-	{ "SDMA2_RQ_PENDING", 255, 255, &umr_bitfield_default },
-	{ "SDMA3_RQ_PENDING", 255, 255, &umr_bitfield_default },
-	{ NULL, 0, 0, NULL },
+	{ "SDMA_RQ_PENDING", 255, 255 },
+	{ "SDMA1_RQ_PENDING", 255, 255 },
+	{ "SDMA_BUSY", 255, 255 },
+	{ "SDMA1_BUSY",255, 255 },
+	{ "SDMA2_BUSY", 255, 255 },
+	{ "SDMA3_BUSY", 255, 255 },
+	{ "SDMA2_RQ_PENDING", 255, 255 },
+	{ "SDMA3_RQ_PENDING", 255, 255 },
+	{ NULL, 0, 0 },
 };
 
 static struct umr_bitfield stat_srbm_status2_vce_bits[] = {
-	{ "VCE0_BUSY", 255, 255, &umr_bitfield_default },
-	{ "VCE1_BUSY", 255, 255, &umr_bitfield_default },
-	{ NULL, 0, 0, NULL },
+	{ "VCE0_BUSY", 255, 255 },
+	{ "VCE1_BUSY", 255, 255 },
+	{ NULL, 0, 0 },
 };
 
 static struct umr_bitfield stat_srbm_status_uvd_bits[] = {
-	{ "UVD_BUSY", 255, 255, &umr_bitfield_default },
-	{ NULL, 0, 0, NULL },
+	{ "UVD_BUSY", 255, 255 },
+	{ NULL, 0, 0 },
 };
 
 static struct umr_bitfield stat_carrizo_sensor_bits[] = {
-	{ "GFX_SCLK", AMDGPU_PP_SENSOR_GFX_SCLK, SENSOR_D100|(SENSOR_MHZ<<4), &umr_bitfield_default },
-	{ "VDD_NB", AMDGPU_PP_SENSOR_VDDNB, SENSOR_MILLIVOLT<<4, &umr_bitfield_default },
-	{ "VDD_GFX", AMDGPU_PP_SENSOR_VDDGFX, SENSOR_MILLIVOLT<<4, &umr_bitfield_default },
-	{ "UVD_VCLK", AMDGPU_PP_SENSOR_UVD_VCLK, SENSOR_D100|(SENSOR_MHZ<<4), &umr_bitfield_default },
-	{ "UVD_DCLK", AMDGPU_PP_SENSOR_UVD_DCLK, SENSOR_D100|(SENSOR_MHZ<<4), &umr_bitfield_default },
-	{ "VCE_ECCLK", AMDGPU_PP_SENSOR_VCE_ECCLK, SENSOR_D100|(SENSOR_MHZ<<4), &umr_bitfield_default },
-	{ "GPU_LOAD", AMDGPU_PP_SENSOR_GPU_LOAD, SENSOR_PERCENT<<4, &umr_bitfield_default },
-	{ "GPU_TEMP", AMDGPU_PP_SENSOR_GPU_TEMP, SENSOR_D1000|(SENSOR_TEMP<<4), &umr_bitfield_default },
-	{ NULL, 0, 0, NULL },
+	{ "GFX_SCLK", AMDGPU_PP_SENSOR_GFX_SCLK, SENSOR_D100|(SENSOR_MHZ<<4) },
+	{ "VDD_NB", AMDGPU_PP_SENSOR_VDDNB, SENSOR_MILLIVOLT<<4 },
+	{ "VDD_GFX", AMDGPU_PP_SENSOR_VDDGFX, SENSOR_MILLIVOLT<<4 },
+	{ "UVD_VCLK", AMDGPU_PP_SENSOR_UVD_VCLK, SENSOR_D100|(SENSOR_MHZ<<4) },
+	{ "UVD_DCLK", AMDGPU_PP_SENSOR_UVD_DCLK, SENSOR_D100|(SENSOR_MHZ<<4) },
+	{ "VCE_ECCLK", AMDGPU_PP_SENSOR_VCE_ECCLK, SENSOR_D100|(SENSOR_MHZ<<4) },
+	{ "GPU_LOAD", AMDGPU_PP_SENSOR_GPU_LOAD, SENSOR_PERCENT<<4 },
+	{ "GPU_TEMP", AMDGPU_PP_SENSOR_GPU_TEMP, SENSOR_D1000|(SENSOR_TEMP<<4) },
+	{ NULL, 0, 0 },
 };
 
 static struct umr_bitfield stat_vi_sensor_bits[] = {
-	{ "GFX_SCLK", AMDGPU_PP_SENSOR_GFX_SCLK, SENSOR_D100|(SENSOR_MHZ<<4), &umr_bitfield_default },
-	{ "GFX_MCLK", AMDGPU_PP_SENSOR_GFX_MCLK, SENSOR_D100|(SENSOR_MHZ<<4), &umr_bitfield_default },
-	{ "GPU_LOAD", AMDGPU_PP_SENSOR_GPU_LOAD, SENSOR_PERCENT<<4, &umr_bitfield_default },
-	{ "MEM_LOAD", AMDGPU_PP_SENSOR_MEM_LOAD, SENSOR_PERCENT<<4, &umr_bitfield_default },
-	{ "GPU_TEMP", AMDGPU_PP_SENSOR_GPU_TEMP, SENSOR_D1000|(SENSOR_TEMP<<4), &umr_bitfield_default },
-	{ "AVG_GPU",  AMDGPU_PP_SENSOR_GPU_POWER, SENSOR_WATT|(SENSOR_POWER<<4), &umr_bitfield_default },
-	{ NULL, 0, 0, NULL },
+	{ "GFX_SCLK", AMDGPU_PP_SENSOR_GFX_SCLK, SENSOR_D100|(SENSOR_MHZ<<4) },
+	{ "GFX_MCLK", AMDGPU_PP_SENSOR_GFX_MCLK, SENSOR_D100|(SENSOR_MHZ<<4) },
+	{ "GPU_LOAD", AMDGPU_PP_SENSOR_GPU_LOAD, SENSOR_PERCENT<<4 },
+	{ "MEM_LOAD", AMDGPU_PP_SENSOR_MEM_LOAD, SENSOR_PERCENT<<4 },
+	{ "GPU_TEMP", AMDGPU_PP_SENSOR_GPU_TEMP, SENSOR_D1000|(SENSOR_TEMP<<4) },
+	{ "AVG_GPU",  AMDGPU_PP_SENSOR_GPU_POWER, SENSOR_WATT|(SENSOR_POWER<<4) },
+	{ NULL, 0, 0 },
 };
 
 static struct umr_bitfield stat_cik_sensor_bits[] = {
-	{ "GFX_SCLK", AMDGPU_PP_SENSOR_GFX_SCLK, SENSOR_D100|(SENSOR_MHZ<<4), &umr_bitfield_default },
-	{ "GFX_MCLK", AMDGPU_PP_SENSOR_GFX_MCLK, SENSOR_D100|(SENSOR_MHZ<<4), &umr_bitfield_default },
-	{ "GPU_LOAD", AMDGPU_PP_SENSOR_GPU_LOAD, SENSOR_PERCENT<<4, &umr_bitfield_default },
-	{ "MEM_LOAD", AMDGPU_PP_SENSOR_MEM_LOAD, SENSOR_PERCENT<<4, &umr_bitfield_default },
-	{ "GPU_TEMP", AMDGPU_PP_SENSOR_GPU_TEMP, SENSOR_D1000|(SENSOR_TEMP<<4), &umr_bitfield_default },
-	{ NULL, 0, 0, NULL },
+	{ "GFX_SCLK", AMDGPU_PP_SENSOR_GFX_SCLK, SENSOR_D100|(SENSOR_MHZ<<4) },
+	{ "GFX_MCLK", AMDGPU_PP_SENSOR_GFX_MCLK, SENSOR_D100|(SENSOR_MHZ<<4) },
+	{ "GPU_LOAD", AMDGPU_PP_SENSOR_GPU_LOAD, SENSOR_PERCENT<<4 },
+	{ "MEM_LOAD", AMDGPU_PP_SENSOR_MEM_LOAD, SENSOR_PERCENT<<4 },
+	{ "GPU_TEMP", AMDGPU_PP_SENSOR_GPU_TEMP, SENSOR_D1000|(SENSOR_TEMP<<4) },
+	{ NULL, 0, 0 },
 };
 
 static struct umr_bitfield stat_kaveri_sensor_bits[] = {
-	{ "GFX_SCLK", AMDGPU_PP_SENSOR_GFX_SCLK, SENSOR_D100|(SENSOR_MHZ<<4), &umr_bitfield_default },
-	{ "GPU_TEMP", AMDGPU_PP_SENSOR_GPU_TEMP, SENSOR_D1000|(SENSOR_TEMP<<4), &umr_bitfield_default },
-	{ NULL, 0, 0, NULL },
+	{ "GFX_SCLK", AMDGPU_PP_SENSOR_GFX_SCLK, SENSOR_D100|(SENSOR_MHZ<<4) },
+	{ "GPU_TEMP", AMDGPU_PP_SENSOR_GPU_TEMP, SENSOR_D1000|(SENSOR_TEMP<<4) },
+	{ NULL, 0, 0 },
 };
 
 static struct umr_bitfield stat_si_sensor_bits[] = {
-	{ "GFX_SCLK", AMDGPU_PP_SENSOR_GFX_SCLK, SENSOR_D100|(SENSOR_MHZ<<4), &umr_bitfield_default },
-	{ "GFX_MCLK", AMDGPU_PP_SENSOR_GFX_MCLK, SENSOR_D100|(SENSOR_MHZ<<4), &umr_bitfield_default },
-	{ "GPU_TEMP", AMDGPU_PP_SENSOR_GPU_TEMP, SENSOR_D1000|(SENSOR_TEMP<<4), &umr_bitfield_default },
-	{ NULL, 0, 0, NULL },
+	{ "GFX_SCLK", AMDGPU_PP_SENSOR_GFX_SCLK, SENSOR_D100|(SENSOR_MHZ<<4) },
+	{ "GFX_MCLK", AMDGPU_PP_SENSOR_GFX_MCLK, SENSOR_D100|(SENSOR_MHZ<<4) },
+	{ "GPU_TEMP", AMDGPU_PP_SENSOR_GPU_TEMP, SENSOR_D1000|(SENSOR_TEMP<<4) },
+	{ NULL, 0, 0 },
 };
 
 static struct umr_bitfield stat_ai_sensor_bits[] = {
-	{ "GFX_SCLK", AMDGPU_PP_SENSOR_GFX_SCLK, SENSOR_D100|(SENSOR_MHZ<<4), &umr_bitfield_default },
-	{ "GFX_MCLK", AMDGPU_PP_SENSOR_GFX_MCLK, SENSOR_D100|(SENSOR_MHZ<<4), &umr_bitfield_default },
-	{ "GPU_LOAD", AMDGPU_PP_SENSOR_GPU_LOAD, SENSOR_PERCENT<<4, &umr_bitfield_default },
-	{ "MEM_LOAD", AMDGPU_PP_SENSOR_MEM_LOAD, SENSOR_PERCENT<<4, &umr_bitfield_default },
-	{ "GPU_TEMP", AMDGPU_PP_SENSOR_GPU_TEMP, SENSOR_D1000|(SENSOR_TEMP<<4), &umr_bitfield_default },
-	{ "AVG_GPU",  AMDGPU_PP_SENSOR_GPU_POWER, SENSOR_WATT|(SENSOR_POWER<<4), &umr_bitfield_default },
-	{ NULL, 0, 0, NULL },
+	{ "GFX_SCLK", AMDGPU_PP_SENSOR_GFX_SCLK, SENSOR_D100|(SENSOR_MHZ<<4) },
+	{ "GFX_MCLK", AMDGPU_PP_SENSOR_GFX_MCLK, SENSOR_D100|(SENSOR_MHZ<<4) },
+	{ "GPU_LOAD", AMDGPU_PP_SENSOR_GPU_LOAD, SENSOR_PERCENT<<4 },
+	{ "MEM_LOAD", AMDGPU_PP_SENSOR_MEM_LOAD, SENSOR_PERCENT<<4 },
+	{ "GPU_TEMP", AMDGPU_PP_SENSOR_GPU_TEMP, SENSOR_D1000|(SENSOR_TEMP<<4) },
+	{ "AVG_GPU",  AMDGPU_PP_SENSOR_GPU_POWER, SENSOR_WATT|(SENSOR_POWER<<4) },
+	{ NULL, 0, 0 },
 };
 
 static struct umr_bitfield stat_nv_sensor_bits[] = {
-	{ "GFX_SCLK", AMDGPU_PP_SENSOR_GFX_SCLK, SENSOR_D100|(SENSOR_MHZ<<4), &umr_bitfield_default },
-	{ "GFX_MCLK", AMDGPU_PP_SENSOR_GFX_MCLK, SENSOR_D100|(SENSOR_MHZ<<4), &umr_bitfield_default },
-	{ "VDD_GFX", AMDGPU_PP_SENSOR_VDDGFX, SENSOR_MILLIVOLT<<4, &umr_bitfield_default },
-	{ "GPU_LOAD", AMDGPU_PP_SENSOR_GPU_LOAD, SENSOR_PERCENT<<4, &umr_bitfield_default },
-	{ "MEM_LOAD", AMDGPU_PP_SENSOR_MEM_LOAD, SENSOR_PERCENT<<4, &umr_bitfield_default },
-	{ "GPU_TEMP", AMDGPU_PP_SENSOR_GPU_TEMP, SENSOR_D1000|(SENSOR_TEMP<<4), &umr_bitfield_default },
-	{ NULL, 0, 0, NULL },
+	{ "GFX_SCLK", AMDGPU_PP_SENSOR_GFX_SCLK, SENSOR_D100|(SENSOR_MHZ<<4) },
+	{ "GFX_MCLK", AMDGPU_PP_SENSOR_GFX_MCLK, SENSOR_D100|(SENSOR_MHZ<<4) },
+	{ "VDD_GFX", AMDGPU_PP_SENSOR_VDDGFX, SENSOR_MILLIVOLT<<4 },
+	{ "GPU_LOAD", AMDGPU_PP_SENSOR_GPU_LOAD, SENSOR_PERCENT<<4 },
+	{ "MEM_LOAD", AMDGPU_PP_SENSOR_MEM_LOAD, SENSOR_PERCENT<<4 },
+	{ "GPU_TEMP", AMDGPU_PP_SENSOR_GPU_TEMP, SENSOR_D1000|(SENSOR_TEMP<<4) },
+	{ NULL, 0, 0 },
 };
 
 
@@ -319,85 +322,136 @@ static struct umr_bitfield stat_nv_sensor_bits[] = {
 #define AMDGPU_INFO_FENCES_DELTA    0x82
 
 static struct umr_bitfield stat_drm_bits[] = {
-	{ "BYTES_MOVED", AMDGPU_INFO_NUM_BYTES_MOVED, DRM_INFO_BYTES, &umr_bitfield_default },
-	{ "VRAM_USAGE", AMDGPU_INFO_VRAM_USAGE, DRM_INFO_BYTES, &umr_bitfield_default },
-	{ "GTT_USAGE", AMDGPU_INFO_GTT_USAGE, DRM_INFO_BYTES, &umr_bitfield_default },
-	{ "VIS_VRAM", AMDGPU_INFO_VIS_VRAM_USAGE, DRM_INFO_BYTES, &umr_bitfield_default },
-	{ "EVICTIONS", AMDGPU_INFO_NUM_EVICTIONS, DRM_INFO_COUNT, &umr_bitfield_default },
-	{ "FENCES_SIGNALED", AMDGPU_INFO_FENCES_SIGNALED, DRM_INFO_COUNT, &umr_bitfield_default },
-	{ "FENCES_EMITTED", AMDGPU_INFO_FENCES_EMITTED, DRM_INFO_COUNT, &umr_bitfield_default },
-	{ "FENCES_DELTA", AMDGPU_INFO_FENCES_DELTA, DRM_INFO_COUNT, &umr_bitfield_default },
-	{ NULL, 0, 0, NULL },
+	{ "BYTES_MOVED", AMDGPU_INFO_NUM_BYTES_MOVED, DRM_INFO_BYTES },
+	{ "VRAM_USAGE", AMDGPU_INFO_VRAM_USAGE, DRM_INFO_BYTES },
+	{ "GTT_USAGE", AMDGPU_INFO_GTT_USAGE, DRM_INFO_BYTES },
+	{ "VIS_VRAM", AMDGPU_INFO_VIS_VRAM_USAGE, DRM_INFO_BYTES },
+	{ "EVICTIONS", AMDGPU_INFO_NUM_EVICTIONS, DRM_INFO_COUNT },
+	{ "FENCES_SIGNALED", AMDGPU_INFO_FENCES_SIGNALED, DRM_INFO_COUNT },
+	{ "FENCES_EMITTED", AMDGPU_INFO_FENCES_EMITTED, DRM_INFO_COUNT },
+	{ "FENCES_DELTA", AMDGPU_INFO_FENCES_DELTA, DRM_INFO_COUNT },
+	{ NULL, 0, 0 },
 };
 
 static FILE *logfile = NULL;
 
-static uint64_t visible_vram_size = 0;
+#define TOP_SAMPLE_BATCH 63
+
+struct top_counter {
+	char name[32];
+	char *tag;
+	uint64_t counts[32], window[32];
+	int *opt, is_sensor;
+	uint32_t addr, mask[32], cmp[32], value;
+	uint32_t samples[TOP_SAMPLE_BATCH];
+	int sampled;
+	uint64_t addr_mask;
+	struct umr_bitfield *bits;
+};
+
+/* State of one device shown by umr_top(), each sampling thread and the
+ * display find the device they are working on in top_dev */
+struct top_device {
+	struct umr_asic *asic;
+	struct top_counter stat_counters[64];
+	struct umr_bitfield *sensor_bits;
+	volatile uint32_t gpu_power_data[32];
+	unsigned long last_fence_emitted, last_fence_signaled, fence_signal_count, fence_emit_count;
+	struct umr_fence_tracker *fences;	// opened by the first analyze_fence_info()
+	struct umr_fence_snapshot fence_snap;
+	int fences_tried;
+	uint64_t visible_vram_size;
+	pthread_t sensor_thread, sample_thread;
+	int has_sensor_thread, has_sample_thread;
+
+	struct {
+		int num_vf,
+		    active_vf;
+	} sriov;
+
+	/* Last window completed by top_sample_thread(), the display only
+	 * reads stat_counters[].window under the mutex while the thread
+	 * fills .counts */
+	struct {
+		pthread_mutex_t mutex;
+		pthread_cond_t cond;
+		unsigned generation, samples, expected;
+		double seconds;
+		uint64_t end_ns;	// see top_stamp()
+	} window;
+
+	/* Registers of the enabled counters, built by top_build_plan() so
+	 * that a sample is a few loads from the mapped BAR or one batched
+	 * read per pg_lock state instead of a read_reg() per counter */
+	struct {
+		struct umr_reg_batch batch[2][64];	// [1] needs pg_lock
+		int batch_counter[2][64], no_batch[2];
+		int direct[64], no_direct;
+	} plan;
+
+	// samples not counted yet
+	int pending;
+	uint64_t sample_ns[TOP_SAMPLE_BATCH];
+
+	// GPU timestamps of the samples, calibrated at every window
+	struct umr_gpu_clock clock;
+};
+
+static __thread struct top_device *top_dev;
 
 static volatile int sensor_thread_quit = 0;
-static volatile uint32_t gpu_power_data[32];
-static volatile struct umr_bitfield *sensor_bits = NULL;
 static void *gpu_sensor_thread(void *data)
 {
-	struct umr_asic asic = *((struct umr_asic*)data);
-	int size, rem, off, x;
-	char fname[128];
+	struct umr_sensor_ctx ctx;
+	int sensors[32], n;
 	struct timespec ts;
 
 	ts.tv_sec = 0;
 	ts.tv_nsec = 1000000000UL / 50; // limit to 50Hz
 
-	if (sensor_bits == NULL) {
+	top_dev = data;
+	if (top_dev->sensor_bits == NULL) {
 		return NULL;
 	}
+	umr_affinity_apply(top_dev->asic);
 
-	snprintf(fname, sizeof(fname)-1, "/sys/kernel/debug/dri/%d/amdgpu_sensors", asic.instance);
-	asic.fd.sensors = open(fname, O_RDWR);
-	while (!sensor_thread_quit) {
-		rem = sizeof gpu_power_data;
-		off = 0;
-		for (x = 0; sensor_bits[x].regname; ) {
-			switch (sensor_bits[x].start) {
-				default:
-					size = 4;
-					break;
-			}
-			if (size <= rem)
-				umr_read_sensor(&asic, sensor_bits[x].start, (uint32_t*)&gpu_power_data[off], &size);
-			off += size / 4;
-			rem -= size;
-			x   += size / 4;
-		}
+	for (n = 0; n < 32 && top_dev->sensor_bits[n].regname; n++)
+		sensors[n] = top_dev->sensor_bits[n].start;
 
+	if (umr_sensor_ctx_open(&ctx, top_dev->asic->instance))
+		return NULL;
+	ctx.asic = top_dev->asic;
+	while (!sensor_thread_quit) {
+		umr_read_sensors_batch(&ctx, sensors, (uint32_t *)top_dev->gpu_power_data, n);
 		nanosleep(&ts, NULL);
 	}
-	close(asic.fd.sensors);
+	umr_sensor_ctx_close(&ctx);
 	return NULL;
 }
 
-static unsigned long last_fence_emitted, last_fence_signaled, fence_signal_count, fence_emit_count;
 static void analyze_fence_info(struct umr_asic *asic)
 {
-	char name[256];
-	unsigned long fence_emitted, fence_signaled, number;
-	FILE *f;
+	unsigned long fence_emitted, fence_signaled;
+	struct umr_ring_fence *r;
+	int i;
 
-	snprintf(name, sizeof(name)-1, "/sys/kernel/debug/dri/%d/amdgpu_fence_info", asic->instance);
-	f = fopen(name, "rb");
-	if (f) {
-		fence_emitted = fence_signaled = 0;
-		while (fgets(name, sizeof(name)-1, f)) {
-			if (sscanf(name, "Last signaled fence 0x%08lx", &number) == 1)
-				fence_signaled += number;
-			else if (sscanf(name, "Last emitted 0x%08lx", &number) == 1)
-				fence_emitted += number;
-		}
-		fence_signal_count = fence_signaled - last_fence_signaled;
-		fence_emit_count = fence_emitted - last_fence_emitted;
-		last_fence_signaled = fence_signaled;
-		last_fence_emitted = fence_emitted;
-		fclose(f);
+	if (!top_dev->fences_tried) {
+		top_dev->fences_tried = 1;
+		top_dev->fences = umr_fence_tracker_open(asic);
+	}
+	if (!top_dev->fences || umr_fence_tracker_read(top_dev->fences, &top_dev->fence_snap) < 0)
+		return;
+
+	fence_emitted = fence_signaled = 0;
+	for (i = 0; i < top_dev->fence_snap.no_rings; i++) {
+		r = &top_dev->fence_snap.rings[i];
+		fence_signaled += r->signaled;
+		fence_emitted += r->emitted;
 	}
+	top_dev->fence_signal_count = fence_signaled - top_dev->last_fence_signaled;
+	top_dev->fence_emit_count = fence_emitted - top_dev->last_fence_emitted;
+	top_dev->last_fence_signaled = fence_signaled;
+	top_dev->last_fence_emitted = fence_emitted;
 }
 
 static void slice(char *r, char *s)
@@ -420,6 +474,7 @@ static int grab_bits(char *name, struct umr_asic *asic, struct umr_bitfield *bit
 	// try to find the register somewhere in the ASIC
 	*addr = 0;
 	for (i = 0; i < asic->no_blocks; i++) {
+		umr_load_ip_block(asic, asic->blocks[i]);
 		for (j = 0; j < asic->blocks[i]->no_regs; j++) {
 			if (strcmp(asic->blocks[i]->regs[j].regname, name) == 0) {
 				*addr = asic->blocks[i]->regs[j].addr<<2;
@@ -463,6 +518,7 @@ static int grab_addr(char *name, struct umr_asic *asic, struct umr_bitfield *bit
 	// try to find the register somewhere in the ASIC
 	*addr = 0;
 	for (i = 0; i < asic->no_blocks; i++) {
+		umr_load_ip_block(asic, asic->blocks[i]);
 		for (j = 0; j < asic->blocks[i]->no_regs; j++) {
 			if (strcmp(asic->blocks[i]->regs[j].regname, name) == 0) {
 				*addr = asic->blocks[i]->regs[j].addr<<2;
@@ -598,7 +654,7 @@ static void print_drm(struct umr_bitfield *bits, uint64_t *counts)
 static void print_iov(uint64_t *counts)
 {
 	int i;
-	for (i = 0; i < top_options.sriov.num_vf; i++) {
+	for (i = 0; i < top_dev->sriov.num_vf; i++) {
 		char custom_namefmt[30];
 		snprintf(custom_namefmt, sizeof(custom_namefmt)-1,
 			"%%%ds(%%02d) => ", maxstrlen - 3);
@@ -611,34 +667,45 @@ static void print_iov(uint64_t *counts)
 	}
 }
 
-static void parse_bits(struct umr_asic *asic, uint32_t addr, struct umr_bitfield *bits, uint64_t *counts, uint32_t *mask, uint32_t *cmp, uint64_t addr_mask)
+/**
+ * parse_bits - Count the fields of a batch of samples of a register
+ *
+ * @values: The samples, at most TOP_SAMPLE_BATCH of them
+ * @n: Number of samples
+ *
+ * Single bit fields are counted with bit-sliced counters: planes[k] holds
+ * bit k of how many samples had each bit set, so every sample is added to
+ * all 32 bits with a few AND/XOR.  Multi-bit fields are compared without
+ * branches per sample.
+ */
+static void parse_bits(const uint32_t *values, int n, struct umr_bitfield *bits, uint64_t *counts, uint32_t *mask, uint32_t *cmp)
 {
-	int j;
-	uint32_t value;
-
-	if (addr) {
-		if (addr_mask && asic->fd.mmio < 0) {
-			value = 0;
-		} else if (!addr_mask && asic->pci.mem) {
-			value = asic->pci.mem[addr>>2];
-		} else {
-			if (addr_mask & REG_USE_PG_LOCK)
-				asic->options.pg_lock = 1;
-
-			value = asic->reg_funcs.read_reg(asic, addr, REG_MMIO);
+	uint32_t planes[6] = { 0 }, carry, t, width;
+	uint64_t hits;
+	int i, j, k;
 
-			asic->options.pg_lock = 0;
+	for (i = 0; i < n; i++) {
+		carry = values[i];
+		for (k = 0; carry && k < 6; k++) {
+			t = planes[k] & carry;
+			planes[k] ^= carry;
+			carry = t;
 		}
-		for (j = 0; bits[j].regname; j++)
-			if (bits[j].start != 255) {
-				if (bits[j].start == bits[j].stop) {
-					counts[j] += (value & (1UL<<bits[j].start)) ? (top_options.high_frequency ? 10 : 1) : 0;
-				} else {
-					value = (value >> bits[j].start) & ((1UL << (bits[j].stop-bits[j].start)) - 1);
-					counts[j] += ((value & mask[j]) == cmp[j]) ? (top_options.high_frequency ? 10 : 1) : 0;
-				}
-			}
 	}
+
+	for (j = 0; bits[j].regname; j++)
+		if (bits[j].start != 255) {
+			hits = 0;
+			if (bits[j].start == bits[j].stop) {
+				for (k = 0; k < 6; k++)
+					hits += (uint64_t)((planes[k] >> bits[j].start) & 1) << k;
+			} else {
+				width = (1UL << (bits[j].stop-bits[j].start)) - 1;
+				for (i = 0; i < n; i++)
+					hits += (((values[i] >> bits[j].start) & width & mask[j]) == cmp[j]);
+			}
+			counts[j] += hits * (top_options.high_frequency ? 10 : 1);
+		}
 }
 
 static void parse_sensors(struct umr_asic *asic, uint32_t addr, struct umr_bitfield *bits, uint64_t *counts, uint32_t *mask, uint32_t *cmp, uint64_t addr_mask)
@@ -655,7 +722,7 @@ static void parse_sensors(struct umr_asic *asic, uint32_t addr, struct umr_bitfi
 		return;
 
 	for (x = j = 0; bits[j].regname; ) {
-		value = gpu_power_data[x];
+		value = top_dev->gpu_power_data[x];
 		switch (bits[j].stop & 0x0F) {
 			case SENSOR_IDENTITY:
 				counts[j] = value;
@@ -696,46 +763,28 @@ static void parse_drm(struct umr_asic *asic, uint32_t addr, struct umr_bitfield
 
 	for (j = 0; bits[j].regname; j++) {
 		if (bits[j].start == AMDGPU_INFO_FENCES_EMITTED)
-			counts[j] = fence_emit_count;
+			counts[j] = top_dev->fence_emit_count;
 		else if (bits[j].start == AMDGPU_INFO_FENCES_SIGNALED)
-			counts[j] = fence_signal_count;
+			counts[j] = top_dev->fence_signal_count;
 		else if (bits[j].start == AMDGPU_INFO_FENCES_DELTA)
-			counts[j] = last_fence_emitted - last_fence_signaled;
+			counts[j] = top_dev->last_fence_emitted - top_dev->last_fence_signaled;
 		else
 			umr_query_drm(asic, bits[j].start, &counts[j], sizeof(counts[j]));
 	}
 }
 
-static void parse_iov(struct umr_asic *asic, uint32_t addr, struct umr_bitfield *bits, uint64_t *counts, uint32_t *mask, uint32_t *cmp, uint64_t addr_mask)
+static void parse_iov(uint32_t value, struct umr_bitfield *bits, uint64_t *counts)
 {
 	int j;
-	uint32_t value;
 
-	(void)mask;
-	(void)cmp;
-
-	if (addr) {
-		if (addr_mask && asic->fd.mmio < 0) {
-			value = 0;
-		} else if (!addr_mask && asic->pci.mem) {
-			value = asic->pci.mem[addr>>2];
-		} else {
-			if (addr_mask & REG_USE_PG_LOCK)
-				asic->options.pg_lock = 1;
-
-			value = asic->reg_funcs.read_reg(asic, addr, REG_MMIO);
-
-			asic->options.pg_lock = 0;
-		}
-		for (j = 0; bits[j].regname; j++)
-			if (bits[j].start != 255) {
-				if (bits[j].stop == IOV_VF) {
-					counts[j] += ((value & 0xF) == bits[j].start) ? 1 : 0;
-				} else {
-					counts[j] += (value & 0x80000000) ? 1 : 0;
-				}
+	for (j = 0; bits[j].regname; j++)
+		if (bits[j].start != 255) {
+			if (bits[j].stop == IOV_VF) {
+				counts[j] += ((value & 0xF) == bits[j].start) ? 1 : 0;
+			} else {
+				counts[j] += (value & 0x80000000) ? 1 : 0;
 			}
-	}
+		}
 }
 
 static void grab_vram(struct umr_asic *asic)
@@ -761,7 +810,7 @@ static void grab_vram(struct umr_asic *asic)
 
 		printw("\nVRAM: %lu/%lu vis %lu/%" PRIu64" (MiB)\n",
 		       (used * 4096) / 1048576, (total * 4096) / 1048576,
-		       vis_usage, visible_vram_size >> 20);
+		       vis_usage, top_dev->visible_vram_size >> 20);
 	}
 }
 
@@ -791,7 +840,7 @@ static void analyze_drm_info(struct umr_asic *asic)
 				sscanf(line, "\t0x%08lx: %lu byte %s @ %llx", &id, &size, region, &vram_addr);
 				if (!strcmp(region, "VRAM")) {
 					tot_vram += size;
-					if (vram_addr < visible_vram_size>>12)
+					if (vram_addr < top_dev->visible_vram_size>>12)
 						tot_vis_vram += size;
 				}
 				else
@@ -883,18 +932,10 @@ void load_options(void)
 	}
 }
 
-static struct {
-		char name[32];
-		char *tag;
-		uint64_t counts[32];
-		int *opt, is_sensor;
-		uint32_t addr, mask[32], cmp[32];
-		uint64_t addr_mask;
-		struct umr_bitfield *bits;
-} stat_counters[64];
-
-#define ENTRY(_j, _prefix, _name, _bits, _opt, _tag) do { int _i = (_j); snprintf(stat_counters[_i].name, sizeof(stat_counters[_i].name), "%s%s", _prefix, _name); stat_counters[_i].bits = _bits; stat_counters[_i].opt = _opt; stat_counters[_i].tag = _tag; } while (0)
-#define ENTRY_SENSOR(_j, _name, _bits, _opt, _tag) do { int _i = (_j); strcpy(stat_counters[_i].name, _name); stat_counters[_i].bits = _bits; stat_counters[_i].opt = _opt; stat_counters[_i].tag = _tag; stat_counters[_i].is_sensor = 1; } while (0)
+
+
+#define ENTRY(_j, _prefix, _name, _bits, _opt, _tag) do { int _i = (_j); snprintf(top_dev->stat_counters[_i].name, sizeof(top_dev->stat_counters[_i].name), "%s%s", _prefix, _name); top_dev->stat_counters[_i].bits = _bits; top_dev->stat_counters[_i].opt = _opt; top_dev->stat_counters[_i].tag = _tag; } while (0)
+#define ENTRY_SENSOR(_j, _name, _bits, _opt, _tag) do { int _i = (_j); strcpy(top_dev->stat_counters[_i].name, _name); top_dev->stat_counters[_i].bits = _bits; top_dev->stat_counters[_i].opt = _opt; top_dev->stat_counters[_i].tag = _tag; top_dev->stat_counters[_i].is_sensor = 1; } while (0)
 
 static void vi_handle_keys(int i)
 {
@@ -959,24 +1000,24 @@ static void top_build_vi_program(struct umr_asic *asic)
 	if (vcn && ((vcn->discoverable.maj == 2 && vcn->discoverable.min >= 6) || vcn->discoverable.maj >= 4))
 		vcn_prefix = "reg";
 
-	stat_counters[0].bits = &stat_grbm_bits[0];
-	stat_counters[0].opt = &top_options.vi.grbm;
-	stat_counters[0].tag = "GRBM";
+	top_dev->stat_counters[0].bits = &stat_grbm_bits[0];
+	top_dev->stat_counters[0].opt = &top_options.vi.grbm;
+	top_dev->stat_counters[0].tag = "GRBM";
 
 	// which SE to read ...
 	if (options.use_bank == 1)
-		snprintf(stat_counters[0].name, sizeof(stat_counters[0].name), "%sGRBM_STATUS_SE%d", gfx_prefix, options.bank.grbm.se);
+		snprintf(top_dev->stat_counters[0].name, sizeof(top_dev->stat_counters[0].name), "%sGRBM_STATUS_SE%d", gfx_prefix, options.bank.grbm.se);
 	else
-		snprintf(stat_counters[0].name, sizeof(stat_counters[0].name), "%sGRBM_STATUS", gfx_prefix);
+		snprintf(top_dev->stat_counters[0].name, sizeof(top_dev->stat_counters[0].name), "%sGRBM_STATUS", gfx_prefix);
 
 	i = 1;
 
 	ENTRY(i++, gfx_prefix, "GRBM_STATUS2", &stat_grbm2_bits[0], &top_options.vi.grbm, "GRBM");
 
-	top_options.sriov.active_vf = -1;
-	top_options.sriov.num_vf = sriov_supported_vf(asic);
-	if (top_options.sriov.num_vf != 0) {
-		stat_counters[i].is_sensor = 3;
+	top_dev->sriov.active_vf = -1;
+	top_dev->sriov.num_vf = sriov_supported_vf(asic);
+	if (top_dev->sriov.num_vf != 0) {
+		top_dev->stat_counters[i].is_sensor = 3;
 		ENTRY(i++, gfx_prefix, "RLC_GPU_IOV_ACTIVE_FCN_ID", &stat_rlc_iov_bits[0],
 			&top_options.vi.grbm, "GPU_IOV");
 	}
@@ -1006,7 +1047,7 @@ static void top_build_vi_program(struct umr_asic *asic)
 		// SI
 		ENTRY_SENSOR(i++, "GFX_SCLK", &stat_si_sensor_bits[0], &top_options.vi.sensors, "Sensors");
 	}
-	sensor_bits = stat_counters[i-1].bits;
+	top_dev->sensor_bits = top_dev->stat_counters[i-1].bits;
 
 	// More GFX bits
 	ENTRY(i++, gfx_prefix, "TA_STATUS", &stat_ta_bits[0], &top_options.vi.ta, "TA");
@@ -1022,7 +1063,7 @@ static void top_build_vi_program(struct umr_asic *asic)
 		ENTRY(i++, vcn_prefix, "UVD_CGC_STATUS", &stat_uvdclk_bits[0], &top_options.vi.uvd, "UVD");
 		// set PG flag for all UVD registers
 		for (; k < i; k++) {
-			stat_counters[k].addr_mask = REG_USE_PG_LOCK;  // UVD requires PG lock
+			top_dev->stat_counters[k].addr_mask = REG_USE_PG_LOCK;  // UVD requires PG lock
 		}
 
 		j = i;
@@ -1036,9 +1077,9 @@ static void top_build_vi_program(struct umr_asic *asic)
 
 		// set compare/mask for UVD TILE registers
 		for (; j < i; j++) {
-			stat_counters[j].cmp[0] = 0;
-			stat_counters[j].mask[0] = 3;
-			stat_counters[j].addr_mask = REG_USE_PG_LOCK;  // require PG lock
+			top_dev->stat_counters[j].cmp[0] = 0;
+			top_dev->stat_counters[j].mask[0] = 3;
+			top_dev->stat_counters[j].addr_mask = REG_USE_PG_LOCK;  // require PG lock
 		}
 
 	// VCE registers
@@ -1048,7 +1089,7 @@ static void top_build_vi_program(struct umr_asic *asic)
 
 		// set PG flag for all VCE registers
 		for (; k < i; k++) {
-			stat_counters[k].addr_mask = REG_USE_PG_LOCK;  // VCE requires PG lock
+			top_dev->stat_counters[k].addr_mask = REG_USE_PG_LOCK;  // VCE requires PG lock
 		}
 
 	// memory hub
@@ -1066,29 +1107,301 @@ static void top_build_vi_program(struct umr_asic *asic)
 
 }
 
+/*
+ * Binary logger, used when UMR_LOGGER_FORMAT is "binary" (a row per
+ * report window) or "samples" (a row per sample of the raw registers).
+ * Each time it is enabled umr-top.bin gets a header:
+ *
+ *	char     magic[8];		"UMRTOPL1"
+ *	uint32_t flags;			TOP_LOG_SAMPLES if rows are samples,
+ *					TOP_LOG_GPU_TIME if stamped by the GPU
+ *	uint32_t no_columns;
+ *	uint64_t realtime_ns, monotonic_ns;	clocks when the log started
+ *	{ uint16_t len; char name[len]; } columns[no_columns];
+ *
+ * followed by rows of a uint64_t timestamp (ns, see top_stamp()) and a
+ * uint64_t per column, all in host byte order.  monotonic_ns is on the
+ * same clock as the rows.  Rows are buffered and written in large
+ * chunks.  umr --top-log-csv converts a log to CSV.
+ */
+#define TOP_LOG_MAGIC "UMRTOPL1"
+#define TOP_LOG_SAMPLES 1
+#define TOP_LOG_GPU_TIME 2
+#define TOP_LOG_BUFSIZE (1024 * 1024)
+
+static struct {
+	pthread_mutex_t lock;
+	struct top_device *dev;		// the device being logged
+	int fd, per_sample, no_columns;
+	struct {
+		int counter, bit;	// bit is -1 for a raw register
+	} columns[64 * 32];
+	unsigned char *buf;
+	size_t used;
+} top_log = { .lock = PTHREAD_MUTEX_INITIALIZER, .fd = -1 };
+
+static uint64_t timespec_ns(const struct timespec *ts)
+{
+	return (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+/* The time of a sample on CLOCK_MONOTONIC_RAW, read from the GPU's own
+ * counter where it has one so samples of several devices line up
+ * whatever the latency of their reads. */
+static uint64_t top_stamp(struct top_device *dev)
+{
+	return umr_gpu_clock_now(dev->asic, &dev->clock);
+}
+
+static uint64_t top_raw_to_realtime(uint64_t raw_ns)
+{
+	struct timespec rt, raw;
+
+	clock_gettime(CLOCK_REALTIME, &rt);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &raw);
+	return timespec_ns(&rt) + raw_ns - timespec_ns(&raw);
+}
+
+static void top_log_flush(void)
+{
+	size_t off;
+	ssize_t r;
+
+	for (off = 0; off < top_log.used; off += r) {
+		r = write(top_log.fd, top_log.buf + off, top_log.used - off);
+		if (r <= 0)
+			break;
+	}
+	top_log.used = 0;
+}
+
+static void top_log_bytes(const void *data, size_t len)
+{
+	if (top_log.used + len > TOP_LOG_BUFSIZE)
+		top_log_flush();
+	memcpy(top_log.buf + top_log.used, data, len);
+	top_log.used += len;
+}
+
+static void top_log_u64(uint64_t v)
+{
+	top_log_bytes(&v, sizeof v);
+}
+
+static int top_log_open(const char *dir, int per_sample)
+{
+	char name[512];
+	struct timespec ts;
+	uint32_t u32;
+	uint16_t len;
+	int i, j, n;
+
+	snprintf(name, sizeof name, "%s/umr-top.bin", dir);
+	top_log.fd = open(name, O_WRONLY | O_CREAT | O_APPEND, 0644);
+	if (top_log.fd < 0)
+		return -1;
+	top_log.buf = malloc(TOP_LOG_BUFSIZE);
+	if (!top_log.buf) {
+		close(top_log.fd);
+		top_log.fd = -1;
+		return -1;
+	}
+	top_log.used = 0;
+	top_log.per_sample = per_sample;
+	top_log.dev = top_dev;
+
+	// the columns are fixed while the log is open
+	for (i = n = 0; top_dev->stat_counters[i].name[0]; i++) {
+		if (!(top_options.all || *top_dev->stat_counters[i].opt))
+			continue;
+		if (per_sample) {
+			if (top_dev->stat_counters[i].is_sensor == 0 && top_dev->stat_counters[i].addr) {
+				top_log.columns[n].counter = i;
+				top_log.columns[n++].bit = -1;
+			}
+		} else {
+			for (j = 0; top_dev->stat_counters[i].bits[j].regname; j++) {
+				if (top_dev->stat_counters[i].bits[j].start != 255) {
+					top_log.columns[n].counter = i;
+					top_log.columns[n++].bit = j;
+				}
+			}
+		}
+	}
+	top_log.no_columns = n;
+
+	top_log_bytes(TOP_LOG_MAGIC, 8);
+	u32 = (per_sample ? TOP_LOG_SAMPLES : 0) | (top_dev->clock.valid ? TOP_LOG_GPU_TIME : 0);
+	top_log_bytes(&u32, sizeof u32);
+	u32 = n;
+	top_log_bytes(&u32, sizeof u32);
+	clock_gettime(CLOCK_REALTIME, &ts);
+	top_log_u64(timespec_ns(&ts));
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	top_log_u64(timespec_ns(&ts));
+	for (i = 0; i < n; i++) {
+		j = top_log.columns[i].counter;
+		snprintf(name, sizeof name, "%s.%s", top_dev->stat_counters[j].tag,
+			 top_log.columns[i].bit < 0 ? top_dev->stat_counters[j].name : top_dev->stat_counters[j].bits[top_log.columns[i].bit].regname);
+		len = strlen(name);
+		top_log_bytes(&len, sizeof len);
+		top_log_bytes(name, len);
+	}
+	return 0;
+}
+
+static void top_log_close(void)
+{
+	if (top_log.fd < 0)
+		return;
+	top_log_flush();
+	close(top_log.fd);
+	free(top_log.buf);
+	top_log.buf = NULL;
+	top_log.fd = -1;
+}
+
 static void toggle_logger(void)
 {
 	int i, j;
 	top_options.logger ^= 1;
 
 	if (top_options.logger) {
-		char *p, name[512];
+		char *p, *f, name[512];
 		if (!(p = getenv("UMR_LOGGER")))
 			p = getenv("HOME");
+
+		f = getenv("UMR_LOGGER_FORMAT");
+		if (f && (!strcmp(f, "binary") || !strcmp(f, "samples"))) {
+			pthread_mutex_lock(&top_log.lock);
+			if (top_log_open(p, !strcmp(f, "samples")))
+				top_options.logger = 0;
+			pthread_mutex_unlock(&top_log.lock);
+			return;
+		}
+
 		sprintf(name, "%s/umr.log", p);
 		logfile = fopen(name, "a");
 
 		fprintf(logfile, "Time (seconds),");
-		for (i = 0; stat_counters[i].name[0]; i++)
-			if (top_options.all || *stat_counters[i].opt)
-				for (j = 0; stat_counters[i].bits[j].regname != 0; j++)
-					fprintf(logfile, "%s.%s,", stat_counters[i].tag, stat_counters[i].bits[j].regname);
+		for (i = 0; top_dev->stat_counters[i].name[0]; i++)
+			if (top_options.all || *top_dev->stat_counters[i].opt)
+				for (j = 0; top_dev->stat_counters[i].bits[j].regname != 0; j++)
+					fprintf(logfile, "%s.%s,", top_dev->stat_counters[i].tag, top_dev->stat_counters[i].bits[j].regname);
 		fprintf(logfile, "\n");
 	} else {
 		if (logfile)
 			fclose(logfile);
 		logfile = NULL;
+
+		pthread_mutex_lock(&top_log.lock);
+		top_log_close();
+		pthread_mutex_unlock(&top_log.lock);
+	}
+}
+
+/**
+ * umr_top_log_to_csv - Print a binary --top log as CSV
+ *
+ * @path: The umr-top.bin file to convert
+ *
+ * Every header in the file starts a new CSV header line, the time column
+ * is in seconds since the epoch.  With --jsonl every row is a "sample"
+ * record instead with the time in nanoseconds and the columns by name.
+ *
+ * Returns 0 on success, -1 if the file can't be read or is corrupt.
+ */
+int umr_top_log_to_csv(const char *path)
+{
+	char magic[8], name[65536], **names = NULL;
+	uint32_t flags, no_columns, x;
+	uint64_t realtime, monotonic, v;
+	uint16_t len;
+	FILE *f;
+	int r = -1;
+
+	f = fopen(path, "rb");
+	if (!f) {
+		fprintf(stderr, "[ERROR]: Cannot open '%s'\n", path);
+		return -1;
+	}
+
+	no_columns = 0;
+	realtime = monotonic = 0;
+	while (fread(magic, 1, 8, f) == 8) {
+		if (!memcmp(magic, TOP_LOG_MAGIC, 8)) {
+			if (fread(&flags, sizeof flags, 1, f) != 1 ||
+			    fread(&no_columns, sizeof no_columns, 1, f) != 1 ||
+			    fread(&realtime, sizeof realtime, 1, f) != 1 ||
+			    fread(&monotonic, sizeof monotonic, 1, f) != 1)
+				goto error;
+			if (names) {
+				for (x = 0; names[x]; x++)
+					free(names[x]);
+				free(names);
+				names = NULL;
+			}
+			if (options.jsonl) {
+				// the names are keys of every record that follows
+				names = calloc(no_columns + 1, sizeof *names);
+				if (!names)
+					goto error;
+			} else {
+				printf("Time (seconds)");
+			}
+			for (x = 0; x < no_columns; x++) {
+				if (fread(&len, sizeof len, 1, f) != 1 || fread(name, 1, len, f) != len)
+					goto error;
+				if (names) {
+					names[x] = strndup(name, len);
+					if (!names[x])
+						goto error;
+				} else {
+					printf(",%.*s", (int)len, name);
+				}
+			}
+			if (!names)
+				printf("\n");
+			continue;
+		}
+		if (!realtime)
+			goto error;
+
+		memcpy(&v, magic, sizeof v);
+		v = realtime + (v - monotonic);
+		if (names) {
+			umr_jsonl_begin("sample");
+			umr_jsonl_u64("time_ns", v);
+			umr_jsonl_object("columns", 0);
+		} else {
+			printf("%" PRIu64 ".%09" PRIu64, v / 1000000000, v % 1000000000);
+		}
+		for (x = 0; x < no_columns; x++) {
+			if (fread(&v, sizeof v, 1, f) != 1)
+				goto error;
+			if (names)
+				umr_jsonl_u64(names[x], v);
+			else
+				printf(",%" PRIu64, v);
+		}
+		if (names) {
+			umr_jsonl_close();
+			umr_jsonl_end();
+		} else {
+			printf("\n");
+		}
+	}
+	r = 0;
+error:
+	if (r)
+		fprintf(stderr, "[ERROR]: '%s' is not a valid --top log\n", path);
+	if (names) {
+		for (x = 0; names[x]; x++)
+			free(names[x]);
+		free(names);
 	}
+	fclose(f);
+	return r;
 }
 
 #define AMDGPU_INFO_VRAM_GTT			0x14
@@ -1111,7 +1424,7 @@ int get_active_vf(struct umr_asic *asic, uint32_t addr)
 	uint32_t value = -1;
 
 	if (addr) {
-		if (asic->pci.mem) {
+		if (umr_pci_regs(asic)) {
 			value = asic->pci.mem[addr>>2];
 		} else {
 			value = asic->reg_funcs.read_reg(asic, addr, REG_MMIO);
@@ -1121,15 +1434,275 @@ int get_active_vf(struct umr_asic *asic, uint32_t addr)
 	return value;
 }
 
-void umr_top(struct umr_asic *asic)
+static void timespec_add_ns(struct timespec *ts, long ns)
+{
+	ts->tv_nsec += ns;
+	while (ts->tv_nsec >= 1000000000L) {
+		ts->tv_nsec -= 1000000000L;
+		ts->tv_sec++;
+	}
+}
+
+static int timespec_before(const struct timespec *a, const struct timespec *b)
+{
+	return a->tv_sec < b->tv_sec || (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+
+static void top_build_plan(struct umr_asic *asic)
+{
+	int j, n, lock;
+
+	top_dev->plan.no_batch[0] = top_dev->plan.no_batch[1] = top_dev->plan.no_direct = 0;
+	for (j = 0; top_dev->stat_counters[j].name[0]; j++) {
+		top_dev->stat_counters[j].value = 0;
+		top_dev->stat_counters[j].sampled = (top_options.all || *top_dev->stat_counters[j].opt) &&
+					   top_dev->stat_counters[j].is_sensor == 0 && top_dev->stat_counters[j].addr;
+		if (!(top_options.all || *top_dev->stat_counters[j].opt) || !top_dev->stat_counters[j].addr ||
+		    (top_dev->stat_counters[j].is_sensor != 0 && top_dev->stat_counters[j].is_sensor != 3))
+			continue;
+
+		// registers that need the debugfs interface read as 0 without it
+		if (top_dev->stat_counters[j].addr_mask && asic->fd.mmio < 0)
+			continue;
+
+		if (!top_dev->stat_counters[j].addr_mask && umr_pci_regs(asic)) {
+			top_dev->plan.direct[top_dev->plan.no_direct++] = j;
+		} else {
+			lock = !!(top_dev->stat_counters[j].addr_mask & REG_USE_PG_LOCK);
+			n = top_dev->plan.no_batch[lock]++;
+			memset(&top_dev->plan.batch[lock][n], 0, sizeof top_dev->plan.batch[lock][n]);
+			top_dev->plan.batch[lock][n].addr = top_dev->stat_counters[j].addr;
+			top_dev->plan.batch[lock][n].type = REG_MMIO;
+			top_dev->plan.batch_counter[lock][n] = j;
+		}
+	}
+}
+
+static void top_read_plan(struct umr_asic *asic)
+{
+	int x, lock;
+
+	for (x = 0; x < top_dev->plan.no_direct; x++)
+		top_dev->stat_counters[top_dev->plan.direct[x]].value = asic->pci.mem[top_dev->stat_counters[top_dev->plan.direct[x]].addr >> 2];
+
+	for (lock = 0; lock < 2; lock++) {
+		if (!top_dev->plan.no_batch[lock])
+			continue;
+		asic->options.pg_lock = lock;
+		umr_read_regs_batch(asic, top_dev->plan.batch[lock], top_dev->plan.no_batch[lock]);
+		for (x = 0; x < top_dev->plan.no_batch[lock]; x++)
+			top_dev->stat_counters[top_dev->plan.batch_counter[lock][x]].value = top_dev->plan.batch[lock][x].value;
+	}
+	asic->options.pg_lock = 0;
+}
+
+// count the samples gathered since the last flush
+static void top_flush_samples(void)
 {
+	int j, s, c;
+
+	pthread_mutex_lock(&top_log.lock);
+	if (top_log.fd >= 0 && top_log.per_sample && top_log.dev == top_dev) {
+		for (s = 0; s < top_dev->pending; s++) {
+			top_log_u64(top_dev->sample_ns[s]);
+			for (c = 0; c < top_log.no_columns; c++) {
+				j = top_log.columns[c].counter;
+				top_log_u64(top_dev->stat_counters[j].sampled ? top_dev->stat_counters[j].samples[s] : 0);
+			}
+		}
+	}
+	pthread_mutex_unlock(&top_log.lock);
+
+	for (j = 0; top_dev->pending && top_dev->stat_counters[j].name[0]; j++)
+		if (top_dev->stat_counters[j].sampled)
+			parse_bits(top_dev->stat_counters[j].samples, top_dev->pending, top_dev->stat_counters[j].bits, top_dev->stat_counters[j].counts, top_dev->stat_counters[j].mask, top_dev->stat_counters[j].cmp);
+	top_dev->pending = 0;
+}
+
+static void top_sample(struct umr_asic *asic, int first)
+{
+	int j;
+
+	if (top_dev->sriov.num_vf && top_dev->sriov.active_vf >= 0 &&
+		top_dev->sriov.active_vf != get_active_vf(asic, top_dev->stat_counters[2].addr))
+		return;
+
+	top_read_plan(asic);
+	if (top_log.per_sample)
+		top_dev->sample_ns[top_dev->pending] = top_stamp(top_dev);
+	for (j = 0; top_dev->stat_counters[j].name[0]; j++) {
+		if (top_dev->stat_counters[j].sampled)
+			top_dev->stat_counters[j].samples[top_dev->pending] = top_dev->stat_counters[j].value;
+		else if (top_options.all || *top_dev->stat_counters[j].opt) {
+			if (first && top_dev->stat_counters[j].is_sensor == 1) // only parse sensors on first go-around per display
+				parse_sensors(asic, top_dev->stat_counters[j].addr, top_dev->stat_counters[j].bits, top_dev->stat_counters[j].counts, top_dev->stat_counters[j].mask, top_dev->stat_counters[j].cmp, top_dev->stat_counters[j].addr_mask);
+			else if (first && top_dev->stat_counters[j].is_sensor == 2) // only parse drm on first go-around per display
+				parse_drm(asic, top_dev->stat_counters[j].addr, top_dev->stat_counters[j].bits, top_dev->stat_counters[j].counts, top_dev->stat_counters[j].mask, top_dev->stat_counters[j].cmp, top_dev->stat_counters[j].addr_mask);
+			else if (top_dev->stat_counters[j].is_sensor == 3 && top_dev->stat_counters[j].addr)
+				parse_iov(top_dev->stat_counters[j].value, top_dev->stat_counters[j].bits, top_dev->stat_counters[j].counts);
+		}
+	}
+	if (++top_dev->pending == TOP_SAMPLE_BATCH)
+		top_flush_samples();
+}
+
+// how much the displayed bits flipped over the window, 1 when one was busy half the time
+static double top_window_activity(unsigned samples)
+{
+	double p, a, activity = 0.0;
+	int j, k;
+
+	for (j = 0; samples && top_dev->stat_counters[j].name[0]; j++) {
+		if (top_dev->stat_counters[j].is_sensor || !(top_options.all || *top_dev->stat_counters[j].opt))
+			continue;
+		for (k = 0; k < 32 && top_dev->stat_counters[j].bits[k].regname; k++) {
+			p = (double)top_dev->stat_counters[j].counts[k] / (samples * (top_options.high_frequency ? 10 : 1));
+			a = p < 1.0 ? 4.0 * p * (1.0 - p) : 0.0;
+			if (a > activity)
+				activity = a;
+		}
+	}
+	return activity;
+}
+
+/**
+ * top_sample_thread - Sample the status registers at a fixed rate
+ *
+ * Samples are taken on absolute deadlines so the rate doesn't drift with
+ * the cost of the reads or of the display.  Slots that were missed are
+ * dropped instead of sampled in a burst, and the counts of each window are
+ * scaled by the samples actually taken so the busy percentages stay right.
+ *
+ * In adaptive mode the samples of a window are spread evenly at the step
+ * of a umr_sample_rate, which follows how much the bits flipped over the
+ * previous window.
+ */
+static void *top_sample_thread(void *data)
+{
+	struct umr_asic *asic;
+	struct umr_sample_rate rate = { 0 };
+	struct timespec deadline, start, now, end;
+	unsigned rep, slots, samples;
+	uint64_t end_ns;
+	long period_ns;
 	int i, j, k;
-	struct timespec req;
-	uint32_t rep;
-	time_t tt;
-	char hostname[64] = { 0 };
-	char fname[64], *e;
-	pthread_t sensor_thread;
+
+	top_dev = data;
+	asic = top_dev->asic;
+	umr_affinity_apply(asic);
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	while (!top_options.quit) {
+		rep = top_options.high_precision ? 1000 : 100;
+		slots = rep / (top_options.high_frequency ? 10 : 1);
+		period_ns = 1000000000L / rep;
+
+		for (j = 0; top_dev->stat_counters[j].name[0]; j++)
+			memset(top_dev->stat_counters[j].counts, 0, sizeof(top_dev->stat_counters[j].counts));
+		top_build_plan(asic);
+
+		start = deadline;
+		if (top_options.turbo && !top_dev->plan.no_batch[0] && !top_dev->plan.no_batch[1]) {
+			// every register is mapped, poll them back to back for the window
+			timespec_add_ns(&deadline, period_ns * slots);
+			for (samples = 0; !top_options.quit; ) {
+				top_sample(asic, samples == 0);
+				if (!(++samples % TOP_SAMPLE_BATCH)) {
+					clock_gettime(CLOCK_MONOTONIC, &now);
+					if (!timespec_before(&now, &deadline))
+						break;
+				}
+			}
+		} else if (top_options.adaptive) {
+			if (rate.max_ns != (uint64_t)period_ns * slots / 10)
+				umr_sample_rate_init(&rate, 1000000, (uint64_t)period_ns * slots / 10, 5);
+			end = deadline;
+			timespec_add_ns(&end, period_ns * slots);
+			for (samples = 0; !top_options.quit; ) {
+				top_sample(asic, samples == 0);
+				samples++;
+
+				clock_gettime(CLOCK_MONOTONIC, &now);
+				do
+					timespec_add_ns(&deadline, rate.step_ns);
+				while (timespec_before(&deadline, &now));
+				if (!timespec_before(&deadline, &end))
+					break;
+				clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+			}
+			deadline = end;
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+		} else {
+			for (i = samples = 0; i < (int)slots && !top_options.quit; ) {
+				top_sample(asic, i == 0);
+				samples++;
+
+				clock_gettime(CLOCK_MONOTONIC, &now);
+				do {
+					timespec_add_ns(&deadline, period_ns);
+					i++;
+				} while (i < (int)slots && timespec_before(&deadline, &now));
+				clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+			}
+		}
+		top_flush_samples();
+		if (top_options.adaptive)
+			umr_sample_rate_update(&rate, top_window_activity(samples));
+		// a clock that could not be set up (e.g. in GFXOFF) is tried
+		// again every window
+		if (top_dev->clock.valid)
+			umr_gpu_clock_calibrate(asic, &top_dev->clock);
+		else
+			umr_gpu_clock_init(asic, &top_dev->clock);
+		end_ns = top_stamp(top_dev);
+
+		pthread_mutex_lock(&top_dev->window.mutex);
+		for (j = 0; top_dev->stat_counters[j].name[0]; j++) {
+			for (k = 0; k < 32; k++) {
+				if (top_dev->stat_counters[j].is_sensor == 0 || top_dev->stat_counters[j].is_sensor == 3)
+					top_dev->stat_counters[j].window[k] = samples ? top_dev->stat_counters[j].counts[k] * slots / samples : 0;
+				else
+					top_dev->stat_counters[j].window[k] = top_dev->stat_counters[j].counts[k];
+			}
+		}
+		top_dev->window.samples = samples;
+		top_dev->window.expected = slots;
+		top_dev->window.seconds = (deadline.tv_sec - start.tv_sec) + (deadline.tv_nsec - start.tv_nsec) / 1000000000.0;
+		top_dev->window.end_ns = end_ns;
+		top_dev->window.generation++;
+		pthread_cond_signal(&top_dev->window.cond);
+		pthread_mutex_unlock(&top_dev->window.mutex);
+
+		pthread_mutex_lock(&top_log.lock);
+		if (top_log.fd >= 0 && !top_log.per_sample && top_log.dev == top_dev) {
+			top_log_u64(end_ns);
+			for (j = 0; j < top_log.no_columns; j++)
+				top_log_u64(top_dev->stat_counters[top_log.columns[j].counter].window[top_log.columns[j].bit]);
+		}
+		pthread_mutex_unlock(&top_log.lock);
+	}
+	return NULL;
+}
+
+/**
+ * top_device_init - Find the counters of a device and start its threads
+ *
+ * The bitfield tables are copied for each device so that devices of
+ * different families can be monitored side by side.
+ *
+ * Returns 0 on success, -1 if the threads can't be started.
+ */
+static int top_device_init(struct top_device *dev, struct umr_asic *asic)
+{
+	char fname[64];
+	struct umr_bitfield *bits;
+	int i, n;
+
+	memset(dev, 0, sizeof *dev);
+	dev->asic = asic;
+	pthread_mutex_init(&dev->window.mutex, NULL);
+	pthread_cond_init(&dev->window.cond, NULL);
+	top_dev = dev;
 
 	// open drm file if not already open
 	if (asic->fd.drm < 0) {
@@ -1137,87 +1710,214 @@ void umr_top(struct umr_asic *asic)
 		asic->fd.drm = open(fname, O_RDWR);
 	}
 
-	e = getenv("HOSTNAME");
-	if (e) {
-		strcpy(hostname, e);
-	} else {
-		strcpy(hostname, "(nohost)");
-	}
-
-	// init stats
-	memset(&stat_counters, 0, sizeof stat_counters);
-	load_options();
-
 	// select an architecture ...
 	top_build_vi_program(asic);
 
 	// add DRM info
-	for (i = 0; stat_counters[i].name[0]; i++);
+	for (i = 0; top_dev->stat_counters[i].name[0]; i++);
 	ENTRY(i, "", "DRM", &stat_drm_bits[0], &top_options.drm, "DRM");
-	stat_counters[i].is_sensor = 2;
-
-	for (i = 0; stat_counters[i].name[0]; i++) {
-		if (stat_counters[i].is_sensor == 0)
-			grab_bits(stat_counters[i].name, asic, stat_counters[i].bits, &stat_counters[i].addr);
-		else if (stat_counters[i].is_sensor == 3)
-			grab_addr(stat_counters[i].name, asic, stat_counters[i].bits, &stat_counters[i].addr);
+	top_dev->stat_counters[i].is_sensor = 2;
+
+	for (i = 0; top_dev->stat_counters[i].name[0]; i++) {
+		if (top_dev->stat_counters[i].is_sensor == 0 || top_dev->stat_counters[i].is_sensor == 3) {
+			for (n = 0; top_dev->stat_counters[i].bits[n].regname; n++);
+			bits = calloc(n + 1, sizeof *bits);
+			if (!bits)
+				return -1;
+			memcpy(bits, top_dev->stat_counters[i].bits, n * sizeof *bits);
+			top_dev->stat_counters[i].bits = bits;
+		}
+		if (top_dev->stat_counters[i].is_sensor == 0)
+			grab_bits(top_dev->stat_counters[i].name, asic, top_dev->stat_counters[i].bits, &top_dev->stat_counters[i].addr);
+		else if (top_dev->stat_counters[i].is_sensor == 3)
+			grab_addr(top_dev->stat_counters[i].name, asic, top_dev->stat_counters[i].bits, &top_dev->stat_counters[i].addr);
 	}
 
-	sensor_thread_quit = 0;
+	top_dev->visible_vram_size = get_visible_vram_size(asic);
+	umr_gpu_clock_init(asic, &dev->clock);
 
 	// start thread to grab sensor data
-	if (pthread_create(&sensor_thread, NULL, gpu_sensor_thread, asic)) {
+	if (pthread_create(&dev->sensor_thread, NULL, gpu_sensor_thread, dev)) {
 		fprintf(stderr, "[ERROR]: Cannot create gpu_sensor_thread\n");
-		return;
+		return -1;
 	}
+	dev->has_sensor_thread = 1;
 
-	visible_vram_size = get_visible_vram_size(asic);
+	if (pthread_create(&dev->sample_thread, NULL, top_sample_thread, dev)) {
+		fprintf(stderr, "[ERROR]: Cannot create top_sample_thread\n");
+		return -1;
+	}
+	dev->has_sample_thread = 1;
+	return 0;
+}
 
-	initscr();
-	start_color();
-	cbreak();
-	nodelay(stdscr, 1);
-	noecho();
+// stop the threads of a device, top_options.quit and sensor_thread_quit are set
+static void top_device_fini(struct top_device *dev)
+{
+	int i;
 
-	init_pair(1, COLOR_BLUE, COLOR_BLACK);
-	init_pair(2, COLOR_GREEN, COLOR_BLACK);
-	init_pair(3, COLOR_YELLOW, COLOR_BLACK);
-	init_pair(4, COLOR_RED, COLOR_BLACK);
+	if (dev->has_sample_thread)
+		pthread_join(dev->sample_thread, NULL);
+	if (dev->has_sensor_thread)
+		pthread_join(dev->sensor_thread, NULL);
+	for (i = 0; dev->stat_counters[i].name[0]; i++)
+		if (dev->stat_counters[i].is_sensor == 0 || dev->stat_counters[i].is_sensor == 3)
+			free(dev->stat_counters[i].bits);
+	umr_fence_tracker_close(dev->fences);
+	umr_fence_snapshot_free(&dev->fence_snap);
+}
 
-	// setup loop
-	if (top_options.high_precision)
-		rep = 1000;
-	else
-		rep = 100;
-	req.tv_sec = 0;
-	req.tv_nsec = 1000000000/rep; // 10ms
+// value of a counter bit in the last window of a device, or -1 if it isn't shown
+static int64_t top_find_count(struct top_device *dev, const char *tag, const char *name)
+{
+	int i, j;
+
+	for (i = 0; dev->stat_counters[i].name[0]; i++) {
+		if (strcmp(dev->stat_counters[i].tag, tag) || !(top_options.all || *dev->stat_counters[i].opt))
+			continue;
+		for (j = 0; dev->stat_counters[i].bits[j].regname; j++)
+			if (dev->stat_counters[i].bits[j].start != 255 && !strcmp(dev->stat_counters[i].bits[j].regname, name))
+				return dev->stat_counters[i].window[j];
+	}
+	return -1;
+}
+
+// one line per device for the combined view
+static void print_summary(struct top_device *devs, int no_devs, int selected)
+{
+	static const struct {
+		const char *tag, *name, *label;
+	} cols[] = {
+		{ "GRBM", "GUI", "GUI" },
+		{ "GRBM", "CP", "CP" },
+		{ "GRBM", "SPI", "SPI" },
+		{ "GRBM", "TA", "TA" },
+	};
+	int64_t v;
+	int d, c;
+
+	for (d = 0; d < no_devs; d++) {
+		pthread_mutex_lock(&devs[d].window.mutex);
+		printw("%c GPU #%-2d %-12s", d == selected ? '>' : ' ', devs[d].asic->instance, devs[d].asic->asicname);
+		for (c = 0; c < (int)ARRAY_SIZE(cols); c++) {
+			printw(" %s", cols[c].label);
+			if ((v = top_find_count(&devs[d], cols[c].tag, cols[c].name)) >= 0)
+				print_count_value(v);
+			else
+				printw("      -  ");
+		}
+		if ((v = top_find_count(&devs[d], "Sensors", "GFX_SCLK")) >= 0)
+			printw(" %5" PRIi64 " MHz", v);
+		if ((v = top_find_count(&devs[d], "Sensors", "GPU_TEMP")) >= 0)
+			printw(" %3" PRIi64 " C", v);
+		printw(" (%.0f Hz)\n", devs[d].window.seconds > 0 ? devs[d].window.samples / devs[d].window.seconds : 0.0);
+		pthread_mutex_unlock(&devs[d].window.mutex);
+	}
+}
+
+// start sampling devices, top_options.quit is set if one can't be started
+static void top_start(struct top_device *devs, struct umr_asic **asics, int no_asics)
+{
+	int d;
+
+	top_options.quit = 0;
+	sensor_thread_quit = 0;
+	for (d = 0; d < no_asics; d++) {
+		if (top_device_init(&devs[d], asics[d])) {
+			top_options.quit = 1;
+			break;
+		}
+	}
+	top_dev = &devs[0];
+}
+
+static void top_stop(struct top_device *devs, int no_asics)
+{
+	int d;
+
+	top_options.quit = 1;
+	sensor_thread_quit = 1;
+	for (d = 0; d < no_asics; d++) {
+		top_dev = &devs[d];
+		top_device_fini(&devs[d]);
+	}
+	top_log_close();
+	top_dev = NULL;
+}
+
+/*
+ * Show a list of devices, each sampled by threads of its own.  With more
+ * than one device a line per device is printed above the details of the
+ * selected one.
+ */
+static void top_run(struct umr_asic **asics, int no_asics)
+{
+	struct top_device *devs;
+	int i, j, k, d, selected = 0;
+	struct timespec ts;
+	unsigned *shown;
+	time_t tt;
+	char hostname[64] = { 0 };
+	char *e;
+	struct umr_asic *asic;
+
+	devs = calloc(no_asics, sizeof *devs);
+	shown = calloc(no_asics, sizeof *shown);
+	if (!devs || !shown) {
+		fprintf(stderr, "[ERROR]: Out of memory\n");
+		free(devs);
+		free(shown);
+		return;
+	}
+
+	e = getenv("HOSTNAME");
+	if (e) {
+		strcpy(hostname, e);
+	} else {
+		strcpy(hostname, "(nohost)");
+	}
+
+	load_options();
+	top_start(devs, asics, no_asics);
+
+	if (!top_options.quit) {
+		initscr();
+		start_color();
+		cbreak();
+		nodelay(stdscr, 1);
+		noecho();
+
+		init_pair(1, COLOR_BLUE, COLOR_BLACK);
+		init_pair(2, COLOR_GREEN, COLOR_BLACK);
+		init_pair(3, COLOR_YELLOW, COLOR_BLACK);
+		init_pair(4, COLOR_RED, COLOR_BLACK);
+	}
 
 	while (!top_options.quit) {
-		for (i = 0; stat_counters[i].name[0]; i++)
-			memset(stat_counters[i].counts, 0, sizeof(stat_counters[i].counts[0])*32);
-
-		for (i = 0; i < (int)rep / (top_options.high_frequency ? 10 : 1); i++) {
-			if (!top_options.sriov.num_vf || top_options.sriov.active_vf < 0 ||
-				top_options.sriov.active_vf == get_active_vf(asic, stat_counters[2].addr)) {
-				for (j = 0; stat_counters[j].name[0]; j++) {
-					if (top_options.all || *stat_counters[j].opt) {
-						if (stat_counters[j].is_sensor == 0)
-							parse_bits(asic, stat_counters[j].addr, stat_counters[j].bits, stat_counters[j].counts, stat_counters[j].mask, stat_counters[j].cmp, stat_counters[j].addr_mask);
-						else if (i == 0 && stat_counters[j].is_sensor == 1) // only parse sensors on first go-around per display
-							parse_sensors(asic, stat_counters[j].addr, stat_counters[j].bits, stat_counters[j].counts, stat_counters[j].mask, stat_counters[j].cmp, stat_counters[j].addr_mask);
-						else if (i == 0 && stat_counters[j].is_sensor == 2) // only parse drm on first go-around per display
-							parse_drm(asic, stat_counters[j].addr, stat_counters[j].bits, stat_counters[j].counts, stat_counters[j].mask, stat_counters[j].cmp, stat_counters[j].addr_mask);
-						else if (stat_counters[j].is_sensor == 3)
-							parse_iov(asic, stat_counters[j].addr, stat_counters[j].bits, stat_counters[j].counts, stat_counters[j].mask, stat_counters[j].cmp, stat_counters[j].addr_mask);
-					}
-				}
+		// wait for the next window, looking at the keys meanwhile
+		pthread_mutex_lock(&top_dev->window.mutex);
+		if (top_dev->window.generation == shown[selected]) {
+			clock_gettime(CLOCK_REALTIME, &ts);
+			timespec_add_ns(&ts, 50000000L);
+			pthread_cond_timedwait(&top_dev->window.cond, &top_dev->window.mutex, &ts);
+		}
+		pthread_mutex_unlock(&top_dev->window.mutex);
+		for (d = j = 0; d < no_asics; d++) {
+			pthread_mutex_lock(&devs[d].window.mutex);
+			if (devs[d].window.generation != shown[d]) {
+				shown[d] = devs[d].window.generation;
+				j = 1;
 			}
-			nanosleep(&req, NULL);
+			pthread_mutex_unlock(&devs[d].window.mutex);
 		}
+
+		if ((i = wgetch(stdscr)) == ERR && !j)
+			continue;
+
 		move(0, 0);
 		clear();
 
-		if ((i = wgetch(stdscr)) != ERR) {
+		if (i != ERR) {
 			switch (i) {
 			case 'q':  top_options.quit = 1; break;
 			case 'l':  toggle_logger(); break;
@@ -1225,36 +1925,35 @@ void umr_top(struct umr_asic *asic)
 			case 'w':  top_options.wide ^= 1; break;
 			case 'v':  top_options.vram ^= 1; break;
 			case 'W':  save_options(); break;
-			case '1':
-				top_options.high_precision ^= 1;
-				if (top_options.high_precision)
-					rep = 1000;
-				else
-					rep = 100;
-
-				req.tv_sec = 0;
-				req.tv_nsec = 1000000000/rep; // 10ms
-				break;
+			case '1': top_options.high_precision ^= 1; break;
 			case '2':
 				top_options.high_frequency ^= 1;
 				break;
+			case '3': top_options.turbo ^= 1; break;
+			case '4': top_options.adaptive ^= 1; break;
+			case '<':
+				selected = (selected + no_asics - 1) % no_asics;
+				break;
+			case '>':
+				selected = (selected + 1) % no_asics;
+				break;
 			case '[':
-				if (top_options.sriov.num_vf) {
-					top_options.sriov.active_vf--;
-					if (top_options.sriov.active_vf < 0)
-						top_options.sriov.active_vf = top_options.sriov.num_vf - 1;
+				if (top_dev->sriov.num_vf) {
+					top_dev->sriov.active_vf--;
+					if (top_dev->sriov.active_vf < 0)
+						top_dev->sriov.active_vf = top_dev->sriov.num_vf - 1;
 				}
 				break;
 			case ']':
-				if (top_options.sriov.num_vf) {
-					top_options.sriov.active_vf++;
-					if (top_options.sriov.active_vf >= top_options.sriov.num_vf)
-						top_options.sriov.active_vf = 0;
+				if (top_dev->sriov.num_vf) {
+					top_dev->sriov.active_vf++;
+					if (top_dev->sriov.active_vf >= top_dev->sriov.num_vf)
+						top_dev->sriov.active_vf = 0;
 				}
 				break;
 			case '=':
-				if (top_options.sriov.num_vf) {
-					top_options.sriov.active_vf = -1;
+				if (top_dev->sriov.num_vf) {
+					top_dev->sriov.active_vf = -1;
 				}
 				break;
 			case 'r': top_options.drm ^= 1; break;
@@ -1262,21 +1961,30 @@ void umr_top(struct umr_asic *asic)
 				top_options.handle_key(i);
 			}
 		}
+		top_dev = &devs[selected];
+		asic = top_dev->asic;
+
+		if (no_asics > 1) {
+			print_summary(devs, no_asics, selected);
+			printw("\n");
+		}
+
+		pthread_mutex_lock(&top_dev->window.mutex);
 
 		tt = time(NULL);
-		printw("(%s[%s]) %s%s -- %s",
+		printw("(%s[%s]) %s(sample @ %s, report @ %s, %.0f Hz achieved) -- %s",
 			hostname, asic->asicname,
 			top_options.logger ? "(logger enabled) " : "",
-			top_options.high_frequency ?
-				(top_options.high_precision ? "(sample @ 1ms, report @ 100ms)" : "(sample @ 10ms, report @ 100ms)") :
-				(top_options.high_precision ? "(sample @ 1ms, report @ 1000ms)" : "(sample @ 10ms, report @ 1000ms)"),
+			top_options.turbo && umr_pci_regs(asic) ? "turbo" :
+			top_options.adaptive ? "adaptive" : top_options.high_precision ? "1ms" : "10ms",
+			top_options.high_frequency ? "100ms" : "1000ms",
+			top_dev->window.seconds > 0 ? top_dev->window.samples / top_dev->window.seconds : 0.0,
 			ctime(&tt));
-
 		// figure out padding
-		for (i = maxstrlen = 0; stat_counters[i].name[0]; i++)
-			if (top_options.all || *stat_counters[i].opt)
-				for (j = 0; stat_counters[i].bits[j].regname; j++)
-					if (stat_counters[i].bits[j].start != 255 && (k = strlen(stat_counters[i].bits[j].regname)) > maxstrlen)
+		for (i = maxstrlen = 0; top_dev->stat_counters[i].name[0]; i++)
+			if (top_options.all || *top_dev->stat_counters[i].opt)
+				for (j = 0; top_dev->stat_counters[i].bits[j].regname; j++)
+					if (top_dev->stat_counters[i].bits[j].start != 255 && (k = strlen(top_dev->stat_counters[i].bits[j].regname)) > maxstrlen)
 						maxstrlen = k;
 		snprintf(namefmt, sizeof(namefmt)-1, "%%%ds => ", maxstrlen + 1);
 
@@ -1286,31 +1994,32 @@ void umr_top(struct umr_asic *asic)
 			clock_gettime(CLOCK_MONOTONIC, &tp);
 			fprintf(logfile, "%f,", ((double)tp.tv_sec * 1000000000.0 + tp.tv_nsec) / 1000000000.0);
 		}
-		for (i = 0; stat_counters[i].name[0]; i++) {
-			if (top_options.all || *stat_counters[i].opt) {
+		for (i = 0; top_dev->stat_counters[i].name[0]; i++) {
+			if (top_options.all || *top_dev->stat_counters[i].opt) {
 				if (logfile != NULL) {
-					for (j = 0; stat_counters[i].bits[j].regname != 0; j++) {
-						if (stat_counters[i].bits[j].start != 255)
-							fprintf(logfile, "%llu,", (unsigned long long)stat_counters[i].counts[j]);
+					for (j = 0; top_dev->stat_counters[i].bits[j].regname != 0; j++) {
+						if (top_dev->stat_counters[i].bits[j].start != 255)
+							fprintf(logfile, "%llu,", (unsigned long long)top_dev->stat_counters[i].window[j]);
 					}
 				}
-				if (!i || strcmp(stat_counters[i-1].tag, stat_counters[i].tag)) {
+				if (!i || strcmp(top_dev->stat_counters[i-1].tag, top_dev->stat_counters[i].tag)) {
 					if (print_j & (top_options.wide ? 3 : 1))
 						printw("\n");
-					printw("\n%s Bits:\n", stat_counters[i].tag);
+					printw("\n%s Bits:\n", top_dev->stat_counters[i].tag);
 					print_j = 0;
 				}
 
-				if (stat_counters[i].is_sensor == 0)
-					print_counts(stat_counters[i].bits, stat_counters[i].counts);
-				else if (stat_counters[i].is_sensor == 1)
-					print_sensors(stat_counters[i].bits, stat_counters[i].counts);
-				else if (stat_counters[i].is_sensor == 2)
-					print_drm(stat_counters[i].bits, stat_counters[i].counts);
-				else if (stat_counters[i].is_sensor == 3)
-					print_iov(stat_counters[i].counts);
+				if (top_dev->stat_counters[i].is_sensor == 0)
+					print_counts(top_dev->stat_counters[i].bits, top_dev->stat_counters[i].window);
+				else if (top_dev->stat_counters[i].is_sensor == 1)
+					print_sensors(top_dev->stat_counters[i].bits, top_dev->stat_counters[i].window);
+				else if (top_dev->stat_counters[i].is_sensor == 2)
+					print_drm(top_dev->stat_counters[i].bits, top_dev->stat_counters[i].window);
+				else if (top_dev->stat_counters[i].is_sensor == 3)
+					print_iov(top_dev->stat_counters[i].window);
 			}
 		}
+		pthread_mutex_unlock(&top_dev->window.mutex);
 		if (logfile != NULL) {
 			fprintf(logfile, "\n");
 		}
@@ -1323,14 +2032,534 @@ void umr_top(struct umr_asic *asic)
 		}
 		if (print_j & (top_options.wide ? 3 : 1))
 			printw("\n");
-		printw("\n(a)ll (w)ide (1)high_precision (2)high_frequency (W)rite (l)ogger\n(v)ram d(r)m\n%s", top_options.helptext);
-		if (top_options.sriov.num_vf) {
+		printw("\n(a)ll (w)ide (1)high_precision (2)high_frequency (3)turbo (4)adaptive (W)rite (l)ogger\n(v)ram d(r)m\n%s", top_options.helptext);
+		if (top_dev->sriov.num_vf) {
 			printw("([)prev VF (])next VF (=)all VF\n");
 		}
+		if (no_asics > 1) {
+			printw("(<)prev GPU (>)next GPU\n");
+		}
 		refresh();
 	}
-	endwin();
+	if (!isendwin())
+		endwin();
 
-	sensor_thread_quit = 1;
-	pthread_join(sensor_thread, NULL);
+	top_stop(devs, no_asics);
+	free(devs);
+	free(shown);
+}
+
+void umr_top(struct umr_asic *asic)
+{
+	top_run(&asic, 1);
+}
+
+static void top_gfxoff(struct umr_asic **asics, int no_asics, uint32_t value)
+{
+	int x;
+
+	for (x = 0; x < no_asics; x++) {
+		if (value)
+			umr_gfxoff_release(asics[x]);
+		else
+			umr_gfxoff_hold(asics[x]);
+	}
+}
+
+/**
+ * umr_top_all - Run --top on every device at once
+ *
+ * @options: Options every device is opened with
+ *
+ * The devices share the register databases (which are only read once per
+ * process) and each one is sampled by threads of its own.
+ */
+void umr_top_all(struct umr_options *options)
+{
+	struct umr_asic **asics;
+	int no_asics;
+
+	if (umr_enumerate_device_list(printf, options->database_path, options, &asics, &no_asics, 0) || !no_asics) {
+		fprintf(stderr, "[ERROR]: No devices found\n");
+		return;
+	}
+	top_gfxoff(asics, no_asics, 0);
+	top_run(asics, no_asics);
+	top_gfxoff(asics, no_asics, 1);
+	umr_enumerate_device_list_free(asics);
+}
+
+/*
+ * Exporter
+ *
+ * umr_top_export() runs the sampling threads of --top without a display.
+ * After every window the metrics of all devices are formatted once into
+ * an OpenMetrics page and/or pushed as statsd gauges, a scrape only copies
+ * the last page so it doesn't cost any register reads.
+ */
+static struct {
+	pthread_mutex_t lock;
+	char *page;
+	size_t page_len;
+	int http_fd, statsd_fd;
+	struct sockaddr_storage statsd_addr;
+	socklen_t statsd_addrlen;
+	char statsd[1400];
+	int statsd_len;
+} top_export = { .lock = PTHREAD_MUTEX_INITIALIZER, .http_fd = -1, .statsd_fd = -1 };
+
+enum top_metric_family {
+	TOP_METRIC_BUSY = 0,
+	TOP_METRIC_SENSOR,
+	TOP_METRIC_DRM,
+	TOP_METRIC_VF_BUSY,
+	TOP_METRIC_RATE,
+	TOP_METRIC_MAX,
+};
+
+static const struct {
+	const char *name, *help;
+} top_metric_families[TOP_METRIC_MAX] = {
+	{ "umr_busy_ratio", "Fraction of the samples of the last window a status bit was set" },
+	{ "umr_sensor", "Last value of a power sensor, in the unit of its unit label" },
+	{ "umr_drm", "Last value of an amdgpu DRM info query" },
+	{ "umr_vf_busy_ratio", "Fraction of the samples of the last window a virtual function was active" },
+	{ "umr_sample_rate_hertz", "Samples taken per second in the last window" },
+};
+
+typedef void (*top_metric_fn)(void *data, struct top_device *dev, int family, const char *block, const char *field, const char *unit, double value);
+
+// call fn for every metric of a family of a device, the window mutex is held
+static void top_device_metrics(struct top_device *dev, int family, top_metric_fn fn, void *data)
+{
+	struct top_counter *c;
+	double busy, value;
+	const char *unit;
+	char vf[8];
+	int i, j;
+
+	busy = top_options.high_precision ? 1000.0 : 100.0;
+	if (family == TOP_METRIC_RATE) {
+		fn(data, dev, family, NULL, NULL, NULL, dev->window.seconds > 0 ? dev->window.samples / dev->window.seconds : 0.0);
+		return;
+	}
+
+	for (i = 0; dev->stat_counters[i].name[0]; i++) {
+		c = &dev->stat_counters[i];
+		if (c->is_sensor == 3) {
+			if (family != TOP_METRIC_VF_BUSY)
+				continue;
+			for (j = 0; j < dev->sriov.num_vf && j < 32; j++) {
+				snprintf(vf, sizeof vf, "VF%02d", j);
+				fn(data, dev, family, c->tag, vf, NULL, c->window[j] / busy);
+			}
+			continue;
+		}
+		if ((c->is_sensor == 0 && family != TOP_METRIC_BUSY) ||
+		    (c->is_sensor == 1 && family != TOP_METRIC_SENSOR) ||
+		    (c->is_sensor == 2 && family != TOP_METRIC_DRM))
+			continue;
+		for (j = 0; c->bits[j].regname; j++) {
+			if (c->bits[j].start == 255)
+				continue;
+			value = c->window[j];
+			unit = NULL;
+			if (c->is_sensor == 0) {
+				value /= busy;
+			} else if (c->is_sensor == 1) {
+				switch (c->bits[j].stop >> 4) {
+				case SENSOR_MILLIVOLT: unit = "V"; value /= 1000.0; break;
+				case SENSOR_MHZ: unit = "MHz"; break;
+				case SENSOR_PERCENT: unit = "percent"; break;
+				case SENSOR_TEMP: unit = "celsius"; break;
+				case SENSOR_POWER: unit = "W"; value /= 100.0; break;
+				}
+			} else if (c->bits[j].stop == DRM_INFO_BYTES) {
+				unit = "bytes";
+			}
+			fn(data, dev, family, c->tag, c->bits[j].regname, unit, value);
+		}
+	}
+}
+
+// the page being written and the end of the window taken under its mutex
+struct top_openmetrics_window {
+	FILE *f;
+	uint64_t end_ns;	// 0 until the first window closed
+};
+
+static void top_openmetrics_sample(void *data, struct top_device *dev, int family, const char *block, const char *field, const char *unit, double value)
+{
+	struct top_openmetrics_window *w = data;
+	FILE *f = w->f;
+	uint64_t ns;
+
+	fprintf(f, "%s{gpu=\"%d\",asic=\"%s\"", top_metric_families[family].name, dev->asic->instance, dev->asic->asicname);
+	if (block)
+		fprintf(f, ",block=\"%s\",field=\"%s\"", block, field);
+	if (unit)
+		fprintf(f, ",unit=\"%s\"", unit);
+	if (!w->end_ns) {
+		// no timestamp rather than one from the raw clock's epoch
+		fprintf(f, "} %g\n", value);
+		return;
+	}
+	ns = top_raw_to_realtime(w->end_ns);
+	fprintf(f, "} %g %" PRIu64 ".%03" PRIu64 "\n", value, ns / 1000000000, ns / 1000000 % 1000);
+}
+
+static void top_statsd_flush(void)
+{
+	if (top_export.statsd_len) {
+		if (sendto(top_export.statsd_fd, top_export.statsd, top_export.statsd_len, MSG_DONTWAIT,
+			   (struct sockaddr *)&top_export.statsd_addr, top_export.statsd_addrlen) < 0 && errno != EAGAIN)
+			fprintf(stderr, "[WARNING]: Cannot send to the statsd sink: %s\n", strerror(errno));
+		top_export.statsd_len = 0;
+	}
+}
+
+// add a gauge to the statsd datagram, sending it when full
+static void top_statsd_sample(void *data, struct top_device *dev, int family, const char *block, const char *field, const char *unit, double value)
+{
+	char line[160];
+	int n;
+
+	(void)data; (void)unit;
+	if (block)
+		n = snprintf(line, sizeof line, "%s.gpu%d.%s.%s:%g|g\n", top_metric_families[family].name, dev->asic->instance, block, field, value);
+	else
+		n = snprintf(line, sizeof line, "%s.gpu%d:%g|g\n", top_metric_families[family].name, dev->asic->instance, value);
+	if (n <= 0 || n >= (int)sizeof line)
+		return;
+	if (top_export.statsd_len + n > (int)sizeof top_export.statsd)
+		top_statsd_flush();
+	memcpy(top_export.statsd + top_export.statsd_len, line, n);
+	top_export.statsd_len += n;
+}
+
+// format the last windows of every device and publish them
+static void top_export_window(struct top_device *devs, int no_devs)
+{
+	struct top_openmetrics_window w;
+	FILE *f = NULL;
+	char *page = NULL;
+	size_t len = 0;
+	int family, d;
+
+	if (top_export.http_fd >= 0 && !(f = open_memstream(&page, &len)))
+		return;
+
+	for (family = 0; family < TOP_METRIC_MAX; family++) {
+		if (f)
+			fprintf(f, "# TYPE %s gauge\n# HELP %s %s.\n",
+				top_metric_families[family].name, top_metric_families[family].name, top_metric_families[family].help);
+		for (d = 0; d < no_devs; d++) {
+			pthread_mutex_lock(&devs[d].window.mutex);
+			if (devs[d].window.generation) {
+				if (f) {
+					w.f = f;
+					w.end_ns = devs[d].window.end_ns;
+					top_device_metrics(&devs[d], family, top_openmetrics_sample, &w);
+				}
+				if (top_export.statsd_fd >= 0)
+					top_device_metrics(&devs[d], family, top_statsd_sample, NULL);
+			}
+			pthread_mutex_unlock(&devs[d].window.mutex);
+		}
+	}
+	if (top_export.statsd_fd >= 0)
+		top_statsd_flush();
+
+	if (f) {
+		fprintf(f, "# EOF\n");
+		if (fclose(f)) {
+			free(page);
+			return;
+		}
+		pthread_mutex_lock(&top_export.lock);
+		free(top_export.page);
+		top_export.page = page;
+		top_export.page_len = len;
+		pthread_mutex_unlock(&top_export.lock);
+	}
+}
+
+static int top_write_all(int fd, const char *buf, size_t len)
+{
+	ssize_t r;
+
+	while (len) {
+		r = write(fd, buf, len);
+		if (r <= 0) {
+			if (r < 0 && errno == EINTR)
+				continue;
+			return -1;
+		}
+		buf += r;
+		len -= r;
+	}
+	return 0;
+}
+
+// answer one HTTP request with a copy of the last page
+static void top_http_serve(int fd)
+{
+	static const char not_found[] = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+	char req[1024], hdr[256], *page;
+	size_t len;
+	ssize_t r;
+	int n;
+
+	r = read(fd, req, sizeof(req) - 1);
+	if (r <= 0)
+		return;
+	req[r] = 0;
+	if (strncmp(req, "GET /metrics", 12) || (req[12] != ' ' && req[12] != '?')) {
+		top_write_all(fd, not_found, sizeof(not_found) - 1);
+		return;
+	}
+
+	pthread_mutex_lock(&top_export.lock);
+	len = top_export.page_len;
+	page = malloc(len + 1);
+	if (page)
+		memcpy(page, top_export.page ? top_export.page : "", len);
+	pthread_mutex_unlock(&top_export.lock);
+	if (!page)
+		return;
+
+	n = snprintf(hdr, sizeof hdr,
+		"HTTP/1.0 200 OK\r\n"
+		"Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+		"Content-Length: %zu\r\nConnection: close\r\n\r\n", len);
+	if (!top_write_all(fd, hdr, n))
+		top_write_all(fd, page, len);
+	free(page);
+}
+
+static void *top_http_thread(void *data)
+{
+	struct timeval tv = { .tv_sec = 1 };
+	struct pollfd pfd;
+	int fd;
+
+	(void)data;
+	pfd.fd = top_export.http_fd;
+	pfd.events = POLLIN;
+	while (!top_options.quit) {
+		if (poll(&pfd, 1, 100) <= 0)
+			continue;
+		fd = accept(top_export.http_fd, NULL, NULL);
+		if (fd < 0)
+			continue;
+		// a client that doesn't send its request can't stall the others for long
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+		setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof tv);
+		top_http_serve(fd);
+		close(fd);
+	}
+	return NULL;
+}
+
+// split "[host:]port" at the last colon
+static int top_parse_hostport(const char *spec, char *host, size_t hostlen, char *port, size_t portlen, const char *defhost)
+{
+	const char *colon = strrchr(spec, ':');
+
+	if (colon) {
+		if ((size_t)(colon - spec) >= hostlen)
+			return -1;
+		memcpy(host, spec, colon - spec);
+		host[colon - spec] = 0;
+		spec = colon + 1;
+	} else {
+		snprintf(host, hostlen, "%s", defhost);
+	}
+	if (!*spec || strlen(spec) >= portlen)
+		return -1;
+	strcpy(port, spec);
+	return 0;
+}
+
+static int top_export_listen(const char *spec)
+{
+	struct addrinfo hints, *res, *ai;
+	char host[256], port[16];
+	int fd = -1, one = 1;
+
+	if (top_parse_hostport(spec, host, sizeof host, port, sizeof port, "")) {
+		fprintf(stderr, "[ERROR]: Invalid listen address '%s'\n", spec);
+		return -1;
+	}
+	memset(&hints, 0, sizeof hints);
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	if (getaddrinfo(host[0] ? host : NULL, port, &hints, &res)) {
+		fprintf(stderr, "[ERROR]: Cannot resolve '%s'\n", spec);
+		return -1;
+	}
+	for (ai = res; ai; ai = ai->ai_next) {
+		fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+		if (fd < 0)
+			continue;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+		if (!bind(fd, ai->ai_addr, ai->ai_addrlen) && !listen(fd, 16))
+			break;
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+	if (fd < 0)
+		fprintf(stderr, "[ERROR]: Cannot listen on '%s': %s\n", spec, strerror(errno));
+	return fd;
+}
+
+static int top_export_statsd(const char *spec)
+{
+	struct addrinfo hints, *res;
+	char host[256], port[16];
+
+	if (top_parse_hostport(spec, host, sizeof host, port, sizeof port, "localhost")) {
+		fprintf(stderr, "[ERROR]: Invalid statsd address '%s'\n", spec);
+		return -1;
+	}
+	memset(&hints, 0, sizeof hints);
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	if (getaddrinfo(host, port, &hints, &res)) {
+		fprintf(stderr, "[ERROR]: Cannot resolve '%s'\n", spec);
+		return -1;
+	}
+	top_export.statsd_fd = socket(res->ai_family, res->ai_socktype | SOCK_CLOEXEC, res->ai_protocol);
+	if (top_export.statsd_fd >= 0) {
+		memcpy(&top_export.statsd_addr, res->ai_addr, res->ai_addrlen);
+		top_export.statsd_addrlen = res->ai_addrlen;
+	} else {
+		fprintf(stderr, "[ERROR]: Cannot create the statsd socket: %s\n", strerror(errno));
+	}
+	freeaddrinfo(res);
+	return top_export.statsd_fd < 0 ? -1 : 0;
+}
+
+static void top_export_sigint(int signo)
+{
+	(void)signo;
+	top_options.quit = 1;
+}
+
+/**
+ * umr_top_export - Sample every device like --top-all and export the windows
+ *
+ * @options: Options every device is opened with
+ * @spec: Comma separated list of "http:[<addr>:]<port>" and
+ *        "statsd:[<host>:]<port>" sinks
+ *
+ * Runs until SIGINT or SIGTERM.  Every counter is sampled (as with the
+ * '(a)ll' key of --top) with the window and precision saved with 'W'.
+ *
+ * Returns 0 on a clean exit, -1 on error.
+ */
+int umr_top_export(struct umr_options *options, const char *spec)
+{
+	struct umr_asic **asics;
+	struct top_device *devs = NULL;
+	struct sigaction sa, old_int, old_term;
+	pthread_t http_thread;
+	unsigned *seen = NULL;
+	char *specs, *tok, *save;
+	int no_asics, d, fresh, ret = -1, has_http_thread = 0;
+
+	specs = strdup(spec);
+	if (!specs)
+		return -1;
+	for (tok = strtok_r(specs, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+		if (!strncmp(tok, "http:", 5) && top_export.http_fd < 0) {
+			if ((top_export.http_fd = top_export_listen(tok + 5)) < 0)
+				goto out;
+		} else if (!strncmp(tok, "statsd:", 7) && top_export.statsd_fd < 0) {
+			if (top_export_statsd(tok + 7))
+				goto out;
+		} else {
+			fprintf(stderr, "[ERROR]: Invalid --top-export sink '%s'\n", tok);
+			goto out;
+		}
+	}
+
+	if (umr_enumerate_device_list(printf, options->database_path, options, &asics, &no_asics, 0) || !no_asics) {
+		fprintf(stderr, "[ERROR]: No devices found\n");
+		goto out;
+	}
+	devs = calloc(no_asics, sizeof *devs);
+	seen = calloc(no_asics, sizeof *seen);
+	if (!devs || !seen) {
+		fprintf(stderr, "[ERROR]: Out of memory\n");
+		goto out_devices;
+	}
+
+	memset(&sa, 0, sizeof sa);
+	sa.sa_handler = top_export_sigint;
+	sigaction(SIGINT, &sa, &old_int);
+	sigaction(SIGTERM, &sa, &old_term);
+
+	load_options();
+	top_options.all = 1;
+	top_gfxoff(asics, no_asics, 0);
+	top_start(devs, asics, no_asics);
+	if (!top_options.quit && top_export.http_fd >= 0) {
+		if (pthread_create(&http_thread, NULL, top_http_thread, NULL)) {
+			fprintf(stderr, "[ERROR]: Cannot create the HTTP thread\n");
+			top_options.quit = 1;
+		} else {
+			has_http_thread = 1;
+		}
+	}
+	if (!top_options.quit)
+		ret = 0;
+
+	while (!top_options.quit) {
+		// publish once per window of the first device, or when another
+		// device has finished one in the meantime
+		pthread_mutex_lock(&devs[0].window.mutex);
+		if (devs[0].window.generation == seen[0]) {
+			struct timespec ts;
+			clock_gettime(CLOCK_REALTIME, &ts);
+			timespec_add_ns(&ts, 100000000L);
+			pthread_cond_timedwait(&devs[0].window.cond, &devs[0].window.mutex, &ts);
+		}
+		pthread_mutex_unlock(&devs[0].window.mutex);
+
+		for (d = fresh = 0; d < no_asics; d++) {
+			pthread_mutex_lock(&devs[d].window.mutex);
+			if (devs[d].window.generation != seen[d]) {
+				seen[d] = devs[d].window.generation;
+				fresh = 1;
+			}
+			pthread_mutex_unlock(&devs[d].window.mutex);
+		}
+		if (fresh)
+			top_export_window(devs, no_asics);
+	}
+
+	if (has_http_thread)
+		pthread_join(http_thread, NULL);
+	top_stop(devs, no_asics);
+	top_gfxoff(asics, no_asics, 1);
+	sigaction(SIGINT, &old_int, NULL);
+	sigaction(SIGTERM, &old_term, NULL);
+out_devices:
+	free(devs);
+	free(seen);
+	umr_enumerate_device_list_free(asics);
+out:
+	free(specs);
+	if (top_export.http_fd >= 0)
+		close(top_export.http_fd);
+	if (top_export.statsd_fd >= 0)
+		close(top_export.statsd_fd);
+	top_export.http_fd = top_export.statsd_fd = -1;
+	free(top_export.page);
+	top_export.page = NULL;
+	top_export.page_len = 0;
+	return ret;
 }
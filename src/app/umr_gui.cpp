@@ -24,7 +24,9 @@
  */
 #include "parson.h"
 #include <fcntl.h>
+#include <map>
 #include <mutex>
+#include <string>
 #include <unistd.h>
 #include <vector>
 #include <stdio.h>
@@ -47,6 +49,8 @@
 
 extern "C" {
 #include "umr_rumr.h"
+#include "gui/wire.h"
+#include "gui/session.h"
 }
 
 /* Random helpers */
@@ -54,7 +58,8 @@ extern void send_request(JSON_Value *req, struct umr_asic *asic);
 extern void force_redraw();
 extern void add_vertical_line(const ImVec2& avail);
 extern bool kb_shortcut(int keycode);
-extern GLuint texture_from_qoi_buffer(int width, int height, void *buffer, int buffer_size);
+extern GLuint texture_from_qoi_tiles(GLuint texture, int width, int height, JSON_Array *tiles,
+									 void *buffer, int buffer_size);
 extern void goto_tab(int keycode);
 extern float get_gui_scale();
 extern "C" {
@@ -187,7 +192,7 @@ struct umr_bitfield * draw_value_as_bitfield(umr_bitfield *bitfield, int n_field
 	for (int j = 0; j < n_fields; j++) {
 		struct umr_bitfield *bit = &bitfield[j];
 
-		uint64_t mask = (1llu << (1 + (bit->stop - bit->start))) - 1;
+		uint64_t mask = umr_bitfield_mask(bit);
 		uint64_t v = ((new_value ? *new_value : value) >> bit->start) & mask;
 		uint64_t v_original = (value >> bit->start) & mask;
 
@@ -220,45 +225,31 @@ struct umr_bitfield * draw_value_as_bitfield(umr_bitfield *bitfield, int n_field
 struct Link {
 	struct rumr_comm_funcs *cf; /* NULL if replaying a session. */
 	char *addr;
+	bool binary; /* the server takes binary messages (see wire.h) */
 };
 
-static void save_to_disk(const char *session_folder, int msg_idx,
-						 const char *answer_as_str, size_t answer_len,
-						 void *raw_data, int raw_data_size) {
-	char filename[PATH_MAX];
-
-	sprintf(filename, "%s/%d.json", session_folder, msg_idx);
-	FILE *f = fopen(filename, "w");
-	if (f) {
-		fwrite(answer_as_str, 1, answer_len, f);
-		fclose(f);
-
-		if (raw_data_size) {
-			sprintf(filename, "%s/%d.raw", session_folder, msg_idx);
-			FILE *f = fopen(filename, "wb");
-			if (f) {
-				uint32_t s = htole32(raw_data_size);
-				fwrite(&s, 1, sizeof(raw_data_size), f);
-				fwrite(raw_data, 1, raw_data_size, f);
-				fclose(f);
-			}
-		}
-	}
-}
-
+/* The raw data of an answer from the server points into the buffer it was
+ * received in, returned in *rx, which the caller frees with
+ * rumr_buffer_free() once done with the answer.  Otherwise *rx is NULL and
+ * the raw data (if any) is freed with free(). */
 JSON_Value *query(struct Link& lnk, JSON_Value *request,
-				  void **raw_data, unsigned *raw_data_size,
-				  const char *session_folder, int msg_idx) {
+				  void **raw_data, unsigned *raw_data_size, struct rumr_buffer **rx,
+				  struct umr_session_log *log, int msg_idx) {
+	*rx = NULL;
 	#if UMR_SERVER
 	if (lnk.cf) {
-		char* s = json_serialize_to_string(request);
-		int len = strlen(s) + 1;
-
 		struct rumr_buffer *buf = rumr_buffer_init();
-		rumr_buffer_add_data(buf, s, len);
-		json_free_serialized_string(s);
+		if (lnk.binary) {
+			rumr_buffer_add_uint32(buf, UMR_WIRE_MAGIC);
+			umr_wire_encode(buf, request);
+		} else {
+			char* s = json_serialize_to_string(request);
+			rumr_buffer_add_data(buf, s, strlen(s) + 1);
+			json_free_serialized_string(s);
+		}
+		int len = buf->woffset;
 
-		int r = lnk.cf->tx(lnk.cf, buf);
+		int r = buf->failed ? -1 : lnk.cf->tx(lnk.cf, buf);
 		json_value_free(request);
 		rumr_buffer_free(buf);
 
@@ -280,27 +271,48 @@ JSON_Value *query(struct Link& lnk, JSON_Value *request,
 		char *buffer = (char*)buf->data;
 		len = buf->woffset;
 
-		int strl = strlen(&buffer[sizeof(uint32_t)]) + 1;
-		memcpy(raw_data_size, buffer, sizeof(uint32_t));
-		assert(len == sizeof(uint32_t) + strl + *raw_data_size);
-		JSON_Value *out = json_parse_string(&buffer[sizeof(uint32_t)]);
+		/* The answer sits between the raw data size and the raw data. */
+		JSON_Value *out;
+		uint32_t head, answer_len;
+		if (lnk.binary) {
+			uint32_t magic = 0;
+			head = 2 * sizeof(uint32_t);
+			out = NULL;
+			answer_len = 0;
+			if (len >= (int)head) {
+				memcpy(&magic, buffer, sizeof(uint32_t));
+				memcpy(raw_data_size, &buffer[sizeof(uint32_t)], sizeof(uint32_t));
+				if (magic == UMR_WIRE_MAGIC)
+					out = umr_wire_decode((uint8_t*)&buffer[head], len - head, &answer_len);
+			}
+			if (out == NULL) {
+				printf("Invalid binary answer (%d bytes)\n", len);
+				rumr_buffer_free(buf);
+				return NULL;
+			}
+		} else {
+			head = sizeof(uint32_t);
+			answer_len = strlen(&buffer[head]) + 1;
+			memcpy(raw_data_size, buffer, sizeof(uint32_t));
+			out = json_parse_string(&buffer[head]);
+		}
+		assert(len == head + answer_len + *raw_data_size);
 		if (json_object_get_boolean(json_object(out), "has_raw_data")) {
 			assert(*raw_data_size);
-			*raw_data = malloc(*raw_data_size);
-			memcpy(*raw_data,
-				   &buffer[sizeof(uint32_t) + strl],
-				   *raw_data_size);
+			*raw_data = &buffer[head + answer_len];
 		} else {
 			assert(*raw_data_size == 0);
 		}
 
-		/* Save to disk for replay */
-		if (session_folder)
-			save_to_disk(session_folder, msg_idx,
-						 &buffer[sizeof(uint32_t)], strl,
-						 raw_data ? *raw_data : NULL, *raw_data_size);
+		/* Record for replay */
+		if (log)
+			umr_session_log_append(log, msg_idx, lnk.binary, &buffer[head], answer_len,
+								   *raw_data, *raw_data_size);
 
-		rumr_buffer_free(buf);
+		if (*raw_data_size)
+			*rx = buf;
+		else
+			rumr_buffer_free(buf);
 
 		return out;
 	} else
@@ -308,11 +320,9 @@ JSON_Value *query(struct Link& lnk, JSON_Value *request,
 	{
 		JSON_Value *in = umr_process_json_request(json_object(request), raw_data, raw_data_size);
 
-		if (session_folder) {
+		if (log) {
 			char *s = json_serialize_to_string(in);
-			save_to_disk(session_folder, msg_idx,
-						 s, strlen(s),
-						 raw_data ? *raw_data : NULL, *raw_data_size);
+			umr_session_log_append(log, msg_idx, 0, s, strlen(s) + 1, *raw_data, *raw_data_size);
 			json_free_serialized_string(s);
 		}
 
@@ -326,8 +336,7 @@ void force_redraw() {
 	SDL_PushEvent(&evt);
 }
 
-static struct Link lnk;
-static pthread_cond_t cond;
+static struct Link lnk; /* never connected, each lane connects a copy */
 static bool done;
 
 struct AsicData {
@@ -401,7 +410,129 @@ struct AsicData {
 	std::vector<Panel*> panels;
 };
 
-std::vector<JSON_Value*> pending_request;
+/* Requests are served by lanes, one per asic and class of request plus
+ * one for those not tied to an asic (and the subscriptions), each with its
+ * own thread and connection to the server.  A slow ring or waves read on
+ * one asic then doesn't hold up the panels of another, or the register
+ * reads of its own.  A read still queued is dropped when the same one is
+ * asked for again. */
+enum RequestClass { REQUEST_INTERACTIVE, REQUEST_BULK };
+
+struct Lane {
+	unsigned did;
+	int instance; /* -1 for the lane of requests without an asic */
+	int cls;
+	std::vector<JSON_Value*> queue;
+	int in_flight;
+	pthread_cond_t cond;
+	pthread_t thread;
+	bool has_thread;
+	struct Link link;
+};
+
+static std::vector<Lane*> lanes;
+static bool lanes_started; /* not when replaying */
+static void *lane_thread(void *arg);
+
+static bool command_in(const char *command, const char **list, int n) {
+	for (int i = 0; i < n; i++) {
+		if (!strcmp(command, list[i]))
+			return true;
+	}
+	return false;
+}
+
+static int request_class(const char *command) {
+	const char *bulk[] = {
+		"ring", "waves", "singlestep", "vm-read", "vm-decode", "peak-bo", "gem-info", "kms"
+	};
+	return command_in(command, bulk, ARRAY_SIZE(bulk)) ? REQUEST_BULK : REQUEST_INTERACTIVE;
+}
+
+/* Reads that a newer identical request makes useless. */
+static bool request_coalesces(JSON_Object *req) {
+	const char *reads[] = {
+		"ring", "waves", "read", "vm-read", "vm-decode", "memory-usage", "drm-counters",
+		"sensors", "hwmon", "runtimepm", "pp_features", "power", "kms", "gem-info", "peak-bo",
+		"accumulate-poll"
+	};
+	const char *command = json_object_get_string(req, "command");
+	return command && !json_object_has_value(req, "set") &&
+		   command_in(command, reads, ARRAY_SIZE(reads));
+}
+
+/* Called with mtx held. */
+static Lane *lane_for(JSON_Object *req) {
+	const char *command = json_object_get_string(req, "command");
+	JSON_Object *asc = json_object_get_object(req, "asic");
+	unsigned did = 0;
+	int instance = -1, cls = REQUEST_INTERACTIVE;
+
+	/* subscriptions share one subscriber id, keep them in order */
+	if (asc && strcmp(command, "subscribe") && strcmp(command, "unsubscribe")) {
+		did = json_object_get_number(asc, "did");
+		instance = json_object_get_number(asc, "instance");
+		cls = request_class(command);
+	}
+
+	for (auto l: lanes) {
+		if (l->did == did && l->instance == instance && l->cls == cls)
+			return l;
+	}
+
+	Lane *l = new Lane();
+	l->did = did;
+	l->instance = instance;
+	l->cls = cls;
+	l->in_flight = 0;
+	l->has_thread = false;
+	pthread_cond_init(&l->cond, NULL);
+	l->link = lnk;
+	if (lnk.cf) {
+		/* each lane has its own connection */
+		l->link.cf = (struct rumr_comm_funcs *) calloc(1, sizeof *lnk.cf);
+		*l->link.cf = *lnk.cf;
+	}
+	if (lanes_started)
+		l->has_thread = pthread_create(&l->thread, NULL, lane_thread, l) == 0;
+	lanes.push_back(l);
+	return l;
+}
+
+static void queue_request(JSON_Value *req) {
+	pthread_mutex_lock(&mtx);
+	Lane *l = lane_for(json_object(req));
+	if (request_coalesces(json_object(req))) {
+		char *s = json_serialize_to_string(req);
+		for (int i = 0; i < (int)l->queue.size(); i++) {
+			char *q = json_serialize_to_string(l->queue[i]);
+			if (!strcmp(s, q)) {
+				json_value_free(l->queue[i]);
+				l->queue.erase(l->queue.begin() + i--);
+			}
+			json_free_serialized_string(q);
+		}
+		json_free_serialized_string(s);
+	}
+	l->queue.push_back(req);
+	pthread_cond_signal(&l->cond);
+	pthread_mutex_unlock(&mtx);
+}
+
+/* Whether requests about @asic (NULL: not tied to one, -1: any) are being served. */
+static bool requests_pending(struct umr_asic *asic) {
+	for (auto l: lanes) {
+		if (l->queue.empty() && !l->in_flight)
+			continue;
+		if (asic == (struct umr_asic *)-1)
+			return true;
+		if (!asic && l->instance < 0)
+			return true;
+		if (asic && l->did == asic->did && l->instance == asic->instance)
+			return true;
+	}
+	return false;
+}
 
 void send_request(JSON_Value *req, struct umr_asic *asic) {
 	if (asic) {
@@ -410,10 +541,7 @@ void send_request(JSON_Value *req, struct umr_asic *asic) {
 		json_object_set_number(json_object(a), "instance", asic->instance);
 		json_object_set_value(json_object(req), "asic", a);
 	}
-	pthread_mutex_lock(&mtx);
-	pending_request.push_back(req);
-	pthread_cond_signal(&cond);
-	pthread_mutex_unlock(&mtx);
+	queue_request(req);
 }
 
 void Panel::send_request(JSON_Value *req) {
@@ -423,10 +551,75 @@ void Panel::send_request(JSON_Value *req) {
 		json_object_set_number(json_object(a), "instance", asic->instance);
 		json_object_set_value(json_object(req), "asic", a);
 	}
-	pthread_mutex_lock(&mtx);
-	pending_request.push_back(req);
-	pthread_cond_signal(&cond);
-	pthread_mutex_unlock(&mtx);
+	queue_request(req);
+}
+
+/* Subscriptions (see "subscribe" in commands.c).  The server gives us a
+ * subscriber id on our first subscription and tells us when to ask for
+ * the next updates, if it forgets about us the epoch is bumped and the
+ * panels subscribe again. */
+static int subscriber_id;
+static int subscription_epoch;
+static int64_t next_updates_ns = -1;
+
+static void subscription_name(char *name, struct umr_asic *asic, const char *command) {
+	if (asic)
+		sprintf(name, "%u.%d/%s", asic->did, asic->instance, command);
+	else
+		sprintf(name, "%s", command);
+}
+
+void Panel::subscribe(const char *command, int period_ms, bool changes_only, const char *params) {
+	Subscription *sub = NULL;
+	for (int i = 0; i < num_subscriptions && !sub; i++) {
+		if (!strcmp(subscriptions[i].command, command))
+			sub = &subscriptions[i];
+	}
+	if (!sub) {
+		if (num_subscriptions == ARRAY_SIZE(subscriptions))
+			return;
+		sub = &subscriptions[num_subscriptions++];
+		sub->command = command;
+		sub->period_ms = -1;
+	}
+	sub->watched = true;
+	if (sub->period_ms == period_ms && sub->changes_only == changes_only && sub->params == params &&
+		sub->epoch == subscription_epoch)
+		return;
+	sub->params = params;
+	sub->period_ms = period_ms;
+	sub->changes_only = changes_only;
+	sub->epoch = subscription_epoch;
+
+	char name[128];
+	subscription_name(name, asic, command);
+	JSON_Value *source = params ? json_parse_string(params) : json_value_init_object();
+	json_object_set_string(json_object(source), "command", command);
+	JSON_Value *req = json_value_init_object();
+	json_object_set_string(json_object(req), "command", "subscribe");
+	json_object_set_string(json_object(req), "name", name);
+	json_object_set_value(json_object(req), "source", source);
+	json_object_set_number(json_object(req), "period_ms", period_ms);
+	json_object_set_boolean(json_object(req), "changes_only", changes_only);
+	send_request(req);
+}
+
+void Panel::end_frame() {
+	for (int i = 0; i < num_subscriptions; i++) {
+		if (subscriptions[i].watched) {
+			subscriptions[i].watched = false;
+			continue;
+		}
+		if (subscriptions[i].epoch == subscription_epoch) {
+			char name[128];
+			subscription_name(name, asic, subscriptions[i].command);
+			JSON_Value *req = json_value_init_object();
+			json_object_set_string(json_object(req), "command", "unsubscribe");
+			json_object_set_string(json_object(req), "name", name);
+			send_request(req);
+		}
+		subscriptions[i--] = subscriptions[--num_subscriptions];
+	}
 }
 
 AsicData *answer_to_asic_data(std::vector<AsicData*> *asics, JSON_Object *request) {
@@ -485,6 +678,15 @@ static void process_response(std::vector<AsicData*> *asics, ActivityPanel *activ
 				return;
 			}
 		}
+		if (!strcmp(cmd, "updates")) {
+			/* Each update is the response to a subscribed request. */
+			JSON_Array *updates = json_object_dotget_array(response, "answer.updates");
+			for (int i = 0; i < (int)json_array_get_count(updates); i++)
+				process_response(asics, activity_panel, json_array_get_object(updates, i), NULL, 0);
+			return;
+		}
+		if (!strcmp(cmd, "subscribe") || !strcmp(cmd, "unsubscribe"))
+			return;
 		if (!error && !strcmp(cmd, "ping")) {
 			int64_t pong = time_ns();
 			int64_t ping = (int64_t)json_object_get_number(request, "ts");
@@ -509,24 +711,165 @@ static void process_response(std::vector<AsicData*> *asics, ActivityPanel *activ
 	force_redraw();
 }
 
-struct communication_th_args {
-	std::vector<AsicData*> *asics;
-	ActivityPanel *activity_panel;
+/* An answer received by a lane, handed to the render thread which gives it
+ * to the panels at the start of the next frame.  The lanes push them on a
+ * lock-free list so that they go back to the server without waiting for
+ * the frame (which holds mtx) to end. */
+struct Answer {
+	Answer *next;
+	Lane *lane;
+	JSON_Value *in;
+	void *raw_data;
+	unsigned raw_data_size;
+	struct rumr_buffer *rx; /* holds raw_data, see query() */
 };
+static Answer *answers; /* newest first */
 
-static void *communication_thread(void *_job) {
-	int id = 0;
-	char session_folder[PATH_MAX];
+static void free_answer(Answer *a) {
+	if (a->rx)
+		rumr_buffer_free(a->rx);
+	else
+		free(a->raw_data);
+	json_value_free(a->in);
+	delete a;
+}
 
-	/* Wait for the server to reply first. */
-	if (lnk.cf) {
-		do {
-			if (lnk.cf->connect(lnk.cf, lnk.addr) == 0)
-				break;
-			sleep(1);
-		} while (true);
+static void post_answer(Answer *a) {
+	a->next = __atomic_load_n(&answers, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&answers, &a->next, a, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+	force_redraw();
+}
+
+/* Called by the render thread with mtx held. */
+static void deliver_answers(std::vector<AsicData*> *asics, ActivityPanel *activity_panel) {
+	Answer *a = __atomic_exchange_n(&answers, (Answer*)NULL, __ATOMIC_ACQUIRE), *prev = NULL, *next;
+
+	/* oldest first */
+	for (; a; a = next) {
+		next = a->next;
+		a->next = prev;
+		prev = a;
+	}
+	for (a = prev; a; a = next) {
+		next = a->next;
+		process_response(asics, activity_panel, json_object(a->in), a->raw_data, a->raw_data_size);
+		a->lane->in_flight--;
+		free_answer(a);
+	}
+}
+static char session_folder[PATH_MAX];
+static struct umr_session_log *session_log;
+static int msg_count;
+
+/* Answers the server tagged with an "etag" (see response_cache_lookup() in
+ * commands.c), by request.  The next identical request carries the tag and
+ * a "not_modified" reply is answered from here.  The enumerate answer is
+ * also kept on disk so that the IP discovery dumps aren't sent again when
+ * reconnecting to the same server. */
+struct CachedResponse {
+	JSON_Value *response;
+	void *raw_data;
+	unsigned raw_data_size;
+};
+static std::map<std::string, CachedResponse> response_cache;
+static char *response_cache_file;
+
+static bool response_cacheable(const char *command) {
+	const char *cacheable[] = { "enumerate", "pp_features", "kms" };
+	return command_in(command, cacheable, ARRAY_SIZE(cacheable));
+}
+
+/* Called with mtx held. */
+static void response_cache_put(const std::string& key, JSON_Value *response, void *raw_data, unsigned raw_data_size) {
+	CachedResponse &c = response_cache[key];
+	if (c.response) {
+		json_value_free(c.response);
+		free(c.raw_data);
 	}
+	c.response = json_value_deep_copy(response);
+	c.raw_data = raw_data_size ? malloc(raw_data_size) : NULL;
+	c.raw_data_size = raw_data_size;
+	if (raw_data_size)
+		memcpy(c.raw_data, raw_data, raw_data_size);
+}
+
+/* The file holds the request, the response and the raw data. */
+static void save_response_cache_file(const std::string& key, JSON_Value *response,
+									 void *raw_data, unsigned raw_data_size) {
+	FILE *f = fopen(response_cache_file, "wb");
+	if (!f)
+		return;
+	char *s = json_serialize_to_string(response);
+	uint32_t sizes[3] = { htole32(key.size()), htole32(strlen(s)), htole32(raw_data_size) };
+	fwrite(sizes, 1, sizeof(sizes), f);
+	fwrite(key.c_str(), 1, key.size(), f);
+	fwrite(s, 1, strlen(s), f);
+	if (raw_data_size)
+		fwrite(raw_data, 1, raw_data_size, f);
+	fclose(f);
+	json_free_serialized_string(s);
+}
 
+static void load_response_cache_file(const char *folder, const char *addr) {
+	char filename[PATH_MAX];
+	int n = snprintf(filename, sizeof(filename), "%senumerate-", folder);
+	for (const char *c = addr; *c && n < (int)sizeof(filename) - 8; c++)
+		filename[n++] = isalnum(*c) ? *c : '_';
+	strcpy(&filename[n], ".cache");
+	response_cache_file = strdup(filename);
+
+	FILE *f = fopen(filename, "rb");
+	if (!f)
+		return;
+	uint32_t sizes[3];
+	if (fread(sizes, 1, sizeof(sizes), f) == sizeof(sizes)) {
+		uint32_t key_len = le32toh(sizes[0]), json_len = le32toh(sizes[1]);
+		uint32_t raw_data_size = le32toh(sizes[2]);
+		char *data = (char*)malloc(key_len + json_len + raw_data_size + 2);
+		if (fread(data, 1, key_len + json_len + raw_data_size, f) == key_len + json_len + raw_data_size) {
+			std::string key(data, key_len);
+			void *raw_data = &data[key_len + json_len + 1];
+			memmove(raw_data, &data[key_len + json_len], raw_data_size);
+			data[key_len + json_len] = '\0';
+			JSON_Value *response = json_parse_string(&data[key_len]);
+			if (response)
+				response_cache_put(key, response, raw_data, raw_data_size);
+			json_value_free(response);
+		}
+		free(data);
+	}
+	fclose(f);
+}
+
+/* Swap a "not_modified" reply to the request @key for the cached response,
+ * or cache a tagged response.  Called with mtx held. */
+static void response_cache_update(const std::string& key, JSON_Value **in, void **raw_data, unsigned *raw_data_size) {
+	JSON_Object *response = json_object(*in);
+
+	if (json_object_get_boolean(response, "not_modified") == 1) {
+		auto it = response_cache.find(key);
+		if (it == response_cache.end())
+			return;
+		/* the cached response echoes an older request */
+		JSON_Value *request = json_value_deep_copy(json_object_get_value(response, "request"));
+		json_value_free(*in);
+		*in = json_value_deep_copy(it->second.response);
+		json_object_set_value(json_object(*in), "request", request);
+		*raw_data_size = it->second.raw_data_size;
+		if (*raw_data_size) {
+			*raw_data = malloc(*raw_data_size);
+			memcpy(*raw_data, it->second.raw_data, *raw_data_size);
+		}
+	} else if (json_object_has_value(response, "etag") && !json_object_has_value(response, "error")) {
+		response_cache_put(key, *in, *raw_data, *raw_data_size);
+		const char *command = json_object_dotget_string(response, "request.command");
+		if (response_cache_file && command && !strcmp(command, "enumerate"))
+			save_response_cache_file(key, *in, *raw_data, *raw_data_size);
+	}
+}
+
+static void init_session_folder() {
+	int id = 0;
 
 	while (id < 1024) {
 		struct stat statbuf;
@@ -536,57 +879,154 @@ static void *communication_thread(void *_job) {
 		}
 	}
 
-	int save_to_disk = mkdir(session_folder, 0755) == 0;
-	if (!save_to_disk) {
+	if (mkdir(session_folder, 0755) == 0) {
+		char filename[PATH_MAX];
+		snprintf(filename, sizeof(filename), "%s/" UMR_SESSION_FILE, session_folder);
+		session_log = umr_session_log_open(filename);
+	} else {
 		printf("Failed to create the replay folder (error: %d)\n", errno);
 	}
+}
+
+static bool connect_link(struct Link& link) {
+	/* Wait for the server to reply first. */
+	while (link.cf->connect(link.cf, link.addr)) {
+		if (done)
+			return false;
+		sleep(1);
+	}
+
+	/* Switch to binary messages if the server knows them, older
+	 * servers answer with an error and we stay with JSON text. */
+	void *raw_data = NULL;
+	unsigned raw_data_size = 0;
+	struct rumr_buffer *rx;
+	JSON_Value *req = json_value_init_object();
+	json_object_set_string(json_object(req), "command", "wire-format");
+	json_object_set_string(json_object(req), "format", "binary");
+	JSON_Value *in = query(link, req, &raw_data, &raw_data_size, &rx, NULL, 0);
+	const char *format = json_object_dotget_string(json_object(in), "answer.format");
+	link.binary = format && !strcmp(format, "binary");
+	if (rx)
+		rumr_buffer_free(rx);
+	else
+		free(raw_data);
+	json_value_free(in);
+	return true;
+}
 
-	communication_th_args *args = static_cast<communication_th_args *>(_job);
+static void *lane_thread(void *arg) {
+	Lane *l = static_cast<Lane *>(arg);
+	/* the lane without an asic also pings and fetches the subscriptions */
+	const bool global = l->instance < 0;
 	int64_t last_ping = time_ns();
 
-	int msg_count = 0;
+	if (l->link.cf && !connect_link(l->link))
+		return NULL;
+
+	pthread_mutex_lock(&mtx);
 	while (!done) {
-		pthread_mutex_lock(&mtx);
-		if (pending_request.empty()) {
+		if (l->queue.empty()) {
 			int64_t now = time_ns();
 
-			if (now - last_ping > 1000000000) {
+			if (global && next_updates_ns >= 0 && now >= next_updates_ns) {
+				JSON_Value *req = json_value_init_object();
+				json_object_set_string(json_object(req), "command", "updates");
+				next_updates_ns = -1;
+				l->queue.push_back(req);
+			} else if (global && now - last_ping > 1000000000) {
 				JSON_Value *req = json_value_init_object();
 				json_object_set_string(json_object(req), "command", "ping");
 				json_object_set_number(json_object(req), "ts", now);
 				last_ping = now;
-				pending_request.push_back(req);
-			} else {
+				l->queue.push_back(req);
+			} else if (global) {
+				int64_t wait = last_ping + 1000000000 - now;
+				if (next_updates_ns >= 0 && next_updates_ns - now < wait)
+					wait = next_updates_ns - now;
 				struct timespec t;
 				clock_gettime(CLOCK_REALTIME, &t);
-				t.tv_sec += 1;
-				pthread_cond_timedwait(&cond, &mtx, &t);
+				wait += t.tv_nsec;
+				t.tv_sec += wait / 1000000000;
+				t.tv_nsec = wait % 1000000000;
+				pthread_cond_timedwait(&l->cond, &mtx, &t);
+			} else {
+				pthread_cond_wait(&l->cond, &mtx);
 			}
+			continue;
 		}
-		for (int i = 0; i < pending_request.size(); i++) {
-			void *raw_data = NULL;
-			unsigned raw_data_size = 0;
-			JSON_Value* req = pending_request[i];
-			pthread_mutex_unlock(&mtx);
-			bool is_ping = strcmp(json_object_get_string(json_object(req), "command"), "ping") == 0;
-			JSON_Value *in = query(lnk, req, &raw_data, &raw_data_size,
-										  (save_to_disk && !is_ping) ? session_folder : NULL, msg_count);
-			if (!is_ping)
-				msg_count++;
 
-			pthread_mutex_lock(&mtx);
+		Answer *a = new Answer();
+		a->lane = l;
+		JSON_Value* req = l->queue.front();
+		l->queue.erase(l->queue.begin());
+		l->in_flight++;
+		const char *command = json_object_get_string(json_object(req), "command");
+		bool is_ping = strcmp(command, "ping") == 0;
+		bool is_subscription = !strcmp(command, "subscribe") || !strcmp(command, "unsubscribe") ||
+							   !strcmp(command, "updates");
+		if (is_subscription && subscriber_id)
+			json_object_set_number(json_object(req), "subscriber", subscriber_id);
+		int msg_idx = is_ping ? 0 : msg_count++;
+		std::string cache_key;
+		bool has_etag = false;
+		if (response_cacheable(command)) {
+			char *s = json_serialize_to_string(req);
+			cache_key = s;
+			json_free_serialized_string(s);
+			auto it = response_cache.find(cache_key);
+			if (it != response_cache.end()) {
+				const char *etag = json_object_get_string(json_object(it->second.response), "etag");
+				if (etag) {
+					json_object_set_string(json_object(req), "etag", etag);
+					has_etag = true;
+				}
+			}
+		}
+		pthread_mutex_unlock(&mtx);
+
+		/* a "not_modified" reply is saved once swapped for the cached response */
+		JSON_Value *in = query(l->link, req, &a->raw_data, &a->raw_data_size, &a->rx,
+							   (!is_ping && !has_etag) ? session_log : NULL, msg_idx);
+
+		pthread_mutex_lock(&mtx);
 
-			process_response(args->asics, args->activity_panel, json_object(in), raw_data, raw_data_size);
+		if (in && !cache_key.empty())
+			response_cache_update(cache_key, &in, &a->raw_data, &a->raw_data_size);
+		if (in && session_log && has_etag) {
+			pthread_mutex_unlock(&mtx);
+			char *s = json_serialize_to_string(in);
+			umr_session_log_append(session_log, msg_idx, 0, s, strlen(s) + 1, a->raw_data, a->raw_data_size);
+			json_free_serialized_string(s);
+			pthread_mutex_lock(&mtx);
+		}
 
-			json_value_free(in);
+		if (is_subscription) {
+			JSON_Object *response = json_object(in);
+			const char *cmd = json_object_dotget_string(response, "request.command");
+			if (json_object_has_value(response, "error")) {
+				/* The server restarted or dropped us, start over. */
+				if (!strcmp(json_object_get_string(response, "error"), "unknown subscriber")) {
+					subscriber_id = 0;
+					next_updates_ns = -1;
+					subscription_epoch++;
+				}
+			} else if (cmd && !strcmp(cmd, "subscribe")) {
+				subscriber_id = json_object_dotget_number(response, "answer.subscriber");
+				next_updates_ns = time_ns();
+			} else if (cmd && !strcmp(cmd, "updates")) {
+				double next_ms = json_object_dotget_number(response, "answer.next_ms");
+				next_updates_ns = next_ms < 0 ? -1 : time_ns() + (int64_t)(next_ms * 1000000);
+			}
 		}
-		pending_request.clear();
-		pthread_mutex_unlock(&mtx);
-	}
 
-	delete args;
+		/* still in flight until the render thread delivered it */
+		a->in = in;
+		post_answer(a);
+	}
+	pthread_mutex_unlock(&mtx);
 
-	return 0;
+	return NULL;
 }
 
 static int goto_tab_on_next_redraw = -1;
@@ -603,26 +1043,48 @@ void add_vertical_line(const ImVec2& avail) {
 	ImGui::GetWindowDrawList()->AddLine(start, end, ImGui::GetColorU32(ImGuiCol_TabActive));
 }
 
-GLuint texture_from_qoi_buffer(int width, int height, void *buffer, int buffer_size)
+/* Uploads the QOI tiles of a peak-bo answer. tiles is the flat [x, y, w, h, size]
+ * list describing buffer. A new texture is created if texture is 0, otherwise
+ * only the tiles that changed are updated.
+ */
+GLuint texture_from_qoi_tiles(GLuint texture, int width, int height, JSON_Array *tiles,
+							  void *buffer, int buffer_size)
 {
-	GLuint texture_id;
-
-	qoi_desc desc;
-	desc.width = width;
-	desc.height = height;
-	desc.channels = 4;
-	desc.colorspace = QOI_LINEAR;
-	void *data = qoi_decode(buffer, buffer_size, &desc, 4);
-
-	glGenTextures(1, &texture_id);
-	glBindTexture(GL_TEXTURE_2D, texture_id);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0,
-				 GL_RGBA, GL_UNSIGNED_BYTE, data);
-	free(data);
-
-	return texture_id;
+	if (!texture) {
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0,
+					 GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	} else {
+		glBindTexture(GL_TEXTURE_2D, texture);
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	int offset = 0;
+	for (size_t i = 0; i + 4 < json_array_get_count(tiles); i += 5) {
+		int x = json_array_get_number(tiles, i);
+		int y = json_array_get_number(tiles, i + 1);
+		int w = json_array_get_number(tiles, i + 2);
+		int h = json_array_get_number(tiles, i + 3);
+		int size = json_array_get_number(tiles, i + 4);
+
+		if (offset + size > buffer_size)
+			break;
+
+		qoi_desc desc;
+		void *data = qoi_decode((uint8_t*)buffer + offset, size, &desc, 4);
+		offset += size;
+		if (!data)
+			continue;
+		if ((int)desc.width == w && (int)desc.height == h)
+			glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, data);
+		free(data);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	return texture;
 }
 
 void goto_tab(int key_code) {
@@ -635,52 +1097,91 @@ float get_gui_scale() {
 	return gui_scale;
 }
 
+/* Recordings made before UMR_SESSION_FILE have one file per answer, .json
+ * or .bin (see wire.h), and one with the raw data. */
+static JSON_Value *load_replay_file(const char *url, int msg_idx, void **raw_data, uint32_t *raw_data_size) {
+	char filename[PATH_MAX];
+	JSON_Value *msg;
+	struct stat st;
+	int fd;
+
+	*raw_data = NULL;
+	*raw_data_size = 0;
+	sprintf(filename, "%s/%d.json", url, msg_idx);
+	msg = json_parse_file(filename);
+	if (msg == NULL) {
+		sprintf(filename, "%s/%d.bin", url, msg_idx);
+		fd = open(filename, O_RDONLY);
+		if (fd < 0)
+			return NULL;
+		if (fstat(fd, &st) == 0 && st.st_size > 0) {
+			uint8_t *data = (uint8_t*)malloc(st.st_size);
+			if (data && read(fd, data, st.st_size) == st.st_size)
+				msg = umr_wire_decode(data, st.st_size, NULL);
+			free(data);
+		}
+		close(fd);
+	}
+
+	if (msg && json_object_get_boolean(json_object(msg), "has_raw_data")) {
+		sprintf(filename, "%s/%d.raw", url, msg_idx);
+		fd = open(filename, O_RDONLY);
+		if (fd >= 0) {
+			uint32_t s;
+			if (read(fd, &s, sizeof(s)) == sizeof(s)) {
+				*raw_data_size = le32toh(s);
+				*raw_data = malloc(*raw_data_size);
+				if (!*raw_data || read(fd, *raw_data, *raw_data_size) != (ssize_t)*raw_data_size)
+					*raw_data_size = 0;
+			}
+			close(fd);
+		}
+	}
+	return msg;
+}
+
+/* NULL when replaying a recording from before UMR_SESSION_FILE */
+static struct umr_session_replay *session_replay;
+
 static int replay_up_to(const char *url, std::vector<AsicData*> &asics,
 								ActivityPanel *activity_panel, std::vector<std::string>& replay_commands,
 								int idx) {
-	char filename[PATH_MAX];
-	void *raw_data = NULL;
-	int msg_idx = 0, fd;
+	int msg_idx = 0;
 
 	while (idx < 0 || msg_idx <= idx) {
 		uint32_t raw_data_size = 0;
+		void *raw_data = NULL;
 		JSON_Value *msg;
 
-		sprintf(filename, "%s/%d.json", url, msg_idx);
-
-		msg = json_parse_file(filename);
-		if (msg == NULL) {
-			/* We're done replaying everything. */
-			break;
+		if (session_replay) {
+			if (msg_idx >= umr_session_replay_count(session_replay))
+				break;
+			msg = umr_session_replay_read(session_replay, msg_idx, &raw_data, &raw_data_size);
 		} else {
-			JSON_Object *e = json_object(msg);
-
-			if (idx < 0) {
-				JSON_Object *req = json_object_get_object(e, "request");
-				replay_commands.push_back(json_object_get_string(req, "command"));
+			msg = load_replay_file(url, msg_idx, &raw_data, &raw_data_size);
+			if (msg == NULL) {
+				/* We're done replaying everything. */
+				break;
 			}
+		}
 
-			if (json_object_get_boolean(e, "has_raw_data")) {
-				sprintf(filename, "%s/%d.raw", url, msg_idx);
-
-				fd = open(filename, O_RDONLY);
-				if (fd >= 0) {
-					uint32_t s;
-					read(fd, &s, sizeof(raw_data_size));
-					raw_data_size = le32toh(s);
-					raw_data = malloc(raw_data_size);
-					read(fd, raw_data, raw_data_size);
-					close(fd);
-				}
-			}
+		JSON_Object *e = json_object(msg);
+		if (idx < 0) {
+			const char *command = json_object_dotget_string(e, "request.command");
+			char label[128];
+			if (session_replay)
+				snprintf(label, sizeof(label), "%s +%.3fs", command ? command : "?",
+						 umr_session_replay_time(session_replay, msg_idx) / 1e9);
+			else
+				snprintf(label, sizeof(label), "%s", command ? command : "?");
+			replay_commands.push_back(label);
+		}
 
+		if (msg)
 			process_response(&asics, activity_panel, e, raw_data, raw_data_size);
 
-			free(raw_data);
-			raw_data = NULL;
-			json_value_free(msg);
-		}
-
+		free(raw_data);
+		json_value_free(msg);
 		msg_idx++;
 	}
 
@@ -698,17 +1199,15 @@ void reset_before_replay(std::vector<AsicData*> &asics,
 
 static struct rumr_comm_funcs *rumr_get_cf(char *arg, char **addr)
 {
+	const struct rumr_comm_funcs *funcs = rumr_comm_lookup(arg, addr);
 	struct rumr_comm_funcs *cf;
-	*addr = arg;
-
-	if (!memcmp(arg, "tcp://", 6)) {
-		cf = (struct rumr_comm_funcs *) calloc(1, sizeof rumr_tcp_funcs);
-		*cf = rumr_tcp_funcs;
-		cf->log_msg = printf;
-		*addr = &arg[6];
-		return cf;
-	}
-	return NULL;
+
+	if (!funcs)
+		return NULL;
+	cf = (struct rumr_comm_funcs *) calloc(1, sizeof *cf);
+	*cf = *funcs;
+	cf->log_msg = printf;
+	return cf;
 }
 
 static int run_gui(char *url)
@@ -717,7 +1216,6 @@ static int run_gui(char *url)
 	pthread_mutexattr_init(&mat);
 	pthread_mutexattr_settype(&mat, PTHREAD_MUTEX_RECURSIVE);
 	pthread_mutex_init(&mtx, &mat);
-	pthread_cond_init(&cond, NULL);
 
 	bool replay = false;
 	int current_replay, max_replay;
@@ -725,6 +1223,11 @@ static int run_gui(char *url)
 		struct stat statbuf;
 		int r = stat(url, &statbuf);
 		if (r == 0 && S_ISDIR(statbuf.st_mode)) {
+			char filename[PATH_MAX];
+			snprintf(filename, sizeof(filename), "%s/" UMR_SESSION_FILE, url);
+			session_replay = umr_session_replay_open(filename);
+			replay = true;
+		} else if (r == 0 && S_ISREG(statbuf.st_mode) && (session_replay = umr_session_replay_open(url))) {
 			replay = true;
 		} else {
 			lnk.cf = rumr_get_cf(url, &lnk.addr);
@@ -746,15 +1249,13 @@ static int run_gui(char *url)
 	/* This panel is a global panel (nothing asic specific). */
 	ActivityPanel *activity_panel = new ActivityPanel(NULL);
 
-	pthread_t t_id;
 	std::vector<std::string> replay_commands;
 	if (replay) {
 		current_replay = replay_up_to(url, asics, activity_panel, replay_commands, -1);
 	} else {
-		communication_th_args *args = new communication_th_args();
-		args->asics = &asics;
-		args->activity_panel = activity_panel;
-		pthread_create(&t_id, NULL, communication_thread, args);
+		/* lanes start as requests come in */
+		init_session_folder();
+		lanes_started = true;
 	}
 
 	ImVec4 clear_color = ImColor(0, 43, 54, 255).Value;
@@ -839,6 +1340,13 @@ static int run_gui(char *url)
 			}
 			fclose(f);
 		}
+
+		if (lnk.cf && lnk.addr) {
+			char *folder = strdup(config_filename);
+			strrchr(folder, '/')[1] = '\0';
+			load_response_cache_file(folder, lnk.addr);
+			free(folder);
+		}
 		free((void*)config_filename);
 	}
 
@@ -943,6 +1451,7 @@ static int run_gui(char *url)
 		ImVec2 avail = ImGui::GetContentRegionAvail();
 
 		pthread_mutex_lock(&mtx);
+		deliver_answers(&asics, activity_panel);
 
 		if (replay) {
 			const int n_replay = (int)replay_commands.size() - 1;
@@ -1015,9 +1524,9 @@ static int run_gui(char *url)
 			}
 		}
 
-		const bool can_send_request = pending_request.empty();
 		for (int i = 0; i < asics.size(); i++) {
 			AsicData &data = *asics[i];
+			const bool can_send_request = !requests_pending(data.asic);
 
 			char asic[64];
 			sprintf(asic, "%s (%s)", data.asic->asicname, data.asic->options.pci.name);
@@ -1091,15 +1600,21 @@ static int run_gui(char *url)
 			ImGui::EndTabItem();
 		}
 		if (ImGui::BeginTabItem("Activity", NULL)) {
-			if (activity_panel->display(dt, avail, can_send_request))
+			if (activity_panel->display(dt, avail, !requests_pending(NULL)))
 				need_auto_refresh = -1;
 			ImGui::EndTabItem();
 		}
 		ImGui::EndTabBar();
 
+		/* Sources of the panels that weren't displayed stop. */
+		for (auto ad: asics)
+			for (auto panel: ad->panels)
+				panel->end_frame();
+		activity_panel->end_frame();
+
 		if (replay) {
 			/* */
-		} else if (!pending_request.empty()) {
+		} else if (requests_pending((struct umr_asic *)-1)) {
 			avail.x += 2 * ImGui::GetStyle().WindowPadding.x;
 			ImVec2 c(avail.x - 10, topleft.y);
 			ImGui::SetCursorScreenPos(c);
@@ -1129,19 +1644,34 @@ static int run_gui(char *url)
 	}
 
 	pthread_mutex_lock(&mtx);
-	pthread_cond_signal(&cond);
+	for (auto l: lanes)
+		pthread_cond_signal(&l->cond);
 	pthread_mutex_unlock(&mtx);
 
+	for (auto l: lanes) {
 #if UMR_SERVER
-	if (lnk.cf) {
-		lnk.cf->close(lnk.cf);
-	}
+		if (l->link.cf)
+			l->link.cf->close(l->link.cf);
 #endif
-
-	if (!replay) {
-		void *res;
-		pthread_join(t_id, &res);
+		if (l->has_thread)
+			pthread_join(l->thread, NULL);
+		for (auto req: l->queue)
+			json_value_free(req);
+	}
+	for (Answer *a = answers, *next; a; a = next) {
+		next = a->next;
+		free_answer(a);
+	}
+	answers = NULL;
+	for (auto l: lanes) {
+		free(l->link.cf);
+		delete l;
 	}
+	lanes.clear();
+	umr_session_log_close(session_log);
+	session_log = NULL;
+	umr_session_replay_close(session_replay);
+	session_replay = NULL;
 
 	for (int i = 0; i < asics.size(); i++)
 		delete asics[i];
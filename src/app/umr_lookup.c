@@ -27,24 +27,20 @@
 
 void umr_lookup(struct umr_asic *asic, char *address, char *value)
 {
-	int byaddress, i, j, k;
+	int byaddress, i, j;
 	uint32_t regno, num;
 
 	byaddress = sscanf(address, "0x%"SCNx32, &regno);
 	sscanf(value, "%"SCNx32, &num);
 
 	if (byaddress) {
+		umr_load_ip_blocks(asic, NULL);
 		for (i = 0; i < asic->no_blocks; i++)
 		for (j = 0; j < asic->blocks[i]->no_regs; j++)
 			if (asic->blocks[i]->regs[j].type == REG_MMIO &&
 			    asic->blocks[i]->regs[j].addr == regno) {
 				printf("%s.%s => 0x%08lx\n", asic->blocks[i]->ipname, asic->blocks[i]->regs[j].regname, (unsigned long)num);
-				for (k = 0; k < asic->blocks[i]->regs[j].no_bits; k++) {
-					uint32_t v;
-					v = (1UL << (asic->blocks[i]->regs[j].bits[k].stop + 1 - asic->blocks[i]->regs[j].bits[k].start)) - 1;
-					v &= (num >> asic->blocks[i]->regs[j].bits[k].start);
-					asic->blocks[i]->regs[j].bits[k].bitfield_print(asic, asic->asicname, asic->blocks[i]->ipname, asic->blocks[i]->regs[j].regname, asic->blocks[i]->regs[j].bits[k].regname, asic->blocks[i]->regs[j].bits[k].start, asic->blocks[i]->regs[j].bits[k].stop, v);
-				}
+				umr_bitfield_print_all(asic, asic->blocks[i], &asic->blocks[i]->regs[j], num);
 			}
 	} else {
 		char ipname[256], regname[256], *p;
@@ -61,16 +57,12 @@ void umr_lookup(struct umr_asic *asic, char *address, char *value)
 
 		for (i = 0; i < asic->no_blocks; i++)
 			if (!strcmp(asic->blocks[i]->ipname, ipname)) {
+				umr_load_ip_block(asic, asic->blocks[i]);
 				for (j = 0; j < asic->blocks[i]->no_regs; j++) {
 					if (asic->blocks[i]->regs[j].type == REG_MMIO &&
 					    !strcmp(asic->blocks[i]->regs[j].regname, regname)) {
 						printf("%s.%s => 0x%08lx\n", asic->blocks[i]->ipname, asic->blocks[i]->regs[j].regname, (unsigned long)num);
-						for (k = 0; k < asic->blocks[i]->regs[j].no_bits; k++) {
-							uint32_t v;
-							v = (1UL << (asic->blocks[i]->regs[j].bits[k].stop + 1 - asic->blocks[i]->regs[j].bits[k].start)) - 1;
-							v &= (num >> asic->blocks[i]->regs[j].bits[k].start);
-							asic->blocks[i]->regs[j].bits[k].bitfield_print(asic, asic->asicname, asic->blocks[i]->ipname, asic->blocks[i]->regs[j].regname, asic->blocks[i]->regs[j].bits[k].regname, asic->blocks[i]->regs[j].bits[k].start, asic->blocks[i]->regs[j].bits[k].stop, v);
-						}
+						umr_bitfield_print_all(asic, asic->blocks[i], &asic->blocks[i]->regs[j], num);
 					}
 				}
 			}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umrapp.h"
+#include <errno.h>
+
+/*
+ * umrc - run a umr command line on a umr --daemon
+ *
+ * The socket is taken from UMR_DAEMON (default /run/umr.sock), the rest
+ * of the command line is passed as is, e.g. "umrc -r *.gfx1030.mmGRBM_STATUS".
+ */
+int main(int argc, char **argv)
+{
+	const char *path = getenv("UMR_DAEMON");
+	int r;
+
+	if (!path)
+		path = "/run/umr.sock";
+	r = umr_daemon_forward(path, argc, argv);
+	if (r < 0) {
+		fprintf(stderr, "[ERROR]: Could not reach the umr daemon at '%s': %s\n", path, strerror(errno));
+		return EXIT_FAILURE;
+	}
+	return r;
+}
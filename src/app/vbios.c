@@ -24,30 +24,18 @@
  */
 #include "umrapp.h"
 
-#define AMDGPU_INFO_VBIOS			0x1B
-#define AMDGPU_INFO_VBIOS_INFO			0x3
 int umr_print_vbios_info(struct umr_asic *asic)
 {
-	char fname[64];
-	int r;
-	struct umr_vbios_info vbios_info;
+	const struct umr_pp_cache *pp;
 
-	if (asic->fd.drm < 0) {
-		snprintf(fname, sizeof(fname)-1, "/dev/dri/card%d", asic->instance);
-		asic->fd.drm = open(fname, O_RDWR);
-	}
+	pp = umr_pp_cache_get(asic, 1);
+	if (!pp || !pp->have_vbios)
+		return -1;
 
-	r = umr_query_drm_vbios(asic, AMDGPU_INFO_VBIOS, AMDGPU_INFO_VBIOS_INFO,
-			&vbios_info, sizeof(vbios_info));
-	if (r)
-		return r;
-
-	printf("vbios name          : %s\n", vbios_info.name);
-	printf("vbios pn            : %s\n", vbios_info.vbios_pn);
-	printf("vbios version       : %d\n", vbios_info.version);
-	printf("vbios ver_str       : %s\n", vbios_info.vbios_ver_str);
-	printf("vbios date          : %s\n", vbios_info.date);
-
-	close(asic->fd.drm);
+	printf("vbios name          : %s\n", pp->vbios.name);
+	printf("vbios pn            : %s\n", pp->vbios.vbios_pn);
+	printf("vbios version       : %d\n", pp->vbios.version);
+	printf("vbios ver_str       : %s\n", pp->vbios.vbios_ver_str);
+	printf("vbios date          : %s\n", pp->vbios.date);
 	return 0;
 }
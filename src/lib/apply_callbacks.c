@@ -23,6 +23,10 @@
  *
  */
 #include "umr.h"
+#include <pthread.h>
+
+// serializes the discovery of hive nodes by umr_xgmi_node()
+static pthread_mutex_t xgmi_node_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static int hive_cmp(const void *a, const void *b)
 {
@@ -30,33 +34,97 @@ static int hive_cmp(const void *a, const void *b)
 	return (A->hive_position > B->hive_position);
 }
 
+/**
+ * umr_xgmi_no_nodes - Number of nodes in the XGMI hive of @asic
+ *
+ * Returns 0 if @asic is not part of a (scanned) hive.
+ */
+int umr_xgmi_no_nodes(struct umr_asic *asic)
+{
+	int n;
+
+	for (n = 0; n < UMR_MAX_XGMI_DEVICES; n++)
+		if (!asic->config.xgmi.nodes[n].asic && !asic->config.xgmi.nodes[n].node_id)
+			break;
+	return n;
+}
+
+/**
+ * umr_xgmi_node - The device of node @n of the XGMI hive of @asic
+ *
+ * umr_scan_config() only reads the topology of the hive, the other
+ * nodes are discovered (sharing the register database with @asic) the
+ * first time they are asked for here.  If the callbacks were already
+ * applied the node gets them too.
+ *
+ * Returns NULL if there is no such node or it could not be discovered.
+ */
+struct umr_asic *umr_xgmi_node(struct umr_asic *asic, int n)
+{
+	struct umr_xgmi_hive_info *node;
+	struct umr_options options;
+
+	if (n < 0 || n >= UMR_MAX_XGMI_DEVICES)
+		return NULL;
+	node = &asic->config.xgmi.nodes[n];
+
+	pthread_mutex_lock(&xgmi_node_lock);
+	if (!node->asic && node->node_id) {
+		memset(&options, 0, sizeof options);
+		options.instance = node->instance;
+		options.verbose = asic->options.verbose;
+		options.use_colour = asic->options.use_colour;
+		strcpy(options.database_path, asic->options.database_path);
+		node->asic = umr_discover_asic(&options, asic->err_msg);
+		if (node->asic && asic->config.xgmi.callbacks_applied) {
+			node->asic->mem_funcs = asic->mem_funcs;
+			node->asic->reg_funcs = asic->reg_funcs;
+		}
+	}
+	pthread_mutex_unlock(&xgmi_node_lock);
+	return node->asic;
+}
+
 /**
  * umr_apply_callbacks - Apply the reg/mem callbacks to each ASIC node in an XGMI hive
  *
  * @asic: The ASIC the user connected to
  * @mems: The memory callbacks
  * @regs: The register callbacks
+ *
+ * Nodes that were not discovered yet get the callbacks when they are
+ * (see umr_xgmi_node()), they are only discovered here if the driver
+ * did not export their position in the hive.
  */
 void umr_apply_callbacks(struct umr_asic *asic,
 			 struct umr_memory_access_funcs *mems,
 			 struct umr_register_access_funcs *regs)
 {
-	int n;
+	int n, no_nodes;
 	struct umr_reg *reg;
+	struct umr_asic *node;
+
+	no_nodes = umr_xgmi_no_nodes(asic);
+	for (n = 0; n < no_nodes; n++) {
+		node = asic->config.xgmi.nodes[n].asic;
+		if (!node && asic->config.xgmi.nodes[n].hive_position >= 0)
+			continue;
+		if (!node)
+			node = umr_xgmi_node(asic, n);
+		if (!node)
+			continue;
 
-	n = 0;
-	while (asic->config.xgmi.nodes[n].asic) {
-		reg = umr_find_reg_by_name(asic->config.xgmi.nodes[n].asic, "mmMC_VM_XGMI_LFB_CNTL", NULL);
+		reg = umr_find_reg_by_name(node, "mmMC_VM_XGMI_LFB_CNTL", NULL);
 		if (!reg) {
 			asic->err_msg("[BUG]: Cannot find register mmMC_VM_XGMI_LFB_CNTL on ASIC\n");
 			return;
 		}
 
-		asic->config.xgmi.nodes[n].asic->mem_funcs = *mems;
-		asic->config.xgmi.nodes[n].asic->reg_funcs = *regs;
-		asic->config.xgmi.nodes[n].hive_position = umr_bitslice_reg(asic->config.xgmi.nodes[n].asic, reg, "PF_LFB_REGION", asic->reg_funcs.read_reg(asic->config.xgmi.nodes[n].asic, reg->addr * 4, REG_MMIO));
-		++n;
+		node->mem_funcs = *mems;
+		node->reg_funcs = *regs;
+		asic->config.xgmi.nodes[n].hive_position = umr_bitslice_reg(node, reg, "PF_LFB_REGION", asic->reg_funcs.read_reg(node, reg->addr * 4, REG_MMIO));
 	}
+	n = no_nodes;
 
 	// sort nodes based on hive position
 	qsort(&asic->config.xgmi.nodes[0], n, sizeof(asic->config.xgmi.nodes[0]), hive_cmp);
@@ -39,16 +39,66 @@
 void umr_bitfield_default(struct umr_asic *asic, char *asicname, char *ipname, char *regname, char *bitname, int start, int stop, uint32_t value)
 {
 	char buf[512], fpath[256];
-	struct umr_options options = asic->options;
-	if (options.bitfields) {
+	const struct umr_options *options = &asic->options;
+	if (options->bitfields) {
 		snprintf(fpath, sizeof(fpath)-1, "%s.%s.%s%s%s.", asicname, ipname, CYAN, regname, RST);
 		snprintf(buf, sizeof(buf)-1, "\t%s%s%s%s[%s%d:%d%s]",
-			options.bitfields_full ? fpath : ".",
+			options->bitfields_full ? fpath : ".",
 			RED, bitname, RST,
 			BLUE, start, stop, RST);
-		printf("%-65s == %s%8lu%s (%s0x%08lx%s)\n", buf,
+		fprintf(umr_output_stream(asic), "%-65s == %s%8lu%s (%s0x%08lx%s)\n", buf,
 			YELLOW, (unsigned long)value, RST,
 			YELLOW, (unsigned long)value, RST);
 	}
 }
 
+
+typedef void (*umr_bitfield_print_func)(struct umr_asic *asic, char *asicname, char *ipname, char *regname, char *bitname, int start, int stop, uint32_t value);
+
+// indexed by enum umr_bitfield_printer
+static const umr_bitfield_print_func bitfield_printers[] = {
+	[UMR_BITFIELD_PRINT_DEFAULT] = &umr_bitfield_default,
+};
+
+/**
+ * umr_bitfield_print - Print a bitfield of a register
+ *
+ * @asic - The device associated with the bitfield
+ * @ip, @reg - The IP block and register the bitfield belongs to
+ * @bit - The index of the bitfield in reg->bits
+ * @value - The shifted and masked value to print
+ *
+ * The helper is chosen by reg->print, the bitfields themselves only
+ * carry their name and position.
+ */
+void umr_bitfield_print(struct umr_asic *asic, struct umr_ip_block *ip, struct umr_reg *reg, int bit, uint32_t value)
+{
+	umr_bitfield_print_func f = &umr_bitfield_default;
+
+	if (reg->print < sizeof(bitfield_printers) / sizeof(bitfield_printers[0]) && bitfield_printers[reg->print])
+		f = bitfield_printers[reg->print];
+	f(asic, asic->asicname, ip->ipname, reg->regname, reg->bits[bit].regname, reg->bits[bit].start, reg->bits[bit].stop, value);
+}
+
+/**
+ * umr_bitfield_print_all - Print every bitfield of a register value
+ *
+ * @asic - The device associated with the register
+ * @ip, @reg - The IP block and register
+ * @value - The full value of the register
+ *
+ * The fields are sliced in one pass with umr_bitslice_all().
+ */
+void umr_bitfield_print_all(struct umr_asic *asic, struct umr_ip_block *ip, struct umr_reg *reg, uint64_t value)
+{
+	uint64_t vals[64], *v = vals;
+	int k;
+
+	if (reg->no_bits > 64 && !(v = calloc(reg->no_bits, sizeof *v)))
+		return;
+	umr_bitslice_all(reg, value, v);
+	for (k = 0; k < reg->no_bits; k++)
+		umr_bitfield_print(asic, ip, reg, k, v[k]);
+	if (v != vals)
+		free(v);
+}
@@ -0,0 +1,1003 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+#include <pthread.h>
+
+/**
+ * A capture sits between the ASIC and its access callbacks and keeps a
+ * copy of everything read through them: VRAM and system memory (rings,
+ * IBs, shaders and page tables), registers (VM context and the rest),
+ * wave status, GPRs and ring contents.  The bundle written from it is
+ * attached in place of the hardware callbacks like the test harness.
+ *
+ * Bundle layout, all in the byte order of the capturing host:
+ *
+ *	struct bundle_header
+ *	GCA config data (config_size bytes, padded to 8)
+ *	struct bundle_record[no_records], sorted by type, addr and aux
+ *	struct bundle_blob[no_blobs]
+ *	blob data, every blob 8 byte aligned and stored once
+ *
+ * Memory is recorded per page and written as runs of the bytes that were
+ * read, identical runs (zero pages, shared shader code, ...) share a blob.
+ */
+
+#define BUNDLE_MAGIC "UMRBNDL1"
+#define BUNDLE_VERSION 1
+#define BUNDLE_NO_BLOB 0xFFFFFFFFUL
+
+#define CAPTURE_BUCKETS 4096
+#define CAPTURE_PAGE 4096
+
+// what a record holds, addr and aux depend on the type
+enum bundle_type {
+	REC_VRAM = 0,	// addr: linear VRAM address, aux: size
+	REC_SRAM,	// addr: system memory address, aux: size
+	REC_REG,	// addr: byte address, aux: regclass, blob: values in read order
+	REC_WAVE,	// addr: wave_id(), aux: return value, blob: struct umr_wave_status
+	REC_SQ_INFO,	// addr: wave_id() of the CU, aux: return value, blob: the sq_info
+	REC_SGPR,	// addr: wave_id(), aux: return value, blob: the SGPRs
+	REC_VGPR,	// addr: wave_id() | thread, aux: return value, blob: the VGPRs
+	REC_RING,	// addr: hash of the name, aux: ring size, blob: ring data
+	REC_BUS,	// addr: GPU bus address, aux: CPU address
+};
+
+struct bundle_header {
+	char magic[8];
+	uint32_t version, config_size, no_records, no_blobs;
+	char asicname[64];
+	uint64_t vram_size, vis_vram_size, gtt_size, data_size;
+};
+
+struct bundle_record {
+	uint32_t type, blob;
+	uint64_t addr, aux;
+};
+
+struct bundle_blob {
+	uint64_t offset; // from the start of the blob data
+	uint32_t size, pad;
+};
+
+// what was read at one address, memory is kept per page
+struct capture_item {
+	struct capture_item *next;
+	uint32_t type;
+	uint64_t addr, key, aux; // key tells apart registers of different classes
+	uint8_t *data, *valid;   // valid is one byte per byte of a page
+	uint32_t size, max;
+};
+
+struct umr_capture {
+	// the callbacks of the ASIC from before the capture started
+	struct umr_memory_access_funcs mem_funcs;
+	struct umr_register_access_funcs reg_funcs;
+	struct umr_wave_access_funcs wave_funcs;
+	struct umr_read_gpr_funcs gpr_read_funcs;
+	struct umr_read_ring_func ring_func;
+
+	pthread_mutex_t lock;
+	struct capture_item *bucket[CAPTURE_BUCKETS];
+	uint32_t no_items;
+};
+
+struct umr_capture_bundle {
+	uint8_t *buf;
+	const struct bundle_header *hdr;
+	const uint8_t *config, *data;
+	const struct bundle_record *rec;
+	const struct bundle_blob *blob;
+	uint32_t *cursor; // next value of each REC_REG record
+	pthread_mutex_t lock;
+};
+
+static uint64_t hash_bytes(const void *p, size_t size)
+{
+	const uint8_t *b = p;
+	uint64_t h = 0xCBF29CE484222325ULL;
+
+	while (size--) {
+		h ^= *b++;
+		h *= 0x100000001B3ULL;
+	}
+	return h;
+}
+
+// 10 bits per coordinate, the thread of a VGPR read goes above them
+static uint64_t wave_id(unsigned se, unsigned sh, unsigned cu, unsigned simd, unsigned wave)
+{
+	return ((uint64_t)(se & 0x3FF) << 40) | ((uint64_t)(sh & 0x3FF) << 30) |
+	       ((uint64_t)(cu & 0x3FF) << 20) | ((uint64_t)(simd & 0x3FF) << 10) | (wave & 0x3FF);
+}
+
+static uint64_t gpr_id(struct umr_wave_data *wd, uint32_t thread)
+{
+	return wave_id(wd->se, wd->sh, wd->cu, wd->simd, wd->wave) | ((uint64_t)thread << 50);
+}
+
+static unsigned item_hash(uint32_t type, uint64_t addr, uint64_t key)
+{
+	uint64_t h = addr ^ ((uint64_t)type << 56) ^ (key << 32);
+	h *= 0x9E3779B97F4A7C15ULL;
+	return h >> (64 - 12);
+}
+
+// call with the lock held
+static struct capture_item *item_get(struct umr_capture *cap, uint32_t type, uint64_t addr, uint64_t key)
+{
+	struct capture_item *it;
+	unsigned h = item_hash(type, addr, key);
+
+	for (it = cap->bucket[h]; it; it = it->next)
+		if (it->type == type && it->addr == addr && it->key == key)
+			return it;
+
+	it = calloc(1, sizeof *it);
+	if (!it)
+		return NULL;
+	it->type = type;
+	it->addr = addr;
+	it->key = key;
+	it->next = cap->bucket[h];
+	cap->bucket[h] = it;
+	++cap->no_items;
+	return it;
+}
+
+// make room for @size bytes of data
+static int item_reserve(struct capture_item *it, uint32_t size)
+{
+	uint8_t *p;
+
+	if (size <= it->max)
+		return 0;
+	p = realloc(it->data, size);
+	if (!p)
+		return -1;
+	it->data = p;
+	it->max = size;
+	return 0;
+}
+
+static void record_mem(struct umr_capture *cap, uint32_t type, uint64_t addr, uint32_t size, const void *src)
+{
+	const uint8_t *s = src;
+	struct capture_item *it;
+	uint32_t off, len;
+
+	pthread_mutex_lock(&cap->lock);
+	while (size) {
+		off = addr & (CAPTURE_PAGE - 1);
+		len = CAPTURE_PAGE - off;
+		if (len > size)
+			len = size;
+		it = item_get(cap, type, addr - off, 0);
+		if (!it)
+			break;
+		if (!it->valid) {
+			if (item_reserve(it, CAPTURE_PAGE))
+				break;
+			it->size = CAPTURE_PAGE;
+			it->valid = calloc(1, CAPTURE_PAGE);
+			if (!it->valid)
+				break;
+		}
+		memcpy(&it->data[off], s, len);
+		memset(&it->valid[off], 1, len);
+		addr += len;
+		s += len;
+		size -= len;
+	}
+	pthread_mutex_unlock(&cap->lock);
+}
+
+// keep the latest result of a keyed read, trailing zero words are dropped
+static void record_data(struct umr_capture *cap, uint32_t type, uint64_t addr, uint64_t aux, const void *src, uint32_t size, int trim)
+{
+	const uint32_t *w = src;
+	struct capture_item *it;
+
+	if (trim)
+		while (size >= 4 && !w[size / 4 - 1])
+			size -= 4;
+
+	pthread_mutex_lock(&cap->lock);
+	// a later read of the same thing replaces the earlier one
+	it = item_get(cap, type, addr, 0);
+	if (it && !item_reserve(it, size ? size : 1)) {
+		it->aux = aux;
+		it->size = size;
+		if (size)
+			memcpy(it->data, src, size);
+	}
+	pthread_mutex_unlock(&cap->lock);
+}
+
+static void record_reg(struct umr_capture *cap, uint64_t addr, enum regclass type, uint32_t value)
+{
+	struct capture_item *it;
+
+	pthread_mutex_lock(&cap->lock);
+	it = item_get(cap, REC_REG, addr, type);
+	if (it && !item_reserve(it, it->size + 4 <= it->max ? it->max : (it->max ? it->max * 2 : 64))) {
+		it->aux = type;
+		memcpy(&it->data[it->size], &value, 4);
+		it->size += 4;
+	}
+	pthread_mutex_unlock(&cap->lock);
+}
+
+static int cap_access_sram(struct umr_asic *asic, uint64_t address, uint32_t size, void *dst, int write_en)
+{
+	struct umr_capture *cap = asic->capture;
+	int r;
+
+	r = cap->mem_funcs.access_sram(asic, address, size, dst, write_en);
+	if (!r && !write_en)
+		record_mem(cap, REC_SRAM, address, size, dst);
+	return r;
+}
+
+static int cap_access_linear_vram(struct umr_asic *asic, uint64_t address, uint32_t size, void *data, int write_en)
+{
+	struct umr_capture *cap = asic->capture;
+	int r;
+
+	r = cap->mem_funcs.access_linear_vram(asic, address, size, data, write_en);
+	if (!r && !write_en)
+		record_mem(cap, REC_VRAM, address, size, data);
+	return r;
+}
+
+static uint64_t cap_gpu_bus_to_cpu_address(struct umr_asic *asic, uint64_t dma_addr)
+{
+	struct umr_capture *cap = asic->capture;
+	uint64_t cpu_addr;
+
+	cpu_addr = cap->mem_funcs.gpu_bus_to_cpu_address(asic, dma_addr);
+	record_data(cap, REC_BUS, dma_addr, cpu_addr, NULL, 0, 0);
+	return cpu_addr;
+}
+
+static uint32_t cap_read_reg(struct umr_asic *asic, uint64_t addr, enum regclass type)
+{
+	struct umr_capture *cap = asic->capture;
+	uint32_t v;
+
+	v = cap->reg_funcs.read_reg(asic, addr, type);
+	record_reg(cap, addr, type, v);
+	return v;
+}
+
+static int cap_get_wave_status(struct umr_asic *asic, unsigned se, unsigned sh, unsigned cu, unsigned simd, unsigned wave, struct umr_wave_status *ws)
+{
+	struct umr_capture *cap = asic->capture;
+	int r;
+
+	r = cap->wave_funcs.get_wave_status(asic, se, sh, cu, simd, wave, ws);
+	record_data(cap, REC_WAVE, wave_id(se, sh, cu, simd, wave), (uint32_t)r, ws, sizeof *ws, 0);
+	return r;
+}
+
+static int cap_get_wave_sq_info(struct umr_asic *asic, unsigned se, unsigned sh, unsigned cu, struct umr_wave_status *ws)
+{
+	struct umr_capture *cap = asic->capture;
+	int r;
+
+	r = cap->wave_funcs.get_wave_sq_info(asic, se, sh, cu, ws);
+	record_data(cap, REC_SQ_INFO, wave_id(se, sh, cu, 0, 0), (uint32_t)r, &ws->sq_info, sizeof ws->sq_info, 0);
+	return r;
+}
+
+static int cap_read_sgprs(struct umr_asic *asic, struct umr_wave_data *wd, uint32_t *dst)
+{
+	struct umr_capture *cap = asic->capture;
+	int r;
+
+	r = cap->gpr_read_funcs.read_sgprs(asic, wd, dst);
+	record_data(cap, REC_SGPR, gpr_id(wd, 0), (uint32_t)r, dst, sizeof wd->sgprs, 1);
+	return r;
+}
+
+static int cap_read_vgprs(struct umr_asic *asic, struct umr_wave_data *wd, uint32_t thread, uint32_t *dst)
+{
+	struct umr_capture *cap = asic->capture;
+	int r;
+
+	r = cap->gpr_read_funcs.read_vgprs(asic, wd, thread, dst);
+	record_data(cap, REC_VGPR, gpr_id(wd, thread), (uint32_t)r, dst, 256 * 4, 1);
+	return r;
+}
+
+static void *cap_read_ring_data(struct umr_asic *asic, char *ringname, uint32_t *ringsize)
+{
+	struct umr_capture *cap = asic->capture;
+	void *data;
+
+	data = cap->ring_func.read_ring_data(asic, ringname, ringsize);
+	if (data)
+		record_data(cap, REC_RING, hash_bytes(ringname, strlen(ringname)), *ringsize, data, *ringsize + 12, 0);
+	return data;
+}
+
+/**
+ * umr_capture_start - Start recording the hardware accesses of an ASIC
+ * @asic: The ASIC with its hardware callbacks already set up
+ *
+ * The memory, register, wave, GPR and ring callbacks of @asic are wrapped
+ * to keep a copy of everything they read.  The optional 64-bit register,
+ * bulk wave status and ring window callbacks are disabled while capturing
+ * so those reads go through the recorded ones.  Use umr_capture_write() to
+ * save the bundle and umr_capture_stop() to restore the callbacks.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int umr_capture_start(struct umr_asic *asic)
+{
+	struct umr_capture *cap;
+
+	if (asic->capture)
+		return 0;
+	// the nodes of a hive share the callbacks but not the capture
+	if (umr_xgmi_no_nodes(asic)) {
+		asic->err_msg("[ERROR]: XGMI hives cannot be captured\n");
+		return -1;
+	}
+
+	cap = calloc(1, sizeof *cap);
+	if (!cap) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return -1;
+	}
+	pthread_mutex_init(&cap->lock, NULL);
+	cap->mem_funcs = asic->mem_funcs;
+	cap->reg_funcs = asic->reg_funcs;
+	cap->wave_funcs = asic->wave_funcs;
+	cap->gpr_read_funcs = asic->gpr_read_funcs;
+	cap->ring_func = asic->ring_func;
+	asic->capture = cap;
+
+	if (asic->mem_funcs.access_sram)
+		asic->mem_funcs.access_sram = cap_access_sram;
+	if (asic->mem_funcs.access_linear_vram)
+		asic->mem_funcs.access_linear_vram = cap_access_linear_vram;
+	if (asic->mem_funcs.gpu_bus_to_cpu_address)
+		asic->mem_funcs.gpu_bus_to_cpu_address = cap_gpu_bus_to_cpu_address;
+	asic->mem_funcs.access_vram = NULL;
+	if (asic->reg_funcs.read_reg)
+		asic->reg_funcs.read_reg = cap_read_reg;
+	asic->reg_funcs.read_reg64 = NULL;
+	asic->reg_funcs.write_reg64 = NULL;
+	asic->reg_funcs.read_regs_batch = NULL;
+	asic->reg_funcs.write_regs_batch = NULL;
+	if (asic->wave_funcs.get_wave_status)
+		asic->wave_funcs.get_wave_status = cap_get_wave_status;
+	if (asic->wave_funcs.get_wave_sq_info)
+		asic->wave_funcs.get_wave_sq_info = cap_get_wave_sq_info;
+	asic->wave_funcs.get_wave_status_bulk = NULL;
+	asic->wave_funcs.scan_wave_data = NULL;
+	if (asic->gpr_read_funcs.read_sgprs)
+		asic->gpr_read_funcs.read_sgprs = cap_read_sgprs;
+	if (asic->gpr_read_funcs.read_vgprs)
+		asic->gpr_read_funcs.read_vgprs = cap_read_vgprs;
+	if (asic->ring_func.read_ring_data)
+		asic->ring_func.read_ring_data = cap_read_ring_data;
+	asic->ring_func.read_ring_header = NULL;
+	asic->ring_func.read_ring_window = NULL;
+	return 0;
+}
+
+/**
+ * umr_capture_stop - Stop recording and restore the callbacks
+ * @asic: The ASIC the capture was started on
+ *
+ * Anything not saved with umr_capture_write() is lost.
+ */
+void umr_capture_stop(struct umr_asic *asic)
+{
+	struct umr_capture *cap = asic->capture;
+	struct capture_item *it, *next;
+	unsigned x;
+
+	if (!cap)
+		return;
+
+	asic->mem_funcs = cap->mem_funcs;
+	asic->reg_funcs = cap->reg_funcs;
+	asic->wave_funcs = cap->wave_funcs;
+	asic->gpr_read_funcs = cap->gpr_read_funcs;
+	asic->ring_func = cap->ring_func;
+	asic->capture = NULL;
+
+	for (x = 0; x < CAPTURE_BUCKETS; x++) {
+		for (it = cap->bucket[x]; it; it = next) {
+			next = it->next;
+			free(it->data);
+			free(it->valid);
+			free(it);
+		}
+	}
+	pthread_mutex_destroy(&cap->lock);
+	free(cap);
+}
+
+// bundle being written, the blobs point into the capture items
+struct bundle_writer {
+	struct bundle_record *rec;
+	uint32_t no_rec, max_rec;
+
+	struct {
+		const uint8_t *data;
+		uint64_t hash;
+		uint32_t size;
+	} *blobs;
+	uint32_t no_blobs, max_blobs;
+	uint32_t *table, table_size; // open addressed blob index + 1
+	uint64_t data_size;
+};
+
+static int writer_grow_table(struct bundle_writer *w)
+{
+	uint32_t *table, size, x, h;
+
+	size = w->table_size ? w->table_size * 2 : 1024;
+	table = calloc(size, sizeof *table);
+	if (!table)
+		return -1;
+	for (x = 0; x < w->no_blobs; x++) {
+		for (h = w->blobs[x].hash & (size - 1); table[h]; h = (h + 1) & (size - 1));
+		table[h] = x + 1;
+	}
+	free(w->table);
+	w->table = table;
+	w->table_size = size;
+	return 0;
+}
+
+// returns the index of the blob holding @data, identical data is stored once
+static uint32_t writer_blob(struct bundle_writer *w, const uint8_t *data, uint32_t size)
+{
+	uint64_t hash = hash_bytes(data, size);
+	uint32_t h, i;
+
+	if (2 * (w->no_blobs + 1) > w->table_size && writer_grow_table(w))
+		return BUNDLE_NO_BLOB;
+	for (h = hash & (w->table_size - 1); (i = w->table[h]); h = (h + 1) & (w->table_size - 1)) {
+		--i;
+		if (w->blobs[i].hash == hash && w->blobs[i].size == size && !memcmp(w->blobs[i].data, data, size))
+			return i;
+	}
+
+	if (w->no_blobs == w->max_blobs) {
+		uint32_t max = w->max_blobs ? w->max_blobs * 2 : 256;
+		void *p = realloc(w->blobs, max * sizeof w->blobs[0]);
+		if (!p)
+			return BUNDLE_NO_BLOB;
+		w->blobs = p;
+		w->max_blobs = max;
+	}
+	i = w->no_blobs++;
+	w->blobs[i].data = data;
+	w->blobs[i].hash = hash;
+	w->blobs[i].size = size;
+	w->table[h] = i + 1;
+	w->data_size += (size + 7) & ~7U;
+	return i;
+}
+
+static int writer_add(struct bundle_writer *w, uint32_t type, uint64_t addr, uint64_t aux, const uint8_t *data, uint32_t size, int has_data)
+{
+	struct bundle_record *r;
+
+	if (w->no_rec == w->max_rec) {
+		uint32_t max = w->max_rec ? w->max_rec * 2 : 1024;
+		void *p = realloc(w->rec, max * sizeof w->rec[0]);
+		if (!p)
+			return -1;
+		w->rec = p;
+		w->max_rec = max;
+	}
+	r = &w->rec[w->no_rec];
+	r->type = type;
+	r->addr = addr;
+	r->aux = aux;
+	r->blob = BUNDLE_NO_BLOB;
+	if (has_data) {
+		r->blob = writer_blob(w, data, size);
+		if (r->blob == BUNDLE_NO_BLOB)
+			return -1;
+	}
+	++w->no_rec;
+	return 0;
+}
+
+static int record_cmp(const void *a, const void *b)
+{
+	const struct bundle_record *ra = a, *rb = b;
+
+	if (ra->type != rb->type)
+		return ra->type < rb->type ? -1 : 1;
+	if (ra->addr != rb->addr)
+		return ra->addr < rb->addr ? -1 : 1;
+	if (ra->aux != rb->aux)
+		return ra->aux < rb->aux ? -1 : 1;
+	return 0;
+}
+
+static int writer_add_item(struct bundle_writer *w, struct capture_item *it)
+{
+	uint32_t x, y;
+
+	if (it->type != REC_VRAM && it->type != REC_SRAM)
+		return writer_add(w, it->type, it->addr, it->aux, it->data, it->size, it->type != REC_BUS);
+
+	// a page is written as the runs of bytes that were read
+	for (x = 0; x < CAPTURE_PAGE; x = y) {
+		for (; x < CAPTURE_PAGE && !it->valid[x]; x++);
+		for (y = x; y < CAPTURE_PAGE && it->valid[y]; y++);
+		if (y > x && writer_add(w, it->type, it->addr + x, y - x, &it->data[x], y - x, 1))
+			return -1;
+	}
+	return 0;
+}
+
+static int write_padded(FILE *f, const void *data, size_t size)
+{
+	static const uint8_t zero[8];
+
+	if (size && fwrite(data, 1, size, f) != size)
+		return -1;
+	if ((size & 7) && fwrite(zero, 1, 8 - (size & 7), f) != 8 - (size & 7))
+		return -1;
+	return 0;
+}
+
+/**
+ * umr_capture_write - Save everything captured so far as a bundle
+ * @asic: The ASIC the capture was started on
+ * @fname: The file to write
+ *
+ * The capture keeps running so this can be called more than once.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int umr_capture_write(struct umr_asic *asic, const char *fname)
+{
+	struct umr_capture *cap = asic->capture;
+	struct bundle_writer w;
+	struct bundle_header hdr;
+	struct bundle_blob blob;
+	struct capture_item *it;
+	uint64_t offset;
+	unsigned x;
+	FILE *f;
+	int r = -1;
+
+	if (!cap) {
+		asic->err_msg("[ERROR]: No capture was started\n");
+		return -1;
+	}
+
+	memset(&w, 0, sizeof w);
+	pthread_mutex_lock(&cap->lock);
+	for (x = 0; x < CAPTURE_BUCKETS; x++)
+		for (it = cap->bucket[x]; it; it = it->next)
+			if (writer_add_item(&w, it))
+				goto out;
+	if (w.no_rec)
+		qsort(w.rec, w.no_rec, sizeof w.rec[0], record_cmp);
+
+	memset(&hdr, 0, sizeof hdr);
+	memcpy(hdr.magic, BUNDLE_MAGIC, 8);
+	hdr.version = BUNDLE_VERSION;
+	hdr.config_size = sizeof asic->config.data;
+	hdr.no_records = w.no_rec;
+	hdr.no_blobs = w.no_blobs;
+	snprintf(hdr.asicname, sizeof hdr.asicname, "%s", asic->asicname);
+	hdr.vram_size = asic->config.vram_size;
+	hdr.vis_vram_size = asic->config.vis_vram_size;
+	hdr.gtt_size = asic->config.gtt_size;
+	hdr.data_size = w.data_size;
+
+	f = fopen(fname, "wb");
+	if (!f) {
+		asic->err_msg("[ERROR]: Could not open capture bundle '%s' for writing\n", fname);
+		goto out;
+	}
+	if (write_padded(f, &hdr, sizeof hdr) ||
+	    write_padded(f, asic->config.data, sizeof asic->config.data) ||
+	    write_padded(f, w.rec, (size_t)w.no_rec * sizeof w.rec[0]))
+		goto err;
+	for (offset = x = 0; x < w.no_blobs; x++) {
+		memset(&blob, 0, sizeof blob);
+		blob.offset = offset;
+		blob.size = w.blobs[x].size;
+		if (fwrite(&blob, sizeof blob, 1, f) != 1)
+			goto err;
+		offset += (blob.size + 7) & ~7U;
+	}
+	for (x = 0; x < w.no_blobs; x++)
+		if (write_padded(f, w.blobs[x].data, w.blobs[x].size))
+			goto err;
+	r = 0;
+err:
+	if (fclose(f) || r) {
+		asic->err_msg("[ERROR]: Could not write capture bundle '%s'\n", fname);
+		r = -1;
+	}
+out:
+	pthread_mutex_unlock(&cap->lock);
+	free(w.rec);
+	free(w.blobs);
+	free(w.table);
+	return r;
+}
+
+/**
+ * umr_load_capture_bundle - Load a bundle written by umr_capture_write()
+ * @fname: The file to read
+ *
+ * Returns the bundle or NULL on error.
+ */
+struct umr_capture_bundle *umr_load_capture_bundle(const char *fname)
+{
+	struct umr_capture_bundle *b;
+	const struct bundle_header *hdr;
+	uint64_t off, need;
+	uint32_t x;
+	long size;
+	FILE *f;
+
+	f = fopen(fname, "rb");
+	if (!f) {
+		fprintf(stderr, "[ERROR]: Could not open capture bundle '%s'\n", fname);
+		return NULL;
+	}
+	b = calloc(1, sizeof *b);
+	if (!b || fseek(f, 0, SEEK_END) || (size = ftell(f)) < 0 || fseek(f, 0, SEEK_SET))
+		goto err;
+	b->buf = malloc(size ? size : 1);
+	if (!b->buf || fread(b->buf, 1, size, f) != (size_t)size)
+		goto err;
+	fclose(f);
+	f = NULL;
+
+	// check every table fits in the file before pointing into it
+	hdr = (const struct bundle_header *)b->buf;
+	if ((uint64_t)size < sizeof *hdr || memcmp(hdr->magic, BUNDLE_MAGIC, 8) || hdr->version != BUNDLE_VERSION)
+		goto bad;
+	off = (sizeof *hdr + 7) & ~7ULL;
+	b->config = b->buf + off;
+	off += ((uint64_t)hdr->config_size + 7) & ~7ULL;
+	b->rec = (const struct bundle_record *)(b->buf + off);
+	off += ((uint64_t)hdr->no_records * sizeof b->rec[0] + 7) & ~7ULL;
+	b->blob = (const struct bundle_blob *)(b->buf + off);
+	off += (uint64_t)hdr->no_blobs * sizeof b->blob[0];
+	b->data = b->buf + off;
+	if (off + hdr->data_size != (uint64_t)size)
+		goto bad;
+	for (x = 0; x < hdr->no_blobs; x++)
+		if (b->blob[x].offset + b->blob[x].size > hdr->data_size)
+			goto bad;
+	for (x = 0; x < hdr->no_records; x++) {
+		if (b->rec[x].blob == BUNDLE_NO_BLOB)
+			continue;
+		if (b->rec[x].blob >= hdr->no_blobs)
+			goto bad;
+		// memory records must be backed by their whole size
+		need = (b->rec[x].type == REC_VRAM || b->rec[x].type == REC_SRAM) ? b->rec[x].aux : 0;
+		if (b->blob[b->rec[x].blob].size < need)
+			goto bad;
+	}
+	b->hdr = hdr;
+	b->cursor = calloc(hdr->no_records ? hdr->no_records : 1, sizeof b->cursor[0]);
+	if (!b->cursor)
+		goto err;
+	pthread_mutex_init(&b->lock, NULL);
+	return b;
+
+bad:
+	fprintf(stderr, "[ERROR]: '%s' is not a valid capture bundle\n", fname);
+	free(b->buf);
+	free(b);
+	return NULL;
+err:
+	fprintf(stderr, "[ERROR]: Could not read capture bundle '%s'\n", fname);
+	if (f)
+		fclose(f);
+	if (b)
+		free(b->buf);
+	free(b);
+	return NULL;
+}
+
+/**
+ * umr_capture_bundle_asicname - The name of the ASIC a bundle was captured on
+ */
+const char *umr_capture_bundle_asicname(struct umr_capture_bundle *bundle)
+{
+	return bundle->hdr->asicname;
+}
+
+/**
+ * umr_free_capture_bundle - Free a bundle
+ */
+void umr_free_capture_bundle(struct umr_capture_bundle *bundle)
+{
+	if (!bundle)
+		return;
+	pthread_mutex_destroy(&bundle->lock);
+	free(bundle->cursor);
+	free(bundle->buf);
+	free(bundle);
+}
+
+// index of the first record not before (type, addr)
+static uint32_t bundle_lower(const struct umr_capture_bundle *b, uint32_t type, uint64_t addr)
+{
+	uint32_t lo = 0, hi = b->hdr->no_records, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (b->rec[mid].type < type || (b->rec[mid].type == type && b->rec[mid].addr < addr))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static const struct bundle_record *bundle_find(const struct umr_capture_bundle *b, uint32_t type, uint64_t addr)
+{
+	uint32_t i = bundle_lower(b, type, addr);
+
+	if (i < b->hdr->no_records && b->rec[i].type == type && b->rec[i].addr == addr)
+		return &b->rec[i];
+	return NULL;
+}
+
+static const uint8_t *blob_data(const struct umr_capture_bundle *b, const struct bundle_record *r, uint32_t *size)
+{
+	if (r->blob == BUNDLE_NO_BLOB) {
+		*size = 0;
+		return NULL;
+	}
+	*size = b->blob[r->blob].size;
+	return b->data + b->blob[r->blob].offset;
+}
+
+static int bundle_access(struct umr_asic *asic, uint32_t type, uint64_t address, uint32_t size, void *dst, int write_en)
+{
+	struct umr_capture_bundle *b = asic->mem_funcs.data;
+	const struct bundle_record *r;
+	uint32_t i, len, bsize;
+	uint64_t off;
+
+	if (write_en) {
+		asic->err_msg("[ERROR]: Memory of a capture bundle cannot be written\n");
+		return -1;
+	}
+
+	// the runs do not overlap so the one covering an address is the
+	// last one starting at or before it
+	while (size) {
+		i = bundle_lower(b, type, address + 1);
+		r = i ? &b->rec[i - 1] : NULL;
+		if (!r || r->type != type || address - r->addr >= r->aux) {
+			asic->err_msg("[ERROR]: %s 0x%" PRIx64 " not found in capture bundle\n",
+				type == REC_VRAM ? "Video memory" : "System memory", address);
+			return -1;
+		}
+		off = address - r->addr;
+		len = r->aux - off < size ? (uint32_t)(r->aux - off) : size;
+		memcpy(dst, blob_data(b, r, &bsize) + off, len);
+		dst = (char *)dst + len;
+		address += len;
+		size -= len;
+	}
+	return 0;
+}
+
+static int bundle_access_sram(struct umr_asic *asic, uint64_t address, uint32_t size, void *dst, int write_en)
+{
+	return bundle_access(asic, REC_SRAM, address, size, dst, write_en);
+}
+
+static int bundle_access_linear_vram(struct umr_asic *asic, uint64_t address, uint32_t size, void *data, int write_en)
+{
+	return bundle_access(asic, REC_VRAM, address, size, data, write_en);
+}
+
+static uint64_t bundle_gpu_bus_to_cpu_address(struct umr_asic *asic, uint64_t dma_addr)
+{
+	const struct bundle_record *r = bundle_find(asic->mem_funcs.data, REC_BUS, dma_addr);
+
+	return r ? r->aux : dma_addr;
+}
+
+// registers return the values in the order they were read, the last one repeats
+static uint32_t bundle_read_reg(struct umr_asic *asic, uint64_t addr, enum regclass type)
+{
+	struct umr_capture_bundle *b = asic->reg_funcs.data;
+	const struct bundle_record *r;
+	const uint8_t *values;
+	uint32_t i, n, v;
+
+	i = bundle_lower(b, REC_REG, addr);
+	for (; i < b->hdr->no_records && b->rec[i].type == REC_REG && b->rec[i].addr == addr; i++)
+		if (b->rec[i].aux == (uint64_t)type)
+			break;
+	if (i == b->hdr->no_records || b->rec[i].type != REC_REG || b->rec[i].addr != addr)
+		return 0xDEADBEEF;
+	r = &b->rec[i];
+	values = blob_data(b, r, &n);
+	n /= 4;
+	if (!n)
+		return 0xDEADBEEF;
+
+	pthread_mutex_lock(&b->lock);
+	memcpy(&v, values + 4 * (b->cursor[i] < n ? b->cursor[i] : n - 1), 4);
+	if (b->cursor[i] < n)
+		++b->cursor[i];
+	pthread_mutex_unlock(&b->lock);
+	return v;
+}
+
+static int bundle_write_reg(struct umr_asic *asic, uint64_t addr, uint32_t value, enum regclass type)
+{
+	// writes (bank selects, SQ indices) only matter to the hardware
+	(void)asic; (void)addr; (void)value; (void)type;
+	return 0;
+}
+
+// copy a keyed record out, the rest of @dst (of @size bytes) is zeroed
+static int bundle_copy(struct umr_capture_bundle *b, uint32_t type, uint64_t addr, void *dst, uint32_t size)
+{
+	const struct bundle_record *r = bundle_find(b, type, addr);
+	const uint8_t *data;
+	uint32_t n;
+
+	if (!r)
+		return -1;
+	data = blob_data(b, r, &n);
+	if (n > size)
+		n = size;
+	memset(dst, 0, size);
+	if (n)
+		memcpy(dst, data, n);
+	return (int)(uint32_t)r->aux;
+}
+
+static int bundle_wave_status(struct umr_asic *asic, unsigned se, unsigned sh, unsigned cu, unsigned simd, unsigned wave, struct umr_wave_status *ws)
+{
+	return bundle_copy(asic->wave_funcs.data, REC_WAVE, wave_id(se, sh, cu, simd, wave), ws, sizeof *ws);
+}
+
+static int bundle_wave_sq_info(struct umr_asic *asic, unsigned se, unsigned sh, unsigned cu, struct umr_wave_status *ws)
+{
+	return bundle_copy(asic->wave_funcs.data, REC_SQ_INFO, wave_id(se, sh, cu, 0, 0), &ws->sq_info, sizeof ws->sq_info);
+}
+
+static int bundle_read_sgprs(struct umr_asic *asic, struct umr_wave_data *wd, uint32_t *dst)
+{
+	return bundle_copy(asic->gpr_read_funcs.data, REC_SGPR, gpr_id(wd, 0), dst, sizeof wd->sgprs);
+}
+
+static int bundle_read_vgprs(struct umr_asic *asic, struct umr_wave_data *wd, uint32_t thread, uint32_t *dst)
+{
+	return bundle_copy(asic->gpr_read_funcs.data, REC_VGPR, gpr_id(wd, thread), dst, 256 * 4);
+}
+
+static void *bundle_read_ring_data(struct umr_asic *asic, char *ringname, uint32_t *ringsize)
+{
+	struct umr_capture_bundle *b = asic->ring_func.data;
+	const struct bundle_record *r;
+	const uint8_t *data;
+	uint32_t n;
+	void *p;
+
+	r = bundle_find(b, REC_RING, hash_bytes(ringname, strlen(ringname)));
+	if (!r) {
+		asic->err_msg("[ERROR]: Ring '%s' not found in capture bundle\n", ringname);
+		return NULL;
+	}
+	data = blob_data(b, r, &n);
+	p = calloc(1, n ? n : 1);
+	if (!p)
+		return NULL;
+	memcpy(p, data, n);
+	*ringsize = r->aux;
+	return p;
+}
+
+/**
+ * umr_attach_capture_bundle - Replay a bundle in place of the hardware
+ * @bundle: The bundle from umr_load_capture_bundle()
+ * @asic: The ASIC to attach it to, usually made from
+ *        umr_capture_bundle_asicname().  Its access callbacks are replaced.
+ *
+ * Memory, rings, waves and GPRs return what was captured, registers
+ * return the values in the order they were read.  Anything that was not
+ * captured fails like it would with the test harness.
+ */
+void umr_attach_capture_bundle(struct umr_capture_bundle *bundle, struct umr_asic *asic)
+{
+	memset(&asic->mem_funcs, 0, sizeof asic->mem_funcs);
+	asic->mem_funcs.access_linear_vram = bundle_access_linear_vram;
+	asic->mem_funcs.access_sram = bundle_access_sram;
+	asic->mem_funcs.gpu_bus_to_cpu_address = bundle_gpu_bus_to_cpu_address;
+	asic->mem_funcs.vm_message = &printf;
+	asic->mem_funcs.data = bundle;
+	asic->mem_funcs.no_readahead = 1;
+
+	memset(&asic->reg_funcs, 0, sizeof asic->reg_funcs);
+	asic->reg_funcs.read_reg = bundle_read_reg;
+	asic->reg_funcs.write_reg = bundle_write_reg;
+	asic->reg_funcs.data = bundle;
+
+	memset(&asic->gpr_read_funcs, 0, sizeof asic->gpr_read_funcs);
+	asic->gpr_read_funcs.read_sgprs = bundle_read_sgprs;
+	asic->gpr_read_funcs.read_vgprs = bundle_read_vgprs;
+	asic->gpr_read_funcs.data = bundle;
+
+	memset(&asic->wave_funcs, 0, sizeof asic->wave_funcs);
+	asic->wave_funcs.get_wave_status = bundle_wave_status;
+	asic->wave_funcs.get_wave_sq_info = bundle_wave_sq_info;
+	asic->wave_funcs.data = bundle;
+
+	memset(&asic->ring_func, 0, sizeof asic->ring_func);
+	asic->ring_func.read_ring_data = bundle_read_ring_data;
+	asic->ring_func.data = bundle;
+
+	asic->shader_disasm_funcs.disasm = umr_shader_disasm;
+
+	// the configuration of the captured device
+	memset(asic->config.data, 0, sizeof asic->config.data);
+	memcpy(asic->config.data, bundle->config,
+	       bundle->hdr->config_size < sizeof asic->config.data ? bundle->hdr->config_size : sizeof asic->config.data);
+	asic->config.vram_size = bundle->hdr->vram_size;
+	asic->config.vis_vram_size = bundle->hdr->vis_vram_size;
+	asic->config.gtt_size = bundle->hdr->gtt_size;
+	umr_scan_config_gca_data(asic);
+
+	if (asic->options.vgpr_granularity >= 0)
+		asic->parameters.vgpr_granularity = asic->options.vgpr_granularity;
+
+	// default shader options
+	if (asic->family <= FAMILY_VI) { // on gfx9+ hs/gs are opaque
+		asic->options.shader_enable.enable_gs_shader = 1;
+		asic->options.shader_enable.enable_hs_shader = 1;
+	}
+	asic->options.shader_enable.enable_vs_shader   = 1;
+	asic->options.shader_enable.enable_ps_shader   = 1;
+	asic->options.shader_enable.enable_es_shader   = 1;
+	asic->options.shader_enable.enable_ls_shader   = 1;
+	asic->options.shader_enable.enable_comp_shader = 1;
+
+	if (asic->family > FAMILY_VI)
+		asic->options.shader_enable.enable_es_ls_swap = 1;  // on >FAMILY_VI we swap LS/ES for HS/GS
+
+	umr_create_mmio_accel(asic);
+}
@@ -32,6 +32,7 @@
 void umr_close_asic(struct umr_asic *asic)
 {
 	if (asic) {
+		umr_gfxoff_guard_free(asic);
 		cond_close(asic->fd.mmio2);
 		cond_close(asic->fd.mmio);
 		cond_close(asic->fd.didt);
@@ -46,6 +47,12 @@ void umr_close_asic(struct umr_asic *asic)
 		cond_close(asic->fd.iova);
 		cond_close(asic->fd.iomem);
 		cond_close(asic->fd.gfxoff);
+		umr_capture_stop(asic);
+		umr_close_proc_mem(asic);
+		umr_uq_registry_free(asic);
+		umr_uring_fini(asic);
+		umr_shader_disasm_fini(asic);
+		umr_shader_disasm_cache_free(asic);
 		umr_free_asic(asic);
 	}
 }
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+
+// the 'mm' spelling also finds the 'reg' spelling of newer databases
+static const struct {
+	const char *ip, *name;
+} core_regs[UMR_CORE_REG_MAX] = {
+	[UMR_CORE_SQ_CMD]                        = { "gfx", "mmSQ_CMD" },
+	[UMR_CORE_CP_HQD_ACTIVE]                 = { "gfx", "mmCP_HQD_ACTIVE" },
+	[UMR_CORE_CP_HQD_VMID]                   = { "gfx", "mmCP_HQD_VMID" },
+	[UMR_CORE_CP_HQD_PQ_BASE]                = { "gfx", "mmCP_HQD_PQ_BASE" },
+	[UMR_CORE_CP_HQD_PQ_BASE_HI]             = { "gfx", "mmCP_HQD_PQ_BASE_HI" },
+	[UMR_CORE_CP_HQD_PQ_RPTR]                = { "gfx", "mmCP_HQD_PQ_RPTR" },
+	[UMR_CORE_CP_HQD_PQ_WPTR]                = { "gfx", "mmCP_HQD_PQ_WPTR" },
+	[UMR_CORE_CP_HQD_PQ_WPTR_LO]             = { "gfx", "mmCP_HQD_PQ_WPTR_LO" },
+	[UMR_CORE_CP_HQD_PQ_WPTR_HI]             = { "gfx", "mmCP_HQD_PQ_WPTR_HI" },
+	[UMR_CORE_CP_HQD_PQ_RPTR_REPORT_ADDR]    = { "gfx", "mmCP_HQD_PQ_RPTR_REPORT_ADDR" },
+	[UMR_CORE_CP_HQD_PQ_RPTR_REPORT_ADDR_HI] = { "gfx", "mmCP_HQD_PQ_RPTR_REPORT_ADDR_HI" },
+	[UMR_CORE_CP_HQD_PQ_CONTROL]             = { "gfx", "mmCP_HQD_PQ_CONTROL" },
+	[UMR_CORE_CP_HQD_EOP_BASE_ADDR]          = { "gfx", "mmCP_HQD_EOP_BASE_ADDR" },
+	[UMR_CORE_CP_HQD_EOP_BASE_ADDR_HI]       = { "gfx", "mmCP_HQD_EOP_BASE_ADDR_HI" },
+	[UMR_CORE_CP_HQD_EOP_RPTR]               = { "gfx", "mmCP_HQD_EOP_RPTR" },
+	[UMR_CORE_CP_HQD_EOP_WPTR]               = { "gfx", "mmCP_HQD_EOP_WPTR" },
+	[UMR_CORE_CP_HQD_EOP_WPTR_MEM]           = { "gfx", "mmCP_HQD_EOP_WPTR_MEM" },
+	[UMR_CORE_CP_MQD_BASE_ADDR]              = { "gfx", "mmCP_MQD_BASE_ADDR" },
+	[UMR_CORE_CP_MQD_BASE_ADDR_HI]           = { "gfx", "mmCP_MQD_BASE_ADDR_HI" },
+	[UMR_CORE_CP_HQD_DEQUEUE_REQUEST]        = { "gfx", "mmCP_HQD_DEQUEUE_REQUEST" },
+	[UMR_CORE_CP_HQD_IQ_TIMER]               = { "gfx", "mmCP_HQD_IQ_TIMER" },
+	[UMR_CORE_CP_HQD_AQL_CONTROL]            = { "gfx", "mmCP_HQD_AQL_CONTROL" },
+	[UMR_CORE_CP_HQD_CTX_SAVE_BASE_ADDR_LO]  = { "gfx", "mmCP_HQD_CTX_SAVE_BASE_ADDR_LO" },
+	[UMR_CORE_CP_HQD_CTX_SAVE_BASE_ADDR_HI]  = { "gfx", "mmCP_HQD_CTX_SAVE_BASE_ADDR_HI" },
+	[UMR_CORE_CP_HQD_CTX_SAVE_SIZE]          = { "gfx", "mmCP_HQD_CTX_SAVE_SIZE" },
+	[UMR_CORE_CP_HQD_CNTL_STACK_OFFSET]      = { "gfx", "mmCP_HQD_CNTL_STACK_OFFSET" },
+	[UMR_CORE_CP_HQD_CNTL_STACK_SIZE]        = { "gfx", "mmCP_HQD_CNTL_STACK_SIZE" },
+	[UMR_CORE_CP_GFX_HQD_CNTL]               = { "gfx", "mmCP_GFX_HQD_CNTL" },
+	[UMR_CORE_SDMA0_QUEUE0_RB_CNTL]          = { "gfx", "mmSDMA0_QUEUE0_RB_CNTL" },
+};
+
+// per-asic resolved core registers, a register that is not in the
+// database is remembered as missing so it is not searched for again
+struct umr_core_reg_cache {
+	int vm_partition;
+	uint8_t resolved[UMR_CORE_REG_MAX];
+	struct umr_reg *regs[UMR_CORE_REG_MAX];
+};
+
+/**
+ * umr_core_reg - Find a core register by ID
+ *
+ * @asic: The device
+ * @id: Which register
+ *
+ * The register is looked up by name in the instance of its IP block
+ * selected by asic->options.vm_partition the first time it is used,
+ * later calls (until the partition changes) are an array lookup.
+ *
+ * Returns the register or NULL if this device does not have it.
+ */
+struct umr_reg *umr_core_reg(struct umr_asic *asic, enum umr_core_reg_id id)
+{
+	struct umr_core_reg_cache *cache;
+
+	if (id >= UMR_CORE_REG_MAX)
+		return NULL;
+
+	if (!asic->core_regs) {
+		asic->core_regs = calloc(1, sizeof *asic->core_regs);
+		if (!asic->core_regs) {
+			asic->err_msg("[ERROR]: Out of memory\n");
+			return NULL;
+		}
+		asic->core_regs->vm_partition = asic->options.vm_partition;
+	}
+	cache = asic->core_regs;
+
+	// another GFX instance has other registers
+	if (cache->vm_partition != asic->options.vm_partition) {
+		memset(cache, 0, sizeof *cache);
+		cache->vm_partition = asic->options.vm_partition;
+	}
+
+	if (!cache->resolved[id]) {
+		cache->regs[id] = umr_find_reg_data_by_ip_by_instance(asic, (char *)core_regs[id].ip,
+			asic->options.vm_partition, (char *)core_regs[id].name);
+		cache->resolved[id] = 1;
+	}
+	return cache->regs[id];
+}
+
+/**
+ * umr_read_core_reg - Read a core register (0 if the device does not have it)
+ */
+uint64_t umr_read_core_reg(struct umr_asic *asic, enum umr_core_reg_id id)
+{
+	struct umr_reg *reg = umr_core_reg(asic, id);
+
+	return reg ? umr_read_reg_by_reg(asic, reg) : 0;
+}
+
+/**
+ * umr_bitslice_core_reg - Extract a bitfield from the value of a core register (0 if missing)
+ */
+uint64_t umr_bitslice_core_reg(struct umr_asic *asic, enum umr_core_reg_id id, char *bitname, uint64_t regvalue)
+{
+	struct umr_reg *reg = umr_core_reg(asic, id);
+
+	return reg ? umr_bitslice_reg(asic, reg, bitname, regvalue) : 0;
+}
+
+const char *umr_core_reg_name(enum umr_core_reg_id id)
+{
+	return id < UMR_CORE_REG_MAX ? core_regs[id].name : "unknown";
+}
+
+/**
+ * umr_free_core_regs - Forget the resolved core registers
+ */
+void umr_free_core_regs(struct umr_asic *asic)
+{
+	free(asic->core_regs);
+	asic->core_regs = NULL;
+}
@@ -0,0 +1,333 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+
+/*
+ * The HQD registers of every ME/pipe/queue of the CP are read with one
+ * umr_read_regs_batch() so each SRBM bank is selected once and the
+ * registers of a queue are fetched together.  The registers are looked
+ * up once per dump instead of once per queue.
+ */
+
+enum {
+	HQD_ANY = 0,
+	HQD_PRE_AI,   // only before FAMILY_AI
+	HQD_AI,       // only from FAMILY_AI on
+};
+
+// a register and the (half of the) field of umr_cp_queue_state it fills
+struct hqd_reg {
+	int core;            // UMR_CORE_* or -1 to look up 'name'
+	const char *name;
+	size_t off;
+	int wide, hi, fam;
+};
+
+#define Q(f) offsetof(struct umr_cp_queue_state, f)
+#define CORE(id, f, ...) { UMR_CORE_##id, NULL, Q(f), __VA_ARGS__ }
+#define GFX(n, f, ...) { -1, "@mmCP_GFX_" n, Q(f), __VA_ARGS__ }
+
+static const struct hqd_reg compute_regs[] = {
+	CORE(CP_HQD_ACTIVE,                 active,       0, 0, HQD_ANY),
+	CORE(CP_HQD_VMID,                   vmid,         0, 0, HQD_ANY),
+	CORE(CP_HQD_PQ_BASE,                base,         1, 0, HQD_ANY),
+	CORE(CP_HQD_PQ_BASE_HI,             base,         1, 1, HQD_ANY),
+	CORE(CP_HQD_PQ_RPTR,                rptr,         0, 0, HQD_ANY),
+	CORE(CP_HQD_PQ_WPTR,                wptr,         1, 0, HQD_PRE_AI),
+	CORE(CP_HQD_PQ_WPTR_LO,             wptr,         1, 0, HQD_AI),
+	CORE(CP_HQD_PQ_WPTR_HI,             wptr,         1, 1, HQD_AI),
+	CORE(CP_HQD_PQ_RPTR_REPORT_ADDR,    rptr_addr,    1, 0, HQD_ANY),
+	CORE(CP_HQD_PQ_RPTR_REPORT_ADDR_HI, rptr_addr,    1, 1, HQD_ANY),
+	CORE(CP_HQD_PQ_CONTROL,             cntl,         0, 0, HQD_ANY),
+	CORE(CP_HQD_EOP_BASE_ADDR,          eop_base,     1, 0, HQD_ANY),
+	CORE(CP_HQD_EOP_BASE_ADDR_HI,       eop_base,     1, 1, HQD_ANY),
+	CORE(CP_HQD_EOP_RPTR,               eop_rptr,     0, 0, HQD_ANY),
+	CORE(CP_HQD_EOP_WPTR,               eop_wptr,     0, 0, HQD_ANY),
+	CORE(CP_HQD_EOP_WPTR_MEM,           eop_wptr_mem, 0, 0, HQD_ANY),
+	CORE(CP_MQD_BASE_ADDR,              mqd_base,     1, 0, HQD_ANY),
+	CORE(CP_MQD_BASE_ADDR_HI,           mqd_base,     1, 1, HQD_ANY),
+	CORE(CP_HQD_DEQUEUE_REQUEST,        deq_req,      0, 0, HQD_ANY),
+	CORE(CP_HQD_IQ_TIMER,               iq_timer,     0, 0, HQD_ANY),
+	CORE(CP_HQD_AQL_CONTROL,            aql_cntl,     0, 0, HQD_ANY),
+	CORE(CP_HQD_CTX_SAVE_BASE_ADDR_LO,  save_base,    1, 0, HQD_ANY),
+	CORE(CP_HQD_CTX_SAVE_BASE_ADDR_HI,  save_base,    1, 1, HQD_ANY),
+	CORE(CP_HQD_CTX_SAVE_SIZE,          save_size,    0, 0, HQD_ANY),
+	CORE(CP_HQD_CNTL_STACK_OFFSET,      stack_offset, 0, 0, HQD_ANY),
+	CORE(CP_HQD_CNTL_STACK_SIZE,        stack_size,   0, 0, HQD_ANY),
+};
+
+static const struct hqd_reg gfx_regs[] = {
+	GFX("HQD_ACTIVE",          active,    0, 0, HQD_ANY),
+	GFX("HQD_VMID",            vmid,      0, 0, HQD_ANY),
+	GFX("HQD_BASE",            base,      1, 0, HQD_ANY),
+	GFX("HQD_BASE_HI",         base,      1, 1, HQD_ANY),
+	GFX("HQD_RPTR",            rptr,      0, 0, HQD_ANY),
+	GFX("HQD_CSMD_RPTR",       csmd_rptr, 0, 0, HQD_ANY),
+	GFX("HQD_WPTR",            wptr,      1, 0, HQD_ANY),
+	GFX("HQD_WPTR_HI",         wptr,      1, 1, HQD_AI),
+	GFX("HQD_RPTR_ADDR",       rptr_addr, 1, 0, HQD_ANY),
+	GFX("HQD_RPTR_ADDR_HI",    rptr_addr, 1, 1, HQD_ANY),
+	GFX("HQD_CNTL",            cntl,      0, 0, HQD_ANY),
+	GFX("HQD_OFFSET",          offset,    0, 0, HQD_ANY),
+	GFX("MQD_BASE_ADDR",       mqd_base,  1, 0, HQD_ANY),
+	GFX("MQD_BASE_ADDR_HI",    mqd_base,  1, 1, HQD_ANY),
+	GFX("HQD_DEQUEUE_REQUEST", deq_req,   0, 0, HQD_ANY),
+	GFX("HQD_IQ_TIMER",        iq_timer,  0, 0, HQD_ANY),
+};
+
+#undef GFX
+#undef CORE
+#undef Q
+
+#define MAX_HQD_REGS 32
+
+/*
+ * cp_geometry - Number of MEs, pipes of the first ME and queues per pipe
+ *
+ * GFX11+ has no ME2 for compute, ME3 is the MES (SCHED/KIQ) which only
+ * uses one queue per pipe.  Compute pipes beyond ME1 are always two.
+ */
+static void cp_geometry(struct umr_asic *asic, enum umr_cp_queue_kind kind,
+			uint32_t *max_me, uint32_t *pipes, uint32_t *queues)
+{
+	int maj, min;
+
+	umr_gfx_get_ip_ver(asic, &maj, &min);
+	if (kind == UMR_CP_QUEUES_GFX) {
+		*max_me = 2;
+		*pipes = 1;
+		*queues = 2;
+		if (maj == 10 && min != 1)
+			*pipes = 2;
+		else if ((maj == 10 && min == 1) || maj == 12)
+			*queues = 8;
+		return;
+	}
+
+	*max_me = 3;
+	*pipes = 4;
+	*queues = 4;
+	switch (maj) {
+		case 10: break;
+		case 11: *max_me = 4; break;
+		case 12: *max_me = 4; *pipes = 2; break;
+		default: *queues = 8; break;
+	}
+}
+
+static int pipe_count(struct umr_asic *asic, enum umr_cp_queue_kind kind, uint32_t me, uint32_t pipes)
+{
+	if (kind == UMR_CP_QUEUES_COMPUTE && me == 2 && asic->family >= FAMILY_GFX11)
+		return 0;
+	return (kind == UMR_CP_QUEUES_GFX || me == 1) ? pipes : 2;
+}
+
+static int queue_count(enum umr_cp_queue_kind kind, uint32_t me, uint32_t queues)
+{
+	return (kind == UMR_CP_QUEUES_COMPUTE && me == 3) ? 1 : queues;
+}
+
+// the per pipe registers, NULL if this device does not have them
+static struct umr_reg *pipe_reg(struct umr_asic *asic, enum umr_cp_queue_kind kind, uint32_t me, int istat)
+{
+	char name[64];
+	int rs64 = asic->family >= FAMILY_GFX11;
+
+	if (istat) {
+		if (asic->family >= FAMILY_AI)
+			return NULL;
+		if (kind == UMR_CP_QUEUES_GFX)
+			strcpy(name, "@mmCP_INT_STAT_DEBUG");
+		else
+			sprintf(name, "@mmCP_ME%"PRIu32"_INT_STAT_DEBUG", me);
+	} else if (kind == UMR_CP_QUEUES_GFX) {
+		strcpy(name, rs64 ? "@mmCP_GFX_RS64_INSTR_PNTR0" : "@mmCP_ME_INSTR_PNTR");
+	} else if (me == 3) {
+		strcpy(name, "@mmCP_MES_INSTR_PNTR");
+	} else if (rs64) {
+		strcpy(name, "@mmCP_MEC_RS64_INSTR_PNTR");
+	} else {
+		sprintf(name, "@mmCP_MEC%"PRIu32"_INSTR_PNTR", me);
+	}
+	return umr_find_reg_data_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, name);
+}
+
+static void batch_reg(struct umr_reg_batch *b, struct umr_reg *reg, union umr_bank_select bank)
+{
+	b->addr = reg->type == REG_MMIO ? reg->addr * 4 : reg->addr;
+	b->type = reg->type;
+	b->use_bank = 2;
+	b->bank = bank;
+}
+
+/**
+ * umr_cp_queues_read - Read the HQD state of every CP queue
+ *
+ * @asic: The device
+ * @kind: The compute (MEC/MES) or the graphics (ME) queues
+ * @cq: Where to store the table, release it with umr_cp_queues_free()
+ *
+ * Every queue of every ME/pipe is listed whether it is active or not
+ * along with the instruction pointer of each pipe.  Registers this
+ * device does not have read as zero.  The HQD registers are read
+ * through the SRBM bank of their queue (the vmid of asic->options.bank
+ * is kept), asic->options is not changed.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int umr_cp_queues_read(struct umr_asic *asic, enum umr_cp_queue_kind kind, struct umr_cp_queues *cq)
+{
+	const struct hqd_reg *table;
+	struct umr_reg *regs[MAX_HQD_REGS], *iptr, *istat;
+	struct umr_reg_batch *batch;
+	struct umr_cp_queue_state *q;
+	struct umr_cp_pipe_state *p;
+	union umr_bank_select bank;
+	uint32_t max_me, pipes, queues, me, pipe, queue, v;
+	int no_table, x, n, nq, np;
+
+	memset(cq, 0, sizeof *cq);
+	cq->kind = kind;
+	if (kind == UMR_CP_QUEUES_GFX) {
+		table = gfx_regs;
+		no_table = sizeof(gfx_regs) / sizeof(gfx_regs[0]);
+	} else {
+		table = compute_regs;
+		no_table = sizeof(compute_regs) / sizeof(compute_regs[0]);
+	}
+
+	// the register set is resolved once for all queues
+	for (x = 0; x < no_table; x++) {
+		regs[x] = NULL;
+		if (table[x].fam == HQD_PRE_AI && asic->family >= FAMILY_AI)
+			continue;
+		if (table[x].fam == HQD_AI && asic->family < FAMILY_AI)
+			continue;
+		if (table[x].core >= 0)
+			regs[x] = umr_core_reg(asic, table[x].core);
+		else
+			regs[x] = umr_find_reg_data_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, (char *)table[x].name);
+	}
+
+	cp_geometry(asic, kind, &max_me, &pipes, &queues);
+	for (me = 1; me < max_me; me++) {
+		cq->no_pipes += pipe_count(asic, kind, me, pipes);
+		cq->no_queues += pipe_count(asic, kind, me, pipes) * queue_count(kind, me, queues);
+	}
+
+	cq->queues = calloc(cq->no_queues ? cq->no_queues : 1, sizeof *cq->queues);
+	cq->pipes = calloc(cq->no_pipes ? cq->no_pipes : 1, sizeof *cq->pipes);
+	batch = calloc(cq->no_queues * no_table + cq->no_pipes * 2 + 1, sizeof *batch);
+	if (!cq->queues || !cq->pipes || !batch) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		free(batch);
+		umr_cp_queues_free(cq);
+		return -1;
+	}
+
+	// gather every register of every queue in one array
+	bank = asic->options.bank;
+	n = nq = np = 0;
+	for (me = 1; me < max_me; me++) {
+		iptr = pipe_reg(asic, kind, me, 0);
+		istat = pipe_reg(asic, kind, me, 1);
+		for (pipe = 0; pipe < (uint32_t)pipe_count(asic, kind, me, pipes); pipe++) {
+			bank.srbm.me = me;
+			bank.srbm.pipe = pipe;
+			for (queue = 0; queue < (uint32_t)queue_count(kind, me, queues); queue++) {
+				q = &cq->queues[nq++];
+				q->me = me;
+				q->pipe = pipe;
+				q->queue = queue;
+				bank.srbm.queue = queue;
+				for (x = 0; x < no_table; x++)
+					if (regs[x])
+						batch_reg(&batch[n++], regs[x], bank);
+			}
+
+			p = &cq->pipes[np++];
+			p->me = me;
+			p->pipe = pipe;
+			p->has_iptr = !!iptr;
+			p->has_istat = !!istat;
+			bank.srbm.queue = 0;
+			if (iptr)
+				batch_reg(&batch[n++], iptr, bank);
+			if (istat)
+				batch_reg(&batch[n++], istat, bank);
+		}
+	}
+
+	if (umr_read_regs_batch(asic, batch, n)) {
+		free(batch);
+		umr_cp_queues_free(cq);
+		return -1;
+	}
+
+	// scatter the values back in the order they were gathered
+	n = nq = np = 0;
+	for (me = 1; me < max_me; me++) {
+		for (pipe = 0; pipe < (uint32_t)pipe_count(asic, kind, me, pipes); pipe++) {
+			for (queue = 0; queue < (uint32_t)queue_count(kind, me, queues); queue++) {
+				q = &cq->queues[nq++];
+				for (x = 0; x < no_table; x++) {
+					if (!regs[x])
+						continue;
+					v = batch[n++].value;
+					if (!table[x].wide)
+						*(uint32_t *)((char *)q + table[x].off) = v;
+					else
+						*(uint64_t *)((char *)q + table[x].off) |= (uint64_t)v << (table[x].hi ? 32 : 0);
+				}
+				q->active &= 1;
+				q->vmid &= 0xF;
+				q->base <<= 8;
+				if (kind == UMR_CP_QUEUES_COMPUTE)
+					q->eop_base <<= 8;
+			}
+
+			p = &cq->pipes[np++];
+			if (p->has_iptr)
+				p->instr_pntr = batch[n++].value;
+			if (p->has_istat)
+				p->int_stat_debug = batch[n++].value;
+		}
+	}
+
+	free(batch);
+	return 0;
+}
+
+/**
+ * umr_cp_queues_free - Release a table read by umr_cp_queues_read()
+ */
+void umr_cp_queues_free(struct umr_cp_queues *cq)
+{
+	free(cq->queues);
+	free(cq->pipes);
+	cq->queues = NULL;
+	cq->pipes = NULL;
+	cq->no_queues = cq->no_pipes = 0;
+}
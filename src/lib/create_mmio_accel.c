@@ -23,6 +23,8 @@
  *
  */
 #include "umr.h"
+#include <ctype.h>
+#include <stdarg.h>
 
 static int sort_addr(const void *A, const void *B)
 {
@@ -38,6 +40,119 @@ static int sort_addr(const void *A, const void *B)
 	return 0;
 }
 
+static void free_mmio_pages(struct umr_asic *asic)
+{
+	uint32_t x;
+
+	for (x = 0; x < asic->mmio_no_pages; x++)
+		umr_huge_free(asic->mmio_pages[x]);
+	free(asic->mmio_pages);
+	asic->mmio_pages = NULL;
+	asic->mmio_no_pages = 0;
+}
+
+/**
+ * create_mmio_pages - Create the address to register page table
+ *
+ * Only pages that contain at least one register are allocated.  Aliased
+ * registers keep the first entry (lowest ord) of mmio_accel so lookups
+ * return the same register the binary search did.  If the address space
+ * is too sparse for the table the binary search is used instead.
+ */
+static int create_mmio_pages(struct umr_asic *asic)
+{
+	uint32_t x, page, no_pages;
+	uint64_t addr;
+
+	free_mmio_pages(asic);
+
+	if (!asic->mmio_accel_size)
+		return 0;
+
+	no_pages = (asic->mmio_accel[asic->mmio_accel_size - 1].mmio_addr >> UMR_MMIO_PAGE_SHIFT) + 1;
+	if (asic->mmio_accel[asic->mmio_accel_size - 1].mmio_addr >= ((uint64_t)UMR_MMIO_MAX_PAGES << UMR_MMIO_PAGE_SHIFT))
+		return 0;
+
+	asic->mmio_pages = calloc(no_pages, sizeof asic->mmio_pages[0]);
+	if (!asic->mmio_pages) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return -1;
+	}
+	asic->mmio_no_pages = no_pages;
+
+	for (x = 0; x < asic->mmio_accel_size; x++) {
+		addr = asic->mmio_accel[x].mmio_addr;
+		page = addr >> UMR_MMIO_PAGE_SHIFT;
+		if (!asic->mmio_pages[page]) {
+			asic->mmio_pages[page] = umr_huge_alloc(UMR_MMIO_PAGE_SIZE * sizeof asic->mmio_pages[0][0]);
+			if (!asic->mmio_pages[page]) {
+				asic->err_msg("[ERROR]: Out of memory\n");
+				free_mmio_pages(asic);
+				return -1;
+			}
+		}
+		if (!asic->mmio_pages[page][addr & (UMR_MMIO_PAGE_SIZE - 1)])
+			asic->mmio_pages[page][addr & (UMR_MMIO_PAGE_SIZE - 1)] = x + 1;
+	}
+	return 0;
+}
+
+// ord is used to stabilize the sort; regs with same offset appear in
+// mmio_accel in database order (block order, then alphabetically ascending)
+#define ACCEL_ORD(blk, reg) (((uint32_t)(blk) << 20) | (uint32_t)(reg))
+
+// fill @dst with the MMIO registers of block @i, returns the number of entries
+static uint32_t fill_mmio_accel(struct umr_asic *asic, int i, struct umr_mmio_accel_data *dst)
+{
+	uint32_t x;
+	int j;
+
+	for (x = j = 0; j < asic->blocks[i]->no_regs; j++) {
+		if (asic->blocks[i]->regs[j].type == REG_MMIO) {
+			if (dst) {
+				dst[x].mmio_addr = asic->blocks[i]->regs[j].addr;
+				dst[x].ip = asic->blocks[i];
+				dst[x].reg = &asic->blocks[i]->regs[j];
+				dst[x].ord = ACCEL_ORD(i, j);
+				dst[x].flags = 0;
+				if (strstr(asic->blocks[i]->regs[j].regname, "SQ_IND_INDEX"))
+					dst[x].flags |= UMR_MMIO_ACCEL_SQ_IND_INDEX;
+				if (strstr(asic->blocks[i]->regs[j].regname, "SQ_IND_DATA"))
+					dst[x].flags |= UMR_MMIO_ACCEL_SQ_IND_DATA;
+			}
+			++x;
+		}
+	}
+	return x;
+}
+
+static int build_mmio_accel(struct umr_asic *asic)
+{
+	int i;
+	uint32_t no_regs, x;
+
+	for (no_regs = i = 0; i < asic->no_blocks; i++)
+		no_regs += fill_mmio_accel(asic, i, NULL);
+
+	free(asic->mmio_accel);
+	asic->mmio_accel = calloc(no_regs ? no_regs : 1, sizeof asic->mmio_accel[0]);
+	asic->mmio_accel_size = no_regs;
+	if (!asic->mmio_accel) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		asic->mmio_accel_size = 0;
+		return -1;
+	}
+
+	for (x = i = 0; i < asic->no_blocks; i++)
+		x += fill_mmio_accel(asic, i, &asic->mmio_accel[x]);
+
+	qsort(asic->mmio_accel, no_regs, sizeof asic->mmio_accel[0], sort_addr);
+
+	return create_mmio_pages(asic);
+}
+
+static int build_reg_name_index(struct umr_asic *asic);
+
 /**
  * umr_create_mmio_accel - Create MMIO accelerator table
  *
@@ -45,45 +160,331 @@ static int sort_addr(const void *A, const void *B)
  *
  * This function creates lookup tables that quickly convert
  * an offsetted MMIO address into a pointer to register and ip
- * block structures.
+ * block structures.  Only IP blocks that are loaded are added,
+ * the rest are added as they are loaded (see umr_load_ip_block()).
  */
 int umr_create_mmio_accel(struct umr_asic *asic)
 {
-	int i, j;
-	uint32_t no_regs, x;
+	int r = -1;
 
-	for (no_regs = i = 0; i < asic->no_blocks; i++) {
-		for (j = 0; j < asic->blocks[i]->no_regs; j++) {
-			if (asic->blocks[i]->regs[j].type == REG_MMIO) {
-				++no_regs;
-			}
-		}
+	umr_timing_begin(UMR_TIMING_MMIO_ACCEL);
+	if (asic->options.no_lazy_regs)
+		umr_load_ip_blocks(asic, NULL);
+
+	if (!build_mmio_accel(asic))
+		r = umr_create_reg_name_index(asic);
+	umr_timing_end(UMR_TIMING_MMIO_ACCEL);
+	return r;
+}
+
+// merge the MMIO registers of a newly loaded block @i into the accel table
+static int add_mmio_accel(struct umr_asic *asic, int i)
+{
+	struct umr_mmio_accel_data *add, *tab;
+	uint32_t n, x, y, z;
+
+	n = fill_mmio_accel(asic, i, NULL);
+	if (!n)
+		return 0;
+
+	add = calloc(n, sizeof add[0]);
+	tab = realloc(asic->mmio_accel, (asic->mmio_accel_size + n) * sizeof tab[0]);
+	if (!add || !tab) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		free(add);
+		if (tab)
+			asic->mmio_accel = tab;
+		return -1;
 	}
+	asic->mmio_accel = tab;
+	fill_mmio_accel(asic, i, add);
+	qsort(add, n, sizeof add[0], sort_addr);
 
-	asic->mmio_accel = calloc(no_regs, sizeof asic->mmio_accel[0]);
-	asic->mmio_accel_size = no_regs;
-	if (!asic->mmio_accel) {
+	// merge from the back so nothing is overwritten before it is moved
+	x = asic->mmio_accel_size;
+	y = n;
+	z = x + y;
+	while (y) {
+		if (x && sort_addr(&tab[x - 1], &add[y - 1]) > 0)
+			tab[--z] = tab[--x];
+		else
+			tab[--z] = add[--y];
+	}
+	asic->mmio_accel_size += n;
+	free(add);
+
+	return create_mmio_pages(asic);
+}
+
+/**
+ * umr_reg_name_hash - Hash a register name (case insensitive)
+ */
+uint32_t umr_reg_name_hash(const char *regname)
+{
+	uint32_t h = 2166136261UL;
+
+	while (*regname) {
+		h ^= (uint32_t)toupper((unsigned char)*regname++);
+		h *= 16777619UL;
+	}
+	return h;
+}
+
+static void reg_index_insert(struct umr_asic *asic, int i)
+{
+	uint32_t h, x;
+	int j;
+
+	for (j = 0; j < asic->blocks[i]->no_regs; j++) {
+		h = umr_reg_name_hash(asic->blocks[i]->regs[j].regname);
+		for (x = h & asic->reg_index_mask; asic->reg_index[x].reg; x = (x + 1) & asic->reg_index_mask);
+		asic->reg_index[x].hash = h;
+		asic->reg_index[x].ip = i;
+		asic->reg_index[x].reg = &asic->blocks[i]->regs[j];
+	}
+	asic->reg_index_used += asic->blocks[i]->no_regs;
+}
+
+static int build_reg_name_index(struct umr_asic *asic)
+{
+	uint32_t no_regs, size;
+	int i;
+
+	umr_huge_free(asic->reg_index);
+	asic->reg_index = NULL;
+	asic->reg_index_mask = 0;
+	asic->reg_index_used = 0;
+
+	for (no_regs = i = 0; i < asic->no_blocks; i++)
+		no_regs += asic->blocks[i]->no_regs;
+
+	// keep the load factor at or below 50%
+	for (size = 16; size < 2 * no_regs; size <<= 1);
+
+	asic->reg_index = umr_huge_alloc(size * sizeof asic->reg_index[0]);
+	if (!asic->reg_index) {
 		asic->err_msg("[ERROR]: Out of memory\n");
 		return -1;
 	}
+	asic->reg_index_mask = size - 1;
 
+	for (i = 0; i < asic->no_blocks; i++)
+		reg_index_insert(asic, i);
 
-	for (x = i = 0; i < asic->no_blocks; i++) {
-		for (j = 0; j < asic->blocks[i]->no_regs; j++) {
-			if (asic->blocks[i]->regs[j].type == REG_MMIO) {
-				asic->mmio_accel[x].mmio_addr = asic->blocks[i]->regs[j].addr;
-				asic->mmio_accel[x].ip = asic->blocks[i];
-				asic->mmio_accel[x].reg = &asic->blocks[i]->regs[j];
-				// ord is used to stabilize the sort; regs with same offset
-				// appear in mmio_accel in the order they appeared in the
-				// register database (i.e. alphabetically ascending)
-				asic->mmio_accel[x].ord = x;
-				++x;
-			}
+	return 0;
+}
+
+/**
+ * umr_create_reg_name_index - Create the register name hash table
+ *
+ * @asic:  Device to create the index for
+ *
+ * Hashes every register of every loaded IP block by name.  Registers
+ * with the same name (e.g. one per IP instance) are stored along the
+ * same probe sequence and lookups pick the one in the lowest numbered
+ * block like a linear scan would.
+ *
+ * Returns -1 on error.
+ */
+int umr_create_reg_name_index(struct umr_asic *asic)
+{
+	// any resolved handles point into the old register data
+	umr_wave_data_free_field_cache(asic);
+	umr_free_reg_search_index(asic);
+
+	return build_reg_name_index(asic);
+}
+
+/**
+ * umr_load_ip_block - Load the registers of an IP block
+ *
+ * @asic: The device the block belongs to
+ * @ip: The IP block
+ *
+ * Does nothing if the registers are already loaded.  Otherwise they are
+ * read from the database and added to the MMIO accel table and the name
+ * index if those exist.  Registers of other blocks do not move so
+ * pointers to them stay valid.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int umr_load_ip_block(struct umr_asic *asic, struct umr_ip_block *ip)
+{
+	int i, r;
+
+	if (!ip->source)
+		return 0;
+
+	umr_timing_begin(UMR_TIMING_DATABASE);
+	r = umr_database_load_ipblock(ip, asic->err_msg);
+	umr_timing_end(UMR_TIMING_DATABASE);
+	if (!ip->no_regs)
+		return r;
+
+	for (i = 0; i < asic->no_blocks && asic->blocks[i] != ip; i++);
+	if (i == asic->no_blocks)
+		return r;
+
+	if (asic->mmio_accel && add_mmio_accel(asic, i))
+		r = -1;
+	if (asic->reg_index) {
+		if (2 * (asic->reg_index_used + ip->no_regs) > asic->reg_index_mask + 1) {
+			if (build_reg_name_index(asic))
+				r = -1;
+		} else {
+			reg_index_insert(asic, i);
 		}
 	}
+	// the wildcard index numbers every register so it has to be rebuilt
+	umr_free_reg_search_index(asic);
+	return r;
+}
 
-	qsort(asic->mmio_accel, no_regs, sizeof asic->mmio_accel[0], sort_addr);
+// most blocks are small, a few threads are enough to hide the big ones
+#define UMR_LOAD_THREADS 8
+
+// IP blocks loaded by umr_load_ip_blocks() on several threads, the
+// error messages of each block are kept so they can be reported in
+// block order once everything is loaded
+struct load_job {
+	struct umr_ip_block **blocks;
+	char **msgs;
+	int *res;
+	int n, next;
+};
 
+static __thread char **load_msgs;    // messages of the block being loaded
+
+static int load_errout(const char *fmt, ...)
+{
+	va_list ap;
+	char buf[512], *p;
+	size_t len, olen;
+
+	va_start(ap, fmt);
+	vsnprintf(buf, sizeof buf, fmt, ap);
+	va_end(ap);
+
+	len = strlen(buf);
+	olen = *load_msgs ? strlen(*load_msgs) : 0;
+	p = realloc(*load_msgs, olen + len + 1);
+	if (p) {
+		memcpy(p + olen, buf, len + 1);
+		*load_msgs = p;
+	}
 	return 0;
 }
+
+static void *load_worker(void *arg)
+{
+	struct load_job *job = arg;
+	int i;
+
+	while ((i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->n) {
+		load_msgs = &job->msgs[i];
+		job->res[i] = umr_database_load_ipblock(job->blocks[i], load_errout);
+	}
+	load_msgs = NULL;
+	return NULL;
+}
+
+// load @n blocks, on worker threads if there are enough of them
+static int load_blocks(struct umr_asic *asic, struct umr_ip_block **blocks, int n)
+{
+	pthread_t threads[UMR_LOAD_THREADS];
+	struct load_job job;
+	int i, no_threads, r = 0;
+	long cpus;
+
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	no_threads = n / 2;
+	if (no_threads > UMR_LOAD_THREADS)
+		no_threads = UMR_LOAD_THREADS;
+	if (cpus > 0 && no_threads > cpus)
+		no_threads = cpus;
+
+	memset(&job, 0, sizeof job);
+	job.msgs = calloc(n, sizeof job.msgs[0]);
+	job.res = calloc(n, sizeof job.res[0]);
+	if (no_threads < 2 || !job.msgs || !job.res) {
+		free(job.msgs);
+		free(job.res);
+		for (i = 0; i < n; i++)
+			if (umr_database_load_ipblock(blocks[i], asic->err_msg))
+				r = -1;
+		return r;
+	}
+	job.blocks = blocks;
+	job.n = n;
+
+	// the calling thread is one of the workers
+	for (i = 0; i < no_threads - 1; i++)
+		if (pthread_create(&threads[i], NULL, load_worker, &job))
+			break;
+	no_threads = i;
+	load_worker(&job);
+	for (i = 0; i < no_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	for (i = 0; i < n; i++) {
+		if (job.msgs[i])
+			asic->err_msg("%s", job.msgs[i]);
+		free(job.msgs[i]);
+		if (job.res[i])
+			r = -1;
+	}
+	free(job.msgs);
+	free(job.res);
+	return r;
+}
+
+/**
+ * umr_load_ip_blocks - Load the registers of IP blocks
+ *
+ * @asic: The device
+ * @ipname: Load blocks whose name starts with this (NULL == all blocks)
+ *
+ * Code that walks asic->blocks[]->regs directly instead of using the
+ * lookup functions (which load what they need) should call this first.
+ * The blocks are read on a few threads, errors are reported through
+ * asic->err_msg in block order once all of them are loaded.  The MMIO
+ * accel table and the name index are then rebuilt once.
+ *
+ * Returns 0 on success, -1 if any block failed to load.
+ */
+int umr_load_ip_blocks(struct umr_asic *asic, const char *ipname)
+{
+	struct umr_ip_block **blocks;
+	int i, n, r = 0;
+
+	if (asic->all_regs_loaded)
+		return 0;
+
+	blocks = calloc(asic->no_blocks ? asic->no_blocks : 1, sizeof blocks[0]);
+	if (!blocks) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return -1;
+	}
+	for (n = i = 0; i < asic->no_blocks; i++)
+		if (asic->blocks[i]->source &&
+		    (!ipname || !strncmp(asic->blocks[i]->ipname, ipname, strlen(ipname))))
+			blocks[n++] = asic->blocks[i];
+	if (n) {
+		umr_timing_begin(UMR_TIMING_DATABASE);
+		r = load_blocks(asic, blocks, n);
+		umr_timing_end(UMR_TIMING_DATABASE);
+	}
+	free(blocks);
+	if (!ipname)
+		asic->all_regs_loaded = 1;
+
+	// rebuilding once is cheaper than merging block by block
+	if (n) {
+		if (asic->mmio_accel && build_mmio_accel(asic))
+			r = -1;
+		if (asic->reg_index && build_reg_name_index(asic))
+			r = -1;
+		umr_free_reg_search_index(asic);
+	}
+	return r;
+}
@@ -28,6 +28,10 @@ void umr_database_free_scan_items(struct umr_database_scan_item *it)
 {
 	struct umr_database_scan_item *nit;
 
+	if (it && it->index) {
+		free(it->index->first);
+		free(it->index);
+	}
 	while (it) {
 		nit = it->next;
 		free(it);
@@ -29,6 +29,7 @@
  *
  * This function searches through a linked list of database scan items to find an item that matches
  * the given IP name, major version, minor version, and revision. It also optionally filters by a desired path.
+ * If the list is indexed only the items of @ipname are visited (in list order).
  *
  * @param db Pointer to the head of the database scan item list.
  * @param ipname The name of the IP to search for.
@@ -45,8 +46,10 @@ struct umr_database_scan_item *umr_database_find_ip(
 	char *desired_path)
 {
 	struct umr_database_scan_item *si, *best;
+	int indexed;
 
-	si = db;
+	indexed = db && db->index;
+	si = indexed ? umr_database_scan_find_ipname(db, ipname) : db;
 	best = NULL;
 	while (si) {
 		if (!desired_path ||
@@ -67,7 +70,7 @@ struct umr_database_scan_item *umr_database_find_ip(
 				}
 			}
 		}
-		si = si->next;
+		si = indexed ? si->next_ip : si->next;
 	}
 	if (!best && desired_path)
 		return umr_database_find_ip(db, ipname, maj, min, rev, NULL);
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ */
+
+#include "umr.h"
+
+#define NAME_POOL_CHUNK (64 * 1024)
+
+struct umr_name_pool_chunk {
+	struct umr_name_pool_chunk *next;
+	size_t used, size;
+	uint64_t data[];
+};
+
+struct umr_name_pool {
+	struct umr_name_pool_chunk *chunks;
+	char **slots;                   // open addressed table of interned names
+	uint32_t no_slots, no_names;
+};
+
+// exact (case sensitive) FNV-1a
+static uint32_t name_hash(const char *name)
+{
+	uint32_t h = 2166136261UL;
+	while (*name) {
+		h ^= (uint8_t)*name++;
+		h *= 16777619UL;
+	}
+	return h;
+}
+
+/**
+ * umr_name_pool_create - Create an empty name pool
+ *
+ * A name pool is an arena that register/bitfield names (and other
+ * database memory with the same lifetime) are carved out of, identical
+ * names are only stored once.  Everything is released at once with
+ * umr_name_pool_free().
+ */
+struct umr_name_pool *umr_name_pool_create(void)
+{
+	return calloc(1, sizeof(struct umr_name_pool));
+}
+
+/**
+ * umr_name_pool_alloc - Allocate zeroed memory from a name pool
+ *
+ * The memory is 8 byte aligned and lives until the pool is freed.
+ * Returns NULL if out of memory.
+ */
+void *umr_name_pool_alloc(struct umr_name_pool *pool, size_t size)
+{
+	struct umr_name_pool_chunk *c = pool->chunks;
+	void *p;
+
+	size = (size + 7) & ~(size_t)7;
+	if (!c || c->used + size > c->size) {
+		size_t csize = size > NAME_POOL_CHUNK ? size : NAME_POOL_CHUNK;
+		c = umr_huge_alloc(sizeof *c + csize);
+		if (!c)
+			return NULL;
+		c->size = csize;
+		c->next = pool->chunks;
+		pool->chunks = c;
+	}
+	p = (char *)c->data + c->used;
+	c->used += size;
+	return p;
+}
+
+static int name_pool_grow(struct umr_name_pool *pool)
+{
+	char **slots;
+	uint32_t n, x, h;
+
+	n = pool->no_slots ? pool->no_slots * 2 : 1024;
+	slots = calloc(n, sizeof *slots);
+	if (!slots)
+		return -1;
+	for (x = 0; x < pool->no_slots; x++) {
+		if (!pool->slots[x])
+			continue;
+		h = name_hash(pool->slots[x]) & (n - 1);
+		while (slots[h])
+			h = (h + 1) & (n - 1);
+		slots[h] = pool->slots[x];
+	}
+	free(pool->slots);
+	pool->slots = slots;
+	pool->no_slots = n;
+	return 0;
+}
+
+/**
+ * umr_name_pool_intern - Store a name in a pool
+ *
+ * Returns the pooled copy of @name, the same pointer is returned for
+ * every identical name.  Returns NULL if out of memory.
+ */
+char *umr_name_pool_intern(struct umr_name_pool *pool, const char *name)
+{
+	uint32_t h;
+	size_t len;
+	char *p;
+
+	// keep the table at most half full
+	if (2 * (pool->no_names + 1) > pool->no_slots && name_pool_grow(pool))
+		return NULL;
+
+	h = name_hash(name) & (pool->no_slots - 1);
+	while (pool->slots[h]) {
+		if (!strcmp(pool->slots[h], name))
+			return pool->slots[h];
+		h = (h + 1) & (pool->no_slots - 1);
+	}
+
+	len = strlen(name) + 1;
+	p = umr_name_pool_alloc(pool, len);
+	if (!p)
+		return NULL;
+	memcpy(p, name, len);
+	pool->slots[h] = p;
+	++pool->no_names;
+	return p;
+}
+
+/**
+ * umr_name_pool_free - Free a name pool and everything allocated from it
+ */
+void umr_name_pool_free(struct umr_name_pool *pool)
+{
+	struct umr_name_pool_chunk *c, *n;
+
+	if (!pool)
+		return;
+	for (c = pool->chunks; c; c = n) {
+		n = c->next;
+		umr_huge_free(c);
+	}
+	free(pool->slots);
+	free(pool);
+}
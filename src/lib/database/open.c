@@ -37,18 +37,21 @@
  * @param path     The base path where the database file might be located (can be NULL).
  * @param filename The name of the database file to open.
  * @param binary   Flag indicating whether to open the file in binary mode (`1` for binary, `0` for text).
+ * @param found    If not NULL receives the path of the file that was opened.
+ * @param len      Size of the @found buffer.
  * @return A pointer to the opened FILE structure if successful, or NULL if all attempts fail.
  */
-FILE *umr_database_open(char *path, char *filename, int binary)
+FILE *umr_database_open_path(char *path, char *filename, int binary, char *found, size_t len)
 {
 	FILE *f;
 	char p[512];
 	const char* mode = binary ? "rb" : "r";
 
 	// 1. try to open it directly
-	f = fopen(filename, mode);
+	snprintf(p, sizeof p, "%s", filename);
+	f = fopen(p, mode);
 	if (f)
-		return f;
+		goto done;
 
 	// 2. if there is a path option used try that
 	if (path && strlen(path)) {
@@ -56,7 +59,7 @@ FILE *umr_database_open(char *path, char *filename, int binary)
 		sprintf(p, "%s%s%s", path, s, filename);
 		f = fopen(p, mode);
 		if (f)
-			return f;
+			goto done;
 	}
 
 	// 3. try using an environment path
@@ -66,7 +69,7 @@ FILE *umr_database_open(char *path, char *filename, int binary)
 		sprintf(p, "%s%s%s", path, s, filename);
 		f = fopen(p, mode);
 		if (f)
-			return f;
+			goto done;
 	}
 
 	// 4. try using UMR_DB_DIR define
@@ -74,10 +77,26 @@ FILE *umr_database_open(char *path, char *filename, int binary)
 	sprintf(p, "%s%s", UMR_DB_DIR, filename);
 	f = fopen(p, mode);
 	if (f)
-		return f;
+		goto done;
 #endif
 
 	// 5. try using CMAKE_SOURCE_DIR/database
 	sprintf(p, "%s/database/%s", UMR_SOURCE_DIR, filename);
-	return fopen(p, mode);
+	f = fopen(p, mode);
+done:
+	if (f)
+		umr_timing_count(UMR_TIMING_DATABASE, 1, 0);
+	if (f && found && len)
+		snprintf(found, len, "%s", p);
+	return f;
+}
+
+/**
+ * @brief Opens a database file from various possible locations.
+ *
+ * Same as umr_database_open_path() without reporting where the file was found.
+ */
+FILE *umr_database_open(char *path, char *filename, int binary)
+{
+	return umr_database_open_path(path, filename, binary, NULL, 0);
 }
@@ -33,21 +33,7 @@ ipcmnname, ipsocname, instance, regfile
 ...
 
 */
-/**
- * @brief Reads ASIC information from a database file.
- *
- * This function reads and parses an ASIC description file to initialize an
- * \ref umr_asic structure. The file contains details about the ASIC, including
- * common name, SOC15 filename, family ID, number of blocks, VGPR granularity,
- * and whether it is an APU. It also lists IP blocks associated with the ASIC.
- *
- * @param options Pointer to a \ref umr_options structure containing configuration options.
- * @param filename The name of the database file to read from.
- * @param errout Callback function for error output.
- *
- * @return A pointer to the initialized \ref umr_asic structure on success, or NULL on failure.
- */
-struct umr_asic *umr_database_read_asic(struct umr_options *options, char *filename, umr_err_output errout)
+static struct umr_asic *read_asic(struct umr_options *options, char *filename, umr_err_output errout)
 {
 	char linebuf[256], cmnname[256], soc15fname[256], ipcmnname[256], ipsocname[256], regfile[256];
 	struct umr_asic *asic;
@@ -107,6 +93,7 @@ struct umr_asic *umr_database_read_asic(struct umr_options *options, char *filen
 	}
 
 	umr_database_free_soc15(soc15);
+	umr_timing_count(UMR_TIMING_DATABASE, 0, ftell(f));
 	fclose(f);
 	return asic;
 error:
@@ -116,3 +103,27 @@ error:
 	return NULL;
 
 }
+
+/**
+ * @brief Reads ASIC information from a database file.
+ *
+ * This function reads and parses an ASIC description file to initialize an
+ * \ref umr_asic structure. The file contains details about the ASIC, including
+ * common name, SOC15 filename, family ID, number of blocks, VGPR granularity,
+ * and whether it is an APU. It also lists IP blocks associated with the ASIC.
+ *
+ * @param options Pointer to a \ref umr_options structure containing configuration options.
+ * @param filename The name of the database file to read from.
+ * @param errout Callback function for error output.
+ *
+ * @return A pointer to the initialized \ref umr_asic structure on success, or NULL on failure.
+ */
+struct umr_asic *umr_database_read_asic(struct umr_options *options, char *filename, umr_err_output errout)
+{
+	struct umr_asic *asic;
+
+	umr_timing_begin(UMR_TIMING_DATABASE);
+	asic = read_asic(options, filename, errout);
+	umr_timing_end(UMR_TIMING_DATABASE);
+	return asic;
+}
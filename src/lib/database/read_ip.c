@@ -56,74 +56,54 @@ static void fill_ipver_from_path(char* ip_path, struct umr_ip_block* ip_block) {
 	}
 }
 
-/**
- * @brief Reads an IP block from the database.
- *
- * This function reads an IP (Integrated Processor) block's register information
- * from a specified file in the database. It parses the file to extract register
- * details and populates an `umr_ip_block` structure with this information.
- *
- * @param soc15        Pointer to the SOC15 database, which contains information about various IP blocks.
- * @param path         The base path where the IP block's register file is located.
- * @param filename     The name of the file containing the IP block's register information.
- * @param cmnname      Common name for the IP block.
- * @param soc15name    SOC15-specific name for the IP block.
- * @param inst         Instance number of the IP block.
- * @param errout       Function pointer to an error output function used for logging errors.
- *
- * @return A pointer to a populated `umr_ip_block` structure on success, or NULL if an error occurs.
- */
-struct umr_ip_block *umr_database_read_ipblock(struct umr_soc15_database *soc15, char *path, char *filename, char *cmnname, char *soc15name, int inst, umr_err_output errout)
+// the registers parsed from one .reg file, shared by every IP block
+// that loads the same file so that identical devices enumerated in one
+// process parse (and store the names and bitfields of) each file once
+struct umr_reg_table {
+	char *regpath;
+	uint64_t size, mtime;       // of the .reg file when it was read
+	int refs;
+	struct umr_ip_block tmpl;   // registers without segment offsets
+	uint8_t *segidx;            // segment index of each register
+	struct umr_reg_table *next;
+};
+
+static struct umr_reg_table *reg_tables;
+static pthread_mutex_t reg_tables_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int read_ipblock_text(struct umr_ip_block *ip, const char *regpath, uint8_t **segidx, umr_err_output errout)
 {
-	struct umr_ip_block *ip;
 	FILE *f;
 	uint32_t no_regs;
 	int x;
 	char linebuf[256];
 
-	if (soc15) {
-		// find soc15 entry
-		while (soc15) {
-			if (!strcmp(soc15->ipname, soc15name))
-				break;
-			soc15 = soc15->next;
-		}
-		if (!soc15) {
-			errout("[ERROR]: Cannot find IP name [%s] in the SOC15 table\n", soc15name);
-			return NULL;
-		}
-	}
-
-	f = umr_database_open(path, filename, 0);
+	f = fopen(regpath, "r");
 	if (!f) {
-		errout("[ERROR]: IP register file [%s] not found\n", filename);
-		errout("[ERROR]: These files are typically found in the source tree under [database/ip/]\n");
-		errout("[ERROR]: If you have manually relocated the database tree use the '-dbp' option to tell UMR where they are\n");
-		return NULL;
+		errout("[ERROR]: IP register file [%s] not found\n", regpath);
+		return -1;
 	}
 
-	ip = calloc(1, sizeof *ip);
-	if (!ip) {
-		errout("[ERROR]: Could not allocate memory for IP block\n");
+	if (!fgets(linebuf, sizeof(linebuf), f) || sscanf(linebuf, "%"SCNu32, &no_regs) != 1) {
+		errout("[ERROR]: Could not read first line from IP database file [%s]\n", regpath);
 		fclose(f);
-		return NULL;
+		return -1;
 	}
-
-	if (!fgets(linebuf, sizeof(linebuf), f) || sscanf(linebuf, "%"SCNu32, &no_regs) != 1) {
-		errout("[ERROR]: Could not read first line from IP database file [%s, %s, %s, %s, %d]\n",
-			path, filename, cmnname, soc15name, inst);
-		free(ip);
+	ip->regs = umr_huge_alloc((no_regs ? no_regs : 1) * sizeof(*(ip->regs)));
+	*segidx = calloc(no_regs ? no_regs : 1, 1);
+	ip->name_pool = umr_name_pool_create();
+	if (!ip->regs || !*segidx || !ip->name_pool) {
+		errout("[ERROR]: Could not allocate memory for IP block\n");
+		umr_huge_free(ip->regs);
+		ip->regs = NULL;
+		free(*segidx);
+		*segidx = NULL;
+		umr_name_pool_free(ip->name_pool);
+		ip->name_pool = NULL;
 		fclose(f);
-		return NULL;
+		return -1;
 	}
 	ip->no_regs = no_regs;
-	ip->regs = calloc(no_regs, sizeof(*(ip->regs)));
-	ip->ipname = strdup(cmnname);
-
-	// try to parse version out of filename (assume path has no spaces)
-	if (sscanf(filename, "%s", linebuf)) {
-		fill_ipver_from_path(linebuf, ip);
-	}
 
 	x = 0;
 	while (x != ip->no_regs && fgets(linebuf, sizeof linebuf, f)) {
@@ -147,30 +127,318 @@ struct umr_ip_block *umr_database_read_ipblock(struct umr_soc15_database *soc15,
 				errout("[ERROR]: Invalid regfile line [%s]\n", linebuf);
 		}
 
-		ip->regs[x].regname = strdup(reg_fields.name);
+		ip->regs[x].regname = umr_name_pool_intern(ip->name_pool, reg_fields.name);
 		ip->regs[x].type    = reg_fields.type;
 		ip->regs[x].addr    = reg_fields.addr;
-		if (soc15 && ip->regs[x].type == REG_MMIO)
-			ip->regs[x].addr += soc15->off[inst][reg_fields.idx];
+		(*segidx)[x] = reg_fields.idx < 0xFF ? reg_fields.idx : 0xFF;
 		ip->regs[x].no_bits = reg_fields.nobits;
 		ip->regs[x].bit64   = reg_fields.is64;
 
 		if (reg_fields.nobits) {
-			ip->regs[x].bits = calloc(reg_fields.nobits, sizeof(*(ip->regs[x].bits)));
+			ip->regs[x].bits = umr_name_pool_alloc(ip->name_pool, reg_fields.nobits * sizeof(*(ip->regs[x].bits)));
 			for (y = 0; y < reg_fields.nobits; y++) {
 				if (!fgets(linebuf, sizeof linebuf, f) || sscanf(linebuf, "\t%s %d %d", bit_fields.name, &bit_fields.start, &bit_fields.stop) != 3){
 					errout("[ERROR]: Could not read bitfield definition\n");
 					fclose(f);
-					return ip;
+					return 0;
 				}
-				ip->regs[x].bits[y].regname = strdup(bit_fields.name);
+				ip->regs[x].bits[y].regname = umr_name_pool_intern(ip->name_pool, bit_fields.name);
 				ip->regs[x].bits[y].start = bit_fields.start;
 				ip->regs[x].bits[y].stop = bit_fields.stop;
-				ip->regs[x].bits[y].bitfield_print = &umr_bitfield_default;
 			}
 		}
 		++x;
 	}
 	fclose(f);
+	return 0;
+}
+
+static void free_reg_table(struct umr_reg_table *t)
+{
+	if (t->tmpl.db_map) {
+		umr_database_free_ipblock_bin(&t->tmpl);
+	} else {
+		umr_name_pool_free(t->tmpl.name_pool);
+		umr_huge_free(t->tmpl.regs);
+	}
+	free(t->segidx);
+	free(t->regpath);
+	free(t);
+}
+
+// find the table for @regpath, called with reg_tables_lock held
+static struct umr_reg_table *find_reg_table(const char *regpath, const struct stat *st)
+{
+	struct umr_reg_table *t;
+
+	// a file edited since it was read is read again, blocks already
+	// using the old table keep it
+	for (t = reg_tables; t; t = t->next)
+		if (!strcmp(t->regpath, regpath) && t->size == (uint64_t)st->st_size && t->mtime == (uint64_t)st->st_mtime)
+			return t;
+	return NULL;
+}
+
+static struct umr_reg_table *read_reg_table(const char *regpath, const struct stat *st, umr_err_output errout)
+{
+	struct umr_reg_table *t;
+
+	t = calloc(1, sizeof *t);
+	if (t)
+		t->regpath = strdup(regpath);
+	if (!t || !t->regpath) {
+		free(t);
+		errout("[ERROR]: Could not allocate memory for IP block\n");
+		return NULL;
+	}
+	t->size = st->st_size;
+	t->mtime = st->st_mtime;
+
+	// use the compiled form of the file if there is an up to date one
+	if (umr_database_read_ipblock_bin(regpath, &t->tmpl, &t->segidx) &&
+	    read_ipblock_text(&t->tmpl, regpath, &t->segidx, errout)) {
+		free_reg_table(t);
+		return NULL;
+	}
+	umr_timing_count(UMR_TIMING_DATABASE, 1, t->size);
+	return t;
+}
+
+/**
+ * umr_database_read_ipblock_regs - Load the registers of an IP block
+ *
+ * @ip: The IP block to populate (regs/no_regs)
+ * @regpath: Path of the .reg file
+ * @seg: Segment offsets added to MMIO register addresses (or NULL)
+ * @no_seg: Number of entries in @seg
+ * @errout: Function pointer to an error output function
+ *
+ * Uses the compiled form of the file if there is an up to date one,
+ * otherwise the text file is parsed.  Each file is only read once per
+ * process while any IP block uses it: the register names and bitfields
+ * are shared and only the regs[] array (which holds the per device
+ * addresses and values) is private to @ip.  Release the registers with
+ * umr_database_free_ipblock_regs().  Safe to call from several threads
+ * for different IP blocks.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int umr_database_read_ipblock_regs(struct umr_ip_block *ip, const char *regpath, const uint64_t *seg, int no_seg, umr_err_output errout)
+{
+	struct umr_reg_table *t, *nt;
+	struct stat st;
+	int x;
+
+	if (stat(regpath, &st)) {
+		errout("[ERROR]: IP register file [%s] not found\n", regpath);
+		return -1;
+	}
+
+	pthread_mutex_lock(&reg_tables_lock);
+	t = find_reg_table(regpath, &st);
+	if (!t) {
+		// parse without the lock so blocks can be loaded in parallel
+		pthread_mutex_unlock(&reg_tables_lock);
+		nt = read_reg_table(regpath, &st, errout);
+		if (!nt)
+			return -1;
+		pthread_mutex_lock(&reg_tables_lock);
+		t = find_reg_table(regpath, &st);
+		if (t) {
+			// another thread read the same file first
+			free_reg_table(nt);
+		} else {
+			t = nt;
+			t->next = reg_tables;
+			reg_tables = t;
+		}
+	}
+	++t->refs;
+	pthread_mutex_unlock(&reg_tables_lock);
+
+	ip->reg_table = t;
+	ip->regs = umr_huge_alloc((t->tmpl.no_regs ? t->tmpl.no_regs : 1) * sizeof ip->regs[0]);
+	if (!ip->regs) {
+		umr_database_free_ipblock_regs(ip);
+		errout("[ERROR]: Could not allocate memory for IP block\n");
+		return -1;
+	}
+	memcpy(ip->regs, t->tmpl.regs, t->tmpl.no_regs * sizeof ip->regs[0]);
+	if (seg)
+		for (x = 0; x < t->tmpl.no_regs; x++)
+			if (ip->regs[x].type == REG_MMIO && t->segidx[x] < no_seg)
+				ip->regs[x].addr += seg[t->segidx[x]];
+	ip->no_regs = t->tmpl.no_regs;
+	ip->name_pool = t->tmpl.name_pool;
+	ip->db_map = t->tmpl.db_map;
+	ip->db_map_size = t->tmpl.db_map_size;
+	ip->db_bits = t->tmpl.db_bits;
+	return 0;
+}
+
+/**
+ * umr_database_free_ipblock_regs - Release the registers of an IP block
+ *
+ * Only valid for blocks populated by umr_database_read_ipblock_regs(),
+ * the shared table is freed when its last user releases it.  The IP
+ * block structure itself and its ipname are left to the caller.
+ */
+void umr_database_free_ipblock_regs(struct umr_ip_block *ip)
+{
+	struct umr_reg_table *t = ip->reg_table, **pt;
+
+	umr_huge_free(ip->regs);
+	ip->regs = NULL;
+	ip->no_regs = 0;
+	ip->reg_table = NULL;
+	ip->name_pool = NULL;
+	ip->db_map = NULL;
+	ip->db_bits = NULL;
+	if (!t)
+		return;
+
+	pthread_mutex_lock(&reg_tables_lock);
+	if (!--t->refs) {
+		for (pt = &reg_tables; *pt != t; pt = &(*pt)->next);
+		*pt = t->next;
+		free_reg_table(t);
+	}
+	pthread_mutex_unlock(&reg_tables_lock);
+}
+
+/**
+ * umr_database_defer_ipblock - Record where the registers of an IP block come from
+ *
+ * @ip: The IP block (without registers)
+ * @regpath: Path of the .reg file
+ * @seg: Segment offsets added to MMIO register addresses (or NULL)
+ * @no_seg: Number of entries in @seg
+ *
+ * The registers are read by umr_database_load_ipblock() the first time
+ * they are needed.
+ *
+ * Returns 0 on success, -1 if out of memory.
+ */
+int umr_database_defer_ipblock(struct umr_ip_block *ip, const char *regpath, const uint64_t *seg, int no_seg)
+{
+	struct umr_ip_block_source *src;
+
+	src = calloc(1, sizeof *src);
+	if (!src)
+		return -1;
+	src->regpath = strdup(regpath);
+	if (seg && no_seg) {
+		src->seg = calloc(no_seg, sizeof src->seg[0]);
+		if (src->seg) {
+			memcpy(src->seg, seg, no_seg * sizeof src->seg[0]);
+			src->no_seg = no_seg;
+		}
+	}
+	if (!src->regpath || (seg && no_seg && !src->seg)) {
+		umr_database_free_ipblock_source(src);
+		return -1;
+	}
+	ip->source = src;
+	return 0;
+}
+
+/**
+ * umr_database_load_ipblock - Load the registers of a deferred IP block
+ *
+ * @ip: The IP block
+ * @errout: Function pointer to an error output function
+ *
+ * Does nothing if the registers are already loaded.  The block is
+ * marked as loaded even if reading the file fails so it is not retried
+ * on every lookup.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int umr_database_load_ipblock(struct umr_ip_block *ip, umr_err_output errout)
+{
+	struct umr_ip_block_source *src = ip->source;
+	int r;
+
+	if (!src)
+		return 0;
+	ip->source = NULL;
+	r = umr_database_read_ipblock_regs(ip, src->regpath, src->seg, src->no_seg, errout);
+	umr_database_free_ipblock_source(src);
+	return r;
+}
+
+void umr_database_free_ipblock_source(struct umr_ip_block_source *src)
+{
+	if (src) {
+		free(src->regpath);
+		free(src->seg);
+		free(src);
+	}
+}
+
+/**
+ * @brief Creates an IP block from the database.
+ *
+ * This function looks up an IP (Integrated Processor) block's register file
+ * in the database and creates an `umr_ip_block` structure for it.  The
+ * registers themselves are only read when first needed (see
+ * umr_load_ip_block()).
+ *
+ * @param soc15        Pointer to the SOC15 database, which contains information about various IP blocks.
+ * @param path         The base path where the IP block's register file is located.
+ * @param filename     The name of the file containing the IP block's register information.
+ * @param cmnname      Common name for the IP block.
+ * @param soc15name    SOC15-specific name for the IP block.
+ * @param inst         Instance number of the IP block.
+ * @param errout       Function pointer to an error output function used for logging errors.
+ *
+ * @return A pointer to a populated `umr_ip_block` structure on success, or NULL if an error occurs.
+ */
+struct umr_ip_block *umr_database_read_ipblock(struct umr_soc15_database *soc15, char *path, char *filename, char *cmnname, char *soc15name, int inst, umr_err_output errout)
+{
+	struct umr_ip_block *ip;
+	FILE *f;
+	char linebuf[256], regpath[512];
+
+	if (soc15) {
+		// find soc15 entry
+		while (soc15) {
+			if (!strcmp(soc15->ipname, soc15name))
+				break;
+			soc15 = soc15->next;
+		}
+		if (!soc15) {
+			errout("[ERROR]: Cannot find IP name [%s] in the SOC15 table\n", soc15name);
+			return NULL;
+		}
+	}
+
+	f = umr_database_open_path(path, filename, 0, regpath, sizeof regpath);
+	if (!f) {
+		errout("[ERROR]: IP register file [%s] not found\n", filename);
+		errout("[ERROR]: These files are typically found in the source tree under [database/ip/]\n");
+		errout("[ERROR]: If you have manually relocated the database tree use the '-dbp' option to tell UMR where they are\n");
+		return NULL;
+	}
+	fclose(f);
+
+	ip = calloc(1, sizeof *ip);
+	if (!ip) {
+		errout("[ERROR]: Could not allocate memory for IP block\n");
+		return NULL;
+	}
+	ip->ipname = strdup(cmnname);
+
+	// try to parse version out of filename (assume path has no spaces)
+	if (sscanf(filename, "%s", linebuf)) {
+		fill_ipver_from_path(linebuf, ip);
+	}
+
+	if (!ip->ipname || umr_database_defer_ipblock(ip, regpath, soc15 ? soc15->off[inst] : NULL, soc15 ? UMR_SOC15_MAX_SEG : 0)) {
+		errout("[ERROR]: Could not allocate memory for IP block\n");
+		free(ip->ipname);
+		free(ip);
+		return NULL;
+	}
 	return ip;
 }
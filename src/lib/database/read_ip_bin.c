@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ */
+
+#include "umr.h"
+#include "umr_regdb.h"
+#if defined(__unix__)
+#include <sys/mman.h>
+#endif
+
+/**
+ * umr_database_read_ipblock_bin - Populate an IP block from a compiled database
+ *
+ * @regpath: Path of the .reg text file, the compiled file is looked up next
+ *           to it with the UMR_REGDB_SUFFIX extension
+ * @ip: The IP block to populate (regs/no_regs)
+ * @segidx: Receives an allocated array with the segment index of each
+ *          register, register addresses are left as stored in the file
+ *
+ * The compiled file is mapped read-only and the register and bitfield
+ * names point directly into its string table.  The register and bitfield
+ * arrays are allocated in one block each since the decoded records carry
+ * pointers the file cannot hold.
+ *
+ * Returns 0 on success, or -1 if there is no compiled file, it is stale
+ * (the .reg file changed since it was compiled) or it is malformed, in
+ * which case the caller should parse the text file.
+ */
+int umr_database_read_ipblock_bin(const char *regpath, struct umr_ip_block *ip, uint8_t **segidx)
+{
+#if defined(__unix__)
+	const struct umr_regdb_header *hdr;
+	const struct umr_regdb_reg *rr;
+	const struct umr_regdb_bit *rb;
+	const char *strtab;
+	char binpath[600];
+	struct stat st, bst;
+	size_t len, size;
+	uint32_t x, y;
+	void *map;
+	int fd;
+
+	len = strlen(regpath);
+	if (len < 4 || strcmp(regpath + len - 4, ".reg") || len + 1 > sizeof binpath)
+		return -1;
+	snprintf(binpath, sizeof binpath, "%.*s%s", (int)(len - 4), regpath, UMR_REGDB_SUFFIX);
+
+	if (stat(regpath, &st))
+		return -1;
+	fd = open(binpath, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &bst) || bst.st_size < (off_t)sizeof *hdr) {
+		close(fd);
+		return -1;
+	}
+	size = bst.st_size;
+	map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -1;
+
+	// validate the header and that every array fits in the file
+	hdr = map;
+	if (hdr->magic != UMR_REGDB_MAGIC || hdr->version != UMR_REGDB_VERSION ||
+	    hdr->src_size != (uint64_t)st.st_size || hdr->src_mtime != (uint64_t)st.st_mtime ||
+	    !hdr->strtab_size ||
+	    size != sizeof *hdr + (uint64_t)hdr->no_regs * sizeof *rr +
+		    (uint64_t)hdr->no_bits * sizeof *rb + hdr->strtab_size)
+		goto error;
+	rr = (const void *)(hdr + 1);
+	rb = (const void *)(rr + hdr->no_regs);
+	strtab = (const char *)(rb + hdr->no_bits);
+	if (strtab[hdr->strtab_size - 1])
+		goto error;
+
+	ip->regs = umr_huge_alloc((hdr->no_regs ? hdr->no_regs : 1) * sizeof ip->regs[0]);
+	ip->db_bits = umr_huge_alloc((hdr->no_bits ? hdr->no_bits : 1) * sizeof ip->db_bits[0]);
+	*segidx = calloc(hdr->no_regs ? hdr->no_regs : 1, 1);
+	if (!ip->regs || !ip->db_bits || !*segidx)
+		goto error_free;
+
+	for (x = 0; x < hdr->no_regs; x++) {
+		if (rr[x].name >= hdr->strtab_size ||
+		    (uint64_t)rr[x].first_bit + rr[x].no_bits > hdr->no_bits)
+			goto error_free;
+		ip->regs[x].regname = (char *)&strtab[rr[x].name];
+		ip->regs[x].type    = rr[x].type;
+		ip->regs[x].addr    = rr[x].addr;
+		(*segidx)[x] = rr[x].idx < 0xFF ? rr[x].idx : 0xFF;
+		ip->regs[x].no_bits = rr[x].no_bits;
+		ip->regs[x].bit64   = rr[x].bit64;
+		if (rr[x].no_bits)
+			ip->regs[x].bits = &ip->db_bits[rr[x].first_bit];
+	}
+	for (y = 0; y < hdr->no_bits; y++) {
+		if (rb[y].name >= hdr->strtab_size)
+			goto error_free;
+		ip->db_bits[y].regname = (char *)&strtab[rb[y].name];
+		ip->db_bits[y].start = rb[y].start;
+		ip->db_bits[y].stop = rb[y].stop;
+	}
+
+	ip->no_regs = hdr->no_regs;
+	ip->db_map = map;
+	ip->db_map_size = size;
+	return 0;
+error_free:
+	umr_huge_free(ip->regs);
+	umr_huge_free(ip->db_bits);
+	free(*segidx);
+	ip->regs = NULL;
+	ip->db_bits = NULL;
+	*segidx = NULL;
+error:
+	munmap(map, size);
+	return -1;
+#else
+	(void)regpath;
+	(void)ip;
+	(void)segidx;
+	return -1;
+#endif
+}
+
+/**
+ * umr_database_free_ipblock_bin - Free the registers of a compiled IP block
+ *
+ * Only valid for blocks populated by umr_database_read_ipblock_bin(), the
+ * IP block structure itself and its ipname are left to the caller.
+ */
+void umr_database_free_ipblock_bin(struct umr_ip_block *ip)
+{
+	umr_huge_free(ip->regs);
+	umr_huge_free(ip->db_bits);
+#if defined(__unix__)
+	munmap(ip->db_map, ip->db_map_size);
+#endif
+	ip->regs = NULL;
+	ip->db_bits = NULL;
+	ip->db_map = NULL;
+	ip->no_regs = 0;
+}
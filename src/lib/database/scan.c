@@ -24,14 +24,61 @@
 
 #include "umr.h"
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <dirent.h>
+#include <errno.h>
 
-static int umr_do_scan(struct umr_database_scan_item *it, char *path)
+#define SCAN_CACHE_MAGIC "UMRDBIDX 1"
+#define SCAN_MAX_ROOTS 4
+
+// directories visited by a scan with their modification times, adding,
+// removing or renaming a file or subdirectory changes the mtime of the
+// directory holding it
+struct scan_dirs {
+	int n, size;
+	struct {
+		char path[512];
+		int64_t sec;         // -1 if the directory does not exist
+		long nsec;
+	} *d;
+};
+
+static int add_scan_dir(struct scan_dirs *dirs, const char *path, DIR *dir)
+{
+	struct stat st;
+	void *p;
+
+	if (dirs->n == dirs->size) {
+		dirs->size = dirs->size ? dirs->size * 2 : 16;
+		p = realloc(dirs->d, dirs->size * sizeof dirs->d[0]);
+		if (!p)
+			return -1;
+		dirs->d = p;
+	}
+	snprintf(dirs->d[dirs->n].path, sizeof dirs->d[0].path, "%s", path);
+	if (dir && !fstat(dirfd(dir), &st)) {
+		dirs->d[dirs->n].sec = st.st_mtim.tv_sec;
+		dirs->d[dirs->n].nsec = st.st_mtim.tv_nsec;
+	} else {
+		dirs->d[dirs->n].sec = -1;
+		dirs->d[dirs->n].nsec = 0;
+	}
+	++dirs->n;
+	return 0;
+}
+
+static int umr_do_scan(struct umr_database_scan_item *it, char *path, struct scan_dirs *dirs)
 {
 	DIR *dir;
 	struct dirent *di;
 
 	dir = opendir(path);
+	if (dirs && add_scan_dir(dirs, path, dir)) {
+		fprintf(stderr, "[ERROR]: Out of memory\n");
+		if (dir)
+			closedir(dir);
+		return -1;
+	}
 	if (!dir)
 		return 0;
 
@@ -45,11 +92,14 @@ static int umr_do_scan(struct umr_database_scan_item *it, char *path)
 			int r;
 			char p[512];
 			sprintf(p, "%s/%s", path, di->d_name);
-			r = umr_do_scan(it, p);
+			r = umr_do_scan(it, p, dirs);
 			if (r) {
 				closedir(dir);
 				return r;
 			}
+			// the recursion appended to the list
+			while (it->next)
+				it = it->next;
 		}
 		if (strstr(di->d_name, ".reg")) { // we only care about register files
 			strcpy(it->path, path);
@@ -77,62 +127,333 @@ static int umr_do_scan(struct umr_database_scan_item *it, char *path)
 }
 
 /**
- * @brief Scans directories for register files and populates a database scan item list.
+ * scan_cache_path - Where the scan cache is kept
  *
- * This function scans specified directories for files with the ".reg" extension,
- * which are expected to contain register definitions. It starts by scanning the provided
- * path, then checks the environment variable `UMR_DATABASE_PATH`, followed by any
- * predefined directory (if defined), and finally a default source directory.
+ * UMR_DATABASE_CACHE names the file (an empty value disables the
+ * cache), otherwise it is umr/database.idx under $XDG_CACHE_HOME or
+ * ~/.cache.  Returns 0 if there is a cache file.
+ */
+static int scan_cache_path(char *buf, size_t len)
+{
+	const char *p;
+
+	p = getenv("UMR_DATABASE_CACHE");
+	if (p) {
+		if (!*p)
+			return -1;
+		snprintf(buf, len, "%s", p);
+		return 0;
+	}
+
+	p = getenv("XDG_CACHE_HOME");
+	if (p && *p) {
+		snprintf(buf, len, "%s/umr/database.idx", p);
+		return 0;
+	}
+	p = getenv("HOME");
+	if (p && *p) {
+		snprintf(buf, len, "%s/.cache/umr/database.idx", p);
+		return 0;
+	}
+	return -1;
+}
+
+// split a cache line into tab separated fields (the newline is dropped)
+static int split_fields(char *line, char **f, int max)
+{
+	int n = 0;
+
+	line[strcspn(line, "\n")] = 0;
+	while (n < max) {
+		f[n++] = line;
+		line = strchr(line, '\t');
+		if (!line)
+			break;
+		*line++ = 0;
+	}
+	return n;
+}
+
+/**
+ * read_scan_cache - Load the scan result from the cache file
  *
- * For each valid ".reg" file found, it creates an entry in a linked list of type
- * `umr_database_scan_item` containing details such as the file path, name, IP name,
- * major, minor, and revision numbers.
+ * The cache is only used if it was made for the same list of search
+ * roots and none of the directories it recorded changed since.
  *
- * @param path The initial directory path to start scanning. If NULL or empty, the function
- *             will attempt to use other sources specified by environment variables and defaults.
- * @return A pointer to the head of the linked list containing scan items, or NULL if an error occurs.
+ * Returns the list or NULL if the cache is missing or out of date.
  */
-struct umr_database_scan_item *umr_database_scan(char *path)
+static struct umr_database_scan_item *read_scan_cache(const char *cachefile, char **roots, int no_roots)
 {
-	int r;
-	struct umr_database_scan_item *it, *pit;
-	char p[512];
+	struct umr_database_scan_item *head, *it;
+	char line[1200], *f[7];
+	struct stat st;
+	int64_t sec;
+	long nsec;
+	int n, r;
+	FILE *cf;
 
-	pit = it = calloc(1, sizeof *it);
-	if (!it) {
+	cf = fopen(cachefile, "r");
+	if (!cf)
 		return NULL;
+
+	head = it = calloc(1, sizeof *it);
+	if (!head)
+		goto bad;
+	if (!fgets(line, sizeof line, cf) || strncmp(line, SCAN_CACHE_MAGIC "\n", sizeof(SCAN_CACHE_MAGIC)))
+		goto bad;
+
+	r = 0;
+	while (fgets(line, sizeof line, cf)) {
+		n = split_fields(line, f, 7);
+		if (n == 2 && !strcmp(f[0], "R")) {
+			// search roots in order
+			if (r >= no_roots || strcmp(f[1], roots[r]))
+				goto bad;
+			++r;
+		} else if (n == 4 && !strcmp(f[0], "D")) {
+			sec = strtoll(f[1], NULL, 10);
+			nsec = strtol(f[2], NULL, 10);
+			if (stat(f[3], &st) || !S_ISDIR(st.st_mode)) {
+				if (sec != -1)
+					goto bad;
+			} else if (sec != st.st_mtim.tv_sec || nsec != st.st_mtim.tv_nsec) {
+				goto bad;
+			}
+		} else if (n == 7 && !strcmp(f[0], "I")) {
+			if (strlen(f[4]) >= sizeof it->ipname || strlen(f[5]) >= sizeof it->path ||
+			    strlen(f[6]) >= sizeof it->fname)
+				goto bad;
+			it->maj = atoi(f[1]);
+			it->min = atoi(f[2]);
+			it->rev = atoi(f[3]);
+			strcpy(it->ipname, f[4]);
+			strcpy(it->path, f[5]);
+			strcpy(it->fname, f[6]);
+			it->next = calloc(1, sizeof *it);
+			if (!it->next)
+				goto bad;
+			it = it->next;
+		} else {
+			goto bad;
+		}
 	}
+	if (r != no_roots)
+		goto bad;
+	fclose(cf);
+	return head;
+bad:
+	fclose(cf);
+	umr_database_free_scan_items(head);
+	return NULL;
+}
 
-	if (path && *path) {
-		r = umr_do_scan(it, path);
-		if (r)
-			goto error;
+/**
+ * write_scan_cache - Store a scan result in the cache file
+ *
+ * The file is written under a temporary name and renamed into place so
+ * concurrent umr processes never see a partial cache.  Failing to write
+ * the cache is not an error.
+ */
+static void write_scan_cache(const char *cachefile, char **roots, int no_roots,
+			     struct scan_dirs *dirs, struct umr_database_scan_item *it)
+{
+	char tmpname[576], dirname[512], *p;
+	FILE *cf;
+	int x, fd;
+
+	// create the cache directory (and ~/.cache) if needed
+	snprintf(dirname, sizeof dirname, "%s", cachefile);
+	p = strrchr(dirname, '/');
+	if (p && p != dirname) {
+		*p = 0;
+		if (mkdir(dirname, 0755) && errno == ENOENT) {
+			p = strrchr(dirname, '/');
+			if (p && p != dirname) {
+				*p = 0;
+				mkdir(dirname, 0755);
+				*p = '/';
+				mkdir(dirname, 0755);
+			}
+		}
 	}
 
-	path = getenv("UMR_DATABASE_PATH");
-	if (path) {
-		r = umr_do_scan(it, path);
-		if (r)
-			goto error;
+	snprintf(tmpname, sizeof tmpname, "%s.XXXXXX", cachefile);
+	fd = mkstemp(tmpname);
+	if (fd < 0)
+		return;
+	cf = fdopen(fd, "w");
+	if (!cf) {
+		close(fd);
+		unlink(tmpname);
+		return;
 	}
 
+	fprintf(cf, SCAN_CACHE_MAGIC "\n");
+	for (x = 0; x < no_roots; x++)
+		fprintf(cf, "R\t%s\n", roots[x]);
+	for (x = 0; x < dirs->n; x++)
+		fprintf(cf, "D\t%"PRId64"\t%ld\t%s\n", dirs->d[x].sec, dirs->d[x].nsec, dirs->d[x].path);
+	for (; it && it->next; it = it->next)
+		fprintf(cf, "I\t%d\t%d\t%d\t%s\t%s\t%s\n", it->maj, it->min, it->rev, it->ipname, it->path, it->fname);
+
+	if (fclose(cf) || rename(tmpname, cachefile))
+		unlink(tmpname);
+}
+
+static uint32_t ipname_hash(const char *s)
+{
+	uint32_t h = 2166136261UL;
+
+	while (*s) {
+		h ^= (uint8_t)*s++;
+		h *= 16777619UL;
+	}
+	return h;
+}
+
+/**
+ * build_scan_index - Hash the scan items by IP name
+ *
+ * Each slot holds the first item of an IP name and the items of the same
+ * name are chained through next_ip in list order.  The empty item that
+ * ends the list is hashed as well so lookups match exactly what a walk
+ * over the list would.
+ */
+static int build_scan_index(struct umr_database_scan_item *head)
+{
+	struct umr_database_scan_index *idx;
+	struct umr_database_scan_item *it, **last;
+	uint32_t n, size, x;
+
+	for (n = 0, it = head; it; it = it->next)
+		++n;
+	for (size = 16; size < 2 * n; size <<= 1);
+
+	idx = calloc(1, sizeof *idx);
+	if (!idx)
+		return -1;
+	idx->first = calloc(size, sizeof idx->first[0]);
+	last = calloc(size, sizeof last[0]);
+	if (!idx->first || !last) {
+		free(idx->first);
+		free(idx);
+		free(last);
+		return -1;
+	}
+	idx->mask = size - 1;
+
+	for (it = head; it; it = it->next) {
+		for (x = ipname_hash(it->ipname) & idx->mask; idx->first[x] && strcmp(idx->first[x]->ipname, it->ipname); x = (x + 1) & idx->mask);
+		if (!idx->first[x])
+			idx->first[x] = it;
+		else
+			last[x]->next_ip = it;
+		last[x] = it;
+	}
+	free(last);
+	head->index = idx;
+	return 0;
+}
+
+/**
+ * umr_database_scan_find_ipname - Find the first scan item of an IP name
+ *
+ * @db: The list returned by umr_database_scan()
+ * @ipname: The IP name
+ *
+ * The other items of the same name follow through ->next_ip.  Returns
+ * NULL if there is no such IP or @db has no index.
+ */
+struct umr_database_scan_item *umr_database_scan_find_ipname(struct umr_database_scan_item *db, const char *ipname)
+{
+	struct umr_database_scan_index *idx = db->index;
+	uint32_t x;
+
+	if (!idx)
+		return NULL;
+	for (x = ipname_hash(ipname) & idx->mask; idx->first[x]; x = (x + 1) & idx->mask)
+		if (!strcmp(idx->first[x]->ipname, ipname))
+			return idx->first[x];
+	return NULL;
+}
+
+static struct umr_database_scan_item *database_scan(char *path)
+{
+	int r, x, no_roots;
+	struct umr_database_scan_item *it;
+	struct scan_dirs dirs;
+	char *roots[SCAN_MAX_ROOTS], p[512], cachefile[512];
+
+	no_roots = 0;
+	if (path && *path)
+		roots[no_roots++] = path;
+	path = getenv("UMR_DATABASE_PATH");
+	if (path)
+		roots[no_roots++] = path;
 #ifdef UMR_DB_DIR
-	r = umr_do_scan(it, UMR_DB_DIR);
-	if (r)
-		goto error;
+	roots[no_roots++] = UMR_DB_DIR;
 #endif
-
 	sprintf(p, "%s/database/", UMR_SOURCE_DIR);
-	r = umr_do_scan(it, p);
-	if (r)
-		goto error;
+	roots[no_roots++] = p;
+
+	r = scan_cache_path(cachefile, sizeof cachefile);
+	if (!r) {
+		it = read_scan_cache(cachefile, roots, no_roots);
+		if (it) {
+			build_scan_index(it);
+			return it;
+		}
+	}
 
+	it = calloc(1, sizeof *it);
+	if (!it) {
+		return NULL;
+	}
+
+	memset(&dirs, 0, sizeof dirs);
+	for (x = 0; x < no_roots; x++) {
+		if (umr_do_scan(it, roots[x], &dirs))
+			goto error;
+	}
+
+	if (!r)
+		write_scan_cache(cachefile, roots, no_roots, &dirs, it);
+	free(dirs.d);
+	build_scan_index(it);
 	return it;
 error:
-	while (pit) {
-		it = pit->next;
-		free(pit);
-		pit = it;
-	}
+	free(dirs.d);
+	umr_database_free_scan_items(it);
 	return NULL;
 }
+
+/**
+ * @brief Scans directories for register files and populates a database scan item list.
+ *
+ * This function scans specified directories for files with the ".reg" extension,
+ * which are expected to contain register definitions. It starts by scanning the provided
+ * path, then checks the environment variable `UMR_DATABASE_PATH`, followed by any
+ * predefined directory (if defined), and finally a default source directory.
+ *
+ * For each valid ".reg" file found, it creates an entry in a linked list of type
+ * `umr_database_scan_item` containing details such as the file path, name, IP name,
+ * major, minor, and revision numbers.
+ *
+ * The result is kept in a cache file (see scan_cache_path()) along with the
+ * modification time of every directory scanned, the next call reuses it
+ * without walking the tree if no directory changed.  The returned list is
+ * indexed by IP name for umr_database_find_ip().
+ *
+ * @param path The initial directory path to start scanning. If NULL or empty, the function
+ *             will attempt to use other sources specified by environment variables and defaults.
+ * @return A pointer to the head of the linked list containing scan items, or NULL if an error occurs.
+ */
+struct umr_database_scan_item *umr_database_scan(char *path)
+{
+	struct umr_database_scan_item *it;
+
+	umr_timing_begin(UMR_TIMING_DATABASE);
+	it = database_scan(path);
+	umr_timing_end(UMR_TIMING_DATABASE);
+	return it;
+}
@@ -1921,6 +1921,41 @@ static void umr_dump_field_info(struct umr_asic *asic, const struct umr_metrics_
 	}
 }
 
+#define METRICS_VERSION(a, b)	(((uint32_t)(a) << 16) | (b))
+
+static const struct {
+	uint32_t version;
+	const char *prefix;
+	const struct umr_metrics_field_info *info;
+	uint32_t count;
+} metrics_tables[] = {
+	{ METRICS_VERSION(1, 0), "v1_0.", metrics_v1_0, ARRAY_SIZE(metrics_v1_0) },
+	{ METRICS_VERSION(1, 1), "v1_1.", metrics_v1_1, ARRAY_SIZE(metrics_v1_1) },
+	{ METRICS_VERSION(1, 2), "v1_2.", metrics_v1_2, ARRAY_SIZE(metrics_v1_2) },
+	{ METRICS_VERSION(1, 3), "v1_3.", metrics_v1_3, ARRAY_SIZE(metrics_v1_3) },
+	{ METRICS_VERSION(1, 4), "v1_4.", metrics_v1_4, ARRAY_SIZE(metrics_v1_4) },
+	{ METRICS_VERSION(1, 5), "v1_5.", metrics_v1_5, ARRAY_SIZE(metrics_v1_5) },
+	{ METRICS_VERSION(1, 6), "v1_6.", metrics_v1_6, ARRAY_SIZE(metrics_v1_6) },
+	{ METRICS_VERSION(1, 7), "v1_7.", metrics_v1_7, ARRAY_SIZE(metrics_v1_7) },
+	{ METRICS_VERSION(2, 0), "v2_0.", metrics_v2_0, ARRAY_SIZE(metrics_v2_0) },
+	{ METRICS_VERSION(2, 1), "v2_1.", metrics_v2_1, ARRAY_SIZE(metrics_v2_1) },
+	{ METRICS_VERSION(2, 2), "v2_2.", metrics_v2_2, ARRAY_SIZE(metrics_v2_2) },
+	{ METRICS_VERSION(2, 3), "v2_3.", metrics_v2_3, ARRAY_SIZE(metrics_v2_3) },
+	{ METRICS_VERSION(2, 4), "v2_4.", metrics_v2_4, ARRAY_SIZE(metrics_v2_4) },
+	{ METRICS_VERSION(3, 0), "v3_0.", metrics_v3_0, ARRAY_SIZE(metrics_v3_0) },
+};
+
+static int find_metrics_table(struct umr_asic *asic, const struct umr_metrics_table_header *header)
+{
+	uint32_t i;
+
+	for (i = 0; i < ARRAY_SIZE(metrics_tables); i++)
+		if (metrics_tables[i].version == METRICS_VERSION(header->format_revision, header->content_revision))
+			return i;
+	asic->err_msg("[ERROR]: Unknown Metrics table format: 0x%"PRIx8"\n", header->format_revision);
+	return -1;
+}
+
 /**
  * umr_dump_metrics - Dump GPU metrics to a KV array
  *
@@ -1932,69 +1967,134 @@ static void umr_dump_field_info(struct umr_asic *asic, const struct umr_metrics_
  */
 struct umr_key_value *umr_dump_metrics(struct umr_asic *asic, const void *table, uint32_t size)
 {
-	struct umr_metrics_table_header *header =
-		(struct umr_metrics_table_header *)table;
-
 	struct umr_key_value *kv;
+	int t;
 
 	if (!table || !size)
 		return NULL;
 
+	t = find_metrics_table(asic, table);
+	if (t < 0)
+		return NULL;
+
 	kv = calloc(1, sizeof *kv);
+	if (!kv)
+		return NULL;
 
 	umr_dump_field_info(asic, metrics_header, ARRAY_SIZE(metrics_header), " hdr.", table, kv);
+	umr_dump_field_info(asic, metrics_tables[t].info, metrics_tables[t].count, metrics_tables[t].prefix, table, kv);
+	return kv;
+}
 
-#define METRICS_VERSION(a, b)	((a << 16) | b )
+static void add_layout_fields(struct umr_metrics_layout *layout, const struct umr_metrics_field_info *info,
+			      uint32_t count, const char *prefix, uint32_t size)
+{
+	uint32_t i;
 
-	switch (METRICS_VERSION(header->format_revision, header->content_revision)) {
-	case METRICS_VERSION(1, 0):
-		umr_dump_field_info(asic, metrics_v1_0, ARRAY_SIZE(metrics_v1_0), "v1_0.", table, kv);
-		break;
-	case METRICS_VERSION(1, 1):
-		umr_dump_field_info(asic, metrics_v1_1, ARRAY_SIZE(metrics_v1_1), "v1_1.", table, kv);
-		break;
-	case METRICS_VERSION(1, 2):
-		umr_dump_field_info(asic, metrics_v1_2, ARRAY_SIZE(metrics_v1_2), "v1_2.", table, kv);
-		break;
-	case METRICS_VERSION(1, 3):
-		umr_dump_field_info(asic, metrics_v1_3, ARRAY_SIZE(metrics_v1_3), "v1_3.", table, kv);
-		break;
-	case METRICS_VERSION(1, 4):
-		umr_dump_field_info(asic, metrics_v1_4, ARRAY_SIZE(metrics_v1_4), "v1_4.", table, kv);
-		break;
-	case METRICS_VERSION(1, 5):
-		umr_dump_field_info(asic, metrics_v1_5, ARRAY_SIZE(metrics_v1_5), "v1_5.", table, kv);
-		break;
-	case METRICS_VERSION(1, 6):
-		umr_dump_field_info(asic, metrics_v1_6, ARRAY_SIZE(metrics_v1_6), "v1_6.", table, kv);
-		break;
-	case METRICS_VERSION(1, 7):
-		umr_dump_field_info(asic, metrics_v1_7, ARRAY_SIZE(metrics_v1_7), "v1_7.", table, kv);
-		break;
-	case METRICS_VERSION(2, 0):
-		umr_dump_field_info(asic, metrics_v2_0, ARRAY_SIZE(metrics_v2_0), "v2_0.", table, kv);
-		break;
-	case METRICS_VERSION(2, 1):
-		umr_dump_field_info(asic, metrics_v2_1, ARRAY_SIZE(metrics_v2_1), "v2_1.", table, kv);
-		break;
-	case METRICS_VERSION(2, 2):
-		umr_dump_field_info(asic, metrics_v2_2, ARRAY_SIZE(metrics_v2_2), "v2_2.", table, kv);
-		break;
-	case METRICS_VERSION(2, 3):
-		umr_dump_field_info(asic, metrics_v2_3, ARRAY_SIZE(metrics_v2_3), "v2_3.", table, kv);
-		break;
-	case METRICS_VERSION(2, 4):
-		umr_dump_field_info(asic, metrics_v2_4, ARRAY_SIZE(metrics_v2_4), "v2_4.", table, kv);
-		break;
-	case METRICS_VERSION(3, 0):
-		umr_dump_field_info(asic, metrics_v3_0, ARRAY_SIZE(metrics_v3_0), "v3_0.", table, kv);
-		break;
-	default:
-		asic->err_msg("[ERROR]: Unknown Metrics table format: 0x%"PRIx8"\n", header->format_revision);
-		free(kv);
-		return NULL;
+	for (i = 0; i < count && layout->no_fields < UMR_MAX_KEYS; i++) {
+		// fields the table is too short for are left out
+		if (info[i].offset + info[i].size > size)
+			continue;
+		switch (info[i].size) {
+		case 1:
+		case 2:
+		case 4:
+		case 8:
+			layout->fields[layout->no_fields].prefix = prefix;
+			layout->fields[layout->no_fields].name = info[i].name;
+			layout->fields[layout->no_fields].size = info[i].size;
+			layout->fields[layout->no_fields].offset = info[i].offset;
+			++layout->no_fields;
+			break;
+		}
 	}
+}
 
-	return kv;
+/**
+ * umr_metrics_resolve_layout - Find the fields of a GPU metrics table
+ *
+ * @asic: The ASIC the table comes from
+ * @table: The contents of the GPU metrics file
+ * @size: The size of the table
+ * @layout: Where to store the offset of every field
+ *
+ * The layout is only valid for tables of the same revision and size, it
+ * lets umr_metrics_decode() read the values without looking the fields
+ * up or formatting them.
+ *
+ * Returns 0 on success, -1 if the format of the table isn't known.
+ */
+int umr_metrics_resolve_layout(struct umr_asic *asic, const void *table, uint32_t size, struct umr_metrics_layout *layout)
+{
+	const struct umr_metrics_table_header *header = table;
+	int t;
+
+	memset(layout, 0, sizeof *layout);
+	if (!table || size < sizeof *header)
+		return -1;
+
+	t = find_metrics_table(asic, header);
+	if (t < 0)
+		return -1;
+
+	layout->version = metrics_tables[t].version;
+	layout->size = size;
+	add_layout_fields(layout, metrics_header, ARRAY_SIZE(metrics_header), " hdr.", size);
+	add_layout_fields(layout, metrics_tables[t].info, metrics_tables[t].count, metrics_tables[t].prefix, size);
+	if (layout->no_fields == UMR_MAX_KEYS)
+		asic->err_msg("[WARNING]: Too many keys for gpu metrics data...\n");
+	return 0;
 }
 
+/**
+ * umr_metrics_decode - Read the values of a GPU metrics table
+ *
+ * @layout: The layout of the table from umr_metrics_resolve_layout()
+ * @table: The contents of the GPU metrics file
+ * @size: The size of the table
+ * @values: One value per field of the layout, the previous values on entry
+ * @changed: If not NULL, set to whether each value differs from the previous one
+ *
+ * Returns the number of values that changed, or -1 if the table doesn't
+ * have the revision and size the layout was resolved for.
+ */
+int umr_metrics_decode(const struct umr_metrics_layout *layout, const void *table, uint32_t size,
+		       uint64_t *values, uint8_t *changed)
+{
+	const struct umr_metrics_table_header *header = table;
+	const uint8_t *ref = table;
+	uint8_t v8;
+	uint16_t v16;
+	uint32_t v32;
+	uint64_t v;
+	int i, n;
+
+	if (!layout->version || size != layout->size ||
+	    METRICS_VERSION(header->format_revision, header->content_revision) != layout->version)
+		return -1;
+
+	for (i = n = 0; i < layout->no_fields; i++) {
+		switch (layout->fields[i].size) {
+		case 1:
+			v8 = ref[layout->fields[i].offset];
+			v = v8;
+			break;
+		case 2:
+			memcpy(&v16, ref + layout->fields[i].offset, 2);
+			v = v16;
+			break;
+		case 4:
+			memcpy(&v32, ref + layout->fields[i].offset, 4);
+			v = v32;
+			break;
+		default:
+			memcpy(&v, ref + layout->fields[i].offset, 8);
+			break;
+		}
+		if (changed)
+			changed[i] = v != values[i];
+		n += v != values[i];
+		values[i] = v;
+	}
+	return n;
+}
@@ -41,8 +41,7 @@
 static struct umr_ip_block *read_ip_block(struct umr_asic *asic, struct umr_discovery_table_entry *det, struct umr_database_scan_item *nit)
 {
 	FILE *f;
-	char ipcmn[256], fname[512], linebuf[512];
-	uint32_t no_regs, x;
+	char ipcmn[256], fname[512];
 	struct umr_ip_block *ip;
 	int vce_present;
 	struct umr_discovery_table_entry *pdet;
@@ -56,21 +55,18 @@ static struct umr_ip_block *read_ip_block(struct umr_asic *asic, struct umr_disc
 		asic->err_msg("Could not open file %s\n", fname);
 		return NULL;
 	}
+	fclose(f);
+
 	ip = calloc(1, sizeof *ip);
-	if (!ip) {
-		fclose(f);
+	if (!ip)
 		return NULL;
-	}
 
-	// the first line has the number of registers
-	if (!fgets(linebuf, sizeof(linebuf) - 1, f) || sscanf(linebuf, "%"SCNu32, &no_regs) != 1) {
-		asic->err_msg("[ERROR]: Could not read first line from the IP database file %s\n", fname);
+	// the registers are read the first time they are needed
+	if (umr_database_defer_ipblock(ip, fname, det->segments, sizeof(det->segments) / sizeof(det->segments[0]))) {
+		asic->err_msg("[ERROR]: Out of memory\n");
 		free(ip);
-		fclose(f);
 		return NULL;
 	}
-	ip->no_regs = no_regs;
-	ip->regs = calloc(no_regs, sizeof(*(ip->regs)));
 
 	// copy over the IP discovery versioning to this IP block
 	// so we can have more precise versioning info since the database
@@ -123,59 +119,6 @@ static struct umr_ip_block *read_ip_block(struct umr_asic *asic, struct umr_disc
 		ip->ipname = strdup(ipname);
 	}
 
-	// parse the IP database file for this block
-	x = 0;
-	while (fgets(linebuf, sizeof linebuf, f)) {
-		uint32_t y;
-		struct {
-			char name[128];
-			int type;
-			uint64_t addr;
-			uint32_t nobits;
-			uint32_t is64;
-			uint32_t idx;
-		} reg_fields;
-		struct {
-			char name[128];
-			int start, stop;
-		} bit_fields;
-
-		// parse the line which should return 6 fields
-		if (sscanf(linebuf, "%s %d 0x%"PRIx64" %"PRIu32" %"PRIu32" %"PRIu32,
-			reg_fields.name, &reg_fields.type, &reg_fields.addr,
-			&reg_fields.nobits, &reg_fields.is64, &reg_fields.idx) != 6) {
-				asic->err_msg("[ERROR]: Invalid regfile line [%s]\n", linebuf);
-		}
-
-		// populate this register slot for this IP block
-		ip->regs[x].regname = strdup(reg_fields.name);
-		ip->regs[x].type    = reg_fields.type;
-		ip->regs[x].addr    = reg_fields.addr;
-		// add the SOC15 segment offset for MMIO bound registers
-		if (ip->regs[x].type == REG_MMIO)
-			ip->regs[x].addr += det->segments[reg_fields.idx];
-		ip->regs[x].no_bits = reg_fields.nobits;
-		ip->regs[x].bit64   = reg_fields.is64;
-
-		// if this register has bitfields parse those as well
-		if (reg_fields.nobits) {
-			ip->regs[x].bits = calloc(reg_fields.nobits, sizeof(*(ip->regs[x].bits)));
-			for (y = 0; y < reg_fields.nobits; y++) {
-				if (fgets(linebuf, sizeof linebuf, f) == NULL || sscanf(linebuf, "\t%s %d %d", bit_fields.name, &bit_fields.start, &bit_fields.stop) != 3) {
-					asic->err_msg("[ERROR]: Could not parse bitfield line from file %s\n", fname);
-					fclose(f);
-					return ip;
-				} else {
-					ip->regs[x].bits[y].regname = strdup(bit_fields.name);
-					ip->regs[x].bits[y].start = bit_fields.start;
-					ip->regs[x].bits[y].stop = bit_fields.stop;
-					ip->regs[x].bits[y].bitfield_print = &umr_bitfield_default;
-				}
-			}
-		}
-		++x;
-	}
-	fclose(f);
 	return ip;
 }
 
@@ -187,22 +130,32 @@ static struct umr_ip_block *read_ip_block(struct umr_asic *asic, struct umr_disc
  */
 static void dump_discovery_to_log(struct umr_discovery_table_entry *det, struct umr_options *options)
 {
-	fprintf(options->test_log_fd, "DISCOVERY = { ");
-	while (det) {
-		int x;
-		for (x = 0; x < 128; x++) fprintf(options->test_log_fd, "%02" PRIx8, (unsigned)(det->ipname[x] & 0xFF));
-		fprintf(options->test_log_fd, "%02" PRIx8 "%02" PRIx8, (unsigned)(det->die >> 8), (unsigned)(det->die & 0xFF));
-		fprintf(options->test_log_fd, "%02" PRIx8 "%02" PRIx8, (unsigned)(det->instance >> 8), (unsigned)(det->instance & 0xFF));
-		fprintf(options->test_log_fd, "%02" PRIx8 "%02" PRIx8, (unsigned)(det->maj >> 8), (unsigned)(det->maj & 0xFF));
-		fprintf(options->test_log_fd, "%02" PRIx8 "%02" PRIx8, (unsigned)(det->min >> 8), (unsigned)(det->min & 0xFF));
-		fprintf(options->test_log_fd, "%02" PRIx8 "%02" PRIx8, (unsigned)(det->rev >> 8), (unsigned)(det->rev & 0xFF));
-		fprintf(options->test_log_fd, "%02" PRIx8 "%02" PRIx8, (unsigned)(det->logical_inst >> 8) & 0xFF, (unsigned)(det->logical_inst & 0xFF));
-		for (x = 0; x < 32; x++) {
-			fprintf(options->test_log_fd, "%016" PRIx64, det->segments[x]);
-		}
-		det = det->next;
+	struct umr_discovery_table_entry *d;
+	uint8_t *buf, *p;
+	int n, x, y;
+
+	for (n = 0, d = det; d; d = d->next)
+		++n;
+	p = buf = calloc(n ? n : 1, DET_REC_SIZE);
+	if (!buf)
+		return;
+
+	// 16 and 64-bit fields are stored big endian
+	for (d = det; d; d = d->next) {
+		for (x = 0; x < 128; x++)
+			*p++ = d->ipname[x];
+		*p++ = d->die >> 8;		*p++ = d->die;
+		*p++ = d->instance >> 8;	*p++ = d->instance;
+		*p++ = d->maj >> 8;		*p++ = d->maj;
+		*p++ = d->min >> 8;		*p++ = d->min;
+		*p++ = d->rev >> 8;		*p++ = d->rev;
+		*p++ = d->logical_inst >> 8;	*p++ = d->logical_inst;
+		for (x = 0; x < 32; x++)
+			for (y = 56; y >= 0; y -= 8)
+				*p++ = d->segments[x] >> y;
 	}
-	fprintf(options->test_log_fd, "}\n");
+	umr_test_log_bytes(options, UMR_TV_DISCOVERY, 0, buf, p - buf);
+	free(buf);
 }
 
 /**
@@ -61,6 +61,7 @@ struct umr_asic *umr_discover_asic_by_name(struct umr_options *options, char *na
 
 	if (asic) {
 		asic->did = 0;
+		asic->fd.gfxoff = -1; // opened by umr_discover_asic() for a real device
 		if (options->instance == -1) {
 			// try and discover an instance that works
 			struct umr_options tmp_opt;
@@ -24,6 +24,141 @@
  */
 #include "umr.h"
 
+static const char *ip_names[UMR_IP_MAX] = {
+	[UMR_IP_GFX] = "gfx",
+	[UMR_IP_SDMA] = "sdma",
+	[UMR_IP_VCN] = "vcn",
+	[UMR_IP_MMHUB] = "mmhub",
+	[UMR_IP_OSS] = "oss",
+	[UMR_IP_OSSSYS] = "osssys",
+};
+
+/*
+ * The index is inside the asic and only depends on asic->blocks, so it is
+ * (re)built on use when the blocks changed.  Every thread builds the same
+ * contents.
+ */
+static const struct umr_ip_index *ip_index(const struct umr_asic *asic)
+{
+	struct umr_ip_index *idx = (struct umr_ip_index *)&asic->ip_index;
+	struct umr_ip_block *ip;
+	size_t len;
+	int x, k;
+
+	if (idx->built_for == asic->blocks && idx->built_no_blocks == asic->no_blocks)
+		return idx;
+
+	memset(idx, 0, sizeof *idx);
+	for (k = 0; k < UMR_IP_MAX; k++) {
+		len = strlen(ip_names[k]);
+		for (x = 0; x < asic->no_blocks; x++) {
+			ip = asic->blocks[x];
+			if (!memcmp(ip->ipname, ip_names[k], len)) {
+				if (!idx->first[k])
+					idx->first[k] = ip;
+				if (ip->discoverable.logical_inst >= 0 &&
+				    ip->discoverable.logical_inst < UMR_IP_INDEX_INSTANCES &&
+				    !idx->inst[k][ip->discoverable.logical_inst])
+					idx->inst[k][ip->discoverable.logical_inst] = ip;
+			}
+			if (!idx->contains[k] && strstr(ip->ipname, ip_names[k]))
+				idx->contains[k] = ip;
+		}
+	}
+	idx->built_for = asic->blocks;
+	idx->built_no_blocks = asic->no_blocks;
+	return idx;
+}
+
+/**
+ * umr_ip_block_by_kind - Find a well known IP block
+ *
+ * @asic: The ASIC to search for the IP block
+ * @ip: Which IP
+ * @instance: The logical instance to match (or <0 for don't care)
+ *
+ * Same as umr_find_ip_block() with the name of @ip without the scan.
+ *
+ * Returns NULL if not found.
+ */
+struct umr_ip_block *umr_ip_block_by_kind(const struct umr_asic *asic, enum umr_ip_kind ip, int instance)
+{
+	const struct umr_ip_index *idx;
+	int x;
+
+	if (ip < 0 || ip >= UMR_IP_MAX)
+		return NULL;
+	idx = ip_index(asic);
+	if (instance < 0)
+		return idx->first[ip];
+	if (instance < UMR_IP_INDEX_INSTANCES)
+		return idx->inst[ip][instance];
+
+	for (x = 0; x < asic->no_blocks; x++)
+		if (!memcmp(asic->blocks[x]->ipname, ip_names[ip], strlen(ip_names[ip])) &&
+		    asic->blocks[x]->discoverable.logical_inst == instance)
+			return asic->blocks[x];
+	return NULL;
+}
+
+/**
+ * umr_ip_version_by_kind - The discoverable version of a well known IP block
+ *
+ * @asic: The ASIC to search for the IP block
+ * @ip: Which IP
+ * @instance: The logical instance to match (or <0 for don't care)
+ * @maj, @min, @rev: Optionally retrieve the version (if not NULL)
+ *
+ * Returns 0 if the block was found, -1 if not.
+ */
+int umr_ip_version_by_kind(const struct umr_asic *asic, enum umr_ip_kind ip, int instance, int *maj, int *min, int *rev)
+{
+	struct umr_ip_block *b = umr_ip_block_by_kind(asic, ip, instance);
+
+	if (!b)
+		return -1;
+	if (maj)
+		*maj = b->discoverable.maj;
+	if (min)
+		*min = b->discoverable.min;
+	if (rev)
+		*rev = b->discoverable.rev;
+	return 0;
+}
+
+/*
+ * umr_ip_kind_of - The umr_ip_kind named exactly @ipname, -1 if none
+ */
+static int umr_ip_kind_of(const char *ipname)
+{
+	int k;
+
+	for (k = 0; k < UMR_IP_MAX; k++)
+		if (!strcmp(ipname, ip_names[k]))
+			return k;
+	return -1;
+}
+
+/**
+ * umr_ip_block_containing - The first block whose name contains @ipname
+ *
+ * Used by umr_get_ip_revision(), well known names are looked up in the
+ * index.
+ */
+struct umr_ip_block *umr_ip_block_containing(const struct umr_asic *asic, const char *ipname)
+{
+	int x, k;
+
+	k = umr_ip_kind_of(ipname);
+	if (k >= 0)
+		return ip_index(asic)->contains[k];
+	for (x = 0; x < asic->no_blocks; x++)
+		if (strstr(asic->blocks[x]->ipname, ipname))
+			return asic->blocks[x];
+	return NULL;
+}
+
+
 /**
  * umr_find_ip_block - Find an IP block given a name and optional instance
  *
@@ -35,7 +170,11 @@
  */
 struct umr_ip_block *umr_find_ip_block(const struct umr_asic *asic, const char *ipname, int instance)
 {
-	int x;
+	int x, k;
+
+	k = umr_ip_kind_of(ipname);
+	if (k >= 0)
+		return umr_ip_block_by_kind(asic, k, instance);
 
 	for (x = 0; x < asic->no_blocks; x++) {
 		if (!memcmp(asic->blocks[x]->ipname, ipname, strlen(ipname))) {
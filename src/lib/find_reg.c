@@ -77,6 +77,171 @@ static int expression_matches(const char* str, const char* pattern)
 	return !*pattern;
 }
 
+#define TRIGRAM_BITS 6
+#define TRIGRAM_KEYS (1UL << (3 * TRIGRAM_BITS))
+
+// trigram index over every register name (in block order) used to narrow
+// down the candidates of a wildcard search
+struct umr_reg_search_index {
+	uint32_t *block_start;  // global number of the first register of each block
+	uint32_t *start, *end;  // range of postings for each trigram key
+	uint32_t *postings;     // ascending global register numbers
+	int users;              // iterators walking this index
+	int stale;              // replaced, free once the last user is done
+};
+
+static uint32_t trigram_sym(char c)
+{
+	c = toupper((unsigned char)c);
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'A' && c <= 'Z')
+		return 10 + c - 'A';
+	if (c == '_')
+		return 36;
+	return 63;
+}
+
+static uint32_t trigram_key(const char *s)
+{
+	return (trigram_sym(s[0]) << (2 * TRIGRAM_BITS)) | (trigram_sym(s[1]) << TRIGRAM_BITS) | trigram_sym(s[2]);
+}
+
+static void free_search_index(struct umr_reg_search_index *idx)
+{
+	if (idx) {
+		free(idx->block_start);
+		free(idx->start);
+		free(idx->end);
+		free(idx->postings);
+		free(idx);
+	}
+}
+
+/**
+ * umr_free_reg_search_index - Free the wildcard search index of an asic
+ *
+ * An index that wildcard iterators are still walking is only detached,
+ * the last iterator frees it.  It stays valid for them since registers
+ * loaded afterwards were not numbered by it.
+ */
+void umr_free_reg_search_index(struct umr_asic *asic)
+{
+	if (asic->reg_search && asic->reg_search->users)
+		asic->reg_search->stale = 1;
+	else
+		free_search_index(asic->reg_search);
+	asic->reg_search = NULL;
+}
+
+static void free_iter(struct umr_find_reg_iter *iter)
+{
+	if (iter->idx && !--iter->idx->users && iter->idx->stale)
+		free_search_index(iter->idx);
+	free(iter->ip);
+	free(iter->reg);
+	free(iter);
+}
+
+/**
+ * create_reg_search_index - Build the trigram index for wildcard searches
+ *
+ * Every register gets a global number in block order.  For each trigram
+ * of a register name (case insensitive) the number is appended to the
+ * posting list of that trigram so each list is sorted.
+ */
+static struct umr_reg_search_index *create_reg_search_index(struct umr_asic *asic)
+{
+	struct umr_reg_search_index *idx;
+	uint32_t g, key, total;
+	size_t len, x;
+	const char *name;
+	int i, j;
+
+	idx = calloc(1, sizeof *idx);
+	if (!idx)
+		goto oom;
+	idx->block_start = calloc(asic->no_blocks + 1, sizeof idx->block_start[0]);
+	idx->start = calloc(TRIGRAM_KEYS, sizeof idx->start[0]);
+	idx->end = calloc(TRIGRAM_KEYS, sizeof idx->end[0]);
+	if (!idx->block_start || !idx->start || !idx->end)
+		goto oom;
+
+	// count (an upper bound of) the postings per trigram
+	for (g = i = 0; i < asic->no_blocks; i++) {
+		idx->block_start[i] = g;
+		for (j = 0; j < asic->blocks[i]->no_regs; j++, g++) {
+			name = asic->blocks[i]->regs[j].regname;
+			len = strlen(name);
+			for (x = 0; x + 3 <= len; x++)
+				++idx->end[trigram_key(name + x)];
+		}
+	}
+	idx->block_start[i] = g;
+
+	for (total = key = 0; key < TRIGRAM_KEYS; key++) {
+		idx->start[key] = total;
+		total += idx->end[key];
+		idx->end[key] = idx->start[key];
+	}
+
+	idx->postings = calloc(total ? total : 1, sizeof idx->postings[0]);
+	if (!idx->postings)
+		goto oom;
+
+	// fill, a trigram that appears twice in one name is only added once
+	for (g = i = 0; i < asic->no_blocks; i++) {
+		for (j = 0; j < asic->blocks[i]->no_regs; j++, g++) {
+			name = asic->blocks[i]->regs[j].regname;
+			len = strlen(name);
+			for (x = 0; x + 3 <= len; x++) {
+				key = trigram_key(name + x);
+				if (idx->end[key] > idx->start[key] && idx->postings[idx->end[key] - 1] == g)
+					continue;
+				idx->postings[idx->end[key]++] = g;
+			}
+		}
+	}
+	return idx;
+oom:
+	asic->err_msg("[ERROR]: Out of memory\n");
+	free_search_index(idx);
+	return NULL;
+}
+
+/**
+ * pick_candidates - Find the smallest posting list for a pattern
+ *
+ * Every literal run of at least three characters in @pattern (runs are
+ * split by '*' and '?') must appear in a matching name, so any of their
+ * trigrams narrows the search.  Returns 0 if the pattern has no usable
+ * trigram.
+ */
+static int pick_candidates(struct umr_reg_search_index *idx, const char *pattern, const uint32_t **cand, uint32_t *no_cand)
+{
+	const char *run;
+	uint32_t key, n;
+	size_t len, x;
+	int found = 0;
+
+	while (*pattern) {
+		for (run = pattern; *pattern && *pattern != '*' && *pattern != '?'; pattern++);
+		len = pattern - run;
+		for (x = 0; x + 3 <= len; x++) {
+			key = trigram_key(run + x);
+			n = idx->end[key] - idx->start[key];
+			if (!found || n < *no_cand) {
+				*cand = &idx->postings[idx->start[key]];
+				*no_cand = n;
+				found = 1;
+			}
+		}
+		if (*pattern)
+			++pattern;
+	}
+	return found;
+}
+
 /**
  * umr_find_reg_wild_first - Initiate a wildcard iterative search
  *
@@ -101,9 +266,68 @@ struct umr_find_reg_iter* umr_find_reg_wild_first(struct umr_asic* asic, const c
 
 	iter->ip_i = -1;
 	iter->reg_i = -1;
+
+	// only the blocks the search can match need their registers
+	if (!asic->all_regs_loaded) {
+		int i;
+
+		if (ip) {
+			for (i = 0; i < asic->no_blocks; i++)
+				if (asic->blocks[i]->source && expression_matches(asic->blocks[i]->ipname, ip))
+					umr_load_ip_block(asic, asic->blocks[i]);
+		} else {
+			umr_load_ip_blocks(asic, NULL);
+		}
+	}
+
+	if (!asic->reg_search)
+		asic->reg_search = create_reg_search_index(asic);
+	if (asic->reg_search) {
+		iter->use_index = pick_candidates(asic->reg_search, iter->reg, &iter->cand, &iter->no_cand);
+		if (iter->use_index) {
+			iter->idx = asic->reg_search;
+			++iter->idx->users;
+		}
+	}
 	return iter;
 }
 
+// walk the candidates from the trigram index (in block order)
+static struct umr_find_reg_iter_result wild_next_indexed(struct umr_find_reg_iter **iterp)
+{
+	struct umr_find_reg_iter_result res;
+	struct umr_find_reg_iter *iter = *iterp;
+	struct umr_reg_search_index *idx = iter->idx;
+	uint32_t g;
+
+	while (iter->cand_i < iter->no_cand) {
+		g = iter->cand[iter->cand_i++];
+
+		// candidates are ascending so the block only ever moves forward
+		if (iter->ip_i < 0 || g >= idx->block_start[iter->ip_i + 1]) {
+			do {
+				++(iter->ip_i);
+			} while (g >= idx->block_start[iter->ip_i + 1]);
+			iter->ip_ok = !iter->ip || expression_matches(iter->asic->blocks[iter->ip_i]->ipname, iter->ip);
+		}
+		if (!iter->ip_ok)
+			continue;
+
+		iter->reg_i = g - idx->block_start[iter->ip_i];
+		if (expression_matches(iter->asic->blocks[iter->ip_i]->regs[iter->reg_i].regname, iter->reg)) {
+			res.reg = &iter->asic->blocks[iter->ip_i]->regs[iter->reg_i];
+			res.ip = iter->asic->blocks[iter->ip_i];
+			return res;
+		}
+	}
+
+	free_iter(iter);
+	res.ip = NULL;
+	res.reg = NULL;
+	*iterp = NULL;
+	return res;
+}
+
 /**
  * umr_find_reg_wild_next - Iterate an existing register search
  *
@@ -115,6 +339,10 @@ struct umr_find_reg_iter_result umr_find_reg_wild_next(struct umr_find_reg_iter
 {
 	struct umr_find_reg_iter_result res;
 	struct umr_find_reg_iter *iter = *iterp;
+
+	if (iter->use_index)
+		return wild_next_indexed(iterp);
+
 	for (;;) {
 		// if reg_i == -1 find the next IP block
 		if (iter->reg_i == -1) {
@@ -126,9 +354,7 @@ struct umr_find_reg_iter_result umr_find_reg_wild_next(struct umr_find_reg_iter
 
 			// no more blocks
 			if (iter->ip_i >= iter->asic->no_blocks) {
-				free(iter->ip);
-				free(iter->reg);
-				free(iter);
+				free_iter(iter);
 				res.ip = NULL;
 				res.reg = NULL;
 				*iterp = NULL;
@@ -191,11 +417,79 @@ struct umr_reg* umr_find_reg_data_by_ip_by_instance(struct umr_asic* asic, const
 	return umr_find_reg_data_by_ip_by_instance_with_ip(asic, ip, inst, regname, NULL);
 }
 
+// does an IP block pass the ip/instance filter of a by-name lookup?
+static int ip_block_matches(struct umr_ip_block *block, const char *ip, int inst, const char *instname)
+{
+	// optionally require the ip block name to partially match (allows for ignoring version numbers)
+	if (ip && (strlen(block->ipname) >= strlen(ip) && memcmp(block->ipname, ip, strlen(ip))))
+		return 0;
+
+	// if we are looking for an instance require the {inst} as well
+	if (inst >= 0 && !strstr(block->ipname, instname))
+		return 0;
+
+	// if we are not looking for an instance skip over IP blocks with an instance
+	// this is mostly to catch UMR bugs that don't forward say
+	// --vm-partition to a register function on partitioned hosts
+	if (inst < 0 && inst != -2 && strstr(block->ipname, "{"))
+		return 0;
+
+	return 1;
+}
+
+// look a register up in the name index, entries sharing a name sit along the
+// same probe chain, the match in the lowest numbered IP block is returned so
+// the result is the same one a linear scan would find no matter what order
+// the blocks were indexed in
+static struct umr_reg *find_reg_in_index(struct umr_asic *asic, const char *ip, int inst, const char *instname, const char *regname, uint32_t *blk)
+{
+	struct umr_reg_name_index *e, *best = NULL;
+	uint32_t h, x;
+
+	h = umr_reg_name_hash(regname);
+	for (x = h & asic->reg_index_mask; asic->reg_index[x].reg; x = (x + 1) & asic->reg_index_mask) {
+		e = &asic->reg_index[x];
+		if (e->hash == h && (!best || e->ip < best->ip) && !istr_cmp(e->reg->regname, regname) &&
+		    ip_block_matches(asic->blocks[e->ip], ip, inst, instname))
+			best = e;
+	}
+	if (!best)
+		return NULL;
+	*blk = best->ip;
+	return best->reg;
+}
+
+// binary search the (sorted) registers of a block
+static struct umr_reg *find_reg_in_block(struct umr_ip_block *block, const char *regname)
+{
+	int bot, top, mid, diff;
+
+	bot = 0;
+	top = block->no_regs;
+	while (bot < top) {
+		mid = (bot + top) >> 1;
+		diff = istr_cmp(block->regs[mid].regname, regname);
+		if (diff < 0) {
+			// needle is above mid
+			bot = mid + 1;
+		} else {
+			// needle is below or equal to mid
+			top = mid;
+		}
+	}
+	if (bot < block->no_regs && !istr_cmp(block->regs[bot].regname, regname))
+		return &block->regs[bot];
+	return NULL;
+}
+
 /**
  * @brief Finds register data by IP, instance, and register name.
  *
  * This function searches for a specific register within an IP block of a given ASIC instance.
  * It uses the IP address, instance number, and register name to locate the corresponding register data.
+ * A name starting with 'mm' also matches the 'reg' spelling used by newer databases, the
+ * first IP block with either spelling wins.  IP blocks that have not been loaded yet are
+ * loaded in order until one holds the register.
  *
  * @param asic Pointer to the ASIC structure containing the IP blocks.
  * @param ip The IP address (as a string) of the IP block to search within.
@@ -209,7 +503,9 @@ struct umr_reg* umr_find_reg_data_by_ip_by_instance_with_ip(struct umr_asic* asi
 {
 	int i, k;
 	char origname[96], tmpregname[100], instname[16];
-	const char *oregname = regname;
+	const char *altname;
+	struct umr_reg *reg, *alt;
+	uint32_t blk, altblk;
 
 	strcpy(origname, regname);
 
@@ -227,61 +523,65 @@ struct umr_reg* umr_find_reg_data_by_ip_by_instance_with_ip(struct umr_asic* asi
 	if (k)
 		++regname;
 
-	oregname = regname;
-retry:
-	for (i = 0; i < asic->no_blocks; i++) {
-		// optionally require the ip block name to partially match (allows for ignoring version numbers)
-		if (ip && (strlen(asic->blocks[i]->ipname) >= strlen(ip) && memcmp(asic->blocks[i]->ipname, ip, strlen(ip))))
-			continue;
+	// if regname starts with 'mm' also search for the variant with 'reg' prefix
+	// this avoids having to recode a lot of logic.
+	altname = NULL;
+	if (!memcmp(regname, "mm", 2)) {
+		memcpy(tmpregname, "reg", 4);
+		strncpy(tmpregname + 3, regname + 2, sizeof(tmpregname) - 4);
+		tmpregname[sizeof(tmpregname) - 1] = 0;
+		altname = tmpregname;
+	}
 
-		// if we are looking for an instance require the {inst} as well
-		if (inst >= 0 && !strstr(asic->blocks[i]->ipname, instname))
-			continue;
+	// load blocks in order until one has the register, the earlier blocks
+	// cannot hold it so the first match is the same as if every block had
+	// been loaded up front
+	if (!asic->all_regs_loaded) {
+		for (i = 0; i < asic->no_blocks; i++) {
+			if (!ip_block_matches(asic->blocks[i], ip, inst, instname))
+				continue;
+			if (asic->blocks[i]->source)
+				umr_load_ip_block(asic, asic->blocks[i]);
+			if (find_reg_in_block(asic->blocks[i], regname) ||
+			    (altname && find_reg_in_block(asic->blocks[i], altname)))
+				break;
+		}
+	}
 
-		// if we are not looking for an instance skip over IP blocks with an instance
-		// this is mostly to catch UMR bugs that don't forward say
-		// --vm-partition to a register function on partitioned hosts
-		if (inst < 0 && inst != -2 && strstr(asic->blocks[i]->ipname, "{"))
-			continue;
-		{
-			int bot, top, mid, diff;
-			bot = 0;
-			top = asic->blocks[i]->no_regs;
-			while (bot < top) {
-				mid = (bot + top) >> 1;
-				diff = istr_cmp(asic->blocks[i]->regs[mid].regname, regname);
-				if (diff < 0) {
-					// needle is above mid
-					bot = mid + 1;
-				} else {
-					// needle is below or equal to mid
-					top = mid;
-				}
-			}
-			if (bot < asic->blocks[i]->no_regs && !istr_cmp(asic->blocks[i]->regs[bot].regname, regname)) {
+	if (asic->reg_index) {
+		reg = find_reg_in_index(asic, ip, inst, instname, regname, &blk);
+		alt = altname ? find_reg_in_index(asic, ip, inst, instname, altname, &altblk) : NULL;
+		if (alt && (!reg || altblk < blk)) {
+			reg = alt;
+			blk = altblk;
+		}
+		if (reg) {
+			if (ipp)
+				*ipp = asic->blocks[blk];
+			return reg;
+		}
+	} else {
+		for (i = 0; i < asic->no_blocks; i++) {
+			if (!ip_block_matches(asic->blocks[i], ip, inst, instname))
+				continue;
+			reg = find_reg_in_block(asic->blocks[i], regname);
+			if (!reg && altname)
+				reg = find_reg_in_block(asic->blocks[i], altname);
+			if (reg) {
 				if (ipp)
 					*ipp = asic->blocks[i];
-				return &asic->blocks[i]->regs[bot];
+				return reg;
 			}
 		}
 	}
 
-	// if regname starts with 'mm' search for variant with 'reg' prefix
-	// this avoids having to recode a lot of logic.
-	if (!memcmp(regname, "mm", 2)) {
-		memcpy(tmpregname, "reg", 4);
-		strncpy(tmpregname + 3, regname + 2, sizeof(tmpregname) - 4);
-		regname = (const char *)tmpregname;
-		goto retry;
-	}
-
 	if (!k) {
 		if (!asic->options.trap_unsorted_db) {
 			asic->options.trap_unsorted_db = 1;
 			for (i = 0; i < asic->no_blocks; i++) {
 				for (k = 0; k < asic->blocks[i]->no_regs; k++) {
 					if (!strcmp(asic->blocks[i]->regs[k].regname, regname) ||
-					    !strcmp(asic->blocks[i]->regs[k].regname, origname)) {
+					    (altname && !strcmp(asic->blocks[i]->regs[k].regname, altname))) {
 						    asic->err_msg("[ERROR]: Register <%s> found in an **UNSORTED** database\n", origname);
 						    asic->err_msg("[ERROR]: Your UMR database is not sorted, please check /usr/share/umr or /usr/local/share/umr for outdated contents.\n");
 						    asic->err_msg("[ERROR]: UMR will not function correctly with outdated databases\n");
@@ -290,7 +590,7 @@ retry:
 				}
 			}
 		}
-		asic->err_msg("[BUG]: reg [%s](%d) not found on asic [%s]\n", oregname, inst, asic->asicname);
+		asic->err_msg("[BUG]: reg [%s](%d) not found on asic [%s]\n", regname, inst, asic->asicname);
 	}
 	return NULL;
 }
@@ -311,21 +611,32 @@ uint32_t umr_find_reg(struct umr_asic* asic, const char* regname)
 }
 
 /**
- * umr_find_reg_by_addr - Find a register by addressable offset
+ * umr_find_mmio_accel - Find the MMIO accel entry for an address
  *
- * Returns the umr_reg structure (if found) for a register at a
- * given address.  If @ip is not NULL it will also store the IP block
- * pointer for the register as well.
+ * @asic: The device the register belongs to
+ * @addr: The DWORD address of the register
+ *
+ * Returns the first entry (in database order) of the MMIO accel table
+ * for @addr, or NULL if no register is at that address or the table was
+ * not created.  Any address can belong to any block so IP blocks that
+ * have not been loaded yet are all loaded.
  */
-struct umr_reg* umr_find_reg_by_addr(struct umr_asic* asic, uint64_t addr, struct umr_ip_block** ip)
+struct umr_mmio_accel_data *umr_find_mmio_accel(struct umr_asic *asic, uint64_t addr)
 {
-	int i, j;
+	uint32_t x, bot, mid, top;
 
-	if (ip)
-		*ip = NULL;
+	if (!asic->all_regs_loaded)
+		umr_load_ip_blocks(asic, NULL);
+
+	if (asic->mmio_pages) {
+		if ((addr >> UMR_MMIO_PAGE_SHIFT) < asic->mmio_no_pages &&
+		    asic->mmio_pages[addr >> UMR_MMIO_PAGE_SHIFT] &&
+		    (x = asic->mmio_pages[addr >> UMR_MMIO_PAGE_SHIFT][addr & (UMR_MMIO_PAGE_SIZE - 1)]))
+			return &asic->mmio_accel[x - 1];
+		return NULL;
+	}
 
 	if (asic->mmio_accel) {
-		uint32_t bot, mid, top;
 		bot = 0;
 		top = asic->mmio_accel_size;
 
@@ -337,10 +648,36 @@ struct umr_reg* umr_find_reg_by_addr(struct umr_asic* asic, uint64_t addr, struc
 				top = mid;
 			}
 		}
-		if (bot < asic->mmio_accel_size && asic->mmio_accel[bot].mmio_addr == addr) {
+		if (bot < asic->mmio_accel_size && asic->mmio_accel[bot].mmio_addr == addr)
+			return &asic->mmio_accel[bot];
+	}
+	return NULL;
+}
+
+/**
+ * umr_find_reg_by_addr - Find a register by addressable offset
+ *
+ * Returns the umr_reg structure (if found) for a register at a
+ * given address.  If @ip is not NULL it will also store the IP block
+ * pointer for the register as well.
+ */
+struct umr_reg* umr_find_reg_by_addr(struct umr_asic* asic, uint64_t addr, struct umr_ip_block** ip)
+{
+	struct umr_mmio_accel_data *acc;
+	int i, j;
+
+	if (ip)
+		*ip = NULL;
+
+	if (!asic->all_regs_loaded)
+		umr_load_ip_blocks(asic, NULL);
+
+	if (asic->mmio_accel) {
+		acc = umr_find_mmio_accel(asic, addr);
+		if (acc) {
 			if (ip)
-				*ip = asic->mmio_accel[bot].ip;
-			return asic->mmio_accel[bot].reg;
+				*ip = acc->ip;
+			return acc->reg;
 		}
 		return NULL;
 	}
@@ -356,22 +693,39 @@ struct umr_reg* umr_find_reg_by_addr(struct umr_asic* asic, uint64_t addr, struc
 }
 
 /**
- * umr_reg_name - Construct a human readable name for a register
+ * umr_reg_name_r - Construct a human readable name for a register
  *
- * Returns a human readable name including IP and register name
- * to the caller based on the address specified.
+ * @asic: The device the register belongs to
+ * @addr: The DWORD address of the register
+ * @buf: Where to store the name
+ * @len: Size of @buf
+ *
+ * Thread-safe version of umr_reg_name().  Returns @buf or the constant
+ * string "<unknown>" if no register is at @addr.
  */
-char* umr_reg_name(struct umr_asic* asic, uint64_t addr)
+char *umr_reg_name_r(struct umr_asic *asic, uint64_t addr, char *buf, size_t len)
 {
 	struct umr_reg* reg;
 	struct umr_ip_block* ip;
-	static char name[512];
 
 	reg = umr_find_reg_by_addr(asic, addr, &ip);
 	if (ip && reg) {
-		sprintf(name, "%s%s.%s%s", RED, ip->ipname, reg->regname, RST);
-		return name;
+		snprintf(buf, len, "%s%s.%s%s", RED, ip->ipname, reg->regname, RST);
+		return buf;
 	} else {
 		return "<unknown>";
 	}
 }
+
+/**
+ * umr_reg_name - Construct a human readable name for a register
+ *
+ * Returns a human readable name including IP and register name
+ * to the caller based on the address specified.  The name is stored
+ * in a static buffer, use umr_reg_name_r() from threaded code.
+ */
+char* umr_reg_name(struct umr_asic* asic, uint64_t addr)
+{
+	static char name[512];
+	return umr_reg_name_r(asic, addr, name, sizeof name);
+}
@@ -31,7 +31,17 @@ void umr_free_asic_blocks(struct umr_asic *asic)
 {
 	int x, y, z;
 	for (x = 0; x < asic->no_blocks; x++) {
-		if (asic->blocks[x]) {
+		if (asic->blocks[x] && asic->blocks[x]->reg_table) {
+			umr_database_free_ipblock_regs(asic->blocks[x]);
+			free(asic->blocks[x]->ipname);
+		} else if (asic->blocks[x] && asic->blocks[x]->db_map) {
+			umr_database_free_ipblock_bin(asic->blocks[x]);
+			free(asic->blocks[x]->ipname);
+		} else if (asic->blocks[x] && asic->blocks[x]->name_pool) {
+			umr_name_pool_free(asic->blocks[x]->name_pool);
+			free(asic->blocks[x]->ipname);
+			umr_huge_free(asic->blocks[x]->regs);
+		} else if (asic->blocks[x]) {
 			for (y = 0; y < asic->blocks[x]->no_regs; y++) {
 				free(asic->blocks[x]->regs[y].regname);
 				for (z = 0; z < asic->blocks[x]->regs[y].no_bits; z++) {
@@ -40,12 +50,24 @@ void umr_free_asic_blocks(struct umr_asic *asic)
 				free(asic->blocks[x]->regs[y].bits);
 			}
 			free(asic->blocks[x]->ipname);
-			free(asic->blocks[x]->regs);
+			umr_huge_free(asic->blocks[x]->regs);
 		}
+		if (asic->blocks[x])
+			umr_database_free_ipblock_source(asic->blocks[x]->source);
 		free(asic->blocks[x]);
 	}
 	free(asic->blocks);
 	free(asic->mmio_accel);
+	for (x = 0; x < (int)asic->mmio_no_pages; x++)
+		umr_huge_free(asic->mmio_pages[x]);
+	free(asic->mmio_pages);
+	umr_huge_free(asic->reg_index);
+	umr_wave_data_free_field_cache(asic);
+	umr_free_reg_search_index(asic);
+	umr_free_core_regs(asic);
+	umr_free_config_dirs(asic);
+	umr_vm_tlb_flush(asic);
+	umr_free_vm_reg_cache(asic);
 	free(asic->asicname);
 	free(asic);
 }
@@ -39,9 +39,9 @@ int umr_gfx_get_ip_ver(struct umr_asic *asic, int *maj, int *min)
 	struct umr_ip_block *ip;
 
 	// try by GC version
-	ip = umr_find_ip_block(asic, "gfx", 0); // for multi instance
+	ip = umr_ip_block_by_kind(asic, UMR_IP_GFX, 0); // for multi instance
 	if (!ip)
-		ip = umr_find_ip_block(asic, "gfx", -1); // for single instance
+		ip = umr_ip_block_by_kind(asic, UMR_IP_GFX, -1); // for single instance
 
 	if (ip) {
 		*maj = ip->discoverable.maj;
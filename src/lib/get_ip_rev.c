@@ -38,21 +38,18 @@
  */
 int umr_get_ip_revision(struct umr_asic *asic, const char *ipname, int *maj, int *min, int *rev)
 {
-	int x;
+	struct umr_ip_block *ip = umr_ip_block_containing(asic, ipname);
 
-	for (x = 0; x < asic->no_blocks; x++) {
-		if (strstr(asic->blocks[x]->ipname, ipname)) {
-			if (maj) {
-				*maj = asic->blocks[x]->discoverable.maj;
-			}
-			if (min) {
-				*min = asic->blocks[x]->discoverable.min;
-			}
-			if (rev) {
-				*rev = asic->blocks[x]->discoverable.rev;
-			}
-			return 0;
-		}
+	if (!ip)
+		return -1;
+	if (maj) {
+		*maj = ip->discoverable.maj;
 	}
-	return -1;
+	if (min) {
+		*min = ip->discoverable.min;
+	}
+	if (rev) {
+		*rev = ip->discoverable.rev;
+	}
+	return 0;
 }
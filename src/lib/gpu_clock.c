@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+#include <time.h>
+
+/*
+ * GPU timestamps on the host clock.  A sample stamped with the host time
+ * after a series of register reads is off by however long those reads
+ * took, which differs from device to device.  Reading the free running
+ * counter of the GPU with the sample and mapping it onto the host clock
+ * lines up samples of several devices on the same time base.
+ *
+ * The counter is the SMUIO golden TSC where the device has one (it keeps
+ * counting through GFXOFF), otherwise the RLC reference clock timestamp.
+ * The map is a line through the latest calibration point with the slope
+ * measured from the first one, against CLOCK_MONOTONIC_RAW which is not
+ * slewed by NTP.  Each calibration point is the tightest of a few reads
+ * bracketed by host clock reads, so calling umr_gpu_clock_calibrate()
+ * now and then follows the drift of the GPU clock ever more precisely.
+ */
+
+#define GPU_CLOCK_TRIES		8	// reads per calibration point, the tightest is kept
+#define GPU_CLOCK_SETTLE_NS	5000000	// between the first two points
+
+static const char *gpu_clock_regs[][2] = {
+	{ "mmGOLDEN_TSC_COUNT_LOWER", "mmGOLDEN_TSC_COUNT_UPPER" },
+	{ "mmRLC_REFCLOCK_TIMESTAMP_LSB", "mmRLC_REFCLOCK_TIMESTAMP_MSB" },
+};
+
+static uint64_t raw_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * umr_gpu_clock_read - Read the free running counter of a GPU
+ *
+ * @asic: The device
+ * @clk: A clock set up by umr_gpu_clock_init()
+ *
+ * The high word is read on both sides of the low word so a carry
+ * between the reads is not mistaken for a jump of 2^32 ticks.
+ *
+ * Returns the counter in ticks.
+ */
+uint64_t umr_gpu_clock_read(struct umr_asic *asic, const struct umr_gpu_clock *clk)
+{
+	uint32_t hi, lo, hi2;
+
+	hi = umr_reg_handle_read(asic, &clk->hi);
+	lo = umr_reg_handle_read(asic, &clk->lo);
+	hi2 = umr_reg_handle_read(asic, &clk->hi);
+	if (hi2 != hi)
+		lo = umr_reg_handle_read(asic, &clk->lo);
+	return ((uint64_t)hi2 << 32) | lo;
+}
+
+// the counter and the host time halfway through the tightest of a few reads
+static uint64_t calibration_point(struct umr_asic *asic, const struct umr_gpu_clock *clk, uint64_t *host_ns)
+{
+	uint64_t t0, t1, ticks, best_ticks = 0, best = ~0ULL;
+	int i;
+
+	for (i = 0; i < GPU_CLOCK_TRIES; i++) {
+		t0 = raw_ns();
+		ticks = umr_gpu_clock_read(asic, clk);
+		t1 = raw_ns();
+		if (t1 - t0 < best) {
+			best = t1 - t0;
+			best_ticks = ticks;
+			*host_ns = t0 + (t1 - t0) / 2;
+		}
+	}
+	return best_ticks;
+}
+
+/**
+ * umr_gpu_clock_calibrate - Add a calibration point
+ *
+ * @asic: The device
+ * @clk: The clock
+ *
+ * The first call (from umr_gpu_clock_init()) takes two points a few
+ * milliseconds apart, later calls move the offset to a new point and
+ * measure the drift from the first one.  Must be called from a thread
+ * that can read the registers of @asic.
+ *
+ * Returns 0 on success, -1 if the counter isn't counting (clk->valid is
+ * cleared then).
+ */
+int umr_gpu_clock_calibrate(struct umr_asic *asic, struct umr_gpu_clock *clk)
+{
+	struct timespec ts = { 0, GPU_CLOCK_SETTLE_NS };
+	uint64_t ticks, ns;
+
+	if (!clk->lo.reg)
+		return -1;
+
+	if (!clk->anchor_ticks) {
+		clk->anchor_ticks = calibration_point(asic, clk, &clk->anchor_ns);
+		nanosleep(&ts, NULL);
+	}
+	ticks = calibration_point(asic, clk, &ns);
+	if (!clk->anchor_ticks || ticks <= clk->anchor_ticks || ns <= clk->anchor_ns) {
+		clk->valid = 0;
+		clk->anchor_ticks = 0;
+		return -1;
+	}
+
+	clk->ns_per_tick = (double)(ns - clk->anchor_ns) / (ticks - clk->anchor_ticks);
+	clk->base_ticks = ticks;
+	clk->base_ns = ns;
+	clk->valid = 1;
+	return 0;
+}
+
+/**
+ * umr_gpu_clock_init - Find the free running counter of a GPU and calibrate it
+ *
+ * @asic: The device
+ * @clk: The clock to set up
+ *
+ * Returns 0 on success, -1 if the device has no counter or it isn't
+ * counting (e.g. the GFX block is off).  umr_gpu_clock_now() falls back
+ * to the host clock then.
+ */
+int umr_gpu_clock_init(struct umr_asic *asic, struct umr_gpu_clock *clk)
+{
+	unsigned i;
+
+	memset(clk, 0, sizeof *clk);
+	for (i = 0; i < sizeof gpu_clock_regs / sizeof gpu_clock_regs[0]; i++) {
+		if (umr_reg_handle_resolve(asic, NULL, -1, gpu_clock_regs[i][0], &clk->lo) ||
+		    umr_reg_handle_resolve(asic, NULL, -1, gpu_clock_regs[i][1], &clk->hi))
+			continue;
+		if (!umr_gpu_clock_calibrate(asic, clk))
+			return 0;
+	}
+	memset(clk, 0, sizeof *clk);
+	return -1;
+}
+
+/**
+ * umr_gpu_clock_to_ns - Map a counter value onto CLOCK_MONOTONIC_RAW
+ *
+ * @clk: A calibrated clock
+ * @ticks: A value from umr_gpu_clock_read()
+ *
+ * Returns the host time of @ticks in nanoseconds.
+ */
+uint64_t umr_gpu_clock_to_ns(const struct umr_gpu_clock *clk, uint64_t ticks)
+{
+	if (ticks >= clk->base_ticks)
+		return clk->base_ns + (uint64_t)((ticks - clk->base_ticks) * clk->ns_per_tick);
+	return clk->base_ns - (uint64_t)((clk->base_ticks - ticks) * clk->ns_per_tick);
+}
+
+/**
+ * umr_gpu_clock_now - The current time of a GPU on CLOCK_MONOTONIC_RAW
+ *
+ * @asic: The device
+ * @clk: The clock, if it isn't valid the host clock is read instead
+ *
+ * Returns the time in nanoseconds.
+ */
+uint64_t umr_gpu_clock_now(struct umr_asic *asic, const struct umr_gpu_clock *clk)
+{
+	if (!clk->valid)
+		return raw_ns();
+	return umr_gpu_clock_to_ns(clk, umr_gpu_clock_read(asic, clk));
+}
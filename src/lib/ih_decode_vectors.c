@@ -27,56 +27,98 @@
 
 #define BITS(x, a, b) (unsigned long)((x >> (a)) & ((1ULL << ((b)-(a)))-1))
 
-/** umr_ih_decode_vectors - Decode a series of interrupt vectors
+/** umr_ih_vector_size - The size of an interrupt vector in bytes
  *
- * @asic: The device the vectors came from
- * @ui: Callback structure to handle the decoded data
- * @ih_data: The vector data
- * @length: Length of vector data in bytes (must be multiple of vector size)
+ * Returns -1 for devices whose vectors cannot be decoded.
+ */
+int umr_ih_vector_size(struct umr_asic *asic)
+{
+	switch (asic->family) {
+	case FAMILY_VI: // oss30
+		return 16;
+	case FAMILY_NV: // oss40/50
+	case FAMILY_AI:
+	case FAMILY_GFX11:
+		return 32;
+	default:
+		return -1;
+	}
+}
+
+/** umr_ih_parse_vector - Extract the fields of an interrupt vector
  *
- * Returns the number of vectors processed.
+ * @asic: The device the vector came from
+ * @data: The vector
+ * @v: [out] The fields, those the vector format lacks are 0
+ *
+ * Nothing is formatted so this is cheap enough to filter on.
+ *
+ * Returns the size of the vector in dwords or -1.
  */
-int umr_ih_decode_vectors(struct umr_asic *asic, struct umr_ih_decode_ui *ui, uint32_t *ih_data, uint32_t length)
+int umr_ih_parse_vector(struct umr_asic *asic, const uint32_t *data, struct umr_ih_vector *v)
 {
-	uint32_t off = 0;
+	memset(v, 0, sizeof *v);
+	switch (asic->family) {
+	case FAMILY_VI:
+		v->source_id = BITS(data[0], 0, 8);
+		v->vmid = BITS(data[2], 8, 16);
+		v->pasid = BITS(data[2], 16, 32);
+		v->context[0] = data[3];
+		return 4;
+
+	case FAMILY_NV:
+	case FAMILY_AI:
+	case FAMILY_GFX11:
+		v->client_id = BITS(data[0], 0, 8);
+		v->source_id = BITS(data[0], 8, 16);
+		v->ring_id = BITS(data[0], 16, 24);
+		v->vmid = BITS(data[0], 24, 28);
+		v->vmid_type = BITS(data[0], 31, 32);
+		v->timestamp = data[1] + ((uint64_t)BITS(data[2], 0, 16) << 32);
+		v->pasid = BITS(data[3], 0, 16);
+		memcpy(v->context, &data[4], sizeof v->context);
+		return 8;
 
+	default:
+		return -1;
+	}
+}
+
+/** umr_ih_decode_vector - Decode the interrupt vector at ih_data[off]
+ *
+ * Returns the size of the vector in dwords or -1.
+ */
+int umr_ih_decode_vector(struct umr_asic *asic, struct umr_ih_decode_ui *ui, uint32_t *ih_data, uint32_t off)
+{
 	switch (asic->family) {
 	case FAMILY_VI: // oss30
-		while (length) {
-			ui->start_vector(ui, off);
-			ui->add_field(ui, off + 0, "SourceID",   BITS(ih_data[off + 0], 0, 8), NULL, 10); // TODO: add ID to name translation
-			ui->add_field(ui, off + 1, "SourceData", BITS(ih_data[off + 1], 0, 24), NULL, 16);
-			ui->add_field(ui, off + 2, "VMID",       BITS(ih_data[off + 2], 8, 16), NULL, 10);
-			ui->add_field(ui, off + 2, "PASID",      BITS(ih_data[off + 2], 16, 32), NULL, 10);
-			ui->add_field(ui, off + 3, "ContextID0", ih_data[off + 3], NULL, 16);
-			ui->done(ui);
-			length -= 16;
-			off += 4;
-		}
-		return off / 4;
+		ui->start_vector(ui, off);
+		ui->add_field(ui, off + 0, "SourceID",   BITS(ih_data[off + 0], 0, 8), NULL, 10); // TODO: add ID to name translation
+		ui->add_field(ui, off + 1, "SourceData", BITS(ih_data[off + 1], 0, 24), NULL, 16);
+		ui->add_field(ui, off + 2, "VMID",       BITS(ih_data[off + 2], 8, 16), NULL, 10);
+		ui->add_field(ui, off + 2, "PASID",      BITS(ih_data[off + 2], 16, 32), NULL, 10);
+		ui->add_field(ui, off + 3, "ContextID0", ih_data[off + 3], NULL, 16);
+		ui->done(ui);
+		return 4;
 
 	case FAMILY_NV: // oss40/50
 	case FAMILY_AI:
 	case FAMILY_GFX11:
-		while (length) {
-			ui->start_vector(ui, off);
-			ui->add_field(ui, off + 0, "ClientID", BITS(ih_data[off + 0], 0, 8), NULL, 10); // TODO: add ID to name translation
-			ui->add_field(ui, off + 0, "SourceID", BITS(ih_data[off + 0], 8, 16), NULL, 10); // TODO: add ID to name translation
-			ui->add_field(ui, off + 0, "RingID",   BITS(ih_data[off + 0], 16, 24), NULL, 10);
-			ui->add_field(ui, off + 0, "VMID",     BITS(ih_data[off + 0], 24, 28), NULL, 10);
-			ui->add_field(ui, off + 0, "VMID_TYPE", BITS(ih_data[off + 0], 31, 32), NULL, 10);
-			ui->add_field(ui, off + 1, "Timestamp", ih_data[off + 1] + ((uint64_t)BITS(ih_data[off+2], 0, 16) << 32), NULL, 10);
-			ui->add_field(ui, off + 2, "Timestamp_SRC", BITS(ih_data[off + 2], 31, 32), NULL, 10);
-			ui->add_field(ui, off + 3, "PASID", BITS(ih_data[off + 3], 0, 16), NULL, 16);
-			ui->add_field(ui, off + 4, "ContextID0", ih_data[off + 4], NULL, 16);
-			ui->add_field(ui, off + 5, "ContextID1", ih_data[off + 5], NULL, 16);
-			ui->add_field(ui, off + 6, "ContextID2", ih_data[off + 6], NULL, 16);
-			ui->add_field(ui, off + 7, "ContextID3", ih_data[off + 7], NULL, 16);
-			ui->done(ui);
-			length -= 32;
-			off += 8;
-		}
-		return off / 8;
+		ui->start_vector(ui, off);
+		ui->add_field(ui, off + 0, "ClientID", BITS(ih_data[off + 0], 0, 8), NULL, 10); // TODO: add ID to name translation
+		ui->add_field(ui, off + 0, "SourceID", BITS(ih_data[off + 0], 8, 16), NULL, 10); // TODO: add ID to name translation
+		ui->add_field(ui, off + 0, "RingID",   BITS(ih_data[off + 0], 16, 24), NULL, 10);
+		ui->add_field(ui, off + 0, "VMID",     BITS(ih_data[off + 0], 24, 28), NULL, 10);
+		ui->add_field(ui, off + 0, "VMID_TYPE", BITS(ih_data[off + 0], 31, 32), NULL, 10);
+		ui->add_field(ui, off + 1, "Timestamp", ih_data[off + 1] + ((uint64_t)BITS(ih_data[off+2], 0, 16) << 32), NULL, 10);
+		ui->add_field(ui, off + 2, "Timestamp_SRC", BITS(ih_data[off + 2], 31, 32), NULL, 10);
+		ui->add_field(ui, off + 3, "PASID", BITS(ih_data[off + 3], 0, 16), NULL, 16);
+		ui->add_field(ui, off + 4, "ContextID0", ih_data[off + 4], NULL, 16);
+		ui->add_field(ui, off + 5, "ContextID1", ih_data[off + 5], NULL, 16);
+		ui->add_field(ui, off + 6, "ContextID2", ih_data[off + 6], NULL, 16);
+		ui->add_field(ui, off + 7, "ContextID3", ih_data[off + 7], NULL, 16);
+		ui->done(ui);
+		return 8;
 
 	case FAMILY_SI:
 	case FAMILY_CIK:
@@ -85,7 +127,31 @@ int umr_ih_decode_vectors(struct umr_asic *asic, struct umr_ih_decode_ui *ui, ui
 		asic->err_msg("[BUG]: unhandled family case:%d in umr_ih_decode_vectors()\n", asic->family);
 		return -1;
 	}
-	return 0;
+}
+
+/** umr_ih_decode_vectors - Decode a series of interrupt vectors
+ *
+ * @asic: The device the vectors came from
+ * @ui: Callback structure to handle the decoded data
+ * @ih_data: The vector data
+ * @length: Length of vector data in bytes (must be multiple of vector size)
+ *
+ * Returns the number of vectors processed.
+ */
+int umr_ih_decode_vectors(struct umr_asic *asic, struct umr_ih_decode_ui *ui, uint32_t *ih_data, uint32_t length)
+{
+	uint32_t off = 0;
+	int n = 0, r;
+
+	while (length) {
+		r = umr_ih_decode_vector(asic, ui, ih_data, off);
+		if (r < 0)
+			return -1;
+		length -= r * 4;
+		off += r;
+		++n;
+	}
+	return n;
 }
 
 #if 0
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+#include <time.h>
+
+/*
+ * A reader of the primary IH ring that keeps its own read pointer, the
+ * one in IH_RB_RPTR belongs to the driver.  Every poll decodes only the
+ * vectors written since the last one, counts them per ClientID/SourceID
+ * and hands those passing the filter to the ui.
+ */
+
+// MC_SPACE of IH_RB_CNTL when the ring is addressed by bus address
+#define IH_MC_SPACE_PHYSICAL 2
+
+/**
+ * umr_ih_filter_match - Does a vector pass a filter
+ */
+int umr_ih_filter_match(const struct umr_ih_filter *f, const struct umr_ih_vector *v)
+{
+	return (f->client_id < 0 || (uint32_t)f->client_id == v->client_id) &&
+	       (f->source_id < 0 || (uint32_t)f->source_id == v->source_id) &&
+	       (f->vmid < 0 || (uint32_t)f->vmid == v->vmid) &&
+	       (f->pasid < 0 || (uint32_t)f->pasid == v->pasid);
+}
+
+// IH_RB_BASE holds bits 8..39 of the address, newer OSS adds IH_RB_BASE_HI
+static const struct {
+	const char *name;
+	size_t off;
+	int optional;
+} ih_regs[] = {
+	{ "mmIH_RB_CNTL", offsetof(struct umr_ih_ring, cntl), 0 },
+	{ "mmIH_RB_BASE", offsetof(struct umr_ih_ring, base), 0 },
+	{ "mmIH_RB_BASE_HI", offsetof(struct umr_ih_ring, base_hi), 1 },
+	{ "mmIH_RB_RPTR", offsetof(struct umr_ih_ring, rptr), 0 },
+	{ "mmIH_RB_WPTR", offsetof(struct umr_ih_ring, wptr), 0 },
+};
+
+/**
+ * umr_ih_ring_init - Start reading the IH ring of a device
+ *
+ * @asic: The device
+ * @ih: The reader to initialize, release with umr_ih_ring_free()
+ * @from_rptr: Start at the driver's read pointer instead of only
+ *             decoding the vectors written from now on
+ *
+ * The filter matches everything, set ih->filter to narrow it.
+ *
+ * Returns 0 on success, -1 if the device has no (enabled) IH ring umr
+ * can decode.
+ */
+int umr_ih_ring_init(struct umr_asic *asic, struct umr_ih_ring *ih, int from_rptr)
+{
+	uint64_t cntl;
+	unsigned x;
+	int vs;
+
+	memset(ih, 0, sizeof *ih);
+	ih->filter.client_id = ih->filter.source_id = ih->filter.vmid = ih->filter.pasid = -1;
+
+	vs = umr_ih_vector_size(asic);
+	if (vs < 0) {
+		asic->err_msg("[ERROR]: IH vectors of this device cannot be decoded\n");
+		return -1;
+	}
+	ih->vector_size = vs;
+
+	for (x = 0; x < sizeof(ih_regs) / sizeof(ih_regs[0]); x++) {
+		struct umr_reg *reg = umr_find_reg_data_by_ip_by_instance(asic, "oss", -1, ih_regs[x].name);
+		if (!reg && !ih_regs[x].optional) {
+			asic->err_msg("[ERROR]: Cannot find IH register '%s'\n", ih_regs[x].name);
+			return -1;
+		}
+		*(struct umr_reg **)((char *)ih + ih_regs[x].off) = reg;
+	}
+
+	cntl = umr_read_reg_by_reg(asic, ih->cntl);
+	if (!umr_bitslice_reg(asic, ih->cntl, "RB_ENABLE", cntl)) {
+		asic->err_msg("[ERROR]: The IH ring is not enabled\n");
+		return -1;
+	}
+	ih->size = 4U << umr_bitslice_reg(asic, ih->cntl, "RB_SIZE", cntl);
+	ih->bus_addr = umr_bitslice_reg_quiet(asic, ih->cntl, "MC_SPACE", cntl) == IH_MC_SPACE_PHYSICAL;
+	ih->addr = (uint64_t)umr_read_reg_by_reg(asic, ih->base) << 8;
+	if (ih->base_hi)
+		ih->addr |= (uint64_t)(umr_read_reg_by_reg(asic, ih->base_hi) & 0xFF) << 40;
+
+	ih->buf = calloc(1, ih->size);
+	if (!ih->buf) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return -1;
+	}
+
+	if (from_rptr)
+		ih->cursor = umr_read_reg_by_reg(asic, ih->rptr);
+	else
+		ih->cursor = umr_read_reg_by_reg(asic, ih->wptr);
+	ih->cursor &= (ih->size - 1) & ~(ih->vector_size - 1);
+	return 0;
+}
+
+static int read_ring(struct umr_asic *asic, struct umr_ih_ring *ih, uint32_t off, uint32_t len)
+{
+	uint32_t *dst = &ih->buf[off / 4];
+
+	if (ih->bus_addr)
+		return asic->mem_funcs.access_sram(asic, ih->addr + off, len, dst, 0);
+	return umr_read_vram(asic, asic->options.vm_partition,
+		(asic->family < FAMILY_AI ? UMR_GFX_HUB : UMR_MM_HUB) | 0,
+		ih->addr + off, len, dst);
+}
+
+static int cmp_rate(const void *a, const void *b)
+{
+	const struct umr_ih_source_rate *x = a, *y = b;
+
+	if (x->client_id != y->client_id)
+		return x->client_id < y->client_id ? -1 : 1;
+	if (x->source_id != y->source_id)
+		return x->source_id < y->source_id ? -1 : 1;
+	return 0;
+}
+
+static struct umr_ih_source_rate *find_rate(struct umr_ih_ring *ih, const struct umr_ih_vector *v)
+{
+	struct umr_ih_source_rate key, *r;
+	int lo = 0, hi = ih->no_rates, mid;
+
+	key.client_id = v->client_id;
+	key.source_id = v->source_id;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (cmp_rate(&ih->rates[mid], &key) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < ih->no_rates && !cmp_rate(&ih->rates[lo], &key))
+		return &ih->rates[lo];
+
+	// a storm has few sources, inserting in place is fine
+	r = realloc(ih->rates, (ih->no_rates + 1) * sizeof *r);
+	if (!r)
+		return NULL;
+	ih->rates = r;
+	memmove(&r[lo + 1], &r[lo], (ih->no_rates - lo) * sizeof *r);
+	memset(&r[lo], 0, sizeof *r);
+	r[lo].client_id = v->client_id;
+	r[lo].source_id = v->source_id;
+	++ih->no_rates;
+	return &r[lo];
+}
+
+// move the rate window forward to 'now', clearing the seconds skipped
+static void advance_rates(struct umr_ih_ring *ih, uint64_t now)
+{
+	uint64_t s;
+	int x;
+
+	if (now <= ih->now_sec)
+		return;
+	for (s = ih->now_sec + 1; s <= now && s - ih->now_sec <= UMR_IH_RATE_SLOTS; s++)
+		for (x = 0; x < ih->no_rates; x++)
+			ih->rates[x].slots[s % UMR_IH_RATE_SLOTS] = 0;
+	ih->now_sec = now;
+}
+
+/**
+ * umr_ih_ring_decode - Decode the vectors up to a write pointer
+ *
+ * @asic: The device
+ * @ih: The reader
+ * @wptr: The write pointer of the ring in bytes
+ * @now_sec: The current time in seconds, selects the rate slot
+ * @ui: Where to send the vectors that pass ih->filter, may be NULL to
+ *      only count them
+ *
+ * Every vector is counted in the rate of its ClientID/SourceID but only
+ * those passing the filter are decoded through the ui, with offsets in
+ * dwords from the start of the ring.
+ *
+ * Returns the number of vectors passed to the ui or -1 on error.
+ */
+int umr_ih_ring_decode(struct umr_asic *asic, struct umr_ih_ring *ih, uint32_t wptr, uint64_t now_sec, struct umr_ih_decode_ui *ui)
+{
+	struct umr_ih_source_rate *rate;
+	struct umr_ih_vector v;
+	uint32_t end, len;
+	int n = 0;
+
+	wptr &= (ih->size - 1) & ~(ih->vector_size - 1);
+	advance_rates(ih, now_sec);
+	if (wptr == ih->cursor)
+		return 0;
+
+	// one read up to the end of the ring and one from its start
+	end = wptr > ih->cursor ? wptr : ih->size;
+	if (read_ring(asic, ih, ih->cursor, end - ih->cursor))
+		return -1;
+	if (wptr < ih->cursor && wptr && read_ring(asic, ih, 0, wptr))
+		return -1;
+
+	for (len = (wptr - ih->cursor) & (ih->size - 1); len; len -= ih->vector_size) {
+		umr_ih_parse_vector(asic, &ih->buf[ih->cursor / 4], &v);
+		++ih->vectors;
+		rate = find_rate(ih, &v);
+		if (rate) {
+			++rate->total;
+			++rate->slots[now_sec % UMR_IH_RATE_SLOTS];
+		}
+		if (umr_ih_filter_match(&ih->filter, &v)) {
+			if (ui)
+				umr_ih_decode_vector(asic, ui, ih->buf, ih->cursor / 4);
+			++n;
+		} else {
+			++ih->filtered;
+		}
+		ih->cursor = (ih->cursor + ih->vector_size) & (ih->size - 1);
+	}
+	return n;
+}
+
+/**
+ * umr_ih_ring_poll - Decode the vectors written since the last poll
+ *
+ * The write pointer is read from IH_RB_WPTR, if the hardware reports an
+ * overflow the vectors it overwrote are lost and ih->overflows counts it.
+ * See umr_ih_ring_decode().
+ */
+int umr_ih_ring_poll(struct umr_asic *asic, struct umr_ih_ring *ih, struct umr_ih_decode_ui *ui)
+{
+	struct timespec ts;
+	uint64_t wptr;
+
+	wptr = umr_read_reg_by_reg(asic, ih->wptr);
+	if (umr_bitslice_reg_quiet(asic, ih->wptr, "RB_OVERFLOW", wptr))
+		++ih->overflows;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return umr_ih_ring_decode(asic, ih, wptr, ts.tv_sec, ui);
+}
+
+/**
+ * umr_ih_source_rate - Vectors per second of a source over the rate window
+ */
+uint32_t umr_ih_source_rate(const struct umr_ih_source_rate *r)
+{
+	uint64_t sum = 0;
+	int x;
+
+	for (x = 0; x < UMR_IH_RATE_SLOTS; x++)
+		sum += r->slots[x];
+	return sum / UMR_IH_RATE_SLOTS;
+}
+
+void umr_ih_ring_free(struct umr_ih_ring *ih)
+{
+	free(ih->buf);
+	free(ih->rates);
+	ih->buf = NULL;
+	ih->rates = NULL;
+	ih->no_rates = 0;
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+
+/*
+ * The KFD 'rls' debugfs file prints each node's runlist as
+ *
+ *   Node 0, gpu_id 5f5a:
+ *     00000000: c0032200 00000180 00000000 ...
+ *
+ * with up to eight words after the offset of each line.  The whole dump
+ * is decoded in one pass with a lookup table instead of a sscanf() per
+ * line as it gets large on nodes with many queues.
+ */
+
+// value + 1 of a hex digit, 0 for any other character
+static const uint8_t hexval[256] = {
+	['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+	['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+	['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+	['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+};
+
+// parse a hex number at *p (at most 8 digits), returns the digits consumed
+static int parse_hex(const char **p, const char *end, uint32_t *v)
+{
+	const char *s = *p;
+	uint32_t x = 0;
+	int n = 0;
+
+	while (s < end && n < 8 && hexval[(uint8_t)*s]) {
+		x = (x << 4) | (hexval[(uint8_t)*s++] - 1);
+		++n;
+	}
+	*p = s;
+	*v = x;
+	return n;
+}
+
+static const char *skip_blanks(const char *p, const char *end)
+{
+	while (p < end && (*p == ' ' || *p == '\t'))
+		++p;
+	return p;
+}
+
+static int push_word(struct umr_kfd_runlist *rl, uint32_t *size, uint32_t w)
+{
+	uint32_t *t;
+
+	if (rl->no_words == *size) {
+		*size = *size ? *size * 2 : 1024;
+		t = realloc(rl->words, *size * sizeof *t);
+		if (!t)
+			return -1;
+		rl->words = t;
+	}
+	rl->words[rl->no_words++] = w;
+	return 0;
+}
+
+/*
+ * parse_node - parse a "Node N, gpu_id X" header, returns 0 if the line
+ * is one
+ */
+static int parse_node(const char *p, const char *end, struct umr_kfd_runlist *rl)
+{
+	if (end - p < 5 || memcmp(p, "Node ", 5))
+		return -1;
+	p += 5;
+	if (p == end || *p < '0' || *p > '9')
+		return -1;
+	for (rl->node = 0; p < end && *p >= '0' && *p <= '9'; p++)
+		rl->node = rl->node * 10 + (*p - '0');
+	rl->gpu_id = 0;
+	if (end - p > 9 && !memcmp(p, ", gpu_id ", 9)) {
+		p += 9;
+		parse_hex(&p, end, &rl->gpu_id);
+	}
+	return 0;
+}
+
+/**
+ * umr_kfd_rls_parse - Decode the runlists of a KFD 'rls' dump
+ *
+ * @text: The contents of the debugfs file
+ * @len: Its length in bytes
+ * @rls: Receives an array of the runlists, one per node in the order
+ *       of the dump, release with umr_kfd_rls_free()
+ *
+ * A node's words end at the first line that is not "offset: words..."
+ * (as the sscanf() based parser it replaces did).
+ *
+ * Returns the number of runlists or -1 if out of memory.
+ */
+int umr_kfd_rls_parse(const char *text, size_t len, struct umr_kfd_runlist **rls)
+{
+	struct umr_kfd_runlist *out = NULL, *cur = NULL, *t, hdr;
+	const char *p = text, *end = text + len, *eol;
+	uint32_t size = 0, w;
+	int n = 0, have = 0, in_node = 0;
+
+	while (p < end) {
+		eol = memchr(p, '\n', end - p);
+		if (!eol)
+			eol = end;
+
+		if (!parse_node(p, eol, &hdr)) {
+			if (n == have) {
+				have = have ? have * 2 : 8;
+				t = realloc(out, have * sizeof *out);
+				if (!t)
+					goto oom;
+				out = t;
+			}
+			cur = &out[n++];
+			*cur = hdr;
+			cur->words = NULL;
+			cur->no_words = 0;
+			size = 0;
+			in_node = 1;
+		} else if (in_node) {
+			// "offset: w w w ...", the offset is not kept
+			p = skip_blanks(p, eol);
+			if (!parse_hex(&p, eol, &w) || p == eol || *p++ != ':') {
+				in_node = 0;
+			} else {
+				p = skip_blanks(p, eol);
+				if (p == eol || !hexval[(uint8_t)*p]) {
+					in_node = 0;
+				} else {
+					while (parse_hex(&p, eol, &w)) {
+						if (push_word(cur, &size, w))
+							goto oom;
+						p = skip_blanks(p, eol);
+					}
+				}
+			}
+		}
+		p = eol + 1;
+	}
+
+	*rls = out;
+	return n;
+oom:
+	umr_kfd_rls_free(out, n);
+	*rls = NULL;
+	return -1;
+}
+
+void umr_kfd_rls_free(struct umr_kfd_runlist *rls, int no_rls)
+{
+	int x;
+
+	if (!rls)
+		return;
+	for (x = 0; x < no_rls; x++)
+		free(rls[x].words);
+	free(rls);
+}
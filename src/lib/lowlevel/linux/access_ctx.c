@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+
+// context bound on the calling thread (NULL == use asic->options)
+static __thread struct umr_access_ctx *bound_ctx;
+
+/**
+ * umr_access_ctx_create - Create a register access context
+ *
+ * @asic: The device the context accesses
+ *
+ * The context starts out with a copy of the bank, pg_lock, context bank
+ * and partition settings of the calling thread, those of the context it
+ * has bound or else asic->options.  If registers are accessed
+ * through the regs2 debugfs file the context gets its own open file
+ * description of it (a dup() would share the SET_STATE state of the
+ * original) so bank selections made by different threads cannot clobber
+ * each other.  The same goes for the gprwave file whose wave selection is
+ * also per file, and the context keeps its own cache of resolved WAVE
+ * STATUS bitfields (see umr_wave_data_resolve_field()).
+ *
+ * Returns the context or NULL on error.
+ */
+struct umr_access_ctx *umr_access_ctx_create(struct umr_asic *asic)
+{
+	struct umr_access_ctx *ctx;
+	char fname[64];
+
+	ctx = calloc(1, sizeof *ctx);
+	if (!ctx) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return NULL;
+	}
+
+	ctx->asic = asic;
+	if (bound_ctx && bound_ctx->asic == asic) {
+		// e.g. a wave scan on a worker of umr_xcc_run() stays on its XCC
+		ctx->use_bank = bound_ctx->use_bank;
+		ctx->bank = bound_ctx->bank;
+		ctx->pg_lock = bound_ctx->pg_lock;
+		ctx->context_reg_bank = bound_ctx->context_reg_bank;
+		ctx->vm_partition = bound_ctx->vm_partition;
+	} else {
+		ctx->use_bank = asic->options.use_bank;
+		ctx->bank = asic->options.bank;
+		ctx->pg_lock = asic->options.pg_lock;
+		ctx->context_reg_bank = asic->options.context_reg_bank;
+		ctx->vm_partition = asic->options.vm_partition;
+	}
+	ctx->fd_mmio2 = -1;
+	ctx->fd_gprwave = -1;
+
+	// only the debugfs backend accesses the regs2 file itself
+	if (asic->fd.mmio2 >= 0 &&
+	    (asic->reg_funcs.read_reg == umr_read_reg || asic->reg_funcs.read_reg == umr_read_reg_uring)) {
+		snprintf(fname, sizeof fname, "/proc/self/fd/%d", asic->fd.mmio2);
+		ctx->fd_mmio2 = open(fname, O_RDWR);
+		if (ctx->fd_mmio2 < 0) {
+			asic->err_msg("[ERROR]: Could not reopen the regs2 file for an access context\n");
+			free(ctx);
+			return NULL;
+		}
+	}
+	if (asic->fd.gprwave >= 0 &&
+	    (asic->wave_funcs.get_wave_status == umr_get_wave_status || asic->gpr_read_funcs.read_sgprs == umr_read_sgprs)) {
+		snprintf(fname, sizeof fname, "/proc/self/fd/%d", asic->fd.gprwave);
+		ctx->fd_gprwave = open(fname, O_RDWR);
+		if (ctx->fd_gprwave < 0) {
+			asic->err_msg("[ERROR]: Could not reopen the gprwave file for an access context\n");
+			if (ctx->fd_mmio2 >= 0)
+				close(ctx->fd_mmio2);
+			free(ctx);
+			return NULL;
+		}
+	}
+	return ctx;
+}
+
+/**
+ * umr_access_ctx_free - Free a register access context
+ *
+ * The context is unbound first if it is bound on the calling thread.
+ */
+void umr_access_ctx_free(struct umr_access_ctx *ctx)
+{
+	if (!ctx)
+		return;
+	if (bound_ctx == ctx)
+		bound_ctx = NULL;
+	if (ctx->fd_mmio2 >= 0)
+		close(ctx->fd_mmio2);
+	if (ctx->fd_gprwave >= 0)
+		close(ctx->fd_gprwave);
+	free(ctx->wave_fields);
+	free(ctx);
+}
+
+/**
+ * umr_access_ctx_bind - Bind a register access context to the calling thread
+ *
+ * @ctx: The context to bind, or NULL to go back to asic->options
+ *
+ * Returns the previously bound context so callers can nest.
+ */
+struct umr_access_ctx *umr_access_ctx_bind(struct umr_access_ctx *ctx)
+{
+	struct umr_access_ctx *prev = bound_ctx;
+	bound_ctx = ctx;
+	return prev;
+}
+
+/**
+ * umr_access_ctx_current - The context bound on this thread for @asic
+ *
+ * Returns NULL if no context (or one for another device) is bound.
+ */
+struct umr_access_ctx *umr_access_ctx_current(struct umr_asic *asic)
+{
+	if (bound_ctx && bound_ctx->asic == asic)
+		return bound_ctx;
+	return NULL;
+}
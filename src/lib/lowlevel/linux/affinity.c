@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#define _GNU_SOURCE
+#include "umr.h"
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+/*
+ * On machines with more than one NUMA node a device hangs off the root
+ * complex of one of them, register and debugfs accesses made from the CPUs
+ * of another node take longer and vary more.  The threads that work on a
+ * device (samplers, watchpoints, wave scans, server workers) call
+ * umr_affinity_apply() to run on the CPUs local to it and to prefer its
+ * node for the memory they allocate.
+ */
+
+// the asic the calling thread was last placed for
+static __thread struct umr_asic *placed_asic;
+
+// "0-7,16-23" (sysfs) or "0-7+16-23" (-O cpu_affinity=), returns the number of CPUs
+static int parse_cpulist(const char *s, uint64_t *cpus)
+{
+	long first, last;
+	char *end;
+	int n = 0;
+
+	memset(cpus, 0, UMR_MAX_CPUS / 8);
+	while (*s) {
+		first = last = strtol(s, &end, 10);
+		if (end == s || first < 0)
+			break;
+		if (*end == '-') {
+			s = end + 1;
+			last = strtol(s, &end, 10);
+			if (end == s)
+				break;
+		}
+		for (; first <= last && first < UMR_MAX_CPUS; first++) {
+			if (!(cpus[first / 64] & (1ULL << (first % 64))))
+				++n;
+			cpus[first / 64] |= 1ULL << (first % 64);
+		}
+		s = end;
+		if (*s != ',' && *s != '+')
+			break;
+		++s;
+	}
+	return n;
+}
+
+static int read_device_file(struct umr_asic *asic, const char *name, char *buf, int size)
+{
+	char path[128];
+	FILE *f;
+	int r;
+
+	snprintf(path, sizeof path, "/sys/bus/pci/devices/%s/%s", asic->options.pci.name, name);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	r = fgets(buf, size, f) ? 0 : -1;
+	fclose(f);
+	return r;
+}
+
+/**
+ * umr_affinity_init - Find the CPUs and NUMA node local to a device
+ *
+ * @asic: The device just discovered
+ *
+ * Reads the numa_node and local_cpulist files of the PCI device unless
+ * asic->options.cpu_affinity overrides them: "off" to leave the threads
+ * where the scheduler puts them, or a list of CPUs ("0-7+16-23") to run
+ * them on instead.  Nothing is pinned on single node machines.
+ */
+void umr_affinity_init(struct umr_asic *asic)
+{
+	char buf[4096];
+
+	asic->numa.node = -1;
+	asic->numa.no_cpus = 0;
+	if (!strcmp(asic->options.cpu_affinity, "off"))
+		return;
+	if (asic->options.cpu_affinity[0]) {
+		asic->numa.no_cpus = parse_cpulist(asic->options.cpu_affinity, asic->numa.cpus);
+		if (!asic->numa.no_cpus)
+			asic->err_msg("[WARNING]: No CPUs in cpu_affinity=%s\n", asic->options.cpu_affinity);
+		return;
+	}
+	if (asic->options.is_virtual || !asic->options.pci.name[0])
+		return;
+
+	if (read_device_file(asic, "numa_node", buf, sizeof buf))
+		return;
+	asic->numa.node = atoi(buf);
+	if (asic->numa.node < 0)
+		return;
+	if (!read_device_file(asic, "local_cpulist", buf, sizeof buf))
+		asic->numa.no_cpus = parse_cpulist(buf, asic->numa.cpus);
+}
+
+/**
+ * umr_affinity_apply - Run the calling thread on the CPUs local to a device
+ *
+ * @asic: The device the thread works on
+ *
+ * Pins the thread to the CPUs found by umr_affinity_init() and makes the
+ * node of the device the preferred one for the memory it allocates (pages
+ * are placed when first touched, so buffers the thread fills itself end up
+ * there).  Calling it again for the same device is free.
+ *
+ * Returns 0 on success or if there is nothing to do, -1 on error.
+ */
+int umr_affinity_apply(struct umr_asic *asic)
+{
+	unsigned long nodes[UMR_MAX_CPUS / (8 * sizeof(unsigned long))];
+	const int bits = 8 * sizeof(unsigned long);
+	cpu_set_t set;
+	int i;
+
+	if (!asic || !asic->numa.no_cpus || placed_asic == asic)
+		return 0;
+	placed_asic = asic;
+
+	CPU_ZERO(&set);
+	for (i = 0; i < UMR_MAX_CPUS && i < CPU_SETSIZE; i++)
+		if (asic->numa.cpus[i / 64] & (1ULL << (i % 64)))
+			CPU_SET(i, &set);
+	if (pthread_setaffinity_np(pthread_self(), sizeof set, &set))
+		return -1;
+
+	if (asic->numa.node >= 0 && asic->numa.node < UMR_MAX_CPUS) {
+		memset(nodes, 0, sizeof nodes);
+		nodes[asic->numa.node / bits] |= 1UL << (asic->numa.node % bits);
+		// the kernel reads maxnode - 1 bits
+		if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, nodes, 8 * sizeof nodes + 1))
+			return -1;
+	}
+	return 0;
+}
@@ -28,6 +28,11 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+
+#define DET_CACHE_MAGIC "UMRDET 1"
 
 static void set_ip_logical_inst(struct umr_discovery_table_entry *first,
                                 struct umr_discovery_table_entry *end,
@@ -208,20 +213,7 @@ static void add_ip_instances(struct umr_discovery_table_entry **det, int die_num
         │       ├── num_instance
         │       └── revision <= dec
 */
-/**
- * @brief Parses IP discovery data and returns a discovery table entry.
- *
- * This function parses the IP discovery data for a given instance and populates
- * the discovery table entries. It also updates the number of blocks found in the
- * discovery data.
- *
- * @param[in]  instance The instance identifier for which to parse the IP discovery data.
- * @param[out] nblocks  A pointer to an integer where the number of blocks will be stored.
- * @param[in]  errout   An error output function used to report any errors during parsing.
- *
- * @return A pointer to the first entry in the parsed discovery table, or NULL if an error occurred.
- */
-struct umr_discovery_table_entry *umr_parse_ip_discovery(int instance, int *nblocks, umr_err_output errout)
+static struct umr_discovery_table_entry *parse_ip_discovery(int instance, int *nblocks, umr_err_output errout)
 {
 	DIR *top = NULL, *die = NULL;
 	char linebuf[512];
@@ -277,3 +269,254 @@ error:
 	}
 	return NULL;
 }
+
+/**
+ * det_cache_dir - Where the parsed discovery tables are kept
+ *
+ * UMR_DISCOVERY_CACHE names the directory (an empty value disables the
+ * cache), otherwise it is umr/discovery under $XDG_CACHE_HOME or ~/.cache.
+ */
+static int det_cache_dir(char *buf, size_t len)
+{
+	const char *p;
+
+	p = getenv("UMR_DISCOVERY_CACHE");
+	if (p) {
+		if (!*p)
+			return -1;
+		snprintf(buf, len, "%s", p);
+		return 0;
+	}
+
+	p = getenv("XDG_CACHE_HOME");
+	if (p && *p) {
+		snprintf(buf, len, "%s/umr/discovery", p);
+		return 0;
+	}
+	p = getenv("HOME");
+	if (p && *p) {
+		snprintf(buf, len, "%s/.cache/umr/discovery", p);
+		return 0;
+	}
+	return -1;
+}
+
+// first line of a sysfs/procfs file without the newline
+static int read_first_line(const char *fname, char *buf, size_t len)
+{
+	FILE *f;
+
+	f = fopen(fname, "r");
+	if (!f)
+		return -1;
+	if (!fgets(buf, len, f)) {
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+	buf[strcspn(buf, "\n")] = 0;
+	return 0;
+}
+
+/**
+ * det_cache_key - Identify the discovery table of card @instance
+ *
+ * The table only changes with the device (PCI address, DID and
+ * revision), the driver (kernel release and amdgpu module) or a reboot
+ * (harvesting, partition modes), the key holds all of them.  The PCI
+ * address is also returned in @pci to name the cache file.
+ *
+ * Returns 0 on success, -1 if any part could not be read.
+ */
+static int det_cache_key(int instance, char *key, size_t len, char *pci, size_t pcilen)
+{
+	char path[256], link[512], did[32], rev[32], drv[128], boot[64], *p;
+	struct utsname un;
+	ssize_t n;
+
+	snprintf(path, sizeof path, "/sys/class/drm/card%d/device", instance);
+	n = readlink(path, link, sizeof link - 1);
+	if (n <= 0)
+		return -1;
+	link[n] = 0;
+	p = strrchr(link, '/');
+	if (snprintf(pci, pcilen, "%s", p ? p + 1 : link) >= (int)pcilen)
+		return -1;
+
+	snprintf(path, sizeof path, "/sys/class/drm/card%d/device/device", instance);
+	if (read_first_line(path, did, sizeof did))
+		return -1;
+	snprintf(path, sizeof path, "/sys/class/drm/card%d/device/revision", instance);
+	if (read_first_line(path, rev, sizeof rev))
+		return -1;
+	if (read_first_line("/proc/sys/kernel/random/boot_id", boot, sizeof boot))
+		return -1;
+	// a built in driver has no srcversion, the kernel release covers it
+	if (read_first_line("/sys/module/amdgpu/srcversion", drv, sizeof drv))
+		strcpy(drv, "builtin");
+	if (uname(&un))
+		return -1;
+
+	snprintf(key, len, "%s %s %s %s %s %s", pci, did, rev, un.release, drv, boot);
+	return 0;
+}
+
+/**
+ * det_cache_load - Read a discovery table stored by det_cache_save()
+ *
+ * Returns the table (with the empty entry that ends it like the sysfs
+ * parser makes) or NULL if the file is missing, damaged or was made for
+ * a different @key.
+ */
+static struct umr_discovery_table_entry *det_cache_load(const char *fname, const char *key, int *nblocks)
+{
+	struct umr_discovery_table_entry *pdet, *det;
+	char line[1024], *p, *end;
+	int x, n = 0;
+	FILE *f;
+
+	f = fopen(fname, "r");
+	if (!f)
+		return NULL;
+
+	pdet = det = calloc(1, sizeof *det);
+	if (!det)
+		goto bad;
+	if (!fgets(line, sizeof line, f) || strcmp(line, DET_CACHE_MAGIC "\n"))
+		goto bad;
+	if (!fgets(line, sizeof line, f) || strncmp(line, "K\t", 2) ||
+	    strncmp(line + 2, key, strlen(key)) || strcmp(line + 2 + strlen(key), "\n"))
+		goto bad;
+
+	while (fgets(line, sizeof line, f)) {
+		unsigned harvest;
+
+		if (sscanf(line, "E\t%127[^\t]\t%d\t%d\t%d\t%d\t%d\t%d\t%u\t",
+			   det->ipname, &det->die, &det->instance, &det->maj, &det->min,
+			   &det->rev, &det->logical_inst, &harvest) != 8)
+			goto bad;
+		det->harvest = harvest;
+
+		// the segments are the last field
+		p = strrchr(line, '\t');
+		if (!p)
+			goto bad;
+		++p;
+		for (x = 0; x < 32; x++) {
+			det->segments[x] = strtoull(p, &end, 16);
+			if (end == p || (x < 31 && *end != ','))
+				goto bad;
+			p = end + 1;
+		}
+
+		det->next = calloc(1, sizeof *det);
+		if (!det->next)
+			goto bad;
+		det = det->next;
+		++n;
+	}
+	if (!n)
+		goto bad;
+	fclose(f);
+	umr_timing_count(UMR_TIMING_IP_DISCOVERY, 1, 0);
+	*nblocks = n;
+	return pdet;
+bad:
+	fclose(f);
+	while (pdet) {
+		det = pdet->next;
+		free(pdet);
+		pdet = det;
+	}
+	return NULL;
+}
+
+/**
+ * det_cache_save - Store a parsed discovery table
+ *
+ * The file is written under a temporary name and renamed into place so
+ * concurrent umr processes never see a partial table.  Failing to write
+ * it is not an error.
+ */
+static void det_cache_save(const char *dir, const char *fname, const char *key, struct umr_discovery_table_entry *det)
+{
+	char path[512], tmpname[600], *p;
+	FILE *f;
+	int x, fd;
+
+	// create the directory and its parents if needed
+	snprintf(path, sizeof path, "%s", dir);
+	for (p = strchr(path + 1, '/'); ; p = strchr(p + 1, '/')) {
+		if (p)
+			*p = 0;
+		if (mkdir(path, 0755) && errno != EEXIST)
+			return;
+		if (!p)
+			break;
+		*p = '/';
+	}
+
+	// mkstemp() needs the whole template
+	if (snprintf(tmpname, sizeof tmpname, "%s.XXXXXX", fname) >= (int)sizeof tmpname)
+		return;
+	fd = mkstemp(tmpname);
+	if (fd < 0)
+		return;
+	f = fdopen(fd, "w");
+	if (!f) {
+		close(fd);
+		unlink(tmpname);
+		return;
+	}
+
+	fprintf(f, DET_CACHE_MAGIC "\n");
+	fprintf(f, "K\t%s\n", key);
+	// the last entry is the empty one ending the table
+	for (; det && det->next; det = det->next) {
+		fprintf(f, "E\t%s\t%d\t%d\t%d\t%d\t%d\t%d\t%u\t", det->ipname, det->die, det->instance,
+			det->maj, det->min, det->rev, det->logical_inst, (unsigned)det->harvest);
+		for (x = 0; x < 32; x++)
+			fprintf(f, "%s%"PRIx64, x ? "," : "", det->segments[x]);
+		fprintf(f, "\n");
+	}
+
+	if (fclose(f) || rename(tmpname, fname))
+		unlink(tmpname);
+}
+
+/**
+ * @brief Parses IP discovery data and returns a discovery table entry.
+ *
+ * This function parses the IP discovery data for a given instance and populates
+ * the discovery table entries. It also updates the number of blocks found in the
+ * discovery data.
+ *
+ * The parsed table is cached on disk (see det_cache_dir()) keyed by the
+ * device, the driver and the boot so later runs skip the sysfs walk.
+ *
+ * @param[in]  instance The instance identifier for which to parse the IP discovery data.
+ * @param[out] nblocks  A pointer to an integer where the number of blocks will be stored.
+ * @param[in]  errout   An error output function used to report any errors during parsing.
+ *
+ * @return A pointer to the first entry in the parsed discovery table, or NULL if an error occurred.
+ */
+struct umr_discovery_table_entry *umr_parse_ip_discovery(int instance, int *nblocks, umr_err_output errout)
+{
+	struct umr_discovery_table_entry *det = NULL;
+	char dir[512], fname[640], key[512], pci[64];
+	int cached;
+
+	umr_timing_begin(UMR_TIMING_IP_DISCOVERY);
+	cached = !det_cache_dir(dir, sizeof dir) && !det_cache_key(instance, key, sizeof key, pci, sizeof pci);
+	if (cached) {
+		snprintf(fname, sizeof fname, "%s/%s.det", dir, pci);
+		det = det_cache_load(fname, key, nblocks);
+	}
+	if (!det) {
+		det = parse_ip_discovery(instance, nblocks, errout);
+		if (det && cached)
+			det_cache_save(dir, fname, key, det);
+	}
+	umr_timing_end(UMR_TIMING_IP_DISCOVERY);
+	return det;
+}
@@ -125,31 +125,14 @@ static int find_pci_instance(const char* pci_string)
 }
 
 
-/**
- * umr_discover_asic - Search for an ASIC in the system
- *
- * @options: The ASIC options that control how an ASIC is found and are bound to the structure once found.
- * @errout:  Error output function pointer to handle error messages.
- *
- * This function searches for an ASIC based on the provided options. It can discover the ASIC by:
- * - Virtual device if @options->dev_name starts with a '.'.
- * - PCI bus address specified in @options->pci.
- * - DRI instance specified in @options->instance.
- * - Device name specified in @options->dev_name.
- *
- * The function handles various scenarios such as checking for the presence of the amdgpu kernel module,
- * reading device IDs, and mapping PCI memory if necessary.
- *
- * @return A pointer to the discovered ASIC structure on success, or NULL on failure.
- */
-struct umr_asic *umr_discover_asic(struct umr_options *options, umr_err_output errout)
+static struct umr_asic *discover_asic(struct umr_options *options, umr_err_output errout)
 {
 	char driver[512], name[256], fname[256];
 	FILE *f;
 	unsigned did = 0;
 	struct umr_asic *asic = NULL;
 	long trydid = options->forcedid;
-	int busmatch = 0, parsed_did, need_config_scan = 0;
+	int parsed_did, need_config_scan = 0;
 	int tryipdiscovery = 0;
 
 	// virtual device
@@ -304,9 +287,12 @@ struct umr_asic *umr_discover_asic(struct umr_options *options, umr_err_output e
 	if (asic) {
 		asic->err_msg = errout;
 		memcpy(&asic->options, options, sizeof(*options));
+		umr_affinity_init(asic);
 		if (!asic->options.no_kernel) {
+			umr_timing_begin(UMR_TIMING_DEBUGFS);
 			snprintf(fname, sizeof(fname)-1, "/sys/kernel/debug/dri/%d/amdgpu_regs2", asic->instance);
 			asic->fd.mmio2 = open(fname, O_RDWR);
+			umr_mmio2_invalidate_bank(asic);
 			if (asic->fd.mmio2 >= 0) {
 				asic->fd.mmio = -1;
 			} else {
@@ -344,6 +330,13 @@ struct umr_asic *umr_discover_asic(struct umr_options *options, umr_err_output e
 			asic->fd.gfxoff = open(fname, O_RDWR);
 			asic->fd.drm = -1; // default to closed
 			// if appending to the fd list remember to update close_asic() and discover_by_did()...
+			umr_timing_count(UMR_TIMING_DEBUGFS,
+				(asic->fd.mmio2 >= 0) + (asic->fd.mmio >= 0) + (asic->fd.didt >= 0) +
+				(asic->fd.pcie >= 0) + (asic->fd.smc >= 0) + (asic->fd.sensors >= 0) +
+				(asic->fd.vram >= 0) + (asic->fd.gprwave >= 0) + (asic->fd.gpr >= 0) +
+				(asic->fd.wave >= 0) + (asic->fd.iova >= 0) + (asic->fd.iomem >= 0) +
+				(asic->fd.gfxoff >= 0), 0);
+			umr_timing_end(UMR_TIMING_DEBUGFS);
 		} else {
 			// no files open!
 			asic->fd.mmio2 = -1;
@@ -362,106 +355,43 @@ struct umr_asic *umr_discover_asic(struct umr_options *options, umr_err_output e
 			asic->fd.gfxoff = -1;
 		}
 
-		if (options->use_pci) {
-			// init PCI mapping
-			int use_region;
-			void *pcimem_v;
+		// the register BAR alone is mapped through sysfs on first use (see
+		// umr_pci_regs()), libpciaccess is only needed for the VRAM BAR,
+		// to enable the device without a kernel driver or to find it by DID
+		if (options->use_vram_bar || (options->use_pci && (options->no_kernel || !options->pci.name[0]))) {
 			struct pci_device_iterator *pci_iter;
-			pciaddr_t pci_region_addr;
 
-			pci_system_init();
-			pci_iter = pci_id_match_iterator_create(NULL);
-			if (!pci_iter) {
-				errout("[ERROR]: Cannot create PCI iterator");
+			if (umr_pci_system_get()) {
+				errout("[ERROR]: Cannot initialize libpciaccess\n");
 				goto err_pci;
 			}
-			do {
-				asic->pci.pdevice = pci_device_next(pci_iter);
-				if (options->pci.domain || options->pci.bus || options->pci.slot || options->pci.func) {
-					while (asic->pci.pdevice && (
-						options->pci.domain != asic->pci.pdevice->domain ||
-						options->pci.bus != asic->pci.pdevice->bus ||
-						options->pci.slot != asic->pci.pdevice->dev ||
-						options->pci.func != asic->pci.pdevice->func)) {
-						asic->pci.pdevice = pci_device_next(pci_iter);
-					}
-
-					// indicate we found an exact match for the pci bus/slot
-					// this is used because NPI use cases won't have names to
-					// match against in is_did_match()
-					if (asic->pci.pdevice)
-						busmatch = 1;
+			if (options->pci.domain || options->pci.bus || options->pci.slot || options->pci.func) {
+				asic->pci.pdevice = pci_device_find_by_slot(options->pci.domain, options->pci.bus,
+									    options->pci.slot, options->pci.func);
+			} else {
+				pci_iter = pci_id_match_iterator_create(NULL);
+				if (!pci_iter) {
+					umr_pci_system_put();
+					errout("[ERROR]: Cannot create PCI iterator");
+					goto err_pci;
 				}
-			} while (asic->pci.pdevice && !(busmatch || (asic->pci.pdevice->vendor_id == 0x1002 && is_did_match(asic, asic->pci.pdevice->device_id))));
+				do {
+					asic->pci.pdevice = pci_device_next(pci_iter);
+				} while (asic->pci.pdevice && !(asic->pci.pdevice->vendor_id == 0x1002 && is_did_match(asic, asic->pci.pdevice->device_id)));
+				pci_iterator_destroy(pci_iter);
+			}
 
 			if (!asic->pci.pdevice) {
+				umr_pci_system_put();
 				errout("[ERROR]: Could not find ASIC with DID of %04lx\n", (unsigned long)asic->did);
 				goto err_pci;
 			}
-			pci_iterator_destroy(pci_iter);
 
 			// enable device if kernel module isn't present
 			if (asic->options.no_kernel)
 				pci_device_enable(asic->pci.pdevice);
 
 			pci_device_probe(asic->pci.pdevice);
-
-			use_region = 6;
-			// try to detect based on ASIC family
-			if (asic->family <= FAMILY_SI) {
-				// try region 2 for SI
-				if (asic->pci.pdevice->regions[2].is_64 == 0 &&
-					asic->pci.pdevice->regions[2].is_prefetchable == 0 &&
-					asic->pci.pdevice->regions[2].is_IO == 0) {
-						use_region = 2;
-				}
-			} else if (asic->family <= FAMILY_VI) {
-				// try region 5 for CIK..VI
-				if (asic->pci.pdevice->regions[5].is_64 == 0 &&
-					asic->pci.pdevice->regions[5].is_prefetchable == 0 &&
-					asic->pci.pdevice->regions[5].is_IO == 0) {
-						use_region = 5;
-				}
-			}
-
-			// scan for a region 256K <= X <= 4096K which is 32-bit, non IO, non prefetchable
-			// manually scan because a lot of distro ship with a buggy libpciaccess
-			if (use_region == 6) {
-				// open /sys/bus/pci/devices/${pciaddr}/resource
-				uint64_t lowaddr, highaddr, size, flags;
-				char linebuf[512];
-				FILE *res;
-				sprintf(linebuf, "/sys/bus/pci/devices/%04"PRIx32":%02"PRIx32":%02"PRIx32".%d/resource",
-					(uint32_t)asic->pci.pdevice->domain,
-					(uint32_t)asic->pci.pdevice->bus,
-					(uint32_t)asic->pci.pdevice->dev,
-					(int)asic->pci.pdevice->func);
-				res = fopen(linebuf, "r");
-				if (res) {
-					use_region = 0;
-					while (fgets(linebuf, sizeof linebuf, res)) {
-						sscanf(linebuf, "0x%"PRIx64" 0x%"PRIx64" 0x%"PRIx64, &lowaddr, &highaddr, &flags);
-						size = highaddr - lowaddr + 1;
-						if (size >= (256 * 1024ULL) && size <= (4096 * 1024ULL) && !(flags & (1|4|8)))
-							break;
-						++use_region;
-					}
-					fclose(res);
-				}
-			}
-
-			if (use_region >= 6) {
-				errout("[ERROR]: Could not find PCI region (debugfs mode might still work)\n");
-				goto err_pci;
-			}
-			asic->pci.region = use_region;
-
-			pci_region_addr = asic->pci.pdevice->regions[use_region].base_addr;
-			if (pci_device_map_range(asic->pci.pdevice, pci_region_addr, asic->pci.pdevice->regions[use_region].size, PCI_DEV_MAP_FLAG_WRITABLE, &pcimem_v)) {
-				errout("[ERROR]: Could not map PCI memory\n");
-				goto err_pci;
-			}
-			asic->pci.mem = pcimem_v;
 		}
 	}
 
@@ -474,3 +404,30 @@ err_pci:
 	return NULL;
 }
 
+/**
+ * umr_discover_asic - Search for an ASIC in the system
+ *
+ * @options: The ASIC options that control how an ASIC is found and are bound to the structure once found.
+ * @errout:  Error output function pointer to handle error messages.
+ *
+ * This function searches for an ASIC based on the provided options. It can discover the ASIC by:
+ * - Virtual device if @options->dev_name starts with a '.'.
+ * - PCI bus address specified in @options->pci.
+ * - DRI instance specified in @options->instance.
+ * - Device name specified in @options->dev_name.
+ *
+ * The function handles various scenarios such as checking for the presence of the amdgpu kernel module,
+ * reading device IDs, and mapping PCI memory if necessary.
+ *
+ * @return A pointer to the discovered ASIC structure on success, or NULL on failure.
+ */
+struct umr_asic *umr_discover_asic(struct umr_options *options, umr_err_output errout)
+{
+	struct umr_asic *asic;
+
+	umr_timing_begin(UMR_TIMING_DISCOVER);
+	asic = discover_asic(options, errout);
+	umr_timing_end(UMR_TIMING_DISCOVER);
+	return asic;
+}
+
@@ -25,13 +25,114 @@
 #include "umr.h"
 #include <sys/types.h>
 #include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <ctype.h>
+
+#define UMR_ENUM_THREADS 16
+
+struct enum_job {
+	umr_err_output errout;
+	const char *database_path;
+	struct umr_options *global_options;
+	struct umr_options *options;    // what every device is discovered with
+	int xgmi_scan;
+	int n, next;
+	char (*names)[32];          // PCI bus addresses in readdir() order
+	struct umr_asic **asics;    // asics[i] is the device of names[i] or NULL
+};
+
+/*
+ * discover_device - Discover the device at PCI bus address @name
+ *
+ * @options is the worker's copy of job->options, only the fields that
+ * discovery changes are reset from it for each device.
+ *
+ * Returns the asic with its startup_timing and DID filled in, or NULL if
+ * it could not be discovered.
+ */
+static struct umr_asic *discover_device(struct enum_job *job, struct umr_options *options, const char *name)
+{
+	struct umr_timing start;
+	struct umr_asic *asic;
+	char devicepath[512];
+	FILE *f;
+
+	options->instance = job->options->instance;
+	options->is_virtual = job->options->is_virtual;
+	options->pci = job->options->pci;
+	if (sscanf(name, "%04x:%02x:%02x.%01x",
+			&options->pci.domain, &options->pci.bus, &options->pci.slot,
+			&options->pci.func) != 4)
+		return NULL;
+
+	// we found a PCI bus address
+	umr_timing_get_thread(&start);
+	asic = umr_discover_asic(options, job->errout);
+	if (!asic)
+		return NULL;
+
+	umr_scan_config(asic, job->xgmi_scan);
+	umr_timing_get_thread(&asic->startup_timing);
+	umr_timing_sub(&asic->startup_timing, &start);
+
+	// grab the DID
+	sprintf(devicepath, "/sys/bus/pci/drivers/amdgpu/%s/device", name);
+	f = fopen(devicepath, "r");
+	if (f) {
+		if (fscanf(f, "%x", &asic->did) != 1) {
+			job->errout("[ERROR]: Could not read device DID from %s\n", devicepath);
+		}
+		fclose(f);
+	} else {
+		job->errout("[ERROR]: Could not open 'device' file for enumeration path=<%s>\n", devicepath);
+	}
+
+	// devices are discovered one at a time while writing a test vector
+	if (options->test_log && options->test_log_fd && !options->test_log_bin) {
+		fprintf(options->test_log_fd, "-----\n");
+	}
+	return asic;
+}
+
+static void *enum_worker(void *arg)
+{
+	struct enum_job *job = arg;
+	struct umr_options *options;
+	int i;
+
+	options = malloc(sizeof *options);
+	if (!options)
+		return NULL;
+	*options = *job->options;
+	while ((i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->n)
+		job->asics[i] = discover_device(job, options, job->names[i]);
+	free(options);
+	return NULL;
+}
+
+// the per device discovery only touches files of its own device and
+// the shared register database unless it uses libpciaccess (not thread
+// safe, needed for the VRAM BAR) or writes a test vector, the register
+// BAR of use_pci is only mapped on first use
+static int can_enumerate_parallel(struct umr_options *global_options)
+{
+	return !global_options ||
+	       (!global_options->use_vram_bar &&
+		!global_options->test_log && !global_options->no_kernel);
+}
 
 /**
  * @brief Enumerates AMD GPU devices and populates a list of ASIC structures.
  *
  * This function scans the PCI bus for AMD GPU devices under the `/sys/bus/pci/drivers/amdgpu` path,
  * creates an ASIC structure for each device found, and stores them in a dynamically allocated array.
- * The number of discovered ASICs is returned via the `no_asics` parameter.
+ * The number of discovered ASICs is returned via the `no_asics` parameter.  The startup phases
+ * spent on each device are recorded in its `startup_timing`.
+ *
+ * The devices are discovered concurrently on up to UMR_ENUM_THREADS threads
+ * (the register database is shared by identical parts), the list is in
+ * the same order as a serial scan would produce.
  *
  * @param errout A function pointer to handle error output messages.
  * @param database_path Path to the UMR database used for ASIC discovery.
@@ -43,8 +144,10 @@
  */
 int umr_enumerate_device_list(umr_err_output errout, const char *database_path, struct umr_options *global_options, struct umr_asic ***asics, int *no_asics, int xgmi_scan)
 {
-	struct umr_options options;
-	int x;
+	struct enum_job job;
+	pthread_t workers[UMR_ENUM_THREADS];
+	int i, x, no_workers;
+	long cpus;
 	DIR *dir;
 	struct dirent *de;
 
@@ -59,50 +162,174 @@ int umr_enumerate_device_list(umr_err_output errout, const char *database_path,
 
 	*asics = calloc(256, sizeof *asics); // allocate enough pointers for upto 128 devices
 
-	x = 0;
-	while (x < 256 && (de  = readdir(dir))) {
-		memset(&options, 0, sizeof options);
-		if (global_options)
-			options = *global_options;
-		options.quiet = 1;
-		strncpy(options.database_path, database_path, sizeof(options.database_path) - 1);
-		if (sscanf(de->d_name, "%04x:%02x:%02x.%01x",
-				&options.pci.domain, &options.pci.bus, &options.pci.slot,
-				&options.pci.func) == 4) {
-			// we found a PCI bus address
-			(*asics)[x] = umr_discover_asic(&options, errout);
-			if ((*asics)[x]) {
-				char devicepath[512];
-				FILE *f;
-
-				umr_scan_config((*asics)[x], xgmi_scan);
-
-				// grab the DID
-				sprintf(devicepath, "/sys/bus/pci/drivers/amdgpu/%s/device", de->d_name);
-				f = fopen(devicepath, "r");
-				if (f) {
-					if (fscanf(f, "%x", &((*asics)[x]->did)) != 1) {
-						errout("[ERROR]: Could not read device DID from %s\n", devicepath);
-					}
-					fclose(f);
-				} else {
-					errout("[ERROR]: Could not open 'device' file for enumeration path=<%s>\n", devicepath);
-				}
-
-				++x;
-
-				if (global_options && global_options->test_log && global_options->test_log_fd) {
-					fprintf(global_options->test_log_fd, "-----\n");
-				}
-			}
-		}
+	memset(&job, 0, sizeof job);
+	job.errout = errout;
+	job.database_path = database_path;
+	job.global_options = global_options;
+	job.xgmi_scan = xgmi_scan;
+	job.names = calloc(256, sizeof *job.names);
+	job.asics = calloc(256, sizeof *job.asics);
+	job.options = calloc(1, sizeof *job.options);
+	if (!*asics || !job.names || !job.asics || !job.options) {
+		closedir(dir);
+		free(job.names);
+		free(job.asics);
+		free(job.options);
+		free(*asics);
+		*asics = NULL;
+		errout("[ERROR]: Out of memory\n");
+		return -1;
+	}
+
+	// device entries are the links named after their PCI bus address
+	while (job.n < 256 && (de = readdir(dir))) {
+		unsigned domain, bus, slot, func;
+		// skip names too long to be a bus address
+		if (sscanf(de->d_name, "%04x:%02x:%02x.%01x", &domain, &bus, &slot, &func) == 4 &&
+		    snprintf(job.names[job.n], sizeof job.names[0], "%s", de->d_name) < (int)sizeof job.names[0])
+			++job.n;
 	}
 	closedir(dir);
+
+	if (global_options)
+		*job.options = *global_options;
+	job.options->quiet = 1;
+	strncpy(job.options->database_path, database_path, sizeof(job.options->database_path) - 1);
+
+	no_workers = job.n < UMR_ENUM_THREADS ? job.n : UMR_ENUM_THREADS;
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpus > 0 && no_workers > cpus)
+		no_workers = cpus;
+	if (!can_enumerate_parallel(global_options))
+		no_workers = 1;
+
+	// the calling thread is one of the workers
+	for (i = 1; i < no_workers; i++)
+		if (pthread_create(&workers[i], NULL, enum_worker, &job))
+			break;
+	no_workers = i;
+	enum_worker(&job);
+	for (i = 1; i < no_workers; i++)
+		pthread_join(workers[i], NULL);
+
+	for (i = x = 0; i < job.n; i++)
+		if (job.asics[i])
+			(*asics)[x++] = job.asics[i];
+	free(job.names);
+	free(job.asics);
+	free(job.options);
 	*no_asics = x;
 
 	return 0;
 }
 
+/*
+ * dri_instance - The DRI instance of the device at PCI bus address @name
+ *
+ * The same instance umr_discover_asic() picks: an amdgpu debugfs
+ * directory (not a render node) whose name file gives @name, the one
+ * with IP discovery if there are several.
+ */
+static int dri_instance(DIR *dri, const char *name)
+{
+	struct dirent *de;
+	char path[512], device[256];
+	int inst, found = -1;
+	FILE *f;
+
+	rewinddir(dri);
+	while ((de = readdir(dri))) {
+		if (!isdigit(de->d_name[0]) || (inst = atoi(de->d_name)) >= 128)
+			continue;
+		snprintf(path, sizeof path, "/sys/kernel/debug/dri/%s/amdgpu_regs2", de->d_name);
+		if (access(path, F_OK))
+			continue;
+		snprintf(path, sizeof path, "/sys/kernel/debug/dri/%s/name", de->d_name);
+		f = fopen(path, "r");
+		if (!f)
+			continue;
+		if (fscanf(f, "%*s %255s", device) != 1) {
+			fclose(f);
+			continue;
+		}
+		fclose(f);
+		if (strcmp(device + (strncmp(device, "dev=", 4) ? 0 : 4), name))
+			continue;
+		found = inst;
+		snprintf(path, sizeof path, "/sys/class/drm/card%d/device/ip_discovery/die/0/num_ips", inst);
+		if (!access(path, F_OK))
+			break;
+	}
+	return found;
+}
+
+/**
+ * umr_enumerate_device_ids - List the AMDGPU devices without discovering them
+ *
+ * @errout: Where errors go
+ * @ids: Receives the devices (to be freed with free()) in the order
+ *       umr_enumerate_device_list() lists them
+ * @no_ids: Receives the number of devices
+ *
+ * Only the PCI bus address, DID and DRI instance of each device are read,
+ * no IP blocks or register databases are loaded and nothing is opened
+ * besides a few sysfs and debugfs files.  The instance is -1 if debugfs
+ * is not available.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+int umr_enumerate_device_ids(umr_err_output errout, struct umr_device_id **ids, int *no_ids)
+{
+	struct umr_device_id *id, *t;
+	struct dirent *de;
+	DIR *dir, *dri;
+	char path[512];
+	int n = 0;
+	FILE *f;
+
+	*ids = NULL;
+	*no_ids = 0;
+
+	dir = opendir("/sys/bus/pci/drivers/amdgpu");
+	if (!dir) {
+		errout("[ERROR]: Cannot open path /sys/bus/pci/drivers/amdgpu to enumerate devices.\n");
+		return -1;
+	}
+	dri = opendir("/sys/kernel/debug/dri");
+
+	while ((de = readdir(dir))) {
+		unsigned domain, bus, slot, func;
+		if (sscanf(de->d_name, "%04x:%02x:%02x.%01x", &domain, &bus, &slot, &func) != 4)
+			continue;
+		t = realloc(*ids, (n + 1) * sizeof *t);
+		if (!t) {
+			errout("[ERROR]: Out of memory\n");
+			break;
+		}
+		*ids = t;
+		id = &t[n];
+		memset(id, 0, sizeof *id);
+		// skip names too long to be a bus address
+		if (snprintf(id->pci_name, sizeof id->pci_name, "%s", de->d_name) >= (int)sizeof id->pci_name)
+			continue;
+		++n;
+		id->instance = dri ? dri_instance(dri, de->d_name) : -1;
+
+		snprintf(path, sizeof path, "/sys/bus/pci/drivers/amdgpu/%s/device", de->d_name);
+		f = fopen(path, "r");
+		if (f) {
+			if (fscanf(f, "%x", &id->did) != 1)
+				errout("[ERROR]: Could not read device DID from %s\n", path);
+			fclose(f);
+		}
+	}
+	if (dri)
+		closedir(dri);
+	closedir(dir);
+	*no_ids = n;
+	return 0;
+}
+
 void umr_enumerate_device_list_free(struct umr_asic **asics)
 {
 	int x;
@@ -0,0 +1,362 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+#include <time.h>
+#include <errno.h>
+
+/*
+ * The fence progress of the kernel rings comes from the debugfs file
+ * amdgpu_fence_info.  A tracker keeps the file open and re-reads it with
+ * pread() at offset 0, the text is parsed in one pass into an array of
+ * rings that is reused from one read to the next.  The tracker remembers
+ * when the last signaled fence of each ring moved so that rings with
+ * pending fences that make no progress can be told apart.
+ */
+
+#define FENCE_INFO_MIN_SIZE 4096
+
+struct umr_fence_tracker {
+	struct umr_asic *asic;
+	int fd;
+	char *buf;
+	int size;
+	struct umr_fence_snapshot last; // the previous read
+};
+
+static uint64_t fence_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// the value of a "Last ... 0x%08x" line
+static uint32_t fence_value(const char *line, const char *eol)
+{
+	const char *p = memchr(line, 'x', eol - line);
+
+	return p ? strtoul(p + 1, NULL, 16) : 0;
+}
+
+/**
+ * umr_fence_info_parse - Parse the text of amdgpu_fence_info
+ *
+ * @text: The contents of the file, NUL terminated
+ * @snap: Receives the rings, its array is reused (and grown) so that
+ *        parsing into the same snapshot again does not allocate
+ *
+ * Only the fences are filled in, snap->time_ns and the progress times are
+ * left to the caller.
+ *
+ * Returns the number of rings found or -1 if out of memory.
+ */
+int umr_fence_info_parse(const char *text, struct umr_fence_snapshot *snap)
+{
+	struct umr_ring_fence *r = NULL, *t;
+	const char *p, *eol, *name, *end;
+	int trailing = 0;
+	size_t len;
+
+	snap->no_rings = 0;
+	for (p = text; *p; p = *eol ? eol + 1 : eol) {
+		eol = strchr(p, '\n');
+		if (!eol)
+			eol = p + strlen(p);
+
+		if (!strncmp(p, "--- ring", 8)) {
+			if (snap->no_rings == snap->max_rings) {
+				t = realloc(snap->rings, (snap->max_rings * 2 + 8) * sizeof *t);
+				if (!t)
+					return -1;
+				snap->rings = t;
+				snap->max_rings = snap->max_rings * 2 + 8;
+			}
+			r = &snap->rings[snap->no_rings++];
+			memset(r, 0, sizeof *r);
+			name = memchr(p, '(', eol - p);
+			end = name ? memchr(name, ')', eol - name) : NULL;
+			if (name && end) {
+				len = end - name - 1;
+				if (len >= sizeof r->name)
+					len = sizeof r->name - 1;
+				memcpy(r->name, name + 1, len);
+			}
+			trailing = 0;
+		} else if (r && !strncmp(p, "Last ", 5)) {
+			// "Last emitted" follows the fence it belongs to
+			if (!strncmp(p + 5, "signaled fence", 14)) {
+				r->signaled = fence_value(p, eol);
+				trailing = 0;
+			} else if (!strncmp(p + 5, "signaled trailing fence", 23)) {
+				r->trailing_signaled = fence_value(p, eol);
+				r->has_trailing = 1;
+				trailing = 1;
+			} else if (!strncmp(p + 5, "emitted", 7)) {
+				if (trailing)
+					r->trailing_emitted = fence_value(p, eol);
+				else
+					r->emitted = fence_value(p, eol);
+			}
+		}
+	}
+	return snap->no_rings;
+}
+
+/**
+ * umr_fence_snapshot_find - Find a ring of a snapshot by name
+ *
+ * @snap: The snapshot
+ * @name: The ring, e.g. "gfx_0.0.0"
+ * @hint: Where to look first (the rings of two reads are in the same order)
+ *
+ * Returns the ring or NULL.
+ */
+struct umr_ring_fence *umr_fence_snapshot_find(const struct umr_fence_snapshot *snap, const char *name, int hint)
+{
+	int i;
+
+	if (hint >= 0 && hint < snap->no_rings && !strcmp(snap->rings[hint].name, name))
+		return &snap->rings[hint];
+	for (i = 0; i < snap->no_rings; i++)
+		if (!strcmp(snap->rings[i].name, name))
+			return &snap->rings[i];
+	return NULL;
+}
+
+/**
+ * umr_fence_snapshot_delta - The fence progress between two snapshots
+ *
+ * @before: The older snapshot
+ * @after: The newer snapshot
+ * @deltas: Receives one entry per ring of @after, in its order
+ *
+ * The fences are 32-bit sequence numbers, the deltas wrap with them.  A
+ * ring that is not in @before has no progress.
+ *
+ * Returns the number of entries stored.
+ */
+int umr_fence_snapshot_delta(const struct umr_fence_snapshot *before, const struct umr_fence_snapshot *after,
+			     struct umr_ring_fence_delta *deltas)
+{
+	const struct umr_ring_fence *a, *b;
+	int i;
+
+	for (i = 0; i < after->no_rings; i++) {
+		a = &after->rings[i];
+		b = umr_fence_snapshot_find(before, a->name, i);
+		deltas[i].name = a->name;
+		deltas[i].signaled = b ? a->signaled - b->signaled : 0;
+		deltas[i].emitted = b ? a->emitted - b->emitted : 0;
+		deltas[i].pending = a->emitted - a->signaled;
+	}
+	return after->no_rings;
+}
+
+/**
+ * umr_fence_snapshot_free - Free the rings of a snapshot
+ */
+void umr_fence_snapshot_free(struct umr_fence_snapshot *snap)
+{
+	free(snap->rings);
+	memset(snap, 0, sizeof *snap);
+}
+
+/**
+ * umr_fence_tracker_open - Open amdgpu_fence_info of a device
+ *
+ * @asic: The device
+ *
+ * Returns the tracker or NULL if the file can't be opened.
+ */
+struct umr_fence_tracker *umr_fence_tracker_open(struct umr_asic *asic)
+{
+	return umr_fence_tracker_open_instance(asic, asic->instance);
+}
+
+/**
+ * umr_fence_tracker_open_instance - Open amdgpu_fence_info of a DRI instance
+ *
+ * @asic: The device used for error messages
+ * @instance: The debugfs DRI instance, e.g. that of a VF bound to amdgpu
+ *            on the host
+ *
+ * Returns the tracker or NULL if the file can't be opened.
+ */
+struct umr_fence_tracker *umr_fence_tracker_open_instance(struct umr_asic *asic, int instance)
+{
+	struct umr_fence_tracker *ft;
+	char path[128];
+
+	ft = calloc(1, sizeof *ft);
+	if (!ft)
+		return NULL;
+	ft->asic = asic;
+	snprintf(path, sizeof path, "/sys/kernel/debug/dri/%d/amdgpu_fence_info", instance);
+	ft->fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (ft->fd < 0) {
+		free(ft);
+		return NULL;
+	}
+	return ft;
+}
+
+// read the whole file into ft->buf, growing it as needed
+static int fence_tracker_fill(struct umr_fence_tracker *ft)
+{
+	ssize_t r;
+	char *t;
+
+	if (!ft->buf) {
+		ft->buf = malloc(FENCE_INFO_MIN_SIZE);
+		if (!ft->buf)
+			return -1;
+		ft->size = FENCE_INFO_MIN_SIZE;
+	}
+	for (;;) {
+		do {
+			r = pread(ft->fd, ft->buf, ft->size - 1, 0);
+		} while (r < 0 && errno == EINTR);
+		if (r < 0)
+			return -1;
+		if (r < ft->size - 1)
+			break;
+		t = realloc(ft->buf, ft->size * 2);
+		if (!t)
+			return -1;
+		ft->buf = t;
+		ft->size *= 2;
+	}
+	ft->buf[r] = 0;
+	return 0;
+}
+
+/**
+ * umr_fence_tracker_read - Read the fence progress of every ring
+ *
+ * @ft: The tracker
+ * @snap: Receives the rings, zero it before the first read and release it
+ *        with umr_fence_snapshot_free()
+ *
+ * ->progress_ns of each ring is when the tracker last saw its signaled
+ * fence move, or now if it has no pending fences.
+ *
+ * Returns the number of rings or -1 on error.
+ */
+int umr_fence_tracker_read(struct umr_fence_tracker *ft, struct umr_fence_snapshot *snap)
+{
+	struct umr_ring_fence *r, *prev;
+	struct umr_fence_snapshot *last = &ft->last;
+	uint64_t now;
+	int i, n;
+
+	if (fence_tracker_fill(ft))
+		return -1;
+	now = fence_now_ns();
+	n = umr_fence_info_parse(ft->buf, snap);
+	if (n < 0)
+		return -1;
+	snap->time_ns = now;
+
+	for (i = 0; i < n; i++) {
+		r = &snap->rings[i];
+		prev = umr_fence_snapshot_find(last, r->name, i);
+		if (prev && prev->signaled == r->signaled && r->emitted != r->signaled)
+			r->progress_ns = prev->progress_ns;
+		else
+			r->progress_ns = now;
+	}
+
+	// keep a copy for the next read
+	if (last->max_rings < n) {
+		r = realloc(last->rings, n * sizeof *r);
+		if (!r)
+			return -1;
+		last->rings = r;
+		last->max_rings = n;
+	}
+	memcpy(last->rings, snap->rings, n * sizeof *r);
+	last->no_rings = n;
+	last->time_ns = now;
+	return n;
+}
+
+/**
+ * umr_fence_tracker_poll - Wait for a ring to stop making progress
+ *
+ * @ft: The tracker
+ * @period_ns: Time between two reads of the file
+ * @stall_ns: How long a ring with pending fences must not signal any to
+ *            be reported
+ * @timeout_ns: How long to poll for, 0 for a single read
+ * @ringname: Receives the name of the stalled ring
+ * @size: Size of @ringname
+ *
+ * Returns 1 if a ring stalled, 0 if none did in time and -1 on error.
+ */
+int umr_fence_tracker_poll(struct umr_fence_tracker *ft, uint64_t period_ns, uint64_t stall_ns,
+			   uint64_t timeout_ns, char *ringname, int size)
+{
+	struct umr_fence_snapshot snap;
+	struct timespec ts;
+	uint64_t deadline;
+	int i, r = 0;
+
+	memset(&snap, 0, sizeof snap);
+	deadline = fence_now_ns() + timeout_ns;
+	for (;;) {
+		if (umr_fence_tracker_read(ft, &snap) < 0) {
+			r = -1;
+			break;
+		}
+		for (i = 0; i < snap.no_rings; i++)
+			if (snap.time_ns - snap.rings[i].progress_ns >= stall_ns &&
+			    snap.rings[i].emitted != snap.rings[i].signaled) {
+				snprintf(ringname, size, "%s", snap.rings[i].name);
+				r = 1;
+				break;
+			}
+		if (r || snap.time_ns >= deadline)
+			break;
+		ts.tv_sec = period_ns / 1000000000ULL;
+		ts.tv_nsec = period_ns % 1000000000ULL;
+		nanosleep(&ts, NULL);
+	}
+	umr_fence_snapshot_free(&snap);
+	return r;
+}
+
+/**
+ * umr_fence_tracker_close - Close a tracker opened by umr_fence_tracker_open()
+ */
+void umr_fence_tracker_close(struct umr_fence_tracker *ft)
+{
+	if (!ft)
+		return;
+	close(ft->fd);
+	free(ft->buf);
+	umr_fence_snapshot_free(&ft->last);
+	free(ft);
+}
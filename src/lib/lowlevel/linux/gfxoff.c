@@ -22,13 +22,15 @@
  *
  */
 #include "umrapp.h"
+#include <pthread.h>
+#include <time.h>
 
 void umr_gfxoff_read(struct umr_asic *asic)
 {
 	uint32_t value = 0xff;
 	if (strcmp(asic->asicname, "renoir") == 0) {
 		lseek(asic->fd.gfxoff, 0, SEEK_SET);
-		if (read(asic->fd.gfxoff, &value, sizeof(uint32_t)) < 0) {
+		if (umr_io_read(asic, UMR_IO_OTHER, asic->fd.gfxoff, &value, sizeof(uint32_t)) < 0) {
 			asic->err_msg("[ERROR]: Could not read from GFXOFF status\n");
 		} else {
 			printf("gfxoff status : %s \n", (value == 0)?"enable":"disable");
@@ -37,3 +39,185 @@ void umr_gfxoff_read(struct umr_asic *asic)
 		asic->err_msg("[ERROR]: can't check gfxoff status on this asic\n");
 	}
 }
+
+/*
+ * GFXOFF is disabled for as long as someone holds it.  When the last
+ * hold is released it is enabled again after the linger time (on a
+ * thread of its own) so a batch of commands that each take a hold powers
+ * the GFX block up once instead of once per command.
+ */
+struct umr_gfxoff_guard {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_t thread;
+	int running, stop;
+	int holds;
+	int disabled;               // what was last written to amdgpu_gfxoff
+	uint64_t linger_ns;
+	uint64_t idle_since_ns;     // when holds dropped to 0
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void gfxoff_write(struct umr_asic *asic, uint32_t value)
+{
+	if (write(asic->fd.gfxoff, &value, sizeof(value)) != sizeof(value))
+		asic->err_msg("[ERROR]: Could not write to GFXOFF control\n");
+}
+
+static struct umr_gfxoff_guard *get_guard(struct umr_asic *asic)
+{
+	struct umr_gfxoff_guard *g;
+
+	if (!asic->gfxoff_guard) {
+		g = calloc(1, sizeof *g);
+		if (!g)
+			return NULL;
+		pthread_mutex_init(&g->lock, NULL);
+		pthread_cond_init(&g->cond, NULL);
+		asic->gfxoff_guard = g;
+	}
+	return asic->gfxoff_guard;
+}
+
+// enables GFXOFF once it has been released for the linger time
+static void *linger_thread(void *arg)
+{
+	struct umr_asic *asic = arg;
+	struct umr_gfxoff_guard *g = asic->gfxoff_guard;
+	struct timespec ts;
+	uint64_t now, left;
+
+	pthread_mutex_lock(&g->lock);
+	while (!g->stop) {
+		if (g->disabled && !g->holds) {
+			now = now_ns();
+			if (now - g->idle_since_ns >= g->linger_ns) {
+				gfxoff_write(asic, 1);
+				g->disabled = 0;
+				continue;
+			}
+			left = g->linger_ns - (now - g->idle_since_ns);
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_sec += left / 1000000000ULL;
+			ts.tv_nsec += left % 1000000000ULL;
+			if (ts.tv_nsec >= 1000000000L) {
+				ts.tv_nsec -= 1000000000L;
+				++ts.tv_sec;
+			}
+			pthread_cond_timedwait(&g->cond, &g->lock, &ts);
+		} else {
+			pthread_cond_wait(&g->cond, &g->lock);
+		}
+	}
+	pthread_mutex_unlock(&g->lock);
+	return NULL;
+}
+
+/**
+ * umr_gfxoff_set_linger - Set how long GFXOFF stays disabled after the last release
+ *
+ * @asic: The device
+ * @linger_ns: The linger time, 0 (the default) enables GFXOFF as soon as
+ *             the last hold is released
+ */
+void umr_gfxoff_set_linger(struct umr_asic *asic, uint64_t linger_ns)
+{
+	struct umr_gfxoff_guard *g = get_guard(asic);
+
+	if (!g)
+		return;
+	pthread_mutex_lock(&g->lock);
+	g->linger_ns = linger_ns;
+	pthread_cond_signal(&g->cond);
+	pthread_mutex_unlock(&g->lock);
+}
+
+/**
+ * umr_gfxoff_hold - Keep GFXOFF disabled until umr_gfxoff_release()
+ *
+ * @asic: The device
+ *
+ * Holds nest (and may be taken by several threads), GFXOFF is only
+ * written when it is not already disabled.  Does nothing if the device
+ * has no amdgpu_gfxoff control.
+ */
+void umr_gfxoff_hold(struct umr_asic *asic)
+{
+	struct umr_gfxoff_guard *g;
+
+	if (asic->fd.gfxoff < 0 || !(g = get_guard(asic)))
+		return;
+	pthread_mutex_lock(&g->lock);
+	if (!g->holds++ && !g->disabled) {
+		gfxoff_write(asic, 0);
+		g->disabled = 1;
+	}
+	pthread_mutex_unlock(&g->lock);
+}
+
+/**
+ * umr_gfxoff_release - Drop a hold taken with umr_gfxoff_hold()
+ *
+ * @asic: The device
+ *
+ * GFXOFF is enabled again when the last hold is dropped, after the linger
+ * time if one was set with umr_gfxoff_set_linger().
+ */
+void umr_gfxoff_release(struct umr_asic *asic)
+{
+	struct umr_gfxoff_guard *g = asic->gfxoff_guard;
+
+	if (asic->fd.gfxoff < 0 || !g)
+		return;
+	pthread_mutex_lock(&g->lock);
+	if (g->holds && !--g->holds && g->disabled) {
+		if (!g->linger_ns) {
+			gfxoff_write(asic, 1);
+			g->disabled = 0;
+		} else {
+			g->idle_since_ns = now_ns();
+			if (!g->running && !pthread_create(&g->thread, NULL, linger_thread, asic))
+				g->running = 1;
+			if (g->running) {
+				pthread_cond_signal(&g->cond);
+			} else {
+				gfxoff_write(asic, 1);
+				g->disabled = 0;
+			}
+		}
+	}
+	pthread_mutex_unlock(&g->lock);
+}
+
+/**
+ * umr_gfxoff_guard_free - Stop the linger thread and enable GFXOFF if it is still disabled
+ *
+ * Called before the amdgpu_gfxoff control is closed.
+ */
+void umr_gfxoff_guard_free(struct umr_asic *asic)
+{
+	struct umr_gfxoff_guard *g = asic->gfxoff_guard;
+
+	if (!g)
+		return;
+	if (g->running) {
+		pthread_mutex_lock(&g->lock);
+		g->stop = 1;
+		pthread_cond_signal(&g->cond);
+		pthread_mutex_unlock(&g->lock);
+		pthread_join(g->thread, NULL);
+	}
+	if (g->disabled && asic->fd.gfxoff >= 0)
+		gfxoff_write(asic, 1);
+	pthread_cond_destroy(&g->cond);
+	pthread_mutex_destroy(&g->lock);
+	free(g);
+	asic->gfxoff_guard = NULL;
+}
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+#include <pthread.h>
+#if defined(__unix__)
+#include <sys/mman.h>
+#endif
+
+/*
+ * The register tables of a full database load and the lookup tables built
+ * over them are hundreds of thousands of small objects that are walked by
+ * every lookup, decode and sample.  Allocated one by one they are spread
+ * over thousands of 4K pages.  umr_huge_alloc() carves them out of 2MB
+ * slabs instead and maps every slab on a huge page: from the hugetlbfs
+ * pool if the administrator reserved one (MAP_HUGETLB), otherwise as a
+ * 2MB aligned mapping advised for transparent huge pages.  Allocations of
+ * half a slab or more get a mapping of their own the same way.
+ *
+ * Slab memory is never reused, a slab is unmapped once everything carved
+ * from it has been freed.  umr_huge_free() also takes memory that came
+ * from calloc() (the fallback when mapping fails, or tables built
+ * elsewhere) so the callers don't need to know where a table came from.
+ */
+
+#define HUGE_PAGE_SIZE (2UL * 1024 * 1024)
+#define HUGE_DIRECT_MIN (HUGE_PAGE_SIZE / 2)
+
+struct huge_region {
+	struct huge_region *next;
+	char *base;
+	size_t size, used;          // used is the bump offset of a slab
+	unsigned long live;         // allocations not freed yet
+};
+
+static pthread_mutex_t huge_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct huge_region *huge_regions, *huge_slab;
+static int huge_no_hugetlb;     // MAP_HUGETLB failed once, don't try again
+
+#if defined(__unix__)
+// @size bytes (a multiple of HUGE_PAGE_SIZE) on huge pages if possible
+static void *huge_map(size_t size)
+{
+	char *p, *a;
+
+#ifdef MAP_HUGETLB
+	if (!huge_no_hugetlb) {
+		p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (p != MAP_FAILED)
+			return p;
+		huge_no_hugetlb = 1;
+	}
+#endif
+
+	// over map so a 2MB aligned range can be kept, THP needs the alignment
+	p = mmap(NULL, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		return NULL;
+	a = (char *)(((uintptr_t)p + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+	if (a > p)
+		munmap(p, a - p);
+	munmap(a + size, p + HUGE_PAGE_SIZE - a);
+#ifdef MADV_HUGEPAGE
+	madvise(a, size, MADV_HUGEPAGE);
+#endif
+	return a;
+}
+
+static void huge_unmap(void *p, size_t size)
+{
+	munmap(p, size);
+}
+#else
+static void *huge_map(size_t size)
+{
+	(void)huge_no_hugetlb;
+	return NULL;
+}
+
+static void huge_unmap(void *p, size_t size)
+{
+}
+#endif
+
+static struct huge_region *huge_region_new(size_t size)
+{
+	struct huge_region *r;
+
+	r = calloc(1, sizeof *r);
+	if (!r)
+		return NULL;
+	r->size = (size + HUGE_PAGE_SIZE - 1) & ~(size_t)(HUGE_PAGE_SIZE - 1);
+	r->base = huge_map(r->size);
+	if (!r->base) {
+		free(r);
+		return NULL;
+	}
+	r->next = huge_regions;
+	huge_regions = r;
+	return r;
+}
+
+/**
+ * umr_huge_alloc - Allocate zeroed memory for a long lived table or a large buffer
+ *
+ * @size: Number of bytes
+ *
+ * The memory is 16 byte aligned and comes from a slab on huge pages
+ * (or, if it is large, from a huge page mapping of its own).  It falls
+ * back to calloc() when no mapping can be made.  Free it with
+ * umr_huge_free().
+ *
+ * Returns the memory or NULL if out of memory.
+ */
+void *umr_huge_alloc(size_t size)
+{
+	struct huge_region *r;
+	void *p = NULL;
+
+	size = size ? (size + 15) & ~(size_t)15 : 16;
+	pthread_mutex_lock(&huge_lock);
+	if (size >= HUGE_DIRECT_MIN) {
+		r = huge_region_new(size);
+		if (r) {
+			r->used = r->size;
+			r->live = 1;
+			p = r->base;
+		}
+	} else {
+		if (!huge_slab || huge_slab->used + size > huge_slab->size)
+			huge_slab = huge_region_new(HUGE_PAGE_SIZE);
+		if (huge_slab) {
+			p = huge_slab->base + huge_slab->used;
+			huge_slab->used += size;
+			++huge_slab->live;
+		}
+	}
+	pthread_mutex_unlock(&huge_lock);
+	return p ? p : calloc(1, size);
+}
+
+/**
+ * umr_huge_free - Free memory from umr_huge_alloc()
+ *
+ * @p: The memory, may be NULL or come from calloc()/malloc()
+ */
+void umr_huge_free(void *p)
+{
+	struct huge_region *r, **pr;
+
+	if (!p)
+		return;
+	pthread_mutex_lock(&huge_lock);
+	for (pr = &huge_regions; (r = *pr); pr = &r->next)
+		if ((char *)p >= r->base && (char *)p < r->base + r->size)
+			break;
+	if (r && !--r->live) {
+		*pr = r->next;
+		if (r == huge_slab)
+			huge_slab = NULL;
+		huge_unmap(r->base, r->size);
+		free(r);
+	}
+	pthread_mutex_unlock(&huge_lock);
+	if (!r)
+		free(p);
+}
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <time.h>
+
+/*
+ * Counters of the syscalls made for an asic.  They are always on, a
+ * call costs one clock_gettime() (a vDSO call) and a few relaxed atomic
+ * adds on top of the syscall itself, and threads scanning the same asic
+ * may update them concurrently.
+ */
+
+static const char *class_names[UMR_IO_MAX] = {
+	"mmio",
+	"vram",
+	"iomem",
+	"gprwave",
+	"sensors",
+	"rumr",
+	"other",
+};
+
+uint64_t umr_io_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * umr_io_account - Count one syscall
+ * @asic: The device the call was made for, may be NULL
+ * @cls: What kind of file it went to
+ * @op: Read, write or ioctl
+ * @bytes: What the call returned, negative values (errors) count as 0 bytes
+ * @ns: Time spent in the call
+ */
+void umr_io_account(struct umr_asic *asic, enum umr_io_class cls, enum umr_io_op op, int64_t bytes, uint64_t ns)
+{
+	if (!asic || cls >= UMR_IO_MAX)
+		return;
+	if (bytes < 0)
+		bytes = 0;
+	switch (op) {
+	case UMR_IO_READ:
+		__atomic_fetch_add(&asic->io_stats.cls[cls].reads, 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&asic->io_stats.cls[cls].bytes_read, bytes, __ATOMIC_RELAXED);
+		break;
+	case UMR_IO_WRITE:
+		__atomic_fetch_add(&asic->io_stats.cls[cls].writes, 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&asic->io_stats.cls[cls].bytes_written, bytes, __ATOMIC_RELAXED);
+		break;
+	case UMR_IO_IOCTL:
+		__atomic_fetch_add(&asic->io_stats.cls[cls].ioctls, 1, __ATOMIC_RELAXED);
+		break;
+	}
+	__atomic_fetch_add(&asic->io_stats.cls[cls].ns, ns, __ATOMIC_RELAXED);
+}
+
+/**
+ * umr_io_class_of_fd - Which class a file descriptor of @asic belongs to
+ *
+ * For callers handed a bare descriptor (e.g. umr_uring_submit()), files
+ * that are not one of asic->fd or of the access context bound on this
+ * thread are UMR_IO_OTHER.
+ */
+enum umr_io_class umr_io_class_of_fd(struct umr_asic *asic, int fd)
+{
+	struct umr_access_ctx *ctx;
+
+	if (fd < 0)
+		return UMR_IO_OTHER;
+	// the files an access context reopened for its thread
+	ctx = umr_access_ctx_current(asic);
+	if (ctx) {
+		if (fd == ctx->fd_mmio2)
+			return UMR_IO_MMIO;
+		if (fd == ctx->fd_gprwave)
+			return UMR_IO_GPRWAVE;
+	}
+	if (fd == asic->fd.mmio || fd == asic->fd.mmio2 || fd == asic->fd.pcie ||
+	    fd == asic->fd.smc || fd == asic->fd.didt)
+		return UMR_IO_MMIO;
+	if (fd == asic->fd.vram)
+		return UMR_IO_VRAM;
+	if (fd == asic->fd.iomem || fd == asic->fd.iova ||
+	    (asic->proc_mem.pid && fd == asic->proc_mem.fd))
+		return UMR_IO_IOMEM;
+	if (fd == asic->fd.gprwave || fd == asic->fd.gpr || fd == asic->fd.wave)
+		return UMR_IO_GPRWAVE;
+	if (fd == asic->fd.sensors)
+		return UMR_IO_SENSORS;
+	return UMR_IO_OTHER;
+}
+
+ssize_t umr_io_read(struct umr_asic *asic, enum umr_io_class cls, int fd, void *buf, size_t size)
+{
+	uint64_t t = umr_io_now();
+	ssize_t r = read(fd, buf, size);
+
+	umr_io_account(asic, cls, UMR_IO_READ, r, umr_io_now() - t);
+	return r;
+}
+
+ssize_t umr_io_write(struct umr_asic *asic, enum umr_io_class cls, int fd, const void *buf, size_t size)
+{
+	uint64_t t = umr_io_now();
+	ssize_t r = write(fd, buf, size);
+
+	umr_io_account(asic, cls, UMR_IO_WRITE, r, umr_io_now() - t);
+	return r;
+}
+
+ssize_t umr_io_pread(struct umr_asic *asic, enum umr_io_class cls, int fd, void *buf, size_t size, off_t offset)
+{
+	uint64_t t = umr_io_now();
+	ssize_t r = pread(fd, buf, size, offset);
+
+	umr_io_account(asic, cls, UMR_IO_READ, r, umr_io_now() - t);
+	return r;
+}
+
+ssize_t umr_io_pwrite(struct umr_asic *asic, enum umr_io_class cls, int fd, const void *buf, size_t size, off_t offset)
+{
+	uint64_t t = umr_io_now();
+	ssize_t r = pwrite(fd, buf, size, offset);
+
+	umr_io_account(asic, cls, UMR_IO_WRITE, r, umr_io_now() - t);
+	return r;
+}
+
+ssize_t umr_io_preadv(struct umr_asic *asic, enum umr_io_class cls, int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+	uint64_t t = umr_io_now();
+	ssize_t r = preadv(fd, iov, iovcnt, offset);
+
+	umr_io_account(asic, cls, UMR_IO_READ, r, umr_io_now() - t);
+	return r;
+}
+
+int umr_io_ioctl(struct umr_asic *asic, enum umr_io_class cls, int fd, unsigned long request, void *arg)
+{
+	uint64_t t = umr_io_now();
+	int r = ioctl(fd, request, arg);
+
+	umr_io_account(asic, cls, UMR_IO_IOCTL, 0, umr_io_now() - t);
+	return r;
+}
+
+/**
+ * umr_io_stats_get - Copy the counters of @asic
+ */
+void umr_io_stats_get(struct umr_asic *asic, struct umr_io_stats *st)
+{
+	const uint64_t *src = &asic->io_stats.cls[0].reads;
+	uint64_t *dst = &st->cls[0].reads;
+	unsigned i;
+
+	for (i = 0; i < sizeof *st / sizeof *dst; i++)
+		dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+}
+
+const char *umr_io_class_name(enum umr_io_class cls)
+{
+	return cls < UMR_IO_MAX ? class_names[cls] : "unknown";
+}
+
+/**
+ * umr_io_stats_print - Print a table of the classes that saw any calls to @f
+ */
+void umr_io_stats_print(const struct umr_io_stats *st, FILE *f)
+{
+	int i;
+
+	fprintf(f, "%-10s %10s %10s %10s %14s %14s %12s\n", "class", "reads", "writes", "ioctls", "bytes_read", "bytes_written", "msec");
+	for (i = 0; i < UMR_IO_MAX; i++) {
+		if (!st->cls[i].reads && !st->cls[i].writes && !st->cls[i].ioctls)
+			continue;
+		fprintf(f, "%-10s %10"PRIu64" %10"PRIu64" %10"PRIu64" %14"PRIu64" %14"PRIu64" %12.3f\n",
+			class_names[i], st->cls[i].reads, st->cls[i].writes, st->cls[i].ioctls,
+			st->cls[i].bytes_read, st->cls[i].bytes_written, st->cls[i].ns / 1000000.0);
+	}
+}
@@ -33,6 +33,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+// ranges passed to a single process_vm_readv()/process_vm_writev()
+#define UMR_USER_MEMV_BATCH 64
 
 #if 0
 #define DEBUG(...) asic->err_msg("DEBUG:" __VA_ARGS__)
@@ -59,7 +64,7 @@ uint64_t umr_vm_dma_to_phys(struct umr_asic *asic, uint64_t dma_addr)
 		// an address given a seek to a given address this has been
 		// removed in newer kernels
 		lseek(asic->fd.iova, dma_addr & ~0xFFFULL, SEEK_SET);
-		if (read(asic->fd.iova, &phys, 8) != 8) {
+		if (umr_io_read(asic, UMR_IO_IOMEM, asic->fd.iova, &phys, 8) != 8) {
 			asic->err_msg("[ERROR]: Could not read from debugfs iova file for address %" PRIx64 "\n", dma_addr);
 			return 0;
 		}
@@ -78,34 +83,113 @@ static int umr_access_sram_via_iomem(struct umr_asic *asic, uint64_t address, ui
 	lseek(asic->fd.iomem, address, SEEK_SET);
 	if (write_en == 0) {
 		memset(dst, 0xFF, size);
-		if ((r = read(asic->fd.iomem, dst, size)) != size) {
+		if ((r = umr_io_read(asic, UMR_IO_IOMEM, asic->fd.iomem, dst, size)) != size) {
 			return -1;
 		}
 	} else {
-		if ((r = write(asic->fd.iomem, dst, size)) != size) {
+		if ((r = umr_io_write(asic, UMR_IO_IOMEM, asic->fd.iomem, dst, size)) != size) {
 			return -1;
 		}
 	}
 	return 0;
 }
 
+// open (or reuse) /proc/<pid>/mem of the user queue process
+static int proc_mem_fd(struct umr_asic *asic)
+{
+	char name[128];
+	uint32_t pid = asic->options.user_queue.client_info.proc_info.pid;
+
+	if (asic->proc_mem.pid == pid && pid)
+		return asic->proc_mem.fd;
+
+	umr_close_proc_mem(asic);
+	sprintf(name, "/proc/%" PRIu32 "/mem", pid);
+	asic->proc_mem.fd = open(name, O_RDWR);
+	if (asic->proc_mem.fd < 0)
+		return -1;
+	asic->proc_mem.pid = pid;
+	return asic->proc_mem.fd;
+}
+
+/**
+ * @brief Close the cached /proc/<pid>/mem handle of the user queue process.
+ *
+ * The handle is reopened on the next access, this is also done
+ * automatically when the pid of the bound user queue changes.
+ */
+void umr_close_proc_mem(struct umr_asic *asic)
+{
+	if (asic->proc_mem.pid) {
+		close(asic->proc_mem.fd);
+		asic->proc_mem.pid = 0;
+	}
+}
+
 static int umr_access_sram_via_hmm(struct umr_asic *asic, uint64_t address, uint32_t size, void *dst, int write_en)
 {
 	ssize_t s;
-	char name[128];
 	int fd;
 
-	sprintf(name, "/proc/%d/mem", asic->options.user_queue.client_info.proc_info.pid);
-	fd = open(name, O_RDWR);
+	fd = proc_mem_fd(asic);
+	if (fd < 0)
+		return -1;
 	if (write_en) {
-		s = pwrite(fd, dst, size, address);
+		s = umr_io_pwrite(asic, UMR_IO_IOMEM, fd, dst, size, address);
 	} else {
-		s = pread(fd, dst, size, address);
+		s = umr_io_pread(asic, UMR_IO_IOMEM, fd, dst, size, address);
 	}
-	close(fd);
 	return (s == size) ? 0 : -1;
 }
 
+/**
+ * @brief Access several ranges of the user queue process memory at once.
+ *
+ * @param asic Pointer to the UMR ASIC structure with a bound user queue.
+ * @param va Array of @n virtual addresses in the process.
+ * @param size Array of @n sizes in bytes.
+ * @param data Array of @n local buffers to read into or write from.
+ * @param n Number of ranges.
+ * @param write_en Set to 0 for read operation, non-zero for write operation.
+ *
+ * The ranges are transferred with process_vm_readv()/process_vm_writev()
+ * so many small accesses cost a single syscall.  If that is not
+ * permitted the ranges are accessed one at a time through /proc/<pid>/mem.
+ *
+ * @return 0 if every range was transferred in full, -1 otherwise.
+ */
+int umr_access_user_memv(struct umr_asic *asic, const uint64_t *va, const uint32_t *size, void **data, int n, int write_en)
+{
+	struct iovec local[UMR_USER_MEMV_BATCH], remote[UMR_USER_MEMV_BATCH];
+	uint64_t total;
+	ssize_t r;
+	int x, y, c;
+
+	for (x = 0; x < n; x += c) {
+		c = n - x;
+		if (c > UMR_USER_MEMV_BATCH)
+			c = UMR_USER_MEMV_BATCH;
+		total = 0;
+		for (y = 0; y < c; y++) {
+			local[y].iov_base = data[x + y];
+			local[y].iov_len = size[x + y];
+			remote[y].iov_base = (void *)(uintptr_t)va[x + y];
+			remote[y].iov_len = size[x + y];
+			total += size[x + y];
+		}
+		r = syscall(write_en ? SYS_process_vm_writev : SYS_process_vm_readv,
+			    (pid_t)asic->options.user_queue.client_info.proc_info.pid, local, (unsigned long)c, remote, (unsigned long)c, 0UL);
+		if (r == (ssize_t)total)
+			continue;
+
+		// partial transfer or not allowed, redo this batch one range at a time
+		for (y = 0; y < c; y++)
+			if (umr_access_sram_via_hmm(asic, va[x + y], size[x + y], data[x + y], write_en))
+				return -1;
+	}
+	return 0;
+}
+
 /**
  * @brief Access system memory.
  *
@@ -132,15 +216,8 @@ int umr_access_sram(struct umr_asic *asic, uint64_t address, uint32_t size, void
 		}
 	}
 
-	if (asic->options.test_log && asic->options.test_log_fd) {
-		uint8_t *tlp = (uint8_t *)dst;
-		unsigned x;
-		fprintf(asic->options.test_log_fd, "SYSRAM@0x%"PRIx64" = {", address);
-		for (x = 0; x < size; x++) {
-			fprintf(asic->options.test_log_fd, "%02"PRIx8, tlp[x]);
-		}
-		fprintf(asic->options.test_log_fd, "}\n");
-	}
+	if (asic->options.test_log && asic->options.test_log_fd)
+		umr_test_log_bytes(&asic->options, UMR_TV_SYSRAM, address, dst, size);
 	return 0;
 error:
 	asic->err_msg("[ERROR]: Could not %s system memory at address 0x%"PRIx64"\n", write_en ? "write to" : "read from", address);
@@ -167,24 +244,195 @@ int umr_access_linear_vram(struct umr_asic *asic, uint64_t address, uint32_t siz
 {
 	lseek(asic->fd.vram, address, SEEK_SET);
 	if (write_en == 0) {
-		if (read(asic->fd.vram, data, size) != size) {
+		if (umr_io_read(asic, UMR_IO_VRAM, asic->fd.vram, data, size) != size) {
 			asic->err_msg("[ERROR]: Could not read from VRAM at address 0x%" PRIx64 "\n", address);
 			return -1;
 		}
-		if (asic->options.test_log && asic->options.test_log_fd) {
-			uint8_t *tlp = (uint8_t *)data;
-			unsigned x;
-			fprintf(asic->options.test_log_fd, "VRAM@0x%"PRIx64" = {", address);
-			for (x = 0; x < size; x++) {
-				fprintf(asic->options.test_log_fd, "%02"PRIx8, tlp[x]);
-			}
-			fprintf(asic->options.test_log_fd, "}\n");
-		}
+		if (asic->options.test_log && asic->options.test_log_fd)
+			umr_test_log_bytes(&asic->options, UMR_TV_VRAM, address, data, size);
 	} else {
-		if (write(asic->fd.vram, data, size) != size) {
+		if (umr_io_write(asic, UMR_IO_VRAM, asic->fd.vram, data, size) != size) {
 			asic->err_msg("[ERROR]: Could not write to VRAM at address 0x%" PRIx64 "\n", address);
 			return -1;
 		}
 	}
 	return 0;
 }
+
+// largest slice of the VRAM BAR mapped at a time
+#define UMR_VRAM_BAR_WINDOW (256ULL * 1024 * 1024)
+
+// the VRAM BAR is the largest prefetchable memory region of the device
+static int vram_bar_region(struct umr_asic *asic)
+{
+	int x, r = -1;
+
+	for (x = 0; x < 6; x++) {
+		if (asic->pci.pdevice->regions[x].is_IO || !asic->pci.pdevice->regions[x].is_prefetchable)
+			continue;
+		if (r < 0 || asic->pci.pdevice->regions[x].size > asic->pci.pdevice->regions[r].size)
+			r = x;
+	}
+	return r;
+}
+
+// move the window so it covers the BAR offset @address
+static int vram_bar_map(struct umr_asic *asic, uint64_t address)
+{
+	struct pci_mem_region *region = &asic->pci.pdevice->regions[asic->pci.vram.region];
+	void *mem;
+	uint64_t base, size;
+
+	base = address & ~(UMR_VRAM_BAR_WINDOW - 1);
+	size = region->size - base;
+	if (size > UMR_VRAM_BAR_WINDOW)
+		size = UMR_VRAM_BAR_WINDOW;
+
+	if (asic->pci.vram.mem) {
+		pci_device_unmap_range(asic->pci.pdevice, asic->pci.vram.mem, asic->pci.vram.size);
+		asic->pci.vram.mem = NULL;
+	}
+	if (pci_device_map_range(asic->pci.pdevice, region->base_addr + base, size,
+				 PCI_DEV_MAP_FLAG_WRITABLE | PCI_DEV_MAP_FLAG_WRITE_COMBINE, &mem))
+		return -1;
+	asic->pci.vram.mem = mem;
+	asic->pci.vram.base = base;
+	asic->pci.vram.size = size;
+	return 0;
+}
+
+/**
+ * @brief Access VRAM linearly through the mapped VRAM BAR.
+ *
+ * Drop-in replacement for umr_access_linear_vram() in asic->mem_funcs
+ * (see -O use_vram_bar).  Addresses inside the CPU visible part of VRAM
+ * are copied directly from a window of the BAR which is moved as needed.
+ * Anything beyond the BAR and test logging go through the regular
+ * accessors (MMIO with use_pci, otherwise debugfs).
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int umr_access_linear_vram_via_bar(struct umr_asic *asic, uint64_t address, uint32_t size, void *data, int write_en)
+{
+	uint8_t *p = data;
+	uint64_t n;
+
+	if (asic->pci.pdevice && !asic->pci.vram.resolved) {
+		asic->pci.vram.resolved = 1;
+		asic->pci.vram.region = vram_bar_region(asic);
+		if (asic->pci.vram.region < 0)
+			asic->err_msg("[WARNING]: Could not find the VRAM BAR, using regular VRAM access\n");
+	}
+
+	while (size && asic->pci.vram.resolved && asic->pci.vram.region >= 0 &&
+	       !(asic->options.test_log && asic->options.test_log_fd) &&
+	       address < asic->pci.pdevice->regions[asic->pci.vram.region].size) {
+		if (!asic->pci.vram.mem || address < asic->pci.vram.base ||
+		    address >= asic->pci.vram.base + asic->pci.vram.size) {
+			if (vram_bar_map(asic, address)) {
+				asic->err_msg("[WARNING]: Could not map the VRAM BAR, using regular VRAM access\n");
+				asic->pci.vram.region = -1;
+				break;
+			}
+		}
+		n = asic->pci.vram.base + asic->pci.vram.size - address;
+		if (n > size)
+			n = size;
+		if (write_en)
+			memcpy(asic->pci.vram.mem + (address - asic->pci.vram.base), p, n);
+		else
+			memcpy(p, asic->pci.vram.mem + (address - asic->pci.vram.base), n);
+		p += n;
+		address += n;
+		size -= n;
+	}
+
+	if (!size)
+		return 0;
+	if (asic->options.use_pci)
+		return umr_access_vram_via_mmio(asic, address, size, p, write_en);
+	return umr_access_linear_vram(asic, address, size, p, write_en);
+}
+
+// size of each io_uring operation when splitting large memory accesses
+#define UMR_URING_CHUNK (64 * 1024)
+
+/* Access @size bytes at @address of @fd in chunks queued in one submission.
+ * The chunks that still failed are finished with @fallback from where they
+ * stopped (nothing is transferred twice), without one the access fails. */
+static int access_fd_uring(struct umr_asic *asic, int fd, uint64_t address, uint32_t size, void *data, int write_en,
+			   int (*fallback)(struct umr_asic *asic, uint64_t address, uint32_t size, void *data, int write_en))
+{
+	struct umr_uring_op *ops;
+	uint32_t n, x, done;
+	int r;
+
+	n = (size + UMR_URING_CHUNK - 1) / UMR_URING_CHUNK;
+	ops = calloc(n, sizeof *ops);
+	if (!ops) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return -1;
+	}
+	for (x = 0; x < n; x++) {
+		ops[x].fd = fd;
+		ops[x].write_en = write_en;
+		ops[x].offset = address + (uint64_t)x * UMR_URING_CHUNK;
+		ops[x].buf = (uint8_t *)data + (uint64_t)x * UMR_URING_CHUNK;
+		ops[x].len = (x == n - 1) ? size - x * UMR_URING_CHUNK : UMR_URING_CHUNK;
+	}
+	r = umr_uring_submit(asic, ops, n);
+	for (x = 0; r && fallback && x < n; x++) {
+		if (ops[x].res == (int)ops[x].len)
+			continue;
+		done = ops[x].res > 0 ? ops[x].res : 0;
+		if (fallback(asic, ops[x].offset + done, ops[x].len - done, (uint8_t *)ops[x].buf + done, write_en))
+			break;
+		ops[x].res = ops[x].len;
+	}
+	if (r && fallback && x == n)
+		r = 0;
+	free(ops);
+	return r;
+}
+
+/**
+ * @brief Access system memory through the io_uring backend.
+ *
+ * Drop-in replacement for umr_access_sram() in asic->mem_funcs.  Large
+ * accesses through amdgpu_iomem are split into chunks that are queued in
+ * a single submission.  Small accesses and test logging are handled by
+ * umr_access_sram(), as are the chunks that failed (from where they
+ * stopped).
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int umr_access_sram_uring(struct umr_asic *asic, uint64_t address, uint32_t size, void *dst, int write_en)
+{
+	if (!asic->uring || asic->fd.iomem < 0 || size <= UMR_URING_CHUNK ||
+	    (asic->options.test_log && asic->options.test_log_fd))
+		return umr_access_sram(asic, address, size, dst, write_en);
+
+	return access_fd_uring(asic, asic->fd.iomem, address, size, dst, write_en, umr_access_sram);
+}
+
+/**
+ * @brief Access VRAM linearly through the io_uring backend.
+ *
+ * Drop-in replacement for umr_access_linear_vram() in asic->mem_funcs.
+ * Large accesses through amdgpu_vram are split into chunks that are
+ * queued in a single submission.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int umr_access_linear_vram_uring(struct umr_asic *asic, uint64_t address, uint32_t size, void *data, int write_en)
+{
+	if (!asic->uring || asic->fd.vram < 0 || size <= UMR_URING_CHUNK ||
+	    (asic->options.test_log && asic->options.test_log_fd))
+		return umr_access_linear_vram(asic, address, size, data, write_en);
+
+	if (access_fd_uring(asic, asic->fd.vram, address, size, data, write_en, NULL)) {
+		asic->err_msg("[ERROR]: Could not %s VRAM at address 0x%" PRIx64 "\n", write_en ? "write to" : "read from", address);
+		return -1;
+	}
+	return 0;
+}
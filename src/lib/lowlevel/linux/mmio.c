@@ -27,6 +27,7 @@
 #include <linux/types.h>
 #include <asm/ioctl.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 
 struct amdgpu_debugfs_regs2_iocdata {
 	__u32 use_srbm, use_grbm, pg_lock;
@@ -57,35 +58,125 @@ enum AMDGPU_DEBUGFS_REGS2_CMDS {
 #define AMDGPU_DEBUGFS_REGS2_IOC_SET_STATE _IOWR(0x20, AMDGPU_DEBUGFS_REGS2_CMD_SET_STATE, struct amdgpu_debugfs_regs2_iocdata)
 #define AMDGPU_DEBUGFS_REGS2_IOC_SET_STATE_V2 _IOWR(0x20, AMDGPU_DEBUGFS_REGS2_CMD_SET_STATE_V2, struct amdgpu_debugfs_regs2_iocdata_v2)
 
+/* ==== Indirect registers through the PCI BAR ==== */
+
+// look up an index/data pair (and optional upper index) by name
+static void ind_pair_resolve(struct umr_asic *asic, struct umr_ind_pair *p, const char *index, const char *data, const char *index_hi)
+{
+	struct umr_reg *ri, *rd, *rh = NULL;
+	uint64_t size = asic->pci.size;
+
+	memset(p, 0, sizeof *p);
+	ri = umr_find_reg_data_by_ip_by_instance(asic, NULL, -1, index);
+	rd = umr_find_reg_data_by_ip_by_instance(asic, NULL, -1, data);
+	if (index_hi)
+		rh = umr_find_reg_data_by_ip_by_instance(asic, NULL, -1, index_hi);
+	if (!ri || !rd || ri->type != REG_MMIO || rd->type != REG_MMIO)
+		return;
+
+	p->index = ri->addr * 4;
+	p->data = rd->addr * 4;
+	if (rh && rh->type == REG_MMIO)
+		p->index_hi = rh->addr * 4;
+	p->ok = (p->index + 4 <= size) && (p->data + 4 <= size) && (p->index_hi + 4 <= size);
+}
+
 /**
- * umr_pcie_read - Read a PCIE register
+ * ind_regs_get - Get the index/data pair for an indirect register class
  *
- * Reads a PCIE register via debugfs or direct MMIO.
+ * The pair offsets only depend on the family so they are looked up once
+ * per ASIC, afterwards an access is just raw stores/loads on the BAR.
+ * Returns NULL if the BAR is not mapped or the family has no pair.
  */
-static uint32_t umr_pcie_read(struct umr_asic *asic, uint64_t addr)
+static struct umr_ind_pair *ind_regs_get(struct umr_asic *asic, enum regclass type)
 {
-	uint32_t value;
-	if (asic->options.use_pci) {
+	if (!umr_pci_regs(asic))
+		return NULL;
+
+	if (!asic->ind_regs.resolved) {
+		asic->ind_regs.resolved = 1;
 		switch (asic->config.gfx.family) {
-#if 0
 			case 110: // SI
 			case 120: // CIK
 			case 125: // KV
 			case 130: // VI
-				umr_write_reg_by_name(asic, "mmSMC_IND_INDEX_1", addr);
-				return umr_read_reg_by_name(asic, "mmSMC_IND_DATA_1");
+				ind_pair_resolve(asic, &asic->ind_regs.smc, "@mmSMC_IND_INDEX_1", "@mmSMC_IND_DATA_1", NULL);
+				break;
 			case 135: // CZ
-				umr_write_reg_by_name(asic, "mmMP0PUB_IND_INDEX_1", addr);
-				return umr_read_reg_by_name(asic, "mmMP0PUB_IND_DATA_1");
-#endif
-			default:
-				asic->err_msg("[BUG]: Unsupported family type in umr_pcie_read()\n");
-				return 0;
+				ind_pair_resolve(asic, &asic->ind_regs.smc, "@mmMP0PUB_IND_INDEX_1", "@mmMP0PUB_IND_DATA_1", NULL);
+				break;
+		}
+		// SOC15 and later reach PCIE/SMN space through the NBIO INDEX2/DATA2 pair
+		if (asic->family >= FAMILY_AI)
+			ind_pair_resolve(asic, &asic->ind_regs.pcie, "@mmPCIE_INDEX2", "@mmPCIE_DATA2", "@mmPCIE_INDEX2_HI");
+		else
+			ind_pair_resolve(asic, &asic->ind_regs.pcie, "@mmPCIE_INDEX", "@mmPCIE_DATA", NULL);
+	}
+
+	if (type == REG_SMC)
+		return asic->ind_regs.smc.ok ? &asic->ind_regs.smc : NULL;
+	return asic->ind_regs.pcie.ok ? &asic->ind_regs.pcie : NULL;
+}
+
+// index write + data read, the index is read back to post the write
+static uint32_t ind_bar_read(struct umr_asic *asic, struct umr_ind_pair *p, uint64_t addr)
+{
+	volatile uint32_t *mem = asic->pci.mem;
+	uint32_t value;
+
+	mem[p->index/4] = addr & 0xFFFFFFFFUL;
+	(void)mem[p->index/4];
+	if (p->index_hi && (addr >> 32)) {
+		mem[p->index_hi/4] = addr >> 32;
+		(void)mem[p->index_hi/4];
+	}
+	value = mem[p->data/4];
+	if (p->index_hi && (addr >> 32)) {
+		mem[p->index_hi/4] = 0;
+		(void)mem[p->index_hi/4];
+	}
+	return value;
+}
+
+static void ind_bar_write(struct umr_asic *asic, struct umr_ind_pair *p, uint64_t addr, uint32_t value)
+{
+	volatile uint32_t *mem = asic->pci.mem;
+
+	mem[p->index/4] = addr & 0xFFFFFFFFUL;
+	(void)mem[p->index/4];
+	if (p->index_hi && (addr >> 32)) {
+		mem[p->index_hi/4] = addr >> 32;
+		(void)mem[p->index_hi/4];
+	}
+	mem[p->data/4] = value;
+	(void)mem[p->data/4];
+	if (p->index_hi && (addr >> 32)) {
+		mem[p->index_hi/4] = 0;
+		(void)mem[p->index_hi/4];
+	}
+}
+
+/**
+ * umr_pcie_read - Read a PCIE register
+ *
+ * Reads a PCIE register via debugfs or direct MMIO.
+ */
+static uint32_t umr_pcie_read(struct umr_asic *asic, uint64_t addr)
+{
+	struct umr_ind_pair *p;
+	uint32_t value;
+
+	if (asic->options.use_pci) {
+		p = ind_regs_get(asic, REG_PCIE);
+		if (!p) {
+			asic->err_msg("[BUG]: Unsupported family type in umr_pcie_read()\n");
+			return 0;
 		}
+		return ind_bar_read(asic, p, addr);
 	} else {
 		if (lseek(asic->fd.pcie, addr, SEEK_SET) < 0)
 			asic->err_msg("[ERROR]: Cannot seek to PCIE address\n");
-		if (read(asic->fd.pcie, &value, 4) != 4)
+		if (umr_io_read(asic, UMR_IO_MMIO, asic->fd.pcie, &value, 4) != 4)
 			asic->err_msg("[ERROR]: Cannot read from PCIE reg\n");
 		return value;
 	}
@@ -98,29 +189,21 @@ static uint32_t umr_pcie_read(struct umr_asic *asic, uint64_t addr)
  */
 static uint32_t umr_pcie_write(struct umr_asic *asic, uint64_t addr, uint32_t value)
 {
+	struct umr_ind_pair *p;
+
 	if (asic->options.use_pci) {
-		switch (asic->config.gfx.family) {
-#if 0
-			case 110: // SI
-			case 120: // CIK
-			case 125: // KV
-			case 130: // VI
-				umr_write_reg_by_name(asic, "mmSMC_IND_INDEX_1", addr);
-				return umr_write_reg_by_name(asic, "mmSMC_IND_DATA_1", value);
-			case 135: // CZ
-				umr_write_reg_by_name(asic, "mmMP0PUB_IND_INDEX_1", addr);
-				return umr_write_reg_by_name(asic, "mmMP0PUB_IND_DATA_1", value);
-#endif
-			default:
-				asic->err_msg("[BUG]: Unsupported family type in umr_pcie_write()\n");
-				return -1;
+		p = ind_regs_get(asic, REG_PCIE);
+		if (!p) {
+			asic->err_msg("[BUG]: Unsupported family type in umr_pcie_write()\n");
+			return -1;
 		}
+		ind_bar_write(asic, p, addr, value);
 	} else {
 		if (lseek(asic->fd.pcie, addr, SEEK_SET) < 0) {
 			asic->err_msg("[ERROR]: Cannot seek to PCIE address\n");
 			return -1;
 		}
-		if (write(asic->fd.pcie, &value, 4) != 4) {
+		if (umr_io_write(asic, UMR_IO_MMIO, asic->fd.pcie, &value, 4) != 4) {
 			asic->err_msg("[ERROR]: Cannot write to PCIE reg\n");
 			return -1;
 		}
@@ -135,26 +218,20 @@ static uint32_t umr_pcie_write(struct umr_asic *asic, uint64_t addr, uint32_t va
  */
 static uint32_t umr_smc_read(struct umr_asic *asic, uint64_t addr)
 {
+	struct umr_ind_pair *p;
 	uint32_t value;
+
 	if (asic->options.use_pci) {
-		switch (asic->config.gfx.family) {
-			case 110: // SI
-			case 120: // CIK
-			case 125: // KV
-			case 130: // VI
-				umr_write_reg_by_name(asic, "mmSMC_IND_INDEX_1", addr);
-				return umr_read_reg_by_name(asic, "mmSMC_IND_DATA_1");
-			case 135: // CZ
-				umr_write_reg_by_name(asic, "mmMP0PUB_IND_INDEX_1", addr);
-				return umr_read_reg_by_name(asic, "mmMP0PUB_IND_DATA_1");
-			default:
-				asic->err_msg("[BUG]: Unsupported family type in umr_smc_read()\n");
-				return 0;
+		p = ind_regs_get(asic, REG_SMC);
+		if (!p) {
+			asic->err_msg("[BUG]: Unsupported family type in umr_smc_read()\n");
+			return 0;
 		}
+		return ind_bar_read(asic, p, addr);
 	} else {
 		if (lseek(asic->fd.smc, addr, SEEK_SET) < 0)
 			asic->err_msg("[ERROR]: Cannot seek to SMC address\n");
-		if (read(asic->fd.smc, &value, 4) != 4)
+		if (umr_io_read(asic, UMR_IO_MMIO, asic->fd.smc, &value, 4) != 4)
 			asic->err_msg("[ERROR]: Cannot read from SMC reg\n");
 		return value;
 	}
@@ -168,27 +245,21 @@ static uint32_t umr_smc_read(struct umr_asic *asic, uint64_t addr)
  */
 static uint32_t umr_smc_write(struct umr_asic *asic, uint64_t addr, uint32_t value)
 {
+	struct umr_ind_pair *p;
+
 	if (asic->options.use_pci) {
-		switch (asic->config.gfx.family) {
-			case 110: // SI
-			case 120: // CIK
-			case 125: // KV
-			case 130: // VI
-				umr_write_reg_by_name(asic, "mmSMC_IND_INDEX_1", addr);
-				return umr_write_reg_by_name(asic, "mmSMC_IND_DATA_1", value);
-			case 135: // CZ
-				umr_write_reg_by_name(asic, "mmMP0PUB_IND_INDEX_1", addr);
-				return umr_write_reg_by_name(asic, "mmMP0PUB_IND_DATA_1", value);
-			default:
-				asic->err_msg("[BUG]: Unsupported family type in umr_smc_write()\n");
-				return -1;
+		p = ind_regs_get(asic, REG_SMC);
+		if (!p) {
+			asic->err_msg("[BUG]: Unsupported family type in umr_smc_write()\n");
+			return -1;
 		}
+		ind_bar_write(asic, p, addr, value);
 	} else {
 		if (lseek(asic->fd.smc, addr, SEEK_SET) < 0) {
 			asic->err_msg("[ERROR]: Cannot seek to SMC address\n");
 			return -1;
 		}
-		if (write(asic->fd.smc, &value, 4) != 4) {
+		if (umr_io_write(asic, UMR_IO_MMIO, asic->fd.smc, &value, 4) != 4) {
 			asic->err_msg("[ERROR]: Cannot write to SMC reg\n");
 			return -1;
 		}
@@ -196,65 +267,168 @@ static uint32_t umr_smc_write(struct umr_asic *asic, uint64_t addr, uint32_t val
 	return 0;
 }
 
+/* ==== Register access state ==== */
+
+// the bank/partition state and regs2 file used by the calling thread,
+// either its bound umr_access_ctx or the shared asic->options
+struct access_view {
+	int *use_bank, *pg_lock, *context_reg_bank, *vm_partition;
+	union umr_bank_select *bank;
+	int fd_mmio2;
+	struct umr_mmio2_state *mmio2_state;
+};
+
+static void access_view_get(struct umr_asic *asic, struct access_view *v)
+{
+	struct umr_access_ctx *ctx = umr_access_ctx_current(asic);
+
+	if (ctx) {
+		v->use_bank = &ctx->use_bank;
+		v->pg_lock = &ctx->pg_lock;
+		v->context_reg_bank = &ctx->context_reg_bank;
+		v->vm_partition = &ctx->vm_partition;
+		v->bank = &ctx->bank;
+		v->fd_mmio2 = ctx->fd_mmio2;
+		v->mmio2_state = &ctx->mmio2_state;
+	} else {
+		v->use_bank = &asic->options.use_bank;
+		v->pg_lock = &asic->options.pg_lock;
+		v->context_reg_bank = &asic->options.context_reg_bank;
+		v->vm_partition = &asic->options.vm_partition;
+		v->bank = &asic->options.bank;
+		v->fd_mmio2 = asic->fd.mmio2;
+		v->mmio2_state = &asic->mmio2_state;
+	}
+}
+
+/**
+ * umr_mmio2_invalidate_bank - Forget the cached regs2 bank state
+ *
+ * @asic: The device whose cached state should be dropped
+ *
+ * The next register access through fd.mmio2 will unconditionally
+ * resend the SET_STATE ioctl.  Changes made through asic->options are
+ * detected automatically, this is only needed if the state of the file
+ * may have changed behind umr's back (e.g. the fd was reopened).  The
+ * cache of the access context bound on this thread is dropped as well.
+ */
+void umr_mmio2_invalidate_bank(struct umr_asic *asic)
+{
+	struct umr_access_ctx *ctx = umr_access_ctx_current(asic);
+
+	asic->mmio2_state.valid = 0;
+	if (ctx)
+		ctx->mmio2_state.valid = 0;
+}
+
+// returns non-zero if the bank state in @v matches what was last sent
+static int mmio2_bank_cached(const struct access_view *v, int xcc_id)
+{
+	const struct umr_mmio2_state *st = v->mmio2_state;
+
+	if (!st->valid ||
+	    st->use_bank != *v->use_bank ||
+	    st->pg_lock != !!*v->pg_lock ||
+	    st->xcc_id != xcc_id)
+		return 0;
+
+	switch (*v->use_bank) {
+		case 1:
+			return st->bank.grbm.se == v->bank->grbm.se &&
+			       st->bank.grbm.sh == v->bank->grbm.sh &&
+			       st->bank.grbm.instance == v->bank->grbm.instance;
+		case 2:
+			return st->bank.srbm.me == v->bank->srbm.me &&
+			       st->bank.srbm.pipe == v->bank->srbm.pipe &&
+			       st->bank.srbm.queue == v->bank->srbm.queue &&
+			       st->bank.srbm.vmid == v->bank->srbm.vmid;
+		default:
+			return 1;
+	}
+}
+
+static void mmio2_bank_update(const struct access_view *v, int xcc_id)
+{
+	v->mmio2_state->valid = 1;
+	v->mmio2_state->use_bank = *v->use_bank;
+	v->mmio2_state->pg_lock = !!*v->pg_lock;
+	v->mmio2_state->xcc_id = xcc_id;
+	v->mmio2_state->bank = *v->bank;
+}
+
 // this sends the grbm/srbm data up based on flags...
-static int mmio2_apply_bank(struct umr_asic *asic)
+static int mmio2_apply_bank(struct umr_asic *asic, const struct access_view *v)
 {
 	struct amdgpu_debugfs_regs2_iocdata id;
 	struct amdgpu_debugfs_regs2_iocdata_v2 id_v2;
-	int r;
+	int r, xcc_id;
+
+	// the v1 ioctl has no XCC selection so don't let it invalidate the cache
+	xcc_id = asic->options.use_v1_regs_debugfs ? 0 :
+		 (*v->vm_partition == -1 ? 0 : *v->vm_partition);
+	if (mmio2_bank_cached(v, xcc_id))
+		return 0;
 
 	memset(&id, 0, sizeof id);
 	memset(&id_v2, 0, sizeof id_v2);
 
 	if (!asic->options.use_v1_regs_debugfs) {
-		if (asic->options.pg_lock) {
+		if (*v->pg_lock) {
 			id_v2.pg_lock = 1;
 		}
 
-		if (asic->options.use_bank == 1) {
-			id_v2.grbm.se = asic->options.bank.grbm.se;
-			id_v2.grbm.sh = asic->options.bank.grbm.sh;
-			id_v2.grbm.instance = asic->options.bank.grbm.instance;
+		if (*v->use_bank == 1) {
+			id_v2.grbm.se = v->bank->grbm.se;
+			id_v2.grbm.sh = v->bank->grbm.sh;
+			id_v2.grbm.instance = v->bank->grbm.instance;
 			id_v2.use_grbm = 1;
 		}
 
-		if (asic->options.use_bank == 2) {
-			id_v2.srbm.me    = asic->options.bank.srbm.me;
-			id_v2.srbm.pipe  = asic->options.bank.srbm.pipe;
-			id_v2.srbm.queue = asic->options.bank.srbm.queue;
-			id_v2.srbm.vmid  = asic->options.bank.srbm.vmid;
+		if (*v->use_bank == 2) {
+			id_v2.srbm.me    = v->bank->srbm.me;
+			id_v2.srbm.pipe  = v->bank->srbm.pipe;
+			id_v2.srbm.queue = v->bank->srbm.queue;
+			id_v2.srbm.vmid  = v->bank->srbm.vmid;
 			id_v2.use_srbm = 1;
 		}
-		id_v2.xcc_id = asic->options.vm_partition == -1 ? 0 : asic->options.vm_partition;
-		r = ioctl(asic->fd.mmio2, AMDGPU_DEBUGFS_REGS2_IOC_SET_STATE_V2, &id_v2);
-		if (!r)
+		id_v2.xcc_id = xcc_id;
+		r = umr_io_ioctl(asic, UMR_IO_MMIO, v->fd_mmio2, AMDGPU_DEBUGFS_REGS2_IOC_SET_STATE_V2, &id_v2);
+		if (!r) {
+			mmio2_bank_update(v, xcc_id);
 			return r;
+		}
 
 		// stop trying this and fall back by default now
 		asic->options.use_v1_regs_debugfs = 1;
+		xcc_id = 0;
 	}
 
 	// fall back to old IOCTL that isn't XCC aware
-	if (asic->options.pg_lock) {
+	if (*v->pg_lock) {
 		id.pg_lock = 1;
 	}
 
-	if (asic->options.use_bank == 1) {
-		id.grbm.se = asic->options.bank.grbm.se;
-		id.grbm.sh = asic->options.bank.grbm.sh;
-		id.grbm.instance = asic->options.bank.grbm.instance;
+	if (*v->use_bank == 1) {
+		id.grbm.se = v->bank->grbm.se;
+		id.grbm.sh = v->bank->grbm.sh;
+		id.grbm.instance = v->bank->grbm.instance;
 		id.use_grbm = 1;
 	}
 
-	if (asic->options.use_bank == 2) {
-		id.srbm.me    = asic->options.bank.srbm.me;
-		id.srbm.pipe  = asic->options.bank.srbm.pipe;
-		id.srbm.queue = asic->options.bank.srbm.queue;
-		id.srbm.vmid  = asic->options.bank.srbm.vmid;
+	if (*v->use_bank == 2) {
+		id.srbm.me    = v->bank->srbm.me;
+		id.srbm.pipe  = v->bank->srbm.pipe;
+		id.srbm.queue = v->bank->srbm.queue;
+		id.srbm.vmid  = v->bank->srbm.vmid;
 		id.use_srbm = 1;
 	}
 
-	return ioctl(asic->fd.mmio2, AMDGPU_DEBUGFS_REGS2_IOC_SET_STATE, &id);
+	r = umr_io_ioctl(asic, UMR_IO_MMIO, v->fd_mmio2, AMDGPU_DEBUGFS_REGS2_IOC_SET_STATE, &id);
+	if (!r)
+		mmio2_bank_update(v, xcc_id);
+	else
+		v->mmio2_state->valid = 0;
+	return r;
 }
 
 /** @brief Reads a register by address, applying bank selection if necessary.
@@ -266,26 +440,29 @@ static int mmio2_apply_bank(struct umr_asic *asic)
  */
 uint32_t umr_read_reg(struct umr_asic *asic, uint64_t addr, enum regclass type)
 {
+	struct access_view v;
 	uint32_t value=0;
 	uint64_t mmio_addr = addr & 0xFFFFFFFF;
 	int use_bank = 0;
 
+	access_view_get(asic, &v);
+
 	if (addr == 0xFFFFFFFF)
 		asic->err_msg("[BUG]: reading from addr==0xFFFFFFFF is likely a bug\n");
 
 	// apply bank bits
 	if (type == REG_MMIO && asic->options.no_kernel) {
-		use_bank = asic->options.use_bank;
+		use_bank = *v.use_bank;
 		if (use_bank == 1) {
-			umr_grbm_select_index(asic, asic->options.bank.grbm.se, asic->options.bank.grbm.sh, asic->options.bank.grbm.instance);
+			umr_grbm_select_index(asic, v.bank->grbm.se, v.bank->grbm.sh, v.bank->grbm.instance);
 		} else if (use_bank == 2) {
-			umr_srbm_select_index(asic, asic->options.bank.srbm.me, asic->options.bank.srbm.pipe, asic->options.bank.srbm.queue, asic->options.bank.srbm.vmid);
+			umr_srbm_select_index(asic, v.bank->srbm.me, v.bank->srbm.pipe, v.bank->srbm.queue, v.bank->srbm.vmid);
 		}
 	}
 
 	// apply context banking
 	if ((mmio_addr >= (0xA000*4)) && (mmio_addr < (0xB000*4)))
-		addr += asic->options.context_reg_bank * 0x1000;
+		addr += *v.context_reg_bank * 0x1000;
 
 	switch (type) {
 		case REG_SMN:
@@ -293,21 +470,21 @@ uint32_t umr_read_reg(struct umr_asic *asic, uint64_t addr, enum regclass type)
 			value = umr_pcie_read(asic, addr);
 			break;
 		case REG_MMIO:
-			if (asic->pci.mem && (addr < asic->pci.pdevice->regions[asic->pci.region].size)) {
+			if (umr_pci_regs(asic) && (addr < asic->pci.size)) {
 				value = asic->pci.mem[addr/4];
 				break;
 			} else {
 				if (asic->fd.mmio2 >= 0) {
 					// use new interface
-					if (mmio2_apply_bank(asic)) {
+					if (mmio2_apply_bank(asic, &v)) {
 						asic->err_msg("[ERROR]: Could not set register IOCTL state\n");
 						return 0;
 					}
-					if (lseek(asic->fd.mmio2, addr, SEEK_SET) < 0) {
+					if (lseek(v.fd_mmio2, addr, SEEK_SET) < 0) {
 						asic->err_msg("[ERROR]: Cannot seek to MMIO address for read\n");
 						return 0;
 					}
-					if (read(asic->fd.mmio2, &value, 4) != 4) {
+					if (umr_io_read(asic, UMR_IO_MMIO, v.fd_mmio2, &value, 4) != 4) {
 						asic->err_msg("[ERROR]: Cannot read from MMIO reg\n");
 						return 0;
 					}
@@ -316,7 +493,7 @@ uint32_t umr_read_reg(struct umr_asic *asic, uint64_t addr, enum regclass type)
 					addr &= 0xFFFFFFUL;
 					if (lseek(asic->fd.mmio, addr | umr_apply_bank_selection_address(asic), SEEK_SET) < 0)
 						asic->err_msg("[ERROR]: Cannot seek to MMIO address\n");
-					if (read(asic->fd.mmio, &value, 4) != 4)
+					if (umr_io_read(asic, UMR_IO_MMIO, asic->fd.mmio, &value, 4) != 4)
 						asic->err_msg("[ERROR]: Cannot read from MMIO reg\n");
 				}
 				break;
@@ -340,10 +517,18 @@ uint32_t umr_read_reg(struct umr_asic *asic, uint64_t addr, enum regclass type)
 	}
 
 	if (asic->options.test_log && asic->options.test_log_fd) {
-		if (strstr(umr_reg_name(asic, addr>>2), "SQ_IND_DATA")) {
-			fprintf(asic->options.test_log_fd, "SQ@0x%"PRIx64" = { 0x%"PRIx32" } ; %s\n", asic->test_harness.sq_ind_index, value, umr_reg_name(asic, addr>>2));
+		struct umr_mmio_accel_data *acc;
+		const char *comment = NULL;
+		char name[512];
+
+		acc = umr_find_mmio_accel(asic, addr>>2);
+		// register names only go into the text format
+		if (!asic->options.test_log_bin)
+			comment = umr_reg_name_r(asic, addr>>2, name, sizeof name);
+		if (acc && (acc->flags & UMR_MMIO_ACCEL_SQ_IND_DATA)) {
+			umr_test_log_words(&asic->options, UMR_TV_SQ, asic->test_harness.sq_ind_index, &value, 1, comment);
 		} else {
-			fprintf(asic->options.test_log_fd, "MMIO@0x%"PRIx64" = { 0x%"PRIx32" } ; %s\n", mmio_addr, value, umr_reg_name(asic, addr>>2));
+			umr_test_log_words(&asic->options, UMR_TV_MMIO, mmio_addr, &value, 1, comment);
 		}
 	}
 
@@ -360,25 +545,28 @@ uint32_t umr_read_reg(struct umr_asic *asic, uint64_t addr, enum regclass type)
  */
 int umr_write_reg(struct umr_asic *asic, uint64_t addr, uint32_t value, enum regclass type)
 {
+	struct access_view v;
 	uint64_t mmio_addr = addr & 0xFFFFFFFF;
 	int use_bank = 0, r = 0;
 
+	access_view_get(asic, &v);
+
 	if (addr == 0xFFFFFFFF)
 		asic->err_msg("[BUG]: reading from addr==0xFFFFFFFF is likely a bug\n");
 
 	// apply bank bits
 	if (type == REG_MMIO && asic->options.no_kernel) {
-		use_bank = asic->options.use_bank;
+		use_bank = *v.use_bank;
 		if (use_bank == 1) {
-			umr_grbm_select_index(asic, asic->options.bank.grbm.se, asic->options.bank.grbm.sh, asic->options.bank.grbm.instance);
+			umr_grbm_select_index(asic, v.bank->grbm.se, v.bank->grbm.sh, v.bank->grbm.instance);
 		} else if (use_bank == 2) {
-			umr_srbm_select_index(asic, asic->options.bank.srbm.me, asic->options.bank.srbm.pipe, asic->options.bank.srbm.queue, asic->options.bank.srbm.vmid);
+			umr_srbm_select_index(asic, v.bank->srbm.me, v.bank->srbm.pipe, v.bank->srbm.queue, v.bank->srbm.vmid);
 		}
 	}
 
 	// apply context banking
 	if ((mmio_addr >= (0xA000*4)) && (mmio_addr < (0xB000*4)))
-		addr += asic->options.context_reg_bank * 0x1000;
+		addr += *v.context_reg_bank * 0x1000;
 
 	switch (type) {
 		case REG_SMN:
@@ -386,19 +574,19 @@ int umr_write_reg(struct umr_asic *asic, uint64_t addr, uint32_t value, enum reg
 			r = umr_pcie_write(asic, addr, value);
 			break;
 		case REG_MMIO:
-			if (asic->pci.mem && (addr < asic->pci.pdevice->regions[asic->pci.region].size)) {
+			if (umr_pci_regs(asic) && (addr < asic->pci.size)) {
 				asic->pci.mem[addr/4] = value;
 			} else {
 				if (asic->fd.mmio2 >= 0) {
 					// use new interface
-					if (mmio2_apply_bank(asic)) {
+					if (mmio2_apply_bank(asic, &v)) {
 						asic->err_msg("[ERROR]: Could not set register IOCTL state\n");
 						return 0;
 					}
-					if (lseek(asic->fd.mmio2, addr, SEEK_SET) < 0) {
+					if (lseek(v.fd_mmio2, addr, SEEK_SET) < 0) {
 						asic->err_msg("[ERROR]: Cannot seek to MMIO address\n");
 						r = -1;
-					} else if (write(asic->fd.mmio2, &value, 4) != 4) {
+					} else if (umr_io_write(asic, UMR_IO_MMIO, v.fd_mmio2, &value, 4) != 4) {
 						asic->err_msg("[ERROR]: Cannot write to MMIO reg\n");
 						r = -1;
 					}
@@ -408,14 +596,17 @@ int umr_write_reg(struct umr_asic *asic, uint64_t addr, uint32_t value, enum reg
 					if (lseek(asic->fd.mmio, addr | umr_apply_bank_selection_address(asic), SEEK_SET) < 0) {
 						asic->err_msg("[ERROR]: Cannot seek to MMIO address for write\n");
 						r = -1;
-					} else if (write(asic->fd.mmio, &value, 4) != 4) {
+					} else if (umr_io_write(asic, UMR_IO_MMIO, asic->fd.mmio, &value, 4) != 4) {
 						asic->err_msg("[ERROR]: Cannot write to MMIO reg\n");
 						r = -1;
 					}
 				}
 			}
 			if (asic->options.test_log && asic->options.test_log_fd) {
-				if (strstr(umr_reg_name(asic, addr>>2), "SQ_IND_INDEX")) {
+				struct umr_mmio_accel_data *acc;
+
+				acc = umr_find_mmio_accel(asic, addr>>2);
+				if (acc && (acc->flags & UMR_MMIO_ACCEL_SQ_IND_INDEX)) {
 					asic->test_harness.sq_ind_index = value;
 				}
 			}
@@ -439,3 +630,420 @@ int umr_write_reg(struct umr_asic *asic, uint64_t addr, uint32_t value, enum reg
 
 	return r;
 }
+
+/* ==== Batched register access ==== */
+
+// is the regs2 fast path usable for this asic?
+static int batch_use_mmio2(struct umr_asic *asic)
+{
+	return asic->fd.mmio2 >= 0 &&
+	       !umr_pci_regs(asic) &&
+	       !asic->options.no_kernel &&
+	       !(asic->options.test_log && asic->options.test_log_fd);
+}
+
+static int batch_same_bank(const struct umr_reg_batch *a, const struct umr_reg_batch *b)
+{
+	if (a->use_bank != b->use_bank)
+		return 0;
+	switch (a->use_bank) {
+		case 1:
+			return a->bank.grbm.se == b->bank.grbm.se &&
+			       a->bank.grbm.sh == b->bank.grbm.sh &&
+			       a->bank.grbm.instance == b->bank.grbm.instance;
+		case 2:
+			return a->bank.srbm.me == b->bank.srbm.me &&
+			       a->bank.srbm.pipe == b->bank.srbm.pipe &&
+			       a->bank.srbm.queue == b->bank.srbm.queue &&
+			       a->bank.srbm.vmid == b->bank.srbm.vmid;
+		default:
+			return 1;
+	}
+}
+
+// order entries by bank state, then type, then address so that groups
+// and contiguous runs end up next to each other
+static int batch_sort(const void *A, const void *B)
+{
+	const struct umr_reg_batch *a = *(const struct umr_reg_batch **)A,
+				   *b = *(const struct umr_reg_batch **)B;
+	const uint32_t *ka = (const uint32_t *)&a->bank, *kb = (const uint32_t *)&b->bank;
+	unsigned x, n;
+
+	if (a->use_bank != b->use_bank)
+		return a->use_bank < b->use_bank ? -1 : 1;
+	n = a->use_bank == 1 ? 3 : a->use_bank == 2 ? 4 : 0;
+	for (x = 0; x < n; x++)
+		if (ka[x] != kb[x])
+			return ka[x] < kb[x] ? -1 : 1;
+	if (a->type != b->type)
+		return a->type < b->type ? -1 : 1;
+	if (a->addr != b->addr)
+		return a->addr < b->addr ? -1 : 1;
+	// keep the sort stable
+	return a < b ? -1 : (a > b);
+}
+
+static uint64_t batch_mmio_addr(const struct access_view *v, uint64_t addr)
+{
+	uint64_t mmio_addr = addr & 0xFFFFFFFF;
+
+	// apply context banking (same as umr_read_reg())
+	if ((mmio_addr >= (0xA000*4)) && (mmio_addr < (0xB000*4)))
+		addr += *v->context_reg_bank * 0x1000;
+	return addr;
+}
+
+// queue every register of a group (same bank) in one io_uring submission
+static int batch_rw_group_uring(struct umr_asic *asic, const struct access_view *v, struct umr_reg_batch **ents, int n, int write_en)
+{
+	struct umr_uring_op *ops;
+	int x, r;
+
+	ops = calloc(n, sizeof *ops);
+	if (!ops) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return -1;
+	}
+	for (x = 0; x < n; x++) {
+		ops[x].fd = v->fd_mmio2;
+		ops[x].write_en = write_en;
+		ops[x].offset = batch_mmio_addr(v, ents[x]->addr);
+		ops[x].buf = &ents[x]->value;
+		ops[x].len = 4;
+	}
+	r = umr_uring_submit(asic, ops, n);
+	for (x = 0; x < n; x++) {
+		if (ops[x].res != 4) {
+			asic->err_msg("[ERROR]: Cannot %s MMIO reg\n", write_en ? "write to" : "read from");
+			if (!write_en)
+				ents[x]->value = 0;
+		}
+	}
+	free(ops);
+	return r;
+}
+
+// read contiguous MMIO runs out of a group (same bank) with preadv()
+static int batch_read_group_mmio2(struct umr_asic *asic, const struct access_view *v, struct umr_reg_batch **ents, int n)
+{
+	struct iovec iov[64];
+	uint64_t addr;
+	int x, y, r = 0;
+
+	if (mmio2_apply_bank(asic, v)) {
+		asic->err_msg("[ERROR]: Could not set register IOCTL state\n");
+		for (x = 0; x < n; x++)
+			ents[x]->value = 0;
+		return -1;
+	}
+
+	if (asic->uring)
+		return batch_rw_group_uring(asic, v, ents, n, 0);
+
+	for (x = 0; x < n; x = y) {
+		addr = batch_mmio_addr(v, ents[x]->addr);
+		iov[0].iov_base = &ents[x]->value;
+		iov[0].iov_len = 4;
+		for (y = x + 1; y < n && (y - x) < (int)(sizeof(iov)/sizeof(iov[0])) &&
+		     batch_mmio_addr(v, ents[y]->addr) == addr + 4 * (y - x); y++) {
+			iov[y - x].iov_base = &ents[y]->value;
+			iov[y - x].iov_len = 4;
+		}
+		if (umr_io_preadv(asic, UMR_IO_MMIO, v->fd_mmio2, iov, y - x, addr) != (ssize_t)(4 * (y - x))) {
+			asic->err_msg("[ERROR]: Cannot read from MMIO reg\n");
+			while (x < y)
+				ents[x++]->value = 0;
+			r = -1;
+		}
+	}
+	return r;
+}
+
+/**
+ * umr_read_regs_batch - Read an array of registers
+ *
+ * @asic: The device to read from
+ * @regs: Array of registers (address, type and bank) to read, the
+ *        values are stored in regs[].value
+ * @no_regs: Number of entries in @regs
+ *
+ * Entries are grouped by bank state so that on the regs2 debugfs
+ * interface each group requires a single SET_STATE ioctl, and runs of
+ * contiguous MMIO registers inside a group are fetched with one preadv().
+ * Reads are not guaranteed to be issued in array order.  If the io_uring
+ * backend is active each group is issued as a single submission instead.
+ *
+ * Backends with a read_regs_batch callback (rumr) are handed the whole
+ * array, for other backends (direct PCI, no-kernel, test harness, ...)
+ * the registers are read one at a time with asic->reg_funcs.
+ *
+ * Returns 0 on success, -1 if any register failed to read.
+ */
+int umr_read_regs_batch(struct umr_asic *asic, struct umr_reg_batch *regs, int no_regs)
+{
+	struct umr_reg_batch **ents;
+	struct access_view view, *v = &view;
+	union umr_bank_select bank;
+	int use_bank, x, y, z, r = 0;
+
+	if (no_regs <= 0)
+		return 0;
+	if (asic->reg_funcs.read_regs_batch)
+		return asic->reg_funcs.read_regs_batch(asic, regs, no_regs);
+
+	// other backends only know about the shared asic->options
+	access_view_get(asic, v);
+	if (asic->reg_funcs.read_reg != umr_read_reg && asic->reg_funcs.read_reg != umr_read_reg_uring) {
+		v->use_bank = &asic->options.use_bank;
+		v->bank = &asic->options.bank;
+	}
+	use_bank = *v->use_bank;
+	bank = *v->bank;
+
+	if ((asic->reg_funcs.read_reg != umr_read_reg && asic->reg_funcs.read_reg != umr_read_reg_uring) ||
+	    !batch_use_mmio2(asic)) {
+		for (x = 0; x < no_regs; x++) {
+			*v->use_bank = regs[x].use_bank;
+			*v->bank = regs[x].bank;
+			regs[x].value = asic->reg_funcs.read_reg(asic, regs[x].addr, regs[x].type);
+		}
+		*v->use_bank = use_bank;
+		*v->bank = bank;
+		return 0;
+	}
+
+	ents = calloc(no_regs, sizeof *ents);
+	if (!ents) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return -1;
+	}
+	for (x = 0; x < no_regs; x++)
+		ents[x] = &regs[x];
+	qsort(ents, no_regs, sizeof ents[0], batch_sort);
+
+	for (x = 0; x < no_regs; x = y) {
+		for (y = x + 1; y < no_regs && batch_same_bank(ents[x], ents[y]); y++);
+
+		*v->use_bank = ents[x]->use_bank;
+		*v->bank = ents[x]->bank;
+
+		// MMIO entries sort to the front of a group
+		for (z = x; z < y && ents[z]->type == REG_MMIO; z++);
+		if (z > x && batch_read_group_mmio2(asic, v, &ents[x], z - x))
+			r = -1;
+		for (; z < y; z++)
+			ents[z]->value = umr_read_reg(asic, ents[z]->addr, ents[z]->type);
+	}
+
+	*v->use_bank = use_bank;
+	*v->bank = bank;
+	free(ents);
+	return r;
+}
+
+/**
+ * umr_write_regs_batch - Write an array of registers
+ *
+ * @asic: The device to write to
+ * @regs: Array of registers (address, type, bank and value) to write
+ * @no_regs: Number of entries in @regs
+ *
+ * Writes are issued in array order.  Consecutive entries that share
+ * the same bank state are sent after a single bank select on the regs2
+ * debugfs interface.  Backends with a write_regs_batch callback (rumr)
+ * are handed the whole array.
+ *
+ * Returns 0 on success, -1 if any register failed to write.
+ */
+int umr_write_regs_batch(struct umr_asic *asic, struct umr_reg_batch *regs, int no_regs)
+{
+	struct umr_reg_batch **ents = NULL;
+	struct access_view view, *v = &view;
+	union umr_bank_select bank;
+	uint64_t addr;
+	int use_bank, x, y, z, r = 0;
+
+	if (no_regs <= 0)
+		return 0;
+	if (asic->reg_funcs.write_regs_batch)
+		return asic->reg_funcs.write_regs_batch(asic, regs, no_regs);
+
+	// other backends only know about the shared asic->options
+	access_view_get(asic, v);
+	if (asic->reg_funcs.write_reg != umr_write_reg && asic->reg_funcs.write_reg != umr_write_reg_uring) {
+		v->use_bank = &asic->options.use_bank;
+		v->bank = &asic->options.bank;
+	}
+	use_bank = *v->use_bank;
+	bank = *v->bank;
+
+	if ((asic->reg_funcs.write_reg != umr_write_reg && asic->reg_funcs.write_reg != umr_write_reg_uring) ||
+	    !batch_use_mmio2(asic)) {
+		for (x = 0; x < no_regs; x++) {
+			*v->use_bank = regs[x].use_bank;
+			*v->bank = regs[x].bank;
+			if (asic->reg_funcs.write_reg(asic, regs[x].addr, regs[x].value, regs[x].type))
+				r = -1;
+		}
+		*v->use_bank = use_bank;
+		*v->bank = bank;
+		return r;
+	}
+
+	for (x = 0; x < no_regs; x = y) {
+		*v->use_bank = regs[x].use_bank;
+		*v->bank = regs[x].bank;
+		if (mmio2_apply_bank(asic, v)) {
+			asic->err_msg("[ERROR]: Could not set register IOCTL state\n");
+			r = -1;
+			break;
+		}
+		if (asic->uring) {
+			// queue the run of MMIO writes as one (linked, so still
+			// ordered) submission
+			if (!ents)
+				ents = calloc(no_regs, sizeof *ents);
+			for (z = 0, y = x; ents && y < no_regs && regs[y].type == REG_MMIO &&
+			     batch_same_bank(&regs[x], &regs[y]); y++)
+				ents[z++] = &regs[y];
+			if (z) {
+				if (batch_rw_group_uring(asic, v, ents, z, 1))
+					r = -1;
+				continue;
+			}
+		}
+		for (y = x; y < no_regs && batch_same_bank(&regs[x], &regs[y]); y++) {
+			if (regs[y].type != REG_MMIO) {
+				if (umr_write_reg(asic, regs[y].addr, regs[y].value, regs[y].type))
+					r = -1;
+				continue;
+			}
+			addr = batch_mmio_addr(v, regs[y].addr);
+			if (umr_io_pwrite(asic, UMR_IO_MMIO, v->fd_mmio2, &regs[y].value, 4, addr) != 4) {
+				asic->err_msg("[ERROR]: Cannot write to MMIO reg\n");
+				r = -1;
+			}
+		}
+	}
+
+	*v->use_bank = use_bank;
+	*v->bank = bank;
+	free(ents);
+	return r;
+}
+
+/**
+ * umr_read_reg_uring - Read a register through the io_uring backend
+ *
+ * Drop-in replacement for umr_read_reg() in asic->reg_funcs.  A single
+ * register is cheaper with a plain pread() than with an io_uring_enter()
+ * round trip so it is forwarded to umr_read_reg(), the gain is in
+ * umr_read_regs_batch() which queues whole bank groups.
+ */
+uint32_t umr_read_reg_uring(struct umr_asic *asic, uint64_t addr, enum regclass type)
+{
+	return umr_read_reg(asic, addr, type);
+}
+
+/**
+ * umr_write_reg_uring - Write a register through the io_uring backend
+ *
+ * Drop-in replacement for umr_write_reg() in asic->reg_funcs, single
+ * registers are written with pwrite() (see umr_read_reg_uring()).
+ */
+int umr_write_reg_uring(struct umr_asic *asic, uint64_t addr, uint32_t value, enum regclass type)
+{
+	return umr_write_reg(asic, addr, value, type);
+}
+
+/* ==== 64-bit register access ==== */
+
+// can a LO/HI pair be accessed with one 8-byte operation?
+static int reg64_use_fast_path(struct umr_asic *asic, const struct access_view *v, uint64_t addr, enum regclass type)
+{
+	if (type != REG_MMIO || asic->options.no_kernel ||
+	    (asic->options.test_log && asic->options.test_log_fd))
+		return 0;
+	addr = batch_mmio_addr(v, addr);
+	if (umr_pci_regs(asic))
+		return !(addr & 7) && (addr + 8 <= asic->pci.size);
+	return asic->fd.mmio2 >= 0;
+}
+
+/**
+ * umr_read_reg64 - Read a 64-bit register in a single access
+ *
+ * @asic: The device the register is from
+ * @addr: The BYTE address of the LO half (the HI half follows it)
+ * @type: REG_MMIO, REG_SMC, etc
+ *
+ * Drop-in for the read_reg64 member of asic->reg_funcs.  Registers
+ * mapped through the PCI BAR are read with one 64-bit load and the
+ * regs2 interface is read with one 8-byte read() so both halves come
+ * from the same bank selection.  Everything else (SMC/PCIE, no_kernel
+ * mode, the test log) falls back to two umr_read_reg() calls.
+ */
+uint64_t umr_read_reg64(struct umr_asic *asic, uint64_t addr, enum regclass type)
+{
+	struct access_view view, *v = &view;
+	uint64_t value = 0;
+
+	access_view_get(asic, v);
+	if (!reg64_use_fast_path(asic, v, addr, type))
+		return (uint64_t)umr_read_reg(asic, addr, type) |
+		       ((uint64_t)umr_read_reg(asic, addr + 4, type) << 32);
+
+	addr = batch_mmio_addr(v, addr);
+	if (asic->pci.mem)
+		return *(volatile uint64_t *)&asic->pci.mem[addr/4];
+
+	if (mmio2_apply_bank(asic, v)) {
+		asic->err_msg("[ERROR]: Could not set register IOCTL state\n");
+		return 0;
+	}
+	if (umr_io_pread(asic, UMR_IO_MMIO, v->fd_mmio2, &value, 8, addr) != 8) {
+		asic->err_msg("[ERROR]: Cannot read from MMIO reg\n");
+		return 0;
+	}
+	return value;
+}
+
+/**
+ * umr_write_reg64 - Write a 64-bit register in a single access
+ *
+ * @asic: The device the register is from
+ * @addr: The BYTE address of the LO half (the HI half follows it)
+ * @value: The 64-bit value to write
+ * @type: REG_MMIO, REG_SMC, etc
+ *
+ * Counterpart of umr_read_reg64().  The LO half is written first on
+ * every path.
+ */
+int umr_write_reg64(struct umr_asic *asic, uint64_t addr, uint64_t value, enum regclass type)
+{
+	struct access_view view, *v = &view;
+
+	access_view_get(asic, v);
+	if (!reg64_use_fast_path(asic, v, addr, type)) {
+		if (umr_write_reg(asic, addr, value & 0xFFFFFFFFUL, type))
+			return -1;
+		return umr_write_reg(asic, addr + 4, value >> 32, type);
+	}
+
+	addr = batch_mmio_addr(v, addr);
+	if (asic->pci.mem) {
+		*(volatile uint64_t *)&asic->pci.mem[addr/4] = value;
+		return 0;
+	}
+
+	if (mmio2_apply_bank(asic, v)) {
+		asic->err_msg("[ERROR]: Could not set register IOCTL state\n");
+		return -1;
+	}
+	if (umr_io_pwrite(asic, UMR_IO_MMIO, v->fd_mmio2, &value, 8, addr) != 8) {
+		asic->err_msg("[ERROR]: Cannot write to MMIO reg\n");
+		return -1;
+	}
+	return 0;
+}
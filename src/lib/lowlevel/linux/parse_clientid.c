@@ -86,8 +86,7 @@ static int init_gfx9_queue(struct umr_asic *asic, int x, int *init)
 
             // sort out size of the buffer so we can modulo the rptr/wptr correctly.
             asic->options.user_queue.client_info.queue[x].rb_buf_size =
-                1 << (1 + umr_bitslice_reg_by_name_by_ip_by_instance(asic, "gfx", asic->options.vm_partition,
-                    "regCP_HQD_PQ_CONTROL", "QUEUE_SIZE", mqdwords[145]));
+                1 << (1 + umr_bitslice_core_reg(asic, UMR_CORE_CP_HQD_PQ_CONTROL, "QUEUE_SIZE", mqdwords[145]));
 
             // reduce the wptr/rptr values modulo the size of the queue buffer
             asic->options.user_queue.client_info.queue[x].rb_wptr_poll_value %= asic->options.user_queue.client_info.queue[x].rb_buf_size;
@@ -130,8 +129,7 @@ static int init_gfx9_queue(struct umr_asic *asic, int x, int *init)
             // TODO: sort out register in database to tie to
             // sort out size of the buffer so we can modulo the rptr/wptr correctly.
             asic->options.user_queue.client_info.queue[x].rb_buf_size =
-                1 << (1 + umr_bitslice_reg_by_name_by_ip_by_instance(asic, "gfx", asic->options.vm_partition,
-                    "regSDMA0_QUEUE0_RB_CNTL", "RB_SIZE", mqdwords[0]));
+                1 << (1 + umr_bitslice_core_reg(asic, UMR_CORE_SDMA0_QUEUE0_RB_CNTL, "RB_SIZE", mqdwords[0]));
 
             // reduce the wptr/rptr values modulo the size of the queue buffer
             asic->options.user_queue.client_info.queue[x].rb_wptr_poll_value %= asic->options.user_queue.client_info.queue[x].rb_buf_size;
@@ -177,8 +175,7 @@ static int init_gfx10_queue(struct umr_asic *asic, int x, int *init)
             // parse some fields of CP_GFX_HQD_CNTL (mqdwords[145])
                 // 2**(RB_BUFSZ+1)
                 asic->options.user_queue.client_info.queue[x].rb_buf_size =
-                    1 << (1 + umr_bitslice_reg_by_name_by_ip_by_instance(asic, "gfx", asic->options.vm_partition,
-                        "mmCP_GFX_HQD_CNTL", "RB_BUFSZ", mqdwords[145]));
+                    1 << (1 + umr_bitslice_core_reg(asic, UMR_CORE_CP_GFX_HQD_CNTL, "RB_BUFSZ", mqdwords[145]));
 
             // reduce the wptr/rptr values modulo the size of the queue buffer
             asic->options.user_queue.client_info.queue[x].rb_wptr_poll_value %= asic->options.user_queue.client_info.queue[x].rb_buf_size;
@@ -216,8 +213,7 @@ static int init_gfx10_queue(struct umr_asic *asic, int x, int *init)
 
             // sort out size of the buffer so we can modulo the rptr/wptr correctly.
             asic->options.user_queue.client_info.queue[x].rb_buf_size =
-                1 << (1 + umr_bitslice_reg_by_name_by_ip_by_instance(asic, "gfx", asic->options.vm_partition,
-                    "mmCP_HQD_PQ_CONTROL", "QUEUE_SIZE", mqdwords[145]));
+                1 << (1 + umr_bitslice_core_reg(asic, UMR_CORE_CP_HQD_PQ_CONTROL, "QUEUE_SIZE", mqdwords[145]));
 
             // reduce the wptr/rptr values modulo the size of the queue buffer
             asic->options.user_queue.client_info.queue[x].rb_wptr_poll_value %= asic->options.user_queue.client_info.queue[x].rb_buf_size;
@@ -262,8 +258,7 @@ static int init_gfx10_queue(struct umr_asic *asic, int x, int *init)
             // TOOD: sort out GFX10 SDMA control reg name/IP blocl
             // sort out size of the buffer so we can modulo the rptr/wptr correctly.
             asic->options.user_queue.client_info.queue[x].rb_buf_size =
-                1 << (1 + umr_bitslice_reg_by_name_by_ip_by_instance(asic, "gfx", asic->options.vm_partition,
-                    "regSDMA0_QUEUE0_RB_CNTL", "RB_SIZE", mqdwords[0]));
+                1 << (1 + umr_bitslice_core_reg(asic, UMR_CORE_SDMA0_QUEUE0_RB_CNTL, "RB_SIZE", mqdwords[0]));
 
             // reduce the wptr/rptr values modulo the size of the queue buffer
             asic->options.user_queue.client_info.queue[x].rb_wptr_poll_value %= asic->options.user_queue.client_info.queue[x].rb_buf_size;
@@ -309,8 +304,7 @@ static int init_gfx11_queue(struct umr_asic *asic, int x, int *init)
             // parse some fields of CP_GFX_HQD_CNTL (mqdwords[145])
                 // 2**(RB_BUFSZ+1)
                 asic->options.user_queue.client_info.queue[x].rb_buf_size =
-                    1 << (1 + umr_bitslice_reg_by_name_by_ip_by_instance(asic, "gfx", asic->options.vm_partition,
-                        "regCP_GFX_HQD_CNTL", "RB_BUFSZ", mqdwords[145]));
+                    1 << (1 + umr_bitslice_core_reg(asic, UMR_CORE_CP_GFX_HQD_CNTL, "RB_BUFSZ", mqdwords[145]));
 
             // reduce the wptr/rptr values modulo the size of the queue buffer
             asic->options.user_queue.client_info.queue[x].rb_wptr_poll_value %= asic->options.user_queue.client_info.queue[x].rb_buf_size;
@@ -348,8 +342,7 @@ static int init_gfx11_queue(struct umr_asic *asic, int x, int *init)
 
             // sort out size of the buffer so we can modulo the rptr/wptr correctly.
             asic->options.user_queue.client_info.queue[x].rb_buf_size =
-                1 << (1 + umr_bitslice_reg_by_name_by_ip_by_instance(asic, "gfx", asic->options.vm_partition,
-                    "regCP_HQD_PQ_CONTROL", "QUEUE_SIZE", mqdwords[145]));
+                1 << (1 + umr_bitslice_core_reg(asic, UMR_CORE_CP_HQD_PQ_CONTROL, "QUEUE_SIZE", mqdwords[145]));
 
             // reduce the wptr/rptr values modulo the size of the queue buffer
             asic->options.user_queue.client_info.queue[x].rb_wptr_poll_value %= asic->options.user_queue.client_info.queue[x].rb_buf_size;
@@ -393,8 +386,7 @@ static int init_gfx11_queue(struct umr_asic *asic, int x, int *init)
 
             // sort out size of the buffer so we can modulo the rptr/wptr correctly.
             asic->options.user_queue.client_info.queue[x].rb_buf_size =
-                1 << (1 + umr_bitslice_reg_by_name_by_ip_by_instance(asic, "gfx", asic->options.vm_partition,
-                    "regSDMA0_QUEUE0_RB_CNTL", "RB_SIZE", mqdwords[0]));
+                1 << (1 + umr_bitslice_core_reg(asic, UMR_CORE_SDMA0_QUEUE0_RB_CNTL, "RB_SIZE", mqdwords[0]));
 
             // reduce the wptr/rptr values modulo the size of the queue buffer
             asic->options.user_queue.client_info.queue[x].rb_wptr_poll_value %= asic->options.user_queue.client_info.queue[x].rb_buf_size;
@@ -440,8 +432,7 @@ static int init_gfx12_queue(struct umr_asic *asic, int x, int *init)
             // parse some fields of CP_GFX_HQD_CNTL (mqdwords[145])
                 // 2**(RB_BUFSZ+1)
                 asic->options.user_queue.client_info.queue[x].rb_buf_size =
-                    1 << (1 + umr_bitslice_reg_by_name_by_ip_by_instance(asic, "gfx", asic->options.vm_partition,
-                        "regCP_GFX_HQD_CNTL", "RB_BUFSZ", mqdwords[145]));
+                    1 << (1 + umr_bitslice_core_reg(asic, UMR_CORE_CP_GFX_HQD_CNTL, "RB_BUFSZ", mqdwords[145]));
 
             // reduce the wptr/rptr values modulo the size of the queue buffer
             asic->options.user_queue.client_info.queue[x].rb_wptr_poll_value %= asic->options.user_queue.client_info.queue[x].rb_buf_size;
@@ -479,8 +470,7 @@ static int init_gfx12_queue(struct umr_asic *asic, int x, int *init)
 
             // sort out size of the buffer so we can modulo the rptr/wptr correctly.
             asic->options.user_queue.client_info.queue[x].rb_buf_size =
-                1 << (1 + umr_bitslice_reg_by_name_by_ip_by_instance(asic, "gfx", asic->options.vm_partition,
-                    "regCP_HQD_PQ_CONTROL", "QUEUE_SIZE", mqdwords[145]));
+                1 << (1 + umr_bitslice_core_reg(asic, UMR_CORE_CP_HQD_PQ_CONTROL, "QUEUE_SIZE", mqdwords[145]));
 
             // reduce the wptr/rptr values modulo the size of the queue buffer
             asic->options.user_queue.client_info.queue[x].rb_wptr_poll_value %= asic->options.user_queue.client_info.queue[x].rb_buf_size;
@@ -524,8 +514,7 @@ static int init_gfx12_queue(struct umr_asic *asic, int x, int *init)
 
             // sort out size of the buffer so we can modulo the rptr/wptr correctly.
             asic->options.user_queue.client_info.queue[x].rb_buf_size =
-                1 << (1 + umr_bitslice_reg_by_name_by_ip_by_instance(asic, "gfx", asic->options.vm_partition,
-                    "regSDMA0_QUEUE0_RB_CNTL", "RB_SIZE", mqdwords[0]));
+                1 << (1 + umr_bitslice_core_reg(asic, UMR_CORE_SDMA0_QUEUE0_RB_CNTL, "RB_SIZE", mqdwords[0]));
 
             // reduce the wptr/rptr values modulo the size of the queue buffer
             asic->options.user_queue.client_info.queue[x].rb_wptr_poll_value %= asic->options.user_queue.client_info.queue[x].rb_buf_size;
@@ -539,6 +528,300 @@ static int init_gfx12_queue(struct umr_asic *asic, int x, int *init)
     return 0;
 }
 
+/*
+ * The contents of kfd/mqds, one entry per process with the queues of
+ * every block listed for it in file order.  The file is parsed once per
+ * lookup or enumeration and clients are joined against it by tgid.
+ */
+struct kfd_mqd_process {
+    uint32_t pid;
+    int no_queues;
+    struct kfd_mqd_queue {
+        enum umr_queue_type queue_type;
+        uint32_t mqd_words[UMR_MAX_MQD_SIZE];
+    } *queues;
+};
+
+struct kfd_mqds {
+    struct kfd_mqd_process *procs; // sorted by pid once loaded
+    int no_procs;
+};
+
+static int cmp_kfd_process(const void *a, const void *b)
+{
+    const struct kfd_mqd_process *pa = a, *pb = b;
+    return (pa->pid > pb->pid) - (pa->pid < pb->pid);
+}
+
+static void kfd_mqds_free(struct kfd_mqds *mqds)
+{
+    int x;
+
+    for (x = 0; x < mqds->no_procs; x++)
+        free(mqds->procs[x].queues);
+    free(mqds->procs);
+    memset(mqds, 0, sizeof *mqds);
+}
+
+/**
+ * kfd_mqds_load - Parse /sys/kernel/debug/kfd/mqds into @mqds
+ *
+ * Returns -1 if the file could not be opened or memory ran out.
+ */
+static int kfd_mqds_load(struct umr_asic *asic, struct kfd_mqds *mqds)
+{
+    struct kfd_mqd_process *proc;
+    char line[512];
+    uint32_t t[9], pid, pasid;
+    int p = -1, q = -1;
+    void *tmp;
+    FILE *f;
+
+    memset(mqds, 0, sizeof *mqds);
+    f = fopen("/sys/kernel/debug/kfd/mqds", "r");
+    if (!f)
+        return -1;
+
+    while (fgets(line, sizeof(line) - 1, f)) {
+        if (sscanf(line, "Process %"SCNu32" PASID %"SCNu32":", &pid, &pasid) == 2) {
+            // a process may be listed once per device, its queues are appended
+            for (p = 0; p < mqds->no_procs && mqds->procs[p].pid != pid; p++);
+            if (p == mqds->no_procs) {
+                tmp = realloc(mqds->procs, (p + 1) * sizeof *mqds->procs);
+                if (!tmp)
+                    goto error;
+                mqds->procs = tmp;
+                memset(&mqds->procs[p], 0, sizeof mqds->procs[p]);
+                mqds->procs[p].pid = pid;
+                ++(mqds->no_procs);
+            }
+            q = -1;
+        } else if (p >= 0 && (!memcmp(line, "  Compute", 9) || !memcmp(line, "  SDMA", 6))) {
+            // TODO: match the device 'asic' actually refers to, right now we just parse all queues in for the PID
+            proc = &mqds->procs[p];
+            tmp = realloc(proc->queues, (proc->no_queues + 1) * sizeof *proc->queues);
+            if (!tmp)
+                goto error;
+            proc->queues = tmp;
+            q = proc->no_queues++;
+            memset(&proc->queues[q], 0, sizeof proc->queues[q]);
+            proc->queues[q].queue_type = line[2] == 'C' ? UMR_QUEUE_COMPUTE : UMR_QUEUE_SDMA;
+        } else if (q >= 0 && sscanf(line, "%"SCNx32": %"SCNx32" %"SCNx32" %"SCNx32" %"SCNx32" %"SCNx32" %"SCNx32" %"SCNx32" %"SCNx32,
+                &t[0], &t[1], &t[2], &t[3], &t[4], &t[5], &t[6], &t[7], &t[8]) == 9) {
+            // store the line of data in the mqd struct
+            if (((t[0]/4)+7) >= UMR_MAX_MQD_SIZE) {
+                asic->err_msg("[BUG]: Reading MQD from KFD 'mqds' file resulted in offset (%"PRIu32") beyond UMR_MAX_MQD_SIZE\n", t[0]/4);
+            } else {
+                memcpy(&mqds->procs[p].queues[q].mqd_words[t[0]/4], &t[1], 32);
+            }
+        } else {
+            // anything else ends the block of the process
+            p = q = -1;
+        }
+    }
+    fclose(f);
+
+    if (mqds->no_procs)
+        qsort(mqds->procs, mqds->no_procs, sizeof *mqds->procs, cmp_kfd_process);
+    return 0;
+error:
+    asic->err_msg("[ERROR]: Out of memory parsing /sys/kernel/debug/kfd/mqds\n");
+    fclose(f);
+    kfd_mqds_free(mqds);
+    return -1;
+}
+
+static struct kfd_mqd_process *kfd_mqds_find(const struct kfd_mqds *mqds, const char *tgid)
+{
+    struct kfd_mqd_process key = { 0 };
+
+    if (!mqds || !mqds->no_procs)
+        return NULL;
+    key.pid = strtoul(tgid, NULL, 10);
+    return bsearch(&key, mqds->procs, mqds->no_procs, sizeof key, cmp_kfd_process);
+}
+
+/**
+ * load_client - Read the queues of the client in asic->options.user_queue.client_line
+ * @mqds: The parsed kfd/mqds file for KFD clients, NULL if it could not be read
+ * @use_type: Whether @queueid is a queue type rather than a queue id
+ * @queueid: The queue to select in asic->options.user_queue.state.qidx
+ *
+ * The client_type must already be set.  Returns -1 on error.
+ */
+static int load_client(struct umr_asic *asic, const struct kfd_mqds *mqds, int use_type, uint64_t queueid)
+{
+    struct kfd_mqd_process *proc;
+    int gfx_maj, gfx_min, total_queues = 0, queueno, x;
+    char path[512];
+    uint64_t tmp;
+    FILE *f;
+
+    memset(&asic->options.user_queue.client_info, 0, sizeof asic->options.user_queue.client_info);
+    asic->options.user_queue.state.qidx = -1;
+
+    // ok we found the client-id let's read proc_info
+    sprintf(path, "/sys/kernel/debug/dri/client-%s/proc_info", asic->options.user_queue.client_line.id);
+    f = fopen(path, "r");
+    if (f) {
+        if (fscanf(f, "pid: %"SCNu32"\ncomm: %s",
+                &asic->options.user_queue.client_info.proc_info.pid,
+                asic->options.user_queue.client_info.proc_info.comm) != 2) {
+            asic->err_msg("[ERROR]: Could not parse proc_info file %s\n", path);
+            fclose(f);
+            return -1;
+        }
+        fclose(f);
+    } else {
+        asic->err_msg("[ERROR]: Could not open client's proc_info file from %s\n", path);
+        return -1;
+    }
+
+    // parse the vm_pagetable_info file
+    sprintf(path, "/sys/kernel/debug/dri/client-%s/vm_pagetable_info", asic->options.user_queue.client_line.id);
+    f = fopen(path, "r");
+    if (f) {
+        if (fscanf(f, "pd_address: %"SCNx64"\nmax_pfn: %"SCNx64"\nnum_level: %"SCNx32"\nblock_size: %"SCNx32"\nfragment_size: %"SCNx32,
+                &asic->options.user_queue.client_info.vm_pagetable_info.pd_address,
+                &asic->options.user_queue.client_info.vm_pagetable_info.max_pfn,
+                &asic->options.user_queue.client_info.vm_pagetable_info.num_level,
+                &asic->options.user_queue.client_info.vm_pagetable_info.block_size,
+                &asic->options.user_queue.client_info.vm_pagetable_info.fragment_size) != 5) {
+            asic->err_msg("[ERROR]: Could not parse vm_pagetable_info file %s\n", path);
+            fclose(f);
+            return -1;
+        }
+        fclose(f);
+    } else {
+        asic->err_msg("[ERROR]: Could not open client's vm_pagetable_info file from %s\n", path);
+        return -1;
+    }
+
+    umr_gfx_get_ip_ver(asic, &gfx_maj, &gfx_min);
+
+    // disable VM translations using the queue state (in case the caller has called this more than once)
+    // at this point all VM page walks/read/writes will use live MMIO registers to access VM context registers.
+    asic->options.user_queue.state.active = 0;
+
+    // we can initialize a few registers...
+    // use max_pfn to compute a mask for the VA span.
+    tmp = ((asic->options.user_queue.client_info.vm_pagetable_info.max_pfn) - 1) & 0xFFFFFFFFFFFFULL;
+    asic->options.user_queue.state.registers.PAGE_TABLE_END_ADDR_LO32 = tmp & 0xFFFFFFFF;
+    asic->options.user_queue.state.registers.PAGE_TABLE_END_ADDR_HI32 = (tmp >> 32ULL) & 0xF;
+    tmp &= asic->options.user_queue.client_info.vm_pagetable_info.pd_address;
+    asic->options.user_queue.state.registers.PAGE_TABLE_BASE_ADDR_LO32 = tmp & 0xFFFFFFFF;
+    asic->options.user_queue.state.registers.PAGE_TABLE_BASE_ADDR_HI32 = tmp >> 32ULL;
+
+    // now read upto UMR_MAX_MQD_QUEUES from the dir of the form queue-${queueno}/
+    if (asic->options.user_queue.client_type == UMR_CLIENT_KGD) {
+        // we're reading queues for this client based on the kgd debugfs tree
+        for (queueno = 1; queueno < 256; queueno++) {
+            if (total_queues == UMR_MAX_MQD_QUEUES)
+                break;
+            sprintf(path, "/sys/kernel/debug/dri/client-%s/queue-%d/mqd_info", asic->options.user_queue.client_line.id, queueno);
+            f = fopen(path, "r");
+            if (f) {
+                uint32_t queue_type;
+                if (fscanf(f, "queue_type: %"SCNu32"\nmqd_gpu_address: %"SCNx64,
+                    &queue_type,
+                    &asic->options.user_queue.client_info.queue[total_queues].mqd_gpu_address) == 2) {
+                    int mqd_type = -1;
+
+                    switch (queue_type) {
+                        case 0:
+                            asic->options.user_queue.client_info.queue[total_queues].queue_type = UMR_QUEUE_GFX;
+                            mqd_type = UMR_MQD_ENGINE_GFX;
+                            break;
+                        case 1:
+                            asic->options.user_queue.client_info.queue[total_queues].queue_type = UMR_QUEUE_COMPUTE;
+                            mqd_type = UMR_MQD_ENGINE_COMPUTE;
+                            break;
+                        case 2:
+                            asic->options.user_queue.client_info.queue[total_queues].queue_type = UMR_QUEUE_SDMA;
+                            mqd_type = UMR_MQD_ENGINE_SDMA0;
+                            break;
+                        default:
+                            asic->err_msg("[BUG]: Unsupported client queue type [%"PRIu32"]\n", queue_type);
+                    }
+                    asic->options.user_queue.client_info.queue[total_queues].queue_id = queueno;
+                    if (mqd_type != -1) {
+                        asic->options.user_queue.client_info.queue[total_queues].mqd_size = umr_mqd_decode_size(mqd_type, asic->family);
+                        if (umr_read_vram(asic, asic->options.vm_partition, 0,
+                                asic->options.user_queue.client_info.queue[total_queues].mqd_gpu_address,
+                                asic->options.user_queue.client_info.queue[total_queues].mqd_size*4,
+                                &asic->options.user_queue.client_info.queue[total_queues].mqd_words) < 0) {
+                            asic->err_msg("[ERROR]: Could not read the MQD from memory for %s\n", path);
+                        }
+                    }
+                    ++total_queues;
+                } else {
+                    asic->err_msg("[ERROR]: Could not parse the MQD info file %s\n", path);
+                }
+                fclose(f);
+            }
+        }
+    } else if (asic->options.user_queue.client_type == UMR_CLIENT_KFD) {
+        // we're reading queues for this client based on the kfd debugfs tree
+        if (!mqds) {
+            asic->err_msg("[ERROR]: Could not open /sys/kernel/debug/kfd/mqds\n");
+        } else if ((proc = kfd_mqds_find(mqds, asic->options.user_queue.client_line.tgid))) {
+            for (x = 0; x < proc->no_queues && x < UMR_MAX_MQD_QUEUES; x++) {
+                asic->options.user_queue.client_info.queue[x].queue_type = proc->queues[x].queue_type;
+                asic->options.user_queue.client_info.queue[x].queue_id = x;
+                memcpy(asic->options.user_queue.client_info.queue[x].mqd_words, proc->queues[x].mqd_words, sizeof proc->queues[x].mqd_words);
+
+                // resolve MQD addresses
+                if (proc->queues[x].queue_type == UMR_QUEUE_COMPUTE) {
+                    asic->options.user_queue.client_info.queue[x].mqd_size = umr_mqd_decode_size(UMR_MQD_ENGINE_COMPUTE, asic->family);
+                    asic->options.user_queue.client_info.queue[x].mqd_gpu_address =
+                        ((uint64_t)asic->options.user_queue.client_info.queue[x].mqd_words[129] << 32ULL) |
+                        asic->options.user_queue.client_info.queue[x].mqd_words[128];
+                } else {
+                    asic->options.user_queue.client_info.queue[x].mqd_size = umr_mqd_decode_size(UMR_MQD_ENGINE_SDMA0, asic->family);
+                    asic->options.user_queue.client_info.queue[x].mqd_gpu_address =
+                        ((uint64_t)asic->options.user_queue.client_info.queue[x].mqd_words[45] << 32ULL) |
+                        asic->options.user_queue.client_info.queue[x].mqd_words[44];
+                }
+            }
+        }
+    }
+
+    // enable VM translations using the queue state
+    // at this point all VM page walks/read/writes will use the values programmed into user_queue.state.registers
+    asic->options.user_queue.state.active = 1;
+
+    // parse the MQD and HQD to setup the address/rptr/wptr of the command packets
+    for (x = 0; x < UMR_MAX_MQD_QUEUES; x++) {
+        if (asic->options.user_queue.client_info.queue[x].mqd_gpu_address) {
+            int init = 0, r = -1;
+
+            if (gfx_maj == 9) {
+                r = init_gfx9_queue(asic, x, &init);
+            } else if (gfx_maj == 10) {
+                r = init_gfx10_queue(asic, x, &init);
+            } else if (gfx_maj == 11) {
+                r = init_gfx11_queue(asic, x, &init);
+            } else if (gfx_maj == 12) {
+                r = init_gfx12_queue(asic, x, &init);
+            } else {
+                asic->err_msg("[BUG]: The gfx maj %d is not currently supported by umr for user queues\n", gfx_maj);
+                return -1;
+            }
+            if (r < 0) {
+                return -1;
+            }
+            // we're done
+            if (init) {
+                if ((!use_type && (queueid == asic->options.user_queue.client_info.queue[x].queue_id)) ||
+                    (use_type && (queueid == asic->options.user_queue.client_info.queue[x].queue_type))) {
+                        asic->options.user_queue.state.qidx = x;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
 /**
  * umr_parse_clientid -- Parse the user_queue structure fields against debugfs
  * This allows UMR to bind to a specific user queue for debugging command submissions
@@ -568,13 +851,13 @@ static int init_gfx12_queue(struct umr_asic *asic, int x, int *init)
  */
 struct umr_user_queue umr_parse_clientid(struct umr_asic *asic, const char *cid)
 {
-    int client_named = 0, use_name = 0, use_pid = 0, use_type = 0, found = 0, x;
-    int gfx_maj, gfx_min;
-    uint64_t queueid = 0, tmp;
+    int client_named = 0, use_name = 0, use_pid = 0, use_type = 0, found = 0, have_mqds = 0;
+    uint64_t queueid = 0;
     char p[256], pp[256], str[256], path[512];
     const char *ps, *pps;
     FILE *f;
     struct umr_user_queue retq = { 0 }, tmpq = { 0 };
+    struct kfd_mqds mqds = { 0 };
 
     // save the current queue because we'll need to override it
     retq.state.qidx = -1;
@@ -650,6 +933,10 @@ struct umr_user_queue umr_parse_clientid(struct umr_asic *asic, const char *cid)
     // pp => queue id, type
     // use_type, use_name, use_pid must be initialized.
 
+    // kfd/mqds is needed to tell the client type apart and for the queues of KFD clients
+    if (!client_named || asic->options.user_queue.client_type == UMR_CLIENT_KFD)
+        have_mqds = !kfd_mqds_load(asic, &mqds);
+
     // now p points to the procname or clientid and pp points to the queueid
     sprintf(path, "/sys/kernel/debug/dri/%d/clients", asic->instance);
     f = fopen(path, "r");
@@ -673,22 +960,10 @@ struct umr_user_queue umr_parse_clientid(struct umr_asic *asic, const char *cid)
                     // found the entry
                     found = 1;
                     if (!client_named) {
-                        // try to auto detect the client type
-                        FILE *cf;
-                        char buf[256], str[256];
                         // a KFD client is one where the PID is found in kfd/mqds as "Process ${tgid}"
-                        asic->options.user_queue.client_type = UMR_CLIENT_KGD;
-                        cf = fopen("/sys/kernel/debug/kfd/mqds", "r");
-                        if (cf) {
-                            sprintf(str, "Process %s", asic->options.user_queue.client_line.tgid);
-                            while(fgets(buf, sizeof buf, cf)) {
-                                if (strstr(buf, str)) {
-                                    asic->options.user_queue.client_type = UMR_CLIENT_KFD;
-                                    break;
-                                }
-                            }
-                            fclose(cf);
-                        }
+                        asic->options.user_queue.client_type =
+                            kfd_mqds_find(have_mqds ? &mqds : NULL, asic->options.user_queue.client_line.tgid) ?
+                                UMR_CLIENT_KFD : UMR_CLIENT_KGD;
                     }
                     break;
                 }
@@ -701,214 +976,17 @@ struct umr_user_queue umr_parse_clientid(struct umr_asic *asic, const char *cid)
     fclose(f);
 
     // we found the client now let's read it into memory
-    if (found) {
-        int total_queues = 0, queueno = 1;
-
-        // ok we found the client-id let's read proc_info
-        sprintf(path, "/sys/kernel/debug/dri/client-%s/proc_info", asic->options.user_queue.client_line.id);
-        f = fopen(path, "r");
-        if (f) {
-            if (fscanf(f, "pid: %"SCNu32"\ncomm: %s",
-                    &asic->options.user_queue.client_info.proc_info.pid,
-                    asic->options.user_queue.client_info.proc_info.comm) != 2) {
-                asic->err_msg("[ERROR]: Could not parse proc_info file %s\n", path);
-                fclose(f);
-                goto error;
-            }
-            fclose(f);
-        } else {
-            asic->err_msg("[ERROR]: Could not open client's proc_info file from %s\n", path);
-            goto error;
-        }
-
-        // parse the vm_pagetable_info file
-        sprintf(path, "/sys/kernel/debug/dri/client-%s/vm_pagetable_info", asic->options.user_queue.client_line.id);
-        f = fopen(path, "r");
-        if (f) {
-            if (fscanf(f, "pd_address: %"SCNx64"\nmax_pfn: %"SCNx64"\nnum_level: %"SCNx32"\nblock_size: %"SCNx32"\nfragment_size: %"SCNx32,
-                    &asic->options.user_queue.client_info.vm_pagetable_info.pd_address,
-                    &asic->options.user_queue.client_info.vm_pagetable_info.max_pfn,
-                    &asic->options.user_queue.client_info.vm_pagetable_info.num_level,
-                    &asic->options.user_queue.client_info.vm_pagetable_info.block_size,
-                    &asic->options.user_queue.client_info.vm_pagetable_info.fragment_size) != 5) {
-                asic->err_msg("[ERROR]: Could not parse vm_pagetable_info file %s\n", path);
-                fclose(f);
-                goto error;
-            }
-            fclose(f);
-        } else {
-            asic->err_msg("[ERROR]: Could not open client's vm_pagetable_info file from %s\n", path);
-            goto error;
-        }
-
-		umr_gfx_get_ip_ver(asic, &gfx_maj, &gfx_min);
-
-        // disable VM translations using the queue state (in case the caller has called this more than once)
-        // at this point all VM page walks/read/writes will use live MMIO registers to access VM context registers.
-        asic->options.user_queue.state.active = 0;
-
-        // we can initialize a few registers...
-        // use max_pfn to compute a mask for the VA span.
-        tmp = ((asic->options.user_queue.client_info.vm_pagetable_info.max_pfn) - 1) & 0xFFFFFFFFFFFFULL;
-        asic->options.user_queue.state.registers.PAGE_TABLE_END_ADDR_LO32 = tmp & 0xFFFFFFFF;
-        asic->options.user_queue.state.registers.PAGE_TABLE_END_ADDR_HI32 = (tmp >> 32ULL) & 0xF;
-        tmp &= asic->options.user_queue.client_info.vm_pagetable_info.pd_address;
-        asic->options.user_queue.state.registers.PAGE_TABLE_BASE_ADDR_LO32 = tmp & 0xFFFFFFFF;
-        asic->options.user_queue.state.registers.PAGE_TABLE_BASE_ADDR_HI32 = tmp >> 32ULL;
-
-        // now read upto UMR_MAX_MQD_QUEUES from the dir of the form queue-${queueno}/
-        if (asic->options.user_queue.client_type == UMR_CLIENT_KGD) {
-            // we're reading queues for this client based on the kgd debugfs tree
-            for (queueno = 1; queueno < 256; queueno++) {
-                if (total_queues == UMR_MAX_MQD_QUEUES)
-                    break;
-                sprintf(path, "/sys/kernel/debug/dri/client-%s/queue-%d/mqd_info", asic->options.user_queue.client_line.id, queueno);
-                f = fopen(path, "r");
-                if (f) {
-                    uint32_t queue_type;
-                    if (fscanf(f, "queue_type: %"SCNu32"\nmqd_gpu_address: %"SCNx64,
-                        &queue_type,
-                        &asic->options.user_queue.client_info.queue[total_queues].mqd_gpu_address) == 2) {
-                        int mqd_type = -1;
-
-                        switch (queue_type) {
-                            case 0:
-                                asic->options.user_queue.client_info.queue[total_queues].queue_type = UMR_QUEUE_GFX;
-                                mqd_type = UMR_MQD_ENGINE_GFX;
-                                break;
-                            case 1:
-                                asic->options.user_queue.client_info.queue[total_queues].queue_type = UMR_QUEUE_COMPUTE;
-                                mqd_type = UMR_MQD_ENGINE_COMPUTE;
-                                break;
-                            case 2:
-                                asic->options.user_queue.client_info.queue[total_queues].queue_type = UMR_QUEUE_SDMA;
-                                mqd_type = UMR_MQD_ENGINE_SDMA0;
-                                break;
-                            default:
-                                asic->err_msg("[BUG]: Unsupported client queue type [%"PRIu32"]\n", queue_type);
-                        }
-                        asic->options.user_queue.client_info.queue[total_queues].queue_id = queueno;
-                        if (mqd_type != -1) {
-                            asic->options.user_queue.client_info.queue[total_queues].mqd_size = umr_mqd_decode_size(mqd_type, asic->family);
-                            if (umr_read_vram(asic, asic->options.vm_partition, 0,
-                                    asic->options.user_queue.client_info.queue[total_queues].mqd_gpu_address,
-                                    asic->options.user_queue.client_info.queue[total_queues].mqd_size*4,
-                                    &asic->options.user_queue.client_info.queue[total_queues].mqd_words) < 0) {
-                                asic->err_msg("[ERROR]: Could not read the MQD from memory for %s\n", path);
-                            }
-                        }
-                        ++total_queues;
-                    } else {
-                        asic->err_msg("[ERROR]: Could not parse the MQD info file %s\n", path);
-                    }
-                    fclose(f);
-                }
-            }
-        } else if (asic->options.user_queue.client_type == UMR_CLIENT_KFD) {
-            // we're reading queues for this client based on the kfd debugfs tree
-            memset(&asic->options.user_queue.client_info.queue, 0, sizeof(asic->options.user_queue.client_info.queue));
-            f = fopen("/sys/kernel/debug/kfd/mqds", "r");
-            if (f) {
-                char line[512];
-                uint32_t t[9];
-                uint32_t pid, pasid;
-
-                // start at -1 since the first queue increments this before storing data
-                total_queues = -1;
-
-                // scan for a line matching the PID/tgid
-                while (fgets(line, sizeof(line) - 1, f)) {
-                    if (sscanf(line, "Process %"SCNu32" PASID %"SCNu32":", &pid, &pasid) == 2) {
-                        if (pid == strtoul(asic->options.user_queue.client_line.tgid, NULL, 10)) {
-                            // this KFD queue matches the PID, so let's copy any Compute queues found here
-                            while (fgets(line, sizeof(line) - 1, f)) {
-                                if (!memcmp(line, "  Compute", 9)) {
-                                    // TODO: match the device 'asic' actually refers to, right now we just parse all queues in for the PID
-                                    // start a new queue
-                                    ++total_queues;
-                                    asic->options.user_queue.client_info.queue[total_queues].queue_type = UMR_QUEUE_COMPUTE;
-                                    asic->options.user_queue.client_info.queue[total_queues].queue_id = total_queues;
-                                    asic->options.user_queue.client_info.queue[total_queues].mqd_size = umr_mqd_decode_size(UMR_MQD_ENGINE_COMPUTE, asic->family);
-                                } else if (!memcmp(line, "  SDMA", 6)) {
-                                    ++total_queues;
-                                    asic->options.user_queue.client_info.queue[total_queues].queue_type = UMR_QUEUE_SDMA;
-                                    asic->options.user_queue.client_info.queue[total_queues].queue_id = total_queues;
-                                    asic->options.user_queue.client_info.queue[total_queues].mqd_size = umr_mqd_decode_size(UMR_MQD_ENGINE_SDMA0, asic->family);
-                                } else if (total_queues >= 0 && sscanf(line, "%"SCNx32": %"SCNx32" %"SCNx32" %"SCNx32" %"SCNx32" %"SCNx32" %"SCNx32" %"SCNx32" %"SCNx32,
-                                    &t[0], &t[1], &t[2], &t[3], &t[4], &t[5], &t[6], &t[7], &t[8]) == 9) {
-                                    // store the line of data in the mqd struct
-                                    if (((t[0]/4)+7) >= UMR_MAX_MQD_SIZE) {
-                                        asic->err_msg("[BUG]: Reading MQD from KFD 'mqds' file resulted in offset (%"PRIu32") beyond UMR_MAX_MQD_SIZE\n", t[0]/4);
-                                    } else {
-                                        memcpy(&asic->options.user_queue.client_info.queue[total_queues].mqd_words[t[0]/4], &t[1], 32);
-                                    }
-                                } else {
-                                    break;
-                                }
-                            }
-                        }
-                        // TODO: should we break here? or parse in all queues for a given PID?
-                    }
-                }
-                // resolve MQD addresses for compute queues
-                for (queueno = 0; queueno < total_queues; queueno++) {
-                    if (asic->options.user_queue.client_info.queue[queueno].queue_type == UMR_QUEUE_COMPUTE) {
-                        asic->options.user_queue.client_info.queue[queueno].mqd_gpu_address =
-                            ((uint64_t)asic->options.user_queue.client_info.queue[queueno].mqd_words[129] << 32ULL) |
-                            asic->options.user_queue.client_info.queue[queueno].mqd_words[128];
-                    } else if (asic->options.user_queue.client_info.queue[queueno].queue_type == UMR_QUEUE_SDMA) {
-                        asic->options.user_queue.client_info.queue[queueno].mqd_gpu_address =
-                            ((uint64_t)asic->options.user_queue.client_info.queue[queueno].mqd_words[45] << 32ULL) |
-                            asic->options.user_queue.client_info.queue[queueno].mqd_words[44];
-                    }
-                }
-            } else {
-                asic->err_msg("[ERROR]: Could not open /sys/kernel/debug/kfd/mqds\n");
-            }
-            fclose(f);
-        }
-    } else {
+    if (!found) {
         asic->err_msg("[ERROR]: The client '%s' was not found for this device.\n", asic->options.user_queue.clientid);
         memset(&asic->options.user_queue, 0, sizeof asic->options.user_queue);
         goto error;
     }
-
-    // enable VM translations using the queue state
-    // at this point all VM page walks/read/writes will use the values programmed into user_queue.state.registers
-    asic->options.user_queue.state.active = 1;
-
-    // parse the MQD and HQD to setup the address/rptr/wptr of the command packets
-    for (x = 0; x < UMR_MAX_MQD_QUEUES; x++) {
-        if (asic->options.user_queue.client_info.queue[x].mqd_gpu_address) {
-            int init = 0, r = -1;
-
-            if (gfx_maj == 9) {
-                r = init_gfx9_queue(asic, x, &init);
-            } else if (gfx_maj == 10) {
-                r = init_gfx10_queue(asic, x, &init);
-            } else if (gfx_maj == 11) {
-                r = init_gfx11_queue(asic, x, &init);
-            } else if (gfx_maj == 12) {
-                r = init_gfx12_queue(asic, x, &init);
-            } else {
-                asic->err_msg("[BUG]: The gfx maj %d is not currently supported by umr for user queues\n", gfx_maj);
-                goto error;
-            }
-            if (r < 0) {
-                goto error;
-            }
-            // we're done
-            if (init) {
-                if ((!use_type && (queueid == asic->options.user_queue.client_info.queue[x].queue_id)) ||
-                    (use_type && (queueid == asic->options.user_queue.client_info.queue[x].queue_type))) {
-                        asic->options.user_queue.state.qidx = x;
-                }
-            }
-        }
-    }
+    if (load_client(asic, have_mqds ? &mqds : NULL, use_type, queueid) < 0)
+        goto error;
 
     retq = asic->options.user_queue;
 error:
+    kfd_mqds_free(&mqds);
     asic->options.user_queue = tmpq;
     return retq;
 }
@@ -929,33 +1007,41 @@ int umr_init_clientid(struct umr_asic *asic)
         // read from live system
         strcpy(cid, asic->options.user_queue.clientid);
         asic->options.user_queue = umr_parse_clientid(asic, cid);
+        // the process memory handle belongs to the previous queue
+        umr_close_proc_mem(asic);
 
         // Store user queue selected to the test harness
-        if (asic->options.test_log && asic->options.test_log_fd) {
-            uint8_t *p = (uint8_t *)&asic->options.user_queue;
-            unsigned x;
-            fprintf(asic->options.test_log_fd, "USERQUEUE = {");
-            for (x = 0; x < sizeof(asic->options.user_queue); x++) {
-                fprintf(asic->options.test_log_fd, "%02"PRIx8, p[x]);
-            }
-            fprintf(asic->options.test_log_fd, "}\n");
-        }
+        if (asic->options.test_log && asic->options.test_log_fd)
+            umr_test_log_bytes(&asic->options, UMR_TV_USERQUEUE, 0, &asic->options.user_queue, sizeof(asic->options.user_queue));
     }
     // done
     return asic->options.user_queue.state.qidx == -1 ? -1 : 0;
 }
 
+/**
+ * umr_enumerate_user_queue_clients - List every client of the device with its queues
+ *
+ * kfd/mqds is parsed once and joined by tgid against a single pass over
+ * the clients file.  Returns a list to be freed with umr_user_queue_free().
+ */
 struct umr_user_queue *umr_enumerate_user_queue_clients(struct umr_asic *asic)
 {
-    struct umr_user_queue *lq = NULL, *tq;
+    struct umr_user_queue *lq = NULL, *tq, *saved;
+    struct kfd_mqds mqds = { 0 };
     char path[512], buf[512];
-    FILE *f = NULL, *cf = NULL;
+    FILE *f = NULL;
+    int have_mqds = 0;
+
+    // the clients are loaded in place in asic->options.user_queue like umr_parse_clientid() does
+    saved = malloc(sizeof *saved);
+    if (!saved)
+        return NULL;
+    *saved = asic->options.user_queue;
 
     lq = calloc(1, sizeof *lq);
     if (!lq)
         goto error;
 
-    // now p points to the procname or clientid and pp points to the queueid
     sprintf(path, "/sys/kernel/debug/dri/%d/clients", asic->instance);
     f = fopen(path, "r");
     if (!f) {
@@ -963,41 +1049,42 @@ struct umr_user_queue *umr_enumerate_user_queue_clients(struct umr_asic *asic)
         goto error;
     }
 
+    // a rumr client fetches each queue from the server instead
+    if (!asic->options.rumr_active)
+        have_mqds = !kfd_mqds_load(asic, &mqds);
+
     // scan file for the target client
     if (fgets(path, sizeof path, f)) {
         while (fgets(path, sizeof path, f)) {
-            int kgd_mode = 1;
-            struct {
-                char command[256], tgid[32], dev[32], master[32], a[32], uid[32], magic[32], name[256], id[32];
-            } client_line;
-
+            asic->options.user_queue = *saved;
             if (sscanf(path, "%s %s %s %s %s %s %s %s %s",
-                client_line.command, client_line.tgid,
-                client_line.dev, client_line.master,
-                client_line.a, client_line.uid,
-                client_line.magic, client_line.name,
-                client_line.id) != 9) {
+                asic->options.user_queue.client_line.command, asic->options.user_queue.client_line.tgid,
+                asic->options.user_queue.client_line.dev, asic->options.user_queue.client_line.master,
+                asic->options.user_queue.client_line.a, asic->options.user_queue.client_line.uid,
+                asic->options.user_queue.client_line.magic, asic->options.user_queue.client_line.name,
+                asic->options.user_queue.client_line.id) != 9) {
                 asic->err_msg("[ERROR]: Could not parse 'clients' file.  Could be that your kernel is too old.\n");
                 goto error;
             }
 
             // a KFD client is one where the PID is found in kfd/mqds as "Process ${tgid}"
-            cf = fopen("/sys/kernel/debug/kfd/mqds", "r");
-            if (cf) {
-                sprintf(path, "Process %s", client_line.tgid);
-                while(fgets(buf, sizeof buf, cf)) {
-                    if (strstr(buf, path)) {
-                        kgd_mode = 0;
-                        break;
-                    }
-                }
-                fclose(cf);
-            }
+            asic->options.user_queue.client_type =
+                kfd_mqds_find(have_mqds ? &mqds : NULL, asic->options.user_queue.client_line.tgid) ?
+                    UMR_CLIENT_KFD : UMR_CLIENT_KGD;
 
             // parse the client
-            sprintf(buf, "%s,client=%d,queue=0", kgd_mode ? "kgd" : "kfd", atoi(client_line.id));
             tq = lq->prev;
-            *lq = umr_parse_clientid(asic, buf);
+            if (asic->options.rumr_active) {
+                sprintf(buf, "%s,client=%d,queue=0",
+                    asic->options.user_queue.client_type == UMR_CLIENT_KFD ? "kfd" : "kgd",
+                    atoi(asic->options.user_queue.client_line.id));
+                *lq = umr_parse_clientid(asic, buf);
+            } else if (!load_client(asic, have_mqds ? &mqds : NULL, 0, 0)) {
+                *lq = asic->options.user_queue;
+            } else {
+                memset(lq, 0, sizeof *lq);
+                lq->state.qidx = -1;
+            }
             lq->prev = tq;
 
             // advance the list
@@ -1011,6 +1098,9 @@ struct umr_user_queue *umr_enumerate_user_queue_clients(struct umr_asic *asic)
         }
     }
     fclose(f);
+    kfd_mqds_free(&mqds);
+    asic->options.user_queue = *saved;
+    free(saved);
 
     // last entry is always redundant so remove
     if (lq->prev) {
@@ -1025,6 +1115,9 @@ struct umr_user_queue *umr_enumerate_user_queue_clients(struct umr_asic *asic)
 error:
     if (f)
         fclose(f);
+    kfd_mqds_free(&mqds);
+    asic->options.user_queue = *saved;
+    free(saved);
     while (lq && lq->prev)
         lq = lq->prev;
     while (lq) {
@@ -1035,6 +1128,226 @@ error:
     return NULL;
 }
 
+#define FNV64_OFFSET 0xcbf29ce484222325ULL
+#define FNV64_PRIME  0x100000001b3ULL
+
+// hash of the MQD of a queue, 0 for slots without a queue
+static uint64_t mqd_hash(uint64_t mqd_gpu_address, const uint32_t *mqd_words)
+{
+    const uint8_t *p = (const uint8_t *)mqd_words;
+    uint64_t h = FNV64_OFFSET;
+    size_t x;
+
+    if (!mqd_gpu_address)
+        return 0;
+    for (x = 0; x < UMR_MAX_MQD_SIZE * sizeof *mqd_words; x++)
+        h = (h ^ p[x]) * FNV64_PRIME;
+    return h ^ mqd_gpu_address;
+}
+
+// hash of queue x of a KFD process as load_client() would store it
+static uint64_t kfd_mqd_hash(struct kfd_mqd_process *proc, int x)
+{
+    const uint32_t *w;
+
+    if (!proc || x >= proc->no_queues)
+        return 0;
+    w = proc->queues[x].mqd_words;
+    if (proc->queues[x].queue_type == UMR_QUEUE_COMPUTE)
+        return mqd_hash(((uint64_t)w[129] << 32ULL) | w[128], w);
+    return mqd_hash(((uint64_t)w[45] << 32ULL) | w[44], w);
+}
+
+/**
+ * refresh_queue_pointers - Re-read the rptr/wptr of queue @x of asic->options.user_queue
+ *
+ * Returns 1 if either moved.
+ */
+static int refresh_queue_pointers(struct umr_asic *asic, int x)
+{
+    uint64_t rptr, wptr;
+
+    if (!asic->options.user_queue.client_info.queue[x].rb_buf_size)
+        return 0;
+    if (umr_read_vram(asic, asic->options.vm_partition, 0,
+            asic->options.user_queue.client_info.queue[x].hqd_rptr_addr, 8, &rptr) < 0 ||
+        umr_read_vram(asic, asic->options.vm_partition, 0,
+            asic->options.user_queue.client_info.queue[x].rb_wptr_poll_addr, 8, &wptr) < 0) {
+        asic->err_msg("[ERROR]: Could not read the rptr/wptr of client %s queue %"PRIu32" (try disabling GFXOFF with '-go 0')\n",
+            asic->options.user_queue.client_line.id, asic->options.user_queue.client_info.queue[x].queue_id);
+        return 0;
+    }
+    rptr %= asic->options.user_queue.client_info.queue[x].rb_buf_size;
+    wptr %= asic->options.user_queue.client_info.queue[x].rb_buf_size;
+    if (rptr == asic->options.user_queue.client_info.queue[x].hqd_rptr_value &&
+        wptr == asic->options.user_queue.client_info.queue[x].rb_wptr_poll_value)
+        return 0;
+    asic->options.user_queue.client_info.queue[x].hqd_rptr_value = rptr;
+    asic->options.user_queue.client_info.queue[x].rb_wptr_poll_value = wptr;
+    return 1;
+}
+
+/**
+ * umr_uq_registry_refresh - Bring the cached user queue clients of @asic up to date
+ *
+ * The first call loads every client like umr_enumerate_user_queue_clients()
+ * into asic->uq_registry.  Later calls load only clients that are new, or
+ * KFD clients whose MQDs in kfd/mqds changed, and otherwise just re-read
+ * the rptr/wptr of each known queue instead of deriving the queue from its
+ * MQD again.  Clients that went away are dropped.  The queues of a KGD
+ * client are only listed again if it is reloaded.
+ *
+ * Every queue that changed gets the new registry generation in
+ * entries[].generation[].  Returns the number of queues that changed
+ * (including those that went away) or -1 on error.
+ */
+int umr_uq_registry_refresh(struct umr_asic *asic)
+{
+    struct umr_uq_registry *reg;
+    struct umr_uq_registry_entry *e;
+    struct umr_user_queue *saved;
+    struct kfd_mqd_process *proc;
+    struct kfd_mqds mqds = { 0 };
+    char path[512];
+    int have_mqds, changed = 0, reload, n, x;
+    uint64_t h;
+    void *tmp;
+    FILE *f;
+
+    if (asic->options.rumr_active) {
+        asic->err_msg("[ERROR]: The user queue registry is not available over a rumr connection\n");
+        return -1;
+    }
+    if (!asic->uq_registry) {
+        asic->uq_registry = calloc(1, sizeof *asic->uq_registry);
+        if (!asic->uq_registry)
+            return -1;
+    }
+    reg = asic->uq_registry;
+
+    sprintf(path, "/sys/kernel/debug/dri/%d/clients", asic->instance);
+    f = fopen(path, "r");
+    if (!f) {
+        asic->err_msg("[ERROR]: Could not open clients file for device instance %d\n", asic->instance);
+        return -1;
+    }
+    saved = malloc(sizeof *saved);
+    if (!saved) {
+        fclose(f);
+        return -1;
+    }
+    *saved = asic->options.user_queue;
+    have_mqds = !kfd_mqds_load(asic, &mqds);
+    ++(reg->generation);
+
+    if (fgets(path, sizeof path, f)) {
+        while (fgets(path, sizeof path, f)) {
+            asic->options.user_queue = *saved;
+            if (sscanf(path, "%s %s %s %s %s %s %s %s %s",
+                asic->options.user_queue.client_line.command, asic->options.user_queue.client_line.tgid,
+                asic->options.user_queue.client_line.dev, asic->options.user_queue.client_line.master,
+                asic->options.user_queue.client_line.a, asic->options.user_queue.client_line.uid,
+                asic->options.user_queue.client_line.magic, asic->options.user_queue.client_line.name,
+                asic->options.user_queue.client_line.id) != 9) {
+                asic->err_msg("[ERROR]: Could not parse 'clients' file.  Could be that your kernel is too old.\n");
+                changed = -1;
+                break;
+            }
+            proc = kfd_mqds_find(have_mqds ? &mqds : NULL, asic->options.user_queue.client_line.tgid);
+            asic->options.user_queue.client_type = proc ? UMR_CLIENT_KFD : UMR_CLIENT_KGD;
+
+            // a client is known by its id and process
+            for (n = 0; n < reg->no_entries; n++)
+                if (!strcmp(reg->entries[n].uq.client_line.id, asic->options.user_queue.client_line.id) &&
+                    !strcmp(reg->entries[n].uq.client_line.tgid, asic->options.user_queue.client_line.tgid))
+                    break;
+            reload = 0;
+            if (n == reg->no_entries) {
+                tmp = realloc(reg->entries, (n + 1) * sizeof *reg->entries);
+                if (!tmp) {
+                    changed = -1;
+                    break;
+                }
+                reg->entries = tmp;
+                memset(&reg->entries[n], 0, sizeof reg->entries[n]);
+                ++(reg->no_entries);
+                reload = 1;
+            }
+            e = &reg->entries[n];
+            e->seen = reg->generation;
+
+            if (e->uq.client_type != asic->options.user_queue.client_type)
+                reload = 1;
+            for (x = 0; !reload && proc && x < UMR_MAX_MQD_QUEUES; x++)
+                if (kfd_mqd_hash(proc, x) != e->mqd_hash[x])
+                    reload = 1;
+
+            if (reload) {
+                if (load_client(asic, have_mqds ? &mqds : NULL, 0, 0) < 0) {
+                    memset(&asic->options.user_queue, 0, sizeof asic->options.user_queue);
+                    asic->options.user_queue.state.qidx = -1;
+                }
+                for (x = 0; x < UMR_MAX_MQD_QUEUES; x++) {
+                    h = mqd_hash(asic->options.user_queue.client_info.queue[x].mqd_gpu_address,
+                                 asic->options.user_queue.client_info.queue[x].mqd_words);
+                    if (h != e->mqd_hash[x] ||
+                        asic->options.user_queue.client_info.queue[x].hqd_rptr_value != e->uq.client_info.queue[x].hqd_rptr_value ||
+                        asic->options.user_queue.client_info.queue[x].rb_wptr_poll_value != e->uq.client_info.queue[x].rb_wptr_poll_value) {
+                        e->generation[x] = reg->generation;
+                        ++changed;
+                    }
+                    e->mqd_hash[x] = h;
+                }
+            } else {
+                // only the read and write pointers can have moved
+                asic->options.user_queue = e->uq;
+                asic->options.user_queue.state.active = 1;
+                for (x = 0; x < UMR_MAX_MQD_QUEUES; x++) {
+                    if (asic->options.user_queue.client_info.queue[x].mqd_gpu_address &&
+                        refresh_queue_pointers(asic, x)) {
+                        e->generation[x] = reg->generation;
+                        ++changed;
+                    }
+                }
+            }
+            e->uq = asic->options.user_queue;
+        }
+    }
+    fclose(f);
+    kfd_mqds_free(&mqds);
+    asic->options.user_queue = *saved;
+    free(saved);
+    if (changed < 0)
+        return -1;
+
+    // drop the clients that went away
+    for (x = n = 0; n < reg->no_entries; n++) {
+        if (reg->entries[n].seen != reg->generation) {
+            int y;
+            for (y = 0; y < UMR_MAX_MQD_QUEUES; y++)
+                changed += reg->entries[n].uq.client_info.queue[y].mqd_gpu_address != 0;
+            continue;
+        }
+        if (x != n)
+            memcpy(&reg->entries[x], &reg->entries[n], sizeof reg->entries[n]);
+        ++x;
+    }
+    reg->no_entries = x;
+    return changed;
+}
+
+/**
+ * umr_uq_registry_free - Free the cached user queue clients of @asic
+ */
+void umr_uq_registry_free(struct umr_asic *asic)
+{
+    if (asic->uq_registry) {
+        free(asic->uq_registry->entries);
+        free(asic->uq_registry);
+        asic->uq_registry = NULL;
+    }
+}
+
 void umr_user_queue_free(struct umr_user_queue *uq)
 {
     struct umr_user_queue *tq;
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+#include <sys/mman.h>
+
+/*
+ * libpciaccess scans every PCI device of the host when it is initialized
+ * so it is initialized once for all asics that need it (the VRAM BAR,
+ * enabling the device without a kernel driver, config space reads) and
+ * torn down with the last of them.  The register BAR does not need it,
+ * it is mapped through its sysfs resource file the first time a register
+ * is accessed through it.
+ */
+
+// PCI BAR flags kept in the low bits of the sysfs resource flags
+#define BAR_FLAG_IO        1
+#define BAR_FLAG_64        4
+#define BAR_FLAG_PREFETCH  8
+
+static pthread_mutex_t pci_lock = PTHREAD_MUTEX_INITIALIZER;
+static int pci_users;
+
+/**
+ * umr_pci_system_get - Initialize libpciaccess for one more user
+ *
+ * Returns 0 on success, -1 if libpciaccess could not be initialized.
+ */
+int umr_pci_system_get(void)
+{
+	int r = 0;
+
+	pthread_mutex_lock(&pci_lock);
+	if (!pci_users)
+		r = pci_system_init() ? -1 : 0;
+	if (!r)
+		++pci_users;
+	pthread_mutex_unlock(&pci_lock);
+	return r;
+}
+
+/**
+ * umr_pci_system_put - Drop a user of libpciaccess
+ *
+ * The last user cleans it up, which invalidates every struct pci_device.
+ */
+void umr_pci_system_put(void)
+{
+	pthread_mutex_lock(&pci_lock);
+	if (pci_users && !--pci_users)
+		pci_system_cleanup();
+	pthread_mutex_unlock(&pci_lock);
+}
+
+// the BAR holding the registers, -1 if none is found
+static int find_reg_bar(struct umr_asic *asic, const char *pciname, uint64_t *size)
+{
+	uint64_t lowaddr, highaddr, flags, sizes[6] = { 0 }, bar_flags[6] = { 0 };
+	char linebuf[512];
+	int x, n;
+	FILE *res;
+
+	snprintf(linebuf, sizeof linebuf, "/sys/bus/pci/devices/%s/resource", pciname);
+	res = fopen(linebuf, "r");
+	if (!res)
+		return -1;
+	for (n = 0; n < 6 && fgets(linebuf, sizeof linebuf, res); n++) {
+		if (sscanf(linebuf, "0x%"PRIx64" 0x%"PRIx64" 0x%"PRIx64, &lowaddr, &highaddr, &flags) != 3)
+			break;
+		sizes[n] = highaddr ? highaddr - lowaddr + 1 : 0;
+		bar_flags[n] = flags;
+	}
+	fclose(res);
+
+	// SI has the registers in BAR 2, CIK..VI in BAR 5 (32-bit, non IO, non prefetchable)
+	x = -1;
+	if (asic->family <= FAMILY_SI)
+		x = 2;
+	else if (asic->family <= FAMILY_VI)
+		x = 5;
+	if (x >= 0 && x < n && sizes[x] && !(bar_flags[x] & (BAR_FLAG_IO | BAR_FLAG_64 | BAR_FLAG_PREFETCH))) {
+		*size = sizes[x];
+		return x;
+	}
+
+	// otherwise the first 256K <= X <= 4096K which is 32-bit, non IO, non prefetchable
+	for (x = 0; x < n; x++)
+		if (sizes[x] >= (256 * 1024ULL) && sizes[x] <= (4096 * 1024ULL) &&
+		    !(bar_flags[x] & (BAR_FLAG_IO | BAR_FLAG_64 | BAR_FLAG_PREFETCH))) {
+			*size = sizes[x];
+			return x;
+		}
+	return -1;
+}
+
+static int map_regs(struct umr_asic *asic)
+{
+	char pciname[32], fname[128];
+	uint64_t size;
+	void *mem;
+	int region, fd;
+
+	if (asic->pci.pdevice)
+		snprintf(pciname, sizeof pciname, "%04x:%02x:%02x.%x",
+			 (unsigned)asic->pci.pdevice->domain, (unsigned)asic->pci.pdevice->bus,
+			 (unsigned)asic->pci.pdevice->dev, (unsigned)asic->pci.pdevice->func);
+	else
+		snprintf(pciname, sizeof pciname, "%s", asic->options.pci.name);
+
+	region = find_reg_bar(asic, pciname, &size);
+	if (region < 0) {
+		asic->err_msg("[ERROR]: Could not find PCI region (debugfs mode might still work)\n");
+		return -1;
+	}
+
+	snprintf(fname, sizeof fname, "/sys/bus/pci/devices/%s/resource%d", pciname, region);
+	fd = open(fname, O_RDWR | O_SYNC | O_CLOEXEC);
+	if (fd < 0) {
+		asic->err_msg("[ERROR]: Could not open %s\n", fname);
+		return -1;
+	}
+	mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mem == MAP_FAILED) {
+		asic->err_msg("[ERROR]: Could not map PCI memory\n");
+		return -1;
+	}
+	asic->pci.region = region;
+	asic->pci.size = size;
+	__atomic_store_n(&asic->pci.mem, mem, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/**
+ * umr_pci_map_regs - Map the register BAR of a device
+ *
+ * Called by umr_pci_regs() the first time a register is accessed with
+ * asic->options.use_pci.  Only one attempt is made, if the BAR cannot be
+ * mapped use_pci is cleared so the accessors go through debugfs instead.
+ *
+ * Returns the mapping or NULL.
+ */
+uint32_t *umr_pci_map_regs(struct umr_asic *asic)
+{
+	pthread_mutex_lock(&pci_lock);
+	if (!asic->pci.map_tried) {
+		asic->pci.map_tried = 1;
+		if (map_regs(asic)) {
+			asic->err_msg("[WARNING]: Falling back to debugfs for register access\n");
+			asic->options.use_pci = 0;
+		}
+	}
+	pthread_mutex_unlock(&pci_lock);
+	return asic->pci.mem;
+}
+
+/**
+ * umr_pci_unmap_regs - Unmap the register BAR mapped by umr_pci_map_regs()
+ */
+void umr_pci_unmap_regs(struct umr_asic *asic)
+{
+	if (asic->pci.mem)
+		munmap(asic->pci.mem, asic->pci.size);
+	asic->pci.mem = NULL;
+	asic->pci.size = 0;
+	asic->pci.map_tried = 0;
+}
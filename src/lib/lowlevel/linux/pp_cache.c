@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+#include <errno.h>
+#include <sys/stat.h>
+
+/*
+ * The powerplay table and the VBIOS info only change when the driver is
+ * reloaded (or the board reflashed).  They are kept with the asic along
+ * with a hash of the raw table and the VBIOS version, and the VBIOS info
+ * is also stored on disk under that hash so a later umr process does not
+ * have to query the driver for it again.
+ */
+
+#define AMDGPU_INFO_VBIOS       0x1B
+#define AMDGPU_INFO_VBIOS_INFO  0x3
+
+#define PP_CACHE_MAGIC     "UMRPPC01"
+#define PP_TABLE_MAX_SIZE  (1UL << 20)
+
+static uint64_t fnv1a(uint64_t h, const void *buf, size_t len)
+{
+	const uint8_t *p = buf;
+
+	while (len--) {
+		h ^= *p++;
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+// the raw pp_table of the device, *size is 0 if there is none
+static uint8_t *read_pp_table(struct umr_asic *asic, uint32_t *size)
+{
+	char fname[128];
+	uint8_t *buf = NULL, *t;
+	size_t len = 0, cap = 0;
+	ssize_t r;
+	int fd;
+
+	*size = 0;
+	snprintf(fname, sizeof fname, "/sys/class/drm/card%d/device/pp_table", asic->instance);
+	fd = open(fname, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+	for (;;) {
+		if (len == cap) {
+			cap = cap ? cap * 2 : 4096;
+			if (cap > PP_TABLE_MAX_SIZE)
+				break;
+			t = realloc(buf, cap);
+			if (!t)
+				break;
+			buf = t;
+		}
+		r = read(fd, buf + len, cap - len);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			break;
+		len += r;
+	}
+	close(fd);
+	if (!len) {
+		free(buf);
+		return NULL;
+	}
+	*size = len;
+	return buf;
+}
+
+/*
+ * UMR_PP_CACHE names the directory (an empty value disables the disk
+ * cache), otherwise it is umr/pp under $XDG_CACHE_HOME or ~/.cache.
+ */
+static int pp_cache_path(uint64_t hash, char *buf, size_t len, int mkdirs)
+{
+	char dir[512], *p;
+	const char *e;
+
+	e = getenv("UMR_PP_CACHE");
+	if (e) {
+		if (!*e)
+			return -1;
+		snprintf(dir, sizeof dir, "%s", e);
+	} else if ((e = getenv("XDG_CACHE_HOME")) && *e) {
+		snprintf(dir, sizeof dir, "%s/umr/pp", e);
+	} else if ((e = getenv("HOME")) && *e) {
+		snprintf(dir, sizeof dir, "%s/.cache/umr/pp", e);
+	} else {
+		return -1;
+	}
+
+	if (mkdirs) {
+		// and its parents (~/.cache) if needed
+		for (p = dir + 1; *p; p++) {
+			if (*p == '/') {
+				*p = 0;
+				mkdir(dir, 0755);
+				*p = '/';
+			}
+		}
+		mkdir(dir, 0755);
+	}
+	snprintf(buf, len, "%s/%016" PRIx64 ".vbios", dir, hash);
+	return 0;
+}
+
+static int load_vbios(uint64_t hash, struct umr_vbios_info *vbios)
+{
+	char fname[576], magic[8];
+	FILE *f;
+	int ok;
+
+	if (pp_cache_path(hash, fname, sizeof fname, 0))
+		return -1;
+	f = fopen(fname, "rb");
+	if (!f)
+		return -1;
+	ok = fread(magic, 1, sizeof magic, f) == sizeof magic &&
+	     !memcmp(magic, PP_CACHE_MAGIC, sizeof magic) &&
+	     fread(vbios, 1, sizeof *vbios, f) == sizeof *vbios;
+	fclose(f);
+	return ok ? 0 : -1;
+}
+
+// written under a temporary name and renamed, failing to store it is not an error
+static void store_vbios(uint64_t hash, const struct umr_vbios_info *vbios)
+{
+	char fname[576], tmpname[600];
+	FILE *f;
+	int fd;
+
+	if (pp_cache_path(hash, fname, sizeof fname, 1))
+		return;
+	snprintf(tmpname, sizeof tmpname, "%s.XXXXXX", fname);
+	fd = mkstemp(tmpname);
+	if (fd < 0)
+		return;
+	f = fdopen(fd, "wb");
+	if (!f) {
+		close(fd);
+		unlink(tmpname);
+		return;
+	}
+	fwrite(PP_CACHE_MAGIC, 1, 8, f);
+	fwrite(vbios, 1, sizeof *vbios, f);
+	if (fclose(f) || rename(tmpname, fname))
+		unlink(tmpname);
+}
+
+static int query_vbios(struct umr_asic *asic, struct umr_vbios_info *vbios)
+{
+	char fname[64];
+
+	if (asic->fd.drm < 0) {
+		snprintf(fname, sizeof fname, "/dev/dri/card%d", asic->instance);
+		asic->fd.drm = open(fname, O_RDWR | O_CLOEXEC);
+		if (asic->fd.drm < 0)
+			return -1;
+	}
+	memset(vbios, 0, sizeof *vbios);
+	return umr_query_drm_vbios(asic, AMDGPU_INFO_VBIOS, AMDGPU_INFO_VBIOS_INFO, vbios, sizeof *vbios);
+}
+
+/**
+ * umr_pp_cache_get - The powerplay table and VBIOS info of a device
+ *
+ * @asic: The device
+ * @recheck: Read the raw table again and compare its hash with the cached
+ *           one, otherwise a cached copy is returned without any I/O
+ *
+ * The VBIOS info is taken from the disk cache when one was stored for the
+ * same hash and only queried from the driver otherwise.  The result stays
+ * valid until the next call with @recheck or until the asic is freed.
+ *
+ * Returns NULL if out of memory.
+ */
+const struct umr_pp_cache *umr_pp_cache_get(struct umr_asic *asic, int recheck)
+{
+	struct umr_pp_cache *c = asic->pp_cache;
+	uint8_t *raw;
+	uint32_t size;
+	uint64_t hash;
+
+	if (c && !recheck)
+		return c;
+
+	umr_scan_config_fields(asic, 0, UMR_CONFIG_SCAN_VBIOS);
+	raw = read_pp_table(asic, &size);
+	hash = fnv1a(0xcbf29ce484222325ULL, raw, size);
+	hash = fnv1a(hash, asic->config.vbios_version, strlen(asic->config.vbios_version));
+
+	if (c && c->hash == hash) {
+		free(raw);
+		return c;
+	}
+
+	if (!c) {
+		c = calloc(1, sizeof *c);
+		if (!c) {
+			free(raw);
+			return NULL;
+		}
+		asic->pp_cache = c;
+	}
+	free(c->pp_table);
+	c->pp_table = raw;
+	c->pp_table_size = size;
+	c->hash = hash;
+	c->have_vbios = !load_vbios(hash, &c->vbios);
+	if (!c->have_vbios && !query_vbios(asic, &c->vbios)) {
+		c->have_vbios = 1;
+		store_vbios(hash, &c->vbios);
+	}
+	return c;
+}
+
+/**
+ * umr_pp_cache_free - Drop the cached powerplay table and VBIOS info
+ */
+void umr_pp_cache_free(struct umr_asic *asic)
+{
+	if (!asic->pp_cache)
+		return;
+	free(asic->pp_cache->pp_table);
+	free(asic->pp_cache);
+	asic->pp_cache = NULL;
+}
@@ -26,6 +26,35 @@
 #include <asm/ioctl.h>
 #include <sys/ioctl.h>
 
+/*
+ * Results of the AMDGPU_INFO queries the kernel answers the same way for
+ * the life of the device are kept with the asic, keyed by (field, type).
+ */
+struct umr_drm_query_cache {
+	struct {
+		int field, type, size;
+		uint8_t *data;
+	} *entries;
+	int no_entries;
+};
+
+/**
+ * umr_query_drm_cache_free - Drop the cached AMDGPU_INFO results of a device
+ */
+void umr_query_drm_cache_free(struct umr_asic *asic)
+{
+	struct umr_drm_query_cache *c = asic->drm_query_cache;
+	int x;
+
+	if (!c)
+		return;
+	for (x = 0; x < c->no_entries; x++)
+		free(c->entries[x].data);
+	free(c->entries);
+	free(c);
+	asic->drm_query_cache = NULL;
+}
+
 #ifndef UMR_NO_DRM
 #include <drm.h>
 #include <amdgpu_drm.h>
@@ -35,32 +64,118 @@
 #define DRM_IOCTL_BASE                  'd'
 #define DRM_COMMAND_BASE                0x40
 
-/**
- * umr_query_drm - Perform a DRM IOCTL for AMDGPU_INFO data
- *
- * @field - The field to retrieve via IOCTL
- */
-int umr_query_drm(struct umr_asic *asic, int field, void *ret, int size)
+static const int static_fields[] = {
+	0x14, // AMDGPU_INFO_VRAM_GTT
+	0x16, // AMDGPU_INFO_DEV_INFO
+	0x1B, // AMDGPU_INFO_VBIOS
+	0x1D, // AMDGPU_INFO_VCE_CLOCK_TABLE
+	0x22, // AMDGPU_INFO_MAX_IBS
+};
+
+static int is_static_field(int field)
 {
-	struct drm_amdgpu_info inf;
+	unsigned x;
 
-	memset(&inf, 0, sizeof inf);
-	inf.return_pointer = (uintptr_t)ret;
-	inf.return_size = size;
-	inf.query = field;
-	return ioctl(asic->fd.drm, DRM_IOC(DRM_IOC_WRITE, DRM_IOCTL_BASE, DRM_COMMAND_BASE + DRM_AMDGPU_INFO, sizeof(inf)), &inf);
+	for (x = 0; x < sizeof(static_fields) / sizeof(static_fields[0]); x++)
+		if (static_fields[x] == field)
+			return 1;
+	return 0;
 }
 
-int umr_query_drm_vbios(struct umr_asic *asic, int field, int type, void *ret, int size)
+// a cached result of at least size bytes
+static int cache_lookup(struct umr_asic *asic, int field, int type, void *ret, int size)
+{
+	struct umr_drm_query_cache *c = asic->drm_query_cache;
+	int x;
+
+	if (!c)
+		return -1;
+	for (x = 0; x < c->no_entries; x++) {
+		if (c->entries[x].field == field && c->entries[x].type == type) {
+			if (c->entries[x].size < size)
+				return -1;
+			memcpy(ret, c->entries[x].data, size);
+			return 0;
+		}
+	}
+	return -1;
+}
+
+// a failure to store it is not an error, the next call asks the kernel again
+static void cache_store(struct umr_asic *asic, int field, int type, const void *ret, int size)
+{
+	struct umr_drm_query_cache *c = asic->drm_query_cache;
+	uint8_t *data;
+	void *t;
+	int x;
+
+	if (!c) {
+		c = calloc(1, sizeof *c);
+		if (!c)
+			return;
+		asic->drm_query_cache = c;
+	}
+	data = malloc(size);
+	if (!data)
+		return;
+	memcpy(data, ret, size);
+
+	for (x = 0; x < c->no_entries; x++) {
+		if (c->entries[x].field == field && c->entries[x].type == type) {
+			free(c->entries[x].data);
+			c->entries[x].data = data;
+			c->entries[x].size = size;
+			return;
+		}
+	}
+	t = realloc(c->entries, (c->no_entries + 1) * sizeof c->entries[0]);
+	if (!t) {
+		free(data);
+		return;
+	}
+	c->entries = t;
+	c->entries[c->no_entries].field = field;
+	c->entries[c->no_entries].type = type;
+	c->entries[c->no_entries].size = size;
+	c->entries[c->no_entries].data = data;
+	++c->no_entries;
+}
+
+static int query(struct umr_asic *asic, int field, int type, void *ret, int size)
 {
 	struct drm_amdgpu_info inf;
+	int r;
+
+	if (is_static_field(field) && !cache_lookup(asic, field, type, ret, size))
+		return 0;
 
 	memset(&inf, 0, sizeof inf);
 	inf.return_pointer = (uintptr_t)ret;
 	inf.return_size = size;
 	inf.query = field;
 	inf.vbios_info.type = type;
-	return ioctl(asic->fd.drm, DRM_IOC(DRM_IOC_WRITE, DRM_IOCTL_BASE, DRM_COMMAND_BASE + DRM_AMDGPU_INFO, sizeof(inf)), &inf);
+	r = umr_io_ioctl(asic, UMR_IO_OTHER, asic->fd.drm, DRM_IOC(DRM_IOC_WRITE, DRM_IOCTL_BASE, DRM_COMMAND_BASE + DRM_AMDGPU_INFO, sizeof(inf)), &inf);
+	if (!r && is_static_field(field))
+		cache_store(asic, field, type, ret, size);
+	return r;
+}
+
+/**
+ * umr_query_drm - Perform a DRM IOCTL for AMDGPU_INFO data
+ *
+ * @field - The field to retrieve via IOCTL
+ *
+ * Fields that do not change while the driver is loaded (device info,
+ * VRAM/GTT sizes, ...) are only asked for once per asic.
+ */
+int umr_query_drm(struct umr_asic *asic, int field, void *ret, int size)
+{
+	return query(asic, field, 0, ret, size);
+}
+
+int umr_query_drm_vbios(struct umr_asic *asic, int field, int type, void *ret, int size)
+{
+	return query(asic, field, type, ret, size);
 }
 
 #else
@@ -76,3 +191,26 @@ int umr_query_drm_vbios(struct umr_asic *asic, int field, int type, void *ret, i
 }
 
 #endif
+
+/**
+ * umr_query_drm_batch - Perform several AMDGPU_INFO queries
+ *
+ * @q: The queries, q[].r receives what umr_query_drm() returned for each
+ * @n: The number of queries
+ *
+ * Static fields are answered from the cache so a refresh of a set of
+ * fields only costs an IOCTL for the ones that can change.
+ *
+ * Returns the number of queries that failed.
+ */
+int umr_query_drm_batch(struct umr_asic *asic, struct umr_drm_query *q, int n)
+{
+	int x, failed = 0;
+
+	for (x = 0; x < n; x++) {
+		q[x].r = umr_query_drm_vbios(asic, q[x].field, q[x].type, q[x].ret, q[x].size);
+		if (q[x].r)
+			++failed;
+	}
+	return failed;
+}
@@ -42,6 +42,27 @@ enum AMDGPU_DEBUGFS_GPRWAVE_CMDS {
 };
 #define AMDGPU_DEBUGFS_GPRWAVE_IOC_SET_STATE _IOWR(0x20, AMDGPU_DEBUGFS_GPRWAVE_CMD_SET_STATE, struct amdgpu_debugfs_gprwave_iocdata)
 
+// the wave selection is per open file so threads with a bound access
+// context use the private file of their context
+static int gprwave_fd(struct umr_asic *asic)
+{
+	struct umr_access_ctx *ctx = umr_access_ctx_current(asic);
+
+	if (ctx && ctx->fd_gprwave >= 0)
+		return ctx->fd_gprwave;
+	return asic->fd.gprwave;
+}
+
+// the XCC selected with the wave, the partition of the bound access
+// context or else asic->options.vm_partition (-1 is XCC 0)
+static uint32_t gprwave_xcc(struct umr_asic *asic)
+{
+	struct umr_access_ctx *ctx = umr_access_ctx_current(asic);
+	int p = ctx ? ctx->vm_partition : asic->options.vm_partition;
+
+	return p < 0 ? 0 : p;
+}
+
 /**
  * @brief Reads GPR or wave data from a specified GPU resource.
  *
@@ -68,7 +89,7 @@ int umr_linux_read_gpr_gprwave_raw(struct umr_asic *asic, int v_or_s,
 				   uint32_t offset, uint32_t size, uint32_t *dst)
 {
 	struct amdgpu_debugfs_gprwave_iocdata id;
-	int r = 0;
+	int r = 0, fd;
 
 	memset(&id, 0, sizeof id);
 	id.gpr_or_wave = 1;
@@ -97,14 +118,15 @@ int umr_linux_read_gpr_gprwave_raw(struct umr_asic *asic, int v_or_s,
 		}
 	}
 	id.gpr.vpgr_or_sgpr = v_or_s;
-	id.xcc_id = asic->options.vm_partition == -1 ? 0 : asic->options.vm_partition;
+	id.xcc_id = gprwave_xcc(asic);
 
-	r = ioctl(asic->fd.gprwave, AMDGPU_DEBUGFS_GPRWAVE_IOC_SET_STATE, &id);
+	fd = gprwave_fd(asic);
+	r = umr_io_ioctl(asic, UMR_IO_GPRWAVE, fd, AMDGPU_DEBUGFS_GPRWAVE_IOC_SET_STATE, &id);
 	if (r)
 		return r;
 
-	lseek(asic->fd.gprwave, offset, SEEK_SET);
-	return read(asic->fd.gprwave, dst, size);
+	lseek(fd, offset, SEEK_SET);
+	return umr_io_read(asic, UMR_IO_GPRWAVE, fd, dst, size);
 }
 
 // TODO: hoist id/lseek/read calls into raw function out of this function
@@ -115,11 +137,13 @@ static int read_gpr_gprwave(struct umr_asic *asic, int v_or_s, uint32_t thread,
 	uint64_t addr = 0;
 
 	if (asic->family < FAMILY_NV) {
-		se = umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID", "SE_ID");
-		sh = umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID", "SH_ID");
-		cu = umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID", "CU_ID");
-		wave = umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID", "WAVE_ID");
-		simd = umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID", "SIMD_ID");
+		se = umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_SE_ID);
+		sh = umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_SH_ID);
+		cu = umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_CU_ID);
+		wave = umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_WAVE_ID);
+		simd = umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_SIMD_ID);
+		if (se == 0xDEADBEEF)
+			return -1;
 
 		if (v_or_s == 0) {
 			uint32_t shift;
@@ -127,9 +151,9 @@ static int read_gpr_gprwave(struct umr_asic *asic, int v_or_s, uint32_t thread,
 				shift = 3;  // on SI..CIK allocations were done in 8-dword blocks
 			else
 				shift = 4;  // on VI allocations are in 16-dword blocks
-			size = 4 * ((umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_GPR_ALLOC", "SGPR_SIZE") + 1) << shift);
+			size = 4 * ((umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_SGPR_SIZE) + 1) << shift);
 		} else {
-			size = 4 * ((umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_GPR_ALLOC", "VGPR_SIZE") + 1) << asic->parameters.vgpr_granularity);
+			size = 4 * ((umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_VGPR_SIZE) + 1) << asic->parameters.vgpr_granularity);
 		}
 	} else {
 		se = wd->se;
@@ -141,7 +165,7 @@ static int read_gpr_gprwave(struct umr_asic *asic, int v_or_s, uint32_t thread,
 		if (v_or_s == 0) {
 			size = 4 * 124; // regular SGPRs, VCC, and TTMPs
 		} else {
-			size = 4 * ((umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_GPR_ALLOC", "VGPR_SIZE") + 1) << asic->parameters.vgpr_granularity);
+			size = 4 * ((umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_VGPR_SIZE) + 1) << asic->parameters.vgpr_granularity);
 		}
 	}
 
@@ -152,8 +176,6 @@ static int read_gpr_gprwave(struct umr_asic *asic, int v_or_s, uint32_t thread,
 	// if we are reading SGPRS then optionally dump them
 	// and then read TRAP registers if necessary
 	if (asic->options.test_log && asic->options.test_log_fd) {
-		int x;
-
 		// we use addr for test logging
 		addr =
 			((v_or_s ? 0ULL : 1ULL) << 60) | // reading SGPRs
@@ -165,13 +187,7 @@ static int read_gpr_gprwave(struct umr_asic *asic, int v_or_s, uint32_t thread,
 			((uint64_t)simd << 44)      |
 			((uint64_t)thread << 52ULL); // thread_id
 
-		fprintf(asic->options.test_log_fd, "%cGPR@0x%"PRIx64" = { ", "SV"[v_or_s], addr);
-		for (x = 0; x < r; x += 4) {
-			fprintf(asic->options.test_log_fd, "0x%"PRIx32, dst[x/4]);
-			if (x < (r - 4))
-				fprintf(asic->options.test_log_fd, ", ");
-		}
-		fprintf(asic->options.test_log_fd, "}\n");
+		umr_test_log_words(&asic->options, v_or_s ? UMR_TV_VGPR : UMR_TV_SGPR, addr, dst, r / 4, NULL);
 	}
 
 	// TODO: hoist trap to _raw
@@ -180,16 +196,8 @@ static int read_gpr_gprwave(struct umr_asic *asic, int v_or_s, uint32_t thread,
 		if (umr_wave_data_get_flag_trap_en(asic, wd) || umr_wave_data_get_flag_priv(asic, wd)) {
 			r = umr_linux_read_gpr_gprwave_raw(asic, v_or_s, thread, se, sh, cu, wave, simd, 4 * 0x6C, size, &dst[0x6C]);
 			if (r > 0) {
-				if (asic->options.test_log && asic->options.test_log_fd) {
-					int x;
-					fprintf(asic->options.test_log_fd, "SGPR@0x%"PRIx64" = { ", addr + 0x6C * 4);
-					for (x = 0; x < r; x += 4) {
-						fprintf(asic->options.test_log_fd, "0x%"PRIx32, dst[0x6C + x/4]);
-						if (x < (r - 4))
-							fprintf(asic->options.test_log_fd, ", ");
-					}
-					fprintf(asic->options.test_log_fd, "}\n");
-				}
+				if (asic->options.test_log && asic->options.test_log_fd)
+					umr_test_log_words(&asic->options, UMR_TV_SGPR, addr + 0x6C * 4, &dst[0x6C], r / 4, NULL);
 			}
 		}
 	}
@@ -247,6 +255,32 @@ int umr_read_vgprs(struct umr_asic *asic, struct umr_wave_data *wd, uint32_t thr
 	}
 }
 
+// select the wave in @id and read its status words, returns the number of bytes read
+static int read_wave_status(struct umr_asic *asic, int fd, struct amdgpu_debugfs_gprwave_iocdata *id, uint32_t *buf)
+{
+	uint64_t addr;
+	int r;
+
+	r = umr_io_ioctl(asic, UMR_IO_GPRWAVE, fd, AMDGPU_DEBUGFS_GPRWAVE_IOC_SET_STATE, id);
+	if (r)
+		return r;
+
+	r = umr_io_pread(asic, UMR_IO_GPRWAVE, fd, buf, 64*4, 0);
+	if (r < 0)
+		return r;
+
+	if (asic->options.test_log && asic->options.test_log_fd) {
+		addr = ((uint64_t)id->se << 7) |
+			   ((uint64_t)id->sh << 15) |
+			   ((uint64_t)id->cu << 23) |
+			   ((uint64_t)id->wave << 31) |
+			   ((uint64_t)id->simd << 37);
+		umr_test_log_words(&asic->options, UMR_TV_WAVESTATUS, addr, buf, r / 4, NULL);
+	}
+
+	return r;
+}
+
 /**
  * @brief Reads raw wave status data from a specified GPU resource.
  *
@@ -266,50 +300,69 @@ int umr_read_vgprs(struct umr_asic *asic, struct umr_wave_data *wd, uint32_t thr
  */
 int umr_get_wave_status_raw(struct umr_asic *asic, unsigned se, unsigned sh, unsigned cu, unsigned simd, unsigned wave, uint32_t *buf)
 {
-	int r = 0;
-	uint64_t addr = 0;
 	struct amdgpu_debugfs_gprwave_iocdata id;
 
-	if (asic->fd.gprwave >= 0) {
-		memset(&id, 0, sizeof id);
-		id.gpr_or_wave = 0;
-		id.se = se;
-		id.sh = sh;
-		id.cu = cu;
-		id.wave = wave;
-		id.simd = simd;
-		id.xcc_id = asic->options.vm_partition == -1 ? 0 : asic->options.vm_partition;
+	if (asic->fd.gprwave < 0) {
+		asic->err_msg("[ERROR]:  Your kernel is too old the amdgpu_gprwave file is now required.\n");
+		return -1;
+	}
 
-		r = ioctl(asic->fd.gprwave, AMDGPU_DEBUGFS_GPRWAVE_IOC_SET_STATE, &id);
-		if (r)
-			return r;
+	memset(&id, 0, sizeof id);
+	id.gpr_or_wave = 0;
+	id.se = se;
+	id.sh = sh;
+	id.cu = cu;
+	id.wave = wave;
+	id.simd = simd;
+	id.xcc_id = gprwave_xcc(asic);
 
-		lseek(asic->fd.gprwave, 0, SEEK_SET);
-		r = read(asic->fd.gprwave, buf, 64*4);
-		if (r < 0)
-			return r;
-	} else {
+	return read_wave_status(asic, gprwave_fd(asic), &id, buf);
+}
+
+/**
+ * @brief Reads and parses the wave status of several wave slots of a SIMD.
+ *
+ * The gprwave interface selects a single wave per SET_STATE call so this is
+ * a tight loop of one ioctl and one pread() per slot with the selection
+ * built once, instead of a full umr_get_wave_status() call per slot.
+ *
+ * @param asic Pointer to the UMR ASIC structure representing the GPU.
+ * @param se Shader Engine ID.
+ * @param sh Shader Array ID.
+ * @param cu Compute Unit ID.
+ * @param simd SIMD ID.
+ * @param no_waves Waves 0 to no_waves-1 are read.
+ * @param ws Array of no_waves wave status structures the parsed data is stored in.
+ *
+ * @return Returns 0 on success, or -1 if any slot could not be read or parsed.
+ */
+int umr_get_wave_status_bulk(struct umr_asic *asic, unsigned se, unsigned sh, unsigned cu, unsigned simd, unsigned no_waves, struct umr_wave_status *ws)
+{
+	struct amdgpu_debugfs_gprwave_iocdata id;
+	uint32_t buf[64];
+	int r, fd;
+
+	if (asic->fd.gprwave < 0) {
 		asic->err_msg("[ERROR]:  Your kernel is too old the amdgpu_gprwave file is now required.\n");
 		return -1;
 	}
 
-	if (asic->options.test_log && asic->options.test_log_fd) {
-		int x;
-		addr = ((uint64_t)id.se << 7) |
-			   ((uint64_t)id.sh << 15) |
-			   ((uint64_t)id.cu << 23) |
-			   ((uint64_t)id.wave << 31) |
-			   ((uint64_t)id.simd << 37);
-		fprintf(asic->options.test_log_fd, "WAVESTATUS@0x%"PRIx64" = { ", addr);
-		for (x = 0; x < r; x += 4) {
-			fprintf(asic->options.test_log_fd, "0x%"PRIx32, buf[x/4]);
-			if (x < (r - 4))
-				fprintf(asic->options.test_log_fd, ", ");
-		}
-		fprintf(asic->options.test_log_fd, "}\n");
-	}
+	memset(&id, 0, sizeof id);
+	id.gpr_or_wave = 0;
+	id.se = se;
+	id.sh = sh;
+	id.cu = cu;
+	id.simd = simd;
+	id.xcc_id = gprwave_xcc(asic);
+	fd = gprwave_fd(asic);
 
-	return r;
+	for (id.wave = 0; id.wave < no_waves; id.wave++) {
+		memset(buf, 0, sizeof buf);
+		r = read_wave_status(asic, fd, &id, buf);
+		if (r <= 0 || umr_parse_wave_data_gfx(asic, &ws[id.wave], buf, r >> 2))
+			return -1;
+	}
+	return 0;
 }
 
 /**
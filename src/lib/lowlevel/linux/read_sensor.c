@@ -32,11 +32,78 @@ int umr_read_sensor(struct umr_asic *asic, int sensor, void *dst, int *size)
 	int r;
 
 	// multiply sensor index by 4 to get byte address
-	lseek(asic->fd.sensors, sensor*4, SEEK_SET);
-	r = read(asic->fd.sensors, dst, *size);
+	r = umr_io_pread(asic, UMR_IO_SENSORS, asic->fd.sensors, dst, *size, sensor*4);
 	if (r != *size) {
 		return -1;
 	}
 	*size = r;
 	return 0;
 }
+
+/**
+ * umr_sensor_ctx_open - Open the sensors of a device for umr_read_sensors_batch()
+ *
+ * @ctx: The context to initialize
+ * @instance: The DRI instance of the device
+ *
+ * The context only holds the debugfs file so threads polling sensors
+ * don't need a copy of the asic.
+ *
+ * Returns 0 on success, -1 if the sensors file can't be opened.
+ */
+int umr_sensor_ctx_open(struct umr_sensor_ctx *ctx, int instance)
+{
+	char fname[128];
+
+	snprintf(fname, sizeof(fname)-1, "/sys/kernel/debug/dri/%d/amdgpu_sensors", instance);
+	ctx->fd = open(fname, O_RDWR);
+	ctx->no_ranges = 0;
+	ctx->asic = NULL;
+	return ctx->fd < 0 ? -1 : 0;
+}
+
+void umr_sensor_ctx_close(struct umr_sensor_ctx *ctx)
+{
+	if (ctx->fd >= 0)
+		close(ctx->fd);
+	ctx->fd = -1;
+}
+
+/**
+ * umr_read_sensors_batch - Read several 32-bit powerplay sensors
+ *
+ * @ctx: Sensors context from umr_sensor_ctx_open()
+ * @sensors: Sensor indices to read
+ * @dst: Receives the value of sensors[i] in dst[i]
+ * @no_sensors: Number of sensors
+ *
+ * Runs of consecutive indices are fetched with one pread() of the whole
+ * range.  Kernels that only return one sensor per read reject that, in
+ * which case the context remembers it and each sensor is read with its
+ * own pread() (still saving the lseek() of umr_read_sensor()).  Sensors
+ * that fail to read keep their previous value in @dst.
+ *
+ * Returns 0 on success, -1 if any sensor failed to read.
+ */
+int umr_read_sensors_batch(struct umr_sensor_ctx *ctx, const int *sensors, uint32_t *dst, int no_sensors)
+{
+	int x, y, z, r = 0;
+	uint32_t value;
+
+	for (x = 0; x < no_sensors; x = y) {
+		for (y = x + 1; y < no_sensors && sensors[y] == sensors[y - 1] + 1; y++);
+
+		if (y - x > 1 && !ctx->no_ranges) {
+			if (umr_io_pread(ctx->asic, UMR_IO_SENSORS, ctx->fd, &dst[x], (y - x) * 4, sensors[x] * 4) == (y - x) * 4)
+				continue;
+			ctx->no_ranges = 1;
+		}
+		for (z = x; z < y; z++) {
+			if (umr_io_pread(ctx->asic, UMR_IO_SENSORS, ctx->fd, &value, 4, sensors[z] * 4) == 4)
+				dst[z] = value;
+			else
+				r = -1;
+		}
+	}
+	return r;
+}
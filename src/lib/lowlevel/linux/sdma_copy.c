@@ -0,0 +1,451 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+#include <dirent.h>
+#include <sys/syscall.h>
+
+/*
+ * Buffer objects are read by having an SDMA engine copy them into a GTT
+ * staging buffer the CPU reads at memory bandwidth, instead of going
+ * through the amdgpu_vram debugfs file or MM_INDEX/MM_DATA a few bytes
+ * at a time.  A copy is an ordinary command submission of our own so the
+ * source has to be mapped in our VM, which is done by importing the BO
+ * as a dma-buf (the kernel hands back the same VRAM object).  This needs
+ * the kernel driver and an SDMA engine that still makes progress.
+ *
+ * The staging buffer has two halves: while the CPU reads one the SDMA
+ * engine fills the other.
+ */
+
+#define SDMA_COPY_CHUNK       (16ULL << 20)    // bytes per half of the staging buffer
+#define SDMA_COPY_PACKET      (1ULL << 20)     // bytes per COPY_LINEAR packet
+#define SDMA_COPY_IB_DW       256              // dwords per IB, one IB per half
+#define SDMA_COPY_TIMEOUT_NS  (2000ULL * 1000 * 1000)
+
+#ifndef UMR_NO_DRM
+#include <amdgpu.h>
+#include <amdgpu_drm.h>
+#include <xf86drm.h>
+
+#define SDMA_OP_COPY               1
+#define SDMA_SUBOP_COPY_LINEAR     0
+
+struct sdma_copy {
+	struct umr_asic *asic;
+	int fd;
+	amdgpu_device_handle dev;
+	amdgpu_context_handle ctx;
+	amdgpu_bo_list_handle list;
+	struct {
+		amdgpu_bo_handle bo;
+		amdgpu_va_handle va_handle;
+		uint64_t va, size;
+		void *cpu;
+	} src, staging, ib;
+	uint64_t seq[2];
+};
+
+// the render node of the device, or its primary node if there is none,
+// found by the PCI address since the DRM minors need not follow the
+// debugfs instance
+static int open_render_node(struct umr_asic *asic)
+{
+	char path[300], card[64] = "";
+	struct dirent *de;
+	DIR *dir;
+	int fd = -1;
+
+	if (!asic->options.pci.name[0]) {
+		asic->err_msg("[ERROR]: The PCI address of the device is not known\n");
+		return -1;
+	}
+	snprintf(path, sizeof path, "/sys/bus/pci/devices/%s/drm", asic->options.pci.name);
+	dir = opendir(path);
+	if (!dir)
+		return -1;
+	while (fd < 0 && (de = readdir(dir))) {
+		if (!memcmp(de->d_name, "renderD", 7)) {
+			snprintf(path, sizeof path, "/dev/dri/%s", de->d_name);
+			fd = open(path, O_RDWR | O_CLOEXEC);
+		} else if (!memcmp(de->d_name, "card", 4) && strlen(de->d_name) < sizeof card) {
+			strcpy(card, de->d_name);
+		}
+	}
+	closedir(dir);
+	if (fd < 0 && card[0]) {
+		snprintf(path, sizeof path, "/dev/dri/%s", card);
+		fd = open(path, O_RDWR | O_CLOEXEC);
+	}
+	return fd;
+}
+
+static int map_bo(struct sdma_copy *sc, amdgpu_bo_handle bo, uint64_t size, uint64_t *va, amdgpu_va_handle *va_handle)
+{
+	size = (size + 4095) & ~4095ULL;
+	if (amdgpu_va_range_alloc(sc->dev, amdgpu_gpu_va_range_general, size, 4096, 0, va, va_handle, 0))
+		return -1;
+	if (amdgpu_bo_va_op(bo, 0, size, *va, 0, AMDGPU_VA_OP_MAP)) {
+		amdgpu_va_range_free(*va_handle);
+		*va_handle = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+static void unmap_bo(amdgpu_bo_handle bo, uint64_t size, uint64_t va, amdgpu_va_handle va_handle)
+{
+	if (!va_handle)
+		return;
+	amdgpu_bo_va_op(bo, 0, (size + 4095) & ~4095ULL, va, 0, AMDGPU_VA_OP_UNMAP);
+	amdgpu_va_range_free(va_handle);
+}
+
+static int alloc_gtt(struct sdma_copy *sc, uint64_t size, amdgpu_bo_handle *bo, void **cpu,
+		     uint64_t *va, amdgpu_va_handle *va_handle)
+{
+	struct amdgpu_bo_alloc_request req;
+
+	// cached GTT, the CPU reads it back
+	memset(&req, 0, sizeof req);
+	req.alloc_size = size;
+	req.phys_alignment = 4096;
+	req.preferred_heap = AMDGPU_GEM_DOMAIN_GTT;
+	if (amdgpu_bo_alloc(sc->dev, &req, bo))
+		return -1;
+	if (amdgpu_bo_cpu_map(*bo, cpu) || map_bo(sc, *bo, size, va, va_handle)) {
+		amdgpu_bo_free(*bo);
+		*bo = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+static void sdma_copy_fini(struct sdma_copy *sc)
+{
+	if (sc->list)
+		amdgpu_bo_list_destroy(sc->list);
+	if (sc->ctx)
+		amdgpu_cs_ctx_free(sc->ctx);
+	if (sc->ib.bo) {
+		unmap_bo(sc->ib.bo, sc->ib.size, sc->ib.va, sc->ib.va_handle);
+		amdgpu_bo_cpu_unmap(sc->ib.bo);
+		amdgpu_bo_free(sc->ib.bo);
+	}
+	if (sc->staging.bo) {
+		unmap_bo(sc->staging.bo, sc->staging.size, sc->staging.va, sc->staging.va_handle);
+		amdgpu_bo_cpu_unmap(sc->staging.bo);
+		amdgpu_bo_free(sc->staging.bo);
+	}
+	if (sc->src.bo) {
+		unmap_bo(sc->src.bo, sc->src.size, sc->src.va, sc->src.va_handle);
+		amdgpu_bo_free(sc->src.bo);
+	}
+	if (sc->dev)
+		amdgpu_device_deinitialize(sc->dev);
+	if (sc->fd >= 0)
+		close(sc->fd);
+}
+
+static int sdma_copy_init(struct sdma_copy *sc, struct umr_asic *asic, int dmabuf_fd)
+{
+	struct amdgpu_bo_import_result imp;
+	amdgpu_bo_handle bos[3];
+	uint32_t major, minor;
+
+	memset(sc, 0, sizeof *sc);
+	sc->asic = asic;
+	sc->fd = open_render_node(asic);
+	if (sc->fd < 0) {
+		asic->err_msg("[ERROR]: Could not open the DRM device of %s\n", asic->options.pci.name);
+		return -1;
+	}
+	if (amdgpu_device_initialize(sc->fd, &major, &minor, &sc->dev)) {
+		sc->dev = NULL;
+		asic->err_msg("[ERROR]: Could not initialize the amdgpu device\n");
+		goto error;
+	}
+
+	if (amdgpu_bo_import(sc->dev, amdgpu_bo_handle_type_dma_buf_fd, dmabuf_fd, &imp)) {
+		asic->err_msg("[ERROR]: Could not import the buffer object\n");
+		goto error;
+	}
+	sc->src.bo = imp.buf_handle;
+	sc->src.size = imp.alloc_size;
+	if (map_bo(sc, sc->src.bo, sc->src.size, &sc->src.va, &sc->src.va_handle)) {
+		asic->err_msg("[ERROR]: Could not map the buffer object\n");
+		goto error;
+	}
+
+	sc->staging.size = 2 * SDMA_COPY_CHUNK;
+	sc->ib.size = 2 * SDMA_COPY_IB_DW * 4;
+	if (alloc_gtt(sc, sc->staging.size, &sc->staging.bo, &sc->staging.cpu, &sc->staging.va, &sc->staging.va_handle) ||
+	    alloc_gtt(sc, sc->ib.size, &sc->ib.bo, &sc->ib.cpu, &sc->ib.va, &sc->ib.va_handle)) {
+		asic->err_msg("[ERROR]: Could not allocate the GTT staging buffers\n");
+		goto error;
+	}
+
+	bos[0] = sc->src.bo;
+	bos[1] = sc->staging.bo;
+	bos[2] = sc->ib.bo;
+	if (amdgpu_cs_ctx_create(sc->dev, &sc->ctx) ||
+	    amdgpu_bo_list_create(sc->dev, 3, bos, NULL, &sc->list)) {
+		asic->err_msg("[ERROR]: Could not create the SDMA submission context\n");
+		goto error;
+	}
+	return 0;
+error:
+	sdma_copy_fini(sc);
+	return -1;
+}
+
+/*
+ * submit_copy - Copy @size bytes at @offset of the source into a half of
+ * the staging buffer
+ */
+static int submit_copy(struct sdma_copy *sc, int half, uint64_t offset, uint64_t size)
+{
+	struct amdgpu_cs_request req;
+	struct amdgpu_cs_ib_info ib;
+	uint32_t *p = (uint32_t *)sc->ib.cpu + half * SDMA_COPY_IB_DW;
+	uint64_t src = sc->src.va + offset, dst = sc->staging.va + half * SDMA_COPY_CHUNK, n;
+	int len = 0;
+
+	while (size) {
+		n = size > SDMA_COPY_PACKET ? SDMA_COPY_PACKET : size;
+		p[len++] = SDMA_OP_COPY | (SDMA_SUBOP_COPY_LINEAR << 8);
+		// SDMA 4.0 and later count from zero
+		p[len++] = sc->asic->family >= FAMILY_AI ? n - 1 : n;
+		p[len++] = 0;   // no endian swap
+		p[len++] = src & 0xFFFFFFFF;
+		p[len++] = src >> 32;
+		p[len++] = dst & 0xFFFFFFFF;
+		p[len++] = dst >> 32;
+		src += n;
+		dst += n;
+		size -= n;
+	}
+	// IBs are a multiple of 8 dwords, a zero dword is a NOP
+	while (len & 7)
+		p[len++] = 0;
+
+	memset(&ib, 0, sizeof ib);
+	ib.ib_mc_address = sc->ib.va + half * SDMA_COPY_IB_DW * 4;
+	ib.size = len;
+	memset(&req, 0, sizeof req);
+	req.ip_type = AMDGPU_HW_IP_DMA;
+	req.resources = sc->list;
+	req.number_of_ibs = 1;
+	req.ibs = &ib;
+	if (amdgpu_cs_submit(sc->ctx, 0, &req, 1)) {
+		sc->asic->err_msg("[ERROR]: Could not submit the SDMA copy\n");
+		return -1;
+	}
+	sc->seq[half] = req.seq_no;
+	return 0;
+}
+
+static int wait_copy(struct sdma_copy *sc, int half)
+{
+	struct amdgpu_cs_fence fence;
+	uint32_t expired = 0;
+
+	memset(&fence, 0, sizeof fence);
+	fence.context = sc->ctx;
+	fence.ip_type = AMDGPU_HW_IP_DMA;
+	fence.fence = sc->seq[half];
+	if (amdgpu_cs_query_fence_status(&fence, SDMA_COPY_TIMEOUT_NS, 0, &expired) || !expired) {
+		sc->asic->err_msg("[ERROR]: The SDMA copy did not complete (is the GPU hung?)\n");
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * umr_sdma_read_dmabuf - Read a buffer object with SDMA copies through GTT
+ *
+ * @asic: The device the buffer object lives on
+ * @dmabuf_fd: The buffer object exported as a dma-buf, see
+ *             umr_sdma_export_client_bo()
+ * @offset: Where to start reading in the buffer object (bytes)
+ * @size: How many bytes to read, 0 reads up to the end of the object
+ * @sink: Receives the bytes in order in pieces of up to 16MB, returning
+ *        non-zero stops the read
+ * @data: Opaque pointer passed to @sink
+ *
+ * Requires the amdgpu kernel driver.  A copy that does not complete
+ * within two seconds fails the read.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int umr_sdma_read_dmabuf(struct umr_asic *asic, int dmabuf_fd, uint64_t offset, uint64_t size,
+			 umr_sdma_sink sink, void *data)
+{
+	struct sdma_copy sc;
+	uint64_t pos, n, next;
+	int half, r = 0;
+
+	if (asic->family < FAMILY_CIK || asic->options.no_kernel) {
+		asic->err_msg("[ERROR]: SDMA copies need an SDMA engine and the amdgpu kernel driver\n");
+		return -1;
+	}
+	if ((offset | size) & 3) {
+		asic->err_msg("[ERROR]: SDMA copies must be dword aligned\n");
+		return -1;
+	}
+	if (sdma_copy_init(&sc, asic, dmabuf_fd))
+		return -1;
+	if (!size && offset < sc.src.size)
+		size = sc.src.size - offset;
+	if (offset > sc.src.size || size > sc.src.size - offset) {
+		asic->err_msg("[ERROR]: Range 0x%" PRIx64 "+0x%" PRIx64 " is outside of the buffer object (0x%" PRIx64 " bytes)\n",
+			offset, size, sc.src.size);
+		sdma_copy_fini(&sc);
+		return -1;
+	}
+
+	// the next chunk is copied while the current one is handed to the sink
+	pos = 0;
+	half = 0;
+	if (size && submit_copy(&sc, 0, offset, size < SDMA_COPY_CHUNK ? size : SDMA_COPY_CHUNK))
+		r = -1;
+	while (!r && pos < size) {
+		n = size - pos < SDMA_COPY_CHUNK ? size - pos : SDMA_COPY_CHUNK;
+		next = pos + n;
+		if (next < size &&
+		    submit_copy(&sc, half ^ 1, offset + next, size - next < SDMA_COPY_CHUNK ? size - next : SDMA_COPY_CHUNK)) {
+			r = -1;
+			break;
+		}
+		if (wait_copy(&sc, half) ||
+		    sink(data, (uint8_t *)sc.staging.cpu + half * SDMA_COPY_CHUNK, n)) {
+			// the kernel keeps the buffers of a copy in flight alive
+			r = -1;
+			break;
+		}
+		pos = next;
+		half ^= 1;
+	}
+	sdma_copy_fini(&sc);
+	return r;
+}
+
+/*
+ * find_client_fd - The fd of @pid on @asic if there is exactly one
+ *
+ * The fds are matched on the drm-pdev key of their fdinfo.
+ */
+static int find_client_fd(struct umr_asic *asic, int pid)
+{
+	char path[64], line[256], pdev[64];
+	struct dirent *de;
+	DIR *dir;
+	FILE *f;
+	int fd = -1, n = 0;
+
+	snprintf(pdev, sizeof pdev, "drm-pdev:\t%s", asic->options.pci.name);
+	snprintf(path, sizeof path, "/proc/%d/fdinfo", pid);
+	dir = opendir(path);
+	if (!dir)
+		return -1;
+	while ((de = readdir(dir))) {
+		snprintf(path, sizeof path, "/proc/%d/fdinfo/%s", pid, de->d_name);
+		f = fopen(path, "r");
+		if (!f)
+			continue;
+		while (fgets(line, sizeof line, f))
+			if (!memcmp(line, pdev, strlen(pdev))) {
+				fd = atoi(de->d_name);
+				++n;
+				break;
+			}
+		fclose(f);
+	}
+	closedir(dir);
+	if (n > 1) {
+		asic->err_msg("[ERROR]: Process %d has %d fds open on the device, specify which one\n", pid, n);
+		return -1;
+	}
+	return fd;
+}
+
+/**
+ * umr_sdma_export_client_bo - Export a buffer object of another process
+ *
+ * @asic: The device
+ * @pid: The process owning the GEM handle
+ * @fd: The DRM fd of @pid the handle belongs to, or -1 to use the only fd
+ *      @pid has open on @asic
+ * @handle: The GEM handle (as listed by amdgpu_gem_info)
+ *
+ * The fd is taken from the process with pidfd_getfd() which needs
+ * ptrace access to it.
+ *
+ * Returns a dma-buf fd to be closed by the caller, or -1 on error.
+ */
+int umr_sdma_export_client_bo(struct umr_asic *asic, int pid, int fd, uint32_t handle)
+{
+	int pid_fd, gpu_fd, dmabuf_fd = -1;
+
+	if (fd < 0)
+		fd = find_client_fd(asic, pid);
+	if (fd < 0) {
+		asic->err_msg("[ERROR]: Could not find the DRM fd of process %d\n", pid);
+		return -1;
+	}
+	pid_fd = syscall(SYS_pidfd_open, pid, 0);
+	if (pid_fd < 0) {
+		asic->err_msg("[ERROR]: Could not open process %d\n", pid);
+		return -1;
+	}
+	gpu_fd = syscall(SYS_pidfd_getfd, pid_fd, fd, 0);
+	close(pid_fd);
+	if (gpu_fd < 0) {
+		asic->err_msg("[ERROR]: Could not import fd %d of process %d\n", fd, pid);
+		return -1;
+	}
+	if (drmPrimeHandleToFD(gpu_fd, handle, DRM_CLOEXEC, &dmabuf_fd))
+		asic->err_msg("[ERROR]: Could not export GEM handle %" PRIu32 " of process %d\n", handle, pid);
+	close(gpu_fd);
+	return dmabuf_fd;
+}
+
+#else
+
+int umr_sdma_read_dmabuf(struct umr_asic *asic, int dmabuf_fd, uint64_t offset, uint64_t size,
+			 umr_sdma_sink sink, void *data)
+{
+	(void)dmabuf_fd; (void)offset; (void)size; (void)sink; (void)data;
+	asic->err_msg("[ERROR]: SDMA copies need libdrm, umr was built with UMR_NO_DRM\n");
+	return -1;
+}
+
+int umr_sdma_export_client_bo(struct umr_asic *asic, int pid, int fd, uint32_t handle)
+{
+	(void)pid; (void)fd; (void)handle;
+	asic->err_msg("[ERROR]: Exporting buffer objects needs libdrm, umr was built with UMR_NO_DRM\n");
+	return -1;
+}
+
+#endif
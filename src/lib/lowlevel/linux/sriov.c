@@ -0,0 +1,361 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+#include <dirent.h>
+
+/*
+ * The VFs of an SR-IOV device are sampled from the PF alone.  The RLC
+ * keeps the scheduling state of every function in its GPU_IOV registers
+ * (the function that owns the GFX engine and a bit per function of busy
+ * VMs, busy SDMA queues and pending doorbells, bit 31 being the PF) so
+ * one batch read of the PF registers per sample covers all of the VFs
+ * with the register database of the PF.  VFs that are bound to amdgpu on
+ * the host also expose their kernel rings, their fence progress is read
+ * from their amdgpu_fence_info when the counters are taken.
+ */
+
+#define SRIOV_PF 31
+#define SRIOV_MAX_SDMA 8
+
+enum {
+	SRIOV_ACTIVE_FCN = 0,
+	SRIOV_VM_BUSY,
+	SRIOV_DOORBELL,
+	SRIOV_SDMA0,
+	SRIOV_NO_REGS = SRIOV_SDMA0 + SRIOV_MAX_SDMA,
+};
+
+struct sriov_ring_state {
+	struct umr_fence_tracker *ft;
+	struct umr_fence_snapshot last, cur;
+	struct umr_ring_fence_delta *deltas;
+	int max_deltas;
+};
+
+struct umr_sriov_sampler {
+	struct umr_asic *asic;
+	struct umr_sriov_vf vfs[UMR_SRIOV_MAX_VFS];
+	struct sriov_ring_state rings[UMR_SRIOV_MAX_VFS];
+	int no_vfs;
+
+	struct umr_reg_batch batch[SRIOV_NO_REGS];
+	int word[SRIOV_NO_REGS];            // index in batch[] or -1 if the register is missing
+	int no_words;
+	unsigned vf_id_shift, pf_vf_shift;
+	uint32_t vf_id_mask;
+
+	struct umr_sriov_fcn_stats cnt[SRIOV_PF + 1];   // indexed by function bit
+	uint64_t samples;
+	int last_fcn;
+};
+
+// the DRI instance of a PCI device in debugfs or -1
+static int sriov_dri_instance(const char *pci_name)
+{
+	char path[300], line[128], *dev;
+	struct dirent *de;
+	DIR *dir;
+	FILE *f;
+	int inst = -1;
+
+	dir = opendir("/sys/kernel/debug/dri");
+	if (!dir)
+		return -1;
+	while (inst < 0 && (de = readdir(dir))) {
+		if (de->d_name[0] < '0' || de->d_name[0] > '9' || atoi(de->d_name) >= 128)
+			continue;
+		snprintf(path, sizeof path, "/sys/kernel/debug/dri/%s/name", de->d_name);
+		f = fopen(path, "r");
+		if (!f)
+			continue;
+		if (fgets(line, sizeof line, f)) {
+			line[strcspn(line, "\n")] = 0;
+			dev = strstr(line, "dev=");
+			dev = dev ? dev + 4 : strchr(line, ' ');
+			if (dev && *dev == ' ')
+				++dev;
+			if (dev && !strncmp(dev, pci_name, strlen(pci_name)) &&
+			    (!dev[strlen(pci_name)] || dev[strlen(pci_name)] == ' '))
+				inst = atoi(de->d_name);
+		}
+		fclose(f);
+	}
+	closedir(dir);
+	return inst;
+}
+
+/**
+ * umr_sriov_list_vfs - Find the enabled VFs of a PF
+ *
+ * @asic: The PF
+ * @vfs: Receives the VFs
+ * @max: Size of @vfs
+ *
+ * The VFs are the virtfn<n> links of the PF in sysfs, <n> being the VF
+ * number.  A VF that is bound to amdgpu on the host has the debugfs DRI
+ * instance of its own, the VFs passed to guests have none.
+ *
+ * Returns the number of VFs (0 if SR-IOV is not enabled) or -1 if the PCI
+ * address of the PF is not known.
+ */
+int umr_sriov_list_vfs(struct umr_asic *asic, struct umr_sriov_vf *vfs, int max)
+{
+	char path[300], link[300], *name;
+	ssize_t len;
+	int n;
+
+	if (!asic->options.pci.name[0]) {
+		asic->err_msg("[ERROR]: The PCI address of the device is not known\n");
+		return -1;
+	}
+	for (n = 0; n < max && n < UMR_SRIOV_MAX_VFS; n++) {
+		snprintf(path, sizeof path, "/sys/bus/pci/devices/%s/virtfn%d", asic->options.pci.name, n);
+		len = readlink(path, link, sizeof link - 1);
+		if (len < 0)
+			break;
+		link[len] = 0;
+		name = strrchr(link, '/');
+		name = name ? name + 1 : link;
+		vfs[n].index = n;
+		if (snprintf(vfs[n].pci_name, sizeof vfs[n].pci_name, "%s", name) >= (int)sizeof vfs[n].pci_name) {
+			asic->err_msg("[ERROR]: VF %d has an unexpected PCI address '%s'\n", n, name);
+			break;
+		}
+		vfs[n].instance = sriov_dri_instance(vfs[n].pci_name);
+	}
+	return n;
+}
+
+// the RLC IOV register @name of the GC instance in use, NULL if missing
+static struct umr_reg *sriov_reg(struct umr_asic *asic, const char *name)
+{
+	char regname[64];
+
+	snprintf(regname, sizeof regname, "@mm%s", name);
+	return umr_find_reg_data_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, regname);
+}
+
+static const struct umr_bitfield *sriov_field(struct umr_reg *reg, const char *name)
+{
+	int i;
+
+	for (i = 0; i < reg->no_bits; i++)
+		if (!strcmp(reg->bits[i].regname, name))
+			return &reg->bits[i];
+	return NULL;
+}
+
+/**
+ * umr_sriov_sampler_open - Prepare to sample the VFs of a PF
+ *
+ * @asic: The PF
+ * @vfs: The VFs to report, from umr_sriov_list_vfs()
+ * @no_vfs: Number of entries in @vfs
+ *
+ * The RLC IOV registers are looked up once in the register database of
+ * the PF, the SDMA and doorbell status registers that a part lacks are
+ * left out of the samples.  The fence files of the VFs bound on the host
+ * are opened.
+ *
+ * Returns the sampler or NULL if the part has no RLC IOV registers.
+ */
+struct umr_sriov_sampler *umr_sriov_sampler_open(struct umr_asic *asic, const struct umr_sriov_vf *vfs, int no_vfs)
+{
+	static const char *names[SRIOV_NO_REGS] = {
+		"RLC_GPU_IOV_ACTIVE_FCN_ID", "RLC_GPU_IOV_VM_BUSY_STATUS", "RLC_GPU_IOV_VF_DOORBELL_STATUS",
+		"RLC_GPU_IOV_SDMA0_BUSY_STATUS", "RLC_GPU_IOV_SDMA1_BUSY_STATUS",
+		"RLC_GPU_IOV_SDMA2_BUSY_STATUS", "RLC_GPU_IOV_SDMA3_BUSY_STATUS",
+		"RLC_GPU_IOV_SDMA4_BUSY_STATUS", "RLC_GPU_IOV_SDMA5_BUSY_STATUS",
+		"RLC_GPU_IOV_SDMA6_BUSY_STATUS", "RLC_GPU_IOV_SDMA7_BUSY_STATUS",
+	};
+	const struct umr_bitfield *vf_id, *pf_vf;
+	struct umr_sriov_sampler *s;
+	struct sriov_ring_state *rs;
+	struct umr_reg *reg;
+	int i;
+
+	reg = sriov_reg(asic, names[SRIOV_ACTIVE_FCN]);
+	vf_id = reg ? sriov_field(reg, "VF_ID") : NULL;
+	pf_vf = reg ? sriov_field(reg, "PF_VF") : NULL;
+	if (!vf_id || !pf_vf) {
+		asic->err_msg("[ERROR]: The device has no RLC_GPU_IOV_ACTIVE_FCN_ID register\n");
+		return NULL;
+	}
+
+	s = calloc(1, sizeof *s);
+	if (!s) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return NULL;
+	}
+	s->asic = asic;
+	s->last_fcn = -1;
+	s->vf_id_shift = vf_id->start;
+	s->vf_id_mask = umr_bitfield_mask(vf_id);
+	s->pf_vf_shift = pf_vf->start;
+	s->no_vfs = no_vfs < UMR_SRIOV_MAX_VFS ? no_vfs : UMR_SRIOV_MAX_VFS;
+	memcpy(s->vfs, vfs, s->no_vfs * sizeof *vfs);
+
+	for (i = 0; i < SRIOV_NO_REGS; i++) {
+		reg = sriov_reg(asic, names[i]);
+		s->word[i] = -1;
+		if (!reg)
+			continue;
+		s->word[i] = s->no_words;
+		s->batch[s->no_words].addr = reg->type == REG_MMIO ? reg->addr * 4 : reg->addr;
+		s->batch[s->no_words++].type = reg->type;
+	}
+
+	for (i = 0; i < s->no_vfs; i++) {
+		rs = &s->rings[i];
+		if (s->vfs[i].instance < 0)
+			continue;
+		rs->ft = umr_fence_tracker_open_instance(asic, s->vfs[i].instance);
+		if (rs->ft && umr_fence_tracker_read(rs->ft, &rs->last) < 0) {
+			umr_fence_tracker_close(rs->ft);
+			rs->ft = NULL;
+		}
+	}
+	return s;
+}
+
+/**
+ * umr_sriov_sampler_sample - Take one sample of every function
+ *
+ * @s: The sampler
+ *
+ * The RLC IOV registers are read with one umr_read_regs_batch() and
+ * added to the counters of the functions.
+ *
+ * Returns 0 on success and -1 if the registers could not be read.
+ */
+int umr_sriov_sampler_sample(struct umr_sriov_sampler *s)
+{
+	uint32_t active, busy, doorbell, sdma;
+	int i, fcn;
+
+	if (umr_read_regs_batch(s->asic, s->batch, s->no_words))
+		return -1;
+
+	active = s->batch[s->word[SRIOV_ACTIVE_FCN]].value;
+	fcn = ((active >> s->pf_vf_shift) & 1) ? (int)((active >> s->vf_id_shift) & s->vf_id_mask) : SRIOV_PF;
+	if (fcn > SRIOV_PF)
+		fcn = SRIOV_PF;
+	++s->cnt[fcn].active;
+	if (s->last_fcn >= 0 && fcn != s->last_fcn)
+		++s->cnt[fcn].switches;
+	s->last_fcn = fcn;
+
+	busy = s->word[SRIOV_VM_BUSY] >= 0 ? s->batch[s->word[SRIOV_VM_BUSY]].value : 0;
+	doorbell = s->word[SRIOV_DOORBELL] >= 0 ? s->batch[s->word[SRIOV_DOORBELL]].value : 0;
+	for (sdma = 0, i = 0; i < SRIOV_MAX_SDMA; i++)
+		if (s->word[SRIOV_SDMA0 + i] >= 0)
+			sdma |= s->batch[s->word[SRIOV_SDMA0 + i]].value;
+
+	for (i = 0; i <= SRIOV_PF; i++) {
+		s->cnt[i].gfx_busy += (busy >> i) & 1;
+		s->cnt[i].doorbell += (doorbell >> i) & 1;
+		s->cnt[i].sdma_busy += (sdma >> i) & 1;
+	}
+	++s->samples;
+	return 0;
+}
+
+// fences signaled on the rings of a VF since the last call
+static int sriov_ring_progress(struct sriov_ring_state *rs, uint64_t *fences)
+{
+	struct umr_fence_snapshot t;
+	struct umr_ring_fence_delta *d;
+	int i, n;
+
+	n = umr_fence_tracker_read(rs->ft, &rs->cur);
+	if (n < 0)
+		return -1;
+	if (n > rs->max_deltas) {
+		d = realloc(rs->deltas, n * sizeof *d);
+		if (!d)
+			return -1;
+		rs->deltas = d;
+		rs->max_deltas = n;
+	}
+	umr_fence_snapshot_delta(&rs->last, &rs->cur, rs->deltas);
+	for (*fences = 0, i = 0; i < n; i++)
+		*fences += rs->deltas[i].signaled;
+
+	t = rs->last;
+	rs->last = rs->cur;
+	rs->cur = t;
+	return 0;
+}
+
+/**
+ * umr_sriov_sampler_take - Take the counters of every function and reset them
+ *
+ * @s: The sampler
+ * @stats: Receives the counters of the VFs, in the order they were passed
+ *         to umr_sriov_sampler_open(), followed by those of the PF
+ * @samples: Set to the number of samples the counters cover (may be NULL)
+ *
+ * The fences signaled on the rings of the VFs bound on the host are read
+ * here, so they cover the time since the previous call.
+ *
+ * Returns the number of entries stored in @stats.
+ */
+int umr_sriov_sampler_take(struct umr_sriov_sampler *s, struct umr_sriov_fcn_stats *stats, uint64_t *samples)
+{
+	struct sriov_ring_state *rs;
+	int i;
+
+	for (i = 0; i < s->no_vfs; i++) {
+		stats[i] = s->cnt[s->vfs[i].index];
+		rs = &s->rings[i];
+		if (rs->ft && !sriov_ring_progress(rs, &stats[i].fences))
+			stats[i].has_rings = 1;
+	}
+	stats[i] = s->cnt[SRIOV_PF];
+	if (samples)
+		*samples = s->samples;
+
+	memset(s->cnt, 0, sizeof s->cnt);
+	s->samples = 0;
+	return s->no_vfs + 1;
+}
+
+/**
+ * umr_sriov_sampler_close - Free a sampler from umr_sriov_sampler_open()
+ */
+void umr_sriov_sampler_close(struct umr_sriov_sampler *s)
+{
+	int i;
+
+	if (!s)
+		return;
+	for (i = 0; i < s->no_vfs; i++) {
+		umr_fence_tracker_close(s->rings[i].ft);
+		umr_fence_snapshot_free(&s->rings[i].last);
+		umr_fence_snapshot_free(&s->rings[i].cur);
+		free(s->rings[i].deltas);
+	}
+	free(s);
+}
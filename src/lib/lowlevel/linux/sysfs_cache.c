@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+
+/*
+ * sysfs/debugfs text files polled by the power and sensor views are kept
+ * open and re-read with pread() at offset 0 (which makes the kernel
+ * generate the contents again) instead of an open/read/close per sample.
+ *
+ * With umr_sysfs_cache_refresh_start() a thread re-reads every file that
+ * was read recently once per period, in one pass, and readers get the
+ * copy it made so a request never waits on a slow attribute (some hwmon
+ * files ask the SMU).
+ */
+
+#define SYSFS_FILE_MAX  4096            // sysfs attributes are at most a page
+#define SYSFS_RETRY_NS  1000000000ULL   // how long a missing file stays missing
+#define SYSFS_IDLE      4               // periods without a reader before the thread skips a file
+
+struct sysfs_file {
+	char *path;
+	int fd;
+	uint64_t opened_ns;         // of the last open attempt
+	uint64_t used_ns;           // of the last umr_sysfs_read()
+	uint64_t read_ns;           // when buf was filled, 0 if it never was
+	char *buf;                  // the refresh thread's copy
+	int len;
+};
+
+struct umr_sysfs_cache {
+	pthread_mutex_t lock;       // protects everything but the fds (never closed while in use)
+	struct sysfs_file *files;
+	int no_files;
+
+	pthread_t thread;
+	pthread_cond_t cond;
+	int running, stop;
+	uint64_t period_ns;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static struct umr_sysfs_cache *get_cache(struct umr_asic *asic)
+{
+	struct umr_sysfs_cache *c;
+
+	// the first use is from the thread that set up the asic
+	if (!asic->sysfs_cache) {
+		c = calloc(1, sizeof *c);
+		if (!c)
+			return NULL;
+		pthread_mutex_init(&c->lock, NULL);
+		pthread_cond_init(&c->cond, NULL);
+		asic->sysfs_cache = c;
+	}
+	return asic->sysfs_cache;
+}
+
+static struct sysfs_file *find_file(struct umr_sysfs_cache *c, const char *path, uint64_t now)
+{
+	struct sysfs_file *f, *t;
+	int x;
+
+	for (x = 0; x < c->no_files; x++) {
+		f = &c->files[x];
+		if (strcmp(f->path, path))
+			continue;
+		if (f->fd < 0 && now - f->opened_ns >= SYSFS_RETRY_NS) {
+			f->fd = open(path, O_RDONLY | O_CLOEXEC);
+			f->opened_ns = now;
+		}
+		return f;
+	}
+
+	t = realloc(c->files, (c->no_files + 1) * sizeof *t);
+	if (!t)
+		return NULL;
+	c->files = t;
+	f = &c->files[c->no_files];
+	memset(f, 0, sizeof *f);
+	f->path = strdup(path);
+	if (!f->path)
+		return NULL;
+	f->fd = open(path, O_RDONLY | O_CLOEXEC);
+	f->opened_ns = now;
+	++c->no_files;
+	return f;
+}
+
+static int read_fd(int fd, char *buf, int size)
+{
+	ssize_t r;
+
+	do {
+		r = pread(fd, buf, size - 1, 0);
+	} while (r < 0 && errno == EINTR);
+	if (r < 0)
+		r = 0;
+	buf[r] = 0;
+	return r;
+}
+
+/**
+ * umr_sysfs_read - Read a sysfs or debugfs text file of a device
+ *
+ * @asic: The device the file belongs to, it owns the open file
+ * @path: The file
+ * @buf: Receives the contents, NUL terminated (empty on error)
+ * @size: Size of @buf
+ *
+ * The file is opened the first time it is read and kept open until the
+ * asic is freed.  While the refresh thread runs the contents it read in
+ * its last pass are returned.
+ *
+ * Returns the number of bytes read or -1 if the file can't be read.
+ */
+int umr_sysfs_read(struct umr_asic *asic, const char *path, char *buf, int size)
+{
+	struct umr_sysfs_cache *c;
+	struct sysfs_file *f;
+	uint64_t now = now_ns();
+	int fd, len;
+
+	buf[0] = 0;
+	c = get_cache(asic);
+	if (!c)
+		return -1;
+
+	pthread_mutex_lock(&c->lock);
+	f = find_file(c, path, now);
+	if (!f || f->fd < 0) {
+		pthread_mutex_unlock(&c->lock);
+		return -1;
+	}
+	f->used_ns = now;
+	if (c->running && f->read_ns && now - f->read_ns < 2 * c->period_ns) {
+		len = f->len < size ? f->len : size - 1;
+		memcpy(buf, f->buf, len);
+		buf[len] = 0;
+		pthread_mutex_unlock(&c->lock);
+		return len;
+	}
+	fd = f->fd;
+	pthread_mutex_unlock(&c->lock);
+	return read_fd(fd, buf, size);
+}
+
+static void *refresh_thread(void *arg)
+{
+	struct umr_sysfs_cache *c = arg;
+	struct timespec ts;
+	char *tmp;
+	uint64_t now;
+	int x, fd, len;
+
+	tmp = malloc(SYSFS_FILE_MAX);
+	if (!tmp)
+		return NULL;
+	pthread_mutex_lock(&c->lock);
+	while (!c->stop) {
+		// one pass over the files someone still reads
+		now = now_ns();
+		for (x = 0; x < c->no_files && !c->stop; x++) {
+			if (c->files[x].fd < 0 || now - c->files[x].used_ns > SYSFS_IDLE * c->period_ns)
+				continue;
+			fd = c->files[x].fd;
+			pthread_mutex_unlock(&c->lock);
+			len = read_fd(fd, tmp, SYSFS_FILE_MAX);
+			pthread_mutex_lock(&c->lock);
+			if (!c->files[x].buf)
+				c->files[x].buf = malloc(SYSFS_FILE_MAX);
+			if (c->files[x].buf) {
+				memcpy(c->files[x].buf, tmp, len + 1);
+				c->files[x].len = len;
+				c->files[x].read_ns = now_ns();
+			}
+		}
+
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += c->period_ns / 1000000000ULL;
+		ts.tv_nsec += c->period_ns % 1000000000ULL;
+		if (ts.tv_nsec >= 1000000000L) {
+			ts.tv_nsec -= 1000000000L;
+			++ts.tv_sec;
+		}
+		while (!c->stop && pthread_cond_timedwait(&c->cond, &c->lock, &ts) != ETIMEDOUT);
+	}
+	pthread_mutex_unlock(&c->lock);
+	free(tmp);
+	return NULL;
+}
+
+/**
+ * umr_sysfs_cache_refresh_start - Re-read the files of a device on a thread
+ *
+ * @asic: The device
+ * @period_ns: How often the files read in the last few periods are re-read
+ *
+ * Returns 0 on success (or if the thread already runs), -1 on error.
+ */
+int umr_sysfs_cache_refresh_start(struct umr_asic *asic, uint64_t period_ns)
+{
+	struct umr_sysfs_cache *c = get_cache(asic);
+	int r = 0;
+
+	if (!c || !period_ns)
+		return -1;
+	pthread_mutex_lock(&c->lock);
+	if (!c->running) {
+		c->period_ns = period_ns;
+		c->stop = 0;
+		if (pthread_create(&c->thread, NULL, refresh_thread, c))
+			r = -1;
+		else
+			c->running = 1;
+	}
+	pthread_mutex_unlock(&c->lock);
+	return r;
+}
+
+/**
+ * umr_sysfs_cache_free - Stop the refresh thread and close the files
+ */
+void umr_sysfs_cache_free(struct umr_asic *asic)
+{
+	struct umr_sysfs_cache *c = asic->sysfs_cache;
+	int x;
+
+	if (!c)
+		return;
+	if (c->running) {
+		pthread_mutex_lock(&c->lock);
+		c->stop = 1;
+		pthread_cond_signal(&c->cond);
+		pthread_mutex_unlock(&c->lock);
+		pthread_join(c->thread, NULL);
+	}
+	for (x = 0; x < c->no_files; x++) {
+		if (c->files[x].fd >= 0)
+			close(c->files[x].fd);
+		free(c->files[x].path);
+		free(c->files[x].buf);
+	}
+	free(c->files);
+	pthread_cond_destroy(&c->cond);
+	pthread_mutex_destroy(&c->lock);
+	free(c);
+	asic->sysfs_cache = NULL;
+}
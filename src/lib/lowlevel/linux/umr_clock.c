@@ -23,40 +23,138 @@
 #include "umr.h"
 #include <time.h>
 
-/**
- * umr_read_clock - Read a clock information via sysfs
+/*
+ * The pp_dpm_* files (and the performance level) are read through
+ * umr_sysfs_read() so they stay open, and what was parsed from each is
+ * kept with a hash of its text.  A file that reads back the same is not
+ * parsed again, which is most reads when they are polled.
  */
-int umr_read_clock(struct umr_asic *asic, char* clockname, struct umr_clock_source* clock)
+#define CLOCK_CACHE_FILES (UMR_CLOCK_MAX + 2)
+
+struct umr_clock_cache {
+	struct {
+		char name[40];
+		uint64_t hash;
+		uint32_t clock_Mhz[10];
+		int clock_level;
+		int current_clock; // -1 if no level is marked
+	} files[CLOCK_CACHE_FILES];
+	int no_files;
+};
+
+static const char *clock_names[UMR_CLOCK_MAX] = {
+	"sclk", "mclk", "pcie", "fclk", "socclk", "dcefclk",
+};
+
+static uint64_t fnv1a(const char *buf, int len)
 {
-	FILE* fp = NULL;
-	char name[256];
-	char* token;
-	int ret = -1;
-	snprintf(name, sizeof(name)-1, \
-		"/sys/class/drm/card%d/device/pp_dpm_%s", asic->instance, clockname);
-	clock->clock_level = 0;
-	fp = fopen(name, "r");
-	if (fp) {
-		while (fgets(name, sizeof(name)-1, fp)) {
+	uint64_t h = 0xcbf29ce484222325ULL;
+
+	while (len-- > 0) {
+		h ^= (uint8_t)*buf++;
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+// the cache entry of a file, NULL if it can't be kept
+static struct umr_clock_cache *clock_cache_entry(struct umr_asic *asic, const char *name, int *idx)
+{
+	struct umr_clock_cache *c = asic->clock_cache;
+	int x;
+
+	if (!c) {
+		c = calloc(1, sizeof *c);
+		if (!c)
+			return NULL;
+		asic->clock_cache = c;
+	}
+	for (x = 0; x < c->no_files; x++) {
+		if (!strcmp(c->files[x].name, name)) {
+			*idx = x;
+			return c;
+		}
+	}
+	if (c->no_files == CLOCK_CACHE_FILES || strlen(name) >= sizeof c->files[0].name)
+		return NULL;
+	x = c->no_files++;
+	strcpy(c->files[x].name, name);
+	c->files[x].hash = 0;
+	c->files[x].clock_level = -1; // never parsed
+	*idx = x;
+	return c;
+}
 
-			if (strstr(name, "*"))
-				clock->current_clock = clock->clock_level;
+static void parse_clock(char *buf, struct umr_clock_source *clock, int *current)
+{
+	char *line, *next, *token;
 
-			token = strtok(name, " ");
-			while(token != NULL){
+	*current = -1;
+	for (line = buf; *line && clock->clock_level < (int)(sizeof(clock->clock_Mhz) / sizeof(clock->clock_Mhz[0])); line = next) {
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = 0;
+		else
+			next = line + strlen(line);
+
+		if (strstr(line, "*"))
+			*current = clock->clock_level;
+
+		token = strtok(line, " ");
+		while(token != NULL){
 			if (strstr(token,"Mhz")){
-					sscanf(token, "%uMhz", &clock->clock_Mhz[clock->clock_level]);
-					break;
-				}
-				token = strtok(NULL, " ");
+				sscanf(token, "%uMhz", &clock->clock_Mhz[clock->clock_level]);
+				break;
 			}
-			clock->clock_level++;
+			token = strtok(NULL, " ");
 		}
-		fclose(fp);
-		ret = 0;
+		clock->clock_level++;
 	}
+}
 
-	return ret;
+// returns -1 on error, 1 if the file changed since it was last read and 0 if not
+static int read_clock(struct umr_asic *asic, const char *clockname, struct umr_clock_source *clock)
+{
+	struct umr_clock_cache *c;
+	char name[256], buf[4096];
+	uint64_t hash;
+	int n, x, current;
+
+	snprintf(name, sizeof(name)-1, \
+		"/sys/class/drm/card%d/device/pp_dpm_%s", asic->instance, clockname);
+	clock->clock_level = 0;
+	n = umr_sysfs_read(asic, name, buf, sizeof buf);
+	if (n < 0)
+		return -1;
+
+	hash = fnv1a(buf, n);
+	c = clock_cache_entry(asic, name, &x);
+	if (c && c->files[x].clock_level >= 0 && c->files[x].hash == hash) {
+		clock->clock_level = c->files[x].clock_level;
+		memcpy(clock->clock_Mhz, c->files[x].clock_Mhz, sizeof clock->clock_Mhz);
+		if (c->files[x].current_clock >= 0)
+			clock->current_clock = c->files[x].current_clock;
+		return 0;
+	}
+
+	parse_clock(buf, clock, &current);
+	if (current >= 0)
+		clock->current_clock = current;
+	if (c) {
+		c->files[x].hash = hash;
+		c->files[x].clock_level = clock->clock_level;
+		c->files[x].current_clock = current;
+		memcpy(c->files[x].clock_Mhz, clock->clock_Mhz, sizeof clock->clock_Mhz);
+	}
+	return 1;
+}
+
+/**
+ * umr_read_clock - Read a clock information via sysfs
+ */
+int umr_read_clock(struct umr_asic *asic, char* clockname, struct umr_clock_source* clock)
+{
+	return read_clock(asic, clockname, clock) < 0 ? -1 : 0;
 }
 
 /**
@@ -83,7 +181,7 @@ int umr_set_clock(struct umr_asic *asic, const char* clock_name, void* value)
 		"/sys/class/drm/card%d/device/pp_dpm_%s", asic->instance, clock_name);
 	fd = open(name, O_RDWR);
 	if (fd) {
-		if (write(fd, input, input_len+1) < 0) {
+		if (umr_io_write(asic, UMR_IO_OTHER, fd, input, input_len+1) < 0) {
 			asic->err_msg("[ERROR]: Could not write to clock file %s\n", name);
 		}
 		close(fd);
@@ -112,35 +210,97 @@ void umr_set_clock_performance(struct umr_asic *asic, const char* operation)
 		"/sys/class/drm/card%d/device/power_dpm_force_performance_level", asic->instance);
 	fd = open(fname, O_RDWR);
 	if (fd) {
-		str_len = write(fd, oper_string, strlen(oper_string));
+		str_len = umr_io_write(asic, UMR_IO_OTHER, fd, oper_string, strlen(oper_string));
 		close(fd);
 	}
 	if (str_len != strlen(oper_string))
 		asic->err_msg("[ERROR]: Operate clock failed!\n");
 }
 
+// the first line of power_dpm_force_performance_level, same return as read_clock()
+static int read_performance_level(struct umr_asic *asic, char *level, uint32_t len)
+{
+	struct umr_clock_cache *c;
+	char name[256], buf[256], *p;
+	uint64_t hash;
+	int n, x;
+
+	snprintf(name, sizeof(name)-1, \
+		"/sys/class/drm/card%d/device/power_dpm_force_performance_level", asic->instance);
+	n = umr_sysfs_read(asic, name, buf, sizeof buf);
+	if (n <= 0)
+		return -1;
+	p = strchr(buf, '\n');
+	if (p)
+		p[1] = 0;
+	snprintf(level, len, "%s", buf);
+
+	hash = fnv1a(buf, n);
+	c = clock_cache_entry(asic, name, &x);
+	if (!c)
+		return 1;
+	if (c->files[x].clock_level >= 0 && c->files[x].hash == hash)
+		return 0;
+	c->files[x].hash = hash;
+	c->files[x].clock_level = 0;
+	return 1;
+}
+
 /**
  * umr_check_clock_performance - check power_dpm_force_performance_level via sysfs
  */
 int umr_check_clock_performance(struct umr_asic *asic, char* clockperformance, uint32_t len)
 {
+	char level[256];
 
-	FILE* fp = NULL;
-	char name[256];
-	int ret = 0;
-	snprintf(name, sizeof(name)-1, \
-		"/sys/class/drm/card%d/device/power_dpm_force_performance_level", asic->instance);
-	fp = fopen(name, "r");
-	if (fp) {
-		if (fgets(clockperformance, len-1, fp) == NULL) {
-			asic->err_msg("[ERROR]: Could not read from clock file %s\n", name);
-		} else {
-			ret = strlen(clockperformance);
-		}
-		fclose(fp);
-	} else {
-		ret = 0;
+	if (len < 2)
+		return 0;
+	// as fgets() into len-1 bytes did
+	if (read_performance_level(asic, level, len - 1 < sizeof level ? len - 1 : sizeof level) < 0)
+		return 0;
+	strcpy(clockperformance, level);
+	return strlen(clockperformance);
+}
+
+/**
+ * umr_read_clock_snapshot - Read every clock domain and the performance level
+ *
+ * @asic: The device
+ * @snap: Receives the clocks in UMR_CLOCK_* order and the performance level
+ *        (without the newline)
+ *
+ * Each file is read once (see umr_read_clock()), snap->changed tells which
+ * of them read differently than the last time they were read.
+ *
+ * Returns the number of clock domains read.
+ */
+int umr_read_clock_snapshot(struct umr_asic *asic, struct umr_clock_snapshot *snap)
+{
+	int i, r, n = 0;
+	char *p;
+
+	memset(snap, 0, sizeof *snap);
+	for (i = 0; i < UMR_CLOCK_MAX; i++) {
+		strcpy(snap->clocks[i].clock_name, clock_names[i]);
+		r = read_clock(asic, clock_names[i], &snap->clocks[i]);
+		if (r >= 0)
+			++n;
+		if (r > 0)
+			snap->changed |= 1U << i;
 	}
+	if (read_performance_level(asic, snap->performance_level, sizeof snap->performance_level) > 0)
+		snap->changed |= 1U << UMR_CLOCK_MAX;
+	p = strchr(snap->performance_level, '\n');
+	if (p)
+		*p = 0;
+	return n;
+}
 
-	return ret;
+/**
+ * umr_clock_cache_free - Drop what was parsed from the clock files
+ */
+void umr_clock_cache_free(struct umr_asic *asic)
+{
+	free(asic->clock_cache);
+	asic->clock_cache = NULL;
 }
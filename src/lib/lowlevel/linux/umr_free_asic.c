@@ -29,10 +29,15 @@
  */
 void umr_free_asic(struct umr_asic *asic)
 {
-	if (asic->pci.mem != NULL) {
-		// free PCI mapping
-		pci_device_unmap_range(asic->pci.pdevice, asic->pci.mem, asic->pci.pdevice->regions[asic->pci.region].size);
-		pci_system_cleanup();
-	}
+	if (asic->pci.vram.mem != NULL)
+		pci_device_unmap_range(asic->pci.pdevice, asic->pci.vram.mem, asic->pci.vram.size);
+	umr_pci_unmap_regs(asic);
+	if (asic->pci.pdevice != NULL)
+		umr_pci_system_put();
+	umr_close_ring_handles(asic);
+	umr_sysfs_cache_free(asic);
+	umr_pp_cache_free(asic);
+	umr_clock_cache_free(asic);
+	umr_query_drm_cache_free(asic);
 	umr_free_asic_blocks(asic);
 }
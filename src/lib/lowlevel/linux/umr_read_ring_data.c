@@ -65,7 +65,7 @@ void *umr_read_ring_data(struct umr_asic *asic, char *ringname, uint32_t *ringsi
 			asic->err_msg("[ERROR]: Out of memory\n");
 			return NULL;
 		}
-		r = read(fd, ring_data, *ringsize + 12);
+		r = umr_io_read(asic, UMR_IO_OTHER, fd, ring_data, *ringsize + 12);
 		close(fd);
 		if (r != *ringsize + 12) {
 			free(ring_data);
@@ -73,18 +73,202 @@ void *umr_read_ring_data(struct umr_asic *asic, char *ringname, uint32_t *ringsi
 		}
 
 		// store in test vector if open
-		if (asic->options.test_log && asic->options.test_log_fd) {
-			uint32_t *rd = ring_data, x;
-			fprintf(asic->options.test_log_fd, "RINGDATA = { ");
-			for (x = 0; x < (*ringsize + 12); x += 4) {
-				if (x) {
-					fprintf(asic->options.test_log_fd, ", ");
-				}
-				fprintf(asic->options.test_log_fd, "0x%"PRIx32, rd[x/4]);
-			}
-			fprintf(asic->options.test_log_fd, "}\n");
-		}
+		if (asic->options.test_log && asic->options.test_log_fd)
+			umr_test_log_words(&asic->options, UMR_TV_RINGDATA, 0, ring_data, (*ringsize + 12) / 4, NULL);
 	}
 
 	return ring_data;
 }
+
+/* a debugfs ring file kept open between reads, see umr_read_ring_header(),
+ * fd is -1 while test vectors are used */
+struct umr_ring_handle {
+	char name[64];
+	int fd;
+	uint32_t ringsize;          // in bytes excluding the 12 byte header
+	uint32_t *words, nwords;    // buffer returned by umr_read_ring_window()
+	struct umr_ring_handle *next;
+};
+
+static void close_ring_handle(struct umr_ring_handle *rh)
+{
+	if (rh->fd >= 0)
+		close(rh->fd);
+	umr_huge_free(rh->words);
+	free(rh);
+}
+
+/* the open handle of @ringname, opened on first use */
+static struct umr_ring_handle *get_ring_handle(struct umr_asic *asic, char *ringname)
+{
+	struct umr_ring_handle *rh;
+	char fname[128];
+	off_t size;
+
+	for (rh = asic->ring_handles; rh; rh = rh->next)
+		if (!strcmp(rh->name, ringname))
+			return rh;
+
+	rh = calloc(1, sizeof *rh);
+	if (!rh) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return NULL;
+	}
+	snprintf(rh->name, sizeof rh->name, "%s", ringname);
+	rh->fd = -1;
+	if (asic->options.test_log)
+		goto out;
+
+	snprintf(fname, sizeof(fname)-1, "/sys/kernel/debug/dri/%d/amdgpu_ring_%s", asic->instance, ringname);
+	rh->fd = open(fname, O_RDONLY);
+	if (rh->fd < 0) {
+		asic->err_msg("[ERROR]: Could not open ring debugfs file '%s'\n", fname);
+		if (asic->family >= FAMILY_NV && !strcmp(ringname, "gfx"))
+			asic->err_msg("[WARNING]: On Navi and later ASICs the gfx ring name has changed, for instance: 'gfx_0.0.0'\n");
+		close_ring_handle(rh);
+		return NULL;
+	}
+	size = lseek(rh->fd, 0, SEEK_END);
+	if (size <= 12) {
+		close_ring_handle(rh);
+		return NULL;
+	}
+	rh->ringsize = size - 12;
+out:
+	rh->next = asic->ring_handles;
+	asic->ring_handles = rh;
+	return rh;
+}
+
+/* forget a handle whose reads failed so the next read reopens the file */
+static void drop_ring_handle(struct umr_asic *asic, struct umr_ring_handle *rh)
+{
+	struct umr_ring_handle **p;
+
+	for (p = &asic->ring_handles; *p; p = &(*p)->next) {
+		if (*p == rh) {
+			*p = rh->next;
+			close_ring_handle(rh);
+			return;
+		}
+	}
+}
+
+/**
+ * umr_read_ring_header - Read the pointers of a ring
+ *
+ * @ringname:  Common name for the ring, e.g., 'gfx' or 'comp_1.0.0'
+ * @ptrs:      Receives the read, write and device write pointers
+ * @ringsize:  Receives the size of the ring in bytes (excluding the 12 byte header)
+ *
+ * Only the 12 byte header of the ring is read.  The debugfs file of the
+ * ring is kept open so polling the pointers costs one pread() per call.
+ * As with umr_read_ring_data() the pointers may be unwrapped.
+ *
+ * Returns 0 on success.
+ */
+int umr_read_ring_header(struct umr_asic *asic, char *ringname, uint32_t *ptrs, uint32_t *ringsize)
+{
+	struct umr_ring_handle *rh;
+	uint32_t *ring_data;
+
+	// test vectors store (and replay) whole rings
+	if (asic->options.test_log) {
+		ring_data = umr_read_ring_data(asic, ringname, ringsize);
+		if (!ring_data)
+			return -1;
+		memcpy(ptrs, ring_data, 12);
+		free(ring_data);
+		return 0;
+	}
+
+	rh = get_ring_handle(asic, ringname);
+	if (!rh)
+		return -1;
+	if (umr_io_pread(asic, UMR_IO_OTHER, rh->fd, ptrs, 12, 0) != 12) {
+		drop_ring_handle(asic, rh);
+		return -1;
+	}
+	*ringsize = rh->ringsize;
+	return 0;
+}
+
+/**
+ * umr_read_ring_window - Read a span of words of a ring
+ *
+ * @ringname:  Common name for the ring, e.g., 'gfx' or 'comp_1.0.0'
+ * @start:     First word to read (reduced modulo the ring size)
+ * @stop:      Word to stop at (reduced modulo the ring size), the span
+ *             wraps around the end of the ring if @stop < @start
+ * @nwords:    Receives the number of words read
+ *
+ * Only the words from @start up to @stop are read, typically the
+ * rptr..wptr window found with umr_read_ring_header().
+ *
+ * Returns a buffer owned by the ring handle holding the words in order
+ * which stays valid until the next umr_read_ring_window() of the ring,
+ * or NULL on error.
+ */
+uint32_t *umr_read_ring_window(struct umr_asic *asic, char *ringname, uint32_t start, uint32_t stop, uint32_t *nwords)
+{
+	struct umr_ring_handle *rh;
+	uint32_t size, n, first, *ring_data = NULL;
+
+	rh = get_ring_handle(asic, ringname);
+	if (!rh)
+		return NULL;
+
+	// test vectors store (and replay) whole rings
+	if (rh->fd < 0) {
+		ring_data = umr_read_ring_data(asic, ringname, &rh->ringsize);
+		if (!ring_data)
+			return NULL;
+	}
+
+	size = rh->ringsize / 4;
+	if (!size)
+		goto error;
+	start %= size;
+	stop %= size;
+	n = (stop + size - start) % size;
+
+	if (n > rh->nwords) {
+		umr_huge_free(rh->words);
+		rh->words = umr_huge_alloc(size * sizeof *rh->words);
+		rh->nwords = rh->words ? size : 0;
+		if (!rh->words) {
+			asic->err_msg("[ERROR]: Out of memory\n");
+			goto error;
+		}
+	}
+
+	// up to the end of the ring and then from its start
+	first = n < size - start ? n : size - start;
+	if (ring_data) {
+		memcpy(rh->words, &ring_data[3 + start], first * 4);
+		memcpy(&rh->words[first], &ring_data[3], (n - first) * 4);
+		free(ring_data);
+	} else if (umr_io_pread(asic, UMR_IO_OTHER, rh->fd, rh->words, first * 4, 12 + (off_t)start * 4) != (ssize_t)(first * 4) ||
+		   (n > first && umr_io_pread(asic, UMR_IO_OTHER, rh->fd, &rh->words[first], (n - first) * 4, 12) != (ssize_t)((n - first) * 4))) {
+		drop_ring_handle(asic, rh);
+		return NULL;
+	}
+	*nwords = n;
+	return rh->words;
+error:
+	free(ring_data);
+	return NULL;
+}
+
+/**
+ * umr_close_ring_handles - Close the ring files kept open by umr_read_ring_header()
+ */
+void umr_close_ring_handles(struct umr_asic *asic)
+{
+	struct umr_ring_handle *rh;
+
+	while ((rh = asic->ring_handles)) {
+		asic->ring_handles = rh->next;
+		close_ring_handle(rh);
+	}
+}
@@ -28,56 +28,35 @@
 #include <llvm-c/Disassembler.h>
 #include <llvm-c/Target.h>
 
-/**
- * @brief Disassemble a shader program.
- *
- * This function takes a shader program and disassembles it into human-readable form.
- * The disassembled instructions are stored in an array of strings, which is allocated
- * by this function and must be freed by the caller.
- *
- * @param asic         Pointer to the UMR ASIC structure representing the GPU.
- * @param inst         Pointer to the shader program bytes.
- * @param inst_bytes   Number of bytes in the shader program.
- * @param PC           Shader address in virtual memory.
- * @param disasm_text  Output parameter: array of pointers to disassembled shader instructions.
- *
- * @return             0 on success, -1 on failure (e.g., out of memory).
- */
-int umr_shader_disasm(struct umr_asic *asic,
-		     uint8_t *inst, unsigned inst_bytes,
-		     uint64_t PC,
-		     char ***disasm_text)
-{
-	LLVMDisasmContextRef disasm_ref;
-	unsigned x, z, i;
-	int maj, min;
-	size_t n;
-	char tmp[256], *cpuname, *features;
+// one LLVM disassembler context, a context is only used by one thread at a time
+struct umr_disasm_ctx {
+	LLVMDisasmContextRef ref;
+	const char *features;
+	int in_use;
+	struct umr_disasm_ctx *next;
+};
 
-	if (umr_gfx_get_ip_ver(asic, &maj, &min) < 0 || maj < 8) {
-		// LLVM disassembly not supported for older targets.
-		return 0;
-	}
-
-	*disasm_text = calloc(inst_bytes/4, sizeof(**disasm_text));
-	if (!*disasm_text) {
-		asic->err_msg("[ERROR]: Out of memory\n");
-		return -1;
-	}
+// the contexts of an ASIC, kept until umr_shader_disasm_fini()
+struct umr_disasm_cache {
+	const char *cpuname;
+	struct umr_disasm_ctx *ctxs;
+};
 
-	if (asic->options.no_disasm) {
-		for (x = 0; x < inst_bytes; x += 4) {
-			(*disasm_text)[x/4] = strdup("...");
-		}
-		return 0;
-	}
+static pthread_once_t llvm_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t disasm_lock = PTHREAD_MUTEX_INITIALIZER;
 
-	// initialize LLVM
+static void llvm_init(void)
+{
 	LLVMInitializeAllTargetInfos();
 	LLVMInitializeAllTargetMCs();
 	LLVMInitializeAllDisassemblers();
+}
+
+// cpuname based on mesa usage
+static const char *disasm_cpuname(struct umr_asic *asic)
+{
+	const char *cpuname;
 
-	// cpuname based on mesa usage
 	cpuname = asic->asicname;
 	if (!strcmp(cpuname, "raven1") || !strcmp(cpuname, "picasso"))
 		cpuname = "gfx902";
@@ -135,75 +114,381 @@ int umr_shader_disasm(struct umr_asic *asic,
 			}
 		}
 	}
+	return cpuname;
+}
 
-	// compute features
-	features = "";
-	if (asic->family >= FAMILY_NV && asic->options.wave64)
-		features = "+wavefrontsize64";
+/*
+ * Take an idle context for @features from the cache of @asic or create
+ * one.  Threads that disassemble at the same time each get their own.
+ */
+static struct umr_disasm_ctx *disasm_get(struct umr_asic *asic, const char *features)
+{
+	struct umr_disasm_cache *cache;
+	struct umr_disasm_ctx *ctx;
+	const char *cpuname;
 
-	disasm_ref = LLVMCreateDisasmCPUFeatures(
+	pthread_once(&llvm_once, llvm_init);
+
+	pthread_mutex_lock(&disasm_lock);
+	cache = asic->disasm_cache;
+	if (!cache) {
+		cache = calloc(1, sizeof *cache);
+		if (!cache) {
+			pthread_mutex_unlock(&disasm_lock);
+			return NULL;
+		}
+		cache->cpuname = disasm_cpuname(asic);
+		asic->disasm_cache = cache;
+	}
+	for (ctx = cache->ctxs; ctx; ctx = ctx->next) {
+		if (!ctx->in_use && !strcmp(ctx->features, features)) {
+			ctx->in_use = 1;
+			break;
+		}
+	}
+	cpuname = cache->cpuname;
+	pthread_mutex_unlock(&disasm_lock);
+	if (ctx)
+		return ctx;
+
+	// creating the context is the slow part so it's done unlocked
+	ctx = calloc(1, sizeof *ctx);
+	if (!ctx)
+		return NULL;
+	ctx->ref = LLVMCreateDisasmCPUFeatures(
 			"amdgcn-mesa-mesa3d", cpuname, features, NULL, 0,
 			NULL, NULL);
-
-	if (!disasm_ref) {
-		asic->err_msg("[ERROR]:  Could not create disassembler context\n");
-		free(*disasm_text);
-		return -1;
+	if (!ctx->ref) {
+		free(ctx);
+		return NULL;
 	}
+	ctx->features = features;
+	ctx->in_use = 1;
+
+	pthread_mutex_lock(&disasm_lock);
+	ctx->next = cache->ctxs;
+	cache->ctxs = ctx;
+	pthread_mutex_unlock(&disasm_lock);
+	return ctx;
+}
+
+static void disasm_put(struct umr_disasm_ctx *ctx)
+{
+	pthread_mutex_lock(&disasm_lock);
+	ctx->in_use = 0;
+	pthread_mutex_unlock(&disasm_lock);
+}
+
+/*
+ * Disassemble @inst from @start until an instruction ends at or past @stop.
+ * The lines of @b (and @is_start if not NULL) are indexed by word from
+ * @origin, an instruction that would not fit in @b stops the run.
+ *
+ * Returns the offset the run stopped at.
+ */
+static unsigned disasm_run(struct umr_disasm_ctx *ctx, uint8_t *inst, unsigned inst_bytes, uint64_t PC,
+			   unsigned origin, unsigned start, unsigned stop, struct umr_disasm_builder *b, uint8_t *is_start)
+{
+	unsigned x, z;
+	size_t n;
+	int valid;
+	char tmp[256];
 
-	for (i = x = 0; x < inst_bytes; x += n) {
+	for (x = start; x < stop; x += n) {
 		n = LLVMDisasmInstruction(
-				disasm_ref,
+				ctx->ref,
 				inst + x, inst_bytes - x,
 				PC + x,
 				tmp, sizeof(tmp));
-		if (!n) {
+		valid = n != 0;
+		if (!valid) {
 			// invalid instruction, skip 4 bytes
 			n = 4;
-			(*disasm_text)[i++] = strdup("...");
-		} else {
-			// valid instruction
-
-			// if the instruction is longer than 4 bytes
-			// then add ';;' to all but the first line
-			(*disasm_text)[i++] = strdup(tmp);
+		}
+		if ((x - origin + n) / 4 > b->no_lines)
+			break;
+		if (is_start)
+			is_start[(x - origin) / 4] = 1;
+		if (valid) {
+			// the words after the first of a longer instruction
+			// are marked as its continuation
+			umr_disasm_builder_add(b, (x - origin) / 4, tmp);
 			for (z = 4; z < n; z += 4)
-				(*disasm_text)[i++] = strdup(";;");
+				b->line[(x - origin + z) / 4] = UMR_DISASM_CONT;
 		}
 	}
+	return x;
+}
 
-	LLVMDisasmDispose(disasm_ref);
-	return 0;
+// shaders this large are split over several threads
+#define UMR_DISASM_PARALLEL_BYTES (64 * 1024)
+#define UMR_DISASM_CHUNK_BYTES (16 * 1024)
+#define UMR_DISASM_THREADS 16
+
+struct disasm_chunk {
+	struct umr_asic *asic;
+	const char *features;
+	uint8_t *inst;
+	unsigned inst_bytes;
+	uint64_t PC;
+
+	unsigned start, stop, end;
+	struct umr_disasm_builder b;
+	uint8_t *is_start;
+	pthread_t thread;
+};
+
+static void *disasm_worker(void *arg)
+{
+	struct disasm_chunk *c = arg;
+	struct umr_disasm_ctx *ctx;
+
+	// a chunk that could not be done is left empty, see disasm_parallel()
+	c->end = c->start;
+	ctx = disasm_get(c->asic, c->features);
+	if (!ctx)
+		return NULL;
+	c->end = disasm_run(ctx, c->inst, c->inst_bytes, c->PC, c->start, c->start, c->stop, &c->b, c->is_start);
+	disasm_put(ctx);
+	return NULL;
+}
+
+/*
+ * Each chunk is disassembled from its start as if an instruction began
+ * there and runs a little past the next chunk's start.  The chunks are
+ * then stitched in order: where the previous chunk stopped is normally
+ * an instruction start of the next chunk too, after which both decode the
+ * same.  If it isn't (the chunk started inside an instruction) the text is
+ * decoded one instruction at a time from there until it lines up with
+ * the chunk again.  The result is the same as a serial disassembly.
+ */
+static void disasm_parallel(struct umr_asic *asic, struct umr_disasm_ctx *ctx, const char *features,
+			    uint8_t *inst, unsigned inst_bytes, uint64_t PC, struct umr_disasm_builder *b, int no_chunks)
+{
+	struct disasm_chunk chunks[UMR_DISASM_THREADS], *c;
+	unsigned chunk_bytes, pos, x, limit;
+	uint32_t line;
+	int i, j, started;
+
+	chunk_bytes = (inst_bytes / no_chunks) & ~3U;
+	memset(chunks, 0, sizeof chunks);
+	for (i = 0; i < no_chunks; i++) {
+		c = &chunks[i];
+		c->asic = asic;
+		c->features = features;
+		c->inst = inst;
+		c->inst_bytes = inst_bytes;
+		c->PC = PC;
+		c->start = i * chunk_bytes;
+		c->stop = (i + 1 < no_chunks) ? c->start + chunk_bytes : inst_bytes;
+		// room for the instruction that crosses into the next chunk
+		limit = (c->stop - c->start) / 4 + 16;
+		if (limit > (inst_bytes - c->start) / 4)
+			limit = (inst_bytes - c->start) / 4;
+		c->is_start = calloc(limit, 1);
+		if (!c->is_start || umr_disasm_builder_init(&c->b, limit)) {
+			// the chunks that could not be set up are decoded while stitching
+			free(c->is_start);
+			c->is_start = NULL;
+			no_chunks = i;
+			break;
+		}
+	}
+
+	// the calling thread does the first chunk with its own context
+	for (started = 1; started < no_chunks; started++)
+		if (pthread_create(&chunks[started].thread, NULL, disasm_worker, &chunks[started]))
+			break;
+	if (no_chunks)
+		chunks[0].end = disasm_run(ctx, inst, inst_bytes, PC, 0, 0, chunks[0].stop, &chunks[0].b, chunks[0].is_start);
+	for (i = 1; i < started; i++)
+		pthread_join(chunks[i].thread, NULL);
+	for (i = started; i < no_chunks; i++)
+		chunks[i].end = chunks[i].start;
+
+	for (pos = 0, j = 0; pos < inst_bytes; ) {
+		// the last chunk that starts at or before pos
+		while (j + 1 < no_chunks && chunks[j + 1].start <= pos)
+			++j;
+		c = &chunks[j];
+		if (pos < c->end && !c->b.err && c->is_start[(pos - c->start) / 4]) {
+			for (x = pos; x < c->end; x += 4) {
+				line = c->b.line[(x - c->start) / 4];
+				if (line == UMR_DISASM_CONT || line == UMR_DISASM_INVALID)
+					b->line[x / 4] = line;
+				else
+					umr_disasm_builder_add(b, x / 4, c->b.text + line);
+			}
+			pos = c->end;
+		} else {
+			// resync one instruction at a time
+			pos = disasm_run(ctx, inst, inst_bytes, PC, 0, pos, pos + 1, b, NULL);
+		}
+	}
+
+	for (i = 0; i < no_chunks; i++) {
+		umr_disasm_builder_fini(&chunks[i].b);
+		free(chunks[i].is_start);
+	}
+}
+
+/**
+ * umr_shader_disasm_block - Disassemble a shader program into one allocation
+ *
+ * @asic: The device the shader is for
+ * @inst: The shader program
+ * @inst_bytes: The number of bytes in @inst
+ * @PC: The address of @inst
+ *
+ * LLVM is initialized once and the disassembler contexts are kept in
+ * asic->disasm_cache so later calls reuse them.  The function may be
+ * called from several threads at once.  Shaders of at least
+ * UMR_DISASM_PARALLEL_BYTES are split into chunks that are disassembled
+ * by a pool of threads.
+ *
+ * Returns the disassembly, to be freed with free(), or NULL if the ASIC
+ * is not supported or on error.
+ */
+struct umr_disasm_block *umr_shader_disasm_block(struct umr_asic *asic, uint8_t *inst, unsigned inst_bytes, uint64_t PC)
+{
+	struct umr_disasm_builder b;
+	struct umr_disasm_ctx *ctx;
+	int maj, min, no_chunks;
+	const char *features;
+
+	if (umr_gfx_get_ip_ver(asic, &maj, &min) < 0 || maj < 8) {
+		// LLVM disassembly not supported for older targets.
+		return NULL;
+	}
+
+	if (umr_disasm_builder_init(&b, inst_bytes / 4)) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return NULL;
+	}
+
+	// every line reads "..."
+	if (asic->options.no_disasm)
+		return umr_disasm_builder_finish(&b);
+
+	// compute features
+	features = "";
+	if (asic->family >= FAMILY_NV && asic->options.wave64)
+		features = "+wavefrontsize64";
+
+	ctx = disasm_get(asic, features);
+	if (!ctx) {
+		asic->err_msg("[ERROR]:  Could not create disassembler context\n");
+		umr_disasm_builder_fini(&b);
+		return NULL;
+	}
+
+	no_chunks = 1;
+	if (inst_bytes >= UMR_DISASM_PARALLEL_BYTES) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+		no_chunks = inst_bytes / UMR_DISASM_CHUNK_BYTES;
+		if (no_chunks > UMR_DISASM_THREADS)
+			no_chunks = UMR_DISASM_THREADS;
+		if (cpus > 0 && no_chunks > cpus)
+			no_chunks = cpus;
+	}
+	if (no_chunks > 1)
+		disasm_parallel(asic, ctx, features, inst, inst_bytes, PC, &b, no_chunks);
+	else
+		disasm_run(ctx, inst, inst_bytes, PC, 0, 0, inst_bytes, &b, NULL);
+
+	disasm_put(ctx);
+	if (b.err)
+		asic->err_msg("[ERROR]: Out of memory\n");
+	return umr_disasm_builder_finish(&b);
+}
+
+/**
+ * umr_shader_disasm_fini - Free the disassembler contexts of an ASIC
+ *
+ * @asic: The ASIC to free the contexts of
+ *
+ * No disassembly of @asic may be in progress.
+ */
+void umr_shader_disasm_fini(struct umr_asic *asic)
+{
+	struct umr_disasm_cache *cache = asic->disasm_cache;
+	struct umr_disasm_ctx *ctx;
+
+	if (!cache)
+		return;
+	while (cache->ctxs) {
+		ctx = cache->ctxs;
+		cache->ctxs = ctx->next;
+		LLVMDisasmDispose(ctx->ref);
+		free(ctx);
+	}
+	free(cache);
+	asic->disasm_cache = NULL;
 }
 
 #else
 
 /**
- * umr_shader_disasm - Diassemble a shader
+ * umr_shader_disasm_block - Diassemble a shader
  *
+ * Without LLVM every line reads "...".
+ */
+struct umr_disasm_block *umr_shader_disasm_block(struct umr_asic *asic, uint8_t *inst, unsigned inst_bytes, uint64_t PC)
+{
+	struct umr_disasm_builder b;
+
+	if (umr_disasm_builder_init(&b, inst_bytes / 4)) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return NULL;
+	}
+	return umr_disasm_builder_finish(&b);
+}
+
+/**
+ * umr_shader_disasm_fini - Free the disassembler contexts of an ASIC
+ *
+ * @asic: The ASIC to free the contexts of
+ */
+void umr_shader_disasm_fini(struct umr_asic *asic)
+{
+	(void)asic;
+}
+
+#endif
+
+/**
+ * umr_shader_disasm - Diassemble a shader into an array of strings
+ *
+ * @asic: The device the shader is for
  * @inst:  Shader program
  * @inst_bytes: number of bytes in shader
  * @PC:  Shader address in virtual memory
  * @disasm_text:	array of pointers that are assigned pointers
  *					to disassembled shader.
+ *
+ * The lines of umr_shader_disasm_block() as separate strings, each and the
+ * array itself must be freed with free().  @disasm_text is left alone if
+ * the ASIC is too old to be disassembled.
+ *
+ * Returns 0 on success, -1 on error.
  */
 int umr_shader_disasm(struct umr_asic *asic,
 		     uint8_t *inst, unsigned inst_bytes,
 		     uint64_t PC,
 		     char ***disasm_text)
 {
-	unsigned x;
+	struct umr_disasm_block *b;
+	int maj, min;
 
-	*disasm_text = calloc(inst_bytes/4, sizeof(**disasm_text));
+	b = umr_shader_disasm_block(asic, inst, inst_bytes, PC);
+	if (!b)
+		return (umr_gfx_get_ip_ver(asic, &maj, &min) < 0 || maj < 8) ? 0 : -1;
+	*disasm_text = umr_disasm_block_to_strs(b);
+	free(b);
 	if (!*disasm_text) {
 		asic->err_msg("[ERROR]: Out of memory\n");
 		return -1;
 	}
-
-	for (x = 0; x < inst_bytes; x += 4) {
-		(*disasm_text)[x/4] = strdup("...");
-	}
 	return 0;
 }
-
-#endif
@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+
+#if HAVE_IO_URING
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <linux/io_uring.h>
+#include <errno.h>
+
+#define UMR_URING_ENTRIES 256
+
+struct umr_uring {
+	int fd;
+	unsigned entries;
+	// held from filling the SQ until the last CQE of a submit is
+	// reaped, the access contexts of several threads share the ring
+	pthread_mutex_t lock;
+
+	void *sq_ptr, *cq_ptr;
+	size_t sq_sz, cq_sz, sqes_sz;
+
+	unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+	struct io_uring_sqe *sqes;
+
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_cqe *cqes;
+};
+
+static int uring_setup(unsigned entries, struct io_uring_params *p)
+{
+	return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+	return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static void uring_unmap(struct umr_uring *ring)
+{
+	if (ring->sqes && ring->sqes != MAP_FAILED)
+		munmap(ring->sqes, ring->sqes_sz);
+	if (ring->cq_ptr && ring->cq_ptr != MAP_FAILED && ring->cq_ptr != ring->sq_ptr)
+		munmap(ring->cq_ptr, ring->cq_sz);
+	if (ring->sq_ptr && ring->sq_ptr != MAP_FAILED)
+		munmap(ring->sq_ptr, ring->sq_sz);
+}
+
+/**
+ * umr_uring_init - Create an io_uring instance for an asic
+ *
+ * @asic: The device to attach the ring to
+ *
+ * Returns 0 on success (asic->uring is set), or -1 if io_uring
+ * is not available on this kernel in which case callers should keep
+ * using the regular debugfs access functions.
+ */
+int umr_uring_init(struct umr_asic *asic)
+{
+	struct io_uring_params p;
+	struct umr_uring *ring;
+
+	if (asic->uring)
+		return 0;
+
+	ring = calloc(1, sizeof *ring);
+	if (!ring) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return -1;
+	}
+
+	memset(&p, 0, sizeof p);
+	ring->fd = uring_setup(UMR_URING_ENTRIES, &p);
+	if (ring->fd < 0) {
+		free(ring);
+		return -1;
+	}
+	ring->entries = p.sq_entries;
+
+	ring->sq_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->cq_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_sz > ring->sq_sz)
+			ring->sq_sz = ring->cq_sz;
+		ring->cq_sz = ring->sq_sz;
+	}
+
+	ring->sq_ptr = mmap(NULL, ring->sq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (ring->sq_ptr == MAP_FAILED)
+		goto error;
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		ring->cq_ptr = ring->sq_ptr;
+	} else {
+		ring->cq_ptr = mmap(NULL, ring->cq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+		if (ring->cq_ptr == MAP_FAILED)
+			goto error;
+	}
+
+	ring->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+		goto error;
+
+	ring->sq_head  = (unsigned *)((char *)ring->sq_ptr + p.sq_off.head);
+	ring->sq_tail  = (unsigned *)((char *)ring->sq_ptr + p.sq_off.tail);
+	ring->sq_mask  = (unsigned *)((char *)ring->sq_ptr + p.sq_off.ring_mask);
+	ring->sq_array = (unsigned *)((char *)ring->sq_ptr + p.sq_off.array);
+	ring->cq_head  = (unsigned *)((char *)ring->cq_ptr + p.cq_off.head);
+	ring->cq_tail  = (unsigned *)((char *)ring->cq_ptr + p.cq_off.tail);
+	ring->cq_mask  = (unsigned *)((char *)ring->cq_ptr + p.cq_off.ring_mask);
+	ring->cqes     = (struct io_uring_cqe *)((char *)ring->cq_ptr + p.cq_off.cqes);
+
+	pthread_mutex_init(&ring->lock, NULL);
+	asic->uring = ring;
+	return 0;
+error:
+	uring_unmap(ring);
+	close(ring->fd);
+	free(ring);
+	return -1;
+}
+
+/**
+ * umr_uring_fini - Tear down the io_uring instance of an asic
+ */
+void umr_uring_fini(struct umr_asic *asic)
+{
+	if (asic->uring) {
+		uring_unmap(asic->uring);
+		close(asic->uring->fd);
+		pthread_mutex_destroy(&asic->uring->lock);
+		free(asic->uring);
+		asic->uring = NULL;
+	}
+}
+
+/**
+ * umr_uring_submit - Issue a list of read/write operations
+ *
+ * @asic: The device with an initialized ring
+ * @ops: Array of operations, ops[].res receives the number of bytes
+ *       transferred or a negative errno
+ * @no_ops: Number of operations
+ *
+ * All operations are queued and submitted with a single io_uring_enter()
+ * per ring-full of entries.  Operations that the kernel rejects (e.g. the
+ * file does not support async reads) are retried synchronously.  Runs of
+ * consecutive writes are linked so they are performed in array order,
+ * when one of them fails the kernel cancels the rest of the chain and
+ * those are retried synchronously (in order) as well.  Callers on other
+ * threads wait for the ring while a submit is in flight.
+ *
+ * Returns 0 if every operation transferred its full length, -1 otherwise.
+ */
+int umr_uring_submit(struct umr_asic *asic, struct umr_uring_op *ops, int no_ops)
+{
+	struct umr_uring *ring = asic->uring;
+	struct io_uring_sqe *sqe;
+	struct io_uring_cqe *cqe;
+	unsigned tail, head, idx, n, x, done;
+	uint64_t t;
+	int i, r = 0;
+
+	if (!ring)
+		return -1;
+
+	t = umr_io_now();
+
+	pthread_mutex_lock(&ring->lock);
+	for (i = 0; i < no_ops; i += n) {
+		n = no_ops - i;
+		if (n > ring->entries)
+			n = ring->entries;
+
+		tail = *ring->sq_tail;
+		for (x = 0; x < n; x++) {
+			idx = tail & *ring->sq_mask;
+			sqe = &ring->sqes[idx];
+			memset(sqe, 0, sizeof *sqe);
+			sqe->opcode = ops[i + x].write_en ? IORING_OP_WRITE : IORING_OP_READ;
+			sqe->fd = ops[i + x].fd;
+			sqe->off = ops[i + x].offset;
+			sqe->addr = (uint64_t)(uintptr_t)ops[i + x].buf;
+			sqe->len = ops[i + x].len;
+			sqe->user_data = i + x;
+			ops[i + x].res = -ECANCELED;
+			// writes are chained so they retire in array order
+			if (ops[i + x].write_en && x + 1 < n && ops[i + x + 1].write_en)
+				sqe->flags |= IOSQE_IO_LINK;
+			ring->sq_array[idx] = idx;
+			++tail;
+		}
+		__atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+
+		if (uring_enter(ring->fd, n, n, IORING_ENTER_GETEVENTS) < 0) {
+			asic->err_msg("[ERROR]: io_uring_enter failed (%s)\n", strerror(errno));
+			pthread_mutex_unlock(&ring->lock);
+			return -1;
+		}
+
+		for (done = 0; done < n; ) {
+			head = *ring->cq_head;
+			if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+				// not everything has completed yet
+				if (uring_enter(ring->fd, 0, n - done, IORING_ENTER_GETEVENTS) < 0) {
+					asic->err_msg("[ERROR]: io_uring_enter failed (%s)\n", strerror(errno));
+					pthread_mutex_unlock(&ring->lock);
+					return -1;
+				}
+				continue;
+			}
+			cqe = &ring->cqes[head & *ring->cq_mask];
+			ops[cqe->user_data].res = cqe->res;
+			__atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+			++done;
+		}
+	}
+	pthread_mutex_unlock(&ring->lock);
+
+	// the time of the batch is charged to the class of its first op
+	if (no_ops)
+		umr_io_account(asic, umr_io_class_of_fd(asic, ops[0].fd), UMR_IO_IOCTL, 0, umr_io_now() - t);
+
+	for (i = 0; i < no_ops; i++) {
+		enum umr_io_class cls = umr_io_class_of_fd(asic, ops[i].fd);
+
+		if (ops[i].res == -EINVAL || ops[i].res == -EOPNOTSUPP || ops[i].res == -ECANCELED) {
+			if (ops[i].write_en)
+				ops[i].res = umr_io_pwrite(asic, cls, ops[i].fd, ops[i].buf, ops[i].len, ops[i].offset);
+			else
+				ops[i].res = umr_io_pread(asic, cls, ops[i].fd, ops[i].buf, ops[i].len, ops[i].offset);
+		} else {
+			umr_io_account(asic, cls, ops[i].write_en ? UMR_IO_WRITE : UMR_IO_READ, ops[i].res, 0);
+		}
+		if (ops[i].res != (int)ops[i].len)
+			r = -1;
+	}
+	return r;
+}
+
+#else
+
+int umr_uring_init(struct umr_asic *asic)
+{
+	(void)asic;
+	return -1;
+}
+
+void umr_uring_fini(struct umr_asic *asic)
+{
+	(void)asic;
+}
+
+int umr_uring_submit(struct umr_asic *asic, struct umr_uring_op *ops, int no_ops)
+{
+	(void)asic;
+	(void)ops;
+	(void)no_ops;
+	return -1;
+}
+
+#endif
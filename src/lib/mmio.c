@@ -74,15 +74,10 @@ uint64_t umr_read_reg_by_name_by_ip_by_instance(struct umr_asic *asic, char *ip,
 {
 	struct umr_reg *reg;
 	reg = umr_find_reg_data_by_ip_by_instance(asic, ip, inst, name);
-	if (reg) {
-		if (reg->bit64)
-			return ((uint64_t)asic->reg_funcs.read_reg(asic, reg->addr * (reg->type == REG_MMIO ? 4 : 1), reg->type)) |
-			((uint64_t)asic->reg_funcs.read_reg(asic, (reg->addr + 1) * (reg->type == REG_MMIO ? 4 : 1), reg->type) << 32);
-		else
-			return asic->reg_funcs.read_reg(asic, reg->addr * (reg->type == REG_MMIO ? 4 : 1), reg->type);
-	} else {
+	if (reg)
+		return umr_read_reg_by_reg(asic, reg);
+	else
 		return 0;
-	}
 }
 
 /**
@@ -120,21 +115,63 @@ int umr_write_reg_by_name_by_ip(struct umr_asic *asic, char *ip, char *name, uin
 int umr_write_reg_by_name_by_ip_by_instance(struct umr_asic *asic, char *ip, int inst, char *name, uint64_t value)
 {
 	struct umr_reg *reg;
-	int r;
 
 	reg = umr_find_reg_data_by_ip_by_instance(asic, ip, inst, name);
-	if (reg) {
-		if (reg->bit64) {
-			r = asic->reg_funcs.write_reg(asic, reg->addr * (reg->type == REG_MMIO ? 4 : 1), value & 0xFFFFFFFFUL, reg->type);
-			if (!r)
-				return asic->reg_funcs.write_reg(asic, (reg->addr + 1) * (reg->type == REG_MMIO ? 4 : 1), value >> 32, reg->type);
-			return r;
-		} else {
-			return asic->reg_funcs.write_reg(asic, reg->addr * (reg->type == REG_MMIO ? 4 : 1), value, reg->type);
-		}
-	} else {
+	if (reg)
+		return umr_write_reg_by_reg(asic, reg, value);
+	else
 		return -1;
-	}
+}
+
+/**
+ * umr_read_reg_by_reg - Read a register given its register data
+ *
+ * 64-bit registers are read with the read_reg64 callback when the
+ * backend provides one so both halves come from a single access,
+ * otherwise the LO and HI halves are read separately.  The HI half is
+ * the next dword, 4 bytes on in the byte addressed SMC, PCIE and DIDT
+ * spaces.
+ *
+ * @param asic Pointer to the ASIC structure.
+ * @param reg The register to read.
+ * @return The value of the register.
+ */
+uint64_t umr_read_reg_by_reg(struct umr_asic *asic, struct umr_reg *reg)
+{
+	uint64_t scale = reg->type == REG_MMIO ? 4 : 1;
+
+	if (!reg->bit64)
+		return asic->reg_funcs.read_reg(asic, reg->addr * scale, reg->type);
+	if (asic->reg_funcs.read_reg64)
+		return asic->reg_funcs.read_reg64(asic, reg->addr * scale, reg->type);
+	return ((uint64_t)asic->reg_funcs.read_reg(asic, reg->addr * scale, reg->type)) |
+	       ((uint64_t)asic->reg_funcs.read_reg(asic, reg->addr * scale + 4, reg->type) << 32);
+}
+
+/**
+ * umr_write_reg_by_reg - Write a register given its register data
+ *
+ * Counterpart of umr_read_reg_by_reg(), the LO half of a 64-bit
+ * register is written first when the halves are written separately.
+ *
+ * @param asic Pointer to the ASIC structure.
+ * @param reg The register to write.
+ * @param value Value to write to the register.
+ * @return 0 on success, non-zero on failure.
+ */
+int umr_write_reg_by_reg(struct umr_asic *asic, struct umr_reg *reg, uint64_t value)
+{
+	uint64_t scale = reg->type == REG_MMIO ? 4 : 1;
+	int r;
+
+	if (!reg->bit64)
+		return asic->reg_funcs.write_reg(asic, reg->addr * scale, value, reg->type);
+	if (asic->reg_funcs.write_reg64)
+		return asic->reg_funcs.write_reg64(asic, reg->addr * scale, value, reg->type);
+	r = asic->reg_funcs.write_reg(asic, reg->addr * scale, value & 0xFFFFFFFFUL, reg->type);
+	if (!r)
+		return asic->reg_funcs.write_reg(asic, reg->addr * scale + 4, value >> 32, reg->type);
+	return r;
 }
 
 /**
@@ -154,6 +191,16 @@ int umr_write_reg_by_name(struct umr_asic *asic, char *name, uint64_t value)
 	return umr_write_reg_by_name_by_ip(asic, NULL, name, value);
 }
 
+static struct umr_bitfield *find_bitfield(struct umr_reg *reg, const char *bitname)
+{
+	int i;
+
+	for (i = 0; i < reg->no_bits; i++)
+		if (!strcmp(bitname, reg->bits[i].regname))
+			return &reg->bits[i];
+	return NULL;
+}
+
 /**
  * umr_bitslice_reg_quiet - Slice a register value by a bitfield (quiet version)
  *
@@ -171,15 +218,11 @@ int umr_write_reg_by_name(struct umr_asic *asic, char *name, uint64_t value)
  */
 uint64_t umr_bitslice_reg_quiet(struct umr_asic *asic, struct umr_reg *reg, char *bitname, uint64_t regvalue)
 {
-	int i;
+	struct umr_bitfield *bf = find_bitfield(reg, bitname);
+
 	(void)asic;
-	for (i = 0; i < reg->no_bits; i++) {
-		if (!strcmp(bitname, reg->bits[i].regname)) {
-			regvalue >>= reg->bits[i].start;
-			regvalue &= (1ULL << (reg->bits[i].stop - reg->bits[i].start + 1)) - 1;
-			return regvalue;
-		}
-	}
+	if (bf)
+		return (regvalue >> bf->start) & umr_bitfield_mask(bf);
 	return 0xFFFFFFFFULL;
 }
 
@@ -197,14 +240,10 @@ uint64_t umr_bitslice_reg_quiet(struct umr_asic *asic, struct umr_reg *reg, char
  */
 uint64_t umr_bitslice_reg(struct umr_asic *asic, struct umr_reg *reg, char *bitname, uint64_t regvalue)
 {
-	int i;
-	for (i = 0; i < reg->no_bits; i++) {
-		if (!strcmp(bitname, reg->bits[i].regname)) {
-			regvalue >>= reg->bits[i].start;
-			regvalue &= (1ULL << (reg->bits[i].stop - reg->bits[i].start + 1)) - 1;
-			return regvalue;
-		}
-	}
+	struct umr_bitfield *bf = find_bitfield(reg, bitname);
+
+	if (bf)
+		return (regvalue >> bf->start) & umr_bitfield_mask(bf);
 	asic->err_msg("[BUG]: Bitfield [%s] not found in reg [%s] on asic [%s]\n", bitname, reg->regname, asic->asicname);
 	return 0;
 }
@@ -224,18 +263,34 @@ uint64_t umr_bitslice_reg(struct umr_asic *asic, struct umr_reg *reg, char *bitn
  */
 uint64_t umr_bitslice_compose_value(struct umr_asic *asic, struct umr_reg *reg, char *bitname, uint64_t regvalue)
 {
-	int i;
-	for (i = 0; i < reg->no_bits; i++) {
-		if (!strcmp(bitname, reg->bits[i].regname)) {
-			regvalue &= (1ULL << (reg->bits[i].stop - reg->bits[i].start + 1)) - 1;
-			regvalue <<= reg->bits[i].start;
-			return regvalue;
-		}
-	}
+	struct umr_bitfield *bf = find_bitfield(reg, bitname);
+
+	if (bf)
+		return (regvalue & umr_bitfield_mask(bf)) << bf->start;
 	asic->err_msg("[BUG]: Bitfield [%s] not found in reg [%s] on asic [%s]\n", bitname, reg->regname, asic->asicname);
 	return 0;
 }
 
+/**
+ * umr_bitslice_all - Slice a register value into all of its bitfields
+ *
+ * Decodes every bitfield of @reg in one pass instead of looking each one
+ * up by name, out[i] receives the value of reg->bits[i].
+ *
+ * @param reg Pointer to the register structure.
+ * @param regvalue The entire value of the register.
+ * @param out Array of at least reg->no_bits values.
+ * @return The number of bitfields decoded (reg->no_bits).
+ */
+int umr_bitslice_all(struct umr_reg *reg, uint64_t regvalue, uint64_t *out)
+{
+	int i;
+
+	for (i = 0; i < reg->no_bits; i++)
+		out[i] = (regvalue >> reg->bits[i].start) & umr_bitfield_mask(&reg->bits[i]);
+	return reg->no_bits;
+}
+
 /**
  * umr_bitslice_reg_by_name_by_ip - Slice out a bitfield by IP and register name
  *
@@ -368,6 +423,73 @@ uint64_t umr_bitslice_compose_value_by_name(struct umr_asic *asic, char *regname
 	return umr_bitslice_compose_value_by_name_by_ip(asic, NULL, regname, bitname, regvalue);
 }
 
+/**
+ * umr_reg_handle_resolve - Resolve a register by name once
+ *
+ * @param asic Pointer to the ASIC structure.
+ * @param ip Name of the IP block or NULL for any IP block.
+ * @param inst Instance number of the IP block (or -1 for none).
+ * @param regname Name of the register.
+ * @param h Handle to fill in.
+ * @return 0 on success, -1 if the register was not found.
+ */
+int umr_reg_handle_resolve(struct umr_asic *asic, const char *ip, int inst, const char *regname, struct umr_reg_handle *h)
+{
+	memset(h, 0, sizeof *h);
+	h->reg = umr_find_reg_data_by_ip_by_instance_with_ip(asic, ip, inst, regname, &h->ip);
+	if (!h->reg)
+		return -1;
+	h->addr = h->reg->addr * (h->reg->type == REG_MMIO ? 4 : 1);
+	return 0;
+}
+
+/**
+ * umr_field_handle_resolve - Resolve a bitfield of a register once
+ *
+ * The handle can then be used with umr_field_get() and umr_field_compose()
+ * which are simple shift and mask operations.
+ *
+ * @param asic Pointer to the ASIC structure.
+ * @param reg Pointer to the register structure.
+ * @param bitname Name of the bitfield.
+ * @param fh Handle to fill in.
+ * @return 0 on success, -1 if the bitfield was not found (an error is logged).
+ */
+int umr_field_handle_resolve(struct umr_asic *asic, struct umr_reg *reg, const char *bitname, struct umr_field_handle *fh)
+{
+	struct umr_bitfield *bf = find_bitfield(reg, bitname);
+
+	memset(fh, 0, sizeof *fh);
+	if (bf) {
+		fh->reg = reg;
+		fh->shift = bf->start;
+		fh->mask = umr_bitfield_mask(bf);
+		return 0;
+	}
+	asic->err_msg("[BUG]: Bitfield [%s] not found in reg [%s] on asic [%s]\n", bitname, reg->regname, asic->asicname);
+	return -1;
+}
+
+/**
+ * umr_reg_handle_read - Read a register through a resolved handle
+ *
+ * @param asic Pointer to the ASIC structure.
+ * @param h The resolved register handle.
+ * @return The value of the register (both halves for 64-bit registers).
+ */
+uint64_t umr_reg_handle_read(struct umr_asic *asic, const struct umr_reg_handle *h)
+{
+	uint64_t value;
+
+	if (h->reg->bit64 && asic->reg_funcs.read_reg64)
+		return asic->reg_funcs.read_reg64(asic, h->addr, h->reg->type);
+
+	value = asic->reg_funcs.read_reg(asic, h->addr, h->reg->type);
+	if (h->reg->bit64)
+		value |= (uint64_t)asic->reg_funcs.read_reg(asic, h->addr + 4, h->reg->type) << 32;
+	return value;
+}
+
 /**
  * @brief Select a GRBM instance
  *
@@ -3248,6 +3248,119 @@ uint32_t umr_mqd_decode_rows(enum umr_mqd_engine_sel eng, enum chipfamily fam)
 	return 0;
 }
 
+/**
+ * umr_mqd_fields_table - The field table of an MQD
+ *
+ * @eng: The engine the MQD belongs to
+ * @fam: The ASIC generation the engine belongs to
+ * @rows: [out] The number of fields in the table
+ *
+ * The table is static and ordered by row, a row number names the same
+ * field for every MQD of @eng and @fam.  Returns NULL if there is none.
+ */
+const struct umr_mqd_fields *umr_mqd_fields_table(enum umr_mqd_engine_sel eng, enum chipfamily fam, uint32_t *rows)
+{
+	uint32_t x, y;
+
+	for (x = 0; fields[x].fields != NULL; x++) {
+		if (eng == fields[x].eng && fam >= fields[x].family) {
+			for (y = 0; fields[x].fields[y].label; y++);
+			*rows = y;
+			return fields[x].fields;
+		}
+	}
+	*rows = 0;
+	return NULL;
+}
+
+/**
+ * umr_mqd_filter_init - Select the fields of an MQD to iterate over
+ *
+ * @f: The filter to initialize, release with umr_mqd_filter_free()
+ * @eng: The engine the MQDs belong to
+ * @fam: The ASIC generation the engine belongs to
+ * @match: Which fields to select (or * for all), partial match on the label
+ *
+ * The labels are matched once here so the filter can be applied to any
+ * number of MQDs without looking at the labels again.
+ *
+ * Returns 0 on success, -1 if there is no table for @eng and @fam.
+ */
+int umr_mqd_filter_init(struct umr_mqd_filter *f, enum umr_mqd_engine_sel eng, enum chipfamily fam, const char *match)
+{
+	uint32_t x;
+
+	memset(f, 0, sizeof *f);
+	f->table = umr_mqd_fields_table(eng, fam, &f->rows);
+	if (!f->table)
+		return -1;
+	if (match && match[0] != '*') {
+		f->sel = calloc((f->rows + 7) / 8, 1);
+		if (!f->sel)
+			return -1;
+		for (x = 0; x < f->rows; x++)
+			if (strstr(f->table[x].label, match))
+				f->sel[x / 8] |= 1 << (x % 8);
+	}
+	return 0;
+}
+
+void umr_mqd_filter_free(struct umr_mqd_filter *f)
+{
+	free(f->sel);
+	f->sel = NULL;
+}
+
+/**
+ * umr_mqd_field_next - The next selected field of an MQD
+ *
+ * @f: The filter from umr_mqd_filter_init()
+ * @data: The MQD dwords
+ * @nwords: The number of words in @data, fields past it are skipped
+ * @prev: An older copy of the MQD to diff against or NULL
+ * @row: The row to continue from, start with 0
+ * @field: [out] The field found
+ *
+ * With @prev only the fields whose value differs are returned.  The
+ * label points into the static tables so nothing is allocated.
+ *
+ * Returns 1 if a field was found, 0 at the end of the table.
+ */
+int umr_mqd_field_next(const struct umr_mqd_filter *f, const uint32_t *data, uint32_t nwords, const uint32_t *prev, uint32_t *row, struct umr_mqd_field *field)
+{
+	const struct umr_mqd_fields *m;
+	uint32_t x;
+
+	for (x = *row; x < f->rows; x++) {
+		m = &f->table[x];
+		if (f->sel && !(f->sel[x / 8] & (1 << (x % 8))))
+			continue;
+		if (m->offset >= nwords)
+			continue;
+		if (prev && prev[m->offset] == data[m->offset])
+			continue;
+		field->row = x;
+		field->offset = m->offset;
+		field->label = m->label;
+		field->value = data[m->offset];
+		field->prev_value = prev ? prev[m->offset] : 0;
+		*row = x + 1;
+		return 1;
+	}
+	*row = f->rows;
+	return 0;
+}
+
+/**
+ * umr_mqd_field_format - Format a field as umr_mqd_decode_data() does
+ *
+ * Returns the length of the text as snprintf() does.
+ */
+int umr_mqd_field_format(const struct umr_mqd_field *field, char *buf, size_t size)
+{
+	return snprintf(buf, size, "MQD[%03"PRIu32"] == 0x%08"PRIx32" (%s)", field->offset, field->value, field->label);
+}
+
 /**
  * umr_mqd_decode_data - Decode an MQD packet into text
  *
@@ -3257,31 +3370,25 @@ uint32_t umr_mqd_decode_rows(enum umr_mqd_engine_sel eng, enum chipfamily fam)
  * @match: Which fields to return (or * for all) will partial match.
  *
  * Returns NULL on error, otherwise a pointer to an array of char pointers that can be freed with free() each.
+ * Callers that only print the fields should use umr_mqd_field_next() which allocates nothing.
  */
 char **umr_mqd_decode_data(enum umr_mqd_engine_sel eng, enum chipfamily fam, uint32_t *data, char *match)
 {
-	const struct umr_mqd_fields *m;
-	uint32_t x, y, z;
+	struct umr_mqd_filter f;
+	struct umr_mqd_field field;
+	uint32_t row = 0, z = 0;
 	char **txt;
 	char buf[256];
-	
-	y = umr_mqd_decode_rows(eng, fam);
-	if (!y) {
+
+	if (umr_mqd_filter_init(&f, eng, fam, match) || !f.rows) {
+		umr_mqd_filter_free(&f);
 		return NULL;
 	}
-	txt = calloc(y + 1, sizeof(*txt));
-	for (x = 0; fields[x].fields != NULL; x++) {
-		if (eng == fields[x].eng && fam >= fields[x].family) {
-			m = fields[x].fields;
-			for (y = z = 0; m[y].label; y++) {
-				if (match[0] == '*' || strstr(m[y].label, match)) {
-					sprintf(buf, "MQD[%03"PRIu32"] == 0x%08"PRIx32" (%s)", m[y].offset, data[m[y].offset], m[y].label);
-					txt[z++] = strdup(buf);
-				}
-			}
-			return txt;
-		}
+	txt = calloc(f.rows + 1, sizeof(*txt));
+	while (txt && umr_mqd_field_next(&f, data, UMR_MAX_MQD_SIZE, NULL, &row, &field)) {
+		umr_mqd_field_format(&field, buf, sizeof buf);
+		txt[z++] = strdup(buf);
 	}
-	free(txt);
-	return NULL;
+	umr_mqd_filter_free(&f);
+	return txt;
 }
@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#define _GNU_SOURCE
+#include "umr.h"
+#include <errno.h>
+
+/*
+ * The printers (waves, rings, register dumps, ...) write their text to a
+ * stdio stream with a large buffer instead of stdout.  When the buffer is
+ * full it is handed to a writer thread which writes it while the printer
+ * fills the buffer again, so a big dump redirected to a file or a pipe
+ * costs a few large writes instead of one (or more) per line.
+ *
+ * Text printed with printf() is not ordered with the stream so a printer
+ * opens a section with umr_output_begin() (which flushes stdout) and
+ * closes it with umr_output_end() (which writes out everything it
+ * printed) around its output.
+ *
+ * A thread can send what the printers it calls write to a stream of its
+ * own with umr_output_redirect(), e.g. the workers of umr_xcc_run() each
+ * collect the output of one XCC.
+ */
+// the stream of the calling thread, see umr_output_redirect()
+static __thread FILE *thread_stream;
+
+struct umr_output {
+	FILE *f;
+	int fd, threaded, depth, error;
+
+	pthread_t writer;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int stop;
+
+	// the chunk being written by the writer thread
+	char *pending;
+	size_t pending_len, pending_size;
+};
+
+static int write_all(int fd, const char *buf, size_t size)
+{
+	ssize_t r;
+
+	while (size) {
+		r = write(fd, buf, size);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			return -1;
+		buf += r;
+		size -= r;
+	}
+	return 0;
+}
+
+static void *output_writer(void *arg)
+{
+	struct umr_output *out = arg;
+	int r;
+
+	pthread_mutex_lock(&out->lock);
+	for (;;) {
+		while (!out->pending_len && !out->stop)
+			pthread_cond_wait(&out->cond, &out->lock);
+		if (!out->pending_len)
+			break;
+		pthread_mutex_unlock(&out->lock);
+		// nobody touches the chunk until pending_len is cleared
+		r = write_all(out->fd, out->pending, out->pending_len) ? (errno ? errno : EIO) : 0;
+		pthread_mutex_lock(&out->lock);
+		if (r)
+			out->error = r;
+		out->pending_len = 0;
+		pthread_cond_broadcast(&out->cond);
+	}
+	pthread_mutex_unlock(&out->lock);
+	return NULL;
+}
+
+static ssize_t output_write(void *cookie, const char *buf, size_t size)
+{
+	struct umr_output *out = cookie;
+	char *p;
+
+	if (!out->threaded) {
+		if (write_all(out->fd, buf, size))
+			return -1;
+		return size;
+	}
+
+	pthread_mutex_lock(&out->lock);
+	while (out->pending_len)
+		pthread_cond_wait(&out->cond, &out->lock);
+	if (out->error) {
+		errno = out->error;
+		pthread_mutex_unlock(&out->lock);
+		return -1;
+	}
+	if (size > out->pending_size) {
+		p = realloc(out->pending, size);
+		if (!p) {
+			pthread_mutex_unlock(&out->lock);
+			return -1;
+		}
+		out->pending = p;
+		out->pending_size = size;
+	}
+	memcpy(out->pending, buf, size);
+	out->pending_len = size;
+	pthread_cond_broadcast(&out->cond);
+	pthread_mutex_unlock(&out->lock);
+	return size;
+}
+
+// wait until the writer thread is idle
+static void output_drain(struct umr_output *out)
+{
+	if (!out->threaded)
+		return;
+	pthread_mutex_lock(&out->lock);
+	while (out->pending_len)
+		pthread_cond_wait(&out->cond, &out->lock);
+	pthread_mutex_unlock(&out->lock);
+}
+
+/**
+ * umr_output_open - Open a buffered output sink
+ *
+ * @fd: The file descriptor written to (it is not closed with the sink)
+ * @size: The size of the buffer, e.g. 1MB
+ * @threaded: Whether full buffers are written by a background thread
+ *
+ * Store the sink in options.output so the printers use it.
+ *
+ * Returns NULL on error.
+ */
+struct umr_output *umr_output_open(int fd, size_t size, int threaded)
+{
+	cookie_io_functions_t io = { NULL, output_write, NULL, NULL };
+	struct umr_output *out;
+
+	out = calloc(1, sizeof *out);
+	if (!out)
+		return NULL;
+	out->fd = fd;
+	out->threaded = threaded;
+	pthread_mutex_init(&out->lock, NULL);
+	pthread_cond_init(&out->cond, NULL);
+
+	out->f = fopencookie(out, "w", io);
+	if (!out->f || setvbuf(out->f, NULL, _IOFBF, size))
+		goto error;
+	if (threaded && pthread_create(&out->writer, NULL, output_writer, out))
+		goto error;
+	return out;
+error:
+	if (out->f)
+		fclose(out->f);
+	pthread_cond_destroy(&out->cond);
+	pthread_mutex_destroy(&out->lock);
+	free(out);
+	return NULL;
+}
+
+/**
+ * umr_output_flush - Write out everything printed to a sink
+ *
+ * Returns once the text has been written to the file descriptor.
+ */
+void umr_output_flush(struct umr_output *out)
+{
+	if (!out)
+		return;
+	fflush(out->f);
+	output_drain(out);
+}
+
+/**
+ * umr_output_close - Flush a sink and free it
+ */
+void umr_output_close(struct umr_output *out)
+{
+	if (!out)
+		return;
+	umr_output_flush(out);
+	if (out->threaded) {
+		pthread_mutex_lock(&out->lock);
+		out->stop = 1;
+		pthread_cond_broadcast(&out->cond);
+		pthread_mutex_unlock(&out->lock);
+		pthread_join(out->writer, NULL);
+	}
+	fclose(out->f);
+	free(out->pending);
+	pthread_cond_destroy(&out->cond);
+	pthread_mutex_destroy(&out->lock);
+	free(out);
+}
+
+/**
+ * umr_output_begin - Start printing to the sink of a device
+ *
+ * @asic: The device, its sink is asic->options.output
+ *
+ * Sections nest, only the outermost one flushes stdout on entry and the
+ * sink when it ends (see umr_output_end()).
+ *
+ * Returns the stream to print to, stdout if there is no sink.
+ */
+FILE *umr_output_begin(struct umr_asic *asic)
+{
+	struct umr_output *out = asic->options.output;
+
+	if (thread_stream)
+		return thread_stream;
+	if (!out)
+		return stdout;
+	if (!out->depth++)
+		fflush(stdout);
+	return out->f;
+}
+
+/**
+ * umr_output_stream - The stream printers of a device write to
+ *
+ * Returns the sink's stream inside a umr_output_begin() section and
+ * stdout otherwise, for helpers (like the bitfield printers) that are
+ * called from printers with and without a section.
+ */
+FILE *umr_output_stream(struct umr_asic *asic)
+{
+	struct umr_output *out = asic->options.output;
+
+	if (thread_stream)
+		return thread_stream;
+	return (out && out->depth) ? out->f : stdout;
+}
+
+/**
+ * umr_output_end - End a section started with umr_output_begin()
+ */
+void umr_output_end(struct umr_asic *asic)
+{
+	struct umr_output *out = asic->options.output;
+
+	if (thread_stream)
+		return;
+	if (out && out->depth && !--out->depth)
+		umr_output_flush(out);
+}
+
+/**
+ * umr_output_redirect - Send the printers of the calling thread to a stream
+ *
+ * @f: The stream, or NULL to go back to the sink (or stdout)
+ *
+ * Sections started on the thread return @f and end without flushing it.
+ *
+ * Returns the previous stream of the thread so callers can nest.
+ */
+FILE *umr_output_redirect(FILE *f)
+{
+	FILE *prev = thread_stream;
+
+	thread_stream = f;
+	return prev;
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include <umr.h>
+
+/**
+ * Scans of DWORD buffers for the packet decoders and the shader size
+ * estimator.  They compare a vector of words per step where the compiler
+ * targets AVX2, SSE2 or AArch64 NEON and fall back to a plain loop
+ * otherwise, the result is the same either way.
+ */
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SCAN_WIDTH 8
+typedef __m256i scan_vec;
+#define scan_load(p)     _mm256_loadu_si256((const __m256i *)(p))
+#define scan_set1(v)     _mm256_set1_epi32((int)(v))
+#define scan_eq(a, b)    _mm256_cmpeq_epi32((a), (b))
+#define scan_or(a, b)    _mm256_or_si256((a), (b))
+#define scan_mask(a)     ((uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(a)))
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SCAN_WIDTH 4
+typedef __m128i scan_vec;
+#define scan_load(p)     _mm_loadu_si128((const __m128i *)(p))
+#define scan_set1(v)     _mm_set1_epi32((int)(v))
+#define scan_eq(a, b)    _mm_cmpeq_epi32((a), (b))
+#define scan_or(a, b)    _mm_or_si128((a), (b))
+#define scan_mask(a)     ((uint32_t)_mm_movemask_ps(_mm_castsi128_ps(a)))
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define SCAN_WIDTH 4
+typedef uint32x4_t scan_vec;
+#define scan_load(p)     vld1q_u32(p)
+#define scan_set1(v)     vdupq_n_u32(v)
+#define scan_eq(a, b)    vceqq_u32((a), (b))
+#define scan_or(a, b)    vorrq_u32((a), (b))
+static inline uint32_t scan_mask(uint32x4_t a)
+{
+	static const uint32_t bits[4] = { 1, 2, 4, 8 };
+	return vaddvq_u32(vandq_u32(a, vld1q_u32(bits)));
+}
+#endif
+
+#ifdef SCAN_WIDTH
+#define SCAN_FULL ((1U << SCAN_WIDTH) - 1)
+#endif
+
+/**
+ * umr_dword_find - Find the first word of a buffer that matches any of a set of values
+ * @buf: The words to search
+ * @nwords: How many words are in @buf
+ * @values: The values to look for
+ * @no_values: How many values are in @values
+ *
+ * Returns the index of the first match or @nwords if there is none.
+ */
+uint32_t umr_dword_find(const uint32_t *buf, uint32_t nwords, const uint32_t *values, int no_values)
+{
+	uint32_t x = 0;
+	int y;
+
+#ifdef SCAN_WIDTH
+	if (no_values > 0 && no_values <= UMR_DWORD_FIND_MAX) {
+		scan_vec v[UMR_DWORD_FIND_MAX], w, m;
+		uint32_t bits;
+
+		for (y = 0; y < no_values; y++)
+			v[y] = scan_set1(values[y]);
+		for (; nwords - x >= SCAN_WIDTH; x += SCAN_WIDTH) {
+			w = scan_load(&buf[x]);
+			m = scan_eq(w, v[0]);
+			for (y = 1; y < no_values; y++)
+				m = scan_or(m, scan_eq(w, v[y]));
+			bits = scan_mask(m);
+			if (bits)
+				return x + __builtin_ctz(bits);
+		}
+	}
+#endif
+	for (; x < nwords; x++)
+		for (y = 0; y < no_values; y++)
+			if (buf[x] == values[y])
+				return x;
+	return nwords;
+}
+
+/**
+ * umr_dword_span - Count how many words at the start of a buffer equal a value
+ * @buf: The words to search
+ * @nwords: How many words are in @buf
+ * @value: The value of the run
+ *
+ * Returns the length of the run, @nwords if every word equals @value.
+ */
+uint32_t umr_dword_span(const uint32_t *buf, uint32_t nwords, uint32_t value)
+{
+	uint32_t x = 0;
+
+#ifdef SCAN_WIDTH
+	{
+		scan_vec v = scan_set1(value);
+		uint32_t bits;
+
+		for (; nwords - x >= SCAN_WIDTH; x += SCAN_WIDTH) {
+			bits = scan_mask(scan_eq(scan_load(&buf[x]), v));
+			if (bits != SCAN_FULL)
+				return x + __builtin_ctz(~bits);
+		}
+	}
+#endif
+	for (; x < nwords && buf[x] == value; x++);
+	return x;
+}
+
+/**
+ * umr_dword_count - Count the words of a buffer that equal a value
+ * @buf: The words to search
+ * @nwords: How many words are in @buf
+ * @value: The value to count
+ *
+ * Returns how many words of @buf equal @value.
+ */
+uint32_t umr_dword_count(const uint32_t *buf, uint32_t nwords, uint32_t value)
+{
+	uint32_t x = 0, n = 0;
+
+#ifdef SCAN_WIDTH
+	{
+		scan_vec v = scan_set1(value);
+
+		for (; nwords - x >= SCAN_WIDTH; x += SCAN_WIDTH)
+			n += __builtin_popcount(scan_mask(scan_eq(scan_load(&buf[x]), v)));
+	}
+#endif
+	for (; x < nwords; x++)
+		n += (buf[x] == value);
+	return n;
+}
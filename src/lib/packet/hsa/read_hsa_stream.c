@@ -56,7 +56,7 @@ static void add_shader(struct umr_asic *asic,
 
 	if (ps->shader == NULL) {
 		// attach the shader to the head
-		ps->shader = calloc(1, sizeof(ps->shader[0]));
+		ps->shader = umr_packet_alloc(asic, sizeof(ps->shader[0]));
 		pgm = ps->shader;
 	} else {
 		// walk till the end of the list
@@ -64,7 +64,7 @@ static void add_shader(struct umr_asic *asic,
 		while (pgm->next) {
 			pgm = pgm->next;
 		}
-		pgm->next = calloc(1, sizeof(ps->shader[0]));
+		pgm->next = umr_packet_alloc(asic, sizeof(ps->shader[0]));
 		pgm = pgm->next;
 	}
 
@@ -72,11 +72,11 @@ static void add_shader(struct umr_asic *asic,
 	pgm->vmid = vmid;
 	pgm->addr = shader_addr;
 	if (!asic->options.no_follow_shader)
-		pgm->size = umr_compute_shader_size(asic, vm_partition, pgm);
+		pgm->size = umr_packet_shader_size(asic, vm_partition, pgm);
 	else
 		pgm->size = 1;
 	pgm->type = type;
-	pgm->regs = umr_copy_regpairs(reg_pairs);
+	pgm->regs = umr_copy_regpairs(asic, reg_pairs);
 }
 
 static void parse_kernel_object(struct umr_asic *asic, struct umr_hsa_stream *stream, uint64_t kernel_object, uint64_t kernarg)
@@ -134,7 +134,7 @@ static void parse_kernel_object(struct umr_asic *asic, struct umr_hsa_stream *st
 	umr_free_shader_reg_pairs(reg_pair);
 
 	// copy the kernarg
-	stream->kernel_dispatch.kernarg_data = calloc(1, stream->kernel_dispatch.kernarg_size);
+	stream->kernel_dispatch.kernarg_data = umr_packet_alloc(asic, stream->kernel_dispatch.kernarg_size);
 	if (stream->kernel_dispatch.kernarg_data) {
 		if (umr_read_vram(asic, asic->options.vm_partition, 0,
 				stream->kernel_dispatch.kernarg_va, stream->kernel_dispatch.kernarg_size,
@@ -161,7 +161,7 @@ struct umr_hsa_stream *umr_hsa_decode_stream(struct umr_asic *asic, uint32_t *st
 	uint16_t t16, *s;
 	(void)ip_version;
 
-	oms = ms = calloc(1, sizeof *ms);
+	oms = ms = umr_packet_alloc(asic, sizeof *ms);
 	if (!ms)
 		goto error;
 
@@ -183,7 +183,7 @@ struct umr_hsa_stream *umr_hsa_decode_stream(struct umr_asic *asic, uint32_t *st
 
 		// if not enough stream for packet or reach 0, stop parsing
 		if (nwords < ms->nwords || !ms->nwords) {
-			free(ms);
+			umr_packet_release(asic, ms);
 			if (prev_ms) {
 				prev_ms->next = NULL;
 			} else {
@@ -192,7 +192,7 @@ struct umr_hsa_stream *umr_hsa_decode_stream(struct umr_asic *asic, uint32_t *st
 			return oms;
 		}
 
-		ms->words = calloc(ms->nwords - 1, sizeof *(ms->words)); // don't need copy of header
+		ms->words = umr_packet_alloc(asic, (ms->nwords - 1) * sizeof *(ms->words)); // don't need copy of header
 		if (!ms->words)
 			goto error;
 		for (n = 0; n < ms->nwords - 1; n++) {
@@ -215,7 +215,7 @@ struct umr_hsa_stream *umr_hsa_decode_stream(struct umr_asic *asic, uint32_t *st
 
 		nwords -= ms->nwords;
 		if (nwords) {
-			ms->next = calloc(1, sizeof *(ms->next));
+			ms->next = umr_packet_alloc(asic, sizeof *(ms->next));
 			if (!ms->next)
 				goto error;
 			prev_ms = ms;
@@ -226,7 +226,7 @@ struct umr_hsa_stream *umr_hsa_decode_stream(struct umr_asic *asic, uint32_t *st
 	return oms;
 error:
 	asic->err_msg("[ERROR]: Out of memory\n");
-	while (oms) {
+	while (oms && !asic->packet_arena) {
 		free(oms->words);
 		ms = oms->next;
 		free(oms);
@@ -390,6 +390,8 @@ struct umr_hsa_stream *umr_hsa_decode_stream_opcodes(struct umr_asic *asic, stru
 
 /**
  * umr_free_hsa_stream - Free a hsa stream object
+ *
+ * Not for streams owned by a umr_packet_stream, use umr_packet_free() on those.
  */
 void umr_free_hsa_stream(struct umr_hsa_stream *stream)
 {
@@ -399,7 +401,7 @@ void umr_free_hsa_stream(struct umr_hsa_stream *stream)
 		pgm = stream->shader;
 		while (pgm) {
 			struct umr_shaders_pgm *next = pgm->next;
-			free(pgm->regs);
+			umr_free_regpairs_copy(pgm->regs);
 			free(pgm);
 			pgm = next;
 		}
@@ -459,3 +461,68 @@ struct umr_shaders_pgm *umr_find_shader_in_hsa_stream(struct umr_asic *asic, str
 
 	return NULL;
 }
+
+/**
+ * umr_aql_view_next - View the next AQL packet of a buffer in place
+ *
+ * @buf: The queue buffer
+ * @nwords: The number of 32-bit words in @buf
+ * @slot: The packet to start looking from, on return the one after @view
+ * @flags: UMR_AQL_VIEW_ACTIVE to skip HSA_INVALID packets
+ * @view: Where to describe the packet
+ *
+ * AQL packets are fixed 64-byte records so unlike umr_hsa_decode_stream()
+ * nothing is copied, allocated or read from the kernel object.  The view
+ * points into @buf and is valid as long as it is.  With
+ * UMR_AQL_VIEW_ACTIVE a queue is walked in time proportional to the
+ * packets that have not been consumed by the CP yet.
+ *
+ * Returns 1 if a packet was found, 0 at the end of the buffer.
+ */
+int umr_aql_view_next(const uint32_t *buf, uint32_t nwords, uint32_t *slot, int flags, struct umr_aql_view *view)
+{
+	const uint32_t *w;
+	uint32_t nslots = nwords / 16, x;
+
+	for (x = *slot; x < nslots; x++)
+		if (!(flags & UMR_AQL_VIEW_ACTIVE) || (buf[16 * x] & 0xFF) != 1)
+			break;
+	if (x >= nslots) {
+		*slot = nslots;
+		return 0;
+	}
+	*slot = x + 1;
+
+	w = &buf[16 * x];
+	memset(view, 0, sizeof *view);
+	view->words = w;
+	view->slot = x;
+	view->header = w[0] & 0xFFFF;
+	view->type = w[0] & 0xFF;
+	view->barrier = (w[0] >> 8) & 1;
+	view->acquire_fence_scope = (w[0] >> 9) & 3;
+	view->release_fence_scope = (w[0] >> 11) & 3;
+
+	// see umr_hsa_decode_stream_opcodes() for the layouts
+	switch (view->type) {
+		case 2: // kernel dispatch
+			view->dispatch.setup_dimensions = (w[0] >> 16) & 3;
+			view->dispatch.workgroup_size[0] = w[1] & 0xFFFF;
+			view->dispatch.workgroup_size[1] = w[1] >> 16;
+			view->dispatch.workgroup_size[2] = w[2] & 0xFFFF;
+			view->dispatch.grid_size[0] = w[3];
+			view->dispatch.grid_size[1] = w[4];
+			view->dispatch.grid_size[2] = w[5];
+			view->dispatch.private_segment_size = w[6];
+			view->dispatch.group_segment_size = w[7];
+			view->dispatch.kernel_object = w[8] | ((uint64_t)w[9] << 32);
+			view->dispatch.kernarg_address = w[10] | ((uint64_t)w[11] << 32);
+			// fall through
+		case 3: // barrier and
+		case 4: // agent dispatch
+		case 5: // barrier or
+			view->completion_signal = w[14] | ((uint64_t)w[15] << 32);
+			break;
+	}
+	return 1;
+}
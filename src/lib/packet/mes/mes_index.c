@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include <umr.h>
+
+/**
+ * A MES index lists the packets of a MES ring or log along with the
+ * doorbell, queue, process and gang they refer to.  The packets that
+ * refer to the same doorbell or gang context are chained so the history
+ * of a queue is found without decoding or searching the whole stream.
+ * The fields are taken from umr_mes_decode_stream_opcodes() so they
+ * follow its layouts for each MES version.
+ */
+
+static uint32_t map_hash(uint64_t key)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	return (uint32_t)key;
+}
+
+static uint32_t map_find(const struct umr_mes_index_map *m, uint64_t key)
+{
+	uint32_t x;
+
+	for (x = map_hash(key) & (m->size - 1); m->slots[x].first != UMR_MES_INDEX_NONE; x = (x + 1) & (m->size - 1))
+		if (m->slots[x].key == key)
+			break;
+	return x;
+}
+
+static int map_grow(struct umr_mes_index_map *m)
+{
+	struct umr_mes_index_map n;
+	uint32_t x, y;
+
+	n.size = m->size ? m->size * 2 : 64;
+	n.used = m->used;
+	n.slots = malloc(n.size * sizeof n.slots[0]);
+	if (!n.slots)
+		return -1;
+	for (x = 0; x < n.size; x++)
+		n.slots[x].first = UMR_MES_INDEX_NONE;
+	for (x = 0; x < m->size; x++) {
+		if (m->slots[x].first == UMR_MES_INDEX_NONE)
+			continue;
+		y = map_find(&n, m->slots[x].key);
+		n.slots[y] = m->slots[x];
+	}
+	free(m->slots);
+	*m = n;
+	return 0;
+}
+
+// add entry @e to the chain of @key, returns the entry it follows
+static int map_add(struct umr_mes_index_map *m, uint64_t key, uint32_t e, uint32_t *prev)
+{
+	uint32_t x;
+
+	if (2 * (m->used + 1) > m->size && map_grow(m))
+		return -1;
+	x = map_find(m, key);
+	if (m->slots[x].first == UMR_MES_INDEX_NONE) {
+		m->slots[x].key = key;
+		m->slots[x].first = e;
+		++(m->used);
+		*prev = UMR_MES_INDEX_NONE;
+	} else {
+		*prev = m->slots[x].last;
+	}
+	m->slots[x].last = e;
+	return 0;
+}
+
+struct index_ui_data {
+	struct umr_mes_index *idx;
+	struct umr_mes_index_entry *e;
+	int err;
+};
+
+static void index_link(struct index_ui_data *data)
+{
+	struct umr_mes_index *idx = data->idx;
+	struct umr_mes_index_entry *e = data->e;
+	uint32_t n, prev;
+
+	if (!e)
+		return;
+	data->e = NULL;
+	n = e - idx->entries;
+	if (e->doorbell_offset != UMR_MES_INDEX_NONE) {
+		if (map_add(&idx->doorbells, e->doorbell_offset, n, &prev))
+			data->err = -1;
+		else if (prev != UMR_MES_INDEX_NONE)
+			idx->entries[prev].next_doorbell = n;
+	}
+	if (e->gang_context_addr) {
+		if (map_add(&idx->gangs, e->gang_context_addr, n, &prev))
+			data->err = -1;
+		else if (prev != UMR_MES_INDEX_NONE)
+			idx->entries[prev].next_gang = n;
+	}
+}
+
+static void index_start_ib(struct umr_stream_decode_ui *ui, uint64_t ib_addr, uint32_t ib_vmid, uint64_t from_addr, uint32_t from_vmid, uint32_t size, int type)
+{
+	(void)ui; (void)ib_addr; (void)ib_vmid; (void)from_addr; (void)from_vmid; (void)size; (void)type;
+}
+
+static void index_start_opcode(struct umr_stream_decode_ui *ui, uint64_t ib_addr, uint32_t ib_vmid, int pkttype, uint32_t opcode, uint32_t subop, uint32_t nwords, const char *opcode_name, uint32_t header, const uint32_t *raw_data)
+{
+	struct index_ui_data *data = ui->data;
+	struct umr_mes_index *idx = data->idx;
+	struct umr_mes_index_entry *e;
+
+	(void)ib_vmid; (void)pkttype; (void)subop; (void)header; (void)raw_data;
+	index_link(data);
+	if (idx->no_entries == idx->max_entries) {
+		uint32_t max = idx->max_entries ? idx->max_entries * 2 : 256;
+
+		e = realloc(idx->entries, max * sizeof e[0]);
+		if (!e) {
+			data->err = -1;
+			return;
+		}
+		idx->entries = e;
+		idx->max_entries = max;
+	}
+	e = &idx->entries[idx->no_entries++];
+	memset(e, 0, sizeof *e);
+	e->addr = ib_addr;
+	e->opcode = opcode;
+	e->nwords = nwords;
+	e->name = opcode_name;
+	e->doorbell_offset = e->queue_id = e->pipe_id = e->process_id = UMR_MES_INDEX_NONE;
+	e->next_doorbell = e->next_gang = UMR_MES_INDEX_NONE;
+	data->e = e;
+}
+
+static void index_add_field(struct umr_stream_decode_ui *ui, uint64_t ib_addr, uint32_t ib_vmid, const char *field_name, uint64_t value, char *str, int ideal_radix, int field_size)
+{
+	struct index_ui_data *data = ui->data;
+	struct umr_mes_index_entry *e = data->e;
+
+	(void)ib_addr; (void)ib_vmid; (void)str; (void)ideal_radix; (void)field_size;
+	if (!e)
+		return;
+	if (!strcmp(field_name, "doorbell_offset"))
+		e->doorbell_offset = value;
+	else if (!strcmp(field_name, "queue_id"))
+		e->queue_id = value;
+	else if (!strcmp(field_name, "pipe_id"))
+		e->pipe_id = value;
+	else if (!strcmp(field_name, "process_id"))
+		e->process_id = value;
+	else if (!strcmp(field_name, "gang_context_addr"))
+		e->gang_context_addr = value;
+	else if (!strcmp(field_name, "process_context_addr"))
+		e->process_context_addr = value;
+}
+
+static void index_done(struct umr_stream_decode_ui *ui)
+{
+	index_link(ui->data);
+}
+
+/**
+ * umr_mes_index_create - Create an empty MES index
+ *
+ * Returns the index or NULL if out of memory.
+ */
+struct umr_mes_index *umr_mes_index_create(void)
+{
+	return calloc(1, sizeof(struct umr_mes_index));
+}
+
+/**
+ * umr_mes_index_feed - Add the packets of a buffer of MES words to an index
+ * @asic: The ASIC the MES packets are bound for
+ * @idx: The index to add to
+ * @words: The MES words
+ * @nwords: How many words are in @words
+ * @addr: The address of @words
+ *
+ * A ring or log can be fed in pieces as it is read.  Zero words between
+ * packets are skipped and a packet that is cut off at the end of @words
+ * is not consumed, it should be fed again with the words that follow it.
+ *
+ * Returns how many words were consumed or -1 on error.
+ */
+int umr_mes_index_feed(struct umr_asic *asic, struct umr_mes_index *idx, uint32_t *words, uint32_t nwords, uint64_t addr)
+{
+	struct umr_packet_arena *arena = asic->packet_arena;
+	struct umr_stream_decode_ui ui;
+	struct index_ui_data data;
+	struct umr_mes_stream *ms;
+	uint32_t off = 0, start, len = 0;
+
+	memset(&ui, 0, sizeof ui);
+	memset(&data, 0, sizeof data);
+	data.idx = idx;
+	ui.rt = UMR_RING_MES;
+	ui.start_ib = index_start_ib;
+	ui.start_opcode = index_start_opcode;
+	ui.add_field = index_add_field;
+	ui.done = index_done;
+	ui.data = &data;
+
+	// the streams are freed right away, keep them out of any session arena
+	asic->packet_arena = NULL;
+	while (off < nwords) {
+		// the size of a MES packet is in bits 12..19 of its header
+		start = off;
+		while (off < nwords) {
+			len = (words[off] >> 12) & 0xFF;
+			if (!len || len > nwords - off)
+				break;
+			off += len;
+		}
+		if (off > start) {
+			ms = umr_mes_decode_stream(asic, &words[start], off - start, -1);
+			if (!ms) {
+				off = start;
+				data.err = -1;
+				break;
+			}
+			umr_mes_decode_stream_opcodes(asic, &ui, ms, addr + 4ULL * start, 0, ~0UL);
+			umr_free_mes_stream(ms);
+			if (data.err)
+				break;
+		}
+		if (off < nwords) {
+			if (len)
+				break;	// cut off packet
+			++off;		// padding
+		}
+	}
+	asic->packet_arena = arena;
+	return data.err ? -1 : (int)off;
+}
+
+/**
+ * umr_mes_index_find_doorbell - Find the first packet that refers to a doorbell
+ * @idx: The index to search
+ * @doorbell_offset: The doorbell offset of the queue
+ *
+ * The following packets of the queue are chained by next_doorbell.
+ *
+ * Returns the entry or UMR_MES_INDEX_NONE.
+ */
+uint32_t umr_mes_index_find_doorbell(const struct umr_mes_index *idx, uint32_t doorbell_offset)
+{
+	if (!idx->doorbells.size)
+		return UMR_MES_INDEX_NONE;
+	return idx->doorbells.slots[map_find(&idx->doorbells, doorbell_offset)].first;
+}
+
+/**
+ * umr_mes_index_find_gang - Find the first packet that refers to a gang
+ * @idx: The index to search
+ * @gang_context_addr: The address of the gang context
+ *
+ * The following packets of the gang are chained by next_gang.
+ *
+ * Returns the entry or UMR_MES_INDEX_NONE.
+ */
+uint32_t umr_mes_index_find_gang(const struct umr_mes_index *idx, uint64_t gang_context_addr)
+{
+	if (!idx->gangs.size)
+		return UMR_MES_INDEX_NONE;
+	return idx->gangs.slots[map_find(&idx->gangs, gang_context_addr)].first;
+}
+
+/**
+ * umr_mes_index_free - Free a MES index
+ * @idx: The index to free
+ */
+void umr_mes_index_free(struct umr_mes_index *idx)
+{
+	if (!idx)
+		return;
+	free(idx->entries);
+	free(idx->doorbells.slots);
+	free(idx->gangs.slots);
+	free(idx);
+}
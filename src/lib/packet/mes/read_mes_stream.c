@@ -173,7 +173,7 @@ struct umr_mes_stream *umr_mes_decode_stream(struct umr_asic *asic, uint32_t *st
 		return NULL;
 	}
 
-	oms = ms = calloc(1, sizeof *ms);
+	oms = ms = umr_packet_alloc(asic, sizeof *ms);
 	if (!ms)
 		goto error;
 
@@ -184,7 +184,7 @@ struct umr_mes_stream *umr_mes_decode_stream(struct umr_asic *asic, uint32_t *st
 
 		// if not enough stream for packet or reach 0, stop parsing
 		if (nwords < ms->nwords || !ms->nwords) {
-			free(ms);
+			umr_packet_release(asic, ms);
 			if (prev_ms) {
 				prev_ms->next = NULL;
 			} else {
@@ -194,7 +194,7 @@ struct umr_mes_stream *umr_mes_decode_stream(struct umr_asic *asic, uint32_t *st
 		}
 
 		ms->header = *stream++;
-		ms->words = calloc(ms->nwords - 1, sizeof *(ms->words)); // don't need copy of header
+		ms->words = umr_packet_alloc(asic, (ms->nwords - 1) * sizeof *(ms->words)); // don't need copy of header
 		if (!ms->words)
 			goto error;
 		for (n = 0; n < ms->nwords - 1; n++) {
@@ -202,7 +202,7 @@ struct umr_mes_stream *umr_mes_decode_stream(struct umr_asic *asic, uint32_t *st
 		}
 		nwords -= ms->nwords;
 		if (nwords) {
-			ms->next = calloc(1, sizeof *(ms->next));
+			ms->next = umr_packet_alloc(asic, sizeof *(ms->next));
 			if (!ms->next)
 				goto error;
 			prev_ms = ms;
@@ -212,7 +212,7 @@ struct umr_mes_stream *umr_mes_decode_stream(struct umr_asic *asic, uint32_t *st
 	return oms;
 error:
 	asic->err_msg("[ERROR]: Out of memory\n");
-	while (oms) {
+	while (oms && !asic->packet_arena) {
 		free(oms->words);
 		ms = oms->next;
 		free(oms);
@@ -987,12 +987,15 @@ struct umr_mes_stream *umr_mes_decode_stream_opcodes(struct umr_asic *asic, stru
 
 /**
  * umr_free_mes_stream - Free a mes stream object
+ *
+ * Not for streams owned by a umr_packet_stream, use umr_packet_free() on those.
  */
 void umr_free_mes_stream(struct umr_mes_stream *stream)
 {
 	while (stream) {
 		struct umr_mes_stream *n;
 		n = stream->next;
+		free(stream->words);
 		free(stream);
 		stream = n;
 	}
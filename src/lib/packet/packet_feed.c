@@ -0,0 +1,372 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include <umr.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * A feed decodes a buffer that is handed over in pieces (e.g. a large
+ * IB dump read from a file) without ever holding all of it.  Each piece
+ * is appended to the words left over from the previous one, the whole
+ * packets at the front are decoded and presented right away and the
+ * packet still being received is kept for the next piece.
+ */
+
+// how many words of a file are pushed at once
+#define FEED_WINDOW (1UL << 16)
+
+struct umr_packet_feed {
+	struct umr_asic *asic;
+	struct umr_decode_session *sess;
+	enum umr_ring_type rt;
+	uint32_t vmid;
+	uint64_t addr;			// of pending[0]
+	uint32_t *pending, npending, maxpending;
+	void (*present)(struct umr_packet_stream *str, uint64_t addr, uint32_t vmid, void *data);
+	void *data;
+};
+
+// PM4 packets carry their size in the header, see index_pm4()
+static uint32_t frame_pm4(const uint32_t *words, uint32_t nwords)
+{
+	uint32_t off = 0, n_words;
+
+	while (off < nwords) {
+		n_words = ((words[off] >> 16) + 1) & 0x3FFF;
+		if ((words[off] >> 30) == 2)
+			--n_words;
+		if (nwords - off < 1 + n_words)
+			break;
+		off += 1 + n_words;
+	}
+	return off;
+}
+
+/*
+ * How many words at the front of the pending words are whole packets.
+ * The other types are framed by their decoders which cannot tell a
+ * truncated packet from a whole one so the last packet found is only
+ * decoded once another one follows it (or the feed is finished).
+ */
+static uint32_t frame_pending(struct umr_packet_feed *feed)
+{
+	struct umr_packet_index *idx;
+	uint32_t n = 0;
+
+	switch (feed->rt) {
+		case UMR_RING_PM4:
+		case UMR_RING_PM4_LITE:
+			return frame_pm4(feed->pending, feed->npending);
+		case UMR_RING_SDMA:
+		case UMR_RING_MES:
+		case UMR_RING_VPE:
+		case UMR_RING_UMSCH:
+		case UMR_RING_HSA:
+			idx = umr_packet_index_buffer(feed->asic, feed->pending, feed->npending, feed->rt);
+			if (idx && idx->no_entries > 1)
+				n = idx->entries[idx->no_entries - 1].offset;
+			umr_packet_index_free(idx);
+			return n;
+		default:
+			// the VCN messages cannot be framed, they wait for the end
+			return 0;
+	}
+}
+
+static void present_default(struct umr_packet_stream *str, uint64_t addr, uint32_t vmid, void *data)
+{
+	(void)data;
+	umr_packet_disassemble_stream(str, addr, vmid, 0, 0, ~0UL, 1, 0);
+}
+
+// decode and present the first nwords pending words and drop them
+static int feed_decode(struct umr_packet_feed *feed, uint32_t nwords)
+{
+	struct umr_packet_stream *str;
+
+	if (!nwords)
+		return 0;
+	str = umr_decode_session_buffer(feed->sess, feed->vmid, feed->addr, feed->pending, nwords, NULL);
+	if (!str)
+		return -1;
+	feed->present(str, feed->addr, feed->vmid, feed->data);
+	umr_decode_session_release(feed->sess, str);
+
+	memmove(feed->pending, &feed->pending[nwords], (feed->npending - nwords) * sizeof feed->pending[0]);
+	feed->npending -= nwords;
+	feed->addr += 4ULL * nwords;
+	return 0;
+}
+
+/**
+ * umr_packet_feed_create - Start decoding a buffer that arrives in pieces
+ * @asic: The ASIC model the packets correspond to
+ * @ui: The UI the packets are presented with
+ * @rt: What type of packets are in the buffer (not UMR_RING_GUESS)
+ * @ip_version: The IP version to decode for or UMR_PACKET_IP_VERSION_AUTO
+ * @from_vmid: Which VMID space the buffer came from
+ * @from_addr: The address of the first word of the buffer
+ * @present: Called with each decoded run of packets, NULL to disassemble
+ *           them (following IBs) through @ui
+ * @data: Passed to @present
+ *
+ * Packets are decoded on their own run at a time so state set up by
+ * packets in an earlier run (such as the shader registers of PM4
+ * dispatches) is not known to the packets of a later one.  The streams
+ * handed to @present are freed when it returns.
+ *
+ * Returns the feed or NULL on error.
+ */
+struct umr_packet_feed *umr_packet_feed_create(struct umr_asic *asic, struct umr_stream_decode_ui *ui,
+	enum umr_ring_type rt, int32_t ip_version, uint32_t from_vmid, uint64_t from_addr,
+	void (*present)(struct umr_packet_stream *str, uint64_t addr, uint32_t vmid, void *data), void *data)
+{
+	struct umr_packet_feed *feed;
+
+	if (rt == UMR_RING_GUESS || rt == UMR_RING_UNK) {
+		asic->err_msg("[ERROR]: The type of packets of a feed must be known\n");
+		return NULL;
+	}
+	feed = calloc(1, sizeof *feed);
+	if (!feed)
+		goto oom;
+	feed->sess = umr_decode_session_create(asic, ui, rt, ip_version, 0);
+	if (!feed->sess) {
+		free(feed);
+		goto oom;
+	}
+	feed->asic = asic;
+	feed->rt = rt;
+	feed->vmid = from_vmid;
+	feed->addr = from_addr;
+	feed->present = present ? present : present_default;
+	feed->data = data;
+	return feed;
+oom:
+	asic->err_msg("[ERROR]: Out of memory\n");
+	return NULL;
+}
+
+/**
+ * umr_packet_feed_push - Hand the next words of the buffer to a feed
+ * @feed: The feed
+ * @words: The words, they are copied
+ * @nwords: How many words there are
+ *
+ * The packets completed by these words are decoded and presented before
+ * this returns.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int umr_packet_feed_push(struct umr_packet_feed *feed, const uint32_t *words, uint32_t nwords)
+{
+	if (feed->maxpending - feed->npending < nwords) {
+		uint32_t max = feed->maxpending ? feed->maxpending : 1024;
+		uint32_t *p;
+
+		while (max - feed->npending < nwords)
+			max *= 2;
+		p = realloc(feed->pending, max * sizeof *p);
+		if (!p) {
+			feed->asic->err_msg("[ERROR]: Out of memory\n");
+			return -1;
+		}
+		feed->pending = p;
+		feed->maxpending = max;
+	}
+	memcpy(&feed->pending[feed->npending], words, nwords * sizeof *words);
+	feed->npending += nwords;
+	return feed_decode(feed, frame_pending(feed));
+}
+
+/**
+ * umr_packet_feed_finish - Decode whatever is left in a feed
+ * @feed: The feed
+ *
+ * Words left that do not make a whole packet (a buffer cut short) are
+ * decoded as they are.  More words can be pushed afterwards.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int umr_packet_feed_finish(struct umr_packet_feed *feed)
+{
+	return feed_decode(feed, feed->npending);
+}
+
+/**
+ * umr_packet_feed_free - Free a feed
+ * @feed: The feed, words that were not decoded are dropped
+ */
+void umr_packet_feed_free(struct umr_packet_feed *feed)
+{
+	if (!feed)
+		return;
+	umr_decode_session_free(feed->sess);
+	free(feed->pending);
+	free(feed);
+}
+
+// a file mapped whole, the pages that were pushed are dropped as we go
+static int feed_mapped(struct umr_packet_feed *feed, int fd, off_t skip, off_t size)
+{
+	const uint32_t *words;
+	uint64_t nwords, off, n;
+	void *map;
+	int r = 0;
+
+	map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		return 1;
+	madvise(map, size, MADV_SEQUENTIAL);
+	words = (const uint32_t *)((const char *)map + skip);
+	nwords = (size - skip) / 4;
+	for (off = 0; !r && off < nwords; off += n) {
+		n = nwords - off;
+		if (n > FEED_WINDOW)
+			n = FEED_WINDOW;
+		r = umr_packet_feed_push(feed, &words[off], n);
+		madvise(map, ((size_t)((const char *)&words[off + n] - (const char *)map)) & ~(size_t)(sysconf(_SC_PAGESIZE) - 1), MADV_DONTNEED);
+	}
+	munmap(map, size);
+	return r;
+}
+
+// anything that cannot be mapped (a pipe) is read a window at a time
+static int feed_read(struct umr_packet_feed *feed, int fd, off_t skip)
+{
+	uint32_t *buf;
+	size_t len = 0;
+	ssize_t r;
+	char *p;
+	int ret = 0;
+
+	buf = malloc(FEED_WINDOW * 4);
+	if (!buf) {
+		feed->asic->err_msg("[ERROR]: Out of memory\n");
+		return -1;
+	}
+	p = (char *)buf;
+	for (;;) {
+		r = read(fd, p + len, FEED_WINDOW * 4 - len);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r < 0) {
+			ret = -1;
+			break;
+		}
+		len += r;
+		if (skip && len >= (size_t)skip) {
+			memmove(p, p + skip, len - skip);
+			len -= skip;
+			skip = 0;
+		}
+		if (!skip && (len == FEED_WINDOW * 4 || (!r && len >= 4))) {
+			ret = umr_packet_feed_push(feed, buf, len / 4);
+			if (ret)
+				break;
+			len = 0;
+		}
+		if (!r)
+			break;
+	}
+	free(buf);
+	return ret;
+}
+
+// one hex word per line, other lines are skipped
+static int feed_text(struct umr_packet_feed *feed, int fd)
+{
+	char line[128];
+	uint32_t *buf, n = 0;
+	FILE *f;
+	int r = 0;
+
+	buf = malloc(FEED_WINDOW * 4);
+	f = fdopen(fd, "r");
+	if (!buf || !f) {
+		free(buf);
+		if (f)
+			fclose(f);
+		else
+			close(fd);
+		feed->asic->err_msg("[ERROR]: Out of memory\n");
+		return -1;
+	}
+	while (!r && fgets(line, sizeof line, f)) {
+		if (sscanf(line, "%"SCNx32, &buf[n]) == 1 && ++n == FEED_WINDOW) {
+			r = umr_packet_feed_push(feed, buf, n);
+			n = 0;
+		}
+	}
+	if (!r && n)
+		r = umr_packet_feed_push(feed, buf, n);
+	fclose(f);
+	free(buf);
+	return r;
+}
+
+/**
+ * umr_packet_feed_file - Push a file of packets through a feed
+ * @feed: The feed
+ * @filename: A raw ".bin" image, a ".ring" debugfs dump (whose 12 byte
+ *            header is skipped) or text with one hex word per line
+ *
+ * Binary files are mapped (or read when they cannot be) and pushed a
+ * window at a time so output starts before the whole file is read and
+ * only about a window of it is in memory.  The feed is finished at the
+ * end of the file.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int umr_packet_feed_file(struct umr_packet_feed *feed, const char *filename)
+{
+	struct stat st;
+	off_t skip;
+	int fd, r;
+
+	fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		feed->asic->err_msg("[ERROR]: Cannot open IB file '%s': %s\n", filename, strerror(errno));
+		return -1;
+	}
+
+	if (strstr(filename, ".ring") || strstr(filename, ".bin")) {
+		skip = strstr(filename, ".ring") ? 12 : 0;
+		r = 1;
+		if (!fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size > skip)
+			r = feed_mapped(feed, fd, skip, st.st_size);
+		if (r > 0)
+			r = feed_read(feed, fd, skip);
+		close(fd);
+	} else {
+		r = feed_text(feed, fd);
+	}
+	if (r) {
+		feed->asic->err_msg("[ERROR]: Could not decode IB file '%s'\n", filename);
+		return -1;
+	}
+	return umr_packet_feed_finish(feed);
+}
@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include <umr.h>
+
+/**
+ * A packet index only records where the packets of a buffer are and
+ * what they are so a viewer can list a large ring right away and only
+ * decode the packets the user looks at with umr_packet_decode_index().
+ */
+
+static struct umr_packet_index_entry *index_add(struct umr_packet_index *idx)
+{
+	if (idx->no_entries == idx->max_entries) {
+		uint32_t max = idx->max_entries ? idx->max_entries * 2 : 256;
+		struct umr_packet_index_entry *e = realloc(idx->entries, max * sizeof e[0]);
+
+		if (!e)
+			return NULL;
+		idx->entries = e;
+		idx->max_entries = max;
+	}
+	return memset(&idx->entries[idx->no_entries++], 0, sizeof idx->entries[0]);
+}
+
+// PM4 packets carry their size in the header, see umr_pm4_lite_decode_stream()
+static int index_pm4(struct umr_packet_index *idx, uint32_t *stream, uint32_t nwords)
+{
+	struct umr_packet_index_entry *e;
+	uint32_t off = 0, n_words;
+
+	while (off < nwords) {
+		n_words = ((stream[off] >> 16) + 1) & 0x3FFF;
+		if ((stream[off] >> 30) == 2)
+			--n_words;
+		if (nwords - off < 1 + n_words)
+			break;
+
+		e = index_add(idx);
+		if (!e)
+			return -1;
+		e->offset = off;
+		e->nwords = 1 + n_words;
+		// rings are padded with one word packets (type 2 or a NOP
+		// of count 0x3FFF), a run of the same one is a single entry
+		if (!n_words)
+			e->nwords = umr_dword_span(&stream[off], nwords - off, stream[off]);
+		e->header = stream[off];
+		e->pkttype = stream[off] >> 30;
+		if (e->pkttype == 0) {
+			e->name = "PKT0";
+		} else if (e->pkttype == 3) {
+			e->opcode = (stream[off] >> 8) & 0xFF;
+			if (e->opcode == 0x33)
+				e->name = (n_words == 3) ? "PKT3_INDIRECT_BUFFER_CONST" : "PKT3_COND_INDIRECT_BUFFER_CONST";
+			else if (e->opcode == 0x3F)
+				e->name = (n_words == 3) ? "PKT3_INDIRECT_BUFFER" : "PKT3_COND_INDIRECT_BUFFER";
+			else
+				e->name = umr_pm4_opcode_to_str(stream[off]);
+		}
+		off += e->nwords;
+	}
+	return 0;
+}
+
+struct index_ui_data {
+	struct umr_packet_index *idx;
+	uint64_t base;
+	uint32_t nwords;
+	int err;
+};
+
+static void index_start_ib(struct umr_stream_decode_ui *ui, uint64_t ib_addr, uint32_t ib_vmid, uint64_t from_addr, uint32_t from_vmid, uint32_t size, int type)
+{
+	(void)ui; (void)ib_addr; (void)ib_vmid; (void)from_addr; (void)from_vmid; (void)size; (void)type;
+}
+
+static void index_start_opcode(struct umr_stream_decode_ui *ui, uint64_t ib_addr, uint32_t ib_vmid, int pkttype, uint32_t opcode, uint32_t subop, uint32_t nwords, const char *opcode_name, uint32_t header, const uint32_t *raw_data)
+{
+	struct index_ui_data *data = ui->data;
+	struct umr_packet_index_entry *e;
+	uint64_t off = (ib_addr - data->base) / 4;
+
+	(void)ib_vmid; (void)nwords; (void)raw_data;
+	if (off >= data->nwords)
+		return;
+	e = index_add(data->idx);
+	if (!e) {
+		data->err = -1;
+		return;
+	}
+	e->offset = off;
+	e->header = header;
+	e->pkttype = pkttype;
+	e->opcode = opcode;
+	e->subop = subop;
+	e->name = opcode_name;
+}
+
+static void index_add_field(struct umr_stream_decode_ui *ui, uint64_t ib_addr, uint32_t ib_vmid, const char *field_name, uint64_t value, char *str, int ideal_radix, int field_size)
+{
+	(void)ui; (void)ib_addr; (void)ib_vmid; (void)field_name; (void)value; (void)str; (void)ideal_radix; (void)field_size;
+}
+
+static void index_add_shader(struct umr_stream_decode_ui *ui, struct umr_asic *asic, uint64_t ib_addr, uint32_t ib_vmid, struct umr_shaders_pgm *shader)
+{
+	(void)ui; (void)asic; (void)ib_addr; (void)ib_vmid; (void)shader;
+}
+
+static void index_add_data(struct umr_stream_decode_ui *ui, struct umr_asic *asic, uint64_t ib_addr, uint32_t ib_vmid, uint64_t buf_addr, uint32_t buf_vmid, enum UMR_DATABLOCK_ENUM type, uint64_t etype)
+{
+	(void)ui; (void)asic; (void)ib_addr; (void)ib_vmid; (void)buf_addr; (void)buf_vmid; (void)type; (void)etype;
+}
+
+static void index_done(struct umr_stream_decode_ui *ui)
+{
+	(void)ui;
+}
+
+/*
+ * The size of the other packet types depends on the opcode so their own
+ * decoders frame them, without following IBs and with a UI that only
+ * records where each packet starts.
+ */
+static int index_decoded(struct umr_asic *asic, struct umr_packet_index *idx, uint32_t *stream, uint32_t nwords, enum umr_ring_type rt)
+{
+	struct umr_stream_decode_ui ui;
+	struct index_ui_data data;
+	struct umr_packet_stream *str;
+	int no_follow_ib = asic->options.no_follow_ib;
+	uint32_t x;
+
+	memset(&ui, 0, sizeof ui);
+	memset(&data, 0, sizeof data);
+	data.idx = idx;
+	data.nwords = nwords;
+	ui.rt = rt;
+	ui.start_ib = index_start_ib;
+	ui.start_opcode = index_start_opcode;
+	ui.add_field = index_add_field;
+	ui.add_shader = index_add_shader;
+	ui.add_data = index_add_data;
+	ui.done = index_done;
+	ui.data = &data;
+
+	asic->options.no_follow_ib = 1;
+	str = umr_packet_decode_buffer(asic, &ui, 0, 0, stream, nwords, rt, NULL);
+	if (str) {
+		umr_packet_disassemble_stream(str, 0, 0, 0, 0, ~0UL, 0, 0);
+		umr_packet_free(str);
+	}
+	asic->options.no_follow_ib = no_follow_ib;
+	if (!str || data.err)
+		return -1;
+
+	// a packet runs up to the next one, words not handled by the
+	// decoder are counted to the packet before them
+	for (x = 0; x < idx->no_entries; x++)
+		idx->entries[x].nwords = ((x + 1 < idx->no_entries) ? idx->entries[x + 1].offset : nwords) - idx->entries[x].offset;
+	return 0;
+}
+
+/**
+ * umr_packet_index_buffer - Find the packets of a buffer without decoding them
+ * @asic: The ASIC model the packets correspond to
+ * @stream: An array of 32-bit words with the packets
+ * @nwords: How many words are in the @stream array
+ * @rt: What type of packets are in the buffer
+ *
+ * PM4 packets are framed from their headers alone and a run of the same
+ * one word packet (ring padding) is one entry.  The other types are
+ * framed by their decoders but without following IBs and without any
+ * output.  The names of the entries point to static strings.
+ *
+ * Returns the index or NULL on error.
+ */
+struct umr_packet_index *umr_packet_index_buffer(struct umr_asic *asic, uint32_t *stream, uint32_t nwords, enum umr_ring_type rt)
+{
+	struct umr_packet_index *idx;
+	int r;
+
+	idx = calloc(1, sizeof *idx);
+	if (!idx) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return NULL;
+	}
+	idx->rt = rt;
+
+	switch (rt) {
+		case UMR_RING_PM4:
+		case UMR_RING_PM4_LITE:
+			r = index_pm4(idx, stream, nwords);
+			break;
+		case UMR_RING_SDMA:
+		case UMR_RING_MES:
+		case UMR_RING_VPE:
+		case UMR_RING_UMSCH:
+		case UMR_RING_HSA:
+			r = index_decoded(asic, idx, stream, nwords, rt);
+			break;
+		default:
+			asic->err_msg("[ERROR]: Ring type %d cannot be indexed\n", (int)rt);
+			r = -1;
+			break;
+	}
+	if (r) {
+		umr_packet_index_free(idx);
+		return NULL;
+	}
+	return idx;
+}
+
+/**
+ * umr_packet_index_free - Free a packet index
+ * @idx: The index to free
+ */
+void umr_packet_index_free(struct umr_packet_index *idx)
+{
+	if (!idx)
+		return;
+	free(idx->entries);
+	free(idx);
+}
+
+/**
+ * umr_packet_decode_index - Fully decode some packets of an index
+ * @asic: The ASIC model the packets correspond to
+ * @ui: The UI to present the packets with
+ * @idx: The index of @stream from umr_packet_index_buffer()
+ * @first: The first entry to decode
+ * @count: How many entries to decode
+ * @stream: The buffer the index was made from
+ * @from_vmid: Which VMID space the buffer came from
+ * @from_addr: The address the buffer came from
+ * @follow: Should IBs and BOs of the packets be followed
+ *
+ * The packets are decoded on their own so state that is set up by
+ * earlier packets of the buffer (such as the shader registers of PM4
+ * dispatches) is not known to them.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int umr_packet_decode_index(struct umr_asic *asic, struct umr_stream_decode_ui *ui, struct umr_packet_index *idx,
+			    uint32_t first, uint32_t count, uint32_t *stream, uint32_t from_vmid, uint64_t from_addr, int follow)
+{
+	struct umr_packet_stream *str;
+	uint32_t off, nwords;
+
+	if (!count || first >= idx->no_entries || count > idx->no_entries - first)
+		return -1;
+
+	off = idx->entries[first].offset;
+	nwords = idx->entries[first + count - 1].offset + idx->entries[first + count - 1].nwords - off;
+	str = umr_packet_decode_buffer(asic, ui, from_vmid, from_addr + 4ULL * off, &stream[off], nwords, idx->rt, NULL);
+	if (!str)
+		return -1;
+	umr_packet_disassemble_stream(str, from_addr + 4ULL * off, from_vmid, 0, 0, ~0UL, follow, 0);
+	umr_packet_free(str);
+	return 0;
+}
@@ -0,0 +1,566 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include <umr.h>
+
+/**
+ * The packet log is a umr_stream_decode_ui that appends every callback
+ * to a byte buffer instead of printing it.  Each event is a type byte
+ * followed by LEB128 numbers; addresses are stored as the signed
+ * difference to the address of the previous event and names as indices
+ * into the log's table of names.  Raw packet words are stored as is in
+ * host byte order.
+ *
+ * The VCN message and unhandled opcode callbacks hand out decoder
+ * objects and are not recorded.
+ */
+
+#define NO_NAME 0xFFFFFFFFUL
+
+static int log_reserve(struct umr_packet_log *log, size_t n)
+{
+	uint8_t *buf;
+	size_t size;
+
+	if (log->len + n <= log->size)
+		return 0;
+	size = log->size ? log->size : 4096;
+	while (size < log->len + n)
+		size *= 2;
+	buf = realloc(log->buf, size);
+	if (!buf)
+		return -1;
+	log->buf = buf;
+	log->size = size;
+	return 0;
+}
+
+static void put_uvar(struct umr_packet_log *log, uint64_t v)
+{
+	do {
+		log->buf[log->len++] = (v & 0x7F) | (v > 0x7F ? 0x80 : 0);
+		v >>= 7;
+	} while (v);
+}
+
+static void put_svar(struct umr_packet_log *log, int64_t v)
+{
+	put_uvar(log, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+static void put_addr(struct umr_packet_log *log, uint64_t addr)
+{
+	put_svar(log, (int64_t)(addr - log->last_addr));
+	log->last_addr = addr;
+}
+
+static uint32_t name_hash(const char *s)
+{
+	uint32_t h = 2166136261UL;
+
+	while (*s)
+		h = (h ^ (uint8_t)*s++) * 16777619UL;
+	return h;
+}
+
+static int names_rehash(struct umr_packet_log *log, uint32_t size)
+{
+	uint32_t *tab, x, y;
+
+	tab = malloc(size * sizeof tab[0]);
+	if (!tab)
+		return -1;
+	memset(tab, 0xFF, size * sizeof tab[0]);
+	for (x = 0; x < log->no_names; x++) {
+		y = name_hash(&log->names[log->name_off[x]]) & (size - 1);
+		while (tab[y] != NO_NAME)
+			y = (y + 1) & (size - 1);
+		tab[y] = x;
+	}
+	free(log->name_hash);
+	log->name_hash = tab;
+	log->hash_size = size;
+	return 0;
+}
+
+// index of a name in the table of the log, NO_NAME for NULL or on error
+static uint32_t log_name(struct umr_packet_log *log, const char *name)
+{
+	uint32_t h, len, id;
+
+	if (!name)
+		return NO_NAME;
+
+	if (log->no_names * 2 >= log->hash_size &&
+	    names_rehash(log, log->hash_size ? log->hash_size * 2 : 256))
+		return NO_NAME;
+
+	h = name_hash(name) & (log->hash_size - 1);
+	while ((id = log->name_hash[h]) != NO_NAME) {
+		if (!strcmp(&log->names[log->name_off[id]], name))
+			return id;
+		h = (h + 1) & (log->hash_size - 1);
+	}
+
+	len = strlen(name) + 1;
+	if (log->names_len + len > log->names_size) {
+		uint32_t size = log->names_size ? log->names_size : 4096;
+		char *names;
+
+		while (size < log->names_len + len)
+			size *= 2;
+		names = realloc(log->names, size);
+		if (!names)
+			return NO_NAME;
+		log->names = names;
+		log->names_size = size;
+	}
+	if (log->no_names == log->max_names) {
+		uint32_t max = log->max_names ? log->max_names * 2 : 256;
+		uint32_t *off = realloc(log->name_off, max * sizeof off[0]);
+
+		if (!off)
+			return NO_NAME;
+		log->name_off = off;
+		log->max_names = max;
+	}
+	memcpy(&log->names[log->names_len], name, len);
+	log->name_off[log->no_names] = log->names_len;
+	log->names_len += len;
+	log->name_hash[h] = log->no_names;
+	return log->no_names++;
+}
+
+// names are stored off by one so NULL is a single zero byte
+static void put_name(struct umr_packet_log *log, uint32_t id)
+{
+	put_uvar(log, id == NO_NAME ? 0 : (uint64_t)id + 1);
+}
+
+// worst case size of an event without its raw words
+#define EVENT_MAX (1 + 16 * 10)
+
+static void log_start_ib(struct umr_stream_decode_ui *ui, uint64_t ib_addr, uint32_t ib_vmid, uint64_t from_addr, uint32_t from_vmid, uint32_t size, int type)
+{
+	struct umr_packet_log *log = ui->data;
+
+	if (log_reserve(log, EVENT_MAX))
+		return;
+	log->buf[log->len++] = UMR_PACKET_LOG_START_IB;
+	put_addr(log, ib_addr);
+	put_uvar(log, ib_vmid);
+	put_uvar(log, from_addr);
+	put_uvar(log, from_vmid);
+	put_uvar(log, size);
+	put_svar(log, type);
+}
+
+static void log_unhandled_dword(struct umr_stream_decode_ui *ui, uint64_t ib_addr, uint32_t ib_vmid, uint32_t dword)
+{
+	struct umr_packet_log *log = ui->data;
+
+	if (log_reserve(log, EVENT_MAX))
+		return;
+	log->buf[log->len++] = UMR_PACKET_LOG_UNHANDLED_DWORD;
+	put_addr(log, ib_addr);
+	put_uvar(log, ib_vmid);
+	put_uvar(log, dword);
+}
+
+static void log_start_opcode(struct umr_stream_decode_ui *ui, uint64_t ib_addr, uint32_t ib_vmid, int pkttype, uint32_t opcode, uint32_t subop, uint32_t nwords, const char *opcode_name, uint32_t header, const uint32_t *raw_data)
+{
+	struct umr_packet_log *log = ui->data;
+	uint32_t name = log_name(log, opcode_name), no_raw = 0;
+
+	// the SDMA and VPE decoders count the header in nwords
+	if (raw_data) {
+		no_raw = nwords;
+		if ((ui->rt == UMR_RING_SDMA || ui->rt == UMR_RING_VPE) && no_raw)
+			--no_raw;
+	}
+
+	if (log_reserve(log, EVENT_MAX + no_raw * 4))
+		return;
+	log->buf[log->len++] = UMR_PACKET_LOG_START_OPCODE;
+	put_addr(log, ib_addr);
+	put_uvar(log, ib_vmid);
+	put_svar(log, pkttype);
+	put_uvar(log, opcode);
+	put_uvar(log, subop);
+	put_uvar(log, nwords);
+	put_name(log, name);
+	put_uvar(log, header);
+	put_uvar(log, no_raw);
+	if (no_raw) {
+		memcpy(&log->buf[log->len], raw_data, no_raw * 4);
+		log->len += no_raw * 4;
+	}
+}
+
+static void log_add_field(struct umr_stream_decode_ui *ui, uint64_t ib_addr, uint32_t ib_vmid, const char *field_name, uint64_t value, char *str, int ideal_radix, int field_size)
+{
+	struct umr_packet_log *log = ui->data;
+	uint32_t name = log_name(log, field_name), sname = log_name(log, str);
+
+	if (log_reserve(log, EVENT_MAX))
+		return;
+	log->buf[log->len++] = UMR_PACKET_LOG_FIELD;
+	put_addr(log, ib_addr);
+	put_uvar(log, ib_vmid);
+	put_name(log, name);
+	put_uvar(log, value);
+	put_name(log, sname);
+	put_svar(log, ideal_radix);
+	put_svar(log, field_size);
+}
+
+static void log_add_shader(struct umr_stream_decode_ui *ui, struct umr_asic *asic, uint64_t ib_addr, uint32_t ib_vmid, struct umr_shaders_pgm *shader)
+{
+	struct umr_packet_log *log = ui->data;
+
+	(void)asic;
+	if (log_reserve(log, EVENT_MAX))
+		return;
+	log->buf[log->len++] = UMR_PACKET_LOG_SHADER;
+	put_addr(log, ib_addr);
+	put_uvar(log, ib_vmid);
+	put_uvar(log, shader->addr);
+	put_uvar(log, shader->vmid);
+	put_uvar(log, shader->size);
+	put_svar(log, shader->type);
+	put_uvar(log, shader->src.ib_base);
+	put_uvar(log, shader->src.ib_offset);
+}
+
+static void log_add_data(struct umr_stream_decode_ui *ui, struct umr_asic *asic, uint64_t ib_addr, uint32_t ib_vmid, uint64_t buf_addr, uint32_t buf_vmid, enum UMR_DATABLOCK_ENUM type, uint64_t etype)
+{
+	struct umr_packet_log *log = ui->data;
+
+	(void)asic;
+	if (log_reserve(log, EVENT_MAX))
+		return;
+	log->buf[log->len++] = UMR_PACKET_LOG_DATA;
+	put_addr(log, ib_addr);
+	put_uvar(log, ib_vmid);
+	put_uvar(log, buf_addr);
+	put_uvar(log, buf_vmid);
+	put_uvar(log, type);
+	put_uvar(log, etype);
+}
+
+static void log_taint(struct umr_stream_decode_ui *ui)
+{
+	struct umr_packet_log *log = ui->data;
+
+	if (!log_reserve(log, 1))
+		log->buf[log->len++] = UMR_PACKET_LOG_TAINT;
+}
+
+static void log_done(struct umr_stream_decode_ui *ui)
+{
+	struct umr_packet_log *log = ui->data;
+
+	if (!log_reserve(log, 1))
+		log->buf[log->len++] = UMR_PACKET_LOG_DONE;
+}
+
+/**
+ * umr_packet_log_create - Create an empty packet log
+ * @rt: The type of ring the log will record
+ *
+ * Pass &log->ui to any of the umr_packet_decode_*() functions and then
+ * to umr_packet_disassemble_stream() through the packet stream to fill
+ * the log.
+ *
+ * Returns the log or NULL if out of memory.
+ */
+struct umr_packet_log *umr_packet_log_create(enum umr_ring_type rt)
+{
+	struct umr_packet_log *log;
+
+	log = calloc(1, sizeof *log);
+	if (!log)
+		return NULL;
+	log->ui.rt = rt;
+	log->ui.start_ib = log_start_ib;
+	log->ui.unhandled_dword = log_unhandled_dword;
+	log->ui.start_opcode = log_start_opcode;
+	log->ui.add_field = log_add_field;
+	log->ui.add_shader = log_add_shader;
+	log->ui.add_data = log_add_data;
+	log->ui.taint = log_taint;
+	log->ui.done = log_done;
+	log->ui.data = log;
+	return log;
+}
+
+/**
+ * umr_packet_log_reset - Drop the events of a log
+ * @log: The log to empty
+ *
+ * The buffers and the names are kept for the next decode.
+ */
+void umr_packet_log_reset(struct umr_packet_log *log)
+{
+	log->len = 0;
+	log->last_addr = 0;
+}
+
+/**
+ * umr_packet_log_free - Free a packet log
+ * @log: The log to free
+ */
+void umr_packet_log_free(struct umr_packet_log *log)
+{
+	if (!log)
+		return;
+	free(log->buf);
+	free(log->names);
+	free(log->name_off);
+	free(log->name_hash);
+	free(log);
+}
+
+/**
+ * umr_packet_log_reader_init - Start reading a packet log from the first event
+ * @reader: The reader to initialize
+ * @log: The log to read
+ */
+void umr_packet_log_reader_init(struct umr_packet_log_reader *reader, const struct umr_packet_log *log)
+{
+	memset(reader, 0, sizeof *reader);
+	reader->log = log;
+}
+
+/**
+ * umr_packet_log_reader_fini - Free the buffers of a reader
+ * @reader: The reader
+ */
+void umr_packet_log_reader_fini(struct umr_packet_log_reader *reader)
+{
+	free(reader->raw);
+	reader->raw = NULL;
+	reader->raw_size = 0;
+}
+
+static int get_uvar(struct umr_packet_log_reader *r, uint64_t *v)
+{
+	unsigned shift = 0;
+	uint8_t b;
+
+	*v = 0;
+	do {
+		if (r->pos >= r->log->len || shift > 63)
+			return -1;
+		b = r->log->buf[r->pos++];
+		*v |= (uint64_t)(b & 0x7F) << shift;
+		shift += 7;
+	} while (b & 0x80);
+	return 0;
+}
+
+static int get_u32(struct umr_packet_log_reader *r, uint32_t *v)
+{
+	uint64_t t;
+
+	if (get_uvar(r, &t))
+		return -1;
+	*v = t;
+	return 0;
+}
+
+static int get_int(struct umr_packet_log_reader *r, int *v)
+{
+	uint64_t t;
+
+	if (get_uvar(r, &t))
+		return -1;
+	*v = (int)(int64_t)((t >> 1) ^ -(t & 1));
+	return 0;
+}
+
+static int get_addr(struct umr_packet_log_reader *r, uint64_t *addr)
+{
+	uint64_t t;
+
+	if (get_uvar(r, &t))
+		return -1;
+	r->last_addr += (uint64_t)((int64_t)(t >> 1) ^ -(int64_t)(t & 1));
+	*addr = r->last_addr;
+	return 0;
+}
+
+static int get_name(struct umr_packet_log_reader *r, const char **name)
+{
+	uint64_t id;
+
+	if (get_uvar(r, &id) || id > r->log->no_names)
+		return -1;
+	*name = id ? &r->log->names[r->log->name_off[id - 1]] : NULL;
+	return 0;
+}
+
+/**
+ * umr_packet_log_next - Read the next event of a packet log
+ * @reader: The reader started with umr_packet_log_reader_init()
+ * @ev: Where to store the event
+ *
+ * The raw words of a START_OPCODE event are only valid until the next
+ * call.
+ *
+ * Returns 1 if an event was read, 0 at the end of the log and -1 if the
+ * log is corrupt.
+ */
+int umr_packet_log_next(struct umr_packet_log_reader *reader, struct umr_packet_log_event *ev)
+{
+	const struct umr_packet_log *log = reader->log;
+	uint64_t t = 0;
+	int r = 0;
+
+	memset(ev, 0, sizeof *ev);
+	if (reader->pos >= log->len)
+		return 0;
+
+	ev->type = log->buf[reader->pos++];
+	switch (ev->type) {
+		case UMR_PACKET_LOG_START_IB:
+			r = get_addr(reader, &ev->addr) || get_u32(reader, &ev->vmid) ||
+			    get_uvar(reader, &ev->ib.from_addr) || get_u32(reader, &ev->ib.from_vmid) ||
+			    get_u32(reader, &ev->ib.size) || get_int(reader, &ev->ib.type);
+			break;
+		case UMR_PACKET_LOG_UNHANDLED_DWORD:
+			r = get_addr(reader, &ev->addr) || get_u32(reader, &ev->vmid) ||
+			    get_u32(reader, &ev->dword);
+			break;
+		case UMR_PACKET_LOG_START_OPCODE:
+			r = get_addr(reader, &ev->addr) || get_u32(reader, &ev->vmid) ||
+			    get_int(reader, &ev->opcode.pkttype) || get_u32(reader, &ev->opcode.opcode) ||
+			    get_u32(reader, &ev->opcode.subop) || get_u32(reader, &ev->opcode.nwords) ||
+			    get_name(reader, &ev->opcode.name) || get_u32(reader, &ev->opcode.header) ||
+			    get_u32(reader, &ev->opcode.no_raw);
+			if (r || !ev->opcode.no_raw)
+				break;
+			if (ev->opcode.no_raw > (log->len - reader->pos) / 4)
+				return -1;
+			if (ev->opcode.no_raw > reader->raw_size) {
+				uint32_t *raw = realloc(reader->raw, ev->opcode.no_raw * sizeof raw[0]);
+				if (!raw)
+					return -1;
+				reader->raw = raw;
+				reader->raw_size = ev->opcode.no_raw;
+			}
+			memcpy(reader->raw, &log->buf[reader->pos], ev->opcode.no_raw * 4);
+			reader->pos += ev->opcode.no_raw * 4;
+			ev->opcode.raw = reader->raw;
+			break;
+		case UMR_PACKET_LOG_FIELD:
+			r = get_addr(reader, &ev->addr) || get_u32(reader, &ev->vmid) ||
+			    get_name(reader, &ev->field.name) || get_uvar(reader, &ev->field.value) ||
+			    get_name(reader, &ev->field.str) || get_int(reader, &ev->field.radix) ||
+			    get_int(reader, &ev->field.size);
+			break;
+		case UMR_PACKET_LOG_SHADER:
+			r = get_addr(reader, &ev->addr) || get_u32(reader, &ev->vmid) ||
+			    get_uvar(reader, &ev->shader.addr) || get_u32(reader, &ev->shader.vmid) ||
+			    get_u32(reader, &ev->shader.size) || get_int(reader, &ev->shader.type) ||
+			    get_uvar(reader, &ev->shader.src.ib_base) || get_uvar(reader, &ev->shader.src.ib_offset);
+			break;
+		case UMR_PACKET_LOG_DATA:
+			r = get_addr(reader, &ev->addr) || get_u32(reader, &ev->vmid) ||
+			    get_uvar(reader, &ev->data.addr) || get_u32(reader, &ev->data.vmid) ||
+			    get_uvar(reader, &t) || get_uvar(reader, &ev->data.etype);
+			if (!r)
+				ev->data.type = t;
+			break;
+		case UMR_PACKET_LOG_TAINT:
+		case UMR_PACKET_LOG_DONE:
+			break;
+		default:
+			return -1;
+	}
+	return r ? -1 : 1;
+}
+
+/**
+ * umr_packet_log_replay - Feed the events of a packet log to a UI
+ * @log: The log to replay
+ * @asic: The ASIC passed to the shader and data callbacks
+ * @ui: The UI to call, callbacks that are NULL are skipped
+ *
+ * The UI sees the same calls (except for the ones that are not recorded)
+ * as it would have seen from the decode, without decoding again.  The
+ * shaders passed to add_shader() only have their address, size, type
+ * and source filled in.
+ *
+ * Returns 0 on success, -1 if the log is corrupt.
+ */
+int umr_packet_log_replay(const struct umr_packet_log *log, struct umr_asic *asic, struct umr_stream_decode_ui *ui)
+{
+	struct umr_packet_log_reader reader;
+	struct umr_packet_log_event ev;
+	int r;
+
+	umr_packet_log_reader_init(&reader, log);
+	while ((r = umr_packet_log_next(&reader, &ev)) > 0) {
+		switch (ev.type) {
+			case UMR_PACKET_LOG_START_IB:
+				if (ui->start_ib)
+					ui->start_ib(ui, ev.addr, ev.vmid, ev.ib.from_addr, ev.ib.from_vmid, ev.ib.size, ev.ib.type);
+				break;
+			case UMR_PACKET_LOG_UNHANDLED_DWORD:
+				if (ui->unhandled_dword)
+					ui->unhandled_dword(ui, ev.addr, ev.vmid, ev.dword);
+				break;
+			case UMR_PACKET_LOG_START_OPCODE:
+				if (ui->start_opcode)
+					ui->start_opcode(ui, ev.addr, ev.vmid, ev.opcode.pkttype, ev.opcode.opcode, ev.opcode.subop,
+							 ev.opcode.nwords, ev.opcode.name, ev.opcode.header, ev.opcode.raw);
+				break;
+			case UMR_PACKET_LOG_FIELD:
+				if (ui->add_field)
+					ui->add_field(ui, ev.addr, ev.vmid, ev.field.name, ev.field.value, (char *)ev.field.str, ev.field.radix, ev.field.size);
+				break;
+			case UMR_PACKET_LOG_SHADER:
+				if (ui->add_shader)
+					ui->add_shader(ui, asic, ev.addr, ev.vmid, &ev.shader);
+				break;
+			case UMR_PACKET_LOG_DATA:
+				if (ui->add_data)
+					ui->add_data(ui, asic, ev.addr, ev.vmid, ev.data.addr, ev.data.vmid, ev.data.type, ev.data.etype);
+				break;
+			case UMR_PACKET_LOG_TAINT:
+				if (ui->taint)
+					ui->taint(ui);
+				break;
+			case UMR_PACKET_LOG_DONE:
+				if (ui->done)
+					ui->done(ui);
+				break;
+			default:
+				break;
+		}
+	}
+	umr_packet_log_reader_fini(&reader);
+	return r;
+}
@@ -23,6 +23,7 @@
  *
  */
 #include <umr.h>
+#include <sched.h>
 
 /**
  * The "packet" routines are meant to be a wrapper around all of the
@@ -31,6 +32,454 @@
  * instead of calling the lower level functions directly.
  */
 
+#define PACKET_ARENA_MIN (64 * 1024)
+#define PACKET_ARENA_MAX (1024 * 1024)
+
+// packet nodes, word copies and shader records of one decode are
+// carved out of these chunks and released together by umr_packet_free()
+struct umr_packet_arena {
+	struct umr_packet_arena *next;
+	size_t used, size;
+	_Alignas(16) unsigned char data[];
+};
+
+/**
+ * umr_packet_alloc - Allocate zeroed memory for a decoded packet stream
+ * @asic: The ASIC the stream is decoded for
+ * @size: The number of bytes to allocate
+ *
+ * While umr_packet_decode_buffer() runs the memory comes from the arena
+ * of the stream and must not be passed to free(), otherwise it comes
+ * from calloc().  Use umr_packet_release() to free it either way.
+ *
+ * Returns a pointer to the memory or NULL if out of memory.
+ */
+void *umr_packet_alloc(struct umr_asic *asic, size_t size)
+{
+	struct umr_packet_arena *chunk, *head = asic->packet_arena;
+	size_t csize;
+	void *p;
+
+	if (!head)
+		return calloc(1, size);
+
+	size = (size + 15) & ~(size_t)15;
+	if (!size)
+		size = 16;
+
+	// the second chunk in the list is the one being filled, the head
+	// stays put since the stream points at it
+	chunk = head->next ? head->next : head;
+	if (chunk->used + size > chunk->size) {
+		csize = chunk->size * 2;
+		if (csize > PACKET_ARENA_MAX)
+			csize = PACKET_ARENA_MAX;
+		if (csize < size)
+			csize = size;
+		chunk = calloc(1, sizeof *chunk + csize);
+		if (!chunk)
+			return NULL;
+		chunk->size = csize;
+		chunk->next = head->next;
+		head->next = chunk;
+	}
+	p = chunk->data + chunk->used;
+	chunk->used += size;
+	return p;
+}
+
+/**
+ * umr_packet_release - Free memory from umr_packet_alloc()
+ * @asic: The ASIC the stream is decoded for
+ * @p: The memory to free
+ *
+ * Memory taken from an arena is only reclaimed with the whole arena.
+ */
+void umr_packet_release(struct umr_asic *asic, void *p)
+{
+	if (!asic->packet_arena)
+		free(p);
+}
+
+static void packet_arena_free(struct umr_packet_arena *chunk)
+{
+	struct umr_packet_arena *next;
+
+	while (chunk) {
+		next = chunk->next;
+		free(chunk);
+		chunk = next;
+	}
+}
+
+#define IB_CACHE_BUCKETS 256
+
+// at most this many IBs of a ring are read ahead
+#define IB_PREFETCH_MAX 4096
+
+enum {
+	IB_QUEUED = 0,	// waiting for the prefetch thread
+	IB_READING,
+	IB_READ,
+};
+
+// an IB read while decoding, words is NULL if the read failed
+struct umr_ib_cache_entry {
+	struct umr_ib_cache_entry *next;
+	int vm_partition, state;
+	uint32_t vmid, size;
+	uint64_t addr;
+	uint32_t *words;
+};
+
+// size of a shader bound by one of the packets
+struct umr_shader_size_entry {
+	struct umr_shader_size_entry *next;
+	int vm_partition;
+	uint32_t vmid, size;
+	uint64_t addr;
+};
+
+// IBs read by one decode, packets referencing the same IB share one read
+struct umr_ib_cache {
+	struct umr_ib_cache_entry *bucket[IB_CACHE_BUCKETS];
+	struct umr_shader_size_entry *shaders[IB_CACHE_BUCKETS];
+
+	// IBs of the ring read ahead in submission order, see ib_prefetch_start()
+	struct umr_asic *asic;
+	struct umr_ib_cache_entry **prefetch;
+	int no_prefetch, stop, started;
+	pthread_t thread;
+	pthread_mutex_t lock; // held around every VRAM read of the decode
+};
+
+static unsigned ib_cache_hash(uint32_t vmid, uint64_t addr, uint32_t size)
+{
+	uint64_t h = (addr >> 2) ^ ((uint64_t)vmid << 48) ^ ((uint64_t)size << 20);
+	h *= 0x9E3779B97F4A7C15ULL;
+	return h >> (64 - 8);
+}
+
+static struct umr_ib_cache_entry *ib_cache_find(struct umr_ib_cache *cache, int vm_partition, uint32_t vmid, uint64_t addr, uint32_t size)
+{
+	struct umr_ib_cache_entry *e;
+
+	for (e = cache->bucket[ib_cache_hash(vmid, addr, size)]; e; e = e->next)
+		if (e->vmid == vmid && e->addr == addr && e->size == size && e->vm_partition == vm_partition)
+			return e;
+	return NULL;
+}
+
+static struct umr_ib_cache_entry *ib_cache_add(struct umr_ib_cache *cache, int vm_partition, uint32_t vmid, uint64_t addr, uint32_t size)
+{
+	struct umr_ib_cache_entry *e;
+	unsigned h = ib_cache_hash(vmid, addr, size);
+
+	e = calloc(1, sizeof *e);
+	if (!e)
+		return NULL;
+	e->vm_partition = vm_partition;
+	e->vmid = vmid;
+	e->addr = addr;
+	e->size = size;
+	e->next = cache->bucket[h];
+	cache->bucket[h] = e;
+	return e;
+}
+
+static uint32_t *ib_read(struct umr_asic *asic, struct umr_ib_cache *cache, int vm_partition, uint32_t vmid, uint64_t addr, uint32_t size)
+{
+	uint32_t *words;
+	int r;
+
+	words = calloc(1, size);
+	if (!words)
+		return NULL;
+	if (cache)
+		pthread_mutex_lock(&cache->lock);
+	r = umr_read_vram(asic, vm_partition, vmid, addr, size, words);
+	if (cache)
+		pthread_mutex_unlock(&cache->lock);
+	if (r < 0) {
+		free(words);
+		return NULL;
+	}
+	return words;
+}
+
+// read a queued IB unless the other thread already started on it
+static void ib_entry_read(struct umr_asic *asic, struct umr_ib_cache *cache, struct umr_ib_cache_entry *e)
+{
+	int state = IB_QUEUED;
+
+	if (__atomic_compare_exchange_n(&e->state, &state, IB_READING, 0, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+		e->words = ib_read(asic, cache, e->vm_partition, e->vmid, e->addr, e->size);
+		__atomic_store_n(&e->state, IB_READ, __ATOMIC_RELEASE);
+		return;
+	}
+	while (state != IB_READ) {
+		sched_yield();
+		state = __atomic_load_n(&e->state, __ATOMIC_ACQUIRE);
+	}
+}
+
+static void *ib_prefetch_worker(void *arg)
+{
+	struct umr_ib_cache *cache = arg;
+	int i;
+
+	for (i = 0; i < cache->no_prefetch && !__atomic_load_n(&cache->stop, __ATOMIC_RELAXED); i++)
+		ib_entry_read(cache->asic, cache, cache->prefetch[i]);
+	return NULL;
+}
+
+/*
+ * ib_prefetch_start - Read the IBs of a PM4 ring on a background thread
+ *
+ * The top level packets are scanned for INDIRECT_BUFFER packets and their
+ * IBs are read in submission order while the ring is decoded.  Decoding
+ * stays on the calling thread and in order since every IB updates the
+ * register state the following packets are decoded with, only the reads
+ * move ahead.  The VM walk is not thread safe so the reads of both
+ * threads are serialized by the cache lock, and the registers are all
+ * loaded up front so the decoder never loads a block while the other
+ * thread looks registers up.
+ */
+static void ib_prefetch_start(struct umr_asic *asic, struct umr_ib_cache *cache, int vm_partition, uint32_t vmid, uint32_t *stream, uint32_t nwords)
+{
+	struct umr_ib_cache_entry *e;
+	uint32_t n, n_words, size, tvmid;
+	uint64_t addr;
+
+	cache->prefetch = calloc(IB_PREFETCH_MAX, sizeof cache->prefetch[0]);
+	if (!cache->prefetch)
+		return;
+
+	for (n = 0; n < nwords && cache->no_prefetch < IB_PREFETCH_MAX; n += 1 + n_words) {
+		n_words = ((stream[n] >> 16) + 1) & 0x3FFF;
+		if ((stream[n] >> 30) == 2)
+			--n_words;
+		if (!n_words) {
+			// skip the rest of a run of padding
+			n_words = umr_dword_span(&stream[n], nwords - n, stream[n]) - 1;
+			continue;
+		}
+		if ((stream[n] >> 30) != 3 || n_words < 3 || n + n_words >= nwords)
+			continue;
+		if (((stream[n] >> 8) & 0xFF) != 0x3F && ((stream[n] >> 8) & 0xFF) != 0x33)
+			continue;
+
+		// same fields and limits as the PM4 decoder uses
+		addr = (stream[n + 1] & ~3ULL) | ((uint64_t)(stream[n + 2] & 0xFFFF) << 32);
+		size = (stream[n + 3] & ((1UL << 20) - 1)) * 4;
+		if (!size || size > (1024UL * 1024UL * 8UL))
+			continue;
+		tvmid = (stream[n + 3] >> 24) & 0xF;
+		if (!tvmid)
+			tvmid = vmid;
+		if (umr_packet_filter_ib_pruned(asic->packet_filter, tvmid))
+			continue;
+		if (ib_cache_find(cache, vm_partition, tvmid, addr, size))
+			continue;
+		e = ib_cache_add(cache, vm_partition, tvmid, addr, size);
+		if (!e)
+			break;
+		cache->prefetch[cache->no_prefetch++] = e;
+	}
+
+	// a single IB is read just as fast by the decoder itself
+	if (cache->no_prefetch < 2 || umr_load_ip_blocks(asic, NULL))
+		return;
+
+	cache->asic = asic;
+	if (!pthread_create(&cache->thread, NULL, ib_prefetch_worker, cache))
+		cache->started = 1;
+}
+
+static struct umr_ib_cache *ib_cache_create(void)
+{
+	struct umr_ib_cache *cache;
+
+	cache = calloc(1, sizeof *cache);
+	if (cache)
+		pthread_mutex_init(&cache->lock, NULL);
+	return cache;
+}
+
+/**
+ * umr_packet_fetch_ib - Read an IB referenced by a packet
+ * @asic: The ASIC the stream is decoded for
+ * @vm_partition: The VM partition to read from
+ * @vmid: The VMID of the IB
+ * @addr: The address of the IB
+ * @size: The size of the IB in bytes
+ *
+ * While umr_packet_decode_buffer() runs every IB is read once and the
+ * words are shared by all packets that reference it.  With the
+ * parallel_ibs option the IBs of a PM4 ring may already have been read
+ * by the prefetch thread.  Hand the words back with
+ * umr_packet_release_ib() when done.
+ *
+ * Returns the words of the IB or NULL if it could not be read.
+ */
+uint32_t *umr_packet_fetch_ib(struct umr_asic *asic, int vm_partition, uint32_t vmid, uint64_t addr, uint32_t size)
+{
+	struct umr_ib_cache *cache = asic->ib_cache;
+	struct umr_ib_cache_entry *e;
+	uint32_t *words;
+
+	if (!cache)
+		return ib_read(asic, NULL, vm_partition, vmid, addr, size);
+
+	e = ib_cache_find(cache, vm_partition, vmid, addr, size);
+	if (e) {
+		ib_entry_read(asic, cache, e);
+		return e->words;
+	}
+
+	// failed reads are remembered too so they are not retried
+	words = ib_read(asic, cache, vm_partition, vmid, addr, size);
+	e = ib_cache_add(cache, vm_partition, vmid, addr, size);
+	if (!e) {
+		// the words have to stay alive until the decode ends
+		free(words);
+		return NULL;
+	}
+	e->words = words;
+	e->state = IB_READ;
+	return words;
+}
+
+/**
+ * umr_packet_release_ib - Hand back the words from umr_packet_fetch_ib()
+ * @asic: The ASIC the stream is decoded for
+ * @words: The words of the IB
+ *
+ * Cached IBs are freed when the decode ends.
+ */
+void umr_packet_release_ib(struct umr_asic *asic, uint32_t *words)
+{
+	if (!asic->ib_cache)
+		free(words);
+}
+
+/**
+ * umr_packet_shader_size - Compute the size of a shader bound by a packet
+ * @asic: The ASIC the stream is decoded for
+ * @vm_partition: The VM partition to read from
+ * @shader: The shader program to query
+ *
+ * Like umr_compute_shader_size() but while umr_packet_decode_buffer()
+ * runs the size of every shader is only computed once, a stream binds
+ * the same few shaders for all of its draws and dispatches.
+ *
+ * Returns the size of the shader in bytes.
+ */
+uint32_t umr_packet_shader_size(struct umr_asic *asic, int vm_partition, struct umr_shaders_pgm *shader)
+{
+	struct umr_ib_cache *cache = asic->ib_cache;
+	struct umr_shader_size_entry *e;
+	unsigned h;
+	uint32_t size;
+
+	if (!cache)
+		return umr_compute_shader_size(asic, vm_partition, shader);
+
+	h = ib_cache_hash(shader->vmid, shader->addr, 0);
+	for (e = cache->shaders[h]; e; e = e->next)
+		if (e->vmid == shader->vmid && e->addr == shader->addr && e->vm_partition == vm_partition)
+			return e->size;
+
+	pthread_mutex_lock(&cache->lock);
+	size = umr_compute_shader_size(asic, vm_partition, shader);
+	pthread_mutex_unlock(&cache->lock);
+
+	e = calloc(1, sizeof *e);
+	if (e) {
+		e->vm_partition = vm_partition;
+		e->vmid = shader->vmid;
+		e->addr = shader->addr;
+		e->size = size;
+		e->next = cache->shaders[h];
+		cache->shaders[h] = e;
+	}
+	return size;
+}
+
+// stop reading ahead for the last decode, what was read stays cached
+static void ib_prefetch_stop(struct umr_ib_cache *cache)
+{
+	if (cache->started) {
+		__atomic_store_n(&cache->stop, 1, __ATOMIC_RELAXED);
+		pthread_join(cache->thread, NULL);
+		cache->started = 0;
+	}
+	cache->stop = 0;
+	free(cache->prefetch);
+	cache->prefetch = NULL;
+	cache->no_prefetch = 0;
+}
+
+// drop every cached IB and shader size
+static void ib_cache_clear(struct umr_ib_cache *cache)
+{
+	struct umr_shader_size_entry *se, *snext;
+	struct umr_ib_cache_entry *e, *next;
+	unsigned x;
+
+	for (x = 0; x < IB_CACHE_BUCKETS; x++) {
+		for (e = cache->bucket[x]; e; e = next) {
+			next = e->next;
+			free(e->words);
+			free(e);
+		}
+		for (se = cache->shaders[x]; se; se = snext) {
+			snext = se->next;
+			free(se);
+		}
+		cache->bucket[x] = NULL;
+		cache->shaders[x] = NULL;
+	}
+}
+
+// must be called before the VM context of the decode ends
+static void ib_cache_free(struct umr_ib_cache *cache)
+{
+	if (!cache)
+		return;
+	ib_prefetch_stop(cache);
+	ib_cache_clear(cache);
+	pthread_mutex_destroy(&cache->lock);
+	free(cache);
+}
+
+/*
+ * A decode session keeps what a decode would otherwise set up and tear
+ * down each time: the arena of a released stream is handed to the next
+ * one, and with UMR_DECODE_SESSION_KEEP the IB/shader size cache and the
+ * VM context live until the session is invalidated, so IBs referenced
+ * by several decodes are only read once.
+ */
+struct umr_decode_session {
+	struct umr_asic *asic;
+	struct umr_stream_decode_ui *ui;
+	enum umr_ring_type rt;
+	int32_t ip_version;
+	unsigned flags;
+	struct umr_ib_cache *ib_cache;   // with UMR_DECODE_SESSION_KEEP
+	struct umr_packet_arena *spare;  // zeroed chunk for the next stream
+};
+
+// a session's IB cache outlives the decode
+static void decode_buffer_end(struct umr_asic *asic, struct umr_decode_session *sess, struct umr_ib_cache *prev_ib_cache)
+{
+	if (sess && asic->ib_cache == sess->ib_cache)
+		ib_prefetch_stop(asic->ib_cache);
+	else
+		ib_cache_free(asic->ib_cache);
+	asic->ib_cache = prev_ib_cache;
+}
+
  struct umr_packet_stream *umr_packet_decode_buffer(struct umr_asic *asic, struct umr_stream_decode_ui *ui,
 	uint32_t from_vmid, uint64_t from_addr,
 	uint32_t *stream, uint32_t nwords, enum umr_ring_type rt, void *queue_data)
@@ -55,7 +504,10 @@ struct umr_packet_stream *umr_packet_decode_buffer_ex(struct umr_asic *asic, str
 	uint32_t from_vmid, uint64_t from_addr,
 	uint32_t *stream, uint32_t nwords, enum umr_ring_type rt, void *queue_data, int32_t ip_version)
 {
+	struct umr_decode_session *sess = asic->decode_session;
 	struct umr_packet_stream *str;
+	struct umr_packet_arena *prev_arena;
+	struct umr_ib_cache *prev_ib_cache;
 	void *p = NULL;
 
 	str = calloc(1, sizeof *str);
@@ -65,6 +517,26 @@ struct umr_packet_stream *umr_packet_decode_buffer_ex(struct umr_asic *asic, str
 	str->from_vmid = from_vmid;
 	str->from_addr = from_addr;
 
+	// the VCN decoders attach messages that are freed node by node
+	if (rt != UMR_RING_VCN_ENC && rt != UMR_RING_VCN_DEC) {
+		if (sess && sess->spare) {
+			str->arena = sess->spare;
+			sess->spare = NULL;
+		} else {
+			str->arena = calloc(1, sizeof *str->arena + PACKET_ARENA_MIN);
+			if (str->arena)
+				str->arena->size = PACKET_ARENA_MIN;
+		}
+	}
+	prev_arena = asic->packet_arena;
+	asic->packet_arena = str->arena;
+	prev_ib_cache = asic->ib_cache;
+	asic->ib_cache = (sess && sess->ib_cache) ? sess->ib_cache : ib_cache_create();
+
+	// IBs and buffers the packets point to are all read with the same VM setup
+	umr_vm_context_begin(asic);
+	if (rt == UMR_RING_PM4 && asic->ib_cache && asic->options.parallel_ibs && !asic->options.no_follow_ib)
+		ib_prefetch_start(asic, asic->ib_cache, asic->options.vm_partition, from_vmid, stream, nwords);
 	switch (rt) {
 		case UMR_RING_PM4:
 			p = str->stream.pm4 = umr_pm4_decode_stream(asic, asic->options.vm_partition, from_vmid, from_addr, stream, nwords, queue_data, ip_version);
@@ -95,13 +567,21 @@ struct umr_packet_stream *umr_packet_decode_buffer_ex(struct umr_asic *asic, str
 			break;
 		case UMR_RING_UNK:
 		default:
+			decode_buffer_end(asic, sess, prev_ib_cache);
+			umr_vm_context_end(asic);
+			asic->packet_arena = prev_arena;
+			packet_arena_free(str->arena);
 			free(str);
 			asic->err_msg("[BUG]: Invalid ring type in packet_decode_buffer()\n");
 			return NULL;
 	}
+	decode_buffer_end(asic, sess, prev_ib_cache);
+	umr_vm_context_end(asic);
+	asic->packet_arena = prev_arena;
 
 	if (!p) {
 		asic->err_msg("[ERROR]: Could not create packet stream object in packet_decode_buffer()\n");
+		packet_arena_free(str->arena);
 		free(str);
 		return NULL;
 	}
@@ -139,6 +619,61 @@ static void apply_start_stop(int *start, int *stop, int rptr, int wptr, int ring
 	}
 }
 
+/**
+ * umr_packet_decode_view - Decode packets from a ring view
+ * @asic: The ASIC model the packet decoding corresponds to
+ * @ui: A user interface to provide sizing and other information for unhandled opcodes
+ * @from_vmid: Which VMID space the ring is in
+ * @rv: The span of the ring, see umr_user_queue_view()
+ * @rt: What type of packets are to be decoded?
+ * @queue_data: Opaque pointer to pass to decoder
+ *
+ * The segments of a view are stored in ring order so the words are decoded
+ * where they were read to.  Returns a pointer to a umr_packet_stream
+ * structure if successful.
+ */
+struct umr_packet_stream *umr_packet_decode_view(struct umr_asic *asic, struct umr_stream_decode_ui *ui,
+	uint32_t from_vmid, const struct umr_ring_view *rv, enum umr_ring_type rt, void *queue_data, int32_t ip_version)
+{
+	if (!rv->nwords)
+		return NULL;
+	return umr_packet_decode_buffer_ex(asic, ui, from_vmid, rv->seg[0].addr, rv->seg[0].words, rv->nwords, rt, queue_data, ip_version);
+}
+
+/**
+ * umr_ring_type_by_name - Guess the packet type of a kernel ring
+ * @ringname: The name of the ring, e.g., 'gfx_0.0.0' or 'sdma0'
+ *
+ * Returns the type of packets found on the ring or UMR_RING_UNK if the
+ * name is not known.
+ */
+enum umr_ring_type umr_ring_type_by_name(const char *ringname)
+{
+	if (!memcmp(ringname, "gfx", 3) ||
+		!memcmp(ringname, "uvd", 3) ||
+		!memcmp(ringname, "mes_kiq", 7) ||
+		!memcmp(ringname, "kiq", 3) ||
+		!memcmp(ringname, "comp", 4)) {
+		// only decode PM4 packets on certain rings
+		return UMR_RING_PM4;
+	} else if (!memcmp(ringname, "vcn_enc", 7) ||
+		!memcmp(ringname, "vcn_unified_", 12)) {
+		return UMR_RING_VCN_ENC;
+	} else if (!memcmp(ringname, "vcn_dec", 7)) {
+		return UMR_RING_VCN_DEC;
+	} else if (!memcmp(ringname, "sdma", 4) ||
+		   !memcmp(ringname, "page", 4)) {
+		return UMR_RING_SDMA;
+	} else if (!memcmp(ringname, "mes", 3)) {
+		return UMR_RING_MES;
+	} else if (!memcmp(ringname, "vpe", 3)) {
+		return UMR_RING_VPE;
+	} else if (!memcmp(ringname, "umsch", 5)) {
+		return UMR_RING_UMSCH;
+	}
+	return UMR_RING_UNK;
+}
+
 struct umr_packet_stream *umr_packet_decode_ring(struct umr_asic *asic, struct umr_stream_decode_ui *ui,
 	char *ringname, int halt_waves, int *start, int *stop, enum umr_ring_type rt, void *queue_data)
 {
@@ -162,7 +697,7 @@ struct umr_packet_stream *umr_packet_decode_ring_ex(struct umr_asic *asic, struc
 	char *ringname, int halt_waves, int *start, int *stop, enum umr_ring_type rt, void *queue_data, int32_t ip_version)
 {
 	void *ps = NULL;
-	uint32_t *ringdata = NULL, ringsize = 0;
+	uint32_t *ringdata = NULL, ringsize = 0, ptrs[3];
 	int only_active = 1;
 
 	if (halt_waves && asic->options.halt_waves) {
@@ -173,13 +708,11 @@ struct umr_packet_stream *umr_packet_decode_ring_ex(struct umr_asic *asic, struc
 	if (rt == UMR_RING_GUESS) {
 		if (!strcmp(ringname, "uq")) {
 			if (asic->options.user_queue.state.active) {
-				ringdata = calloc(asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].rb_buf_size, sizeof *ringdata);
+				struct umr_ring_view rv;
+
 				if (!asic->options.use_full_user_queue) {
 					if (asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].rb_wptr_poll_value == asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].hqd_rptr_value) {
 						asic->err_msg("[ERROR]: The user queue's RPTR and WPTR are equal.  You can try using -O use_full_user_queue instead to read the entire queue.\n");
-						// free the buffer so we don't decode garbage
-						free(ringdata);
-						ringdata = NULL;
 						goto cleanup;
 					} else {
 						apply_start_stop(start, stop,
@@ -192,90 +725,98 @@ struct umr_packet_stream *umr_packet_decode_ring_ex(struct umr_asic *asic, struc
 					*start = 0;
 					*stop = asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].rb_buf_size;
 				}
-				if (ringdata) {
-					// AQL RPTR/WPTR is in terms of 64-byte (16 dword) packets
-					// we need to do AQL math in 32-bit word terms because other
-					// queues are all in terms of 32-bits
-					if (asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].queue_type == UMR_QUEUE_COMPUTE) {
-						*start = (*start * 16) % asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].rb_buf_size;
-						*stop = (*stop * 16) % asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].rb_buf_size;
-
-						// enable disasm_early_term because they don't use the same terminals as mesa
-						asic->options.disasm_early_term = 1;
-					}
-					// continue, so at this point we read the queue like a ring (allowing start > stop)
-					if (umr_read_user_queue_buffer(asic, *start, *stop, ringdata, &ringsize)) {
-						asic->err_msg("[ERROR]: Could not decode packet stream fetched from the user queue.");
-						free(ringdata);
-						ringdata = NULL;
-						goto cleanup;
-					} else {
-						switch (asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].queue_type) {
-							case UMR_QUEUE_COMPUTE_PM4:
-							case UMR_QUEUE_GFX: rt = UMR_RING_PM4; break;
-							case UMR_QUEUE_COMPUTE: rt = UMR_RING_HSA; break;
-							case UMR_QUEUE_SDMA: rt = UMR_RING_SDMA; break;
-							default:
-								asic->err_msg("[BUG]: Unsupported queue type [%d] (%s:%d)\n", asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].queue_type, __FILE__, __LINE__);
-								free(ringdata);
-								ringdata = NULL;
-								goto cleanup;
-						}
-						ps = umr_packet_decode_buffer(asic, ui, 0, asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].hqd_base_addr + *start * 4, ringdata, ringsize, rt, queue_data);
-						free(ringdata);
-						ringdata = NULL;
+
+				// AQL RPTR/WPTR is in terms of 64-byte (16 dword) packets
+				// we need to do AQL math in 32-bit word terms because other
+				// queues are all in terms of 32-bits
+				if (asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].queue_type == UMR_QUEUE_COMPUTE) {
+					*start = (*start * 16) % asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].rb_buf_size;
+					*stop = (*stop * 16) % asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].rb_buf_size;
+
+					// enable disasm_early_term because they don't use the same terminals as mesa
+					asic->options.disasm_early_term = 1;
+				}
+				switch (asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].queue_type) {
+					case UMR_QUEUE_COMPUTE_PM4:
+					case UMR_QUEUE_GFX: rt = UMR_RING_PM4; break;
+					case UMR_QUEUE_COMPUTE: rt = UMR_RING_HSA; break;
+					case UMR_QUEUE_SDMA: rt = UMR_RING_SDMA; break;
+					default:
+						asic->err_msg("[BUG]: Unsupported queue type [%d] (%s:%d)\n", asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].queue_type, __FILE__, __LINE__);
 						goto cleanup;
-					}
 				}
+
+				// continue, so at this point we read only the span of the queue like a ring (allowing start > stop)
+				if (umr_user_queue_view(asic, *start, *stop, &rv)) {
+					asic->err_msg("[ERROR]: Could not decode packet stream fetched from the user queue.");
+					goto cleanup;
+				}
+				ps = umr_packet_decode_view(asic, ui, 0, &rv, rt, queue_data, ip_version);
+				umr_ring_view_free(&rv);
+				goto cleanup;
 			} else {
 				asic->err_msg("[ERROR]: User queue is not active, did you use a --user-queue command?\n");
 				goto cleanup;
 			}
-		} else if (!memcmp(ringname, "gfx", 3) ||
-			!memcmp(ringname, "uvd", 3) ||
-			!memcmp(ringname, "mes_kiq", 7) ||
-			!memcmp(ringname, "kiq", 3) ||
-			!memcmp(ringname, "comp", 4)) {
-			// only decode PM4 packets on certain rings
-			rt = UMR_RING_PM4;
-		} else if (!memcmp(ringname, "vcn_enc", 7) ||
-			!memcmp(ringname, "vcn_unified_", 12)) {
-			rt = UMR_RING_VCN_ENC;
-		} else if (!memcmp(ringname, "vcn_dec", 7)) {
-			rt = UMR_RING_VCN_DEC;
-		} else if (!memcmp(ringname, "sdma", 4) ||
-			   !memcmp(ringname, "page", 4)) {
-			rt = UMR_RING_SDMA;
-		} else if (!memcmp(ringname, "mes", 3)) {
-			rt = UMR_RING_MES;
-		} else if (!memcmp(ringname, "vpe", 3)) {
-			rt = UMR_RING_VPE;
-		} else if (!memcmp(ringname, "umsch", 5)) {
-			rt = UMR_RING_UMSCH;
 		} else {
-			asic->err_msg("[ERROR]: Unknown ring type <%s> for umr_packet_decode_ring()\n", ringname);
-			return NULL;
+			rt = umr_ring_type_by_name(ringname);
+			if (rt == UMR_RING_UNK) {
+				asic->err_msg("[ERROR]: Unknown ring type <%s> for umr_packet_decode_ring()\n", ringname);
+				return NULL;
+			}
 		}
 	}
 
-	// read ring data and reduce indeices modulo ring size
-	// since the kernel returned values might be unwrapped.
-	if (!ringdata) {
+	// a remote backend decodes PM4 rings on its side, one round trip in
+	// place of one for the ring and one for every IB
+	if (rt == UMR_RING_PM4 && !queue_data && asic->ring_func.decode_ring_pm4) {
+		struct umr_packet_stream *str;
+		struct umr_pm4_stream *pm4 = NULL;
+
+		if (!asic->ring_func.decode_ring_pm4(asic, ringname, start, stop, &pm4)) {
+			if (pm4) {
+				str = calloc(1, sizeof *str);
+				if (str) {
+					str->type = rt;
+					str->ui = ui;
+					str->asic = asic;
+					str->stream.pm4 = pm4;
+					str->cont = pm4;
+					ps = str;
+				} else {
+					umr_free_pm4_stream(pm4);
+				}
+			}
+			goto cleanup;
+		}
+	}
+
+	// read the ring pointers, and the whole ring only if the backend
+	// can't read just the span to decode
+	if (asic->ring_func.read_ring_header && asic->ring_func.read_ring_window) {
+		if (asic->ring_func.read_ring_header(asic, ringname, ptrs, &ringsize))
+			goto cleanup;
+	} else {
 		ringdata = asic->ring_func.read_ring_data(asic, ringname, &ringsize);
-		if ((*stop != -1) && (uint32_t)(*stop * 4) >= ringsize)
-			*stop = (ringsize / 4);
+		if (!ringdata)
+			goto cleanup;
+		memcpy(ptrs, ringdata, sizeof ptrs);
 	}
+	if ((*stop != -1) && (uint32_t)(*stop * 4) >= ringsize)
+		*stop = (ringsize / 4);
 
-	if (ringdata) {
-		ringsize /= 4;
-		ringdata[0] %= ringsize;
-		ringdata[1] %= ringsize;
+	// reduce indeices modulo ring size
+	// since the kernel returned values might be unwrapped.
+	ringsize /= 4;
+	if (ringsize) {
+		ptrs[0] %= ringsize;
+		ptrs[1] %= ringsize;
 
 		if (*start != -1 || *stop != -1) {
 			only_active = 0;
 		}
 
-		apply_start_stop(start, stop, ringdata[0], ringdata[1], ringsize);
+		apply_start_stop(start, stop, ptrs[0], ptrs[1], ringsize);
 
 		// reduce indeices modulo ring size
 		if ((uint32_t)*stop > ringsize) {
@@ -289,16 +830,23 @@ struct umr_packet_stream *umr_packet_decode_ring_ex(struct umr_asic *asic, struc
 			int o_start = *start;
 			uint32_t *lineardata, linearsize;
 
-			// copy ring data into linear array
-			lineardata = calloc(ringsize, sizeof(*lineardata));
-			linearsize = 0;
-			while (*start != *stop && linearsize < ringsize) {
-				lineardata[linearsize++] = ringdata[3 + *start];  // first 3 words are rptr/wptr/dwptr
-				*start = (*start + 1) % ringsize;
+			if (!ringdata) {
+				// the backend reads the span in order into a buffer it owns
+				lineardata = asic->ring_func.read_ring_window(asic, ringname, *start, *stop, &linearsize);
+				if (lineardata)
+					ps = umr_packet_decode_buffer_ex(asic, ui, 0, 0, lineardata, linearsize, rt, queue_data, ip_version);
+			} else {
+				// copy ring data into linear array
+				lineardata = calloc(ringsize, sizeof(*lineardata));
+				linearsize = 0;
+				while (*start != *stop && linearsize < ringsize) {
+					lineardata[linearsize++] = ringdata[3 + *start];  // first 3 words are rptr/wptr/dwptr
+					*start = (*start + 1) % ringsize;
+				}
+				*start = o_start;
+				ps = umr_packet_decode_buffer_ex(asic, ui, 0, 0, lineardata, linearsize, rt, queue_data, ip_version);
+				free(lineardata);
 			}
-			*start = o_start;
-			ps = umr_packet_decode_buffer_ex(asic, ui, 0, 0, lineardata, linearsize, rt, queue_data, ip_version);
-			free(lineardata);
 		}
 	}
 	free(ringdata);
@@ -339,12 +887,15 @@ struct umr_packet_stream *umr_packet_decode_vm_buffer_ex(struct umr_asic *asic,
 		asic->err_msg("[ERROR]: Out of memory\n");
 		return NULL;
 	}
+	umr_vm_context_begin(asic);
 	if (umr_read_vram(asic, asic->options.vm_partition, vmid, addr, nwords * 4, words)) {
+		umr_vm_context_end(asic);
 		asic->err_msg("[ERROR]: Could not read vram %" PRIx32 "@0x%"PRIx64"\n", vmid, addr);
 		free(words);
 		return NULL;
 	}
 	str = umr_packet_decode_buffer_ex(asic, ui, vmid, addr, words, nwords, rt, queue_data, ip_version);
+	umr_vm_context_end(asic);
 	free(words);
 	return str;
 }
@@ -356,7 +907,10 @@ struct umr_packet_stream *umr_packet_decode_vm_buffer_ex(struct umr_asic *asic,
  */
 void umr_packet_free(struct umr_packet_stream *stream)
 {
-	if (stream) {
+	if (stream && stream->arena) {
+		packet_arena_free(stream->arena);
+		free(stream);
+	} else if (stream) {
 		switch (stream->type) {
 			case UMR_RING_PM4:
 			case UMR_RING_PM4_LITE:
@@ -389,6 +943,148 @@ void umr_packet_free(struct umr_packet_stream *stream)
 	}
 }
 
+/**
+ * umr_decode_session_create - Create a session to decode many buffers with
+ * @asic: The ASIC model the packet decoding corresponds to
+ * @ui: A user interface passed to every decode of the session
+ * @rt: What type of packets are to be decoded (UMR_RING_GUESS for rings)
+ * @ip_version: The IP version passed to every decode of the session
+ * @flags: UMR_DECODE_SESSION_* flags
+ *
+ * With UMR_DECODE_SESSION_KEEP the memory the packets point to is assumed
+ * not to change between decodes (e.g. a halted ring decoded repeatedly)
+ * until umr_decode_session_invalidate() is called.
+ *
+ * Returns the session or NULL if out of memory.
+ */
+struct umr_decode_session *umr_decode_session_create(struct umr_asic *asic, struct umr_stream_decode_ui *ui,
+	enum umr_ring_type rt, int32_t ip_version, unsigned flags)
+{
+	struct umr_decode_session *sess;
+
+	sess = calloc(1, sizeof *sess);
+	if (!sess)
+		return NULL;
+	sess->asic = asic;
+	sess->ui = ui;
+	sess->rt = rt;
+	sess->ip_version = ip_version;
+	sess->flags = flags;
+	if (flags & UMR_DECODE_SESSION_KEEP) {
+		sess->ib_cache = ib_cache_create();
+		if (!sess->ib_cache) {
+			free(sess);
+			return NULL;
+		}
+		umr_vm_context_begin(asic);
+	}
+	return sess;
+}
+
+/**
+ * umr_decode_session_buffer - Decode packets from a buffer in a session
+ *
+ * Like umr_packet_decode_buffer_ex().  Hand the stream back with
+ * umr_decode_session_release() so its memory is reused.
+ */
+struct umr_packet_stream *umr_decode_session_buffer(struct umr_decode_session *sess, uint32_t from_vmid, uint64_t from_addr,
+	uint32_t *stream, uint32_t nwords, void *queue_data)
+{
+	struct umr_decode_session *prev = sess->asic->decode_session;
+	struct umr_packet_stream *str;
+
+	sess->asic->decode_session = sess;
+	str = umr_packet_decode_buffer_ex(sess->asic, sess->ui, from_vmid, from_addr, stream, nwords, sess->rt, queue_data, sess->ip_version);
+	sess->asic->decode_session = prev;
+	return str;
+}
+
+/**
+ * umr_decode_session_ring - Decode packets from a kernel ring in a session
+ *
+ * Like umr_packet_decode_ring_ex().  Hand the stream back with
+ * umr_decode_session_release() so its memory is reused.
+ */
+struct umr_packet_stream *umr_decode_session_ring(struct umr_decode_session *sess, char *ringname, int halt_waves,
+	int *start, int *stop, void *queue_data)
+{
+	struct umr_decode_session *prev = sess->asic->decode_session;
+	struct umr_packet_stream *str;
+
+	sess->asic->decode_session = sess;
+	str = umr_packet_decode_ring_ex(sess->asic, sess->ui, ringname, halt_waves, start, stop, sess->rt, queue_data, sess->ip_version);
+	sess->asic->decode_session = prev;
+	return str;
+}
+
+/**
+ * umr_decode_session_release - Free a stream decoded in a session
+ * @sess: The session
+ * @stream: The stream (may be NULL)
+ *
+ * The largest chunk of the stream's arena is cleared and kept for the
+ * next decode of the session so its packets fit in one chunk.
+ */
+void umr_decode_session_release(struct umr_decode_session *sess, struct umr_packet_stream *stream)
+{
+	struct umr_packet_arena *chunk, *big = NULL, *next;
+
+	if (!stream || !stream->arena) {
+		umr_packet_free(stream);
+		return;
+	}
+	for (chunk = stream->arena; chunk; chunk = chunk->next)
+		if (!big || chunk->size > big->size)
+			big = chunk;
+	if (sess->spare && sess->spare->size >= big->size)
+		big = NULL;
+	for (chunk = stream->arena; chunk; chunk = next) {
+		next = chunk->next;
+		if (chunk != big)
+			free(chunk);
+	}
+	if (big) {
+		free(sess->spare);
+		memset(big->data, 0, big->used);
+		big->used = 0;
+		big->next = NULL;
+		sess->spare = big;
+	}
+	free(stream);
+}
+
+/**
+ * umr_decode_session_invalidate - Forget the IBs and VM setup of a session
+ *
+ * For UMR_DECODE_SESSION_KEEP sessions once the GPU may have rewritten
+ * the memory the packets point to (e.g. the ring ran again).
+ */
+void umr_decode_session_invalidate(struct umr_decode_session *sess)
+{
+	if (!sess->ib_cache)
+		return;
+	ib_prefetch_stop(sess->ib_cache);
+	ib_cache_clear(sess->ib_cache);
+	umr_vm_context_refresh(sess->asic);
+}
+
+/**
+ * umr_decode_session_free - Free a decode session
+ *
+ * Streams decoded in the session stay valid.
+ */
+void umr_decode_session_free(struct umr_decode_session *sess)
+{
+	if (!sess)
+		return;
+	if (sess->ib_cache) {
+		ib_cache_free(sess->ib_cache);
+		umr_vm_context_end(sess->asic);
+	}
+	free(sess->spare);
+	free(sess);
+}
+
 /**
  * umr_packet_find_shader - Find a shader or compute kernel in a stream
  * @stream: An array of 32-bit words corresponding to the packet data to decode
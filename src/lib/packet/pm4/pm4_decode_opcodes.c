@@ -377,6 +377,471 @@ static uint32_t fetch_word(struct umr_asic *asic, struct umr_pm4_stream *stream,
 	}
 }
 
+/*
+ * Packets made only of plain bitfields are described by these tables
+ * instead of code.  Each IP version lists the opcodes whose layout it
+ * introduces or changes, decode_pkt3_gfxN() consults its own table
+ * first and otherwise falls back to its switch and then to the previous
+ * version, so an opcode uses the newest layout at or below the IP version.
+ */
+
+// bits [lo, hi) of payload word 'word', shifted left by 'shift'
+struct pm4_field {
+	const char *name;
+	uint8_t word, lo, hi, shift, radix;
+	char **strs; // optional names indexed by the value
+};
+
+#define PM4_FIELDS(...) ((const struct pm4_field[]){ __VA_ARGS__ { NULL, 0, 0, 0, 0, 0, NULL } })
+
+static const struct pm4_field *const pm4_gfx8_fields[256] = {
+	[0x12] = PM4_FIELDS(), // CLEAR_STATE
+	[0x15] = PM4_FIELDS( // DISPATCH_DIRECT
+		{ "DIM_X", 0, 0, 32, 0, 10, NULL },
+		{ "DIM_Y", 1, 0, 32, 0, 10, NULL },
+		{ "DIM_Z", 2, 0, 32, 0, 10, NULL },
+	),
+	[0x1D] = PM4_FIELDS(), // ATOMIC_GDS
+	[0x1E] = PM4_FIELDS(), // ATOMIC_MEM
+	[0x22] = PM4_FIELDS( // COND_EXEC
+		{ "GPU_ADDR_LO32", 0, 2, 32, 2, 16, NULL },
+		{ "GPU_ADDR_HI32", 1, 0, 32, 0, 16, NULL },
+		{ "COMMAND", 2, 28, 32, 0, 10, NULL },
+		{ "EXEC_COUNT", 3, 0, 14, 0, 10, NULL },
+	),
+	[0x27] = PM4_FIELDS( // DRAW_INDEX_2
+		{ "MAX_SIZE", 0, 0, 32, 0, 10, NULL },
+		{ "INDEX_BASE_LO", 1, 0, 32, 0, 16, NULL },
+		{ "INDEX_BASE_HI", 2, 0, 32, 0, 16, NULL },
+		{ "INDEX_COUNT", 3, 0, 32, 0, 10, NULL },
+		{ "DRAW_INITIATOR", 4, 0, 32, 0, 10, NULL },
+	),
+	[0x28] = PM4_FIELDS( // CONTEXT_CONTROL
+		{ "LOAD_EN", 0, 31, 32, 0, 10, NULL },
+		{ "LOAD_CS", 0, 24, 25, 0, 10, NULL },
+		{ "LOAD_GFX", 0, 16, 17, 0, 10, NULL },
+		{ "LOAD_GLOBAL", 0, 15, 16, 0, 10, NULL },
+		{ "LOAD_MULTI", 0, 1, 2, 0, 10, NULL },
+		{ "LOAD_SINGLE", 0, 0, 1, 0, 10, NULL },
+		{ "SHADOW_EN", 1, 31, 32, 0, 10, NULL },
+		{ "SHADOW_CS", 1, 24, 25, 0, 10, NULL },
+		{ "SHADOW_GFX", 1, 16, 17, 0, 10, NULL },
+		{ "SHADOW_GLOBAL", 1, 15, 16, 0, 10, NULL },
+		{ "SHADOW_MULTI", 1, 1, 2, 0, 10, NULL },
+		{ "SHADOW_SINGLE", 1, 0, 1, 0, 10, NULL },
+	),
+	[0x2D] = PM4_FIELDS( // DRAW_INDEX_AUTO
+		{ "INDEX_COUNT", 0, 0, 32, 0, 10, NULL },
+		{ "DRAW_INITIATOR", 1, 0, 32, 0, 10, NULL },
+	),
+	[0x2F] = PM4_FIELDS( // NUM_INSTANCES
+		{ "NUM_INSTANCES", 0, 0, 32, 0, 16, NULL },
+	),
+	[0x42] = PM4_FIELDS( // PFP_SYNC_ME
+		{ "DUMMY_DATA", 0, 0, 32, 0, 16, NULL },
+	),
+	[0x47] = PM4_FIELDS( // EVENT_WRITE_EOP
+		{ "EVENT_TYPE", 0, 0, 6, 0, 10, NULL },
+		{ "EVENT_INDEX", 0, 8, 12, 0, 10, NULL },
+		{ "INV_L2", 0, 20, 21, 0, 10, NULL },
+		{ "ADDRESS_LO", 1, 2, 32, 2, 16, NULL },
+		{ "ADDRESS_HI", 2, 0, 16, 0, 16, NULL },
+		{ "DATA_SEL", 2, 29, 32, 0, 10, NULL },
+		{ "INT_SEL", 2, 24, 26, 0, 10, NULL },
+		{ "DATA_LO", 3, 0, 32, 0, 16, NULL },
+		{ "DATA_HI", 4, 0, 32, 0, 16, NULL },
+	),
+	[0x4A] = PM4_FIELDS( // PREAMBLE_CNTL
+		{ "COMMAND", 0, 28, 32, 0, 16, NULL },
+	),
+	[0x50] = PM4_FIELDS( // DMA_DATA
+		{ "ENGINE_SEL", 0, 0, 1, 0, 10, NULL },
+		{ "SRC_CACHE_POLICY", 0, 13, 15, 0, 10, NULL },
+		{ "DST_SEL", 0, 20, 22, 0, 10, NULL },
+		{ "DST_CACHE_POLICY", 0, 25, 27, 0, 10, NULL },
+		{ "SRC_SEL", 0, 29, 31, 0, 10, NULL },
+		{ "CP_SYNC", 0, 31, 32, 0, 10, NULL },
+		{ "SRC_ADDR_LO_OR_DATA", 1, 0, 32, 0, 16, NULL },
+		{ "SRC_ADDR_HI", 2, 0, 32, 0, 16, NULL },
+		{ "DST_ADDR_LO", 3, 0, 32, 0, 16, NULL },
+		{ "DST_ADDR_HI", 4, 0, 32, 0, 16, NULL },
+		{ "BYTE_COUNT", 5, 0, 21, 0, 10, NULL },
+		{ "DIS_WC", 5, 21, 22, 0, 10, NULL },
+		{ "SAS", 5, 26, 27, 0, 10, NULL },
+		{ "DAS", 5, 27, 28, 0, 10, NULL },
+		{ "SAIC", 5, 28, 29, 0, 10, NULL },
+		{ "DAIC", 5, 29, 30, 0, 10, NULL },
+		{ "RAW_WAIT", 5, 30, 31, 0, 10, NULL },
+	),
+	[0x80] = PM4_FIELDS( // LOAD_CONST_RAM
+		{ "ADDR_LO", 0, 0, 32, 0, 16, NULL },
+		{ "ADDR_HI", 1, 0, 32, 0, 16, NULL },
+		{ "NUM_DW", 2, 0, 32, 0, 16, NULL },
+		{ "START_ADDR", 3, 0, 16, 0, 16, NULL },
+		{ "CACHE_POLICY", 3, 25, 27, 0, 10, NULL },
+	),
+	[0x84] = PM4_FIELDS( // INCREMENT_CE_COUNTER
+		{ "CNTRSEL", 0, 0, 2, 0, 10, op_84_cntr_sel },
+	),
+	[0x86] = PM4_FIELDS( // WAIT_ON_CE_COUNTER
+		{ "COND_ACQUIRE_MEM", 0, 0, 1, 0, 10, NULL },
+		{ "FORCE_SYNC", 0, 1, 2, 0, 10, NULL },
+	),
+	[0x8B] = PM4_FIELDS( // SWITCH_BUFFER
+		{ "DUMMY", 0, 0, 32, 0, 16, NULL },
+	),
+	[0xA0] = PM4_FIELDS( // SET_RESOURCES
+		{ "VMID_MASK", 0, 0, 16, 0, 16, NULL },
+		{ "QUEUE_TYPE", 0, 29, 32, 0, 10, NULL },
+		{ "QUEUE_MASK_LO", 1, 0, 32, 0, 16, NULL },
+		{ "QUEUE_MASK_HI", 2, 0, 32, 0, 16, NULL },
+		{ "GWS_MASK_LO", 3, 0, 32, 0, 16, NULL },
+		{ "GWS_MASK_HI", 4, 0, 32, 0, 16, NULL },
+		{ "OAC_MASK", 5, 0, 16, 0, 16, NULL },
+		{ "GDS_HEAP_BASE", 6, 0, 6, 0, 10, NULL },
+		{ "GDS_HEAP_SIZE", 6, 11, 17, 0, 10, NULL },
+	),
+	[0xA1] = PM4_FIELDS( // PKT3_MAP_PROCESS
+		{ "PASID", 0, 0, 16, 0, 10, NULL },
+		{ "DIQ_ENABLE", 0, 24, 25, 0, 10, NULL },
+		{ "PAGE_TABLE_BASE", 1, 0, 28, 0, 16, NULL },
+		{ "SH_MEM_BASES", 2, 0, 32, 0, 16, NULL },
+		{ "SH_MEM_APE1_BASE", 3, 0, 32, 0, 16, NULL },
+		{ "SH_MEM_APE1_LIMIT", 4, 0, 32, 0, 16, NULL },
+		{ "SH_MEM_CONFIG", 5, 0, 32, 0, 16, NULL },
+		{ "GDS_ADDR_LO", 6, 0, 32, 0, 16, NULL },
+		{ "GDS_ADDR_HI", 7, 0, 32, 0, 16, NULL },
+		{ "NUM_GWS", 8, 0, 6, 0, 10, NULL },
+		{ "NUM_OAC", 8, 8, 12, 0, 10, NULL },
+		{ "GDS_SIZE", 8, 16, 22, 0, 10, NULL },
+	),
+};
+
+static const struct pm4_field *const pm4_gfx9_fields[256] = {
+	[0x12] = PM4_FIELDS( // CLEAR_STATE
+		{ "CMD", 0, 0, 4, 0, 10, NULL },
+	),
+	[0x13] = PM4_FIELDS( // INDEX_BUFFER_SIZE
+		{ "INDEX_BUFFER_SIZE", 0, 0, 32, 0, 10, NULL },
+	),
+	[0x16] = PM4_FIELDS( // DISPATCH_INDIRECT
+		{ "DATA_OFFSET", 0, 0, 32, 0, 16, NULL },
+		{ "DISPATCH_INITIATOR", 1, 0, 32, 0, 16, NULL },
+	),
+	[0x1D] = PM4_FIELDS(), // ATOMIC_GDS
+	[0x1E] = PM4_FIELDS(), // ATOMIC_MEM
+	[0x20] = PM4_FIELDS( // SET_PREDICATION
+		{ "PRED_BOOL", 0, 8, 9, 0, 16, NULL },
+		{ "HINT", 0, 12, 13, 0, 16, NULL },
+		{ "PRED_OP", 0, 16, 19, 0, 16, NULL },
+		{ "CONTINUE_BIT", 0, 31, 32, 0, 16, NULL },
+		{ "START_ADDR_LO", 1, 4, 32, 4, 16, NULL },
+		{ "START_ADDR_HI", 2, 0, 32, 0, 16, NULL },
+	),
+	[0x25] = PM4_FIELDS( // DRAW_INDEX_INDIRECT
+		{ "DATA_OFFSET", 0, 0, 32, 0, 16, NULL },
+		{ "BASE_VTX_LOC", 1, 0, 16, 0, 16, NULL },
+		{ "START_INDX_LOC", 1, 16, 32, 0, 16, NULL },
+		{ "START_INST_LOC", 2, 0, 16, 0, 16, NULL },
+		{ "START_INDX_ENABLE", 2, 28, 29, 0, 10, NULL },
+		{ "DRAW_INITIATOR", 3, 0, 32, 0, 16, NULL },
+	),
+	[0x26] = PM4_FIELDS( // INDEX_BASE
+		{ "INDEX_BASE_LO", 0, 1, 32, 1, 16, NULL },
+		{ "INDEX_BASE_HI", 1, 0, 32, 0, 16, NULL },
+	),
+	[0x38] = PM4_FIELDS( // DRAW_INDEX_INDIRECT_MULTI
+		{ "DATA_OFFSET", 0, 0, 32, 0, 16, NULL },
+		{ "BASE_VTX_LOC", 1, 0, 16, 0, 16, NULL },
+		{ "START_INDX_LOC", 1, 16, 32, 0, 16, NULL },
+		{ "START_INST_LOC", 2, 0, 16, 0, 16, NULL },
+		{ "DRAW_INDEX_LOC", 3, 0, 16, 0, 16, NULL },
+		{ "START_INDX_ENABLE", 3, 28, 29, 0, 10, NULL },
+		{ "COUNT_INDIRECT_ENABLE", 3, 30, 31, 0, 10, NULL },
+		{ "DRAW_INDEX_ENABLE", 3, 31, 32, 0, 10, NULL },
+		{ "COUNT", 4, 0, 32, 0, 16, NULL },
+		{ "COUNT_ADDR_LO", 5, 2, 32, 2, 16, NULL },
+		{ "COUNT_ADDR_HI", 6, 0, 32, 0, 16, NULL },
+		{ "STRIDE", 7, 0, 32, 0, 16, NULL },
+		{ "DRAW_INITIATOR", 8, 0, 32, 0, 16, NULL },
+	),
+	[0x50] = PM4_FIELDS( // DMA_DATA
+		{ "ENGINE_SEL", 0, 0, 1, 0, 10, NULL },
+		{ "SRC_CACHE_POLICY", 0, 13, 15, 0, 10, NULL },
+		{ "DST_SEL", 0, 20, 22, 0, 10, NULL },
+		{ "DST_CACHE_POLICY", 0, 25, 27, 0, 10, NULL },
+		{ "SRC_SEL", 0, 29, 31, 0, 10, NULL },
+		{ "CP_SYNC", 0, 31, 32, 0, 10, NULL },
+		{ "SRC_ADDR_LO_OR_DATA", 1, 0, 32, 0, 16, NULL },
+		{ "SRC_ADDR_HI", 2, 0, 32, 0, 16, NULL },
+		{ "DST_ADDR_LO", 3, 0, 32, 0, 16, NULL },
+		{ "DST_ADDR_HI", 4, 0, 32, 0, 16, NULL },
+		{ "BYTE_COUNT", 5, 0, 26, 0, 10, NULL },
+		{ "SAS", 5, 26, 27, 0, 10, NULL },
+		{ "DAS", 5, 27, 28, 0, 10, NULL },
+		{ "SAIC", 5, 28, 29, 0, 10, NULL },
+		{ "DAIC", 5, 29, 30, 0, 10, NULL },
+		{ "RAW_WAIT", 5, 30, 31, 0, 10, NULL },
+		{ "DIS_WC", 5, 31, 32, 0, 10, NULL },
+	),
+	[0x5D] = PM4_FIELDS( // PRIME_UTCL2
+		{ "CACHE_PERM", 0, 0, 3, 0, 10, NULL },
+		{ "PRIME_MODE", 0, 3, 4, 0, 10, NULL },
+		{ "ENGINE_SEL", 0, 30, 32, 0, 10, NULL },
+		{ "ADDR_LO", 1, 0, 32, 0, 16, NULL },
+		{ "ADDR_HI", 2, 0, 32, 0, 16, NULL },
+		{ "REQUESTED_PAGES", 3, 0, 14, 0, 10, NULL },
+	),
+	[0x86] = PM4_FIELDS( // WAIT_ON_CE_COUNTER
+		{ "COND_ACQUIRE_MEM", 0, 0, 1, 0, 10, NULL },
+		{ "FORCE_SYNC", 0, 1, 2, 0, 10, NULL },
+		{ "MEM_VOLATILE", 0, 27, 28, 0, 10, NULL },
+	),
+	[0x8B] = PM4_FIELDS( // SWITCH_BUFFER
+		{ "TMZ", 0, 0, 1, 0, 16, NULL },
+	),
+	[0x90] = PM4_FIELDS( // FRAME_CONTROL
+		{ "TMZ", 0, 0, 1, 0, 10, NULL },
+		{ "COMMAND", 0, 28, 32, 0, 10, NULL },
+	),
+	[0x91] = PM4_FIELDS( // INDEX_ATTRIBUTES_INDIRECT
+		{ "ATTRIBUTE_BASE_LO", 0, 4, 32, 4, 16, NULL },
+		{ "ATTRIBUTE_BASE_HI", 1, 0, 32, 0, 16, NULL },
+		{ "ATTRIBUTE_INDEX", 2, 0, 16, 0, 10, NULL },
+	),
+	[0x95] = PM4_FIELDS( // HDP_FLUSH
+		{ "DUMMY", 0, 0, 32, 0, 16, NULL },
+	),
+	[0x9A] = PM4_FIELDS( // DMA_DATA_FILL_MULTI
+		{ "ENGINE_SEL", 0, 0, 1, 0, 10, NULL },
+		{ "MEMLOG_CLEAR", 0, 10, 11, 0, 10, NULL },
+		{ "DST_SEL", 0, 20, 22, 0, 10, NULL },
+		{ "DST_CACHE_POLICY", 0, 25, 27, 0, 10, NULL },
+		{ "SRC_SEL", 0, 29, 31, 0, 10, NULL },
+		{ "CP_SYNC", 0, 31, 32, 0, 10, NULL },
+		{ "BYTE_STRIDE", 1, 0, 32, 0, 10, NULL },
+		{ "DMA_COUNT", 2, 0, 32, 0, 10, NULL },
+		{ "DST_ADDR_LO", 3, 0, 32, 0, 16, NULL },
+		{ "DST_ADDR_HI", 4, 0, 32, 0, 16, NULL },
+		{ "BYTE_COUNT", 5, 0, 26, 0, 10, NULL },
+	),
+	[0xA1] = PM4_FIELDS( // PKT3_MAP_PROCESS
+		{ "PASID", 0, 0, 16, 0, 10, NULL },
+		{ "DEBUG_VMID", 0, 18, 22, 0, 10, NULL },
+		{ "DEBUG_FLAG", 0, 22, 23, 0, 10, NULL },
+		{ "TMZ", 0, 23, 24, 0, 10, NULL },
+		{ "DIQ_ENABLE", 0, 24, 25, 0, 10, NULL },
+		{ "PROCESS_QUANTUM", 0, 25, 32, 0, 10, NULL },
+		{ "VM_CONTEXT_PAGE_TABLE_BASE_ADDR_LO32", 1, 0, 32, 0, 16, NULL },
+		{ "VM_CONTEXT_PAGE_TABLE_BASE_ADDR_HI32", 2, 0, 32, 0, 16, NULL },
+		{ "SH_MEM_BASES", 3, 0, 32, 0, 16, NULL },
+		{ "SH_MEM_CONFIG", 4, 0, 32, 0, 16, NULL },
+		{ "SQ_SHADER_TBA_LO", 5, 0, 32, 0, 16, NULL },
+		{ "SQ_SHADER_TBA_HI", 6, 0, 32, 0, 16, NULL },
+		{ "SQ_SHADER_TMA_LO", 7, 0, 32, 0, 16, NULL },
+		{ "SQ_SHADER_TMA_HI", 8, 0, 32, 0, 16, NULL },
+		{ "GDS_ADDR_LO", 10, 0, 32, 0, 16, NULL },
+		{ "GDS_ADDR_HI", 11, 0, 32, 0, 16, NULL },
+		{ "NUM_GWS", 12, 0, 6, 0, 10, NULL },
+		{ "SDMA_ENABLE", 12, 7, 8, 0, 10, NULL },
+		{ "NUM_OAC", 12, 8, 12, 0, 10, NULL },
+		{ "GDS_SIZE", 12, 16, 22, 0, 10, NULL },
+		{ "NUM_QUEUES", 12, 22, 32, 0, 10, NULL },
+		{ "COMPLETION_SIGNAL_LO32", 13, 0, 32, 0, 16, NULL },
+		{ "COMPLETION_SIGNAL_HI32", 14, 0, 32, 0, 16, NULL },
+	),
+};
+
+static const struct pm4_field *const pm4_gfx10_fields[256] = {
+	[0x1D] = PM4_FIELDS(), // ATOMIC_GDS
+	[0x1E] = PM4_FIELDS(), // ATOMIC_MEM
+	[0x25] = PM4_FIELDS( // DRAW_INDEX_INDIRECT
+		{ "DATA_OFFSET", 0, 0, 32, 0, 16, NULL },
+		{ "BASE_VTX_LOC", 1, 0, 16, 0, 16, NULL },
+		{ "START_INDX_LOC", 1, 16, 32, 0, 16, NULL },
+		{ "START_INST_LOC", 2, 0, 16, 0, 16, NULL },
+		{ "DISABLE_CPVGTDMA_SM", 2, 26, 27, 0, 10, NULL },
+		{ "START_INDX_ENABLE", 2, 28, 29, 0, 10, NULL },
+		{ "DRAW_INITIATOR", 3, 0, 32, 0, 16, NULL },
+	),
+	[0x38] = PM4_FIELDS( // DRAW_INDEX_INDIRECT_MULTI
+		{ "DATA_OFFSET", 0, 0, 32, 0, 16, NULL },
+		{ "BASE_VTX_LOC", 1, 0, 16, 0, 16, NULL },
+		{ "START_INDX_LOC", 1, 16, 32, 0, 16, NULL },
+		{ "START_INST_LOC", 2, 0, 16, 0, 16, NULL },
+		{ "DRAW_INDEX_LOC", 3, 0, 16, 0, 16, NULL },
+		{ "DISABLE_CPVGTDMA_SM", 3, 26, 27, 0, 10, NULL },
+		{ "USE_VGPRS", 3, 27, 28, 0, 10, NULL },
+		{ "START_INDX_ENABLE", 3, 28, 29, 0, 10, NULL },
+		{ "THREAD_TRACE_MARKER_ENABLE", 3, 29, 30, 0, 10, NULL },
+		{ "COUNT_INDIRECT_ENABLE", 3, 30, 31, 0, 10, NULL },
+		{ "DRAW_INDEX_ENABLE", 3, 31, 32, 0, 10, NULL },
+		{ "COUNT", 4, 0, 32, 0, 16, NULL },
+		{ "COUNT_ADDR_LO", 5, 2, 32, 2, 16, NULL },
+		{ "COUNT_ADDR_HI", 6, 0, 32, 0, 16, NULL },
+		{ "STRIDE", 7, 0, 32, 0, 16, NULL },
+		{ "DRAW_INITIATOR", 8, 0, 32, 0, 16, NULL },
+	),
+	[0x42] = PM4_FIELDS( // PFP_SYNC_ME
+		{ "DUMMY_DATA", 0, 0, 32, 0, 16, NULL },
+	),
+	[0x47] = PM4_FIELDS( // EVENT_WRITE_EOP
+		{ "EVENT_TYPE", 0, 0, 6, 0, 10, NULL },
+		{ "EVENT_INDEX", 0, 8, 12, 0, 10, NULL },
+		{ "INV_L2", 0, 20, 21, 0, 10, NULL },
+		{ "ADDRESS_LO", 1, 2, 32, 2, 16, NULL },
+		{ "ADDRESS_HI", 2, 0, 16, 0, 16, NULL },
+		{ "DATA_SEL", 2, 29, 32, 0, 10, NULL },
+		{ "INT_SEL", 2, 24, 26, 0, 10, NULL },
+		{ "DATA_LO", 3, 0, 32, 0, 16, NULL },
+		{ "DATA_HI", 4, 0, 32, 0, 16, NULL },
+	),
+	[0x4A] = PM4_FIELDS( // PREAMBLE_CNTL
+		{ "COMMAND", 0, 28, 32, 0, 16, NULL },
+	),
+	[0x86] = PM4_FIELDS( // WAIT_ON_CE_COUNTER
+		{ "COND_ACQUIRE_MEM", 0, 0, 1, 0, 10, NULL },
+		{ "FORCE_SYNC", 0, 1, 2, 0, 10, NULL },
+	),
+	[0x8B] = PM4_FIELDS( // SWITCH_BUFFER
+		{ "DUMMY", 0, 0, 32, 0, 16, NULL },
+	),
+	[0xB0] = PM4_FIELDS( // DISPATCH_NODES
+		{ "SHADER_DIR_ADDR_LO", 0, 0, 32, 0, 16, NULL },
+		{ "SHADER_DIR_ADDR_HI", 1, 0, 16, 0, 16, NULL },
+		{ "ISSUE_SQTT_MARKER_EVENT", 1, 16, 17, 0, 16, NULL },
+		{ "INPUT_MODE", 1, 17, 19, 0, 16, op_b0_input_mode },
+		{ "ISSUE_GFX_EXIT_SIGNAL", 1, 19, 20, 0, 16, NULL },
+		{ "GRAPH_DATA_ADDR_LO", 2, 0, 32, 0, 16, NULL },
+		{ "GRAPH_DATA_ADDR_HI", 3, 0, 16, 0, 16, NULL },
+		{ "USER_DATA_BASE", 4, 0, 16, 0, 16, NULL },
+		{ "DISPATCH_INITIATOR", 5, 0, 32, 0, 16, NULL },
+		{ "ROOT_SHADER_ID", 6, 0, 32, 0, 16, NULL },
+		{ "INPUT_RECORDS_ADDR_LO", 7, 0, 32, 0, 16, NULL },
+		{ "INPUT_RECORDS_ADDR_HI", 8, 0, 16, 0, 16, NULL },
+		{ "INPUT_RECORDS_STRIDE", 9, 0, 32, 0, 16, NULL },
+		{ "INPUT_RECORDS_COUNT", 10, 0, 32, 0, 16, NULL },
+	),
+};
+
+static const struct pm4_field *const pm4_gfx11_fields[256] = {
+	[0x11] = PM4_FIELDS( // SET_BASE
+		{ "BASE_INDEX", 0, 0, 4, 0, 10, NULL },
+		{ "ADDRESS_LO", 1, 3, 32, 3, 16, NULL },
+		{ "ADDRESS_HI", 2, 0, 32, 0, 16, NULL },
+	),
+	[0x1D] = PM4_FIELDS(), // ATOMIC_GDS
+	[0x1E] = PM4_FIELDS(), // ATOMIC_MEM
+	[0x22] = PM4_FIELDS( // COND_EXEC
+		{ "GPU_ADDR_LO32", 0, 2, 32, 2, 16, NULL },
+		{ "GPU_ADDR_HI32", 1, 0, 32, 0, 16, NULL },
+		{ "CACHE_POLICY", 2, 25, 27, 0, 16, NULL },
+		{ "EXEC_COUNT", 3, 0, 14, 0, 16, NULL },
+	),
+	[0x38] = PM4_FIELDS( // DRAW_INDEX_INDIRECT_MULTI
+		{ "DATA_OFFSET", 0, 0, 32, 0, 16, NULL },
+		{ "BASE_VTX_LOC", 1, 0, 16, 0, 16, NULL },
+		{ "START_INDX_LOC", 1, 16, 32, 0, 16, NULL },
+		{ "START_INST_LOC", 2, 0, 16, 0, 16, NULL },
+		{ "DRAW_INDEX_LOC", 3, 0, 16, 0, 16, NULL },
+		{ "TASK_SHADER_MODE", 3, 25, 26, 0, 10, NULL },
+		{ "USE_VGPRS", 3, 27, 28, 0, 10, NULL },
+		{ "START_INDX_ENABLE", 3, 28, 29, 0, 10, NULL },
+		{ "THREAD_TRACE_MARKER_ENABLE", 3, 29, 30, 0, 10, NULL },
+		{ "COUNT_INDIRECT_ENABLE", 3, 30, 31, 0, 10, NULL },
+		{ "DRAW_INDEX_ENABLE", 3, 31, 32, 0, 10, NULL },
+		{ "COUNT", 4, 0, 32, 0, 16, NULL },
+		{ "COUNT_ADDR_LO", 5, 2, 32, 2, 16, NULL },
+		{ "COUNT_ADDR_HI", 6, 0, 32, 0, 16, NULL },
+		{ "STRIDE", 7, 0, 32, 0, 16, NULL },
+		{ "DRAW_INITIATOR", 8, 0, 32, 0, 16, NULL },
+	),
+	[0xB1] = PM4_FIELDS( // EVENT_WRITE_ZPASS
+		{ "ADDRESS_LO", 0, 3, 32, 3, 16, NULL },
+		{ "ADDRESS_HI", 1, 0, 32, 0, 16, NULL },
+	),
+};
+
+static const struct pm4_field *const pm4_gfx12_fields[256] = {
+	[0x1D] = PM4_FIELDS(), // ATOMIC_GDS
+	[0x1E] = PM4_FIELDS(), // ATOMIC_MEM
+	[0x47] = PM4_FIELDS( // EVENT_WRITE_EOP
+		{ "EVENT_TYPE", 0, 0, 6, 0, 10, NULL },
+		{ "EVENT_INDEX", 0, 8, 12, 0, 10, NULL },
+		{ "INV_L2", 0, 20, 21, 0, 10, NULL },
+		{ "ADDRESS_LO", 1, 2, 32, 2, 16, NULL },
+		{ "ADDRESS_HI", 2, 0, 16, 0, 16, NULL },
+		{ "DATA_SEL", 2, 29, 32, 0, 10, NULL },
+		{ "INT_SEL", 2, 24, 26, 0, 10, NULL },
+		{ "DATA_LO", 3, 0, 32, 0, 16, NULL },
+		{ "DATA_HI", 4, 0, 32, 0, 16, NULL },
+	),
+	[0x50] = PM4_FIELDS( // DMA_DATA
+		{ "ENGINE_SEL", 0, 0, 1, 0, 10, NULL },
+		{ "SRC_INDIRECT", 0, 1, 2, 0, 10, NULL },
+		{ "DST_INDIRECT", 0, 2, 3, 0, 10, NULL },
+		{ "SRC_TEMPORAL", 0, 13, 15, 0, 10, NULL },
+		{ "DST_SEL", 0, 20, 22, 0, 10, NULL },
+		{ "DST_TEMPORAL", 0, 25, 27, 0, 10, NULL },
+		{ "SRC_SEL", 0, 29, 31, 0, 10, NULL },
+		{ "CP_SYNC", 0, 31, 32, 0, 10, NULL },
+		{ "SRC_ADDR_LO_OR_DATA", 1, 0, 32, 0, 16, NULL },
+		{ "SRC_ADDR_HI", 2, 0, 32, 0, 16, NULL },
+		{ "DST_ADDR_LO", 3, 0, 32, 0, 16, NULL },
+		{ "DST_ADDR_HI", 4, 0, 32, 0, 16, NULL },
+		{ "BYTE_COUNT", 5, 0, 26, 0, 10, NULL },
+		{ "SAS", 5, 26, 27, 0, 10, NULL },
+		{ "DAS", 5, 27, 28, 0, 10, NULL },
+		{ "SAIC", 5, 28, 29, 0, 10, NULL },
+		{ "DAIC", 5, 29, 30, 0, 10, NULL },
+		{ "RAW_WAIT", 5, 30, 31, 0, 10, NULL },
+		{ "DIS_WC", 5, 31, 32, 0, 10, NULL },
+	),
+	[0x9A] = PM4_FIELDS( // DMA_DATA_FILL_MULTI
+		{ "ENGINE_SEL", 0, 0, 1, 0, 10, NULL },
+		{ "MEMLOG_CLEAR", 0, 10, 11, 0, 10, NULL },
+		{ "DST_SEL", 0, 20, 22, 0, 10, NULL },
+		{ "DST_TEMPORAL", 0, 25, 27, 0, 10, NULL },
+		{ "SRC_SEL", 0, 29, 31, 0, 10, NULL },
+		{ "CP_SYNC", 0, 31, 32, 0, 10, NULL },
+		{ "BYTE_STRIDE", 1, 0, 32, 0, 10, NULL },
+		{ "DMA_COUNT", 2, 0, 32, 0, 10, NULL },
+		{ "DST_ADDR_LO", 3, 0, 32, 0, 16, NULL },
+		{ "DST_ADDR_HI", 4, 0, 32, 0, 16, NULL },
+		{ "BYTE_COUNT", 5, 0, 26, 0, 10, NULL },
+	),
+	[0xA7] = PM4_FIELDS( // DISPATCH_DIRECT_INTERLEAVED
+		{ "DIM_X", 0, 0, 32, 0, 10, NULL },
+		{ "DIM_Y", 1, 0, 16, 0, 10, NULL },
+		{ "DIM_Z", 2, 0, 16, 0, 10, NULL },
+		{ "DISPATCH_INITIATOR", 3, 0, 32, 0, 16, NULL },
+	),
+	[0xEF] = PM4_FIELDS( // UPDATE_DB_SUMMARIZER_TIMEOUTS
+		{ "REG_VALUE", 0, 0, 32, 0, 16, NULL },
+	),
+};
+/**
+ * decode_fields - Decode a packet described by a field table
+ *
+ * @fields: The fields of the packet or NULL if it has no table entry
+ *
+ * Returns 1 if the packet was decoded, 0 if it has no table entry.
+ */
+static int decode_fields(struct umr_asic *asic, struct umr_stream_decode_ui *ui, struct umr_pm4_stream *stream,
+			 uint64_t ib_addr, uint32_t ib_vmid, const struct pm4_field *fields)
+{
+	const struct pm4_field *f;
+	uint64_t v;
+
+	if (!fields)
+		return 0;
+	for (f = fields; f->name; f++) {
+		v = BITS(fetch_word(asic, stream, f->word), f->lo, f->hi) << f->shift;
+		ui->add_field(ui, ib_addr + 4 * (f->word + 1), ib_vmid, f->name, v, f->strs ? f->strs[v] : NULL, f->radix, 32);
+	}
+	return 1;
+}
+
 static void decode_pkt0(struct umr_asic *asic, struct umr_stream_decode_ui *ui, struct umr_pm4_stream *stream, uint64_t ib_addr, uint32_t ib_vmid)
 {
 	uint32_t n;
@@ -466,6 +931,9 @@ static void load_X_reg(struct umr_asic *asic, struct umr_stream_decode_ui *ui, s
 
 static void decode_pkt3_gfx8(struct umr_asic *asic, struct umr_stream_decode_ui *ui, struct umr_pm4_stream *stream, uint64_t ib_addr, uint32_t ib_vmid)
 {
+	if (decode_fields(asic, ui, stream, ib_addr, ib_vmid, pm4_gfx8_fields[stream->opcode]))
+		return;
+
 	switch (stream->opcode) {
 		case 0x10: // NOP
 			if (stream->n_words == 0)
@@ -495,53 +963,6 @@ static void decode_pkt3_gfx8(struct umr_asic *asic, struct umr_stream_decode_ui
 				}
 			}
 			break;
-		case 0x12: // CLEAR_STATE
-			break;
-		case 0x15: // DISPATCH_DIRECT
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DIM_X", fetch_word(asic, stream, 0), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "DIM_Y", fetch_word(asic, stream, 1), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "DIM_Z", fetch_word(asic, stream, 2), NULL, 10, 32);
-			break;
-		case 0x1d: // ATOMIC_GDS
-			// TODO: fill in
-			break;
-		case 0x1e: // ATOMIC_MEM
-			// TODO: fill in
-			break;
-		case 0x22: // COND_EXEC
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "GPU_ADDR_LO32", BITS(fetch_word(asic, stream, 0), 2, 32) << 2, NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "GPU_ADDR_HI32", fetch_word(asic, stream, 1), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "COMMAND", BITS(fetch_word(asic, stream, 2), 28, 32), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "EXEC_COUNT", BITS(fetch_word(asic, stream, 3), 0, 14), NULL, 10, 32);
-			break;
-		case 0x27: // DRAW_INDEX_2
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "MAX_SIZE", fetch_word(asic, stream, 0), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "INDEX_BASE_LO", fetch_word(asic, stream, 1), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "INDEX_BASE_HI", fetch_word(asic, stream, 2), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "INDEX_COUNT", fetch_word(asic, stream, 3), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 20, ib_vmid, "DRAW_INITIATOR", fetch_word(asic, stream, 4), NULL, 10, 32);
-			break;
-		case 0x28: // CONTEXT_CONTROL
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "LOAD_EN", BITS(fetch_word(asic, stream, 0), 31, 32), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "LOAD_CS", BITS(fetch_word(asic, stream, 0), 24, 25), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "LOAD_GFX", BITS(fetch_word(asic, stream, 0), 16, 17), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "LOAD_GLOBAL", BITS(fetch_word(asic, stream, 0), 15, 16), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "LOAD_MULTI", BITS(fetch_word(asic, stream, 0), 1, 2), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "LOAD_SINGLE", BITS(fetch_word(asic, stream, 0), 0, 1), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "SHADOW_EN", BITS(fetch_word(asic, stream, 1), 31, 32), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "SHADOW_CS", BITS(fetch_word(asic, stream, 1), 24, 25), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "SHADOW_GFX", BITS(fetch_word(asic, stream, 1), 16, 17), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "SHADOW_GLOBAL", BITS(fetch_word(asic, stream, 1), 15, 16), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "SHADOW_MULTI", BITS(fetch_word(asic, stream, 1), 1, 2), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "SHADOW_SINGLE", BITS(fetch_word(asic, stream, 1), 0, 1), NULL, 10, 32);
-			break;
-		case 0x2D: // DRAW_INDEX_AUTO
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "INDEX_COUNT", fetch_word(asic, stream, 0), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "DRAW_INITIATOR", fetch_word(asic, stream, 1), NULL, 10, 32);
-			break;
-		case 0x2F: // NUM_INSTANCES
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "NUM_INSTANCES", fetch_word(asic, stream, 0), NULL, 16, 32);
-			break;
 		case 0x33: // INDIRECT_BUFFER_CONST
 		case 0x3F: // INDIRECT_BUFFER_CIK
 			if (stream->opcode == 0x3F && stream->n_words == 13) {
@@ -630,9 +1051,6 @@ static void decode_pkt3_gfx8(struct umr_asic *asic, struct umr_stream_decode_ui
 			}
 			ui->add_field(ui, ib_addr + 20, ib_vmid, "DST_ADDR_HI", fetch_word(asic, stream, 4), NULL, 16, 32);
 			break;
-		case 0x42: // PFP_SYNC_ME
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DUMMY_DATA", fetch_word(asic, stream, 0), NULL, 16, 32);
-			break;
 		case 0x43: // SURFACE_SYNC
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "ENGINE", BITS(fetch_word(asic, stream, 0), 31, 32), BITS(fetch_word(asic, stream, 0), 31, 32) ? "ME" : "PFP", 10, 32);
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "COHER_CNTL", BITS(fetch_word(asic, stream, 0), 0, 29), NULL, 10, 32);
@@ -648,17 +1066,6 @@ static void decode_pkt3_gfx8(struct umr_asic *asic, struct umr_stream_decode_ui
 				ui->add_field(ui, ib_addr + 12, ib_vmid, "ADDRESS_HI", fetch_word(asic, stream, 2), NULL, 16, 32);
 			}
 			break;
-		case 0x47: // EVENT_WRITE_EOP
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "EVENT_TYPE", BITS(fetch_word(asic, stream, 0), 0, 6), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "EVENT_INDEX", BITS(fetch_word(asic, stream, 0), 8, 12), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "INV_L2", BITS(fetch_word(asic, stream, 0), 20, 21), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "ADDRESS_LO", BITS(fetch_word(asic, stream, 1), 2, 32) << 2, NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "ADDRESS_HI", BITS(fetch_word(asic, stream, 2), 0, 16), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "DATA_SEL", BITS(fetch_word(asic, stream, 2), 29, 32), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "INT_SEL", BITS(fetch_word(asic, stream, 2), 24, 26), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "DATA_LO", fetch_word(asic, stream, 3), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 20, ib_vmid, "DATA_HI", fetch_word(asic, stream, 4), NULL, 16, 32);
-			break;
 		case 0x49: // RELEASE_MEM
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "EVENT_TYPE", BITS(fetch_word(asic, stream, 0), 0, 6), vgt_event_decode(BITS(fetch_word(asic, stream, 0), 0, 6)), 10, 32);
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "EVENT_INDEX", BITS(fetch_word(asic, stream, 0), 8, 12), NULL, 10, 32);
@@ -679,28 +1086,6 @@ static void decode_pkt3_gfx8(struct umr_asic *asic, struct umr_stream_decode_ui
 			ui->add_field(ui, ib_addr + 20, ib_vmid, "DATA_LO", fetch_word(asic, stream, 4), NULL, 16, 32);
 			ui->add_field(ui, ib_addr + 24, ib_vmid, "DATA_HI", fetch_word(asic, stream, 5), NULL, 16, 32);
 			break;
-		case 0x4A: // PREAMBLE_CNTL
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "COMMAND", BITS(fetch_word(asic, stream, 0), 28, 32), NULL, 16, 32);
-			break;
-		case 0x50: // DMA_DATA
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "ENGINE_SEL", BITS(fetch_word(asic, stream, 0), 0, 1), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "SRC_CACHE_POLICY", BITS(fetch_word(asic, stream, 0), 13, 15), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DST_SEL", BITS(fetch_word(asic, stream, 0), 20, 22), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DST_CACHE_POLICY", BITS(fetch_word(asic, stream, 0), 25, 27), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "SRC_SEL", BITS(fetch_word(asic, stream, 0), 29, 31), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "CP_SYNC", BITS(fetch_word(asic, stream, 0), 31, 32), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "SRC_ADDR_LO_OR_DATA", fetch_word(asic, stream, 1), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "SRC_ADDR_HI", fetch_word(asic, stream, 2), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "DST_ADDR_LO", fetch_word(asic, stream, 3), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 20, ib_vmid, "DST_ADDR_HI", fetch_word(asic, stream, 4), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "BYTE_COUNT", BITS(fetch_word(asic, stream, 5), 0, 21), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "DIS_WC", BITS(fetch_word(asic, stream, 5), 21, 22), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "SAS", BITS(fetch_word(asic, stream, 5), 26, 27), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "DAS", BITS(fetch_word(asic, stream, 5), 27, 28), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "SAIC", BITS(fetch_word(asic, stream, 5), 28, 29), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "DAIC", BITS(fetch_word(asic, stream, 5), 29, 30), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "RAW_WAIT", BITS(fetch_word(asic, stream, 5), 30, 31), NULL, 10, 32);
-			break;
 		case 0x58: // ACQUIRE_MEM
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "ENGINE", BITS(fetch_word(asic, stream, 0), 31, 32), BITS(fetch_word(asic, stream, 0), 31, 32) ? "ME" : "PFP", 10, 32);
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "COHER_CNTL", BITS(fetch_word(asic, stream, 0), 0, 30), NULL, 10, 32);
@@ -780,13 +1165,6 @@ static void decode_pkt3_gfx8(struct umr_asic *asic, struct umr_stream_decode_ui
 				}
 			}
 			break;
-		case 0x80: // LOAD_CONST_RAM
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "ADDR_LO", fetch_word(asic, stream, 0), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "ADDR_HI", fetch_word(asic, stream, 1), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "NUM_DW", fetch_word(asic, stream, 2), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "START_ADDR", BITS(fetch_word(asic, stream, 3), 0, 16), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "CACHE_POLICY", BITS(fetch_word(asic, stream, 3), 25, 27), NULL, 10, 32);
-			break;
 		case 0x81: // WRITE_CONST_RAM
 			{
 				uint32_t addr = BITS(fetch_word(asic, stream, 0), 0, 16);
@@ -806,16 +1184,6 @@ static void decode_pkt3_gfx8(struct umr_asic *asic, struct umr_stream_decode_ui
 			ui->add_field(ui, ib_addr + 12, ib_vmid, "ADDR_LO", fetch_word(asic, stream, 2), NULL, 16, 32);
 			ui->add_field(ui, ib_addr + 16, ib_vmid, "ADDR_HI", fetch_word(asic, stream, 3), NULL, 16, 32);
 			break;
-		case 0x84: // INCREMENT_CE_COUNTER
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "CNTRSEL", BITS(fetch_word(asic, stream, 0), 0, 2), op_84_cntr_sel[BITS(fetch_word(asic, stream, 0), 0, 2)], 10, 32);
-			break;
-		case 0x86: // WAIT_ON_CE_COUNTER
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "COND_ACQUIRE_MEM", BITS(fetch_word(asic, stream, 0), 0, 1), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "FORCE_SYNC", BITS(fetch_word(asic, stream, 0), 1, 2), NULL, 10, 32);
-			break;
-		case 0x8B: // SWITCH_BUFFER
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DUMMY", fetch_word(asic, stream, 0), NULL, 16, 32);
-			break;
 		case 0x9B: // SET_SH_REG_INDEX
 			{
 				uint64_t addr = BITS(fetch_word(asic, stream, 0), 0, 16) + 0x2C00;
@@ -849,31 +1217,6 @@ static void decode_pkt3_gfx8(struct umr_asic *asic, struct umr_stream_decode_ui
 				}
 			}
 			break;
-		case 0xA0: // SET_RESOURCES
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "VMID_MASK", BITS(fetch_word(asic, stream, 0), 0, 16), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "QUEUE_TYPE", BITS(fetch_word(asic, stream, 0), 29, 32), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "QUEUE_MASK_LO", fetch_word(asic, stream, 1), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "QUEUE_MASK_HI", fetch_word(asic, stream, 2), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "GWS_MASK_LO", fetch_word(asic, stream, 3), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 20, ib_vmid, "GWS_MASK_HI", fetch_word(asic, stream, 4), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "OAC_MASK", BITS(fetch_word(asic, stream, 5), 0, 16), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 28, ib_vmid, "GDS_HEAP_BASE", BITS(fetch_word(asic, stream, 6), 0, 6), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 28, ib_vmid, "GDS_HEAP_SIZE", BITS(fetch_word(asic, stream, 6), 11, 17), NULL, 10, 32);
-			break;
-		case 0xA1: // PKT3_MAP_PROCESS
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "PASID", BITS(fetch_word(asic, stream, 0), 0, 16), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DIQ_ENABLE", BITS(fetch_word(asic, stream, 0), 24, 25), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "PAGE_TABLE_BASE", BITS(fetch_word(asic, stream, 1), 0, 28), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "SH_MEM_BASES", fetch_word(asic, stream, 2), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "SH_MEM_APE1_BASE", fetch_word(asic, stream, 3), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 20, ib_vmid, "SH_MEM_APE1_LIMIT", fetch_word(asic, stream, 4), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "SH_MEM_CONFIG", fetch_word(asic, stream, 5), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 28, ib_vmid, "GDS_ADDR_LO", fetch_word(asic, stream, 6), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 32, ib_vmid, "GDS_ADDR_HI", fetch_word(asic, stream, 7), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 36, ib_vmid, "NUM_GWS", BITS(fetch_word(asic, stream, 8), 0, 6), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 36, ib_vmid, "NUM_OAC", BITS(fetch_word(asic, stream, 8), 8, 12), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 36, ib_vmid, "GDS_SIZE", BITS(fetch_word(asic, stream, 8), 16, 22), NULL, 10, 32);
-			break;
 		case 0xA2: // PKT3_MAP_QUEUES
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "QUEUE_SEL", BITS(fetch_word(asic, stream, 0), 4, 6), NULL, 10, 32);
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "VMID", BITS(fetch_word(asic, stream, 0), 8, 12), NULL, 10, 32);
@@ -951,6 +1294,9 @@ static void decode_pkt3_gfx8(struct umr_asic *asic, struct umr_stream_decode_ui
 
 static void decode_pkt3_gfx9(struct umr_asic *asic, struct umr_stream_decode_ui *ui, struct umr_pm4_stream *stream, uint64_t ib_addr, uint32_t ib_vmid)
 {
+	if (decode_fields(asic, ui, stream, ib_addr, ib_vmid, pm4_gfx9_fields[stream->opcode]))
+		return;
+
 	switch (stream->opcode) {
 		case 0x11: // SET_BASE
 			{
@@ -965,42 +1311,6 @@ static void decode_pkt3_gfx9(struct umr_asic *asic, struct umr_stream_decode_ui
 				}
 			}
 			break;
-		case 0x12: // CLEAR_STATE
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "CMD", BITS(fetch_word(asic, stream, 0), 0, 4), NULL, 10, 32);
-			break;
-		case 0x13: // INDEX_BUFFER_SIZE
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "INDEX_BUFFER_SIZE", fetch_word(asic, stream, 0), NULL, 10, 32);
-			break;
-		case 0x16: // DISPATCH_INDIRECT
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DATA_OFFSET", fetch_word(asic, stream, 0), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "DISPATCH_INITIATOR", fetch_word(asic, stream, 1), NULL, 16, 32);
-			break;
-		case 0x1d: // ATOMIC_GDS
-			// TODO: fill in
-			break;
-		case 0x1e: // ATOMIC_MEM
-			// TODO: fill in
-			break;
-		case 0x20: // SET_PREDICATION
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "PRED_BOOL", BITS(fetch_word(asic, stream, 0), 8, 9), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "HINT", BITS(fetch_word(asic, stream, 0), 12, 13), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "PRED_OP", BITS(fetch_word(asic, stream, 0), 16, 19), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "CONTINUE_BIT", BITS(fetch_word(asic, stream, 0), 31, 32), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "START_ADDR_LO", BITS(fetch_word(asic, stream, 1), 4, 32) << 4, NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "START_ADDR_HI", fetch_word(asic, stream, 2), NULL, 16, 32);
-			break;
-		case 0x25: // DRAW_INDEX_INDIRECT
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DATA_OFFSET", fetch_word(asic, stream, 0), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "BASE_VTX_LOC", BITS(fetch_word(asic, stream, 1), 0, 16), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "START_INDX_LOC", BITS(fetch_word(asic, stream, 1), 16, 32), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "START_INST_LOC", BITS(fetch_word(asic, stream, 2), 0, 16), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "START_INDX_ENABLE", BITS(fetch_word(asic, stream, 2), 28, 29), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "DRAW_INITIATOR", fetch_word(asic, stream, 3), NULL, 16, 32);
-			break;
-		case 0x26: // INDEX_BASE
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "INDEX_BASE_LO", BITS(fetch_word(asic, stream, 0), 1, 32) << 1, NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "INDEX_BASE_HI", fetch_word(asic, stream, 1), NULL, 16, 32);
-			break;
 		case 0x37: // WRITE_DATA
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "ENGINE", BITS(fetch_word(asic, stream, 0), 30, 32), op_37_engines[BITS(fetch_word(asic, stream, 0), 30, 32)], 10, 32);
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "CACHE_POLICY", BITS(fetch_word(asic, stream, 0), 25, 27), NULL, 10, 32);
@@ -1019,21 +1329,6 @@ static void decode_pkt3_gfx9(struct umr_asic *asic, struct umr_stream_decode_ui
 				}
 			}
 			break;
-		case 0x38: // DRAW_INDEX_INDIRECT_MULTI
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DATA_OFFSET", fetch_word(asic, stream, 0), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "BASE_VTX_LOC", BITS(fetch_word(asic, stream, 1), 0, 16), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "START_INDX_LOC", BITS(fetch_word(asic, stream, 1), 16, 32), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "START_INST_LOC", BITS(fetch_word(asic, stream, 2), 0, 16), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "DRAW_INDEX_LOC", BITS(fetch_word(asic, stream, 3), 0, 16), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "START_INDX_ENABLE", BITS(fetch_word(asic, stream, 3), 28, 29), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "COUNT_INDIRECT_ENABLE", BITS(fetch_word(asic, stream, 3), 30, 31), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "DRAW_INDEX_ENABLE", BITS(fetch_word(asic, stream, 3), 31, 32), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 20, ib_vmid, "COUNT", fetch_word(asic, stream, 4), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "COUNT_ADDR_LO", BITS(fetch_word(asic, stream, 5), 2, 32) << 2, NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 28, ib_vmid, "COUNT_ADDR_HI", fetch_word(asic, stream, 6), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 32, ib_vmid, "STRIDE", fetch_word(asic, stream, 7), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 36, ib_vmid, "DRAW_INITIATOR", fetch_word(asic, stream, 8), NULL, 16, 32);
-			break;
 		case 0x46: // EVENT_WRITE
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "EVENT_TYPE", BITS(fetch_word(asic, stream, 0), 0, 6), NULL, 10, 32);
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "EVENT_INDEX", BITS(fetch_word(asic, stream, 0), 8, 12), NULL, 10, 32);
@@ -1099,38 +1394,11 @@ static void decode_pkt3_gfx9(struct umr_asic *asic, struct umr_stream_decode_ui
 			if (asic->family >= FAMILY_AI)
 				ui->add_field(ui, ib_addr + 28, ib_vmid, "INT_CTXID", fetch_word(asic, stream, 6), NULL, 16, 32);
 			break;
-		case 0x50: // DMA_DATA
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "ENGINE_SEL", BITS(fetch_word(asic, stream, 0), 0, 1), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "SRC_CACHE_POLICY", BITS(fetch_word(asic, stream, 0), 13, 15), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DST_SEL", BITS(fetch_word(asic, stream, 0), 20, 22), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DST_CACHE_POLICY", BITS(fetch_word(asic, stream, 0), 25, 27), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "SRC_SEL", BITS(fetch_word(asic, stream, 0), 29, 31), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "CP_SYNC", BITS(fetch_word(asic, stream, 0), 31, 32), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "SRC_ADDR_LO_OR_DATA", fetch_word(asic, stream, 1), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "SRC_ADDR_HI", fetch_word(asic, stream, 2), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "DST_ADDR_LO", fetch_word(asic, stream, 3), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 20, ib_vmid, "DST_ADDR_HI", fetch_word(asic, stream, 4), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "BYTE_COUNT", BITS(fetch_word(asic, stream, 5), 0, 26), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "SAS", BITS(fetch_word(asic, stream, 5), 26, 27), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "DAS", BITS(fetch_word(asic, stream, 5), 27, 28), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "SAIC", BITS(fetch_word(asic, stream, 5), 28, 29), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "DAIC", BITS(fetch_word(asic, stream, 5), 29, 30), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "RAW_WAIT", BITS(fetch_word(asic, stream, 5), 30, 31), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "DIS_WC", BITS(fetch_word(asic, stream, 5), 31, 32), NULL, 10, 32);
-			break;
 		case 0x51: // CONTEXT_REG_RMW
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "REG", fetch_word(asic, stream, 0), umr_reg_name(asic, fetch_word(asic, stream, 0)), 16, 32);
 			ui->add_field(ui, ib_addr + 8, ib_vmid, "MASK", fetch_word(asic, stream, 1), NULL, 16, 32);
 			ui->add_field(ui, ib_addr + 12, ib_vmid, "DATA", fetch_word(asic, stream, 2), NULL, 16, 32);
 			break;
-		case 0x5D: // PRIME_UTCL2
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "CACHE_PERM", BITS(fetch_word(asic, stream, 0), 0, 3), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "PRIME_MODE", BITS(fetch_word(asic, stream, 0), 3, 4), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "ENGINE_SEL", BITS(fetch_word(asic, stream, 0), 30, 32), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "ADDR_LO", fetch_word(asic, stream, 1), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "ADDR_HI", fetch_word(asic, stream, 2), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "REQUESTED_PAGES", BITS(fetch_word(asic, stream, 3), 0, 14), NULL, 10, 32);
-			break;
 		case 0x81: // WRITE_CONST_RAM
 			{
 				uint32_t addr = BITS(fetch_word(asic, stream, 0), 0, 16);
@@ -1143,65 +1411,6 @@ static void decode_pkt3_gfx9(struct umr_asic *asic, struct umr_stream_decode_ui
 				}
 			}
 			break;
-		case 0x86: // WAIT_ON_CE_COUNTER
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "COND_ACQUIRE_MEM", BITS(fetch_word(asic, stream, 0), 0, 1), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "FORCE_SYNC", BITS(fetch_word(asic, stream, 0), 1, 2), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "MEM_VOLATILE", BITS(fetch_word(asic, stream, 0), 27, 28), NULL, 10, 32);
-			break;
-		case 0x8B: // SWITCH_BUFFER
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "TMZ", BITS(fetch_word(asic, stream, 0), 0, 1), NULL, 16, 32);
-			break;
-		case 0x90: // FRAME_CONTROL
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "TMZ", BITS(fetch_word(asic, stream, 0), 0, 1), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "COMMAND", BITS(fetch_word(asic, stream, 0), 28, 32), NULL, 10, 32);
-			break;
-		case 0x91: // INDEX_ATTRIBUTES_INDIRECT
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "ATTRIBUTE_BASE_LO", BITS(fetch_word(asic, stream, 0), 4, 32) << 4, NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "ATTRIBUTE_BASE_HI", fetch_word(asic, stream, 1), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "ATTRIBUTE_INDEX", BITS(fetch_word(asic, stream, 2), 0, 16), NULL, 10, 32);
-			break;
-		case 0x95: // HDP_FLUSH
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DUMMY", fetch_word(asic, stream, 0), NULL, 16, 32);
-			break;
-		case 0x9A: // DMA_DATA_FILL_MULTI
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "ENGINE_SEL", BITS(fetch_word(asic, stream, 0), 0, 1), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "MEMLOG_CLEAR", BITS(fetch_word(asic, stream, 0), 10, 11), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DST_SEL", BITS(fetch_word(asic, stream, 0), 20, 22), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DST_CACHE_POLICY", BITS(fetch_word(asic, stream, 0), 25, 27), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "SRC_SEL", BITS(fetch_word(asic, stream, 0), 29, 31), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "CP_SYNC", BITS(fetch_word(asic, stream, 0), 31, 32), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "BYTE_STRIDE", fetch_word(asic, stream, 1), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "DMA_COUNT", fetch_word(asic, stream, 2), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "DST_ADDR_LO", fetch_word(asic, stream, 3), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 20, ib_vmid, "DST_ADDR_HI", fetch_word(asic, stream, 4), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "BYTE_COUNT", BITS(fetch_word(asic, stream, 5), 0, 26), NULL, 10, 32);
-			break;
-		case 0xA1: // PKT3_MAP_PROCESS
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "PASID", BITS(fetch_word(asic, stream, 0), 0, 16), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DEBUG_VMID", BITS(fetch_word(asic, stream, 0), 18, 22), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DEBUG_FLAG", BITS(fetch_word(asic, stream, 0), 22, 23), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "TMZ", BITS(fetch_word(asic, stream, 0), 23, 24), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DIQ_ENABLE", BITS(fetch_word(asic, stream, 0), 24, 25), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "PROCESS_QUANTUM", BITS(fetch_word(asic, stream, 0), 25, 32), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "VM_CONTEXT_PAGE_TABLE_BASE_ADDR_LO32", fetch_word(asic, stream, 1), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "VM_CONTEXT_PAGE_TABLE_BASE_ADDR_HI32", fetch_word(asic, stream, 2), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "SH_MEM_BASES", fetch_word(asic, stream, 3), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 20, ib_vmid, "SH_MEM_CONFIG", fetch_word(asic, stream, 4), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "SQ_SHADER_TBA_LO", fetch_word(asic, stream, 5), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 28, ib_vmid, "SQ_SHADER_TBA_HI", fetch_word(asic, stream, 6), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 32, ib_vmid, "SQ_SHADER_TMA_LO", fetch_word(asic, stream, 7), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 36, ib_vmid, "SQ_SHADER_TMA_HI", fetch_word(asic, stream, 8), NULL, 16, 32);
-			// offset 40 is reserved...
-			ui->add_field(ui, ib_addr + 44, ib_vmid, "GDS_ADDR_LO", fetch_word(asic, stream, 10), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 48, ib_vmid, "GDS_ADDR_HI", fetch_word(asic, stream, 11), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 52, ib_vmid, "NUM_GWS", BITS(fetch_word(asic, stream, 12), 0, 6), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 52, ib_vmid, "SDMA_ENABLE", BITS(fetch_word(asic, stream, 12), 7, 8), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 52, ib_vmid, "NUM_OAC", BITS(fetch_word(asic, stream, 12), 8, 12), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 52, ib_vmid, "GDS_SIZE", BITS(fetch_word(asic, stream, 12), 16, 22), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 52, ib_vmid, "NUM_QUEUES", BITS(fetch_word(asic, stream, 12), 22, 32), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 56, ib_vmid, "COMPLETION_SIGNAL_LO32", fetch_word(asic, stream, 13), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 60, ib_vmid, "COMPLETION_SIGNAL_HI32", fetch_word(asic, stream, 14), NULL, 16, 32);
-			break;
 		case 0xA2: // PKT3_MAP_QUEUES
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "QUEUE_SEL", BITS(fetch_word(asic, stream, 0), 4, 6), NULL, 10, 32);
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "VMID", BITS(fetch_word(asic, stream, 0), 8, 12), NULL, 10, 32);
@@ -1271,22 +1480,10 @@ static void decode_pkt3_gfx9(struct umr_asic *asic, struct umr_stream_decode_ui
 
 static void decode_pkt3_gfx10(struct umr_asic *asic, struct umr_stream_decode_ui *ui, struct umr_pm4_stream *stream, uint64_t ib_addr, uint32_t ib_vmid)
 {
+	if (decode_fields(asic, ui, stream, ib_addr, ib_vmid, pm4_gfx10_fields[stream->opcode]))
+		return;
+
 	switch (stream->opcode) {
-		case 0x1d: // ATOMIC_GDS
-			// TODO: fill in
-			break;
-		case 0x1e: // ATOMIC_MEM
-			// TODO: fill in
-			break;
-		case 0x25: // DRAW_INDEX_INDIRECT
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DATA_OFFSET", fetch_word(asic, stream, 0), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "BASE_VTX_LOC", BITS(fetch_word(asic, stream, 1), 0, 16), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "START_INDX_LOC", BITS(fetch_word(asic, stream, 1), 16, 32), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "START_INST_LOC", BITS(fetch_word(asic, stream, 2), 0, 16), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "DISABLE_CPVGTDMA_SM", BITS(fetch_word(asic, stream, 2), 26, 27), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "START_INDX_ENABLE", BITS(fetch_word(asic, stream, 2), 28, 29), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "DRAW_INITIATOR", fetch_word(asic, stream, 3), NULL, 16, 32);
-			break;
 		case 0x37: // WRITE_DATA
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "ENGINE", BITS(fetch_word(asic, stream, 0), 30, 32), op_37_engines[BITS(fetch_word(asic, stream, 0), 30, 32)], 10, 32);
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "CACHE_POLICY", BITS(fetch_word(asic, stream, 0), 25, 27), NULL, 10, 32);
@@ -1305,24 +1502,6 @@ static void decode_pkt3_gfx10(struct umr_asic *asic, struct umr_stream_decode_ui
 				}
 			}
 			break;
-		case 0x38: // DRAW_INDEX_INDIRECT_MULTI
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DATA_OFFSET", fetch_word(asic, stream, 0), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "BASE_VTX_LOC", BITS(fetch_word(asic, stream, 1), 0, 16), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "START_INDX_LOC", BITS(fetch_word(asic, stream, 1), 16, 32), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "START_INST_LOC", BITS(fetch_word(asic, stream, 2), 0, 16), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "DRAW_INDEX_LOC", BITS(fetch_word(asic, stream, 3), 0, 16), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "DISABLE_CPVGTDMA_SM", BITS(fetch_word(asic, stream, 3), 26, 27), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "USE_VGPRS", BITS(fetch_word(asic, stream, 3), 27, 28), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "START_INDX_ENABLE", BITS(fetch_word(asic, stream, 3), 28, 29), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "THREAD_TRACE_MARKER_ENABLE", BITS(fetch_word(asic, stream, 3), 29, 30), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "COUNT_INDIRECT_ENABLE", BITS(fetch_word(asic, stream, 3), 30, 31), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "DRAW_INDEX_ENABLE", BITS(fetch_word(asic, stream, 3), 31, 32), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 20, ib_vmid, "COUNT", fetch_word(asic, stream, 4), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "COUNT_ADDR_LO", BITS(fetch_word(asic, stream, 5), 2, 32) << 2, NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 28, ib_vmid, "COUNT_ADDR_HI", fetch_word(asic, stream, 6), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 32, ib_vmid, "STRIDE", fetch_word(asic, stream, 7), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 36, ib_vmid, "DRAW_INITIATOR", fetch_word(asic, stream, 8), NULL, 16, 32);
-			break;
 		case 0x3C: // WAIT_REG_MEM
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "ENGINE", BITS(fetch_word(asic, stream, 0), 8, 9), BITS(fetch_word(asic, stream, 0), 8, 9) ? "PFP" : "ME", 10, 32);
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "MEMSPACE", BITS(fetch_word(asic, stream, 0), 4, 5), BITS(fetch_word(asic, stream, 0), 4, 5) ? "MEM" : "REG", 10, 32);
@@ -1361,9 +1540,6 @@ static void decode_pkt3_gfx10(struct umr_asic *asic, struct umr_stream_decode_ui
 			}
 			ui->add_field(ui, ib_addr + 20, ib_vmid, "DST_ADDR_HI", fetch_word(asic, stream, 4), NULL, 16, 32);
 			break;
-		case 0x42: // PFP_SYNC_ME
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DUMMY_DATA", fetch_word(asic, stream, 0), NULL, 16, 32);
-			break;
 		case 0x43: // SURFACE_SYNC
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "ENGINE", BITS(fetch_word(asic, stream, 0), 31, 32), BITS(fetch_word(asic, stream, 0), 31, 32) ? "ME" : "PFP", 10, 32);
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "COHER_CNTL", BITS(fetch_word(asic, stream, 0), 0, 29), NULL, 10, 32);
@@ -1379,17 +1555,6 @@ static void decode_pkt3_gfx10(struct umr_asic *asic, struct umr_stream_decode_ui
 				ui->add_field(ui, ib_addr + 12, ib_vmid, "ADDRESS_HI", fetch_word(asic, stream, 2), NULL, 16, 32);
 			}
 			break;
-		case 0x47: // EVENT_WRITE_EOP
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "EVENT_TYPE", BITS(fetch_word(asic, stream, 0), 0, 6), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "EVENT_INDEX", BITS(fetch_word(asic, stream, 0), 8, 12), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "INV_L2", BITS(fetch_word(asic, stream, 0), 20, 21), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "ADDRESS_LO", BITS(fetch_word(asic, stream, 1), 2, 32) << 2, NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "ADDRESS_HI", BITS(fetch_word(asic, stream, 2), 0, 16), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "DATA_SEL", BITS(fetch_word(asic, stream, 2), 29, 32), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "INT_SEL", BITS(fetch_word(asic, stream, 2), 24, 26), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "DATA_LO", fetch_word(asic, stream, 3), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 20, ib_vmid, "DATA_HI", fetch_word(asic, stream, 4), NULL, 16, 32);
-			break;
 		case 0x49: // RELEASE_MEM
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "EVENT_TYPE", BITS(fetch_word(asic, stream, 0), 0, 6), vgt_event_decode(BITS(fetch_word(asic, stream, 0), 0, 6)), 10, 32);
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "EVENT_INDEX", BITS(fetch_word(asic, stream, 0), 8, 12), NULL, 10, 32);
@@ -1430,9 +1595,6 @@ static void decode_pkt3_gfx10(struct umr_asic *asic, struct umr_stream_decode_ui
 			if (asic->family >= FAMILY_AI)
 				ui->add_field(ui, ib_addr + 28, ib_vmid, "INT_CTXID", fetch_word(asic, stream, 6), NULL, 16, 32);
 			break;
-		case 0x4A: // PREAMBLE_CNTL
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "COMMAND", BITS(fetch_word(asic, stream, 0), 28, 32), NULL, 16, 32);
-			break;
 		case 0x4C: // DISPATCH_MESH_INDIRECT_MULTI
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "DATA_OFFSET", fetch_word(asic, stream, 0), NULL, 16, 32);
 			ui->add_field(ui, ib_addr + 8, ib_vmid, "XYZ_DIM_LOC", BITS(fetch_word(asic, stream, 1), 0, 16), umr_reg_name(asic, BITS(fetch_word(asic, stream, 1), 0, 16) + 0x2C00), 16, 32);
@@ -1463,13 +1625,6 @@ static void decode_pkt3_gfx10(struct umr_asic *asic, struct umr_stream_decode_ui
 			ui->add_field(ui, ib_addr + 24, ib_vmid, "POLL_INTERVAL", BITS(fetch_word(asic, stream, 5), 0, 16), NULL, 10, 32);
 			ui->add_field(ui, ib_addr + 28, ib_vmid, "GCR_CNTL", BITS(fetch_word(asic, stream, 6), 0, 19), NULL, 16, 32);
 			break;
-		case 0x86: // WAIT_ON_CE_COUNTER
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "COND_ACQUIRE_MEM", BITS(fetch_word(asic, stream, 0), 0, 1), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "FORCE_SYNC", BITS(fetch_word(asic, stream, 0), 1, 2), NULL, 10, 32);
-			break;
-		case 0x8B: // SWITCH_BUFFER
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DUMMY", fetch_word(asic, stream, 0), NULL, 16, 32);
-			break;
 		case 0xA2: // PKT3_MAP_QUEUES
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "QUEUE_SEL", BITS(fetch_word(asic, stream, 0), 4, 6), NULL, 10, 32);
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "GANG_SHED_MODE", BITS(fetch_word(asic, stream, 0), 7, 8), NULL, 10, 32);
@@ -1554,23 +1709,6 @@ static void decode_pkt3_gfx10(struct umr_asic *asic, struct umr_stream_decode_ui
 			ui->add_field(ui, ib_addr + 36, ib_vmid, "STRIDE", fetch_word(asic, stream, 8), NULL, 10, 32);
 			ui->add_field(ui, ib_addr + 40, ib_vmid, "DISPATCH_INITIATOR", fetch_word(asic, stream, 9), NULL, 16, 32);
 			break;
-		case 0xB0: // DISPATCH_NODES
-			// PM4_MEC_DISPATCH_NODES_ACE
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "SHADER_DIR_ADDR_LO", fetch_word(asic, stream, 0), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "SHADER_DIR_ADDR_HI", BITS(fetch_word(asic, stream, 1), 0, 16), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "ISSUE_SQTT_MARKER_EVENT", BITS(fetch_word(asic, stream, 1), 16, 17), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "INPUT_MODE", BITS(fetch_word(asic, stream, 1), 17, 19), op_b0_input_mode[BITS(fetch_word(asic, stream, 1), 17, 19)], 16, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "ISSUE_GFX_EXIT_SIGNAL", BITS(fetch_word(asic, stream, 1), 19, 20), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "GRAPH_DATA_ADDR_LO", fetch_word(asic, stream, 2), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "GRAPH_DATA_ADDR_HI", BITS(fetch_word(asic, stream, 3), 0, 16), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 20, ib_vmid, "USER_DATA_BASE", BITS(fetch_word(asic, stream, 4), 0, 16), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "DISPATCH_INITIATOR", fetch_word(asic, stream, 5), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 28, ib_vmid, "ROOT_SHADER_ID", fetch_word(asic, stream, 6), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 32, ib_vmid, "INPUT_RECORDS_ADDR_LO", fetch_word(asic, stream, 7), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 36, ib_vmid, "INPUT_RECORDS_ADDR_HI", BITS(fetch_word(asic, stream, 8), 0, 16), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 40, ib_vmid, "INPUT_RECORDS_STRIDE", fetch_word(asic, stream, 9), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 44, ib_vmid, "INPUT_RECORDS_COUNT", fetch_word(asic, stream, 10), NULL, 16, 32);
-			break;
 		default:
 			decode_pkt3_gfx9(asic, ui, stream, ib_addr, ib_vmid);
 			break;
@@ -1579,24 +1717,10 @@ static void decode_pkt3_gfx10(struct umr_asic *asic, struct umr_stream_decode_ui
 
 static void decode_pkt3_gfx11(struct umr_asic *asic, struct umr_stream_decode_ui *ui, struct umr_pm4_stream *stream, uint64_t ib_addr, uint32_t ib_vmid)
 {
+	if (decode_fields(asic, ui, stream, ib_addr, ib_vmid, pm4_gfx11_fields[stream->opcode]))
+		return;
+
 	switch (stream->opcode) {
-		case 0x11: // SET_BASE
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "BASE_INDEX", BITS(fetch_word(asic, stream, 0), 0, 4), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "ADDRESS_LO", BITS(fetch_word(asic, stream, 1), 3, 32) << 3, NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "ADDRESS_HI", fetch_word(asic, stream, 2), NULL, 16, 32);
-			break;
-		case 0x1d: // ATOMIC_GDS
-			// TODO: fill in
-			break;
-		case 0x1e: // ATOMIC_MEM
-			// TODO: fill in
-			break;
-		case 0x22: // COND_EXEC
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "GPU_ADDR_LO32", BITS(fetch_word(asic, stream, 0), 2, 32) << 2, NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "GPU_ADDR_HI32", fetch_word(asic, stream, 1), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "CACHE_POLICY", BITS(fetch_word(asic, stream, 2), 25, 27), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "EXEC_COUNT", BITS(fetch_word(asic, stream, 3), 0, 14), NULL, 16, 32);
-			break;
 		case 0x37: // WRITE_DATA
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "ENGINE", BITS(fetch_word(asic, stream, 0), 30, 32), op_37_engines[BITS(fetch_word(asic, stream, 0), 30, 32)], 10, 32);
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "CACHE_POLICY", BITS(fetch_word(asic, stream, 0), 25, 27), NULL, 10, 32);
@@ -1614,24 +1738,6 @@ static void decode_pkt3_gfx11(struct umr_asic *asic, struct umr_stream_decode_ui
 				}
 			}
 			break;
-		case 0x38: // DRAW_INDEX_INDIRECT_MULTI
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DATA_OFFSET", fetch_word(asic, stream, 0), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "BASE_VTX_LOC", BITS(fetch_word(asic, stream, 1), 0, 16), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "START_INDX_LOC", BITS(fetch_word(asic, stream, 1), 16, 32), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "START_INST_LOC", BITS(fetch_word(asic, stream, 2), 0, 16), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "DRAW_INDEX_LOC", BITS(fetch_word(asic, stream, 3), 0, 16), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "TASK_SHADER_MODE", BITS(fetch_word(asic, stream, 3), 25, 26), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "USE_VGPRS", BITS(fetch_word(asic, stream, 3), 27, 28), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "START_INDX_ENABLE", BITS(fetch_word(asic, stream, 3), 28, 29), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "THREAD_TRACE_MARKER_ENABLE", BITS(fetch_word(asic, stream, 3), 29, 30), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "COUNT_INDIRECT_ENABLE", BITS(fetch_word(asic, stream, 3), 30, 31), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "DRAW_INDEX_ENABLE", BITS(fetch_word(asic, stream, 3), 31, 32), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 20, ib_vmid, "COUNT", fetch_word(asic, stream, 4), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "COUNT_ADDR_LO", BITS(fetch_word(asic, stream, 5), 2, 32) << 2, NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 28, ib_vmid, "COUNT_ADDR_HI", fetch_word(asic, stream, 6), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 32, ib_vmid, "STRIDE", fetch_word(asic, stream, 7), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 36, ib_vmid, "DRAW_INITIATOR", fetch_word(asic, stream, 8), NULL, 16, 32);
-			break;
 		case 0x3C: // WAIT_REG_MEM
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "ENGINE", BITS(fetch_word(asic, stream, 0), 8, 9), BITS(fetch_word(asic, stream, 0), 8, 9) ? "PFP" : "ME", 10, 32);
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "MEMSPACE", BITS(fetch_word(asic, stream, 0), 4, 5), BITS(fetch_word(asic, stream, 0), 4, 5) ? "MEM" : "REG", 10, 32);
@@ -1911,10 +2017,6 @@ static void decode_pkt3_gfx11(struct umr_asic *asic, struct umr_stream_decode_ui
 				}
 			}
 			break;
-		case 0xb1: // EVENT_WRITE_ZPASS
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "ADDRESS_LO", BITS(fetch_word(asic, stream, 0), 3, 32) << 3, NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "ADDRESS_HI", fetch_word(asic, stream, 1), NULL, 16, 32);
-			break;
 		case 0xb4: // EXECUTE_INDIRECT_V2
 		{
 			uint32_t userdata_dw_count = BITS(fetch_word(asic, stream, 0), 1, 6);
@@ -2145,13 +2247,10 @@ static void decode_pkt3_gfx11(struct umr_asic *asic, struct umr_stream_decode_ui
 
 static void decode_pkt3_gfx12(struct umr_asic *asic, struct umr_stream_decode_ui *ui, struct umr_pm4_stream *stream, uint64_t ib_addr, uint32_t ib_vmid)
 {
+	if (decode_fields(asic, ui, stream, ib_addr, ib_vmid, pm4_gfx12_fields[stream->opcode]))
+		return;
+
 	switch (stream->opcode) {
-		case 0x1d: // ATOMIC_GDS
-			// TODO: fill in
-			break;
-		case 0x1e: // ATOMIC_MEM
-			// TODO: fill in
-			break;
 		case 0x25: // DRAW_INDEX_INDIRECT
 			// note: the field in bit 26 was seemingly reverted for GFX12 so this is effectively the gfx9 decoding now
 			decode_pkt3_gfx9(asic, ui, stream, ib_addr, ib_vmid);
@@ -2261,17 +2360,6 @@ static void decode_pkt3_gfx12(struct umr_asic *asic, struct umr_stream_decode_ui
 				ui->add_field(ui, ib_addr + 12, ib_vmid, "ADDRESS_HI", fetch_word(asic, stream, 2), NULL, 16, 32);
 			}
 			break;
-		case 0x47: // EVENT_WRITE_EOP
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "EVENT_TYPE", BITS(fetch_word(asic, stream, 0), 0, 6), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "EVENT_INDEX", BITS(fetch_word(asic, stream, 0), 8, 12), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "INV_L2", BITS(fetch_word(asic, stream, 0), 20, 21), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "ADDRESS_LO", BITS(fetch_word(asic, stream, 1), 2, 32) << 2, NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "ADDRESS_HI", BITS(fetch_word(asic, stream, 2), 0, 16), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "DATA_SEL", BITS(fetch_word(asic, stream, 2), 29, 32), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "INT_SEL", BITS(fetch_word(asic, stream, 2), 24, 26), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "DATA_LO", fetch_word(asic, stream, 3), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 20, ib_vmid, "DATA_HI", fetch_word(asic, stream, 4), NULL, 16, 32);
-			break;
 		case 0x49: // RELEASE_MEM
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "EVENT_TYPE", BITS(fetch_word(asic, stream, 0), 0, 6), vgt_event_decode(BITS(fetch_word(asic, stream, 0), 0, 6)), 10, 32);
 			ui->add_field(ui, ib_addr + 4, ib_vmid, "EVENT_INDEX", BITS(fetch_word(asic, stream, 0), 8, 12), NULL, 10, 32);
@@ -2317,40 +2405,6 @@ static void decode_pkt3_gfx12(struct umr_asic *asic, struct umr_stream_decode_ui
 			ui->add_field(ui, ib_addr + 8, ib_vmid, "LINEAR_DISPATCH_ENABLE", BITS(fetch_word(asic, stream, 1), 28, 29), NULL, 10, 32);
 			ui->add_field(ui, ib_addr + 12, ib_vmid, "DRAW_INITIATOR", fetch_word(asic, stream, 2), NULL, 16, 32);
 			break;
-		case 0x50: // DMA_DATA
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "ENGINE_SEL", BITS(fetch_word(asic, stream, 0), 0, 1), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "SRC_INDIRECT", BITS(fetch_word(asic, stream, 0), 1, 2), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DST_INDIRECT", BITS(fetch_word(asic, stream, 0), 2, 3), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "SRC_TEMPORAL", BITS(fetch_word(asic, stream, 0), 13, 15), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DST_SEL", BITS(fetch_word(asic, stream, 0), 20, 22), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DST_TEMPORAL", BITS(fetch_word(asic, stream, 0), 25, 27), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "SRC_SEL", BITS(fetch_word(asic, stream, 0), 29, 31), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "CP_SYNC", BITS(fetch_word(asic, stream, 0), 31, 32), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "SRC_ADDR_LO_OR_DATA", fetch_word(asic, stream, 1), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "SRC_ADDR_HI", fetch_word(asic, stream, 2), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "DST_ADDR_LO", fetch_word(asic, stream, 3), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 20, ib_vmid, "DST_ADDR_HI", fetch_word(asic, stream, 4), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "BYTE_COUNT", BITS(fetch_word(asic, stream, 5), 0, 26), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "SAS", BITS(fetch_word(asic, stream, 5), 26, 27), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "DAS", BITS(fetch_word(asic, stream, 5), 27, 28), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "SAIC", BITS(fetch_word(asic, stream, 5), 28, 29), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "DAIC", BITS(fetch_word(asic, stream, 5), 29, 30), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "RAW_WAIT", BITS(fetch_word(asic, stream, 5), 30, 31), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "DIS_WC", BITS(fetch_word(asic, stream, 5), 31, 32), NULL, 10, 32);
-			break;
-		case 0x9A: // DMA_DATA_FILL_MULTI
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "ENGINE_SEL", BITS(fetch_word(asic, stream, 0), 0, 1), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "MEMLOG_CLEAR", BITS(fetch_word(asic, stream, 0), 10, 11), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DST_SEL", BITS(fetch_word(asic, stream, 0), 20, 22), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DST_TEMPORAL", BITS(fetch_word(asic, stream, 0), 25, 27), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "SRC_SEL", BITS(fetch_word(asic, stream, 0), 29, 31), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "CP_SYNC", BITS(fetch_word(asic, stream, 0), 31, 32), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "BYTE_STRIDE", fetch_word(asic, stream, 1), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "DMA_COUNT", fetch_word(asic, stream, 2), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "DST_ADDR_LO", fetch_word(asic, stream, 3), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 20, ib_vmid, "DST_ADDR_HI", fetch_word(asic, stream, 4), NULL, 16, 32);
-			ui->add_field(ui, ib_addr + 24, ib_vmid, "BYTE_COUNT", BITS(fetch_word(asic, stream, 5), 0, 26), NULL, 10, 32);
-			break;
 		case 0xA2: // PKT3_MAP_QUEUES
 			{ uint32_t ext_sel = BITS(fetch_word(asic, stream, 0), 2, 4),
 					   engine_sel = BITS(fetch_word(asic, stream, 0), 26, 29);
@@ -2415,27 +2469,14 @@ static void decode_pkt3_gfx12(struct umr_asic *asic, struct umr_stream_decode_ui
 					ui->add_field(ui, ib_addr + 20, ib_vmid, "DOORBELL_OFFSET3", BITS(fetch_word(asic, stream, 4), 2, 28), NULL, 16, 32);
 			}
 			break;
-		case 0xA7: // DISPATCH_DIRECT_INTERLEAVED
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "DIM_X", fetch_word(asic, stream, 0), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 8, ib_vmid, "DIM_Y", BITS(fetch_word(asic, stream, 1), 0, 16), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 12, ib_vmid, "DIM_Z", BITS(fetch_word(asic, stream, 2), 0, 16), NULL, 10, 32);
-			ui->add_field(ui, ib_addr + 16, ib_vmid, "DISPATCH_INITIATOR", fetch_word(asic, stream, 3), NULL, 16, 32);
-			break;
-		case 0xEF: // UPDATE_DB_SUMMARIZER_TIMEOUTS
-			ui->add_field(ui, ib_addr + 4, ib_vmid, "REG_VALUE", fetch_word(asic, stream, 0), NULL, 16, 32);
-			break;
 		default:
 			decode_pkt3_gfx11(asic, ui, stream, ib_addr, ib_vmid);
 			break;
 	}
 }
 
-static void decode_pkt3(struct umr_asic *asic, struct umr_stream_decode_ui *ui, struct umr_pm4_stream *stream, uint64_t ib_addr, uint32_t ib_vmid)
+static void decode_pkt3(struct umr_asic *asic, struct umr_stream_decode_ui *ui, struct umr_pm4_stream *stream, uint64_t ib_addr, uint32_t ib_vmid, int maj)
 {
-	int maj, min;
-
-	umr_gfx_get_ip_ver(asic, &maj, &min);
-
 	switch (maj) {
 		case 6:
 		case 7:
@@ -2517,7 +2558,7 @@ struct umr_pm4_stream *umr_pm4_decode_stream_opcodes(struct umr_asic *asic, stru
 				ui->start_opcode(ui, ib_addr, ib_vmid, stream->pkttype, stream->opcode, 0, stream->n_words, opcode_name, stream->header, stream->words);
 
 			if (stream->pkttype == 3)
-				decode_pkt3(asic, ui, stream, ib_addr, ib_vmid);
+				decode_pkt3(asic, ui, stream, ib_addr, ib_vmid, maj);
 			else if (stream->pkttype == 0)
 				decode_pkt0(asic, ui, stream, ib_addr, ib_vmid);
 
@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+
+/*
+ * While asic->packet_filter is set the PM4 decoder only keeps the packets
+ * that match it (and the IB packets leading to kept packets).  The
+ * opcode and VMID are checked on the header as soon as a packet is
+ * framed, shaders are only looked up for draws and dispatches that can
+ * still match, and IBs of another VMID than the filter's are not read.
+ * The register and VA checks look at the few words of the packets that
+ * carry register offsets or addresses.
+ */
+
+/**
+ * umr_packet_filter_init - Reset a packet filter to match every packet
+ */
+void umr_packet_filter_init(struct umr_packet_filter *f)
+{
+	memset(f, 0, sizeof *f);
+}
+
+/**
+ * umr_packet_filter_add_opcode - Add a PM4 type 3 opcode to a filter
+ */
+void umr_packet_filter_add_opcode(struct umr_packet_filter *f, uint32_t opcode)
+{
+	f->flags |= UMR_PACKET_FILTER_OPCODE;
+	f->opcodes[(opcode & 0xFF) >> 5] |= 1U << (opcode & 31);
+}
+
+/**
+ * umr_packet_filter_ib_pruned - Can an IB be skipped without reading it
+ *
+ * @f: The filter (or NULL)
+ * @vmid: The VMID of the IB
+ *
+ * Every packet of an IB is in its VMID, with a VMID filter an IB of
+ * another VMID can't contain a match.
+ */
+int umr_packet_filter_ib_pruned(const struct umr_packet_filter *f, uint32_t vmid)
+{
+	return f && (f->flags & UMR_PACKET_FILTER_VMID) && (vmid & 0xFF) != f->vmid;
+}
+
+// the opcode and VMID tests which only need the header
+static int filter_header(const struct umr_packet_filter *f, uint32_t vmid, const struct umr_pm4_stream *ps)
+{
+	if ((f->flags & UMR_PACKET_FILTER_VMID) && (vmid & 0xFF) != f->vmid)
+		return 0;
+	if ((f->flags & UMR_PACKET_FILTER_OPCODE) &&
+	    (ps->pkttype != 3 || !(f->opcodes[ps->opcode >> 5] & (1U << (ps->opcode & 31)))))
+		return 0;
+	return 1;
+}
+
+/**
+ * umr_pm4_filter_wants_shaders - Should the shaders of a draw or dispatch be looked up
+ *
+ * @f: The filter (or NULL)
+ * @vmid: The VMID of the packet
+ * @ps: The framed packet
+ *
+ * Returns 0 if the packet can't match whatever its shaders are.
+ */
+int umr_pm4_filter_wants_shaders(const struct umr_packet_filter *f, uint32_t vmid, const struct umr_pm4_stream *ps)
+{
+	// draws and dispatches don't write registers
+	return !f || (filter_header(f, vmid, ps) && !(f->flags & UMR_PACKET_FILTER_REG));
+}
+
+static uint32_t word(const struct umr_pm4_stream *ps, uint32_t n)
+{
+	return n < ps->n_words ? ps->words[n] : 0;
+}
+
+static int reg_in(const struct umr_packet_filter *f, uint32_t reg, uint32_t count)
+{
+	return count && reg <= f->reg_hi && reg + count - 1 >= f->reg_lo;
+}
+
+// does the packet write a register in [reg_lo, reg_hi]
+static int filter_reg(const struct umr_packet_filter *f, const struct umr_pm4_stream *ps)
+{
+	uint32_t base, n;
+
+	if (ps->pkttype == 0)
+		return reg_in(f, ps->pkt0off, ps->n_words);
+	if (ps->pkttype != 3 || !ps->n_words)
+		return 0;
+
+	switch (ps->opcode) {
+		case 0x68: base = 0x2000; goto set_reg;  // SET_CONFIG_REG
+		case 0x69: base = 0xA000; goto set_reg;  // SET_CONTEXT_REG
+		case 0x79: base = 0xC000; goto set_reg;  // SET_UCONFIG_REG
+		case 0x76:                               // SET_SH_REG
+		case 0x9B: base = 0x2C00;                // SET_SH_REG_INDEX
+set_reg:
+			return reg_in(f, base + (word(ps, 0) & 0xFFFF), ps->n_words - 1);
+		case 0xB8: base = 0xA000; goto pairs;    // SET_CONTEXT_REG_PAIRS
+		case 0xBE: base = 0xC000; goto pairs;    // SET_UCONFIG_REG_PAIRS
+		case 0xBA: base = 0x2C00;                // SET_SH_REG_PAIRS
+pairs:
+			for (n = 0; n < ps->n_words; n += 2)
+				if (reg_in(f, base + (word(ps, n) & 0xFFFF), 1))
+					return 1;
+			return 0;
+		case 0xBB:
+		case 0xBC:
+		case 0xBD: // SET_SH_REG_PAIRS_PACKED(_N)
+			for (n = 1; n < ps->n_words; n += 3)
+				if (reg_in(f, 0x2C00 + (word(ps, n) & 0xFFFF), 1) ||
+				    reg_in(f, 0x2C00 + (word(ps, n) >> 16), 1))
+					return 1;
+			return 0;
+		case 0x37: // WRITE_DATA to a register
+			if (((word(ps, 0) >> 8) & 0xF) == 0 && ps->n_words > 3)
+				return reg_in(f, word(ps, 1), ps->n_words - 3);
+			return 0;
+	}
+	return 0;
+}
+
+static int va_in(const struct umr_packet_filter *f, uint64_t addr, uint64_t size)
+{
+	return size && addr <= f->va_hi && addr + size - 1 >= f->va_lo;
+}
+
+static uint64_t va(const struct umr_pm4_stream *ps, uint32_t lo, uint32_t hi_mask)
+{
+	return (word(ps, lo) & ~3ULL) | ((uint64_t)(word(ps, lo + 1) & hi_mask) << 32);
+}
+
+// does the packet reference memory in [va_lo, va_hi]
+static int filter_va(const struct umr_packet_filter *f, const struct umr_pm4_stream *ps)
+{
+	const struct umr_shaders_pgm *pgm;
+
+	if (ps->pkttype != 3)
+		return 0;
+	for (pgm = ps->shader; pgm; pgm = pgm->next)
+		if (va_in(f, pgm->addr, pgm->size ? pgm->size : 4))
+			return 1;
+
+	switch (ps->opcode) {
+		case 0x3F: // INDIRECT_BUFFER
+		case 0x33: // INDIRECT_BUFFER_CONST
+			return va_in(f, va(ps, 0, 0xFFFF), (word(ps, 2) & ((1UL << 20) - 1)) * 4);
+		case 0x37: // WRITE_DATA to memory
+			if (((word(ps, 0) >> 8) & 0xF) && ps->n_words > 3)
+				return va_in(f, va(ps, 1, 0xFFFFFFFF), (ps->n_words - 3) * 4);
+			return 0;
+		case 0x3C: // WAIT_REG_MEM on memory
+			return ((word(ps, 0) >> 4) & 1) && va_in(f, va(ps, 1, 0xFFFF), 4);
+		case 0x47: // EVENT_WRITE_EOP
+			return va_in(f, va(ps, 1, 0xFFFF), 8);
+		case 0x49: // RELEASE_MEM
+			return ps->n_words > 3 && va_in(f, va(ps, 2, 0xFFFFFFFF), 8);
+		case 0x40: // COPY_DATA, selects of 0 are registers
+			return ((word(ps, 0) & 0xF) && va_in(f, va(ps, 1, 0xFFFFFFFF), 4)) ||
+			       (((word(ps, 0) >> 8) & 0xF) && va_in(f, va(ps, 3, 0xFFFFFFFF), 4));
+		case 0x50: // DMA_DATA
+			return va_in(f, va(ps, 1, 0xFFFFFFFF), word(ps, 5) & 0x3FFFFFF) ||
+			       va_in(f, va(ps, 3, 0xFFFFFFFF), word(ps, 5) & 0x3FFFFFF);
+	}
+	return 0;
+}
+
+/**
+ * umr_pm4_filter_match - Does a decoded PM4 packet pass a filter
+ *
+ * @f: The filter (or NULL to match everything)
+ * @vmid: The VMID of the packet
+ * @ps: The packet, with its shaders if it is a draw or dispatch
+ *
+ * Every test enabled in f->flags must pass.
+ */
+int umr_pm4_filter_match(const struct umr_packet_filter *f, uint32_t vmid, const struct umr_pm4_stream *ps)
+{
+	if (!f)
+		return 1;
+	if (!filter_header(f, vmid, ps))
+		return 0;
+	if ((f->flags & UMR_PACKET_FILTER_REG) && !filter_reg(f, ps))
+		return 0;
+	if ((f->flags & UMR_PACKET_FILTER_VA) && !filter_va(f, ps))
+		return 0;
+	return 1;
+}
+
+// a register offset by name or number
+static int parse_reg(struct umr_asic *asic, const char *s, uint32_t *reg)
+{
+	struct umr_reg *r;
+	char *end;
+
+	*reg = strtoul(s, &end, 0);
+	if (end != s && !*end)
+		return 0;
+	r = umr_find_reg_by_name(asic, s, NULL);
+	if (!r || r->type != REG_MMIO) {
+		asic->err_msg("[ERROR]: Unknown MMIO register [%s] in packet filter\n", s);
+		return -1;
+	}
+	*reg = r->addr;
+	return 0;
+}
+
+static int parse_opcode(struct umr_asic *asic, struct umr_packet_filter *f, const char *s)
+{
+	const char *name;
+	char *end;
+	uint32_t op;
+
+	op = strtoul(s, &end, 0);
+	if (end != s && !*end && op < 256) {
+		umr_packet_filter_add_opcode(f, op);
+		return 0;
+	}
+	for (op = 0; op < 256; op++) {
+		name = umr_pm4_opcode_to_str(op << 8);
+		if (!name || !strcmp(name, "UNK"))
+			continue;
+		if (!strcasecmp(name, s) || (!strncmp(name, "PKT3_", 5) && !strcasecmp(name + 5, s))) {
+			umr_packet_filter_add_opcode(f, op);
+			return 0;
+		}
+	}
+	asic->err_msg("[ERROR]: Unknown PM4 opcode [%s] in packet filter\n", s);
+	return -1;
+}
+
+/**
+ * umr_packet_filter_parse - Build a packet filter from text
+ *
+ * @asic: The device (for register names)
+ * @spec: Comma separated terms: 'op=<name|number>' (repeatable, e.g.
+ *        op=DISPATCH_DIRECT), 'reg=<reg>[-<reg>]' by name or DWORD
+ *        offset, 'va=<addr>[-<addr>]' and 'vmid=<n>'
+ * @f: Receives the filter
+ *
+ * Returns 0 on success and -1 on a malformed term.
+ */
+int umr_packet_filter_parse(struct umr_asic *asic, const char *spec, struct umr_packet_filter *f)
+{
+	char *copy, *term, *save, *val, *dash;
+	int r = -1;
+
+	umr_packet_filter_init(f);
+	copy = strdup(spec);
+	if (!copy) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return -1;
+	}
+	for (term = strtok_r(copy, ",", &save); term; term = strtok_r(NULL, ",", &save)) {
+		val = strchr(term, '=');
+		if (!val) {
+			asic->err_msg("[ERROR]: Packet filter term [%s] is not <key>=<value>\n", term);
+			goto out;
+		}
+		*val++ = 0;
+		dash = strchr(val, '-');
+		if (dash)
+			*dash++ = 0;
+		if (!strcmp(term, "op")) {
+			if (parse_opcode(asic, f, val))
+				goto out;
+		} else if (!strcmp(term, "reg")) {
+			if (parse_reg(asic, val, &f->reg_lo) || parse_reg(asic, dash ? dash : val, &f->reg_hi))
+				goto out;
+			f->flags |= UMR_PACKET_FILTER_REG;
+		} else if (!strcmp(term, "va")) {
+			f->va_lo = strtoull(val, NULL, 16);
+			f->va_hi = dash ? strtoull(dash, NULL, 16) : f->va_lo;
+			f->flags |= UMR_PACKET_FILTER_VA;
+		} else if (!strcmp(term, "vmid")) {
+			f->vmid = strtoul(val, NULL, 0);
+			f->flags |= UMR_PACKET_FILTER_VMID;
+		} else {
+			asic->err_msg("[ERROR]: Unknown packet filter term [%s]\n", term);
+			goto out;
+		}
+	}
+	r = 0;
+out:
+	free(copy);
+	return r;
+}
@@ -38,11 +38,10 @@ struct umr_pm4_stream *umr_pm4_lite_decode_stream(struct umr_asic *asic, int vm_
 {
 	struct umr_pm4_stream *ops, *ps, *prev_ps = NULL;
 
-	(void)asic;
 	(void)vm_partition;
 	(void)vmid;
 	(void)ip_version;
-	ps = ops = calloc(1, sizeof *ops);
+	ps = ops = umr_packet_alloc(asic, sizeof *ops);
 	if (!ps) {
 		asic->err_msg("[ERROR]: Out of memory\n");
 		return NULL;
@@ -62,7 +61,7 @@ struct umr_pm4_stream *umr_pm4_lite_decode_stream(struct umr_asic *asic, int vm_
 
 		if (nwords < 1 + ps->n_words) {
 			// if not enough words to fill packet, stop and set current packet to null
-			free(ps);
+			umr_packet_release(asic, ps);
 			if (prev_ps) {
 				prev_ps->next = NULL;
 			} else {
@@ -72,14 +71,14 @@ struct umr_pm4_stream *umr_pm4_lite_decode_stream(struct umr_asic *asic, int vm_
 		}
 
 		// grab rest of words
-		ps->words = calloc(ps->n_words, sizeof(ps->words[0]));
+		ps->words = umr_packet_alloc(asic, ps->n_words * sizeof(ps->words[0]));
 		memcpy(ps->words, &stream[1], ps->n_words * sizeof(stream[0]));
 
 		// advance stream
 		nwords -= 1 + ps->n_words;
 		stream += 1 + ps->n_words;
 		if (nwords) {
-			ps->next = calloc(1, sizeof(*ps));
+			ps->next = umr_packet_alloc(asic, sizeof(*ps));
 			prev_ps = ps;
 			ps = ps->next;
 		}
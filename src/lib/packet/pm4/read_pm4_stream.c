@@ -23,6 +23,7 @@
  *
  */
 #include <stdbool.h>
+#include <stddef.h>
 
 #include "umr.h"
 
@@ -54,18 +55,31 @@ static int reg_sort(const void *a, const void *b)
 	return strcmp(A->regname, B->regname);
 }
 
+// a copy of a register list, shared by reference between shaders until the
+// register state it was taken from changes
+struct umr_regpairs_copy {
+	uint32_t refs;
+	struct umr_shader_reg_pair pairs[];
+};
+
+#define REGPAIRS_COPY(x) ((struct umr_regpairs_copy *)((char *)(x) - offsetof(struct umr_regpairs_copy, pairs)))
+
 /**
  * umr_copy_regpairs - Create a distinct copy of a register pair linked list
  *
+ * @asic: The ASIC the registers belong to
  * @head: The register pair linked list to clone
  *
  * Returns a pointer to a copy of the linked list in the form of a sorted array.
- * While this function does setup the 'next' pointer the returned pointer is itself
- * a heap pointer to an array so it should be freed instead of walking the list.
+ * While this function does setup the 'next' pointer the returned pointer is
+ * an array that must be released with umr_free_regpairs_copy() instead of
+ * walking the list.  While a packet stream is decoded the copy belongs to
+ * the stream (see umr_packet_alloc()).
  */
-struct umr_shader_reg_pair *umr_copy_regpairs(struct umr_shader_reg_pair *head)
+struct umr_shader_reg_pair *umr_copy_regpairs(struct umr_asic *asic, struct umr_shader_reg_pair *head)
 {
-	struct umr_shader_reg_pair *copy, *tmp;
+	struct umr_regpairs_copy *copy;
+	struct umr_shader_reg_pair *tmp;
 	uint32_t x, count;
 
 	// count the # of entries in the list
@@ -78,29 +92,192 @@ struct umr_shader_reg_pair *umr_copy_regpairs(struct umr_shader_reg_pair *head)
 
 	if (count) {
 		// allocate an array and copy the list into it
-		copy = calloc(count, sizeof *head);
+		copy = umr_packet_alloc(asic, sizeof *copy + count * sizeof *head);
+		if (!copy)
+			return NULL;
+		copy->refs = 1;
 		tmp = head;
 		count = 0;
 		while (tmp) {
-			copy[count] = *tmp;
+			copy->pairs[count] = *tmp;
 			tmp = tmp->next;
 			++count;
 		}
 
 		// sort the array by register name
-		qsort(copy, count, sizeof(*copy), reg_sort);
+		qsort(copy->pairs, count, sizeof(copy->pairs[0]), reg_sort);
 
 		// re-attach the next pointers so other parts of the library can just walk the list
 		for (x = 0; x < (count-1); x++) {
-			copy[x].next = &copy[x+1];
+			copy->pairs[x].next = &copy->pairs[x+1];
 		}
-		copy[count-1].next = NULL;
-		return copy;
+		copy->pairs[count-1].next = NULL;
+		return copy->pairs;
 	} else {
 		return NULL;
 	}
 }
 
+/**
+ * umr_free_regpairs_copy - Release a copy made by umr_copy_regpairs()
+ *
+ * @regs: The copy to release (may be NULL)
+ *
+ * Copies can be shared between several shaders, the memory is freed
+ * when the last reference is dropped.
+ */
+void umr_free_regpairs_copy(struct umr_shader_reg_pair *regs)
+{
+	struct umr_regpairs_copy *copy;
+
+	if (!regs)
+		return;
+	copy = REGPAIRS_COPY(regs);
+	if (!--copy->refs)
+		free(copy);
+}
+
+struct pm4_reg_slot {
+	uint32_t reg;
+	struct umr_shader_reg_pair *pair;
+};
+
+// register writes seen while decoding a submission, indexed by register
+// offset so a write only walks the list when the register is new
+struct pm4_reg_state {
+	struct umr_shader_reg_pair **head, *tail;
+
+	// open addressed table of offset -> pair, pair == NULL marks a free slot
+	struct pm4_reg_slot *slot;
+	uint32_t n, size;
+
+	// pairs the caller passed in which are not yet in the table
+	struct umr_shader_reg_pair *seeded;
+
+	// all unknown registers share one "<unknown>" pair
+	struct umr_shader_reg_pair *unknown;
+
+	// the copy handed to the last shader, NULL once a register changes
+	struct umr_shader_reg_pair *copy;
+};
+
+static uint32_t reg_hash(uint32_t reg)
+{
+	reg *= 0x9E3779B1UL;
+	return reg ^ (reg >> 16);
+}
+
+static int reg_state_grow(struct pm4_reg_state *rs)
+{
+	uint32_t x, y, size = rs->size ? rs->size * 2 : 256;
+	struct pm4_reg_slot *slot;
+
+	slot = calloc(size, sizeof rs->slot[0]);
+	if (!slot)
+		return -1;
+	for (x = 0; x < rs->size; x++) {
+		if (!rs->slot[x].pair)
+			continue;
+		y = reg_hash(rs->slot[x].reg) & (size - 1);
+		while (slot[y].pair)
+			y = (y + 1) & (size - 1);
+		slot[y] = rs->slot[x];
+	}
+	free(rs->slot);
+	rs->slot = slot;
+	rs->size = size;
+	return 0;
+}
+
+static void reg_state_init(struct pm4_reg_state *rs, struct umr_shader_reg_pair **head)
+{
+	memset(rs, 0, sizeof *rs);
+	rs->head = head;
+	rs->seeded = *head;
+	for (rs->tail = *head; rs->tail && rs->tail->next; rs->tail = rs->tail->next);
+}
+
+/**
+ * reg_state_find - Find the pair tracking a register
+ *
+ * @asic: The ASIC the registers belong to
+ * @rs: The register state of the submission
+ * @reg: The register offset
+ *
+ * Returns the pair for @reg, appending a new one to the list if this
+ * is the first write to it, or NULL if out of memory.
+ */
+static struct umr_shader_reg_pair *reg_state_find(struct umr_asic *asic, struct pm4_reg_state *rs, uint32_t reg)
+{
+	struct umr_shader_reg_pair *pair;
+	char buf[512], *name;
+	uint32_t x;
+
+	if (rs->size) {
+		for (x = reg_hash(reg) & (rs->size - 1); rs->slot[x].pair; x = (x + 1) & (rs->size - 1))
+			if (rs->slot[x].reg == reg)
+				return rs->slot[x].pair;
+	}
+
+	// first write to this register in the submission
+	name = umr_reg_name_r(asic, reg, buf, sizeof buf);
+	if (!strcmp(name, "<unknown>") && rs->unknown) {
+		pair = rs->unknown;
+	} else {
+		pair = umr_shader_find_regpair(rs->seeded, name);
+		if (!pair) {
+			pair = calloc(1, sizeof *pair);
+			if (!pair)
+				return NULL;
+			snprintf(pair->regname, sizeof(pair->regname), "%s", name);
+			if (rs->tail)
+				rs->tail->next = pair;
+			else
+				*rs->head = pair;
+			rs->tail = pair;
+		}
+		if (!strcmp(name, "<unknown>"))
+			rs->unknown = pair;
+	}
+
+	if (2 * (rs->n + 1) > rs->size && reg_state_grow(rs))
+		return pair;
+	for (x = reg_hash(reg) & (rs->size - 1); rs->slot[x].pair; x = (x + 1) & (rs->size - 1));
+	rs->slot[x].reg = reg;
+	rs->slot[x].pair = pair;
+	++rs->n;
+	return pair;
+}
+
+/**
+ * reg_state_write - Record a register write
+ *
+ * @asic: The ASIC the registers belong to
+ * @rs: The register state of the submission
+ * @reg: The register offset
+ * @value: The 32-bit value written
+ * @ib_vmid: The VMID of the IB containing this register write
+ * @ib_addr: The address from the start of the IB of this register write
+ */
+static void reg_state_write(struct umr_asic *asic, struct pm4_reg_state *rs, uint32_t reg, uint32_t value, uint32_t ib_vmid, uint64_t ib_addr)
+{
+	struct umr_shader_reg_pair *pair;
+
+	pair = reg_state_find(asic, rs, reg);
+	if (!pair)
+		return;
+	pair->value = value;
+	pair->vmid = ib_vmid;
+	pair->addr = ib_addr;
+	pair->used = 0;
+	rs->copy = NULL;
+}
+
+static void reg_state_fini(struct pm4_reg_state *rs)
+{
+	free(rs->slot);
+}
+
 /**
  * add_shader - Add a shader reference to the current packet
  *
@@ -110,18 +287,18 @@ struct umr_shader_reg_pair *umr_copy_regpairs(struct umr_shader_reg_pair *head)
  * @shader_addr: The address of the shader program
  * @vm_partition: The specific GC instance the shader is running on
  * @type: The UMR_SHADER_* type the shader is (pixel, vertex, etc)
- * @reg_pairs: The linked list structure containing all of the register writes found in the submission up until this packet
+ * @rs: The register writes found in the submission up until this packet
  */
 static void add_shader(struct umr_asic *asic,
 	struct umr_pm4_stream *ps,
 	uint32_t vmid, uint64_t shader_addr, int vm_partition,
-	int type, struct umr_shader_reg_pair *reg_pairs)
+	int type, struct pm4_reg_state *rs)
 {
 	struct umr_shaders_pgm *pgm;
 
 	if (ps->shader == NULL) {
 		// attach the shader to the head
-		ps->shader = calloc(1, sizeof(ps->shader[0]));
+		ps->shader = umr_packet_alloc(asic, sizeof(ps->shader[0]));
 		pgm = ps->shader;
 	} else {
 		// walk till the end of the list
@@ -129,7 +306,7 @@ static void add_shader(struct umr_asic *asic,
 		while (pgm->next) {
 			pgm = pgm->next;
 		}
-		pgm->next = calloc(1, sizeof(ps->shader[0]));
+		pgm->next = umr_packet_alloc(asic, sizeof(ps->shader[0]));
 		pgm = pgm->next;
 	}
 
@@ -137,11 +314,18 @@ static void add_shader(struct umr_asic *asic,
 	pgm->vmid = vmid;
 	pgm->addr = shader_addr;
 	if (!asic->options.no_follow_shader)
-		pgm->size = umr_compute_shader_size(asic, vm_partition, pgm);
+		pgm->size = umr_packet_shader_size(asic, vm_partition, pgm);
 	else
 		pgm->size = 1;
 	pgm->type = type;
-	pgm->regs = umr_copy_regpairs(reg_pairs);
+
+	// share the previous copy if no register was written since
+	if (rs->copy) {
+		++REGPAIRS_COPY(rs->copy)->refs;
+	} else {
+		rs->copy = umr_copy_regpairs(asic, *rs->head);
+	}
+	pgm->regs = rs->copy;
 }
 
 /**
@@ -183,7 +367,7 @@ struct umr_shader_reg_pair *umr_shader_find_partial_regpair(struct umr_shader_re
  *
  * @regs: The linked list to free
  *
- * Note: This is not to free the regs attached to a shader_pgm (just use free() on that)
+ * Note: This is not to free the regs attached to a shader_pgm (use umr_free_regpairs_copy() on that)
  */
 void umr_free_shader_reg_pairs(struct umr_shader_reg_pair *regs)
 {
@@ -245,11 +429,11 @@ void umr_shader_add_reg_pair(struct umr_shader_reg_pair **head, const char *regn
  * @vm_partition: The GC core these are running on
  * @vmid: The VMID of the shader program
  * @ps: The packet the shaders should be attached to
- * @reg_pairs: The populated linked list of register writes
+ * @rs: The register writes found in the submission so far
  * @compute_jobs: If 1 then only add compute shaders, otherwise add GFX shaders
  */
 static void process_shaders(struct umr_asic *asic, int vm_partition, uint32_t vmid,
-	struct umr_pm4_stream *ps, struct umr_shader_reg_pair *reg_pairs,
+	struct umr_pm4_stream *ps, struct pm4_reg_state *rs,
 	int compute_jobs)
 {
 	struct {
@@ -269,7 +453,7 @@ static void process_shaders(struct umr_asic *asic, int vm_partition, uint32_t vm
 	};
 	int x;
 #if 0
-	struct umr_shader_reg_pair *stages = umr_shader_find_partial_regpair(reg_pairs, "VGT_SHADER_STAGES_EN");
+	struct umr_shader_reg_pair *stages = umr_shader_find_partial_regpair(*rs->head, "VGT_SHADER_STAGES_EN");
 	struct umr_reg *stage_reg = NULL;
 	int gfx_maj = 0, gfx_min = 0;
 
@@ -302,8 +486,8 @@ static void process_shaders(struct umr_asic *asic, int vm_partition, uint32_t vm
 			continue;
 
 		// try to find programming the top and bottom halfs
-		hi = umr_shader_find_partial_regpair(reg_pairs, types[x].hi);
-		lo = umr_shader_find_partial_regpair(reg_pairs, types[x].lo);
+		hi = umr_shader_find_partial_regpair(*rs->head, types[x].hi);
+		lo = umr_shader_find_partial_regpair(*rs->head, types[x].lo);
 		if (hi && lo) {
 			if (hi->value || lo->value) {
 #if 0
@@ -318,16 +502,21 @@ static void process_shaders(struct umr_asic *asic, int vm_partition, uint32_t vm
 					}
 				}
 #endif
+				// the copy must see the used flags
+				if (!hi->used || !lo->used)
+					rs->copy = NULL;
 				hi->used = 1;
 				lo->used = 1;
 				// we found both addresses so let's add this shader
 				uint64_t addr = (((uint64_t)hi->value) << 40) | (((uint64_t)lo->value) << 8);
-				add_shader(asic, ps, vmid, addr, vm_partition, types[x].type, reg_pairs);				
+				add_shader(asic, ps, vmid, addr, vm_partition, types[x].type, rs);
 			}
 		}
 	}
 }
 
+static struct umr_pm4_stream *decode_stream(struct umr_asic *asic, int vm_partition, uint32_t vmid, uint64_t from_addr, uint32_t *stream, uint32_t nwords, struct pm4_reg_state *rs, int32_t ip_version);
+
 /**
  * parse_pm4 - Parse a PM4 packet looking for pointers to shaders or IBs
  *
@@ -335,13 +524,12 @@ static void process_shaders(struct umr_asic *asic, int vm_partition, uint32_t vm
  * @vmid:  The known VMID this packet belongs to (or 0 if from a ring)
  * @ib_addr: The address of the IB
  * @ps: The PM4 packet to parse
- * @reg_pairs: The linked list of register writes accumulated so far.
+ * @rs: The register writes accumulated so far.
  *
  */
-static void parse_pm4(struct umr_asic *asic, int vm_partition, uint32_t vmid, uint64_t ib_addr, struct umr_pm4_stream *ps, struct umr_shader_reg_pair **reg_pairs, int32_t ip_version)
+static void parse_pm4(struct umr_asic *asic, int vm_partition, uint32_t vmid, uint64_t ib_addr, struct umr_pm4_stream *ps, struct pm4_reg_state *rs, int32_t ip_version)
 {
 	uint32_t n, value;
-	char *regname = NULL;
 
 	switch (ps->opcode) {
 		// these packets actually schedule shaders so this is where we process registers to see what
@@ -351,7 +539,8 @@ static void parse_pm4(struct umr_asic *asic, int vm_partition, uint32_t vmid, ui
 		case 0xA7: // DISPATCH_DIRECT_INTERLEAVED
 		case 0xAA: // DISPATCH_TASKMESH_DIRECT_ACE
 		case 0xAD: // DISPATCH_TASKMESH_INDIRECT_MULTI_ACE
-			process_shaders(asic, vm_partition, vmid, ps, *reg_pairs, 1); // <-- COMPUTE jobs
+			if (umr_pm4_filter_wants_shaders(asic->packet_filter, vmid, ps))
+				process_shaders(asic, vm_partition, vmid, ps, rs, 1); // <-- COMPUTE jobs
 			break;
 		case 0x4C: // DISPATCH_MESH_INDIRECT_MULTI
 		case 0x4D: // DISPATCH_TASKMESH_GFX
@@ -359,16 +548,16 @@ static void parse_pm4(struct umr_asic *asic, int vm_partition, uint32_t vmid, ui
 		case 0x27: // DRAW_INDEX_2
 		case 0x2D: // DRAW_INDEX_AUTO
 		case 0x38: // DRAW_INDEX_INDIRECT_MULTI
-			process_shaders(asic, vm_partition, vmid, ps, *reg_pairs, 0); // <-- GFX jobs
+			if (umr_pm4_filter_wants_shaders(asic->packet_filter, vmid, ps))
+				process_shaders(asic, vm_partition, vmid, ps, rs, 0); // <-- GFX jobs
 			break;
 		case 0x69: // SET_CONTEXT_REG
 		{
 			uint64_t addr = BITS(fetch_word(asic, ps, 0), 0, 16) + 0xA000;
 			ib_addr += 4;
 			for (n = 1; n < ps->n_words; n++) {
-				regname = umr_reg_name(asic, addr);
 				value = fetch_word(asic, ps, n);
-				umr_shader_add_reg_pair(reg_pairs, regname, value, vmid, ib_addr);
+				reg_state_write(asic, rs, addr, value, vmid, ib_addr);
 				++addr;
 				ib_addr += 4;
 			}
@@ -379,9 +568,8 @@ static void parse_pm4(struct umr_asic *asic, int vm_partition, uint32_t vmid, ui
 			uint64_t addr = BITS(fetch_word(asic, ps, 0), 0, 16) + 0xC000;
 			ib_addr += 4;
 			for (n = 1; n < ps->n_words; n++) {
-				regname = umr_reg_name(asic, addr);
 				value = fetch_word(asic, ps, n);
-				umr_shader_add_reg_pair(reg_pairs, regname, value, vmid, ib_addr);
+				reg_state_write(asic, rs, addr, value, vmid, ib_addr);
 				++addr;
 				ib_addr += 4;
 			}
@@ -391,9 +579,8 @@ static void parse_pm4(struct umr_asic *asic, int vm_partition, uint32_t vmid, ui
 		{
 			for (n = 0; n < ps->n_words; n += 2) {
 				// handle both register writes per doublet
-				regname = umr_reg_name(asic, 0xA000 + BITS(fetch_word(asic, ps, n), 0, 16));
 				value = fetch_word(asic, ps, n + 1);
-				umr_shader_add_reg_pair(reg_pairs, regname, value, vmid, ib_addr);
+				reg_state_write(asic, rs, 0xA000 + BITS(fetch_word(asic, ps, n), 0, 16), value, vmid, ib_addr);
 				ib_addr += 8;
 			}
 			break;
@@ -402,9 +589,8 @@ static void parse_pm4(struct umr_asic *asic, int vm_partition, uint32_t vmid, ui
 		{
 			for (n = 0; n < ps->n_words; n += 2) {
 				// handle both register writes per doublet
-				regname = umr_reg_name(asic, 0x2C00 + BITS(fetch_word(asic, ps, n), 0, 16));
 				value = fetch_word(asic, ps, n + 1);
-				umr_shader_add_reg_pair(reg_pairs, regname, value, vmid, ib_addr);
+				reg_state_write(asic, rs, 0x2C00 + BITS(fetch_word(asic, ps, n), 0, 16), value, vmid, ib_addr);
 				ib_addr += 8;
 			}
 			break;
@@ -420,9 +606,8 @@ static void parse_pm4(struct umr_asic *asic, int vm_partition, uint32_t vmid, ui
 				// handle both register writes per triplet
 				ib_addr += 4;
 				for (m = 0; m < 2; m++) {
-					regname = umr_reg_name(asic, 0x2C00 + BITS(fetch_word(asic, ps, n), (16 * m), (16 * (m + 1))));
 					value = fetch_word(asic, ps, n + m + 1);
-					umr_shader_add_reg_pair(reg_pairs, regname, value, vmid, ib_addr);
+					reg_state_write(asic, rs, 0x2C00 + BITS(fetch_word(asic, ps, n), (16 * m), (16 * (m + 1))), value, vmid, ib_addr);
 					ib_addr += 4;
 				}
 			}
@@ -432,9 +617,8 @@ static void parse_pm4(struct umr_asic *asic, int vm_partition, uint32_t vmid, ui
 		{
 			for (n = 0; n < ps->n_words; n += 2) {
 				// handle both register writes per doublet
-				regname = umr_reg_name(asic, 0xC000 + BITS(fetch_word(asic, ps, n), 0, 16));
 				value = fetch_word(asic, ps, n + 1);
-				umr_shader_add_reg_pair(reg_pairs, regname, value, vmid, ib_addr);
+				reg_state_write(asic, rs, 0xC000 + BITS(fetch_word(asic, ps, n), 0, 16), value, vmid, ib_addr);
 				ib_addr += 8;
 			}
 			break;
@@ -445,9 +629,8 @@ static void parse_pm4(struct umr_asic *asic, int vm_partition, uint32_t vmid, ui
 			uint32_t reg_addr = BITS(fetch_word(asic, ps, 0), 0, 16) + 0x2C00;
 			ib_addr += 4;
 			for (n = 1; n < ps->n_words; n++) {
-				regname = umr_reg_name(asic, reg_addr + n - 1);
 				value = fetch_word(asic, ps, n);
-				umr_shader_add_reg_pair(reg_pairs, regname, value, vmid, ib_addr);
+				reg_state_write(asic, rs, reg_addr + n - 1, value, vmid, ib_addr);
 				ib_addr += 4;
 			}
 			break;
@@ -472,16 +655,19 @@ static void parse_pm4(struct umr_asic *asic, int vm_partition, uint32_t vmid, ui
 				tvmid = (fetch_word(asic, ps, 2) >> 24) & 0xF;
 				if (!tvmid)
 					tvmid = vmid;
-				buf = calloc(1, size);
-				if (umr_read_vram(asic, vm_partition, tvmid, ib_addr, size, buf) < 0) {
+				if (umr_packet_filter_ib_pruned(asic->packet_filter, tvmid))
+					break;
+				buf = umr_packet_fetch_ib(asic, vm_partition, tvmid, ib_addr, size);
+				if (!buf) {
 					asic->err_msg("[ERROR]: Could not read IB at 0x%"PRIx32":0x%" PRIx64 "\n", tvmid, ib_addr);
 				} else {
-					ps->ib = umr_pm4_decode_stream(asic, vm_partition, tvmid, ib_addr, buf, size / 4, reg_pairs, ip_version);
-					ps->ib->parent = ps;
+					ps->ib = decode_stream(asic, vm_partition, tvmid, ib_addr, buf, size / 4, rs, ip_version);
+					if (ps->ib)
+						ps->ib->parent = ps;
 					ps->ib_source.addr = ib_addr;
 					ps->ib_source.vmid = tvmid;
 				}
-				free(buf);
+				umr_packet_release_ib(asic, buf);
 			}
 			break;
 		}
@@ -544,6 +730,8 @@ struct umr_shaders_pgm *umr_find_shader_in_pm4_stream(struct umr_asic *asic, str
 
 /**
  * umr_free_pm4_stream - Free a PM4 stream object
+ *
+ * Not for streams owned by a umr_packet_stream, use umr_packet_free() on those.
  */
 void umr_free_pm4_stream(struct umr_pm4_stream *stream)
 {
@@ -556,7 +744,7 @@ void umr_free_pm4_stream(struct umr_pm4_stream *stream)
 			struct umr_shaders_pgm *pgmnext, *pgm = stream->shader;
 			while (pgm) {
 				pgmnext = pgm->next;
-				free(pgm->regs);
+				umr_free_regpairs_copy(pgm->regs);
 				free(pgm);
 				pgm = pgmnext;
 			}
@@ -568,20 +756,45 @@ void umr_free_pm4_stream(struct umr_pm4_stream *stream)
 }
 
 /**
- * umr_pm4_decode_stream - Decode an array of PM4 packets into a PM4 stream
+ * drop_packet - Empty a packet node that didn't pass the packet filter
+ *
+ * The node is reused for the next packet of the stream.
+ */
+static void drop_packet(struct umr_asic *asic, struct umr_pm4_stream *ps)
+{
+	struct umr_shaders_pgm *pgm, *pgmnext;
+	struct umr_pm4_stream *prev = ps->prev;
+
+	// arena memory goes with the stream
+	if (!asic->packet_arena) {
+		for (pgm = ps->shader; pgm; pgm = pgmnext) {
+			pgmnext = pgm->next;
+			umr_free_regpairs_copy(pgm->regs);
+			free(pgm);
+		}
+		free(ps->words);
+	}
+	memset(ps, 0, sizeof *ps);
+	ps->prev = prev;
+}
+
+/**
+ * decode_stream - Decode an array of PM4 packets into a PM4 stream
  *
  * @vm_partition: What VM partition does it come from (-1 is default)
  * @vmid:  The VMID (or zero) that this array comes from (if say an IB)
  * @from_addr: The address in the VMID where the stream came from.
  * @stream: An array of DWORDS which contain the PM4 packets
  * @nwords:  The number of words in the stream
+ * @rs: The register writes of the submission, shared with any IBs
  *
  * Returns a PM4 stream if successfully decoded.
  */
-struct umr_pm4_stream *umr_pm4_decode_stream(struct umr_asic *asic, int vm_partition, uint32_t vmid, uint64_t from_addr, uint32_t *stream, uint32_t nwords, struct umr_shader_reg_pair **reg_head, int32_t ip_version)
+static struct umr_pm4_stream *decode_stream(struct umr_asic *asic, int vm_partition, uint32_t vmid, uint64_t from_addr, uint32_t *stream, uint32_t nwords, struct pm4_reg_state *rs, int32_t ip_version)
 {
 	struct umr_pm4_stream *ops, *ps, *prev_ps = NULL;
 	uint64_t ib_addr = from_addr;
+	int dropped = 0;
 	struct {
 		int n;
 		uint32_t
@@ -590,14 +803,9 @@ struct umr_pm4_stream *umr_pm4_decode_stream(struct umr_asic *asic, int vm_parti
 		uint64_t
 			addr;
 	} uvd_ib;
-	struct umr_shader_reg_pair *local_pairs = NULL;
 	(void)ip_version;
-	// if the caller passed in NULL then just initialize a local set of register pairs
-	if (reg_head == NULL) {
-		reg_head = &local_pairs;
-	}
 
-	ps = ops = calloc(1, sizeof *ops);
+	ps = ops = umr_packet_alloc(asic, sizeof *ops);
 	if (!ps) {
 		asic->err_msg("[ERROR]: Out of memory\n");
 		return NULL;
@@ -623,7 +831,7 @@ struct umr_pm4_stream *umr_pm4_decode_stream(struct umr_asic *asic, int vm_parti
 
 		if (nwords < 1 + ps->n_words) {
 			// if not enough words to fill packet, stop and set current packet to null
-			free(ps);
+			umr_packet_release(asic, ps);
 			if (prev_ps) {
 				prev_ps->next = NULL;
 			} else {
@@ -634,13 +842,13 @@ struct umr_pm4_stream *umr_pm4_decode_stream(struct umr_asic *asic, int vm_parti
 
 		// grab rest of words
 		if (ps->n_words) {
-			ps->words = calloc(ps->n_words, sizeof(ps->words[0]));
+			ps->words = umr_packet_alloc(asic, ps->n_words * sizeof(ps->words[0]));
 			memcpy(ps->words, &stream[1], ps->n_words * sizeof(stream[0]));
 		}
 
 		// decode specific packets
 		if (ps->pkttype == 3) {
-			parse_pm4(asic, vm_partition, vmid, ib_addr + 4, ps, reg_head, ip_version); // +4 is to skip the PM4 header
+			parse_pm4(asic, vm_partition, vmid, ib_addr + 4, ps, rs, ip_version); // +4 is to skip the PM4 header
 		} else if (ps->pkttype == 0) {
 			char *name;
 			name = umr_reg_name(asic, ps->pkt0off);
@@ -670,18 +878,20 @@ struct umr_pm4_stream *umr_pm4_decode_stream(struct umr_asic *asic, int vm_parti
 			}
 
 			// we have everything we need to point to an IB
-			if (!asic->options.no_follow_ib && uvd_ib.n == 15) {
-				void *buf;
-				buf = calloc(1, uvd_ib.size);
-				if (umr_read_vram(asic, vm_partition, uvd_ib.vmid, uvd_ib.addr, uvd_ib.size, buf) < 0) {
+			if (!asic->options.no_follow_ib && uvd_ib.n == 15 &&
+			    !umr_packet_filter_ib_pruned(asic->packet_filter, uvd_ib.vmid)) {
+				uint32_t *buf;
+				buf = umr_packet_fetch_ib(asic, vm_partition, uvd_ib.vmid, uvd_ib.addr, uvd_ib.size);
+				if (!buf) {
 					asic->err_msg("[ERROR]: Could not read IB at 0x%"PRIx32":0x%" PRIx64 "\n", uvd_ib.vmid, uvd_ib.addr);
 				} else {
-					ps->ib = umr_pm4_decode_stream(asic, vm_partition, uvd_ib.vmid, uvd_ib.addr, buf, uvd_ib.size / 4, reg_head, ip_version);
-					ps->ib->parent = ps;
+					ps->ib = decode_stream(asic, vm_partition, uvd_ib.vmid, uvd_ib.addr, buf, uvd_ib.size / 4, rs, ip_version);
+					if (ps->ib)
+						ps->ib->parent = ps;
 					ps->ib_source.addr = uvd_ib.addr;
 					ps->ib_source.vmid = uvd_ib.vmid;
 				}
-				free(buf);
+				umr_packet_release_ib(asic, buf);
 				memset(&uvd_ib, 0, sizeof uvd_ib);
 			}
 		}
@@ -690,19 +900,62 @@ struct umr_pm4_stream *umr_pm4_decode_stream(struct umr_asic *asic, int vm_parti
 		nwords -= 1 + ps->n_words;
 		stream += 1 + ps->n_words;
 		ib_addr += 4 * (1 + ps->n_words);
+
+		// a filtered out packet is kept if it leads to kept packets of an IB
+		if (!ps->ib && !umr_pm4_filter_match(asic->packet_filter, vmid, ps)) {
+			drop_packet(asic, ps);
+			dropped = 1;
+			continue;
+		}
+		dropped = 0;
 		if (nwords) {
-			ps->next = calloc(1, sizeof(*ps));
+			ps->next = umr_packet_alloc(asic, sizeof(*ps));
 			prev_ps = ps;
 			ps = ps->next;
 		}
 	}
 
-	// if we created the list locally free the linked list of register writes
-	while (local_pairs) {
-		struct umr_shader_reg_pair *next = local_pairs->next;
-		free(local_pairs);
-		local_pairs = next;
+	// the node after the last kept packet is unused
+	if (dropped) {
+		umr_packet_release(asic, ps);
+		if (prev_ps)
+			prev_ps->next = NULL;
+		else
+			ops = NULL;
 	}
 
+	return ops;
+}
+
+/**
+ * umr_pm4_decode_stream - Decode an array of PM4 packets into a PM4 stream
+ *
+ * @vm_partition: What VM partition does it come from (-1 is default)
+ * @vmid:  The VMID (or zero) that this array comes from (if say an IB)
+ * @from_addr: The address in the VMID where the stream came from.
+ * @stream: An array of DWORDS which contain the PM4 packets
+ * @nwords:  The number of words in the stream
+ * @reg_head: The list of register writes to continue from (or NULL)
+ *
+ * Returns a PM4 stream if successfully decoded.
+ */
+struct umr_pm4_stream *umr_pm4_decode_stream(struct umr_asic *asic, int vm_partition, uint32_t vmid, uint64_t from_addr, uint32_t *stream, uint32_t nwords, struct umr_shader_reg_pair **reg_head, int32_t ip_version)
+{
+	struct umr_shader_reg_pair *local_pairs = NULL;
+	struct umr_pm4_stream *ops;
+	struct pm4_reg_state rs;
+
+	// if the caller passed in NULL then just initialize a local set of register pairs
+	if (reg_head == NULL) {
+		reg_head = &local_pairs;
+	}
+
+	reg_state_init(&rs, reg_head);
+	ops = decode_stream(asic, vm_partition, vmid, from_addr, stream, nwords, &rs, ip_version);
+	reg_state_fini(&rs);
+
+	// if we created the list locally free the linked list of register writes
+	umr_free_shader_reg_pairs(local_pairs);
+
 	return ops;
 }
\ No newline at end of file
@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+#include <pthread.h>
+#include <unistd.h>
+
+/*
+ * A capture halts the waves once and reads every ring it was given along
+ * with the HQD state of the CP queues before resuming, so the rings are
+ * seen at the same point in time.  Only the reads happen inside the halt
+ * window, the packets are decoded afterwards from the captured words.
+ */
+
+#define UMR_RING_CAPTURE_THREADS 8
+
+struct capture_job {
+	struct umr_asic *asic;
+	struct umr_ring_capture *cap;
+	int next;
+};
+
+static void capture_ring(struct umr_asic *asic, struct umr_ring_capture_ring *ring)
+{
+	uint32_t *data, ringsize;
+
+	data = asic->ring_func.read_ring_data(asic, ring->name, &ringsize);
+	if (!data)
+		return;
+
+	// the first 3 words are rptr/wptr/dwptr
+	ringsize /= 4;
+	ring->words = malloc((ringsize ? ringsize : 1) * sizeof *ring->words);
+	if (!ring->words) {
+		free(data);
+		return;
+	}
+	memcpy(ring->words, data + 3, ringsize * sizeof *ring->words);
+	ring->nwords = ringsize;
+	if (ringsize) {
+		// the kernel returned values might be unwrapped
+		ring->rptr = data[0] % ringsize;
+		ring->wptr = data[1] % ringsize;
+		ring->dwptr = data[2] % ringsize;
+	}
+	ring->ok = 1;
+	free(data);
+}
+
+static void *capture_worker(void *arg)
+{
+	struct capture_job *job = arg;
+	int i;
+
+	umr_affinity_apply(job->asic);
+	while ((i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->cap->no_rings)
+		capture_ring(job->asic, &job->cap->rings[i]);
+	return NULL;
+}
+
+// each debugfs ring file is opened by the reader of its own so they can be
+// read at once unless the backend is replaced or a test vector is involved
+static int can_capture_parallel(struct umr_asic *asic)
+{
+	return asic->ring_func.read_ring_data == umr_read_ring_data && !asic->options.test_log;
+}
+
+/**
+ * umr_ring_capture - Read several kernel rings in one wave halt
+ * @asic: The ASIC the rings belong to
+ * @ringnames: The names of the rings, e.g., 'gfx_0.0.0' or 'sdma0'
+ * @no_rings: How many names are in @ringnames
+ * @workers: How many threads read the rings, 0 picks a default and 1
+ *           reads them one after another
+ *
+ * If asic->options.halt_waves is set the waves are halted once (watching
+ * the first gfx or compute ring given), then every ring, its pointers and
+ * the HQD state of the compute and gfx queues are read and the waves are
+ * resumed.  The CP queues are read while the workers read the rings.  A
+ * ring that cannot be read is kept with ok = 0.
+ *
+ * Returns the capture to be freed with umr_ring_capture_free() or NULL if
+ * out of memory.
+ */
+struct umr_ring_capture *umr_ring_capture(struct umr_asic *asic, char **ringnames, int no_rings, int workers)
+{
+	struct umr_ring_capture *cap;
+	struct capture_job job;
+	pthread_t threads[UMR_RING_CAPTURE_THREADS];
+	char saved_ring[sizeof asic->options.ring_name];
+	uint64_t start = 0;
+	int i, halt, watch;
+	long cpus;
+
+	cap = calloc(1, sizeof *cap);
+	if (cap)
+		cap->rings = calloc(no_rings ? no_rings : 1, sizeof *cap->rings);
+	if (!cap || !cap->rings) {
+		free(cap);
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return NULL;
+	}
+	cap->no_rings = no_rings;
+	for (i = 0, watch = -1; i < no_rings; i++) {
+		snprintf(cap->rings[i].name, sizeof cap->rings[i].name, "%s", ringnames[i]);
+		cap->rings[i].rt = umr_ring_type_by_name(ringnames[i]);
+		if (watch == -1 && (!memcmp(ringnames[i], "gfx", 3) || !memcmp(ringnames[i], "comp", 4)))
+			watch = i;
+	}
+
+	if (workers <= 0)
+		workers = UMR_RING_CAPTURE_THREADS;
+	if (workers > UMR_RING_CAPTURE_THREADS)
+		workers = UMR_RING_CAPTURE_THREADS;
+	if (workers > no_rings)
+		workers = no_rings;
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpus > 0 && workers > cpus)
+		workers = cpus;
+	if (!can_capture_parallel(asic))
+		workers = 1;
+
+	halt = asic->options.halt_waves && no_rings;
+	if (halt) {
+		// the halt watches a ring to know the CP stopped
+		memcpy(saved_ring, asic->options.ring_name, sizeof saved_ring);
+		if (snprintf(asic->options.ring_name, sizeof asic->options.ring_name, "%s",
+			     cap->rings[watch == -1 ? 0 : watch].name) >= (int)sizeof asic->options.ring_name) {
+			// a truncated name would watch another ring or none,
+			// read the rings without halting the waves then
+			memcpy(asic->options.ring_name, saved_ring, sizeof saved_ring);
+			halt = 0;
+		}
+	}
+	if (halt) {
+		cap->halted = !umr_sq_cmd_halt_waves(asic, UMR_SQ_CMD_HALT, 100);
+		start = umr_ring_now_us();
+	}
+
+	job.asic = asic;
+	job.cap = cap;
+	job.next = 0;
+	for (i = 1; i < workers; i++)
+		if (pthread_create(&threads[i], NULL, capture_worker, &job))
+			break;
+	workers = i;
+
+	cap->have_compute = !umr_cp_queues_read(asic, UMR_CP_QUEUES_COMPUTE, &cap->compute);
+	cap->have_gfx = !umr_cp_queues_read(asic, UMR_CP_QUEUES_GFX, &cap->gfx);
+
+	// the calling thread is one of the workers
+	capture_worker(&job);
+	for (i = 1; i < workers; i++)
+		pthread_join(threads[i], NULL);
+
+	if (halt) {
+		umr_sq_cmd_halt_waves(asic, UMR_SQ_CMD_RESUME, 0);
+		cap->halt_us = umr_ring_now_us() - start;
+		memcpy(asic->options.ring_name, saved_ring, sizeof saved_ring);
+	}
+	return cap;
+}
+
+/**
+ * umr_ring_capture_span - Copy the words between a captured ring's pointers
+ * @ring: The captured ring
+ * @nwords: Receives how many words were copied
+ *
+ * The words from the read pointer up to the write pointer are copied in
+ * order, unwrapping the ring.
+ *
+ * Returns the words to be freed by the caller, or NULL if the ring was
+ * not read, is idle or out of memory.
+ */
+uint32_t *umr_ring_capture_span(const struct umr_ring_capture_ring *ring, uint32_t *nwords)
+{
+	uint32_t *words, x, n;
+
+	*nwords = 0;
+	if (!ring->ok || !ring->nwords || ring->rptr == ring->wptr)
+		return NULL;
+
+	n = (ring->wptr + ring->nwords - ring->rptr) % ring->nwords;
+	words = calloc(n, sizeof *words);
+	if (!words)
+		return NULL;
+	for (x = 0; x < n; x++)
+		words[x] = ring->words[(ring->rptr + x) % ring->nwords];
+	*nwords = n;
+	return words;
+}
+
+/**
+ * umr_ring_capture_decode - Decode the active span of a captured ring
+ * @asic: The ASIC the capture was taken from
+ * @ui: A user interface to provide sizing and other information for unhandled opcodes
+ * @cap: The capture
+ * @idx: Which ring of @cap to decode
+ * @queue_data: Opaque pointer to pass to decoder
+ *
+ * The IBs are still fetched from the GPU while decoding, only the ring
+ * itself comes from the capture.
+ *
+ * Returns a pointer to a umr_packet_stream structure if successful.
+ */
+struct umr_packet_stream *umr_ring_capture_decode(struct umr_asic *asic, struct umr_stream_decode_ui *ui,
+	struct umr_ring_capture *cap, int idx, void *queue_data)
+{
+	struct umr_packet_stream *ps;
+	uint32_t *words, nwords;
+
+	if (idx < 0 || idx >= cap->no_rings || cap->rings[idx].rt == UMR_RING_UNK)
+		return NULL;
+	words = umr_ring_capture_span(&cap->rings[idx], &nwords);
+	if (!words)
+		return NULL;
+	ps = umr_packet_decode_buffer_ex(asic, ui, 0, 0, words, nwords, cap->rings[idx].rt, queue_data, UMR_PACKET_IP_VERSION_AUTO);
+	free(words);
+	return ps;
+}
+
+/**
+ * umr_ring_capture_free - Free a capture made by umr_ring_capture()
+ */
+void umr_ring_capture_free(struct umr_ring_capture *cap)
+{
+	int i;
+
+	if (!cap)
+		return;
+	for (i = 0; i < cap->no_rings; i++)
+		free(cap->rings[i].words);
+	if (cap->have_compute)
+		umr_cp_queues_free(&cap->compute);
+	if (cap->have_gfx)
+		umr_cp_queues_free(&cap->gfx);
+	free(cap->rings);
+	free(cap);
+}
@@ -25,249 +25,196 @@
 #include "umr.h"
 #include <inttypes.h>
 
-static void sized_oss1_5(struct umr_asic *asic, int vm_partition, struct umr_stream_decode_ui *ui, uint32_t *stream, uint32_t *ostream, uint32_t nwords, uint64_t from_addr, uint32_t from_vmid, struct umr_sdma_stream *ps, int32_t ip_version)
+/*
+ * Packet sizes for OSS 1..6, in words after the header, per opcode and
+ * sub-opcode.  A size differs between the families (pre-AI, AI, NV and
+ * later) so each entry holds one per family and a stream picks its column
+ * once.  A header bit in .alt_mask selects the .alt size instead (the
+ * broadcast/frame-to-field forms of the copies) and packets with a variable
+ * length add .var_mul times a count field of header or payload word
+ * .var_word (0 is the header).
+ */
+enum sdma_family {
+	SDMA_PRE_AI,
+	SDMA_AI,
+	SDMA_NV,
+	SDMA_FAMILIES,
+};
+
+#define SDMA_OPCODES     18
+#define SDMA_SUB_OPCODES 37
+
+#define SDMA_SIZE_VALID   1 // a known packet
+#define SDMA_SIZE_ANY_SUB 2 // (in sub-opcode 0) the sub-opcode is not part of the packet type
+
+struct sdma_size {
+	uint8_t flags;
+	uint8_t nwords[SDMA_FAMILIES];
+	uint8_t alt[SDMA_FAMILIES];
+	uint32_t alt_mask;
+	uint8_t var_word, var_shift, var_mul;
+	uint32_t var_mask;
+};
+
+#define SZ(n)             { SDMA_SIZE_VALID, { n, n, n } }
+#define SZ_ANY(n)         { SDMA_SIZE_VALID | SDMA_SIZE_ANY_SUB, { n, n, n } }
+#define SZ_FAM(a, b, c)   { SDMA_SIZE_VALID, { a, b, c } }
+#define SZ_VAR(n, w, s, m, k) { SDMA_SIZE_VALID, { n, n, n }, { 0 }, 0, w, s, k, m }
+
+static const struct sdma_size sdma_sizes[SDMA_OPCODES][SDMA_SUB_OPCODES] = {
+	[0] = { // NOP
+		[0] = { SDMA_SIZE_VALID | SDMA_SIZE_ANY_SUB, { 0, 0, 0 }, { 0 }, 0, 0, 16, 1, 0x3FFF },
+	},
+	[1] = { // COPY
+		[0]  = { SDMA_SIZE_VALID, { 6, 6, 6 }, { 8, 8, 8 }, 1UL << 27 },     // LINEAR (BROADCAST)
+		[1]  = { SDMA_SIZE_VALID, { 11, 12, 12 }, { 14, 15, 15 }, 3UL << 26 }, // TILED (L2T Broadcast/F2F)
+		[3]  = SZ(7),                                                     // STRUCTURE/SOA
+		[4]  = SZ(12),                                                    // LINEAR_SUB_WINDOW
+		[5]  = SZ_FAM(13, 13, 16),                                        // TILED_SUB_WINDOW
+		[6]  = SZ_FAM(14, 14, 17),                                        // T2T_SUB_WIND
+		[7]  = SZ(6),                                                     // DIRTY_PAGE
+		[8]  = SZ_VAR(6, 1, 24, 0xFF, 4),                                 // LINEAR_PHY
+		[16] = SZ(6),                                                     // LINEAR_BC
+		[17] = { SDMA_SIZE_VALID, { 12, 12, 12 }, { 15, 15, 15 }, 3UL << 26 }, // TILED_BC
+		[20] = SZ(12),                                                    // LINEAR_SUB_WINDOW_BC
+		[21] = SZ(13),                                                    // TILED_SUB_WINDOW_BC
+		[22] = SZ(14),                                                    // T2T_SUB_WIND_BC
+		[36] = SZ(19),                                                    // LINEAR_SUB_WINDOW_LARGE
+	},
+	[2] = { // WRITE
+		[0] = SZ_VAR(4, 3, 0, 0xFFFFF, 1), // LINEAR
+		[1] = SZ_VAR(9, 8, 0, 0xFFFFF, 1), // TILED
+		[2] = SZ_VAR(9, 8, 0, 0xFFFFF, 1), // TILED_BC
+	},
+	[4] = { [0] = SZ_ANY(5) },  // INDIRECT
+	[5] = { // FENCE
+		[0] = SZ(3), // FENCE
+		[1] = SZ(7), // FENCE CONDITIONAL INTERRUPT
+		[3] = SZ(0), // PROTECTED FENCE
+	},
+	[6] = { [0] = SZ_ANY(1) },  // TRAP
+	[7] = { [0] = SZ_ANY(2) },  // SEM and MEM_INCR
+	[8] = { // POLL_REGMEM
+		[0] = SZ(5),  // MEM
+		[1] = SZ(3),  // REG
+		[2] = SZ(4),  // DBIT
+		[3] = SZ(12), // MEM_VERIFY
+		[4] = SZ(3),  // INVALIDATION
+	},
+	[9] = { [0] = SZ_ANY(4) },  // COND_EXE
+	[10] = { [0] = SZ_ANY(7) }, // ATOMIC
+	[11] = { // FILL
+		[0] = SZ(4), // CONST_FILL
+		[1] = SZ(5), // FILL_MULTI
+	},
+	[12] = { // PTE
+		[0] = SZ(9), // GEN_PTEPDE (aka WRITE_INCR)
+		[1] = SZ(7), // COPY_PTEPDE
+		[2] = SZ(7), // RMW_PTEPDE
+	},
+	[13] = { // TIMESTAMP
+		[0] = SZ(2), // SET_LOCAL
+		[1] = SZ(2), // GET_LOCAL
+		[2] = SZ(2), // GET_GLOBAL
+	},
+	[14] = {
+		[0] = SZ(2), // SRBM_WRITE
+		[1] = SZ(3), // RMW_REGISTER
+	},
+	[15] = { [0] = SZ_ANY(1) }, // PRE_EXE
+	[16] = { [0] = SZ_ANY(3) }, // GPUVM_TLB_INV
+	[17] = { [0] = SZ_ANY(4) }, // GCR
+};
+
+// how a stream (and the IBs it points to) is split into packets
+struct sdma_framing {
+	int ossmaj;
+	enum sdma_family family;
+	struct umr_stream_decode_ui *ui;
+	int vm_partition;
+};
+
+static struct umr_sdma_stream *decode_stream(struct umr_asic *asic, const struct sdma_framing *f,
+					     uint64_t from_addr, uint32_t from_vmid, uint32_t *stream, uint32_t nwords);
+
+static void follow_ib(struct umr_asic *asic, const struct sdma_framing *f, uint32_t *stream, uint32_t *ostream,
+		      uint64_t from_addr, uint32_t from_vmid, struct umr_sdma_stream *ps)
 {
-	(void)nwords;
-	ps->nwords = 0xFFFFFFFFUL;
-	switch (ps->opcode) {
-		case 0: // NOP
-			ps->nwords = (ps->header_dw >> 16) & 0x3FFF;
-			break;
-		case 1: // COPY
-			switch (ps->sub_opcode) {
-				case 0: // LINEAR
-					ps->nwords = 6;
+	uint32_t *data;
 
-					// BROADCAST
-					if (ps->header_dw & (1UL << 27)) {
-						ps->nwords += 2;
-					}
-					break;
-				case 1: // TILED
-					if (ps->header_dw & (3UL << 26)) { // L2T Broadcast/F2F
-						ps->nwords = asic->family >= FAMILY_AI ? 15 : 14;
-					} else {
-						ps->nwords = asic->family >= FAMILY_AI ? 12 : 11;
-					}
-					break;
-				case 3: // STRUCTURE/SOA
-					ps->nwords = 7;
-					break;
-				case 4: // LINEAR_SUB_WINDOW
-					ps->nwords = 12;
-					break;
-				case 5: // TILED_SUB_WINDOW
-					ps->nwords = asic->family >= FAMILY_NV ? 16 : 13;
-					break;
-				case 6: // T2T_SUB_WIND
-					ps->nwords = asic->family >= FAMILY_NV ? 17 : 14;
-					break;
-				case 7: // DIRTY_PAGE
-					ps->nwords = 6;
-					break;
-				case 8: // LINEAR_PHY
-					ps->nwords = 6;
-					ps->nwords += 4 * (stream[0] >> 24);
-					break;
-				case 16: // LINEAR_BC
-					ps->nwords = 6;
-					break;
-				case 17: // TILED_BC
-					if (ps->header_dw & (3UL << 26)) {
-						ps->nwords = 15; // L2T Broadcast/F2F
-					} else {
-						ps->nwords = 12;
-					}
-					break;
-				case 20: // LINEAR_SUB_WINDOW_BC
-					ps->nwords = 12;
-					break;
-				case 21: // TILED_SUB_WIMDOW_BC
-					ps->nwords = 13;
-					break;
-				case 22: // T2T_SUB_WIND_BC
-					ps->nwords = 14;
-					break;
-				case 36: // LINEAR_SUB_WINDOW_LARGE
-					ps->nwords = 19;
-					break;
-			}
-			break;
-		case 2:  // WRITE
-			switch (ps->sub_opcode) {
-				case 0: // LINEAR
-					ps->nwords = 4;
-					ps->nwords += stream[2] & 0xFFFFF;
-					break;
-				case 1: // TILED
-					ps->nwords = 9;
-					ps->nwords += stream[7] & 0xFFFFF;
-					break;
-				case 2: // TILED_BC
-					ps->nwords = 9;
-					ps->nwords += stream[7] & 0xFFFFF;
-					break;
-			}
-			break;
-		case 4: // INDIRECT
-			ps->ib.vmid = (ps->header_dw >> 16) & 0xF;
-			if (!ps->ib.vmid)
-				ps->ib.vmid = from_vmid;
-			ps->ib.addr = ((uint64_t)stream[1] << 32) | stream[0];
-			ps->ib.size = stream[2];
-			if (asic->family == FAMILY_AI) {
-				ps->ib.vmid |= UMR_MM_HUB;
-			} else {
-				ps->ib.vmid |= (from_vmid & 0xFF00);
-			}
-			ps->nwords = 5;
-			if (!asic->options.no_follow_ib) {
-				uint32_t *data = calloc(ps->ib.size, sizeof(*data));
-				if (umr_read_vram(asic, vm_partition, ps->ib.vmid, ps->ib.addr, ps->ib.size * sizeof(*data), data) == 0) {
-					ps->next_ib = umr_sdma_decode_stream(asic, ui, vm_partition, from_addr + (((intptr_t)(stream - ostream)) << 2), ps->ib.vmid, data, ps->ib.size, ip_version);
-					if (ps->next_ib) {
-						ps->next_ib->from.addr = from_addr + (((intptr_t)(stream - ostream)) << 2);
-						ps->next_ib->from.vmid = from_vmid;
-					}
-				}
-				free(data);
-			}
-			break;
-		case 5: // FENCE
-			switch (ps->sub_opcode) {
-				case 0: // FENCE
-					ps->nwords = 3;
-					break;
-				case 1: // FENCE CONDITIONAL INTERRUPT
-					ps->nwords = 7;
-					break;
-				case 3: // PROTECTED FENCE
-					ps->nwords = 0;
-					break;
-				default:
-					asic->err_msg("[BUG]: Unsupported FENCE sub_opcode: %d\n", ps->sub_opcode);
-					break;
-			}
-			break;
-		case 6: // TRAP
-			ps->nwords = 1;
-			break;
-		case 7: // SEM and MEM_INCR
-			ps->nwords = 2;
-			break;
-		case 8: // POLL_REGMEM
-			switch (ps->sub_opcode) {
-				case 0: // MEM
-					ps->nwords = 5;
-					break;
-				case 1: // REG
-					ps->nwords = 3;
-					break;
-				case 2: // DBIT
-					ps->nwords = 4;
-					break;
-				case 3: // MEM_VERIFY
-					ps->nwords = 12;
-					break;
-				case 4: // INVALIDATION
-					ps->nwords = 3;
-					break;
-			}
-			break;
-		case 9: // COND_EXE
-			ps->nwords = 4;
-			break;
-		case 10: // ATOMIC
-			ps->nwords = 7;
-			break;
-		case 11: // FILL
-			switch (ps->sub_opcode) {
-				case 0: // CONST_FILL
-					ps->nwords = 4;
-					break;
-				case 1: // FILL_MULTI
-					ps->nwords = 5;
-					break;
-			}
-			break;
-		case 12: // PTE
-			switch (ps->sub_opcode) {
-				case 0: // GEN_PTEPDE (aka WRITE_INCR)
-					ps->nwords = 9;
-					break;
-				case 1: // COPY_PTEPDE
-					ps->nwords = 7;
-					break;
-				case 2: // RMW_PTEPDE
-					ps->nwords = 7;
-					break;
-			}
-			break;
-		case 13: // TIMESTAMP
-			switch (ps->sub_opcode) {
-				case 0: // SET_LOCAL
-					ps->nwords = 2;
-					break;
-				case 1: // GET_LOCAL
-					ps->nwords = 2;
-					break;
-				case 2: // GET_GLOBAL
-					ps->nwords = 2;
-					break;
-			}
-			break;
-		case 14:
-			switch (ps->sub_opcode) {
-				case 0: // SRBM_WRITE
-					ps->nwords = 2;
-					break;
-				case 1: // RMW_REGISTER
-					ps->nwords = 3;
-					break;
-			}
-			break;
-		case 15: // PRE_EXE
-			ps->nwords = 1;
-			break;
-		case 16: // GPUVM_TLB_INV
-			ps->nwords = 3;
-			break;
-		case 17: // GCR
-			ps->nwords = 4;
-			break;
-		default:
-			if (!ui || !ui->unhandled_size || ui->unhandled_size(ui, asic, ps, UMR_RING_SDMA)) {
-				asic->err_msg("[ERROR]: Invalid SDMA opcode in umr_sdma_decode_ring(): opcode [%x]\n", (unsigned)ps->opcode);
-				break;
-			}
-			// Callback succeeded to populate size in stream->nwrods.
-			return;
+	ps->ib.vmid = (ps->header_dw >> 16) & 0xF;
+	if (!ps->ib.vmid)
+		ps->ib.vmid = from_vmid;
+	ps->ib.addr = ((uint64_t)stream[1] << 32) | stream[0];
+	ps->ib.size = stream[2];
+	if (asic->family == FAMILY_AI) {
+		ps->ib.vmid |= UMR_MM_HUB;
+	} else {
+		ps->ib.vmid |= (from_vmid & 0xFF00);
+	}
+	if (asic->options.no_follow_ib)
+		return;
+	data = umr_packet_fetch_ib(asic, f->vm_partition, ps->ib.vmid, ps->ib.addr, ps->ib.size * sizeof(*data));
+	if (data) {
+		ps->next_ib = decode_stream(asic, f, from_addr + (((intptr_t)(stream - ostream)) << 2), ps->ib.vmid, data, ps->ib.size);
+		if (ps->next_ib) {
+			ps->next_ib->from.addr = from_addr + (((intptr_t)(stream - ostream)) << 2);
+			ps->next_ib->from.vmid = from_vmid;
+		}
 	}
+	umr_packet_release_ib(asic, data);
 }
 
-/**
- * umr_sdma_decode_stream - Decode an array of sdma packets into a sdma stream
- *
- * @vmid:  The VMID (or zero) that this array comes from (if say an IB)
- * @ui: UI callbacks for tracking and modifying parse state (e.g. handling private op codes)
- * @stream: An array of DWORDS which contain the sdma packets
- * @nwords:  The number of words in the stream
- *
- * Returns a sdma stream if successfully decoded.
+/*
+ * size_packet - Set ps->nwords from the size table, it is left at
+ * 0xFFFFFFFF for an unknown packet.  @stream points past the header and
+ * holds @nwords - 1 words.
  */
-struct umr_sdma_stream *umr_sdma_decode_stream(struct umr_asic *asic, struct umr_stream_decode_ui *ui, int vm_partition,
-					       uint64_t from_addr, uint32_t from_vmid, uint32_t *stream, uint32_t nwords, int32_t ip_version)
+static void size_packet(struct umr_asic *asic, const struct sdma_framing *f, uint32_t *stream, uint32_t *ostream,
+			uint32_t nwords, uint64_t from_addr, uint32_t from_vmid, struct umr_sdma_stream *ps)
+{
+	const struct sdma_size *sz = NULL;
+	uint32_t v;
+
+	if (ps->opcode < SDMA_OPCODES) {
+		sz = &sdma_sizes[ps->opcode][0];
+		if (!(sz->flags & SDMA_SIZE_ANY_SUB))
+			sz = ps->sub_opcode < SDMA_SUB_OPCODES ? &sdma_sizes[ps->opcode][ps->sub_opcode] : NULL;
+	}
+
+	if (!sz || !(sz->flags & SDMA_SIZE_VALID)) {
+		// a known opcode with an unknown sub-opcode, otherwise it may be a private one
+		if (ps->opcode < SDMA_OPCODES && sdma_sizes[ps->opcode][0].flags) {
+			if (ps->opcode == 5)
+				asic->err_msg("[BUG]: Unsupported FENCE sub_opcode: %d\n", ps->sub_opcode);
+			return;
+		}
+		if (!f->ui || !f->ui->unhandled_size || f->ui->unhandled_size(f->ui, asic, ps, UMR_RING_SDMA))
+			asic->err_msg("[ERROR]: Invalid SDMA opcode in umr_sdma_decode_ring(): opcode [%x]\n", (unsigned)ps->opcode);
+		// on success the callback set ps->nwords
+		return;
+	}
+
+	ps->nwords = (ps->header_dw & sz->alt_mask) ? sz->alt[f->family] : sz->nwords[f->family];
+	if (sz->var_mask) {
+		if (!sz->var_word)
+			v = ps->header_dw;
+		else
+			v = sz->var_word < nwords ? stream[sz->var_word - 1] : 0;
+		ps->nwords += ((v >> sz->var_shift) & sz->var_mask) * sz->var_mul;
+	}
+
+	if (ps->opcode == 4 && nwords > ps->nwords) // INDIRECT
+		follow_ib(asic, f, stream, ostream, from_addr, from_vmid, ps);
+}
+
+static struct umr_sdma_stream *decode_stream(struct umr_asic *asic, const struct sdma_framing *f,
+					     uint64_t from_addr, uint32_t from_vmid, uint32_t *stream, uint32_t nwords)
 {
 	struct umr_sdma_stream *ops, *ps, *prev_ps = NULL;
 	uint32_t *ostream = stream;
-	int ossmaj, ossmin;
-	(void)ip_version;
-	if (umr_sdma_get_ip_ver(asic, &ossmaj, &ossmin)) {
-		asic->err_msg("[BUG] Cannot determine version of OSS block for this ASIC.\n");
-		return NULL;
-	}
 
-	ps = ops = calloc(1, sizeof *ops);
+	ps = ops = umr_packet_alloc(asic, sizeof *ops);
 	if (!ps) {
 		asic->err_msg("[ERROR]: Out of memory\n");
 		return NULL;
@@ -279,28 +226,21 @@ struct umr_sdma_stream *umr_sdma_decode_stream(struct umr_asic *asic, struct umr
 		ps->header_dw = *stream++;
 		ps->nwords = 0xFFFFFFFFUL;
 
-		switch (ossmaj) {
-			case 1:
-			case 2:
-			case 3:
-			case 4:
-			case 5:
-			case 6:
-				sized_oss1_5(asic, vm_partition, ui, stream, ostream, nwords, from_addr, from_vmid, ps, ip_version);
-				break;
-		}
+		if (f->ossmaj >= 1 && f->ossmaj <= 6)
+			size_packet(asic, f, stream, ostream, nwords, from_addr, from_vmid, ps);
 
 		// error decoding the packet because nwords was not changed
 		if (ps->nwords == 0xFFFFFFFFUL) {
 			asic->err_msg("[ERROR]: Packet failed to size correctly.\n");
 			ps->nwords = 0;
-			umr_free_sdma_stream(ops);
+			if (!asic->packet_arena)
+				umr_free_sdma_stream(ops);
 			return NULL;
 		}
 
 		if (nwords < 1 + ps->nwords) {
 			// if not enough words to fill packet, stop and set current packet to null
-			free(ps);
+			umr_packet_release(asic, ps);
 			if (prev_ps) {
 				prev_ps->next = NULL;
 			} else {
@@ -310,7 +250,7 @@ struct umr_sdma_stream *umr_sdma_decode_stream(struct umr_asic *asic, struct umr
 		} 
 		
 		// grab rest of words
-		ps->words = calloc(ps->nwords, sizeof(ps->words[0]));
+		ps->words = umr_packet_alloc(asic, ps->nwords * sizeof(ps->words[0]));
 		memcpy(ps->words, stream, ps->nwords * sizeof(ps->words[0]));
 
 		// advance stream
@@ -318,7 +258,7 @@ struct umr_sdma_stream *umr_sdma_decode_stream(struct umr_asic *asic, struct umr
 		nwords -= 1 + ps->nwords;
 		
 		if (nwords) {
-			ps->next = calloc(1, sizeof(*ps));
+			ps->next = umr_packet_alloc(asic, sizeof(*ps));
 			prev_ps = ps;
 			ps = ps->next;
 		}
@@ -326,8 +266,37 @@ struct umr_sdma_stream *umr_sdma_decode_stream(struct umr_asic *asic, struct umr
 	return ops;
 }
 
+/**
+ * umr_sdma_decode_stream - Decode an array of sdma packets into a sdma stream
+ *
+ * @vmid:  The VMID (or zero) that this array comes from (if say an IB)
+ * @ui: UI callbacks for tracking and modifying parse state (e.g. handling private op codes)
+ * @stream: An array of DWORDS which contain the sdma packets
+ * @nwords:  The number of words in the stream
+ *
+ * Returns a sdma stream if successfully decoded.
+ */
+struct umr_sdma_stream *umr_sdma_decode_stream(struct umr_asic *asic, struct umr_stream_decode_ui *ui, int vm_partition,
+					       uint64_t from_addr, uint32_t from_vmid, uint32_t *stream, uint32_t nwords, int32_t ip_version)
+{
+	struct sdma_framing f;
+	int ossmin;
+
+	if (umr_sdma_get_ip_ver(asic, &f.ossmaj, &ossmin)) {
+		asic->err_msg("[BUG] Cannot determine version of OSS block for this ASIC.\n");
+		return NULL;
+	}
+	f.family = asic->family >= FAMILY_NV ? SDMA_NV : asic->family >= FAMILY_AI ? SDMA_AI : SDMA_PRE_AI;
+	(void)ip_version;
+	f.ui = ui;
+	f.vm_partition = vm_partition;
+	return decode_stream(asic, &f, from_addr, from_vmid, stream, nwords);
+}
+
 /**
  * umr_free_sdma_stream - Free a sdma stream object
+ *
+ * Not for streams owned by a umr_packet_stream, use umr_packet_free() on those.
  */
 void umr_free_sdma_stream(struct umr_sdma_stream *stream)
 {
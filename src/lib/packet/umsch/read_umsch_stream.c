@@ -42,7 +42,7 @@ struct umr_umsch_stream *umr_umsch_decode_stream(struct umr_asic *asic, int vm_p
 	(void)from_vmid;
 	(void)vm_partition;
 	(void)ip_version;
-	ps = ops = calloc(1, sizeof *ops);
+	ps = ops = umr_packet_alloc(asic, sizeof *ops);
 	if (!ps) {
 		asic->err_msg("[ERROR]: Out of memory\n");
 		return NULL;
@@ -80,7 +80,7 @@ struct umr_umsch_stream *umr_umsch_decode_stream(struct umr_asic *asic, int vm_p
 		}
 
 		// grab rest of words
-		ps->words = calloc(ps->nwords, sizeof(ps->words[0]));
+		ps->words = umr_packet_alloc(asic, ps->nwords * sizeof(ps->words[0]));
 		memcpy(ps->words, stream, ps->nwords * sizeof(ps->words[0]));
 
 		// advance stream
@@ -88,7 +88,7 @@ struct umr_umsch_stream *umr_umsch_decode_stream(struct umr_asic *asic, int vm_p
 		nwords -= ps->nwords; // includes header
 
 		if (nwords) {
-			ps->next = calloc(1, sizeof(*ps));
+			ps->next = umr_packet_alloc(asic, sizeof(*ps));
 			ps = ps->next;
 		}
 	}
@@ -97,6 +97,8 @@ struct umr_umsch_stream *umr_umsch_decode_stream(struct umr_asic *asic, int vm_p
 
 /**
  * umr_free_umsch_stream - Free a umsch stream object
+ *
+ * Not for streams owned by a umr_packet_stream, use umr_packet_free() on those.
  */
 void umr_free_umsch_stream(struct umr_umsch_stream *stream)
 {
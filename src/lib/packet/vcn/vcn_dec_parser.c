@@ -146,7 +146,7 @@ static void add_field(struct umr_asic *asic, uint32_t vmid, uint64_t addr, uint3
 		else if (ideal_radix == 16)
 			sprintf(p, FORMAT16, value);
 	}
-	if (fp) { /* assume vcn is valid */
+	if (fp && !asic->options.vcn_summary) { /* assume vcn is valid */
 		fprintf(fp, CFORMAT_32b "%s",
 			BLUE, vmid, RST,
 			YELLOW, addr, RST,
@@ -184,7 +184,9 @@ static void add_field_1(struct umr_asic *asic, uint32_t vmid, uint64_t addr, uin
 			sprintf(p, FORMAT16, value);
 		*offset += bits/8;
 	}
-	if (fp) { /* assume vcn is valid */
+	if (fp && asic->options.vcn_summary) {
+		*offset += bits/8;
+	} else if (fp) { /* assume vcn is valid */
 		if(bits == 8) {
 			fprintf(fp, CFORMAT_8b "%s",
 				BLUE, vmid, RST,
@@ -229,7 +231,7 @@ static void add_field_2(struct umr_asic *asic, uint32_t vmid, uint64_t addr, uin
 		else if (ideal_radix == 16)
 			sprintf(p, FORMAT16, value);
 	}
-	if (fp) { /* assume vcn is valid */
+	if (fp && !asic->options.vcn_summary) { /* assume vcn is valid */
 		fprintf(fp, CFORMAT_32b "MESSAGE[%d]:%s",
 			BLUE, vmid, RST,
 			YELLOW, addr, RST,
@@ -272,7 +274,9 @@ static void add_field_3_i(struct umr_asic *asic, uint32_t vmid, uint64_t addr, u
 			sprintf(p, FORMAT16, value);
 		*offset += bits/8;
 	}
-	if (fp) { /* assume vcn is valid */
+	if (fp && asic->options.vcn_summary) {
+		*offset += (bits == 8 || bits == 16) ? bits/8 : 4;
+	} else if (fp) { /* assume vcn is valid */
 		if(bits == 8) {
 			if (idx0 > 0)
 				fprintf(fp, CFORMAT_8b "%s[%d][%d]",
@@ -344,7 +348,7 @@ static void add_field_bit(struct umr_asic *asic, uint32_t offset, char *name, ui
 			sprintf(p, "%s,bits[%s] %s=0x%"PRIx32, t0, bits, name, value);
 		free(t0);
 	}
-	if (fp) { /* assume vcn is valid */
+	if (fp && !asic->options.vcn_summary) { /* assume vcn is valid */
 		if (ideal_radix == 10)
 			fprintf(fp, ",%sbits[%s] %s=%"PRIu32"%s", BBLUE, bits, name, value, RST);
 		else
@@ -362,6 +366,95 @@ static void dump_ib(uint32_t *buf, uint32_t size, FILE *fp)
 		}
 }
 
+/* read_dec_msg_upto - Extend a partially read message buffer
+ *
+ * @asic: The ASIC model the packet decoding corresponds to
+ * @vcn: The message being read
+ * @buf: The buffer, *len bytes of it are read
+ * @need: How many bytes the buffer must hold
+ *
+ * Returns 0 on success, -1 on error (*buf is freed then).
+ */
+static int read_dec_msg_upto(struct umr_asic *asic, struct umr_vcn_cmd_message *vcn, uint8_t **buf, uint32_t *len, uint32_t need)
+{
+	uint8_t *nbuf;
+
+	if (need <= *len)
+		return 0;
+	nbuf = realloc(*buf, need);
+	if (!nbuf) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		free(*buf);
+		return -1;
+	}
+	*buf = nbuf;
+	if (umr_read_vram(asic, asic->options.vm_partition, vcn->vmid, vcn->addr + *len, need - *len, nbuf + *len) < 0) {
+		free(nbuf);
+		return -1;
+	}
+	*len = need;
+	return 0;
+}
+
+/* umr_vcn_read_dec_msg - Read a decode IB message buffer
+ *
+ * @asic: The ASIC model the packet decoding corresponds to
+ * @vcn: The message, its vmid and addr must be set
+ * @size_from_index: Size the message by its index instead of the total_size of its header
+ *
+ * The header (and the index if the message is sized by it) is read first,
+ * the rest of the message follows with one more read once the size is
+ * known so nothing past the end of the message is touched.  On success
+ * vcn->size is set and the message is in vcn->buf.
+ *
+ * Returns 0 on success, -1 if the message could not be read.
+ */
+int umr_vcn_read_dec_msg(struct umr_asic *asic, struct umr_vcn_cmd_message *vcn, int size_from_index)
+{
+	rvcn_dec_message_header_t *mh;
+	uint32_t len = 0, size, size_ex, header_size, num_buffers, i;
+	rvcn_dec_message_index_t *pi;
+	uint8_t *buf = NULL;
+
+	if (read_dec_msg_upto(asic, vcn, &buf, &len, sizeof *mh) < 0) {
+		asic->err_msg("[ERROR]: Could not read IB at 0x%"PRIx32":0x%" PRIx64 "\n", vcn->vmid, vcn->addr);
+		return -1;
+	}
+	mh = (rvcn_dec_message_header_t *)buf;
+
+	if (size_from_index) {
+		/* calculate the total_size in case it is wrong from the header */
+		size = mh->header_size + mh->index[0].size;
+		if (mh->num_buffers > 1) {
+			/* all other messages exept the first one follow the header */
+			header_size = mh->header_size;
+			num_buffers = mh->num_buffers;
+			size_ex = (num_buffers - 1) * sizeof(rvcn_dec_message_index_t);
+			if (read_dec_msg_upto(asic, vcn, &buf, &len, header_size + size_ex) < 0) {
+				asic->err_msg("[ERROR]: Could not read IB at 0x%"PRIx32":0x%" PRIx64 "\n", vcn->vmid, vcn->addr);
+				return -1;
+			}
+			mh = (rvcn_dec_message_header_t *)buf;
+			pi = (rvcn_dec_message_index_t *)(buf + header_size);
+			size += size_ex;
+			for (i = 0; i < num_buffers - 1; i++)
+				size += pi[i].size;
+		}
+		if (mh->total_size != size)
+			asic->err_msg("[WARN]: Invalid IB size reported [%d], should be [%d] at 0x%"PRIx32":0x%" PRIx64 "\n", mh->total_size, size, vcn->vmid, vcn->addr);
+	} else {
+		size = mh->total_size < mh->header_size ? mh->header_size : mh->total_size;
+	}
+	vcn->size = size;
+
+	if (read_dec_msg_upto(asic, vcn, &buf, &len, size) < 0) {
+		asic->err_msg("\n[ERROR]: Could not read IB Message at 0x%" PRIx32 "@0x%" PRIx64 "\n", vcn->vmid, vcn->addr);
+		return -1;
+	}
+	vcn->buf = (uint32_t *)buf;
+	return 0;
+}
+
 /* umr_parse_vcn_dec - Parse VCN decode IB message
  *
  * @asic: The ASIC model the packet decoding corresponds to
@@ -584,15 +677,20 @@ void umr_print_dec_ib_msg(struct umr_asic *asic, struct umr_vcn_cmd_message *vcn
 			asic->err_msg("\n[ERROR]: invalid VCN message\n");
 			return;
 		}
-		p_ctxt = malloc(vcn->size);
-		if (!p_ctxt) {
-			asic->err_msg("\n[ERROR]: Running out memory\n");
-			return;
-		}
-		if (umr_read_vram(asic, partition, tvmid, addr, vcn->size, p_ctxt) < 0) {
-			asic->err_msg("\n[ERROR]: Could not read IB Message at 0x%" PRIx32 "@0x%" PRIx64 "\n", tvmid, addr);
-			free(p_ctxt);
-			return;
+		if (vcn->buf) {
+			// already read by the stream decoder
+			p_ctxt = (uint8_t *)vcn->buf;
+		} else {
+			p_ctxt = malloc(vcn->size);
+			if (!p_ctxt) {
+				asic->err_msg("\n[ERROR]: Running out memory\n");
+				return;
+			}
+			if (umr_read_vram(asic, partition, tvmid, addr, vcn->size, p_ctxt) < 0) {
+				asic->err_msg("\n[ERROR]: Could not read IB Message at 0x%" PRIx32 "@0x%" PRIx64 "\n", tvmid, addr);
+				free(p_ctxt);
+				return;
+			}
 		}
 		mh = (rvcn_dec_message_header_t *) p_ctxt;
 	} else {
@@ -700,7 +798,7 @@ void umr_print_dec_ib_msg(struct umr_asic *asic, struct umr_vcn_cmd_message *vcn
 	if (pOut)
 		fprintf(pOut, "\nDone Decoding VCN message at 0x%" PRIx32 "@0x%" PRIx64 "\n", tvmid, addr);
 
-	if (pOut)
+	if (pOut && p_ctxt != (uint8_t *)vcn->buf)
 		free(p_ctxt);
 }
 
@@ -48,7 +48,7 @@
 	}
 
 #define ADD_IB_TYPE(type) \
-	add_field_2(asic, vmid, vcn_addr, &offset, "IB_TYPE", #type, "", ib_type, 0, pOut, pBuf);
+	add_ib_type(asic, vmid, vcn_addr, &offset, #type, ib_type, pOut, pBuf);
 
 struct vcn_gui_message {
 	uint32_t *in_buf;
@@ -74,7 +74,7 @@ static void add_field_1(struct umr_asic *asic, uint32_t vmid, uint64_t addr, uin
 		else if (ideal_radix == 16)
 			sprintf(p, FORMAT16, value);
 	}
-	if (fp) {
+	if (fp && !asic->options.vcn_summary) {
 		fprintf(fp, CFORMAT_32b "%s",
 			BLUE, vmid, RST,
 			YELLOW, addr, RST,
@@ -106,7 +106,7 @@ static void add_field_2(struct umr_asic *asic, uint32_t vmid, uint64_t addr, uin
 		else if (ideal_radix == 16)
 			sprintf(p, FORMAT16, value);
 	}
-	if (fp) {
+	if (fp && !asic->options.vcn_summary) {
 		if (ideal_radix == 0)
 			fprintf(fp, CFORMAT_32b "%s(%s%s%s)",
 				BLUE, vmid, RST,
@@ -142,7 +142,7 @@ static void add_field_3(struct umr_asic *asic, uint32_t vmid, uint64_t addr, uin
 		else if (ideal_radix == 16)
 			sprintf(p, FORMAT16, value);
 	}
-	if (fp) {
+	if (fp && !asic->options.vcn_summary) {
 		fprintf(fp, CFORMAT_32b "%s[%d]",
 			BLUE, vmid, RST,
 			YELLOW, addr, RST,
@@ -174,7 +174,7 @@ static void add_field_4(struct umr_asic *asic, uint32_t vmid, uint64_t addr, uin
 		else if (ideal_radix == 16)
 			sprintf(p, FORMAT16, value);
 	}
-	if (fp) {
+	if (fp && !asic->options.vcn_summary) {
 		if (ideal_radix == 0)
 			fprintf(fp, CFORMAT_32b "%s[%d](%s)",
 				BLUE, vmid, RST,
@@ -195,6 +195,21 @@ static void add_field_4(struct umr_asic *asic, uint32_t vmid, uint64_t addr, uin
 	*offset += 4;
 }
 
+// the IB types are all that summary mode prints of a message
+static void add_ib_type(struct umr_asic *asic, uint32_t vmid, uint64_t addr, uint32_t *offset,
+			const char *type, uint32_t value, FILE *fp, char ***buf)
+{
+	if (fp && asic->options.vcn_summary) {
+		fprintf(fp, CFORMAT_32b "IB_TYPE(%s)",
+			BLUE, vmid, RST,
+			YELLOW, addr, RST,
+			YELLOW, *offset, RST,
+			BMAGENTA, "", value, RST, type);
+		fp = NULL;
+	}
+	add_field_2(asic, vmid, addr, offset, "IB_TYPE", type, "", value, 0, fp, buf);
+}
+
 static void add_field_bit(struct umr_asic *asic, uint32_t offset, char *name, uint32_t value,
 			  char *bits, uint32_t ideal_radix, FILE *fp, char ***buf)
 {
@@ -210,7 +225,7 @@ static void add_field_bit(struct umr_asic *asic, uint32_t offset, char *name, ui
 			sprintf(p, "%s,bits[%s] %s=0x%"PRIx32, t0, bits, name, value);
 		free(t0);
 	}
-	if (fp) {
+	if (fp && !asic->options.vcn_summary) {
 		if (ideal_radix == 10)
 			fprintf(fp, ",%sbits[%s] %s=%"PRIu32"%s", BBLUE, bits, name, value, RST);
 		else
@@ -39,7 +39,7 @@ struct umr_vpe_stream *umr_vpe_decode_stream(struct umr_asic *asic, int vm_parti
 	struct umr_vpe_stream *ops, *ps, *prev_ps = NULL;
 	uint32_t *ostream = stream;
 	(void)ip_version;
-	ps = ops = calloc(1, sizeof *ops);
+	ps = ops = umr_packet_alloc(asic, sizeof *ops);
 	if (!ps) {
 		asic->err_msg("[ERROR]: Out of memory\n");
 		return NULL;
@@ -97,15 +97,15 @@ struct umr_vpe_stream *umr_vpe_decode_stream(struct umr_asic *asic, int vm_parti
 					ps->ib.vmid |= UMR_MM_HUB;
 				ps->nwords = 5;
 				if (!asic->options.no_follow_ib) {
-					uint32_t *data = calloc(ps->ib.size, sizeof(*data));
-					if (umr_read_vram(asic, vm_partition, ps->ib.vmid, ps->ib.addr, ps->ib.size * sizeof(*data), data) == 0) {
+					uint32_t *data = umr_packet_fetch_ib(asic, vm_partition, ps->ib.vmid, ps->ib.addr, ps->ib.size * sizeof(*data));
+					if (data) {
 						ps->next_ib = umr_vpe_decode_stream(asic, vm_partition, from_addr + (((intptr_t)(stream - ostream)) << 2), ps->ib.vmid, data, ps->ib.size, ip_version);
 						if (ps->next_ib) {
 							ps->next_ib->from.addr = from_addr + (((intptr_t)(stream - ostream)) << 2);
 							ps->next_ib->from.vmid = from_vmid;
 						}
 					}
-					free(data);
+					umr_packet_release_ib(asic, data);
 				}
 				break;
 			case 5: // FENCE
@@ -141,13 +141,14 @@ struct umr_vpe_stream *umr_vpe_decode_stream(struct umr_asic *asic, int vm_parti
 				break;
 			default:
 				asic->err_msg("[ERROR]: Invalid vpe opcode in umr_vpe_decode_ring(): opcode [%x]\n", (unsigned)ps->opcode);
-				umr_free_vpe_stream(ops);
+				if (!asic->packet_arena)
+					umr_free_vpe_stream(ops);
 				return NULL;
 		}
 
 		if (nwords < 1 + ps->nwords) {
 			// if not enough words to fill packet, stop and set current packet to null
-			free(ps);
+			umr_packet_release(asic, ps);
 			if (prev_ps) {
 				prev_ps->next = NULL;
 			} else {
@@ -157,7 +158,7 @@ struct umr_vpe_stream *umr_vpe_decode_stream(struct umr_asic *asic, int vm_parti
 		}
 
 		// grab rest of words
-		ps->words = calloc(ps->nwords, sizeof(ps->words[0]));
+		ps->words = umr_packet_alloc(asic, ps->nwords * sizeof(ps->words[0]));
 		memcpy(ps->words, stream, ps->nwords * sizeof(ps->words[0]));
 
 		// advance stream
@@ -165,7 +166,7 @@ struct umr_vpe_stream *umr_vpe_decode_stream(struct umr_asic *asic, int vm_parti
 		nwords -= 1 + ps->nwords;
 
 		if (nwords) {
-			ps->next = calloc(1, sizeof(*ps));
+			ps->next = umr_packet_alloc(asic, sizeof(*ps));
 			prev_ps = ps;
 			ps = ps->next;
 		}
@@ -175,6 +176,8 @@ struct umr_vpe_stream *umr_vpe_decode_stream(struct umr_asic *asic, int vm_parti
 
 /**
  * umr_free_vpe_stream - Free a vpe stream object
+ *
+ * Not for streams owned by a umr_packet_stream, use umr_packet_free() on those.
  */
 void umr_free_vpe_stream(struct umr_vpe_stream *stream)
 {
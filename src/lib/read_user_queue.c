@@ -24,6 +24,49 @@
  */
 #include "umr.h"
 
+/*
+ * read_segments - Read the words [start, end) of the bound user queue into @buf
+ *
+ * A span that wraps is read as two segments, both under one VM context so
+ * the page walk of the queue buffer is only done once.  @seg_words and
+ * @seg_addr (may be NULL) receive the length and GPU address of each.
+ * Returns the number of segments, or -1 on error.
+ */
+static int read_segments(struct umr_asic *asic, uint32_t start, uint32_t end, uint32_t *buf, uint32_t *seg_words, uint64_t *seg_addr)
+{
+    uint64_t base = asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].hqd_base_addr;
+    uint32_t n[2];
+    int segs, x, r = 0;
+
+    if (start > end) {
+        // read from start to RB_BUZSZ and then 0 to end
+        n[0] = asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].rb_buf_size - start;
+        n[1] = end;
+        segs = end ? 2 : 1;
+    } else {
+        n[0] = end - start;
+        n[1] = 0;
+        segs = 1;
+    }
+
+    umr_vm_context_begin(asic);
+    for (x = 0; x < segs; x++) {
+        uint64_t addr = x ? base : base + start * 4;
+        if (n[x] && umr_read_vram(asic, asic->options.vm_partition, 0, addr, n[x] * 4, x ? buf + n[0] : buf) < 0) {
+            asic->err_msg("[ERROR]: Could not read between '%s' and '%s' from user queue buffer.\n",
+                x ? "0" : "start", (x || segs == 1) ? "end" : "RB_BUFSZ");
+            r = -1;
+            break;
+        }
+        if (seg_words)
+            seg_words[x] = n[x];
+        if (seg_addr)
+            seg_addr[x] = addr;
+    }
+    umr_vm_context_end(asic);
+    return r ? r : segs;
+}
+
 /**
  * umr_read_user_queue_buffer - Read the user queue buffer as a ring
  * @asic: The ASIC that has the user queue attached to it.
@@ -36,32 +79,80 @@
  */
 int umr_read_user_queue_buffer(struct umr_asic *asic, uint32_t start, uint32_t end, uint32_t *buf, uint32_t *len)
 {
-    uint32_t n;
+    uint32_t n[2] = { 0, 0 };
 
     *len = 0;
-    if (start > end) {
-        // read from start to RB_BUZSZ and then 0 to end
-        n = asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].rb_buf_size - start;
-        if (umr_read_vram(asic, asic->options.vm_partition, 0,
-            asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].hqd_base_addr + start * 4, n * 4, buf) < 0) {
-                asic->err_msg("[ERROR]: Could not read between 'start' and RB_BUFSZ from user queue buffer.\n");
-                return -1;
-        }
-        if (umr_read_vram(asic, asic->options.vm_partition, 0,
-            asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].hqd_base_addr, end * 4, buf + n * 4) < 0) {
-                asic->err_msg("[ERROR]: Could not read between 0 and 'end' from user queue buffer.\n");
-                return -1;
-        }
-        *len = n + end;
-        return 0;
-    } else {
-        // read from start to end
-        if (umr_read_vram(asic, asic->options.vm_partition, 0,
-            asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].hqd_base_addr + start * 4, (end - start) * 4, buf) < 0) {
-                asic->err_msg("[ERROR]: Could not read between 'start' and 'end' from user queue buffer.\n");
-                return -1;
-        }
-        *len = end - start;
-        return 0;
+    if (read_segments(asic, start, end, buf, n, NULL) < 0)
+        return -1;
+    *len = n[0] + n[1];
+    return 0;
+}
+
+/**
+ * umr_user_queue_view - View the words [start, end) of the bound user queue
+ * @asic: The ASIC that has the user queue attached to it.
+ * @start: The start offset in dwords
+ * @end: The end offset in dwords (end < start wraps around the end of the queue)
+ * @rv: [out] The view, release with umr_ring_view_free()
+ *
+ * Unlike umr_read_user_queue_buffer() the caller does not size a buffer
+ * for the whole queue, only the span is read.  The segments are stored back
+ * to back so rv->seg[0].words holds all rv->nwords words in ring order and
+ * can be handed to the decoders as is, while rv->seg[] keeps the GPU
+ * address each part came from (see umr_ring_view_addr()).
+ *
+ * Returns 0 on success.
+ */
+int umr_user_queue_view(struct umr_asic *asic, uint32_t start, uint32_t end, struct umr_ring_view *rv)
+{
+    uint32_t size = asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].rb_buf_size;
+    uint32_t n[2] = { 0, 0 };
+    uint64_t addr[2] = { 0, 0 };
+    int segs;
+
+    memset(rv, 0, sizeof *rv);
+    // a span given as start plus a count may run past the end of the queue
+    if (end > size)
+        end -= size;
+    if (start >= size || end > size) {
+        asic->err_msg("[ERROR]: User queue span 0x%"PRIx32"..0x%"PRIx32" is outside of the queue (0x%"PRIx32" words)\n", start, end, size);
+        return -1;
+    }
+    rv->words = calloc(start > end ? size - start + end : end - start + 1, sizeof *rv->words);
+    if (!rv->words) {
+        asic->err_msg("[ERROR]: Out of memory\n");
+        return -1;
     }
+    segs = read_segments(asic, start, end, rv->words, n, addr);
+    if (segs < 0) {
+        umr_ring_view_free(rv);
+        return -1;
+    }
+    rv->no_segs = segs;
+    rv->seg[0].words = rv->words;
+    rv->seg[0].nwords = n[0];
+    rv->seg[0].addr = addr[0];
+    if (segs == 2) {
+        rv->seg[1].words = rv->words + n[0];
+        rv->seg[1].nwords = n[1];
+        rv->seg[1].addr = addr[1];
+    }
+    rv->nwords = n[0] + n[1];
+    return 0;
+}
+
+/**
+ * umr_ring_view_addr - The GPU address of word @idx of a view
+ */
+uint64_t umr_ring_view_addr(const struct umr_ring_view *rv, uint32_t idx)
+{
+    if (rv->no_segs == 2 && idx >= rv->seg[0].nwords)
+        return rv->seg[1].addr + (uint64_t)(idx - rv->seg[0].nwords) * 4;
+    return rv->seg[0].addr + (uint64_t)idx * 4;
+}
+
+void umr_ring_view_free(struct umr_ring_view *rv)
+{
+    free(rv->words);
+    memset(rv, 0, sizeof *rv);
 }
@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+
+// the updates of one register in one bank
+struct field_group {
+	struct umr_field_update *first;
+	int n;
+	uint64_t mask, value, old;
+	int read;                   // index of the LO half in the read batch, -1 if not read
+};
+
+// byte address scale of a register that can be written by field
+static int field_scale(struct umr_reg *reg)
+{
+	switch (reg->type) {
+		case REG_MMIO: return 4;
+		case REG_DIDT:
+		case REG_PCIE:
+		case REG_SMC: return 1;
+		default: return 0;
+	}
+}
+
+static int same_bank(const struct umr_field_update *a, const struct umr_field_update *b)
+{
+	if (a->use_bank != b->use_bank)
+		return 0;
+	switch (a->use_bank) {
+		case 1:
+			return a->bank.grbm.se == b->bank.grbm.se &&
+			       a->bank.grbm.sh == b->bank.grbm.sh &&
+			       a->bank.grbm.instance == b->bank.grbm.instance;
+		case 2:
+			return a->bank.srbm.me == b->bank.srbm.me &&
+			       a->bank.srbm.pipe == b->bank.srbm.pipe &&
+			       a->bank.srbm.queue == b->bank.srbm.queue &&
+			       a->bank.srbm.vmid == b->bank.srbm.vmid;
+		default:
+			return 1;
+	}
+}
+
+// by bank, then type and address (like umr_read_regs_batch() groups them)
+static int update_sort(const void *A, const void *B)
+{
+	const struct umr_field_update *a = *(const struct umr_field_update **)A,
+				      *b = *(const struct umr_field_update **)B;
+	const uint32_t *ka = (const uint32_t *)&a->bank, *kb = (const uint32_t *)&b->bank;
+	unsigned x, n;
+
+	if (a->use_bank != b->use_bank)
+		return a->use_bank < b->use_bank ? -1 : 1;
+	n = a->use_bank == 1 ? 3 : a->use_bank == 2 ? 4 : 0;
+	for (x = 0; x < n; x++)
+		if (ka[x] != kb[x])
+			return ka[x] < kb[x] ? -1 : 1;
+	if (a->reg->type != b->reg->type)
+		return a->reg->type < b->reg->type ? -1 : 1;
+	if (a->reg->addr != b->reg->addr)
+		return a->reg->addr < b->reg->addr ? -1 : 1;
+	// later updates of the same field win
+	return a < b ? -1 : (a > b);
+}
+
+static void batch_entry(struct umr_reg_batch *e, const struct field_group *g, int hi, uint64_t value)
+{
+	struct umr_reg *reg = g->first->reg;
+
+	memset(e, 0, sizeof *e);
+	// the HI half is the next dword, also in the byte addressed spaces
+	e->addr = reg->addr * field_scale(reg) + (hi ? 4 : 0);
+	e->type = reg->type;
+	e->use_bank = g->first->use_bank;
+	e->bank = g->first->bank;
+	e->value = hi ? value >> 32 : value;
+}
+
+// read the registers of @groups that need it into ->old, @all reads every one
+static int read_groups(struct umr_asic *asic, struct field_group *groups, int no_groups, int all)
+{
+	struct umr_reg_batch *batch;
+	int i, n = 0, r;
+
+	batch = calloc(no_groups * 2 + 1, sizeof *batch);
+	if (!batch) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return -1;
+	}
+	for (i = 0; i < no_groups; i++) {
+		groups[i].read = -1;
+		if (!all && (groups[i].mask == (groups[i].first->reg->bit64 ? ~0ULL : 0xFFFFFFFFULL)))
+			continue;
+		groups[i].read = n;
+		batch_entry(&batch[n++], &groups[i], 0, 0);
+		if (groups[i].first->reg->bit64)
+			batch_entry(&batch[n++], &groups[i], 1, 0);
+	}
+	r = umr_read_regs_batch(asic, batch, n);
+	for (i = 0; i < no_groups; i++) {
+		if (groups[i].read < 0)
+			continue;
+		groups[i].old = batch[groups[i].read].value;
+		if (groups[i].first->reg->bit64)
+			groups[i].old |= (uint64_t)batch[groups[i].read + 1].value << 32;
+	}
+	free(batch);
+	return r;
+}
+
+/**
+ * umr_write_fields - Update bitfields of registers with one write per register
+ *
+ * @asic: The device to write to
+ * @updates: The fields to set, the same field can be listed more than
+ *           once (the last one wins)
+ * @no_updates: The number of entries in @updates
+ * @flags: UMR_WRITE_FIELDS_VERIFY to read the registers back
+ *
+ * The updates are grouped by register and bank.  Every register is read
+ * once (unless the updates cover all of its bits), the fields are merged
+ * into the value and it is written once, so no intermediate state
+ * reaches the hardware.  The reads and the writes are issued in bank
+ * order through umr_read_regs_batch() and umr_write_regs_batch().  Every
+ * field is looked up before anything is accessed, an unknown field or a
+ * register that can't be written leaves the hardware untouched.
+ *
+ * ->result of each update receives the value written to its register, or
+ * with UMR_WRITE_FIELDS_VERIFY the value read back after the writes.
+ *
+ * Returns 0 on success, 1 if a field did not read back as written and
+ * -1 on error.
+ */
+int umr_write_fields(struct umr_asic *asic, struct umr_field_update *updates, int no_updates, int flags)
+{
+	struct umr_field_update **order = NULL, *u;
+	struct field_group *groups = NULL, *g;
+	struct umr_reg_batch *batch = NULL;
+	const struct umr_bitfield *bf;
+	uint64_t mask;
+	int i, j, no_groups = 0, n, r = -1;
+
+	if (no_updates <= 0)
+		return 0;
+	order = calloc(no_updates, sizeof *order);
+	groups = calloc(no_updates, sizeof *groups);
+	batch = calloc(no_updates * 2, sizeof *batch);
+	if (!order || !groups || !batch) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		goto out;
+	}
+	for (i = 0; i < no_updates; i++) {
+		if (!field_scale(updates[i].reg)) {
+			asic->err_msg("[ERROR]: Register [%s] can't be written by field\n", updates[i].reg->regname);
+			goto out;
+		}
+		order[i] = &updates[i];
+	}
+	qsort(order, no_updates, sizeof order[0], update_sort);
+
+	// merge the fields of each register
+	for (i = 0; i < no_updates; i++) {
+		u = order[i];
+		if (!no_groups || groups[no_groups - 1].first->reg != u->reg ||
+		    !same_bank(groups[no_groups - 1].first, u))
+			groups[no_groups++].first = u;
+		g = &groups[no_groups - 1];
+		++g->n;
+
+		if (u->bitname) {
+			bf = NULL;
+			for (j = 0; j < u->reg->no_bits; j++)
+				if (!strcmp(u->reg->bits[j].regname, u->bitname))
+					bf = &u->reg->bits[j];
+			if (!bf) {
+				asic->err_msg("[ERROR]: Bitfield [%s] not found in reg [%s]\n", u->bitname, u->reg->regname);
+				goto out;
+			}
+			mask = umr_bitfield_mask(bf) << bf->start;
+			g->value = (g->value & ~mask) | ((u->value << bf->start) & mask);
+		} else {
+			mask = u->reg->bit64 ? ~0ULL : 0xFFFFFFFFULL;
+			g->value = u->value & mask;
+		}
+		g->mask |= mask;
+	}
+
+	if (read_groups(asic, groups, no_groups, 0))
+		goto out;
+
+	// one write per register (LO half first), in bank order
+	for (i = n = 0; i < no_groups; i++) {
+		g = &groups[i];
+		if (g->read >= 0)
+			g->value = (g->old & ~g->mask) | g->value;
+		batch_entry(&batch[n++], g, 0, g->value);
+		if (g->first->reg->bit64)
+			batch_entry(&batch[n++], g, 1, g->value);
+	}
+	if (umr_write_regs_batch(asic, batch, n))
+		goto out;
+
+	r = 0;
+	if (flags & UMR_WRITE_FIELDS_VERIFY) {
+		if (read_groups(asic, groups, no_groups, 1)) {
+			r = -1;
+			goto out;
+		}
+		for (i = 0; i < no_groups; i++)
+			if ((groups[i].old ^ groups[i].value) & groups[i].mask)
+				r = 1;
+	}
+	// the updates of a group are next to each other in order[]
+	for (i = j = 0; i < no_groups; j += groups[i++].n)
+		for (n = j; n < j + groups[i].n; n++)
+			order[n]->result = (flags & UMR_WRITE_FIELDS_VERIFY) ? groups[i].old : groups[i].value;
+out:
+	free(order);
+	free(groups);
+	free(batch);
+	return r;
+}
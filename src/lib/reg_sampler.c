@@ -0,0 +1,383 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+
+/*
+ * Background register sampler.  The bitfields of a set of registers are
+ * sampled every step on a thread of its own (with its own access
+ * context) and the value of each bitfield is added to a counter, e.g.
+ * summing the *_BUSY bits of GRBM_STATUS tells how busy each block was.
+ *
+ * The shift and mask of every bitfield is worked out once up front, the
+ * registers are read with one umr_read_regs_batch() per sample and the
+ * samples are taken on absolute deadlines so the rate doesn't drift by
+ * the cost of the reads.  A sample that is late by more than a step is
+ * dropped rather than taken in a burst to catch up.
+ *
+ * An adaptive sampler instead takes the step from a umr_sample_rate,
+ * reporting the share of bitfields that changed since the previous
+ * sample as the activity.  Samples are then irregular so each value is
+ * weighted by the time that actually passed since the previous sample
+ * and umr_reg_sampler_read() returns counters scaled to the time average.
+ */
+
+struct sampler_field {
+	int word;		// index of the (low) word of the register in batch[]
+	int bit64;		// the high word follows it
+	unsigned shift;
+	uint64_t mask;
+};
+
+struct umr_reg_sampler {
+	struct umr_asic *asic;
+	struct umr_access_ctx *ctx;
+	struct umr_reg_batch *batch;
+	int no_words;
+	struct sampler_field *fields;
+	int no_fields;
+	uint64_t step_ns, no_steps;
+	pthread_t thread;
+	int joined;
+
+	int adaptive;
+	struct umr_sample_rate rate;
+	uint64_t period_ns;
+	uint64_t *prev;		// values of the previous adaptive sample
+
+	pthread_mutex_t lock;	// protects the fields below
+	uint64_t *counters, samples, missed;
+	double *weighted;	// value * ns of the adaptive samples
+	uint64_t elapsed_ns;
+	int stop, done;
+};
+
+static void add_ns(struct timespec *ts, uint64_t ns)
+{
+	ns += ts->tv_nsec;
+	ts->tv_sec += ns / 1000000000ULL;
+	ts->tv_nsec = ns % 1000000000ULL;
+}
+
+static int64_t diff_ns(const struct timespec *a, const struct timespec *b)
+{
+	return (int64_t)(a->tv_sec - b->tv_sec) * 1000000000LL + (a->tv_nsec - b->tv_nsec);
+}
+
+static int sampler_stopped(struct umr_reg_sampler *s)
+{
+	return __atomic_load_n(&s->stop, __ATOMIC_RELAXED);
+}
+
+static uint64_t field_value(struct umr_reg_sampler *s, struct sampler_field *f)
+{
+	uint64_t value;
+
+	value = s->batch[f->word].value;
+	if (f->bit64)
+		value |= (uint64_t)s->batch[f->word + 1].value << 32;
+	return (value >> f->shift) & f->mask;
+}
+
+static void *sampler_thread(void *arg)
+{
+	struct umr_reg_sampler *s = arg;
+	struct sampler_field *f;
+	struct timespec deadline, now;
+	uint64_t step;
+	int i;
+
+	umr_affinity_apply(s->asic);
+	umr_access_ctx_bind(s->ctx);
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	for (step = 0; step < s->no_steps && !sampler_stopped(s); step++) {
+		umr_read_regs_batch(s->asic, s->batch, s->no_words);
+
+		pthread_mutex_lock(&s->lock);
+		for (i = 0; i < s->no_fields; i++) {
+			f = &s->fields[i];
+			s->counters[i] += field_value(s, f);
+		}
+		++s->samples;
+		pthread_mutex_unlock(&s->lock);
+
+		if (step + 1 == s->no_steps)
+			break;
+
+		// sleep until the next deadline, dropping those already passed
+		add_ns(&deadline, s->step_ns);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		while (diff_ns(&now, &deadline) > (int64_t)s->step_ns && step + 2 < s->no_steps) {
+			add_ns(&deadline, s->step_ns);
+			++step;
+			__atomic_fetch_add(&s->missed, 1, __ATOMIC_RELAXED);
+		}
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR && !sampler_stopped(s));
+	}
+	umr_access_ctx_bind(NULL);
+
+	pthread_mutex_lock(&s->lock);
+	s->done = 1;
+	pthread_mutex_unlock(&s->lock);
+	return NULL;
+}
+
+static void *adaptive_thread(void *arg)
+{
+	struct umr_reg_sampler *s = arg;
+	struct timespec start, deadline, now, last;
+	uint64_t value, dt, step;
+	int i, changed;
+
+	umr_affinity_apply(s->asic);
+	umr_access_ctx_bind(s->ctx);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	last = start;
+	step = s->rate.step_ns;
+	for (;;) {
+		umr_read_regs_batch(s->asic, s->batch, s->no_words);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		// the first sample stands for the first step
+		dt = s->samples ? (uint64_t)diff_ns(&now, &last) : step;
+		last = now;
+
+		changed = 0;
+		pthread_mutex_lock(&s->lock);
+		for (i = 0; i < s->no_fields; i++) {
+			value = field_value(s, &s->fields[i]);
+			if (s->samples && value != s->prev[i])
+				++changed;
+			s->prev[i] = value;
+			s->counters[i] += value;
+			s->weighted[i] += (double)value * dt;
+		}
+		++s->samples;
+		s->elapsed_ns += dt;
+		pthread_mutex_unlock(&s->lock);
+
+		if (diff_ns(&now, &start) >= (int64_t)s->period_ns || sampler_stopped(s))
+			break;
+
+		step = umr_sample_rate_update(&s->rate, s->no_fields ? (double)changed / s->no_fields : 0.0);
+		deadline = now;
+		add_ns(&deadline, step);
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR && !sampler_stopped(s));
+	}
+	umr_access_ctx_bind(NULL);
+
+	pthread_mutex_lock(&s->lock);
+	s->done = 1;
+	pthread_mutex_unlock(&s->lock);
+	return NULL;
+}
+
+static void sampler_free(struct umr_reg_sampler *s)
+{
+	umr_access_ctx_free(s->ctx);
+	pthread_mutex_destroy(&s->lock);
+	free(s->batch);
+	free(s->fields);
+	free(s->counters);
+	free(s->weighted);
+	free(s->prev);
+	free(s);
+}
+
+static struct umr_reg_sampler *sampler_start(struct umr_asic *asic, struct umr_reg **regs, int no_regs,
+					      uint64_t step_ns, uint64_t period_ns,
+					      const struct umr_sample_rate *rate)
+{
+	struct umr_reg_sampler *s;
+	int i, k, w, f;
+
+	s = calloc(1, sizeof *s);
+	if (!s)
+		goto oom;
+	s->asic = asic;
+	s->step_ns = step_ns ? step_ns : 1;
+	s->no_steps = period_ns / s->step_ns;
+	if (!s->no_steps)
+		s->no_steps = 1;
+	if (rate) {
+		s->adaptive = 1;
+		s->rate = *rate;
+		s->period_ns = period_ns;
+	}
+	pthread_mutex_init(&s->lock, NULL);
+
+	for (i = 0; i < no_regs; i++) {
+		s->no_words += regs[i]->bit64 ? 2 : 1;
+		s->no_fields += regs[i]->no_bits;
+	}
+	s->batch = calloc(s->no_words ? s->no_words : 1, sizeof *s->batch);
+	s->fields = calloc(s->no_fields ? s->no_fields : 1, sizeof *s->fields);
+	s->counters = calloc(s->no_fields ? s->no_fields : 1, sizeof *s->counters);
+	if (s->adaptive) {
+		s->weighted = calloc(s->no_fields ? s->no_fields : 1, sizeof *s->weighted);
+		s->prev = calloc(s->no_fields ? s->no_fields : 1, sizeof *s->prev);
+	}
+	if (!s->batch || !s->fields || !s->counters || (s->adaptive && (!s->weighted || !s->prev))) {
+		sampler_free(s);
+		goto oom;
+	}
+
+	for (i = w = f = 0; i < no_regs; i++) {
+		uint64_t scale = regs[i]->type == REG_MMIO ? 4 : 1;
+
+		s->batch[w].addr = regs[i]->addr * scale;
+		s->batch[w].type = regs[i]->type;
+		if (regs[i]->bit64) {
+			s->batch[w + 1].addr = regs[i]->addr * scale + 4;
+			s->batch[w + 1].type = regs[i]->type;
+		}
+		for (k = 0; k < regs[i]->no_bits; k++, f++) {
+			unsigned width = regs[i]->bits[k].stop - regs[i]->bits[k].start + 1;
+
+			s->fields[f].word = w;
+			s->fields[f].bit64 = regs[i]->bit64;
+			s->fields[f].shift = regs[i]->bits[k].start;
+			s->fields[f].mask = width >= 64 ? ~0ULL : (1ULL << width) - 1;
+		}
+		w += regs[i]->bit64 ? 2 : 1;
+	}
+
+	s->ctx = umr_access_ctx_create(asic);
+	if (!s->ctx || pthread_create(&s->thread, NULL, s->adaptive ? adaptive_thread : sampler_thread, s)) {
+		sampler_free(s);
+		return NULL;
+	}
+	return s;
+oom:
+	asic->err_msg("[ERROR]: Out of memory\n");
+	return NULL;
+}
+
+/**
+ * umr_reg_sampler_start - Start sampling the bitfields of registers
+ *
+ * @asic: The device to read the registers from
+ * @regs: The registers, read without any bank selected
+ * @no_regs: Number of entries in @regs
+ * @step_ns: Time between samples
+ * @period_ns: How long to sample for, at least one sample is taken
+ *
+ * The counters are indexed by bitfield, those of @regs[0] first then
+ * those of @regs[1] and so on.
+ *
+ * Returns the sampler, to be stopped with umr_reg_sampler_stop(), or
+ * NULL on error.
+ */
+struct umr_reg_sampler *umr_reg_sampler_start(struct umr_asic *asic, struct umr_reg **regs, int no_regs,
+					      uint64_t step_ns, uint64_t period_ns)
+{
+	return sampler_start(asic, regs, no_regs, step_ns, period_ns, NULL);
+}
+
+/**
+ * umr_reg_sampler_start_adaptive - Start sampling at a rate that follows the registers
+ *
+ * @asic: The device to read the registers from
+ * @regs: The registers, read without any bank selected
+ * @no_regs: Number of entries in @regs
+ * @rate: The controller of the step, from umr_sample_rate_init() (copied)
+ * @period_ns: How long to sample for, at least one sample is taken
+ *
+ * Like umr_reg_sampler_start() but the step shrinks while the bitfields
+ * change and grows while they don't.  The counters read are weighted by
+ * the time between samples so counter / samples is the time average.
+ */
+struct umr_reg_sampler *umr_reg_sampler_start_adaptive(struct umr_asic *asic, struct umr_reg **regs, int no_regs,
+						       const struct umr_sample_rate *rate, uint64_t period_ns)
+{
+	return sampler_start(asic, regs, no_regs, rate->min_ns, period_ns, rate);
+}
+
+/**
+ * umr_reg_sampler_read - Copy the counters sampled so far
+ *
+ * @s: The sampler
+ * @counters: Where to copy the counters (umr_reg_sampler_fields() of them)
+ * @samples: Set to the number of samples taken (may be NULL)
+ * @missed: Set to the number of samples dropped for being late (may be NULL)
+ *
+ * The counters of an adaptive sampler are weighted by time and scaled
+ * to the number of samples.
+ *
+ * Returns 1 if the sampler is done, 0 if it is still sampling.
+ */
+int umr_reg_sampler_read(struct umr_reg_sampler *s, uint64_t *counters, uint64_t *samples, uint64_t *missed)
+{
+	int done, i;
+
+	pthread_mutex_lock(&s->lock);
+	if (counters && s->adaptive && s->elapsed_ns) {
+		for (i = 0; i < s->no_fields; i++)
+			counters[i] = (uint64_t)(s->weighted[i] * s->samples / s->elapsed_ns + 0.5);
+	} else if (counters) {
+		memcpy(counters, s->counters, s->no_fields * sizeof *counters);
+	}
+	if (samples)
+		*samples = s->samples;
+	done = s->done;
+	pthread_mutex_unlock(&s->lock);
+	if (missed)
+		*missed = __atomic_load_n(&s->missed, __ATOMIC_RELAXED);
+	return done;
+}
+
+/**
+ * umr_reg_sampler_fields - The number of counters of a sampler
+ */
+int umr_reg_sampler_fields(struct umr_reg_sampler *s)
+{
+	return s->no_fields;
+}
+
+/**
+ * umr_reg_sampler_wait - Wait for a sampler to take all of its samples
+ */
+void umr_reg_sampler_wait(struct umr_reg_sampler *s)
+{
+	if (!s->joined)
+		pthread_join(s->thread, NULL);
+	s->joined = 1;
+}
+
+/**
+ * umr_reg_sampler_stop - Stop a sampler (if still running) and free it
+ *
+ * The counters should be read with umr_reg_sampler_read() first.
+ */
+void umr_reg_sampler_stop(struct umr_reg_sampler *s)
+{
+	if (!s)
+		return;
+	__atomic_store_n(&s->stop, 1, __ATOMIC_RELAXED);
+	umr_reg_sampler_wait(s);
+	sampler_free(s);
+}
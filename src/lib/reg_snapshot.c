@@ -0,0 +1,337 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+
+// can this register be read as part of a snapshot (and at what scale)
+static int snapshot_scale(struct umr_asic *asic, struct umr_reg *reg)
+{
+	switch (reg->type) {
+		case REG_MMIO: return 4;
+		case REG_DIDT: return 1;
+		case REG_PCIE: return 1;
+		case REG_SMC: return asic->options.read_smc ? 1 : 0;
+		default: return 0;
+	}
+}
+
+static int block_matches(struct umr_ip_block *ip, const char *ipname)
+{
+	return !ipname || !ipname[0] || !strcmp(ipname, "*") ||
+		!memcmp(ip->ipname, ipname, strlen(ipname));
+}
+
+/**
+ * umr_reg_snapshot_create - Allocate an empty snapshot
+ *
+ * @asic: The device the snapshot is for
+ * @ipname: Optional IP block name prefix ("gfx", "mmhub", ...), NULL
+ *          or "*" selects every IP block.
+ *
+ * Returns the snapshot (with every register marked invalid) or NULL
+ * on error.
+ */
+struct umr_reg_snapshot *umr_reg_snapshot_create(struct umr_asic *asic, const char *ipname)
+{
+	struct umr_reg_snapshot *snap;
+	int i, n;
+
+	snap = calloc(1, sizeof *snap);
+	if (!snap)
+		goto oom;
+
+	for (n = i = 0; i < asic->no_blocks; i++)
+		if (block_matches(asic->blocks[i], ipname))
+			++n;
+
+	snap->blocks = calloc(n ? n : 1, sizeof snap->blocks[0]);
+	if (!snap->blocks)
+		goto oom;
+
+	for (i = 0; i < asic->no_blocks; i++) {
+		if (!block_matches(asic->blocks[i], ipname))
+			continue;
+		umr_load_ip_block(asic, asic->blocks[i]);
+		snap->blocks[snap->no_blocks].ip = asic->blocks[i];
+		snap->blocks[snap->no_blocks].values = calloc(asic->blocks[i]->no_regs + 1, sizeof(uint64_t));
+		snap->blocks[snap->no_blocks].valid = calloc(asic->blocks[i]->no_regs + 1, 1);
+		if (!snap->blocks[snap->no_blocks].values || !snap->blocks[snap->no_blocks].valid) {
+			++snap->no_blocks;
+			goto oom;
+		}
+		++snap->no_blocks;
+	}
+	return snap;
+oom:
+	asic->err_msg("[ERROR]: Out of memory\n");
+	umr_reg_snapshot_free(snap);
+	return NULL;
+}
+
+/**
+ * umr_reg_snapshot_free - Free a snapshot
+ */
+void umr_reg_snapshot_free(struct umr_reg_snapshot *snap)
+{
+	int i;
+
+	if (snap) {
+		for (i = 0; i < snap->no_blocks; i++) {
+			free(snap->blocks[i].values);
+			free(snap->blocks[i].valid);
+		}
+		free(snap->blocks);
+		free(snap);
+	}
+}
+
+/**
+ * umr_reg_snapshot_capture - Read every register of one or more IP blocks
+ *
+ * @asic: The device to read from
+ * @ipname: Optional IP block name prefix (see umr_reg_snapshot_create())
+ *
+ * All registers are read with a single umr_read_regs_batch() call using
+ * the current bank selection so the regs2 interface selects the bank once.
+ * SMC registers are only read with '-O read_smc'.
+ *
+ * Returns the snapshot or NULL on error.
+ */
+struct umr_reg_snapshot *umr_reg_snapshot_capture(struct umr_asic *asic, const char *ipname)
+{
+	struct umr_reg_snapshot *snap;
+	struct umr_reg_batch *batch;
+	struct umr_reg *reg;
+	int i, j, n, scale;
+
+	snap = umr_reg_snapshot_create(asic, ipname);
+	if (!snap)
+		return NULL;
+
+	for (n = i = 0; i < snap->no_blocks; i++)
+		for (j = 0; j < snap->blocks[i].ip->no_regs; j++)
+			if (snapshot_scale(asic, &snap->blocks[i].ip->regs[j]))
+				n += snap->blocks[i].ip->regs[j].bit64 ? 2 : 1;
+
+	batch = calloc(n ? n : 1, sizeof *batch);
+	if (!batch) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		umr_reg_snapshot_free(snap);
+		return NULL;
+	}
+
+	for (n = i = 0; i < snap->no_blocks; i++) {
+		for (j = 0; j < snap->blocks[i].ip->no_regs; j++) {
+			reg = &snap->blocks[i].ip->regs[j];
+			scale = snapshot_scale(asic, reg);
+			if (!scale)
+				continue;
+			batch[n].addr = reg->addr * scale;
+			batch[n].type = reg->type;
+			batch[n].use_bank = asic->options.use_bank;
+			batch[n].bank = asic->options.bank;
+			++n;
+			if (reg->bit64) {
+				batch[n] = batch[n - 1];
+				batch[n].addr = reg->addr * scale + 4;
+				++n;
+			}
+		}
+	}
+
+	if (umr_read_regs_batch(asic, batch, n)) {
+		free(batch);
+		umr_reg_snapshot_free(snap);
+		return NULL;
+	}
+
+	// scatter the values back in the same order they were gathered
+	for (n = i = 0; i < snap->no_blocks; i++) {
+		for (j = 0; j < snap->blocks[i].ip->no_regs; j++) {
+			reg = &snap->blocks[i].ip->regs[j];
+			if (!snapshot_scale(asic, reg))
+				continue;
+			snap->blocks[i].values[j] = batch[n++].value;
+			if (reg->bit64)
+				snap->blocks[i].values[j] |= (uint64_t)batch[n++].value << 32;
+			snap->blocks[i].valid[j] = 1;
+		}
+	}
+
+	free(batch);
+	return snap;
+}
+
+/**
+ * umr_reg_snapshot_save - Export a snapshot as text
+ *
+ * @asic: The device the snapshot was captured from
+ * @snap: The snapshot
+ * @path: File to write
+ *
+ * Each captured register is written as "ipname.regname 0xvalue" which can
+ * be read back with umr_reg_snapshot_load() (or simply diffed as text).
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int umr_reg_snapshot_save(struct umr_asic *asic, struct umr_reg_snapshot *snap, const char *path)
+{
+	FILE *f;
+	int i, j;
+
+	f = fopen(path, "w");
+	if (!f) {
+		asic->err_msg("[ERROR]: Could not open snapshot file [%s] for writing\n", path);
+		return -1;
+	}
+
+	fprintf(f, "# umr register snapshot of %s\n", asic->asicname);
+	for (i = 0; i < snap->no_blocks; i++)
+		for (j = 0; j < snap->blocks[i].ip->no_regs; j++)
+			if (snap->blocks[i].valid[j])
+				fprintf(f, "%s.%s 0x%"PRIx64"\n", snap->blocks[i].ip->ipname, snap->blocks[i].ip->regs[j].regname, snap->blocks[i].values[j]);
+
+	if (fclose(f)) {
+		asic->err_msg("[ERROR]: Could not write snapshot file [%s]\n", path);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * umr_reg_snapshot_load - Import a snapshot written by umr_reg_snapshot_save()
+ *
+ * @asic: The device the snapshot was captured from
+ * @ipname: Optional IP block name prefix, registers of other IP blocks are
+ *          ignored.
+ * @path: File to read
+ *
+ * Registers that are not known to @asic are skipped with a warning.
+ *
+ * Returns the snapshot or NULL on error.
+ */
+struct umr_reg_snapshot *umr_reg_snapshot_load(struct umr_asic *asic, const char *ipname, const char *path)
+{
+	struct umr_reg_snapshot *snap;
+	struct umr_ip_block *ip;
+	struct umr_reg *reg;
+	char line[512], name[512], *dot;
+	uint64_t value;
+	int i;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		asic->err_msg("[ERROR]: Could not open snapshot file [%s]\n", path);
+		return NULL;
+	}
+
+	snap = umr_reg_snapshot_create(asic, ipname);
+	if (!snap) {
+		fclose(f);
+		return NULL;
+	}
+
+	while (fgets(line, sizeof line, f)) {
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+		if (sscanf(line, "%511s %"SCNx64, name, &value) != 2 || !(dot = strrchr(name, '.'))) {
+			asic->err_msg("[WARNING]: Invalid line in snapshot file [%s]: %s", path, line);
+			continue;
+		}
+		*dot++ = 0;
+
+		// the ipname must match exactly (the lookup only matches a prefix)
+		reg = umr_find_reg_data_by_ip_by_instance_with_ip(asic, name, -2, dot, &ip);
+		if (!reg || strcmp(ip->ipname, name)) {
+			asic->err_msg("[WARNING]: Register [%s.%s] from snapshot not found on this ASIC\n", name, dot);
+			continue;
+		}
+		for (i = 0; i < snap->no_blocks; i++) {
+			if (snap->blocks[i].ip == ip) {
+				snap->blocks[i].values[reg - ip->regs] = value;
+				snap->blocks[i].valid[reg - ip->regs] = 1;
+				break;
+			}
+		}
+	}
+	fclose(f);
+	return snap;
+}
+
+/**
+ * umr_reg_snapshot_diff - Compare two snapshots
+ *
+ * @asic: The device the snapshots are for
+ * @a: The "before" snapshot
+ * @b: The "after" snapshot
+ * @out: Where to print changed registers (can be NULL to only count them)
+ *
+ * Both snapshots must have been created for the same @asic.  Registers
+ * that are valid in both snapshots and whose values differ are printed
+ * along with any bitfields that changed if '-O bits' is enabled.
+ *
+ * Returns the number of registers that differ.
+ */
+int umr_reg_snapshot_diff(struct umr_asic *asic, struct umr_reg_snapshot *a, struct umr_reg_snapshot *b, FILE *out)
+{
+	struct umr_reg *reg;
+	uint64_t va, vb, mask;
+	int i, j, k, l, n = 0;
+
+	for (i = 0; i < a->no_blocks; i++) {
+		// snapshots usually cover the same blocks in the same order
+		for (l = (i < b->no_blocks && b->blocks[i].ip == a->blocks[i].ip) ? i : 0; l < b->no_blocks; l++)
+			if (b->blocks[l].ip == a->blocks[i].ip)
+				break;
+		if (l == b->no_blocks)
+			continue;
+
+		for (j = 0; j < a->blocks[i].ip->no_regs; j++) {
+			if (!a->blocks[i].valid[j] || !b->blocks[l].valid[j])
+				continue;
+			va = a->blocks[i].values[j];
+			vb = b->blocks[l].values[j];
+			if (va == vb)
+				continue;
+
+			++n;
+			if (!out)
+				continue;
+
+			reg = &a->blocks[i].ip->regs[j];
+			fprintf(out, "%s%s.%s%s => %s0x%08"PRIx64"%s -> %s0x%08"PRIx64"%s\n",
+				CYAN, a->blocks[i].ip->ipname, reg->regname, RST, YELLOW, va, RST, YELLOW, vb, RST);
+			if (asic->options.bitfields) {
+				for (k = 0; k < reg->no_bits; k++) {
+					mask = umr_bitfield_mask(&reg->bits[k]);
+					if (((va >> reg->bits[k].start) & mask) != ((vb >> reg->bits[k].start) & mask))
+						fprintf(out, "\t%s%s%s: 0x%"PRIx64" -> 0x%"PRIx64"\n", GREEN, reg->bits[k].regname, RST,
+							(va >> reg->bits[k].start) & mask, (vb >> reg->bits[k].start) & mask);
+				}
+			}
+		}
+	}
+	return n;
+}
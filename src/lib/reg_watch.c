@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+
+/*
+ * Register watchpoints.  A small set of registers is polled on a thread
+ * of its own (with its own access context) and every poll the triggers
+ * are evaluated against it.  When one fires the snapshot is taken right
+ * away: more registers, the pointers of some rings and optionally the
+ * waves, into the next slot of a ring buffer of hits.
+ *
+ * The registers are read with umr_read_regs_batch() which goes through
+ * the PCI BAR when it is mapped and through one regs2 read per bank
+ * otherwise.  The slots are allocated up front so taking a snapshot only
+ * costs the reads (the wave scan excepted).
+ */
+
+struct umr_reg_watch {
+	struct umr_asic *asic;
+	struct umr_access_ctx *ctx;
+	struct umr_reg_watch_trigger *triggers;
+	int no_triggers, no_regs, no_snap_regs, no_rings, waves, capacity;
+	char (*rings)[64];
+	struct umr_reg_batch *batch, *snap_batch;
+	int *word, *snap_word;      // index of the (low) word of each register
+	uint8_t *bit64, *snap_bit64;
+	uint64_t step_ns, period_ns;
+	struct umr_gpu_clock clock;
+	pthread_t thread;
+	int joined;
+
+	struct umr_reg_watch_hit *hits;
+	uint64_t polls, no_hits;    // the hit n lives in hits[n % capacity]
+	int stop, done;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int watch_stopped(struct umr_reg_watch *w)
+{
+	return __atomic_load_n(&w->stop, __ATOMIC_RELAXED);
+}
+
+static uint64_t batch_value(const struct umr_reg_batch *batch, int word, int bit64)
+{
+	uint64_t value = batch[word].value;
+
+	if (bit64)
+		value |= (uint64_t)batch[word + 1].value << 32;
+	return value;
+}
+
+// does @t fire given the last two polls of its register
+static int trigger_fires(const struct umr_reg_watch_trigger *t, uint64_t prev, uint64_t value, int first)
+{
+	int was = (prev & t->mask) == t->match, is = (value & t->mask) == t->match;
+
+	switch (t->edge) {
+	case UMR_REG_WATCH_LEVEL:
+		return is;
+	case UMR_REG_WATCH_RISING:
+		return !first && !was && is;
+	case UMR_REG_WATCH_FALLING:
+		return !first && was && !is;
+	case UMR_REG_WATCH_CHANGE:
+		return !first && (prev & t->mask) != (value & t->mask);
+	}
+	return 0;
+}
+
+static void take_snapshot(struct umr_reg_watch *w, int trigger, uint64_t poll, uint64_t time_ns)
+{
+	struct umr_reg_watch_hit *h = &w->hits[w->no_hits % w->capacity];
+	uint32_t ringsize;
+	int i;
+
+	h->gpu_ns = w->clock.valid ? umr_gpu_clock_now(w->asic, &w->clock) : 0;
+
+	// the snapshot registers first, they are what was in flight
+	if (w->no_snap_regs)
+		umr_read_regs_batch(w->asic, w->snap_batch, w->snap_word[w->no_snap_regs]);
+	for (i = 0; i < w->no_snap_regs; i++)
+		h->snap_values[i] = batch_value(w->snap_batch, w->snap_word[i], w->snap_bit64[i]);
+	for (i = 0; i < w->no_rings; i++)
+		if (w->asic->ring_func.read_ring_header(w->asic, w->rings[i], h->ring_ptrs[i], &ringsize))
+			memset(h->ring_ptrs[i], 0, sizeof h->ring_ptrs[i]);
+	for (i = 0; i < w->no_regs; i++)
+		h->values[i] = batch_value(w->batch, w->word[i], w->bit64[i]);
+	umr_free_wave_data(h->waves);
+	h->waves = NULL;
+	h->time_ns = time_ns;
+	h->poll = poll;
+	h->trigger = trigger;
+	h->capture_ns = now_ns() - time_ns;
+	if (w->waves)
+		h->waves = umr_scan_wave_data(w->asic);
+	__atomic_store_n(&w->no_hits, w->no_hits + 1, __ATOMIC_RELEASE);
+}
+
+static void *watch_thread(void *arg)
+{
+	struct umr_reg_watch *w = arg;
+	struct umr_reg_watch_trigger *t;
+	struct timespec deadline;
+	uint64_t *prev, value, start, time_ns, poll;
+	int i, fired, stop = 0;
+
+	umr_affinity_apply(w->asic);
+	prev = calloc(w->no_regs ? w->no_regs : 1, sizeof *prev);
+	umr_access_ctx_bind(w->ctx);
+	umr_gpu_clock_init(w->asic, &w->clock);
+	start = now_ns();
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	for (poll = 0; prev && !stop && !watch_stopped(w); poll++) {
+		umr_read_regs_batch(w->asic, w->batch, w->word[w->no_regs]);
+		time_ns = now_ns();
+
+		// one hit per poll, for the first trigger that fires
+		fired = -1;
+		for (i = 0; i < w->no_triggers && fired < 0; i++) {
+			t = &w->triggers[i];
+			value = batch_value(w->batch, w->word[t->reg], w->bit64[t->reg]);
+			if (trigger_fires(t, prev[t->reg], value, !poll))
+				fired = i;
+		}
+		if (fired >= 0) {
+			take_snapshot(w, fired, poll, time_ns);
+			stop = w->triggers[fired].stop;
+		}
+		for (i = 0; i < w->no_regs; i++)
+			prev[i] = batch_value(w->batch, w->word[i], w->bit64[i]);
+		__atomic_store_n(&w->polls, poll + 1, __ATOMIC_RELAXED);
+
+		if (w->period_ns && time_ns - start >= w->period_ns)
+			break;
+		if (w->step_ns) {
+			deadline.tv_nsec += w->step_ns;
+			deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+			deadline.tv_nsec %= 1000000000L;
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR && !watch_stopped(w));
+		}
+	}
+	umr_access_ctx_bind(NULL);
+	free(prev);
+	__atomic_store_n(&w->done, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+// lay the registers out in a batch, word[no_regs] receives the number of words
+static int layout_regs(struct umr_reg **regs, int no_regs, struct umr_reg_batch **batch, int **word, uint8_t **bit64)
+{
+	int i, w;
+
+	*word = calloc(no_regs + 1, sizeof **word);
+	*bit64 = calloc(no_regs + 1, sizeof **bit64);
+	*batch = calloc(2 * no_regs + 1, sizeof **batch);
+	if (!*word || !*bit64 || !*batch)
+		return -1;
+	for (i = w = 0; i < no_regs; i++) {
+		uint64_t scale = regs[i]->type == REG_MMIO ? 4 : 1;
+
+		(*word)[i] = w;
+		(*bit64)[i] = regs[i]->bit64;
+		(*batch)[w].addr = regs[i]->addr * scale;
+		(*batch)[w].type = regs[i]->type;
+		if (regs[i]->bit64) {
+			(*batch)[w + 1].addr = regs[i]->addr * scale + 4;
+			(*batch)[w + 1].type = regs[i]->type;
+		}
+		w += regs[i]->bit64 ? 2 : 1;
+	}
+	(*word)[no_regs] = w;
+	return 0;
+}
+
+/**
+ * umr_reg_watch_free - Stop a watch (if still running) and free it
+ */
+void umr_reg_watch_free(struct umr_reg_watch *w)
+{
+	int i;
+
+	if (!w)
+		return;
+	umr_reg_watch_stop(w);
+	if (w->hits) {
+		for (i = 0; i < w->capacity; i++) {
+			free(w->hits[i].values);
+			free(w->hits[i].snap_values);
+			free(w->hits[i].ring_ptrs);
+			umr_free_wave_data(w->hits[i].waves);
+		}
+	}
+	umr_access_ctx_free(w->ctx);
+	free(w->hits);
+	free(w->triggers);
+	free(w->rings);
+	free(w->batch);
+	free(w->snap_batch);
+	free(w->word);
+	free(w->snap_word);
+	free(w->bit64);
+	free(w->snap_bit64);
+	free(w);
+}
+
+/**
+ * umr_reg_watch_start - Start polling registers for trigger conditions
+ *
+ * @asic: The device to read the registers from
+ * @cfg: What to watch and what to capture, the arrays are copied
+ *
+ * The registers are read without any bank selected.  The rings are read
+ * with asic->ring_func.read_ring_header(), which for the debugfs rings
+ * keeps their files open, and are read once here so the files are opened
+ * before the watch starts.
+ *
+ * Returns the watch, to be freed with umr_reg_watch_free(), or NULL on
+ * error.
+ */
+struct umr_reg_watch *umr_reg_watch_start(struct umr_asic *asic, const struct umr_reg_watch_config *cfg)
+{
+	struct umr_reg_watch *w;
+	uint32_t ptrs[3], ringsize;
+	int i;
+
+	for (i = 0; i < cfg->no_triggers; i++)
+		if (cfg->triggers[i].reg < 0 || cfg->triggers[i].reg >= cfg->no_regs) {
+			asic->err_msg("[ERROR]: Trigger %d watches register %d of %d\n", i, cfg->triggers[i].reg, cfg->no_regs);
+			return NULL;
+		}
+
+	w = calloc(1, sizeof *w);
+	if (!w)
+		goto oom;
+	w->joined = 1;
+	w->asic = asic;
+	w->no_regs = cfg->no_regs;
+	w->no_snap_regs = cfg->no_snap_regs;
+	w->no_triggers = cfg->no_triggers;
+	w->no_rings = cfg->no_rings;
+	w->waves = cfg->waves;
+	w->step_ns = cfg->step_ns;
+	w->period_ns = cfg->period_ns;
+	w->capacity = cfg->capacity > 0 ? cfg->capacity : 64;
+
+	w->triggers = calloc(w->no_triggers + 1, sizeof *w->triggers);
+	w->rings = calloc(w->no_rings + 1, sizeof *w->rings);
+	w->hits = calloc(w->capacity, sizeof *w->hits);
+	if (!w->triggers || !w->rings || !w->hits ||
+	    layout_regs(cfg->regs, w->no_regs, &w->batch, &w->word, &w->bit64) ||
+	    layout_regs(cfg->snap_regs, w->no_snap_regs, &w->snap_batch, &w->snap_word, &w->snap_bit64))
+		goto oom_free;
+	memcpy(w->triggers, cfg->triggers, w->no_triggers * sizeof *w->triggers);
+	for (i = 0; i < w->no_rings; i++)
+		snprintf(w->rings[i], sizeof w->rings[i], "%s", cfg->rings[i]);
+	for (i = 0; i < w->capacity; i++) {
+		w->hits[i].values = calloc(w->no_regs + 1, sizeof *w->hits[i].values);
+		w->hits[i].snap_values = calloc(w->no_snap_regs + 1, sizeof *w->hits[i].snap_values);
+		w->hits[i].ring_ptrs = calloc(w->no_rings + 1, sizeof *w->hits[i].ring_ptrs);
+		if (!w->hits[i].values || !w->hits[i].snap_values || !w->hits[i].ring_ptrs)
+			goto oom_free;
+	}
+
+	for (i = 0; i < w->no_rings; i++)
+		if (asic->ring_func.read_ring_header(asic, w->rings[i], ptrs, &ringsize)) {
+			asic->err_msg("[ERROR]: Could not read the pointers of ring '%s'\n", w->rings[i]);
+			umr_reg_watch_free(w);
+			return NULL;
+		}
+
+	w->ctx = umr_access_ctx_create(asic);
+	if (!w->ctx || pthread_create(&w->thread, NULL, watch_thread, w)) {
+		umr_reg_watch_free(w);
+		return NULL;
+	}
+	w->joined = 0;
+	return w;
+oom_free:
+	umr_reg_watch_free(w);
+oom:
+	asic->err_msg("[ERROR]: Out of memory\n");
+	return NULL;
+}
+
+/**
+ * umr_reg_watch_status - How far a watch got
+ *
+ * @w: The watch
+ * @polls: Set to the number of polls so far (may be NULL)
+ * @hits: Set to the number of hits so far, including those overwritten
+ *        in the ring buffer (may be NULL)
+ *
+ * Returns 1 if the watch is done (its period ran out, a stopping trigger
+ * fired or it was stopped), 0 if it is still polling.
+ */
+int umr_reg_watch_status(struct umr_reg_watch *w, uint64_t *polls, uint64_t *hits)
+{
+	if (polls)
+		*polls = __atomic_load_n(&w->polls, __ATOMIC_RELAXED);
+	if (hits)
+		*hits = __atomic_load_n(&w->no_hits, __ATOMIC_ACQUIRE);
+	return __atomic_load_n(&w->done, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * umr_reg_watch_wait - Wait for a watch to be done
+ */
+void umr_reg_watch_wait(struct umr_reg_watch *w)
+{
+	if (!w->joined)
+		pthread_join(w->thread, NULL);
+	w->joined = 1;
+}
+
+/**
+ * umr_reg_watch_stop - Stop a watch, the hits are kept
+ */
+void umr_reg_watch_stop(struct umr_reg_watch *w)
+{
+	__atomic_store_n(&w->stop, 1, __ATOMIC_RELAXED);
+	umr_reg_watch_wait(w);
+}
+
+/**
+ * umr_reg_watch_get - A hit kept in the ring buffer of a watch
+ *
+ * @w: The watch, stopped or done
+ * @n: Which of the kept hits, 0 is the oldest
+ *
+ * Returns NULL if @n is not a kept hit or the watch is still running.
+ */
+const struct umr_reg_watch_hit *umr_reg_watch_get(struct umr_reg_watch *w, int n)
+{
+	uint64_t kept, first;
+
+	if (!w->joined)
+		return NULL;
+	kept = w->no_hits < (uint64_t)w->capacity ? w->no_hits : (uint64_t)w->capacity;
+	if (n < 0 || (uint64_t)n >= kept)
+		return NULL;
+	first = w->no_hits - kept;
+	return &w->hits[(first + n) % w->capacity];
+}
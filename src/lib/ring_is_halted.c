@@ -23,93 +23,160 @@
  *
  */
 #include "umr.h"
+#include <time.h>
+
+// how long the pointers must stand still by default (microseconds)
+#define RING_HALT_TIMEOUT 500
+
+// first and longest wait between two samples of the pointers (microseconds)
+#define RING_HALT_MIN_DELAY 5
+#define RING_HALT_MAX_DELAY 100
 
 /**
- * umr_ring_is_halted - Try to determine if a ring is actually halted
+ * umr_ring_now_us - The CLOCK_MONOTONIC time in microseconds
+ */
+uint64_t umr_ring_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/* read the rptr/wptr of a kernel ring, -1 if the ring can't be read */
+static int read_ring_pointers(struct umr_asic *asic, char *ringname, uint64_t *rptr, uint64_t *wptr)
+{
+	uint32_t *ringdata, ptrs[3], ringsize;
+
+	// only the pointers are needed if the backend can read them alone
+	if (asic->ring_func.read_ring_header) {
+		if (asic->ring_func.read_ring_header(asic, ringname, ptrs, &ringsize))
+			return -1;
+	} else {
+		ringdata = asic->ring_func.read_ring_data(asic, ringname, &ringsize);
+		if (!ringdata)
+			return -1;
+		memcpy(ptrs, ringdata, sizeof ptrs);
+		free(ringdata);
+	}
+
+	// reduce indices modulo ring size since the kernel
+	// returned values might be unwrapped.
+	ringsize /= 4;
+	if (!ringsize)
+		return -1;
+	*rptr = ptrs[0] % ringsize;
+	*wptr = ptrs[1] % ringsize;
+	return 0;
+}
+
+// the user queue umr is bound to
+#define UQ(asic) ((asic)->options.user_queue.client_info.queue[(asic)->options.user_queue.state.qidx])
+
+/* read the rptr/wptr of the selected user queue, reduced modulo its size */
+static int read_uq_pointers(struct umr_asic *asic, uint64_t *rptr, uint64_t *wptr)
+{
+	if (umr_read_vram(asic, asic->options.vm_partition, 0, UQ(asic).hqd_rptr_addr, 8, &UQ(asic).hqd_rptr_value) < 0) {
+		asic->err_msg("[ERROR]: Could not read hqd_rptr value\n");
+		return -1;
+	}
+	if (umr_read_vram(asic, asic->options.vm_partition, 0, UQ(asic).rb_wptr_poll_addr, 8, &UQ(asic).rb_wptr_poll_value) < 0) {
+		asic->err_msg("[ERROR]: Could not read rb_wptr_poll value\n");
+		return -1;
+	}
+	UQ(asic).rb_wptr_poll_value %= UQ(asic).rb_buf_size;
+	UQ(asic).hqd_rptr_value %= UQ(asic).rb_buf_size;
+	*rptr = UQ(asic).hqd_rptr_value;
+	*wptr = UQ(asic).rb_wptr_poll_value;
+	return 0;
+}
+
+/* read the rptr/wptr of @ringname, -1 for an error, 1 if the ring is gone */
+static int read_pointers(struct umr_asic *asic, char *ringname, uint64_t *rptr, uint64_t *wptr)
+{
+	if (!strcmp(ringname, "uq"))
+		return read_uq_pointers(asic, rptr, wptr);
+	return read_ring_pointers(asic, ringname, rptr, wptr) ? 1 : 0;
+}
+
+/**
+ * umr_ring_halt_window - How long a ring must stand still to be halted
+ *
+ * asic->options.ring_halt_timeout microseconds, 500 if not set.
+ */
+uint64_t umr_ring_halt_window(struct umr_asic *asic)
+{
+	return asic->options.ring_halt_timeout > 0 ? asic->options.ring_halt_timeout : RING_HALT_TIMEOUT;
+}
+
+/**
+ * umr_ring_is_halted_by - Determine if a ring is halted before a deadline
  *
  * @asic: The ASIC the ring is attached to.
  * @ringname: The name of the ring we want to check if it's halted.
+ * @deadline: CLOCK_MONOTONIC time in microseconds (see umr_ring_now_us())
+ *            the answer is needed by, 0 for none
  *
- * Returns 1 if it's halted, 0 or otherwise.
+ * As umr_ring_is_halted() but a ring that has not stood still for the
+ * whole window by @deadline is reported as not halted.
  */
-int umr_ring_is_halted(struct umr_asic *asic, char *ringname)
+int umr_ring_is_halted_by(struct umr_asic *asic, char *ringname, uint64_t deadline)
 {
-	uint32_t *ringdata, ringsize;
-	int n;
+	uint64_t rptr, wptr, nrptr, nwptr, start, delay, timeout, now;
+	int halted = 0, r;
 
 	if (!strcmp(ringname, "none"))
 		return 1;
 
-	if (!strcmp(ringname, "uq")) {
-		int tries = 0;
-		uint64_t rptr, wptr;
+	timeout = umr_ring_halt_window(asic);
 
-		// read initial values
-		if (umr_read_vram(asic, asic->options.vm_partition, 0,
-				asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].hqd_rptr_addr, 8,
-				&rptr) < 0) {
-			asic->err_msg("[ERROR]: Could not read hqd_rptr value\n");
-			return -1;
-		}
-		if (umr_read_vram(asic, asic->options.vm_partition, 0,
-				asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].rb_wptr_poll_addr, 8,
-				&wptr) < 0) {
-			asic->err_msg("[ERROR]: Could not read rb_wptr_poll value\n");
-			return -1;
-		}
-
-		asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].rb_wptr_poll_value %= asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].rb_buf_size;
-		asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].hqd_rptr_value %= asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].rb_buf_size;
-
-		// bail out if no packets left
-		if (wptr == rptr)
-			return 0;
-
-		// re-read the RPTR/WPTR out of the queue and check if RPTR != WPTR
-		do {
-			if (umr_read_vram(asic, asic->options.vm_partition, 0,
-					asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].hqd_rptr_addr, 8,
-					&asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].hqd_rptr_value) < 0) {
-				asic->err_msg("[ERROR]: Could not read hqd_rptr value\n");
-				return -1;
-			}
-			if (umr_read_vram(asic, asic->options.vm_partition, 0,
-					asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].rb_wptr_poll_addr, 8,
-					&asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].rb_wptr_poll_value) < 0) {
-				asic->err_msg("[ERROR]: Could not read rb_wptr_poll value\n");
-				return -1;
-			}
-
-			asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].rb_wptr_poll_value %= asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].rb_buf_size;
-			asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].hqd_rptr_value %= asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].rb_buf_size;
-
-			// if the wptr or rptr moved the queue is obviously not halted.
-			if ((rptr != asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].hqd_rptr_value) ||
-				(wptr != asic->options.user_queue.client_info.queue[asic->options.user_queue.state.qidx].rb_wptr_poll_value)) {
-					return 0;
-			}
-			usleep(5);
-		} while (++tries < 100);
-		return 1;
-	} else {
-		// read ring data and reduce indeices modulo ring size
-		// since the kernel returned values might be unwrapped.
-		for (n = 0; n < 100; n++) {
-			ringdata = asic->ring_func.read_ring_data(asic, ringname, &ringsize);
-			if (!ringdata) {
-				return 0;
-			}
-			ringsize /= 4;
-			ringdata[0] %= ringsize;
-			ringdata[1] %= ringsize;
-			if (ringdata[0] == ringdata[1]) {
-				free(ringdata);
-				return 0;
-			}
-			free(ringdata);
-			usleep(5);
-		}
-	}
+	umr_vm_context_begin(asic);
+
+	// bail out if no packets left
+	r = read_pointers(asic, ringname, &rptr, &wptr);
+	if (r || wptr == rptr)
+		goto out;
 
-	return 1;
+	// re-read the RPTR/WPTR and check if either moved
+	start = now = umr_ring_now_us();
+	delay = RING_HALT_MIN_DELAY;
+	do {
+		if (deadline && now >= deadline)
+			goto out;
+		usleep(delay);
+		if (delay < RING_HALT_MAX_DELAY)
+			delay <<= 1;
+
+		// if the wptr or rptr moved the queue is obviously not halted.
+		r = read_pointers(asic, ringname, &nrptr, &nwptr);
+		if (r || nrptr != rptr || nwptr != wptr)
+			goto out;
+		now = umr_ring_now_us();
+	} while (now - start < timeout);
+	halted = 1;
+out:
+	umr_vm_context_end(asic);
+	return r < 0 ? -1 : halted;
+}
+
+/**
+ * umr_ring_is_halted - Try to determine if a ring is actually halted
+ *
+ * @asic: The ASIC the ring is attached to.
+ * @ringname: The name of the ring we want to check if it's halted.
+ *
+ * A ring is considered halted if it has packets pending and its read
+ * and write pointers do not move for asic->options.ring_halt_timeout
+ * microseconds (500 if not set).  The pointers are sampled with a delay
+ * that starts at a few microseconds and doubles so a ring that is
+ * still moving is usually detected after the first couple of samples.
+ * User queue pointers are read with the VM context held so only the
+ * first sample walks the page tables.
+ *
+ * Returns 1 if it's halted, 0 if not and -1 if the user queue pointers
+ * can't be read.
+ */
+int umr_ring_is_halted(struct umr_asic *asic, char *ringname)
+{
+	return umr_ring_is_halted_by(asic, ringname, 0);
 }
@@ -24,18 +24,44 @@
  */
 #include <umr_rumr.h>
 
+#include <pthread.h>
+
 #define MAX(x, y) (((x) >= (y)) ? (x) : (y))
 
+// freed buffers are kept for the next rumr_buffer_init() (every opcode
+// needs at least two of them) unless the pool is full or the buffer
+// grew too large to be worth holding on to
+#define RUMR_POOL_MAX		8
+#define RUMR_POOL_KEEP_MAX	(1024 * 1024)
+
+static struct {
+	pthread_mutex_t lock;
+	struct rumr_buffer *bufs[RUMR_POOL_MAX];
+	int n;
+} pool = { PTHREAD_MUTEX_INITIALIZER, { NULL }, 0 };
+
 /**
  * @brief Initializes a new rumr_buffer structure.
  *
- * This function allocates memory for a new buffer and sets its initial size.
+ * A buffer is taken from the pool if there is one, otherwise this function
+ * allocates memory for a new buffer and sets its initial size.  The
+ * contents of the buffer are not cleared.
  *
  * @return A pointer to the newly created rumr_buffer, or NULL if allocation fails.
  */
 struct rumr_buffer *rumr_buffer_init(void)
 {
-	struct rumr_buffer *buf;
+	struct rumr_buffer *buf = NULL;
+
+	pthread_mutex_lock(&pool.lock);
+	if (pool.n)
+		buf = pool.bufs[--pool.n];
+	pthread_mutex_unlock(&pool.lock);
+	if (buf) {
+		buf->roffset = buf->woffset = 0;
+		buf->failed = 0;
+		return buf;
+	}
 
 	buf = calloc(1, sizeof *buf);
 	if (!buf)
@@ -50,6 +76,44 @@ struct rumr_buffer *rumr_buffer_init(void)
 	return buf;
 }
 
+/**
+ * @brief Makes room for more data at the end of the buffer.
+ *
+ * The buffer at least doubles in size when it grows so building a large
+ * buffer a piece at a time costs a linear number of copies.  Callers that
+ * know the size of a payload reserve it up front so the buffer grows once.
+ *
+ * @param buf Pointer to the rumr_buffer structure.
+ * @param size Number of bytes that will be added after the write offset.
+ * @return 0 on success, -1 (and the buffer is marked failed) if out of memory.
+ */
+int rumr_buffer_reserve(struct rumr_buffer *buf, uint32_t size)
+{
+	uint64_t need = (uint64_t)buf->woffset + size, new_size;
+	uint8_t *tmp;
+
+	if (buf->failed)
+		return -1;
+	if (need <= buf->size)
+		return 0;
+	if (need > UINT32_MAX - RUMR_BUFFER_PREHEADER) {
+		buf->failed = 1;
+		return -1;
+	}
+
+	for (new_size = MAX(buf->size, 1024); new_size < need; new_size *= 2);
+	if (new_size > UINT32_MAX - RUMR_BUFFER_PREHEADER)
+		new_size = need;
+	tmp = (uint8_t*)realloc(buf->data - RUMR_BUFFER_PREHEADER, new_size + RUMR_BUFFER_PREHEADER);
+	if (!tmp) {
+		buf->failed = 1;
+		return -1;
+	}
+	buf->data = tmp + RUMR_BUFFER_PREHEADER;
+	buf->size = new_size;
+	return 0;
+}
+
 /**
  * @brief Adds data to the end of the buffer.
  *
@@ -61,18 +125,8 @@ struct rumr_buffer *rumr_buffer_init(void)
  */
 void rumr_buffer_add_data(struct rumr_buffer *buf, void *data, uint32_t size)
 {
-	if (buf->failed)
+	if (rumr_buffer_reserve(buf, size))
 		return;
-	if ((buf->woffset + size) > buf->size) {
-		uint32_t new_size = buf->size + MAX(1024, size);
-		uint8_t *tmp = (uint8_t*)realloc(buf->data - RUMR_BUFFER_PREHEADER, new_size + RUMR_BUFFER_PREHEADER);
-		if (!tmp) {
-			buf->failed = 1;
-			return;
-		}
-		buf->data = tmp + RUMR_BUFFER_PREHEADER;
-		buf->size = new_size;
-	}
 	memcpy(buf->data + buf->woffset, data, size);
 	buf->woffset += size;
 }
@@ -133,16 +187,44 @@ uint32_t rumr_buffer_read_uint32(struct rumr_buffer *buf)
 }
 
 /**
- * @brief Frees the memory allocated for a rumr_buffer structure.
+ * @brief Frees a rumr_buffer structure.
+ *
+ * The buffer goes back to the pool if there is room for it.
  *
  * @param buf Pointer to the rumr_buffer structure to free.
  */
 void rumr_buffer_free(struct rumr_buffer *buf)
 {
-	if (buf) {
+	if (!buf)
+		return;
+	if (!buf->failed && buf->size <= RUMR_POOL_KEEP_MAX) {
+		pthread_mutex_lock(&pool.lock);
+		if (pool.n < RUMR_POOL_MAX) {
+			pool.bufs[pool.n++] = buf;
+			buf = NULL;
+		}
+		pthread_mutex_unlock(&pool.lock);
+		if (!buf)
+			return;
+	}
+	free(buf->data - RUMR_BUFFER_PREHEADER);
+	free(buf);
+}
+
+/**
+ * @brief Releases the buffers held by the pool.
+ */
+void rumr_buffer_pool_flush(void)
+{
+	struct rumr_buffer *buf;
+
+	pthread_mutex_lock(&pool.lock);
+	while (pool.n) {
+		buf = pool.bufs[--pool.n];
 		free(buf->data - RUMR_BUFFER_PREHEADER);
 		free(buf);
 	}
+	pthread_mutex_unlock(&pool.lock);
 }
 
 /**
@@ -24,41 +24,86 @@
  */
 #include <umr_rumr.h>
 #include <stdarg.h>
+#include <dirent.h>
+#include <errno.h>
 
 /* Implementation of "the" client side.  This should be
  * static for all cases as this binds to the umr library
  * for client services
  */
 
-/* helper used to send opcodes to the server */
-static struct rumr_buffer *send_opcode(struct rumr_client_state *state, uint32_t opcode, int nparam, ...)
+// start an opcode packet with room for @size bytes after the header word
+static struct rumr_buffer *opcode_buf(uint32_t opcode, uint32_t size)
 {
-	va_list ap;
 	struct rumr_buffer *buf;
-	int r;
 
-	va_start(ap, nparam);
 	buf = rumr_buffer_init();
+	if (!buf)
+		return NULL;
+	if (rumr_buffer_reserve(buf, 4 + size)) {
+		rumr_buffer_free(buf);
+		return NULL;
+	}
 	rumr_buffer_add_uint32(buf, (opcode << 10) | (RUMR_VERSION << 1)); // header word
-	while (nparam--) {
-		uint32_t next;
-		next = va_arg(ap, uint32_t);
-		rumr_buffer_add_uint32(buf, next);
+	return buf;
+}
+
+// send a packet from opcode_buf() (consumed) followed by @size bytes of
+// @data, which go out uncompressed from where they are if the comms can
+static int transact_send(struct rumr_client_state *state, struct rumr_buffer *buf, const void *data, uint32_t size)
+{
+	int r;
+
+	if (size && !state->comm.txv && buf)
+		rumr_buffer_add_data(buf, (void *)data, size);
+	if (!buf || buf->failed || ((!size || !state->comm.txv) && rumr_buffer_compress(buf, state->codecs))) {
+		state->log_msg("[ERROR]: Out of memory\n");
+		rumr_buffer_free(buf);
+		return -1;
 	}
-	r = state->comm.tx(&state->comm, buf);
+	// the round trip is timed up to the reply in transact_reply()
+	memcpy(&state->sent_opcode, buf->data, 4);
+	state->sent_opcode = (state->sent_opcode >> 10) & 0xFF;
+	state->sent_bytes = buf->woffset + (state->comm.txv ? size : 0);
+	state->sent_ns = rumr_stats_now();
+	if (size && state->comm.txv)
+		r = state->comm.txv(&state->comm, buf, data, size);
+	else
+		r = state->comm.tx(&state->comm, buf);
 	rumr_buffer_free(buf);
-	buf = NULL;
 	if (r) {
 		state->log_msg("[ERROR]: Could not transmit opcode to server.\n");
-		goto error;
+		return -1;
 	}
+	return 0;
+}
 
-	// there is no return packet
-	if (opcode == RUMR_OP_GOODBYE)
-		goto error;
+// receive the reply from the server, if @dst is given and the comms can
+// the @size bytes after the first @head of the reply are received
+// straight into it and *direct is set
+static struct rumr_buffer *transact_reply(struct rumr_client_state *state, uint32_t head, void *dst, uint32_t size, int *direct)
+{
+	struct rumr_buffer *buf = NULL;
+	int r;
 
-	// return reply from server
-	r = state->comm.rx(&state->comm, &buf);
+	if (direct)
+		*direct = 0;
+	if (dst && state->comm.rx_into)
+		r = state->comm.rx_into(&state->comm, &buf, head, dst, size, direct);
+	else
+		r = state->comm.rx(&state->comm, &buf);
+	if (!r && buf) {
+		uint64_t rtt = rumr_stats_now() - state->sent_ns;
+		uint32_t rx = buf->woffset + ((direct && *direct) ? size : 0);
+
+		rumr_stats_add(state->stats, state->sent_opcode, rtt, state->sent_bytes, rx);
+		umr_io_account(state->asic, UMR_IO_RUMR, UMR_IO_WRITE, state->sent_bytes, 0);
+		umr_io_account(state->asic, UMR_IO_RUMR, UMR_IO_READ, rx, rtt);
+	}
+	if (!r && buf && rumr_buffer_decompress(buf)) {
+		state->log_msg("[ERROR]: Could not decompress reply from server\n");
+		r = -1;
+	}
 	if (!r && buf) {
 		uint32_t reply;
 		// ensure version and server bit is correct
@@ -77,104 +122,273 @@ static struct rumr_buffer *send_opcode(struct rumr_client_state *state, uint32_t
 		rumr_buffer_free(buf);
 		buf = NULL;
 	}
-error:
-	va_end(ap);
 	return buf;
 }
 
+// send a packet from opcode_buf() (consumed) and return the reply from the server
+static struct rumr_buffer *transact(struct rumr_client_state *state, struct rumr_buffer *buf, int reply_expected)
+{
+	if (transact_send(state, buf, NULL, 0))
+		return NULL;
+
+	// there is no return packet
+	if (!reply_expected)
+		return NULL;
+
+	// return reply from server
+	return transact_reply(state, 0, NULL, 0, NULL);
+}
+
+/* helper used to send opcodes to the server */
+static struct rumr_buffer *send_opcode(struct rumr_client_state *state, uint32_t opcode, int nparam, ...)
+{
+	va_list ap;
+	struct rumr_buffer *buf;
+
+	va_start(ap, nparam);
+	buf = opcode_buf(opcode, nparam * 4);
+	while (buf && nparam--) {
+		uint32_t next;
+		next = va_arg(ap, uint32_t);
+		rumr_buffer_add_uint32(buf, next);
+	}
+	va_end(ap);
+	return transact(state, buf, opcode != RUMR_OP_GOODBYE);
+}
+
 static struct rumr_buffer *send_opcode_buf(struct rumr_client_state *state, uint32_t opcode, uint32_t *pkt, uint32_t pktsize)
 {
 	struct rumr_buffer *buf;
-	int r;
 
-	buf = rumr_buffer_init();
-		rumr_buffer_add_uint32(buf, (opcode << 10) | (RUMR_VERSION << 1)); // header word
+	buf = opcode_buf(opcode, pktsize * 4);
+	if (buf)
 		rumr_buffer_add_data(buf, pkt, pktsize*4);
-	r = state->comm.tx(&state->comm, buf);
-	rumr_buffer_free(buf);
-	buf = NULL;
-	if (r) {
-		state->log_msg("[ERROR]: Could not transmit opcode to server.\n");
-		goto error;
-	}
+	return transact(state, buf, 1);
+}
 
-	// return reply from server
-	r = state->comm.rx(&state->comm, &buf);
-	if (!r && buf) {
-		uint32_t reply;
-		// ensure version and server bit is correct
-		reply = rumr_buffer_read_uint32(buf);
-		if (((reply>>1)&0xFF) != RUMR_VERSION) {
-			state->log_msg("[ERROR]: Incorrect server version returned from server\n");
-			rumr_buffer_free(buf);
-			return NULL;
+static struct rumr_buffer *send_opcode_data(struct rumr_client_state *state, uint32_t opcode, void *pkt, uint32_t pktsize)
+{
+	struct rumr_buffer *buf;
+
+	buf = opcode_buf(opcode, pktsize);
+	if (buf)
+		rumr_buffer_add_data(buf, pkt, pktsize);
+	return transact(state, buf, 1);
+}
+
+/*
+ * Cache for "frozen" sessions (-O rumr_cache): registers (keyed by address,
+ * type and bank) and memory (in 4 KiB pages) are only read from the server
+ * once.  Any write through the client drops everything, as does
+ * rumr_client_cache_flush(), so it is only safe while nothing else changes
+ * the GPU (waves and rings halted).
+ */
+#define RCACHE_BUCKETS		1024
+#define RCACHE_PAGE		4096ULL
+#define RCACHE_MAX_PAGES	16384			// 64 MiB of memory, then start over
+#define RCACHE_MAX_FILL		(16 * 1024 * 1024)	// larger reads are not cached
+
+struct rcache_reg {
+	uint64_t addr, value;
+	uint32_t type, bank[4];
+	int use_bank, bit64;
+	struct rcache_reg *next;
+};
+
+struct rcache_page {
+	uint64_t addr;
+	int vram;
+	struct rcache_page *next;
+	uint8_t data[RCACHE_PAGE];
+};
+
+struct rumr_client_cache {
+	struct rcache_reg *regs[RCACHE_BUCKETS];
+	struct rcache_page *pages[RCACHE_BUCKETS];
+	uint32_t no_pages;
+};
+
+/**
+ * rumr_client_cache_flush - Drop everything read with -O rumr_cache
+ * @state: The client state
+ *
+ * Call this when the GPU may have changed behind the client's back (e.g.
+ * after waves or rings were resumed).
+ */
+void rumr_client_cache_flush(struct rumr_client_state *state)
+{
+	struct rumr_client_cache *cache = state->cache;
+	struct rcache_reg *r, *rn;
+	struct rcache_page *p, *pn;
+	unsigned x;
+
+	if (!cache)
+		return;
+	for (x = 0; x < RCACHE_BUCKETS; x++) {
+		for (r = cache->regs[x]; r; r = rn) {
+			rn = r->next;
+			free(r);
 		}
-		if (!(reply&1)) {
-			state->log_msg("[ERROR]: Incorrect server flag returned from server\n");
-			rumr_buffer_free(buf);
-			return NULL;
+		for (p = cache->pages[x]; p; p = pn) {
+			pn = p->next;
+			free(p);
 		}
-	} else {
-		rumr_buffer_free(buf);
-		buf = NULL;
 	}
-error:
-	return buf;
+	memset(cache, 0, sizeof *cache);
 }
 
-static struct rumr_buffer *send_opcode_data(struct rumr_client_state *state, uint32_t opcode, void *pkt, uint32_t pktsize)
+// the cache if -O rumr_cache is set, dropped if it was turned off
+static struct rumr_client_cache *cache_get(struct rumr_client_state *state)
 {
-	struct rumr_buffer *buf;
-	int r;
+	if (!state->asic || !state->asic->options.rumr_cache) {
+		if (state->cache) {
+			rumr_client_cache_flush(state);
+			free(state->cache);
+			state->cache = NULL;
+		}
+		return NULL;
+	}
+	if (!state->cache)
+		state->cache = calloc(1, sizeof *state->cache);
+	return state->cache;
+}
 
-	buf = rumr_buffer_init();
-		rumr_buffer_add_uint32(buf, (opcode << 10) | (RUMR_VERSION << 1)); // header word
-		rumr_buffer_add_data(buf, pkt, pktsize);
-	r = state->comm.tx(&state->comm, buf);
-	rumr_buffer_free(buf);
-	buf = NULL;
-	if (r) {
-		state->log_msg("[ERROR]: Could not transmit opcode to server.\n");
-		goto error;
+static void cache_bank_key(int use_bank, const union umr_bank_select *bank, uint32_t *key)
+{
+	memset(key, 0, 4 * sizeof key[0]);
+	if (use_bank == 1) {
+		key[0] = bank->grbm.se;
+		key[1] = bank->grbm.sh;
+		key[2] = bank->grbm.instance;
+	} else if (use_bank == 2) {
+		key[0] = bank->srbm.me;
+		key[1] = bank->srbm.pipe;
+		key[2] = bank->srbm.queue;
+		key[3] = bank->srbm.vmid;
 	}
+}
 
-	// return reply from server
-	r = state->comm.rx(&state->comm, &buf);
-	if (!r && buf) {
-		uint32_t reply;
-		// ensure version and server bit is correct
-		reply = rumr_buffer_read_uint32(buf);
-		if (((reply>>1)&0xFF) != RUMR_VERSION) {
-			state->log_msg("[ERROR]: Incorrect server version returned from server\n");
-			rumr_buffer_free(buf);
-			return NULL;
+static struct rcache_reg **cache_reg_find(struct rumr_client_cache *cache, uint64_t addr, enum regclass type,
+					  int use_bank, const union umr_bank_select *bank, int bit64)
+{
+	struct rcache_reg **pr;
+	uint32_t key[4];
+
+	cache_bank_key(use_bank, bank, key);
+	for (pr = &cache->regs[(addr >> 2) % RCACHE_BUCKETS]; *pr; pr = &(*pr)->next)
+		if ((*pr)->addr == addr && (*pr)->type == (uint32_t)type && (*pr)->use_bank == use_bank &&
+		    (*pr)->bit64 == bit64 && !memcmp((*pr)->bank, key, sizeof key))
+			break;
+	return pr;
+}
+
+static void cache_reg_insert(struct rumr_client_cache *cache, uint64_t addr, enum regclass type,
+			     int use_bank, const union umr_bank_select *bank, int bit64, uint64_t value)
+{
+	struct rcache_reg **pr = cache_reg_find(cache, addr, type, use_bank, bank, bit64), *r = *pr;
+
+	if (!r) {
+		r = calloc(1, sizeof *r);
+		if (!r)
+			return;
+		r->addr = addr;
+		r->type = type;
+		r->use_bank = use_bank;
+		r->bit64 = bit64;
+		cache_bank_key(use_bank, bank, r->bank);
+		*pr = r;
+	}
+	r->value = value;
+}
+
+static struct rcache_page *cache_page_find(struct rumr_client_cache *cache, uint64_t addr, int vram)
+{
+	struct rcache_page *p;
+
+	for (p = cache->pages[(addr / RCACHE_PAGE) % RCACHE_BUCKETS]; p; p = p->next)
+		if (p->addr == addr && p->vram == vram)
+			return p;
+	return NULL;
+}
+
+static int mem_op(struct umr_asic *asic, uint64_t *addr, uint32_t size, void *dst, int write_en, int vram_en);
+
+/*
+ * Read memory through the page cache, the pages from the first one not
+ * cached to the last one of the read are fetched with a single opcode.
+ */
+static int cached_mem_read(struct umr_asic *asic, struct rumr_client_cache *cache, uint64_t address, uint32_t size, uint8_t *dst, int vram_en)
+{
+	uint64_t first, last, a, fill;
+	struct rcache_page *p;
+	uint8_t *buf;
+	uint32_t off, len;
+
+	first = address & ~(RCACHE_PAGE - 1);
+	last = (address + size - 1) & ~(RCACHE_PAGE - 1);
+	for (a = first; a <= last && cache_page_find(cache, a, vram_en); a += RCACHE_PAGE);
+	if (a <= last) {
+		fill = last + RCACHE_PAGE - a;
+		if (fill > RCACHE_MAX_FILL)
+			return mem_op(asic, &address, size, dst, 0, vram_en);
+		buf = malloc(fill);
+		if (!buf || mem_op(asic, &a, fill, buf, 0, vram_en)) {
+			// the whole pages may not be readable, try just what was asked for
+			free(buf);
+			return mem_op(asic, &address, size, dst, 0, vram_en);
 		}
-		if (!(reply&1)) {
-			state->log_msg("[ERROR]: Incorrect server flag returned from server\n");
-			rumr_buffer_free(buf);
-			return NULL;
+		if (cache->no_pages + fill / RCACHE_PAGE > RCACHE_MAX_PAGES) {
+			struct rumr_client_state *state = asic->mem_funcs.data;
+			struct rcache_reg *regs[RCACHE_BUCKETS];
+
+			// start over but keep the registers
+			memcpy(regs, cache->regs, sizeof regs);
+			memset(cache->regs, 0, sizeof cache->regs);
+			rumr_client_cache_flush(state);
+			memcpy(cache->regs, regs, sizeof regs);
 		}
-	} else {
-		rumr_buffer_free(buf);
-		buf = NULL;
+		for (off = 0; off < fill; off += RCACHE_PAGE) {
+			p = cache_page_find(cache, a + off, vram_en);
+			if (!p) {
+				p = malloc(sizeof *p);
+				if (!p) {
+					free(buf);
+					return mem_op(asic, &address, size, dst, 0, vram_en);
+				}
+				p->addr = a + off;
+				p->vram = vram_en;
+				p->next = cache->pages[(p->addr / RCACHE_PAGE) % RCACHE_BUCKETS];
+				cache->pages[(p->addr / RCACHE_PAGE) % RCACHE_BUCKETS] = p;
+				++cache->no_pages;
+			}
+			memcpy(p->data, buf + off, RCACHE_PAGE);
+		}
+		free(buf);
 	}
-error:
-	return buf;
+
+	for (a = address; size; a += len, dst += len, size -= len) {
+		off = a & (RCACHE_PAGE - 1);
+		len = RCACHE_PAGE - off;
+		if (len > size)
+			len = size;
+		p = cache_page_find(cache, a - off, vram_en);
+		if (!p)
+			return mem_op(asic, &a, size, dst, 0, vram_en);
+		memcpy(dst, p->data + off, len);
+	}
+	return 0;
 }
 
 // handle VRAM/SRAM reads/writes and DMA translations
 static int mem_op(struct umr_asic *asic, uint64_t *addr, uint32_t size, void *dst, int write_en, int vram_en)
 {
 	struct rumr_buffer *buf;
-	int subop;
-	uint32_t *pkt, n;
+	int subop, direct;
+	uint32_t wsize;
 	struct rumr_client_state *state = asic->mem_funcs.data;
 
-	pkt = calloc(6 + (write_en ? size >> 2 : 0), sizeof pkt[0]);
-	if (!pkt) {
-		state->log_msg("[ERROR]: Out of memory\n");
-		return -1;
-	}
+	if (write_en)
+		rumr_client_cache_flush(state);
 
 	if (!dst) {
 		subop = 2;
@@ -182,24 +396,28 @@ static int mem_op(struct umr_asic *asic, uint64_t *addr, uint32_t size, void *ds
 		subop = (vram_en) ? 0 : 1;
 	}
 
-	pkt[0] = (*addr & 0xFFFFFFFFULL);
-	pkt[1] = (*addr >> 32ULL);
-	pkt[2] = (write_en ? (1<<2) : 0) | (subop);
-	pkt[3] = size;
-	// share with the server the VA we're tying to decode because it'll be needed to access HMM space
-	pkt[4] = (asic->options.user_queue.state.va & 0xFFFFFFFFULL);
-	pkt[5] = (asic->options.user_queue.state.va >> 32ULL);
-
-	n = 0;
-	if (write_en && dst) {
-		uint32_t *pbuf = dst;
-		for (n = 0; n < (size >> 2); n++) {
-			pkt[6 + n] = pbuf[n];
+	// the data to write goes right after the 6 word packet, large
+	// writes are sent from @dst itself
+	wsize = (write_en && dst) ? (size & ~3U) : 0;
+	buf = opcode_buf(RUMR_OP_MEM_ACCESS, 6 * 4 + ((wsize < RUMR_TXV_MIN) ? wsize : 0));
+	if (buf) {
+		rumr_buffer_add_uint32(buf, (*addr & 0xFFFFFFFFULL));
+		rumr_buffer_add_uint32(buf, (*addr >> 32ULL));
+		rumr_buffer_add_uint32(buf, (write_en ? (1<<2) : 0) | (subop));
+		rumr_buffer_add_uint32(buf, size);
+		// share with the server the VA we're tying to decode because it'll be needed to access HMM space
+		rumr_buffer_add_uint32(buf, (asic->options.user_queue.state.va & 0xFFFFFFFFULL));
+		rumr_buffer_add_uint32(buf, (asic->options.user_queue.state.va >> 32ULL));
+		if (wsize && wsize < RUMR_TXV_MIN) {
+			rumr_buffer_add_data(buf, dst, wsize);
+			wsize = 0;
 		}
 	}
-	n += 6;
-	buf = send_opcode_buf(asic->mem_funcs.data, RUMR_OP_MEM_ACCESS, pkt, n);
-	free(pkt);
+
+	// read data lands in @dst straight from the comms if possible
+	// (after the header, status and address words of the reply)
+	buf = transact_send(state, buf, dst, wsize) ? NULL :
+		transact_reply(state, 16, (!write_en && subop != 2) ? dst : NULL, size, &direct);
 
 	if (!buf || rumr_buffer_read_uint32(buf) != 1) {
 		state->log_msg("[ERROR]: Could not transmit memory opcode.\n");
@@ -210,7 +428,7 @@ static int mem_op(struct umr_asic *asic, uint64_t *addr, uint32_t size, void *ds
 	*addr  =  rumr_buffer_read_uint32(buf);
 	*addr |=  (uint64_t)rumr_buffer_read_uint32(buf) << 32ULL;
 
-	if (!write_en && subop != 2) {
+	if (!write_en && subop != 2 && !direct) {
 		rumr_buffer_read_data(buf, dst, size);
 	}
 
@@ -228,6 +446,11 @@ static int mem_op(struct umr_asic *asic, uint64_t *addr, uint32_t size, void *ds
  */
 static int access_sram(struct umr_asic *asic, uint64_t address, uint32_t size, void *dst, int write_en)
 {
+	struct rumr_client_cache *cache = cache_get(asic->mem_funcs.data);
+
+	// user queue reads are resolved by the server with the VA being decoded
+	if (cache && !write_en && size && !asic->options.user_queue.state.active)
+		return cached_mem_read(asic, cache, address, size, dst, 0);
 	return mem_op(asic, &address, size, dst, write_en, 0);
 }
 
@@ -240,9 +463,69 @@ static int access_sram(struct umr_asic *asic, uint64_t address, uint32_t size, v
  */
 static int access_linear_vram(struct umr_asic *asic, uint64_t address, uint32_t size, void *data, int write_en)
 {
+	struct rumr_client_cache *cache = cache_get(asic->mem_funcs.data);
+
+	if (cache && !write_en && size)
+		return cached_mem_read(asic, cache, address, size, data, 1);
 	return mem_op(asic, &address, size, data, write_en, 1);
 }
 
+/** access_vram -- Access memory through a GPU VM with the page walk done by the server
+ * @asic, @partition, @vmid, @address, @size, @data, @write_en, @vmdata: as for umr_access_vram()
+ *
+ * Returns 1 to have the page tables walked here when the walk has to be
+ * seen locally (verbose or va_addr_decode), for user queues (the server
+ * resolves their pages with the VA being decoded) and with -O rumr_cache
+ * (the walk is then served from the cache).
+ */
+static int access_vram(struct umr_asic *asic, int partition, uint32_t vmid, uint64_t address, uint32_t size, void *data, int write_en, struct umr_vm_pagewalk *vmdata)
+{
+	struct rumr_client_state *state = asic->mem_funcs.data;
+	struct rumr_buffer *buf;
+	uint32_t wsize;
+	int direct;
+
+	if (asic->options.verbose || asic->mem_funcs.va_addr_decode ||
+	    asic->options.user_queue.state.active || cache_get(state))
+		return 1;
+
+	// the data to write goes right after the 6 word packet, large
+	// writes are sent from @data itself
+	wsize = write_en ? size : 0;
+	buf = opcode_buf(RUMR_OP_VM_ACCESS, 6 * 4 + ((wsize < RUMR_TXV_MIN) ? wsize : 0));
+	if (buf) {
+		rumr_buffer_add_uint32(buf, (address & 0xFFFFFFFFULL));
+		rumr_buffer_add_uint32(buf, (address >> 32ULL));
+		rumr_buffer_add_uint32(buf, vmid);
+		rumr_buffer_add_uint32(buf, partition);
+		rumr_buffer_add_uint32(buf, (write_en ? RUMR_VM_WRITE : 0) | (vmdata ? RUMR_VM_PAGEWALK : 0));
+		rumr_buffer_add_uint32(buf, size);
+		if (wsize && wsize < RUMR_TXV_MIN) {
+			rumr_buffer_add_data(buf, data, wsize);
+			wsize = 0;
+		}
+	}
+
+	// read data lands in @data straight from the comms if possible
+	// (after the header, status and page walk of the reply)
+	buf = transact_send(state, buf, data, wsize) ? NULL :
+		transact_reply(state, 8 + (vmdata ? sizeof *vmdata : 0), write_en ? NULL : data, size, &direct);
+	if (!buf) {
+		state->log_msg("[ERROR]: Could not transmit VM opcode.\n");
+		return -1;
+	}
+	if (rumr_buffer_read_uint32(buf) != 1) {
+		rumr_buffer_free(buf);
+		return -1;
+	}
+	if (vmdata)
+		rumr_buffer_read_data(buf, vmdata, sizeof *vmdata);
+	if (!write_en && !direct)
+		rumr_buffer_read_data(buf, data, size);
+	rumr_buffer_free(buf);
+	return 0;
+}
+
 /** gpu_bus_to_cpu_address --	convert a GPU bound address for
  * 				system memory pages to CPU bound
  * 				addresses
@@ -378,82 +661,62 @@ static int get_wave_status(struct umr_asic *asic, unsigned se, unsigned sh, unsi
 	return r;
 }
 
-static int mmio_reg_op(struct umr_asic *asic, uint64_t addr, enum regclass type, uint32_t *value, int read_en)
+// build a RUMR_OP_REG_ACCESS packet, returns the number of words in it
+static uint32_t reg_op_packet(uint32_t *pkt, uint64_t addr, enum regclass type, int use_bank, const union umr_bank_select *bank,
+			      uint64_t value, int read_en, int bit64)
 {
-	struct rumr_buffer *buf;
-	struct rumr_client_state *state = asic->reg_funcs.data;
+	uint32_t n;
 
-	if (asic->options.use_bank == 1) {
+	pkt[0] = (uint32_t)(addr & 0xFFFFFFFFULL);		// ADDR_LO
+	pkt[1] = (uint32_t)(addr >> 32ULL);			// ADDR_HI
+	pkt[2] = (uint32_t)((read_en ? 1 : 0) | (type << 3) | (bit64 << 11));	// ACCESS_BANK
+	if (use_bank == 1) {
 		// GRBM
-		if (read_en) {
-			buf = send_opcode(asic->reg_funcs.data, RUMR_OP_REG_ACCESS, 7,
-					(uint32_t)(addr & 0xFFFFFFFFULL),		// ADDR_LO
-					(uint32_t)(addr >> 32ULL),			// ADDR_HI
-					(uint32_t)(1 | (1 << 1) | (type << 3)),		// ACCESS_BANK
-					(uint32_t)asic->options.bank.grbm.se,
-					(uint32_t)asic->options.bank.grbm.sh,
-					(uint32_t)asic->options.bank.grbm.instance,
-					(uint32_t)0);
-		} else {
-			buf = send_opcode(asic->reg_funcs.data, RUMR_OP_REG_ACCESS, 9,
-					(uint32_t)(addr & 0xFFFFFFFFULL),		// ADDR_LO
-					(uint32_t)(addr >> 32ULL),			// ADDR_HI
-					(uint32_t)(0 | (1 << 1) | (type << 3)),		// ACCESS_BANK
-					(uint32_t)asic->options.bank.grbm.se,
-					(uint32_t)asic->options.bank.grbm.sh,
-					(uint32_t)asic->options.bank.grbm.instance,
-					(uint32_t)0,
-					(uint32_t)(*value),
-					(uint32_t)0);
-		}
-	} else if (asic->options.use_bank == 2) {
+		pkt[2] |= 1 << 1;
+		pkt[3] = bank->grbm.se;
+		pkt[4] = bank->grbm.sh;
+		pkt[5] = bank->grbm.instance;
+		pkt[6] = 0;
+	} else if (use_bank == 2) {
 		// SRBM
-		if (read_en) {
-			buf = send_opcode(asic->reg_funcs.data, RUMR_OP_REG_ACCESS, 7,
-					(uint32_t)(addr & 0xFFFFFFFFULL),		// ADDR_LO
-					(uint32_t)(addr >> 32ULL),			// ADDR_HI
-					(uint32_t)(1 | (1 << 2) | (type << 3)),		// ACCESS_BANK
-					(uint32_t)asic->options.bank.srbm.me,
-					(uint32_t)asic->options.bank.srbm.pipe,
-					(uint32_t)asic->options.bank.srbm.queue,
-					(uint32_t)asic->options.bank.srbm.vmid);
-		} else {
-			buf = send_opcode(asic->reg_funcs.data, RUMR_OP_REG_ACCESS, 9,
-					(uint32_t)(addr & 0xFFFFFFFFULL),		// ADDR_LO
-					(uint32_t)(addr >> 32ULL),			// ADDR_HI
-					(uint32_t)(0 | (1 << 2) | (type << 3)),		// ACCESS_BANK
-					(uint32_t)asic->options.bank.srbm.me,
-					(uint32_t)asic->options.bank.srbm.pipe,
-					(uint32_t)asic->options.bank.srbm.queue,
-					(uint32_t)asic->options.bank.srbm.vmid,
-					(uint32_t)(*value),
-					(uint32_t)0);
-		}
+		pkt[2] |= 1 << 2;
+		pkt[3] = bank->srbm.me;
+		pkt[4] = bank->srbm.pipe;
+		pkt[5] = bank->srbm.queue;
+		pkt[6] = bank->srbm.vmid;
 	} else {
 		// No bank switching
-		if (read_en) {
-			buf = send_opcode(asic->reg_funcs.data, RUMR_OP_REG_ACCESS, 7,
-					(uint32_t)(addr & 0xFFFFFFFFULL),		// ADDR_LO
-					(uint32_t)(addr >> 32ULL),			// ADDR_HI
-					(uint32_t)(1 | (type << 3)),			// ACCESS_BANK
-					(uint32_t)0,
-					(uint32_t)0,
-					(uint32_t)0,
-					(uint32_t)0);
-		} else {
-			buf = send_opcode(asic->reg_funcs.data, RUMR_OP_REG_ACCESS, 9,
-					(uint32_t)(addr & 0xFFFFFFFFULL),		// ADDR_LO
-					(uint32_t)(addr >> 32ULL),			// ADDR_HI
-					(uint32_t)(0 | (type << 3)),			// ACCESS_BANK
-					(uint32_t)0,
-					(uint32_t)0,
-					(uint32_t)0,
-					(uint32_t)0,
-					(uint32_t)(*value),
-					(uint32_t)0);
+		pkt[3] = pkt[4] = pkt[5] = pkt[6] = 0;
+	}
+	n = 7;
+	if (!read_en) {
+		pkt[n++] = (uint32_t)(value & 0xFFFFFFFFULL);
+		pkt[n++] = (uint32_t)(value >> 32ULL);
+	}
+	return n;
+}
+
+static int mmio_reg_op(struct umr_asic *asic, uint64_t addr, enum regclass type, uint64_t *value, int read_en, int bit64)
+{
+	struct rumr_buffer *buf;
+	struct rumr_client_state *state = asic->reg_funcs.data;
+	struct rumr_client_cache *cache = cache_get(state);
+	struct rcache_reg *hit;
+	uint32_t pkt[9], n;
+
+	if (!read_en) {
+		rumr_client_cache_flush(state);
+	} else if (cache) {
+		hit = *cache_reg_find(cache, addr, type, asic->options.use_bank, &asic->options.bank, bit64);
+		if (hit) {
+			*value = hit->value;
+			return 0;
 		}
 	}
 
+	n = reg_op_packet(pkt, addr, type, asic->options.use_bank, &asic->options.bank, *value, read_en, bit64);
+	buf = send_opcode_buf(state, RUMR_OP_REG_ACCESS, pkt, n);
+
 	if (!buf || rumr_buffer_read_uint32(buf) != 1) {
 		state->log_msg("[ERROR]: Could not transmit register opcode.\n");
 		rumr_buffer_free(buf);
@@ -462,11 +725,275 @@ static int mmio_reg_op(struct umr_asic *asic, uint64_t addr, enum regclass type,
 
 	if (read_en) {
 		*value = rumr_buffer_read_uint32(buf);
+		if (bit64)
+			*value |= (uint64_t)rumr_buffer_read_uint32(buf) << 32ULL;
+		if (cache)
+			cache_reg_insert(cache, addr, type, asic->options.use_bank, &asic->options.bank, bit64, *value);
+	}
+	rumr_buffer_free(buf);
+	return 0;
+}
+
+/*
+ * Batching layer: sub-ops are queued in a buffer that starts with their
+ * count and sent as a single RUMR_OP_BATCH, the replies are then taken
+ * apart with batch_reply() in the order the sub-ops were added.
+ */
+struct rumr_batch {
+	struct rumr_buffer *ops;
+	uint32_t count;
+};
+
+static int batch_init(struct rumr_batch *b)
+{
+	b->count = 0;
+	b->ops = rumr_buffer_init();
+	if (!b->ops)
+		return -1;
+	rumr_buffer_add_uint32(b->ops, 0); // count, patched by batch_send()
+	return 0;
+}
+
+static void batch_add(struct rumr_batch *b, uint32_t opcode, uint32_t *pkt, uint32_t nwords)
+{
+	rumr_buffer_add_uint32(b->ops, opcode);
+	rumr_buffer_add_uint32(b->ops, nwords);
+	rumr_buffer_add_data(b->ops, pkt, nwords * 4);
+	++b->count;
+}
+
+// send the queued sub-ops, returns the reply positioned at the first sub-op reply
+static struct rumr_buffer *batch_send(struct rumr_client_state *state, struct rumr_batch *b)
+{
+	struct rumr_buffer *buf = NULL;
+
+	if (!b->ops->failed) {
+		memcpy(b->ops->data, &b->count, 4);
+		buf = send_opcode_data(state, RUMR_OP_BATCH, b->ops->data, b->ops->woffset);
+	}
+	rumr_buffer_free(b->ops);
+	b->ops = NULL;
+
+	if (!buf || rumr_buffer_read_uint32(buf) != 1 || rumr_buffer_read_uint32(buf) != b->count) {
+		state->log_msg("[ERROR]: Could not transmit batch opcode.\n");
+		rumr_buffer_free(buf);
+		return NULL;
+	}
+	return buf;
+}
+
+// point @sub at the next sub-op reply, returns -1 if that sub-op failed
+static int batch_reply(struct rumr_buffer *buf, struct rumr_buffer *sub)
+{
+	uint32_t len = rumr_buffer_read_uint32(buf);
+
+	memset(sub, 0, sizeof *sub);
+	if (!len || len > buf->woffset - buf->roffset)
+		return -1;
+	sub->data = &buf->data[buf->roffset];
+	sub->size = sub->woffset = len;
+	buf->roffset += len;
+	return 0;
+}
+
+static int regs_batch_op(struct umr_asic *asic, struct umr_reg_batch *regs, int no_regs, int read_en)
+{
+	struct rumr_client_state *state = asic->reg_funcs.data;
+	struct rumr_client_cache *cache = cache_get(state);
+	struct rumr_buffer *buf, sub;
+	struct rcache_reg *hit;
+	struct rumr_batch b;
+	uint32_t pkt[9], n;
+	int x, y, z, r = 0, *todo, no_todo = 0;
+
+	if (!read_en)
+		rumr_client_cache_flush(state);
+
+	// only the registers not cached are sent
+	todo = calloc(no_regs ? no_regs : 1, sizeof todo[0]);
+	if (!todo) {
+		state->log_msg("[ERROR]: Out of memory\n");
+		return -1;
+	}
+	for (x = 0; x < no_regs; x++) {
+		hit = (read_en && cache) ? *cache_reg_find(cache, regs[x].addr, regs[x].type, regs[x].use_bank, &regs[x].bank, 0) : NULL;
+		if (hit)
+			regs[x].value = hit->value;
+		else
+			todo[no_todo++] = x;
+	}
+
+	for (x = 0; x < no_todo; x += RUMR_BATCH_MAX) {
+		if (batch_init(&b)) {
+			state->log_msg("[ERROR]: Out of memory\n");
+			free(todo);
+			return -1;
+		}
+		for (y = x; y < no_todo && y < x + RUMR_BATCH_MAX; y++) {
+			z = todo[y];
+			n = reg_op_packet(pkt, regs[z].addr, regs[z].type, regs[z].use_bank, &regs[z].bank, regs[z].value, read_en, 0);
+			batch_add(&b, RUMR_OP_REG_ACCESS, pkt, n);
+		}
+		buf = batch_send(state, &b);
+		if (!buf) {
+			free(todo);
+			return -1;
+		}
+		for (y = x; y < no_todo && y < x + RUMR_BATCH_MAX; y++) {
+			z = todo[y];
+			if (batch_reply(buf, &sub) || rumr_buffer_read_uint32(&sub) != 1) {
+				if (read_en)
+					regs[z].value = 0xBEBEBEEF;
+				r = -1;
+				continue;
+			}
+			if (read_en) {
+				regs[z].value = rumr_buffer_read_uint32(&sub);
+				if (cache)
+					cache_reg_insert(cache, regs[z].addr, regs[z].type, regs[z].use_bank, &regs[z].bank, 0, regs[z].value);
+			}
+		}
+		rumr_buffer_free(buf);
+	}
+	free(todo);
+	return r;
+}
+
+/** read_regs_batch -- Read an array of registers with one opcode per RUMR_BATCH_MAX registers */
+static int read_regs_batch(struct umr_asic *asic, struct umr_reg_batch *regs, int no_regs)
+{
+	return regs_batch_op(asic, regs, no_regs, 1);
+}
+
+/** write_regs_batch -- Write an array of registers (in order) with one opcode per RUMR_BATCH_MAX registers */
+static int write_regs_batch(struct umr_asic *asic, struct umr_reg_batch *regs, int no_regs)
+{
+	return regs_batch_op(asic, regs, no_regs, 0);
+}
+
+/** get_wave_status_bulk -- Read the status of waves 0..no_waves-1 of a SIMD with one opcode */
+static int get_wave_status_bulk(struct umr_asic *asic, unsigned se, unsigned sh, unsigned cu, unsigned simd, unsigned no_waves, struct umr_wave_status *ws)
+{
+	struct rumr_client_state *state = asic->wave_funcs.data;
+	struct rumr_buffer *buf, sub;
+	struct rumr_batch b;
+	uint32_t pkt[5], ws_buf[64], wslen;
+	unsigned wave;
+	int r = 0;
+
+	if (batch_init(&b)) {
+		state->log_msg("[ERROR]: Out of memory\n");
+		return -1;
+	}
+	for (wave = 0; wave < no_waves; wave++) {
+		pkt[0] = se;
+		pkt[1] = sh;
+		pkt[2] = cu;
+		pkt[3] = simd;
+		pkt[4] = wave;
+		batch_add(&b, RUMR_OP_WAVE_ACCESS, pkt, 5);
+	}
+	buf = batch_send(state, &b);
+	if (!buf)
+		return -1;
+
+	for (wave = 0; wave < no_waves; wave++) {
+		// a slot the server could not read is left zeroed (not valid)
+		memset(&ws[wave], 0, sizeof ws[wave]);
+		if (batch_reply(buf, &sub) || rumr_buffer_read_uint32(&sub) != 1)
+			continue;
+		wslen = rumr_buffer_read_uint32(&sub);
+		if (wslen > sizeof ws_buf) {
+			r = -1;
+			break;
+		}
+		rumr_buffer_read_data(&sub, ws_buf, wslen);
+		if (umr_parse_wave_data_gfx(asic, &ws[wave], ws_buf, wslen >> 2)) {
+			r = -1;
+			break;
+		}
 	}
 	rumr_buffer_free(buf);
+	return r;
+}
+
+// read a register array sent as a count and the words without the trailing zeros
+static int read_trimmed(struct rumr_buffer *buf, uint32_t *words, uint32_t n)
+{
+	uint32_t len = rumr_buffer_read_uint32(buf);
+
+	if (len > n || len * 4 > buf->woffset - buf->roffset)
+		return -1;
+	rumr_buffer_read_data(buf, words, len * 4);
 	return 0;
 }
 
+/** scan_wave_data -- Scan for waves on the server with one opcode
+ *
+ * With the prefetch_gprs option the GPRs of the halted waves come with
+ * the scan, otherwise they are read on first use.
+ */
+static int scan_wave_data(struct umr_asic *asic, struct umr_wave_list *wl)
+{
+	struct rumr_client_state *state = asic->wave_funcs.data;
+	struct umr_wave_data *wd;
+	struct rumr_buffer *buf;
+	uint32_t flags = 0, count, thread;
+
+	if (asic->options.skip_gprs)
+		flags |= RUMR_WAVE_SCAN_SKIP_GPRS;
+	else if (asic->options.prefetch_gprs)
+		flags |= RUMR_WAVE_SCAN_GPRS;
+
+	buf = send_opcode(state, RUMR_OP_WAVE_SCAN, 1, flags);
+	if (!buf || rumr_buffer_read_uint32(buf) != 1) {
+		state->log_msg("[ERROR]: Could not transmit wave scan opcode.\n");
+		rumr_buffer_free(buf);
+		return -1;
+	}
+
+	// every wave takes at least 10 words
+	count = rumr_buffer_read_uint32(buf);
+	if (count > (buf->woffset - buf->roffset) / 40)
+		goto bad;
+	while (count--) {
+		wd = umr_wave_list_append(asic, wl);
+		if (!wd) {
+			rumr_buffer_free(buf);
+			return -1;
+		}
+		wd->se = rumr_buffer_read_uint32(buf);
+		wd->sh = rumr_buffer_read_uint32(buf);
+		wd->cu = rumr_buffer_read_uint32(buf);
+		wd->simd = rumr_buffer_read_uint32(buf);
+		wd->wave = rumr_buffer_read_uint32(buf);
+		wd->num_threads = rumr_buffer_read_uint32(buf);
+		wd->ws.sq_info.busy = rumr_buffer_read_uint32(buf);
+		wd->ws.sq_info.wave_level = rumr_buffer_read_uint32(buf);
+		if (wd->num_threads > 64 || read_trimmed(buf, wd->ws.reg_values, 64))
+			goto bad;
+
+		if (!rumr_buffer_read_uint32(buf)) {
+			wd->gpr_state = asic->options.skip_gprs ? UMR_WAVE_GPRS_NONE : UMR_WAVE_GPRS_LAZY;
+			continue;
+		}
+		if (read_trimmed(buf, wd->sgprs, 1024))
+			goto bad;
+		wd->have_vgprs = rumr_buffer_read_uint32(buf);
+		if (wd->have_vgprs)
+			for (thread = 0; thread < wd->num_threads; thread++)
+				if (read_trimmed(buf, &wd->vgprs[256 * thread], 256))
+					goto bad;
+		wd->gpr_state = UMR_WAVE_GPRS_READ;
+	}
+	rumr_buffer_free(buf);
+	return 0;
+bad:
+	state->log_msg("[ERROR]: Malformed wave scan reply.\n");
+	rumr_buffer_free(buf);
+	return -1;
+}
+
 /** read_reg -- Read a register
  * @asic: The device the register is from
  * @addr:  The byte address of the register to read
@@ -474,9 +1001,9 @@ static int mmio_reg_op(struct umr_asic *asic, uint64_t addr, enum regclass type,
  */
 static uint32_t read_reg(struct umr_asic *asic, uint64_t addr, enum regclass type)
 {
-	uint32_t v;
+	uint64_t v;
 	v = 0xBEBEBEEF;
-	(void)mmio_reg_op(asic, addr, type, &v, 1);
+	(void)mmio_reg_op(asic, addr, type, &v, 1, 0);
 	return v;
 }
 
@@ -488,7 +1015,32 @@ static uint32_t read_reg(struct umr_asic *asic, uint64_t addr, enum regclass typ
  */
 static int write_reg(struct umr_asic *asic, uint64_t addr, uint32_t value, enum regclass type)
 {
-	return mmio_reg_op(asic, addr, type, &value, 0);
+	uint64_t v = value;
+	return mmio_reg_op(asic, addr, type, &v, 0, 0);
+}
+
+/** read_reg64 -- Read a 64-bit register with a single opcode
+ * @asic: The device the register is from
+ * @addr:  The byte address of the LO half of the register
+ * @type:  REG_MMIO or REG_SMC
+ */
+static uint64_t read_reg64(struct umr_asic *asic, uint64_t addr, enum regclass type)
+{
+	uint64_t v;
+	v = 0xBEBEBEEFBEBEBEEFULL;
+	(void)mmio_reg_op(asic, addr, type, &v, 1, 1);
+	return v;
+}
+
+/** write_reg64 -- Write a 64-bit register with a single opcode
+ * @asic: The device the register is from
+ * @addr: The byte address of the LO half of the register
+ * @value: The 64-bit value to write
+ * @type: REG_MMIO or REG_SMC
+ */
+static int write_reg64(struct umr_asic *asic, uint64_t addr, uint64_t value, enum regclass type)
+{
+	return mmio_reg_op(asic, addr, type, &value, 0, 1);
 }
 
 static void *read_ring_data(struct umr_asic *asic, char *ringname, uint32_t *ringsize)
@@ -514,26 +1066,328 @@ static void *read_ring_data(struct umr_asic *asic, char *ringname, uint32_t *rin
 	return ret;
 }
 
+static uint64_t read_uint64(struct rumr_buffer *buf)
+{
+	uint64_t v = rumr_buffer_read_uint32(buf);
+	return v | ((uint64_t)rumr_buffer_read_uint32(buf) << 32);
+}
+
+/** read_pm4_stream -- Rebuild a PM4 stream sent by the server
+ *
+ * See RUMR_PM4_* for the layout.  Returns -1 if the reply is malformed,
+ * *head gets what was read either way.
+ */
+static int read_pm4_stream(struct rumr_buffer *buf, struct umr_pm4_stream *parent, struct umr_pm4_stream **head)
+{
+	struct umr_pm4_stream *ps, *prev = NULL;
+	struct umr_shaders_pgm **pgm;
+	uint32_t count, flags, n;
+
+	*head = NULL;
+	count = rumr_buffer_read_uint32(buf);
+
+	// every packet takes at least 4 words
+	if (count > (buf->woffset - buf->roffset) / 16)
+		return -1;
+	while (count--) {
+		ps = calloc(1, sizeof *ps);
+		if (!ps)
+			return -1;
+		ps->prev = prev;
+		ps->parent = parent;
+		if (prev)
+			prev->next = ps;
+		else
+			*head = ps;
+		prev = ps;
+
+		ps->header = rumr_buffer_read_uint32(buf);
+		ps->pkttype = ps->header >> 30;
+		if (ps->pkttype == 0)
+			ps->pkt0off = ps->header & 0xFFFF;
+		else if (ps->pkttype == 3)
+			ps->opcode = (ps->header >> 8) & 0xFF;
+		ps->ib_offset = rumr_buffer_read_uint32(buf);
+		ps->n_words = rumr_buffer_read_uint32(buf);
+		if (ps->n_words > (buf->woffset - buf->roffset) / 4)
+			return -1;
+		if (ps->n_words) {
+			ps->words = calloc(ps->n_words, sizeof ps->words[0]);
+			if (!ps->words)
+				return -1;
+			rumr_buffer_read_data(buf, ps->words, ps->n_words * 4);
+		}
+
+		flags = rumr_buffer_read_uint32(buf);
+		ps->invalid = (flags & RUMR_PM4_INVALID) ? 1 : 0;
+		if (flags & RUMR_PM4_SHADER) {
+			n = rumr_buffer_read_uint32(buf);
+			if (n > (buf->woffset - buf->roffset) / 36)
+				return -1;
+			for (pgm = &ps->shader; n--; pgm = &(*pgm)->next) {
+				*pgm = calloc(1, sizeof **pgm);
+				if (!*pgm)
+					return -1;
+				(*pgm)->vmid = rumr_buffer_read_uint32(buf);
+				(*pgm)->size = rumr_buffer_read_uint32(buf);
+				(*pgm)->type = rumr_buffer_read_uint32(buf);
+				(*pgm)->addr = read_uint64(buf);
+				(*pgm)->src.ib_base = read_uint64(buf);
+				(*pgm)->src.ib_offset = read_uint64(buf);
+				(*pgm)->pm4_packet = ps;
+			}
+		}
+		if (flags & RUMR_PM4_IB) {
+			ps->ib_source.addr = read_uint64(buf);
+			ps->ib_source.vmid = rumr_buffer_read_uint32(buf);
+			if (read_pm4_stream(buf, ps, &ps->ib))
+				return -1;
+		}
+	}
+	return 0;
+}
+
+/** decode_ring_pm4 -- Decode a PM4 ring on the server
+ *
+ * The server reads the ring and follows the IBs on its side and sends
+ * the decoded packets back, in place of a ring read followed by a memory
+ * read for each IB.
+ */
+static int decode_ring_pm4(struct umr_asic *asic, char *ringname, int *start, int *stop, struct umr_pm4_stream **stream)
+{
+	struct rumr_client_state *state = asic->ring_func.data;
+	const struct umr_packet_filter *f = asic->packet_filter;
+	struct rumr_buffer *buf;
+	char name[128];
+	uint32_t flags = 0, n;
+
+	// with verbose VM decoding the page walks are printed here
+	if (asic->options.verbose)
+		return -1;
+
+	if (asic->options.no_follow_ib)
+		flags |= RUMR_RING_DECODE_NO_FOLLOW_IB;
+	if (asic->options.no_follow_chained_ib)
+		flags |= RUMR_RING_DECODE_NO_FOLLOW_CHAINED_IB;
+	if (asic->options.no_follow_shader)
+		flags |= RUMR_RING_DECODE_NO_FOLLOW_SHADER;
+	if (f)
+		flags |= RUMR_RING_DECODE_FILTER;
+
+	memset(name, 0, sizeof name);
+	strncpy(name, ringname, sizeof(name) - 1);
+	buf = opcode_buf(RUMR_OP_RING_DECODE, sizeof name + 3 * 4 + (f ? 16 * 4 : 0));
+	if (buf) {
+		rumr_buffer_add_data(buf, name, sizeof name);
+		rumr_buffer_add_uint32(buf, (uint32_t)*start);
+		rumr_buffer_add_uint32(buf, (uint32_t)*stop);
+		rumr_buffer_add_uint32(buf, flags);
+		if (f) {
+			rumr_buffer_add_uint32(buf, f->flags);
+			for (n = 0; n < 8; n++)
+				rumr_buffer_add_uint32(buf, f->opcodes[n]);
+			rumr_buffer_add_uint32(buf, f->reg_lo);
+			rumr_buffer_add_uint32(buf, f->reg_hi);
+			rumr_buffer_add_uint32(buf, f->va_lo & 0xFFFFFFFFULL);
+			rumr_buffer_add_uint32(buf, f->va_lo >> 32);
+			rumr_buffer_add_uint32(buf, f->va_hi & 0xFFFFFFFFULL);
+			rumr_buffer_add_uint32(buf, f->va_hi >> 32);
+			rumr_buffer_add_uint32(buf, f->vmid);
+		}
+	}
+	buf = transact(state, buf, 1);
+	if (!buf || rumr_buffer_read_uint32(buf) != 1) {
+		state->log_msg("[ERROR]: Could not transmit ring decode opcode.\n");
+		rumr_buffer_free(buf);
+		return -1;
+	}
+	*start = (int)rumr_buffer_read_uint32(buf);
+	*stop = (int)rumr_buffer_read_uint32(buf);
+	if (read_pm4_stream(buf, NULL, stream)) {
+		state->log_msg("[ERROR]: Malformed ring decode reply.\n");
+		umr_free_pm4_stream(*stream);
+		*stream = NULL;
+		rumr_buffer_free(buf);
+		return -1;
+	}
+	rumr_buffer_free(buf);
+	return 0;
+}
+
+/*
+ * Serialized asics received on connect are kept as <hash>.sasic so the
+ * IP blocks are only sent the first time, see RUMR_OP_DISCOVER.
+ * UMR_RUMR_CACHE names the directory (an empty value disables the
+ * cache), otherwise it is umr/rumr under $XDG_CACHE_HOME or ~/.cache.
+ */
+static int sasic_cache_dir(char *buf, size_t len)
+{
+	const char *p;
+
+	p = getenv("UMR_RUMR_CACHE");
+	if (p) {
+		if (!*p)
+			return -1;
+		snprintf(buf, len, "%s", p);
+		return 0;
+	}
+
+	p = getenv("XDG_CACHE_HOME");
+	if (p && *p) {
+		snprintf(buf, len, "%s/umr/rumr", p);
+		return 0;
+	}
+	p = getenv("HOME");
+	if (p && *p) {
+		snprintf(buf, len, "%s/.cache/umr/rumr", p);
+		return 0;
+	}
+	return -1;
+}
+
+// the hashes of (at most @max) cached serialized asics
+static int sasic_cache_list(uint64_t *hashes, int max)
+{
+	char dir[512], *end;
+	struct dirent *de;
+	uint64_t hash;
+	DIR *d;
+	int n = 0;
+
+	if (sasic_cache_dir(dir, sizeof dir))
+		return 0;
+	d = opendir(dir);
+	if (!d)
+		return 0;
+	while (n < max && (de = readdir(d))) {
+		hash = strtoull(de->d_name, &end, 16);
+		if (hash && end == de->d_name + 16 && !strcmp(end, ".sasic"))
+			hashes[n++] = hash;
+	}
+	closedir(d);
+	return n;
+}
+
+// the cached serialized asic @hash behind the head just received in @buf
+static struct rumr_buffer *sasic_cache_load(uint64_t hash, struct rumr_buffer *buf)
+{
+	struct rumr_buffer *file, *sasic = NULL;
+	char dir[512], fname[576];
+	uint32_t head;
+
+	if (sasic_cache_dir(dir, sizeof dir))
+		return NULL;
+	snprintf(fname, sizeof fname, "%s/%016"PRIx64".sasic", dir, hash);
+	file = rumr_load_serialized_asic(fname, NULL);
+	if (!file)
+		return NULL;
+
+	head = rumr_serialized_asic_head(file);
+	if (head && rumr_serialized_asic_hash(file) == hash) {
+		sasic = rumr_buffer_init();
+		if (sasic) {
+			rumr_buffer_add_data(sasic, buf->data + buf->roffset, buf->woffset - buf->roffset);
+			rumr_buffer_add_data(sasic, file->data + head, file->woffset - head);
+			if (sasic->failed) {
+				rumr_buffer_free(sasic);
+				sasic = NULL;
+			}
+		}
+	} else {
+		unlink(fname);
+	}
+	rumr_buffer_free(file);
+	return sasic;
+}
+
+// cache the serialized asic @hash that follows in @buf, failing to is not an error
+static void sasic_cache_save(uint64_t hash, struct rumr_buffer *buf)
+{
+	char dir[512], fname[576], tmpname[600], *p;
+	uint32_t size = buf->woffset - buf->roffset;
+	int fd, r;
+
+	if (!hash || sasic_cache_dir(dir, sizeof dir))
+		return;
+
+	// create the directory and its parents if needed
+	for (p = strchr(dir + 1, '/'); ; p = strchr(p + 1, '/')) {
+		if (p)
+			*p = 0;
+		if (mkdir(dir, 0755) && errno != EEXIST)
+			return;
+		if (!p)
+			break;
+		*p = '/';
+	}
+
+	snprintf(fname, sizeof fname, "%s/%016"PRIx64".sasic", dir, hash);
+	snprintf(tmpname, sizeof tmpname, "%s.XXXXXX", fname);
+	fd = mkstemp(tmpname);
+	if (fd < 0)
+		return;
+	r = write(fd, buf->data + buf->roffset, size) != (ssize_t)size;
+	if (close(fd) || r || rename(tmpname, fname))
+		unlink(tmpname);
+}
+
 /**
  * @brief Discover the ASIC connected to the RUMR client.
  *
  * This function sends a discovery opcode to the server to gather information about the connected ASIC.
  * It initializes the ASIC model in the client state using the data received from the server.
+ * The IP blocks of ASICs seen before are loaded from a local cache instead of being sent again.
  *
  * @param state Pointer to the RUMR client state structure.
  * @return int Returns 0 on success, -1 on failure.
  */
 int rumr_client_discover(struct rumr_client_state *state)
 {
-	struct rumr_buffer *buf;
-
-	buf = send_opcode(state, RUMR_OP_DISCOVER, 0);
+	uint64_t hashes[RUMR_DISCOVER_MAX_HASHES], hash;
+	struct rumr_buffer *buf, *sasic;
+	int n, x;
+
+	n = sasic_cache_list(hashes, RUMR_DISCOVER_MAX_HASHES);
+again:
+	state->codecs = 0;
+	buf = opcode_buf(RUMR_OP_DISCOVER, (2 + 2 * n) * 4);
+	if (buf) {
+		rumr_buffer_add_uint32(buf, rumr_codecs_supported());
+		rumr_buffer_add_uint32(buf, n);
+		for (x = 0; x < n; x++) {
+			rumr_buffer_add_uint32(buf, hashes[x] & 0xFFFFFFFFULL);
+			rumr_buffer_add_uint32(buf, hashes[x] >> 32);
+		}
+	}
+	buf = transact(state, buf, 1);
 	if (!buf) {
 		state->log_msg("[ERROR]: Could not transmit discoever opcode.\n");
 		return -1;
 	}
 
-	state->asic = rumr_parse_serialized_asic(buf);
+	// the server replies with the compression codecs it has
+	state->codecs = rumr_buffer_read_uint32(buf) & rumr_codecs_supported();
+	hash = rumr_buffer_read_uint32(buf);
+	hash |= (uint64_t)rumr_buffer_read_uint32(buf) << 32;
+
+	if (rumr_buffer_read_uint32(buf)) {
+		// only the head was sent, the IP blocks are in the cache
+		sasic = sasic_cache_load(hash, buf);
+		rumr_buffer_free(buf);
+		if (!sasic) {
+			if (!n)
+				return -1;
+			// the cached copy went bad, ask for all of it
+			n = 0;
+			goto again;
+		}
+		state->asic = rumr_parse_serialized_asic(sasic);
+		rumr_buffer_free(sasic);
+	} else {
+		sasic_cache_save(hash, buf);
+		state->asic = rumr_parse_serialized_asic(buf);
+		rumr_buffer_free(buf);
+	}
 
 	return state->asic ? 0 : -1;
 }
@@ -557,6 +1411,7 @@ int rumr_client_connect(struct rumr_client_state *state, struct rumr_comm_funcs
 
 	state->comm = *cf;
 	state->log_msg = state->comm.log_msg;
+	state->stats = calloc(1, sizeof *state->stats);
 
 	r = state->comm.connect(&state->comm, addr);
 	if (r < 0) {
@@ -579,19 +1434,27 @@ int rumr_client_connect(struct rumr_client_state *state, struct rumr_comm_funcs
 		state->asic->mem_funcs.vm_message = state->log_msg;
 		state->asic->mem_funcs.access_linear_vram = access_linear_vram;
 		state->asic->mem_funcs.access_sram = access_sram;
+		state->asic->mem_funcs.access_vram = access_vram;
 		state->asic->mem_funcs.data = state;
 		state->asic->mem_funcs.gpu_bus_to_cpu_address = gpu_bus_to_cpu_address;
 	// regfuncs
 		state->asic->reg_funcs.data = state;
 		state->asic->reg_funcs.read_reg = read_reg;
 		state->asic->reg_funcs.write_reg = write_reg;
+		state->asic->reg_funcs.read_reg64 = read_reg64;
+		state->asic->reg_funcs.write_reg64 = write_reg64;
+		state->asic->reg_funcs.read_regs_batch = read_regs_batch;
+		state->asic->reg_funcs.write_regs_batch = write_regs_batch;
 	// wavefuncs
 		state->asic->wave_funcs.data = state;
 		state->asic->wave_funcs.get_wave_status = get_wave_status;
+		state->asic->wave_funcs.get_wave_status_bulk = get_wave_status_bulk;
 		state->asic->wave_funcs.get_wave_sq_info = umr_get_wave_sq_info;
+		state->asic->wave_funcs.scan_wave_data = scan_wave_data;
 	// ring funcs
 		state->asic->ring_func.data = state;
 		state->asic->ring_func.read_ring_data = read_ring_data;
+		state->asic->ring_func.decode_ring_pm4 = decode_ring_pm4;
 	// shader
 		state->asic->shader_disasm_funcs.disasm = umr_shader_disasm;
 	// GPRs
@@ -607,10 +1470,7 @@ int rumr_client_connect(struct rumr_client_state *state, struct rumr_comm_funcs
 		} else {
 			// if the client side has not specified a UQ then use what the server sent
 			// keep whatever the server gave us for uq data
-			struct umr_options ops;
-			ops.user_queue = state->asic->options.user_queue;
-			state->asic->options = *options;
-			state->asic->options.user_queue = ops.user_queue;
+			memcpy(&state->asic->options, options, UMR_OPTIONS_SETTINGS_SIZE);
 		}
 
 	// default shader options
@@ -663,5 +1523,80 @@ int rumr_client_user_queue_parse(struct umr_asic *asic)
 void rumr_client_close(struct rumr_client_state *state)
 {
 	send_opcode(state, RUMR_OP_GOODBYE, 0);
+	rumr_client_cache_flush(state);
+	free(state->cache);
+	state->cache = NULL;
 	umr_free_asic(state->asic);
+	free(state->stats);
+	state->stats = NULL;
+	rumr_buffer_pool_flush();
+}
+
+/**
+ * rumr_client_server_stats - Fetch the server's per opcode counters
+ * @state: The client state
+ * @sum: RUMR_STATS_OPS summaries indexed by opcode
+ * @io: Receives the syscall counters of the server's asic, may be NULL
+ *
+ * Returns 0 on success, -1 if the server could not be asked.
+ */
+int rumr_client_server_stats(struct rumr_client_state *state, struct rumr_op_summary *sum, struct umr_io_stats *io)
+{
+	struct umr_io_stats dummy;
+	struct rumr_buffer *buf;
+	uint64_t *w;
+	uint32_t n, i, j, lo;
+
+	if (!io)
+		io = &dummy;
+	memset(sum, 0, RUMR_STATS_OPS * sizeof *sum);
+	memset(io, 0, sizeof *io);
+	buf = send_opcode(state, RUMR_OP_STATS, 0);
+	if (!buf)
+		return -1;
+	if (rumr_buffer_read_uint32(buf) != 1) {
+		rumr_buffer_free(buf);
+		return -1;
+	}
+	// a server with fewer opcodes sends fewer, missing words read as 0
+	n = rumr_buffer_read_uint32(buf);
+	for (i = 0; i < n && i < RUMR_STATS_OPS; i++) {
+		w = &sum[i].count;
+		for (j = 0; j < sizeof sum[i] / 8; j++) {
+			lo = rumr_buffer_read_uint32(buf);
+			w[j] = lo | ((uint64_t)rumr_buffer_read_uint32(buf) << 32);
+		}
+	}
+	// older servers stop here
+	n = rumr_buffer_read_uint32(buf);
+	for (i = 0; i < n && i < UMR_IO_MAX; i++) {
+		w = &io->cls[i].reads;
+		for (j = 0; j < sizeof io->cls[i] / 8; j++) {
+			lo = rumr_buffer_read_uint32(buf);
+			w[j] = lo | ((uint64_t)rumr_buffer_read_uint32(buf) << 32);
+		}
+	}
+	rumr_buffer_free(buf);
+	return 0;
+}
+
+/**
+ * rumr_client_print_stats - Print the client and server per opcode counters
+ * @state: The client state
+ * @f: Where to print them
+ */
+void rumr_client_print_stats(struct rumr_client_state *state, FILE *f)
+{
+	struct rumr_op_summary sum[RUMR_STATS_OPS];
+	struct umr_io_stats io;
+
+	rumr_stats_summarize(state->stats, sum);
+	rumr_stats_print(sum, "client rtt", f);
+	if (rumr_client_server_stats(state, sum, &io)) {
+		fprintf(f, "[ERROR]: Could not read the server stats\n");
+		return;
+	}
+	rumr_stats_print(sum, "server", f);
+	fprintf(f, "server syscalls:\n");
+	umr_io_stats_print(&io, f);
 }
@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include <umr_rumr.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+/*
+ * Per-message compression.  A compressed message keeps its header word
+ * (with RUMR_HDR_COMPRESSED set) followed by the codec, the size of the
+ * original payload and the compressed payload.
+ *
+ * RUMR_CODEC_RLE32 works on 32-bit words since that is what rings (NOP
+ * padding) and memory (zero filled BOs) repeat.  Each token is a control
+ * word with the number of words in its low 31 bits, with bit 31 set it is
+ * followed by one word repeated that many times, otherwise by that many
+ * literal words.  Trailing bytes that don't make a word are stored as is.
+ */
+
+#define RLE_RUN		0x80000000UL
+#define RLE_MIN_RUN	3
+
+/**
+ * rumr_codecs_supported - The codecs this build can (de)compress
+ */
+uint32_t rumr_codecs_supported(void)
+{
+#ifdef HAVE_ZSTD
+	return RUMR_CODEC_RLE32 | RUMR_CODEC_ZSTD;
+#else
+	return RUMR_CODEC_RLE32;
+#endif
+}
+
+// append a control word and its data, returns 0 if it doesn't fit
+static int rle32_put(uint8_t *dst, uint32_t cap, uint32_t *out, uint32_t ctl, const uint8_t *data, uint32_t len)
+{
+	if (cap - *out < 4 + len)
+		return 0;
+	memcpy(dst + *out, &ctl, 4);
+	memcpy(dst + *out + 4, data, len);
+	*out += 4 + len;
+	return 1;
+}
+
+// returns the size of the output or 0 if it would not fit in @cap bytes
+static uint32_t rle32_compress(uint8_t *dst, uint32_t cap, const uint8_t *src, uint32_t size)
+{
+	uint32_t nwords = size / 4, x, y, lstart, out = 0;
+
+	for (x = lstart = 0; x < nwords; x = y) {
+		for (y = x + 1; y < nwords && !memcmp(src + 4 * y, src + 4 * x, 4); y++);
+		if (y - x < RLE_MIN_RUN)
+			continue;
+		// literals up to the run, then the run
+		if (x > lstart && !rle32_put(dst, cap, &out, x - lstart, src + 4 * lstart, 4 * (x - lstart)))
+			return 0;
+		if (!rle32_put(dst, cap, &out, RLE_RUN | (y - x), src + 4 * x, 4))
+			return 0;
+		lstart = y;
+	}
+	if (nwords > lstart && !rle32_put(dst, cap, &out, nwords - lstart, src + 4 * lstart, 4 * (nwords - lstart)))
+		return 0;
+
+	if (cap - out < (size & 3))
+		return 0;
+	memcpy(dst + out, src + 4 * nwords, size & 3);
+	return out + (size & 3);
+}
+
+static int rle32_decompress(uint8_t *dst, uint32_t size, const uint8_t *src, uint32_t csize)
+{
+	uint32_t in = 0, out = 0, ctl, n, v;
+
+	while (size - out >= 4) {
+		if (csize - in < 4)
+			return -1;
+		memcpy(&ctl, src + in, 4);
+		in += 4;
+		n = ctl & ~RLE_RUN;
+		if (!n || n > (size - out) / 4)
+			return -1;
+		if (ctl & RLE_RUN) {
+			if (csize - in < 4)
+				return -1;
+			memcpy(&v, src + in, 4);
+			in += 4;
+			while (n--) {
+				memcpy(dst + out, &v, 4);
+				out += 4;
+			}
+		} else {
+			if (csize - in < 4 * n)
+				return -1;
+			memcpy(dst + out, src + in, 4 * n);
+			in += 4 * n;
+			out += 4 * n;
+		}
+	}
+	if (csize - in != size - out)
+		return -1;
+	memcpy(dst + out, src + in, size - out);
+	return 0;
+}
+
+// exchange the contents of two buffers so @buf keeps its identity
+static void buffer_swap(struct rumr_buffer *buf, struct rumr_buffer *tmp)
+{
+	struct rumr_buffer t = *buf;
+
+	*buf = *tmp;
+	*tmp = t;
+}
+
+/**
+ * rumr_buffer_compress - Compress an outgoing message in place
+ * @buf: The message, starting with its header word
+ * @codecs: The codecs both ends support (RUMR_CODEC_*)
+ *
+ * Messages smaller than RUMR_COMPRESS_MIN, and those that would not get
+ * smaller, are left alone.  zstd is preferred over RLE32 if both ends
+ * have it.
+ *
+ * Returns 0 on success (compressed or not), -1 if out of memory.
+ */
+int rumr_buffer_compress(struct rumr_buffer *buf, uint32_t codecs)
+{
+	struct rumr_buffer *tmp;
+	uint32_t header, codec, size, cap, csize;
+
+	codecs &= rumr_codecs_supported();
+	if (!codecs || buf->failed || buf->woffset < 4 + RUMR_COMPRESS_MIN)
+		return 0;
+	size = buf->woffset - 4;
+	codec = (codecs & RUMR_CODEC_ZSTD) ? RUMR_CODEC_ZSTD : RUMR_CODEC_RLE32;
+
+	// only worth sending if it saves at least 1/16th
+	cap = size - size / 16;
+	tmp = rumr_buffer_init();
+	if (!tmp || rumr_buffer_reserve(tmp, 12 + cap)) {
+		rumr_buffer_free(tmp);
+		return -1;
+	}
+
+	memcpy(&header, buf->data, 4);
+	header |= RUMR_HDR_COMPRESSED;
+	rumr_buffer_add_uint32(tmp, header);
+	rumr_buffer_add_uint32(tmp, codec);
+	rumr_buffer_add_uint32(tmp, size);
+
+	csize = 0;
+#ifdef HAVE_ZSTD
+	if (codec == RUMR_CODEC_ZSTD) {
+		size_t r = ZSTD_compress(tmp->data + 12, cap, buf->data + 4, size, 1);
+		csize = ZSTD_isError(r) ? 0 : (uint32_t)r;
+	}
+#endif
+	if (codec == RUMR_CODEC_RLE32)
+		csize = rle32_compress(tmp->data + 12, cap, buf->data + 4, size);
+
+	if (csize) {
+		tmp->woffset = 12 + csize;
+		buffer_swap(buf, tmp);
+	}
+	rumr_buffer_free(tmp);
+	return 0;
+}
+
+/**
+ * rumr_buffer_decompress - Expand a received message in place
+ * @buf: The message as received, read offset still at the header word
+ *
+ * Messages without RUMR_HDR_COMPRESSED in their header are left alone.
+ *
+ * Returns 0 on success, -1 if the message is corrupt, uses a codec this
+ * build doesn't have or memory runs out.
+ */
+int rumr_buffer_decompress(struct rumr_buffer *buf)
+{
+	struct rumr_buffer *tmp;
+	uint32_t header, codec, size, csize;
+	int r = -1;
+
+	if (buf->woffset < 4)
+		return 0;
+	memcpy(&header, buf->data, 4);
+	if (!(header & RUMR_HDR_COMPRESSED))
+		return 0;
+	if (buf->woffset < 12)
+		return -1;
+	memcpy(&codec, buf->data + 4, 4);
+	memcpy(&size, buf->data + 8, 4);
+	csize = buf->woffset - 12;
+
+	tmp = rumr_buffer_init();
+	if (!tmp || rumr_buffer_reserve(tmp, 4 + size)) {
+		rumr_buffer_free(tmp);
+		return -1;
+	}
+	header &= ~RUMR_HDR_COMPRESSED;
+	rumr_buffer_add_uint32(tmp, header);
+
+	switch (codec) {
+		case RUMR_CODEC_RLE32:
+			r = rle32_decompress(tmp->data + 4, size, buf->data + 12, csize);
+			break;
+#ifdef HAVE_ZSTD
+		case RUMR_CODEC_ZSTD: {
+			size_t n = ZSTD_decompress(tmp->data + 4, size, buf->data + 12, csize);
+			r = (ZSTD_isError(n) || n != size) ? -1 : 0;
+			break;
+		}
+#endif
+		default:
+			break;
+	}
+
+	if (!r) {
+		tmp->woffset = 4 + size;
+		buffer_swap(buf, tmp);
+	}
+	rumr_buffer_free(tmp);
+	return r;
+}
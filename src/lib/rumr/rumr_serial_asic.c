@@ -25,6 +25,39 @@
 #include <umr_rumr.h>
 #include <stdint.h>
 
+/*
+ * The user queue is sent without its unused client_info.queue[] slots,
+ * each of them has room for a full MQD.
+ */
+#define UQ_HEAD_SIZE  offsetof(struct umr_user_queue, client_info.queue)
+#define UQ_QUEUE_SIZE sizeof(((struct umr_user_queue *)0)->client_info.queue[0])
+#define UQ_STATE_SIZE sizeof(((struct umr_user_queue *)0)->state)
+
+static void serialize_user_queue(struct rumr_buffer *buf, struct umr_user_queue *uq)
+{
+	uint32_t n = UMR_MAX_MQD_QUEUES;
+
+	while (n && !uq->client_info.queue[n - 1].mqd_gpu_address && !uq->client_info.queue[n - 1].mqd_size)
+		--n;
+	rumr_buffer_add_data(buf, uq, UQ_HEAD_SIZE);
+	rumr_buffer_add_uint32(buf, n);
+	rumr_buffer_add_data(buf, uq->client_info.queue, n * UQ_QUEUE_SIZE);
+	rumr_buffer_add_data(buf, &uq->state, UQ_STATE_SIZE);
+}
+
+static void deserialize_user_queue(struct rumr_buffer *buf, struct umr_user_queue *uq)
+{
+	uint32_t n;
+
+	memset(uq, 0, sizeof *uq);
+	rumr_buffer_read_data(buf, uq, UQ_HEAD_SIZE);
+	n = rumr_buffer_read_uint32(buf);
+	if (n > UMR_MAX_MQD_QUEUES)
+		n = UMR_MAX_MQD_QUEUES;
+	rumr_buffer_read_data(buf, uq->client_info.queue, n * UQ_QUEUE_SIZE);
+	rumr_buffer_read_data(buf, &uq->state, UQ_STATE_SIZE);
+}
+
 /**
  * @brief Serialize an ASIC model into a buffer.
  *
@@ -45,6 +78,9 @@ struct rumr_buffer *rumr_serialize_asic(struct umr_asic *asic)
 	if (!buf)
 		return NULL;
 
+	// the client gets every register
+	umr_load_ip_blocks(asic, NULL);
+
 	#pragma GCC diagnostic ignored "-Wmisleading-indentation"
 
 	// ASICNAME
@@ -76,7 +112,7 @@ struct rumr_buffer *rumr_serialize_asic(struct umr_asic *asic)
 	// NO blocks
 		rumr_buffer_add_uint32(buf, asic->no_blocks);
 	// user queue data
-		rumr_buffer_add_data(buf, &asic->options.user_queue, sizeof(asic->options.user_queue));
+		serialize_user_queue(buf, &asic->options.user_queue);
 
 	// per IP block
 	for (ip = 0; ip < asic->no_blocks; ip++) {
@@ -145,6 +181,7 @@ struct umr_asic *rumr_parse_serialized_asic(struct rumr_buffer *buf)
 	int ip, reg, bit;
 
 	asic = calloc(1, sizeof *asic);
+	asic->fd.gfxoff = -1; // GFXOFF of a remote device is held by the server
 
 	// read asicname
 		memset(linebuf, 0, sizeof linebuf);
@@ -180,11 +217,12 @@ struct umr_asic *rumr_parse_serialized_asic(struct rumr_buffer *buf)
 		asic->no_blocks = rumr_buffer_read_uint32(buf);
 		asic->blocks = calloc(asic->no_blocks, sizeof asic->blocks[0]);
 	// user queues
-		rumr_buffer_read_data(buf, &asic->options.user_queue, sizeof(asic->options.user_queue));
+		deserialize_user_queue(buf, &asic->options.user_queue);
 
 	// per IP block
 	for (ip = 0; ip < asic->no_blocks; ip++) {
 		asic->blocks[ip] = calloc(1, sizeof *(asic->blocks[0]));
+		asic->blocks[ip]->name_pool = umr_name_pool_create();
 		// ipname
 			memset(linebuf, 0, sizeof linebuf);
 			rumr_buffer_read_data(buf, linebuf, 64);
@@ -204,7 +242,7 @@ struct umr_asic *rumr_parse_serialized_asic(struct rumr_buffer *buf)
 			// regname
 				memset(linebuf, 0, sizeof linebuf);
 				rumr_buffer_read_data(buf, linebuf, 128);
-				asic->blocks[ip]->regs[reg].regname = strdup(linebuf);
+				asic->blocks[ip]->regs[reg].regname = umr_name_pool_intern(asic->blocks[ip]->name_pool, linebuf);
 			// type
 				asic->blocks[ip]->regs[reg].type = rumr_buffer_read_uint32(buf);
 			// ADDR_LO
@@ -215,20 +253,18 @@ struct umr_asic *rumr_parse_serialized_asic(struct rumr_buffer *buf)
 				asic->blocks[ip]->regs[reg].bit64 = rumr_buffer_read_uint32(buf);
 			// nobits
 				asic->blocks[ip]->regs[reg].no_bits = rumr_buffer_read_uint32(buf);
-				asic->blocks[ip]->regs[reg].bits = calloc(asic->blocks[ip]->regs[reg].no_bits, sizeof asic->blocks[0]->regs[0].bits[0]);
+				asic->blocks[ip]->regs[reg].bits = umr_name_pool_alloc(asic->blocks[ip]->name_pool, asic->blocks[ip]->regs[reg].no_bits * sizeof asic->blocks[0]->regs[0].bits[0]);
 
 			// bits
 				for (bit = 0; bit < asic->blocks[ip]->regs[reg].no_bits; bit++) {
 					// bitname
 						memset(linebuf, 0, sizeof linebuf);
 						rumr_buffer_read_data(buf, linebuf, 128);
-						asic->blocks[ip]->regs[reg].bits[bit].regname = strdup(linebuf);
+						asic->blocks[ip]->regs[reg].bits[bit].regname = umr_name_pool_intern(asic->blocks[ip]->name_pool, linebuf);
 					// start
 						asic->blocks[ip]->regs[reg].bits[bit].start = rumr_buffer_read_uint32(buf);
 					// stop
 						asic->blocks[ip]->regs[reg].bits[bit].stop = rumr_buffer_read_uint32(buf);
-					// bitfield print
-						asic->blocks[ip]->regs[reg].bits[bit].bitfield_print = umr_bitfield_default;
 				}
 			}
 	}
@@ -273,3 +309,56 @@ struct rumr_buffer *rumr_load_serialized_asic(const char *fname, char *database_
 {
 	return rumr_buffer_load_file(fname, database_path);
 }
+
+/**
+ * @brief Find where the IP blocks start in a serialized ASIC.
+ *
+ * Everything before the IP blocks (name, config, memory sizes and user
+ * queue data) is small and may change between connects, the IP blocks
+ * with their registers and bitfields are what is worth caching.
+ *
+ * @param buf Pointer to the rumr_buffer containing the serialized ASIC data.
+ * @return The offset of the first IP block, or 0 if the buffer is too short.
+ */
+uint32_t rumr_serialized_asic_head(struct rumr_buffer *buf)
+{
+	uint32_t config, queues, off = 64 + 3 * 4;
+
+	if (buf->woffset < off + 4)
+		return 0;
+	memcpy(&config, buf->data + off, 4);
+	if (config > buf->woffset)
+		return 0;
+	// config, VRAM, VIS_VRAM, GTT, APU, NO blocks and user queue data
+	off += 4 + config + 8 * 4 + UQ_HEAD_SIZE;
+	if (buf->woffset < off + 4)
+		return 0;
+	memcpy(&queues, buf->data + off, 4);
+	if (queues > UMR_MAX_MQD_QUEUES)
+		return 0;
+	off += 4 + queues * UQ_QUEUE_SIZE + UQ_STATE_SIZE;
+	return off <= buf->woffset ? off : 0;
+}
+
+/**
+ * @brief Hash the IP blocks of a serialized ASIC.
+ *
+ * Two serialized ASICs with the same hash can share everything after
+ * rumr_serialized_asic_head(), which is how rumr clients know they can
+ * use the copy they cached on a previous connect.
+ *
+ * @param buf Pointer to the rumr_buffer containing the serialized ASIC data.
+ * @return The 64-bit FNV-1a hash of the IP blocks, 0 if the buffer is malformed.
+ */
+uint64_t rumr_serialized_asic_hash(struct rumr_buffer *buf)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+	uint32_t x, head;
+
+	head = rumr_serialized_asic_head(buf);
+	if (!head)
+		return 0;
+	for (x = head; x < buf->woffset; x++)
+		h = (h ^ buf->data[x]) * 0x100000001b3ULL;
+	return h;
+}
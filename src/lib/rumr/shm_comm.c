@@ -0,0 +1,598 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#define _GNU_SOURCE
+#include "umr_rumr.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/epoll.h>
+#include <poll.h>
+#include <errno.h>
+
+/** Shared memory implementation
+ * A client connects to a unix socket (shm:///run/umr.sock) and is
+ * handed a memfd with one ring per direction and two eventfd doorbells
+ * (SCM_RIGHTS), after which packets only go through the rings.  A
+ * reader spins briefly before it sleeps on its doorbell and a writer
+ * only rings a reader that is asleep, so a request and its reply on an
+ * idle machine cost little more than the copies.  The socket is kept
+ * to notice the other side going away.
+ *
+ * The server side of a connection is always treated as asleep since it
+ * waits in epoll, its get_fd() is an epoll instance that wakes on the
+ * doorbell or the socket.
+ */
+
+#define SHM_RING_SIZE	(2 * 1024 * 1024)	// per direction, power of 2
+#define SHM_SPIN	4096			// polls of a ring before sleeping
+#define SHM_IDLE_SPIN	65536			// polls for a client's next request (status())
+
+// ring 0 carries client->server packets, ring 1 server->client, and
+// doorbell N is rung when ring N has data or ring !N has room
+struct shm_ring {
+	uint32_t head, tail;		// free running counts of bytes written/read
+	uint32_t reader_sleeping,
+		 writer_sleeping;
+	uint32_t pad[12];		// keep the rings on their own cache lines
+};
+
+struct shm_state {
+	int sock, con_sock;		// bound socket / connection
+	int server;			// server side of a connection
+	int efd[2];			// doorbells
+	int epfd;			// server side: doorbell + socket
+	struct shm_ring *rings;
+	uint8_t *data[2];
+};
+
+#define SHM_MAP_SIZE (2 * sizeof(struct shm_ring) + 2 * SHM_RING_SIZE)
+
+static struct shm_state *shm_state_init(void)
+{
+	struct shm_state *ss = calloc(1, sizeof *ss);
+
+	if (ss)
+		ss->sock = ss->con_sock = ss->efd[0] = ss->efd[1] = ss->epfd = -1;
+	return ss;
+}
+
+// drop the connection part of @ss (the bound socket stays)
+static void shm_state_disconnect(struct shm_state *ss)
+{
+	int x;
+
+	if (ss->rings)
+		munmap(ss->rings, SHM_MAP_SIZE);
+	ss->rings = NULL;
+	for (x = 0; x < 2; x++) {
+		if (ss->efd[x] >= 0)
+			close(ss->efd[x]);
+		ss->efd[x] = -1;
+	}
+	if (ss->epfd >= 0)
+		close(ss->epfd);
+	if (ss->con_sock >= 0)
+		close(ss->con_sock);
+	ss->epfd = ss->con_sock = -1;
+}
+
+static int shm_map(struct shm_state *ss, int memfd)
+{
+	void *p = mmap(NULL, SHM_MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+
+	if (p == MAP_FAILED)
+		return -1;
+	ss->rings = p;
+	ss->data[0] = (uint8_t *)&ss->rings[2];
+	ss->data[1] = ss->data[0] + SHM_RING_SIZE;
+	return 0;
+}
+
+static int shm_addr(struct rumr_comm_funcs *cf, char *path, struct sockaddr_un *sun)
+{
+	memset(sun, 0, sizeof *sun);
+	sun->sun_family = AF_UNIX;
+	if (!*path || strlen(path) >= sizeof sun->sun_path) {
+		cf->log_msg("[ERROR]: Invalid unix socket path\n");
+		return -1;
+	}
+	strcpy(sun->sun_path, path);
+	return 0;
+}
+
+// connect to a server and receive the memfd and doorbells
+static int shm_connect(struct rumr_comm_funcs *cf, char *path)
+{
+	struct sockaddr_un sun;
+	struct shm_state *ss;
+	struct msghdr msg;
+	struct cmsghdr *cm;
+	struct iovec iov;
+	union {
+		char buf[CMSG_SPACE(3 * sizeof(int))];
+		struct cmsghdr align;
+	} control;
+	uint32_t size;
+	int fds[3];
+
+	if (shm_addr(cf, path, &sun))
+		return -1;
+	ss = cf->data = shm_state_init();
+	if (!ss)
+		return -1;
+
+	ss->con_sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (ss->con_sock < 0 || connect(ss->con_sock, (const struct sockaddr *)&sun, sizeof sun) < 0) {
+		cf->log_msg("[ERROR]: Could not connect to server\n");
+		goto error;
+	}
+
+	memset(&msg, 0, sizeof msg);
+	iov.iov_base = &size;
+	iov.iov_len = sizeof size;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof control.buf;
+	if (recvmsg(ss->con_sock, &msg, MSG_WAITALL | MSG_CMSG_CLOEXEC) != sizeof size || size != SHM_RING_SIZE) {
+		cf->log_msg("[ERROR]: Server did not set up shared memory\n");
+		goto error;
+	}
+	cm = CMSG_FIRSTHDR(&msg);
+	if (!cm || cm->cmsg_type != SCM_RIGHTS || cm->cmsg_len != CMSG_LEN(sizeof fds)) {
+		cf->log_msg("[ERROR]: Server did not set up shared memory\n");
+		goto error;
+	}
+	memcpy(fds, CMSG_DATA(cm), sizeof fds);
+	ss->efd[0] = fds[1];
+	ss->efd[1] = fds[2];
+	if (shm_map(ss, fds[0])) {
+		close(fds[0]);
+		cf->log_msg("[ERROR]: Could not map shared memory\n");
+		goto error;
+	}
+	close(fds[0]);
+
+	cf->log_msg("[VERBOSE]: Connected to %s (shared memory)\n", path);
+	return 0;
+error:
+	shm_state_disconnect(ss);
+	free(ss);
+	cf->data = NULL;
+	return -1;
+}
+
+// bind to a unix socket path (a stale socket left there is replaced)
+static int shm_bind(struct rumr_comm_funcs *cf, char *path)
+{
+	struct sockaddr_un sun;
+	struct shm_state *ss;
+
+	if (shm_addr(cf, path, &sun))
+		return -1;
+	ss = cf->data = shm_state_init();
+	if (!ss)
+		return -1;
+
+	ss->sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	unlink(path);
+	if (ss->sock < 0 ||
+	    bind(ss->sock, (const struct sockaddr *)&sun, sizeof sun) < 0 ||
+	    listen(ss->sock, 16) < 0) {
+		cf->log_msg("[ERROR]: Could not bind socket\n");
+		if (ss->sock >= 0)
+			close(ss->sock);
+		free(ss);
+		cf->data = NULL;
+		return -1;
+	}
+
+	cf->log_msg("[VERBOSE]: Bound to %s (shared memory)\n", path);
+	return 0;
+}
+
+// accept a client on @ls and set up the memory and doorbells of @ss
+static int shm_setup(struct rumr_comm_funcs *cf, struct shm_state *ls, struct shm_state *ss)
+{
+	struct epoll_event ev;
+	struct msghdr msg;
+	struct cmsghdr *cm;
+	struct iovec iov;
+	union {
+		char buf[CMSG_SPACE(3 * sizeof(int))];
+		struct cmsghdr align;
+	} control;
+	uint32_t size = SHM_RING_SIZE;
+	int fds[3], memfd = -1;
+
+	ss->server = 1;
+	ss->con_sock = accept4(ls->sock, NULL, NULL, SOCK_CLOEXEC);
+	if (ss->con_sock < 0)
+		return -1;
+
+	memfd = memfd_create("rumr", MFD_CLOEXEC);
+	ss->efd[0] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	ss->efd[1] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	ss->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (memfd < 0 || ss->efd[0] < 0 || ss->efd[1] < 0 || ss->epfd < 0 ||
+	    ftruncate(memfd, SHM_MAP_SIZE) || shm_map(ss, memfd))
+		goto error;
+	ss->rings[0].reader_sleeping = 1;
+
+	memset(&ev, 0, sizeof ev);
+	ev.events = EPOLLIN;
+	if (epoll_ctl(ss->epfd, EPOLL_CTL_ADD, ss->efd[0], &ev) ||
+	    epoll_ctl(ss->epfd, EPOLL_CTL_ADD, ss->con_sock, &ev))
+		goto error;
+
+	// hand the memory and doorbells over
+	fds[0] = memfd;
+	fds[1] = ss->efd[0];
+	fds[2] = ss->efd[1];
+	memset(&msg, 0, sizeof msg);
+	memset(&control, 0, sizeof control);
+	iov.iov_base = &size;
+	iov.iov_len = sizeof size;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof control.buf;
+	cm = CMSG_FIRSTHDR(&msg);
+	cm->cmsg_level = SOL_SOCKET;
+	cm->cmsg_type = SCM_RIGHTS;
+	cm->cmsg_len = CMSG_LEN(sizeof fds);
+	memcpy(CMSG_DATA(cm), fds, sizeof fds);
+	if (sendmsg(ss->con_sock, &msg, MSG_NOSIGNAL) != sizeof size)
+		goto error;
+	close(memfd);
+
+	cf->log_msg("[VERBOSE]: Accepted local connection (shared memory)\n");
+	return 0;
+error:
+	cf->log_msg("[ERROR]: Could not set up shared memory for client\n");
+	if (memfd >= 0)
+		close(memfd);
+	shm_state_disconnect(ss);
+	return -1;
+}
+
+// wait (blocking) for a new client connection
+static int shm_accept(struct rumr_comm_funcs *cf)
+{
+	struct shm_state *ss = cf->data;
+
+	shm_state_disconnect(ss);
+	return shm_setup(cf, ss, ss);
+}
+
+// accept a client into its own channel, the bound socket stays with @cf
+static int shm_accept_conn(struct rumr_comm_funcs *cf, struct rumr_comm_funcs *conn)
+{
+	struct shm_state *cs = shm_state_init();
+
+	if (!cs)
+		return -1;
+	if (shm_setup(cf, cf->data, cs)) {
+		free(cs);
+		return -1;
+	}
+	*conn = *cf;
+	conn->data = cs;
+	return 0;
+}
+
+static int shm_get_fd(struct rumr_comm_funcs *cf)
+{
+	struct shm_state *ss = cf->data;
+	return (ss->epfd >= 0) ? ss->epfd : ss->sock;
+}
+
+static void shm_ring_bell(struct shm_state *ss, int n)
+{
+	uint64_t one = 1;
+
+	if (write(ss->efd[n], &one, sizeof one) < 0) {
+		// only fails if the count overflows, it is rung anyways
+	}
+}
+
+// the other side is gone if anything shows up on the socket
+static int shm_peer_gone(struct shm_state *ss)
+{
+	char c;
+	ssize_t r = recv(ss->con_sock, &c, 1, MSG_DONTWAIT | MSG_PEEK);
+
+	return r >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+}
+
+// sleep on doorbell @n until it is rung, -1 if the other side went away
+static int shm_sleep(struct shm_state *ss, int n)
+{
+	struct pollfd pfd[2];
+	uint64_t v;
+
+	pfd[0].fd = ss->efd[n];
+	pfd[0].events = POLLIN;
+	pfd[1].fd = ss->con_sock;
+	pfd[1].events = POLLIN;
+	for (;;) {
+		if (poll(pfd, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (pfd[1].revents && shm_peer_gone(ss))
+			return -1;
+		if (pfd[0].revents) {
+			if (read(ss->efd[n], &v, sizeof v) < 0 && errno != EAGAIN)
+				return -1;
+			return 0;
+		}
+	}
+}
+
+// polls of a ring before sleeping, none on a single CPU where the other
+// side can't make progress while we spin
+static uint32_t shm_spins(uint32_t spins)
+{
+	static int ncpu;
+
+	if (!ncpu)
+		ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	return (ncpu > 1) ? spins : 0;
+}
+
+static uint32_t ring_used(struct shm_ring *r)
+{
+	return __atomic_load_n(&r->head, __ATOMIC_SEQ_CST) - __atomic_load_n(&r->tail, __ATOMIC_SEQ_CST);
+}
+
+// copy @len bytes into ring @n, waiting for room as needed
+static int shm_write(struct shm_state *ss, int n, const void *data, uint32_t len)
+{
+	struct shm_ring *r = &ss->rings[n];
+	const uint8_t *src = data;
+	uint32_t head, space, off, first, spins;
+
+	while (len) {
+		for (spins = 0; !(space = SHM_RING_SIZE - ring_used(r)); ) {
+			if (++spins < shm_spins(SHM_SPIN))
+				continue;
+			// sleep until the reader makes room (checking again
+			// after saying so, the reader may have just done so)
+			__atomic_store_n(&r->writer_sleeping, 1, __ATOMIC_SEQ_CST);
+			if (SHM_RING_SIZE == ring_used(r) && shm_sleep(ss, !n)) {
+				__atomic_store_n(&r->writer_sleeping, 0, __ATOMIC_SEQ_CST);
+				return -1;
+			}
+			__atomic_store_n(&r->writer_sleeping, 0, __ATOMIC_SEQ_CST);
+			spins = 0;
+		}
+		if (space > len)
+			space = len;
+		head = r->head;
+		off = head & (SHM_RING_SIZE - 1);
+		first = SHM_RING_SIZE - off;
+		if (first > space)
+			first = space;
+		memcpy(ss->data[n] + off, src, first);
+		memcpy(ss->data[n], src + first, space - first);
+		__atomic_store_n(&r->head, head + space, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&r->reader_sleeping, __ATOMIC_SEQ_CST))
+			shm_ring_bell(ss, n);
+		src += space;
+		len -= space;
+	}
+	return 0;
+}
+
+// copy @len bytes out of ring @n, waiting for them as needed
+static int shm_read(struct shm_state *ss, int n, void *dst, uint32_t len)
+{
+	struct shm_ring *r = &ss->rings[n];
+	uint8_t *out = dst;
+	uint32_t tail, avail, off, first, spins;
+
+	while (len) {
+		for (spins = 0; !(avail = ring_used(r)); ) {
+			if (++spins < shm_spins(SHM_SPIN))
+				continue;
+			if (!ss->server)
+				__atomic_store_n(&r->reader_sleeping, 1, __ATOMIC_SEQ_CST);
+			if (!ring_used(r) && shm_sleep(ss, n)) {
+				if (!ss->server)
+					__atomic_store_n(&r->reader_sleeping, 0, __ATOMIC_SEQ_CST);
+				return -1;
+			}
+			if (!ss->server)
+				__atomic_store_n(&r->reader_sleeping, 0, __ATOMIC_SEQ_CST);
+			spins = 0;
+		}
+		if (avail > len)
+			avail = len;
+		tail = r->tail;
+		off = tail & (SHM_RING_SIZE - 1);
+		first = SHM_RING_SIZE - off;
+		if (first > avail)
+			first = avail;
+		memcpy(out, ss->data[n] + off, first);
+		memcpy(out + first, ss->data[n], avail - first);
+		__atomic_store_n(&r->tail, tail + avail, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&r->writer_sleeping, __ATOMIC_SEQ_CST))
+			shm_ring_bell(ss, !n);
+		out += avail;
+		len -= avail;
+	}
+	return 0;
+}
+
+// packets are their length followed by the payload, @data (if any) is
+// copied in after the contents of @buf as part of the same packet
+static int shm_txv(struct rumr_comm_funcs *cf, struct rumr_buffer *buf, const void *data, uint32_t size)
+{
+	struct shm_state *ss = cf->data;
+	uint32_t len = buf->woffset + size;
+	int n = ss->server ? 1 : 0;
+
+	if (shm_write(ss, n, &len, sizeof len) ||
+	    shm_write(ss, n, buf->data, buf->woffset) ||
+	    shm_write(ss, n, data, size))
+		return -1;
+	return 0;
+}
+
+static int shm_tx(struct rumr_comm_funcs *cf, struct rumr_buffer *buf)
+{
+	return shm_txv(cf, buf, NULL, 0);
+}
+
+// receive a packet, if it is not compressed and has exactly @size bytes
+// past its first @head they are copied straight into @dst
+//
+// The server side is woken by epoll and returns 1 (nothing received) if
+// that was for a doorbell rung while it was still sending its reply.
+static int shm_rx_into(struct rumr_comm_funcs *cf, struct rumr_buffer **buf, uint32_t head, void *dst, uint32_t size, int *direct)
+{
+	struct shm_state *ss = cf->data;
+	uint32_t len, header;
+	uint64_t v;
+	int n = ss->server ? 0 : 1;
+
+	*buf = NULL;
+	if (direct)
+		*direct = 0;
+
+	if (ss->server && !ring_used(&ss->rings[n])) {
+		if (shm_peer_gone(ss))
+			return -1;
+		// clear the doorbell before looking again so a packet
+		// written right after still wakes epoll
+		if (read(ss->efd[n], &v, sizeof v) < 0 && errno != EAGAIN)
+			return -1;
+		if (!ring_used(&ss->rings[n]))
+			return 1;
+	}
+
+	if (shm_read(ss, n, &len, sizeof len))
+		return -1;
+
+	*buf = rumr_buffer_init();
+	if (!*buf)
+		return -1;
+	if (head < 4 || len < head)
+		head = 0;
+	if (rumr_buffer_reserve(*buf, head ? head : len))
+		goto error;
+	if (head) {
+		if (shm_read(ss, n, (*buf)->data, head))
+			goto error;
+		memcpy(&header, (*buf)->data, 4);
+		if (!(header & RUMR_HDR_COMPRESSED) && len - head == size && dst) {
+			if (shm_read(ss, n, dst, size))
+				goto error;
+			(*buf)->woffset = head;
+			if (direct)
+				*direct = 1;
+			return 0;
+		}
+		// not for @dst after all, the rest joins the head
+		if (rumr_buffer_reserve(*buf, len))
+			goto error;
+	}
+	if (shm_read(ss, n, (*buf)->data + head, len - head))
+		goto error;
+	(*buf)->woffset = len;
+	return 0;
+error:
+	rumr_buffer_free(*buf);
+	*buf = NULL;
+	return -1;
+}
+
+static int shm_rx(struct rumr_comm_funcs *cf, struct rumr_buffer **buf)
+{
+	return shm_rx_into(cf, buf, 0, NULL, 0, NULL);
+}
+
+// close down everything
+static int shm_close(struct rumr_comm_funcs *cf)
+{
+	struct shm_state *ss = cf->data;
+
+	cf->log_msg("[VERBOSE]: Shutting down shared memory\n");
+	shm_state_disconnect(ss);
+	if (ss->sock >= 0)
+		close(ss->sock);
+	free(ss);
+	cf->data = NULL;
+	return 0;
+}
+
+// only close the client connection
+static int shm_closeclient(struct rumr_comm_funcs *cf)
+{
+	cf->log_msg("[VERBOSE]: Closing client connection\n");
+	shm_state_disconnect(cf->data);
+	return 0;
+}
+
+// server side: wait a little for the client's next request with the
+// doorbell muted, requests of a busy client then skip epoll entirely
+static int shm_status(struct rumr_comm_funcs *cf)
+{
+	struct shm_state *ss = cf->data;
+	struct shm_ring *r;
+	uint32_t x;
+	int pending = 0;
+
+	if (!ss->server || !ss->rings)
+		return 0;
+	r = &ss->rings[0];
+	__atomic_store_n(&r->reader_sleeping, 0, __ATOMIC_SEQ_CST);
+	for (x = shm_spins(SHM_IDLE_SPIN); x && !pending; x--)
+		pending = !!ring_used(r);
+	__atomic_store_n(&r->reader_sleeping, 1, __ATOMIC_SEQ_CST);
+
+	// it may have arrived just as the doorbell came back on
+	return pending || ring_used(r);
+}
+
+const struct rumr_comm_funcs rumr_shm_funcs = {
+	NULL,
+	&shm_connect,
+	&shm_bind,
+	&shm_accept,
+	&shm_tx,
+	&shm_rx,
+	&shm_close,
+	&shm_closeclient,
+	&shm_status,
+	NULL,
+	&shm_accept_conn,
+	&shm_get_fd,
+	&shm_txv,
+	&shm_rx_into,
+};
@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include <umr_rumr.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Per opcode request counters for clients and servers.  Servers update
+ * them from several worker threads so everything is added atomically,
+ * a summary taken while requests are in flight may be off by those.
+ *
+ * Latencies go in a histogram indexed by the position of their top bit
+ * times four plus the two bits below it, so a percentile is known to
+ * within 25% (nanoseconds below 4 get a bucket each).
+ */
+
+static const char *opcode_names[] = {
+	"discover",
+	"reg_access",
+	"mem_access",
+	"wave_access",
+	"gpr_access",
+	"ring_access",
+	"user_queue_parse",
+	"goodbye",
+	"batch",
+	"wave_scan",
+	"vm_access",
+	"stats",
+	"ring_decode",
+};
+
+const char *rumr_opcode_name(uint32_t opcode)
+{
+	return opcode < sizeof(opcode_names) / sizeof(opcode_names[0]) ? opcode_names[opcode] : "unknown";
+}
+
+uint64_t rumr_stats_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned bucket(uint64_t ns)
+{
+	unsigned msb;
+
+	if (ns < 4)
+		return ns;
+	msb = 63 - __builtin_clzll(ns);
+	return msb * 4 + ((ns >> (msb - 2)) & 3);
+}
+
+// middle of the range of latencies that land in bucket @b
+static uint64_t bucket_ns(unsigned b)
+{
+	unsigned msb = b / 4;
+
+	if (b < 8)
+		return b;
+	return ((4ULL + (b & 3)) << (msb - 2)) + (1ULL << (msb - 2)) / 2;
+}
+
+/**
+ * rumr_stats_add - Account one request
+ * @stats: The counters (may be NULL)
+ * @opcode: The RUMR_OP_* of the request
+ * @ns: Round trip (client) or handling (server) time
+ * @bytes_tx: Bytes sent on the wire
+ * @bytes_rx: Bytes received on the wire
+ */
+void rumr_stats_add(struct rumr_stats *stats, uint32_t opcode, uint64_t ns, uint32_t bytes_tx, uint32_t bytes_rx)
+{
+	struct rumr_op_stats *op;
+
+	if (!stats || opcode >= RUMR_STATS_OPS)
+		return;
+	op = &stats->op[opcode];
+	__atomic_fetch_add(&op->count, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&op->ns, ns, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&op->bytes_tx, bytes_tx, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&op->bytes_rx, bytes_rx, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&op->hist[bucket(ns)], 1, __ATOMIC_RELAXED);
+}
+
+// latency under which @pct percent of the @count requests in @hist were
+static uint64_t percentile(const uint64_t *hist, uint64_t count, unsigned pct)
+{
+	uint64_t want = (count * pct + 99) / 100, seen = 0;
+	unsigned b;
+
+	for (b = 0; b < RUMR_STATS_BUCKETS; b++) {
+		seen += hist[b];
+		if (seen && seen >= want)
+			return bucket_ns(b);
+	}
+	return 0;
+}
+
+/**
+ * rumr_stats_summarize - Reduce the counters to totals and percentiles
+ * @stats: The counters (may be NULL, all zero then)
+ * @sum: RUMR_STATS_OPS summaries indexed by opcode
+ */
+void rumr_stats_summarize(struct rumr_stats *stats, struct rumr_op_summary *sum)
+{
+	uint64_t hist[RUMR_STATS_BUCKETS];
+	struct rumr_op_stats *op;
+	unsigned i, b;
+
+	memset(sum, 0, RUMR_STATS_OPS * sizeof *sum);
+	if (!stats)
+		return;
+	for (i = 0; i < RUMR_STATS_OPS; i++) {
+		op = &stats->op[i];
+		sum[i].count = __atomic_load_n(&op->count, __ATOMIC_RELAXED);
+		sum[i].ns = __atomic_load_n(&op->ns, __ATOMIC_RELAXED);
+		sum[i].bytes_tx = __atomic_load_n(&op->bytes_tx, __ATOMIC_RELAXED);
+		sum[i].bytes_rx = __atomic_load_n(&op->bytes_rx, __ATOMIC_RELAXED);
+		if (!sum[i].count)
+			continue;
+		for (b = 0; b < RUMR_STATS_BUCKETS; b++)
+			hist[b] = __atomic_load_n(&op->hist[b], __ATOMIC_RELAXED);
+		sum[i].p50_ns = percentile(hist, sum[i].count, 50);
+		sum[i].p99_ns = percentile(hist, sum[i].count, 99);
+	}
+}
+
+/**
+ * rumr_stats_print - Print a table of the opcodes used to @f
+ * @sum: RUMR_STATS_OPS summaries from rumr_stats_summarize()
+ * @title: What the times are, e.g. "client rtt"
+ */
+void rumr_stats_print(const struct rumr_op_summary *sum, const char *title, FILE *f)
+{
+	unsigned i;
+
+	fprintf(f, "%-18s %10s %10s %10s %10s %12s %12s\n", title, "calls", "mean us", "p50 us", "p99 us", "tx bytes", "rx bytes");
+	for (i = 0; i < RUMR_STATS_OPS; i++) {
+		if (!sum[i].count)
+			continue;
+		fprintf(f, "%-18s %10"PRIu64" %10.1f %10.1f %10.1f %12"PRIu64" %12"PRIu64"\n",
+			rumr_opcode_name(i), sum[i].count,
+			sum[i].ns / 1000.0 / sum[i].count,
+			sum[i].p50_ns / 1000.0, sum[i].p99_ns / 1000.0,
+			sum[i].bytes_tx, sum[i].bytes_rx);
+	}
+}
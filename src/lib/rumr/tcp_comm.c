@@ -1,8 +1,17 @@
 
 #include "umr_rumr.h"
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <netdb.h>
+#include <poll.h>
+#include <errno.h>
+#if defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY)
+#include <linux/errqueue.h>
+#define TCP_HAVE_ZEROCOPY 1
+#endif
 
 /** TCP implementation
  * So far fairly basic.  Only supports IPv4 and
@@ -10,8 +19,26 @@
  */
 struct tcp_state {
 	int sock, con_sock;
+	int zerocopy;			// MSG_ZEROCOPY enabled (RUMR_ZEROCOPY set)
+	uint32_t zc_sent, zc_done;	// zerocopy sends made / completed
 };
 
+// payloads at least this large are sent with MSG_ZEROCOPY if enabled
+#define TCP_ZEROCOPY_MIN (64 * 1024)
+
+// set up a connected socket: no Nagle delay on our request/reply
+// traffic and MSG_ZEROCOPY if asked for with RUMR_ZEROCOPY=1
+static void tcp_tune(struct tcp_state *ts)
+{
+	int one = 1;
+
+	setsockopt(ts->con_sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+#ifdef TCP_HAVE_ZEROCOPY
+	if (getenv("RUMR_ZEROCOPY") && atoi(getenv("RUMR_ZEROCOPY")))
+		ts->zerocopy = !setsockopt(ts->con_sock, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof one);
+#endif
+}
+
 // convert a string to sockaddr_in structure
 static struct sockaddr_in addr_to_sin4(char *addr)
 {
@@ -40,7 +67,7 @@ static int tcp_connect(struct rumr_comm_funcs *cf, char *server)
 	struct tcp_state *ts;
 
 	ts = cf->data = calloc(1, sizeof *ts);
-	ts->con_sock = -1;
+	ts->sock = ts->con_sock = -1;
 
 	ts = cf->data;
 	sin = addr_to_sin4(server);
@@ -88,6 +115,7 @@ static int tcp_connect(struct rumr_comm_funcs *cf, char *server)
 		return -1;
 	}
 
+	tcp_tune(ts);
 	cf->log_msg("[VERBOSE]: Connected to %s\n", server);
 
 	return 0;
@@ -126,7 +154,7 @@ static int tcp_bind(struct rumr_comm_funcs *cf, char *host)
 	}
 
 	// now listen
-	if (listen(ts->sock, 1) < 0) {
+	if (listen(ts->sock, 16) < 0) {
 		cf->log_msg("[ERROR]: Could not listen\n");
 		close(ts->sock);
 		free(ts);
@@ -142,35 +170,243 @@ static int tcp_bind(struct rumr_comm_funcs *cf, char *host)
 	return 0;
 }
 
+/*
+ * unix:// uses the same packets and code as TCP over a unix domain
+ * socket, e.g. unix:///run/umr.sock for clients on the same host.
+ */
+static int unix_addr(struct rumr_comm_funcs *cf, char *path, struct sockaddr_un *sun)
+{
+	memset(sun, 0, sizeof *sun);
+	sun->sun_family = AF_UNIX;
+	if (!*path || strlen(path) >= sizeof sun->sun_path) {
+		cf->log_msg("[ERROR]: Invalid unix socket path\n");
+		return -1;
+	}
+	strcpy(sun->sun_path, path);
+	return 0;
+}
+
+// connect a client to a server on a unix socket
+static int unix_connect(struct rumr_comm_funcs *cf, char *path)
+{
+	struct sockaddr_un sun;
+	struct tcp_state *ts;
+
+	if (unix_addr(cf, path, &sun))
+		return -1;
+
+	ts = cf->data = calloc(1, sizeof *ts);
+	if (!ts)
+		return -1;
+	ts->sock = -1;
+	ts->con_sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (ts->con_sock < 0) {
+		cf->log_msg("[ERROR]: Could not create socket\n");
+		goto error;
+	}
+	if (connect(ts->con_sock, (const struct sockaddr *)&sun, sizeof sun) < 0) {
+		cf->log_msg("[ERROR]: Could not connect to server\n");
+		close(ts->con_sock);
+		goto error;
+	}
+
+	cf->log_msg("[VERBOSE]: Connected to %s\n", path);
+	return 0;
+error:
+	free(ts);
+	cf->data = NULL;
+	return -1;
+}
+
+// bind to a unix socket path (a stale socket left there is replaced)
+static int unix_bind(struct rumr_comm_funcs *cf, char *path)
+{
+	struct sockaddr_un sun;
+	struct tcp_state *ts;
+
+	if (unix_addr(cf, path, &sun))
+		return -1;
+
+	ts = cf->data = calloc(1, sizeof *ts);
+	if (!ts)
+		return -1;
+	ts->con_sock = -1;
+	ts->sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (ts->sock < 0) {
+		cf->log_msg("[ERROR]: Could not allocate a socket\n");
+		goto error;
+	}
+	unlink(path);
+	if (bind(ts->sock, (const struct sockaddr *)&sun, sizeof sun) < 0 || listen(ts->sock, 16) < 0) {
+		cf->log_msg("[ERROR]: Could not bind socket\n");
+		close(ts->sock);
+		goto error;
+	}
+
+	cf->log_msg("[VERBOSE]: Bound to %s\n", path);
+	return 0;
+error:
+	free(ts);
+	cf->data = NULL;
+	return -1;
+}
+
+// accept a client on the bound socket @sock, -1 on error
+static int sock_accept(struct rumr_comm_funcs *cf, int sock)
+{
+	struct sockaddr_storage ss;
+	struct sockaddr_in *sin = (struct sockaddr_in *)&ss;
+	socklen_t sslen;
+	uint8_t *ip4 = (uint8_t *)&sin->sin_addr.s_addr;
+	int fd;
+
+	sslen = sizeof ss;
+	fd = accept(sock, (struct sockaddr *)&ss, &sslen);
+	if (fd < 0) {
+		return -1;
+	}
+
+	if (ss.ss_family == AF_INET) {
+		sin->sin_addr.s_addr = ntohl(sin->sin_addr.s_addr);
+		cf->log_msg("[VERBOSE]: Accepted connection from %"PRIu8".%"PRIu8".%"PRIu8".%"PRIu8":%"PRIu16"\n",
+			    ip4[3], ip4[2], ip4[1], ip4[0], ntohs(sin->sin_port));
+	} else {
+		cf->log_msg("[VERBOSE]: Accepted local connection\n");
+	}
+	return fd;
+}
+
 // wait (blocking) for a new client connection
 static int tcp_accept(struct rumr_comm_funcs *cf)
 {
 	struct tcp_state *ts = cf->data;
-	struct sockaddr_in sin;
-	socklen_t sinlen;
-	uint8_t *ip4 = (uint8_t *)&sin.sin_addr.s_addr;
 
-	sinlen = sizeof sin;
-	ts->con_sock = accept(ts->sock, (struct sockaddr *)&sin, &sinlen);
+	ts->con_sock = sock_accept(cf, ts->sock);
 	if (ts->con_sock < 0) {
 		return -1;
 	}
+	tcp_tune(ts);
+	return 0;
+}
+
+// accept a client into its own channel, the bound socket stays with @cf
+static int tcp_accept_conn(struct rumr_comm_funcs *cf, struct rumr_comm_funcs *conn)
+{
+	struct tcp_state *ts = cf->data, *cs;
 
-	sin.sin_addr.s_addr = ntohl(sin.sin_addr.s_addr);
-	cf->log_msg("[VERBOSE]: Accepted connection from %"PRIu8".%"PRIu8".%"PRIu8".%"PRIu8":%"PRIu16"\n",
-		    ip4[3], ip4[2], ip4[1], ip4[0], ntohs(sin.sin_port));
+	cs = calloc(1, sizeof *cs);
+	if (!cs)
+		return -1;
 
+	cs->sock = -1;
+	cs->con_sock = sock_accept(cf, ts->sock);
+	if (cs->con_sock < 0) {
+		free(cs);
+		return -1;
+	}
+
+	tcp_tune(cs);
+	*conn = *cf;
+	conn->data = cs;
 	return 0;
 }
 
+static int tcp_get_fd(struct rumr_comm_funcs *cf)
+{
+	struct tcp_state *ts = cf->data;
+	return (ts->con_sock >= 0) ? ts->con_sock : ts->sock;
+}
+
+#ifdef TCP_HAVE_ZEROCOPY
+// wait until the kernel is done with the pages of every zerocopy send
+static int tcp_zerocopy_wait(struct tcp_state *ts)
+{
+	struct pollfd pfd;
+	struct msghdr msg;
+	struct cmsghdr *cm;
+	struct sock_extended_err *ee;
+	char control[128];
+
+	while (ts->zc_done != ts->zc_sent) {
+		pfd.fd = ts->con_sock;
+		pfd.events = 0; // POLLERR is always reported
+		if (poll(&pfd, 1, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		memset(&msg, 0, sizeof msg);
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof control;
+		if (recvmsg(ts->con_sock, &msg, MSG_ERRQUEUE) < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				continue;
+			return -1;
+		}
+		for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+			ee = (struct sock_extended_err *)CMSG_DATA(cm);
+			if (ee->ee_errno == 0 && ee->ee_origin == SO_EE_ORIGIN_ZEROCOPY)
+				ts->zc_done = ee->ee_data + 1; // completions are in order
+		}
+	}
+	return 0;
+}
+#endif
+
+// send every byte of @iov, the iovecs are consumed
+static int tcp_sendv(struct tcp_state *ts, struct iovec *iov, int niov, size_t total)
+{
+	struct msghdr msg;
+	ssize_t r;
+	int flags = MSG_NOSIGNAL; // a client going away must not SIGPIPE a server with others
+
+#ifdef TCP_HAVE_ZEROCOPY
+	if (ts->zerocopy && total >= TCP_ZEROCOPY_MIN)
+		flags |= MSG_ZEROCOPY;
+#endif
+	while (niov) {
+		memset(&msg, 0, sizeof msg);
+		msg.msg_iov = iov;
+		msg.msg_iovlen = niov;
+		r = sendmsg(ts->con_sock, &msg, flags);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+#ifdef TCP_HAVE_ZEROCOPY
+		if (flags & MSG_ZEROCOPY)
+			++ts->zc_sent;
+#endif
+		// skip what was sent
+		while (niov && (size_t)r >= iov->iov_len) {
+			r -= iov->iov_len;
+			++iov;
+			--niov;
+		}
+		if (niov) {
+			iov->iov_base = (uint8_t *)iov->iov_base + r;
+			iov->iov_len -= r;
+		}
+	}
+#ifdef TCP_HAVE_ZEROCOPY
+	// the caller may reuse its memory as soon as we return
+	if (flags & MSG_ZEROCOPY)
+		return tcp_zerocopy_wait(ts);
+#endif
+	return 0;
+}
 
 // this TCP layer wraps each packet with 8 bytes made up of
 // RUMR
 // payload len (in bytes)
-static int tcp_tx(struct rumr_comm_funcs *cf, struct rumr_buffer *buf)
+// which sit in the preheader of @buf, @data (if any) is sent from where
+// it is after the contents of @buf as part of the same packet
+static int tcp_txv(struct rumr_comm_funcs *cf, struct rumr_buffer *buf, const void *data, uint32_t size)
 {
 	struct tcp_state *ts = cf->data;
-	uint32_t len = buf->woffset;
+	struct iovec iov[2];
+	uint32_t len = buf->woffset + size;
 	uint8_t *ptr = buf->data - RUMR_BUFFER_PREHEADER;
 
 	ptr[0] = 'R';
@@ -182,27 +418,37 @@ static int tcp_tx(struct rumr_comm_funcs *cf, struct rumr_buffer *buf)
 	ptr[6] = (len>>16) & 0xFF;
 	ptr[7] = (len>>24) & 0xFF;
 
-	// we prefix buffers so we can use one send() to send
-	// both our TCP header and the RUMR payload
-	// a single send() call greatly speeds up the RX side
-	if (send(ts->con_sock, buf->data-8, len+8, 0) != (len+8)) {
-		return -1;
-	}
-	return 0;
+	// we prefix buffers so we can send both our TCP header and the
+	// RUMR payload in one go, a single send greatly speeds up the
+	// RX side
+	iov[0].iov_base = ptr;
+	iov[0].iov_len = buf->woffset + 8;
+	iov[1].iov_base = (void *)data;
+	iov[1].iov_len = size;
+	return tcp_sendv(ts, iov, size ? 2 : 1, len + 8);
 }
 
-static int tcp_rx(struct rumr_comm_funcs *cf, struct rumr_buffer **buf)
+static int tcp_tx(struct rumr_comm_funcs *cf, struct rumr_buffer *buf)
+{
+	return tcp_txv(cf, buf, NULL, 0);
+}
+
+// receive a packet, if it is not compressed and has exactly @size bytes
+// past its first @head they are received straight into @dst
+static int tcp_rx_into(struct rumr_comm_funcs *cf, struct rumr_buffer **buf, uint32_t head, void *dst, uint32_t size, int *direct)
 {
 	struct tcp_state *ts = cf->data;
 	uint8_t hdr[8];
-	uint32_t len;
+	uint32_t len, header;
 
 	*buf = NULL;
+	if (direct)
+		*direct = 0;
 
 	// receive the TCP header
-	// note that even though we have two recv() calls only
+	// note that even though we have several recv() calls only
 	// the first one blocks waiting for 8 bytes, because
-	// we TX in a single send() by time this passes
+	// we TX in a single send by time this passes
 	// the next recv() has (at least some) contents to read
 	if (recv(ts->con_sock, hdr, 8, MSG_WAITALL) != 8) {
 		return -1;
@@ -214,20 +460,47 @@ static int tcp_rx(struct rumr_comm_funcs *cf, struct rumr_buffer **buf)
 	len =	((uint32_t)hdr[4]) | ((uint32_t)hdr[5] << 8) |
 		((uint32_t)hdr[6] << 16) | ((uint32_t)hdr[7] << 24);
 
+	// receive straight into a (pooled) buffer big enough for the payload
+	// (or only its head if the rest goes to @dst)
 	*buf = rumr_buffer_init();
 	if (!*buf) {
 		return -1;
 	}
-	(*buf)->data = (uint8_t*)calloc(1, len + RUMR_BUFFER_PREHEADER) + RUMR_BUFFER_PREHEADER;
+	if (head < 4 || len < head)
+		head = 0;
+	if (rumr_buffer_reserve(*buf, head ? head : len))
+		goto error;
+	if (head) {
+		if (recv(ts->con_sock, (*buf)->data, head, MSG_WAITALL) != head)
+			goto error;
+		memcpy(&header, (*buf)->data, 4);
+		if (!(header & RUMR_HDR_COMPRESSED) && len - head == size && dst) {
+			if (size && recv(ts->con_sock, dst, size, MSG_WAITALL) != size)
+				goto error;
+			(*buf)->woffset = head;
+			if (direct)
+				*direct = 1;
+			return 0;
+		}
+		// not for @dst after all, the rest joins the head
+		if (rumr_buffer_reserve(*buf, len))
+			goto error;
+	}
 	(*buf)->woffset = len;
 
-	if (recv(ts->con_sock, (*buf)->data, len, MSG_WAITALL) != len) {
-		rumr_buffer_free(*buf);
-		*buf = NULL;
-		return -1;
-	}
+	if (len > head && recv(ts->con_sock, (*buf)->data + head, len - head, MSG_WAITALL) != len - head)
+		goto error;
 
 	return 0;
+error:
+	rumr_buffer_free(*buf);
+	*buf = NULL;
+	return -1;
+}
+
+static int tcp_rx(struct rumr_comm_funcs *cf, struct rumr_buffer **buf)
+{
+	return tcp_rx_into(cf, buf, 0, NULL, 0, NULL);
 }
 
 // close down *all* sockets
@@ -274,9 +547,60 @@ const struct rumr_comm_funcs rumr_tcp_funcs = {
 	&tcp_close,
 	&tcp_closeclient,
 	&tcp_status,
-	NULL
+	NULL,
+	&tcp_accept_conn,
+	&tcp_get_fd,
+	&tcp_txv,
+	&tcp_rx_into,
+};
+
+const struct rumr_comm_funcs rumr_unix_funcs = {
+	NULL,
+	&unix_connect,
+	&unix_bind,
+	&tcp_accept,
+	&tcp_tx,
+	&tcp_rx,
+	&tcp_close,
+	&tcp_closeclient,
+	&tcp_status,
+	NULL,
+	&tcp_accept_conn,
+	&tcp_get_fd,
+	&tcp_txv,
+	&tcp_rx_into,
 };
 
+/**
+ * rumr_comm_lookup - The comms for an address
+ * @url: The address, e.g. tcp://127.0.0.1:9000, unix:///run/umr.sock or
+ *       shm:///run/umr.sock
+ * @addr: Set to the part of @url after the scheme
+ *
+ * Returns the comms or NULL if the scheme is not known.
+ */
+const struct rumr_comm_funcs *rumr_comm_lookup(char *url, char **addr)
+{
+	static const struct {
+		const char *scheme;
+		const struct rumr_comm_funcs *cf;
+	} schemes[] = {
+		{ "tcp://", &rumr_tcp_funcs },
+		{ "unix://", &rumr_unix_funcs },
+		{ "shm://", &rumr_shm_funcs },
+	};
+	unsigned x;
+
+	*addr = url;
+	for (x = 0; x < sizeof(schemes) / sizeof(schemes[0]); x++) {
+		if (!strncmp(url, schemes[x].scheme, strlen(schemes[x].scheme))) {
+			*addr = &url[strlen(schemes[x].scheme)];
+			return schemes[x].cf;
+		}
+	}
+	return NULL;
+}
+
 
 #ifdef DEMO
 
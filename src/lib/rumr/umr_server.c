@@ -24,6 +24,9 @@
  */
 #include <umr_rumr.h>
 #include <stdint.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <errno.h>
 
 /* An implementation of the Server side using UMR
  * to access the ASIC.  This is an example though useful for
@@ -43,10 +46,16 @@ int rumr_server_bind(struct rumr_server_state *state, struct rumr_comm_funcs *cf
 	// create serialized asic we can use over and over
 	memcpy(&state->comm, cf, sizeof *cf);
 	state->log_msg = state->comm.log_msg;
+	state->codecs = 0;
 	state->serialized_asic = rumr_serialize_asic(state->asic);
 	if (!state->serialized_asic)
 		return -1;
 	state->log_msg("[VERBOSE]: Serialized ASIC is %"PRIu32" bytes long\n", state->serialized_asic->woffset);
+	state->serialized_head = rumr_serialized_asic_head(state->serialized_asic);
+	state->serialized_hash = rumr_serialized_asic_hash(state->serialized_asic);
+	state->stats = calloc(1, sizeof *state->stats);
+	if (!state->stats)
+		return -1;
 
 	// bind communication for server
 	return state->comm.bind(&state->comm, host);
@@ -61,6 +70,7 @@ int rumr_server_bind(struct rumr_server_state *state, struct rumr_comm_funcs *cf
 int rumr_server_accept(struct rumr_server_state *state)
 {
 	state->log_msg("[VERBOSE]: Accepting a new client...\n");
+	state->codecs = 0; // until the client says what it supports in RUMR_OP_DISCOVER
 	return state->comm.accept(&state->comm);
 }
 
@@ -137,6 +147,71 @@ static int handle_op_wave_access(struct rumr_server_state *state, struct rumr_bu
 	return 0;
 }
 
+// append @words[0..n-1] as a count and the words without the trailing zeros
+static void add_trimmed(struct rumr_buffer *outbuf, uint32_t *words, uint32_t n)
+{
+	while (n && !words[n - 1])
+		--n;
+	rumr_buffer_add_uint32(outbuf, n);
+	rumr_buffer_add_data(outbuf, words, n * 4);
+}
+
+// scan every wave (and read the GPRs of the halted ones) in one request
+// instead of a WAVE_ACCESS per slot and a GPR_ACCESS per thread
+static int handle_op_wave_scan(struct rumr_server_state *state, struct rumr_buffer *inbuf, struct rumr_buffer *outbuf)
+{
+	struct umr_asic *asic = state->asic;
+	struct umr_wave_data *head, *wd;
+	uint32_t flags, count, countoff, thread;
+	int skip_gprs, prefetch_gprs;
+
+	flags = rumr_buffer_read_uint32(inbuf);
+
+	// scan with the client's skip_gprs, the GPRs are read below instead
+	// of in the background
+	skip_gprs = asic->options.skip_gprs;
+	prefetch_gprs = asic->options.prefetch_gprs;
+	asic->options.skip_gprs = (flags & RUMR_WAVE_SCAN_SKIP_GPRS) ? 1 : 0;
+	asic->options.prefetch_gprs = 0;
+	head = umr_scan_wave_data(asic);
+	asic->options.skip_gprs = skip_gprs;
+	asic->options.prefetch_gprs = prefetch_gprs;
+
+	rumr_buffer_add_uint32(outbuf, 1); // STATUS==1
+	countoff = outbuf->woffset;
+	rumr_buffer_add_uint32(outbuf, 0);
+	for (count = 0, wd = head; wd; wd = wd->next, ++count) {
+		rumr_buffer_add_uint32(outbuf, wd->se);
+		rumr_buffer_add_uint32(outbuf, wd->sh);
+		rumr_buffer_add_uint32(outbuf, wd->cu);
+		rumr_buffer_add_uint32(outbuf, wd->simd);
+		rumr_buffer_add_uint32(outbuf, wd->wave);
+		rumr_buffer_add_uint32(outbuf, wd->num_threads);
+		rumr_buffer_add_uint32(outbuf, wd->ws.sq_info.busy);
+		rumr_buffer_add_uint32(outbuf, wd->ws.sq_info.wave_level);
+		add_trimmed(outbuf, wd->ws.reg_values, 64);
+
+		// the GPRs of a running wave are left to be read on demand
+		if (!(flags & RUMR_WAVE_SCAN_GPRS) ||
+		    !(umr_wave_data_get_flag_halt(asic, wd) || umr_wave_data_get_flag_fatal_halt(asic, wd)) ||
+		    umr_wave_data_fetch_gprs(asic, wd)) {
+			rumr_buffer_add_uint32(outbuf, 0);
+			continue;
+		}
+		rumr_buffer_add_uint32(outbuf, 1);
+		add_trimmed(outbuf, wd->sgprs, 1024);
+		rumr_buffer_add_uint32(outbuf, wd->have_vgprs);
+		if (wd->have_vgprs)
+			for (thread = 0; thread < wd->num_threads; thread++)
+				add_trimmed(outbuf, &wd->vgprs[256 * thread], 256);
+	}
+	umr_free_wave_data(head);
+
+	if (!outbuf->failed)
+		memcpy(&outbuf->data[countoff], &count, 4);
+	return 0;
+}
+
 // handle a generic memory access (read/write, iommu mapping)
 static int handle_op_mem_access(struct rumr_server_state *state, struct rumr_buffer *inbuf, struct rumr_buffer *outbuf)
 {
@@ -191,28 +266,45 @@ static int handle_op_mem_access(struct rumr_server_state *state, struct rumr_buf
 	if (in.subcommand == 0 || in.subcommand == 1) {
 		// we're accessing memory
 		if (in.rw == 0) {
-			// reading
-			void *dst;
+			// reading, straight into the reply after its status/address
+			uint32_t status, off = outbuf->woffset, done, len;
+			uint64_t va = asic->options.user_queue.state.va;
+			uint8_t *dst;
 
-			dst = calloc(1, in.size);
-			if (in.subcommand == 1) {
-				// read from sysmem
-				r = umr_access_sram(asic, addr, in.size, dst, 0);
-			} else {
-				// read from vram
-				r = umr_access_vram(asic, asic->options.vm_partition, UMR_LINEAR_HUB, addr, in.size, dst, 0, NULL);
-			}
-			rumr_buffer_add_uint32(outbuf, r ? 0 : 1);
+			rumr_buffer_add_uint32(outbuf, 0);
 			rumr_buffer_add_uint32(outbuf, in.addr_lo);
 			rumr_buffer_add_uint32(outbuf, in.addr_hi);
+			if (rumr_buffer_reserve(outbuf, in.size))
+				return -1;
+			dst = &outbuf->data[outbuf->woffset];
+
+			// in pieces so other clients of the asic get a turn in between
+			for (r = 0, done = 0; !r && done < in.size; done += len) {
+				len = in.size - done;
+				if (len > RUMR_SERVER_CHUNK)
+					len = RUMR_SERVER_CHUNK;
+				if (done) {
+					rumr_server_unlock(state);
+					rumr_server_lock(state);
+					asic->options.user_queue.state.va = va;
+				}
+				if (in.subcommand == 1) {
+					// read from sysmem
+					r = umr_access_sram(asic, addr + done, len, dst + done, 0);
+				} else {
+					// read from vram
+					r = umr_access_vram(asic, asic->options.vm_partition, UMR_LINEAR_HUB, addr + done, len, dst + done, 0, NULL);
+				}
+			}
+			status = r ? 0 : 1;
+			memcpy(&outbuf->data[off], &status, 4);
 			if (!r)
-				rumr_buffer_add_data(outbuf, dst, in.size);
-			free(dst);
+				outbuf->woffset += in.size;
 		} else {
 			// writing
 			void *dst;
 
-			if (in.size != (inbuf->size - inbuf->roffset)) {
+			if (in.size != (inbuf->woffset - inbuf->roffset)) {
 				state->log_msg("[ERROR]: Write buffer size does not match remaining packet size\n");
 				return -1;
 			}
@@ -240,6 +332,91 @@ static int handle_op_mem_access(struct rumr_server_state *state, struct rumr_buf
 	return 0;
 }
 
+// handle an access through a GPU VM, the page tables are walked here
+// rather than by the client one register and PDE/PTE at a time
+static int handle_op_vm_access(struct rumr_server_state *state, struct rumr_buffer *inbuf, struct rumr_buffer *outbuf)
+{
+	struct {
+		uint32_t
+			addr_lo,
+			addr_hi,
+			vmid,
+			partition,
+			options,
+			size;
+	} in;
+	struct umr_vm_pagewalk pw, *vmdata;
+	struct umr_asic *asic = state->asic;
+	uint32_t status, off, done, len;
+	uint64_t addr;
+	uint8_t *dst;
+	int r;
+
+	in.addr_lo = rumr_buffer_read_uint32(inbuf);
+	in.addr_hi = rumr_buffer_read_uint32(inbuf);
+		addr = ((uint64_t)in.addr_lo) | ((uint64_t)in.addr_hi << 32ULL);
+	in.vmid = rumr_buffer_read_uint32(inbuf);
+	in.partition = rumr_buffer_read_uint32(inbuf);
+	in.options = rumr_buffer_read_uint32(inbuf);
+	in.size = rumr_buffer_read_uint32(inbuf);
+
+	if ((in.size & 3) || (addr & 3)) {
+		state->log_msg("[ERROR]: Invalid VM access (address and size must be multiples of 4)\n");
+		return -1;
+	}
+
+	// linear VRAM goes through RUMR_OP_MEM_ACCESS and the process hub
+	// would be the server's own memory
+	if ((in.vmid & 0xFF00) == UMR_LINEAR_HUB || (in.vmid & 0xFF00) == UMR_PROCESS_HUB) {
+		state->log_msg("[ERROR]: Invalid VM access hub (0x%" PRIx32 ")\n", in.vmid);
+		return -1;
+	}
+
+	memset(&pw, 0, sizeof pw);
+	vmdata = (in.options & RUMR_VM_PAGEWALK) ? &pw : NULL;
+
+	if (in.options & RUMR_VM_WRITE) {
+		if (in.size != (inbuf->woffset - inbuf->roffset)) {
+			state->log_msg("[ERROR]: Write buffer size does not match remaining packet size\n");
+			return -1;
+		}
+		r = umr_access_vram(asic, in.partition, in.vmid, addr, in.size, &inbuf->data[inbuf->roffset], 1, vmdata);
+		rumr_buffer_add_uint32(outbuf, r ? 0 : 1);
+		if (vmdata)
+			rumr_buffer_add_data(outbuf, vmdata, sizeof *vmdata);
+		return 0;
+	}
+
+	// reading, straight into the reply after its status and page walk
+	off = outbuf->woffset;
+	rumr_buffer_add_uint32(outbuf, 0);
+	if (vmdata)
+		rumr_buffer_add_data(outbuf, vmdata, sizeof *vmdata);
+	if (rumr_buffer_reserve(outbuf, in.size))
+		return -1;
+	dst = &outbuf->data[outbuf->woffset];
+
+	// in pieces so other clients of the asic get a turn in between, a
+	// traced walk is done in one go like it would be locally
+	for (r = 0, done = 0; !r && done < in.size; done += len) {
+		len = in.size - done;
+		if (len > RUMR_SERVER_CHUNK && !vmdata)
+			len = RUMR_SERVER_CHUNK;
+		if (done) {
+			rumr_server_unlock(state);
+			rumr_server_lock(state);
+		}
+		r = umr_access_vram(asic, in.partition, in.vmid, addr + done, len, dst + done, 0, vmdata);
+	}
+	status = r ? 0 : 1;
+	memcpy(&outbuf->data[off], &status, 4);
+	if (vmdata)
+		memcpy(&outbuf->data[off + 4], vmdata, sizeof *vmdata);
+	if (!r)
+		outbuf->woffset += in.size;
+	return 0;
+}
+
 // handle generic mmio/etc register access
 static int handle_op_reg_access(struct rumr_server_state *state, struct rumr_buffer *inbuf, struct rumr_buffer *outbuf)
 {
@@ -259,10 +436,14 @@ static int handle_op_reg_access(struct rumr_server_state *state, struct rumr_buf
 			access,
 			grbm_index,
 			srbm_index,
-			type;
+			type,
+			bit64;
 	} in;
 	uint64_t readval, addr;
 	struct umr_asic *asic = state->asic;
+	struct umr_access_ctx *ctx = umr_access_ctx_current(asic);
+	int *use_bank = ctx ? &ctx->use_bank : &asic->options.use_bank;
+	union umr_bank_select *bank = ctx ? &ctx->bank : &asic->options.bank;
 
 	in.reg_addr_lo = rumr_buffer_read_uint32(inbuf);
 	in.reg_addr_hi = rumr_buffer_read_uint32(inbuf);
@@ -272,10 +453,12 @@ static int handle_op_reg_access(struct rumr_server_state *state, struct rumr_buf
 		in.grbm_index = (in.access_bank >> 1) & 1;
 		in.srbm_index = (in.access_bank >> 2) & 1;
 		in.type = (in.access_bank >> 3) & 0xFF;
+		in.bit64 = (in.access_bank >> 11) & 1;
 	in.se_or_me = rumr_buffer_read_uint32(inbuf);
 	in.sh_or_pipe = rumr_buffer_read_uint32(inbuf);
 	in.instance_or_queue = rumr_buffer_read_uint32(inbuf);
 	in.vmid = rumr_buffer_read_uint32(inbuf);
+	in.value_lo = in.value_hi = 0;
 	if (in.access == 0) { // 0 == write
 		in.value_lo = rumr_buffer_read_uint32(inbuf);
 		in.value_hi = rumr_buffer_read_uint32(inbuf);
@@ -287,27 +470,33 @@ static int handle_op_reg_access(struct rumr_server_state *state, struct rumr_buf
 	}
 
 	if (in.grbm_index) {
-		asic->options.use_bank           = 1;
-		asic->options.bank.grbm.se       = in.se_or_me;
-		asic->options.bank.grbm.sh       = in.sh_or_pipe;
-		asic->options.bank.grbm.instance = in.instance_or_queue;
+		*use_bank           = 1;
+		bank->grbm.se       = in.se_or_me;
+		bank->grbm.sh       = in.sh_or_pipe;
+		bank->grbm.instance = in.instance_or_queue;
 	}
 	if (in.srbm_index) {
-		asic->options.use_bank           = 2;
-		asic->options.bank.srbm.me	 = in.se_or_me;
-		asic->options.bank.srbm.queue	 = in.instance_or_queue;
-		asic->options.bank.srbm.pipe	 = in.sh_or_pipe;
-		asic->options.bank.srbm.vmid	 = in.vmid;
+		*use_bank           = 2;
+		bank->srbm.me       = in.se_or_me;
+		bank->srbm.queue    = in.instance_or_queue;
+		bank->srbm.pipe     = in.sh_or_pipe;
+		bank->srbm.vmid     = in.vmid;
 	}
 
 	if (in.access == 0) {
-		umr_write_reg(asic, addr, in.value_lo | ((uint64_t)in.value_hi << 32ULL), in.type);
+		if (in.bit64)
+			umr_write_reg64(asic, addr, in.value_lo | ((uint64_t)in.value_hi << 32ULL), in.type);
+		else
+			umr_write_reg(asic, addr, in.value_lo, in.type);
 	} else {
-		readval = umr_read_reg(asic, addr, in.type);
+		if (in.bit64)
+			readval = umr_read_reg64(asic, addr, in.type);
+		else
+			readval = umr_read_reg(asic, addr, in.type);
 	}
 
 	// turn off bank selection
-	asic->options.use_bank = 0;
+	*use_bank = 0;
 
 	rumr_buffer_add_uint32(outbuf, 1); // STATUS==1
 	if (in.access == 1) {
@@ -345,6 +534,105 @@ static int handle_op_ring_access(struct rumr_server_state *state, struct rumr_bu
 	return 0;
 }
 
+static void add_uint64(struct rumr_buffer *outbuf, uint64_t val)
+{
+	rumr_buffer_add_uint32(outbuf, val & 0xFFFFFFFFUL);
+	rumr_buffer_add_uint32(outbuf, val >> 32);
+}
+
+// a PM4 stream and the IBs it points to, see RUMR_PM4_*
+static void add_pm4_stream(struct rumr_buffer *outbuf, struct umr_pm4_stream *ps)
+{
+	struct umr_shaders_pgm *pgm;
+	uint32_t count, countoff, flags;
+
+	countoff = outbuf->woffset;
+	rumr_buffer_add_uint32(outbuf, 0);
+	for (count = 0; ps && !outbuf->failed; ps = ps->next, ++count) {
+		rumr_buffer_add_uint32(outbuf, ps->header);
+		rumr_buffer_add_uint32(outbuf, ps->ib_offset);
+		rumr_buffer_add_uint32(outbuf, ps->n_words);
+		rumr_buffer_add_data(outbuf, ps->words, ps->n_words * 4);
+		flags = (ps->shader ? RUMR_PM4_SHADER : 0) | (ps->ib ? RUMR_PM4_IB : 0) | (ps->invalid ? RUMR_PM4_INVALID : 0);
+		rumr_buffer_add_uint32(outbuf, flags);
+		if (ps->shader) {
+			uint32_t n = 0;
+			for (pgm = ps->shader; pgm; pgm = pgm->next)
+				++n;
+			rumr_buffer_add_uint32(outbuf, n);
+			for (pgm = ps->shader; pgm; pgm = pgm->next) {
+				rumr_buffer_add_uint32(outbuf, pgm->vmid);
+				rumr_buffer_add_uint32(outbuf, pgm->size);
+				rumr_buffer_add_uint32(outbuf, pgm->type);
+				add_uint64(outbuf, pgm->addr);
+				add_uint64(outbuf, pgm->src.ib_base);
+				add_uint64(outbuf, pgm->src.ib_offset);
+			}
+		}
+		if (ps->ib) {
+			add_uint64(outbuf, ps->ib_source.addr);
+			rumr_buffer_add_uint32(outbuf, ps->ib_source.vmid);
+			add_pm4_stream(outbuf, ps->ib);
+		}
+	}
+	if (!outbuf->failed)
+		memcpy(&outbuf->data[countoff], &count, 4);
+}
+
+// decode a PM4 ring here where following the IBs doesn't take a round
+// trip for each of them and send the packets back
+static int handle_op_ring_decode(struct rumr_server_state *state, struct rumr_buffer *inbuf, struct rumr_buffer *outbuf)
+{
+	struct umr_asic *asic = state->asic;
+	const struct umr_packet_filter *prev_filter;
+	struct umr_packet_filter filter;
+	struct umr_packet_stream *str;
+	char ringname[128];
+	int start, stop, no_follow_ib, no_follow_chained_ib, no_follow_shader;
+	uint32_t flags, n;
+
+	rumr_buffer_read_data(inbuf, ringname, sizeof ringname);
+	ringname[sizeof(ringname) - 1] = 0;
+	start = (int)rumr_buffer_read_uint32(inbuf);
+	stop = (int)rumr_buffer_read_uint32(inbuf);
+	flags = rumr_buffer_read_uint32(inbuf);
+	if (flags & RUMR_RING_DECODE_FILTER) {
+		umr_packet_filter_init(&filter);
+		filter.flags = rumr_buffer_read_uint32(inbuf);
+		for (n = 0; n < 8; n++)
+			filter.opcodes[n] = rumr_buffer_read_uint32(inbuf);
+		filter.reg_lo = rumr_buffer_read_uint32(inbuf);
+		filter.reg_hi = rumr_buffer_read_uint32(inbuf);
+		filter.va_lo = rumr_buffer_read_uint32(inbuf);
+		filter.va_lo |= (uint64_t)rumr_buffer_read_uint32(inbuf) << 32;
+		filter.va_hi = rumr_buffer_read_uint32(inbuf);
+		filter.va_hi |= (uint64_t)rumr_buffer_read_uint32(inbuf) << 32;
+		filter.vmid = rumr_buffer_read_uint32(inbuf);
+	}
+
+	// decode with the client's options, not the server's
+	no_follow_ib = asic->options.no_follow_ib;
+	no_follow_chained_ib = asic->options.no_follow_chained_ib;
+	no_follow_shader = asic->options.no_follow_shader;
+	prev_filter = asic->packet_filter;
+	asic->options.no_follow_ib = (flags & RUMR_RING_DECODE_NO_FOLLOW_IB) ? 1 : 0;
+	asic->options.no_follow_chained_ib = (flags & RUMR_RING_DECODE_NO_FOLLOW_CHAINED_IB) ? 1 : 0;
+	asic->options.no_follow_shader = (flags & RUMR_RING_DECODE_NO_FOLLOW_SHADER) ? 1 : 0;
+	asic->packet_filter = (flags & RUMR_RING_DECODE_FILTER) ? &filter : NULL;
+	str = umr_packet_decode_ring(asic, NULL, ringname, 0, &start, &stop, UMR_RING_PM4, NULL);
+	asic->options.no_follow_ib = no_follow_ib;
+	asic->options.no_follow_chained_ib = no_follow_chained_ib;
+	asic->options.no_follow_shader = no_follow_shader;
+	asic->packet_filter = prev_filter;
+
+	rumr_buffer_add_uint32(outbuf, 1); // STATUS==1
+	rumr_buffer_add_uint32(outbuf, (uint32_t)start);
+	rumr_buffer_add_uint32(outbuf, (uint32_t)stop);
+	add_pm4_stream(outbuf, str ? str->stream.pm4 : NULL);
+	umr_packet_free(str);
+	return 0;
+}
+
 static int handle_op_user_queue_parse(struct rumr_server_state *state, struct rumr_buffer *inbuf, struct rumr_buffer *outbuf)
 {
 	int ret;
@@ -360,6 +648,136 @@ static int handle_op_user_queue_parse(struct rumr_server_state *state, struct ru
 	return 0;
 }
 
+// agree on the compression codecs to use from now on and send the
+// serialized asic, without its IP blocks if the client has them cached
+static int handle_op_discover(struct rumr_server_state *state, struct rumr_buffer *inbuf, struct rumr_buffer *outbuf)
+{
+	uint32_t count, cached = 0;
+	uint64_t hash;
+
+	state->codecs = rumr_buffer_read_uint32(inbuf) & rumr_codecs_supported();
+	count = rumr_buffer_read_uint32(inbuf);
+	if (count > RUMR_DISCOVER_MAX_HASHES) {
+		state->log_msg("[ERROR]: Too many cached asic hashes (%" PRIu32 ")\n", count);
+		return -1;
+	}
+	while (count--) {
+		hash = rumr_buffer_read_uint32(inbuf);
+		hash |= (uint64_t)rumr_buffer_read_uint32(inbuf) << 32;
+		if (hash && hash == state->serialized_hash)
+			cached = 1;
+	}
+
+	rumr_buffer_add_uint32(outbuf, rumr_codecs_supported());
+	rumr_buffer_add_uint32(outbuf, state->serialized_hash & 0xFFFFFFFFULL);
+	rumr_buffer_add_uint32(outbuf, state->serialized_hash >> 32);
+	rumr_buffer_add_uint32(outbuf, cached);
+	if (cached)
+		rumr_buffer_add_data(outbuf, state->serialized_asic->data, state->serialized_head);
+	else
+		rumr_buffer_add_buffer(outbuf, state->serialized_asic);
+	return 0;
+}
+
+// return the counters of every opcode handled since the server started
+// followed by the syscall counters of the server's asic
+static int handle_op_stats(struct rumr_server_state *state, struct rumr_buffer *inbuf, struct rumr_buffer *outbuf)
+{
+	struct rumr_op_summary sum[RUMR_STATS_OPS];
+	struct umr_io_stats io;
+	uint64_t *w;
+	unsigned i, j;
+
+	(void)inbuf;
+	rumr_stats_summarize(state->stats, sum);
+	rumr_buffer_add_uint32(outbuf, 1); // STATUS==1
+	rumr_buffer_add_uint32(outbuf, RUMR_STATS_OPS);
+	for (i = 0; i < RUMR_STATS_OPS; i++) {
+		w = &sum[i].count;
+		for (j = 0; j < sizeof sum[i] / 8; j++) {
+			rumr_buffer_add_uint32(outbuf, w[j] & 0xFFFFFFFFULL);
+			rumr_buffer_add_uint32(outbuf, w[j] >> 32);
+		}
+	}
+
+	memset(&io, 0, sizeof io);
+	if (state->asic)
+		umr_io_stats_get(state->asic, &io);
+	rumr_buffer_add_uint32(outbuf, UMR_IO_MAX);
+	for (i = 0; i < UMR_IO_MAX; i++) {
+		w = &io.cls[i].reads;
+		for (j = 0; j < sizeof io.cls[i] / 8; j++) {
+			rumr_buffer_add_uint32(outbuf, w[j] & 0xFFFFFFFFULL);
+			rumr_buffer_add_uint32(outbuf, w[j] >> 32);
+		}
+	}
+	return 0;
+}
+
+// handle a vector of register/memory/wave/GPR sub-ops with one reply,
+// each sub-op is handed a view of its own packet so the handlers above
+// see exactly what a single opcode would have carried
+static int handle_op_batch(struct rumr_server_state *state, struct rumr_buffer *inbuf, struct rumr_buffer *outbuf)
+{
+	struct rumr_buffer sub;
+	uint32_t count, opcode, len, lenoff;
+	int r;
+
+	count = rumr_buffer_read_uint32(inbuf);
+	if (count > RUMR_BATCH_MAX) {
+		state->log_msg("[ERROR]: Too many sub-ops in batch (%" PRIu32 ")\n", count);
+		return -1;
+	}
+
+	rumr_buffer_add_uint32(outbuf, 1); // STATUS==1
+	rumr_buffer_add_uint32(outbuf, count);
+	while (count--) {
+		opcode = rumr_buffer_read_uint32(inbuf);
+		len = rumr_buffer_read_uint32(inbuf);
+		if (len > (inbuf->woffset - inbuf->roffset) / 4) {
+			state->log_msg("[ERROR]: Batch sub-op runs past the end of the packet\n");
+			return -1;
+		}
+
+		memset(&sub, 0, sizeof sub);
+		sub.data = &inbuf->data[inbuf->roffset];
+		sub.size = sub.woffset = len * 4;
+		inbuf->roffset += len * 4;
+
+		// reply size is patched in once the handler is done
+		lenoff = outbuf->woffset;
+		rumr_buffer_add_uint32(outbuf, 0);
+		switch (opcode) {
+			case RUMR_OP_REG_ACCESS:
+				r = handle_op_reg_access(state, &sub, outbuf);
+				break;
+			case RUMR_OP_MEM_ACCESS:
+				r = handle_op_mem_access(state, &sub, outbuf);
+				break;
+			case RUMR_OP_WAVE_ACCESS:
+				r = handle_op_wave_access(state, &sub, outbuf);
+				break;
+			case RUMR_OP_GPR_ACCESS:
+				r = handle_op_gpr_access(state, &sub, outbuf);
+				break;
+			default:
+				state->log_msg("[ERROR]: Invalid batch sub-op (0x%" PRIx32 ")\n", opcode);
+				r = -1;
+				break;
+		}
+		if (outbuf->failed)
+			return -1;
+		if (r) {
+			// a failed sub-op has an empty reply
+			outbuf->woffset = lenoff + 4;
+			continue;
+		}
+		len = outbuf->woffset - (lenoff + 4);
+		memcpy(&outbuf->data[lenoff], &len, 4);
+	}
+	return 0;
+}
+
 /** rumr_server_loop: Handles one command from client
  * state: The server state
  *
@@ -368,14 +786,27 @@ static int handle_op_user_queue_parse(struct rumr_server_state *state, struct ru
 int rumr_server_loop(struct rumr_server_state *state)
 {
 	struct rumr_buffer *rbuf, *outbuf;
-	uint32_t header;
+	uint32_t header, bytes_rx, bytes_tx;
+	uint64_t start;
 	int r;
 
-	// receive client packet
-	if (state->comm.rx(&state->comm, &rbuf)) {
+	// receive client packet (comms woken for nothing return 1)
+	r = state->comm.rx(&state->comm, &rbuf);
+	if (r > 0)
+		return 0;
+	if (r) {
 		state->log_msg("[ERROR]: Could not receive client packet\n");
 		return -1;
 	}
+	start = rumr_stats_now();
+	bytes_rx = rbuf->woffset;
+
+	// expand compressed packets
+		if (rumr_buffer_decompress(rbuf)) {
+			state->log_msg("[ERROR]: Could not decompress client packet\n");
+			rumr_buffer_free(rbuf);
+			return -1;
+		}
 
 	// read header
 		header = rumr_buffer_read_uint32(rbuf);
@@ -401,9 +832,14 @@ int rumr_server_loop(struct rumr_server_state *state)
 		outbuf->woffset = 4; // skip over packet header
 
 		r = 0;
+		rumr_server_lock(state);
+
+		// the page tables may have changed since the last request
+		if (state->asic)
+			umr_vm_tlb_flush(state->asic);
 		switch ((header >> 10) & 0xFF) {
 			case RUMR_OP_DISCOVER:
-				rumr_buffer_add_buffer(outbuf, state->serialized_asic);
+				r = handle_op_discover(state, rbuf, outbuf);
 				break;
 			case RUMR_OP_REG_ACCESS:
 				r = handle_op_reg_access(state, rbuf, outbuf);
@@ -423,16 +859,34 @@ int rumr_server_loop(struct rumr_server_state *state)
 			case RUMR_OP_USER_QUEUE_PARSE:
 				r = handle_op_user_queue_parse(state, rbuf, outbuf);
 				break;
+			case RUMR_OP_BATCH:
+				r = handle_op_batch(state, rbuf, outbuf);
+				break;
+			case RUMR_OP_WAVE_SCAN:
+				r = handle_op_wave_scan(state, rbuf, outbuf);
+				break;
+			case RUMR_OP_VM_ACCESS:
+				r = handle_op_vm_access(state, rbuf, outbuf);
+				break;
+			case RUMR_OP_STATS:
+				r = handle_op_stats(state, rbuf, outbuf);
+				break;
+			case RUMR_OP_RING_DECODE:
+				r = handle_op_ring_decode(state, rbuf, outbuf);
+				break;
 			case RUMR_OP_GOODBYE:
+				rumr_server_unlock(state);
 				state->comm.closeconn(&state->comm);
 				rumr_buffer_free(rbuf);
 				rumr_buffer_free(outbuf);
 				return 1;
 			default:
+				rumr_server_unlock(state);
 				state->log_msg("[ERROR]: Invalid packet upcode (0x%" PRIx32 ")\n", (header >> 10) & 0xFF);
 				r = -1;
 				goto error;
 		}
+		rumr_server_unlock(state);
 
 		if (r) {
 			goto error;
@@ -450,10 +904,20 @@ int rumr_server_loop(struct rumr_server_state *state)
 		header |= 1; // set SERVER flag
 		memcpy(&outbuf->data[0], &header, 4);
 
+	// compress large replies (memory, rings, ...)
+		if (rumr_buffer_compress(outbuf, state->codecs)) {
+			state->log_msg("[ERROR]: Out of memory\n");
+			r = -1;
+			goto error;
+		}
+
 	// transmit
+		bytes_tx = outbuf->woffset;
 		r = state->comm.tx(&state->comm, outbuf);
 		if (r) {
 			state->log_msg("[ERROR]: Could not send response buffer to client\n");
+		} else {
+			rumr_stats_add(state->stats, (header >> 10) & 0xFF, rumr_stats_now() - start, bytes_tx, bytes_rx);
 		}
 
 	// free
@@ -464,11 +928,279 @@ error:
 	return r;
 }
 
+/*
+ * Serving several clients at once.  rumr_server_run() waits on the bound
+ * channel and every client with epoll, a client with a request pending
+ * is handed to one of RUMR_SERVER_WORKERS threads which serves that one
+ * request and re-arms the client (EPOLLONESHOT so a client is only ever
+ * served by one worker).  Each client has its own copy of the server
+ * state and its own register access context, so bank selections and
+ * compression codecs are per client, while the accesses themselves are
+ * serialized per asic with a FIFO lock.  Memory reads give up the lock
+ * every RUMR_SERVER_CHUNK bytes so a long read from one client doesn't
+ * stall register reads from another.
+ */
+
+// FIFO (ticket) lock per asic, they live as long as the process
+struct asic_lock {
+	void *asic;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	unsigned long next_ticket, serving;
+	struct asic_lock *next;
+};
+
+static pthread_mutex_t asic_locks_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct asic_lock *asic_locks;
+
+struct rumr_server_conn {
+	struct rumr_server_state state;
+	struct umr_access_ctx *ctx;
+	struct asic_lock *lock;
+	struct rumr_server_conn *next; // in the queue of clients with a request
+};
+
+struct server_run {
+	int epfd, stop;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	struct rumr_server_conn *head, *tail;
+};
+
+static struct asic_lock *asic_lock_get(void *asic)
+{
+	struct asic_lock *l;
+
+	pthread_mutex_lock(&asic_locks_mutex);
+	for (l = asic_locks; l && l->asic != asic; l = l->next);
+	if (!l) {
+		l = calloc(1, sizeof *l);
+		if (l) {
+			l->asic = asic;
+			pthread_mutex_init(&l->mutex, NULL);
+			pthread_cond_init(&l->cond, NULL);
+			l->next = asic_locks;
+			asic_locks = l;
+		}
+	}
+	pthread_mutex_unlock(&asic_locks_mutex);
+	return l;
+}
+
+/** rumr_server_lock: Take the lock of the asic a client accesses
+ * state: The (per client) server state
+ *
+ * Only clients of rumr_server_run() are locked, other states are served
+ * one at a time anyways.  Handlers given to rumr_server_run() must hold
+ * the lock while accessing the hardware.
+ */
+void rumr_server_lock(struct rumr_server_state *state)
+{
+	struct asic_lock *l = state->conn ? state->conn->lock : NULL;
+	unsigned long ticket;
+
+	if (!l)
+		return;
+	pthread_mutex_lock(&l->mutex);
+	ticket = l->next_ticket++;
+	while (l->serving != ticket)
+		pthread_cond_wait(&l->cond, &l->mutex);
+	pthread_mutex_unlock(&l->mutex);
+}
+
+/** rumr_server_unlock: Release the lock taken by rumr_server_lock()
+ * state: The (per client) server state
+ */
+void rumr_server_unlock(struct rumr_server_state *state)
+{
+	struct asic_lock *l = state->conn ? state->conn->lock : NULL;
+
+	if (!l)
+		return;
+	pthread_mutex_lock(&l->mutex);
+	++l->serving;
+	pthread_cond_broadcast(&l->cond);
+	pthread_mutex_unlock(&l->mutex);
+}
+
+static void conn_free(struct rumr_server_conn *conn)
+{
+	conn->state.comm.close(&conn->state.comm);
+	umr_access_ctx_free(conn->ctx);
+	free(conn);
+}
+
+static void *server_worker(void *arg)
+{
+	struct server_run *run = arg;
+	struct rumr_server_conn *conn;
+	struct epoll_event ev;
+	int r, burst;
+
+	for (;;) {
+		pthread_mutex_lock(&run->mutex);
+		while (!run->head && !run->stop)
+			pthread_cond_wait(&run->cond, &run->mutex);
+		conn = run->head;
+		if (conn) {
+			run->head = conn->next;
+			if (!run->head)
+				run->tail = NULL;
+		}
+		pthread_mutex_unlock(&run->mutex);
+		if (!conn)
+			return NULL;
+
+		// keep serving a client whose next request is already
+		// coming (see comm.status()) without a trip through epoll
+		if (conn->ctx)
+			umr_affinity_apply(conn->ctx->asic);
+		umr_access_ctx_bind(conn->ctx);
+		burst = 0;
+		do {
+			if (conn->state.handle)
+				r = conn->state.handle(&conn->state);
+			else
+				r = rumr_server_loop(&conn->state);
+		} while (!r && ++burst < RUMR_SERVER_BURST && conn->state.comm.status(&conn->state.comm) > 0);
+		umr_access_ctx_bind(NULL);
+
+		ev.events = EPOLLIN | EPOLLONESHOT;
+		ev.data.ptr = conn;
+		if (r || epoll_ctl(run->epfd, EPOLL_CTL_MOD, conn->state.comm.get_fd(&conn->state.comm), &ev)) {
+			epoll_ctl(run->epfd, EPOLL_CTL_DEL, conn->state.comm.get_fd(&conn->state.comm), NULL);
+			conn_free(conn);
+		}
+	}
+}
+
+// accept a client and start waiting on its requests
+static void server_accept_conn(struct rumr_server_state *state, struct server_run *run)
+{
+	struct rumr_server_conn *conn;
+	struct epoll_event ev;
+
+	conn = calloc(1, sizeof *conn);
+	if (!conn) {
+		state->log_msg("[ERROR]: Out of memory\n");
+		return;
+	}
+	conn->state = *state;
+	conn->state.codecs = 0; // until the client says what it supports in RUMR_OP_DISCOVER
+	conn->state.conn = conn;
+	if (state->comm.accept_conn(&state->comm, &conn->state.comm)) {
+		state->log_msg("[ERROR]: Could not accept client\n");
+		free(conn);
+		return;
+	}
+
+	conn->lock = asic_lock_get(state->asic);
+	if (state->asic)
+		conn->ctx = umr_access_ctx_create(state->asic);
+	ev.events = EPOLLIN | EPOLLONESHOT;
+	ev.data.ptr = conn;
+	if (!conn->lock || (state->asic && !conn->ctx) ||
+	    epoll_ctl(run->epfd, EPOLL_CTL_ADD, conn->state.comm.get_fd(&conn->state.comm), &ev)) {
+		state->log_msg("[ERROR]: Could not set up client\n");
+		conn_free(conn);
+	}
+}
+
+/** rumr_server_run: Serve any number of clients at once
+ * state: The server state, after rumr_server_bind()
+ *
+ * Each request is handled by state->handle if set (which should use
+ * rumr_server_lock() around hardware accesses) or rumr_server_loop()
+ * otherwise.  state->asic may be NULL if the handler picks its own
+ * devices, the requests of all clients are then serialized.  The comms
+ * must implement accept_conn() and get_fd().
+ *
+ * Only returns on error (-1).
+ */
+int rumr_server_run(struct rumr_server_state *state)
+{
+	struct server_run run;
+	struct epoll_event ev[16];
+	pthread_t workers[RUMR_SERVER_WORKERS];
+	int n, x, no_workers;
+
+	if (!state->comm.accept_conn || !state->comm.get_fd) {
+		state->log_msg("[ERROR]: Comms cannot serve several clients\n");
+		return -1;
+	}
+
+	memset(&run, 0, sizeof run);
+	pthread_mutex_init(&run.mutex, NULL);
+	pthread_cond_init(&run.cond, NULL);
+	run.epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (run.epfd < 0) {
+		state->log_msg("[ERROR]: Could not create epoll instance\n");
+		return -1;
+	}
+	ev[0].events = EPOLLIN;
+	ev[0].data.ptr = NULL; // the bound channel
+	if (epoll_ctl(run.epfd, EPOLL_CTL_ADD, state->comm.get_fd(&state->comm), &ev[0])) {
+		state->log_msg("[ERROR]: Could not wait on server\n");
+		close(run.epfd);
+		return -1;
+	}
+
+	for (no_workers = 0; no_workers < RUMR_SERVER_WORKERS; no_workers++)
+		if (pthread_create(&workers[no_workers], NULL, server_worker, &run))
+			break;
+	if (!no_workers) {
+		state->log_msg("[ERROR]: Could not start server threads\n");
+		close(run.epfd);
+		return -1;
+	}
+
+	for (;;) {
+		n = epoll_wait(run.epfd, ev, sizeof(ev) / sizeof(ev[0]), -1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			state->log_msg("[ERROR]: Waiting on clients failed\n");
+			break;
+		}
+		for (x = 0; x < n; x++) {
+			struct rumr_server_conn *conn = ev[x].data.ptr;
+
+			if (!conn) {
+				server_accept_conn(state, &run);
+				continue;
+			}
+			pthread_mutex_lock(&run.mutex);
+			conn->next = NULL;
+			if (run.tail)
+				run.tail->next = conn;
+			else
+				run.head = conn;
+			run.tail = conn;
+			pthread_cond_signal(&run.cond);
+			pthread_mutex_unlock(&run.mutex);
+		}
+	}
+
+	// workers finish the requests already queued then stop, clients
+	// still waiting for their next request are not tracked and are
+	// dropped when the process exits
+	pthread_mutex_lock(&run.mutex);
+	run.stop = 1;
+	pthread_cond_broadcast(&run.cond);
+	pthread_mutex_unlock(&run.mutex);
+	for (x = 0; x < no_workers; x++)
+		pthread_join(workers[x], NULL);
+	close(run.epfd);
+	return -1;
+}
+
 /** rumr_server_close: Close down the server
  * state: The server state to close
  */
 void rumr_server_close(struct rumr_server_state *state)
 {
 	rumr_buffer_free(state->serialized_asic);
+	free(state->stats);
 	state->comm.close(&state->comm);
+	rumr_buffer_pool_flush();
 }
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+#include <time.h>
+
+/*
+ * Adaptive sampling rate.  A sampler reports how active the last sample
+ * (or window of samples) was, from 0 (nothing changed) to 1, and gets
+ * the step to wait before the next one.  Activity, or a spread of recent
+ * activity, shortens the step right away; every idle report lengthens it
+ * by a quarter, so an idle GPU is sampled at max_ns and a burst at min_ns
+ * within a few samples.
+ *
+ * With a CPU budget the CPU time of the calling thread is measured
+ * between reports and the step is stretched so the thread stays within
+ * that share of one CPU whatever the activity.
+ *
+ * The step is only what the sampler aims for, samplers weight what they
+ * read by the time that actually passed between samples (see last_ns).
+ */
+
+#define SAMPLE_RATE_IDLE	0.02	// activity below this counts as idle
+#define SAMPLE_RATE_SPREAD	0.1	// as does a standard deviation below this
+
+static uint64_t clock_ns(clockid_t id)
+{
+	struct timespec ts;
+
+	clock_gettime(id, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * umr_sample_rate_init - Set up an adaptive sampling rate
+ *
+ * @sr: The controller
+ * @min_ns: Shortest step, used while the GPU is busy
+ * @max_ns: Longest step, used while it is idle
+ * @cpu_budget: Percent of one CPU the sampling thread may use, 0 for no limit
+ *
+ * The first step is @min_ns.
+ */
+void umr_sample_rate_init(struct umr_sample_rate *sr, uint64_t min_ns, uint64_t max_ns, unsigned cpu_budget)
+{
+	memset(sr, 0, sizeof *sr);
+	sr->min_ns = min_ns ? min_ns : 1;
+	sr->max_ns = max_ns > sr->min_ns ? max_ns : sr->min_ns;
+	sr->cpu_budget = cpu_budget;
+	sr->step_ns = sr->min_ns;
+}
+
+/**
+ * umr_sample_rate_update - Report a sample and get the next step
+ *
+ * @sr: The controller
+ * @activity: How much changed since the previous report, 0 to 1
+ *
+ * Must be called from the sampling thread (for its CPU time).  Sets
+ * sr->last_ns to the time of the report on CLOCK_MONOTONIC.
+ *
+ * Returns the time to wait before the next sample in nanoseconds.
+ */
+uint64_t umr_sample_rate_update(struct umr_sample_rate *sr, double activity)
+{
+	uint64_t now, cpu;
+	double d, step;
+
+	if (activity < 0.0)
+		activity = 0.0;
+	if (activity > 1.0)
+		activity = 1.0;
+
+	// exponentially weighted mean and variance of the activity
+	d = activity - sr->mean;
+	sr->mean += 0.25 * d;
+	sr->var = 0.75 * (sr->var + 0.25 * d * d);
+
+	// shrink by up to 4x, by the recent mean if this sample was quiet
+	step = sr->step_ns;
+	if (activity > SAMPLE_RATE_IDLE || sr->var > SAMPLE_RATE_SPREAD * SAMPLE_RATE_SPREAD)
+		step /= 1.0 + 3.0 * (activity > sr->mean ? activity : sr->mean);
+	else
+		step *= 1.25;
+
+	now = clock_ns(CLOCK_MONOTONIC);
+	if (sr->cpu_budget) {
+		cpu = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+		if (sr->last_ns && now > sr->last_ns) {
+			d = (double)(cpu - sr->last_cpu_ns) / (now - sr->last_ns);
+			sr->cpu_share = sr->cpu_share ? 0.5 * (sr->cpu_share + d) : d;
+			d = sr->step_ns * sr->cpu_share * 100.0 / sr->cpu_budget;
+			if (d > step)
+				step = d;
+		}
+		sr->last_cpu_ns = cpu;
+	}
+	sr->last_ns = now;
+
+	if (step < sr->min_ns)
+		step = sr->min_ns;
+	if (step > sr->max_ns)
+		step = sr->max_ns;
+	sr->step_ns = step;
+	return sr->step_ns;
+}
@@ -24,6 +24,8 @@
  */
 #include "umr.h"
 #include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 /**
  * parse_rev0 - Parse initial form of config data
@@ -98,40 +100,99 @@ static void parse_rev5(struct umr_asic *asic, uint32_t *data, int *r)
 	asic->config.gfx.cg_flags |= ((uint64_t)data[(*r)++]) << 32;
 }
 
-static uint64_t read_int(char *pci_name, char *fname)
+/*
+ * The config files are opened relative to directory descriptors of the
+ * device that are kept open until the asic is freed and read with one
+ * pread() each, they are small and (sysfs) generated whole.
+ */
+// amdgpu_firmware_info is a few KB
+#define FW_INFO_SIZE 16384
+
+struct umr_config_dirs {
+	int pci,  // /sys/bus/pci/devices/<pci name>
+	    dri;  // /sys/kernel/debug/dri/<instance>
+};
+
+static int config_dir(struct umr_asic *asic, int dri)
 {
-	char buf[256];
-	FILE *f;
-	uint64_t n;
+	char path[256];
+	int *fd;
 
-	snprintf(buf, sizeof(buf)-1, "/sys/bus/pci/devices/%s/%s", pci_name, fname);
-	f = fopen(buf, "r");
-	if (f) {
-		if (fscanf(f, "%"SCNu64"\n", &n) == 1) {
-			fclose(f);
-			return n;
-		}
-		fclose(f);
+	if (!asic->config_dirs) {
+		asic->config_dirs = calloc(1, sizeof *asic->config_dirs);
+		if (!asic->config_dirs)
+			return -1;
+		asic->config_dirs->pci = asic->config_dirs->dri = -2;
 	}
-	return 0;
+	fd = dri ? &asic->config_dirs->dri : &asic->config_dirs->pci;
+	if (*fd == -2) {
+		if (dri)
+			snprintf(path, sizeof(path)-1, "/sys/kernel/debug/dri/%d", asic->instance);
+		else
+			snprintf(path, sizeof(path)-1, "/sys/bus/pci/devices/%s", asic->options.pci.name);
+		// -1 (not there) is remembered as well
+		*fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	}
+	return *fd;
 }
 
-static uint64_t read_int_drm(int cardno, char *fname)
+/**
+ * umr_free_config_dirs - Close the directories umr_scan_config() read from
+ */
+void umr_free_config_dirs(struct umr_asic *asic)
 {
-	char buf[256];
-	FILE *f;
+	if (asic->config_dirs) {
+		if (asic->config_dirs->pci >= 0)
+			close(asic->config_dirs->pci);
+		if (asic->config_dirs->dri >= 0)
+			close(asic->config_dirs->dri);
+		free(asic->config_dirs);
+		asic->config_dirs = NULL;
+	}
+}
+
+// read up to size-1 bytes of a file, NUL terminated, returns the length or -1
+static ssize_t read_file_at(int dirfd, const char *fname, char *buf, size_t size)
+{
+	ssize_t r, n = 0;
+	int fd;
+
+	if (dirfd < 0 && dirfd != AT_FDCWD)
+		return -1;
+	fd = openat(dirfd, fname, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+	// debugfs files can come in pieces
+	while ((size_t)n < size - 1 && (r = pread(fd, buf + n, size - 1 - n, n)) > 0)
+		n += r;
+	close(fd);
+	buf[n] = 0;
+	umr_timing_count(UMR_TIMING_SCAN_CONFIG, 1, n);
+	return n;
+}
+
+static uint64_t read_int_at(int dirfd, const char *fname, uint64_t dflt)
+{
+	char buf[32];
 	uint64_t n;
 
+	if (read_file_at(dirfd, fname, buf, sizeof buf) > 0 && sscanf(buf, "%"SCNu64, &n) == 1)
+		return n;
+	return dflt;
+}
+
+static uint64_t read_int(struct umr_asic *asic, const char *fname)
+{
+	return read_int_at(config_dir(asic, 0), fname, 0);
+}
+
+// a file of another device by DRM card number
+static uint64_t read_int_drm_or(int cardno, const char *fname, uint64_t dflt)
+{
+	char buf[256];
+
 	snprintf(buf, sizeof(buf)-1, "/sys/class/drm/card%d/device/%s", cardno, fname);
-	f = fopen(buf, "r");
-	if (f) {
-		if (fscanf(f, "%"SCNu64"\n", &n) == 1) {
-			fclose(f);
-			return n;
-		}
-		fclose(f);
-	}
-	return 0;
+	return read_int_at(AT_FDCWD, buf, dflt);
 }
 
 /**
@@ -165,22 +226,9 @@ void umr_scan_config_gca_data(struct umr_asic *asic)
 	}
 }
 
-/**
- * @brief Scan the debugfs configuration data for an ASIC.
- *
- * This function reads various configuration details from the debugfs files of a given ASIC,
- * including memory sizes, XGMI information, VBIOS version, firmware information, and GCA (Graphics Core Architecture) configuration data.
- * It populates the provided `asic` structure with this information.
- *
- * @param asic Pointer to the `umr_asic` structure that will be populated with configuration data.
- * @param xgmi_scan Flag indicating whether to scan the XGMI hive database to see if this device fits in.
- *
- * @return Returns 0 on success, or -1 on error.
- */
-int umr_scan_config(struct umr_asic *asic, int xgmi_scan)
+static int scan_config(struct umr_asic *asic, int xgmi_scan, unsigned want)
 {
-	FILE *f;
-	char fname[256];
+	char *fw;
 	int r;
 
 	if (asic->options.no_kernel) {
@@ -229,28 +277,39 @@ int umr_scan_config(struct umr_asic *asic, int xgmi_scan)
 	if (!asic->options.test_log && asic->options.is_virtual)
 		return -1;
 
+	// what an earlier scan of this asic read already
+	want &= ~asic->config.scanned;
+	if (!xgmi_scan)
+		want &= ~UMR_CONFIG_SCAN_XGMI_HIVE;
+
 	// read memory sizes
-	asic->config.gtt_size = read_int(asic->options.pci.name, "mem_info_gtt_total");
-	asic->config.vis_vram_size = read_int(asic->options.pci.name, "mem_info_vis_vram_total");
-	asic->config.vram_size = read_int(asic->options.pci.name, "mem_info_vram_total");
+	if (want & UMR_CONFIG_SCAN_MEM) {
+		asic->config.gtt_size = read_int(asic, "mem_info_gtt_total");
+		asic->config.vis_vram_size = read_int(asic, "mem_info_vis_vram_total");
+		asic->config.vram_size = read_int(asic, "mem_info_vram_total");
+		asic->config.scanned |= UMR_CONFIG_SCAN_MEM;
+	}
 
 	// try to read xgmi info
-	asic->config.xgmi.device_id = read_int_drm(asic->instance, "xgmi_device_id");
-	if (xgmi_scan && asic->config.xgmi.device_id) {
+	if (want & UMR_CONFIG_SCAN_XGMI) {
+		asic->config.xgmi.device_id = read_int(asic, "xgmi_device_id");
+		asic->config.scanned |= UMR_CONFIG_SCAN_XGMI;
+	}
+	if ((want & UMR_CONFIG_SCAN_XGMI_HIVE) && asic->config.xgmi.device_id) {
 		int x, y;
 
-		asic->config.xgmi.hive_id = read_int_drm(asic->instance, "xgmi_hive_info/xgmi_hive_id");
+		asic->config.xgmi.hive_id = read_int(asic, "xgmi_hive_info/xgmi_hive_id");
 		for (x =  0; x < UMR_MAX_XGMI_DEVICES; x++) {
 			char buf[64];
 			snprintf(buf, sizeof(buf)-1, "xgmi_hive_info/node%d/xgmi_device_id", x+1);
-			asic->config.xgmi.nodes[x].node_id = read_int_drm(asic->instance, buf);
+			asic->config.xgmi.nodes[x].node_id = read_int(asic, buf);
 		}
 
 		// now map instances to node ids
 		for (x = 0; asic->config.xgmi.nodes[x].node_id; x++) {
 			for (y = 0; y < UMR_MAX_XGMI_DEVICES; y++) {
 				uint64_t z;
-				z = read_int_drm(y, "xgmi_device_id");
+				z = read_int_drm_or(y, "xgmi_device_id", 0);
 				if (z == asic->config.xgmi.nodes[x].node_id) {
 					asic->config.xgmi.nodes[x].instance = y;
 					break;
@@ -258,84 +317,82 @@ int umr_scan_config(struct umr_asic *asic, int xgmi_scan)
 			}
 		}
 
-		// now load all of the devices other than this one ...
+		// only the topology is read here, the other devices are
+		// discovered the first time they are used (see umr_xgmi_node())
 		for (x = 0; asic->config.xgmi.nodes[x].node_id; x++) {
-			if (asic->instance != asic->config.xgmi.nodes[x].instance) {
-				struct umr_options options;
-				memset(&options, 0, sizeof options);
-				options.instance = asic->config.xgmi.nodes[x].instance;
-				options.verbose = asic->options.verbose;
-				options.use_colour = asic->options.use_colour;
-				asic->config.xgmi.nodes[x].asic = umr_discover_asic(&options, asic->err_msg);
-			} else {
+			// PF_LFB_REGION of the node, -1 if the driver doesn't export it
+			asic->config.xgmi.nodes[x].hive_position =
+				(int)read_int_drm_or(asic->config.xgmi.nodes[x].instance, "xgmi_physical_id", (uint64_t)-1);
+			if (asic->instance == asic->config.xgmi.nodes[x].instance)
 				asic->config.xgmi.nodes[x].asic = asic;
-			}
 		}
 		asic->options.use_xgmi = 1;
+		asic->config.scanned |= UMR_CONFIG_SCAN_XGMI_HIVE;
 	}
+
 	// read vbios version
-	snprintf(fname, sizeof(fname)-1, "/sys/bus/pci/devices/%s/vbios_version", asic->options.pci.name);
-	f = fopen(fname, "r");
-	if (f) {
-		if (fgets(asic->config.vbios_version, sizeof(asic->config.vbios_version)-1, f))
-			asic->config.vbios_version[strlen(asic->config.vbios_version)-1] = 0; // remove newline...
-		fclose(f);
+	if (want & UMR_CONFIG_SCAN_VBIOS) {
+		if (read_file_at(config_dir(asic, 0), "vbios_version", asic->config.vbios_version,
+				 sizeof(asic->config.vbios_version)) > 0)
+			asic->config.vbios_version[strcspn(asic->config.vbios_version, "\n")] = 0;
+		asic->config.scanned |= UMR_CONFIG_SCAN_VBIOS;
 	}
 
 	/* process FW block */
-	snprintf(fname, sizeof(fname)-1, "/sys/kernel/debug/dri/%d/amdgpu_firmware_info", asic->instance);
-	f = fopen(fname, "r");
-	if (!f)
-		goto gca_config;
-	r = 0;
-	memset(&asic->config.fw, 0, sizeof asic->config.fw);
-	while (r < UMR_MAX_FW && fgets(fname, sizeof(fname)-1, f)) {
-		char *p;
-		fname[strlen(fname)-1] = 0;
-		p = strstr(fname, "feature");
-		if (p) {
-			char t1[64];
-			p[-1] = 0;
-			strcpy(asic->config.fw[r].name, fname);
-			if (sscanf(p, "feature version: %[0-9x], firmware version: 0x%" SCNx32 "\n", t1, &asic->config.fw[r].firmware_version) == 2) {
-				if (memcmp(t1, "0x", 2)) {
-					sscanf(t1, "%"SCNu32, &asic->config.fw[r].feature_version);
-				} else {
-					sscanf(t1, "%"SCNx32, &asic->config.fw[r].feature_version);
+	if ((want & UMR_CONFIG_SCAN_FW) && (fw = malloc(FW_INFO_SIZE))) {
+		char *line, *next;
+
+		memset(&asic->config.fw, 0, sizeof asic->config.fw);
+		r = 0;
+		if (read_file_at(config_dir(asic, 1), "amdgpu_firmware_info", fw, FW_INFO_SIZE) > 0) {
+			for (line = fw; r < UMR_MAX_FW && line && *line; line = next) {
+				char *p;
+				next = strchr(line, '\n');
+				if (next)
+					*next++ = 0;
+				p = strstr(line, "feature");
+				if (p && p > line && p - line <= (int)sizeof(asic->config.fw[r].name)) {
+					char t1[64];
+					p[-1] = 0;
+					strcpy(asic->config.fw[r].name, line);
+					if (sscanf(p, "feature version: %63[0-9x], firmware version: 0x%" SCNx32, t1, &asic->config.fw[r].firmware_version) == 2) {
+						if (memcmp(t1, "0x", 2)) {
+							sscanf(t1, "%"SCNu32, &asic->config.fw[r].feature_version);
+						} else {
+							sscanf(t1, "%"SCNx32, &asic->config.fw[r].feature_version);
+						}
+						++r;
+					}
 				}
-				++r;
 			}
 		}
+		free(fw);
+		asic->config.scanned |= UMR_CONFIG_SCAN_FW;
 	}
-	fclose(f);
 
 	/* process GFX block */
-gca_config:
+	if (!(want & UMR_CONFIG_SCAN_GCA))
+		return 0;
 	if (asic->options.test_log && !asic->options.test_log_fd) {
 		// grab from test harness instead of system
 		umr_test_harness_get_config_data(asic, (uint8_t *)asic->config.data);
 	} else {
 		// grab from system
-		snprintf(fname, sizeof(fname)-1, "/sys/kernel/debug/dri/%d/amdgpu_gca_config", asic->instance);
-		f = fopen(fname, "rb");
-		if (!f)
+		int fd = config_dir(asic, 1);
+
+		if (fd < 0 || (fd = openat(fd, "amdgpu_gca_config", O_RDONLY | O_CLOEXEC)) < 0)
 			return -1;
-		r = fread(asic->config.data, 1, sizeof(asic->config.data), f);
-		fclose(f);
+		r = pread(fd, asic->config.data, sizeof(asic->config.data), 0);
+		close(fd);
 		if (r < 0)
 			return -1;
+		umr_timing_count(UMR_TIMING_SCAN_CONFIG, 1, r);
 
 		// store in test vector if open
-		if (asic->options.test_log && asic->options.test_log_fd) {
-			int x;
-			uint8_t *d = (uint8_t *)asic->config.data;
-			fprintf(asic->options.test_log_fd, "GCACONFIG = { ");
-			for (x = 0; x < r; x++) {
-				fprintf(asic->options.test_log_fd, "%02"PRIx8, d[x]);
-			}
-			fprintf(asic->options.test_log_fd, " }\n");
-		}
+		if (asic->options.test_log && asic->options.test_log_fd)
+			umr_test_log_bytes(&asic->options, UMR_TV_GCACONFIG, 0, asic->config.data, r);
 	}
+	asic->config.scanned |= UMR_CONFIG_SCAN_GCA;
 
 	umr_scan_config_gca_data(asic);
 
@@ -354,3 +411,42 @@ gca_config:
 
 	return 0;
 }
+
+/**
+ * @brief Scan the debugfs configuration data for an ASIC.
+ *
+ * This function reads various configuration details from the debugfs files of a given ASIC,
+ * including memory sizes, XGMI information, VBIOS version, firmware information, and GCA (Graphics Core Architecture) configuration data.
+ * It populates the provided `asic` structure with this information.
+ *
+ * The firmware and VBIOS versions are only needed to print them and are not read, see
+ * umr_scan_config_fields().
+ *
+ * @param asic Pointer to the `umr_asic` structure that will be populated with configuration data.
+ * @param xgmi_scan Flag indicating whether to scan the XGMI hive database to see if this device fits in.
+ *
+ * @return Returns 0 on success, or -1 on error.
+ */
+int umr_scan_config(struct umr_asic *asic, int xgmi_scan)
+{
+	return umr_scan_config_fields(asic, xgmi_scan, UMR_CONFIG_SCAN_DEFAULT);
+}
+
+/**
+ * @brief Scan some of the configuration data of an ASIC.
+ *
+ * Like umr_scan_config() but only the groups in @want (UMR_CONFIG_SCAN_*) are read and
+ * groups an earlier scan of @asic read already are skipped, so it is cheap to call before
+ * using e.g. asic->config.fw.
+ *
+ * @return Returns 0 on success, or -1 on error.
+ */
+int umr_scan_config_fields(struct umr_asic *asic, int xgmi_scan, unsigned want)
+{
+	int r;
+
+	umr_timing_begin(UMR_TIMING_SCAN_CONFIG);
+	r = scan_config(asic, xgmi_scan, want);
+	umr_timing_end(UMR_TIMING_SCAN_CONFIG);
+	return r;
+}
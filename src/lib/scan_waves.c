@@ -26,6 +26,7 @@
 
 #include <assert.h>
 #include <stdbool.h>
+#include <sched.h>
 
 #define MANY_TO_INSTANCE(wgp, simd) (((simd) & 3) | ((wgp) << 2))
 
@@ -137,6 +138,20 @@ static const char *gfx12_regs[] = {
 	NULL
 };
 
+// the WAVE STATUS registers in the order the kernel (and the MMIO path)
+// return them for a GFX major version
+static const char **wave_reg_names(int maj)
+{
+	switch (maj) {
+		case 8: return gfx8_regs;
+		case 9: return gfx9_regs;
+		case 10: return gfx10_regs;
+		case 11: return gfx11_regs;
+		case 12: return gfx12_regs;
+	}
+	return NULL;
+}
+
 static void wave_read_regs_via_mmio(struct umr_asic *asic, uint32_t simd,
 			   uint32_t wave, uint32_t thread,
 			   uint32_t regno, uint32_t num, uint32_t *out)
@@ -184,11 +199,13 @@ static int read_gpr_mmio(struct umr_asic *asic, int v_or_s, uint32_t thread, str
 	uint64_t addr = 0;
 
 	if (asic->family < FAMILY_NV) {
-		se = umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID", "SE_ID");
-		sh = umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID", "SH_ID");
-		cu = umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID", "CU_ID");
-		wave = umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID", "WAVE_ID");
-		simd = umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID", "SIMD_ID");
+		se = umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_SE_ID);
+		sh = umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_SH_ID);
+		cu = umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_CU_ID);
+		wave = umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_WAVE_ID);
+		simd = umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_SIMD_ID);
+		if (se == 0xDEADBEEF)
+			return -1;
 
 		if (v_or_s == 0) {
 			uint32_t shift;
@@ -196,20 +213,22 @@ static int read_gpr_mmio(struct umr_asic *asic, int v_or_s, uint32_t thread, str
 				shift = 3;  // on SI..CIK allocations were done in 8-dword blocks
 			else
 				shift = 4;  // on VI allocations are in 16-dword blocks
-			size = 4 * ((umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_GPR_ALLOC", "SGPR_SIZE") + 1) << shift);
+			size = 4 * ((umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_SGPR_SIZE) + 1) << shift);
 		} else {
-			size = 4 * ((umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_GPR_ALLOC", "VGPR_SIZE") + 1) << asic->parameters.vgpr_granularity);
+			size = 4 * ((umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_VGPR_SIZE) + 1) << asic->parameters.vgpr_granularity);
 		}
 	} else {
-		se = umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID1", "SE_ID");
-		sh = umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID1", "SA_ID");
-		cu = ((umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID1", "WGP_ID") << 2) | umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID1", "SIMD_ID"));
-		wave = umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID1", "WAVE_ID");
+		se = umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_SE_ID);
+		sh = umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_SH_ID);
+		cu = (umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_CU_ID) << 2) | umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_SIMD_ID);
+		wave = umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_WAVE_ID);
 		simd = 0;
+		if (se == 0xDEADBEEF)
+			return -1;
 		if (v_or_s == 0) {
 			size = 4 * 124; // regular SGPRs, VCC, and TTMPs
 		} else {
-			size = 4 * ((umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_GPR_ALLOC", "VGPR_SIZE") + 1) << asic->parameters.vgpr_granularity);
+			size = 4 * ((umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_VGPR_SIZE) + 1) << asic->parameters.vgpr_granularity);
 		}
 	}
 
@@ -220,8 +239,6 @@ static int read_gpr_mmio(struct umr_asic *asic, int v_or_s, uint32_t thread, str
 	// if we are reading SGPRS then optionally dump them
 	// and then read TRAP registers if necessary
 	if (asic->options.test_log && asic->options.test_log_fd) {
-		int x;
-
 		// we use addr for test logging
 		addr =
 			((v_or_s ? 0ULL : 1ULL) << 60) | // reading SGPRs
@@ -233,13 +250,7 @@ static int read_gpr_mmio(struct umr_asic *asic, int v_or_s, uint32_t thread, str
 			((uint64_t)simd << 44)      |
 			((uint64_t)thread << 52ULL); // thread_id
 
-		fprintf(asic->options.test_log_fd, "%cGPR@0x%"PRIx64" = { ", "SV"[v_or_s], addr);
-		for (x = 0; x < r; x += 4) {
-			fprintf(asic->options.test_log_fd, "0x%"PRIx32, dst[x/4]);
-			if (x < (r - 4))
-				fprintf(asic->options.test_log_fd, ", ");
-		}
-		fprintf(asic->options.test_log_fd, "}\n");
+		umr_test_log_words(&asic->options, v_or_s ? UMR_TV_VGPR : UMR_TV_SGPR, addr, dst, r / 4, NULL);
 	}
 
 	if (v_or_s == 0 && size < (4*0x6C)) {
@@ -247,16 +258,8 @@ static int read_gpr_mmio(struct umr_asic *asic, int v_or_s, uint32_t thread, str
 		if (umr_wave_data_get_flag_trap_en(asic, wd) || umr_wave_data_get_flag_priv(asic, wd)) {
 			r = read_gpr_mmio_raw(asic, v_or_s, thread, se, sh, cu, wave, simd, 4 * 0x6C, size, &dst[0x6C]);
 			if (r > 0) {
-				if (asic->options.test_log && asic->options.test_log_fd) {
-					int x;
-					fprintf(asic->options.test_log_fd, "SGPR@0x%"PRIx64" = { ", addr + 0x6C * 4);
-					for (x = 0; x < r; x += 4) {
-						fprintf(asic->options.test_log_fd, "0x%"PRIx32, dst[0x6C + x/4]);
-						if (x < (r - 4))
-							fprintf(asic->options.test_log_fd, ", ");
-					}
-					fprintf(asic->options.test_log_fd, "}\n");
-				}
+				if (asic->options.test_log && asic->options.test_log_fd)
+					umr_test_log_words(&asic->options, UMR_TV_SGPR, addr + 0x6C * 4, &dst[0x6C], r / 4, NULL);
 			}
 		}
 	}
@@ -316,6 +319,10 @@ int umr_get_wave_sq_info_vi(struct umr_asic *asic, unsigned se, unsigned sh, uns
 		uint32_t se, sh, instance, use_grbm;
 	} grbm;
 	struct umr_reg *ind_index, *ind_data;
+	struct umr_access_ctx *ctx = umr_access_ctx_current(asic);
+	// a bound access context has its own bank selection
+	int *use_bank = ctx ? &ctx->use_bank : &asic->options.use_bank;
+	union umr_bank_select *bank = ctx ? &ctx->bank : &asic->options.bank;
 
 	ind_index = umr_find_reg_data_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, "mmSQ_IND_INDEX");
 	ind_data  = umr_find_reg_data_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, "mmSQ_IND_DATA");
@@ -327,16 +334,16 @@ int umr_get_wave_sq_info_vi(struct umr_asic *asic, unsigned se, unsigned sh, uns
 		data = ind_data->addr * 4;
 
 		/* copy grbm options to restore later */
-		grbm.use_grbm = asic->options.use_bank;
-		grbm.se       = asic->options.bank.grbm.se;
-		grbm.sh       = asic->options.bank.grbm.sh;
-		grbm.instance = asic->options.bank.grbm.instance;
+		grbm.use_grbm = *use_bank;
+		grbm.se       = bank->grbm.se;
+		grbm.sh       = bank->grbm.sh;
+		grbm.instance = bank->grbm.instance;
 
 		/* set GRBM banking options */
-		asic->options.use_bank           = 1;
-		asic->options.bank.grbm.se       = se;
-		asic->options.bank.grbm.sh       = sh;
-		asic->options.bank.grbm.instance = cu;
+		*use_bank           = 1;
+		bank->grbm.se       = se;
+		bank->grbm.sh       = sh;
+		bank->grbm.instance = cu;
 
 		if (!index || !data) {
 			asic->err_msg("[BUG]: Cannot find SQ indirect registers on this asic!\n");
@@ -347,10 +354,10 @@ int umr_get_wave_sq_info_vi(struct umr_asic *asic, unsigned se, unsigned sh, uns
 		value = asic->reg_funcs.read_reg(asic, data, REG_MMIO);
 
 		/* restore whatever the user had picked */
-		asic->options.use_bank           = grbm.use_grbm;
-		asic->options.bank.grbm.se       = grbm.se;
-		asic->options.bank.grbm.sh       = grbm.sh;
-		asic->options.bank.grbm.instance = grbm.instance;
+		*use_bank           = grbm.use_grbm;
+		bank->grbm.se       = grbm.se;
+		bank->grbm.sh       = grbm.sh;
+		bank->grbm.instance = grbm.instance;
 
 		/* Did we try to query a non-existing SQ instance? */
 		if (value == 0xbebebeef)
@@ -529,6 +536,81 @@ int umr_get_wave_status_via_mmio(struct umr_asic *asic, unsigned se, unsigned sh
 		return -1;
 }
 
+/**
+ * umr_get_wave_status_via_mmio_bulk - Read the WAVE STATUS of several wave slots via direct MMIO access
+ *
+ * @asic: The ASIC to query
+ * @se: The SE to query
+ * @sh: The SH to query
+ * @cu: The CU to query
+ * @simd: The SIMD to query
+ * @no_waves: Waves 0 to no_waves-1 are read
+ * @ws: Array of @no_waves entries to store the WAVE STATUS register values in
+ *
+ * The GRBM bank is selected once for all of the slots and the SQ_IND_INDEX
+ * value of every register is computed up front so each register only costs
+ * one index write and one data read.
+ *
+ * Returns -1 on error.
+ */
+int umr_get_wave_status_via_mmio_bulk(struct umr_asic *asic, unsigned se, unsigned sh, unsigned cu, unsigned simd, unsigned no_waves, struct umr_wave_status *ws)
+{
+	struct umr_reg *ind_index, *ind_data, *reg;
+	struct umr_field_handle f_wave, f_index, f_simd, f_force;
+	const char **names;
+	uint32_t index[64], buf[64], base;
+	uint64_t index_addr, data_addr;
+	unsigned wave, x, no_regs;
+	int maj, min, r = 0;
+
+	umr_gfx_get_ip_ver(asic, &maj, &min);
+	names = wave_reg_names(maj);
+	ind_index = umr_find_reg_data_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, "mmSQ_IND_INDEX");
+	ind_data  = umr_find_reg_data_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, "mmSQ_IND_DATA");
+	if (!names || !ind_index || !ind_data) {
+		asic->err_msg("[BUG]: The required SQ_IND_{INDEX,DATA} registers are not found on the asic <%s>\n", asic->asicname);
+		return -1;
+	}
+
+	if (umr_field_handle_resolve(asic, ind_index, "WAVE_ID", &f_wave) ||
+	    umr_field_handle_resolve(asic, ind_index, "INDEX", &f_index))
+		return -1;
+	base = 0;
+	if (maj <= 9) {
+		if (umr_field_handle_resolve(asic, ind_index, "SIMD_ID", &f_simd) ||
+		    umr_field_handle_resolve(asic, ind_index, "FORCE_READ", &f_force))
+			return -1;
+		base = umr_field_compose(&f_simd, simd) | umr_field_compose(&f_force, 1);
+	}
+
+	for (no_regs = 0; names[no_regs]; no_regs++) {
+		reg = umr_find_reg_data_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, names[no_regs]);
+		if (!reg) {
+			asic->err_msg("[BUG]: Register (%s) not found on the asic <%s>\n", names[no_regs], asic->asicname);
+			return -1;
+		}
+		index[no_regs] = base | umr_field_compose(&f_index, reg->addr);
+	}
+	index_addr = ind_index->addr * 4;
+	data_addr = ind_data->addr * 4;
+
+	umr_grbm_select_index(asic, se, sh, cu);
+	for (wave = 0; wave < no_waves; wave++) {
+		// first word is the wave data type umr_parse_wave_data_gfx() expects
+		buf[0] = maj - 8;
+		for (x = 0; x < no_regs; x++) {
+			asic->reg_funcs.write_reg(asic, index_addr, index[x] | umr_field_compose(&f_wave, wave), REG_MMIO);
+			buf[1 + x] = asic->reg_funcs.read_reg(asic, data_addr, REG_MMIO);
+		}
+		if (umr_parse_wave_data_gfx(asic, &ws[wave], buf, 1 + no_regs)) {
+			r = -1;
+			break;
+		}
+	}
+	umr_grbm_select_index(asic, 0xFFFFFFFFUL, 0xFFFFFFFFUL, 0xFFFFFFFFUL);
+	return r;
+}
+
 /**
  * umr_parse_wave_data_gfx - Parse wave data as returned by the kernel per GFX IP version
  *
@@ -559,6 +641,35 @@ int umr_parse_wave_data_gfx(struct umr_asic *asic, struct umr_wave_status *ws, c
 	return 0;
 }
 
+// finish scanning a wave slot whose WAVE STATUS is already in pwd->ws
+static int scan_wave_slot_status(struct umr_asic *asic, uint32_t se, uint32_t sh, uint32_t cu,
+				 uint32_t simd, uint32_t wave, struct umr_wave_data *pwd)
+{
+	if (!umr_wave_data_get_flag_valid(asic, pwd) &&
+	    (!umr_wave_data_get_flag_halt(asic, pwd) || umr_wave_data_get_value(asic, pwd, "ixSQ_WAVE_STATUS") == 0xbebebeef))
+		return 0;
+
+	pwd->se = se;
+	pwd->sh = sh;
+	pwd->cu = cu;
+	pwd->simd = simd;
+	pwd->wave = wave;
+
+	// the GPRs are read on first use by umr_wave_data_fetch_gprs()
+	pwd->have_vgprs = 0;
+	if (!asic->options.skip_gprs) {
+		if (asic->family <= FAMILY_AI)
+			pwd->num_threads = 64;
+		else
+			pwd->num_threads = umr_wave_data_get_flag_wave64(asic, pwd) ? 64 : 32;
+		pwd->gpr_state = UMR_WAVE_GPRS_LAZY;
+	} else {
+		pwd->gpr_state = UMR_WAVE_GPRS_NONE;
+	}
+
+	return 1;
+}
+
 /**
  * umr_scan_wave_slot - Scan a wave slot for register data
  *
@@ -575,7 +686,6 @@ int umr_parse_wave_data_gfx(struct umr_asic *asic, struct umr_wave_status *ws, c
 int umr_scan_wave_slot(struct umr_asic *asic, uint32_t se, uint32_t sh, uint32_t cu,
 			       uint32_t simd, uint32_t wave, struct umr_wave_data *pwd)
 {
-	unsigned thread, num_threads;
 	int r;
 
 	if (asic->family <= FAMILY_AI)
@@ -586,38 +696,269 @@ int umr_scan_wave_slot(struct umr_asic *asic, uint32_t se, uint32_t sh, uint32_t
 	if (r)
 		return -1;
 
-	if (!umr_wave_data_get_flag_valid(asic, pwd) &&
-	    (!umr_wave_data_get_flag_halt(asic, pwd) || umr_wave_data_get_value(asic, pwd, "ixSQ_WAVE_STATUS") == 0xbebebeef))
-		return 0;
+	return scan_wave_slot_status(asic, se, sh, cu, simd, wave, pwd);
+}
 
-	pwd->se = se;
-	pwd->sh = sh;
-	pwd->cu = cu;
-	pwd->simd = simd;
-	pwd->wave = wave;
+// scan results are carved out of chunks of records, the first chunk
+// holds this many and every further one twice as many up to the max
+#define WAVE_ARENA_MIN 16
+#define WAVE_ARENA_MAX 1024
 
-	if (!asic->options.skip_gprs) {
-		asic->gpr_read_funcs.read_sgprs(asic, pwd, &pwd->sgprs[0]);
+struct wave_prefetch;
 
-		if (asic->family <= FAMILY_AI)
-			num_threads = 64;
+struct umr_wave_arena {
+	struct umr_wave_arena *next;
+	unsigned used, size;
+	struct wave_prefetch *prefetch; // only on the first chunk
+	struct umr_wave_data wd[];
+};
+
+// background reader started by umr_wave_data_prefetch_gprs()
+struct wave_prefetch {
+	struct umr_asic *asic;
+	struct umr_access_ctx *ctx;
+	struct umr_wave_data *head;
+	pthread_t thread;
+	int stop;
+};
+
+// waves found by a scan, slot is the record the next wave slot is read into
+struct umr_wave_list {
+	struct umr_wave_arena *chunks, *chunk;
+	struct umr_wave_data *head, *tail, *slot;
+	const char **reg_names;
+	int count, max; // waves kept, max 0 for no limit
+};
+
+static struct umr_wave_data *wave_list_slot(struct umr_asic *asic, struct umr_wave_list *wl)
+{
+	struct umr_wave_arena *chunk;
+	unsigned size;
+
+	if (wl->slot)
+		return wl->slot;
+
+	if (!wl->chunk || wl->chunk->used == wl->chunk->size) {
+		size = wl->chunk ? wl->chunk->size * 2 : WAVE_ARENA_MIN;
+		if (size > WAVE_ARENA_MAX)
+			size = WAVE_ARENA_MAX;
+		chunk = calloc(1, sizeof *chunk + size * sizeof chunk->wd[0]);
+		if (!chunk) {
+			asic->err_msg("[ERROR]: Out of memory\n");
+			return NULL;
+		}
+		chunk->size = size;
+		if (wl->chunk)
+			wl->chunk->next = chunk;
 		else
-			num_threads = umr_wave_data_get_flag_wave64(asic, pwd) ? 64 : 32;
-
-		pwd->have_vgprs = 1;
-		pwd->num_threads = num_threads;
-		for (thread = 0; thread < num_threads; ++thread) {
-			if (asic->gpr_read_funcs.read_vgprs(asic, pwd, thread,
-					   &pwd->vgprs[256 * thread]) < 0) {
-				pwd->have_vgprs = 0;
-				break;
-			}
+			wl->chunks = chunk;
+		wl->chunk = chunk;
+	}
+	wl->slot = &wl->chunk->wd[wl->chunk->used];
+	wl->slot->reg_names = wl->reg_names;
+	return wl->slot;
+}
+
+// keep the wave just read into the slot
+static void wave_list_commit(struct umr_wave_list *wl)
+{
+	++wl->chunk->used;
+	if (wl->tail)
+		wl->tail->next = wl->slot;
+	else
+		wl->head = wl->slot;
+	wl->tail = wl->slot;
+	wl->slot = NULL;
+	++wl->count;
+}
+
+static int wave_list_full(const struct umr_wave_list *wl)
+{
+	return wl->max && wl->count >= wl->max;
+}
+
+/**
+ * umr_wave_list_append - Add a wave to the list of a scan
+ *
+ * @asic: The ASIC being scanned
+ * @wl: The list handed to the scan_wave_data callback
+ *
+ * For wave_funcs.scan_wave_data() implementations.  The wave returned
+ * is zeroed apart from its register names and is kept in the list, the
+ * caller fills it in.
+ *
+ * Returns NULL if out of memory.
+ */
+struct umr_wave_data *umr_wave_list_append(struct umr_asic *asic, struct umr_wave_list *wl)
+{
+	struct umr_wave_data *wd = wave_list_slot(asic, wl);
+
+	if (!wd)
+		return NULL;
+	memset(wd, 0, sizeof *wd);
+	wd->reg_names = wl->reg_names;
+	wave_list_commit(wl);
+	return wd;
+}
+
+static void wave_arena_free(struct umr_wave_arena *chunk)
+{
+	struct umr_wave_arena *next;
+
+	if (chunk && chunk->prefetch) {
+		__atomic_store_n(&chunk->prefetch->stop, 1, __ATOMIC_RELAXED);
+		pthread_join(chunk->prefetch->thread, NULL);
+		umr_access_ctx_free(chunk->prefetch->ctx);
+		free(chunk->prefetch);
+	}
+	while (chunk) {
+		next = chunk->next;
+		free(chunk);
+		chunk = next;
+	}
+}
+
+// hand the waves of @wl out as a list, the arena is owned by the head
+static struct umr_wave_data *wave_list_finish(struct umr_wave_list *wl)
+{
+	if (!wl->head) {
+		wave_arena_free(wl->chunks);
+		return NULL;
+	}
+	wl->head->arena = wl->chunks;
+	return wl->head;
+}
+
+/**
+ * umr_free_wave_data - Free the waves returned by umr_scan_wave_data()
+ *
+ * @wd: The head of the list
+ *
+ * The whole list is released with the chunks it was allocated from,
+ * lists built by hand with one allocation per wave are freed wave
+ * by wave.  A GPR prefetch still running on the list is stopped first.
+ */
+void umr_free_wave_data(struct umr_wave_data *wd)
+{
+	struct umr_wave_data *next;
+
+	if (wd && wd->arena) {
+		wave_arena_free(wd->arena);
+		return;
+	}
+	while (wd) {
+		next = wd->next;
+		free(wd);
+		wd = next;
+	}
+}
+
+// read the GPRs of @wd, returns the gpr_state it ends up in
+static int read_wave_gprs(struct umr_asic *asic, struct umr_wave_data *wd)
+{
+	unsigned thread;
+
+	if (asic->gpr_read_funcs.read_sgprs(asic, wd, &wd->sgprs[0]) < 0)
+		return UMR_WAVE_GPRS_NONE;
+
+	wd->have_vgprs = 1;
+	for (thread = 0; thread < wd->num_threads; ++thread) {
+		if (asic->gpr_read_funcs.read_vgprs(asic, wd, thread, &wd->vgprs[256 * thread]) < 0) {
+			wd->have_vgprs = 0;
+			break;
 		}
-	} else {
-		pwd->have_vgprs = 0;
 	}
+	return UMR_WAVE_GPRS_READ;
+}
 
-	return 1;
+/**
+ * umr_wave_data_fetch_gprs - Read the SGPRs and VGPRs of a scanned wave
+ *
+ * @asic: The ASIC the wave was scanned on
+ * @wd: The wave
+ *
+ * The scan only reads the wave status.  The GPRs are read through
+ * asic->gpr_read_funcs the first time this is called on a wave and kept
+ * in @wd for later calls.  If a background prefetch is reading the wave
+ * this waits for it.  wd->have_vgprs tells if the VGPRs were read.
+ *
+ * Returns -1 if the GPRs are not available (skip_gprs was set during the
+ * scan or the SGPRs could not be read), 0 on success.
+ */
+int umr_wave_data_fetch_gprs(struct umr_asic *asic, struct umr_wave_data *wd)
+{
+	int state = UMR_WAVE_GPRS_LAZY;
+
+	if (__atomic_compare_exchange_n(&wd->gpr_state, &state, UMR_WAVE_GPRS_READING, 0,
+					__ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+		state = read_wave_gprs(asic, wd);
+		__atomic_store_n(&wd->gpr_state, state, __ATOMIC_RELEASE);
+	}
+	while (state == UMR_WAVE_GPRS_READING) {
+		sched_yield();
+		state = __atomic_load_n(&wd->gpr_state, __ATOMIC_ACQUIRE);
+	}
+	return state == UMR_WAVE_GPRS_READ ? 0 : -1;
+}
+
+static void *prefetch_worker(void *arg)
+{
+	struct wave_prefetch *pf = arg;
+	struct umr_wave_data *wd;
+
+	umr_affinity_apply(pf->asic);
+	umr_access_ctx_bind(pf->ctx);
+	for (wd = pf->head; wd && !__atomic_load_n(&pf->stop, __ATOMIC_RELAXED); wd = wd->next)
+		if (umr_wave_data_get_flag_halt(pf->asic, wd) || umr_wave_data_get_flag_fatal_halt(pf->asic, wd))
+			umr_wave_data_fetch_gprs(pf->asic, wd);
+	umr_access_ctx_bind(NULL);
+	return NULL;
+}
+
+/**
+ * umr_wave_data_prefetch_gprs - Read the GPRs of scanned waves in the background
+ *
+ * @asic: The ASIC the waves were scanned on
+ * @wd: The head of a list returned by umr_scan_wave_data()
+ *
+ * Starts a thread that fetches the GPRs of every halted wave of the list
+ * through its own access context while the caller goes on with the list.
+ * The thread is stopped by umr_free_wave_data().  Only the debugfs gprwave
+ * backend can be read from another thread, with any other the GPRs are
+ * left to be read on demand.
+ *
+ * Returns -1 on error, 1 if the GPRs cannot be prefetched, 0 if the
+ * prefetch was started.
+ */
+int umr_wave_data_prefetch_gprs(struct umr_asic *asic, struct umr_wave_data *wd)
+{
+	struct wave_prefetch *pf;
+
+	if (!wd || !wd->arena || wd->arena->prefetch || asic->options.skip_gprs ||
+	    asic->options.no_kernel || asic->options.test_log || asic->fd.gprwave < 0 ||
+	    asic->gpr_read_funcs.read_sgprs != umr_read_sgprs ||
+	    asic->gpr_read_funcs.read_vgprs != umr_read_vgprs)
+		return 1;
+
+	pf = calloc(1, sizeof *pf);
+	if (!pf) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return -1;
+	}
+	pf->asic = asic;
+	pf->head = wd;
+	pf->ctx = umr_access_ctx_create(asic);
+	if (!pf->ctx) {
+		free(pf);
+		return -1;
+	}
+	if (pthread_create(&pf->thread, NULL, prefetch_worker, pf)) {
+		umr_access_ctx_free(pf->ctx);
+		free(pf);
+		return -1;
+	}
+	wd->arena->prefetch = pf;
+	return 0;
 }
 
 /**
@@ -630,16 +971,18 @@ int umr_scan_wave_slot(struct umr_asic *asic, uint32_t se, uint32_t sh, uint32_t
  * @simd: The SIMD to query
  * @cu: the CU instance on <=gfx9, the WGP index on >=gfx10
  * @simd: the SIMD within the CU / WGP
- * @pppwd: points to the pointer-to-pointer-to the last element of a linked
- *              list of wave data structures, with the last element yet to be filled in.
- *              The pointer-to-pointer-to is updated by this function.
+ * @wl: The list the waves found are appended to
+ *
+ * If the device has a get_wave_status_bulk callback the status of every
+ * slot is read with one call.
  *
  * Returns -1 on error, 0 on success.
  */
 static int umr_scan_wave_simd(struct umr_asic *asic, uint32_t se, uint32_t sh, uint32_t cu, uint32_t simd,
-			       struct umr_wave_data ***pppwd)
+			       struct umr_wave_list *wl)
 {
 	struct umr_ip_block *gfxip = umr_find_ip_block(asic, "gfx", asic->options.vm_partition);
+	struct umr_wave_status ws[20];
 	uint32_t wave, wave_limit;
 	int r;
 
@@ -650,23 +993,36 @@ static int umr_scan_wave_simd(struct umr_asic *asic, uint32_t se, uint32_t sh, u
 	else
 		wave_limit = 16; // Navi2+
 
-	for (wave = 0; wave < wave_limit; wave++) {
-		struct umr_wave_data *pwd = **pppwd;
-		if ((r = umr_scan_wave_slot(asic, se, sh, cu, simd, wave, pwd)) == 1) {
-			pwd->next = calloc(1, sizeof(*pwd));
-			if (!pwd->next) {
-				asic->err_msg("[ERROR]: Out of memory\n");
-				return -1;
-			}
-			pwd->next->reg_names = pwd->reg_names;
-			*pppwd = &pwd->next;
+	if (asic->wave_funcs.get_wave_status_bulk) {
+		memset(ws, 0, sizeof ws);
+		if (asic->family <= FAMILY_AI)
+			r = asic->wave_funcs.get_wave_status_bulk(asic, se, sh, cu, simd, wave_limit, ws);
+		else
+			r = asic->wave_funcs.get_wave_status_bulk(asic, se, sh, MANY_TO_INSTANCE(cu, simd), 0, wave_limit, ws);
+		if (r)
+			return -1;
+	}
+
+	for (wave = 0; wave < wave_limit && !wave_list_full(wl); wave++) {
+		struct umr_wave_data *pwd = wave_list_slot(asic, wl);
+		if (!pwd)
+			return -1;
+		if (asic->wave_funcs.get_wave_status_bulk) {
+			memcpy(pwd->ws.reg_values, ws[wave].reg_values, sizeof pwd->ws.reg_values);
+			r = scan_wave_slot_status(asic, se, sh, cu, simd, wave, pwd);
+		} else {
+			r = umr_scan_wave_slot(asic, se, sh, cu, simd, wave, pwd);
 		}
+		if (r == 1)
+			wave_list_commit(wl);
 		if (r == -1)
 			return -1;
 	}
 	return 0;
 }
 
+static struct umr_wave_field_cache *wave_field_cache(struct umr_asic *asic, struct umr_wave_data *wd);
+
 /**
  * umr_wave_data_init - Initialize a umr_wave_data structure per GFX IP version
  *
@@ -681,108 +1037,765 @@ int umr_wave_data_init(struct umr_asic *asic, struct umr_wave_data *wd)
 
 	memset(wd, 0, sizeof(*wd));
 	umr_gfx_get_ip_ver(asic, &maj, &min);
-	switch (maj) {
-		case 8:
-			wd->reg_names = gfx8_regs;
-			break;
-		case 9:
-			wd->reg_names = gfx9_regs;
-			break;
-		case 10:
-			wd->reg_names = gfx10_regs;
-			break;
-		case 11:
-			wd->reg_names = gfx11_regs;
-			break;
-		case 12:
-			wd->reg_names = gfx12_regs;
-			break;
-		default:
-			return -1;
-	}
+	wd->reg_names = wave_reg_names(maj);
+	if (!wd->reg_names)
+		return -1;
+	// resolve the well known fields now rather than on first use
+	wave_field_cache(asic, wd);
 	return 0;
 }
 
-/**
- * umr_scan_wave_data - Scan for any halted valid waves
+// CUs (WGPs on gfx10+) of every SE/SH that are neither harvested nor disabled
+struct umr_wave_units {
+	uint32_t no_se, no_sh;
+	uint32_t active[]; // [se * no_sh + sh]
+};
+
+// read @reg of SE @se, SH @sh
+static uint32_t read_reg_se_sh(struct umr_asic *asic, struct umr_reg *reg, uint32_t se, uint32_t sh)
+{
+	struct umr_access_ctx *ctx = umr_access_ctx_current(asic);
+	int *use_bank = ctx ? &ctx->use_bank : &asic->options.use_bank;
+	union umr_bank_select *bank = ctx ? &ctx->bank : &asic->options.bank;
+	union umr_bank_select old_bank = *bank;
+	int old_use_bank = *use_bank;
+	uint32_t value;
+
+	*use_bank = 1;
+	bank->grbm.se = se;
+	bank->grbm.sh = sh;
+	bank->grbm.instance = 0xFFFFFFFFUL;
+	value = asic->reg_funcs.read_reg(asic, reg->addr * 4, REG_MMIO);
+	*use_bank = old_use_bank;
+	*bank = old_bank;
+	return value;
+}
+
+// what reading a register that is not there (GFX powered off, missing from
+// a test vector) returns
+static int reg_value_missing(uint32_t v)
+{
+	return v == 0xFFFFFFFFUL || v == 0xDEADBEEFUL || v == 0xBEBEBEEFUL;
+}
+
+/*
+ * wave_units_resolve - Read which CUs (WGPs) of the device are active
  *
- * Returns NULL on error (or no waves found).
+ * The INACTIVE_CUS (INACTIVE_WGPS on gfx10+) masks of the fused and the
+ * driver configuration are read once per SE/SH and kept in the asic.
+ * Where they cannot be read (virtual device, no registers, GFX powered
+ * off) the units are assumed active.
+ * Called before a scan starts so the scan workers only ever read it.
  */
-struct umr_wave_data *umr_scan_wave_data(struct umr_asic *asic)
+static void wave_units_resolve(struct umr_asic *asic)
 {
-	uint32_t se, sh, simd;
-	struct umr_wave_data *ohead, *head, **ptail;
-	int r;
+	struct umr_wave_units *u = asic->wave_units;
+	uint32_t no_se = asic->config.gfx.max_shader_engines, no_sh = asic->config.gfx.max_sh_per_se;
+	uint32_t se, sh, v, user_v, any = 0;
+	struct umr_reg *cc, *user;
+	char *field;
 
-	ohead = head = malloc(sizeof *head);
-	if (!head) {
-		asic->err_msg("[ERROR]: Out of memory\n");
-		return NULL;
-	}
-	ptail = &head;
+	if (u && u->no_se == no_se && u->no_sh == no_sh)
+		return;
+	free(u);
+	asic->wave_units = u = calloc(1, sizeof *u + no_se * no_sh * sizeof u->active[0]);
+	if (!u)
+		return;
+	u->no_se = no_se;
+	u->no_sh = no_sh;
+
+	field = asic->family <= FAMILY_AI ? "INACTIVE_CUS" : "INACTIVE_WGPS";
+	cc = umr_find_reg_data_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, "mmCC_GC_SHADER_ARRAY_CONFIG");
+	user = umr_find_reg_data_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, "mmGC_USER_SHADER_ARRAY_CONFIG");
+	if (cc && user && !(asic->options.is_virtual && asic->reg_funcs.read_reg == umr_read_reg))
+		for (se = 0; se < no_se; se++)
+		for (sh = 0; sh < no_sh; sh++) {
+			v = read_reg_se_sh(asic, cc, se, sh);
+			user_v = read_reg_se_sh(asic, user, se, sh);
+			if (reg_value_missing(v) || reg_value_missing(user_v))
+				v = user_v = 0;
+			v = ~umr_bitslice_reg_quiet(asic, cc, field, v | user_v);
+			u->active[se * no_sh + sh] = v;
+			any |= v;
+		}
+	if (!any)
+		memset(u->active, 0xFF, no_se * no_sh * sizeof u->active[0]);
+}
 
-	if (umr_wave_data_init(asic, ohead) < 0) {
-		asic->err_msg("[BUG]: Unsupported ASIC IP version in umr_scan_wave_data()\n");
-		free(ohead);
-		return NULL;
-	}
+// should CU (WGP on gfx10+) @cu of SE @se, SH @sh be scanned
+static int wave_unit_wanted(struct umr_asic *asic, uint32_t se, uint32_t sh, uint32_t cu)
+{
+	const struct umr_wave_units *u = asic->wave_units;
 
-	for (se = 0; se < asic->config.gfx.max_shader_engines; se++)
-	for (sh = 0; sh < asic->config.gfx.max_sh_per_se; sh++) {
+	if (u && se < u->no_se && sh < u->no_sh && cu < 32 && !(u->active[se * u->no_sh + sh] & (1U << cu)))
+		return 0;
+	return !asic->options.wave_filter.cu || (cu < 64 && (asic->options.wave_filter.cu & (1ULL << cu)));
+}
+
+static int wave_se_sh_wanted(struct umr_asic *asic, uint32_t se, uint32_t sh)
+{
+	return (!asic->options.wave_filter.se || (se < 32 && (asic->options.wave_filter.se & (1U << se)))) &&
+	       (!asic->options.wave_filter.sh || (sh < 32 && (asic->options.wave_filter.sh & (1U << sh))));
+}
+
+// scan shader engine @se appending the waves found to @wl
+static int scan_wave_se(struct umr_asic *asic, uint32_t se, struct umr_wave_list *wl)
+{
+	struct umr_wave_status ws;
+	uint32_t sh, simd;
+	int r;
+
+	for (sh = 0; sh < asic->config.gfx.max_sh_per_se && !wave_list_full(wl); sh++) {
+		if (!wave_se_sh_wanted(asic, se, sh))
+			continue;
 		if (asic->family <= FAMILY_AI) {
-			for (uint32_t cu = 0; cu < asic->config.gfx.max_cu_per_sh; cu++) {
-				asic->wave_funcs.get_wave_sq_info(asic, se, sh, cu, &(*ptail)->ws);
-				if ((*ptail)->ws.sq_info.busy) {
+			for (uint32_t cu = 0; cu < asic->config.gfx.max_cu_per_sh && !wave_list_full(wl); cu++) {
+				if (!wave_unit_wanted(asic, se, sh, cu))
+					continue;
+				asic->wave_funcs.get_wave_sq_info(asic, se, sh, cu, &ws);
+				if (ws.sq_info.busy) {
 					for (simd = 0; simd < 4; simd++) {
-						r = umr_scan_wave_simd(asic, se, sh, cu, simd, &ptail);
+						r = umr_scan_wave_simd(asic, se, sh, cu, simd, wl);
 						if (r < 0)
-							goto error;
+							return r;
 					}
 				}
 			}
 		} else {
 			for (uint32_t wgp = 0; wgp < asic->config.gfx.max_cu_per_sh / 2; wgp++)
-			for (simd = 0; simd < 4; simd++) {
-				asic->wave_funcs.get_wave_sq_info(asic, se, sh, MANY_TO_INSTANCE(wgp, simd), &(*ptail)->ws);
-				if ((*ptail)->ws.sq_info.busy) {
-					r = umr_scan_wave_simd(asic, se, sh, wgp, simd, &ptail);
+			for (simd = 0; simd < 4 && !wave_list_full(wl); simd++) {
+				if (!wave_unit_wanted(asic, se, sh, wgp))
+					break;
+				asic->wave_funcs.get_wave_sq_info(asic, se, sh, MANY_TO_INSTANCE(wgp, simd), &ws);
+				if (ws.sq_info.busy) {
+					r = umr_scan_wave_simd(asic, se, sh, wgp, simd, wl);
 					if (r < 0)
-						goto error;
+						return r;
 				}
 			}
 		}
 	}
+	return 0;
+}
 
-	// drop the pre-allocated tail node
-	free(*ptail);
-	*ptail = NULL;
-	return head;
-error:
-	while (ohead) {
-		head = ohead->next;
-		free(ohead);
-		ohead = head;
+// at most this many shader engines are scanned at once
+#define UMR_SCAN_THREADS 16
+
+struct scan_job {
+	struct umr_asic *asic;
+	int next, n;
+	const char **reg_names;
+	struct {
+		struct umr_wave_list wl;
+		int r;
+	} *se;
+};
+
+struct scan_worker {
+	pthread_t thread;
+	struct scan_job *job;
+	struct umr_access_ctx *ctx;
+};
+
+static void *scan_worker(void *arg)
+{
+	struct scan_worker *w = arg;
+	struct scan_job *job = w->job;
+	int se;
+
+	umr_affinity_apply(job->asic);
+	umr_access_ctx_bind(w->ctx);
+	while ((se = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->n) {
+		job->se[se].wl.reg_names = job->reg_names;
+		job->se[se].wl.max = job->asic->options.wave_filter.max_waves;
+		job->se[se].r = scan_wave_se(job->asic, se, &job->se[se].wl);
 	}
+	umr_access_ctx_bind(NULL);
 	return NULL;
 }
 
-/**
- * umr_wave_data_get_value - return one of the WAVE STATUS registers
+// every access of a scan has to go through debugfs files that an access
+// context can reopen for the parallel scan to be safe
+static int can_scan_parallel(struct umr_asic *asic)
+{
+	return asic->options.parallel_waves &&
+	       !asic->options.no_kernel && !asic->options.test_log &&
+	       asic->config.gfx.max_shader_engines > 1 &&
+	       asic->fd.mmio2 >= 0 && asic->fd.gprwave >= 0 && !asic->options.use_pci &&
+	       asic->reg_funcs.read_reg == umr_read_reg &&
+	       asic->reg_funcs.write_reg == umr_write_reg &&
+	       asic->wave_funcs.get_wave_sq_info == umr_get_wave_sq_info &&
+	       asic->wave_funcs.get_wave_status == umr_get_wave_status &&
+	       (!asic->wave_funcs.get_wave_status_bulk ||
+		asic->wave_funcs.get_wave_status_bulk == umr_get_wave_status_bulk) &&
+	       (asic->options.skip_gprs ||
+		(asic->gpr_read_funcs.read_sgprs == umr_read_sgprs &&
+		 asic->gpr_read_funcs.read_vgprs == umr_read_vgprs));
+}
+
+/*
+ * scan_wave_data_parallel - Scan the shader engines on worker threads
  *
- * @asic: The ASIC these registers are from
- * @wd: The WAVE STATUS data that has been captured
- * @regname: Which register to read.
+ * Each worker has its own access context so the GRBM bank and the wave
+ * selected in the gprwave file are private to it.  The per SE lists are
+ * joined in SE order so the result is the same as the serial scan.
  *
- * Returns 0xDEADBEEF if the register is not found, otherwise the value.
+ * Returns 0 on success with the list in *head, 1 if the scan could not
+ * be started (the caller should scan serially) and -1 on error.
  */
-uint32_t umr_wave_data_get_value(struct umr_asic *asic, struct umr_wave_data *wd, const char *regname)
+static int scan_wave_data_parallel(struct umr_asic *asic, struct umr_wave_data **head)
 {
-	int x;
-	for (x = 0; wd->reg_names[x]; x++) {
+	struct scan_worker workers[UMR_SCAN_THREADS];
+	struct umr_wave_list wl;
+	struct scan_job job;
+	int i, no_workers, no_ctx, maj, min, r = 0;
+	long cpus;
+
+	// let the serial scan report unsupported devices
+	umr_gfx_get_ip_ver(asic, &maj, &min);
+	if (!wave_reg_names(maj))
+		return 1;
+
+	memset(&job, 0, sizeof job);
+	job.asic = asic;
+	job.reg_names = wave_reg_names(maj);
+	job.n = asic->config.gfx.max_shader_engines;
+	job.se = calloc(job.n, sizeof job.se[0]);
+	if (!job.se) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return -1;
+	}
+
+	no_workers = job.n;
+	if (no_workers > UMR_SCAN_THREADS)
+		no_workers = UMR_SCAN_THREADS;
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpus > 0 && no_workers > cpus)
+		no_workers = cpus;
+	if (no_workers < 2) {
+		free(job.se);
+		return 1;
+	}
+
+	// registers of the gfx blocks are loaded up front so the
+	// workers only ever read the register tables
+	for (i = 0; i < asic->no_blocks; i++)
+		if (!memcmp(asic->blocks[i]->ipname, "gfx", 3) && umr_load_ip_block(asic, asic->blocks[i]))
+			break;
+
+	for (no_ctx = 0; no_ctx < no_workers; no_ctx++) {
+		workers[no_ctx].job = &job;
+		workers[no_ctx].ctx = umr_access_ctx_create(asic);
+		if (!workers[no_ctx].ctx)
+			break;
+	}
+	if (no_ctx < no_workers) {
+		while (no_ctx--)
+			umr_access_ctx_free(workers[no_ctx].ctx);
+		free(job.se);
+		return 1;
+	}
+
+	// the calling thread is one of the workers
+	for (i = 1; i < no_workers; i++)
+		if (pthread_create(&workers[i].thread, NULL, scan_worker, &workers[i]))
+			break;
+	no_workers = i;
+	scan_worker(&workers[0]);
+	for (i = 1; i < no_workers; i++)
+		pthread_join(workers[i].thread, NULL);
+	for (i = 0; i < no_ctx; i++)
+		umr_access_ctx_free(workers[i].ctx);
+
+	// splice the waves and the chunks of every SE together
+	memset(&wl, 0, sizeof wl);
+	for (i = 0; i < job.n; i++) {
+		if (job.se[i].r)
+			r = -1;
+		if (!job.se[i].wl.chunks)
+			continue;
+		if (wl.chunk)
+			wl.chunk->next = job.se[i].wl.chunks;
+		else
+			wl.chunks = job.se[i].wl.chunks;
+		wl.chunk = job.se[i].wl.chunk;
+		if (!job.se[i].wl.head)
+			continue;
+		if (wl.tail)
+			wl.tail->next = job.se[i].wl.head;
+		else
+			wl.head = job.se[i].wl.head;
+		wl.tail = job.se[i].wl.tail;
+		wl.count += job.se[i].wl.count;
+	}
+	free(job.se);
+
+	// every SE stopped at the limit on its own, keep the first ones in SE order
+	if (asic->options.wave_filter.max_waves && wl.count > asic->options.wave_filter.max_waves) {
+		struct umr_wave_data *wd = wl.head;
+
+		for (i = 1; i < asic->options.wave_filter.max_waves; i++)
+			wd = wd->next;
+		wd->next = NULL;
+		wl.tail = wd;
+	}
+	if (r) {
+		wave_arena_free(wl.chunks);
+		*head = NULL;
+	} else {
+		*head = wave_list_finish(&wl);
+	}
+	return r;
+}
+
+static struct umr_wave_data *scan_wave_data(struct umr_asic *asic)
+{
+	uint32_t se;
+	struct umr_wave_data *head;
+	struct umr_wave_list wl;
+	int maj, min, r;
+
+	if (!asic->wave_funcs.scan_wave_data && can_scan_parallel(asic)) {
+		r = scan_wave_data_parallel(asic, &head);
+		if (r < 0)
+			return NULL;
+		if (!r)
+			goto done;
+	}
+
+	memset(&wl, 0, sizeof wl);
+	umr_gfx_get_ip_ver(asic, &maj, &min);
+	wl.reg_names = wave_reg_names(maj);
+	wl.max = asic->options.wave_filter.max_waves;
+	if (!wl.reg_names) {
+		asic->err_msg("[BUG]: Unsupported ASIC IP version in umr_scan_wave_data()\n");
+		return NULL;
+	}
+
+	if (asic->wave_funcs.scan_wave_data) {
+		if (asic->wave_funcs.scan_wave_data(asic, &wl)) {
+			wave_arena_free(wl.chunks);
+			return NULL;
+		}
+	} else {
+		for (se = 0; se < asic->config.gfx.max_shader_engines && !wave_list_full(&wl); se++) {
+			r = scan_wave_se(asic, se, &wl);
+			if (r < 0) {
+				wave_arena_free(wl.chunks);
+				return NULL;
+			}
+		}
+	}
+	head = wave_list_finish(&wl);
+done:
+	// the lists of the XCCs are joined, their GPRs are read on use
+	if (head && asic->options.prefetch_gprs && umr_xcc_current() < 0)
+		umr_wave_data_prefetch_gprs(asic, head);
+	return head;
+}
+
+static int scan_wave_data_xcc(struct umr_asic *asic, void *data)
+{
+	struct umr_wave_data **heads = data, *wd;
+	int xcc = umr_xcc_current();
+
+	heads[xcc] = scan_wave_data(asic);
+	for (wd = heads[xcc]; wd; wd = wd->next)
+		wd->xcc = xcc;
+	return 0;
+}
+
+/*
+ * scan_wave_data_all_xcc - Scan every XCC (options.all_xcc)
+ *
+ * The XCCs are scanned at once by umr_xcc_run(), their lists and the
+ * chunks they are allocated from are joined in XCC order.  The active
+ * CUs are those read by the first scan on every XCC.
+ */
+static struct umr_wave_data *scan_wave_data_all_xcc(struct umr_asic *asic)
+{
+	struct umr_wave_data *heads[UMR_IP_INDEX_INSTANCES], *head = NULL, *tail = NULL;
+	struct umr_wave_arena *arena = NULL, *last = NULL;
+	int i, n = 0;
+
+	memset(heads, 0, sizeof heads);
+	umr_xcc_run(asic, scan_wave_data_xcc, heads);
+	for (i = 0; i < UMR_IP_INDEX_INSTANCES; i++) {
+		if (!heads[i])
+			continue;
+		if (heads[i]->arena) {
+			if (last)
+				last->next = heads[i]->arena;
+			else
+				arena = heads[i]->arena;
+			for (last = heads[i]->arena; last->next; last = last->next);
+			heads[i]->arena = NULL;
+		}
+		if (tail)
+			tail->next = heads[i];
+		else
+			head = heads[i];
+		for (tail = heads[i], ++n; tail->next; tail = tail->next, ++n);
+	}
+
+	// every XCC stopped at the limit on its own, keep the first ones in XCC order
+	if (asic->options.wave_filter.max_waves && n > asic->options.wave_filter.max_waves) {
+		tail = head;
+		for (i = 1; i < asic->options.wave_filter.max_waves; i++)
+			tail = tail->next;
+		tail->next = NULL;
+	}
+	if (head)
+		head->arena = arena;
+	return head;
+}
+
+/**
+ * umr_scan_wave_data - Scan for any halted valid waves
+ *
+ * The waves are allocated in bulk and linked through ->next, the list
+ * must be released with umr_free_wave_data().
+ *
+ * A device with a wave_funcs.scan_wave_data callback is scanned by it
+ * in one go.  Otherwise with the parallel_waves option the shader
+ * engines are scanned on worker threads if the device is accessed
+ * through debugfs.  The GPRs are not read here, see
+ * umr_wave_data_fetch_gprs().  With the prefetch_gprs option they are
+ * read in the background as soon as the scan is done.
+ *
+ * CUs (WGPs on gfx10+) that are harvested or disabled are skipped, the
+ * masks are read by the first scan.  asic->options.wave_filter restricts
+ * the scan to some SEs, SHs and CUs and can stop it after a number of
+ * waves.  It does not apply to devices with a scan_wave_data callback.
+ *
+ * GFXOFF is held off during the scan (see umr_gfxoff_hold()).
+ *
+ * With options.all_xcc every XCC is scanned (see umr_xcc_run()), ->xcc
+ * of the waves tells them apart and the GPRs are not prefetched.
+ *
+ * Returns NULL on error (or no waves found).
+ */
+struct umr_wave_data *umr_scan_wave_data(struct umr_asic *asic)
+{
+	struct umr_wave_data *head;
+
+	umr_gfxoff_hold(asic);
+	wave_units_resolve(asic);
+	if (asic->options.all_xcc && umr_xcc_current() < 0)
+		head = scan_wave_data_all_xcc(asic);
+	else
+		head = scan_wave_data(asic);
+	umr_gfxoff_release(asic);
+	return head;
+}
+
+// sample the valid waves of one SIMD into @samples[*n..max_samples-1]
+static int sample_wave_simd(struct umr_asic *asic, struct umr_wave_data *wd, uint32_t se, uint32_t sh,
+			    uint32_t cu, uint32_t simd, struct umr_wave_pc_sample *samples, int max_samples, int *n)
+{
+	struct umr_ip_block *gfxip = umr_find_ip_block(asic, "gfx", asic->options.vm_partition);
+	struct umr_wave_status ws[20];
+	uint32_t wave, wave_limit, instance;
+	int r;
+
+	if (gfxip->discoverable.maj <= 9)
+		wave_limit = 10;
+	else if (gfxip->discoverable.maj == 10 && gfxip->discoverable.min != 3)
+		wave_limit = 20; // Navi1x
+	else
+		wave_limit = 16; // Navi2+
+
+	instance = asic->family <= FAMILY_AI ? cu : MANY_TO_INSTANCE(cu, simd);
+	if (asic->wave_funcs.get_wave_status_bulk) {
+		if (asic->wave_funcs.get_wave_status_bulk(asic, se, sh, instance,
+							  asic->family <= FAMILY_AI ? simd : 0, wave_limit, ws))
+			return -1;
+	}
+
+	for (wave = 0; wave < wave_limit && *n < max_samples; wave++) {
+		if (asic->wave_funcs.get_wave_status_bulk) {
+			memcpy(wd->ws.reg_values, ws[wave].reg_values, sizeof wd->ws.reg_values);
+		} else {
+			r = asic->wave_funcs.get_wave_status(asic, se, sh, instance,
+							     asic->family <= FAMILY_AI ? simd : 0, wave, &wd->ws);
+			if (r)
+				return -1;
+		}
+		if (!umr_wave_data_get_flag_valid(asic, wd))
+			continue;
+		samples[*n].se = se;
+		samples[*n].sh = sh;
+		samples[*n].cu = cu;
+		samples[*n].simd = simd;
+		samples[*n].wave = wave;
+		umr_wave_data_get_shader_pc_vmid(asic, wd, &samples[*n].vmid, &samples[*n].pc);
+		++*n;
+	}
+	return 0;
+}
+
+/**
+ * umr_sample_wave_pcs - Sample the PC of every valid wave
+ *
+ * @asic: The ASIC to sample
+ * @wd: Scratch wave set up by umr_wave_data_init(), left holding the
+ *      status of the last slot read
+ * @samples: Where to store the samples
+ * @max_samples: The number of entries of @samples
+ *
+ * Only the WAVE STATUS of the slots of busy CUs (WGPs on gfx10+) is read,
+ * through get_wave_status_bulk if the device has it, the CUs that are
+ * harvested or not selected by asic->options.wave_filter are skipped
+ * like by umr_scan_wave_data().  No GPRs are read
+ * and no wave list is built.  The waves are not halted so a sample can
+ * mix the registers of two instructions, it is meant for statistical
+ * profiling.
+ *
+ * Returns the number of samples stored or -1 on error.
+ */
+int umr_sample_wave_pcs(struct umr_asic *asic, struct umr_wave_data *wd,
+			struct umr_wave_pc_sample *samples, int max_samples)
+{
+	struct umr_wave_status ws;
+	uint32_t se, sh, cu, simd;
+	int n = 0;
+
+	if (asic->options.wave_filter.max_waves && max_samples > asic->options.wave_filter.max_waves)
+		max_samples = asic->options.wave_filter.max_waves;
+	wave_units_resolve(asic);
+	for (se = 0; se < asic->config.gfx.max_shader_engines && n < max_samples; se++)
+	for (sh = 0; sh < asic->config.gfx.max_sh_per_se; sh++) {
+		if (!wave_se_sh_wanted(asic, se, sh))
+			continue;
+		if (asic->family <= FAMILY_AI) {
+			for (cu = 0; cu < asic->config.gfx.max_cu_per_sh; cu++) {
+				if (!wave_unit_wanted(asic, se, sh, cu))
+					continue;
+				asic->wave_funcs.get_wave_sq_info(asic, se, sh, cu, &ws);
+				if (!ws.sq_info.busy)
+					continue;
+				for (simd = 0; simd < 4; simd++)
+					if (sample_wave_simd(asic, wd, se, sh, cu, simd, samples, max_samples, &n))
+						return -1;
+			}
+		} else {
+			for (cu = 0; cu < asic->config.gfx.max_cu_per_sh / 2; cu++)
+			for (simd = 0; simd < 4; simd++) {
+				if (!wave_unit_wanted(asic, se, sh, cu))
+					break;
+				asic->wave_funcs.get_wave_sq_info(asic, se, sh, MANY_TO_INSTANCE(cu, simd), &ws);
+				if (!ws.sq_info.busy)
+					continue;
+				if (sample_wave_simd(asic, wd, se, sh, cu, simd, samples, max_samples, &n))
+					return -1;
+			}
+		}
+	}
+	return n;
+}
+
+#define WAVE_FIELD_CACHE_SIZE 64
+
+// per-asic cache of resolved WAVE STATUS bitfields, indexed by the address
+// of the name strings (almost always literals) and verified by content,
+// plus the well known fields by ID
+struct umr_wave_field_cache {
+	const char **reg_names;
+	int vm_partition;
+	struct {
+		char regname[64], bitname[64];
+		struct umr_wave_field wf;
+	} slots[WAVE_FIELD_CACHE_SIZE];
+	struct umr_wave_field known[UMR_WAVE_FIELD_MAX];
+};
+
+// register and bitfield (NULL for the whole register) of the well known
+// fields for gfx8/9, gfx10/11 and gfx12
+static const struct {
+	const char *regname, *bitname;
+} known_fields[UMR_WAVE_FIELD_MAX][3] = {
+	[UMR_WAVE_FIELD_VALID] = { { "ixSQ_WAVE_STATUS", "VALID" }, { "ixSQ_WAVE_STATUS", "VALID" }, { "ixSQ_WAVE_STATUS", "VALID" } },
+	[UMR_WAVE_FIELD_HALT] = { { "ixSQ_WAVE_STATUS", "HALT" }, { "ixSQ_WAVE_STATUS", "HALT" }, { "ixSQ_WAVE_STATE_PRIV", "HALT" } },
+	[UMR_WAVE_FIELD_FATAL_HALT] = { { "ixSQ_WAVE_STATUS", "FATAL_HALT" }, { "ixSQ_WAVE_STATUS", "FATAL_HALT" }, { "ixSQ_WAVE_STATUS", "FATAL_HALT" } },
+	[UMR_WAVE_FIELD_PRIV] = { { "ixSQ_WAVE_STATUS", "PRIV" }, { "ixSQ_WAVE_STATUS", "PRIV" }, { "ixSQ_WAVE_STATUS", "PRIV" } },
+	[UMR_WAVE_FIELD_TRAP_EN] = { { "ixSQ_WAVE_STATUS", "TRAP_EN" }, { "ixSQ_WAVE_STATUS", "TRAP_EN" }, { "ixSQ_WAVE_STATUS", "TRAP_EN" } },
+	[UMR_WAVE_FIELD_WAVE64] = { { "ixSQ_WAVE_IB_STS2", "WAVE64" }, { "ixSQ_WAVE_IB_STS2", "WAVE64" }, { "ixSQ_WAVE_STATUS", "WAVE64" } },
+	[UMR_WAVE_FIELD_SE_ID] = { { "ixSQ_WAVE_HW_ID", "SE_ID" }, { "ixSQ_WAVE_HW_ID1", "SE_ID" }, { "ixSQ_WAVE_HW_ID1", "SE_ID" } },
+	[UMR_WAVE_FIELD_SH_ID] = { { "ixSQ_WAVE_HW_ID", "SH_ID" }, { "ixSQ_WAVE_HW_ID1", "SA_ID" }, { "ixSQ_WAVE_HW_ID1", "SA_ID" } },
+	[UMR_WAVE_FIELD_CU_ID] = { { "ixSQ_WAVE_HW_ID", "CU_ID" }, { "ixSQ_WAVE_HW_ID1", "WGP_ID" }, { "ixSQ_WAVE_HW_ID1", "WGP_ID" } },
+	[UMR_WAVE_FIELD_SIMD_ID] = { { "ixSQ_WAVE_HW_ID", "SIMD_ID" }, { "ixSQ_WAVE_HW_ID1", "SIMD_ID" }, { "ixSQ_WAVE_HW_ID1", "SIMD_ID" } },
+	[UMR_WAVE_FIELD_WAVE_ID] = { { "ixSQ_WAVE_HW_ID", "WAVE_ID" }, { "ixSQ_WAVE_HW_ID1", "WAVE_ID" }, { "ixSQ_WAVE_HW_ID1", "WAVE_ID" } },
+	[UMR_WAVE_FIELD_VM_ID] = { { "ixSQ_WAVE_HW_ID", "VM_ID" }, { "ixSQ_WAVE_HW_ID2", "VM_ID" }, { "ixSQ_WAVE_HW_ID2", "VM_ID" } },
+	[UMR_WAVE_FIELD_SGPR_SIZE] = { { "ixSQ_WAVE_GPR_ALLOC", "SGPR_SIZE" }, { "ixSQ_WAVE_GPR_ALLOC", "SGPR_SIZE" }, { "ixSQ_WAVE_GPR_ALLOC", "SGPR_SIZE" } },
+	[UMR_WAVE_FIELD_VGPR_SIZE] = { { "ixSQ_WAVE_GPR_ALLOC", "VGPR_SIZE" }, { "ixSQ_WAVE_GPR_ALLOC", "VGPR_SIZE" }, { "ixSQ_WAVE_GPR_ALLOC", "VGPR_SIZE" } },
+	[UMR_WAVE_FIELD_PC_LO] = { { "ixSQ_WAVE_PC_LO", NULL }, { "ixSQ_WAVE_PC_LO", NULL }, { "ixSQ_WAVE_PC_LO", NULL } },
+	[UMR_WAVE_FIELD_PC_HI] = { { "ixSQ_WAVE_PC_HI", NULL }, { "ixSQ_WAVE_PC_HI", NULL }, { "ixSQ_WAVE_PC_HI", NULL } },
+};
+
+// which column of known_fields[] a register list uses, -1 if none
+static int known_fields_col(const struct umr_wave_data *wd)
+{
+	if (wd->reg_names == gfx8_regs || wd->reg_names == gfx9_regs)
+		return 0;
+	if (wd->reg_names == gfx10_regs || wd->reg_names == gfx11_regs)
+		return 1;
+	if (wd->reg_names == gfx12_regs)
+		return 2;
+	return -1;
+}
+
+static int wave_data_find_reg_idx(struct umr_wave_data *wd, const char *regname)
+{
+	int x;
+	for (x = 0; wd->reg_names[x]; x++) {
 		if (!strcmp(wd->reg_names[x], regname)) {
-			return wd->ws.reg_values[x];
+			return x;
+		}
+	}
+	return -1;
+}
+
+// resolve the well known fields, the ones that do not exist on this
+// ASIC are left with idx == -1 (and are reported when they are used)
+static void resolve_known_fields(struct umr_asic *asic, struct umr_wave_data *wd, struct umr_wave_field_cache *cache)
+{
+	struct umr_reg *reg;
+	int id, col, i;
+
+	col = known_fields_col(wd);
+	for (id = 0; id < UMR_WAVE_FIELD_MAX; id++) {
+		cache->known[id].idx = -1;
+		if (col < 0)
+			continue;
+		i = wave_data_find_reg_idx(wd, known_fields[id][col].regname);
+		reg = umr_find_reg_data_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, known_fields[id][col].regname);
+		if (i < 0 || !reg)
+			continue;
+		if (!known_fields[id][col].bitname) {
+			cache->known[id].field.reg = reg;
+			cache->known[id].field.shift = 0;
+			cache->known[id].field.mask = 0xFFFFFFFFUL;
+			cache->known[id].idx = i;
+			continue;
+		}
+		for (int x = 0; x < reg->no_bits; x++) {
+			if (!strcmp(reg->bits[x].regname, known_fields[id][col].bitname)) {
+				cache->known[id].field.reg = reg;
+				cache->known[id].field.shift = reg->bits[x].start;
+				cache->known[id].field.mask = umr_bitfield_mask(&reg->bits[x]);
+				cache->known[id].idx = i;
+				break;
+			}
+		}
+	}
+}
+
+// the field cache of the calling thread valid for the register list of @wd
+static struct umr_wave_field_cache *wave_field_cache(struct umr_asic *asic, struct umr_wave_data *wd)
+{
+	struct umr_wave_field_cache *cache, **pcache;
+	struct umr_access_ctx *ctx;
+
+	ctx = umr_access_ctx_current(asic);
+	pcache = ctx ? &ctx->wave_fields : &asic->wave_fields;
+	if (!*pcache) {
+		*pcache = calloc(1, sizeof **pcache);
+		if (!*pcache) {
+			asic->err_msg("[ERROR]: Out of memory\n");
+			return NULL;
 		}
 	}
+	cache = *pcache;
+
+	// a different register list or GFX instance invalidates everything
+	if (cache->reg_names != wd->reg_names || cache->vm_partition != asic->options.vm_partition) {
+		memset(cache, 0, sizeof *cache);
+		cache->reg_names = wd->reg_names;
+		cache->vm_partition = asic->options.vm_partition;
+		resolve_known_fields(asic, wd, cache);
+	}
+	return cache;
+}
+
+/**
+ * umr_wave_data_resolve_field - Resolve a bitfield of a WAVE STATUS register
+ *
+ * @asic: The ASIC these registers are from
+ * @wd: The WAVE STATUS data (only the register list is used)
+ * @regname: Which register
+ * @bitname: Which bitslice of the register
+ * @wf: The resolved handle is stored here, it is valid for any wave data
+ *      of this ASIC and can be used with umr_wave_data_get_field()
+ *
+ * Threads with a bound access context use the cache of their context.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int umr_wave_data_resolve_field(struct umr_asic *asic, struct umr_wave_data *wd, const char *regname, const char *bitname, struct umr_wave_field *wf)
+{
+	struct umr_wave_field_cache *cache;
+	struct umr_reg *reg;
+	uintptr_t h;
+
+	wf->idx = -1;
+	cache = wave_field_cache(asic, wd);
+	if (!cache)
+		return -1;
+
+	h = (((uintptr_t)regname >> 3) ^ ((uintptr_t)bitname >> 2)) % WAVE_FIELD_CACHE_SIZE;
+	if (cache->slots[h].wf.field.reg &&
+	    !strcmp(cache->slots[h].regname, regname) &&
+	    !strcmp(cache->slots[h].bitname, bitname)) {
+		*wf = cache->slots[h].wf;
+		return 0;
+	}
+
+	wf->idx = wave_data_find_reg_idx(wd, regname);
+	if (wf->idx < 0) {
+		asic->err_msg("[BUG]: Register (%s) not found in umr_wave_data list for this ASIC\n", regname);
+		return -1;
+	}
+	reg = umr_find_reg_data_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, regname);
+	if (!reg || umr_field_handle_resolve(asic, reg, bitname, &wf->field))
+		return -1;
+
+	if (strlen(regname) < sizeof(cache->slots[h].regname) && strlen(bitname) < sizeof(cache->slots[h].bitname)) {
+		strcpy(cache->slots[h].regname, regname);
+		strcpy(cache->slots[h].bitname, bitname);
+		cache->slots[h].wf = *wf;
+	}
+	return 0;
+}
+
+/**
+ * umr_wave_data_free_field_cache - Free the resolved WAVE STATUS bitfields
+ *
+ * The active CU masks read by the first scan are dropped as well.
+ */
+void umr_wave_data_free_field_cache(struct umr_asic *asic)
+{
+	free(asic->wave_fields);
+	asic->wave_fields = NULL;
+	free(asic->wave_units);
+	asic->wave_units = NULL;
+}
+
+/**
+ * umr_wave_data_get_value - return one of the WAVE STATUS registers
+ *
+ * @asic: The ASIC these registers are from
+ * @wd: The WAVE STATUS data that has been captured
+ * @regname: Which register to read.
+ *
+ * Returns 0xDEADBEEF if the register is not found, otherwise the value.
+ */
+uint32_t umr_wave_data_get_value(struct umr_asic *asic, struct umr_wave_data *wd, const char *regname)
+{
+	int x;
+
+	x = wave_data_find_reg_idx(wd, regname);
+	if (x >= 0)
+		return wd->ws.reg_values[x];
 	asic->err_msg("[BUG]: Register (%s) not found in umr_wave_data list for this ASIC\n", regname);
 	return 0xDEADBEEF;
 }
@@ -799,13 +1812,50 @@ uint32_t umr_wave_data_get_value(struct umr_asic *asic, struct umr_wave_data *wd
  */
 uint32_t umr_wave_data_get_bits(struct umr_asic *asic, struct umr_wave_data *wd, const char *regname, const char *bitname)
 {
-	uint32_t value;
+	struct umr_wave_field wf;
 
-	value = umr_wave_data_get_value(asic, wd, regname);
-	if (value == 0xDEADBEEF) {
+	if (umr_wave_data_resolve_field(asic, wd, regname, bitname, &wf))
+		return (wf.idx < 0) ? 0xDEADBEEF : 0;
+	if (wd->ws.reg_values[wf.idx] == 0xDEADBEEF)
 		return 0xDEADBEEF;
+	return umr_wave_data_get_field(wd, &wf);
+}
+
+/**
+ * umr_wave_data_get_field_id - return one of the well known WAVE STATUS fields
+ *
+ * @asic: The ASIC these registers are from
+ * @wd: The WAVE STATUS data that has been captured
+ * @id: Which field to return
+ *
+ * The field is looked up in a table resolved once per register list
+ * instead of searching the register and bitfield names on every call.
+ *
+ * Returns 0xDEADBEEF if the register is not found or was not captured,
+ * 0xFFFFFFFF if the GFX IP has no register list, otherwise the value.
+ */
+uint32_t umr_wave_data_get_field_id(struct umr_asic *asic, struct umr_wave_data *wd, enum umr_wave_field_id id)
+{
+	struct umr_wave_field_cache *cache;
+	const struct umr_wave_field *wf;
+	int col;
+
+	col = known_fields_col(wd);
+	if (col < 0)
+		return 0xFFFFFFFFUL;
+
+	cache = wave_field_cache(asic, wd);
+	if (cache && cache->known[id].idx >= 0) {
+		wf = &cache->known[id];
+		if (wd->ws.reg_values[wf->idx] == 0xDEADBEEF)
+			return 0xDEADBEEF;
+		return umr_wave_data_get_field(wd, wf);
 	}
-	return umr_bitslice_reg_by_name_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, (char*)regname, (char*)bitname, value);
+
+	// not resolvable, take the slow path so the error is reported
+	if (!known_fields[id][col].bitname)
+		return umr_wave_data_get_value(asic, wd, known_fields[id][col].regname);
+	return umr_wave_data_get_bits(asic, wd, known_fields[id][col].regname, known_fields[id][col].bitname);
 }
 
 /**
@@ -859,19 +1909,7 @@ int umr_wave_data_get_bit_info(struct umr_asic *asic, struct umr_wave_data *wd,
  */
 int umr_wave_data_get_flag_valid(struct umr_asic *asic, struct umr_wave_data *wd)
 {
-	int maj, min;
-	umr_gfx_get_ip_ver(asic, &maj, &min);
-	switch (maj) {
-		case 6:
-		case 7:
-		case 8:
-		case 9:
-		case 10:
-		case 11:
-		case 12:
-			return umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_STATUS", "VALID");
-	}
-	return -1;
+	return umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_VALID);
 }
 
 /**
@@ -884,19 +1922,7 @@ int umr_wave_data_get_flag_valid(struct umr_asic *asic, struct umr_wave_data *wd
  */
 int umr_wave_data_get_flag_trap_en(struct umr_asic *asic, struct umr_wave_data *wd)
 {
-	int maj, min;
-	umr_gfx_get_ip_ver(asic, &maj, &min);
-	switch (maj) {
-		case 6:
-		case 7:
-		case 8:
-		case 9:
-		case 10:
-		case 11:
-		case 12:
-			return umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_STATUS", "TRAP_EN");
-	}
-	return -1;
+	return umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_TRAP_EN);
 }
 
 /**
@@ -909,20 +1935,7 @@ int umr_wave_data_get_flag_trap_en(struct umr_asic *asic, struct umr_wave_data *
  */
 int umr_wave_data_get_flag_halt(struct umr_asic *asic, struct umr_wave_data *wd)
 {
-	int maj, min;
-	umr_gfx_get_ip_ver(asic, &maj, &min);
-	switch (maj) {
-		case 6:
-		case 7:
-		case 8:
-		case 9:
-		case 10:
-		case 11:
-			return umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_STATUS", "HALT");
-		case 12:
-			return umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_STATE_PRIV", "HALT");
-	}
-	return -1;
+	return umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_HALT);
 }
 
 /**
@@ -935,19 +1948,7 @@ int umr_wave_data_get_flag_halt(struct umr_asic *asic, struct umr_wave_data *wd)
  */
 int umr_wave_data_get_flag_fatal_halt(struct umr_asic *asic, struct umr_wave_data *wd)
 {
-	int maj, min;
-	umr_gfx_get_ip_ver(asic, &maj, &min);
-	switch (maj) {
-		case 6:
-		case 7:
-		case 8:
-		case 9:
-		case 10:
-		case 11:
-		case 12:
-			return umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_STATUS", "FATAL_HALT");
-	}
-	return -1;
+	return umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_FATAL_HALT);
 }
 
 /**
@@ -960,19 +1961,7 @@ int umr_wave_data_get_flag_fatal_halt(struct umr_asic *asic, struct umr_wave_dat
  */
 int umr_wave_data_get_flag_priv(struct umr_asic *asic, struct umr_wave_data *wd)
 {
-	int maj, min;
-	umr_gfx_get_ip_ver(asic, &maj, &min);
-	switch (maj) {
-		case 6:
-		case 7:
-		case 8:
-		case 9:
-		case 10:
-		case 11:
-		case 12:
-			return umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_STATUS", "PRIV");
-	}
-	return -1;
+	return umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_PRIV);
 }
 
 /**
@@ -985,20 +1974,7 @@ int umr_wave_data_get_flag_priv(struct umr_asic *asic, struct umr_wave_data *wd)
  */
 int umr_wave_data_get_flag_wave64(struct umr_asic *asic, struct umr_wave_data *wd)
 {
-	int maj, min;
-	umr_gfx_get_ip_ver(asic, &maj, &min);
-	switch (maj) {
-		case 6:
-		case 7:
-		case 8:
-		case 9:
-		case 10:
-		case 11:
-			return umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_IB_STS2", "WAVE64");
-		case 12:
-			return umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_STATUS", "WAVE64");
-	}
-	return -1;
+	return umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_WAVE64);
 }
 
 /**
@@ -1013,24 +1989,12 @@ int umr_wave_data_get_flag_wave64(struct umr_asic *asic, struct umr_wave_data *w
  */
 int umr_wave_data_get_shader_pc_vmid(struct umr_asic *asic, struct umr_wave_data *wd, uint32_t *vmid, uint64_t *addr)
 {
-	int maj, min;
-	umr_gfx_get_ip_ver(asic, &maj, &min);
-	switch (maj) {
-		case 6:
-		case 7:
-		case 8:
-		case 9:
-			*addr = umr_wave_data_get_value(asic, wd, "ixSQ_WAVE_PC_LO") | ((uint64_t)umr_wave_data_get_value(asic, wd, "ixSQ_WAVE_PC_HI") << 32ULL);
-			*vmid = umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID", "VM_ID");
-			return 0;
-		case 10:
-		case 11:
-		case 12:
-			*addr = umr_wave_data_get_value(asic, wd, "ixSQ_WAVE_PC_LO") | ((uint64_t)umr_wave_data_get_value(asic, wd, "ixSQ_WAVE_PC_HI") << 32ULL);
-			*vmid = umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID2", "VM_ID");
-			return 0;
-	}
-	return -1;
+	if (known_fields_col(wd) < 0)
+		return -1;
+	*addr = umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_PC_LO) |
+		((uint64_t)umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_PC_HI) << 32ULL);
+	*vmid = umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_VM_ID);
+	return 0;
 }
 
 /**
@@ -1043,20 +2007,7 @@ int umr_wave_data_get_shader_pc_vmid(struct umr_asic *asic, struct umr_wave_data
  */
 int umr_wave_data_get_flag_simd_id(struct umr_asic *asic, struct umr_wave_data *wd)
 {
-	int maj, min;
-	umr_gfx_get_ip_ver(asic, &maj, &min);
-	switch (maj) {
-		case 6:
-		case 7:
-		case 8:
-		case 9:
-			return umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID", "SIMD_ID");
-		case 10:
-		case 11:
-		case 12:
-			return umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID1", "SIMD_ID");
-	}
-	return -1;
+	return umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_SIMD_ID);
 }
 
 /**
@@ -1069,20 +2020,7 @@ int umr_wave_data_get_flag_simd_id(struct umr_asic *asic, struct umr_wave_data *
  */
 int umr_wave_data_get_flag_wave_id(struct umr_asic *asic, struct umr_wave_data *wd)
 {
-	int maj, min;
-	umr_gfx_get_ip_ver(asic, &maj, &min);
-	switch (maj) {
-		case 6:
-		case 7:
-		case 8:
-		case 9:
-			return umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID", "WAVE_ID");
-		case 10:
-		case 11:
-		case 12:
-			return umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID1", "WAVE_ID");
-	}
-	return -1;
+	return umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_WAVE_ID);
 }
 
 /**
@@ -1095,16 +2033,11 @@ int umr_wave_data_get_flag_wave_id(struct umr_asic *asic, struct umr_wave_data *
  */
 uint32_t umr_wave_data_num_of_sgprs(struct umr_asic *asic, struct umr_wave_data *wd)
 {
-	int maj, min;
-	umr_gfx_get_ip_ver(asic, &maj, &min);
-	switch (maj) {
-		case 6:
-		case 7: return (umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_GPR_ALLOC", "SGPR_SIZE")) << 3;
-		case 8:
-		case 9: return (umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_GPR_ALLOC", "SGPR_SIZE")) << 4;
-		case 10:
-		case 11:
-		case 12: // TODO: confirm
+	switch (known_fields_col(wd)) {
+		case 0: // SI..CIK allocate in 8-dword blocks, VI+ in 16-dword blocks
+			return umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_SGPR_SIZE) << (asic->family <= FAMILY_CIK ? 3 : 4);
+		case 1:
+		case 2: // TODO: confirm
 			return 124;
 	}
 	return 0;
@@ -1131,19 +2064,19 @@ char *umr_wave_data_describe_wavefront(struct umr_asic *asic, struct umr_wave_da
 		case 9:
 			snprintf(str, sizeof(str)-1, "se%" PRIu32 ".sh%" PRIu32 ".cu%" PRIu32 ".simd%" PRIu32 ".wave%" PRIu32,
 				wd->se, wd->sh, wd->cu,
-				umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID", "SIMD_ID"),
-				umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID", "WAVE_ID"));
+				umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_SIMD_ID),
+				umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_WAVE_ID));
 			break;
 		case 10:
 		case 11:
 		case 12:
 		{
 			int reg_wave, reg_simd, reg_wgp, reg_sa, reg_se, match;
-			reg_wave = umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID1", "WAVE_ID");
-			reg_simd = umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID1", "SIMD_ID");
-			reg_wgp = umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID1", "WGP_ID");
-			reg_sa = umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID1", "SA_ID");
-			reg_se = umr_wave_data_get_bits(asic, wd, "ixSQ_WAVE_HW_ID1", "SE_ID");
+			reg_wave = umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_WAVE_ID);
+			reg_simd = umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_SIMD_ID);
+			reg_wgp = umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_CU_ID);
+			reg_sa = umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_SH_ID);
+			reg_se = umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_SE_ID);
 			if (reg_wave == wd->wave && reg_simd == wd->simd &&
 				reg_wgp == wd->cu && reg_sa == wd->sh && reg_se == wd->se) {
 				match = 1;
@@ -1157,6 +2090,12 @@ char *umr_wave_data_describe_wavefront(struct umr_asic *asic, struct umr_wave_da
 		}
 			break;
 	}
+	if (asic->options.all_xcc) {
+		char xcc_str[sizeof str + 16];
+
+		snprintf(xcc_str, sizeof xcc_str, "xcc%d.%s", wd->xcc, str);
+		return strdup(xcc_str);
+	}
 	return strdup(str);
 }
 
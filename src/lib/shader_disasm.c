@@ -48,6 +48,434 @@ static struct umr_wave_data *find_wave(struct umr_asic *asic, struct umr_wave_da
 	return wd;
 }
 
+/**
+ * umr_disasm_builder_init - Start building a disassembly block
+ *
+ * @b: The builder
+ * @no_lines: How many lines (32-bit words of shader) the block has
+ *
+ * All lines start out as UMR_DISASM_INVALID.
+ *
+ * Returns 0 on success, -1 if out of memory.
+ */
+int umr_disasm_builder_init(struct umr_disasm_builder *b, uint32_t no_lines)
+{
+	uint32_t x;
+
+	memset(b, 0, sizeof *b);
+	b->no_lines = no_lines;
+	b->line = malloc((no_lines ? no_lines : 1) * sizeof b->line[0]);
+	if (!b->line)
+		return -1;
+	for (x = 0; x < no_lines; x++)
+		b->line[x] = UMR_DISASM_INVALID;
+	return 0;
+}
+
+/**
+ * umr_disasm_builder_add - Set the text of a line of a disassembly block
+ *
+ * @b: The builder
+ * @line: The line to set
+ * @str: The text of the line
+ *
+ * An allocation failure is remembered and reported by
+ * umr_disasm_builder_finish().
+ */
+void umr_disasm_builder_add(struct umr_disasm_builder *b, uint32_t line, const char *str)
+{
+	uint32_t len = strlen(str) + 1;
+
+	if (b->err || line >= b->no_lines)
+		return;
+	if (b->len + len > b->size) {
+		uint32_t size = b->size ? b->size : 4096;
+		char *text;
+
+		while (b->len + len > size)
+			size *= 2;
+		text = realloc(b->text, size);
+		if (!text) {
+			b->err = 1;
+			return;
+		}
+		b->text = text;
+		b->size = size;
+	}
+	memcpy(b->text + b->len, str, len);
+	b->line[line] = b->len;
+	b->len += len;
+}
+
+/**
+ * umr_disasm_builder_finish - Turn a builder into a disassembly block
+ *
+ * @b: The builder, it is emptied either way
+ *
+ * Returns the block, to be freed with free(), or NULL if out of memory.
+ */
+struct umr_disasm_block *umr_disasm_builder_finish(struct umr_disasm_builder *b)
+{
+	struct umr_disasm_block *block = NULL;
+
+	if (!b->err && b->line) {
+		block = malloc(sizeof *block + b->no_lines * sizeof block->line[0] + b->len);
+		if (block) {
+			block->no_lines = b->no_lines;
+			block->text_len = b->len;
+			block->line = (uint32_t *)(block + 1);
+			block->text = (char *)(block->line + b->no_lines);
+			memcpy(block->line, b->line, b->no_lines * sizeof block->line[0]);
+			if (b->len)
+				memcpy(block->text, b->text, b->len);
+		}
+	}
+	umr_disasm_builder_fini(b);
+	return block;
+}
+
+/**
+ * umr_disasm_builder_fini - Free a builder that won't be finished
+ *
+ * @b: The builder
+ */
+void umr_disasm_builder_fini(struct umr_disasm_builder *b)
+{
+	free(b->line);
+	free(b->text);
+	memset(b, 0, sizeof *b);
+}
+
+/**
+ * umr_disasm_line - Text of a line of a disassembly block
+ *
+ * @b: The block (or NULL)
+ * @line: The line (32-bit word of the shader)
+ *
+ * Words that continue an instruction read ";;" and words that could not
+ * be disassembled (or any word of a NULL block) read "...".
+ */
+const char *umr_disasm_line(const struct umr_disasm_block *b, uint32_t line)
+{
+	if (!b || line >= b->no_lines || b->line[line] == UMR_DISASM_INVALID)
+		return "...";
+	if (b->line[line] == UMR_DISASM_CONT)
+		return ";;";
+	return b->text + b->line[line];
+}
+
+/**
+ * umr_disasm_block_to_strs - Copy a disassembly block to an array of strings
+ *
+ * @b: The block
+ *
+ * Returns the lines in the form umr_shader_disasm() returns them, each
+ * line and the array are freed with free(), or NULL if out of memory.
+ */
+char **umr_disasm_block_to_strs(const struct umr_disasm_block *b)
+{
+	char **strs;
+	uint32_t x;
+
+	strs = calloc(b->no_lines ? b->no_lines : 1, sizeof *strs);
+	if (!strs)
+		return NULL;
+	for (x = 0; x < b->no_lines; x++) {
+		strs[x] = strdup(umr_disasm_line(b, x));
+		if (!strs[x]) {
+			while (x--)
+				free(strs[x]);
+			free(strs);
+			return NULL;
+		}
+	}
+	return strs;
+}
+
+/**
+ * umr_disasm_block_from_strs - Make a disassembly block from an array of strings
+ *
+ * @strs: The lines as umr_shader_disasm() returns them, they are not freed
+ * @no_lines: How many lines there are
+ *
+ * Returns the block, to be freed with free(), or NULL if out of memory.
+ */
+struct umr_disasm_block *umr_disasm_block_from_strs(char **strs, uint32_t no_lines)
+{
+	struct umr_disasm_builder b;
+	uint32_t x;
+
+	if (umr_disasm_builder_init(&b, no_lines))
+		return NULL;
+	for (x = 0; x < no_lines; x++) {
+		if (!strs[x] || !strcmp(strs[x], "..."))
+			continue;
+		if (!strcmp(strs[x], ";;"))
+			b.line[x] = UMR_DISASM_CONT;
+		else
+			umr_disasm_builder_add(&b, x, strs[x]);
+	}
+	return umr_disasm_builder_finish(&b);
+}
+
+static size_t block_bytes(const struct umr_disasm_block *b)
+{
+	return sizeof *b + b->no_lines * sizeof b->line[0] + b->text_len;
+}
+
+/**
+ * umr_disasm_block_dup - Copy a disassembly block
+ *
+ * @b: The block
+ *
+ * Returns the copy, to be freed with free(), or NULL if out of memory.
+ */
+struct umr_disasm_block *umr_disasm_block_dup(const struct umr_disasm_block *b)
+{
+	struct umr_disasm_block *copy;
+
+	copy = malloc(block_bytes(b));
+	if (!copy)
+		return NULL;
+	memcpy(copy, b, block_bytes(b));
+	copy->line = (uint32_t *)(copy + 1);
+	copy->text = (char *)(copy->line + copy->no_lines);
+	return copy;
+}
+
+// a disassembled shader kept by umr_shader_disasm_block_cached()
+struct umr_disasm_text {
+	uint32_t vmid, size, wave64;
+	uint64_t pc, hash;
+	uint32_t *words;
+	struct umr_disasm_block *block;
+	size_t bytes;
+	struct umr_disasm_text *prev, *next;
+};
+
+// most recently used first, bounded by UMR_DISASM_CACHE_BYTES
+struct umr_disasm_text_cache {
+	struct umr_disasm_text *head, *tail;
+	size_t bytes;
+};
+
+#define UMR_DISASM_CACHE_BYTES (16 * 1024 * 1024)
+
+static pthread_mutex_t disasm_text_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t words_hash(const uint32_t *words, uint32_t n)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+
+	while (n--)
+		h = (h ^ *words++) * 0x100000001b3ULL;
+	return h;
+}
+
+static void unlink_text(struct umr_disasm_text_cache *cache, struct umr_disasm_text *e)
+{
+	if (e->prev)
+		e->prev->next = e->next;
+	else
+		cache->head = e->next;
+	if (e->next)
+		e->next->prev = e->prev;
+	else
+		cache->tail = e->prev;
+	e->prev = e->next = NULL;
+}
+
+static void free_entry(struct umr_disasm_text *e)
+{
+	free(e->block);
+	free(e->words);
+	free(e);
+}
+
+/*
+ * Disassemble with the ASIC's disassembler, the built in one returns a
+ * block directly, others are converted.
+ */
+static struct umr_disasm_block *disasm_block(struct umr_asic *asic, const uint32_t *inst, unsigned inst_bytes, uint64_t PC)
+{
+	struct umr_disasm_block *b;
+	char **strs = NULL;
+	uint32_t x;
+
+	if (!asic->shader_disasm_funcs.disasm || asic->shader_disasm_funcs.disasm == umr_shader_disasm)
+		return umr_shader_disasm_block(asic, (uint8_t *)inst, inst_bytes, PC);
+
+	if (asic->shader_disasm_funcs.disasm(asic, (uint8_t *)inst, inst_bytes, PC, &strs) || !strs)
+		return NULL;
+	b = umr_disasm_block_from_strs(strs, inst_bytes / 4);
+	for (x = 0; x < inst_bytes / 4; x++)
+		free(strs[x]);
+	free(strs);
+	return b;
+}
+
+/**
+ * umr_shader_disasm_block_cached - Disassemble a shader through a cache of results
+ *
+ * @asic: The device the shader is for
+ * @vmid: The VMID the shader was read from
+ * @inst: The shader program
+ * @inst_bytes: The number of bytes in @inst
+ * @PC: The address of @inst
+ *
+ * Many waves run the same shader and the GUI redraws its disassembly
+ * every frame.  The disassembly of each shader is kept per ASIC, keyed by
+ * VMID, address, size and the shader words themselves, so only the first
+ * call for a shader runs the disassembler.  The cache holds up to
+ * UMR_DISASM_CACHE_BYTES and drops the least recently used shaders first.
+ *
+ * Returns a copy of the block, to be freed with free(), or NULL if the
+ * shader could not be disassembled.
+ */
+struct umr_disasm_block *umr_shader_disasm_block_cached(struct umr_asic *asic, unsigned vmid,
+							const uint32_t *inst, unsigned inst_bytes, uint64_t PC)
+{
+	struct umr_disasm_text_cache *cache;
+	struct umr_disasm_block *b;
+	struct umr_disasm_text *e;
+	uint32_t n = inst_bytes / 4;
+	uint64_t hash;
+
+	if (asic->options.no_disasm || !n)
+		return disasm_block(asic, inst, inst_bytes, PC);
+
+	hash = words_hash(inst, n);
+	pthread_mutex_lock(&disasm_text_lock);
+	cache = asic->disasm_text;
+	for (e = cache ? cache->head : NULL; e; e = e->next) {
+		if (e->hash == hash && e->pc == PC && e->vmid == vmid && e->size == inst_bytes &&
+		    e->wave64 == (uint32_t)asic->options.wave64 && !memcmp(e->words, inst, inst_bytes))
+			break;
+	}
+	if (e) {
+		unlink_text(cache, e);
+		e->next = cache->head;
+		if (cache->head)
+			cache->head->prev = e;
+		else
+			cache->tail = e;
+		cache->head = e;
+		b = umr_disasm_block_dup(e->block);
+		pthread_mutex_unlock(&disasm_text_lock);
+		if (!b)
+			asic->err_msg("[ERROR]: Out of memory\n");
+		return b;
+	}
+	pthread_mutex_unlock(&disasm_text_lock);
+
+	b = disasm_block(asic, inst, inst_bytes, PC);
+	if (!b)
+		return NULL;
+
+	// keep a copy, if that fails the shader is just not cached
+	e = calloc(1, sizeof *e);
+	if (!e)
+		return b;
+	e->vmid = vmid;
+	e->size = inst_bytes;
+	e->wave64 = asic->options.wave64;
+	e->pc = PC;
+	e->hash = hash;
+	e->bytes = sizeof *e + inst_bytes + block_bytes(b);
+	e->words = malloc(inst_bytes);
+	if (e->words)
+		e->block = umr_disasm_block_dup(b);
+	if (!e->block || e->bytes > UMR_DISASM_CACHE_BYTES) {
+		free_entry(e);
+		return b;
+	}
+	memcpy(e->words, inst, inst_bytes);
+
+	pthread_mutex_lock(&disasm_text_lock);
+	cache = asic->disasm_text;
+	if (!cache)
+		cache = asic->disasm_text = calloc(1, sizeof *cache);
+	if (!cache) {
+		pthread_mutex_unlock(&disasm_text_lock);
+		free_entry(e);
+		return b;
+	}
+	e->next = cache->head;
+	if (cache->head)
+		cache->head->prev = e;
+	else
+		cache->tail = e;
+	cache->head = e;
+	cache->bytes += e->bytes;
+	while (cache->bytes > UMR_DISASM_CACHE_BYTES) {
+		struct umr_disasm_text *old = cache->tail;
+
+		unlink_text(cache, old);
+		cache->bytes -= old->bytes;
+		free_entry(old);
+	}
+	pthread_mutex_unlock(&disasm_text_lock);
+	return b;
+}
+
+/**
+ * umr_shader_disasm_cached - Disassemble a shader through a cache of results
+ *
+ * @asic: The device the shader is for
+ * @vmid: The VMID the shader was read from
+ * @inst: The shader program
+ * @inst_bytes: The number of bytes in @inst
+ * @PC: The address of @inst
+ * @disasm_text: Where to store the disassembly, see umr_shader_disasm()
+ *
+ * Like umr_shader_disasm_block_cached() but the lines are returned as an
+ * array of strings that the caller frees like those of umr_shader_disasm().
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int umr_shader_disasm_cached(struct umr_asic *asic, unsigned vmid,
+			     const uint32_t *inst, unsigned inst_bytes,
+			     uint64_t PC, char ***disasm_text)
+{
+	struct umr_disasm_block *b;
+
+	*disasm_text = NULL;
+	b = umr_shader_disasm_block_cached(asic, vmid, inst, inst_bytes, PC);
+	if (!b)
+		return -1;
+	*disasm_text = umr_disasm_block_to_strs(b);
+	free(b);
+	if (!*disasm_text) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * umr_shader_disasm_cache_free - Free the disassembled shaders of an ASIC
+ *
+ * @asic: The device to free the cache of
+ */
+void umr_shader_disasm_cache_free(struct umr_asic *asic)
+{
+	struct umr_disasm_text_cache *cache;
+
+	pthread_mutex_lock(&disasm_text_lock);
+	cache = asic->disasm_text;
+	asic->disasm_text = NULL;
+	pthread_mutex_unlock(&disasm_text_lock);
+	if (!cache)
+		return;
+	while (cache->head) {
+		struct umr_disasm_text *e = cache->head;
+
+		cache->head = e->next;
+		free_entry(e);
+	}
+	free(cache);
+}
+
 /**
  * umr_vm_disasm_to_str - Disassemble shader programs in GPU mapped memory to an array of strings
  *
@@ -62,7 +490,7 @@ static struct umr_wave_data *find_wave(struct umr_asic *asic, struct umr_wave_da
 int umr_vm_disasm_to_str(struct umr_asic *asic, int vm_partition, unsigned vmid, uint64_t addr, uint64_t PC, uint32_t size, uint32_t start_offset, char ***out)
 {
 	uint32_t *opcodes = NULL, x, y;
-	char **opcode_strs = NULL;
+	struct umr_disasm_block *text = NULL;
 	int r = 0;
 	char linebuf[512];
 
@@ -83,7 +511,7 @@ int umr_vm_disasm_to_str(struct umr_asic *asic, int vm_partition, unsigned vmid,
 	}
 
 	if (!asic->options.no_disasm)
-		asic->shader_disasm_funcs.disasm(asic, (uint8_t *)opcodes, size, addr + start_offset, &opcode_strs);
+		text = umr_shader_disasm_block_cached(asic, vmid, opcodes, size, addr + start_offset);
 
 	for (y = 0, x = start_offset / 4; x < (start_offset + size)/4; x++, y++) {
 		snprintf(linebuf, sizeof(linebuf) - 1, "%s pgm[%s%u%s@%s0x%" PRIx64 "%s + %s0x%-4x%s] = %s0x%08" PRIx32 "%s\t%s%-60s%s\t",
@@ -92,16 +520,13 @@ int umr_vm_disasm_to_str(struct umr_asic *asic, int vm_partition, unsigned vmid,
 			YELLOW, addr, RST,
 			YELLOW, (unsigned)x * 4, RST,
 			BLUE, opcodes[y], RST,
-			GREEN, opcode_strs ? opcode_strs[y] : "<...>", RST);
-		if (opcode_strs)
-			free(opcode_strs[y]);
+			GREEN, text ? umr_disasm_line(text, y) : "<...>", RST);
 		(*out)[y] = strdup(linebuf);
 	}
-	free(opcode_strs);
+	free(text);
 	free(opcodes);
 	return 0;
 error:
-	free(opcode_strs);
 	free(opcodes);
 	free(*out);
 	return r;
@@ -178,6 +603,15 @@ int umr_vm_disasm(struct umr_asic *asic, FILE *output, int vm_partition, unsigne
 #define S_ENDPGM2 0xbfb00000
 #define S_ENDINV  0xbf9f0000
 
+// largest read made while looking for the end of a shader
+#define SHADER_SIZE_READ_MAX (64 * 1024)
+
+static int shader_size_quiet(const char *fmt, ...)
+{
+	(void)fmt;
+	return 0;
+}
+
 /**
  * umr_compute_shader_size - Compute the size of a shader
  *
@@ -192,42 +626,81 @@ int umr_vm_disasm(struct umr_asic *asic, FILE *output, int vm_partition, unsigne
  */
 uint32_t umr_compute_shader_size(struct umr_asic *asic, int vm_partition, struct umr_shaders_pgm *shader)
 {
+	static const uint32_t ends[] = { S_ENDPGM, S_ENDINV, S_ENDPGM2 };
 	uint64_t addr;
-	uint32_t buf[256/4]; // read 256 byte pages at a time
-	uint32_t lastendpgm, endpgm_cnt, y, x;
+	uint32_t small[256/4], *buf, *big;
+	uint32_t lastendpgm, endpgm_cnt, pos, len, x, n;
+	int (*msg)(const char *fmt, ...);
+	int r;
 
 	addr = shader->addr;
 	endpgm_cnt = 0;
-	x = 256 / 4;
-	y = 0;
+	pos = 0;
 	lastendpgm = 0;
+	len = 256;
+	big = NULL;
 	for (;;) {
-		if (x == 256/4) {
-			// read next page
-			// if we hit a fault just assume that's the end of the memory
-			// mapped to the shader.  This is to account for
-			// older UMDs that might not use the 5 ENDPGM postfix.
-			if (umr_read_vram(asic, vm_partition, shader->vmid, addr, 256, &buf[0]) < 0)
-				break;
-			addr += 256;
-			x = 0;
+		// read 256 bytes first since most shaders are small, then
+		// double the reads up to SHADER_SIZE_READ_MAX for the long
+		// ones so they take a few page walks instead of one per 256
+		// bytes.  If we hit a fault just assume that's the end of the
+		// memory mapped to the shader.  This is to account for older
+		// UMDs that might not use the 5 ENDPGM postfix.
+		buf = small;
+		if (len > sizeof small) {
+			if (!big)
+				big = malloc(SHADER_SIZE_READ_MAX);
+			if (big)
+				buf = big;
+			else
+				len = sizeof small;
 		}
-		y += 4;
-		if (buf[x] == S_ENDPGM || buf[x] == S_ENDINV || buf[x] == S_ENDPGM2) {
-			lastendpgm = y - 4;
-			++endpgm_cnt;
-			if (endpgm_cnt == 5)
-				break;
-			if (asic->options.disasm_early_term)
-				break;
-		} else {
-			endpgm_cnt = 0;
+		// a fault past the end of the shader is expected in the
+		// larger reads so don't report it, the retry reports the
+		// same fault as a 256 byte read would
+		msg = asic->mem_funcs.vm_message;
+		if (len > sizeof small)
+			asic->mem_funcs.vm_message = shader_size_quiet;
+		r = umr_read_vram(asic, vm_partition, shader->vmid, addr, len, buf);
+		asic->mem_funcs.vm_message = msg;
+		if (r < 0) {
+			// the fault may be anywhere in a large read so
+			// retry 256 bytes at a time to stop where it is
+			if (len > sizeof small) {
+				len = sizeof small;
+				continue;
+			}
+			break;
 		}
-		++x;
+		n = len / 4;
+		for (x = 0; x < n; x++) {
+			// outside of a run of terminators skip to the next one
+			if (!endpgm_cnt) {
+				x += umr_dword_find(&buf[x], n - x, ends, 3);
+				if (x == n)
+					break;
+			}
+			if (buf[x] == S_ENDPGM || buf[x] == S_ENDINV || buf[x] == S_ENDPGM2) {
+				lastendpgm = pos + 4 * x;
+				++endpgm_cnt;
+				if (endpgm_cnt == 5) {
+					free(big);
+					return lastendpgm + 4 - 16; // remove last 4 endpgm's
+				}
+				if (asic->options.disasm_early_term) {
+					free(big);
+					return lastendpgm + 4;
+				}
+			} else {
+				endpgm_cnt = 0;
+			}
+		}
+		addr += len;
+		pos += len;
+		if (len < SHADER_SIZE_READ_MAX)
+			len <<= 1;
 	}
-	if (endpgm_cnt == 5)
-		return y - 16; // remove last 4 endpgm's
-	else
-		return lastendpgm + 4; // assume the last endpgm seen was the end
+	free(big);
+	return lastendpgm + 4; // assume the last endpgm seen was the end
 }
 
@@ -30,25 +30,22 @@ static struct umr_reg *find_sq_cmd(struct umr_asic *asic)
 	if (asic->family == FAMILY_SI)
 		return 0;
 
-	struct umr_reg *reg = umr_find_reg_data_by_ip_by_instance(asic, "gfx", asic->options.vm_partition,
-						  asic->family >= FAMILY_GFX11 ? "regSQ_CMD" : "mmSQ_CMD");
+	struct umr_reg *reg = umr_core_reg(asic, UMR_CORE_SQ_CMD);
 	if (!reg)
 		asic->err_msg("[BUG]: Cannot find SQ_CMD register in umr_sq_cmd_halt_waves()\n");
 	return reg;
 }
 
-/**
- * umr_sq_cmd_halt_waves - Attempt to halt or resume waves
- *
- * @mode:	Use UMR_SQ_CMD_HALT to halt waves and
- * 			UMR_SQ_CMD_RESUME to resume waves.
- * @max_retries:	If > 0 halting the waves will be retried if it failed
+/*
+ * sq_cmd_halt_resume - Broadcast SETHALT, for a halt until the ring
+ * stands still or @deadline (see umr_ring_is_halted_by()) passes
  */
-int umr_sq_cmd_halt_waves(struct umr_asic *asic, enum umr_sq_cmd_halt_resume mode, int max_retries)
+static int sq_cmd_halt_resume(struct umr_asic *asic, enum umr_sq_cmd_halt_resume mode, uint64_t deadline)
 {
 	struct umr_reg *reg;
 	uint32_t value;
 	uint64_t addr;
+	int halted = 0;
 	struct {
 		uint32_t se, sh, instance, use_grbm;
 	} grbm;
@@ -81,16 +78,16 @@ int umr_sq_cmd_halt_waves(struct umr_asic *asic, enum umr_sq_cmd_halt_resume mod
 	// compose address
 	addr = reg->addr * 4;
 
-send_cmd:
-	asic->reg_funcs.write_reg(asic, addr, value, reg->type);
-
-	if (mode == UMR_SQ_CMD_HALT &&
-		max_retries > 0 &&
-		!umr_ring_is_halted(asic, asic->options.ring_name)) {
-		usleep(100);
-		max_retries--;
-		goto send_cmd;
-	}
+	// waves launched after a halt are not halted, send it again while
+	// the ring still moves
+	do {
+		asic->reg_funcs.write_reg(asic, addr, value, reg->type);
+		if (mode != UMR_SQ_CMD_HALT)
+			break;
+		halted = umr_ring_is_halted_by(asic, asic->options.ring_name, deadline) == 1;
+		if (!halted)
+			usleep(100);
+	} while (!halted && umr_ring_now_us() < deadline);
 
 	/* restore whatever the user had picked */
 	asic->options.use_bank           = grbm.use_grbm;
@@ -98,8 +95,46 @@ send_cmd:
 	asic->options.bank.grbm.sh       = grbm.sh;
 	asic->options.bank.grbm.instance = grbm.instance;
 
-	return mode == UMR_SQ_CMD_HALT && !umr_ring_is_halted(asic, asic->options.ring_name) ?
-		-1 : 0;
+	return mode == UMR_SQ_CMD_HALT && !halted ? -1 : 0;
+}
+
+/**
+ * umr_sq_cmd_halt_waves_within - Halt waves within a time budget
+ *
+ * @asic: The ASIC to halt the waves of
+ * @budget_us: How long halting may take in microseconds
+ *
+ * SETHALT is broadcast and the ring (asic->options.ring_name) is watched
+ * until its pointers stand still for the halt window, see
+ * umr_ring_is_halted_by().  As soon as they move the halt is sent again,
+ * and the first window the ring stands still for ends the wait, there is
+ * no separate final check.
+ *
+ * Returns 0 if the ring is halted, -1 if it was not halted within the
+ * budget.
+ */
+int umr_sq_cmd_halt_waves_within(struct umr_asic *asic, uint64_t budget_us)
+{
+	return sq_cmd_halt_resume(asic, UMR_SQ_CMD_HALT, umr_ring_now_us() + budget_us);
+}
+
+/**
+ * umr_sq_cmd_halt_waves - Attempt to halt or resume waves
+ *
+ * @mode:	Use UMR_SQ_CMD_HALT to halt waves and
+ * 			UMR_SQ_CMD_RESUME to resume waves.
+ * @max_retries:	If > 0 halting the waves will be retried if it failed
+ *
+ * A halt gets the budget of @max_retries + 1 halt windows (and 100us
+ * between them), see umr_sq_cmd_halt_waves_within().
+ */
+int umr_sq_cmd_halt_waves(struct umr_asic *asic, enum umr_sq_cmd_halt_resume mode, int max_retries)
+{
+	uint64_t budget = 0;
+
+	if (mode == UMR_SQ_CMD_HALT)
+		budget = (uint64_t)(max_retries > 0 ? max_retries + 1 : 1) * (umr_ring_halt_window(asic) + 100);
+	return sq_cmd_halt_resume(asic, mode, umr_ring_now_us() + budget);
 }
 
 /**
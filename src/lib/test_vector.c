@@ -0,0 +1,601 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+
+#include <sys/mman.h>
+#include <pthread.h>
+
+/**
+ * Test vectors are written either as the text script parsed by
+ * umr_create_test_harness() or in a binary form that is cheaper to write
+ * and is replayed straight out of a mapping of the file.
+ *
+ * Binary layout, all in the byte order of the capturing host:
+ *
+ *	char magic[8]
+ *	records, each a struct tv_record followed by size bytes padded to 8
+ *	struct tv_index[no_records], type, size, address and payload offset
+ *		of every record
+ *	struct tv_trailer
+ *
+ * Records are appended as they are logged.  The index and trailer are only
+ * written by umr_test_vector_close() so a run that never got there is still
+ * readable by walking the records.
+ */
+
+#define TV_MAGIC "UMRTVEC1"
+#define TV_INDEX_MAGIC "UMRTVIDX"
+
+struct tv_record {
+	uint32_t type, size;
+	uint64_t address;
+};
+
+struct tv_index {
+	uint32_t type, size;
+	uint64_t address, offset; // offset of the payload in the file
+};
+
+struct tv_trailer {
+	char magic[8];
+	uint64_t index_offset, no_records;
+};
+
+struct umr_test_vector_writer {
+	FILE *f;
+	uint64_t offset;
+	struct tv_index *index;
+	uint64_t no_index, max_index;
+	pthread_mutex_t lock;
+};
+
+// how each record type is spelled in the text format
+static const struct {
+	const char *name;
+	int has_address, words;
+} tv_types[] = {
+	[UMR_TV_GCACONFIG]  = { "GCACONFIG",  0, 0 },
+	[UMR_TV_DISCOVERY]  = { "DISCOVERY",  0, 0 },
+	[UMR_TV_USERQUEUE]  = { "USERQUEUE",  0, 0 },
+	[UMR_TV_SYSRAM]     = { "SYSRAM",     1, 0 },
+	[UMR_TV_VRAM]       = { "VRAM",       1, 0 },
+	[UMR_TV_MMIO]       = { "MMIO",       1, 1 },
+	[UMR_TV_SQ]         = { "SQ",         1, 1 },
+	[UMR_TV_VGPR]       = { "VGPR",       1, 1 },
+	[UMR_TV_SGPR]       = { "SGPR",       1, 1 },
+	[UMR_TV_WAVESTATUS] = { "WAVESTATUS", 1, 1 },
+	[UMR_TV_RINGDATA]   = { "RINGDATA",   0, 1 },
+};
+
+static void text_bytes(FILE *f, const uint8_t *p, uint32_t size)
+{
+	static const char hex[] = "0123456789abcdef";
+	char buf[4096];
+	uint32_t x, n;
+
+	for (n = x = 0; x < size; x++) {
+		buf[n++] = hex[p[x] >> 4];
+		buf[n++] = hex[p[x] & 15];
+		if (n == sizeof buf) {
+			fwrite(buf, 1, n, f);
+			n = 0;
+		}
+	}
+	fwrite(buf, 1, n, f);
+}
+
+static void text_record(FILE *f, enum umr_test_vector_type type, uint64_t address, const void *data, uint32_t size, const char *comment)
+{
+	const uint32_t *w = data;
+	uint32_t x;
+
+	fputs(tv_types[type].name, f);
+	if (tv_types[type].has_address)
+		fprintf(f, "@0x%"PRIx64, address);
+	if (tv_types[type].words) {
+		fputs(" = { ", f);
+		for (x = 0; x < size / 4; x++)
+			fprintf(f, x ? ", 0x%"PRIx32 : "0x%"PRIx32, w[x]);
+		fputs(" }", f);
+	} else {
+		fputs(" = {", f);
+		text_bytes(f, data, size);
+		fputs("}", f);
+	}
+	if (comment)
+		fprintf(f, " ; %s", comment);
+	fputc('\n', f);
+}
+
+static int write_padded(FILE *f, const void *data, size_t size)
+{
+	static const uint8_t zero[8];
+
+	if (size && fwrite(data, 1, size, f) != size)
+		return -1;
+	if ((size & 7) && fwrite(zero, 1, 8 - (size & 7), f) != 8 - (size & 7))
+		return -1;
+	return 0;
+}
+
+static int binary_record(struct umr_test_vector_writer *w, enum umr_test_vector_type type, uint64_t address, const void *data, uint32_t size)
+{
+	struct tv_record rec;
+	struct tv_index *t;
+	int r = 0;
+
+	rec.type = type;
+	rec.size = size;
+	rec.address = address;
+
+	pthread_mutex_lock(&w->lock);
+	if (w->no_index == w->max_index) {
+		t = realloc(w->index, (w->max_index + 1024) * 2 * sizeof *t);
+		if (!t) {
+			r = -1;
+			goto out;
+		}
+		w->index = t;
+		w->max_index = (w->max_index + 1024) * 2;
+	}
+	if (fwrite(&rec, sizeof rec, 1, w->f) != 1 || write_padded(w->f, data, size)) {
+		r = -1;
+		goto out;
+	}
+	t = &w->index[w->no_index++];
+	t->type = type;
+	t->size = size;
+	t->address = address;
+	t->offset = w->offset + sizeof rec;
+	w->offset += sizeof rec + ((size + 7) & ~7ULL);
+out:
+	pthread_mutex_unlock(&w->lock);
+	return r;
+}
+
+/**
+ * umr_test_vector_open - Open a binary test vector for writing
+ * @fname: The file to write
+ *
+ * The returned writer goes into options->test_log_bin with its stream
+ * in options->test_log_fd so the test_log checks of the callers work
+ * unchanged.
+ *
+ * Returns the writer or NULL on error.
+ */
+struct umr_test_vector_writer *umr_test_vector_open(const char *fname)
+{
+	struct umr_test_vector_writer *w;
+
+	w = calloc(1, sizeof *w);
+	if (!w)
+		return NULL;
+	w->f = fopen(fname, "wb");
+	if (!w->f) {
+		fprintf(stderr, "[ERROR]: Could not open test vector '%s' for writing\n", fname);
+		free(w);
+		return NULL;
+	}
+	setvbuf(w->f, NULL, _IOFBF, 1 << 20);
+	if (fwrite(TV_MAGIC, 8, 1, w->f) != 1) {
+		fclose(w->f);
+		free(w);
+		return NULL;
+	}
+	w->offset = 8;
+	pthread_mutex_init(&w->lock, NULL);
+	return w;
+}
+
+/**
+ * umr_test_vector_close - Write the index of a binary test vector and close it
+ * @w: The writer from umr_test_vector_open()
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int umr_test_vector_close(struct umr_test_vector_writer *w)
+{
+	struct tv_trailer tr;
+	int r = 0;
+
+	if (!w)
+		return 0;
+
+	memset(&tr, 0, sizeof tr);
+	memcpy(tr.magic, TV_INDEX_MAGIC, 8);
+	tr.index_offset = w->offset;
+	tr.no_records = w->no_index;
+	if ((w->no_index && fwrite(w->index, sizeof w->index[0], w->no_index, w->f) != w->no_index) ||
+	    fwrite(&tr, sizeof tr, 1, w->f) != 1)
+		r = -1;
+	if (fclose(w->f))
+		r = -1;
+	if (r)
+		fprintf(stderr, "[ERROR]: Could not write test vector index\n");
+	pthread_mutex_destroy(&w->lock);
+	free(w->index);
+	free(w);
+	return r;
+}
+
+/**
+ * umr_test_vector_stream - The stream a binary test vector is written to
+ * @w: The writer from umr_test_vector_open()
+ */
+FILE *umr_test_vector_stream(struct umr_test_vector_writer *w)
+{
+	return w->f;
+}
+
+/**
+ * umr_test_log_bytes - Log a read of bytes to the test vector
+ * @options: The options holding the open test vector
+ * @type: What was read
+ * @address: Where it was read from, ignored for types without an address
+ * @data: The bytes read
+ * @size: How many bytes were read
+ */
+void umr_test_log_bytes(struct umr_options *options, enum umr_test_vector_type type, uint64_t address, const void *data, uint32_t size)
+{
+	if (options->test_log_bin)
+		binary_record(options->test_log_bin, type, address, data, size);
+	else
+		text_record(options->test_log_fd, type, address, data, size, NULL);
+}
+
+/**
+ * umr_test_log_words - Log a read of 32-bit words to the test vector
+ * @options: The options holding the open test vector
+ * @type: What was read
+ * @address: Where it was read from, ignored for types without an address
+ * @data: The words read
+ * @nwords: How many words were read
+ * @comment: Optional text to put after the record, dropped by the binary format
+ */
+void umr_test_log_words(struct umr_options *options, enum umr_test_vector_type type, uint64_t address, const uint32_t *data, uint32_t nwords, const char *comment)
+{
+	if (options->test_log_bin)
+		binary_record(options->test_log_bin, type, address, data, nwords * 4);
+	else
+		text_record(options->test_log_fd, type, address, data, nwords * 4, comment);
+}
+
+/**
+ * umr_is_binary_test_vector - Tell whether a file is a binary test vector
+ * @fname: The file to check
+ */
+int umr_is_binary_test_vector(const char *fname)
+{
+	char magic[8];
+	FILE *f;
+	int r = 0;
+
+	f = fopen(fname, "rb");
+	if (f) {
+		r = fread(magic, 8, 1, f) == 1 && !memcmp(magic, TV_MAGIC, 8);
+		fclose(f);
+	}
+	return r;
+}
+
+// the index a run that was closed properly left at the end of the file
+static const struct tv_index *find_index(const uint8_t *map, uint64_t size, uint64_t *no_records)
+{
+	const struct tv_trailer *tr;
+	const struct tv_index *idx;
+	uint64_t x;
+
+	if (size < 8 + sizeof *tr)
+		return NULL;
+	tr = (const struct tv_trailer *)(map + size - sizeof *tr);
+	if (memcmp(tr->magic, TV_INDEX_MAGIC, 8) || tr->index_offset < 8 || tr->index_offset > size - sizeof *tr ||
+	    tr->no_records != (size - sizeof *tr - tr->index_offset) / sizeof *idx ||
+	    (size - sizeof *tr - tr->index_offset) % sizeof *idx)
+		return NULL;
+	idx = (const struct tv_index *)(map + tr->index_offset);
+	for (x = 0; x < tr->no_records; x++)
+		if (!idx[x].type || idx[x].type >= UMR_TV_NUM ||
+		    idx[x].offset < 8 + sizeof(struct tv_record) || idx[x].offset + idx[x].size > tr->index_offset)
+			return NULL;
+	*no_records = tr->no_records;
+	return idx;
+}
+
+// rebuild the index by walking the records of a run that didn't close the file
+static struct tv_index *scan_records(const uint8_t *map, uint64_t size, uint64_t *no_records)
+{
+	const struct tv_record *rec;
+	struct tv_index *idx = NULL, *t;
+	uint64_t off = 8, n = 0, max = 0;
+
+	while (off + sizeof *rec <= size) {
+		rec = (const struct tv_record *)(map + off);
+		if (!rec->type || rec->type >= UMR_TV_NUM || rec->size > size - off - sizeof *rec)
+			break;
+		if (n == max) {
+			t = realloc(idx, (max + 1024) * 2 * sizeof *t);
+			if (!t) {
+				free(idx);
+				return NULL;
+			}
+			idx = t;
+			max = (max + 1024) * 2;
+		}
+		idx[n].type = rec->type;
+		idx[n].size = rec->size;
+		idx[n].address = rec->address;
+		idx[n].offset = off + sizeof *rec;
+		++n;
+		off += sizeof *rec + ((rec->size + 7) & ~7ULL);
+	}
+	*no_records = n;
+	return idx ? idx : calloc(1, sizeof *idx);
+}
+
+/**
+ * umr_create_test_harness_binary - Create a test harness from a binary test vector
+ * @fname: The file written by umr_test_vector_open()
+ *
+ * The file is mapped privately and the harness blocks point into the
+ * mapping so nothing is parsed or copied, writes made during the replay
+ * only touch the process's copy of the pages.
+ *
+ * Returns the harness or NULL on error.
+ */
+struct umr_test_harness *umr_create_test_harness_binary(const char *fname)
+{
+	struct umr_test_harness *th = NULL;
+	struct umr_test_harness_ram_blocks *rb, **ram_tail[UMR_TV_NUM];
+	struct umr_test_harness_mmio_blocks *mb, **mmio_tail[UMR_TV_NUM];
+	struct umr_test_harness_sq_blocks *sb, **sq_tail;
+	struct tv_index *scanned = NULL;
+	const struct tv_index *idx;
+	uint64_t no_records, x, count[UMR_TV_NUM];
+	uint64_t no_ram = 0, no_mmio = 0, no_sq = 0;
+	uint8_t *map, *payload;
+	struct stat st;
+	int fd;
+
+	fd = open(fname, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "[ERROR]: Could not open test vector '%s'\n", fname);
+		return NULL;
+	}
+	if (fstat(fd, &st) || st.st_size < 8) {
+		close(fd);
+		goto bad_nomap;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "[ERROR]: Could not map test vector '%s'\n", fname);
+		return NULL;
+	}
+	if (memcmp(map, TV_MAGIC, 8))
+		goto bad;
+
+	idx = find_index(map, st.st_size, &no_records);
+	if (!idx) {
+		idx = scanned = scan_records(map, st.st_size, &no_records);
+		if (!idx)
+			goto bad;
+	}
+
+	th = calloc(1, sizeof *th);
+	if (!th)
+		goto bad;
+	th->bin.map = map;
+	th->bin.size = st.st_size;
+
+	// the first record of each type lives in the list head in the harness
+	memset(count, 0, sizeof count);
+	for (x = 0; x < no_records; x++)
+		++count[idx[x].type];
+	for (x = 1; x < UMR_TV_NUM; x++) {
+		if (!count[x])
+			continue;
+		if (x == UMR_TV_SQ)
+			no_sq += count[x] - 1;
+		else if (tv_types[x].words)
+			no_mmio += count[x] - 1;
+		else
+			no_ram += count[x] - 1;
+	}
+	th->bin.ram = calloc(no_ram + 1, sizeof *th->bin.ram);
+	th->bin.mmio = calloc(no_mmio + 1, sizeof *th->bin.mmio);
+	th->bin.sq = calloc(no_sq + 1, sizeof *th->bin.sq);
+	if (!th->bin.ram || !th->bin.mmio || !th->bin.sq)
+		goto bad;
+
+	memset(ram_tail, 0, sizeof ram_tail);
+	memset(mmio_tail, 0, sizeof mmio_tail);
+	rb = th->bin.ram;
+	mb = th->bin.mmio;
+	sb = th->bin.sq;
+	sq_tail = NULL;
+	for (x = 0; x < no_records; x++) {
+		struct umr_test_harness_ram_blocks *ram = NULL;
+		struct umr_test_harness_mmio_blocks *mmio = NULL;
+		struct umr_test_harness_sq_blocks *sq;
+		uint32_t type = idx[x].type;
+
+		payload = map + idx[x].offset;
+		switch (type) {
+		case UMR_TV_GCACONFIG:  ram = &th->config; break;
+		case UMR_TV_DISCOVERY:  ram = &th->discovery; break;
+		case UMR_TV_USERQUEUE:  ram = &th->userqueue; break;
+		case UMR_TV_SYSRAM:     ram = &th->sysram; break;
+		case UMR_TV_VRAM:       ram = &th->vram; break;
+		case UMR_TV_MMIO:       mmio = &th->mmio; break;
+		case UMR_TV_VGPR:       mmio = &th->vgpr; break;
+		case UMR_TV_SGPR:       mmio = &th->sgpr; break;
+		case UMR_TV_WAVESTATUS: mmio = &th->wave; break;
+		case UMR_TV_RINGDATA:   mmio = &th->ring; break;
+		case UMR_TV_SQ:
+			sq = &th->sq;
+			if (sq_tail) {
+				*sq_tail = sb;
+				sq = sb++;
+			}
+			sq->sq_address = idx[x].address;
+			sq->values = (uint32_t *)payload;
+			sq->no_values = idx[x].size / 4;
+			sq_tail = &sq->next;
+			continue;
+		}
+		if (ram) {
+			if (ram_tail[type]) {
+				*ram_tail[type] = rb;
+				ram = rb++;
+			}
+			ram->base_address = idx[x].address;
+			ram->size = idx[x].size;
+			ram->contents = payload;
+			ram_tail[type] = &ram->next;
+		} else {
+			if (mmio_tail[type]) {
+				*mmio_tail[type] = mb;
+				mmio = mb++;
+			}
+			mmio->mmio_address = idx[x].address;
+			mmio->values = (uint32_t *)payload;
+			mmio->no_values = idx[x].size / 4;
+			mmio_tail[type] = &mmio->next;
+		}
+	}
+	free(scanned);
+	return th;
+
+bad:
+	free(scanned);
+	if (th) {
+		free(th->bin.ram);
+		free(th->bin.mmio);
+		free(th->bin.sq);
+		free(th);
+	}
+	munmap(map, st.st_size);
+bad_nomap:
+	fprintf(stderr, "[ERROR]: '%s' is not a valid test vector\n", fname);
+	return NULL;
+}
+
+static int write_ram_list(FILE *f, struct umr_test_vector_writer *w, enum umr_test_vector_type type, struct umr_test_harness_ram_blocks *rb)
+{
+	for (; rb; rb = rb->next) {
+		if (!rb->size)
+			continue;
+		if (w) {
+			if (binary_record(w, type, rb->base_address, rb->contents, rb->size))
+				return -1;
+		} else {
+			text_record(f, type, rb->base_address, rb->contents, rb->size, NULL);
+		}
+	}
+	return 0;
+}
+
+static int write_mmio_list(FILE *f, struct umr_test_vector_writer *w, enum umr_test_vector_type type, struct umr_test_harness_mmio_blocks *mb)
+{
+	for (; mb; mb = mb->next) {
+		if (!mb->no_values)
+			continue;
+		if (w) {
+			if (binary_record(w, type, mb->mmio_address, mb->values, mb->no_values * 4))
+				return -1;
+		} else {
+			text_record(f, type, mb->mmio_address, mb->values, mb->no_values * 4, NULL);
+		}
+	}
+	return 0;
+}
+
+/**
+ * umr_test_vector_convert - Convert a test vector between text and binary
+ * @src: The test vector to read, either format
+ * @dst: Where to write it in the other format
+ *
+ * Records come out grouped by type, which is all the replay depends on
+ * since each type is consumed in order on its own.  Comments of the text
+ * format are not kept.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int umr_test_vector_convert(const char *src, const char *dst)
+{
+	struct umr_test_vector_writer *w = NULL;
+	struct umr_test_harness_sq_blocks *sb;
+	struct umr_test_harness *th;
+	FILE *f = NULL;
+	int r = 0, binary;
+
+	binary = umr_is_binary_test_vector(src);
+	th = umr_create_test_harness_file(src);
+	if (!th)
+		return -1;
+
+	if (binary) {
+		f = fopen(dst, "w");
+		if (!f) {
+			fprintf(stderr, "[ERROR]: Could not open '%s' for writing\n", dst);
+			umr_free_test_harness(th);
+			return -1;
+		}
+	} else {
+		w = umr_test_vector_open(dst);
+		if (!w) {
+			umr_free_test_harness(th);
+			return -1;
+		}
+	}
+
+	r |= write_ram_list(f, w, UMR_TV_DISCOVERY, &th->discovery);
+	r |= write_ram_list(f, w, UMR_TV_GCACONFIG, &th->config);
+	r |= write_ram_list(f, w, UMR_TV_USERQUEUE, &th->userqueue);
+	r |= write_ram_list(f, w, UMR_TV_SYSRAM, &th->sysram);
+	r |= write_ram_list(f, w, UMR_TV_VRAM, &th->vram);
+	r |= write_mmio_list(f, w, UMR_TV_MMIO, &th->mmio);
+	r |= write_mmio_list(f, w, UMR_TV_VGPR, &th->vgpr);
+	r |= write_mmio_list(f, w, UMR_TV_SGPR, &th->sgpr);
+	r |= write_mmio_list(f, w, UMR_TV_WAVESTATUS, &th->wave);
+	r |= write_mmio_list(f, w, UMR_TV_RINGDATA, &th->ring);
+	for (sb = &th->sq; sb; sb = sb->next) {
+		if (!sb->no_values)
+			continue;
+		if (w)
+			r |= binary_record(w, UMR_TV_SQ, sb->sq_address, sb->values, sb->no_values * 4);
+		else
+			text_record(f, UMR_TV_SQ, sb->sq_address, sb->values, sb->no_values * 4, NULL);
+	}
+
+	if (w) {
+		r |= umr_test_vector_close(w);
+	} else if (fclose(f)) {
+		fprintf(stderr, "[ERROR]: Could not write '%s'\n", dst);
+		r = -1;
+	}
+	umr_free_test_harness(th);
+	return r ? -1 : 0;
+}
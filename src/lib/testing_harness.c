@@ -26,6 +26,7 @@
 
 #include <ctype.h>
 #include <stdbool.h>
+#include <sys/mman.h>
 
 // chomp out rest of line
 static void chomp(const char **ptr)
@@ -268,6 +269,20 @@ void umr_free_test_harness(struct umr_test_harness *th)
 	if (!th)
 		return;
 
+	free(th->index.mmio);
+	free(th->index.vram);
+	free(th->index.sysram);
+
+	// a binary test vector owns nothing but the block arrays and the mapping
+	if (th->bin.map) {
+		free(th->bin.ram);
+		free(th->bin.mmio);
+		free(th->bin.sq);
+		munmap(th->bin.map, th->bin.size);
+		free(th);
+		return;
+	}
+
 	discovery = th->discovery.next;
 	config = th->config.next;
 	userqueue = th->userqueue.next;
@@ -533,7 +548,7 @@ error:
 /**
  * umr_create_test_harness_file - Create a test harness from a file on disk
  *
- * @fname: The name of the file on disk
+ * @fname: The name of the file on disk, a text script or a binary test vector
  *
  * Returns a parsed umr_test_harness structure.
  */
@@ -544,6 +559,9 @@ struct umr_test_harness *umr_create_test_harness_file(const char *fname)
 	size_t size;
 	struct umr_test_harness *th;
 
+	if (umr_is_binary_test_vector(fname))
+		return umr_create_test_harness_binary(fname);
+
 	fd = open(fname, O_RDONLY);
 	size = lseek(fd, 0, SEEK_END);
 	lseek(fd, 0, SEEK_SET);
@@ -560,41 +578,48 @@ struct umr_test_harness *umr_create_test_harness_file(const char *fname)
 	return th;
 }
 
-static int access_ram(struct umr_test_harness_ram_blocks *rb, char *name, uint64_t address, uint32_t size, void *dst, int write_en)
+static struct umr_test_harness_ram_range *find_ram_range(struct umr_test_harness_ram_range *ranges, uint32_t n, uint64_t address)
+{
+	uint32_t bot = 0, top = n, mid;
+
+	while (bot < top) {
+		mid = (bot + top) >> 1;
+		if (ranges[mid].end <= address)
+			bot = mid + 1;
+		else
+			top = mid;
+	}
+	if (bot < n && ranges[bot].start <= address)
+		return &ranges[bot];
+	return NULL;
+}
+
+static int access_ram(struct umr_test_harness_ram_range *ranges, uint32_t n, char *name, uint64_t address, uint32_t size, void *dst, int write_en)
 {
-	struct umr_test_harness_ram_blocks *orb = rb;
+	struct umr_test_harness_ram_range *range;
+	struct umr_test_harness_ram_blocks *rb;
+	uint32_t chunk_size;
 
-	// try to find first block that covers the range
 	while (size) {
-		int found = 0;
-		rb = orb;
-		while (rb) {
-			uint32_t chunk_size;
-			if (rb->base_address <= address && (rb->base_address + rb->size) > address) {
-				// this address is inside the block
-				found = 1;
-				chunk_size = size;
-				if (((address + chunk_size) - rb->base_address) > rb->size) {
-					// only use what is left in this chunk
-					chunk_size = rb->size - (address - rb->base_address);
-				}
-				if (!write_en)
-					memcpy(dst, &rb->contents[address - rb->base_address], chunk_size);
-				else
-					memcpy(&rb->contents[address - rb->base_address], dst, chunk_size);
-				address += chunk_size;
-				size -= chunk_size;
-				dst = ((char *)dst + chunk_size);
-			}
-			if (found) {
-				break;
-			}
-			rb = rb->next;
-		}
-		if (!found) {
+		// the first block that covers the address
+		range = find_ram_range(ranges, n, address);
+		if (!range) {
 			fprintf(stderr, "[ERROR]: %s 0x%"PRIx64 " not found in test harness\n", name, address);
 			return -1;
 		}
+		rb = range->block;
+		chunk_size = size;
+		if (((address + chunk_size) - rb->base_address) > rb->size) {
+			// only use what is left in this chunk
+			chunk_size = rb->size - (address - rb->base_address);
+		}
+		if (!write_en)
+			memcpy(dst, &rb->contents[address - rb->base_address], chunk_size);
+		else
+			memcpy(&rb->contents[address - rb->base_address], dst, chunk_size);
+		address += chunk_size;
+		size -= chunk_size;
+		dst = ((char *)dst + chunk_size);
 	}
 	return 0;
 }
@@ -602,13 +627,13 @@ static int access_ram(struct umr_test_harness_ram_blocks *rb, char *name, uint64
 static int access_sram(struct umr_asic *asic, uint64_t address, uint32_t size, void *dst, int write_en)
 {
 	struct umr_test_harness *th = asic->mem_funcs.data;
-	return access_ram(&th->sysram, "System memory", address, size, dst, write_en);
+	return access_ram(th->index.sysram, th->index.no_sysram, "System memory", address, size, dst, write_en);
 }
 
 static int access_linear_vram(struct umr_asic *asic, uint64_t address, uint32_t size, void *data, int write_en)
 {
 	struct umr_test_harness *th = asic->mem_funcs.data;
-	return access_ram(&th->vram, "Video memory", address, size, data, write_en);
+	return access_ram(th->index.vram, th->index.no_vram, "Video memory", address, size, data, write_en);
 }
 
 static uint64_t gpu_bus_to_cpu_address(struct umr_asic *asic, uint64_t dma_addr)
@@ -617,10 +642,54 @@ static uint64_t gpu_bus_to_cpu_address(struct umr_asic *asic, uint64_t dma_addr)
 	return dma_addr;
 }
 
+static struct umr_test_harness_mmio_slot *find_mmio(struct umr_test_harness *th, uint64_t addr)
+{
+	uint32_t i, mask = th->index.mmio_size - 1;
+
+	if (!th->index.mmio_size)
+		return NULL;
+	for (i = ((addr >> 2) * 0x9E3779B1U) & mask; th->index.mmio[i].first; i = (i + 1) & mask)
+		if (th->index.mmio[i].address == addr)
+			return &th->index.mmio[i];
+	return NULL;
+}
+
+static int is_reg(uint64_t qaddr, const uint32_t *regs, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		if (qaddr == regs[i])
+			return 1;
+	return 0;
+}
+
+/*
+ * The indirect access registers are looked up on the first register
+ * access rather than at attach, a name missing from the loaded blocks
+ * loads every pending IP block and that should not happen before the
+ * script touches a register.
+ */
+static void resolve_special_regs(struct umr_test_harness *th)
+{
+	struct umr_asic *asic = th->asic;
+
+	th->index.sq_ind_data = umr_find_reg(asic, "@mmSQ_IND_DATA");
+	th->index.sq_ind_index = umr_find_reg(asic, "@mmSQ_IND_INDEX");
+	th->index.mm_data[0] = umr_find_reg(asic, "@mmMM_DATA");
+	th->index.mm_data[1] = umr_find_reg(asic, "@mmBIF_BX_PF_MM_DATA");
+	th->index.mm_index[0] = umr_find_reg(asic, "@mmMM_INDEX");
+	th->index.mm_index[1] = umr_find_reg(asic, "@mmBIF_BX_PF_MM_INDEX");
+	th->index.mm_index_hi[0] = umr_find_reg(asic, "@mmMM_INDEX_HI");
+	th->index.mm_index_hi[1] = umr_find_reg(asic, "@mmBIF_BX_PF_MM_INDEX_HI");
+	th->index.regs_resolved = 1;
+}
+
 static uint32_t read_reg(struct umr_asic *asic, uint64_t addr, enum regclass type)
 {
 	struct umr_test_harness *th = asic->reg_funcs.data;
 	struct umr_test_harness_sq_blocks *sq;
+	struct umr_test_harness_mmio_slot *slot;
 	struct umr_test_harness_mmio_blocks *mm;
 	uint32_t v;
 	uint64_t qaddr;
@@ -631,11 +700,13 @@ static uint32_t read_reg(struct umr_asic *asic, uint64_t addr, enum regclass typ
 
 	if (type != REG_MMIO)
 		return 0xDEADBEEF;
+	if (!th->index.regs_resolved)
+		resolve_special_regs(th);
 
 //	printf("Reading: %lx\n", (unsigned long)addr);
 
 	// are we reading from SQ_IND_DATA or MM_DATA?
-	if (qaddr == umr_find_reg(asic, "mmSQ_IND_DATA")) {
+	if (qaddr == th->index.sq_ind_data) {
 		// find in SQ list
 		sq = &th->sq;
 		while (sq) {
@@ -647,10 +718,9 @@ static uint32_t read_reg(struct umr_asic *asic, uint64_t addr, enum regclass typ
 			sq = sq->next;
 		}
 		return 0xDEADBEEF;
-	} else if (qaddr == umr_find_reg(asic, "mmSQ_IND_INDEX")) {
+	} else if (qaddr == th->index.sq_ind_index) {
 		return th->sq_ind_index;
-	} else if (qaddr == umr_find_reg(asic, "@mmMM_DATA") ||
-			   qaddr == umr_find_reg(asic, "@mmBIF_BX_PF_MM_DATA")) {
+	} else if (is_reg(qaddr, th->index.mm_data, 2)) {
 		fprintf(stderr, "MM_DATA!\n");
 		// read from VRAM
 		if (th->vram_mm_index & (1ULL << 31)) {
@@ -666,30 +736,30 @@ static uint32_t read_reg(struct umr_asic *asic, uint64_t addr, enum regclass typ
 			fprintf(stderr, "[ERROR]: MM_INDEX must have 32nd bit set\n");
 			return 0;
 		}
-	} else if (qaddr == umr_find_reg(asic, "@mmMM_INDEX") ||
-			   qaddr == umr_find_reg(asic, "@mmBIF_BX_PF_MM_INDEX")) {
+	} else if (is_reg(qaddr, th->index.mm_index, 2)) {
 		return th->vram_mm_index & 0xFFFFFFFFULL;
-	} else if (qaddr == umr_find_reg(asic, "@mmMM_INDEX_HI") ||
-			   qaddr == umr_find_reg(asic, "@mmBIF_BX_PF_MM_INDEX_HI")) {
+	} else if (is_reg(qaddr, th->index.mm_index_hi, 2)) {
 		return th->vram_mm_index >> 32;
 	} else {
-		// read from MMIO list
-		mm = &th->mmio;
-		while (mm) {
-			if (mm->mmio_address == addr && mm->cur_slot != mm->no_values) {
-				v = mm->values[mm->cur_slot];
-				++(mm->cur_slot);
-				return v;
-			}
-			mm = mm->next;
-		}
-		return 0xDEADBEEF;
+		// the first block of this address that has values left
+		slot = find_mmio(th, addr);
+		if (!slot)
+			return 0xDEADBEEF;
+		while (slot->cur && slot->cur->cur_slot == slot->cur->no_values)
+			slot->cur = slot->cur->next_same;
+		mm = slot->cur;
+		if (!mm)
+			return 0xDEADBEEF;
+		v = mm->values[mm->cur_slot];
+		++(mm->cur_slot);
+		return v;
 	}
 }
 
 static int write_reg(struct umr_asic *asic, uint64_t addr, uint32_t value, enum regclass type)
 {
 	struct umr_test_harness *th = asic->reg_funcs.data;
+	struct umr_test_harness_mmio_slot *slot;
 	struct umr_test_harness_mmio_blocks *mm;
 	uint64_t qaddr;
 
@@ -699,16 +769,17 @@ static int write_reg(struct umr_asic *asic, uint64_t addr, uint32_t value, enum
 
 	if (type != REG_MMIO)
 		return -1;
+	if (!th->index.regs_resolved)
+		resolve_special_regs(th);
 
 	// are we reading from SQ_IND_DATA or MM_DATA?
-	if (qaddr == umr_find_reg(asic, "mmSQ_IND_DATA")) {
+	if (qaddr == th->index.sq_ind_data) {
 		// don't allow writing to SQ_IND_DATA
 		return -1;
-	} else if (qaddr == umr_find_reg(asic, "mmSQ_IND_INDEX")) {
+	} else if (qaddr == th->index.sq_ind_index) {
 		th->sq_ind_index = value;
 		return 0;
-	} else if (qaddr == umr_find_reg(asic, "@mmMM_DATA") ||
-			   qaddr == umr_find_reg(asic, "@mmBIF_BX_PF_MM_DATA")) {
+	} else if (is_reg(qaddr, th->index.mm_data, 2)) {
 		// write to VRAM
 		if (th->vram_mm_index & (1ULL << 31)) {
 			uint64_t addr;
@@ -723,25 +794,20 @@ static int write_reg(struct umr_asic *asic, uint64_t addr, uint32_t value, enum
 			fprintf(stderr, "[ERROR]: MM_INDEX must have 32nd bit set\n");
 			return -1;
 		}
-	} else if (qaddr == umr_find_reg(asic, "@mmMM_INDEX") ||
-			   qaddr == umr_find_reg(asic, "@mmBIF_BX_PF_MM_INDEX")) {
+	} else if (is_reg(qaddr, th->index.mm_index, 2)) {
 		th->vram_mm_index = (th->vram_mm_index & 0xFFFFFFFF00000000ULL) | value;
 		return 0;
-	} else if (qaddr == umr_find_reg(asic, "@mmMM_INDEX_HI") ||
-			   qaddr == umr_find_reg(asic, "@mmBIF_BX_PF_MM_INDEX_HI")) {
+	} else if (is_reg(qaddr, th->index.mm_index_hi, 2)) {
 		th->vram_mm_index = (th->vram_mm_index & 0xFFFFFFFFULL) | ((uint64_t)value << 32);
 		return 0;
 	} else {
-		// write to MMIO
-		mm = &th->mmio;
-		while (mm) {
-			if (mm->mmio_address == addr) {
-				mm->values[mm->cur_slot] = value;
-				return 0;
-			}
-			mm = mm->next;
-		}
-		return -1;
+		// write to MMIO, the first block of this address takes it
+		slot = find_mmio(th, addr);
+		if (!slot)
+			return -1;
+		mm = slot->first;
+		mm->values[mm->cur_slot < mm->no_values ? mm->cur_slot : mm->no_values - 1] = value;
+		return 0;
 	}
 }
 
@@ -960,6 +1026,167 @@ void *umr_test_harness_get_ring_data(struct umr_asic *asic, uint32_t *ringsize)
 	return rd;
 }
 
+static int build_mmio_index(struct umr_test_harness *th)
+{
+	struct umr_test_harness_mmio_blocks *mm, **tail;
+	struct umr_test_harness_mmio_slot *slot;
+	uint32_t n, i, mask;
+
+	for (n = 0, mm = &th->mmio; mm; mm = mm->next)
+		n++;
+	for (th->index.mmio_size = 16; th->index.mmio_size < 2 * n; th->index.mmio_size <<= 1);
+	th->index.mmio = calloc(th->index.mmio_size, sizeof *th->index.mmio);
+	if (!th->index.mmio) {
+		th->index.mmio_size = 0;
+		return -1;
+	}
+	mask = th->index.mmio_size - 1;
+
+	for (mm = &th->mmio; mm; mm = mm->next) {
+		mm->next_same = NULL;
+		if (!mm->no_values)
+			continue;
+		slot = NULL;
+		for (i = ((mm->mmio_address >> 2) * 0x9E3779B1U) & mask; th->index.mmio[i].first; i = (i + 1) & mask) {
+			if (th->index.mmio[i].address == mm->mmio_address) {
+				slot = &th->index.mmio[i];
+				break;
+			}
+		}
+		if (!slot) {
+			slot = &th->index.mmio[i];
+			slot->address = mm->mmio_address;
+			slot->first = slot->cur = mm;
+			continue;
+		}
+		// keep the script order of the blocks of an address
+		for (tail = &slot->first->next_same; *tail; tail = &(*tail)->next_same);
+		*tail = mm;
+	}
+	return 0;
+}
+
+struct ram_edge {
+	uint64_t address;
+	uint32_t order;
+	int start;
+};
+
+static int ram_edge_cmp(const void *a, const void *b)
+{
+	const struct ram_edge *x = a, *y = b;
+
+	if (x->address != y->address)
+		return x->address < y->address ? -1 : 1;
+	return 0;
+}
+
+static void heap_push(uint32_t *heap, uint32_t *n, uint32_t v)
+{
+	uint32_t i = (*n)++, t;
+
+	heap[i] = v;
+	for (; i && heap[(i - 1) / 2] > heap[i]; i = (i - 1) / 2) {
+		t = heap[i];
+		heap[i] = heap[(i - 1) / 2];
+		heap[(i - 1) / 2] = t;
+	}
+}
+
+static void heap_pop(uint32_t *heap, uint32_t *n)
+{
+	uint32_t i = 0, c, t;
+
+	heap[0] = heap[--(*n)];
+	while ((c = 2 * i + 1) < *n) {
+		if (c + 1 < *n && heap[c + 1] < heap[c])
+			c++;
+		if (heap[i] <= heap[c])
+			break;
+		t = heap[i];
+		heap[i] = heap[c];
+		heap[c] = t;
+		i = c;
+	}
+}
+
+/*
+ * Split the address space covered by a list of RAM blocks into disjoint
+ * ranges, each owned by the first block of the list that covers it (the
+ * one a linear walk would find).  A sweep over the block edges keeps the
+ * covering blocks in a min-heap by list order.
+ */
+static int build_ram_index(struct umr_test_harness_ram_blocks *head, struct umr_test_harness_ram_range **out, uint32_t *no_out)
+{
+	struct umr_test_harness_ram_blocks *rb, **blocks = NULL;
+	struct umr_test_harness_ram_range *ranges = NULL;
+	struct ram_edge *edges = NULL;
+	uint32_t *heap = NULL, n, nh, nr, i, j;
+	uint8_t *active = NULL;
+	int r = -1;
+
+	*out = NULL;
+	*no_out = 0;
+	for (n = 0, rb = head; rb; rb = rb->next)
+		if (rb->size)
+			n++;
+	if (!n)
+		return 0;
+
+	blocks = calloc(n, sizeof *blocks);
+	edges = calloc(2 * n, sizeof *edges);
+	heap = calloc(n, sizeof *heap);
+	active = calloc(n, 1);
+	ranges = calloc(2 * n, sizeof *ranges);
+	if (!blocks || !edges || !heap || !active || !ranges)
+		goto out;
+
+	for (i = 0, rb = head; rb; rb = rb->next) {
+		if (!rb->size)
+			continue;
+		blocks[i] = rb;
+		edges[2 * i].address = rb->base_address;
+		edges[2 * i].order = i;
+		edges[2 * i].start = 1;
+		edges[2 * i + 1].address = rb->base_address + rb->size;
+		edges[2 * i + 1].order = i;
+		i++;
+	}
+	qsort(edges, 2 * n, sizeof *edges, ram_edge_cmp);
+
+	for (i = nh = nr = 0; i < 2 * n; i = j) {
+		for (j = i; j < 2 * n && edges[j].address == edges[i].address; j++) {
+			active[edges[j].order] = edges[j].start;
+			if (edges[j].start)
+				heap_push(heap, &nh, edges[j].order);
+		}
+		while (nh && !active[heap[0]])
+			heap_pop(heap, &nh);
+		if (!nh || j == 2 * n)
+			continue;
+		rb = blocks[heap[0]];
+		if (nr && ranges[nr - 1].block == rb && ranges[nr - 1].end == edges[i].address) {
+			ranges[nr - 1].end = edges[j].address;
+		} else {
+			ranges[nr].start = edges[i].address;
+			ranges[nr].end = edges[j].address;
+			ranges[nr].block = rb;
+			nr++;
+		}
+	}
+	*out = ranges;
+	*no_out = nr;
+	ranges = NULL;
+	r = 0;
+out:
+	free(blocks);
+	free(edges);
+	free(heap);
+	free(active);
+	free(ranges);
+	return r;
+}
+
 /**
  * umr_attach_test_harness - Attach a test harness to an existing ASIC structure including callbacks.
  *
@@ -973,6 +1200,7 @@ void umr_attach_test_harness(struct umr_test_harness *th, struct umr_asic *asic)
 	asic->mem_funcs.gpu_bus_to_cpu_address = gpu_bus_to_cpu_address;
 	asic->mem_funcs.vm_message = &printf;
 	asic->mem_funcs.data = th;
+	asic->mem_funcs.no_readahead = 1;
 
 	asic->reg_funcs.read_reg = read_reg;
 	asic->reg_funcs.write_reg = write_reg;
@@ -992,6 +1220,17 @@ void umr_attach_test_harness(struct umr_test_harness *th, struct umr_asic *asic)
 
 	th->asic = asic;
 
+	free(th->index.mmio);
+	free(th->index.vram);
+	free(th->index.sysram);
+	memset(&th->index, 0, sizeof th->index);
+	if (build_mmio_index(th) ||
+	    build_ram_index(&th->vram, &th->index.vram, &th->index.no_vram) ||
+	    build_ram_index(&th->sysram, &th->index.sysram, &th->index.no_sysram))
+		asic->err_msg("[ERROR]: Out of memory indexing the test harness\n");
+
+	// the harness replaces what was read from the system
+	asic->config.scanned = 0;
 	umr_scan_config(asic, 0);
 
 	// default shader options
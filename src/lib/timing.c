@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+#include <time.h>
+
+static struct umr_timing timing;
+
+// what the calling thread accounted, see umr_timing_get_thread()
+static __thread struct umr_timing thread_timing;
+static __thread struct {
+	int depth;
+	uint64_t start;
+} active[UMR_TIMING_MAX];
+
+static const char *phase_names[UMR_TIMING_MAX] = {
+	"discover",
+	"ip_discovery",
+	"database",
+	"scan_config",
+	"mmio_accel",
+	"debugfs",
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * umr_timing_begin - Enter a startup phase
+ *
+ * Phases nest (e.g. the database is read during discovery) and a phase
+ * entered again before it ends (e.g. umr_scan_config() called from
+ * within umr_discover_asic()) is only timed once.  Phases are tracked
+ * per thread so devices may be discovered concurrently, the time of
+ * overlapping phases of different threads adds up.
+ */
+void umr_timing_begin(enum umr_timing_phase phase)
+{
+	if (!active[phase].depth++)
+		active[phase].start = now_ns();
+}
+
+/**
+ * umr_timing_end - Leave a startup phase entered with umr_timing_begin()
+ */
+void umr_timing_end(enum umr_timing_phase phase)
+{
+	uint64_t ns;
+
+	if (active[phase].depth && !--active[phase].depth) {
+		ns = now_ns() - active[phase].start;
+		__atomic_fetch_add(&timing.phase[phase].ns, ns, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&timing.phase[phase].calls, 1, __ATOMIC_RELAXED);
+		thread_timing.phase[phase].ns += ns;
+		++thread_timing.phase[phase].calls;
+	}
+}
+
+/**
+ * umr_timing_count - Account files opened and bytes parsed to a phase
+ */
+void umr_timing_count(enum umr_timing_phase phase, uint64_t files, uint64_t bytes)
+{
+	__atomic_fetch_add(&timing.phase[phase].files, files, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&timing.phase[phase].bytes, bytes, __ATOMIC_RELAXED);
+	thread_timing.phase[phase].files += files;
+	thread_timing.phase[phase].bytes += bytes;
+}
+
+/**
+ * umr_timing_get - Copy the counters accumulated since the process started
+ */
+void umr_timing_get(struct umr_timing *t)
+{
+	int i;
+
+	for (i = 0; i < UMR_TIMING_MAX; i++) {
+		t->phase[i].ns = __atomic_load_n(&timing.phase[i].ns, __ATOMIC_RELAXED);
+		t->phase[i].calls = __atomic_load_n(&timing.phase[i].calls, __ATOMIC_RELAXED);
+		t->phase[i].files = __atomic_load_n(&timing.phase[i].files, __ATOMIC_RELAXED);
+		t->phase[i].bytes = __atomic_load_n(&timing.phase[i].bytes, __ATOMIC_RELAXED);
+	}
+}
+
+/**
+ * umr_timing_get_thread - Copy the counters accumulated by the calling thread
+ */
+void umr_timing_get_thread(struct umr_timing *t)
+{
+	*t = thread_timing;
+}
+
+/**
+ * umr_timing_sub - Turn @t into the counters accumulated since @start
+ *
+ * Both are copies taken with umr_timing_get().
+ */
+void umr_timing_sub(struct umr_timing *t, const struct umr_timing *start)
+{
+	int i;
+
+	for (i = 0; i < UMR_TIMING_MAX; i++) {
+		t->phase[i].ns -= start->phase[i].ns;
+		t->phase[i].calls -= start->phase[i].calls;
+		t->phase[i].files -= start->phase[i].files;
+		t->phase[i].bytes -= start->phase[i].bytes;
+	}
+}
+
+const char *umr_timing_phase_name(enum umr_timing_phase phase)
+{
+	return phase < UMR_TIMING_MAX ? phase_names[phase] : "unknown";
+}
+
+/**
+ * umr_timing_print - Print a table of the phases to @f
+ */
+void umr_timing_print(const struct umr_timing *t, FILE *f)
+{
+	int i;
+
+	fprintf(f, "%-14s %12s %8s %8s %12s\n", "phase", "msec", "calls", "files", "bytes");
+	for (i = 0; i < UMR_TIMING_MAX; i++)
+		fprintf(f, "%-14s %12.3f %8"PRIu64" %8"PRIu64" %12"PRIu64"\n",
+			phase_names[i], t->phase[i].ns / 1000000.0,
+			t->phase[i].calls, t->phase[i].files, t->phase[i].bytes);
+}
@@ -109,11 +109,38 @@
 #define VM_VMID_MASK                0xFF    /* Mask for VMID (bits 0:7) */
 #define VM_HUB_MASK                 0xFF00  /* Mask for hub selection (bits 8:15) */
 
+/* Read pipelining */
+#define VM_PENDING_RUNS             32      /* Translated runs queued before they are read */
+
+/* VM registers read for every access, resolved once per hub/partition/VMID */
+enum {
+	VMR_SYSTEM_APERTURE_HIGH_ADDR = 0,
+	VMR_SYSTEM_APERTURE_LOW_ADDR,
+	VMR_MX_L1_TLB_CNTL,
+	VMR_FB_LOCATION_BASE,
+	VMR_FB_LOCATION_TOP,
+	VMR_AGP_BASE,
+	VMR_AGP_BOT,
+	VMR_AGP_TOP,
+	VMR_PAGE_TABLE_START_ADDR_LO32,
+	VMR_PAGE_TABLE_START_ADDR_HI32,
+	VMR_PAGE_TABLE_END_ADDR_LO32,
+	VMR_PAGE_TABLE_END_ADDR_HI32,
+	VMR_CONTEXT_CNTL,
+	VMR_PAGE_TABLE_BASE_ADDR_LO32,
+	VMR_PAGE_TABLE_BASE_ADDR_HI32,
+	VMR_FB_OFFSET,
+	VMR_VGA_MEMORY_BASE_ADDRESS,
+	VMR_VGA_MEMORY_BASE_ADDRESS_HIGH,
+	VMR_MAX,
+};
+
 /* The page table being walked */
 struct umr_vm_ai_state {
 	struct umr_asic *asic;				/* The ASIC model this decoding is attached to */
 	struct umr_vm_pagewalk *vmdata;		/* Optional captured data passed back to the caller (can be NULL) */
 	struct umr_ip_block *ip;			/* The 'gfx' IP block used to determine the IP revision repeatedly in the decoding */
+	struct umr_vm_decoder dec;			/* PTE/PDE decoders of the IP revision, see umr_vm_get_decoder() */
 	int partition;
 	uint64_t va_tally;					/* The tally of VA bits used so far in the translation */
 
@@ -202,6 +229,27 @@ struct umr_vm_ai_state {
 			mmMC_VM_AGP_BOT,
 			mmMC_VM_AGP_TOP;
 	} registers;
+
+	/* VM registers read in one batch by prefetch_vm_regs(), by VMR_* id */
+	struct {
+		uint8_t have[VMR_MAX];
+		uint32_t values[VMR_MAX];
+	} prefetch;
+
+	/* raw entries of the page being walked, see umr_vm_translate_ai() */
+	struct umr_vm_translation walk;
+	struct umr_vm_translation *xlate;	/* Optional translation passed back by umr_vm_translate_ai() */
+
+	/* runs of pages translated but not read yet (see flush_run()) */
+	struct {
+		int n;
+		struct {
+			uint64_t addr;
+			uint32_t len;
+			int sys;
+			void *dst;
+		} run[VM_PENDING_RUNS];
+	} pending;
 };
 
 /**
@@ -572,7 +620,8 @@ static void prepare_pde_to_pte(struct umr_vm_ai_state *vm, int current_depth, ui
  * @param sys Memory location flag:
  *            - 0: Data is located in VRAM (video memory)
  *            - 1: Data is located in system memory
- * @param name Descriptive name for the data type (e.g., "PDE", "PTE", "user page") used in error messages
+ * @param name Descriptive name for the data type (e.g., "PDE", "PTE", "user page") used in error messages,
+ *             NULL to fail quietly
  * @param dst Pointer to buffer where data will be read to or written from
  * @param len Number of bytes to access
  * @param write_en Access mode:
@@ -599,91 +648,575 @@ static int access_translated_address(struct umr_vm_ai_state *vm, uint64_t addr,
 			/* ZFB mode: translate VRAM address to system memory */
 			addr = (addr - vm->vmctrl.agp_bot) + vm->vmctrl.agp_base;
 			if (vm->asic->mem_funcs.access_sram(vm->asic, addr, len, dst, write_en) < 0) {
-				vm->asic->mem_funcs.vm_message("[ERROR]: Cannot read %s entry at SYSRAM address %" PRIx64, name, addr);
+				if (name)
+					vm->asic->mem_funcs.vm_message("[ERROR]: Cannot read %s entry at SYSRAM address %" PRIx64, name, addr);
 				return -1;
 			}
 		} else {
 			if (umr_access_vram(vm->asic, vm->partition, UMR_LINEAR_HUB, addr, len, dst, write_en, NULL) < 0) {
-				vm->asic->mem_funcs.vm_message("[ERROR]: Cannot read %s entry at VRAM address %" PRIx64, name, addr);
+				if (name)
+					vm->asic->mem_funcs.vm_message("[ERROR]: Cannot read %s entry at VRAM address %" PRIx64, name, addr);
 				return -1;
 			}
 		}
 	} else {
 		/* System memory: access directly SRAM */
 		if (vm->asic->mem_funcs.access_sram(vm->asic, addr, len, dst, write_en) < 0) {
-			vm->asic->mem_funcs.vm_message("[ERROR]: Cannot read %s entry at SYSRAM address %" PRIx64, name, addr);
+			if (name)
+				vm->asic->mem_funcs.vm_message("[ERROR]: Cannot read %s entry at SYSRAM address %" PRIx64, name, addr);
 			return -1;
 		}
 	}
 	return 0;
 }
 
+// names are "mm" + prefix + name, the VM_CONTEXT registers get the VMID inserted
+// and global registers are found in any IP block (if the ASIC has them)
+static const struct {
+	const char *name;
+	int vm0, ctx, global;
+} vm_reg_names[VMR_MAX] = {
+	[VMR_SYSTEM_APERTURE_HIGH_ADDR]  = { "MC_VM_SYSTEM_APERTURE_HIGH_ADDR", 1, 0 },
+	[VMR_SYSTEM_APERTURE_LOW_ADDR]   = { "MC_VM_SYSTEM_APERTURE_LOW_ADDR", 1, 0 },
+	[VMR_MX_L1_TLB_CNTL]             = { "MC_VM_MX_L1_TLB_CNTL", 1, 0 },
+	[VMR_FB_LOCATION_BASE]           = { "MC_VM_FB_LOCATION_BASE", 1, 0 },
+	[VMR_FB_LOCATION_TOP]            = { "MC_VM_FB_LOCATION_TOP", 1, 0 },
+	[VMR_AGP_BASE]                   = { "MC_VM_AGP_BASE", 0, 0 },
+	[VMR_AGP_BOT]                    = { "MC_VM_AGP_BOT", 0, 0 },
+	[VMR_AGP_TOP]                    = { "MC_VM_AGP_TOP", 0, 0 },
+	[VMR_PAGE_TABLE_START_ADDR_LO32] = { "_PAGE_TABLE_START_ADDR_LO32", 0, 1 },
+	[VMR_PAGE_TABLE_START_ADDR_HI32] = { "_PAGE_TABLE_START_ADDR_HI32", 0, 1 },
+	[VMR_PAGE_TABLE_END_ADDR_LO32]   = { "_PAGE_TABLE_END_ADDR_LO32", 0, 1 },
+	[VMR_PAGE_TABLE_END_ADDR_HI32]   = { "_PAGE_TABLE_END_ADDR_HI32", 0, 1 },
+	[VMR_CONTEXT_CNTL]               = { "_CNTL", 0, 1 },
+	[VMR_PAGE_TABLE_BASE_ADDR_LO32]  = { "_PAGE_TABLE_BASE_ADDR_LO32", 0, 1 },
+	[VMR_PAGE_TABLE_BASE_ADDR_HI32]  = { "_PAGE_TABLE_BASE_ADDR_HI32", 0, 1 },
+	[VMR_FB_OFFSET]                  = { "MC_VM_FB_OFFSET", 0, 0 },
+	[VMR_VGA_MEMORY_BASE_ADDRESS]      = { "VGA_MEMORY_BASE_ADDRESS", 0, 0, 1 },
+	[VMR_VGA_MEMORY_BASE_ADDRESS_HIGH] = { "VGA_MEMORY_BASE_ADDRESS_HIGH", 0, 0, 1 },
+};
+
+// the PAGE_TABLE_DEPTH/PAGE_TABLE_BLOCK_SIZE fields of VM_CONTEXTx_CNTL
+struct vm_cntl_fields {
+	uint8_t resolved, have_depth, have_block_size;
+	struct umr_field_handle depth, block_size;
+};
+
+struct umr_vm_reg_cache {
+	unsigned hubid;
+	char hub[64];
+	int partition;
+	uint32_t vmid;
+
+	uint8_t resolved[VMR_MAX];
+	struct umr_reg *regs[VMR_MAX];
+	struct vm_cntl_fields cntl;
+
+	/* values read while asic->vm_context.depth > 0, valid for one generation */
+	unsigned generation;
+	uint8_t have[VMR_MAX];
+	uint32_t values[VMR_MAX];
+
+	struct umr_vm_reg_cache *next;
+};
+
+static struct umr_vm_reg_cache *find_vm_regs(struct umr_asic *asic, unsigned hubid, const char *hub, int partition, uint32_t vmid)
+{
+	struct umr_vm_reg_cache *set;
+
+	for (set = asic->vm_regs; set; set = set->next)
+		if (set->hubid == hubid && set->partition == partition && set->vmid == vmid && !strcmp(set->hub, hub))
+			return set;
+
+	set = calloc(1, sizeof *set);
+	if (!set)
+		return NULL;
+	set->hubid = hubid;
+	snprintf(set->hub, sizeof set->hub, "%s", hub);
+	set->partition = partition;
+	set->vmid = vmid;
+	set->next = asic->vm_regs;
+	asic->vm_regs = set;
+	return set;
+}
+
 /**
- * @brief Access GPU mapped memory for GFX9+ platforms
+ * vm_reg - Find one of the VM registers of a hub/VMID
  *
- * This function is responsible for accessing GPU-mapped memory on AMD GPUs with GFX9 and later architectures.
- * It handles virtual to physical address translation using page tables, which may span multiple levels depending on the configuration.
+ * The result (including a register the hub doesn't have) is remembered
+ * in @set so the name is only built and searched for once.
+ */
+static struct umr_reg *vm_reg(struct umr_vm_ai_state *vm, struct umr_vm_reg_cache *set, int id,
+			      const char *hub, const char *vm0prefix, const char *regprefix, uint32_t vmid)
+{
+	char buf[96];
+	struct umr_reg *reg;
+
+	if (set && set->resolved[id])
+		return set->regs[id];
+
+	if (vm_reg_names[id].global) {
+		sprintf(buf, "@mm%s", vm_reg_names[id].name);
+		reg = umr_find_reg(vm->asic, buf) != 0xFFFFFFFF ?
+			umr_find_reg_data_by_ip_by_instance(vm->asic, NULL, -1, buf + 1) : NULL;
+	} else {
+		if (vm_reg_names[id].ctx)
+			sprintf(buf, "mm%sVM_CONTEXT%" PRIu32 "%s", regprefix, vmid, vm_reg_names[id].name);
+		else
+			sprintf(buf, "mm%s%s", vm_reg_names[id].vm0 ? vm0prefix : regprefix, vm_reg_names[id].name);
+		reg = umr_find_reg_data_by_ip_by_instance(vm->asic, (char *)hub, vm->partition, buf);
+	}
+
+	if (set) {
+		set->regs[id] = reg;
+		set->resolved[id] = 1;
+	}
+	return reg;
+}
+
+/**
+ * vm_cntl_fields - Find the fields of VM_CONTEXTx_CNTL
  *
- * @param asic Pointer to the UMR ASIC structure representing the GPU.
- * @param partition The VM partition to be used (refers to different INST of VM register blocks).
- * @param vmid The VMID that the address belongs to. Bits 8:15 indicate which hub the memory belongs to:
- *             - UMR_LINEAR_HUB: The memory is a physical address in VRAM.
- *             - UMR_GFX_HUB: The memory is a virtual address controlled by the GFX hub.
- *             - UMR_MM_HUB: The memory is a virtual address controlled by the MM hub.
- *             Bits 0:7 indicate which VM to access (if any).
- * @param address The address of the memory to access, must be word aligned.
- * @param size The number of bytes to read or write.
- * @param dst Pointer to the buffer to read from/write to.
- * @param write_en Set to 0 to read, non-zero to write.
- * @param vmdata Optional pointer to a structure for capturing page walk data.
+ * The handles are resolved once per @set, without one they are resolved
+ * into @tmp (which must be zeroed) every time.
+ */
+static const struct vm_cntl_fields *vm_cntl_fields(struct umr_asic *asic, struct umr_vm_reg_cache *set,
+						   struct umr_reg *cntl, struct vm_cntl_fields *tmp)
+{
+	struct vm_cntl_fields *f = set ? &set->cntl : tmp;
+
+	if (!f->resolved) {
+		f->have_depth = umr_field_handle_resolve(asic, cntl, "PAGE_TABLE_DEPTH", &f->depth) == 0;
+		f->have_block_size = umr_field_handle_resolve(asic, cntl, "PAGE_TABLE_BLOCK_SIZE", &f->block_size) == 0;
+		f->resolved = 1;
+	}
+	return f;
+}
+
+static uint32_t read_vm_reg(struct umr_vm_ai_state *vm, struct umr_vm_reg_cache *set, int id,
+			    const char *hub, const char *vm0prefix, const char *regprefix, uint32_t vmid)
+{
+	struct umr_reg *reg;
+	uint32_t value;
+	int snapshot = set && vm->asic->vm_context.depth;
+
+	if (snapshot && set->generation == vm->asic->vm_context.generation && set->have[id])
+		return set->values[id];
+
+	if (vm->prefetch.have[id]) {
+		value = vm->prefetch.values[id];
+	} else {
+		reg = vm_reg(vm, set, id, hub, vm0prefix, regprefix, vmid);
+		value = reg ? umr_read_reg_by_reg(vm->asic, reg) : 0;
+	}
+
+	if (snapshot) {
+		if (set->generation != vm->asic->vm_context.generation) {
+			memset(set->have, 0, sizeof set->have);
+			set->generation = vm->asic->vm_context.generation;
+		}
+		set->values[id] = value;
+		set->have[id] = 1;
+	}
+	return value;
+}
+
+/**
+ * prefetch_vm_regs - Read the VM registers an access needs in one batch
  *
- * @return Returns 0 on success, -1 on error.
+ * Only done if the backend has a read_regs_batch callback (rumr) where
+ * each register read is a round trip to the server.  Registers already
+ * held by the VM context snapshot are skipped, the others are picked up
+ * by read_vm_reg() from @vm.  The AGP registers are fetched whether or
+ * not the hub turns out to be in ZFB mode.
+ */
+static void prefetch_vm_regs(struct umr_vm_ai_state *vm, struct umr_vm_reg_cache *set,
+			     const char *hub, const char *vm0prefix, const char *regprefix, uint32_t vmid)
+{
+	struct umr_reg_batch batch[VMR_MAX];
+	struct umr_reg *reg;
+	int ids[VMR_MAX], id, n, x;
+	int snapshot = vm->asic->vm_context.depth && set->generation == vm->asic->vm_context.generation;
+	int uq = vm->asic->options.user_queue.state.active;
+
+	if (!vm->asic->reg_funcs.read_regs_batch)
+		return;
+
+	for (n = id = 0; id < VMR_MAX; id++) {
+		if (snapshot && set->have[id])
+			continue;
+		if ((id == VMR_SYSTEM_APERTURE_HIGH_ADDR || id == VMR_SYSTEM_APERTURE_LOW_ADDR || id == VMR_MX_L1_TLB_CNTL) && (uq || vmid))
+			continue;
+		if (vm_reg_names[id].ctx && uq)
+			continue;
+		if (vm_reg_names[id].global && !vm->asic->is_apu)
+			continue;
+		reg = vm_reg(vm, set, id, hub, vm0prefix, regprefix, vmid);
+		if (!reg || reg->bit64)
+			continue;
+		batch[n].addr = reg->addr * (reg->type == REG_MMIO ? 4 : 1);
+		batch[n].type = reg->type;
+		batch[n].use_bank = vm->asic->options.use_bank;
+		batch[n].bank = vm->asic->options.bank;
+		ids[n++] = id;
+	}
+	if (!n || umr_read_regs_batch(vm->asic, batch, n))
+		return;
+	for (x = 0; x < n; x++) {
+		vm->prefetch.values[ids[x]] = batch[x].value;
+		vm->prefetch.have[ids[x]] = 1;
+	}
+}
+
+/**
+ * umr_vm_context_begin - Start an operation that makes many VM accesses
  *
- * @details
- * The function performs the following steps:
- * 1. Reads various VM context registers to determine the configuration of the page tables.
- * 2. Decodes the virtual address using the page table hierarchy (PDBs and PTBs) based on the PAGE_TABLE_DEPTH and PAGE_TABLE_BLOCK_SIZE settings.
- * 3. Handles different cases for PDEs and PTEs, including when a PDE acts as a PTE (further bit set).
- * 4. Translates the virtual address to a physical address using the decoded page table entries.
- * 5. Reads from or writes to the computed physical address in VRAM or system memory based on the PTE settings.
- * 6. Captures detailed information about the page walk process if `vmdata` is provided, which can be useful for debugging and analysis.
+ * Until the matching umr_vm_context_end() the VM context registers
+ * (FB location, apertures, page table base, ...) of a hub/VMID are only
+ * read by the first umr_access_vram_ai() that needs them.  Calls nest,
+ * the outermost one starts with freshly read registers.
  */
-int umr_access_vram_ai(struct umr_asic *asic, int partition,
-				  uint32_t vmid, uint64_t address, uint32_t size,
-			      void *dst, int write_en, struct umr_vm_pagewalk *vmdata)
+void umr_vm_context_begin(struct umr_asic *asic)
 {
-	struct umr_vm_ai_state vm;
-	uint64_t start_addr, va_mask, offset_mask = 0;
-	uint32_t chunk_size;
-	int current_depth;
+	if (!asic->vm_context.depth++)
+		++asic->vm_context.generation;
+}
 
-	char buf[64];
-	unsigned char *pdst = dst;
-	char *hub, *vm0prefix, *regprefix;
-	unsigned hubid;
-	static const char *indentation = "                  \\->";
+/**
+ * umr_vm_context_end - End an operation started with umr_vm_context_begin()
+ */
+void umr_vm_context_end(struct umr_asic *asic)
+{
+	if (asic->vm_context.depth)
+		--asic->vm_context.depth;
+}
 
-	memset(&vm, 0, sizeof vm);
-	vm.asic = asic;
-	vm.vmdata = vmdata;
-	vm.partition = partition;
-	vm.ip = umr_find_ip_block(vm.asic, "gfx", vm.asic->options.vm_partition);
-	if (!vm.ip) {
-		vm.asic->mem_funcs.vm_message("[BUG]: Cannot find a 'gfx' IP block in this ASIC\n");
-		return -1;
+/**
+ * umr_vm_context_refresh - Re-read the VM context registers on the next access
+ *
+ * For callers that know the VM setup changed (e.g. a VMID was reassigned)
+ * in the middle of an operation.
+ */
+void umr_vm_context_refresh(struct umr_asic *asic)
+{
+	++asic->vm_context.generation;
+}
+
+/* translations of valid pages, checked before walking the page table */
+#define UMR_VM_TLB_ENTRIES 64
+
+struct umr_vm_tlb_entry {
+	struct umr_vm_reg_cache *set;   /* hub/partition/VMID, NULL for an unused entry */
+	uint64_t
+		base_addr,                  /* PAGE_TABLE_BASE_ADDR and START_ADDR the page was walked with */
+		start_addr,
+		va,                         /* VA (relative to start_addr) of the start of the page */
+		offset_mask,                /* offset within the page */
+		pte_page_mask,
+		page_start_addr;            /* CPU address of the page */
+	pte_fields_t pte_fields;
+	struct umr_vm_translation walk; /* the entries walked to the page */
+};
+
+/* page table blocks the PDEs/PTEs are read from, filled with one read each */
+#define UMR_VM_PT_LINES 16
+#define UMR_VM_PT_LINE_SIZE 4096
+
+struct umr_vm_pt_line {
+	int used, sys, partition;
+	uint64_t addr;              /* address of the line (before any ZFB translation) */
+	unsigned last_use;
+	uint8_t data[UMR_VM_PT_LINE_SIZE];
+};
+
+struct umr_vm_tlb {
+	unsigned next;
+	struct umr_vm_tlb_entry entries[UMR_VM_TLB_ENTRIES];
+
+	unsigned pt_clock;
+	struct umr_vm_pt_line pt[UMR_VM_PT_LINES];
+};
+
+static struct umr_vm_tlb *get_tlb(struct umr_asic *asic)
+{
+	if (!asic->vm_tlb)
+		asic->vm_tlb = calloc(1, sizeof *asic->vm_tlb);
+	return asic->vm_tlb;
+}
+
+static struct umr_vm_tlb_entry *tlb_lookup(struct umr_vm_ai_state *vm, struct umr_vm_reg_cache *set, uint64_t address)
+{
+	struct umr_vm_tlb *tlb = vm->asic->vm_tlb;
+	int i;
+
+	if (!tlb || !set)
+		return NULL;
+
+	for (i = 0; i < UMR_VM_TLB_ENTRIES; i++) {
+		struct umr_vm_tlb_entry *e = &tlb->entries[i];
+		if (e->set == set &&
+		    e->base_addr == vm->page_table.page_table_base_addr &&
+		    e->start_addr == vm->page_table.page_table_start_addr &&
+		    (address & ~e->offset_mask) == e->va)
+			return e;
 	}
+	return NULL;
+}
 
-	// if we are using user queues then save the VA in case we are using rumr
-	if (vm.asic->options.user_queue.state.active) {
-		vm.asic->options.user_queue.state.va = address;
+static void tlb_insert(struct umr_vm_ai_state *vm, struct umr_vm_reg_cache *set, uint64_t address,
+		       uint64_t offset_mask, uint64_t page_start_addr)
+{
+	struct umr_vm_tlb_entry *e;
+
+	if (!set || !get_tlb(vm->asic))
+		return;
+
+	e = &vm->asic->vm_tlb->entries[vm->asic->vm_tlb->next++ % UMR_VM_TLB_ENTRIES];
+	e->set = set;
+	e->base_addr = vm->page_table.page_table_base_addr;
+	e->start_addr = vm->page_table.page_table_start_addr;
+	e->va = address & ~offset_mask;
+	e->offset_mask = offset_mask;
+	e->pte_page_mask = vm->pte.pte_page_mask;
+	e->page_start_addr = page_start_addr;
+	e->pte_fields = vm->pte.pte_fields;
+	e->walk = vm->walk;
+}
+
+/* record a PDE of the current walk */
+static void walk_pde(struct umr_vm_ai_state *vm, uint64_t pde)
+{
+	if (vm->walk.levels < 8)
+		vm->walk.pde[vm->walk.levels++] = pde;
+}
+
+/*
+ * access_linear - Access a VMID 0 address that is not translated by
+ * the page table
+ */
+static int access_linear(struct umr_vm_ai_state *vm, uint64_t pa, uint32_t size, void *dst, int write_en)
+{
+	if (vm->xlate) {
+		vm->xlate->pa = pa;
+		vm->xlate->flags = UMR_VM_XLATE_VALID | UMR_VM_XLATE_LINEAR;
 	}
+	return (dst) ? umr_access_vram(vm->asic, vm->partition, UMR_LINEAR_HUB, pa, size, dst, write_en, NULL) : 0;
+}
 
-	// if we are capturing pagewalk data capture the inputs
-	if (vm.vmdata) {
-		vm.vmdata->va = address;
-		vm.vmdata->vmid = vmid;
+/**
+ * read_pt_entries - Read PDEs or PTEs through the page table block cache
+ *
+ * The 4KiB block holding the entries is read once and kept (LRU) so walks
+ * of neighbouring pages don't fetch the same block again.  If the block
+ * can't be read in one go the entries alone are read.  The @n entries
+ * must not cross a block (see pt_entries_left()).
+ */
+static int read_pt_entries(struct umr_vm_ai_state *vm, uint64_t addr, int sys, char *name, uint64_t *entries, uint32_t n)
+{
+	struct umr_vm_tlb *tlb;
+	struct umr_vm_pt_line *line, *victim;
+	uint64_t line_addr = addr & ~(uint64_t)(UMR_VM_PT_LINE_SIZE - 1);
+	uint32_t x;
+	int i;
+
+	// one at a time, only the entries themselves may be backed
+	if (vm->asic->mem_funcs.no_readahead) {
+		for (x = 0; x < n; x++)
+			if (access_translated_address(vm, addr + x * VM_PTB_ENTRY_SIZE, sys, name, &entries[x], VM_PTB_ENTRY_SIZE, 0) < 0)
+				return -1;
+		return 0;
+	}
+	if (!(tlb = get_tlb(vm->asic)))
+		return access_translated_address(vm, addr, sys, name, entries, n * VM_PTB_ENTRY_SIZE, 0);
+
+	victim = &tlb->pt[0];
+	for (i = 0; i < UMR_VM_PT_LINES; i++) {
+		line = &tlb->pt[i];
+		if (line->used && line->addr == line_addr && line->sys == sys && line->partition == vm->partition)
+			goto hit;
+		if (!line->used || (victim->used && line->last_use < victim->last_use))
+			victim = line;
+	}
+
+	line = victim;
+	line->used = 0;
+	if (access_translated_address(vm, line_addr, sys, NULL, line->data, UMR_VM_PT_LINE_SIZE, 0) < 0)
+		return access_translated_address(vm, addr, sys, name, entries, n * VM_PTB_ENTRY_SIZE, 0);
+	line->used = 1;
+	line->addr = line_addr;
+	line->sys = sys;
+	line->partition = vm->partition;
+hit:
+	line->last_use = ++tlb->pt_clock;
+	memcpy(entries, &line->data[addr - line_addr], n * VM_PTB_ENTRY_SIZE);
+	return 0;
+}
+
+static int read_pt_entry(struct umr_vm_ai_state *vm, uint64_t addr, int sys, char *name, uint64_t *entry)
+{
+	return read_pt_entries(vm, addr, sys, name, entry, 1);
+}
+
+/* how many entries from @addr on (at most @n) are in the same page table block */
+static uint32_t pt_entries_left(uint64_t addr, uint64_t n)
+{
+	uint64_t left = (UMR_VM_PT_LINE_SIZE - (addr & (UMR_VM_PT_LINE_SIZE - 1))) / VM_PTB_ENTRY_SIZE;
+
+	return (n < left) ? n : left;
+}
+
+/* drop cached page table blocks a write went to */
+static void pt_invalidate(struct umr_vm_ai_state *vm, uint64_t addr, int sys, uint32_t len)
+{
+	struct umr_vm_tlb *tlb = vm->asic->vm_tlb;
+	int i;
+
+	if (!tlb)
+		return;
+	for (i = 0; i < UMR_VM_PT_LINES; i++)
+		if (tlb->pt[i].used && tlb->pt[i].sys == sys &&
+		    tlb->pt[i].addr < addr + len && addr < tlb->pt[i].addr + UMR_VM_PT_LINE_SIZE)
+			tlb->pt[i].used = 0;
+}
+
+/**
+ * issue_runs - Read the runs queued by flush_run()
+ *
+ * With the io_uring backend all VRAM runs are submitted at once so the
+ * reads of many translated pages cost a single syscall.  Other runs
+ * (and everything if a submission fails) go through
+ * access_translated_address().
+ */
+static int issue_runs(struct umr_vm_ai_state *vm)
+{
+	struct umr_uring_op ops[VM_PENDING_RUNS];
+	int idx[VM_PENDING_RUNS];
+	int x, no_ops = 0, r = 0, use_uring;
+
+	use_uring = vm->asic->uring && vm->asic->fd.vram >= 0 &&
+		    vm->asic->mem_funcs.access_linear_vram == umr_access_linear_vram_uring &&
+		    !vm->asic->options.use_xgmi && !vm->vmctrl.zfb &&
+		    !(vm->asic->options.test_log && vm->asic->options.test_log_fd);
+
+	for (x = 0; x < vm->pending.n; x++) {
+		if (use_uring && !vm->pending.run[x].sys) {
+			ops[no_ops].fd = vm->asic->fd.vram;
+			ops[no_ops].write_en = 0;
+			ops[no_ops].offset = vm->pending.run[x].addr;
+			ops[no_ops].buf = vm->pending.run[x].dst;
+			ops[no_ops].len = vm->pending.run[x].len;
+			idx[no_ops++] = x;
+		} else if (access_translated_address(vm, vm->pending.run[x].addr, vm->pending.run[x].sys, "user page",
+						     vm->pending.run[x].dst, vm->pending.run[x].len, 0) < 0) {
+			r = -1;
+		}
+	}
+
+	if (no_ops && umr_uring_submit(vm->asic, ops, no_ops)) {
+		for (x = 0; x < no_ops; x++)
+			if (access_translated_address(vm, vm->pending.run[idx[x]].addr, 0, "user page",
+						      vm->pending.run[idx[x]].dst, vm->pending.run[idx[x]].len, 0) < 0)
+				r = -1;
 	}
 
+	vm->pending.n = 0;
+	return r;
+}
+
+/**
+ * flush_run - Access a run of pages that are contiguous in memory
+ *
+ * @len is the length of the run which is reset to 0 (even on failure).
+ * Reads are queued and issued by issue_runs() once VM_PENDING_RUNS are
+ * pending (or the access is complete), writes and user queue accesses
+ * are done right away.
+ */
+static int flush_run(struct umr_vm_ai_state *vm, uint64_t addr, int sys, void *dst, uint32_t *len, int write_en)
+{
+	int r = 0;
+
+	if (*len) {
+		// HMM backed user queue pages are read by the VA of the current run
+		if (write_en || vm->asic->options.user_queue.state.active) {
+			r = access_translated_address(vm, addr, sys, "user page", dst, *len, write_en);
+			if (!r)
+				pt_invalidate(vm, addr, sys, *len);
+		} else {
+			vm->pending.run[vm->pending.n].addr = addr;
+			vm->pending.run[vm->pending.n].len = *len;
+			vm->pending.run[vm->pending.n].sys = sys;
+			vm->pending.run[vm->pending.n].dst = dst;
+			if (++vm->pending.n == VM_PENDING_RUNS)
+				r = issue_runs(vm);
+		}
+		*len = 0;
+	}
+	return r;
+}
+
+/**
+ * umr_vm_tlb_flush - Forget all cached VM translations of a device
+ *
+ * This includes the cached page table blocks.  Translations are dropped by themselves if the page table base of the
+ * VM context changes, call this when the page tables themselves may have
+ * been updated (e.g. between unrelated requests of a long running tool).
+ */
+void umr_vm_tlb_flush(struct umr_asic *asic)
+{
+	free(asic->vm_tlb);
+	asic->vm_tlb = NULL;
+}
+
+/**
+ * umr_free_vm_reg_cache - Forget the VM registers resolved by umr_access_vram_ai()
+ */
+void umr_free_vm_reg_cache(struct umr_asic *asic)
+{
+	struct umr_vm_reg_cache *set, *next;
+
+	for (set = asic->vm_regs; set; set = next) {
+		next = set->next;
+		free(set);
+	}
+	asic->vm_regs = NULL;
+}
+
+/**
+ * struct vm_ai_hub - The hub a VM context was loaded from
+ *
+ * Carries the names needed to find further registers of the context
+ * once load_vm_context() has read it.
+ */
+struct vm_ai_hub {
+	unsigned hubid;
+	char *hub, *vm0prefix, *regprefix;
+	struct umr_vm_reg_cache *set;
+};
+
+/**
+ * load_vm_context - Read the registers describing a VM context
+ *
+ * @vm: The decoder state to fill in (asic, ip and partition must be set)
+ * @vmidp: The VMID with the hub selection in bits 8:15, on return the
+ *         hub bits are stripped
+ * @h: Receives the hub and register prefixes that were used
+ *
+ * Fills in the page table, vmctrl and register fields of @vm.
+ *
+ * Returns -1 if the hub is invalid.
+ */
+static int load_vm_context(struct umr_vm_ai_state *vm, uint32_t *vmidp, struct vm_ai_hub *h)
+{
+	char buf[64];
+	struct umr_reg *cntl;
+	struct umr_vm_reg_cache *set;
+	struct vm_cntl_fields tmp = { 0 };
+	const struct vm_cntl_fields *fields;
+	char *hub, *vm0prefix, *regprefix;
+	unsigned hubid;
+	uint32_t vmid = *vmidp;
+	int partition = vm->partition;
+
 	/*
 	 * figure out the register prefix, in newer hardware a MM or GC
 	 * prefix is added depending on which hub is being used.
@@ -695,148 +1228,237 @@ int umr_access_vram_ai(struct umr_asic *asic, int partition,
 	switch (hubid) {
 		case UMR_MM_VC0:
 			hub = "mmhub";
-			if (vm.asic->family == FAMILY_AI) {
+			if (vm->asic->family == FAMILY_AI) {
 				regprefix = "VML2VC0_";
 				vm0prefix = "VMSHAREDVC0_";
 			}
 			break;
 		case UMR_MM_VC1:
 			hub = "mmhub";
-			if (vm.asic->family == FAMILY_AI) {
+			if (vm->asic->family == FAMILY_AI) {
 				regprefix = "VML2VC1_";
 				vm0prefix = "VMSHAREDVC1_";
 			}
 			break;
 		case UMR_MM_HUB:
 			hub = "mmhub";
-			if (vm.asic->family >= FAMILY_NV)
+			if (vm->asic->family >= FAMILY_NV)
 				vm0prefix = regprefix = "MM";
 			break;
 		case UMR_GFX_HUB:
 			hub = "gfx";
-			if (vm.asic->family >= FAMILY_NV)
+			if (vm->asic->family >= FAMILY_NV)
 				vm0prefix = regprefix = "GC";
 			break;
 		case UMR_USER_HUB:
-			hub = vm.asic->options.hub_name;
+			hub = vm->asic->options.hub_name;
 			break;
 		default:
-			vm.asic->mem_funcs.vm_message("[ERROR]: Invalid hub specified in umr_read_vram_ai()\n");
+			vm->asic->mem_funcs.vm_message("[ERROR]: Invalid hub specified in umr_read_vram_ai()\n");
 			return -1;
 	}
 
+	// NULL (out of memory) just means every register is searched for by name
+	set = find_vm_regs(vm->asic, hubid, hub, partition, vmid);
+	memset(&vm->prefetch, 0, sizeof vm->prefetch);
+	if (set)
+		prefetch_vm_regs(vm, set, hub, vm0prefix, regprefix, vmid);
+
 	/* read vm registers */
-	if (vm.asic->options.user_queue.state.active == 0 && vmid == 0) {
+	if (vm->asic->options.user_queue.state.active == 0 && vmid == 0) {
 		/* only need system aperture registers (SAM) if we're using VMID 0 */
-		sprintf(buf, "mm%sMC_VM_SYSTEM_APERTURE_HIGH_ADDR", vm0prefix);
-			vm.registers.mmMC_VM_SYSTEM_APERTURE_HIGH_ADDR = umr_read_reg_by_name_by_ip_by_instance(vm.asic, hub, partition, buf);
-		sprintf(buf, "mm%sMC_VM_SYSTEM_APERTURE_LOW_ADDR", vm0prefix);
-			vm.registers.mmMC_VM_SYSTEM_APERTURE_LOW_ADDR = umr_read_reg_by_name_by_ip_by_instance(vm.asic, hub, partition, buf);
-		vm.vmctrl.system_aperture_low = ((uint64_t)vm.registers.mmMC_VM_SYSTEM_APERTURE_LOW_ADDR) << VM_SYSTEM_APERTURE_SHIFT;
-		vm.vmctrl.system_aperture_high = ((uint64_t)vm.registers.mmMC_VM_SYSTEM_APERTURE_HIGH_ADDR + 1) << VM_SYSTEM_APERTURE_SHIFT;
-		sprintf(buf, "mm%sMC_VM_MX_L1_TLB_CNTL", vm0prefix);
-			vm.registers.mmMC_VM_MX_L1_TLB_CNTL = umr_read_reg_by_name_by_ip_by_instance(vm.asic, hub, partition, buf);
+		vm->registers.mmMC_VM_SYSTEM_APERTURE_HIGH_ADDR = read_vm_reg(vm, set, VMR_SYSTEM_APERTURE_HIGH_ADDR, hub, vm0prefix, regprefix, vmid);
+		vm->registers.mmMC_VM_SYSTEM_APERTURE_LOW_ADDR = read_vm_reg(vm, set, VMR_SYSTEM_APERTURE_LOW_ADDR, hub, vm0prefix, regprefix, vmid);
+		vm->vmctrl.system_aperture_low = ((uint64_t)vm->registers.mmMC_VM_SYSTEM_APERTURE_LOW_ADDR) << VM_SYSTEM_APERTURE_SHIFT;
+		vm->vmctrl.system_aperture_high = ((uint64_t)vm->registers.mmMC_VM_SYSTEM_APERTURE_HIGH_ADDR + 1) << VM_SYSTEM_APERTURE_SHIFT;
+		vm->registers.mmMC_VM_MX_L1_TLB_CNTL = read_vm_reg(vm, set, VMR_MX_L1_TLB_CNTL, hub, vm0prefix, regprefix, vmid);
 	}
 
-	sprintf(buf, "mm%sMC_VM_FB_LOCATION_BASE", vm0prefix);
-		vm.registers.mmMC_VM_FB_LOCATION_BASE = umr_read_reg_by_name_by_ip_by_instance(vm.asic, hub, partition, buf);
-		vm.vmctrl.fb_bottom = ((uint64_t)vm.registers.mmMC_VM_FB_LOCATION_BASE) << VM_FB_OFFSET_SHIFT;
-	sprintf(buf, "mm%sMC_VM_FB_LOCATION_TOP", vm0prefix);
-		vm.registers.mmMC_VM_FB_LOCATION_TOP = umr_read_reg_by_name_by_ip_by_instance(vm.asic, hub, partition, buf);
-		vm.vmctrl.fb_top = ((uint64_t)vm.registers.mmMC_VM_FB_LOCATION_TOP + 1) << VM_FB_OFFSET_SHIFT;
+	vm->registers.mmMC_VM_FB_LOCATION_BASE = read_vm_reg(vm, set, VMR_FB_LOCATION_BASE, hub, vm0prefix, regprefix, vmid);
+		vm->vmctrl.fb_bottom = ((uint64_t)vm->registers.mmMC_VM_FB_LOCATION_BASE) << VM_FB_OFFSET_SHIFT;
+	vm->registers.mmMC_VM_FB_LOCATION_TOP = read_vm_reg(vm, set, VMR_FB_LOCATION_TOP, hub, vm0prefix, regprefix, vmid);
+		vm->vmctrl.fb_top = ((uint64_t)vm->registers.mmMC_VM_FB_LOCATION_TOP + 1) << VM_FB_OFFSET_SHIFT;
 
 	/* check if we are in ZFB mode */
-	if (vm.vmctrl.fb_top < vm.vmctrl.fb_bottom) {
-		vm.vmctrl.zfb = 1;
+	if (vm->vmctrl.fb_top < vm->vmctrl.fb_bottom) {
+		vm->vmctrl.zfb = 1;
 	} else {
-		vm.vmctrl.zfb = 0;
+		vm->vmctrl.zfb = 0;
 	}
 
-	if (vm.vmctrl.zfb) {
-		sprintf(buf, "mm%sMC_VM_AGP_BASE", regprefix);
-			vm.registers.mmMC_VM_AGP_BASE = umr_read_reg_by_name_by_ip_by_instance(vm.asic, hub, partition, buf);
-			vm.vmctrl.agp_base = ((uint64_t)vm.registers.mmMC_VM_AGP_BASE) << VM_FB_OFFSET_SHIFT;
-		sprintf(buf, "mm%sMC_VM_AGP_BOT", regprefix);
-			vm.registers.mmMC_VM_AGP_BOT = umr_read_reg_by_name_by_ip_by_instance(vm.asic, hub, partition, buf);
-			vm.vmctrl.agp_bot = ((uint64_t)vm.registers.mmMC_VM_AGP_BOT) << VM_FB_OFFSET_SHIFT;
-		sprintf(buf, "mm%sMC_VM_AGP_TOP", regprefix);
-			vm.registers.mmMC_VM_AGP_TOP = umr_read_reg_by_name_by_ip_by_instance(vm.asic, hub, partition, buf);
-			vm.vmctrl.agp_top = (((uint64_t)vm.registers.mmMC_VM_AGP_TOP + 1) << VM_FB_OFFSET_SHIFT) | 0xFFFFFFULL;
+	if (vm->vmctrl.zfb) {
+		vm->registers.mmMC_VM_AGP_BASE = read_vm_reg(vm, set, VMR_AGP_BASE, hub, vm0prefix, regprefix, vmid);
+			vm->vmctrl.agp_base = ((uint64_t)vm->registers.mmMC_VM_AGP_BASE) << VM_FB_OFFSET_SHIFT;
+		vm->registers.mmMC_VM_AGP_BOT = read_vm_reg(vm, set, VMR_AGP_BOT, hub, vm0prefix, regprefix, vmid);
+			vm->vmctrl.agp_bot = ((uint64_t)vm->registers.mmMC_VM_AGP_BOT) << VM_FB_OFFSET_SHIFT;
+		vm->registers.mmMC_VM_AGP_TOP = read_vm_reg(vm, set, VMR_AGP_TOP, hub, vm0prefix, regprefix, vmid);
+			vm->vmctrl.agp_top = (((uint64_t)vm->registers.mmMC_VM_AGP_TOP + 1) << VM_FB_OFFSET_SHIFT) | 0xFFFFFFULL;
 	} else {
-		vm.vmctrl.agp_base = vm.vmctrl.agp_bot = vm.vmctrl.agp_top = 0;
+		vm->vmctrl.agp_base = vm->vmctrl.agp_bot = vm->vmctrl.agp_top = 0;
 	}
 
 	/* initialize local copy of context registers */
-		if (vm.asic->options.user_queue.state.active) {
+		if (vm->asic->options.user_queue.state.active) {
 			/* If we are bound to a client space (e.g., --user-queue) for a user queue let's copy from that structure */
-			vm.registers.mmVM_CONTEXTx_PAGE_TABLE_START_ADDR_LO32 = vm.asic->options.user_queue.state.registers.PAGE_TABLE_START_ADDR_LO32;
-			vm.registers.mmVM_CONTEXTx_PAGE_TABLE_START_ADDR_HI32 = vm.asic->options.user_queue.state.registers.PAGE_TABLE_START_ADDR_HI32;
-			vm.registers.mmVM_CONTEXTx_PAGE_TABLE_END_ADDR_LO32 = vm.asic->options.user_queue.state.registers.PAGE_TABLE_END_ADDR_LO32;
-			vm.registers.mmVM_CONTEXTx_PAGE_TABLE_END_ADDR_HI32 = vm.asic->options.user_queue.state.registers.PAGE_TABLE_END_ADDR_HI32;
-			vm.registers.mmVM_CONTEXTx_PAGE_TABLE_BASE_ADDR_LO32 = vm.asic->options.user_queue.state.registers.PAGE_TABLE_BASE_ADDR_LO32;
-			vm.registers.mmVM_CONTEXTx_PAGE_TABLE_BASE_ADDR_HI32 = vm.asic->options.user_queue.state.registers.PAGE_TABLE_BASE_ADDR_HI32;
-			vm.page_table.page_table_depth = vm.asic->options.user_queue.client_info.vm_pagetable_info.num_level;
-			vm.page_table.page_table_block_size = vm.asic->options.user_queue.client_info.vm_pagetable_info.block_size - VM_PDB_ENTRY_BITS; /* 0 == 9-bit block size */
+			vm->registers.mmVM_CONTEXTx_PAGE_TABLE_START_ADDR_LO32 = vm->asic->options.user_queue.state.registers.PAGE_TABLE_START_ADDR_LO32;
+			vm->registers.mmVM_CONTEXTx_PAGE_TABLE_START_ADDR_HI32 = vm->asic->options.user_queue.state.registers.PAGE_TABLE_START_ADDR_HI32;
+			vm->registers.mmVM_CONTEXTx_PAGE_TABLE_END_ADDR_LO32 = vm->asic->options.user_queue.state.registers.PAGE_TABLE_END_ADDR_LO32;
+			vm->registers.mmVM_CONTEXTx_PAGE_TABLE_END_ADDR_HI32 = vm->asic->options.user_queue.state.registers.PAGE_TABLE_END_ADDR_HI32;
+			vm->registers.mmVM_CONTEXTx_PAGE_TABLE_BASE_ADDR_LO32 = vm->asic->options.user_queue.state.registers.PAGE_TABLE_BASE_ADDR_LO32;
+			vm->registers.mmVM_CONTEXTx_PAGE_TABLE_BASE_ADDR_HI32 = vm->asic->options.user_queue.state.registers.PAGE_TABLE_BASE_ADDR_HI32;
+			vm->page_table.page_table_depth = vm->asic->options.user_queue.client_info.vm_pagetable_info.num_level;
+			vm->page_table.page_table_block_size = vm->asic->options.user_queue.client_info.vm_pagetable_info.block_size - VM_PDB_ENTRY_BITS; /* 0 == 9-bit block size */
 
 			/* we aren't using VMIDs but we still need to get the layout of the register so we just jam VMID 8 in there... */
 			sprintf(buf, "mm%sVM_CONTEXT%" PRIu32 "_CNTL", regprefix, 8);
-			vm.registers.mmVM_CONTEXTx_CNTL =
-				umr_bitslice_compose_value_by_name_by_ip_by_instance(vm.asic, hub, partition, buf, "PAGE_TABLE_DEPTH", vm.page_table.page_table_depth) |
-				umr_bitslice_compose_value_by_name_by_ip_by_instance(vm.asic, hub, partition, buf, "PAGE_TABLE_BLOCK_SIZE", vm.page_table.page_table_block_size);
+			vm->registers.mmVM_CONTEXTx_CNTL =
+				umr_bitslice_compose_value_by_name_by_ip_by_instance(vm->asic, hub, partition, buf, "PAGE_TABLE_DEPTH", vm->page_table.page_table_depth) |
+				umr_bitslice_compose_value_by_name_by_ip_by_instance(vm->asic, hub, partition, buf, "PAGE_TABLE_BLOCK_SIZE", vm->page_table.page_table_block_size);
 		} else {
 			/* we're not bound to a client space so let's read the context registers from MMIO space */
-			sprintf(buf, "mm%sVM_CONTEXT%" PRIu32 "_PAGE_TABLE_START_ADDR_LO32", regprefix, vmid);
-				vm.registers.mmVM_CONTEXTx_PAGE_TABLE_START_ADDR_LO32 = umr_read_reg_by_name_by_ip_by_instance(vm.asic, hub, partition, buf);
-			sprintf(buf, "mm%sVM_CONTEXT%" PRIu32 "_PAGE_TABLE_START_ADDR_HI32", regprefix, vmid);
-				vm.registers.mmVM_CONTEXTx_PAGE_TABLE_START_ADDR_HI32 = umr_read_reg_by_name_by_ip_by_instance(vm.asic, hub, partition, buf);
-			sprintf(buf, "mm%sVM_CONTEXT%" PRIu32 "_PAGE_TABLE_END_ADDR_LO32", regprefix, vmid);
-				vm.registers.mmVM_CONTEXTx_PAGE_TABLE_END_ADDR_LO32 = umr_read_reg_by_name_by_ip_by_instance(vm.asic, hub, partition, buf);
-			sprintf(buf, "mm%sVM_CONTEXT%" PRIu32 "_PAGE_TABLE_END_ADDR_HI32", regprefix, vmid);
-				vm.registers.mmVM_CONTEXTx_PAGE_TABLE_END_ADDR_HI32 = umr_read_reg_by_name_by_ip_by_instance(vm.asic, hub, partition, buf);
-			sprintf(buf, "mm%sVM_CONTEXT%" PRIu32 "_CNTL", regprefix, vmid);
-				vm.registers.mmVM_CONTEXTx_CNTL = umr_read_reg_by_name_by_ip_by_instance(vm.asic, hub, partition, buf);
-				vm.page_table.page_table_depth      = umr_bitslice_reg_by_name_by_ip_by_instance(vm.asic, hub, partition, buf, "PAGE_TABLE_DEPTH", vm.registers.mmVM_CONTEXTx_CNTL);
-				vm.page_table.page_table_block_size = umr_bitslice_reg_by_name_by_ip_by_instance(vm.asic, hub, partition, buf, "PAGE_TABLE_BLOCK_SIZE", vm.registers.mmVM_CONTEXTx_CNTL);
-			sprintf(buf, "mm%sVM_CONTEXT%" PRIu32 "_PAGE_TABLE_BASE_ADDR_LO32", regprefix, vmid);
-				vm.registers.mmVM_CONTEXTx_PAGE_TABLE_BASE_ADDR_LO32 = umr_read_reg_by_name_by_ip_by_instance(vm.asic, hub, partition, buf);
-			sprintf(buf, "mm%sVM_CONTEXT%" PRIu32 "_PAGE_TABLE_BASE_ADDR_HI32", regprefix, vmid);
-				vm.registers.mmVM_CONTEXTx_PAGE_TABLE_BASE_ADDR_HI32 = umr_read_reg_by_name_by_ip_by_instance(vm.asic, hub, partition, buf);
+			vm->registers.mmVM_CONTEXTx_PAGE_TABLE_START_ADDR_LO32 = read_vm_reg(vm, set, VMR_PAGE_TABLE_START_ADDR_LO32, hub, vm0prefix, regprefix, vmid);
+			vm->registers.mmVM_CONTEXTx_PAGE_TABLE_START_ADDR_HI32 = read_vm_reg(vm, set, VMR_PAGE_TABLE_START_ADDR_HI32, hub, vm0prefix, regprefix, vmid);
+			vm->registers.mmVM_CONTEXTx_PAGE_TABLE_END_ADDR_LO32 = read_vm_reg(vm, set, VMR_PAGE_TABLE_END_ADDR_LO32, hub, vm0prefix, regprefix, vmid);
+			vm->registers.mmVM_CONTEXTx_PAGE_TABLE_END_ADDR_HI32 = read_vm_reg(vm, set, VMR_PAGE_TABLE_END_ADDR_HI32, hub, vm0prefix, regprefix, vmid);
+			cntl = vm_reg(vm, set, VMR_CONTEXT_CNTL, hub, vm0prefix, regprefix, vmid);
+			if (cntl) {
+				vm->registers.mmVM_CONTEXTx_CNTL = read_vm_reg(vm, set, VMR_CONTEXT_CNTL, hub, vm0prefix, regprefix, vmid);
+				fields = vm_cntl_fields(vm->asic, set, cntl, &tmp);
+				if (fields->have_depth)
+					vm->page_table.page_table_depth = umr_field_get(&fields->depth, vm->registers.mmVM_CONTEXTx_CNTL);
+				if (fields->have_block_size)
+					vm->page_table.page_table_block_size = umr_field_get(&fields->block_size, vm->registers.mmVM_CONTEXTx_CNTL);
+			}
+			vm->registers.mmVM_CONTEXTx_PAGE_TABLE_BASE_ADDR_LO32 = read_vm_reg(vm, set, VMR_PAGE_TABLE_BASE_ADDR_LO32, hub, vm0prefix, regprefix, vmid);
+			vm->registers.mmVM_CONTEXTx_PAGE_TABLE_BASE_ADDR_HI32 = read_vm_reg(vm, set, VMR_PAGE_TABLE_BASE_ADDR_HI32, hub, vm0prefix, regprefix, vmid);
 		}
 
-	if (vm.vmdata) {
-		vm.vmdata->page_table_depth = vm.page_table.page_table_depth;
-		vm.vmdata->page_table_block_size = vm.page_table.page_table_block_size;
+	if (vm->vmdata) {
+		vm->vmdata->page_table_depth = vm->page_table.page_table_depth;
+		vm->vmdata->page_table_block_size = vm->page_table.page_table_block_size;
 	}
 
 	/* setup all the state variables. */
-		vm.page_table.page_table_start_addr = (uint64_t)vm.registers.mmVM_CONTEXTx_PAGE_TABLE_START_ADDR_LO32 << VM_PAGE_TABLE_ADDR_LO32_SHIFT;
-		vm.page_table.page_table_start_addr |= (uint64_t)vm.registers.mmVM_CONTEXTx_PAGE_TABLE_START_ADDR_HI32 << VM_PAGE_TABLE_ADDR_HI32_SHIFT;
-		vm.page_table.page_table_end_addr = (uint64_t)vm.registers.mmVM_CONTEXTx_PAGE_TABLE_END_ADDR_LO32 << VM_PAGE_TABLE_ADDR_LO32_SHIFT;
-		vm.page_table.page_table_end_addr |= (uint64_t)vm.registers.mmVM_CONTEXTx_PAGE_TABLE_END_ADDR_HI32 << VM_PAGE_TABLE_ADDR_HI32_SHIFT;
-		vm.page_table.page_table_base_addr  = (uint64_t)vm.registers.mmVM_CONTEXTx_PAGE_TABLE_BASE_ADDR_LO32 << 0;
-		vm.page_table.page_table_base_addr  |= (uint64_t)vm.registers.mmVM_CONTEXTx_PAGE_TABLE_BASE_ADDR_HI32 << 32;
+		vm->page_table.page_table_start_addr = (uint64_t)vm->registers.mmVM_CONTEXTx_PAGE_TABLE_START_ADDR_LO32 << VM_PAGE_TABLE_ADDR_LO32_SHIFT;
+		vm->page_table.page_table_start_addr |= (uint64_t)vm->registers.mmVM_CONTEXTx_PAGE_TABLE_START_ADDR_HI32 << VM_PAGE_TABLE_ADDR_HI32_SHIFT;
+		vm->page_table.page_table_end_addr = (uint64_t)vm->registers.mmVM_CONTEXTx_PAGE_TABLE_END_ADDR_LO32 << VM_PAGE_TABLE_ADDR_LO32_SHIFT;
+		vm->page_table.page_table_end_addr |= (uint64_t)vm->registers.mmVM_CONTEXTx_PAGE_TABLE_END_ADDR_HI32 << VM_PAGE_TABLE_ADDR_HI32_SHIFT;
+		vm->page_table.page_table_base_addr  = (uint64_t)vm->registers.mmVM_CONTEXTx_PAGE_TABLE_BASE_ADDR_LO32 << 0;
+		vm->page_table.page_table_base_addr  |= (uint64_t)vm->registers.mmVM_CONTEXTx_PAGE_TABLE_BASE_ADDR_HI32 << 32;
 
 	/*
 	 * for some firmwares when in GFXOFF power off state the registers
 	 * read back as all F's
 	 */
-	if (vm.page_table.page_table_base_addr == 0xFFFFFFFFFFFFFFFFULL) {
-		vm.asic->mem_funcs.vm_message(
+	if (vm->page_table.page_table_base_addr == 0xFFFFFFFFFFFFFFFFULL) {
+		vm->asic->mem_funcs.vm_message(
 			"PAGE_TABLE_BASE_ADDRESS read as all F's likely indicates that the ASIC is powered off (possibly via gfxoff)\n"
 			"On GFX 10+ parts with gfxoff enabled a hang can occur, please disable with '--gfxoff 0'\n");
 	}
 
 	/* update addresses for APUs */
-	if (vm.asic->is_apu) {
-		if (umr_find_reg(vm.asic, "@mmVGA_MEMORY_BASE_ADDRESS") != 0xFFFFFFFF) {
-			vm.registers.mmVGA_MEMORY_BASE_ADDRESS = umr_read_reg_by_name(vm.asic, "mmVGA_MEMORY_BASE_ADDRESS");
-			vm.registers.mmVGA_MEMORY_BASE_ADDRESS_HIGH = umr_read_reg_by_name(vm.asic, "mmVGA_MEMORY_BASE_ADDRESS_HIGH");
+	if (vm->asic->is_apu) {
+		if (vm_reg(vm, set, VMR_VGA_MEMORY_BASE_ADDRESS, hub, vm0prefix, regprefix, vmid)) {
+			vm->registers.mmVGA_MEMORY_BASE_ADDRESS = read_vm_reg(vm, set, VMR_VGA_MEMORY_BASE_ADDRESS, hub, vm0prefix, regprefix, vmid);
+			vm->registers.mmVGA_MEMORY_BASE_ADDRESS_HIGH = read_vm_reg(vm, set, VMR_VGA_MEMORY_BASE_ADDRESS_HIGH, hub, vm0prefix, regprefix, vmid);
 		}
 	}
 
-	sprintf(buf, "mm%sMC_VM_FB_OFFSET", regprefix);
-		vm.registers.mmMC_VM_FB_OFFSET = umr_read_reg_by_name_by_ip_by_instance(vm.asic, hub, partition, buf);
-		vm.vmctrl.vm_fb_offset      = (uint64_t)vm.registers.mmMC_VM_FB_OFFSET << VM_FB_OFFSET_SHIFT;
+	vm->registers.mmMC_VM_FB_OFFSET = read_vm_reg(vm, set, VMR_FB_OFFSET, hub, vm0prefix, regprefix, vmid);
+		vm->vmctrl.vm_fb_offset      = (uint64_t)vm->registers.mmMC_VM_FB_OFFSET << VM_FB_OFFSET_SHIFT;
+
+	*vmidp = vmid;
+	h->hubid = hubid;
+	h->hub = hub;
+	h->vm0prefix = vm0prefix;
+	h->regprefix = regprefix;
+	h->set = set;
+	return 0;
+}
+
+/**
+ * @brief Access GPU mapped memory for GFX9+ platforms
+ *
+ * This function is responsible for accessing GPU-mapped memory on AMD GPUs with GFX9 and later architectures.
+ * It handles virtual to physical address translation using page tables, which may span multiple levels depending on the configuration.
+ *
+ * @param asic Pointer to the UMR ASIC structure representing the GPU.
+ * @param partition The VM partition to be used (refers to different INST of VM register blocks).
+ * @param vmid The VMID that the address belongs to. Bits 8:15 indicate which hub the memory belongs to:
+ *             - UMR_LINEAR_HUB: The memory is a physical address in VRAM.
+ *             - UMR_GFX_HUB: The memory is a virtual address controlled by the GFX hub.
+ *             - UMR_MM_HUB: The memory is a virtual address controlled by the MM hub.
+ *             Bits 0:7 indicate which VM to access (if any).
+ * @param address The address of the memory to access, must be word aligned.
+ * @param size The number of bytes to read or write.
+ * @param dst Pointer to the buffer to read from/write to.
+ * @param write_en Set to 0 to read, non-zero to write.
+ * @param vmdata Optional pointer to a structure for capturing page walk data.
+ * @param xlate Optional translation of the first page, errors of the walk are not printed for it.
+ *
+ * @return Returns 0 on success, -1 on error.
+ *
+ * @details
+ * The function performs the following steps:
+ * 1. Reads various VM context registers to determine the configuration of the page tables.
+ * 2. Decodes the virtual address using the page table hierarchy (PDBs and PTBs) based on the PAGE_TABLE_DEPTH and PAGE_TABLE_BLOCK_SIZE settings.
+ * 3. Handles different cases for PDEs and PTEs, including when a PDE acts as a PTE (further bit set).
+ * 4. Translates the virtual address to a physical address using the decoded page table entries.
+ * 5. Reads from or writes to the computed physical address in VRAM or system memory based on the PTE settings.
+ * 6. Captures detailed information about the page walk process if `vmdata` is provided, which can be useful for debugging and analysis.
+ */
+static int access_vram_ai(struct umr_asic *asic, int partition,
+			  uint32_t vmid, uint64_t address, uint32_t size,
+			  void *dst, int write_en, struct umr_vm_pagewalk *vmdata,
+			  struct umr_vm_translation *xlate)
+{
+	struct umr_vm_ai_state vm;
+	uint64_t start_addr, va_mask, offset_mask = 0, page_start_addr, page_end_addr;
+	struct umr_vm_tlb_entry *tlbe;
+	int use_tlb;
+	uint64_t run_addr = 0;
+	uint32_t run_len = 0;
+	int run_sys = 0;
+	unsigned char *run_dst = NULL;
+	uint32_t chunk_size;
+	int current_depth;
+
+	struct umr_vm_reg_cache *set;
+	struct vm_ai_hub h;
+	unsigned char *pdst = dst;
+	char *hub, *vm0prefix, *regprefix;
+	static const char *indentation = "                  \\->";
+
+	memset(&vm, 0, sizeof vm);
+	vm.asic = asic;
+	vm.vmdata = vmdata;
+	vm.xlate = xlate;
+	vm.partition = partition;
+	vm.ip = umr_find_ip_block(vm.asic, "gfx", vm.asic->options.vm_partition);
+	if (!vm.ip) {
+		vm.asic->mem_funcs.vm_message("[BUG]: Cannot find a 'gfx' IP block in this ASIC\n");
+		return -1;
+	}
+	umr_vm_pte_decoder(vm.ip->discoverable.maj, vm.ip->discoverable.min, &vm.dec);
+	umr_vm_pde_decoder(vm.ip->discoverable.maj, vm.ip->discoverable.min, &vm.dec);
+
+	// if we are using user queues then save the VA in case we are using rumr
+	if (vm.asic->options.user_queue.state.active) {
+		vm.asic->options.user_queue.state.va = address;
+	}
+
+	// if we are capturing pagewalk data capture the inputs
+	if (vm.vmdata) {
+		vm.vmdata->va = address;
+		vm.vmdata->vmid = vmid;
+	}
+
+	if (load_vm_context(&vm, &vmid, &h) < 0)
+		return -1;
+	hub = h.hub;
+	vm0prefix = h.vm0prefix;
+	regprefix = h.regprefix;
+	set = h.set;
 
 	if (vm.asic->options.verbose) {
 		if (vm.asic->options.user_queue.state.active) {
@@ -897,7 +1519,7 @@ int umr_access_vram_ai(struct umr_asic *asic, int partition,
 	 * the PAGE_TABLE_BASE_ADDR_* registers form the first level
 	 * PDE value.  It is not read from a Page Directory Block (PDB)
 	 */
-	vm.pde.pde_fields = umr_decode_pde_entry(vm.asic, vm.page_table.page_table_base_addr);
+	vm.pde.pde_fields = vm.dec.pde(vm.page_table.page_table_base_addr);
 	if (!vm.pde.pde_fields.system) {
 		/* transform page_table_base (only if first PDB or the PTB is in VRAM) */
 		vm.page_table.page_table_base_addr -= vm.vmctrl.vm_fb_offset;
@@ -908,23 +1530,25 @@ int umr_access_vram_ai(struct umr_asic *asic, int partition,
 	 * as specified by the System Aperature registers
 	 */
 	if (vm.asic->options.user_queue.state.active == 0 && vmid == 0) {
-		uint32_t sam;
+		struct umr_reg *tlb_cntl;
+		uint32_t sam = 0;
 
-		sprintf(buf, "mm%sMC_VM_MX_L1_TLB_CNTL", vm0prefix);
-		sam = umr_bitslice_reg_by_name_by_ip_by_instance(vm.asic, hub, partition, buf, "SYSTEM_ACCESS_MODE", vm.registers.mmMC_VM_MX_L1_TLB_CNTL);
+		tlb_cntl = vm_reg(&vm, set, VMR_MX_L1_TLB_CNTL, hub, vm0prefix, regprefix, vmid);
+		if (tlb_cntl)
+			sam = umr_bitslice_reg(vm.asic, tlb_cntl, "SYSTEM_ACCESS_MODE", vm.registers.mmMC_VM_MX_L1_TLB_CNTL);
 
 		/* addresses in VMID0 need special handling w.r.t. PAGE_TABLE_START_ADDR */
 		switch (sam) {
 			case VM_SAM_PHYSICAL: /* physical access */
-				return (dst) ? umr_access_vram(vm.asic, partition, UMR_LINEAR_HUB, address, size, dst, write_en, NULL) : 0;
+				return access_linear(&vm, address, size, dst, write_en);
 			case VM_SAM_ALWAYS_VM: /* always VM access */
 				break;
 			case VM_SAM_INSIDE_MAPPED: /* inside system aperture is mapped, otherwise unmapped */
 				if (!(address >= vm.vmctrl.system_aperture_low && address < vm.vmctrl.system_aperture_high)) {
 					if (address >= vm.vmctrl.fb_bottom && address < vm.vmctrl.fb_top) {
-						return (dst) ? umr_access_vram(vm.asic, partition, UMR_LINEAR_HUB, address - vm.vmctrl.fb_bottom, size, dst, write_en, NULL) : 0;
+						return access_linear(&vm, address - vm.vmctrl.fb_bottom, size, dst, write_en);
 					} else {
-						return (dst) ? umr_access_vram(vm.asic, partition, UMR_LINEAR_HUB, address, size, dst, write_en, NULL) : 0;
+						return access_linear(&vm, address, size, dst, write_en);
 					}
 				}
 				break;
@@ -933,9 +1557,9 @@ int umr_access_vram_ai(struct umr_asic *asic, int partition,
 					if (vm.asic->options.verbose)
 						vm.asic->std_msg("[VERBOSE]: Address is inside SAM\n[VERBOSE]: address: 0x%"PRIx64 ", system_apperture_low: 0x%"PRIx64 ", system_aperture_high: 0x%"PRIx64 ", fb_bottom: 0x%"PRIx64  ", fb_top: 0x%"PRIx64 "\n", address, vm.vmctrl.system_aperture_low, vm.vmctrl.system_aperture_high, vm.vmctrl.fb_bottom, vm.vmctrl.fb_top);
 					if (address >= vm.vmctrl.fb_bottom && address < vm.vmctrl.fb_top) {
-						return (dst) ? umr_access_vram(vm.asic, partition, UMR_LINEAR_HUB, address - vm.vmctrl.fb_bottom, size, dst, write_en, NULL) : 0;
+						return access_linear(&vm, address - vm.vmctrl.fb_bottom, size, dst, write_en);
 					} else {
-						return (dst) ? umr_access_vram(vm.asic, partition, UMR_LINEAR_HUB, address, size, dst, write_en, NULL) : 0;
+						return access_linear(&vm, address, size, dst, write_en);
 					}
 				}
 				break;
@@ -947,8 +1571,9 @@ int umr_access_vram_ai(struct umr_asic *asic, int partition,
 
 	/* Addresses after this point should be virtual and within the span of the root page table. */
 	if (address < vm.page_table.page_table_start_addr || address > (vm.page_table.page_table_end_addr + VM_PAGE_OFFSET_MASK)) {
-		vm.asic->mem_funcs.vm_message("[ERROR]: Address %u@%" PRIx64 " is not in range of memory spanned by root page table of VM context\n",
-								   vmid, address);
+		if (!vm.xlate)
+			vm.asic->mem_funcs.vm_message("[ERROR]: Address %u@%" PRIx64 " is not in range of memory spanned by root page table of VM context\n",
+									   vmid, address);
 		return -1;
 	}
 
@@ -959,8 +1584,23 @@ int umr_access_vram_ai(struct umr_asic *asic, int partition,
 	*/
 	address -= vm.page_table.page_table_start_addr;
 
+	/* the page walk has to be done when it is being printed or captured */
+	use_tlb = !vm.asic->options.verbose && !vm.vmdata && !vm.asic->mem_funcs.va_addr_decode;
+
 	do { /* for all pages being accessed ... */
 
+		if (use_tlb && (tlbe = tlb_lookup(&vm, set, address))) {
+			vm.pte.pte_fields = tlbe->pte_fields;
+			vm.pte.pte_page_mask = tlbe->pte_page_mask;
+			offset_mask = tlbe->offset_mask;
+			page_start_addr = tlbe->page_start_addr;
+			start_addr = page_start_addr + (address & offset_mask);
+			vm.walk = tlbe->walk;
+			vm.walk.va = address + vm.page_table.page_table_start_addr;
+			vm.walk.pa = start_addr;
+			goto have_page;
+		}
+
 		/* reset the VA tally used to incrementally print out how much of the VA was consumed
 		 * at every level of the translation.
 		 */
@@ -968,6 +1608,9 @@ int umr_access_vram_ai(struct umr_asic *asic, int partition,
 
 		/* the first PDE is the PAGE_TABLE_BASE_ADDR_* registers */
 		vm.pde.pde_entry = vm.page_table.page_table_base_addr;
+		memset(&vm.walk, 0, sizeof vm.walk);
+		vm.walk.va = address + vm.page_table.page_table_start_addr;
+		walk_pde(&vm, vm.pde.pde_entry);
 
 		// defaults in case we have to bail out before fully decoding to a PTE
 		memset(&vm.pte, 0, sizeof vm.pte);
@@ -978,7 +1621,7 @@ int umr_access_vram_ai(struct umr_asic *asic, int partition,
 		vm.pde.pde_was_pte = 0;
 
 		// decode the first PDE into it's component fields
-		vm.pde.pde_fields = umr_decode_pde_entry(vm.asic, vm.pde.pde_entry);
+		vm.pde.pde_fields = vm.dec.pde(vm.pde.pde_entry);
 
 		// The address of the next PDB/PTB is specified by the
 		// page base address field of PDE's
@@ -1040,10 +1683,10 @@ int umr_access_vram_ai(struct umr_asic *asic, int partition,
 			/* read PDE entry from the PDE base address + PDE selector * 8
 			* (Note: VM_PTB_ENTRY_SIZE works for both PTEs and PDEs as both are 8 bytes) */
 			vm.pde.addr = vm.pde.pde_address + vm.pde.pde_idx * VM_PTB_ENTRY_SIZE;
-			if (access_translated_address(&vm, vm.pde.addr, vm.pde.pde_fields.system, "PDE", &vm.pde.pde_entry, VM_PTB_ENTRY_SIZE, 0) < 0) {
+			if (read_pt_entry(&vm, vm.pde.addr, vm.pde.pde_fields.system, "PDE", &vm.pde.pde_entry) < 0) {
 				return -1;
 			}
-			vm.pde.pde_fields = umr_decode_pde_entry(vm.asic, vm.pde.pde_entry);			/* if the PDE isn't a PTE then print it out (if needed) */
+			vm.pde.pde_fields = vm.dec.pde(vm.pde.pde_entry);			/* if the PDE isn't a PTE then print it out (if needed) */
 			if (!vm.pde.pde_fields.pte) {
 				vm.va_tally |= address & va_mask;
 				if ((vm.asic->options.no_fold_vm_decode || memcmp(&vm.pde.pde_fields, &vm.pde.pde_array[vm.pde.pde_cnt], sizeof vm.pde.pde_fields)) && vm.asic->options.verbose) {
@@ -1051,6 +1694,7 @@ int umr_access_vram_ai(struct umr_asic *asic, int partition,
 					print_pde(&vm, indentation);
 				}
 				memcpy(&vm.pde.pde_array[vm.pde.pde_cnt++], &vm.pde.pde_fields, sizeof vm.pde.pde_fields);
+				walk_pde(&vm, vm.pde.pde_entry);
 				/* capture page walk data if requested */
 				if (vm.vmdata) {
 					vm.vmdata->pde_idx[vm.vmdata->levels] = vm.pde.pde_idx;
@@ -1110,7 +1754,7 @@ pte_further: // we jump here if a PTE-Further was found (from a PTE-as-PDE) so w
 		 * plus 8 times the PTE selector into the PTB
 		 */
 		vm.pte.addr = vm.pde.pde_fields.pte_base_addr + (vm.pte.pte_idx * VM_PTB_ENTRY_SIZE);
-		if (access_translated_address(&vm, vm.pte.addr, vm.pde.pde_fields.system, "PTE", &vm.pte.pte_entry, VM_PTB_ENTRY_SIZE, 0) < 0) {
+		if (read_pt_entry(&vm, vm.pte.addr, vm.pde.pde_fields.system, "PTE", &vm.pte.pte_entry) < 0) {
 			return -1;
 		}	
 pde_is_pte:  // we jump here if a PDE was marked as a PTE
@@ -1118,7 +1762,8 @@ pde_is_pte:  // we jump here if a PDE was marked as a PTE
 		 * at this point we have the PTE for this page in
 		 * the struct pte_entry
 		 */
-		vm.pte.pte_fields = umr_decode_pte_entry(vm.asic, vm.pte.pte_entry);
+		vm.pte.pte_fields = vm.dec.pte(vm.pte.pte_entry);
+		vm.walk.pte = vm.pte.pte_entry;
 
 		/*
 		 * How many bits in the address are used to index into the PTB?
@@ -1179,7 +1824,7 @@ pde_is_pte:  // we jump here if a PDE was marked as a PTE
 				vm.pde.addr = vm.pte.addr;
 				vm.pde.pde_idx = vm.pte.pte_idx;
 				vm.pde.pde_entry = vm.pte.pte_entry;
-				vm.pde.pde_fields = umr_decode_pde_entry(vm.asic, vm.pte.pte_entry);
+				vm.pde.pde_fields = vm.dec.pde(vm.pte.pte_entry);
 				vm.va_tally |= address & va_mask;
 				print_pde(&vm, indentation);
 			} else {
@@ -1189,6 +1834,9 @@ pde_is_pte:  // we jump here if a PDE was marked as a PTE
 		}
 
 		if (vm.pte.pte_is_pde) {
+			walk_pde(&vm, vm.pte.pte_entry);
+			vm.walk.pte = 0;
+			vm.walk.flags |= UMR_VM_XLATE_FURTHER;
 			/*
 			 * If further bit is set, PTE is a PDE, so set pde_fields to PTE
 			 * decoded as a PDE.
@@ -1199,10 +1847,10 @@ pde_is_pte:  // we jump here if a PDE was marked as a PTE
 				 * to point is PDE0.PBA + PTE-as-PDE.PBA.
 				 */
 				uint64_t tmp_addr = vm.pde.pde_fields.pte_base_addr;
-				vm.pde.pde_fields = umr_decode_pde_entry(vm.asic, vm.pte.pte_entry);
+				vm.pde.pde_fields = vm.dec.pde(vm.pte.pte_entry);
 				vm.pde.pde_fields.pte_base_addr += tmp_addr;
 			} else {
-				vm.pde.pde_fields = umr_decode_pde_entry(vm.asic, vm.pte.pte_entry);
+				vm.pde.pde_fields = vm.dec.pde(vm.pte.pte_entry);
 				if (!vm.pde.pde_fields.system) {
 					vm.pde.pde_fields.pte_base_addr -= vm.vmctrl.vm_fb_offset;
 				}
@@ -1265,8 +1913,18 @@ pde_is_pte:  // we jump here if a PDE was marked as a PTE
 			offset_mask = (1ULL << (VM_PAGE_SIZE_BITS + vm.pte.pte_block_fragment_size)) - 1;
 		}
 
-		uint64_t page_start_addr = vm.asic->mem_funcs.gpu_bus_to_cpu_address(vm.asic, vm.pte.pte_fields.page_base_addr);
+		page_start_addr = vm.asic->mem_funcs.gpu_bus_to_cpu_address(vm.asic, vm.pte.pte_fields.page_base_addr);
 		start_addr = page_start_addr + (address & offset_mask);
+		vm.walk.pa = start_addr;
+		vm.walk.page_size = offset_mask + 1;
+		if (vm.pte.pte_fields.valid)
+			vm.walk.flags |= UMR_VM_XLATE_VALID;
+		if (vm.pte.pte_fields.system)
+			vm.walk.flags |= UMR_VM_XLATE_SYSTEM;
+		if (vm.pte.pte_fields.prt)
+			vm.walk.flags |= UMR_VM_XLATE_PRT;
+		if (use_tlb && vm.pte.pte_fields.valid)
+			tlb_insert(&vm, set, address, offset_mask, page_start_addr);
 		if (vm.vmdata) {
 			vm.vmdata->pte_idx = vm.pte.pte_idx;
 			vm.vmdata->pte_va_mask = vm.va_tally + vm.page_table.page_table_start_addr;
@@ -1277,11 +1935,12 @@ pde_is_pte:  // we jump here if a PDE was marked as a PTE
 			vm.vmdata->pte_start_addr = start_addr;
 		}
 
+have_page:
 		/* Compute the chunk size we can access from this page.
 		 * If the size requested goes beyond the current page boundary
 		 * then limit the chunk size to the page boundary.
 		 */
-		uint64_t page_end_addr = page_start_addr + vm.pte.pte_page_mask + 1;
+		page_end_addr = page_start_addr + vm.pte.pte_page_mask + 1;
 		if (start_addr + size > page_end_addr) {
 			chunk_size = page_end_addr - start_addr;
 		} else {
@@ -1321,9 +1980,24 @@ pde_is_pte:  // we jump here if a PDE was marked as a PTE
 		/* allow destination to be NULL to simply use decoder */
 		if (vm.pte.pte_fields.valid) {
 			if (pdst) {
-				if (access_translated_address(&vm, start_addr, vm.pte.pte_fields.system, "user page", pdst, chunk_size, write_en) < 0) {
-					return -1;
+				/*
+				 * pages that follow each other in memory are accessed with
+				 * a single call (ZFB VRAM addresses are translated per page)
+				 */
+				if (run_len && (run_sys != (int)vm.pte.pte_fields.system || run_addr + run_len != start_addr ||
+				    (vm.vmctrl.zfb && !run_sys))) {
+					if (flush_run(&vm, run_addr, run_sys, run_dst, &run_len, write_en) < 0)
+						return -1;
 				}
+				if (!run_len) {
+					// HMM backed user queue pages are accessed by VA
+					if (vm.asic->options.user_queue.state.active)
+						vm.asic->options.user_queue.state.va = address + vm.page_table.page_table_start_addr;
+					run_addr = start_addr;
+					run_sys = vm.pte.pte_fields.system;
+					run_dst = pdst;
+				}
+				run_len += chunk_size;
 				pdst += chunk_size;
 			}
 		} else {
@@ -1331,6 +2005,8 @@ pde_is_pte:  // we jump here if a PDE was marked as a PTE
 				vm.asic->mem_funcs.vm_message("Page is set as PRT so we cannot read/write it, skipping ahead.\n");
 
 			if (pdst) {
+				if (flush_run(&vm, run_addr, run_sys, run_dst, &run_len, write_en) < 0)
+					return -1;
 				pdst += chunk_size;
 			}
 		}
@@ -1342,8 +2018,15 @@ pde_is_pte:  // we jump here if a PDE was marked as a PTE
 		 * this do/while loop.
 		 */
 		vm.vmdata = NULL;
+		if (vm.xlate) {
+			*vm.xlate = vm.walk;
+			vm.xlate = NULL;
+		}
 	} while (size); /* loop for all pages being requested */
 
+	if (flush_run(&vm, run_addr, run_sys, run_dst, &run_len, write_en) < 0 || issue_runs(&vm) < 0)
+		return -1;
+
 	if (vm.asic->options.verbose) {
 		vm.asic->mem_funcs.vm_message("\n=== Completed VM Decoding ===\n");
 	}
@@ -1355,6 +2038,13 @@ pde_is_pte:  // we jump here if a PDE was marked as a PTE
 	return 0;
 
 invalid_page:
+	// the pages before the invalid one are still accessed
+	flush_run(&vm, run_addr, run_sys, run_dst, &run_len, write_en);
+	issue_runs(&vm);
+	if (vm.xlate) {
+		*vm.xlate = vm.walk;
+		return -1;
+	}
 	if (vm.asic->options.user_queue.state.active) {
 		vm.asic->mem_funcs.vm_message("[ERROR]: No valid mapping for 0x%" PRIx64 " from user queue '%s'n", address, vm.asic->options.user_queue.clientid);
 	} else {
@@ -1362,3 +2052,344 @@ invalid_page:
 	}
 	return -1;
 }
+
+int umr_access_vram_ai(struct umr_asic *asic, int partition,
+				  uint32_t vmid, uint64_t address, uint32_t size,
+			      void *dst, int write_en, struct umr_vm_pagewalk *vmdata)
+{
+	return access_vram_ai(asic, partition, vmid, address, size, dst, write_en, vmdata, NULL);
+}
+
+/**
+ * umr_vm_translate_ai - Translate many VAs of a GFX9+ VM context
+ *
+ * See umr_vm_translate().  Nothing is printed (not even with verbose
+ * set) and the walks go through the TLB and page table block caches.
+ */
+int umr_vm_translate_ai(struct umr_asic *asic, int partition, uint32_t vmid,
+			const uint64_t *va, uint32_t n, struct umr_vm_translation *out)
+{
+	void (*va_addr_decode)(pde_fields_t *pdes, int num_pde, pte_fields_t pte) = asic->mem_funcs.va_addr_decode;
+	int verbose = asic->options.verbose, valid = 0;
+	uint32_t x;
+
+	asic->options.verbose = 0;
+	asic->mem_funcs.va_addr_decode = NULL;
+	umr_vm_context_begin(asic);
+	for (x = 0; x < n; x++) {
+		memset(&out[x], 0, sizeof out[x]);
+		out[x].va = va[x];
+		if (!access_vram_ai(asic, partition, vmid, va[x], 4, NULL, 0, NULL, &out[x]) &&
+		    (out[x].flags & UMR_VM_XLATE_VALID))
+			++valid;
+	}
+	umr_vm_context_end(asic);
+	asic->options.verbose = verbose;
+	asic->mem_funcs.va_addr_decode = va_addr_decode;
+	return valid;
+}
+
+/* state of a umr_vm_map_ai() walk */
+/* entries of a page table block read and decoded at once, see map_batch() */
+struct vm_map_batch {
+	uint64_t raw[VM_PDB_ENTRIES];
+	union {
+		pte_fields_t pte[VM_PDB_ENTRIES];
+		pde_fields_t pde[VM_PDB_ENTRIES];
+	};
+};
+
+/* batches of the PTE-as-PDE children, the PTB and the PDB levels */
+#define VM_MAP_BATCH_PTE  0
+#define VM_MAP_BATCH_PTB  1
+#define VM_MAP_BATCH_PDB  2
+#define VM_MAP_BATCHES    (VM_MAP_BATCH_PDB + 8)
+
+struct vm_map_walk {
+	struct umr_vm_ai_state *vm;
+	struct umr_vm_mapping *maps;
+	uint64_t no_maps, max_maps, last;  /* last is the highest VA offset covered */
+	struct vm_map_batch *batch[VM_MAP_BATCHES];  /* one per level being walked */
+};
+
+/*
+ * map_emit - Record a valid leaf page and merge it into the previous
+ * mapping if it continues it both virtually and physically with the
+ * same attributes.
+ */
+static int map_emit(struct vm_map_walk *w, uint64_t va, uint64_t size, const pte_fields_t *f)
+{
+	struct umr_vm_mapping *m, *tmp;
+	pte_fields_t a, b;
+	uint64_t pa;
+
+	if (!f->valid || va > w->last)
+		return 0;
+	if (va + size - 1 > w->last)
+		size = w->last - va + 1;
+
+	pa = f->page_base_addr;
+	if (!f->system)
+		pa -= w->vm->vmctrl.vm_fb_offset;
+	va += w->vm->page_table.page_table_start_addr;
+
+	if (w->no_maps) {
+		m = &w->maps[w->no_maps - 1];
+		a = m->pte_fields;
+		b = *f;
+		a.page_base_addr = b.page_base_addr = 0;
+		a.pte_mask = b.pte_mask = 0;
+		a.fragment = b.fragment = 0;
+		if (m->va + m->size == va && m->pa + m->size == pa && !memcmp(&a, &b, sizeof a)) {
+			m->size += size;
+			return 0;
+		}
+	}
+
+	if (w->no_maps == w->max_maps) {
+		w->max_maps = w->max_maps ? w->max_maps * 2 : 64;
+		tmp = realloc(w->maps, w->max_maps * sizeof *w->maps);
+		if (!tmp) {
+			w->vm->asic->err_msg("[ERROR]: Out of memory\n");
+			return -1;
+		}
+		w->maps = tmp;
+	}
+	m = &w->maps[w->no_maps++];
+	m->va = va;
+	m->size = size;
+	m->pa = pa;
+	m->system = f->system;
+	m->pte_fields = *f;
+	return 0;
+}
+
+/*
+ * map_batch - Read up to @n entries of a page table block from @addr into
+ * batch @level and decode them as PTEs (@pte) or PDEs.
+ *
+ * Returns how many entries were read (they stop at the end of a cached
+ * block) or -1 on error.
+ */
+static int map_batch(struct vm_map_walk *w, int level, uint64_t addr, int sys, int pte, uint64_t n)
+{
+	struct umr_vm_ai_state *vm = w->vm;
+	struct vm_map_batch *b;
+	uint32_t cnt;
+
+	if (level >= VM_MAP_BATCHES)
+		return -1;
+	if (!w->batch[level]) {
+		w->batch[level] = malloc(sizeof *w->batch[level]);
+		if (!w->batch[level]) {
+			vm->asic->err_msg("[ERROR]: Out of memory\n");
+			return -1;
+		}
+	}
+	b = w->batch[level];
+	cnt = pt_entries_left(addr, n);
+	if (read_pt_entries(vm, addr, sys, pte ? "PTE" : "PDE", b->raw, cnt) < 0)
+		return -1;
+	if (pte)
+		vm->dec.pte_batch(b->raw, b->pte, cnt);
+	else
+		vm->dec.pde_batch(b->raw, b->pde, cnt);
+	return cnt;
+}
+
+/* how many entries covering 2^bits bytes each from @va on are needed (at most @n) */
+static uint64_t map_entries(struct vm_map_walk *w, uint64_t va, int bits, uint64_t n)
+{
+	uint64_t need;
+
+	if (va > w->last)
+		return 0;
+	need = ((w->last - va) >> bits) + 1;
+	return (need < n) ? need : n;
+}
+
+/*
+ * map_pte - Handle a PTE (or a PDE with the P bit) @f covering 2^bits
+ * bytes at @va.  A PTE-as-PDE (further) entry is followed one more
+ * level with @pde0 giving the TFS base where @tfs allows it.
+ */
+static int map_pte(struct vm_map_walk *w, uint64_t entry, const pte_fields_t *f, uint64_t va, int bits,
+		   pde_fields_t *pde0, int tfs)
+{
+	struct umr_vm_ai_state *vm = w->vm;
+	pde_fields_t child;
+	uint64_t n, x;
+	int fbits, cnt, i;
+
+	if (!((f->further && f->valid) || (vm->ip->discoverable.maj >= 12 && !f->pte && f->valid)))
+		return map_emit(w, va, 1ULL << bits, f);
+
+	child = vm->dec.pde(entry);
+	if (vm->ip->discoverable.maj >= 11 && tfs && pde0->tfs_addr) {
+		child.pte_base_addr += pde0->pte_base_addr;
+	} else if (!child.system) {
+		child.pte_base_addr -= vm->vmctrl.vm_fb_offset;
+	}
+
+	fbits = VM_PAGE_SIZE_BITS + child.frag_size;
+	if (fbits > bits)
+		fbits = bits;
+	n = map_entries(w, va, fbits, 1ULL << (bits - fbits));
+	for (x = 0; x < n; x += cnt) {
+		cnt = map_batch(w, VM_MAP_BATCH_PTE, child.pte_base_addr + x * VM_PTB_ENTRY_SIZE, child.system, 1, n - x);
+		if (cnt < 0)
+			return -1;
+		for (i = 0; i < cnt; i++)
+			if (map_emit(w, va + ((x + i) << fbits), 1ULL << fbits, &w->batch[VM_MAP_BATCH_PTE]->pte[i]) < 0)
+				return -1;
+	}
+	return 0;
+}
+
+/* map_ptb - Walk the PTB pointed to by the PDE0 @pde0 which covers 2^bits bytes at @va */
+static int map_ptb(struct vm_map_walk *w, pde_fields_t *pde0, uint64_t va, int bits)
+{
+	struct vm_map_batch *b;
+	uint64_t n, x;
+	int pbits, cnt, i;
+
+	pbits = VM_PAGE_SIZE_BITS + pde0->frag_size;
+	if (pbits > bits)
+		pbits = bits;
+	n = map_entries(w, va, pbits, 1ULL << (bits - pbits));
+	for (x = 0; x < n; x += cnt) {
+		cnt = map_batch(w, VM_MAP_BATCH_PTB, pde0->pte_base_addr + x * VM_PTB_ENTRY_SIZE, pde0->system, 1, n - x);
+		if (cnt < 0)
+			return -1;
+		b = w->batch[VM_MAP_BATCH_PTB];
+		for (i = 0; i < cnt; i++)
+			if (map_pte(w, b->raw[i], &b->pte[i], va + ((x + i) << pbits), pbits, pde0, 1) < 0)
+				return -1;
+	}
+	return 0;
+}
+
+/*
+ * map_pdb - Walk the @entries PDEs of the PDB pointed to by @pde, each
+ * covering 2^shift bytes starting at @va.  @depth is the number of PDB
+ * levels left including this one.
+ */
+static int map_pdb(struct vm_map_walk *w, pde_fields_t *pde, int depth, uint64_t va, uint64_t entries, int shift)
+{
+	struct umr_vm_ai_state *vm = w->vm;
+	struct vm_map_batch *b;
+	pde_fields_t f;
+	pte_fields_t p;
+	uint64_t x, n, cva;
+	int level = VM_MAP_BATCH_PDB + depth - 1, cnt, i;
+
+	n = map_entries(w, va, shift, entries);
+	for (x = 0; x < n; x += cnt) {
+		cnt = map_batch(w, level, pde->pte_base_addr + x * VM_PTB_ENTRY_SIZE, pde->system, 0, n - x);
+		if (cnt < 0)
+			return -1;
+		b = w->batch[level];
+		for (i = 0; i < cnt; i++) {
+			cva = va + ((x + i) << shift);
+			f = b->pde[i];
+			if (f.pte) {
+				// a PDE with the P bit maps the whole range it covers
+				p = vm->dec.pte(b->raw[i]);
+				if (map_pte(w, b->raw[i], &p, cva, shift, &f, 0) < 0)
+					return -1;
+				continue;
+			}
+			if (!f.valid)
+				continue;
+			if (!f.system)
+				f.pte_base_addr -= vm->vmctrl.vm_fb_offset;
+			if (depth > 1) {
+				if (map_pdb(w, &f, depth - 1, cva, VM_PDB_ENTRIES, shift - VM_PDB_ENTRY_BITS) < 0)
+					return -1;
+			} else {
+				if (map_ptb(w, &f, cva, shift) < 0)
+					return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+/**
+ * umr_vm_map_ai - List every valid mapping of a VM context
+ *
+ * @asic: The ASIC the VM belongs to
+ * @partition: The VM partition (INST of the VM register blocks)
+ * @vmid: The VMID with the hub selection in bits 8:15 (see umr_access_vram())
+ * @maps: Receives a malloc'ed array of mappings (free with free())
+ * @no_maps: Receives the number of mappings
+ *
+ * The page tables are walked once from the root and every valid leaf is
+ * recorded.  Neighbouring pages that are contiguous both virtually and
+ * physically and share their attributes are merged into one mapping.
+ * The system aperture of VMID0 is not taken into account, only what
+ * the page tables map.
+ *
+ * Returns -1 on error.
+ */
+int umr_vm_map_ai(struct umr_asic *asic, int partition, uint32_t vmid,
+		  struct umr_vm_mapping **maps, uint64_t *no_maps)
+{
+	struct umr_vm_ai_state vm;
+	struct vm_map_walk w;
+	struct vm_ai_hub h;
+	pde_fields_t root;
+	int total_vm_bits, top_pdb_bits, x, r = 0;
+
+	*maps = NULL;
+	*no_maps = 0;
+
+	memset(&vm, 0, sizeof vm);
+	vm.asic = asic;
+	vm.partition = partition;
+	vm.ip = umr_find_ip_block(asic, "gfx", asic->options.vm_partition);
+	if (!vm.ip) {
+		asic->mem_funcs.vm_message("[BUG]: Cannot find a 'gfx' IP block in this ASIC\n");
+		return -1;
+	}
+	umr_vm_pte_decoder(vm.ip->discoverable.maj, vm.ip->discoverable.min, &vm.dec);
+	umr_vm_pde_decoder(vm.ip->discoverable.maj, vm.ip->discoverable.min, &vm.dec);
+
+	if (load_vm_context(&vm, &vmid, &h) < 0)
+		return -1;
+
+	if (vm.page_table.page_table_depth == 0)
+		vm.page_table.page_table_block_size = log2_vm_size(vm.page_table.page_table_start_addr, vm.page_table.page_table_end_addr) - VM_2MB_BLOCK_BITS;
+
+	root = vm.dec.pde(vm.page_table.page_table_base_addr);
+	if (!root.system)
+		root.pte_base_addr -= vm.vmctrl.vm_fb_offset;
+	if (!root.valid)
+		return 0;
+
+	memset(&w, 0, sizeof w);
+	w.vm = &vm;
+	w.last = vm.page_table.page_table_end_addr + VM_PAGE_OFFSET_MASK;
+	// VM addresses are 48 bits (see umr_access_vram())
+	if (w.last > 0xFFFFFFFFFFFFULL)
+		w.last = 0xFFFFFFFFFFFFULL;
+	w.last -= vm.page_table.page_table_start_addr;
+
+	total_vm_bits = log2_vm_size(vm.page_table.page_table_start_addr, vm.page_table.page_table_end_addr);
+	if (vm.page_table.page_table_depth == 0) {
+		r = map_ptb(&w, &root, 0, total_vm_bits);
+	} else {
+		top_pdb_bits = total_vm_bits - (VM_PDB_ENTRY_BITS * (vm.page_table.page_table_depth - 1)) - (vm.page_table.page_table_block_size + VM_2MB_BLOCK_BITS);
+		r = map_pdb(&w, &root, vm.page_table.page_table_depth, 0, 1ULL << top_pdb_bits, total_vm_bits - top_pdb_bits);
+	}
+
+	for (x = 0; x < VM_MAP_BATCHES; x++)
+		free(w.batch[x]);
+	if (r < 0) {
+		free(w.maps);
+		return -1;
+	}
+	*maps = w.maps;
+	*no_maps = w.no_maps;
+	return 0;
+}
@@ -25,29 +25,9 @@
 #include "umr.h"
 #include <inttypes.h>
 
-/**
- * umr_access_vram_via_mmio - Access VRAM via direct MMIO control registers
- *
- * @asic: Pointer to the ASIC device structure
- * @address: Starting VRAM address to access (in bytes)
- * @size: Number of bytes to read/write (must be 4-byte aligned)
- * @dst: Pointer to destination buffer for reads or source buffer for writes
- * @write_en: Access mode flag (0 = read from VRAM, non-zero = write to VRAM)
- *
- * This function provides low-level VRAM access through MMIO index/data register pairs.
- * On GFX10+ hardware, it uses the BIF_BX_PF registers; on older hardware, it uses
- * the legacy MM_INDEX/MM_DATA registers. The function automatically selects the
- * appropriate register set based on the GFX IP version.
- *
- * The MM_INDEX register is configured with bit 31 set to enable VRAM access mode,
- * while MM_INDEX_HI holds the upper address bits for addressing beyond 2GB.
- *
- * Return: 0 on success
- */
-int umr_access_vram_via_mmio(struct umr_asic *asic, uint64_t address, uint32_t size, void *dst, int write_en)
+static void mm_index_resolve(struct umr_asic *asic)
 {
 	uint32_t MM_INDEX, MM_INDEX_HI, MM_DATA;
-	uint32_t *out = dst;
 	int maj, min;
 
 	umr_gfx_get_ip_ver(asic, &maj, &min);
@@ -78,16 +58,92 @@ int umr_access_vram_via_mmio(struct umr_asic *asic, uint64_t address, uint32_t s
 	}
 
 	/* Convert register indices to byte offsets (each register is 4 bytes) */
-	MM_INDEX *= 4;
-	MM_INDEX_HI *= 4;
-	MM_DATA *= 4;
+	asic->mm_index.index = MM_INDEX * 4;
+	asic->mm_index.index_hi = MM_INDEX_HI * 4;
+	asic->mm_index.data = MM_DATA * 4;
+	asic->mm_index.resolved = 1;
+}
+
+/**
+ * umr_access_vram_via_mmio - Access VRAM via direct MMIO control registers
+ *
+ * @asic: Pointer to the ASIC device structure
+ * @address: Starting VRAM address to access (in bytes)
+ * @size: Number of bytes to read/write (must be 4-byte aligned)
+ * @dst: Pointer to destination buffer for reads or source buffer for writes
+ * @write_en: Access mode flag (0 = read from VRAM, non-zero = write to VRAM)
+ *
+ * This function provides low-level VRAM access through MMIO index/data register pairs.
+ * On GFX10+ hardware, it uses the BIF_BX_PF registers; on older hardware, it uses
+ * the legacy MM_INDEX/MM_DATA registers. The function automatically selects the
+ * appropriate register set based on the GFX IP version.
+ *
+ * The MM_INDEX register is configured with bit 31 set to enable VRAM access mode,
+ * while MM_INDEX_HI holds the upper address bits for addressing beyond 2GB.
+ *
+ * The register offsets are looked up once per ASIC and MM_INDEX_HI is only
+ * written when it changes.  When the register BAR is mapped (use_pci) the
+ * transfer is a tight loop of stores/loads on the BAR.
+ *
+ * Return: 0 on success
+ */
+int umr_access_vram_via_mmio(struct umr_asic *asic, uint64_t address, uint32_t size, void *dst, int write_en)
+{
+	uint32_t MM_INDEX, MM_INDEX_HI, MM_DATA, hi;
+	uint32_t *out = dst;
+	volatile uint32_t *mem;
+
+	if (!asic->mm_index.resolved)
+		mm_index_resolve(asic);
+	MM_INDEX = asic->mm_index.index;
+	MM_INDEX_HI = asic->mm_index.index_hi;
+	MM_DATA = asic->mm_index.data;
+
+	if (!size)
+		return 0;
+
+	/*
+	 * With the register BAR mapped the window is driven with raw
+	 * stores/loads, MM_INDEX_HI selects a 2GB span so it is only
+	 * written when the address crosses into the next one.
+	 */
+	mem = asic->pci.mem;
+	if (mem && asic->reg_funcs.write_reg == umr_write_reg && asic->reg_funcs.read_reg == umr_read_reg &&
+	    !(asic->options.test_log && asic->options.test_log_fd) &&
+	    MM_INDEX + 4 <= asic->pci.pdevice->regions[asic->pci.region].size &&
+	    MM_INDEX_HI + 4 <= asic->pci.pdevice->regions[asic->pci.region].size &&
+	    MM_DATA + 4 <= asic->pci.pdevice->regions[asic->pci.region].size) {
+		hi = address >> 31;
+		mem[MM_INDEX_HI / 4] = hi;
+		while (size) {
+			if ((address >> 31) != hi) {
+				hi = address >> 31;
+				mem[MM_INDEX_HI / 4] = hi;
+			}
+			mem[MM_INDEX / 4] = address | 0x80000000;
+			if (write_en == 0)
+				*out++ = mem[MM_DATA / 4];
+			else
+				mem[MM_DATA / 4] = *out++;
+			size -= 4;
+			address += 4;
+		}
+		return 0;
+	}
+
+	/* Set upper address bits (for addresses > 2GB) */
+	hi = address >> 31;
+	asic->reg_funcs.write_reg(asic, MM_INDEX_HI, hi, REG_MMIO);
 
 	/* Process data in 4-byte chunks */
 	while (size) {
+		/* MM_INDEX_HI only changes every 2GB */
+		if ((address >> 31) != hi) {
+			hi = address >> 31;
+			asic->reg_funcs.write_reg(asic, MM_INDEX_HI, hi, REG_MMIO);
+		}
 		/* Set target address with bit 31 set to enable VRAM access mode */
 		asic->reg_funcs.write_reg(asic, MM_INDEX, address | 0x80000000, REG_MMIO);
-		/* Set upper address bits (for addresses > 2GB) */
-		asic->reg_funcs.write_reg(asic, MM_INDEX_HI, address >> 31, REG_MMIO);
 
 		if (write_en == 0) {
 			/* Read operation: fetch data from VRAM via MM_DATA register */
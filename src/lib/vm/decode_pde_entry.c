@@ -25,6 +25,120 @@
 #include "umr.h"
 #include <inttypes.h>
 
+/* where the fields of a PDE are on a gfx generation, see decode_pte_entry.c */
+struct pde_field {
+	uint8_t shift, mask;   // a mask of 0 is a field the generation lacks
+};
+
+struct pde_layout {
+	struct pde_field frag_size, valid, system, coherent, pte, further,
+		llc_noalloc, mtype, tfs_addr, pa_rsvd, mall_reuse;
+	uint64_t base_mask;
+};
+
+#define PDE_COMMON \
+	.valid = { 0, 1 }, .system = { 1, 1 }, .coherent = { 2, 1 }, \
+	.base_mask = 0xFFFFFFFFFFC0ULL
+
+static const struct pde_layout pde_gfx9 = {
+	PDE_COMMON,
+	.frag_size = { 59, 0x1F }, .pte = { 54, 1 }, .further = { 56, 1 },
+};
+
+// GFX10.3+ has the LLC no-allocate flag
+static const struct pde_layout pde_gfx10_3 = {
+	PDE_COMMON,
+	.frag_size = { 59, 0x1F }, .pte = { 54, 1 }, .further = { 56, 1 }, .llc_noalloc = { 58, 1 },
+};
+
+static const struct pde_layout pde_gfx11 = {
+	PDE_COMMON,
+	.frag_size = { 59, 0x1F }, .mtype = { 48, 7 }, .pte = { 54, 1 }, .further = { 56, 1 },
+	.tfs_addr = { 57, 1 }, .llc_noalloc = { 58, 1 },
+};
+
+// GFX12 moves the fragment size to bits 62:58 and the P bit to bit 63
+static const struct pde_layout pde_gfx12 = {
+	PDE_COMMON,
+	.frag_size = { 58, 0x1F }, .pa_rsvd = { 48, 0xF }, .mall_reuse = { 54, 3 },
+	.tfs_addr = { 56, 1 }, .pte = { 63, 1 },
+};
+
+// an unknown generation decodes to nothing
+static const struct pde_layout pde_unknown = { .base_mask = 0 };
+
+#define PDE_FIELD(f) ((e >> l->f.shift) & l->f.mask)
+
+static inline pde_fields_t decode_pde(const struct pde_layout *l, uint64_t e)
+{
+	pde_fields_t f = { 0 };
+
+	f.frag_size     = PDE_FIELD(frag_size);
+	f.pte_base_addr = e & l->base_mask;
+	f.valid         = PDE_FIELD(valid);
+	f.system        = PDE_FIELD(system);
+	f.coherent      = PDE_FIELD(coherent);
+	f.pte           = PDE_FIELD(pte);
+	f.further       = PDE_FIELD(further);
+	f.llc_noalloc   = PDE_FIELD(llc_noalloc);
+	f.mtype         = PDE_FIELD(mtype);
+	f.tfs_addr      = PDE_FIELD(tfs_addr);
+	f.pa_rsvd       = PDE_FIELD(pa_rsvd);
+	f.mall_reuse    = PDE_FIELD(mall_reuse);
+	return f;
+}
+
+#define PDE_DECODER(name) \
+static pde_fields_t decode_##name(uint64_t e) \
+{ \
+	return decode_pde(&name, e); \
+} \
+static void decode_##name##_batch(const uint64_t *e, pde_fields_t *f, int n) \
+{ \
+	int i; \
+	for (i = 0; i < n; i++) \
+		f[i] = decode_pde(&name, e[i]); \
+}
+
+PDE_DECODER(pde_gfx9)
+PDE_DECODER(pde_gfx10_3)
+PDE_DECODER(pde_gfx11)
+PDE_DECODER(pde_gfx12)
+PDE_DECODER(pde_unknown)
+
+/**
+ * umr_vm_pde_decoder - Pick the PDE decoders of a gfx generation
+ *
+ * @maj, @min: The version of the 'gfx' IP block
+ * @dec: Receives the pde and pde_batch decoders
+ */
+void umr_vm_pde_decoder(int maj, int min, struct umr_vm_decoder *dec)
+{
+	switch (maj) {
+		case 9:
+			dec->pde = decode_pde_gfx9;
+			dec->pde_batch = decode_pde_gfx9_batch;
+			break;
+		case 10:
+			// GFX10 before 10.3 has the layout of GFX9
+			dec->pde = (min >= 3) ? decode_pde_gfx10_3 : decode_pde_gfx9;
+			dec->pde_batch = (min >= 3) ? decode_pde_gfx10_3_batch : decode_pde_gfx9_batch;
+			break;
+		case 11:
+			dec->pde = decode_pde_gfx11;
+			dec->pde_batch = decode_pde_gfx11_batch;
+			break;
+		case 12:
+			dec->pde = decode_pde_gfx12;
+			dec->pde_batch = decode_pde_gfx12_batch;
+			break;
+		default:
+			dec->pde = decode_pde_unknown;
+			dec->pde_batch = decode_pde_unknown_batch;
+			break;
+	}
+}
+
 /**
  * umr_decode_pde_entry - Decode a Page Directory Entry (PDE)
  * @asic: Pointer to the ASIC structure containing GPU information
@@ -56,77 +170,20 @@
  * - Bits 54:55 - MALL (Memory Access at Last Level) reuse policy
  * - Bit  63    - PDE-is-PTE flag (moved from bit 54)
  *
+ * This looks the generation up for every call, page walks use the
+ * decoders of umr_vm_get_decoder() instead.
+ *
  * Return: Decoded PDE fields structure containing all extracted bit fields
  */
 pde_fields_t umr_decode_pde_entry(const struct umr_asic *asic, uint64_t pde_entry)
 {
+	struct umr_vm_decoder dec;
 	pde_fields_t pde_fields = { 0 };
-	struct umr_ip_block *ip;
 
 	/* Find the GFX IP block to determine the architecture version */
-	ip = umr_find_ip_block(asic, "gfx", asic->options.vm_partition);
-	if (!ip) {
+	if (umr_vm_get_decoder(asic, &dec)) {
 		asic->err_msg("[BUG]: Cannot find a 'gfx' IP block in this ASIC\n");
 		return pde_fields;
 	}
-
-	/* Decode PDE based on GFX architecture major version */
-	switch (ip->discoverable.maj) {
-		case 9:  /* GFX9: Vega series */
-		case 10: /* GFX10: Navi 1x/2x series */
-			/* Extract fragment size (bits 63:59) - log2 of block fragment size */
-			pde_fields.frag_size     = (pde_entry >> 59) & 0x1F;
-			/* Extract physical base address (bits 47:6) - 64-byte aligned */
-			pde_fields.pte_base_addr = pde_entry & 0xFFFFFFFFFFC0ULL;
-			/* Extract valid bit (bit 0) - indicates if PDE is valid */
-			pde_fields.valid         = pde_entry & 1;
-			/* Extract system memory flag (bit 1) - indicates system vs local memory */
-			pde_fields.system        = (pde_entry >> 1) & 1;
-			/* Extract coherent flag (bit 2) - enables cache coherency/snooping */
-			pde_fields.coherent      = (pde_entry >> 2) & 1;
-			/* Extract PDE-is-PTE flag (bit 54) - allows PTE to act as PDE */
-			pde_fields.pte           = (pde_entry >> 54) & 1;
-			/* Extract further flag (bit 56) - indicates continuation of page walk */
-			pde_fields.further       = (pde_entry >> 56) & 1;
-			/* GFX10.3+ has LLC no-allocate flag */
-			if (ip->discoverable.maj == 10 && ip->discoverable.min >= 3) {
-				pde_fields.llc_noalloc   = (pde_entry >> 58) & 1;
-			}
-			break;
-		case 11: /* GFX11: RDNA3 series */
-			/* Similar to GFX10 but with additional fields */
-			pde_fields.frag_size     = (pde_entry >> 59) & 0x1F;
-			pde_fields.pte_base_addr = pde_entry & 0xFFFFFFFFFFC0ULL;
-			pde_fields.valid         = pde_entry & 1;
-			pde_fields.system        = (pde_entry >> 1) & 1;
-			pde_fields.coherent      = (pde_entry >> 2) & 1;
-			/* Extract memory type (bits 48:50) - determines caching behavior */
-			pde_fields.mtype         = (pde_entry >> 48) & 7;
-			pde_fields.pte           = (pde_entry >> 54) & 1;
-			pde_fields.further       = (pde_entry >> 56) & 1;
-			/* Extract TFS address flag (bit 57) - Translate Further Offset */
-			pde_fields.tfs_addr      = (pde_entry >> 57) & 1;
-			/* Extract LLC no-allocate flag (bit 58) */
-			pde_fields.llc_noalloc   = (pde_entry >> 58) & 1;
-			break;
-		case 12: /* GFX12: RDNA4 series */
-			/* GFX12 has reorganized bit layout */
-			/* Fragment size moved to bits 58:62 */
-			pde_fields.frag_size     = (pde_entry >> 58) & 0x1F;
-			/* Physical base address remains at bits 47:6 */
-			pde_fields.pte_base_addr = pde_entry & 0xFFFFFFFFFFC0ULL;
-			pde_fields.valid         = pde_entry & 1;
-			pde_fields.system        = (pde_entry >> 1) & 1;
-			pde_fields.coherent      = (pde_entry >> 2) & 1;
-			/* Extract PA reserved bits (bits 48:51) */
-			pde_fields.pa_rsvd       = (pde_entry >> 48) & 0xF;
-			/* Extract MALL reuse policy (bits 54:55) - cache reuse strategy */
-			pde_fields.mall_reuse    = (pde_entry >> 54) & 3;
-			/* Extract TFS address flag (bit 56) */
-			pde_fields.tfs_addr      = (pde_entry >> 56) & 1;
-			/* PDE-is-PTE flag moved to bit 63 in GFX12 */
-			pde_fields.pte           = (pde_entry >> 63) & 1;
-			break;
-	}
-	return pde_fields;
+	return dec.pde(pde_entry);
 }
@@ -25,6 +25,175 @@
 #include "umr.h"
 #include <inttypes.h>
 
+/*
+ * Where every field of a PTE is on a gfx generation.  The decoders below
+ * are specialized on these tables (which are constant) so they are plain
+ * shifts and masks, picked once per walk with umr_vm_get_decoder()
+ * instead of looking the generation up for every entry.
+ */
+struct pte_field {
+	uint8_t shift, mask;   // a mask of 0 is a field the generation lacks
+};
+
+struct pte_layout {
+	struct pte_field valid, system, coherent, tmz, execute, read, write, fragment,
+		prt, pde, further, mtype, gcr, llc_noalloc, software, pa_rsvd, dcc, pte;
+
+	// the entry is a PDE (a 64 byte aligned base) if this bit has this value
+	struct pte_field is_pde;
+	uint8_t is_pde_value;
+	uint64_t pte_base_mask, pde_base_mask;
+};
+
+#define PTE_COMMON \
+	.valid = { 0, 1 }, .system = { 1, 1 }, .coherent = { 2, 1 }, .tmz = { 3, 1 }, \
+	.execute = { 4, 1 }, .read = { 5, 1 }, .write = { 6, 1 }, .fragment = { 7, 0x1F }, \
+	.pte_base_mask = 0xFFFFFFFFF000ULL, .pde_base_mask = 0xFFFFFFFFFFC0ULL
+
+static const struct pte_layout pte_gfx9 = {
+	PTE_COMMON,
+	.prt = { 51, 1 }, .pde = { 54, 1 }, .further = { 56, 1 }, .mtype = { 57, 3 },
+	.is_pde = { 56, 1 }, .is_pde_value = 1,
+};
+
+static const struct pte_layout pte_gfx10 = {
+	PTE_COMMON,
+	.mtype = { 48, 3 }, .prt = { 51, 1 }, .pde = { 54, 1 }, .further = { 56, 1 }, .gcr = { 57, 1 },
+	.is_pde = { 56, 1 }, .is_pde_value = 1,
+};
+
+// GFX10.3+ adds the LLC no-allocate flag
+static const struct pte_layout pte_gfx10_3 = {
+	PTE_COMMON,
+	.mtype = { 48, 3 }, .prt = { 51, 1 }, .pde = { 54, 1 }, .further = { 56, 1 }, .gcr = { 57, 1 },
+	.llc_noalloc = { 58, 1 },
+	.is_pde = { 56, 1 }, .is_pde_value = 1,
+};
+
+static const struct pte_layout pte_gfx11 = {
+	PTE_COMMON,
+	.mtype = { 48, 3 }, .prt = { 51, 1 }, .software = { 52, 3 }, .pde = { 54, 1 },
+	.further = { 56, 1 }, .gcr = { 57, 1 }, .llc_noalloc = { 58, 1 },
+	.is_pde = { 56, 1 }, .is_pde_value = 1,
+};
+
+// GFX12 moves mtype to bits 55:54 and flags PTEs (not PDEs) with bit 63
+static const struct pte_layout pte_gfx12 = {
+	PTE_COMMON,
+	.pa_rsvd = { 48, 0xF }, .software = { 52, 3 }, .mtype = { 54, 3 }, .prt = { 56, 1 },
+	.gcr = { 57, 1 }, .dcc = { 58, 1 }, .pte = { 63, 1 },
+	.is_pde = { 63, 1 }, .is_pde_value = 0,
+};
+
+// an unknown generation only gets the page address
+static const struct pte_layout pte_unknown = {
+	.pte_base_mask = 0xFFFFFFFFF000ULL,
+	.is_pde_value = 1,
+};
+
+#define PTE_FIELD(f) ((e >> l->f.shift) & l->f.mask)
+
+static inline pte_fields_t decode_pte(const struct pte_layout *l, uint64_t e)
+{
+	pte_fields_t f = { 0 };
+
+	f.valid       = PTE_FIELD(valid);
+	f.system      = PTE_FIELD(system);
+	f.coherent    = PTE_FIELD(coherent);
+	f.tmz         = PTE_FIELD(tmz);
+	f.execute     = PTE_FIELD(execute);
+	f.read        = PTE_FIELD(read);
+	f.write       = PTE_FIELD(write);
+	f.fragment    = PTE_FIELD(fragment);
+	f.prt         = PTE_FIELD(prt);
+	f.pde         = PTE_FIELD(pde);
+	f.further     = PTE_FIELD(further);
+	f.mtype       = PTE_FIELD(mtype);
+	f.gcr         = PTE_FIELD(gcr);
+	f.llc_noalloc = PTE_FIELD(llc_noalloc);
+	f.software    = PTE_FIELD(software);
+	f.pa_rsvd     = PTE_FIELD(pa_rsvd);
+	f.dcc         = PTE_FIELD(dcc);
+	f.pte         = PTE_FIELD(pte);
+	f.page_base_addr = e & (PTE_FIELD(is_pde) == l->is_pde_value ? l->pde_base_mask : l->pte_base_mask);
+	return f;
+}
+
+#define PTE_DECODER(name) \
+static pte_fields_t decode_##name(uint64_t e) \
+{ \
+	return decode_pte(&name, e); \
+} \
+static void decode_##name##_batch(const uint64_t *e, pte_fields_t *f, int n) \
+{ \
+	int i; \
+	for (i = 0; i < n; i++) \
+		f[i] = decode_pte(&name, e[i]); \
+}
+
+PTE_DECODER(pte_gfx9)
+PTE_DECODER(pte_gfx10)
+PTE_DECODER(pte_gfx10_3)
+PTE_DECODER(pte_gfx11)
+PTE_DECODER(pte_gfx12)
+PTE_DECODER(pte_unknown)
+
+/**
+ * umr_vm_pte_decoder - Pick the PTE decoders of a gfx generation
+ *
+ * @maj, @min: The version of the 'gfx' IP block
+ * @dec: Receives the pte and pte_batch decoders
+ */
+void umr_vm_pte_decoder(int maj, int min, struct umr_vm_decoder *dec)
+{
+	switch (maj) {
+		case 9:
+			dec->pte = decode_pte_gfx9;
+			dec->pte_batch = decode_pte_gfx9_batch;
+			break;
+		case 10:
+			dec->pte = (min >= 3) ? decode_pte_gfx10_3 : decode_pte_gfx10;
+			dec->pte_batch = (min >= 3) ? decode_pte_gfx10_3_batch : decode_pte_gfx10_batch;
+			break;
+		case 11:
+			dec->pte = decode_pte_gfx11;
+			dec->pte_batch = decode_pte_gfx11_batch;
+			break;
+		case 12:
+			dec->pte = decode_pte_gfx12;
+			dec->pte_batch = decode_pte_gfx12_batch;
+			break;
+		default:
+			dec->pte = decode_pte_unknown;
+			dec->pte_batch = decode_pte_unknown_batch;
+			break;
+	}
+}
+
+/**
+ * umr_vm_get_decoder - Resolve the PTE/PDE decoders of a device
+ *
+ * @asic: The device
+ * @dec: Receives the decoders of its 'gfx' IP block generation
+ *
+ * Page walks resolve the decoders once and call them for every entry,
+ * the batch variants decode a whole block (e.g. the 512 entries of a
+ * PTB) in one loop.
+ *
+ * Returns -1 if the device has no 'gfx' IP block.
+ */
+int umr_vm_get_decoder(const struct umr_asic *asic, struct umr_vm_decoder *dec)
+{
+	struct umr_ip_block *ip;
+
+	ip = umr_find_ip_block(asic, "gfx", asic->options.vm_partition);
+	if (!ip)
+		return -1;
+	umr_vm_pte_decoder(ip->discoverable.maj, ip->discoverable.min, dec);
+	umr_vm_pde_decoder(ip->discoverable.maj, ip->discoverable.min, dec);
+	return 0;
+}
+
 /**
  * umr_decode_pte_entry - Decode a Page Table Entry into its component fields
  * @asic: Pointer to the ASIC structure containing hardware configuration
@@ -55,110 +224,21 @@
  * Note: On GFX9-11, bit 54 being set indicates a PDE with the 'P' bit set,
  * which makes the PDE act like a PTE for large page mappings.
  *
+ * This looks the generation up for every call, page walks use the
+ * decoders of umr_vm_get_decoder() instead.
+ *
  * Return: A pte_fields_t structure with all decoded fields, or zeroed
  *         structure if the GFX IP block cannot be found.
  */
 pte_fields_t umr_decode_pte_entry(const struct umr_asic *asic, uint64_t pte_entry)
 {
+	struct umr_vm_decoder dec;
 	pte_fields_t pte_fields = { 0 };
-	uint64_t is_pde = 0;
-	struct umr_ip_block *ip;
 
 	/* Find the GFX IP block to determine the GPU generation */
-	ip = umr_find_ip_block(asic, "gfx", asic->options.vm_partition);
-	if (!ip) {
+	if (umr_vm_get_decoder(asic, &dec)) {
 		asic->err_msg("[BUG]: Cannot find a 'gfx' IP block in this ASIC\n");
 		return pte_fields;
 	}
-
-	/* Decode PTE fields based on GPU generation (IP major version) */
-	switch (ip->discoverable.maj) {
-		case 9: /* GFX9: Vega, AI, Raven */
-			pte_fields.valid          = pte_entry & 1;
-			pte_fields.system         = (pte_entry >> 1) & 1;
-			pte_fields.coherent       = (pte_entry >> 2) & 1;
-			pte_fields.tmz            = (pte_entry >> 3) & 1;
-			pte_fields.execute        = (pte_entry >> 4) & 1;
-			pte_fields.read           = (pte_entry >> 5) & 1;
-			pte_fields.write          = (pte_entry >> 6) & 1;
-			pte_fields.fragment       = (pte_entry >> 7) & 0x1F;
-			pte_fields.prt            = (pte_entry >> 51) & 1;
-			pte_fields.pde            = (pte_entry >> 54) & 1;
-			pte_fields.further        = (pte_entry >> 56) & 1;
-			pte_fields.mtype          = (pte_entry >> 57) & 3;
-			is_pde                    = pte_fields.further;
-			break;
-		case 10: /* GFX10: Navi1x, Navi2x */
-			pte_fields.valid          = pte_entry & 1;
-			pte_fields.system         = (pte_entry >> 1) & 1;
-			pte_fields.coherent       = (pte_entry >> 2) & 1;
-			pte_fields.tmz            = (pte_entry >> 3) & 1;
-			pte_fields.execute        = (pte_entry >> 4) & 1;
-			pte_fields.read           = (pte_entry >> 5) & 1;
-			pte_fields.write          = (pte_entry >> 6) & 1;
-			pte_fields.fragment       = (pte_entry >> 7) & 0x1F;
-			pte_fields.mtype          = (pte_entry >> 48) & 3;
-			pte_fields.prt            = (pte_entry >> 51) & 1;
-			pte_fields.pde            = (pte_entry >> 54) & 1;
-			pte_fields.further        = (pte_entry >> 56) & 1;
-			pte_fields.gcr            = (pte_entry >> 57) & 1;
-			/* GFX10.3+ adds LLC no-allocate flag */
-			if (ip->discoverable.min >= 3) {
-				pte_fields.llc_noalloc    = (pte_entry >> 58) & 1;
-			}
-			is_pde                    = pte_fields.further;
-			break;
-		case 11: /* GFX11: RDNA3 */
-			pte_fields.valid          = pte_entry & 1;
-			pte_fields.system         = (pte_entry >> 1) & 1;
-			pte_fields.coherent       = (pte_entry >> 2) & 1;
-			pte_fields.tmz            = (pte_entry >> 3) & 1;
-			pte_fields.execute        = (pte_entry >> 4) & 1;
-			pte_fields.read           = (pte_entry >> 5) & 1;
-			pte_fields.write          = (pte_entry >> 6) & 1;
-			pte_fields.fragment       = (pte_entry >> 7) & 0x1F;
-			pte_fields.mtype          = (pte_entry >> 48) & 3;
-			pte_fields.prt            = (pte_entry >> 51) & 1;
-			pte_fields.software       = (pte_entry >> 52) & 3; /* Software-defined bits */
-			pte_fields.pde            = (pte_entry >> 54) & 1;
-			pte_fields.further        = (pte_entry >> 56) & 1;
-			pte_fields.gcr            = (pte_entry >> 57) & 1; /* Graphics Cache Rinse  */
-			pte_fields.llc_noalloc    = (pte_entry >> 58) & 1; /* LLC no-allocate */
-			is_pde                    = pte_fields.further;
-			break;
-		case 12: /* GFX12: RDNA4 */
-			pte_fields.valid          = pte_entry & 1;
-			pte_fields.system         = (pte_entry >> 1) & 1;
-			pte_fields.coherent       = (pte_entry >> 2) & 1;
-			pte_fields.tmz            = (pte_entry >> 3) & 1;
-			pte_fields.execute        = (pte_entry >> 4) & 1;
-			pte_fields.read           = (pte_entry >> 5) & 1;
-			pte_fields.write          = (pte_entry >> 6) & 1;
-			pte_fields.fragment       = (pte_entry >> 7) & 0x1F;
-			pte_fields.pa_rsvd        = (pte_entry >> 48) & 0xF; /* Physical address reserved bits */
-			pte_fields.software       = (pte_entry >> 52) & 3; /* Software-defined bits */
-			pte_fields.mtype          = (pte_entry >> 54) & 3; /* Memory type moved to bits 55:54 */
-			pte_fields.prt            = (pte_entry >> 56) & 1;
-			pte_fields.gcr            = (pte_entry >> 57) & 1;
-			pte_fields.dcc            = (pte_entry >> 58) & 1; /* Delta Color Compression */
-			pte_fields.pte            = (pte_entry >> 63) & 1; /* PTE flag: 1=PTE, 0=PDE */
-			is_pde                    = !pte_fields.pte; /* Inverted logic for GFX12 */
-			break;
-	}
-
-	/*
-	 * Extract physical page base address:
-	 * - PTEs use bits [47:12] for 4KB-aligned page address (mask: 0xFFFFFFFFF000)
-	 * - PDEs use bits [47:6] for 64B-aligned address (mask: 0xFFFFFFFFFFC0)
-	 *
-	 * When 'further' bit is set (GFX9-11) or 'pte' bit is 0 (GFX12),
-	 * the entry is a PDE and needs the coarser alignment mask.
-	 */
-	if (is_pde) {
-		pte_fields.page_base_addr = pte_entry & 0xFFFFFFFFFFC0ULL; /* 64B aligned for PDEs */
-	} else {
-		pte_fields.page_base_addr = pte_entry & 0xFFFFFFFFF000ULL; /* 4KB aligned for PTEs */
-	}
-
-	return pte_fields;
+	return dec.pte(pte_entry);
 }
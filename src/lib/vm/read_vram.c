@@ -34,6 +34,94 @@ static uint64_t round_up_next_gib(uint64_t x)
 	return y;
 }
 
+/*
+ * xgmi_route_build - Compute where each node's VRAM sits in the hive
+ *
+ * In an XGMI hive the nodes memory are concatenated end to end, each
+ * node taking one segment.  The segment size is given by the MC
+ * registers which vary by architecture, if none is found the VRAM size
+ * of each node rounded up to a GiB is used.
+ */
+static void xgmi_route_build(struct umr_asic *asic)
+{
+	uint64_t segment_size, vram_size, base = 0;
+	struct umr_asic *node;
+	int n, no_nodes;
+
+	if (umr_find_reg_data_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, "@mmMC_VM_XGMI_LFB_SIZE_ALDE")) {
+		segment_size = umr_read_reg_by_name_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, "mmMC_VM_XGMI_LFB_SIZE_ALDE") << 24ULL;
+	} else if (umr_find_reg_data_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, "@mmMC_VM_XGMI_LFB_SIZE")) {
+		segment_size = umr_read_reg_by_name_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, "mmMC_VM_XGMI_LFB_SIZE") << 24ULL;
+	} else if (umr_find_reg_data_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, "@mmGCMC_VM_XGMI_LFB_SIZE")) {
+		segment_size = umr_read_reg_by_name_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, "mmGCMC_VM_XGMI_LFB_SIZE") << 24ULL;
+	} else {
+		// fallback to just rounding up vram size
+		segment_size = 0;
+	}
+
+	// with a fixed segment size the nodes are only discovered once
+	// an access reaches them
+	no_nodes = umr_xgmi_no_nodes(asic);
+	for (n = 0; n < no_nodes; n++) {
+		node = segment_size ? asic->config.xgmi.nodes[n].asic : umr_xgmi_node(asic, n);
+		vram_size = node ? node->config.vram_size : 0;
+		asic->config.xgmi.route.node[n].asic = node;
+		asic->config.xgmi.route.node[n].base = base;
+		asic->config.xgmi.route.node[n].size = segment_size ? segment_size : vram_size;
+		base += segment_size ? segment_size : round_up_next_gib(vram_size);
+	}
+	asic->config.xgmi.route.no_nodes = n;
+	asic->config.xgmi.route.resolved = 1;
+}
+
+/*
+ * xgmi_access - Access a hive linear address
+ *
+ * The access is split at node boundaries and every piece is passed
+ * to the node owning it with the address relative to that node.
+ */
+static int xgmi_access(struct umr_asic *asic, uint64_t address, uint32_t size, void *data, int write_en)
+{
+	uint8_t *p = data;
+	uint64_t len;
+	int n;
+
+	// copy callbacks so that sysram/vram accesses
+	// go through callbacks when we use other nodes
+	if (!asic->config.xgmi.callbacks_applied)
+		umr_apply_callbacks(asic, &asic->mem_funcs, &asic->reg_funcs);
+	if (!asic->config.xgmi.route.resolved)
+		xgmi_route_build(asic);
+
+	while (size) {
+		for (n = 0; n < asic->config.xgmi.route.no_nodes; n++)
+			if (address >= asic->config.xgmi.route.node[n].base &&
+			    address - asic->config.xgmi.route.node[n].base < asic->config.xgmi.route.node[n].size)
+				break;
+		if (n == asic->config.xgmi.route.no_nodes) {
+			asic->err_msg("[ERROR]: Address 0x%" PRIx64 " is not in the VRAM of any XGMI node\n", address);
+			return -1;
+		}
+
+		len = asic->config.xgmi.route.node[n].base + asic->config.xgmi.route.node[n].size - address;
+		if (len > size)
+			len = size;
+		if (!asic->config.xgmi.route.node[n].asic)
+			asic->config.xgmi.route.node[n].asic = umr_xgmi_node(asic, n);
+		if (!asic->config.xgmi.route.node[n].asic) {
+			asic->err_msg("[ERROR]: Could not open XGMI node %d\n", n);
+			return -1;
+		}
+		if (asic->config.xgmi.route.node[n].asic->mem_funcs.access_linear_vram(asic->config.xgmi.route.node[n].asic,
+				address - asic->config.xgmi.route.node[n].base, len, p, write_en) < 0)
+			return -1;
+		p += len;
+		address += len;
+		size -= len;
+	}
+	return 0;
+}
+
 /**
  * umr_access_vram - Access GPU mapped memory
  *
@@ -52,11 +140,14 @@ static uint64_t round_up_next_gib(uint64_t x)
  * @data:  The buffer to read from/write to
  * @write_en:  Set to 0 to read, non-zero to write
  *
+ * VM addresses are handed to the mem_funcs.access_vram callback first
+ * if the device has one (e.g. a rumr client has the server do the walk).
+ *
  * Returns -1 on error.
  */
 int umr_access_vram(struct umr_asic *asic, int partition, uint32_t vmid, uint64_t address, uint32_t size, void *data, int write_en, struct umr_vm_pagewalk *vmdata)
 {
-	int maj, min;
+	int maj, min, r;
 
 	umr_gfx_get_ip_ver(asic, &maj, &min);
 
@@ -90,55 +181,20 @@ int umr_access_vram(struct umr_asic *asic, int partition, uint32_t vmid, uint64_
 		// in an XGMI hive the XGMI nodes memory are concatenated together
 		// end to end.  so a linear address referenced by one node might
 		// be in another node in the hive
-		if (asic->options.use_xgmi) {
-			// TODO: This code does NOT support a page that
-			// spans multiple nodes.  That sort of setup is probably
-			// not used in the wild but we should keep note of it
-			int n;
-			uint64_t addr = address;
-			uint64_t segment_size;
-
-			// compute XGMI node segment size based on MC registers
-			// this varies depending on the architecture so we try
-			// all LFB_SIZE registers
-			if (umr_find_reg_data_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, "@mmMC_VM_XGMI_LFB_SIZE_ALDE")) {
-				segment_size = umr_read_reg_by_name_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, "mmMC_VM_XGMI_LFB_SIZE_ALDE") << 24ULL;
-			} else if (umr_find_reg_data_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, "@mmMC_VM_XGMI_LFB_SIZE")) {
-				segment_size = umr_read_reg_by_name_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, "mmMC_VM_XGMI_LFB_SIZE") << 24ULL;
-			} else if (umr_find_reg_data_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, "@mmGCMC_VM_XGMI_LFB_SIZE")) {
-				segment_size = umr_read_reg_by_name_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, "mmGCMC_VM_XGMI_LFB_SIZE") << 24ULL;
-			} else {
-				// fallback to just rounding up vram size
-				segment_size = 0;
-			}
-
-			// copy callbacks so that sysram/vram accesses
-			// go through callbacks when we use other nodes
-			if (!asic->config.xgmi.callbacks_applied)
-				umr_apply_callbacks(asic, &asic->mem_funcs, &asic->reg_funcs);
-
-			for (n = 0; asic->config.xgmi.nodes[n].asic; n++) {
-				// if remaining address is within this nodes VRAM size use it
-				if (addr < (segment_size ? segment_size : asic->config.xgmi.nodes[n].asic->config.vram_size)) {
-					asic = asic->config.xgmi.nodes[n].asic;
-					address = addr;
-					if ((address + size) > asic->config.xgmi.nodes[n].asic->config.vram_size) {
-						asic->err_msg("[BUG]: Block being read spans multiple XGMI nodes and this isn't supported by UMR.\n");
-					}
-					break;
-				} else {
-					// otherwise subtract this vram size from the address and go to the next device
-					addr -= segment_size ? segment_size : round_up_next_gib(asic->config.xgmi.nodes[n].asic->config.vram_size);
-				}
-			}
-			// now {asic, address} are the device and it's relative address
-			// that corresponds to the hive address the caller passed
-		}
+		if (asic->options.use_xgmi)
+			return xgmi_access(asic, address, size, data, write_en);
 
 		// use callback for linear access if applicable
 		return asic->mem_funcs.access_linear_vram(asic, address, size, data, write_en);
 	}
 
+	// let the backend translate and access it in one go if it can
+	if (asic->mem_funcs.access_vram) {
+		r = asic->mem_funcs.access_vram(asic, partition, vmid, address, size, data, write_en, vmdata);
+		if (r <= 0)
+			return r;
+	}
+
 	// if we hit this point we have a VM address to pagewalk so we can finally access
 	// the page in question, since <= VI and >= AI are different enough
 	// we branch depending on the GFX version
@@ -150,3 +206,98 @@ int umr_access_vram(struct umr_asic *asic, int partition, uint32_t vmid, uint64_
 
 	return 0;
 }
+
+/**
+ * umr_vm_map - List the mappings of a VM context
+ *
+ * @vmid: The VMID (and hub in bits 8:15) of the VM to walk, see
+ *        umr_access_vram().  Linear and process hubs have no page tables.
+ * @partition: The VM partition to be used
+ * @maps: Receives an array of mappings the caller must free()
+ * @no_maps: Receives the number of mappings
+ *
+ * The page tables are walked once and contiguous pages are merged.
+ * Only GFX9 and newer page tables are supported.
+ *
+ * Returns -1 on error.
+ */
+int umr_vm_map(struct umr_asic *asic, int partition, uint32_t vmid,
+	       struct umr_vm_mapping **maps, uint64_t *no_maps)
+{
+	int maj, min;
+
+	*maps = NULL;
+	*no_maps = 0;
+
+	if ((vmid & 0xFF00) == UMR_LINEAR_HUB || (vmid & 0xFF00) == UMR_PROCESS_HUB) {
+		asic->err_msg("[ERROR]: Cannot list the mappings of a linear or process hub\n");
+		return -1;
+	}
+
+	umr_gfx_get_ip_ver(asic, &maj, &min);
+	if (maj <= 8) {
+		asic->err_msg("[ERROR]: VM mapping dumps are only supported on GFX9 and newer\n");
+		return -1;
+	}
+	return umr_vm_map_ai(asic, partition, vmid, maps, no_maps);
+}
+
+/**
+ * umr_vm_translate - Translate many VAs of a VM context
+ *
+ * @vmid: The VMID (and hub in bits 8:15) the VAs belong to, see
+ *        umr_access_vram().  Linear hub addresses are returned as they are.
+ * @partition: The VM partition to be used
+ * @va: The addresses to translate
+ * @n: How many there are
+ * @out: Receives one translation per address (the raw entries walked,
+ *       the address they lead to and UMR_VM_XLATE_* flags)
+ *
+ * Meant for auditing many addresses at once, nothing is printed and the
+ * caller formats @out as it sees fit.  The VM registers are read once
+ * for the whole batch and the walks share the TLB and page table block
+ * caches.  Only GFX9 and newer page tables are supported.
+ *
+ * Returns how many addresses were translated to a valid page or -1 on
+ * error.
+ */
+int umr_vm_translate(struct umr_asic *asic, int partition, uint32_t vmid,
+		     const uint64_t *va, uint32_t n, struct umr_vm_translation *out)
+{
+	int maj, min, r;
+	uint64_t *masked;
+	uint32_t x;
+
+	if (!n)
+		return 0;
+	if ((vmid & 0xFF00) == UMR_LINEAR_HUB) {
+		for (x = 0; x < n; x++) {
+			memset(&out[x], 0, sizeof out[x]);
+			out[x].va = out[x].pa = va[x];
+			out[x].flags = UMR_VM_XLATE_VALID | UMR_VM_XLATE_LINEAR;
+		}
+		return n;
+	}
+	if ((vmid & 0xFF00) == UMR_PROCESS_HUB) {
+		asic->err_msg("[ERROR]: Process hub addresses cannot be translated\n");
+		return -1;
+	}
+
+	umr_gfx_get_ip_ver(asic, &maj, &min);
+	if (maj <= 8) {
+		asic->err_msg("[ERROR]: VM translations are only supported on GFX9 and newer\n");
+		return -1;
+	}
+
+	// VM addresses are 48 bits, see umr_access_vram()
+	masked = malloc(n * sizeof *masked);
+	if (!masked) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return -1;
+	}
+	for (x = 0; x < n; x++)
+		masked[x] = va[x] & 0xFFFFFFFFFFFFULL;
+	r = umr_vm_translate_ai(asic, partition, vmid, masked, n, out);
+	free(masked);
+	return r;
+}
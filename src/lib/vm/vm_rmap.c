@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+
+/*
+ * A reverse map holds the mappings of every VM it was built from
+ * (see umr_vm_map()) sorted by physical address so the VAs mapping a
+ * physical address are found with a binary search.  Mappings may
+ * overlap (memory shared between processes, or by one VM twice) so
+ * next to each entry the highest end address of the entries up to it
+ * is kept, which bounds how far back a lookup has to look.
+ */
+
+static int rmap_cmp(const struct umr_vm_rmap_entry *a, int system, uint64_t pa)
+{
+	if (a->system != system)
+		return a->system < system ? -1 : 1;
+	return (a->pa < pa) ? -1 : (a->pa > pa);
+}
+
+static int rmap_sort(const void *a, const void *b)
+{
+	const struct umr_vm_rmap_entry *y = b;
+
+	return rmap_cmp(a, y->system, y->pa);
+}
+
+static void rmap_max_end(struct umr_vm_rmap *rmap)
+{
+	uint64_t x, end;
+
+	for (x = 0; x < rmap->no_entries; x++) {
+		end = rmap->entries[x].pa + rmap->entries[x].size;
+		if (x && rmap->entries[x - 1].system == rmap->entries[x].system && rmap->max_end[x - 1] > end)
+			end = rmap->max_end[x - 1];
+		rmap->max_end[x] = end;
+	}
+}
+
+/*
+ * rmap_replace - Replace the entries of one VM with @maps
+ *
+ * The entries of the other VMs stay sorted so the new ones are sorted
+ * on their own and merged in.
+ */
+static int rmap_replace(struct umr_vm_rmap *rmap, uint32_t vmid, uint32_t pid,
+			const struct umr_vm_mapping *maps, uint64_t no_maps)
+{
+	struct umr_vm_rmap_entry *add, *merged;
+	uint64_t *max_end, x, y, n;
+
+	add = calloc(no_maps ? no_maps : 1, sizeof *add);
+	merged = calloc(rmap->no_entries + no_maps + 1, sizeof *merged);
+	max_end = calloc(rmap->no_entries + no_maps + 1, sizeof *max_end);
+	if (!add || !merged || !max_end) {
+		free(add);
+		free(merged);
+		free(max_end);
+		return -1;
+	}
+	for (x = 0; x < no_maps; x++) {
+		add[x].pa = maps[x].pa;
+		add[x].size = maps[x].size;
+		add[x].va = maps[x].va;
+		add[x].vmid = vmid;
+		add[x].pid = pid;
+		add[x].system = maps[x].system;
+	}
+	qsort(add, no_maps, sizeof *add, rmap_sort);
+
+	// merge what is left of the others with the new ones
+	for (x = y = n = 0; x < rmap->no_entries || y < no_maps; ) {
+		if (x < rmap->no_entries && rmap->entries[x].vmid == vmid && rmap->entries[x].pid == pid) {
+			++x;
+			continue;
+		}
+		if (y < no_maps && (x == rmap->no_entries || rmap_sort(&add[y], &rmap->entries[x]) < 0)) {
+			merged[n++] = add[y++];
+		} else {
+			merged[n++] = rmap->entries[x++];
+		}
+	}
+	free(add);
+	free(rmap->entries);
+	free(rmap->max_end);
+	rmap->entries = merged;
+	rmap->max_end = max_end;
+	rmap->no_entries = n;
+	rmap_max_end(rmap);
+	return 0;
+}
+
+/**
+ * umr_vm_rmap_update_vmid - Walk one VMID again and replace its mappings
+ *
+ * @rmap: The reverse map to update
+ * @partition: The VM partition to be used
+ * @vmid: The VMID and hub, see umr_access_vram()
+ *
+ * Returns -1 on error (the old mappings of the VMID are kept).
+ */
+int umr_vm_rmap_update_vmid(struct umr_asic *asic, struct umr_vm_rmap *rmap, int partition, uint32_t vmid)
+{
+	struct umr_vm_mapping *maps;
+	uint64_t no_maps;
+	int r;
+
+	if (umr_vm_map(asic, partition, vmid, &maps, &no_maps) < 0)
+		return -1;
+	r = rmap_replace(rmap, vmid, 0, maps, no_maps);
+	free(maps);
+	if (r)
+		asic->err_msg("[ERROR]: Out of memory\n");
+	return r;
+}
+
+/**
+ * umr_vm_rmap_update_client - Walk the VM of a user queue client again
+ *
+ * @rmap: The reverse map to update
+ * @partition: The VM partition to be used
+ * @hub: The hub the client's page tables are walked through
+ * @uq: The client, see umr_enumerate_user_queue_clients()
+ *
+ * The mappings are recorded with the PID of the client and the VMID
+ * UMR_VM_RMAP_NO_VMID as a client is not bound to one.
+ *
+ * Returns -1 on error (the old mappings of the client are kept).
+ */
+int umr_vm_rmap_update_client(struct umr_asic *asic, struct umr_vm_rmap *rmap, int partition, uint32_t hub,
+			      const struct umr_user_queue *uq)
+{
+	struct umr_user_queue *saved;
+	struct umr_vm_mapping *maps;
+	uint64_t no_maps;
+	int r;
+
+	if (!uq->state.active)
+		return -1;
+
+	// the walk uses the page table of the client bound in asic->options.user_queue
+	saved = malloc(sizeof *saved);
+	if (!saved) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return -1;
+	}
+	*saved = asic->options.user_queue;
+	asic->options.user_queue = *uq;
+	r = umr_vm_map(asic, partition, hub & 0xFF00, &maps, &no_maps);
+	asic->options.user_queue = *saved;
+	free(saved);
+	if (r < 0)
+		return -1;
+
+	r = rmap_replace(rmap, UMR_VM_RMAP_NO_VMID, uq->client_info.proc_info.pid, maps, no_maps);
+	free(maps);
+	if (r)
+		asic->err_msg("[ERROR]: Out of memory\n");
+	return r;
+}
+
+/**
+ * umr_vm_rmap_build - Build the reverse map of a device
+ *
+ * @partition: The VM partition to be used
+ * @hub: The hub whose VMIDs are walked (e.g. UMR_GFX_HUB)
+ *
+ * Every VMID of @hub with a valid page table is walked, then the VMs of
+ * the user queue clients (if they can be listed).  Update single VMs
+ * afterwards with umr_vm_rmap_update_vmid()/umr_vm_rmap_update_client().
+ *
+ * Returns the map to be freed with umr_vm_rmap_free() or NULL on error.
+ */
+struct umr_vm_rmap *umr_vm_rmap_build(struct umr_asic *asic, int partition, uint32_t hub)
+{
+	struct umr_user_queue *uqs, *uq;
+	struct umr_vm_rmap *rmap;
+	uint32_t vmid;
+
+	rmap = calloc(1, sizeof *rmap);
+	if (!rmap) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return NULL;
+	}
+
+	umr_vm_context_begin(asic);
+	for (vmid = 0; vmid < 16; vmid++)
+		umr_vm_rmap_update_vmid(asic, rmap, partition, (hub & 0xFF00) | vmid);
+	umr_vm_context_end(asic);
+
+	uqs = umr_enumerate_user_queue_clients(asic);
+	for (uq = uqs; uq; uq = uq->next)
+		if (uq->state.active)
+			umr_vm_rmap_update_client(asic, rmap, partition, hub, uq);
+	umr_user_queue_free(uqs);
+	return rmap;
+}
+
+/**
+ * umr_vm_rmap_lookup - Find the VAs that map a physical address
+ *
+ * @rmap: The reverse map
+ * @pa: The physical address (linear VRAM or system, see umr_vm_mapping)
+ * @system: Whether @pa is a system memory address
+ * @hits: Receives up to @max_hits of the VAs found
+ * @max_hits: The size of @hits
+ *
+ * Returns how many VAs map @pa, which can be more than @max_hits.
+ */
+uint64_t umr_vm_rmap_lookup(const struct umr_vm_rmap *rmap, uint64_t pa, int system,
+			    struct umr_vm_rmap_hit *hits, uint64_t max_hits)
+{
+	const struct umr_vm_rmap_entry *e;
+	uint64_t lo = 0, hi = rmap->no_entries, mid, n = 0;
+
+	// the first entry that starts after pa
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (rmap_cmp(&rmap->entries[mid], system, pa) <= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	// the entries before it that still reach pa
+	while (lo--) {
+		e = &rmap->entries[lo];
+		if (e->system != system || rmap->max_end[lo] <= pa)
+			break;
+		if (e->pa + e->size > pa) {
+			if (n < max_hits) {
+				hits[n].va = e->va + (pa - e->pa);
+				hits[n].vmid = e->vmid;
+				hits[n].pid = e->pid;
+			}
+			++n;
+		}
+	}
+	return n;
+}
+
+/**
+ * umr_vm_rmap_free - Free a reverse map
+ */
+void umr_vm_rmap_free(struct umr_vm_rmap *rmap)
+{
+	if (!rmap)
+		return;
+	free(rmap->entries);
+	free(rmap->max_end);
+	free(rmap);
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+
+#define FNV64_OFFSET 0xcbf29ce484222325ULL
+#define FNV64_PRIME  0x100000001b3ULL
+
+// FNV-1a over whole words
+static uint64_t hash_words(uint64_t h, const uint32_t *p, unsigned n)
+{
+	while (n--) {
+		h ^= *p++;
+		h *= FNV64_PRIME;
+	}
+	return h;
+}
+
+/**
+ * umr_wave_snapshot_update - Record the state of a wave and report what changed
+ *
+ * @asic: The ASIC the wave is on
+ * @snap: The previous state of the wave, replaced by the state of @wd
+ * @wd: The wave as just read (e.g. by umr_singlestep_wave())
+ * @delta: Where to store what changed
+ *
+ * The status registers are compared by value and the GPRs by a hash of
+ * every block of UMR_WAVE_GPR_BLOCK registers so the snapshot does not
+ * hold a copy of them.  Only the VGPRs allocated to the wave are hashed.
+ * The GPRs of @wd are fetched if they were not yet.  If @snap is zero
+ * filled or holds another wave everything is reported as changed.
+ *
+ * Returns 1 if anything changed, 0 if not.
+ */
+int umr_wave_snapshot_update(struct umr_asic *asic, struct umr_wave_snapshot *snap,
+			     struct umr_wave_data *wd, struct umr_wave_delta *delta)
+{
+	struct umr_wave_snapshot next;
+	unsigned b, t, n, rows;
+	uint64_t h;
+	int x, full;
+
+	memset(&next, 0, sizeof next);
+	memset(delta, 0, sizeof *delta);
+	next.valid = 1;
+	next.se = wd->se;
+	next.sh = wd->sh;
+	next.cu = wd->cu;
+	next.simd = wd->simd;
+	next.wave = wd->wave;
+	memcpy(next.reg_values, wd->ws.reg_values, sizeof next.reg_values);
+
+	full = !snap->valid || snap->se != next.se || snap->sh != next.sh ||
+	       snap->cu != next.cu || snap->simd != next.simd || snap->wave != next.wave;
+
+	for (x = 0; wd->reg_names[x]; x++)
+		if (full || next.reg_values[x] != snap->reg_values[x])
+			delta->regs |= 1ULL << x;
+
+	if (!umr_wave_data_fetch_gprs(asic, wd)) {
+		next.have_gprs = 1;
+		for (b = 0; b < 1024 / UMR_WAVE_GPR_BLOCK; b++) {
+			next.sgpr_hash[b] = hash_words(FNV64_OFFSET, &wd->sgprs[b * UMR_WAVE_GPR_BLOCK], UMR_WAVE_GPR_BLOCK);
+			if (full || !snap->have_gprs || next.sgpr_hash[b] != snap->sgpr_hash[b])
+				delta->sgpr_blocks |= 1ULL << b;
+		}
+
+		if (wd->have_vgprs) {
+			next.have_vgprs = 1;
+			rows = (umr_wave_data_get_field_id(asic, wd, UMR_WAVE_FIELD_VGPR_SIZE) + 1) << asic->parameters.vgpr_granularity;
+			if (rows > 256)
+				rows = 256;
+			for (b = 0; b * UMR_WAVE_GPR_BLOCK < rows; b++) {
+				n = rows - b * UMR_WAVE_GPR_BLOCK;
+				if (n > UMR_WAVE_GPR_BLOCK)
+					n = UMR_WAVE_GPR_BLOCK;
+				h = FNV64_OFFSET;
+				for (t = 0; t < wd->num_threads; t++)
+					h = hash_words(h, &wd->vgprs[256 * t + b * UMR_WAVE_GPR_BLOCK], n);
+				next.vgpr_hash[b] = h;
+				if (full || !snap->have_vgprs || h != snap->vgpr_hash[b])
+					delta->vgpr_blocks |= 1U << b;
+			}
+		}
+	}
+
+	*snap = next;
+	return delta->regs || delta->sgpr_blocks || delta->vgpr_blocks;
+}
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#include "umr.h"
+
+/*
+ * Partitioned parts (MI300 class) have several XCCs (GC instances), the
+ * regs2 and gprwave files pick one with the xcc_id of their SET_STATE
+ * ioctl which comes from the partition of the access.  With -vmp all
+ * (options.all_xcc) the commands that support it do their work once per
+ * XCC through umr_xcc_run().  Every XCC gets a worker thread with an
+ * access context of its own (bank state, partition, regs2 and gprwave
+ * files) so the XCCs are read at the same time, and the text each one
+ * prints is kept apart and written out in XCC order under a header.
+ */
+
+// the XCC the calling thread works on in umr_xcc_run(), -1 outside of it
+static __thread int current_xcc = -1;
+
+struct xcc_worker {
+	pthread_t thread;
+	struct umr_asic *asic;
+	struct umr_access_ctx *ctx;
+	int xcc, r;
+	umr_xcc_fn fn;
+	void *data;
+	char *text;
+	size_t text_size;
+};
+
+/**
+ * umr_xcc_count - The number of XCCs of a device
+ *
+ * Counts the logical instances of the GC block, 1 on parts that are not
+ * partitioned.
+ */
+int umr_xcc_count(struct umr_asic *asic)
+{
+	int i, n = 0;
+
+	for (i = 0; i < UMR_IP_INDEX_INSTANCES; i++)
+		if (umr_ip_block_by_kind(asic, UMR_IP_GFX, i))
+			n = i + 1;
+	return n ? n : 1;
+}
+
+/**
+ * umr_xcc_current - The XCC the calling thread works on
+ *
+ * Returns the XCC inside a umr_xcc_run() callback and -1 otherwise.
+ */
+int umr_xcc_current(void)
+{
+	return current_xcc;
+}
+
+// the XCCs can only be read at once through debugfs files that an access
+// context reopens, other backends share their state through asic->options
+static int can_run_parallel(struct umr_asic *asic)
+{
+	return !asic->options.no_kernel && !asic->options.test_log &&
+	       !asic->options.use_pci && !asic->options.jsonl &&
+	       asic->fd.mmio2 >= 0 &&
+	       asic->reg_funcs.read_reg == umr_read_reg &&
+	       asic->reg_funcs.write_reg == umr_write_reg &&
+	       !umr_access_ctx_current(asic);
+}
+
+// resolve what is looked up on first use so the workers only read it
+static void xcc_warm(struct umr_asic *asic)
+{
+	int i;
+
+	for (i = 0; i < asic->no_blocks; i++)
+		umr_load_ip_block(asic, asic->blocks[i]);
+	for (i = 0; i < UMR_CORE_REG_MAX; i++)
+		umr_core_reg(asic, i);
+}
+
+// run the callback of one XCC with its output kept in w->text
+static void xcc_call(struct xcc_worker *w)
+{
+	FILE *f, *prev;
+
+	current_xcc = w->xcc;
+	if (w->asic->options.jsonl) {
+		w->r = w->fn(w->asic, w->data);
+	} else {
+		f = open_memstream(&w->text, &w->text_size);
+		if (!f) {
+			w->asic->err_msg("[ERROR]: Out of memory\n");
+			w->r = -1;
+		} else {
+			prev = umr_output_redirect(f);
+			w->r = w->fn(w->asic, w->data);
+			umr_output_redirect(prev);
+			fclose(f);
+		}
+	}
+	current_xcc = -1;
+}
+
+static void *xcc_thread(void *arg)
+{
+	struct xcc_worker *w = arg;
+
+	umr_affinity_apply(w->asic);
+	umr_access_ctx_bind(w->ctx);
+	xcc_call(w);
+	umr_access_ctx_bind(NULL);
+	return NULL;
+}
+
+/**
+ * umr_xcc_run - Do some work on every XCC of a device
+ *
+ * @asic: The device
+ * @fn: Called once per XCC, returns non-zero on error
+ * @data: Passed to @fn
+ *
+ * On the debugfs backend the XCCs are worked on at the same time, each
+ * by a thread whose register and wave accesses go to its XCC through an
+ * access context of its own.  @fn may only read what the threads share
+ * (the asic, its register tables, @data); anything it writes must be kept
+ * per XCC, umr_xcc_current() tells @fn which one.  The other backends, and --jsonl output, run the XCCs one at
+ * a time with asic->options.vm_partition set to the XCC.
+ *
+ * The text @fn prints through umr_output_begin() is written out in XCC
+ * order, each behind a "=== XCC n ===" line (XCCs that printed nothing
+ * get no header).  JSON records carry an "xcc" member instead (see
+ * umr_xcc_current()).
+ *
+ * Returns 0 if @fn succeeded on every XCC and -1 otherwise.
+ */
+int umr_xcc_run(struct umr_asic *asic, umr_xcc_fn fn, void *data)
+{
+	struct xcc_worker *w;
+	int i, n, no_threads, vm_partition, parallel, r = 0;
+	FILE *out;
+
+	n = umr_xcc_count(asic);
+	w = calloc(n, sizeof *w);
+	if (!w) {
+		asic->err_msg("[ERROR]: Out of memory\n");
+		return -1;
+	}
+	for (i = 0; i < n; i++) {
+		w[i].asic = asic;
+		w[i].xcc = i;
+		w[i].fn = fn;
+		w[i].data = data;
+	}
+
+	parallel = n > 1 && can_run_parallel(asic);
+	if (parallel) {
+		xcc_warm(asic);
+		for (i = 0; i < n; i++) {
+			w[i].ctx = umr_access_ctx_create(asic);
+			if (!w[i].ctx) {
+				parallel = 0;
+				break;
+			}
+			w[i].ctx->vm_partition = i;
+		}
+	}
+
+	if (parallel) {
+		// the calling thread works on XCC 0 (and those without a thread)
+		for (i = 1; i < n; i++)
+			if (pthread_create(&w[i].thread, NULL, xcc_thread, &w[i]))
+				break;
+		no_threads = i;
+		xcc_thread(&w[0]);
+		for (i = no_threads; i < n; i++)
+			xcc_thread(&w[i]);
+		for (i = 1; i < no_threads; i++)
+			pthread_join(w[i].thread, NULL);
+	} else {
+		vm_partition = asic->options.vm_partition;
+		for (i = 0; i < n; i++) {
+			asic->options.vm_partition = i;
+			xcc_call(&w[i]);
+		}
+		asic->options.vm_partition = vm_partition;
+	}
+
+	if (!asic->options.jsonl) {
+		out = umr_output_begin(asic);
+		for (i = 0; i < n; i++) {
+			if (!w[i].text_size)
+				continue;
+			fprintf(out, "=== XCC %d ===\n", i);
+			fwrite(w[i].text, 1, w[i].text_size, out);
+		}
+		umr_output_end(asic);
+	}
+
+	for (i = 0; i < n; i++) {
+		if (w[i].r)
+			r = -1;
+		umr_access_ctx_free(w[i].ctx);
+		free(w[i].text);
+	}
+	free(w);
+	return r;
+}
@@ -0,0 +1,574 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#define _GNU_SOURCE
+#include "umr.h"
+#include "umr_rumr.h"
+
+#include <limits.h>
+#include <stdarg.h>
+#include <time.h>
+
+/**
+ * Microbenchmarks of the library hot paths.  Everything runs against
+ * test harness ASICs (the envdef files of test/vm and the vectors of
+ * test/kat) so no GPU is needed, and every result is one JSON object
+ * per line so the numbers can be collected and compared per release.
+ *
+ * Allocations are counted by wrapping malloc(), calloc() and realloc()
+ * at link time (see CMakeLists.txt), so only the calls made from umr's
+ * own code are seen.
+ */
+
+static unsigned long long no_allocs, alloc_bytes;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+	__atomic_add_fetch(&no_allocs, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&alloc_bytes, size, __ATOMIC_RELAXED);
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+	__atomic_add_fetch(&no_allocs, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&alloc_bytes, nmemb * size, __ATOMIC_RELAXED);
+	return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	__atomic_add_fetch(&no_allocs, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&alloc_bytes, size, __ATOMIC_RELAXED);
+	return __real_realloc(ptr, size);
+}
+
+static int quiet_printf(const char *fmt, ...)
+{
+	(void)fmt;
+	return 0;
+}
+
+static int err_printf(const char *fmt, ...)
+{
+	va_list ap;
+	int r;
+
+	va_start(ap, fmt);
+	r = vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	return r;
+}
+
+struct bench_state {
+	struct umr_asic *asic;
+	struct umr_test_harness *th;
+
+	// registers and bitfields to cycle through
+	struct umr_reg **regs;
+	int *bits;
+	int no_regs, cur;
+
+	uint32_t *words, nwords;
+	enum umr_ring_type rt;
+	uint8_t *inst;
+	unsigned inst_bytes;
+	struct rumr_buffer *sasic;
+	uint64_t va;
+	uint32_t vmid;
+};
+
+typedef int (*bench_op)(struct bench_state *s);
+
+static const char *vectors_dir;
+static uint64_t min_ns = 200000000ULL;
+static const char *filter;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * run_bench - Time one operation
+ * @name: Name the result is reported under
+ * @op: The operation, returns a negative value on error
+ * @s: State passed to @op
+ *
+ * Runs @op in batches that double in size until a batch takes at least
+ * min_ns and reports the per operation time and allocations of that
+ * batch.  One call before timing warms any cache @op fills on first use.
+ */
+static void run_bench(const char *name, bench_op op, struct bench_state *s)
+{
+	unsigned long long allocs, bytes;
+	uint64_t n, i, t;
+
+	if (filter && !strstr(name, filter))
+		return;
+	if (op(s) < 0) {
+		printf("{\"name\":\"%s\",\"error\":\"operation failed\"}\n", name);
+		return;
+	}
+	for (n = 1;; n *= 2) {
+		allocs = no_allocs;
+		bytes = alloc_bytes;
+		t = now_ns();
+		for (i = 0; i < n; i++)
+			op(s);
+		t = now_ns() - t;
+		if (t >= min_ns || n >= (1ULL << 40))
+			break;
+	}
+	printf("{\"name\":\"%s\",\"iterations\":%" PRIu64 ",\"ns_per_op\":%.1f,\"allocs_per_op\":%.2f,\"bytes_per_op\":%.1f}\n",
+		name, n, (double)t / n, (double)(no_allocs - allocs) / n, (double)(alloc_bytes - bytes) / n);
+	fflush(stdout);
+}
+
+static struct umr_asic *open_envdef(struct bench_state *s, const char *file, char *asicname)
+{
+	struct umr_options options;
+	char path[PATH_MAX];
+
+	memset(s, 0, sizeof *s);
+	snprintf(path, sizeof path, "%s/vm/%s", vectors_dir, file);
+	s->th = umr_create_test_harness_file(path);
+	if (!s->th)
+		return NULL;
+
+	memset(&options, 0, sizeof(options));
+	options.is_virtual = 1;
+	options.force_asic_file = 1;
+	s->asic = umr_discover_asic_by_name(&options, asicname, err_printf);
+	if (!s->asic) {
+		umr_free_test_harness(s->th);
+		return NULL;
+	}
+	umr_attach_test_harness(s->th, s->asic);
+	s->asic->std_msg = quiet_printf;
+	s->asic->mem_funcs.vm_message = quiet_printf;
+	return s->asic;
+}
+
+static struct umr_asic *open_kat(struct bench_state *s, const char *name)
+{
+	struct umr_options options;
+	char path[PATH_MAX];
+
+	memset(s, 0, sizeof *s);
+	snprintf(path, sizeof path, "%s/kat/%s.txt", vectors_dir, name);
+	s->th = umr_create_test_harness_file(path);
+	if (!s->th)
+		return NULL;
+	if (!s->th->discovery.contents) {
+		umr_free_test_harness(s->th);
+		return NULL;
+	}
+
+	memset(&options, 0, sizeof(options));
+	options.forcedid = -1;
+	options.scanblock = "";
+	options.vm_partition = -1;
+	options.th = s->th;
+	options.test_log = 1;
+	s->asic = umr_discover_asic_by_discovery_table("emulated", &options, err_printf);
+	if (!s->asic) {
+		umr_free_test_harness(s->th);
+		return NULL;
+	}
+	umr_attach_test_harness(s->th, s->asic);
+	// the vectors don't hold every IB the rings point at
+	s->asic->err_msg = quiet_printf;
+	s->asic->std_msg = quiet_printf;
+	s->asic->mem_funcs.vm_message = quiet_printf;
+	return s->asic;
+}
+
+static void close_state(struct bench_state *s)
+{
+	if (s->asic)
+		umr_close_asic(s->asic);
+	umr_free_test_harness(s->th);
+	free(s->regs);
+	free(s->bits);
+	free(s->words);
+	free(s->inst);
+	if (s->sasic)
+		rumr_buffer_free(s->sasic);
+	memset(s, 0, sizeof *s);
+}
+
+// every stride'th MMIO register with bitfields so lookups don't all hit the same entry
+static int collect_regs(struct bench_state *s, int max)
+{
+	struct umr_asic *asic = s->asic;
+	int i, j, total = 0, stride;
+
+	// loads every IP block if they are loaded lazily
+	umr_find_reg_by_addr(asic, 0, NULL);
+	for (i = 0; i < asic->no_blocks; i++)
+		for (j = 0; j < asic->blocks[i]->no_regs; j++)
+			if (asic->blocks[i]->regs[j].type == REG_MMIO && asic->blocks[i]->regs[j].no_bits)
+				++total;
+	if (!total)
+		return -1;
+	stride = total > max ? total / max : 1;
+
+	s->regs = calloc(max, sizeof *s->regs);
+	s->bits = calloc(max, sizeof *s->bits);
+	for (total = 0, i = 0; i < asic->no_blocks && s->no_regs < max; i++) {
+		for (j = 0; j < asic->blocks[i]->no_regs && s->no_regs < max; j++) {
+			struct umr_reg *reg = &asic->blocks[i]->regs[j];
+
+			if (reg->type != REG_MMIO || !reg->no_bits || total++ % stride)
+				continue;
+			s->bits[s->no_regs] = s->no_regs % reg->no_bits;
+			s->regs[s->no_regs++] = reg;
+		}
+	}
+	return 0;
+}
+
+static int op_reg_by_name(struct bench_state *s)
+{
+	struct umr_reg *reg = s->regs[s->cur++ % s->no_regs];
+
+	return umr_find_reg_by_name(s->asic, reg->regname, NULL) ? 0 : -1;
+}
+
+static int op_reg_by_addr(struct bench_state *s)
+{
+	struct umr_reg *reg = s->regs[s->cur++ % s->no_regs];
+
+	return umr_find_reg_by_addr(s->asic, reg->addr, NULL) ? 0 : -1;
+}
+
+static int op_reg_wild(struct bench_state *s)
+{
+	struct umr_find_reg_iter *iter;
+	int n = 0;
+
+	iter = umr_find_reg_wild_first(s->asic, NULL, "*vm_fb_loc*");
+	while (iter && umr_find_reg_wild_next(&iter).reg)
+		++n;
+	return n ? 0 : -1;
+}
+
+static int op_bitslice(struct bench_state *s)
+{
+	int i = s->cur++ % s->no_regs;
+	struct umr_reg *reg = s->regs[i];
+
+	umr_bitslice_reg_quiet(s->asic, reg, reg->bits[s->bits[i]].regname, 0xDEADBEEF);
+	return 0;
+}
+
+static void bench_registers(void)
+{
+	struct bench_state s;
+
+	if (!open_envdef(&s, "navi_reg_only.envdef", "navi10")) {
+		fprintf(stderr, "[ERROR]: Could not open navi_reg_only.envdef\n");
+		return;
+	}
+	if (!collect_regs(&s, 256)) {
+		run_bench("reg_lookup_by_name", op_reg_by_name, &s);
+		run_bench("reg_lookup_by_addr", op_reg_by_addr, &s);
+		run_bench("reg_lookup_wildcard", op_reg_wild, &s);
+		run_bench("bitslice_extract", op_bitslice, &s);
+	}
+	close_state(&s);
+}
+
+static int op_vm_read(struct bench_state *s)
+{
+	uint64_t data;
+
+	return umr_read_vram(s->asic, -1, UMR_GFX_HUB | s->vmid, s->va, sizeof data, &data);
+}
+
+static int op_vm_walk(struct bench_state *s)
+{
+	umr_vm_tlb_flush(s->asic);
+	return op_vm_read(s);
+}
+
+static void bench_vm(void)
+{
+	struct bench_state s;
+
+	// the single level system context of direct_vm_test0 and the deeper
+	// PTE.further walk of direct_vm_test10, the harness hands out each
+	// register value once so the VM registers are snapshotted by the
+	// first read and reused by the others
+	if (open_envdef(&s, "direct_vm_test0.envdef", "raven1")) {
+		s.va = 0x444000;
+		s.vmid = 0;
+		umr_vm_context_begin(s.asic);
+		run_bench("vm_walk_depth0", op_vm_walk, &s);
+		run_bench("vm_read_tlb_hit_depth0", op_vm_read, &s);
+		umr_vm_context_end(s.asic);
+		close_state(&s);
+	}
+	if (open_envdef(&s, "direct_vm_test10.envdef", "raven1")) {
+		s.va = 0x7f3bcca00000ULL;
+		s.vmid = 8;
+		umr_vm_context_begin(s.asic);
+		run_bench("vm_walk_depth3", op_vm_walk, &s);
+		run_bench("vm_read_tlb_hit_depth3", op_vm_read, &s);
+		umr_vm_context_end(s.asic);
+		close_state(&s);
+	}
+}
+
+static int op_decode(struct bench_state *s)
+{
+	struct umr_packet_stream *str;
+
+	str = umr_packet_decode_buffer(s->asic, NULL, 0, 0, s->words, s->nwords, s->rt, NULL);
+	if (!str)
+		return -1;
+	umr_packet_free(str);
+	return 0;
+}
+
+static void bench_decode(const char *kat)
+{
+	static const struct {
+		const char *name;
+		enum umr_ring_type rt;
+	} types[] = {
+		{ "pm4", UMR_RING_PM4 },
+		{ "sdma", UMR_RING_SDMA },
+		{ "mes", UMR_RING_MES },
+		{ "hsa", UMR_RING_HSA },
+	};
+	struct bench_state s;
+	uint32_t *ring, ringsize;
+	char name[128];
+	unsigned i;
+
+	if (!open_kat(&s, kat)) {
+		fprintf(stderr, "[ERROR]: Could not open KAT vector '%s'\n", kat);
+		return;
+	}
+	ring = umr_read_ring_data(s.asic, "gfx_0.0.0", &ringsize);
+	// an empty ring block underflows the size
+	if (ring && ringsize >= 4 && ringsize < (1U << 28)) {
+		// skip the rptr/wptr/driver wptr header
+		s.nwords = ringsize / 4;
+		s.words = calloc(s.nwords, sizeof *s.words);
+		memcpy(s.words, &ring[3], s.nwords * 4);
+
+		// the vectors only hold gfx rings, MES and HSA get the same words
+		// which mostly exercises their resync on unknown headers
+		for (i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+			if (types[i].rt == UMR_RING_SDMA)
+				continue;
+			s.rt = types[i].rt;
+			snprintf(name, sizeof name, "decode_%s/%s", types[i].name, kat);
+			run_bench(name, op_decode, &s);
+		}
+
+		// SDMA stops at the first unknown opcode so it gets a synthetic
+		// stream of the same length instead
+		for (i = 0; i + 12 <= s.nwords; i += 12) {
+			s.words[i + 0] = 0x2;           // WRITE LINEAR
+			s.words[i + 1] = 0x1000 + i;
+			s.words[i + 2] = 0;
+			s.words[i + 3] = 2;             // 3 dwords
+			s.words[i + 4] = s.words[i + 5] = s.words[i + 6] = i;
+			s.words[i + 7] = 0x5;           // FENCE
+			s.words[i + 8] = 0x2000;
+			s.words[i + 9] = 0;
+			s.words[i + 10] = i;
+			s.words[i + 11] = 0;            // NOP
+		}
+		for (; i < s.nwords; i++)
+			s.words[i] = 0;
+		s.rt = UMR_RING_SDMA;
+		snprintf(name, sizeof name, "decode_sdma/%s", kat);
+		run_bench(name, op_decode, &s);
+	}
+	free(ring);
+	close_state(&s);
+}
+
+// SIMD busy with wave slot 1 valid, as test_scan_wave_arena_navi does
+static uint32_t fake_status_valid;
+static int fake_status_idx;
+
+static int fake_sq_info(struct umr_asic *asic, unsigned se, unsigned sh, unsigned cu, struct umr_wave_status *ws)
+{
+	(void)asic; (void)se; (void)sh; (void)cu;
+	ws->sq_info.busy = 1;
+	return 0;
+}
+
+static int fake_wave_status(struct umr_asic *asic, unsigned se, unsigned sh, unsigned cu, unsigned simd, unsigned wave, struct umr_wave_status *ws)
+{
+	(void)asic; (void)se; (void)sh; (void)cu; (void)simd;
+	memset(ws->reg_values, 0, sizeof ws->reg_values);
+	if (wave == 1)
+		ws->reg_values[fake_status_idx] = fake_status_valid;
+	return 0;
+}
+
+static int op_wave_scan(struct bench_state *s)
+{
+	struct umr_wave_data *head;
+
+	head = umr_scan_wave_data(s->asic);
+	if (!head)
+		return -1;
+	umr_free_wave_data(head);
+	return 0;
+}
+
+static void bench_waves(void)
+{
+	struct umr_wave_data wd;
+	struct bench_state s;
+	struct umr_asic *asic;
+
+	asic = open_envdef(&s, "navi_reg_only.envdef", "navi10");
+	if (!asic)
+		return;
+	asic->options.vm_partition = -1;
+	asic->options.skip_gprs = 1;
+	if (!umr_wave_data_init(asic, &wd)) {
+		for (fake_status_idx = 0; strcmp(wd.reg_names[fake_status_idx], "ixSQ_WAVE_STATUS"); fake_status_idx++);
+		fake_status_valid = umr_bitslice_compose_value(asic, umr_find_reg_by_name(asic, "ixSQ_WAVE_STATUS", NULL), "VALID", 1);
+		asic->wave_funcs.get_wave_sq_info = fake_sq_info;
+		asic->wave_funcs.get_wave_status = fake_wave_status;
+		asic->wave_funcs.get_wave_status_bulk = NULL;
+		asic->config.gfx.max_shader_engines = 2;
+		asic->config.gfx.max_sh_per_se = 2;
+		asic->config.gfx.max_cu_per_sh = 10;
+		run_bench("wave_scan", op_wave_scan, &s);
+	}
+	close_state(&s);
+}
+
+static int op_disasm(struct bench_state *s)
+{
+	struct umr_disasm_block *b;
+
+	b = umr_shader_disasm_block(s->asic, s->inst, s->inst_bytes, 0);
+	if (!b)
+		return -1;
+	free(b);
+	return 0;
+}
+
+static void bench_disasm(void)
+{
+	// s_mov_b32 s0, s1 / v_mov_b32 v0, v1 / s_nop 0, ended by s_endpgm
+	static const uint32_t body[] = { 0xBE800301, 0x7E000301, 0xBF800000 };
+	struct bench_state s;
+	unsigned i, n = 256;
+
+	if (!open_envdef(&s, "navi_reg_only.envdef", "navi10"))
+		return;
+	s.inst_bytes = n * 4;
+	s.inst = calloc(1, s.inst_bytes);
+	for (i = 0; i < n - 1; i++)
+		((uint32_t *)s.inst)[i] = body[i % 3];
+	((uint32_t *)s.inst)[n - 1] = 0xBF810000;
+	run_bench("shader_disasm_256", op_disasm, &s);
+	close_state(&s);
+}
+
+static int op_serialize(struct bench_state *s)
+{
+	struct rumr_buffer *buf;
+
+	buf = rumr_serialize_asic(s->asic);
+	if (!buf)
+		return -1;
+	rumr_buffer_free(buf);
+	return 0;
+}
+
+static int op_parse(struct bench_state *s)
+{
+	struct umr_asic *asic;
+
+	s->sasic->roffset = 0;
+	asic = rumr_parse_serialized_asic(s->sasic);
+	if (!asic)
+		return -1;
+	umr_free_asic(asic);
+	return 0;
+}
+
+static void bench_rumr(void)
+{
+	struct bench_state s;
+
+	if (!open_envdef(&s, "navi_reg_only.envdef", "navi10"))
+		return;
+	// the serializer walks every register so they all need to be loaded
+	umr_find_reg_by_addr(s.asic, 0, NULL);
+	run_bench("rumr_serialize_asic", op_serialize, &s);
+	s.sasic = rumr_serialize_asic(s.asic);
+	if (s.sasic)
+		run_bench("rumr_parse_asic", op_parse, &s);
+	close_state(&s);
+}
+
+int main(int argc, char **argv)
+{
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-t") && i + 1 < argc)
+			min_ns = strtoull(argv[++i], NULL, 10) * 1000000ULL;
+		else if (!strcmp(argv[i], "-f") && i + 1 < argc)
+			filter = argv[++i];
+		else if (!vectors_dir)
+			vectors_dir = argv[i];
+	}
+	if (!vectors_dir) {
+		fprintf(stderr, "Usage: %s [-t <ms per benchmark>] [-f <name filter>] <vectors dir>\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	printf("{\"umr_version\":\"%s\",\"umr_rev\":\"%s\",\"min_ns\":%" PRIu64 "}\n", UMR_BUILD_VER, UMR_BUILD_REV, min_ns);
+	bench_registers();
+	bench_vm();
+	bench_decode("rs_navi48_test1");
+	bench_decode("rs_phx_test1");
+	bench_waves();
+	bench_disasm();
+	bench_rumr();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,373 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#define _GNU_SOURCE
+#include "umrapp.h"
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdarg.h>
+
+/**
+ * Runs the known answer tests of test/kat in one process.  Every case
+ * gets its own test harness and ASIC, the register database is shared
+ * between them (see read_ip.c) so each IP file is parsed once, and the
+ * cases run on a pool of threads with their output kept in memory and
+ * compared against the .answer* files.
+ *
+ * Only what the vectors use is understood: --test-harness, --force,
+ * --option and --ring-stream.  Anything else fails the case so it can
+ * be run through test/runtest.sh instead.
+ */
+
+struct kat_case {
+	char name[256];
+	char *cmd;
+	char *output;
+	size_t output_size;
+	char *error; // why the case failed, NULL if it passed
+};
+
+struct kat_run {
+	const char *dir;
+	struct kat_case *cases;
+	int no_cases;
+	int next;
+	pthread_mutex_t lock;
+};
+
+// the decode of the calling thread, the ASIC message callbacks print into it
+static __thread FILE *kat_out;
+
+static int kat_printf(const char *fmt, ...)
+{
+	va_list ap;
+	int r;
+
+	va_start(ap, fmt);
+	r = vfprintf(kat_out ? kat_out : stderr, fmt, ap);
+	va_end(ap);
+	return r;
+}
+
+static char *read_file(const char *path, size_t *size)
+{
+	char *buf = NULL;
+	long n;
+	FILE *f;
+
+	f = fopen(path, "rb");
+	if (!f)
+		return NULL;
+	if (!fseek(f, 0, SEEK_END) && (n = ftell(f)) >= 0 && !fseek(f, 0, SEEK_SET)) {
+		buf = malloc(n + 1);
+		if (buf && fread(buf, 1, n, f) != (size_t)n) {
+			free(buf);
+			buf = NULL;
+		} else if (buf) {
+			buf[n] = 0;
+			*size = n;
+		}
+	}
+	fclose(f);
+	return buf;
+}
+
+static char *case_error(const char *fmt, ...)
+{
+	va_list ap;
+	char *s = NULL;
+
+	va_start(ap, fmt);
+	if (vasprintf(&s, fmt, ap) < 0)
+		s = NULL;
+	va_end(ap);
+	return s ? s : strdup("out of memory");
+}
+
+// vectors name their files "test/..." which runtest.sh rewrites to the vector directory
+static char *vector_path(const char *dir, const char *arg)
+{
+	char *s;
+
+	if (strncmp(arg, "test/", 5))
+		return strdup(arg);
+	if (asprintf(&s, "%s/%s", dir, arg + 5) < 0)
+		return NULL;
+	return s;
+}
+
+static void run_case(struct kat_run *run, struct kat_case *kc)
+{
+	struct umr_test_harness *th = NULL;
+	struct umr_options options;
+	struct umr_asic *asic = NULL;
+	char *argv[64], *tok, *save, *ring = NULL, *path;
+	int argc, i;
+	FILE *out;
+
+	memset(&options, 0, sizeof options);
+	options.forcedid = -1;
+	options.scanblock = "";
+	options.vm_partition = -1;
+
+	for (argc = 0, tok = strtok_r(kc->cmd, " \t\r\n", &save); tok && argc < 64; tok = strtok_r(NULL, " \t\r\n", &save))
+		argv[argc++] = tok;
+
+	for (i = 0; i < argc; i++) {
+		if (i + 1 >= argc) {
+			kc->error = case_error("'%s' needs a parameter", argv[i]);
+			goto out;
+		}
+		if (!strcmp(argv[i], "--test-harness") || !strcmp(argv[i], "-th")) {
+			path = vector_path(run->dir, argv[++i]);
+			th = path ? umr_create_test_harness_file(path) : NULL;
+			free(path);
+			if (!th) {
+				kc->error = case_error("could not load test harness '%s'", argv[i]);
+				goto out;
+			}
+			options.th = th;
+			options.test_log = 1;
+		} else if (!strcmp(argv[i], "--force") || !strcmp(argv[i], "-f")) {
+			strncpy(options.dev_name, argv[++i], sizeof(options.dev_name) - 1);
+			options.instance = -1;
+		} else if (!strcmp(argv[i], "--option") || !strcmp(argv[i], "-O")) {
+			if (umr_parse_options(&options, argv[++i])) {
+				kc->error = case_error("unknown option in '%s'", argv[i]);
+				goto out;
+			}
+		} else if (!strcmp(argv[i], "--ring-stream") || !strcmp(argv[i], "-RS")) {
+			ring = argv[++i];
+		} else {
+			kc->error = case_error("'%s' is not supported by umrkat", argv[i]);
+			goto out;
+		}
+	}
+	if (!th || !ring) {
+		kc->error = case_error("needs --test-harness and --ring-stream");
+		goto out;
+	}
+
+	if (th->discovery.contents)
+		asic = umr_discover_asic_by_discovery_table("emulated", &options, kat_printf);
+	else if (options.dev_name[0])
+		asic = umr_discover_asic_by_name(&options, options.dev_name, kat_printf);
+	if (!asic) {
+		kc->error = case_error("could not create the ASIC");
+		goto out;
+	}
+	umr_attach_test_harness(th, asic);
+
+	out = open_memstream(&kc->output, &kc->output_size);
+	if (!out) {
+		kc->error = case_error("out of memory");
+		goto out;
+	}
+	kat_out = out;
+	asic->err_msg = kat_printf;
+	asic->std_msg = kat_printf;
+	asic->mem_funcs.vm_message = kat_printf;
+	umr_read_ring_stream_to(asic, ring, out);
+	kat_out = NULL;
+	fclose(out);
+out:
+	if (asic)
+		umr_close_asic(asic);
+	umr_free_test_harness(th);
+}
+
+// passes if the output matches any of <name>.answer, <name>.answer1, ...
+static void check_case(struct kat_run *run, struct kat_case *kc)
+{
+	char prefix[300], path[PATH_MAX], *answer;
+	size_t size, line, best_line = 0, x;
+	struct dirent *de;
+	DIR *d;
+	int found = 0;
+
+	snprintf(prefix, sizeof prefix, "%s.answer", kc->name);
+	snprintf(path, sizeof path, "%s/kat", run->dir);
+	d = opendir(path);
+	if (!d) {
+		kc->error = case_error("could not open '%s'", path);
+		return;
+	}
+	while ((de = readdir(d))) {
+		if (strncmp(de->d_name, prefix, strlen(prefix)))
+			continue;
+		snprintf(path, sizeof path, "%s/kat/%s", run->dir, de->d_name);
+		answer = read_file(path, &size);
+		if (!answer)
+			continue;
+		found = 1;
+		if (size == kc->output_size && !memcmp(answer, kc->output, size)) {
+			free(answer);
+			closedir(d);
+			return;
+		}
+		// remember how far the closest answer got for the report
+		for (line = 1, x = 0; x < size && x < kc->output_size && answer[x] == kc->output[x]; x++)
+			if (answer[x] == '\n')
+				++line;
+		if (line > best_line)
+			best_line = line;
+		free(answer);
+	}
+	closedir(d);
+	if (!found)
+		kc->error = case_error("no %s* file", prefix);
+	else
+		kc->error = case_error("output differs from every answer, the closest from line %lu", (unsigned long)best_line);
+}
+
+static void *kat_worker(void *arg)
+{
+	struct kat_run *run = arg;
+	struct kat_case *kc;
+
+	for (;;) {
+		pthread_mutex_lock(&run->lock);
+		kc = run->next < run->no_cases ? &run->cases[run->next++] : NULL;
+		pthread_mutex_unlock(&run->lock);
+		if (!kc)
+			return NULL;
+		// a .cmd that could not be read already carries its error
+		if (kc->error)
+			continue;
+		run_case(run, kc);
+		if (!kc->error)
+			check_case(run, kc);
+	}
+}
+
+static int load_cases(struct kat_run *run)
+{
+	char path[PATH_MAX];
+	struct dirent *de;
+	size_t size, len;
+	DIR *d;
+
+	snprintf(path, sizeof path, "%s/kat", run->dir);
+	d = opendir(path);
+	if (!d) {
+		fprintf(stderr, "[ERROR]: Cannot open '%s'\n", path);
+		return -1;
+	}
+	while ((de = readdir(d))) {
+		len = strlen(de->d_name);
+		if (len < 5 || len - 4 >= sizeof run->cases->name || strcmp(de->d_name + len - 4, ".cmd"))
+			continue;
+		run->cases = realloc(run->cases, (run->no_cases + 1) * sizeof *run->cases);
+		memset(&run->cases[run->no_cases], 0, sizeof *run->cases);
+		memcpy(run->cases[run->no_cases].name, de->d_name, len - 4);
+		snprintf(path, sizeof path, "%s/kat/%s", run->dir, de->d_name);
+		run->cases[run->no_cases].cmd = read_file(path, &size);
+		if (!run->cases[run->no_cases].cmd)
+			run->cases[run->no_cases].error = case_error("cannot read '%s'", path);
+		++run->no_cases;
+	}
+	closedir(d);
+	return 0;
+}
+
+// keep what a failed case printed so it can be reviewed and added as another answer
+static void save_output(struct kat_case *kc)
+{
+	char path[PATH_MAX];
+	FILE *f;
+
+	if (!kc->output)
+		return;
+	snprintf(path, sizeof path, "/tmp/umr.%s.test", kc->name);
+	f = fopen(path, "wb");
+	if (!f)
+		return;
+	fwrite(kc->output, 1, kc->output_size, f);
+	fclose(f);
+	printf("\toutput saved to %s\n", path);
+}
+
+static int cmp_case(const void *a, const void *b)
+{
+	return strcmp(((const struct kat_case *)a)->name, ((const struct kat_case *)b)->name);
+}
+
+int main(int argc, char **argv)
+{
+	struct kat_run run = { 0 };
+	pthread_t *threads;
+	int i, jobs = 0, started, failed = 0;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-j") && i + 1 < argc)
+			jobs = atoi(argv[++i]);
+		else if (!run.dir)
+			run.dir = argv[i];
+	}
+	if (!run.dir) {
+		fprintf(stderr, "Usage: %s [-j <jobs>] <vectors dir>\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (jobs <= 0)
+		jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	if (jobs <= 0)
+		jobs = 1;
+
+	if (load_cases(&run))
+		return EXIT_FAILURE;
+	qsort(run.cases, run.no_cases, sizeof *run.cases, cmp_case);
+	pthread_mutex_init(&run.lock, NULL);
+
+	if (jobs > run.no_cases)
+		jobs = run.no_cases ? run.no_cases : 1;
+
+	threads = calloc(jobs, sizeof *threads);
+	for (started = 0; started < jobs; started++)
+		if (pthread_create(&threads[started], NULL, kat_worker, &run))
+			break;
+	// no threads at all still runs the cases, just serially
+	if (!started)
+		kat_worker(&run);
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+
+	for (i = 0; i < run.no_cases; i++) {
+		if (run.cases[i].error) {
+			printf("FAILED: %s: %s\n", run.cases[i].name, run.cases[i].error);
+			save_output(&run.cases[i]);
+			++failed;
+		} else {
+			printf("PASSED: %s\n", run.cases[i].name);
+		}
+		free(run.cases[i].error);
+		free(run.cases[i].output);
+		free(run.cases[i].cmd);
+	}
+	printf("%d of %d KAT cases passed.\n", run.no_cases - failed, run.no_cases);
+	free(run.cases);
+	pthread_mutex_destroy(&run.lock);
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -2,9 +2,15 @@
 
 DECLARE_TESTS(mmio_tests);
 DECLARE_TESTS(vm_tests);
-#if COMMANDS_TEST
+DECLARE_TESTS(packet_tests);
+DECLARE_TESTS(capture_tests);
 DECLARE_TESTS(server_tests);
-#endif
+DECLARE_TESTS(sysfs_tests);
+DECLARE_TESTS(fence_tests);
+DECLARE_TESTS(alloc_tests);
+DECLARE_TESTS(clock_tests);
+DECLARE_TESTS(uring_tests);
+DECLARE_TESTS(watch_tests);
 
 int main(int argc, char **argv)
 {
@@ -12,9 +18,15 @@ int main(int argc, char **argv)
 
     REGISTER_TESTS(mmio_tests);
     REGISTER_TESTS(vm_tests);
-    #if COMMANDS_TEST
+    REGISTER_TESTS(packet_tests);
+    REGISTER_TESTS(capture_tests);
     REGISTER_TESTS(server_tests);
-    #endif
+    REGISTER_TESTS(sysfs_tests);
+    REGISTER_TESTS(fence_tests);
+    REGISTER_TESTS(alloc_tests);
+    REGISTER_TESTS(clock_tests);
+    REGISTER_TESTS(uring_tests);
+    REGISTER_TESTS(watch_tests);
 
     if (1 < argc) {
         global_config.envdef_base_dir = argv[1];
@@ -0,0 +1,40 @@
+#include "test_framework.h"
+
+enum TEST_RESULT test_huge_alloc_navi(struct umr_asic* asic)
+{
+    unsigned char *small[64], *big;
+    size_t i, j;
+
+    // zeroed, aligned and not overlapping
+    for (i = 0; i < 64; i++) {
+        small[i] = umr_huge_alloc(100 + i);
+        ASSERT_NOT_NULL(small[i]);
+        ASSERT_EQ((uintptr_t)small[i] & 15, 0);
+        for (j = 0; j < 100 + i; j++)
+            ASSERT_EQ(small[i][j], 0);
+        memset(small[i], 0xAA, 100 + i);
+    }
+    for (i = 1; i < 64; i++)
+        ASSERT_EQ(small[i - 1][99 + i - 1], 0xAA);
+
+    big = umr_huge_alloc(3 * 1024 * 1024);
+    ASSERT_NOT_NULL(big);
+    ASSERT_EQ(big[3 * 1024 * 1024 - 1], 0);
+    big[3 * 1024 * 1024 - 1] = 1;
+    umr_huge_free(big);
+
+    for (i = 0; i < 64; i++)
+        umr_huge_free(small[i]);
+
+    // memory from calloc() can be freed too
+    umr_huge_free(calloc(1, 32));
+    umr_huge_free(NULL);
+
+    // the register tables of the asic came from it as well
+    ASSERT_NOT_NULL(umr_find_reg_data_by_ip_by_instance(asic, "gfx", -1, "mmGRBM_STATUS"));
+    return TEST_SUCCESS;
+}
+
+DEFINE_TESTS(alloc_tests)
+TEST(test_huge_alloc_navi, "navi_reg_only.envdef", "navi10"),
+END_TESTS(alloc_tests);
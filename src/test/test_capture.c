@@ -0,0 +1,75 @@
+#include "test_framework.h"
+
+static int capture_fake_vram(struct umr_asic* asic, uint64_t address, uint32_t size, void* data, int write_en)
+{
+    uint8_t *p = data;
+    uint32_t x;
+
+    (void)asic; (void)write_en;
+    // the second 64K are zero pages
+    for (x = 0; x < size; x++)
+        p[x] = ((address + x) & 0x10000) ? 0 : (uint8_t)((address + x) * 7 + 1);
+    return 0;
+}
+
+enum TEST_RESULT test_capture_bundle_navi(struct umr_asic* asic)
+{
+    char path[] = "/tmp/umr_capture_XXXXXX";
+    struct umr_capture_bundle *b;
+    uint8_t buf[4096], ref[4096];
+    uint32_t v[2];
+    FILE *f;
+    long size;
+    int fd;
+
+    fd = mkstemp(path);
+    ASSERT_EQ(fd >= 0, 1);
+    close(fd);
+
+    asic->mem_funcs.access_linear_vram = capture_fake_vram;
+    ASSERT_SUCCESS(umr_capture_start(asic));
+    ASSERT_SUCCESS(asic->mem_funcs.access_linear_vram(asic, 0x1FF0, 100, buf, 0));
+    ASSERT_SUCCESS(asic->mem_funcs.access_linear_vram(asic, 0x11000, 4096, buf, 0));
+    ASSERT_SUCCESS(asic->mem_funcs.access_linear_vram(asic, 0x13000, 4096, buf, 0));
+    v[0] = asic->reg_funcs.read_reg(asic, 0xA600, REG_MMIO);
+    v[1] = asic->reg_funcs.read_reg(asic, 0xA600, REG_MMIO);
+    ASSERT_SUCCESS(umr_capture_write(asic, path));
+    umr_capture_stop(asic);
+    ASSERT_EQ(asic->mem_funcs.access_linear_vram, capture_fake_vram);
+
+    // the two zero pages are stored once
+    f = fopen(path, "rb");
+    ASSERT_NOT_NULL(f);
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fclose(f);
+    ASSERT_EQ(size < (long)(sizeof asic->config.data + 4096 + 1024), 1);
+
+    b = umr_load_capture_bundle(path);
+    unlink(path);
+    ASSERT_NOT_NULL(b);
+    ASSERT_STR_EQ(umr_capture_bundle_asicname(b), asic->asicname);
+    umr_attach_capture_bundle(b, asic);
+
+    ASSERT_SUCCESS(asic->mem_funcs.access_linear_vram(asic, 0x2000, 84, buf, 0));
+    capture_fake_vram(asic, 0x2000, 84, ref, 0);
+    ASSERT_EQ(memcmp(buf, ref, 84), 0);
+    ASSERT_SUCCESS(asic->mem_funcs.access_linear_vram(asic, 0x1FF0, 100, buf, 0));
+    capture_fake_vram(asic, 0x1FF0, 100, ref, 0);
+    ASSERT_EQ(memcmp(buf, ref, 100), 0);
+    ASSERT_SUCCESS(asic->mem_funcs.access_linear_vram(asic, 0x13000, 4096, buf, 0));
+    ASSERT_EQ(buf[0] | buf[4095], 0);
+    ASSERT_EQ(asic->mem_funcs.access_linear_vram(asic, 0x1FE0, 32, buf, 0), -1);
+
+    // registers come back in the order they were read, the last one repeats
+    ASSERT_EQ(asic->reg_funcs.read_reg(asic, 0xA600, REG_MMIO), v[0]);
+    ASSERT_EQ(asic->reg_funcs.read_reg(asic, 0xA600, REG_MMIO), v[1]);
+    ASSERT_EQ(asic->reg_funcs.read_reg(asic, 0xA600, REG_MMIO), v[1]);
+    ASSERT_EQ(asic->reg_funcs.read_reg(asic, 0xA604, REG_MMIO), 0xDEADBEEF);
+    umr_free_capture_bundle(b);
+    return TEST_SUCCESS;
+}
+
+DEFINE_TESTS(capture_tests)
+TEST(test_capture_bundle_navi, "navi_reg_only.envdef", "navi10"),
+END_TESTS(capture_tests);
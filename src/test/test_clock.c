@@ -0,0 +1,69 @@
+#include "test_framework.h"
+
+static uint64_t tsc_lo_addr, tsc_hi_addr;
+static int tsc_stopped;
+
+// a 100MHz counter well away from the host clock
+static uint32_t tsc_read_reg(struct umr_asic *asic, uint64_t addr, enum regclass type)
+{
+    struct timespec ts;
+    uint64_t ticks;
+
+    (void)asic; (void)type;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    ticks = tsc_stopped ? 0x1234500000ULL : 0x1234500000ULL + ((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec) / 10;
+    if (addr == tsc_lo_addr)
+        return (uint32_t)ticks;
+    if (addr == tsc_hi_addr)
+        return ticks >> 32;
+    return 0;
+}
+
+enum TEST_RESULT test_gpu_clock_navi(struct umr_asic* asic)
+{
+    uint32_t (*saved_read)(struct umr_asic *, uint64_t, enum regclass) = asic->reg_funcs.read_reg;
+    struct umr_reg_handle lo, hi;
+    struct umr_gpu_clock clk;
+    struct timespec ts;
+    uint64_t now, gpu;
+    int r;
+
+    asic->options.vm_partition = -1;
+    ASSERT_SUCCESS(umr_reg_handle_resolve(asic, NULL, -1, "mmGOLDEN_TSC_COUNT_LOWER", &lo));
+    ASSERT_SUCCESS(umr_reg_handle_resolve(asic, NULL, -1, "mmGOLDEN_TSC_COUNT_UPPER", &hi));
+    tsc_lo_addr = lo.addr;
+    tsc_hi_addr = hi.addr;
+
+    tsc_stopped = 0;
+    asic->reg_funcs.read_reg = tsc_read_reg;
+    r = umr_gpu_clock_init(asic, &clk);
+    if (!r)
+        r = umr_gpu_clock_calibrate(asic, &clk);
+    gpu = umr_gpu_clock_now(asic, &clk);
+    asic->reg_funcs.read_reg = saved_read;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    now = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+    // the counter maps back onto the host clock it was made from
+    ASSERT_SUCCESS(r);
+    ASSERT_EQ(clk.valid, 1);
+    ASSERT_EQ(clk.lo.reg == lo.reg, 1);
+    ASSERT_EQ(clk.ns_per_tick > 9.9 && clk.ns_per_tick < 10.1, 1);
+    ASSERT_EQ(umr_gpu_clock_to_ns(&clk, clk.base_ticks), clk.base_ns);
+    ASSERT_EQ(clk.base_ns - umr_gpu_clock_to_ns(&clk, clk.base_ticks - 100) - 990 <= 20, 1);
+    ASSERT_EQ(gpu <= now && now - gpu < 1000000, 1);
+
+    // a counter that doesn't count is no clock, the host clock stands in
+    tsc_stopped = 1;
+    asic->reg_funcs.read_reg = tsc_read_reg;
+    r = umr_gpu_clock_init(asic, &clk);
+    asic->reg_funcs.read_reg = saved_read;
+    ASSERT_EQ(r, -1);
+    ASSERT_EQ(clk.valid, 0);
+    ASSERT_EQ(umr_gpu_clock_now(asic, &clk) >= now, 1);
+    return TEST_SUCCESS;
+}
+
+DEFINE_TESTS(clock_tests)
+TEST(test_gpu_clock_navi, "navi_reg_only.envdef", "navi10"),
+END_TESTS(clock_tests);
@@ -0,0 +1,60 @@
+#include "test_framework.h"
+
+// amdgpu_fence_info is parsed into rings, the deltas wrap with the fences
+enum TEST_RESULT test_fence_info_parse_navi(struct umr_asic* asic)
+{
+    const char *before =
+        "--- ring 0 (gfx_0.0.0) ---\n"
+        "Last signaled fence          0xfffffff0\n"
+        "Last emitted                 0xfffffff2\n"
+        "Last signaled trailing fence 0x00000005\n"
+        "Last emitted                 0x00000006\n"
+        "Last preempted               0x00000000\n"
+        "--- ring 1 (comp_1.0.0) ---\n"
+        "Last signaled fence          0x00000002\n"
+        "Last emitted                 0x00000002\n";
+    const char *after =
+        "--- ring 1 (comp_1.0.0) ---\n"
+        "Last signaled fence          0x00000010\n"
+        "Last emitted                 0x00000011\n"
+        "--- ring 0 (gfx_0.0.0) ---\n"
+        "Last signaled fence          0x00000004\n"
+        "Last emitted                 0x00000004\n"
+        "--- ring 2 (sdma0) ---\n"
+        "Last signaled fence          0x00000001\n"
+        "Last emitted                 0x00000001\n";
+    struct umr_fence_snapshot b, a;
+    struct umr_ring_fence_delta d[3];
+
+    (void)asic;
+    memset(&b, 0, sizeof b);
+    memset(&a, 0, sizeof a);
+    ASSERT_EQ(umr_fence_info_parse(before, &b), 2);
+    ASSERT_STR_EQ(b.rings[0].name, "gfx_0.0.0");
+    ASSERT_EQ(b.rings[0].signaled, 0xfffffff0u);
+    ASSERT_EQ(b.rings[0].emitted, 0xfffffff2u);
+    ASSERT_EQ(b.rings[0].has_trailing, 1);
+    ASSERT_EQ(b.rings[0].trailing_signaled, 5u);
+    ASSERT_EQ(b.rings[0].trailing_emitted, 6u);
+    ASSERT_EQ(b.rings[1].has_trailing, 0);
+
+    ASSERT_EQ(umr_fence_info_parse(after, &a), 3);
+    ASSERT_EQ(umr_fence_snapshot_delta(&b, &a, d), 3);
+    ASSERT_STR_EQ(d[0].name, "comp_1.0.0");
+    ASSERT_EQ(d[0].signaled, 0xeu);
+    ASSERT_EQ(d[0].pending, 1u);
+    ASSERT_EQ(d[1].signaled, 0x14u);
+    ASSERT_EQ(d[1].emitted, 0x12u);
+    ASSERT_EQ(d[2].signaled, 0u);
+
+    // the array is reused
+    ASSERT_EQ(umr_fence_info_parse(before, &a), 2);
+    ASSERT_EQ(a.rings[1].signaled, 2u);
+    umr_fence_snapshot_free(&b);
+    umr_fence_snapshot_free(&a);
+    return TEST_SUCCESS;
+}
+
+DEFINE_TESTS(fence_tests)
+TEST(test_fence_info_parse_navi, "navi_reg_only.envdef", "navi10"),
+END_TESTS(fence_tests);
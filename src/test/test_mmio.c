@@ -1,4 +1,5 @@
 #include "test_framework.h"
+#include "umr_rumr.h"
 
 enum TEST_RESULT test_reg_name_to_offset(struct umr_asic* asic, char* name, uint32_t byteoffset, uint32_t value)
 {
@@ -28,8 +29,1602 @@ enum TEST_RESULT test_reg_name_to_offset_renoir(struct umr_asic* asic)
     return test_reg_name_to_offset(asic, "mmSMUIO_GFX_MISC_CNTL", 0x5A320, 0x524E5231);
 }
 
+enum TEST_RESULT test_read_regs_batch_navi(struct umr_asic* asic)
+{
+    struct umr_reg_batch regs[2];
+
+    memset(regs, 0, sizeof regs);
+    regs[0].addr = 0xA600;
+    regs[0].type = REG_MMIO;
+    regs[1].addr = 0xA604;
+    regs[1].type = REG_MMIO;
+    regs[1].use_bank = 1;
+    regs[1].bank.grbm.se = regs[1].bank.grbm.sh = regs[1].bank.grbm.instance = 0xFFFFFFFF;
+    ASSERT_SUCCESS(umr_read_regs_batch(asic, regs, 2));
+    ASSERT_EQ(regs[0].value, 0x4E563131);
+    ASSERT_EQ(regs[1].value, 0xDEADBEEF);
+    ASSERT_EQ(asic->options.use_bank, 0);
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_field_handle_navi(struct umr_asic* asic)
+{
+    struct umr_reg_handle h;
+    struct umr_field_handle fh;
+
+    ASSERT_SUCCESS(umr_reg_handle_resolve(asic, NULL, -1, "mmGRBM_GFX_INDEX", &h));
+    ASSERT_EQ(h.addr, h.reg->addr * 4);
+    ASSERT_SUCCESS(umr_field_handle_resolve(asic, h.reg, "SE_INDEX", &fh));
+    ASSERT_EQ(umr_field_get(&fh, 0x12345678), umr_bitslice_reg(asic, h.reg, "SE_INDEX", 0x12345678));
+    ASSERT_EQ(umr_field_compose(&fh, 3), umr_bitslice_compose_value(asic, h.reg, "SE_INDEX", 3));
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_bitslice_all_navi(struct umr_asic* asic)
+{
+    struct umr_reg_handle h;
+    struct umr_reg* reg;
+    struct umr_bitfield full = { (char*)"ALL", 0, 63 };
+    uint64_t vals[64];
+    int k;
+
+    ASSERT_SUCCESS(umr_reg_handle_resolve(asic, NULL, -1, "mmGRBM_GFX_INDEX", &h));
+    reg = h.reg;
+    ASSERT_EQ(reg->no_bits > 1 && reg->no_bits <= 64, 1);
+    ASSERT_EQ(umr_bitslice_all(reg, 0x12345678, vals), reg->no_bits);
+    for (k = 0; k < reg->no_bits; k++)
+        ASSERT_EQ(vals[k], umr_bitslice_reg(asic, reg, reg->bits[k].regname, 0x12345678));
+    ASSERT_EQ(umr_bitfield_mask(&full), ~0ULL);
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_serialize_user_queue_navi(struct umr_asic* asic)
+{
+    struct umr_user_queue* uq = &asic->options.user_queue;
+    struct rumr_buffer *buf, *buf2;
+    struct umr_asic* copy;
+    uint32_t head;
+
+    ASSERT_SUCCESS(umr_load_ip_blocks(asic, NULL));
+    memset(uq, 0, sizeof *uq);
+    strcpy(uq->clientid, "14.1");
+    uq->client_info.queue[1].mqd_gpu_address = 0x1234000;
+    uq->client_info.queue[1].mqd_size = 4;
+    uq->client_info.queue[1].mqd_words[3] = 0xCAFE;
+    uq->state.qidx = 1;
+
+    // the queue[] slots are sent up to the last one used
+    buf = rumr_serialize_asic(asic);
+    ASSERT_NOT_NULL(buf);
+    head = rumr_serialized_asic_head(buf);
+    ASSERT_EQ(head != 0, 1);
+    uq->client_info.queue[5].mqd_size = 4;
+    buf2 = rumr_serialize_asic(asic);
+    ASSERT_NOT_NULL(buf2);
+    ASSERT_EQ(rumr_serialized_asic_head(buf2) - head, 4 * sizeof uq->client_info.queue[0]);
+    ASSERT_EQ(rumr_serialized_asic_hash(buf2), rumr_serialized_asic_hash(buf));
+    rumr_buffer_free(buf2);
+
+    copy = rumr_parse_serialized_asic(buf);
+    rumr_buffer_free(buf);
+    ASSERT_NOT_NULL(copy);
+    ASSERT_STR_EQ(copy->options.user_queue.clientid, "14.1");
+    ASSERT_EQ(copy->options.user_queue.client_info.queue[1].mqd_gpu_address, 0x1234000);
+    ASSERT_EQ(copy->options.user_queue.client_info.queue[1].mqd_words[3], 0xCAFE);
+    ASSERT_EQ(copy->options.user_queue.client_info.queue[2].mqd_gpu_address, 0);
+    ASSERT_EQ(copy->options.user_queue.state.qidx, 1);
+    umr_free_asic(copy);
+    memset(uq, 0, sizeof *uq);
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_find_reg_by_addr_aliases_navi(struct umr_asic* asic)
+{
+    struct umr_ip_block* ip;
+    uint32_t x;
+
+    ASSERT_SUCCESS(umr_load_ip_blocks(asic, NULL));
+    ASSERT_NOT_NULL(asic->mmio_pages);
+    // every address must resolve to its first (lowest ord) accel entry
+    for (x = 0; x < asic->mmio_accel_size; x++) {
+        if (x && asic->mmio_accel[x - 1].mmio_addr == asic->mmio_accel[x].mmio_addr)
+            continue;
+        ASSERT_EQ(umr_find_reg_by_addr(asic, asic->mmio_accel[x].mmio_addr, &ip), asic->mmio_accel[x].reg);
+        ASSERT_EQ(ip, asic->mmio_accel[x].ip);
+    }
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_reg_name_r_navi(struct umr_asic* asic)
+{
+    char name[128];
+
+    ASSERT_NOT_NULL(strstr(umr_reg_name_r(asic, 0xA600 / 4, name, sizeof name), ".mmGCMC_VM_FB_LOCATION_BASE"));
+    ASSERT_STR_EQ(umr_reg_name_r(asic, 0x3FFFFFF, name, sizeof name), "<unknown>");
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_read_reg_by_reg_64bit_navi(struct umr_asic* asic)
+{
+    struct umr_reg *reg, copy;
+
+    reg = umr_find_reg_data_by_ip_by_instance(asic, NULL, -1, "mmGCMC_VM_FB_LOCATION_BASE");
+    ASSERT_NOT_NULL(reg);
+
+    // without a read_reg64 callback the halves are read separately
+    copy = *reg;
+    copy.bit64 = 1;
+    ASSERT_EQ(asic->reg_funcs.read_reg64, NULL);
+    ASSERT_EQ(umr_read_reg_by_reg(asic, &copy), 0xDEADBEEF4E563131ULL);
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_access_ctx_navi(struct umr_asic* asic)
+{
+    struct umr_access_ctx *ctx;
+
+    asic->options.use_bank = 1;
+    asic->options.bank.grbm.se = 2;
+    ctx = umr_access_ctx_create(asic);
+    asic->options.use_bank = 0;
+    ASSERT_NOT_NULL(ctx);
+    ASSERT_EQ(ctx->use_bank, 1);
+    ASSERT_EQ(ctx->bank.grbm.se, 2);
+
+    ASSERT_EQ(umr_access_ctx_bind(ctx), NULL);
+    ASSERT_EQ(umr_access_ctx_current(asic), ctx);
+    ASSERT_EQ(umr_access_ctx_current(NULL), NULL);
+
+    // the files the context reopened count with the ones of the asic
+    ctx->fd_mmio2 = 1000;
+    ctx->fd_gprwave = 1001;
+    ASSERT_EQ(umr_io_class_of_fd(asic, 1000), UMR_IO_MMIO);
+    ASSERT_EQ(umr_io_class_of_fd(asic, 1001), UMR_IO_GPRWAVE);
+    ctx->fd_mmio2 = ctx->fd_gprwave = -1;
+
+    umr_access_ctx_free(ctx);
+    ASSERT_EQ(umr_access_ctx_current(asic), NULL);
+    ASSERT_EQ(umr_io_class_of_fd(asic, 1000), UMR_IO_OTHER);
+    return TEST_SUCCESS;
+}
+
+// a bound context resolves WAVE STATUS fields in its own cache
+enum TEST_RESULT test_access_ctx_wave_fields_navi(struct umr_asic* asic)
+{
+    struct umr_access_ctx *ctx;
+    struct umr_wave_data wd;
+    struct umr_wave_field wf;
+
+    asic->options.vm_partition = -1;
+    ctx = umr_access_ctx_create(asic);
+    ASSERT_NOT_NULL(ctx);
+    umr_access_ctx_bind(ctx);
+    ASSERT_SUCCESS(umr_wave_data_init(asic, &wd));
+    ASSERT_SUCCESS(umr_wave_data_resolve_field(asic, &wd, "ixSQ_WAVE_STATUS", "VALID", &wf));
+    ASSERT_NOT_NULL(ctx->wave_fields);
+    ASSERT_EQ(asic->wave_fields, NULL);
+    umr_access_ctx_free(ctx);
+
+    ASSERT_SUCCESS(umr_wave_data_resolve_field(asic, &wd, "ixSQ_WAVE_STATUS", "VALID", &wf));
+    ASSERT_NOT_NULL(asic->wave_fields);
+    return TEST_SUCCESS;
+}
+
+// the well known fields read by ID match the name based lookups
+enum TEST_RESULT test_wave_field_id_navi(struct umr_asic* asic)
+{
+    struct umr_wave_data wd;
+    int x;
+
+    asic->options.vm_partition = -1;
+    ASSERT_SUCCESS(umr_wave_data_init(asic, &wd));
+    for (x = 0; wd.reg_names[x]; x++)
+        wd.ws.reg_values[x] = 0x5A5A5A5A ^ (x * 0x01010101);
+    ASSERT_EQ(umr_wave_data_get_field_id(asic, &wd, UMR_WAVE_FIELD_VALID), umr_wave_data_get_bits(asic, &wd, "ixSQ_WAVE_STATUS", "VALID"));
+    ASSERT_EQ(umr_wave_data_get_field_id(asic, &wd, UMR_WAVE_FIELD_WAVE_ID), umr_wave_data_get_bits(asic, &wd, "ixSQ_WAVE_HW_ID1", "WAVE_ID"));
+    ASSERT_EQ(umr_wave_data_get_field_id(asic, &wd, UMR_WAVE_FIELD_CU_ID), umr_wave_data_get_bits(asic, &wd, "ixSQ_WAVE_HW_ID1", "WGP_ID"));
+    ASSERT_EQ(umr_wave_data_get_field_id(asic, &wd, UMR_WAVE_FIELD_VM_ID), umr_wave_data_get_bits(asic, &wd, "ixSQ_WAVE_HW_ID2", "VM_ID"));
+    ASSERT_EQ(umr_wave_data_get_field_id(asic, &wd, UMR_WAVE_FIELD_PC_LO), umr_wave_data_get_value(asic, &wd, "ixSQ_WAVE_PC_LO"));
+
+    // registers that were not captured are reported as such
+    for (x = 0; wd.reg_names[x]; x++)
+        wd.ws.reg_values[x] = 0xDEADBEEF;
+    ASSERT_EQ(umr_wave_data_get_field_id(asic, &wd, UMR_WAVE_FIELD_SIMD_ID), 0xDEADBEEF);
+    return TEST_SUCCESS;
+}
+
+// fake SQ_IND_INDEX/SQ_IND_DATA pair, SQ_IND_DATA reads back the index written
+static uint64_t sq_ind_index_addr, sq_ind_data_addr;
+static uint32_t sq_ind_index;
+static int sq_ind_writes;
+
+static int sq_ind_write_reg(struct umr_asic *asic, uint64_t addr, uint32_t value, enum regclass type)
+{
+    (void)asic;
+    (void)type;
+    if (addr == sq_ind_index_addr) {
+        sq_ind_index = value;
+        ++sq_ind_writes;
+    }
+    return 0;
+}
+
+static uint32_t sq_ind_read_reg(struct umr_asic *asic, uint64_t addr, enum regclass type)
+{
+    (void)asic;
+    (void)type;
+    return addr == sq_ind_data_addr ? sq_ind_index : 0;
+}
+
+// every slot of a SIMD in one call, one index write per register
+enum TEST_RESULT test_wave_status_bulk_navi(struct umr_asic* asic)
+{
+    struct umr_wave_status ws[4];
+    struct umr_reg *ind_index, *status;
+    uint32_t value;
+
+    asic->options.vm_partition = -1;
+    ind_index = umr_find_reg_by_name(asic, "mmSQ_IND_INDEX", NULL);
+    status = umr_find_reg_by_name(asic, "ixSQ_WAVE_STATUS", NULL);
+    ASSERT_NOT_NULL(ind_index);
+    ASSERT_NOT_NULL(status);
+    sq_ind_index_addr = ind_index->addr * 4;
+    sq_ind_data_addr = umr_find_reg_by_name(asic, "mmSQ_IND_DATA", NULL)->addr * 4;
+    asic->reg_funcs.write_reg = sq_ind_write_reg;
+    asic->reg_funcs.read_reg = sq_ind_read_reg;
+
+    sq_ind_writes = 0;
+    ASSERT_SUCCESS(umr_get_wave_status_via_mmio_bulk(asic, 0, 0, 0, 0, 4, ws));
+    // sixteen WAVE STATUS registers on gfx10
+    ASSERT_EQ(sq_ind_writes, 4 * 16);
+    value = umr_bitslice_compose_value(asic, ind_index, "WAVE_ID", 3) |
+            umr_bitslice_compose_value(asic, ind_index, "INDEX", status->addr);
+    ASSERT_EQ(ws[3].reg_values[0], value);
+    return TEST_SUCCESS;
+}
+
+// every SIMD is busy and wave slot 1 of each holds a valid wave
+static uint32_t fake_status_valid;
+static int fake_status_idx;
+
+static int fake_sq_info(struct umr_asic *asic, unsigned se, unsigned sh, unsigned cu, struct umr_wave_status *ws)
+{
+    (void)asic; (void)se; (void)sh; (void)cu;
+    ws->sq_info.busy = 1;
+    return 0;
+}
+
+static int fake_wave_status(struct umr_asic *asic, unsigned se, unsigned sh, unsigned cu, unsigned simd, unsigned wave, struct umr_wave_status *ws)
+{
+    (void)asic; (void)se; (void)sh; (void)cu; (void)simd;
+    memset(ws->reg_values, 0, sizeof ws->reg_values);
+    if (wave == 1)
+        ws->reg_values[fake_status_idx] = fake_status_valid;
+    return 0;
+}
+
+// scan results come out of a few bulk allocations and are freed at once
+enum TEST_RESULT test_scan_wave_arena_navi(struct umr_asic* asic)
+{
+    struct umr_wave_data wd, *head, *p;
+    unsigned n, expect;
+
+    asic->options.vm_partition = -1;
+    asic->options.skip_gprs = 1;
+    ASSERT_SUCCESS(umr_wave_data_init(asic, &wd));
+    for (fake_status_idx = 0; strcmp(wd.reg_names[fake_status_idx], "ixSQ_WAVE_STATUS"); fake_status_idx++);
+    fake_status_valid = umr_bitslice_compose_value(asic, umr_find_reg_by_name(asic, "ixSQ_WAVE_STATUS", NULL), "VALID", 1);
+    asic->wave_funcs.get_wave_sq_info = fake_sq_info;
+    asic->wave_funcs.get_wave_status = fake_wave_status;
+    asic->wave_funcs.get_wave_status_bulk = NULL;
+
+    // enough waves to span several chunks
+    asic->config.gfx.max_shader_engines = 2;
+    asic->config.gfx.max_sh_per_se = 2;
+    asic->config.gfx.max_cu_per_sh = 10;
+    expect = asic->config.gfx.max_shader_engines * asic->config.gfx.max_sh_per_se *
+             (asic->config.gfx.max_cu_per_sh / 2) * 4;
+    head = umr_scan_wave_data(asic);
+    ASSERT_NOT_NULL(head);
+    ASSERT_NOT_NULL(head->arena);
+    for (n = 0, p = head; p; p = p->next, n++) {
+        ASSERT_EQ(p->wave, 1);
+        ASSERT_EQ(p->reg_names, wd.reg_names);
+    }
+    ASSERT_EQ(n, expect);
+    umr_free_wave_data(head);
+    return TEST_SUCCESS;
+}
+
+// WGPs 0 and 1 of SE 1 are harvested
+static uint64_t fake_cc_addr;
+
+static uint32_t fake_harvest_read_reg(struct umr_asic *asic, uint64_t addr, enum regclass type)
+{
+    (void)type;
+    if (addr == fake_cc_addr)
+        return asic->options.use_bank && asic->options.bank.grbm.se == 1 ? 3 << 16 : 0;
+    return 0;
+}
+
+static unsigned scan_wave_count(struct umr_asic *asic)
+{
+    struct umr_wave_data *head, *p;
+    unsigned n = 0;
+
+    head = umr_scan_wave_data(asic);
+    for (p = head; p; p = p->next)
+        ++n;
+    umr_free_wave_data(head);
+    return n;
+}
+
+// harvested WGPs are skipped, the scan can be limited to some units and waves
+enum TEST_RESULT test_scan_wave_filter_navi(struct umr_asic* asic)
+{
+    struct umr_wave_data wd, *head;
+
+    asic->options.vm_partition = -1;
+    asic->options.skip_gprs = 1;
+    ASSERT_SUCCESS(umr_wave_data_init(asic, &wd));
+    for (fake_status_idx = 0; strcmp(wd.reg_names[fake_status_idx], "ixSQ_WAVE_STATUS"); fake_status_idx++);
+    fake_status_valid = umr_bitslice_compose_value(asic, umr_find_reg_by_name(asic, "ixSQ_WAVE_STATUS", NULL), "VALID", 1);
+    fake_cc_addr = umr_find_reg_by_name(asic, "mmCC_GC_SHADER_ARRAY_CONFIG", NULL)->addr * 4;
+    asic->reg_funcs.read_reg = fake_harvest_read_reg;
+    asic->wave_funcs.get_wave_sq_info = fake_sq_info;
+    asic->wave_funcs.get_wave_status = fake_wave_status;
+    asic->wave_funcs.get_wave_status_bulk = NULL;
+    asic->config.gfx.max_shader_engines = 2;
+    asic->config.gfx.max_sh_per_se = 1;
+    asic->config.gfx.max_cu_per_sh = 8;
+
+    // 4 WGPs x 4 SIMDs on SE 0, 2 x 4 on SE 1
+    ASSERT_EQ(scan_wave_count(asic), 24u);
+
+    asic->options.wave_filter.se = 1 << 1;
+    ASSERT_EQ(scan_wave_count(asic), 8u);
+    asic->options.wave_filter.cu = 1 << 2;
+    head = umr_scan_wave_data(asic);
+    ASSERT_NOT_NULL(head);
+    ASSERT_EQ(head->se, 1);
+    ASSERT_EQ(head->cu, 2);
+    umr_free_wave_data(head);
+    asic->options.wave_filter.cu = 1 << 0;
+    ASSERT_EQ(scan_wave_count(asic), 0u);
+
+    asic->options.wave_filter.se = 0;
+    asic->options.wave_filter.cu = 0;
+    asic->options.wave_filter.max_waves = 3;
+    ASSERT_EQ(scan_wave_count(asic), 3u);
+    return TEST_SUCCESS;
+}
+
+// count the GPR reads so the scan can be checked to leave them for later
+static int fake_sgpr_reads, fake_vgpr_reads;
+static uint32_t fake_sgpr17;
+
+static int fake_read_sgprs(struct umr_asic *asic, struct umr_wave_data *wd, uint32_t *dst)
+{
+    (void)asic;
+    ++fake_sgpr_reads;
+    dst[0] = 0x1000 | wd->se;
+    dst[17] = fake_sgpr17;
+    return 4;
+}
+
+static int fake_read_vgprs(struct umr_asic *asic, struct umr_wave_data *wd, uint32_t thread, uint32_t *dst)
+{
+    (void)asic; (void)wd;
+    ++fake_vgpr_reads;
+    dst[0] = thread;
+    return 4;
+}
+
+// GPRs are read the first time a wave asks for them and only once
+enum TEST_RESULT test_scan_wave_lazy_gprs_navi(struct umr_asic* asic)
+{
+    struct umr_wave_data wd, *head;
+
+    asic->options.vm_partition = -1;
+    asic->options.skip_gprs = 0;
+    ASSERT_SUCCESS(umr_wave_data_init(asic, &wd));
+    for (fake_status_idx = 0; strcmp(wd.reg_names[fake_status_idx], "ixSQ_WAVE_STATUS"); fake_status_idx++);
+    fake_status_valid = umr_bitslice_compose_value(asic, umr_find_reg_by_name(asic, "ixSQ_WAVE_STATUS", NULL), "VALID", 1);
+    asic->wave_funcs.get_wave_sq_info = fake_sq_info;
+    asic->wave_funcs.get_wave_status = fake_wave_status;
+    asic->wave_funcs.get_wave_status_bulk = NULL;
+    asic->gpr_read_funcs.read_sgprs = fake_read_sgprs;
+    asic->gpr_read_funcs.read_vgprs = fake_read_vgprs;
+    asic->config.gfx.max_shader_engines = 2;
+    asic->config.gfx.max_sh_per_se = 1;
+    asic->config.gfx.max_cu_per_sh = 2;
+
+    fake_sgpr_reads = fake_vgpr_reads = 0;
+    head = umr_scan_wave_data(asic);
+    ASSERT_NOT_NULL(head);
+    ASSERT_EQ(fake_sgpr_reads, 0);
+    ASSERT_EQ(fake_vgpr_reads, 0);
+    ASSERT_EQ(head->gpr_state, UMR_WAVE_GPRS_LAZY);
+
+    ASSERT_SUCCESS(umr_wave_data_fetch_gprs(asic, head));
+    ASSERT_EQ(fake_sgpr_reads, 1);
+    ASSERT_EQ(fake_vgpr_reads, (int)head->num_threads);
+    ASSERT_EQ(head->have_vgprs, 1);
+    ASSERT_EQ(head->sgprs[0], 0x1000u | (uint32_t)head->se);
+    ASSERT_EQ(head->vgprs[256 * 1], 1u);
+
+    // cached
+    ASSERT_SUCCESS(umr_wave_data_fetch_gprs(asic, head));
+    ASSERT_EQ(fake_sgpr_reads, 1);
+    ASSERT_EQ(head->next->gpr_state, UMR_WAVE_GPRS_LAZY);
+
+    // not a debugfs backend so nothing is read in the background
+    ASSERT_EQ(umr_wave_data_prefetch_gprs(asic, head), 1);
+    umr_free_wave_data(head);
+
+    asic->options.skip_gprs = 1;
+    head = umr_scan_wave_data(asic);
+    ASSERT_NOT_NULL(head);
+    ASSERT_EQ(umr_wave_data_fetch_gprs(asic, head), -1);
+    ASSERT_EQ(fake_sgpr_reads, 1);
+    umr_free_wave_data(head);
+    return TEST_SUCCESS;
+}
+
+// read the same wave again as a single step would
+static int restep_wave(struct umr_asic *asic, struct umr_wave_data *wd, const uint32_t *reg_values)
+{
+    if (umr_wave_data_init(asic, wd) < 0)
+        return -1;
+    memcpy(wd->ws.reg_values, reg_values, sizeof wd->ws.reg_values);
+    wd->se = 1;
+    wd->wave = 3;
+    wd->num_threads = 32;
+    return 0;
+}
+
+// only the status registers and GPR blocks that changed are reported
+enum TEST_RESULT test_wave_snapshot_navi(struct umr_asic* asic)
+{
+    struct umr_wave_snapshot snap;
+    struct umr_wave_delta delta;
+    struct umr_wave_data wd;
+    uint32_t regs[64];
+
+    asic->options.vm_partition = -1;
+    asic->gpr_read_funcs.read_sgprs = fake_read_sgprs;
+    asic->gpr_read_funcs.read_vgprs = fake_read_vgprs;
+    memset(&snap, 0, sizeof snap);
+    memset(regs, 0, sizeof regs);
+    fake_sgpr17 = 0;
+
+    // nothing recorded yet
+    ASSERT_SUCCESS(restep_wave(asic, &wd, regs));
+    ASSERT_EQ(umr_wave_snapshot_update(asic, &snap, &wd, &delta), 1);
+    ASSERT_EQ(delta.sgpr_blocks, ~0ULL);
+    ASSERT_EQ(delta.vgpr_blocks & 1, 1u);
+    ASSERT_EQ(delta.regs & 1, 1u);
+
+    ASSERT_SUCCESS(restep_wave(asic, &wd, regs));
+    ASSERT_EQ(umr_wave_snapshot_update(asic, &snap, &wd, &delta), 0);
+
+    regs[3] = 0x55;
+    fake_sgpr17 = 0xdead;
+    ASSERT_SUCCESS(restep_wave(asic, &wd, regs));
+    ASSERT_EQ(umr_wave_snapshot_update(asic, &snap, &wd, &delta), 1);
+    ASSERT_EQ(delta.regs, 1ULL << 3);
+    ASSERT_EQ(delta.sgpr_blocks, 1ULL << (17 / UMR_WAVE_GPR_BLOCK));
+    ASSERT_EQ(delta.vgpr_blocks, 0u);
+
+    // another wave is sent whole
+    ASSERT_SUCCESS(restep_wave(asic, &wd, regs));
+    wd.wave = 4;
+    ASSERT_EQ(umr_wave_snapshot_update(asic, &snap, &wd, &delta), 1);
+    ASSERT_EQ(delta.sgpr_blocks, ~0ULL);
+    return TEST_SUCCESS;
+}
+
+// rptr of a fake ring that advances every 'fake_ring_step' reads (never if 0)
+static uint32_t fake_ring_reads, fake_ring_step;
+
+static void *fake_read_ring_data(struct umr_asic *asic, char *ringname, uint32_t *ringsize)
+{
+    uint32_t *data = calloc(1, 64);
+
+    (void)asic; (void)ringname;
+    ++fake_ring_reads;
+    data[0] = 1 + (fake_ring_step ? fake_ring_reads / fake_ring_step : 0);
+    data[1] = 8;
+    *ringsize = 64;
+    return data;
+}
+
+// a moving ring is seen after a few polls, a stuck one after the timeout
+enum TEST_RESULT test_ring_is_halted_navi(struct umr_asic* asic)
+{
+    asic->ring_func.read_ring_data = fake_read_ring_data;
+    asic->options.ring_halt_timeout = 2000;
+
+    fake_ring_reads = 0;
+    fake_ring_step = 2;
+    ASSERT_EQ(umr_ring_is_halted(asic, "gfx"), 0);
+    ASSERT_EQ(fake_ring_reads, 2u);
+
+    fake_ring_reads = 0;
+    fake_ring_step = 0;
+    ASSERT_EQ(umr_ring_is_halted(asic, "gfx"), 1);
+    ASSERT_EQ(fake_ring_reads > 2, 1);
+    ASSERT_EQ(fake_ring_reads < 60, 1);
+
+    ASSERT_EQ(umr_ring_is_halted(asic, "none"), 1);
+    asic->options.ring_halt_timeout = 0;
+    return TEST_SUCCESS;
+}
+
+// a ring that moves for the first 'fake_ring_moves' reads and then stands still
+static uint32_t fake_ring_moves;
+
+static void *fake_read_halting_ring(struct umr_asic *asic, char *ringname, uint32_t *ringsize)
+{
+    uint32_t *data = calloc(1, 64);
+
+    (void)asic; (void)ringname;
+    ++fake_ring_reads;
+    data[0] = 1 + (fake_ring_reads < fake_ring_moves ? fake_ring_reads : fake_ring_moves);
+    data[1] = 12;
+    *ringsize = 64;
+    return data;
+}
+
+// the halt is resent while the ring moves and gives up at the budget
+enum TEST_RESULT test_sq_cmd_halt_within_navi(struct umr_asic* asic)
+{
+    char ring_name[sizeof asic->options.ring_name];
+    int vm_partition = asic->options.vm_partition;
+    uint64_t start;
+
+    // SQ_CMD of any GFX instance
+    asic->options.vm_partition = -1;
+    memcpy(ring_name, asic->options.ring_name, sizeof ring_name);
+    strcpy(asic->options.ring_name, "gfx");
+    asic->ring_func.read_ring_data = fake_read_halting_ring;
+    asic->options.ring_halt_timeout = 1000;
+
+    fake_ring_reads = 0;
+    fake_ring_moves = 5;
+    ASSERT_EQ(umr_sq_cmd_halt_waves_within(asic, 1000000), 0);
+    ASSERT_EQ(fake_ring_reads > 5, 1);
+
+    // never stands still
+    fake_ring_reads = 0;
+    fake_ring_moves = ~0U;
+    start = umr_ring_now_us();
+    ASSERT_EQ(umr_sq_cmd_halt_waves_within(asic, 5000), -1);
+    ASSERT_EQ(umr_ring_now_us() - start < 100000, 1);
+
+    asic->options.ring_halt_timeout = 0;
+    asic->options.vm_partition = vm_partition;
+    memcpy(asic->options.ring_name, ring_name, sizeof ring_name);
+    return TEST_SUCCESS;
+}
+
+static int disasm_calls;
+
+static int count_disasm(struct umr_asic *asic, uint8_t *inst, unsigned inst_bytes, uint64_t PC, char ***disasm_text)
+{
+    unsigned x;
+
+    (void)asic; (void)inst; (void)PC;
+    ++disasm_calls;
+    *disasm_text = calloc(inst_bytes / 4, sizeof(**disasm_text));
+    for (x = 0; x < inst_bytes / 4; x++)
+        (*disasm_text)[x] = strdup(x ? "s_nop 0" : "s_endpgm");
+    return 0;
+}
+
+enum TEST_RESULT test_disasm_cache_navi(struct umr_asic* asic)
+{
+    int (*old)(struct umr_asic *asic, uint8_t *inst, unsigned inst_bytes, uint64_t PC, char ***disasm_text);
+    uint32_t words[] = { 0xbf810000, 0xbf800000, 0xbf800000 };
+    char **text;
+    int x, k;
+
+    old = asic->shader_disasm_funcs.disasm;
+    asic->shader_disasm_funcs.disasm = count_disasm;
+    disasm_calls = 0;
+
+    // the same shader at the same place is only disassembled once
+    for (k = 0; k < 3; k++) {
+        ASSERT_EQ(umr_shader_disasm_cached(asic, 1, words, sizeof words, 0x1000, &text), 0);
+        ASSERT_STR_EQ(text[0], "s_endpgm");
+        ASSERT_STR_EQ(text[2], "s_nop 0");
+        for (x = 0; x < 3; x++)
+            free(text[x]);
+        free(text);
+    }
+    ASSERT_EQ(disasm_calls, 1);
+
+    // another VMID, address or content is another shader
+    ASSERT_EQ(umr_shader_disasm_cached(asic, 2, words, sizeof words, 0x1000, &text), 0);
+    for (x = 0; x < 3; x++)
+        free(text[x]);
+    free(text);
+    words[1] = 0xbf800001;
+    ASSERT_EQ(umr_shader_disasm_cached(asic, 1, words, sizeof words, 0x1000, &text), 0);
+    for (x = 0; x < 3; x++)
+        free(text[x]);
+    free(text);
+    ASSERT_EQ(disasm_calls, 3);
+
+    umr_shader_disasm_cache_free(asic);
+    asic->shader_disasm_funcs.disasm = old;
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_disasm_block_navi(struct umr_asic* asic)
+{
+    char *strs[] = { "v_mov_b32 v0, 1.0", ";;", "...", "s_endpgm" };
+    struct umr_disasm_block *b, *copy;
+    char **out;
+    int x;
+
+    (void)asic;
+    b = umr_disasm_block_from_strs(strs, 4);
+    ASSERT_NOT_NULL(b);
+    ASSERT_EQ(b->line[1], UMR_DISASM_CONT);
+    ASSERT_EQ(b->line[2], UMR_DISASM_INVALID);
+    ASSERT_EQ(b->text_len, (uint32_t)(strlen(strs[0]) + strlen(strs[3]) + 2));
+
+    // a copy is one allocation of its own
+    copy = umr_disasm_block_dup(b);
+    free(b);
+    ASSERT_NOT_NULL(copy);
+    for (x = 0; x < 4; x++)
+        ASSERT_STR_EQ(umr_disasm_line(copy, x), strs[x]);
+    ASSERT_STR_EQ(umr_disasm_line(NULL, 0), "...");
+
+    out = umr_disasm_block_to_strs(copy);
+    ASSERT_NOT_NULL(out);
+    for (x = 0; x < 4; x++) {
+        ASSERT_STR_EQ(out[x], strs[x]);
+        free(out[x]);
+    }
+    free(out);
+    free(copy);
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_find_reg_wild_navi(struct umr_asic* asic)
+{
+    struct umr_find_reg_iter *iter;
+    struct umr_find_reg_iter_result res;
+    int i, j, n, k;
+
+    // the indexed search must return exactly what a full scan finds, in order
+    iter = umr_find_reg_wild_first(asic, NULL, "*vm_fb_loc*");
+    ASSERT_NOT_NULL(iter);
+    ASSERT_EQ(iter->use_index, 1);
+    n = 0;
+    for (i = 0; i < asic->no_blocks; i++) {
+        for (j = 0; j < asic->blocks[i]->no_regs; j++) {
+            if (!strstr(asic->blocks[i]->regs[j].regname, "VM_FB_LOC"))
+                continue;
+            res = umr_find_reg_wild_next(&iter);
+            ASSERT_EQ(res.reg, &asic->blocks[i]->regs[j]);
+            ASSERT_EQ(res.ip, asic->blocks[i]);
+            ++n;
+        }
+    }
+    ASSERT_EQ(n > 0, 1);
+    res = umr_find_reg_wild_next(&iter);
+    ASSERT_EQ(res.reg, NULL);
+    ASSERT_EQ(iter, NULL);
+
+    // short patterns fall back to the scan
+    iter = umr_find_reg_wild_first(asic, NULL, "mm*");
+    ASSERT_NOT_NULL(iter);
+    ASSERT_EQ(iter->use_index, 0);
+    for (k = 0; iter; k++)
+        umr_find_reg_wild_next(&iter);
+    ASSERT_EQ(k > n, 1);
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_reg_snapshot_navi(struct umr_asic* asic)
+{
+    struct umr_reg_snapshot *a, *b;
+    struct umr_ip_block* ip;
+    struct umr_reg* reg;
+    char path[] = "/tmp/umr_snapshot_XXXXXX";
+    int fd;
+
+    reg = umr_find_reg_by_addr(asic, 0xA600 / 4, &ip);
+    ASSERT_NOT_NULL(reg);
+    a = umr_reg_snapshot_capture(asic, ip->ipname);
+    ASSERT_NOT_NULL(a);
+    ASSERT_EQ(a->blocks[0].ip, ip);
+    ASSERT_EQ(a->blocks[0].valid[reg - ip->regs], 1);
+    ASSERT_EQ(a->blocks[0].values[reg - ip->regs], 0x4E563131);
+
+    // a saved and reloaded snapshot must not differ from the original
+    fd = mkstemp(path);
+    ASSERT_SUCCESS(fd);
+    close(fd);
+    ASSERT_SUCCESS(umr_reg_snapshot_save(asic, a, path));
+    b = umr_reg_snapshot_load(asic, ip->ipname, path);
+    unlink(path);
+    ASSERT_NOT_NULL(b);
+    ASSERT_EQ(umr_reg_snapshot_diff(asic, a, b, NULL), 0);
+
+    b->blocks[0].values[reg - ip->regs] ^= 1;
+    ASSERT_EQ(umr_reg_snapshot_diff(asic, a, b, NULL), 1);
+    umr_reg_snapshot_free(a);
+    umr_reg_snapshot_free(b);
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_name_pool_navi(struct umr_asic* asic)
+{
+    struct umr_ip_block* ip;
+    struct umr_reg* reg;
+    char name[64];
+
+    reg = umr_find_reg_by_name(asic, "mmGRBM_GFX_INDEX", &ip);
+    ASSERT_NOT_NULL(reg);
+    ASSERT_NOT_NULL(ip->name_pool);
+
+    // interning a name already in the block returns the stored copy
+    strcpy(name, reg->regname);
+    ASSERT_EQ(umr_name_pool_intern(ip->name_pool, name) == reg->regname, 1);
+    ASSERT_EQ(umr_name_pool_intern(ip->name_pool, "umr_not_a_register") == reg->regname, 0);
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_lazy_regs_navi(struct umr_asic* asic)
+{
+    struct umr_ip_block* ip;
+    struct umr_reg* reg;
+    int i, pending;
+
+    ASSERT_EQ(asic->all_regs_loaded, 0);
+    reg = umr_find_reg_data_by_ip_by_instance_with_ip(asic, "gfx", -1, "mmGRBM_GFX_INDEX", &ip);
+    ASSERT_NOT_NULL(reg);
+    ASSERT_EQ(ip->source == NULL, 1);
+    for (pending = i = 0; i < asic->no_blocks; i++)
+        pending += asic->blocks[i]->source != NULL;
+    ASSERT_EQ(pending > 0, 1);
+
+    // the index picks the block up as well
+    ASSERT_EQ(umr_find_reg_by_name(asic, "mmGRBM_GFX_INDEX", NULL), reg);
+
+    // an address can be in any block so everything gets loaded
+    ASSERT_NOT_NULL(umr_find_reg_by_addr(asic, 0xA600 / 4, NULL));
+    ASSERT_EQ(asic->all_regs_loaded, 1);
+    for (i = 0; i < asic->no_blocks; i++)
+        ASSERT_EQ(asic->blocks[i]->source == NULL, 1);
+    ASSERT_EQ(umr_find_reg_by_name(asic, "mmGRBM_GFX_INDEX", NULL), reg);
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_database_scan_cache_navi(struct umr_asic* asic)
+{
+    struct umr_database_scan_item *a, *b, *x, *y;
+    char path[] = "/tmp/umr_dbidx_XXXXXX";
+    int fd;
+
+    (void)asic;
+    fd = mkstemp(path);
+    ASSERT_SUCCESS(fd);
+    close(fd);
+    unlink(path);
+    setenv("UMR_DATABASE_CACHE", path, 1);
+
+    // the first scan writes the cache and the second one reads it back
+    a = umr_database_scan(NULL);
+    ASSERT_SUCCESS(access(path, R_OK));
+    b = umr_database_scan(NULL);
+    unlink(path);
+    unsetenv("UMR_DATABASE_CACHE");
+    ASSERT_NOT_NULL(a);
+    ASSERT_NOT_NULL(b);
+    for (x = a, y = b; x && y; x = x->next, y = y->next) {
+        ASSERT_STR_EQ(x->path, y->path);
+        ASSERT_STR_EQ(x->fname, y->fname);
+    }
+    ASSERT_EQ(x == NULL && y == NULL, 1);
+
+    x = umr_database_find_ip(a, "gc", 10, 1, 0, NULL);
+    y = umr_database_find_ip(b, "gc", 10, 1, 0, NULL);
+    ASSERT_NOT_NULL(x);
+    ASSERT_NOT_NULL(y);
+    ASSERT_STR_EQ(x->fname, y->fname);
+    umr_database_free_scan_items(a);
+    umr_database_free_scan_items(b);
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_shared_reg_tables_navi(struct umr_asic* asic)
+{
+    struct umr_options options;
+    struct umr_asic* other;
+    struct umr_ip_block *ip, *oip;
+    struct umr_reg *reg, *oreg;
+
+    memset(&options, 0, sizeof(options));
+    options.is_virtual = 1;
+    options.force_asic_file = 1;
+    other = umr_discover_asic_by_name(&options, "navi10", asic->err_msg);
+    ASSERT_NOT_NULL(other);
+
+    // both devices use one copy of the names and bitfields but have
+    // their own registers
+    reg = umr_find_reg_by_name(asic, "mmGRBM_GFX_INDEX", &ip);
+    oreg = umr_find_reg_by_name(other, "mmGRBM_GFX_INDEX", &oip);
+    ASSERT_NOT_NULL(reg);
+    ASSERT_NOT_NULL(oreg);
+    ASSERT_NOT_NULL(ip->reg_table);
+    ASSERT_EQ(ip->reg_table == oip->reg_table, 1);
+    ASSERT_EQ(reg == oreg, 0);
+    ASSERT_EQ(reg->regname == oreg->regname, 1);
+    ASSERT_EQ(reg->bits == oreg->bits, 1);
+    ASSERT_EQ(reg->addr, oreg->addr);
+
+    // the table outlives the other device
+    umr_close_asic(other);
+    ASSERT_STR_EQ(reg->regname, "mmGRBM_GFX_INDEX");
+    ASSERT_EQ(umr_find_reg_by_name(asic, "mmGRBM_GFX_INDEX", NULL), reg);
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_startup_timing_navi(struct umr_asic* asic)
+{
+    struct umr_timing a, b;
+
+    (void)asic;
+    umr_timing_get(&a);
+
+    // a phase entered again before it ends is only counted once
+    umr_timing_begin(UMR_TIMING_DATABASE);
+    umr_timing_begin(UMR_TIMING_DATABASE);
+    umr_timing_count(UMR_TIMING_DATABASE, 2, 100);
+    umr_timing_end(UMR_TIMING_DATABASE);
+    umr_timing_end(UMR_TIMING_DATABASE);
+
+    umr_timing_get(&b);
+    umr_timing_sub(&b, &a);
+    ASSERT_EQ(b.phase[UMR_TIMING_DATABASE].calls, 1);
+    ASSERT_EQ(b.phase[UMR_TIMING_DATABASE].files, 2);
+    ASSERT_EQ(b.phase[UMR_TIMING_DATABASE].bytes, 100);
+    ASSERT_EQ(b.phase[UMR_TIMING_DISCOVER].calls, 0);
+    ASSERT_STR_EQ(umr_timing_phase_name(UMR_TIMING_DATABASE), "database");
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_scan_config_once_navi(struct umr_asic* asic)
+{
+    struct umr_options saved = asic->options;
+    int instance = asic->instance;
+
+    // a device without sysfs/debugfs files
+    asic->options.is_virtual = 0;
+    asic->instance = 9999;
+    strcpy(asic->options.pci.name, "ffff:ff:ff.f");
+    asic->config.scanned = 0;
+    ASSERT_EQ(umr_scan_config(asic, 0), -1);
+    ASSERT_EQ(asic->config.scanned, UMR_CONFIG_SCAN_MEM | UMR_CONFIG_SCAN_XGMI);
+    ASSERT_EQ(asic->config.vram_size, 0);
+    ASSERT_NOT_NULL(asic->config_dirs);
+
+    // a group read already is not read again, the others only on request
+    asic->config.vram_size = 1234;
+    ASSERT_EQ(umr_scan_config(asic, 0), -1);
+    ASSERT_EQ(asic->config.vram_size, 1234);
+    ASSERT_SUCCESS(umr_scan_config_fields(asic, 0, UMR_CONFIG_SCAN_FW | UMR_CONFIG_SCAN_VBIOS));
+    ASSERT_EQ(asic->config.scanned & UMR_CONFIG_SCAN_ALL, UMR_CONFIG_SCAN_ALL & ~(UMR_CONFIG_SCAN_XGMI_HIVE | UMR_CONFIG_SCAN_GCA));
+    ASSERT_EQ(asic->config.fw[0].name[0], 0);
+
+    umr_free_config_dirs(asic);
+    asic->options = saved;
+    asic->instance = instance;
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_core_regs_navi(struct umr_asic* asic)
+{
+    struct umr_reg *reg;
+
+    // navi10 has a single GC block without an instance number
+    asic->options.vm_partition = -1;
+
+    // resolved once by ID to the same register the name finds
+    reg = umr_core_reg(asic, UMR_CORE_SQ_CMD);
+    ASSERT_NOT_NULL(reg);
+    ASSERT_EQ(reg, umr_find_reg_data_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, "mmSQ_CMD"));
+    ASSERT_EQ(umr_core_reg(asic, UMR_CORE_SQ_CMD), reg);
+    ASSERT_STR_EQ(umr_core_reg_name(UMR_CORE_CP_HQD_PQ_CONTROL), "mmCP_HQD_PQ_CONTROL");
+    ASSERT_EQ(umr_core_reg(asic, UMR_CORE_REG_MAX) == NULL, 1);
+
+    reg = umr_core_reg(asic, UMR_CORE_SDMA0_QUEUE0_RB_CNTL);
+    ASSERT_EQ(reg, umr_find_reg_data_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, "mmSDMA0_QUEUE0_RB_CNTL"));
+    ASSERT_EQ(umr_read_core_reg(asic, UMR_CORE_CP_HQD_ACTIVE),
+              umr_read_reg_by_name_by_ip_by_instance(asic, "gfx", asic->options.vm_partition, "mmCP_HQD_ACTIVE"));
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_mqd_fields_navi(struct umr_asic* asic)
+{
+    struct umr_mqd_filter f;
+    struct umr_mqd_field field;
+    uint32_t mqd[UMR_MAX_MQD_SIZE], prev[UMR_MAX_MQD_SIZE], row, x, n;
+    char line[256], **txt;
+
+    for (x = 0; x < UMR_MAX_MQD_SIZE; x++)
+        mqd[x] = prev[x] = x * 3;
+
+    // every field is returned in the same text umr_mqd_decode_data() produces
+    ASSERT_SUCCESS(umr_mqd_filter_init(&f, UMR_MQD_ENGINE_COMPUTE, asic->family, "*"));
+    ASSERT_EQ(f.rows, umr_mqd_decode_rows(UMR_MQD_ENGINE_COMPUTE, asic->family));
+    txt = umr_mqd_decode_data(UMR_MQD_ENGINE_COMPUTE, asic->family, mqd, "*");
+    ASSERT_NOT_NULL(txt);
+    row = n = 0;
+    while (umr_mqd_field_next(&f, mqd, UMR_MAX_MQD_SIZE, NULL, &row, &field)) {
+        umr_mqd_field_format(&field, line, sizeof line);
+        ASSERT_STR_EQ(line, txt[n]);
+        free(txt[n++]);
+    }
+    ASSERT_EQ(txt[n] == NULL, 1);
+    ASSERT_EQ(n, f.rows);
+    free(txt);
+
+    // only the changed fields are returned when diffing
+    prev[130] ^= 1;
+    row = n = 0;
+    while (umr_mqd_field_next(&f, mqd, UMR_MAX_MQD_SIZE, prev, &row, &field))
+        ++n;
+    ASSERT_EQ(n, 1);
+    ASSERT_STR_EQ(field.label, "cp_hqd_active");
+    ASSERT_EQ(field.value, 390);
+    ASSERT_EQ(field.prev_value, 391);
+    umr_mqd_filter_free(&f);
+
+    // a partial match selects by label, fields past the data are skipped
+    ASSERT_SUCCESS(umr_mqd_filter_init(&f, UMR_MQD_ENGINE_COMPUTE, asic->family, "cp_hqd_pq_rptr"));
+    row = n = 0;
+    while (umr_mqd_field_next(&f, mqd, UMR_MAX_MQD_SIZE, NULL, &row, &field)) {
+        ASSERT_NOT_NULL(strstr(field.label, "cp_hqd_pq_rptr"));
+        ++n;
+    }
+    ASSERT_EQ(n >= 3, 1);
+    row = 0;
+    ASSERT_EQ(umr_mqd_field_next(&f, mqd, 100, NULL, &row, &field), 0);
+    umr_mqd_filter_free(&f);
+
+    ASSERT_EQ(umr_mqd_filter_init(&f, UMR_MQD_ENGINE_MES, asic->family, "*"), -1);
+    return TEST_SUCCESS;
+}
+
+// HQD registers answer with the SRBM bank they were read through
+static uint64_t cpq_active_addr, cpq_base_addr, cpq_vmid_addr;
+static int cpq_reads;
+
+static uint32_t cpq_read_reg(struct umr_asic *asic, uint64_t addr, enum regclass type)
+{
+    union umr_bank_select *b = &asic->options.bank;
+
+    (void)type;
+    ++cpq_reads;
+    if (asic->options.use_bank != 2)
+        return 0xDEADBEEF;
+    if (addr == cpq_active_addr)
+        return b->srbm.me == 1 && b->srbm.pipe == 2 && b->srbm.queue == 3;
+    if (addr == cpq_vmid_addr)
+        return 0x10 | b->srbm.queue;
+    if (addr == cpq_base_addr)
+        return (b->srbm.me << 16) | (b->srbm.pipe << 8) | b->srbm.queue;
+    return 0;
+}
+
+enum TEST_RESULT test_cp_queues_navi(struct umr_asic* asic)
+{
+    struct umr_cp_queues cq;
+    struct umr_cp_queue_state *q;
+    int x, active = 0;
+
+    asic->options.vm_partition = -1;
+    cpq_active_addr = umr_core_reg(asic, UMR_CORE_CP_HQD_ACTIVE)->addr * 4;
+    cpq_vmid_addr = umr_core_reg(asic, UMR_CORE_CP_HQD_VMID)->addr * 4;
+    cpq_base_addr = umr_core_reg(asic, UMR_CORE_CP_HQD_PQ_BASE)->addr * 4;
+    asic->reg_funcs.read_reg = cpq_read_reg;
+
+    // gfx10.1: 4 pipes of 4 queues on MEC1, 2 pipes on MEC2
+    cpq_reads = 0;
+    ASSERT_SUCCESS(umr_cp_queues_read(asic, UMR_CP_QUEUES_COMPUTE, &cq));
+    ASSERT_EQ(cq.no_queues, 24);
+    ASSERT_EQ(cq.no_pipes, 6);
+    ASSERT_EQ(asic->options.use_bank, 0);
+    for (x = 0; x < cq.no_queues; x++) {
+        q = &cq.queues[x];
+        ASSERT_EQ(q->base, (uint64_t)((q->me << 16) | (q->pipe << 8) | q->queue) << 8);
+        ASSERT_EQ(q->vmid, q->queue);
+        active += q->active;
+    }
+    ASSERT_EQ(active, 1);
+    ASSERT_EQ(cq.queues[2 * 4 + 3].active, 1);
+    ASSERT_EQ(cq.pipes[5].me, 2);
+    ASSERT_EQ(cq.pipes[5].pipe, 1);
+    ASSERT_EQ(cq.pipes[5].has_iptr, 1);
+    ASSERT_EQ(cpq_reads, 24 * 25 + 6);
+    umr_cp_queues_free(&cq);
+
+    ASSERT_SUCCESS(umr_cp_queues_read(asic, UMR_CP_QUEUES_GFX, &cq));
+    ASSERT_EQ(cq.no_queues, 8);
+    ASSERT_EQ(cq.no_pipes, 1);
+    umr_cp_queues_free(&cq);
+    return TEST_SUCCESS;
+}
+
+// every node of a KFD rls dump, a node's words end at the first other line
+enum TEST_RESULT test_kfd_rls_parse_navi(struct umr_asic* asic)
+{
+    const char text[] =
+        "Node 0, gpu_id 5f5a:\n"
+        "  00000000: c0032200 00000180 00000000 00000000 00000000 00000000 00000000 00000000\n"
+        "  00000020: DEADBEEF 1\n"
+        "Node 3, gpu_id abcd:\n"
+        "  00000000: 12345678\n"
+        "  Inactive queues follow\n"
+        "  00000004: 9\n"
+        "Node 4, gpu_id 1:\n";
+    struct umr_kfd_runlist *rls;
+    int n;
+
+    (void)asic;
+    n = umr_kfd_rls_parse(text, sizeof text - 1, &rls);
+    ASSERT_EQ(n, 3);
+    ASSERT_EQ(rls[0].node, 0);
+    ASSERT_EQ(rls[0].gpu_id, 0x5f5a);
+    ASSERT_EQ(rls[0].no_words, 10);
+    ASSERT_EQ(rls[0].words[0], 0xc0032200);
+    ASSERT_EQ(rls[0].words[1], 0x180);
+    ASSERT_EQ(rls[0].words[8], 0xDEADBEEF);
+    ASSERT_EQ(rls[0].words[9], 1);
+    ASSERT_EQ(rls[1].node, 3);
+    ASSERT_EQ(rls[1].gpu_id, 0xabcd);
+    ASSERT_EQ(rls[1].no_words, 1);
+    ASSERT_EQ(rls[1].words[0], 0x12345678);
+    ASSERT_EQ(rls[2].node, 4);
+    ASSERT_EQ(rls[2].no_words, 0);
+    umr_kfd_rls_free(rls, n);
+    return TEST_SUCCESS;
+}
+
+// holds nest and GFXOFF is only written when the state changes
+static int gfxoff_writes(int fd, uint32_t *last)
+{
+    uint32_t v;
+    int n = 0;
+
+    while (read(fd, &v, sizeof v) == sizeof v) {
+        *last = v;
+        ++n;
+    }
+    return n;
+}
+
+enum TEST_RESULT test_gfxoff_guard_navi(struct umr_asic* asic)
+{
+    struct timespec ts = { 0, 50000000 };
+    uint32_t last = 0xFF;
+    int p[2];
+
+    ASSERT_SUCCESS(pipe(p));
+    fcntl(p[0], F_SETFL, O_NONBLOCK);
+    asic->fd.gfxoff = p[1];
+
+    umr_gfxoff_hold(asic);
+    umr_gfxoff_hold(asic);
+    umr_gfxoff_release(asic);
+    ASSERT_EQ(gfxoff_writes(p[0], &last), 1);
+    ASSERT_EQ(last, 0);
+    umr_gfxoff_release(asic);
+    ASSERT_EQ(gfxoff_writes(p[0], &last), 1);
+    ASSERT_EQ(last, 1);
+
+    // with a linger a hold taken right after the release writes nothing
+    umr_gfxoff_set_linger(asic, 20000000);
+    umr_gfxoff_hold(asic);
+    umr_gfxoff_release(asic);
+    umr_gfxoff_hold(asic);
+    umr_gfxoff_release(asic);
+    ASSERT_EQ(gfxoff_writes(p[0], &last), 1);
+    ASSERT_EQ(last, 0);
+    nanosleep(&ts, NULL);
+    ASSERT_EQ(gfxoff_writes(p[0], &last), 1);
+    ASSERT_EQ(last, 1);
+
+    // a hold still taken is dropped when the asic is closed
+    umr_gfxoff_hold(asic);
+    umr_gfxoff_guard_free(asic);
+    ASSERT_EQ(gfxoff_writes(p[0], &last), 2);
+    ASSERT_EQ(last, 1);
+    ASSERT_EQ(asic->gfxoff_guard == NULL, 1);
+
+    asic->fd.gfxoff = -1;
+    close(p[0]);
+    close(p[1]);
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_output_sink_navi(struct umr_asic* asic)
+{
+    char expect[4096], got[4096];
+    size_t len = 0;
+    ssize_t r;
+    FILE *f;
+    int p[2], x;
+
+    ASSERT_SUCCESS(pipe(p));
+    fcntl(p[0], F_SETFL, O_NONBLOCK);
+    // a small buffer so the writer thread gets several chunks
+    asic->options.output = umr_output_open(p[1], 64, 1);
+    ASSERT_EQ(asic->options.output != NULL, 1);
+    ASSERT_EQ(umr_output_stream(asic) == stdout, 1);
+
+    f = umr_output_begin(asic);
+    ASSERT_EQ(f != stdout, 1);
+    ASSERT_EQ(umr_output_stream(asic) == f, 1);
+    // nested sections only write out when the outer one ends
+    ASSERT_EQ(umr_output_begin(asic) == f, 1);
+    for (x = 0; x < 100; x++) {
+        fprintf(f, "line %d\n", x);
+        len += snprintf(expect + len, sizeof expect - len, "line %d\n", x);
+    }
+    umr_output_end(asic);
+    umr_output_end(asic);
+    ASSERT_EQ(umr_output_stream(asic) == stdout, 1);
+
+    r = read(p[0], got, sizeof got);
+    ASSERT_EQ(r, (ssize_t)len);
+    ASSERT_EQ(memcmp(got, expect, len), 0);
+
+    umr_output_close(asic->options.output);
+    asic->options.output = NULL;
+    ASSERT_EQ(umr_output_begin(asic) == stdout, 1);
+    umr_output_end(asic);
+    close(p[0]);
+    close(p[1]);
+    return TEST_SUCCESS;
+}
+
+// the IP index gives the same blocks as a scan of asic->blocks
+static struct umr_ip_block *scan_ip(struct umr_asic *asic, const char *name, int instance)
+{
+    int x;
+
+    for (x = 0; x < asic->no_blocks; x++)
+        if (!memcmp(asic->blocks[x]->ipname, name, strlen(name)) &&
+            (instance < 0 || asic->blocks[x]->discoverable.logical_inst == instance))
+            return asic->blocks[x];
+    return NULL;
+}
+
+enum TEST_RESULT test_ip_index_navi(struct umr_asic* asic)
+{
+    const char *names[] = { "gfx", "sdma", "vcn", "mmhub", "oss", "osssys" };
+    struct umr_ip_block *ip;
+    int x, inst, maj, min;
+
+    for (x = 0; x < 6; x++)
+        for (inst = -1; inst < 3; inst++)
+            ASSERT_EQ(umr_find_ip_block(asic, names[x], inst) == scan_ip(asic, names[x], inst), 1);
+    ASSERT_EQ(umr_ip_block_by_kind(asic, UMR_IP_GFX, -1) == scan_ip(asic, "gfx", -1), 1);
+    ASSERT_NOT_NULL(umr_ip_block_by_kind(asic, UMR_IP_GFX, -1));
+    ASSERT_EQ(umr_ip_block_by_kind(asic, UMR_IP_MAX, -1) == NULL, 1);
+
+    // navi10 is GC 10.1
+    ASSERT_SUCCESS(umr_gfx_get_ip_ver(asic, &maj, &min));
+    ASSERT_EQ(maj, 10);
+    ASSERT_EQ(min, 1);
+    ASSERT_SUCCESS(umr_get_ip_revision(asic, "gfx", &maj, NULL, NULL));
+    ASSERT_EQ(maj, 10);
+    ASSERT_EQ(umr_get_ip_revision(asic, "nosuchip", NULL, NULL, NULL), -1);
+
+    // the index follows a change of the blocks
+    ip = asic->blocks[0];
+    asic->no_blocks--;
+    asic->blocks++;
+    ASSERT_EQ(umr_find_ip_block(asic, ip->ipname, -1) == scan_ip(asic, ip->ipname, -1), 1);
+    asic->blocks--;
+    asic->no_blocks++;
+    ASSERT_EQ(umr_find_ip_block(asic, "gfx", -1) == scan_ip(asic, "gfx", -1), 1);
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_binary_test_vector_navi(struct umr_asic* asic)
+{
+    char txt[] = "/tmp/umr_tv_XXXXXX", bin[] = "/tmp/umr_tvb_XXXXXX";
+    struct umr_test_harness *th;
+    struct umr_options opt;
+    uint32_t words[3] = { 5, 6, 7 };
+    FILE *f;
+    int fd;
+
+    (void)asic;
+    fd = mkstemp(txt);
+    ASSERT_EQ(fd >= 0, 1);
+    close(fd);
+    fd = mkstemp(bin);
+    ASSERT_EQ(fd >= 0, 1);
+    close(fd);
+
+    f = fopen(txt, "w");
+    ASSERT_NOT_NULL(f);
+    fprintf(f, "MMIO@0x100 = { 0x1, 0x2 }\nVRAM@0x1000 = {01020304}\nMMIO@0x100 = { 0x3 }\nSQ@0x8 = { 0x9 }\n");
+    fclose(f);
+
+    // text to binary and back, blocks of the same address stay in order
+    ASSERT_SUCCESS(umr_test_vector_convert(txt, bin));
+    ASSERT_EQ(umr_is_binary_test_vector(bin), 1);
+    ASSERT_EQ(umr_is_binary_test_vector(txt), 0);
+    ASSERT_SUCCESS(umr_test_vector_convert(bin, txt));
+    th = umr_create_test_harness_file(txt);
+    ASSERT_NOT_NULL(th);
+    ASSERT_EQ(th->mmio.no_values, 2);
+    ASSERT_EQ(th->mmio.next->values[0], 3);
+    ASSERT_EQ(th->vram.contents[3], 4);
+    ASSERT_EQ(th->sq.values[0], 9);
+    umr_free_test_harness(th);
+
+    // a log that was never closed has no index and is read by walking the records
+    memset(&opt, 0, sizeof opt);
+    opt.test_log_bin = umr_test_vector_open(bin);
+    ASSERT_NOT_NULL(opt.test_log_bin);
+    opt.test_log_fd = umr_test_vector_stream(opt.test_log_bin);
+    umr_test_log_words(&opt, UMR_TV_WAVESTATUS, 0x80, words, 3, NULL);
+    umr_test_log_bytes(&opt, UMR_TV_SYSRAM, 0x2000, "abc", 3);
+    fflush(opt.test_log_fd);
+    th = umr_create_test_harness_file(bin);
+    ASSERT_NOT_NULL(th);
+    ASSERT_EQ(th->wave.mmio_address, 0x80);
+    ASSERT_EQ(th->wave.no_values, 3);
+    ASSERT_EQ(th->sysram.size, 3);
+    umr_free_test_harness(th);
+
+    ASSERT_SUCCESS(umr_test_vector_close(opt.test_log_bin));
+    th = umr_create_test_harness_file(bin);
+    unlink(bin);
+    unlink(txt);
+    ASSERT_NOT_NULL(th);
+    ASSERT_EQ(th->wave.values[2], 7);
+    ASSERT_EQ(memcmp(th->sysram.contents, "abc", 3), 0);
+    umr_free_test_harness(th);
+    return TEST_SUCCESS;
+}
+
+static uint32_t wf_addr, wf_value, wf_stuck;
+static int wf_reads, wf_writes;
+
+static uint32_t wf_read_reg(struct umr_asic *asic, uint64_t addr, enum regclass type)
+{
+    (void)asic; (void)type;
+    ++wf_reads;
+    return addr == wf_addr ? wf_value : 0xDEADBEEF;
+}
+
+static int wf_write_reg(struct umr_asic *asic, uint64_t addr, uint32_t value, enum regclass type)
+{
+    (void)asic; (void)type;
+    ++wf_writes;
+    if (addr == wf_addr)
+        wf_value = (value & ~wf_stuck) | (wf_value & wf_stuck);
+    return 0;
+}
+
+enum TEST_RESULT test_write_fields_navi(struct umr_asic* asic)
+{
+    struct umr_field_update u[4];
+    struct umr_reg_handle h;
+    struct umr_reg *reg;
+    uint32_t expect;
+
+    ASSERT_SUCCESS(umr_reg_handle_resolve(asic, NULL, -1, "mmGRBM_GFX_INDEX", &h));
+    reg = h.reg;
+    wf_addr = reg->addr * 4;
+    asic->reg_funcs.read_reg = wf_read_reg;
+    asic->reg_funcs.write_reg = wf_write_reg;
+
+    // three fields (one set twice) of the register: one read, one write
+    memset(u, 0, sizeof u);
+    u[0].reg = u[1].reg = u[2].reg = u[3].reg = reg;
+    u[0].bitname = "SE_INDEX";
+    u[0].value = 1;
+    u[1].bitname = "SA_INDEX";
+    u[1].value = 2;
+    u[2].bitname = "SE_INDEX";
+    u[2].value = 3;
+    u[3].bitname = "INSTANCE_INDEX";
+    u[3].value = 4;
+    wf_value = 0xFFFFFFFF;
+    wf_stuck = wf_reads = wf_writes = 0;
+    expect = 0xFFFFFFFF & ~(umr_bitslice_compose_value(asic, reg, "SE_INDEX", 0xFFFFFFFF) |
+                            umr_bitslice_compose_value(asic, reg, "SA_INDEX", 0xFFFFFFFF) |
+                            umr_bitslice_compose_value(asic, reg, "INSTANCE_INDEX", 0xFFFFFFFF));
+    expect |= umr_bitslice_compose_value(asic, reg, "SE_INDEX", 3) |
+              umr_bitslice_compose_value(asic, reg, "SA_INDEX", 2) |
+              umr_bitslice_compose_value(asic, reg, "INSTANCE_INDEX", 4);
+    ASSERT_EQ(umr_write_fields(asic, u, 4, 0), 0);
+    ASSERT_EQ(wf_reads, 1);
+    ASSERT_EQ(wf_writes, 1);
+    ASSERT_EQ(wf_value, expect);
+    ASSERT_EQ(u[0].result, expect);
+    ASSERT_EQ(u[3].result, expect);
+
+    // verify reads back once more and reports the field that did not stick
+    wf_reads = wf_writes = 0;
+    u[0].value = 5;
+    wf_stuck = umr_bitslice_compose_value(asic, reg, "SE_INDEX", 0xFFFFFFFF);
+    ASSERT_EQ(umr_write_fields(asic, u, 1, UMR_WRITE_FIELDS_VERIFY), 1);
+    ASSERT_EQ(wf_reads, 2);
+    ASSERT_EQ(wf_writes, 1);
+    ASSERT_EQ(u[0].result, expect);
+
+    // an unknown field leaves the hardware alone
+    wf_reads = wf_writes = 0;
+    u[1].bitname = "NO_SUCH_FIELD";
+    ASSERT_EQ(umr_write_fields(asic, u, 2, 0), -1);
+    ASSERT_EQ(wf_reads, 0);
+    ASSERT_EQ(wf_writes, 0);
+    ASSERT_EQ(asic->options.use_bank, 0);
+    return TEST_SUCCESS;
+}
+
+// a byte addressed SMC space of two dwords
+static uint32_t smc64_words[2];
+
+static uint32_t smc64_read_reg(struct umr_asic *asic, uint64_t addr, enum regclass type)
+{
+    (void)asic;
+    if (type != REG_SMC || (addr != 0x1000 && addr != 0x1004))
+        return 0xDEADBEEF;
+    return smc64_words[(addr - 0x1000) / 4];
+}
+
+static int smc64_write_reg(struct umr_asic *asic, uint64_t addr, uint32_t value, enum regclass type)
+{
+    (void)asic;
+    if (type != REG_SMC || (addr != 0x1000 && addr != 0x1004))
+        return -1;
+    smc64_words[(addr - 0x1000) / 4] = value;
+    return 0;
+}
+
+// the HI half of a 64-bit SMC register is the next dword, 4 bytes on
+enum TEST_RESULT test_write_fields_smc64_navi(struct umr_asic* asic)
+{
+    struct umr_bitfield bits[] = { { "LO_FIELD", 0, 15 }, { "HI_FIELD", 32, 47 } };
+    struct umr_reg reg;
+    struct umr_field_update u[2];
+
+    memset(&reg, 0, sizeof reg);
+    reg.regname = "ixTEST_SMC64";
+    reg.addr = 0x1000;
+    reg.type = REG_SMC;
+    reg.bits = bits;
+    reg.no_bits = 2;
+    reg.bit64 = 1;
+    asic->reg_funcs.read_reg = smc64_read_reg;
+    asic->reg_funcs.write_reg = smc64_write_reg;
+    asic->reg_funcs.read_reg64 = NULL;
+    asic->reg_funcs.write_reg64 = NULL;
+
+    smc64_words[0] = 0x11112222;
+    smc64_words[1] = 0x33334444;
+    memset(u, 0, sizeof u);
+    u[0].reg = u[1].reg = &reg;
+    u[0].bitname = "LO_FIELD";
+    u[0].value = 0xAAAA;
+    u[1].bitname = "HI_FIELD";
+    u[1].value = 0xBBBB;
+    ASSERT_EQ(umr_write_fields(asic, u, 2, UMR_WRITE_FIELDS_VERIFY), 0);
+    ASSERT_EQ(smc64_words[0], 0x1111AAAA);
+    ASSERT_EQ(smc64_words[1], 0x3333BBBB);
+    ASSERT_EQ(u[1].result, 0x3333BBBB1111AAAAULL);
+
+    // and the single register path agrees
+    ASSERT_EQ(umr_read_reg_by_reg(asic, &reg), 0x3333BBBB1111AAAAULL);
+    ASSERT_SUCCESS(umr_write_reg_by_reg(asic, &reg, 0x0123456789ABCDEFULL));
+    ASSERT_EQ(smc64_words[0], 0x89ABCDEF);
+    ASSERT_EQ(smc64_words[1], 0x01234567);
+    return TEST_SUCCESS;
+}
+
+static int xcc_seen[4];
+
+static int xcc_print(struct umr_asic *asic, void *data)
+{
+    int xcc = umr_xcc_current();
+
+    (void)data;
+    xcc_seen[xcc] = asic->options.vm_partition + 1;
+    if (xcc)
+        fprintf(umr_output_begin(asic), "hello %d\n", xcc);
+    umr_output_end(asic);
+    return 0;
+}
+
+enum TEST_RESULT test_xcc_run_navi(struct umr_asic* asic)
+{
+    struct umr_ip_block **blocks = asic->blocks, *gfx, copy, *fake[64];
+    int no_blocks = asic->no_blocks, r;
+    char *text = NULL;
+    size_t size = 0;
+    FILE *f, *prev;
+
+    asic->options.vm_partition = -1;
+    ASSERT_EQ(umr_xcc_count(asic), 1);
+    ASSERT_EQ(umr_xcc_current(), -1);
+
+    // a second GC instance
+    gfx = umr_ip_block_by_kind(asic, UMR_IP_GFX, 0);
+    ASSERT_NOT_NULL(gfx);
+    ASSERT_EQ(no_blocks < 63, 1);
+    memcpy(fake, blocks, no_blocks * sizeof fake[0]);
+    copy = *gfx;
+    copy.discoverable.logical_inst = 1;
+    fake[no_blocks] = &copy;
+    asic->blocks = fake;
+    asic->no_blocks = no_blocks + 1;
+    ASSERT_EQ(umr_xcc_count(asic), 2);
+
+    // the test harness runs the XCCs one after the other on the partition
+    f = open_memstream(&text, &size);
+    prev = umr_output_redirect(f);
+    memset(xcc_seen, 0, sizeof xcc_seen);
+    r = umr_xcc_run(asic, xcc_print, NULL);
+    umr_output_redirect(prev);
+    fclose(f);
+    asic->blocks = blocks;
+    asic->no_blocks = no_blocks;
+
+    ASSERT_EQ(r, 0);
+    ASSERT_EQ(xcc_seen[0], 1);
+    ASSERT_EQ(xcc_seen[1], 2);
+    ASSERT_EQ(asic->options.vm_partition, -1);
+    // XCC 0 printed nothing so it has no header
+    ASSERT_STR_EQ(text, "=== XCC 1 ===\nhello 1\n");
+    free(text);
+    return TEST_SUCCESS;
+}
+
+static uint32_t iov_fcn_addr, iov_vm_addr, iov_db_addr, iov_sdma0_addr, iov_sdma1_addr, iov_fcn;
+
+static uint32_t iov_read_reg(struct umr_asic *asic, uint64_t addr, enum regclass type)
+{
+    (void)asic; (void)type;
+    if (addr == iov_fcn_addr)
+        return iov_fcn;
+    if (addr == iov_vm_addr)
+        return (1u << 2) | (1u << 31);
+    if (addr == iov_db_addr)
+        return 1u << 0;
+    if (addr == iov_sdma0_addr)
+        return 1u << 2;
+    if (addr == iov_sdma1_addr)
+        return 1u << 0;
+    return 0;
+}
+
+static uint32_t iov_addr(struct umr_asic *asic, const char *name)
+{
+    struct umr_reg_handle h;
+
+    if (umr_reg_handle_resolve(asic, NULL, -1, name, &h))
+        return 0;
+    return h.reg->addr * 4;
+}
+
+enum TEST_RESULT test_sriov_sampler_navi(struct umr_asic* asic)
+{
+    struct umr_sriov_vf vfs[2];
+    struct umr_sriov_fcn_stats st[3];
+    struct umr_sriov_sampler *s;
+    uint64_t samples;
+
+    asic->options.vm_partition = -1;
+    iov_fcn_addr = iov_addr(asic, "mmRLC_GPU_IOV_ACTIVE_FCN_ID");
+    iov_vm_addr = iov_addr(asic, "mmRLC_GPU_IOV_VM_BUSY_STATUS");
+    iov_db_addr = iov_addr(asic, "mmRLC_GPU_IOV_VF_DOORBELL_STATUS");
+    iov_sdma0_addr = iov_addr(asic, "mmRLC_GPU_IOV_SDMA0_BUSY_STATUS");
+    iov_sdma1_addr = iov_addr(asic, "mmRLC_GPU_IOV_SDMA1_BUSY_STATUS");
+    ASSERT_EQ(!iov_fcn_addr || !iov_vm_addr || !iov_db_addr || !iov_sdma0_addr || !iov_sdma1_addr, 0);
+    asic->reg_funcs.read_reg = iov_read_reg;
+
+    // VFs 0 and 2, none bound on the host
+    memset(vfs, 0, sizeof vfs);
+    vfs[0].index = 0;
+    vfs[0].instance = -1;
+    vfs[1].index = 2;
+    vfs[1].instance = -1;
+    s = umr_sriov_sampler_open(asic, vfs, 2);
+    ASSERT_NOT_NULL(s);
+
+    // VF 2 owns the engine twice, then the PF
+    iov_fcn = (1u << 31) | 2;
+    ASSERT_SUCCESS(umr_sriov_sampler_sample(s));
+    ASSERT_SUCCESS(umr_sriov_sampler_sample(s));
+    iov_fcn = 0;
+    ASSERT_SUCCESS(umr_sriov_sampler_sample(s));
+
+    ASSERT_EQ(umr_sriov_sampler_take(s, st, &samples), 3);
+    ASSERT_EQ(samples, 3);
+    ASSERT_EQ(st[0].active, 0);
+    ASSERT_EQ(st[0].gfx_busy, 0);
+    ASSERT_EQ(st[0].sdma_busy, 3);
+    ASSERT_EQ(st[0].doorbell, 3);
+    ASSERT_EQ(st[0].has_rings, 0);
+    ASSERT_EQ(st[1].active, 2);
+    ASSERT_EQ(st[1].gfx_busy, 3);
+    ASSERT_EQ(st[1].sdma_busy, 3);
+    ASSERT_EQ(st[1].doorbell, 0);
+    ASSERT_EQ(st[1].switches, 0);
+    ASSERT_EQ(st[2].active, 1);
+    ASSERT_EQ(st[2].gfx_busy, 3);
+    ASSERT_EQ(st[2].switches, 1);
+
+    // taking the counters resets them but a switch still counts across
+    iov_fcn = (1u << 31) | 0;
+    ASSERT_SUCCESS(umr_sriov_sampler_sample(s));
+    ASSERT_EQ(umr_sriov_sampler_take(s, st, &samples), 3);
+    ASSERT_EQ(samples, 1);
+    ASSERT_EQ(st[0].active, 1);
+    ASSERT_EQ(st[0].switches, 1);
+    ASSERT_EQ(st[1].active, 0);
+    ASSERT_EQ(st[2].active, 0);
+    umr_sriov_sampler_close(s);
+    return TEST_SUCCESS;
+}
+
 DEFINE_TESTS(mmio_tests)
 TEST(test_reg_name_to_offset_navi, "navi_reg_only.envdef", "navi10"),
 TEST(test_reg_name_to_offset_raven, "raven_reg_only.envdef", "raven1"),
 TEST(test_reg_name_to_offset_renoir, "renoir_reg_only.envdef", "renoir"),
+TEST(test_read_regs_batch_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_field_handle_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_bitslice_all_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_serialize_user_queue_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_find_reg_by_addr_aliases_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_reg_name_r_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_read_reg_by_reg_64bit_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_access_ctx_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_access_ctx_wave_fields_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_wave_status_bulk_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_wave_field_id_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_scan_wave_arena_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_scan_wave_lazy_gprs_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_scan_wave_filter_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_write_fields_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_write_fields_smc64_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_xcc_run_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_sriov_sampler_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_wave_snapshot_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_ring_is_halted_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_sq_cmd_halt_within_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_disasm_cache_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_disasm_block_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_binary_test_vector_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_find_reg_wild_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_reg_snapshot_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_name_pool_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_lazy_regs_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_database_scan_cache_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_shared_reg_tables_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_startup_timing_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_scan_config_once_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_core_regs_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_mqd_fields_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_cp_queues_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_kfd_rls_parse_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_ip_index_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_gfxoff_guard_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_output_sink_navi, "navi_reg_only.envdef", "navi10"),
 END_TESTS(mmio_tests);
@@ -0,0 +1,730 @@
+#include "test_framework.h"
+
+// folds the callbacks of a decode into a checksum
+static void sum_start_ib(struct umr_stream_decode_ui *ui, uint64_t ib_addr, uint32_t ib_vmid, uint64_t from_addr, uint32_t from_vmid, uint32_t size, int type)
+{
+    uint64_t *sum = ui->data;
+    (void)from_vmid;
+    *sum = *sum * 31 + ib_addr + ib_vmid + from_addr + size + type;
+}
+
+static void sum_start_opcode(struct umr_stream_decode_ui *ui, uint64_t ib_addr, uint32_t ib_vmid, int pkttype, uint32_t opcode, uint32_t subop, uint32_t nwords, const char *opcode_name, uint32_t header, const uint32_t *raw_data)
+{
+    uint64_t *sum = ui->data;
+    uint32_t n;
+
+    (void)ib_vmid; (void)subop;
+    *sum = *sum * 31 + ib_addr + pkttype + opcode + nwords + header + strlen(opcode_name);
+    for (n = 0; n < nwords; n++)
+        *sum = *sum * 31 + raw_data[n];
+}
+
+static void sum_add_field(struct umr_stream_decode_ui *ui, uint64_t ib_addr, uint32_t ib_vmid, const char *field_name, uint64_t value, char *str, int ideal_radix, int field_size)
+{
+    uint64_t *sum = ui->data;
+    (void)ib_vmid;
+    *sum = *sum * 31 + ib_addr + value + ideal_radix + field_size + strlen(field_name) + (str ? strlen(str) : 0);
+}
+
+static void sum_done(struct umr_stream_decode_ui *ui)
+{
+    uint64_t *sum = ui->data;
+    *sum = *sum * 31 + 1;
+}
+
+enum TEST_RESULT test_packet_log_navi(struct umr_asic* asic)
+{
+    uint32_t words[] = {
+        0xC0001000, 0x12345678,             // NOP
+        0xC0017600, 0x20C, 0x1000,          // SET_SH_REG
+        0xC0016900, 0x1, 0x5,               // SET_CONTEXT_REG
+        0xC0033700, 0x500, 0x1000, 0x0, 0x7,// WRITE_DATA
+        0xC0001000, 0x0,                    // NOP
+    };
+    struct umr_stream_decode_ui ui;
+    struct umr_packet_stream *str;
+    struct umr_packet_log *log;
+    struct umr_packet_log_reader reader;
+    struct umr_packet_log_event ev;
+    uint64_t direct = 0, replayed = 0;
+    int n;
+
+    memset(&ui, 0, sizeof ui);
+    ui.rt = UMR_RING_PM4;
+    ui.start_ib = sum_start_ib;
+    ui.start_opcode = sum_start_opcode;
+    ui.add_field = sum_add_field;
+    ui.done = sum_done;
+
+    ui.data = &direct;
+    str = umr_packet_decode_buffer(asic, &ui, 0, 0x1000, words, sizeof words / 4, UMR_RING_PM4, NULL);
+    ASSERT_NOT_NULL(str);
+    umr_packet_disassemble_stream(str, 0x1000, 0, 0, 0, ~0UL, 0, 0);
+    umr_packet_free(str);
+
+    log = umr_packet_log_create(UMR_RING_PM4);
+    ASSERT_NOT_NULL(log);
+    str = umr_packet_decode_buffer(asic, &log->ui, 0, 0x1000, words, sizeof words / 4, UMR_RING_PM4, NULL);
+    ASSERT_NOT_NULL(str);
+    umr_packet_disassemble_stream(str, 0x1000, 0, 0, 0, ~0UL, 0, 0);
+    umr_packet_free(str);
+
+    // the log replays exactly the calls of the decode
+    ui.data = &replayed;
+    ASSERT_EQ(umr_packet_log_replay(log, asic, &ui), 0);
+    ASSERT_EQ(replayed, direct);
+
+    umr_packet_log_reader_init(&reader, log);
+    ASSERT_EQ(umr_packet_log_next(&reader, &ev), 1);
+    ASSERT_EQ(ev.type, UMR_PACKET_LOG_START_IB);
+    ASSERT_EQ(ev.addr, 0x1000ULL);
+    n = 0;
+    while (umr_packet_log_next(&reader, &ev) > 0)
+        if (ev.type == UMR_PACKET_LOG_START_OPCODE)
+            ++n;
+    ASSERT_EQ(n, 5);
+    umr_packet_log_reader_fini(&reader);
+
+    umr_packet_log_free(log);
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_packet_index_navi(struct umr_asic* asic)
+{
+    uint32_t words[] = {
+        0xC0001000, 0x12345678,             // NOP
+        0xC0017600, 0x20C, 0x1000,          // SET_SH_REG
+        0xC0016900, 0x1, 0x5,               // SET_CONTEXT_REG
+        0xC0033700, 0x500, 0x1000, 0x0, 0x7,// WRITE_DATA
+        0xC0001000, 0x0,                    // NOP
+    };
+    struct umr_stream_decode_ui ui;
+    struct umr_packet_index *idx;
+    uint64_t sum = 0, direct = 0;
+    struct umr_packet_stream *str;
+
+    idx = umr_packet_index_buffer(asic, words, sizeof words / 4, UMR_RING_PM4);
+    ASSERT_NOT_NULL(idx);
+    ASSERT_EQ(idx->no_entries, 5u);
+    ASSERT_EQ(idx->entries[1].offset, 2u);
+    ASSERT_EQ(idx->entries[1].nwords, 3u);
+    ASSERT_EQ(idx->entries[3].offset, 8u);
+    ASSERT_EQ(idx->entries[3].opcode, 0x37u);
+    ASSERT_STR_EQ(idx->entries[3].name, "PKT3_WRITE_DATA");
+
+    memset(&ui, 0, sizeof ui);
+    ui.rt = UMR_RING_PM4;
+    ui.start_ib = sum_start_ib;
+    ui.start_opcode = sum_start_opcode;
+    ui.add_field = sum_add_field;
+    ui.done = sum_done;
+
+    // decoding one entry gives what decoding its words does
+    ui.data = &sum;
+    ASSERT_EQ(umr_packet_decode_index(asic, &ui, idx, 3, 1, words, 0, 0x1000, 0), 0);
+    ui.data = &direct;
+    str = umr_packet_decode_buffer(asic, &ui, 0, 0x1000 + 8 * 4, &words[8], 5, UMR_RING_PM4, NULL);
+    ASSERT_NOT_NULL(str);
+    umr_packet_disassemble_stream(str, 0x1000 + 8 * 4, 0, 0, 0, ~0UL, 0, 0);
+    umr_packet_free(str);
+    ASSERT_EQ(sum, direct);
+
+    ASSERT_EQ(umr_packet_decode_index(asic, &ui, idx, 4, 2, words, 0, 0x1000, 0), -1);
+    umr_packet_index_free(idx);
+    return TEST_SUCCESS;
+}
+
+// an 8 word ring whose pending packets wrap around its end
+static void *capture_read_ring(struct umr_asic *asic, char *ringname, uint32_t *ringsize)
+{
+    static const uint32_t gfx[] = {
+        6, 2 + 8, 2,                        // rptr, unwrapped wptr, dwptr
+        0x12345678, 0x0, 0xDEADBEEF, 0xDEADBEEF, 0xDEADBEEF, 0xDEADBEEF,
+        0xC0001000, 0xC0001000,             // NOP, NOP
+    };
+    uint32_t *data;
+
+    (void)asic;
+    if (strcmp(ringname, "gfx_0.0.0") && strcmp(ringname, "sdma0"))
+        return NULL;
+    data = malloc(sizeof gfx);
+    memcpy(data, gfx, sizeof gfx);
+    if (!strcmp(ringname, "sdma0"))
+        data[0] = data[1] = 3;              // idle
+    *ringsize = sizeof gfx - 12;
+    return data;
+}
+
+enum TEST_RESULT test_ring_capture_navi(struct umr_asic* asic)
+{
+    char *names[] = { "gfx_0.0.0", "sdma0", "vcn_dec_0", "bogus" };
+    uint32_t expect[] = { 0xC0001000, 0xC0001000, 0x12345678, 0x0 };
+    void *(*saved)(struct umr_asic *, char *, uint32_t *) = asic->ring_func.read_ring_data;
+    struct umr_stream_decode_ui ui;
+    struct umr_ring_capture *cap;
+    struct umr_packet_stream *str;
+    uint64_t sum = 0, direct = 0;
+    uint32_t *words, nwords;
+
+    ASSERT_EQ(umr_ring_type_by_name("comp_1.0.0"), UMR_RING_PM4);
+    ASSERT_EQ(umr_ring_type_by_name("page1"), UMR_RING_SDMA);
+    ASSERT_EQ(umr_ring_type_by_name("bogus"), UMR_RING_UNK);
+
+    asic->ring_func.read_ring_data = capture_read_ring;
+    cap = umr_ring_capture(asic, names, 4, 4);
+    asic->ring_func.read_ring_data = saved;
+    ASSERT_NOT_NULL(cap);
+    ASSERT_EQ(cap->no_rings, 4);
+    ASSERT_EQ(cap->rings[0].ok, 1);
+    ASSERT_EQ(cap->rings[0].rt, UMR_RING_PM4);
+    ASSERT_EQ(cap->rings[0].nwords, 8u);
+    ASSERT_EQ(cap->rings[0].rptr, 6u);
+    ASSERT_EQ(cap->rings[0].wptr, 2u);
+    ASSERT_EQ(cap->rings[1].ok, 1);
+    ASSERT_EQ(cap->rings[1].rt, UMR_RING_SDMA);
+    ASSERT_EQ(cap->rings[2].ok, 0);
+    ASSERT_EQ(cap->rings[2].rt, UMR_RING_VCN_DEC);
+    ASSERT_EQ(cap->rings[3].rt, UMR_RING_UNK);
+
+    // the span is unwrapped, an idle or unread ring has none
+    words = umr_ring_capture_span(&cap->rings[0], &nwords);
+    ASSERT_NOT_NULL(words);
+    ASSERT_EQ(nwords, 4u);
+    ASSERT_EQ(memcmp(words, expect, sizeof expect), 0);
+    free(words);
+    ASSERT_EQ(umr_ring_capture_span(&cap->rings[1], &nwords) == NULL, 1);
+    ASSERT_EQ(nwords, 0u);
+    ASSERT_EQ(umr_ring_capture_span(&cap->rings[2], &nwords) == NULL, 1);
+
+    memset(&ui, 0, sizeof ui);
+    ui.rt = UMR_RING_PM4;
+    ui.start_ib = sum_start_ib;
+    ui.start_opcode = sum_start_opcode;
+    ui.add_field = sum_add_field;
+    ui.done = sum_done;
+
+    // decoding the capture gives what decoding the span does
+    ui.data = &sum;
+    str = umr_ring_capture_decode(asic, &ui, cap, 0, NULL);
+    ASSERT_NOT_NULL(str);
+    umr_packet_disassemble_stream(str, 0, 0, 0, 0, ~0UL, 0, 0);
+    umr_packet_free(str);
+    ui.data = &direct;
+    str = umr_packet_decode_buffer(asic, &ui, 0, 0, expect, 4, UMR_RING_PM4, NULL);
+    ASSERT_NOT_NULL(str);
+    umr_packet_disassemble_stream(str, 0, 0, 0, 0, ~0UL, 0, 0);
+    umr_packet_free(str);
+    ASSERT_EQ(sum, direct);
+    ASSERT_EQ(umr_ring_capture_decode(asic, &ui, cap, 3, NULL) == NULL, 1);
+
+    umr_ring_capture_free(cap);
+    return TEST_SUCCESS;
+}
+
+// a feed presents each run of packets, the IB around it is not summed
+static void feed_start_ib(struct umr_stream_decode_ui *ui, uint64_t ib_addr, uint32_t ib_vmid, uint64_t from_addr, uint32_t from_vmid, uint32_t size, int type)
+{
+    (void)ui; (void)ib_addr; (void)ib_vmid; (void)from_addr; (void)from_vmid; (void)size; (void)type;
+}
+
+static void feed_done(struct umr_stream_decode_ui *ui)
+{
+    (void)ui;
+}
+
+static void feed_present(struct umr_packet_stream *str, uint64_t addr, uint32_t vmid, void *data)
+{
+    uint32_t *runs = data;
+
+    umr_packet_disassemble_stream(str, addr, vmid, 0, 0, ~0UL, 0, 0);
+    ++*runs;
+}
+
+enum TEST_RESULT test_packet_feed_navi(struct umr_asic* asic)
+{
+    const uint32_t pkts[] = {
+        0xC0001000, 0x12345678,             // NOP
+        0xC0016900, 0x1, 0x5,               // SET_CONTEXT_REG
+        0xC0033700, 0x500, 0x1000, 0x0, 0x7,// WRITE_DATA
+        0xC0001000, 0x0,                    // NOP
+    };
+    const uint32_t chunks[] = { 1, 3, 7, 64 };
+    uint32_t words[8 * 12], nwords = 0, runs, c, off, n;
+    struct umr_stream_decode_ui ui;
+    struct umr_packet_stream *str;
+    struct umr_packet_feed *feed;
+    uint64_t sum, direct = 0;
+    char fname[] = "/tmp/umr_feed_XXXXXX.bin";
+    int fd;
+
+    for (n = 0; n < 8; n++) {
+        memcpy(&words[nwords], pkts, sizeof pkts);
+        words[nwords + 1] = n;
+        nwords += sizeof pkts / 4;
+    }
+
+    memset(&ui, 0, sizeof ui);
+    ui.rt = UMR_RING_PM4;
+    ui.start_ib = feed_start_ib;
+    ui.start_opcode = sum_start_opcode;
+    ui.add_field = sum_add_field;
+    ui.done = feed_done;
+
+    ui.data = &direct;
+    str = umr_packet_decode_buffer(asic, &ui, 0, 0x1000, words, nwords, UMR_RING_PM4, NULL);
+    ASSERT_NOT_NULL(str);
+    umr_packet_disassemble_stream(str, 0x1000, 0, 0, 0, ~0UL, 0, 0);
+    umr_packet_free(str);
+
+    // packets cut by a chunk are decoded once the rest of them arrives
+    ui.data = &sum;
+    for (c = 0; c < sizeof chunks / sizeof chunks[0]; c++) {
+        sum = 0;
+        runs = 0;
+        feed = umr_packet_feed_create(asic, &ui, UMR_RING_PM4, UMR_PACKET_IP_VERSION_AUTO, 0, 0x1000, feed_present, &runs);
+        ASSERT_NOT_NULL(feed);
+        for (off = 0; off < nwords; off += n) {
+            n = nwords - off < chunks[c] ? nwords - off : chunks[c];
+            ASSERT_EQ(umr_packet_feed_push(feed, &words[off], n), 0);
+        }
+        n = runs;
+        ASSERT_EQ(umr_packet_feed_finish(feed), 0);
+        ASSERT_EQ(runs, n);
+        ASSERT_EQ(sum, direct);
+        umr_packet_feed_free(feed);
+    }
+
+    // the last NOP is held until its second word is pushed
+    runs = 0;
+    feed = umr_packet_feed_create(asic, &ui, UMR_RING_PM4, UMR_PACKET_IP_VERSION_AUTO, 0, 0x1000, feed_present, &runs);
+    ASSERT_NOT_NULL(feed);
+    ASSERT_EQ(umr_packet_feed_push(feed, words, nwords - 1), 0);
+    ASSERT_EQ(runs, 1u);
+    ASSERT_EQ(umr_packet_feed_push(feed, &words[nwords - 1], 1), 0);
+    ASSERT_EQ(runs, 2u);
+    umr_packet_feed_free(feed);
+
+    // and from a file
+    fd = mkstemps(fname, 4);
+    ASSERT_EQ(fd >= 0, 1);
+    ASSERT_EQ(write(fd, words, nwords * 4), (ssize_t)(nwords * 4));
+    close(fd);
+    sum = 0;
+    runs = 0;
+    feed = umr_packet_feed_create(asic, &ui, UMR_RING_PM4, UMR_PACKET_IP_VERSION_AUTO, 0, 0x1000, feed_present, &runs);
+    ASSERT_NOT_NULL(feed);
+    ASSERT_EQ(umr_packet_feed_file(feed, fname), 0);
+    unlink(fname);
+    ASSERT_EQ(sum, direct);
+    umr_packet_feed_free(feed);
+
+    ASSERT_EQ(umr_packet_feed_create(asic, &ui, UMR_RING_GUESS, UMR_PACKET_IP_VERSION_AUTO, 0, 0, NULL, NULL) == NULL, 1);
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_mes_index_navi(struct umr_asic* asic)
+{
+    uint32_t words[50], x;
+    struct umr_mes_index *idx;
+
+    // three v10 REMOVE_QUEUE packets, two for doorbell 0x100 and two for
+    // gang 0x2000, with padding after the first
+    memset(words, 0, sizeof words);
+    for (x = 0; x < 3; x++) {
+        uint32_t *p = &words[x ? 2 + 16 * x : 0];
+        p[0] = 0x00010031;
+        p[1] = x == 2 ? 0x200 : 0x100;      // doorbell_offset
+        p[2] = x == 1 ? 0x3000 : 0x2000;    // gang_context_addr
+        p[10] = x + 1;                      // queue_id
+    }
+
+    idx = umr_mes_index_create();
+    ASSERT_NOT_NULL(idx);
+    // the second packet is cut off so it is left for the next feed
+    ASSERT_EQ(umr_mes_index_feed(asic, idx, words, 25, 0x1000), 18);
+    ASSERT_EQ(idx->no_entries, 1u);
+    ASSERT_EQ(umr_mes_index_feed(asic, idx, &words[18], 32, 0x1000 + 18 * 4), 32);
+    ASSERT_EQ(idx->no_entries, 3u);
+    ASSERT_STR_EQ(idx->entries[1].name, "MES_SCH_API_REMOVE_QUEUE");
+    ASSERT_EQ(idx->entries[1].addr, 0x1000u + 18 * 4);
+    ASSERT_EQ(idx->entries[1].queue_id, 2u);
+
+    x = umr_mes_index_find_doorbell(idx, 0x100);
+    ASSERT_EQ(x, 0u);
+    x = idx->entries[x].next_doorbell;
+    ASSERT_EQ(x, 1u);
+    ASSERT_EQ(idx->entries[x].next_doorbell, UMR_MES_INDEX_NONE);
+    x = umr_mes_index_find_gang(idx, 0x2000);
+    ASSERT_EQ(idx->entries[x].next_gang, 2u);
+    ASSERT_EQ(umr_mes_index_find_doorbell(idx, 0x300), UMR_MES_INDEX_NONE);
+    umr_mes_index_free(idx);
+    return TEST_SUCCESS;
+}
+
+// only the rptr..wptr span is returned, in order across the end of the ring
+enum TEST_RESULT test_ring_window_navi(struct umr_asic* asic)
+{
+    struct umr_test_harness *th = asic->reg_funcs.data;
+    uint32_t ring[3 + 8] = { 14, 2, 2, 100, 101, 102, 103, 104, 105, 106, 107 };
+    uint32_t ptrs[3], ringsize, nwords, *words;
+
+    // the harness frees the ring values
+    free(th->ring.values);
+    th->ring.values = malloc(sizeof ring);
+    ASSERT_NOT_NULL(th->ring.values);
+    memcpy(th->ring.values, ring, sizeof ring);
+    th->ring.no_values = 3 + 8;
+    asic->options.test_log = 1;
+
+    ASSERT_SUCCESS(umr_read_ring_header(asic, "gfx", ptrs, &ringsize));
+    ASSERT_EQ(ringsize, 32u);
+    ASSERT_EQ(ptrs[0], 14u);
+    ASSERT_EQ(ptrs[1], 2u);
+
+    words = umr_read_ring_window(asic, "gfx", ptrs[0], ptrs[1], &nwords);
+    ASSERT_NOT_NULL(words);
+    ASSERT_EQ(nwords, 4u);
+    ASSERT_EQ(words[0], 106u);
+    ASSERT_EQ(words[1], 107u);
+    ASSERT_EQ(words[2], 100u);
+    ASSERT_EQ(words[3], 101u);
+
+    words = umr_read_ring_window(asic, "gfx", 1, 3, &nwords);
+    ASSERT_NOT_NULL(words);
+    ASSERT_EQ(nwords, 2u);
+    ASSERT_EQ(words[0], 101u);
+
+    umr_close_ring_handles(asic);
+    asic->options.test_log = 0;
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_pm4_reg_pairs_navi(struct umr_asic* asic)
+{
+    struct umr_reg *lo = umr_find_reg_data_by_ip_by_instance(asic, "gfx", -1, "mmCOMPUTE_PGM_LO");
+    struct umr_shader_reg_pair *head = NULL, *r;
+    struct umr_pm4_stream *ps, *q;
+    struct umr_shaders_pgm *pgm[3];
+    int n = 0;
+
+    ASSERT_NOT_NULL(lo);
+    ASSERT_EQ(lo->addr >= 0x2C00, 1);
+    uint32_t stream[] = {
+        0xC0027600, lo->addr - 0x2C00, 0x1000, 0,  // SET_SH_REG COMPUTE_PGM_LO/HI
+        0xC0027600, lo->addr - 0x2C00, 0x1000, 0,  // same registers again
+        0xC0031500, 1, 1, 1, 0,                     // DISPATCH_DIRECT
+        0xC0031500, 1, 1, 1, 0,                     // no writes in between
+        0xC0016900, 0x1, 5,                         // SET_CONTEXT_REG
+        0xC0031500, 1, 1, 1, 0,
+    };
+
+    asic->options.no_follow_shader = 1;
+    asic->options.shader_enable.enable_comp_shader = 1;
+    ps = umr_pm4_decode_stream(asic, -1, 0, 0, stream, sizeof stream / 4, &head, -1);
+    ASSERT_NOT_NULL(ps);
+
+    // repeated writes update the existing pair
+    for (r = head; r; r = r->next)
+        ++n;
+    ASSERT_EQ(n, 3);
+
+    n = 0;
+    for (q = ps; q; q = q->next)
+        if (q->shader)
+            pgm[n++] = q->shader;
+    ASSERT_EQ(n, 3);
+    ASSERT_EQ(pgm[0]->addr, 0x100000ULL);
+
+    // dispatches without register writes in between share one copy
+    ASSERT_EQ(pgm[0]->regs, pgm[1]->regs);
+    ASSERT_EQ(pgm[1]->regs != pgm[2]->regs, 1);
+    ASSERT_EQ(pgm[0]->regs->used, 1);
+
+    umr_free_pm4_stream(ps);
+    umr_free_shader_reg_pairs(head);
+    asic->options.no_follow_shader = 0;
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_packet_arena_navi(struct umr_asic* asic)
+{
+    struct umr_packet_stream *str;
+    struct umr_pm4_stream *ps;
+    uint32_t *words, n;
+
+    // enough NOPs to spill out of the first arena chunk
+    words = calloc(2 * 8192, sizeof *words);
+    ASSERT_NOT_NULL(words);
+    for (n = 0; n < 8192; n++) {
+        words[2 * n] = 0xC0001000;
+        words[2 * n + 1] = n;
+    }
+
+    str = umr_packet_decode_buffer(asic, NULL, 0, 0, words, 2 * 8192, UMR_RING_PM4, NULL);
+    free(words);
+    ASSERT_NOT_NULL(str);
+    ASSERT_NOT_NULL(str->arena);
+    ASSERT_EQ(asic->packet_arena, NULL);
+
+    n = 0;
+    for (ps = str->stream.pm4; ps; ps = ps->next) {
+        ASSERT_EQ(ps->opcode, 0x10u);
+        ASSERT_EQ(ps->words[0], n);
+        ++n;
+    }
+    ASSERT_EQ(n, 8192u);
+
+    umr_packet_free(str);
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_dword_scan_navi(struct umr_asic* asic)
+{
+    static const uint32_t ends[] = { 0xbf810000, 0xbf9f0000, 0xbfb00000 };
+    uint32_t words[64], x;
+    struct umr_packet_index *idx;
+
+    // odd lengths and offsets so the vector loops and their tails both match
+    for (x = 0; x < 64; x++)
+        words[x] = 0xFFFF1000;
+    words[37] = 0xbfb00000;
+    words[50] = 0xbf810000;
+    ASSERT_EQ(umr_dword_find(words, 64, ends, 3), 37u);
+    ASSERT_EQ(umr_dword_find(&words[38], 26, ends, 3), 12u);
+    ASSERT_EQ(umr_dword_find(words, 37, ends, 3), 37u);
+    ASSERT_EQ(umr_dword_span(&words[1], 63, 0xFFFF1000), 36u);
+    ASSERT_EQ(umr_dword_span(&words[51], 13, 0xFFFF1000), 13u);
+    ASSERT_EQ(umr_dword_count(&words[3], 61, 0xFFFF1000), 59u);
+
+    // a run of ring padding is one entry of the index
+    words[0] = 0xC0001000;
+    words[1] = 0x0;
+    words[37] = 0xC0016900;
+    words[38] = 0x1;
+    words[39] = 0x5;
+    idx = umr_packet_index_buffer(asic, words, 40, UMR_RING_PM4);
+    ASSERT_NOT_NULL(idx);
+    ASSERT_EQ(idx->no_entries, 3u);
+    ASSERT_EQ(idx->entries[1].offset, 2u);
+    ASSERT_EQ(idx->entries[1].nwords, 35u);
+    ASSERT_EQ(idx->entries[2].offset, 37u);
+    umr_packet_index_free(idx);
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_aql_view_navi(struct umr_asic* asic)
+{
+    uint32_t words[4 * 16], slot = 0;
+    struct umr_aql_view view;
+
+    (void)asic;
+    // INVALID, KERNEL_DISPATCH, INVALID, BARRIER_AND
+    memset(words, 0, sizeof words);
+    words[0] = 0x1;
+    words[16] = 0x00030102;                 // 3 dimensions, barrier
+    words[17] = (4 << 16) | 64;             // workgroup 64x4x1
+    words[18] = 1;
+    words[19] = 1024;                       // grid 1024x16x1
+    words[20] = 16;
+    words[21] = 1;
+    words[24] = 0x1000;                     // kernel_object
+    words[25] = 0x7f;
+    words[30] = 0x2000;                     // completion_signal
+    words[32] = 0x1;
+    words[48] = 0x3;
+    words[62] = 0x3000;
+
+    ASSERT_EQ(umr_aql_view_next(words, 64, &slot, UMR_AQL_VIEW_ACTIVE, &view), 1);
+    ASSERT_EQ(view.slot, 1u);
+    ASSERT_EQ(view.words, &words[16]);
+    ASSERT_EQ(view.type, 2);
+    ASSERT_EQ(view.barrier, 1);
+    ASSERT_EQ(view.dispatch.setup_dimensions, 3);
+    ASSERT_EQ(view.dispatch.workgroup_size[1], 4);
+    ASSERT_EQ(view.dispatch.grid_size[1], 16u);
+    ASSERT_EQ(view.dispatch.kernel_object, 0x7f00001000ULL);
+    ASSERT_EQ(view.completion_signal, 0x2000u);
+    ASSERT_EQ(umr_aql_view_next(words, 64, &slot, UMR_AQL_VIEW_ACTIVE, &view), 1);
+    ASSERT_EQ(view.slot, 3u);
+    ASSERT_EQ(view.completion_signal, 0x3000u);
+    ASSERT_EQ(umr_aql_view_next(words, 64, &slot, UMR_AQL_VIEW_ACTIVE, &view), 0);
+
+    // without the filter every slot is a packet, a partial one is not
+    slot = 0;
+    ASSERT_EQ(umr_aql_view_next(words, 60, &slot, 0, &view), 1);
+    ASSERT_EQ(view.type, 1);
+    ASSERT_EQ(umr_aql_view_next(words, 60, &slot, 0, &view), 1);
+    ASSERT_EQ(umr_aql_view_next(words, 60, &slot, 0, &view), 1);
+    ASSERT_EQ(umr_aql_view_next(words, 60, &slot, 0, &view), 0);
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_sdma_framing_navi(struct umr_asic* asic)
+{
+    uint32_t words[] = {
+        0x2, 0x1000, 0, 2, 7, 8, 9,                 // WRITE LINEAR, 3 dwords
+        0x08000001, 64, 0, 1, 2, 3, 4, 5, 6,        // COPY LINEAR BROADCAST
+        0x04000101, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // COPY TILED (F2F), NV size
+        0x00020000, 0, 0,                           // NOP with 2 dwords
+        0x5, 0x2000, 0, 1,                          // FENCE
+    };
+    static const uint32_t sizes[] = { 6, 8, 15, 2, 3 };
+    struct umr_sdma_stream *ss, *p;
+    int n = 0;
+
+    asic->options.no_follow_ib = 1;
+    ss = umr_sdma_decode_stream(asic, NULL, -1, 0, 0, words, sizeof(words) / 4, 0);
+    ASSERT_NOT_NULL(ss);
+    for (p = ss; p; p = p->next) {
+        ASSERT_EQ(n < 5, 1);
+        ASSERT_EQ(p->nwords, sizes[n]);
+        ++n;
+    }
+    ASSERT_EQ(n, 5);
+    umr_free_sdma_stream(ss);
+
+    // an unknown sub-opcode of a known opcode stops the stream
+    words[0] = 0x0F01;
+    ASSERT_EQ(umr_sdma_decode_stream(asic, NULL, -1, 0, 0, words, sizeof(words) / 4, 0) == NULL, 1);
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_decode_session_navi(struct umr_asic* asic)
+{
+    struct umr_decode_session *sess;
+    struct umr_packet_stream *str;
+    struct umr_packet_arena *arena = NULL;
+    struct umr_pm4_stream *ps;
+    uint32_t words[2 * 16], n, round;
+
+    for (n = 0; n < 16; n++) {
+        words[2 * n] = 0xC0001000;
+        words[2 * n + 1] = n;
+    }
+
+    sess = umr_decode_session_create(asic, NULL, UMR_RING_PM4, UMR_PACKET_IP_VERSION_AUTO, UMR_DECODE_SESSION_KEEP);
+    ASSERT_NOT_NULL(sess);
+    // the session holds the VM context
+    ASSERT_EQ(asic->vm_context.depth, 1);
+
+    for (round = 0; round < 3; round++) {
+        str = umr_decode_session_buffer(sess, 0, 0, words, 2 * 16, NULL);
+        ASSERT_NOT_NULL(str);
+        // the arena of the released stream is reused
+        if (round)
+            ASSERT_EQ(str->arena == arena, 1);
+        arena = str->arena;
+        n = 0;
+        for (ps = str->stream.pm4; ps; ps = ps->next) {
+            ASSERT_EQ(ps->opcode, 0x10u);
+            ASSERT_EQ(ps->words[0], n);
+            ASSERT_EQ(ps->shader == NULL, 1);
+            ++n;
+        }
+        ASSERT_EQ(n, 16u);
+        umr_decode_session_release(sess, str);
+    }
+    ASSERT_EQ(asic->decode_session == NULL, 1);
+
+    umr_decode_session_invalidate(sess);
+    umr_decode_session_free(sess);
+    ASSERT_EQ(asic->vm_context.depth, 0);
+    return TEST_SUCCESS;
+}
+
+static int count_kept(struct umr_pm4_stream *ps, uint32_t *opcodes)
+{
+    struct umr_pm4_stream *prev = NULL;
+    int n = 0;
+
+    for (; ps; prev = ps, ps = ps->next) {
+        if (ps->prev != prev)
+            return -1;
+        opcodes[n++] = ps->opcode;
+    }
+    return n;
+}
+
+enum TEST_RESULT test_packet_filter_navi(struct umr_asic* asic)
+{
+    struct umr_reg *lo = umr_find_reg_data_by_ip_by_instance(asic, "gfx", -1, "mmCOMPUTE_PGM_LO");
+    struct umr_packet_filter f;
+    struct umr_packet_stream *str;
+    struct umr_pm4_stream *ps;
+    uint32_t ops[8];
+
+    ASSERT_NOT_NULL(lo);
+    uint32_t stream[] = {
+        0xC0001000, 0,                              // NOP
+        0xC0027600, lo->addr - 0x2C00, 0x1000, 0,  // SET_SH_REG COMPUTE_PGM_LO/HI
+        0xC0031500, 1, 1, 1, 0,                     // DISPATCH_DIRECT, shader at 0x100000
+        0xC0016900, 0x10, 5,                        // SET_CONTEXT_REG 0xA010
+        0xC0033700, 5 << 8, 0x2000, 0, 7,           // WRITE_DATA to memory at 0x2000
+    };
+
+    asic->options.no_follow_shader = 1;
+    asic->options.shader_enable.enable_comp_shader = 1;
+
+    ASSERT_EQ(umr_packet_filter_parse(asic, "op=dispatch_direct", &f), 0);
+    asic->packet_filter = &f;
+    ps = umr_pm4_decode_stream(asic, -1, 0, 0, stream, sizeof stream / 4, NULL, -1);
+    ASSERT_EQ(count_kept(ps, ops), 1);
+    ASSERT_EQ(ops[0], 0x15u);
+    ASSERT_NOT_NULL(ps->shader);
+    umr_free_pm4_stream(ps);
+
+    // register range by name, a pair of SET_SH_REG opcodes
+    ASSERT_EQ(umr_packet_filter_parse(asic, "op=SET_SH_REG,op=PKT3_SET_CONTEXT_REG,reg=mmCOMPUTE_PGM_LO", &f), 0);
+    ps = umr_pm4_decode_stream(asic, -1, 0, 0, stream, sizeof stream / 4, NULL, -1);
+    ASSERT_EQ(count_kept(ps, ops), 1);
+    ASSERT_EQ(ops[0], 0x76u);
+    umr_free_pm4_stream(ps);
+
+    ASSERT_EQ(umr_packet_filter_parse(asic, "reg=0xA000-0xAFFF", &f), 0);
+    ps = umr_pm4_decode_stream(asic, -1, 0, 0, stream, sizeof stream / 4, NULL, -1);
+    ASSERT_EQ(count_kept(ps, ops), 1);
+    ASSERT_EQ(ops[0], 0x69u);
+    umr_free_pm4_stream(ps);
+
+    // memory written and shader code, decoded in an arena
+    ASSERT_EQ(umr_packet_filter_parse(asic, "va=2000-100000", &f), 0);
+    str = umr_packet_decode_buffer(asic, NULL, 0, 0, stream, sizeof stream / 4, UMR_RING_PM4, NULL);
+    ASSERT_NOT_NULL(str);
+    ASSERT_EQ(count_kept(str->stream.pm4, ops), 2);
+    ASSERT_EQ(ops[0], 0x15u);
+    ASSERT_EQ(ops[1], 0x37u);
+    umr_packet_free(str);
+
+    // nothing is submitted in VMID 3
+    ASSERT_EQ(umr_packet_filter_parse(asic, "vmid=3", &f), 0);
+    ASSERT_EQ(umr_packet_filter_ib_pruned(&f, 0), 1);
+    ASSERT_EQ(umr_packet_filter_ib_pruned(&f, 3), 0);
+    ps = umr_pm4_decode_stream(asic, -1, 0, 0, stream, sizeof stream / 4, NULL, -1);
+    ASSERT_EQ(ps, NULL);
+
+    ASSERT_EQ(umr_packet_filter_parse(asic, "op=NOT_AN_OPCODE", &f), -1);
+    ASSERT_EQ(umr_packet_filter_parse(asic, "vmid", &f), -1);
+
+    asic->packet_filter = NULL;
+    ps = umr_pm4_decode_stream(asic, -1, 0, 0, stream, sizeof stream / 4, NULL, -1);
+    ASSERT_EQ(count_kept(ps, ops), 5);
+    umr_free_pm4_stream(ps);
+    asic->options.no_follow_shader = 0;
+    return TEST_SUCCESS;
+}
+
+DEFINE_TESTS(packet_tests)
+TEST(test_packet_log_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_packet_index_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_ring_capture_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_packet_feed_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_mes_index_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_ring_window_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_pm4_reg_pairs_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_packet_arena_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_dword_scan_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_aql_view_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_sdma_framing_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_decode_session_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_packet_filter_navi, "navi_reg_only.envdef", "navi10"),
+END_TESTS(packet_tests);
@@ -1,10 +1,20 @@
 #include "test_framework.h"
+#include "umr_rumr.h"
+#include <stdarg.h>
+
+#if COMMANDS_TEST
 #include "parson.h"
 #include <stdbool.h>
 
 extern void parse_sysfs_clock_file(char *content, int *min, int *max);
 extern JSON_Value *compare_fence_infos(const char *before, const char *after);
 extern JSON_Array *parse_buffer_object_info(char *content, bool is_vm_info);
+extern uint64_t gem_snapshot_update(struct umr_asic *asic, JSON_Array *apps, bool delta, uint64_t *base);
+extern void response_cache_drop(const char *command);
+extern bool response_cache_lookup(const char *key, const char *etag, JSON_Value **answer,
+                                  void **raw_data, unsigned *raw_data_size, char *out_etag);
+extern void response_cache_store(const char *command, const char *key, JSON_Value *answer,
+                                 void *raw_data, unsigned raw_data_size, int ttl_ms, char *etag);
 extern JSON_Array *parse_kms_framebuffer_sysfs_file(struct umr_asic *asic, const char *content);
 extern JSON_Object *parse_kms_state_sysfs_file(const char *content);
 extern JSON_Object *parse_pp_features_sysfs_file(const char *content);
@@ -108,6 +118,96 @@ static enum TEST_RESULT test_parse_buffer_object_info(__attribute__((unused)) st
     return TEST_SUCCESS;
 }
 
+static enum TEST_RESULT test_buffer_object_info_delta(struct umr_asic* asic)
+{
+    char *before = strdup(
+        "pid    47113 command firefox:\n"
+        "\t\t\t\t0x00000001:         4096 byte  GTT CPU_ACCESS_REQUIRED\n"
+        "\t\t\t\t0x00000002:      2097152 byte VRAM VISIBLE pin count 1\n"
+        "\t\t\t\t0x00000003:      2097152 byte VRAM exported as ino:15413\n");
+    char *after = strdup(
+        "pid    47113 command firefox:\n"
+        "\t\t\t\t0x00000001:         4096 byte  GTT CPU_ACCESS_REQUIRED\n"
+        "\t\t\t\t0x00000003:      4194304 byte VRAM exported as ino:15413\n"
+        "\t\t\t\t0x00000004:         4096 byte  GTT\n");
+    uint64_t base, generation;
+
+    JSON_Array *out = parse_buffer_object_info(before, false);
+    JSON_Object *bo = json_array_get_object(json_object_get_array(json_array_get_object(
+        json_object_get_array(json_array_get_object(out, 0), "clients"), 0), "bos"), 1);
+    JSON_Object *attr = json_object_get_object(bo, "attributes");
+    ASSERT_EQ(json_object_get_number(attr, "VRAM"), 1);
+    ASSERT_EQ(json_object_get_number(attr, "VRAM VISIBLE"), 1);
+    ASSERT_EQ(json_object_get_number(attr, "pin count"), 1);
+
+    /* The first snapshot is complete. */
+    generation = gem_snapshot_update(asic, out, true, &base);
+    ASSERT_EQ(base, 0);
+    json_value_free(json_array_get_wrapping_value(out));
+
+    out = parse_buffer_object_info(after, false);
+    ASSERT_EQ(gem_snapshot_update(asic, out, true, &base), generation + 1);
+    ASSERT_EQ(base, generation);
+
+    JSON_Object *client = json_array_get_object(json_object_get_array(json_array_get_object(out, 0), "clients"), 0);
+    JSON_Array *bos = json_object_get_array(client, "bos");
+    JSON_Array *removed = json_object_get_array(client, "removed");
+    ASSERT_EQ(json_array_get_count(bos), 2);
+    ASSERT_EQ(json_object_get_number(json_array_get_object(bos, 0), "handle"), 3);
+    ASSERT_EQ(json_object_get_number(json_array_get_object(bos, 1), "handle"), 4);
+    ASSERT_EQ(json_array_get_count(removed), 1);
+    ASSERT_EQ(json_array_get_number(removed, 0), 2);
+    json_value_free(json_array_get_wrapping_value(out));
+    free(before);
+    free(after);
+    return TEST_SUCCESS;
+}
+
+static enum TEST_RESULT test_response_cache(__attribute__((unused)) struct umr_asic* asic)
+{
+    const char *key = "{\"command\":\"enumerate\"}";
+    JSON_Value *answer = json_parse_string("[{\"name\":\"navi10\"}]"), *cached;
+    char etag[17], etag2[17], etag3[17];
+    void *raw_data = NULL;
+    unsigned raw_data_size = 0;
+
+    ASSERT_EQ(response_cache_lookup(key, NULL, &cached, &raw_data, &raw_data_size, etag2), false);
+    response_cache_store("enumerate", key, answer, (void*)"dump", 4, 60000, etag);
+
+    /* A client without the answer gets a copy of it and its raw data. */
+    ASSERT_EQ(response_cache_lookup(key, NULL, &cached, &raw_data, &raw_data_size, etag2), true);
+    ASSERT_EQ(strcmp(etag, etag2), 0);
+    ASSERT_EQ(json_value_equals(answer, cached), 1);
+    ASSERT_EQ(raw_data_size, 4);
+    ASSERT_EQ(memcmp(raw_data, "dump", 4), 0);
+    json_value_free(cached);
+    free(raw_data);
+
+    /* A client with the same tag gets nothing. */
+    raw_data = NULL;
+    raw_data_size = 0;
+    ASSERT_EQ(response_cache_lookup(key, etag, &cached, &raw_data, &raw_data_size, etag2), true);
+    ASSERT_EQ(cached == NULL, 1);
+    ASSERT_EQ(raw_data == NULL, 1);
+
+    /* The tag follows the content. */
+    response_cache_store("enumerate", key, answer, (void*)"dump", 4, 60000, etag3);
+    ASSERT_EQ(strcmp(etag, etag3), 0);
+    response_cache_store("enumerate", key, answer, (void*)"dumq", 4, 60000, etag3);
+    ASSERT_EQ(strcmp(etag, etag3) != 0, 1);
+
+    response_cache_drop("enumerate");
+    ASSERT_EQ(response_cache_lookup(key, NULL, &cached, &raw_data, &raw_data_size, etag2), false);
+
+    /* Expired answers aren't used. */
+    response_cache_store("enumerate", key, answer, NULL, 0, 0, etag);
+    ASSERT_EQ(response_cache_lookup(key, NULL, &cached, &raw_data, &raw_data_size, etag2), false);
+    response_cache_drop("enumerate");
+
+    json_value_free(answer);
+    return TEST_SUCCESS;
+}
+
 static enum TEST_RESULT test_parse_sysfs_framebuffer(__attribute__((unused)) struct umr_asic* asic)
 {
     const char *content =
@@ -428,13 +528,196 @@ static enum TEST_RESULT test_parse_sysfs_pp_features2(__attribute__((unused)) st
 
     return TEST_SUCCESS;
 }
+#endif
+
+static enum TEST_RESULT test_rumr_stats_navi(struct umr_asic* asic)
+{
+    struct rumr_stats *stats = calloc(1, sizeof *stats);
+    struct rumr_op_summary sum[RUMR_STATS_OPS];
+    int i;
+
+    (void)asic;
+    ASSERT_NOT_NULL(stats);
+
+    // 98 requests at 10us, one at 1ms and one at 10ms
+    for (i = 0; i < 98; i++)
+        rumr_stats_add(stats, RUMR_OP_REG_ACCESS, 10000, 16, 12);
+    rumr_stats_add(stats, RUMR_OP_REG_ACCESS, 1000000, 16, 12);
+    rumr_stats_add(stats, RUMR_OP_REG_ACCESS, 10000000, 16, 12);
+    rumr_stats_add(stats, 1000, 1, 1, 1); // not an opcode, ignored
+    rumr_stats_summarize(stats, sum);
+    free(stats);
+
+    ASSERT_EQ(sum[RUMR_OP_REG_ACCESS].count, 100);
+    ASSERT_EQ(sum[RUMR_OP_REG_ACCESS].bytes_tx, 1600);
+    ASSERT_EQ(sum[RUMR_OP_REG_ACCESS].bytes_rx, 1200);
+    ASSERT_EQ(sum[RUMR_OP_REG_ACCESS].ns, 98 * 10000 + 11000000);
+    // percentiles are within a quarter of a power of two
+    ASSERT_EQ(sum[RUMR_OP_REG_ACCESS].p50_ns >= 8192 && sum[RUMR_OP_REG_ACCESS].p50_ns < 12288, 1);
+    ASSERT_EQ(sum[RUMR_OP_REG_ACCESS].p99_ns >= 786432 && sum[RUMR_OP_REG_ACCESS].p99_ns < 1048576, 1);
+    ASSERT_EQ(sum[RUMR_OP_MEM_ACCESS].count, 0);
+    ASSERT_STR_EQ(rumr_opcode_name(RUMR_OP_WAVE_SCAN), "wave_scan");
+    ASSERT_STR_EQ(rumr_opcode_name(RUMR_OP_RING_DECODE), "ring_decode");
+    return TEST_SUCCESS;
+}
+
+// a client and a server in the same process, every request the client
+// sends is served right away by rumr_server_loop()
+static struct rumr_server_state *loop_server;
+static struct rumr_buffer *loop_msg;
+
+static int loop_log(const char *fmt, ...)
+{
+    va_list ap;
+    int r;
+
+    va_start(ap, fmt);
+    r = vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    return r;
+}
+
+static int loop_connect(struct rumr_comm_funcs *cf, char *addr)
+{
+    (void)cf; (void)addr;
+    return 0;
+}
+
+static int loop_closeconn(struct rumr_comm_funcs *cf)
+{
+    (void)cf;
+    return 0;
+}
+
+static int loop_tx(struct rumr_comm_funcs *cf, struct rumr_buffer *buf)
+{
+    rumr_buffer_free(loop_msg);
+    loop_msg = rumr_buffer_init();
+    rumr_buffer_add_data(loop_msg, buf->data, buf->woffset);
+    // the client's requests are served before tx returns
+    if (cf->data == NULL)
+        return rumr_server_loop(loop_server) < 0 ? -1 : 0;
+    return 0;
+}
+
+static int loop_rx(struct rumr_comm_funcs *cf, struct rumr_buffer **buf)
+{
+    (void)cf;
+    *buf = loop_msg;
+    loop_msg = NULL;
+    return *buf ? 0 : -1;
+}
+
+static uint32_t ring_decode_words[3 + 16];
+
+static void *ring_decode_read_ring(struct umr_asic *asic, char *ringname, uint32_t *ringsize)
+{
+    uint32_t *data;
+
+    (void)asic;
+    if (strcmp(ringname, "gfx_0.0.0"))
+        return NULL;
+    data = malloc(sizeof ring_decode_words);
+    memcpy(data, ring_decode_words, sizeof ring_decode_words);
+    *ringsize = sizeof ring_decode_words - 12;
+    return data;
+}
+
+static enum TEST_RESULT test_rumr_ring_decode_navi(struct umr_asic* asic)
+{
+    struct umr_reg *lo = umr_find_reg_data_by_ip_by_instance(asic, "gfx", -1, "mmCOMPUTE_PGM_LO");
+    struct umr_read_ring_func saved = asic->ring_func;
+    struct rumr_comm_funcs comm = { 0 };
+    struct rumr_server_state srv = { 0 };
+    struct rumr_client_state cli = { 0 };
+    struct umr_packet_stream *str;
+    struct umr_pm4_stream *ps;
+    int start = -1, stop = -1, r;
+
+    ASSERT_NOT_NULL(lo);
+    uint32_t words[] = {
+        0, 11, 0,                                   // rptr, wptr, dwptr
+        0xC0027600, lo->addr - 0x2C00, 0x1000, 0,  // SET_SH_REG COMPUTE_PGM_LO/HI
+        0xC0031500, 1, 1, 1, 0,                     // DISPATCH_DIRECT
+        0xC0001000, 0x42,                           // NOP
+    };
+    memset(ring_decode_words, 0, sizeof ring_decode_words);
+    memcpy(ring_decode_words, words, sizeof words);
+
+    // the server decodes the ring of the test asic
+    memset(&asic->ring_func, 0, sizeof asic->ring_func);
+    asic->ring_func.read_ring_data = ring_decode_read_ring;
+    asic->options.no_follow_shader = 1;
+    asic->options.shader_enable.enable_comp_shader = 1;
+    comm.connect = loop_connect;
+    comm.tx = loop_tx;
+    comm.rx = loop_rx;
+    comm.closeconn = loop_closeconn;
+    comm.log_msg = loop_log;
+    srv.asic = asic;
+    srv.comm = comm;
+    srv.comm.data = &srv;
+    srv.log_msg = loop_log;
+    srv.serialized_asic = rumr_serialize_asic(asic);
+    ASSERT_NOT_NULL(srv.serialized_asic);
+    srv.serialized_head = rumr_serialized_asic_head(srv.serialized_asic);
+    srv.serialized_hash = rumr_serialized_asic_hash(srv.serialized_asic);
+    loop_server = &srv;
+
+    setenv("UMR_RUMR_CACHE", "", 1);
+    r = rumr_client_connect(&cli, &comm, "loop", &asic->options);
+    unsetenv("UMR_RUMR_CACHE");
+    ASSERT_EQ(r, 0);
+    ASSERT_NOT_NULL(cli.asic->ring_func.decode_ring_pm4);
+
+    str = umr_packet_decode_ring(cli.asic, NULL, "gfx_0.0.0", 0, &start, &stop, UMR_RING_GUESS, NULL);
+    ASSERT_NOT_NULL(str);
+    ASSERT_EQ(start, 0);
+    ASSERT_EQ(stop, 11);
+    ASSERT_EQ(cli.stats->op[RUMR_OP_RING_DECODE].count, 1u);
+    ASSERT_EQ(cli.stats->op[RUMR_OP_RING_ACCESS].count, 0u);
+
+    ps = str->stream.pm4;
+    ASSERT_NOT_NULL(ps);
+    ASSERT_EQ(ps->opcode, 0x76u);
+    ASSERT_EQ(ps->n_words, 3u);
+    ASSERT_EQ(ps->words[1], 0x1000u);
+    ps = ps->next;
+    ASSERT_NOT_NULL(ps);
+    ASSERT_EQ(ps->opcode, 0x15u);
+    ASSERT_EQ(ps->prev, str->stream.pm4);
+    ASSERT_NOT_NULL(ps->shader);
+    ASSERT_EQ(ps->shader->type, 2);
+    ASSERT_EQ(ps->shader->addr, 0x100000ULL);
+    ASSERT_EQ(ps->shader->pm4_packet, ps);
+    ps = ps->next;
+    ASSERT_NOT_NULL(ps);
+    ASSERT_EQ(ps->opcode, 0x10u);
+    ASSERT_EQ(ps->words[0], 0x42u);
+    ASSERT_EQ(ps->next, NULL);
+    umr_packet_free(str);
+
+    rumr_client_close(&cli);
+    rumr_buffer_free(srv.serialized_asic);
+    rumr_buffer_free(loop_msg);
+    loop_msg = NULL;
+    asic->ring_func = saved;
+    asic->options.no_follow_shader = 0;
+    return TEST_SUCCESS;
+}
 
 DEFINE_TESTS(server_tests)
+#if COMMANDS_TEST
 TEST(test_parse_sysfs_clock_file, "navi_reg_only.envdef", "navi10"),
 TEST(test_parse_fence_info, "navi_reg_only.envdef", "navi10"),
 TEST(test_parse_buffer_object_info, "navi_reg_only.envdef", "navi10"),
+TEST(test_buffer_object_info_delta, "navi_reg_only.envdef", "navi10"),
+TEST(test_response_cache, "navi_reg_only.envdef", "navi10"),
 TEST(test_parse_sysfs_framebuffer, "navi_reg_only.envdef", "navi10"),
 TEST(test_parse_sysfs_state, "navi_reg_only.envdef", "navi10"),
 TEST(test_parse_sysfs_pp_features, "navi_reg_only.envdef", "navi10"),
 TEST(test_parse_sysfs_pp_features2, "navi_reg_only.envdef", "navi10"),
+#endif
+TEST(test_rumr_stats_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_rumr_ring_decode_navi, "navi_reg_only.envdef", "navi10"),
 END_TESTS(server_tests);
@@ -0,0 +1,85 @@
+#include "test_framework.h"
+
+// a file stays open and is read again in place, also by the refresh thread
+enum TEST_RESULT test_sysfs_cache_navi(struct umr_asic* asic)
+{
+    char path[] = "/tmp/umr_sysfs_XXXXXX", buf[64];
+    struct timespec ts = { 0, 20000000 };
+    int fd;
+
+    fd = mkstemp(path);
+    ASSERT_EQ(fd >= 0, 1);
+    ASSERT_EQ(pwrite(fd, "123\n", 4, 0), 4);
+
+    ASSERT_EQ(umr_sysfs_read(asic, path, buf, sizeof buf), 4);
+    ASSERT_STR_EQ(buf, "123\n");
+    ASSERT_EQ(pwrite(fd, "456\n", 4, 0), 4);
+    ASSERT_EQ(umr_sysfs_read(asic, path, buf, sizeof buf), 4);
+    ASSERT_STR_EQ(buf, "456\n");
+    // truncated to the buffer
+    ASSERT_EQ(umr_sysfs_read(asic, path, buf, 3), 2);
+    ASSERT_STR_EQ(buf, "45");
+    ASSERT_EQ(umr_sysfs_read(asic, "/tmp/umr_sysfs_missing/x", buf, sizeof buf), -1);
+    ASSERT_STR_EQ(buf, "");
+
+    ASSERT_SUCCESS(umr_sysfs_cache_refresh_start(asic, 1000000));
+    ASSERT_EQ(pwrite(fd, "789\n", 4, 0), 4);
+    nanosleep(&ts, NULL);
+    ASSERT_EQ(umr_sysfs_read(asic, path, buf, sizeof buf), 4);
+    ASSERT_STR_EQ(buf, "789\n");
+
+    umr_sysfs_cache_free(asic);
+    ASSERT_EQ(asic->sysfs_cache == NULL, 1);
+    close(fd);
+    unlink(path);
+    return TEST_SUCCESS;
+}
+
+enum TEST_RESULT test_pp_cache_navi(struct umr_asic* asic)
+{
+    char dir[] = "/tmp/umr_pp_XXXXXX", fname[128];
+    const struct umr_pp_cache *pp, *pp2;
+    struct umr_vbios_info vbios;
+    FILE *f;
+
+    ASSERT_NOT_NULL(mkdtemp(dir));
+    setenv("UMR_PP_CACHE", dir, 1);
+
+    // no table and no driver to ask in the test environment
+    asic->fd.drm = -1;
+    pp = umr_pp_cache_get(asic, 1);
+    ASSERT_NOT_NULL(pp);
+    ASSERT_EQ(pp->have_vbios, 0);
+    pp2 = umr_pp_cache_get(asic, 0);
+    ASSERT_EQ(pp2 == pp, 1);
+
+    // a later process finds the VBIOS info stored under the same hash
+    memset(&vbios, 0, sizeof vbios);
+    strcpy((char *)vbios.name, "TESTBIOS");
+    strcpy((char *)vbios.vbios_pn, "113-TEST");
+    snprintf(fname, sizeof fname, "%s/%016" PRIx64 ".vbios", dir, pp->hash);
+    f = fopen(fname, "wb");
+    ASSERT_NOT_NULL(f);
+    fwrite("UMRPPC01", 1, 8, f);
+    fwrite(&vbios, 1, sizeof vbios, f);
+    fclose(f);
+
+    umr_pp_cache_free(asic);
+    ASSERT_EQ(asic->pp_cache == NULL, 1);
+    pp = umr_pp_cache_get(asic, 1);
+    ASSERT_NOT_NULL(pp);
+    ASSERT_EQ(pp->have_vbios, 1);
+    ASSERT_STR_EQ((const char *)pp->vbios.name, "TESTBIOS");
+    ASSERT_STR_EQ((const char *)pp->vbios.vbios_pn, "113-TEST");
+
+    umr_pp_cache_free(asic);
+    unsetenv("UMR_PP_CACHE");
+    unlink(fname);
+    rmdir(dir);
+    return TEST_SUCCESS;
+}
+
+DEFINE_TESTS(sysfs_tests)
+TEST(test_sysfs_cache_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_pp_cache_navi, "navi_reg_only.envdef", "navi10"),
+END_TESTS(sysfs_tests);
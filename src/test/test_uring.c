@@ -0,0 +1,79 @@
+#include "test_framework.h"
+
+#define URING_THREAD_OPS 600    // more than a ring-full so each submit enters several times
+#define URING_THREAD_ROUNDS 50
+
+struct uring_thread {
+    struct umr_asic *asic;
+    int fd;
+    uint32_t base;              // the file holds base + i at dword i
+    int bad;
+};
+
+static void *uring_thread_run(void *arg)
+{
+    struct uring_thread *t = arg;
+    struct umr_uring_op ops[URING_THREAD_OPS];
+    uint32_t vals[URING_THREAD_OPS];
+    int i, round;
+
+    for (round = 0; round < URING_THREAD_ROUNDS; round++) {
+        for (i = 0; i < URING_THREAD_OPS; i++) {
+            memset(&ops[i], 0, sizeof ops[i]);
+            ops[i].fd = t->fd;
+            ops[i].offset = (uint64_t)i * 4;
+            ops[i].buf = &vals[i];
+            ops[i].len = 4;
+            vals[i] = 0;
+        }
+        if (umr_uring_submit(t->asic, ops, URING_THREAD_OPS))
+            ++t->bad;
+        for (i = 0; i < URING_THREAD_OPS; i++)
+            if (ops[i].res != 4 || vals[i] != t->base + i)
+                ++t->bad;
+    }
+    return NULL;
+}
+
+// two threads submitting on the same ring each get their own completions
+enum TEST_RESULT test_uring_threads_navi(struct umr_asic* asic)
+{
+    char path[2][32] = { "/tmp/umr_uring_XXXXXX", "/tmp/umr_uring_XXXXXX" };
+    struct uring_thread t[2];
+    pthread_t threads[2];
+    uint32_t v;
+    int i, j;
+
+    if (umr_uring_init(asic)) {
+        fprintf(stderr, "[WARNING]: io_uring is not available, %s skipped\n", __func__);
+        return TEST_SUCCESS;
+    }
+    for (i = 0; i < 2; i++) {
+        t[i].asic = asic;
+        t[i].base = (i + 1) * 0x10000000;
+        t[i].bad = 0;
+        t[i].fd = mkstemp(path[i]);
+        ASSERT_EQ(t[i].fd >= 0, 1);
+        for (j = 0; j < URING_THREAD_OPS; j++) {
+            v = t[i].base + j;
+            ASSERT_EQ(pwrite(t[i].fd, &v, 4, j * 4), 4);
+        }
+    }
+
+    for (i = 0; i < 2; i++)
+        ASSERT_EQ(pthread_create(&threads[i], NULL, uring_thread_run, &t[i]), 0);
+    for (i = 0; i < 2; i++)
+        pthread_join(threads[i], NULL);
+
+    umr_uring_fini(asic);
+    for (i = 0; i < 2; i++) {
+        close(t[i].fd);
+        unlink(path[i]);
+        ASSERT_EQ(t[i].bad, 0);
+    }
+    return TEST_SUCCESS;
+}
+
+DEFINE_TESTS(uring_tests)
+TEST(test_uring_threads_navi, "navi_reg_only.envdef", "navi10"),
+END_TESTS(uring_tests);
@@ -1,5 +1,8 @@
 #include "test_framework.h"
 
+// a whole PTB, see test_vm_decoder()
+#define VM_DECODER_TEST_ENTRIES 512
+
 // testing direct VM construction
 enum TEST_RESULT test_can_read_from_vm_memory_direct0(struct umr_asic* asic)
 {
@@ -212,6 +215,594 @@ enum TEST_RESULT test_can_read_from_vm_memory_direct23(struct umr_asic* asic)
 return TEST_SUCCESS;
 }
 
+// count the memory accesses made for a VM read
+static int vm_tlb_accesses;
+static int (*vm_tlb_linear)(struct umr_asic *asic, uint64_t address, uint32_t size, void *data, int write_en);
+static int (*vm_tlb_sram)(struct umr_asic *asic, uint64_t address, uint32_t size, void *data, int write_en);
+
+static int count_linear_vram(struct umr_asic *asic, uint64_t address, uint32_t size, void *data, int write_en)
+{
+    ++vm_tlb_accesses;
+    return vm_tlb_linear(asic, address, size, data, write_en);
+}
+
+static int count_sram(struct umr_asic *asic, uint64_t address, uint32_t size, void *data, int write_en)
+{
+    ++vm_tlb_accesses;
+    return vm_tlb_sram(asic, address, size, data, write_en);
+}
+
+// a second read of a page skips the page walk until the TLB is flushed
+enum TEST_RESULT test_vm_tlb(struct umr_asic* asic)
+{
+    uint64_t read_data = 0;
+    int walk;
+
+    vm_tlb_linear = asic->mem_funcs.access_linear_vram;
+    vm_tlb_sram = asic->mem_funcs.access_sram;
+    asic->mem_funcs.access_linear_vram = count_linear_vram;
+    asic->mem_funcs.access_sram = count_sram;
+
+    vm_tlb_accesses = 0;
+    ASSERT_SUCCESS(umr_read_vram(asic, -1, UMR_GFX_HUB|3, 0x800100400800ULL, sizeof(read_data), &read_data));
+    ASSERT_EQ(read_data, 0x0706050403020100);
+    walk = vm_tlb_accesses;
+    ASSERT_NOT_NULL(asic->vm_tlb);
+
+    vm_tlb_accesses = 0;
+    read_data = 0;
+    ASSERT_SUCCESS(umr_read_vram(asic, -1, UMR_GFX_HUB|3, 0x800100400800ULL, sizeof(read_data), &read_data));
+    ASSERT_EQ(read_data, 0x0706050403020100);
+    ASSERT_EQ(vm_tlb_accesses, 1);
+
+    umr_vm_tlb_flush(asic);
+    vm_tlb_accesses = 0;
+    ASSERT_SUCCESS(umr_read_vram(asic, -1, UMR_GFX_HUB|3, 0x800100400800ULL, sizeof(read_data), &read_data));
+    ASSERT_EQ(vm_tlb_accesses, walk);
+    return TEST_SUCCESS;
+}
+
+// count the register reads made for a VM read
+static int vm_ctx_reads;
+static uint32_t (*vm_ctx_read_reg)(struct umr_asic *asic, uint64_t addr, enum regclass type);
+
+static uint32_t count_read_reg(struct umr_asic *asic, uint64_t addr, enum regclass type)
+{
+    ++vm_ctx_reads;
+    return vm_ctx_read_reg(asic, addr, type);
+}
+
+// the VM registers are read once per operation unless refreshed
+enum TEST_RESULT test_vm_context(struct umr_asic* asic)
+{
+    uint64_t read_data = 0;
+    int first;
+
+    vm_ctx_read_reg = asic->reg_funcs.read_reg;
+    asic->reg_funcs.read_reg = count_read_reg;
+
+    umr_vm_context_begin(asic);
+    vm_ctx_reads = 0;
+    ASSERT_SUCCESS(umr_read_vram(asic, -1, UMR_GFX_HUB|3, 0x800100400800ULL, sizeof(read_data), &read_data));
+    ASSERT_EQ(read_data, 0x0706050403020100);
+    first = vm_ctx_reads;
+    ASSERT_EQ(first > 0, 1);
+
+    // nested operations keep using the same registers
+    umr_vm_context_begin(asic);
+    vm_ctx_reads = 0;
+    read_data = 0;
+    ASSERT_SUCCESS(umr_read_vram(asic, -1, UMR_GFX_HUB|3, 0x800100400800ULL, sizeof(read_data), &read_data));
+    ASSERT_EQ(read_data, 0x0706050403020100);
+    ASSERT_EQ(vm_ctx_reads, 0);
+    umr_vm_context_end(asic);
+
+    umr_vm_context_refresh(asic);
+    vm_ctx_reads = 0;
+    ASSERT_SUCCESS(umr_read_vram(asic, -1, UMR_GFX_HUB|3, 0x800100400800ULL, sizeof(read_data), &read_data));
+    ASSERT_EQ(vm_ctx_reads, first);
+    umr_vm_context_end(asic);
+
+    // outside of an operation every access reads them
+    vm_ctx_reads = 0;
+    ASSERT_SUCCESS(umr_read_vram(asic, -1, UMR_GFX_HUB|3, 0x800100400800ULL, sizeof(read_data), &read_data));
+    ASSERT_EQ(vm_ctx_reads, first);
+    ASSERT_EQ(read_data, 0x0706050403020100);
+    return TEST_SUCCESS;
+}
+
+// page tables of vm_tlb_test.envdef plus a second page, served without
+// the harness so whole page table blocks can be read
+static const struct { uint64_t addr, value; } pt_mem[] = {
+    { 0x7fbe9800, 0x00000000bfbe8001ULL },  // PDE2
+    { 0x7fbe8020, 0x00000000bfbe7001ULL },  // PDE1
+    { 0x7fbe7010, 0x00400000bda004b1ULL },  // PTE 0x800100400000
+    { 0x7fbe7018, 0x00400000bda014b1ULL },  // PTE 0x800100401000
+    { 0x7da00800, 0x0706050403020100ULL },
+    { 0x7da01800, 0x0f0e0d0c0b0a0908ULL },
+    { 0x7dbffff8, 0x1716151413121110ULL },  // end of the first 2MiB page
+    { 0x7da01000, 0x1f1e1d1c1b1a1918ULL },  // start of the second
+};
+static int pt_mem_reads;
+
+static int pt_mem_access(struct umr_asic *asic, uint64_t address, uint32_t size, void *data, int write_en)
+{
+    unsigned x;
+
+    (void)asic;
+    if (write_en)
+        return -1;
+    ++pt_mem_reads;
+    memset(data, 0, size);
+    for (x = 0; x < sizeof(pt_mem) / sizeof(pt_mem[0]); x++)
+        if (pt_mem[x].addr >= address && pt_mem[x].addr + 8 <= address + size)
+            memcpy((uint8_t *)data + (pt_mem[x].addr - address), &pt_mem[x].value, 8);
+    return 0;
+}
+
+// walking a neighbouring page reads the page table blocks from the cache
+enum TEST_RESULT test_vm_pt_cache(struct umr_asic* asic)
+{
+    uint64_t read_data = 0;
+
+    asic->mem_funcs.access_linear_vram = pt_mem_access;
+    asic->mem_funcs.no_readahead = 0;
+    umr_vm_context_begin(asic);
+
+    pt_mem_reads = 0;
+    ASSERT_SUCCESS(umr_read_vram(asic, -1, UMR_GFX_HUB|3, 0x800100400800ULL, sizeof(read_data), &read_data));
+    ASSERT_EQ(read_data, 0x0706050403020100);
+    ASSERT_EQ(pt_mem_reads, 4);
+
+    pt_mem_reads = 0;
+    ASSERT_SUCCESS(umr_read_vram(asic, -1, UMR_GFX_HUB|3, 0x800100401800ULL, sizeof(read_data), &read_data));
+    ASSERT_EQ(read_data, 0x0f0e0d0c0b0a0908);
+    ASSERT_EQ(pt_mem_reads, 1);
+
+    umr_vm_context_end(asic);
+    return TEST_SUCCESS;
+}
+
+// two pages next to each other in VRAM are read with one access
+enum TEST_RESULT test_vm_contiguous_run(struct umr_asic* asic)
+{
+    uint8_t buf[0x1008];
+    uint64_t v;
+
+    asic->mem_funcs.access_linear_vram = pt_mem_access;
+    asic->mem_funcs.no_readahead = 0;
+
+    pt_mem_reads = 0;
+    ASSERT_SUCCESS(umr_read_vram(asic, -1, UMR_GFX_HUB|3, 0x800100400800ULL, sizeof(buf), buf));
+    // three page table blocks and the data
+    ASSERT_EQ(pt_mem_reads, 4);
+    memcpy(&v, &buf[0], 8);
+    ASSERT_EQ(v, 0x0706050403020100);
+    memcpy(&v, &buf[0x1000], 8);
+    ASSERT_EQ(v, 0x0f0e0d0c0b0a0908);
+    return TEST_SUCCESS;
+}
+
+// pages that are not contiguous are queued and read at the end
+enum TEST_RESULT test_vm_queued_runs(struct umr_asic* asic)
+{
+    uint64_t buf[2];
+
+    asic->mem_funcs.access_linear_vram = pt_mem_access;
+    asic->mem_funcs.no_readahead = 0;
+
+    pt_mem_reads = 0;
+    ASSERT_SUCCESS(umr_read_vram(asic, -1, UMR_GFX_HUB|3, 0x8001005FFFF8ULL, sizeof(buf), buf));
+    // three page table blocks and one read per run
+    ASSERT_EQ(pt_mem_reads, 5);
+    ASSERT_EQ(buf[0], 0x1716151413121110ULL);
+    ASSERT_EQ(buf[1], 0x1f1e1d1c1b1a1918ULL);
+    return TEST_SUCCESS;
+}
+
+// every valid entry of the tables is found with one read per block
+enum TEST_RESULT test_vm_map(struct umr_asic* asic)
+{
+    struct umr_vm_mapping *maps;
+    uint64_t no_maps;
+
+    asic->mem_funcs.access_linear_vram = pt_mem_access;
+    asic->mem_funcs.no_readahead = 0;
+
+    pt_mem_reads = 0;
+    ASSERT_SUCCESS(umr_vm_map(asic, -1, UMR_GFX_HUB|3, &maps, &no_maps));
+    // one read per page table block
+    // one read per page table block
+    ASSERT_EQ(pt_mem_reads, 3);
+    // the PDE0 entries have the P bit so each maps 2MiB
+    ASSERT_EQ(no_maps, 2);
+    ASSERT_EQ(maps[0].va, 0x800100400000ULL);
+    ASSERT_EQ(maps[0].size, 0x200000);
+    ASSERT_EQ(maps[0].pa, 0x7da00000);
+    ASSERT_EQ(maps[0].system, 0);
+    // not physically contiguous with the first so not merged
+    ASSERT_EQ(maps[1].va, 0x800100600000ULL);
+    ASSERT_EQ(maps[1].pa, 0x7da01000);
+    free(maps);
+    return TEST_SUCCESS;
+}
+
+// the decoders of each generation agree with their batch variants
+enum TEST_RESULT test_vm_decoder(struct umr_asic* asic)
+{
+    const int gens[][2] = { { 9, 0 }, { 10, 1 }, { 10, 3 }, { 11, 0 }, { 12, 0 } };
+    uint64_t e[VM_DECODER_TEST_ENTRIES];
+    pte_fields_t pte[VM_DECODER_TEST_ENTRIES], p;
+    pde_fields_t pde[VM_DECODER_TEST_ENTRIES], d;
+    struct umr_vm_decoder dec;
+    int g, x;
+
+    for (x = 0; x < VM_DECODER_TEST_ENTRIES; x++)
+        e[x] = 0x9E3779B97F4A7C15ULL * (x + 1);
+
+    for (g = 0; g < (int)(sizeof gens / sizeof gens[0]); g++) {
+        umr_vm_pte_decoder(gens[g][0], gens[g][1], &dec);
+        umr_vm_pde_decoder(gens[g][0], gens[g][1], &dec);
+        dec.pte_batch(e, pte, VM_DECODER_TEST_ENTRIES);
+        dec.pde_batch(e, pde, VM_DECODER_TEST_ENTRIES);
+        for (x = 0; x < VM_DECODER_TEST_ENTRIES; x++) {
+            p = dec.pte(e[x]);
+            d = dec.pde(e[x]);
+            ASSERT_EQ(memcmp(&p, &pte[x], sizeof p), 0);
+            ASSERT_EQ(memcmp(&d, &pde[x], sizeof d), 0);
+        }
+    }
+
+    // a gfx9 PTE with the further bit is a PDE with a 64 byte aligned base
+    umr_vm_pte_decoder(9, 0, &dec);
+    p = dec.pte((1ULL << 56) | (3ULL << 57) | 0x12345FC1ULL);
+    ASSERT_EQ(p.further, 1);
+    ASSERT_EQ(p.mtype, 3);
+    ASSERT_EQ(p.page_base_addr, 0x12345FC0ULL);
+    ASSERT_EQ(p.valid, 1);
+
+    // gfx12 flags PTEs with bit 63 and moved mtype and the fragment size
+    umr_vm_pte_decoder(12, 0, &dec);
+    umr_vm_pde_decoder(12, 0, &dec);
+    p = dec.pte((1ULL << 63) | (2ULL << 54) | 0x12345FC1ULL);
+    ASSERT_EQ(p.pte, 1);
+    ASSERT_EQ(p.mtype, 2);
+    ASSERT_EQ(p.page_base_addr, 0x12345000ULL);
+    d = dec.pde((1ULL << 63) | (9ULL << 58) | 0x12345FC1ULL);
+    ASSERT_EQ(d.pte, 1);
+    ASSERT_EQ(d.frag_size, 9);
+    ASSERT_EQ(d.pte_base_addr, 0x12345FC0ULL);
+
+    // and the device's own generation is the one looked up per entry
+    ASSERT_SUCCESS(umr_vm_get_decoder(asic, &dec));
+    p = dec.pte(e[7]);
+    pte[0] = umr_decode_pte_entry(asic, e[7]);
+    ASSERT_EQ(memcmp(&p, &pte[0], sizeof p), 0);
+    return TEST_SUCCESS;
+}
+
+// a batch of VAs is walked with one read per page table block
+enum TEST_RESULT test_vm_translate(struct umr_asic* asic)
+{
+    const uint64_t va[] = { 0x800100400800ULL, 0x800100401800ULL, 0x800100600010ULL, 0x800100800000ULL };
+    struct umr_vm_translation out[4];
+
+    asic->mem_funcs.access_linear_vram = pt_mem_access;
+    asic->mem_funcs.no_readahead = 0;
+
+    pt_mem_reads = 0;
+    ASSERT_EQ(umr_vm_translate(asic, -1, UMR_GFX_HUB|3, va, 4, out), 3);
+    ASSERT_EQ(pt_mem_reads, 3);
+
+    ASSERT_EQ(out[0].va, 0x800100400800ULL);
+    ASSERT_EQ(out[0].pa, 0x7da00800);
+    ASSERT_EQ(out[0].page_size, 0x200000);
+    ASSERT_EQ(out[0].flags, UMR_VM_XLATE_VALID);
+    ASSERT_EQ(out[0].levels, 3);
+    ASSERT_EQ(out[0].pde[1], 0x00000000bfbe8001ULL);
+    ASSERT_EQ(out[0].pde[2], 0x00000000bfbe7001ULL);
+    ASSERT_EQ(out[0].pte, 0x00400000bda004b1ULL);
+    ASSERT_EQ(out[1].pa, 0x7da01800);
+    ASSERT_EQ(out[2].pa, 0x7da01010);
+    ASSERT_EQ(out[2].pte, 0x00400000bda014b1ULL);
+    // the PDE0 of the third 2MiB block is empty
+    ASSERT_EQ(out[3].flags & UMR_VM_XLATE_VALID, 0);
+    ASSERT_EQ(out[3].pte, 0);
+
+    // and again from the TLB
+    pt_mem_reads = 0;
+    ASSERT_EQ(umr_vm_translate(asic, -1, UMR_GFX_HUB|3, va, 2, out), 2);
+    ASSERT_EQ(pt_mem_reads, 0);
+    ASSERT_EQ(out[1].pa, 0x7da01800);
+    ASSERT_EQ(out[1].pte, 0x00400000bda004b1ULL);
+    return TEST_SUCCESS;
+}
+
+// physical addresses are found in the mappings of a VMID
+enum TEST_RESULT test_vm_rmap(struct umr_asic* asic)
+{
+    struct umr_vm_rmap rmap = { 0 };
+    struct umr_vm_rmap_hit hits[4];
+
+    asic->mem_funcs.access_linear_vram = pt_mem_access;
+    asic->mem_funcs.no_readahead = 0;
+
+    ASSERT_SUCCESS(umr_vm_rmap_update_vmid(asic, &rmap, -1, UMR_GFX_HUB|3));
+    ASSERT_EQ(rmap.no_entries, 2);
+
+    // both 2MiB pages cover it
+    ASSERT_EQ(umr_vm_rmap_lookup(&rmap, 0x7da01800, 0, hits, 4), 2);
+    ASSERT_EQ(hits[0].va, 0x800100600800ULL);
+    ASSERT_EQ(hits[0].vmid, UMR_GFX_HUB|3);
+    ASSERT_EQ(hits[0].pid, 0);
+    ASSERT_EQ(hits[1].va, 0x800100401800ULL);
+
+    // only the second reaches past the end of the first
+    ASSERT_EQ(umr_vm_rmap_lookup(&rmap, 0x7dc00800, 0, hits, 4), 1);
+    ASSERT_EQ(hits[0].va, 0x8001007FF800ULL);
+    ASSERT_EQ(umr_vm_rmap_lookup(&rmap, 0x7d000000, 0, hits, 4), 0);
+    ASSERT_EQ(umr_vm_rmap_lookup(&rmap, 0x7da01800, 1, hits, 4), 0);
+    // more hits than room
+    ASSERT_EQ(umr_vm_rmap_lookup(&rmap, 0x7da01800, 0, hits, 1), 2);
+
+    // walking the VMID again replaces its entries
+    ASSERT_SUCCESS(umr_vm_rmap_update_vmid(asic, &rmap, -1, UMR_GFX_HUB|3));
+    ASSERT_EQ(rmap.no_entries, 2);
+    free(rmap.entries);
+    free(rmap.max_end);
+    return TEST_SUCCESS;
+}
+
+// several ranges of the user queue process (here ourselves) in one call
+enum TEST_RESULT test_user_memv(struct umr_asic* asic)
+{
+    static uint32_t src[3] = { 0x11111111, 0x22222222, 0x33333333 };
+    uint32_t dst[3] = { 0 }, sizes[3] = { 4, 4, 4 };
+    uint64_t va[3];
+    void *data[3];
+    unsigned x;
+    int fd;
+
+    for (x = 0; x < 3; x++) {
+        va[x] = (uintptr_t)&src[2 - x];
+        data[x] = &dst[x];
+    }
+    asic->options.user_queue.client_info.proc_info.pid = getpid();
+    ASSERT_SUCCESS(umr_access_user_memv(asic, va, sizes, data, 3, 0));
+    ASSERT_EQ(dst[0], 0x33333333);
+    ASSERT_EQ(dst[2], 0x11111111);
+
+    // single accesses keep /proc/<pid>/mem open between calls
+    asic->options.user_queue.state.active = 1;
+    asic->options.user_queue.state.va = (uintptr_t)&src[1];
+    ASSERT_SUCCESS(umr_access_sram(asic, 0, 4, &dst[0], 0));
+    ASSERT_EQ(dst[0], 0x22222222);
+    fd = asic->proc_mem.fd;
+    ASSERT_SUCCESS(umr_access_sram(asic, 0, 4, &dst[1], 0));
+    ASSERT_EQ(asic->proc_mem.fd, fd);
+    asic->options.user_queue.state.active = 0;
+
+    umr_close_proc_mem(asic);
+    ASSERT_EQ(asic->proc_mem.pid, 0);
+    return TEST_SUCCESS;
+}
+
+// a 64 word user queue at 0x10000 whose words hold their index
+static int uq_view_reads;
+
+static int uq_view_access(struct umr_asic *asic, int partition, uint32_t vmid, uint64_t address, uint32_t size, void *data, int write_en, struct umr_vm_pagewalk *vmdata)
+{
+    uint32_t *w = data, x;
+
+    (void)asic; (void)partition; (void)vmid; (void)write_en; (void)vmdata;
+    for (x = 0; x < size / 4; x++)
+        w[x] = (address - 0x10000) / 4 + x;
+    ++uq_view_reads;
+    return 0;
+}
+
+// a span is read into a buffer of its own size, wrapping spans in two segments
+enum TEST_RESULT test_user_queue_view(struct umr_asic* asic)
+{
+    struct umr_ring_view rv;
+
+    asic->mem_funcs.access_vram = uq_view_access;
+    asic->options.user_queue.state.qidx = 0;
+    asic->options.user_queue.client_info.queue[0].hqd_base_addr = 0x10000;
+    asic->options.user_queue.client_info.queue[0].rb_buf_size = 64;
+
+    uq_view_reads = 0;
+    ASSERT_SUCCESS(umr_user_queue_view(asic, 8, 12, &rv));
+    ASSERT_EQ(rv.no_segs, 1);
+    ASSERT_EQ(rv.nwords, 4);
+    ASSERT_EQ(rv.words[0], 8);
+    ASSERT_EQ(umr_ring_view_addr(&rv, 3), 0x10000 + 11 * 4);
+    ASSERT_EQ(uq_view_reads, 1);
+    umr_ring_view_free(&rv);
+
+    ASSERT_SUCCESS(umr_user_queue_view(asic, 60, 4, &rv));
+    ASSERT_EQ(rv.no_segs, 2);
+    ASSERT_EQ(rv.nwords, 8);
+    ASSERT_EQ(rv.seg[1].words, rv.words + 4);
+    ASSERT_EQ(rv.words[3], 63);
+    ASSERT_EQ(rv.words[4], 0);
+    ASSERT_EQ(umr_ring_view_addr(&rv, 4), 0x10000);
+    umr_ring_view_free(&rv);
+
+    // a start plus count past the end wraps as well
+    ASSERT_SUCCESS(umr_user_queue_view(asic, 62, 66, &rv));
+    ASSERT_EQ(rv.nwords, 4);
+    ASSERT_EQ(rv.words[2], 0);
+    umr_ring_view_free(&rv);
+    ASSERT_EQ(umr_user_queue_view(asic, 64, 4, &rv), -1);
+
+    asic->mem_funcs.access_vram = NULL;
+    return TEST_SUCCESS;
+}
+
+// an 8 vector IH ring at bus address 0x20000, vector i is from client
+// 9 or 20 (odd) with SourceID i
+static int ih_reads, ih_vectors;
+
+static int ih_access_sram(struct umr_asic *asic, uint64_t address, uint32_t size, void *dst, int write_en)
+{
+    uint32_t *w = dst, x, v;
+
+    (void)asic; (void)write_en;
+    for (x = 0; x < size / 4; x++) {
+        v = (address - 0x20000) / 32 + x / 8;
+        w[x] = (x % 8) ? 0 : ((v & 1) ? 20 : 9) | (v << 8);
+    }
+    ++ih_reads;
+    return 0;
+}
+
+static void ih_start(struct umr_ih_decode_ui *ui, uint32_t offset) { (void)ui; (void)offset; ++ih_vectors; }
+static void ih_field(struct umr_ih_decode_ui *ui, uint32_t offset, const char *name, uint32_t value, char *str, int radix) { (void)ui; (void)offset; (void)name; (void)value; (void)str; (void)radix; }
+static void ih_done(struct umr_ih_decode_ui *ui) { (void)ui; }
+
+// only new vectors are read, all are counted and the filter picks those decoded
+enum TEST_RESULT test_ih_ring_tail(struct umr_asic* asic)
+{
+    struct umr_ih_decode_ui ui = { &ih_start, &ih_field, &ih_done, NULL };
+    struct umr_ih_ring ih;
+
+    memset(&ih, 0, sizeof ih);
+    ih.filter.client_id = 9;
+    ih.filter.source_id = ih.filter.vmid = ih.filter.pasid = -1;
+    ih.addr = 0x20000;
+    ih.bus_addr = 1;
+    ih.size = 256;
+    ih.vector_size = umr_ih_vector_size(asic);
+    ASSERT_EQ(ih.vector_size, 32);
+    ih.buf = calloc(1, ih.size);
+    ih.cursor = 192;
+    asic->mem_funcs.access_sram = ih_access_sram;
+
+    // vectors 6, 7, 0 and 1 in two reads
+    ih_reads = ih_vectors = 0;
+    ASSERT_EQ(umr_ih_ring_decode(asic, &ih, 64, 100, &ui), 2);
+    ASSERT_EQ(ih_reads, 2);
+    ASSERT_EQ(ih_vectors, 2);
+    ASSERT_EQ(ih.vectors, 4);
+    ASSERT_EQ(ih.filtered, 2);
+    ASSERT_EQ(ih.cursor, 64);
+    ASSERT_EQ(ih.no_rates, 4);
+    ASSERT_EQ(ih.rates[0].client_id, 9);
+    ASSERT_EQ(ih.rates[0].source_id, 0);
+    ASSERT_EQ(ih.rates[3].client_id, 20);
+    ASSERT_EQ(ih.rates[3].source_id, 7);
+
+    // nothing new is not read
+    ASSERT_EQ(umr_ih_ring_decode(asic, &ih, 64, 100, &ui), 0);
+    ASSERT_EQ(ih_reads, 2);
+
+    // vector 2 and then 10 more of it over the rate window
+    ASSERT_EQ(umr_ih_ring_decode(asic, &ih, 96, 101, NULL), 1);
+    ASSERT_EQ(ih.rates[1].source_id, 2);
+    ih.rates[1].slots[101 % UMR_IH_RATE_SLOTS] += 15;
+    ASSERT_EQ(umr_ih_source_rate(&ih.rates[1]), 2);
+    ASSERT_EQ(ih.rates[1].total, 1);
+
+    // the counts of seconds that passed are dropped
+    ASSERT_EQ(umr_ih_ring_decode(asic, &ih, 96, 110, NULL), 0);
+    ASSERT_EQ(umr_ih_source_rate(&ih.rates[1]), 0);
+
+    asic->mem_funcs.access_sram = NULL;
+    umr_ih_ring_free(&ih);
+    return TEST_SUCCESS;
+}
+
+// fake MM_INDEX/MM_DATA window, MM_DATA reads back the address selected
+static uint32_t mm_index, mm_index_hi;
+static int mm_index_writes, mm_index_hi_writes;
+
+static int mm_write_reg(struct umr_asic *asic, uint64_t addr, uint32_t value, enum regclass type)
+{
+    (void)type;
+    if (addr == asic->mm_index.index) {
+        mm_index = value & 0x7FFFFFFF;
+        ++mm_index_writes;
+    } else if (addr == asic->mm_index.index_hi) {
+        mm_index_hi = value;
+        ++mm_index_hi_writes;
+    }
+    return 0;
+}
+
+static uint32_t mm_read_reg(struct umr_asic *asic, uint64_t addr, enum regclass type)
+{
+    (void)type;
+    if (addr == asic->mm_index.data)
+        return (mm_index_hi << 31) | mm_index;
+    return 0;
+}
+
+// MM_INDEX_HI is only written when the access crosses a 2GB boundary
+enum TEST_RESULT test_vram_via_mmio(struct umr_asic* asic)
+{
+    uint32_t buf[4];
+
+    asic->reg_funcs.write_reg = mm_write_reg;
+    asic->reg_funcs.read_reg = mm_read_reg;
+
+    mm_index_writes = mm_index_hi_writes = 0;
+    ASSERT_SUCCESS(umr_access_vram_via_mmio(asic, 0x7FFFFFF8ULL, sizeof(buf), buf, 0));
+    ASSERT_EQ(mm_index_writes, 4);
+    ASSERT_EQ(mm_index_hi_writes, 2);
+    ASSERT_EQ(buf[0], 0x7FFFFFF8);
+    ASSERT_EQ(buf[1], 0x7FFFFFFC);
+    ASSERT_EQ(buf[2], 0x80000000);
+    ASSERT_EQ(buf[3], 0x80000004);
+    return TEST_SUCCESS;
+}
+
+// records where each piece of a hive access landed
+static struct { uint64_t address; uint32_t size; } xgmi_pieces[4];
+static int xgmi_no_pieces;
+
+static int xgmi_node_access(struct umr_asic *asic, uint64_t address, uint32_t size, void *data, int write_en)
+{
+    (void)asic;
+    (void)write_en;
+    if (xgmi_no_pieces < 4) {
+        xgmi_pieces[xgmi_no_pieces].address = address;
+        xgmi_pieces[xgmi_no_pieces].size = size;
+    }
+    ++xgmi_no_pieces;
+    memset(data, 0, size);
+    return 0;
+}
+
+// a linear access spanning two hive nodes is split at the boundary
+enum TEST_RESULT test_xgmi_route(struct umr_asic* asic)
+{
+    uint64_t buf[2];
+
+    asic->mem_funcs.access_linear_vram = xgmi_node_access;
+    asic->config.vram_size = 0x40000000ULL;
+    asic->config.xgmi.nodes[0].asic = asic;
+    asic->config.xgmi.nodes[1].asic = asic;
+    asic->config.xgmi.callbacks_applied = 1;
+    asic->options.use_xgmi = 1;
+
+    xgmi_no_pieces = 0;
+    ASSERT_SUCCESS(umr_access_vram(asic, -1, UMR_LINEAR_HUB, 0x3FFFFFF8ULL, sizeof(buf), buf, 0, NULL));
+    ASSERT_EQ(xgmi_no_pieces, 2);
+    ASSERT_EQ(xgmi_pieces[0].address, 0x3FFFFFF8ULL);
+    ASSERT_EQ(xgmi_pieces[0].size, 8);
+    ASSERT_EQ(asic->config.xgmi.route.node[1].base, 0x40000000ULL);
+    ASSERT_EQ(xgmi_pieces[1].address, 0);
+    ASSERT_EQ(xgmi_pieces[1].size, 8);
+
+    // past the end of the hive
+    ASSERT_EQ(umr_access_vram(asic, -1, UMR_LINEAR_HUB, 0x80000000ULL, 8, buf, 0, NULL), -1);
+
+    asic->options.use_xgmi = 0;
+    memset(&asic->config.xgmi, 0, sizeof(asic->config.xgmi));
+    return TEST_SUCCESS;
+}
+
 DEFINE_TESTS(vm_tests)
 #if 0
 TEST(test_can_read_from_vm_memory_direct1, "direct_vm_test1.envdef", "raven1"),
@@ -219,6 +810,20 @@ TEST(test_can_read_from_vm_memory_direct1, "direct_vm_test1.envdef", "raven1"),
 #if 1
 TEST(test_can_read_from_vm_memory_direct0, "direct_vm_test0.envdef", "raven1"),
 TEST(test_can_read_from_vm_memory_direct1, "direct_vm_test1.envdef", "raven1"),
+TEST(test_vm_tlb, "vm_tlb_test.envdef", "raven1"),
+TEST(test_vm_context, "vm_tlb_test.envdef", "raven1"),
+TEST(test_vm_pt_cache, "vm_tlb_test.envdef", "raven1"),
+TEST(test_vm_contiguous_run, "vm_tlb_test.envdef", "raven1"),
+TEST(test_vm_queued_runs, "vm_tlb_test.envdef", "raven1"),
+TEST(test_vm_map, "vm_tlb_test.envdef", "raven1"),
+TEST(test_vm_decoder, "vm_tlb_test.envdef", "raven1"),
+TEST(test_vm_translate, "vm_tlb_test.envdef", "raven1"),
+TEST(test_vm_rmap, "vm_tlb_test.envdef", "raven1"),
+TEST(test_user_memv, "vm_tlb_test.envdef", "raven1"),
+TEST(test_user_queue_view, "vm_tlb_test.envdef", "raven1"),
+TEST(test_ih_ring_tail, "vm_tlb_test.envdef", "raven1"),
+TEST(test_vram_via_mmio, "vm_tlb_test.envdef", "raven1"),
+TEST(test_xgmi_route, "vm_tlb_test.envdef", "raven1"),
 TEST(test_can_read_from_vm_memory_direct2, "direct_vm_test2.envdef", "navi10"),
 TEST(test_can_read_from_vm_memory_direct3, "direct_vm_test3.envdef", "navi10"),
 TEST(test_can_read_from_vm_memory_direct5, "direct_vm_test5.envdef", "navi10"),
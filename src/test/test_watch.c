@@ -0,0 +1,163 @@
+#include "test_framework.h"
+
+// the watched register counts the polls, the others read 0xCAFE
+static uint32_t watch_addr, watch_count;
+
+static int watch_read_regs_batch(struct umr_asic *asic, struct umr_reg_batch *regs, int no_regs)
+{
+    int x;
+
+    (void)asic;
+    for (x = 0; x < no_regs; x++)
+        regs[x].value = regs[x].addr == watch_addr ? watch_count++ : 0xCAFE;
+    return 0;
+}
+
+static int watch_read_ring_header(struct umr_asic *asic, char *ringname, uint32_t *ptrs, uint32_t *ringsize)
+{
+    (void)asic;
+    ptrs[0] = 1;
+    ptrs[1] = 2;
+    ptrs[2] = 3;
+    *ringsize = 64;
+    return strcmp(ringname, "gfx_0.0.0") ? -1 : 0;
+}
+
+enum TEST_RESULT test_reg_watch_navi(struct umr_asic* asic)
+{
+    int (*saved_batch)(struct umr_asic *, struct umr_reg_batch *, int) = asic->reg_funcs.read_regs_batch;
+    int (*saved_header)(struct umr_asic *, char *, uint32_t *, uint32_t *) = asic->ring_func.read_ring_header;
+    struct umr_reg *regs[1], *snap_regs[1];
+    struct umr_reg_watch_trigger trig[2];
+    struct umr_reg_watch_config cfg;
+    struct umr_reg_watch *w;
+    const struct umr_reg_watch_hit *h;
+    char *rings[] = { "gfx_0.0.0" };
+    uint64_t polls, hits;
+
+    regs[0] = umr_find_reg_by_name(asic, "mmGRBM_GFX_INDEX", NULL);
+    snap_regs[0] = umr_find_reg_by_name(asic, "mmGRBM_STATUS", NULL);
+    ASSERT_NOT_NULL(regs[0]);
+    ASSERT_NOT_NULL(snap_regs[0]);
+
+    // low two bits rising to 3 fires at 3 and 7, 9 fires and stops
+    memset(trig, 0, sizeof trig);
+    trig[0].mask = 3;
+    trig[0].match = 3;
+    trig[0].edge = UMR_REG_WATCH_RISING;
+    trig[1].mask = ~0ULL;
+    trig[1].match = 9;
+    trig[1].edge = UMR_REG_WATCH_LEVEL;
+    trig[1].stop = 1;
+
+    memset(&cfg, 0, sizeof cfg);
+    cfg.regs = regs;
+    cfg.no_regs = 1;
+    cfg.triggers = trig;
+    cfg.no_triggers = 2;
+    cfg.snap_regs = snap_regs;
+    cfg.no_snap_regs = 1;
+    cfg.rings = rings;
+    cfg.no_rings = 1;
+    cfg.capacity = 2;
+
+    watch_addr = regs[0]->addr * 4;
+    watch_count = 0;
+    asic->reg_funcs.read_regs_batch = watch_read_regs_batch;
+    asic->ring_func.read_ring_header = watch_read_ring_header;
+    w = umr_reg_watch_start(asic, &cfg);
+    if (w)
+        umr_reg_watch_wait(w);
+    asic->reg_funcs.read_regs_batch = saved_batch;
+    asic->ring_func.read_ring_header = saved_header;
+    ASSERT_NOT_NULL(w);
+
+    ASSERT_EQ(umr_reg_watch_status(w, &polls, &hits), 1);
+    ASSERT_EQ(polls, 10u);
+    ASSERT_EQ(hits, 3u);
+
+    // only the last two hits are kept
+    h = umr_reg_watch_get(w, 0);
+    ASSERT_NOT_NULL(h);
+    ASSERT_EQ(h->trigger, 0);
+    ASSERT_EQ(h->poll, 7u);
+    ASSERT_EQ(h->values[0], 7u);
+    h = umr_reg_watch_get(w, 1);
+    ASSERT_NOT_NULL(h);
+    ASSERT_EQ(h->trigger, 1);
+    ASSERT_EQ(h->values[0], 9u);
+    ASSERT_EQ(h->snap_values[0], 0xCAFEu);
+    ASSERT_EQ(h->ring_ptrs[0][1], 2u);
+    ASSERT_EQ(h->waves == NULL, 1);
+    ASSERT_EQ(umr_reg_watch_get(w, 2) == NULL, 1);
+    umr_reg_watch_free(w);
+
+    // a trigger must name one of the polled registers
+    trig[0].reg = 1;
+    ASSERT_EQ(umr_reg_watch_start(asic, &cfg) == NULL, 1);
+    return TEST_SUCCESS;
+}
+
+static int sampler_read_regs_batch(struct umr_asic *asic, struct umr_reg_batch *regs, int no_regs)
+{
+    int x;
+
+    (void)asic;
+    for (x = 0; x < no_regs; x++)
+        regs[x].value = 0xCAFE;
+    return 0;
+}
+
+enum TEST_RESULT test_sample_rate_navi(struct umr_asic* asic)
+{
+    int (*saved_batch)(struct umr_asic *, struct umr_reg_batch *, int) = asic->reg_funcs.read_regs_batch;
+    struct umr_sample_rate sr;
+    struct umr_reg_sampler *s;
+    struct umr_reg *regs[1];
+    uint64_t counters[64], samples, value;
+    int x;
+
+    // busy stays at min_ns, idle backs off to max_ns
+    umr_sample_rate_init(&sr, 1000, 100000, 0);
+    ASSERT_EQ(sr.step_ns, 1000u);
+    ASSERT_EQ(umr_sample_rate_update(&sr, 1.0), 1000u);
+    for (x = 0; x < 100; x++)
+        umr_sample_rate_update(&sr, 0.0);
+    ASSERT_EQ(sr.step_ns, 100000u);
+    ASSERT_EQ(umr_sample_rate_update(&sr, 1.0), 25000u);
+    ASSERT_EQ(umr_sample_rate_update(&sr, 5.0), 6250u);
+    ASSERT_EQ(sr.last_ns != 0, 1);
+
+    umr_sample_rate_init(&sr, 5000, 10, 0);
+    ASSERT_EQ(sr.max_ns, 5000u);
+    ASSERT_EQ(umr_sample_rate_update(&sr, 0.0), 5000u);
+
+    // registers that never change, time weighted counters are value * samples
+    regs[0] = umr_find_reg_by_name(asic, "mmGRBM_GFX_INDEX", NULL);
+    ASSERT_NOT_NULL(regs[0]);
+    ASSERT_EQ(regs[0]->no_bits <= 64, 1);
+    umr_sample_rate_init(&sr, 100000, 1000000, 0);
+    asic->reg_funcs.read_regs_batch = sampler_read_regs_batch;
+    s = umr_reg_sampler_start_adaptive(asic, regs, 1, &sr, 3000000);
+    if (s)
+        umr_reg_sampler_wait(s);
+    asic->reg_funcs.read_regs_batch = saved_batch;
+    ASSERT_NOT_NULL(s);
+
+    ASSERT_EQ(umr_reg_sampler_fields(s), regs[0]->no_bits);
+    ASSERT_EQ(umr_reg_sampler_read(s, counters, &samples, NULL), 1);
+    ASSERT_EQ(samples >= 2, 1);
+    for (x = 0; x < regs[0]->no_bits; x++) {
+        unsigned width = regs[0]->bits[x].stop - regs[0]->bits[x].start + 1;
+
+        value = (0xCAFEULL >> regs[0]->bits[x].start) & (width >= 32 ? 0xFFFFFFFFULL : (1ULL << width) - 1);
+        ASSERT_EQ(counters[x], value * samples);
+    }
+    umr_reg_sampler_stop(s);
+    return TEST_SUCCESS;
+}
+
+DEFINE_TESTS(watch_tests)
+TEST(test_reg_watch_navi, "navi_reg_only.envdef", "navi10"),
+TEST(test_sample_rate_navi, "navi_reg_only.envdef", "navi10"),
+END_TESTS(watch_tests);
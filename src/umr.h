@@ -159,17 +159,49 @@ struct umr_bitfield {
 	char *regname;
 	/* bit start/stop locations starting from 0 up to 31 */
 	unsigned char start, stop;
-	/* helper to print bitfield, optional */
-	void (*bitfield_print)(struct umr_asic *asic, char *asicname, char *ipname, char *regname, char *bitname, int start, int stop, uint32_t value);
+};
+
+// the unshifted mask of a bitfield, fields can be the full 64 bits wide
+static inline uint64_t umr_bitfield_mask(const struct umr_bitfield *bf)
+{
+	return (bf->stop - bf->start) >= 63 ? ~0ULL : (2ULL << (bf->stop - bf->start)) - 1;
+}
+
+// how the bitfields of a register are printed, see umr_bitfield_print()
+enum umr_bitfield_printer {
+	UMR_BITFIELD_PRINT_DEFAULT = 0,
 };
 
 struct umr_reg {
 	char *regname;
-	enum regclass type;
 	uint64_t addr;
 	struct umr_bitfield *bits;
+	uint64_t value;
+	enum regclass type;
 	int no_bits;
-	uint64_t bit64, value;
+	uint8_t bit64;
+	/* an enum umr_bitfield_printer, the same for all of its bitfields */
+	uint8_t print;
+};
+
+// a register resolved once by name so hot paths don't repeat the lookup
+struct umr_reg_handle {
+	struct umr_reg *reg;
+	struct umr_ip_block *ip;
+	uint64_t addr;              // BYTE address (MMIO) or raw address
+};
+
+// a bitfield of a register with its shift and (unshifted) mask precomputed
+struct umr_field_handle {
+	struct umr_reg *reg;
+	uint32_t shift;
+	uint64_t mask;
+};
+
+// a bitfield of one of the captured WAVE STATUS registers
+struct umr_wave_field {
+	int idx;                    // index into umr_wave_data.ws.reg_values
+	struct umr_field_handle field;
 };
 
 struct umr_reg_soc15 {
@@ -185,6 +217,12 @@ struct umr_find_reg_iter {
 	struct umr_asic *asic;
 	char *ip, *reg;
 	int ip_i, reg_i;
+
+	// candidate registers from the trigram index (if used)
+	const uint32_t *cand;
+	uint32_t no_cand, cand_i;
+	int use_index, ip_ok;
+	struct umr_reg_search_index *idx;
 };
 
 struct umr_ip_block {
@@ -194,6 +232,66 @@ struct umr_ip_block {
 	struct {
           int die, maj, min, rev, instance, logical_inst;
     } discoverable;
+	// set if the register names point into a mapped compiled database
+	// (see umr_database_read_ipblock_bin())
+	void *db_map;
+	size_t db_map_size;
+	struct umr_bitfield *db_bits;
+	// set if the register/bitfield names and bitfield arrays were
+	// allocated from a name pool (see umr_name_pool_create())
+	struct umr_name_pool *name_pool;
+	// set if the registers were read from the database, the names and
+	// bitfields above then belong to a table shared with other blocks
+	// that use the same .reg file (see umr_database_read_ipblock_regs())
+	struct umr_reg_table *reg_table;
+	// set while the registers have not been loaded yet, regs/no_regs
+	// are empty until then (see umr_load_ip_block())
+	struct umr_ip_block_source *source;
+};
+
+// startup phases measured by umr_timing_begin()/umr_timing_end()
+enum umr_timing_phase {
+	UMR_TIMING_DISCOVER = 0,    // umr_discover_asic()
+	UMR_TIMING_IP_DISCOVERY,    // umr_parse_ip_discovery()
+	UMR_TIMING_DATABASE,        // asic/soc15/register files
+	UMR_TIMING_SCAN_CONFIG,     // umr_scan_config()
+	UMR_TIMING_MMIO_ACCEL,      // umr_create_mmio_accel()
+	UMR_TIMING_DEBUGFS,         // opening the debugfs files
+	UMR_TIMING_MAX,
+};
+
+struct umr_timing {
+	struct {
+		uint64_t ns;            // time spent in the (outermost) phase
+		uint64_t calls, files, bytes;
+	} phase[UMR_TIMING_MAX];
+};
+
+// syscalls made on behalf of an asic, grouped by the kind of file they
+// go to, see umr_io_account() and the umr_io_*() wrappers
+enum umr_io_class {
+	UMR_IO_MMIO = 0,            // fd.mmio, fd.mmio2, fd.pcie, fd.smc, fd.didt
+	UMR_IO_VRAM,                // fd.vram
+	UMR_IO_IOMEM,               // fd.iomem, fd.iova and /proc/<pid>/mem
+	UMR_IO_GPRWAVE,             // fd.gprwave, fd.gpr, fd.wave
+	UMR_IO_SENSORS,             // fd.sensors
+	UMR_IO_RUMR,                // requests to a rumr server
+	UMR_IO_OTHER,               // DRM queries, rings, clocks, gfxoff, ...
+	UMR_IO_MAX,
+};
+
+enum umr_io_op {
+	UMR_IO_READ = 0,
+	UMR_IO_WRITE,
+	UMR_IO_IOCTL,
+};
+
+struct umr_io_stats {
+	struct {
+		uint64_t reads, writes, ioctls;
+		uint64_t bytes_read, bytes_written;
+		uint64_t ns;            // time spent in the calls
+	} cls[UMR_IO_MAX];
 };
 
 struct umr_find_reg_iter_result {
@@ -255,6 +353,7 @@ struct umr_fw_config {
 
 #define UMR_MAX_FW 32
 #define UMR_MAX_XGMI_DEVICES 128
+#define UMR_MAX_CPUS 1024
 
 #define NUM_HBM_INSTANCES 4
 
@@ -271,7 +370,8 @@ struct umr_test_harness_mmio_blocks {
 	uint32_t *values;       // values for this register
 	uint32_t no_values;     // number of values slotted in this spot
 	uint32_t cur_slot;      // index to current value to return
-	struct umr_test_harness_mmio_blocks *next;
+	struct umr_test_harness_mmio_blocks *next,
+					    *next_same; // next block of the same address (mmio list only)
 };
 
 struct umr_test_harness_sq_blocks {
@@ -291,6 +391,38 @@ struct umr_test_harness {
 
 	uint64_t vram_mm_index; // when these are written they are shadowed here
 	uint32_t sq_ind_index;
+
+	// built by umr_attach_test_harness() so replaying doesn't walk the lists
+	struct {
+		// open addressed by address, blocks of the same address are chained by next_same
+		struct umr_test_harness_mmio_slot {
+			uint64_t address;
+			struct umr_test_harness_mmio_blocks *first, *cur;
+		} *mmio;
+		uint32_t mmio_size;
+
+		// disjoint ranges sorted by address, each mapped to the first block (in script order) covering it
+		struct umr_test_harness_ram_range {
+			uint64_t start, end;
+			struct umr_test_harness_ram_blocks *block;
+		} *vram, *sysram;
+		uint32_t no_vram, no_sysram;
+
+		// DWORD addresses of the indirect access registers, 0xFFFFFFFF if missing,
+		// looked up by the first register access which sets regs_resolved
+		uint32_t sq_ind_data, sq_ind_index, mm_data[2], mm_index[2], mm_index_hi[2];
+		int regs_resolved;
+	} index;
+
+	// set by umr_create_test_harness_binary(), contents and values point into the mapping
+	// and the blocks after the list heads come from these arrays
+	struct {
+		void *map;
+		size_t size;
+		struct umr_test_harness_ram_blocks *ram;
+		struct umr_test_harness_mmio_blocks *mmio;
+		struct umr_test_harness_sq_blocks *sq;
+	} bin;
 };
 
 
@@ -364,6 +496,50 @@ struct umr_user_queue {
 	struct umr_user_queue *next, *prev;
 };
 
+// a span of a ring read in up to two segments (two if it wraps around the end of the ring)
+struct umr_ring_view {
+	struct {
+		uint32_t *words;
+		uint32_t nwords;
+		uint64_t addr; // GPU address of words[0]
+	} seg[2];
+	int no_segs;
+	uint32_t nwords;  // of both segments
+	uint32_t *words;  // storage of the segments back to back, owned by the view
+};
+
+// the user queue clients of a device cached between calls of umr_uq_registry_refresh()
+struct umr_uq_registry {
+	struct umr_uq_registry_entry {
+		struct umr_user_queue uq;
+		uint64_t
+			mqd_hash[UMR_MAX_MQD_QUEUES],   // of uq.client_info.queue[].mqd_words
+			generation[UMR_MAX_MQD_QUEUES], // registry generation the queue last changed in
+			seen;                           // last generation the client was listed in
+	} *entries;
+	int no_entries;
+	uint64_t generation; // bumped by every refresh
+};
+
+// GRBM/SRBM bank selection (which one is live is given by use_bank)
+union umr_bank_select {
+	struct {
+		uint32_t
+			instance,
+			se,
+			sh;
+	} grbm;
+	struct {
+		uint32_t
+			me,
+			queue,
+			pipe,
+			vmid;
+	} srbm;
+};
+
+struct umr_output;
+
 struct umr_options {
 	int forced_instance,
 		instance,
@@ -374,6 +550,7 @@ struct umr_options {
 	    many,
 	    use_pci,
 	    use_colour,
+	    jsonl,              // --jsonl, records are printed as JSON lines
 	    read_smc,
 	    quiet,
 	    no_follow_ib,
@@ -395,11 +572,21 @@ struct umr_options {
 	    pg_lock,
 	    test_log,
 	    vm_partition,
+	    all_xcc,            // -vmp all, the commands that support it run on every XCC, see umr_xcc_run()
 	    is_virtual,
 	    force_asic_file,
 	    export_model,
 	    vgpr_granularity,
 	    use_v1_regs_debugfs,
+	    use_io_uring,
+	    no_lazy_regs,
+	    use_vram_bar,
+	    parallel_waves,
+	    prefetch_gprs,
+	    parallel_ibs,
+	    vcn_summary,
+	    metrics_changed,
+	    ring_halt_timeout,  // microseconds the ring pointers must stand still, see umr_ring_is_halted()
 	    trap_unsorted_db,
 		filter_shader_registers,
 		use_full_user_queue,
@@ -418,21 +605,14 @@ struct umr_options {
 			enable_comp_shader;
 	} shader_enable;
 
-	union {
-		struct {
-			uint32_t
-				instance,
-				se,
-				sh;
-		} grbm;
-		struct {
-			uint32_t
-				me,
-				queue,
-				pipe,
-				vmid;
-		} srbm;
-	} bank;
+	// units scanned for waves and sampled by umr_sample_wave_pcs(), a 0 mask selects all
+	struct {
+		uint32_t se, sh;
+		uint64_t cu;    // CUs on gfx9 and older, WGPs on gfx10+
+		int max_waves;  // stop once this many waves are found, 0 for no limit
+	} wave_filter;
+
+	union umr_bank_select bank;
 
 	long forcedid;
 	char
@@ -441,7 +621,8 @@ struct umr_options {
 		hub_name[32],
 		ring_name[32],
 		desired_path[256],
-		database_path[256];
+		database_path[256],
+		cpu_affinity[64];   // -O cpu_affinity=, "off" or the CPUs to use, see umr_affinity_init()
 	struct {
 		unsigned domain,
 		    bus,
@@ -451,10 +632,13 @@ struct umr_options {
 	} pci;
 
 	FILE *test_log_fd;
+	struct umr_test_vector_writer *test_log_bin; // binary test vector, test_log_fd is its stream
 	struct umr_test_harness *th;
+	struct umr_output *output; // buffered stream of the printers, see umr_output_open()
 
 	// is this a rumr client?
-	int rumr_active;
+	int rumr_active,
+	    rumr_cache;  // cache register/memory reads of a frozen GPU, see rumr_client_cache_flush()
 
 	// user mode queue client support
 	// this structure has (several) nested structures that represent various sources of information
@@ -462,6 +646,9 @@ struct umr_options {
 	struct umr_user_queue user_queue;
 };
 
+// the options without the (large) user queue state, which must stay last
+#define UMR_OPTIONS_SETTINGS_SIZE offsetof(struct umr_options, user_queue)
+
 // Page Directory Entry for VM page walking
 typedef struct {
 	uint64_t
@@ -504,6 +691,7 @@ typedef struct {
 		pte;
 } pte_fields_t;
 
+struct umr_vm_pagewalk;
 struct umr_memory_access_funcs {
 	/** access_sram -- Access System RAM
 	 * @asic:  The device the memory is bound to
@@ -523,6 +711,15 @@ struct umr_memory_access_funcs {
 	 */
 	int (*access_linear_vram)(struct umr_asic *asic, uint64_t address, uint32_t size, void *data, int write_en);
 
+	/** access_vram -- Access memory through a GPU VM (optional)
+	 * @asic, @partition, @vmid, @address, @size, @data, @write_en, @vmdata: as for umr_access_vram()
+	 *
+	 * Called by umr_access_vram() for VM hubs to translate and access the
+	 * memory in one go instead of walking the page tables through the
+	 * other callbacks.  Returns 1 to have the page tables walked anyway.
+	 */
+	int (*access_vram)(struct umr_asic *asic, int partition, uint32_t vmid, uint64_t address, uint32_t size, void *data, int write_en, struct umr_vm_pagewalk *vmdata);
+
 	/** gpu_bus_to_cpu_address -- convert a GPU bound address for
 	 * 							  system memory pages to CPU bound
 	 * 							  addresses
@@ -543,10 +740,17 @@ struct umr_memory_access_funcs {
 
 	void (*va_addr_decode)(pde_fields_t *pdes, int num_pde, pte_fields_t pte);
 
+	/** no_readahead -- only read what is asked for, set when extra bytes
+	 * 					 are costly (MMIO based VRAM access) or not backed
+	 * 					 at all (the test harness)
+	 */
+	int no_readahead;
+
 	/** data -- opaque pointer the callbacks can use for state tracking */
 	void *data;
 };
 
+struct umr_reg_batch;
 struct umr_register_access_funcs {
 	/** read_reg -- Read a register
 	 * @asic: The device the register is from
@@ -563,11 +767,49 @@ struct umr_register_access_funcs {
 	 */
 	int (*write_reg)(struct umr_asic *asic, uint64_t addr, uint32_t value, enum regclass type);
 
+	/** read_reg64 -- Read a 64-bit (LO/HI pair) register in one access (optional)
+	 * @asic: The device the register is from
+	 * @addr:  The byte address of the LO half
+	 * @type:  REG_MMIO or REG_SMC
+	 *
+	 * If NULL the two halves are read with read_reg.
+	 */
+	uint64_t (*read_reg64)(struct umr_asic *asic, uint64_t addr, enum regclass type);
+
+	/** write_reg64 -- Write a 64-bit (LO/HI pair) register in one access (optional)
+	 * @asic: The device the register is from
+	 * @addr: The byte address of the LO half
+	 * @value: The 64-bit value to write
+	 * @type: REG_MMIO or REG_SMC
+	 *
+	 * If NULL the two halves are written (LO first) with write_reg.
+	 */
+	int (*write_reg64)(struct umr_asic *asic, uint64_t addr, uint64_t value, enum regclass type);
+
+	/** read_regs_batch -- Read an array of registers in one go (optional)
+	 * @asic: The device the registers are from
+	 * @regs: The registers (address, type, bank) to read, values are stored in them
+	 * @no_regs: Number of entries in @regs
+	 *
+	 * Used by umr_read_regs_batch(), if NULL each register is read with read_reg.
+	 */
+	int (*read_regs_batch)(struct umr_asic *asic, struct umr_reg_batch *regs, int no_regs);
+
+	/** write_regs_batch -- Write an array of registers in order in one go (optional)
+	 * @asic: The device the registers are from
+	 * @regs: The registers (address, type, bank, value) to write
+	 * @no_regs: Number of entries in @regs
+	 *
+	 * Used by umr_write_regs_batch(), if NULL each register is written with write_reg.
+	 */
+	int (*write_regs_batch)(struct umr_asic *asic, struct umr_reg_batch *regs, int no_regs);
+
 	/** data -- opaque pointer the callbacks can use for state tracking */
 	void *data;
 };
 
 struct umr_wave_status;
+struct umr_wave_list;
 struct umr_wave_access_funcs {
 	/** get_wave_status -- Populate the umr_wave_status structure
 	 * @asic: The device the SQ_WAVE data should come from
@@ -576,6 +818,16 @@ struct umr_wave_access_funcs {
 	 */
 	int (*get_wave_status)(struct umr_asic *asic, unsigned se, unsigned sh, unsigned cu, unsigned simd, unsigned wave, struct umr_wave_status *ws);
 
+	/** get_wave_status_bulk -- Populate the umr_wave_status structures of waves 0..no_waves-1 (optional)
+	 * @asic: The device the SQ_WAVE data should come from
+	 * @se, @sh, @cu, @simd: The SIMD to read data from (same meaning as for get_wave_status)
+	 * @no_waves: The number of wave slots to read
+	 * @ws: Array of @no_waves structures to store the decoded data in
+	 *
+	 * If NULL get_wave_status is called for each slot.
+	 */
+	int (*get_wave_status_bulk)(struct umr_asic *asic, unsigned se, unsigned sh, unsigned cu, unsigned simd, unsigned no_waves, struct umr_wave_status *ws);
+
 	/** get_wave_sq_info -- Populate the sq_info sub-structure of the umr_wave_status structure
 	 * @asic: The device to get SQ information from
 	 * @se, @sh, @cu: Which engine to read
@@ -583,6 +835,15 @@ struct umr_wave_access_funcs {
 	 */
 	int (*get_wave_sq_info)(struct umr_asic *asic, unsigned se, unsigned sh, unsigned cu, struct umr_wave_status *ws);
 
+	/** scan_wave_data -- Scan every wave of the device at once (optional)
+	 * @asic: The device to scan
+	 * @wl: The list to add the waves found to with umr_wave_list_append()
+	 *
+	 * Used by umr_scan_wave_data() in place of the per SIMD scan when
+	 * the whole scan is cheaper done by the backend (e.g. remotely).
+	 */
+	int (*scan_wave_data)(struct umr_asic *asic, struct umr_wave_list *wl);
+
 	/** data -- opaque pointer the callbacks can use for state tracking */
 	void *data;
 };
@@ -616,14 +877,26 @@ struct umr_wave_status {
 	uint32_t reg_values[64];
 };
 
+struct umr_wave_arena;
+
+// umr_wave_data.gpr_state, the GPRs are read on first use (see umr_wave_data_fetch_gprs())
+enum umr_wave_gpr_state {
+	UMR_WAVE_GPRS_LAZY = 0,
+	UMR_WAVE_GPRS_READING,
+	UMR_WAVE_GPRS_READ,
+	UMR_WAVE_GPRS_NONE, // skip_gprs was set or the SGPRs could not be read
+};
+
 // This captures *all* active/halted waves
 struct umr_wave_data {
 	uint32_t vgprs[64 * 256], sgprs[1024], num_threads;
-	int se, sh, cu, simd, wave, have_vgprs, tainted;
+	int se, sh, cu, simd, wave, have_vgprs, tainted, gpr_state;
 	const char **reg_names;
 	struct umr_wave_status ws;
 	struct umr_wave_thread *threads;
 	struct umr_wave_data *next;
+	struct umr_wave_arena *arena; // set on the head of a scan, see umr_free_wave_data()
+	int xcc;                      // XCC of the wave in a scan of every XCC (options.all_xcc), 0 otherwise
 };
 
 struct umr_read_gpr_funcs {
@@ -636,26 +909,119 @@ struct umr_read_gpr_funcs {
 	int (*read_sgprs)(struct umr_asic *asic, struct umr_wave_data *wd, uint32_t *dst);
 };
 
+struct umr_pm4_stream;
 struct umr_read_ring_func {
 	void *data;
 
 	void *(*read_ring_data)(struct umr_asic *asic, char *ringname, uint32_t *ringsize);
+
+	// optional, read only the pointers or a span of words of a ring
+	// (see umr_read_ring_header() and umr_read_ring_window())
+	int (*read_ring_header)(struct umr_asic *asic, char *ringname, uint32_t *ptrs, uint32_t *ringsize);
+	uint32_t *(*read_ring_window)(struct umr_asic *asic, char *ringname, uint32_t start, uint32_t stop, uint32_t *nwords);
+
+	// optional, decode the packets of a PM4 ring where the ring and its
+	// IBs are read (see umr_packet_decode_ring_ex()), returns -1 if it
+	// couldn't and the ring is to be read and decoded here
+	int (*decode_ring_pm4)(struct umr_asic *asic, char *ringname, int *start, int *stop, struct umr_pm4_stream **stream);
 };
 
 // contains info about a node in an XGMI hive
 struct umr_xgmi_hive_info {
 	uint64_t node_id;
 	int instance, hive_position;
-	struct umr_asic *asic;
+	struct umr_asic *asic; // NULL until the node is first used, see umr_xgmi_node()
 };
 
+// entry of the case-insensitive register name hash (see umr_create_reg_name_index())
+struct umr_reg_name_index {
+	uint32_t hash, ip; // ip is the index into asic->blocks[]
+	struct umr_reg *reg;
+};
+
+struct umr_uring;
+struct umr_wave_field_cache;
+struct umr_reg_search_index;
+struct umr_core_reg_cache;
+struct umr_sysfs_cache;
+struct umr_pp_cache;
+struct umr_clock_cache;
+struct umr_gfxoff_guard;
+struct umr_drm_query_cache;
+struct umr_vm_reg_cache;
+struct umr_vm_tlb;
+struct umr_packet_arena;
+struct umr_disasm_cache;
+struct umr_disasm_text_cache;
+struct umr_ib_cache;
+struct umr_packet_filter;
+struct umr_decode_session;
+struct umr_capture;
+
 struct umr_mmio_accel_data {
 	uint64_t mmio_addr;
-	uint32_t ord;
+	uint32_t ord, flags;
 	struct umr_ip_block *ip;
 	struct umr_reg *reg;
 };
 
+// umr_mmio_accel_data.flags
+#define UMR_MMIO_ACCEL_SQ_IND_INDEX (1UL << 0)
+#define UMR_MMIO_ACCEL_SQ_IND_DATA  (1UL << 1)
+
+// the MMIO accel table is also indexed by a two level page table keyed on
+// the DWORD address, each page maps to (index + 1) into mmio_accel or 0
+#define UMR_MMIO_PAGE_SHIFT 10
+#define UMR_MMIO_PAGE_SIZE (1UL << UMR_MMIO_PAGE_SHIFT)
+#define UMR_MMIO_MAX_PAGES (1UL << 16)
+
+// last bank state applied to a regs2 file
+struct umr_mmio2_state {
+	int valid,
+	    use_bank,
+	    pg_lock,
+	    xcc_id;
+	union umr_bank_select bank;
+};
+
+// per-thread register access state, while bound (see umr_access_ctx_bind())
+// the register functions use these fields instead of the shared
+// asic->options ones and access the regs2 interface through a private file
+struct umr_access_ctx {
+	struct umr_asic *asic;
+	int use_bank,
+	    pg_lock,
+	    context_reg_bank,
+	    vm_partition;
+	union umr_bank_select bank;
+	int fd_mmio2, fd_gprwave;
+	struct umr_mmio2_state mmio2_state;
+	struct umr_wave_field_cache *wave_fields;
+};
+
+// well known IP blocks, see umr_ip_block_by_kind()
+enum umr_ip_kind {
+	UMR_IP_GFX = 0,  // the GC block
+	UMR_IP_SDMA,
+	UMR_IP_VCN,
+	UMR_IP_MMHUB,
+	UMR_IP_OSS,      // also matches OSSSYS blocks, like umr_find_ip_block(asic, "oss", ...)
+	UMR_IP_OSSSYS,
+	UMR_IP_MAX,
+};
+
+#define UMR_IP_INDEX_INSTANCES 16
+
+// the blocks of each umr_ip_kind, rebuilt when asic->blocks changes
+struct umr_ip_index {
+	struct umr_ip_block **built_for; // asic->blocks the index was built from
+	int built_no_blocks;
+	struct umr_ip_block
+		*first[UMR_IP_MAX],                            // first block whose name starts with the IP name
+		*inst[UMR_IP_MAX][UMR_IP_INDEX_INSTANCES],     // ... by logical instance
+		*contains[UMR_IP_MAX];                         // first block whose name contains it
+};
+
 struct umr_asic {
 	char *asicname;
 	int no_blocks;
@@ -684,8 +1050,17 @@ struct umr_asic {
 				hive_id;
 			int callbacks_applied;
 			struct umr_xgmi_hive_info nodes[UMR_MAX_XGMI_DEVICES];
+			// hive linear address -> node routing (built once by umr_access_vram())
+			struct {
+				int resolved, no_nodes;
+				struct {
+					uint64_t base, size; // node owns hive addresses [base, base + size)
+					struct umr_asic *asic;
+				} node[UMR_MAX_XGMI_DEVICES];
+			} route;
 		} xgmi;
 		uint32_t data[512];
+		unsigned scanned; // UMR_CONFIG_SCAN_* groups read so far
 	} config;
 	struct {
 		int mmio,
@@ -706,21 +1081,90 @@ struct umr_asic {
 	struct {
 		uint64_t sq_ind_index;
 	} test_harness;
+	// last bank state applied to fd.mmio2, used to skip redundant SET_STATE ioctls
+	struct umr_mmio2_state mmio2_state;
 	struct {
-		struct pci_device *pdevice;
-		uint32_t *mem; // virtual address
+		struct pci_device *pdevice;   // only set when libpciaccess is needed, see umr_pci_system_get()
+		uint32_t *mem; // virtual address, use umr_pci_regs()
 		int region;
+		uint64_t size;  // bytes mapped at mem
+		int map_tried;  // the register BAR is mapped on first use
+		// window of the VRAM BAR mapped by umr_access_linear_vram_via_bar()
+		struct {
+			uint8_t *mem;
+			uint64_t base, size;
+			int resolved, region;
+		} vram;
 	} pci;
+	// CPUs and NUMA node local to the device, see umr_affinity_apply()
+	struct {
+		int node;       // -1 if unknown or not a NUMA machine
+		int no_cpus;    // 0 if the threads are not pinned
+		uint64_t cpus[UMR_MAX_CPUS / 64];
+	} numa;
+	// BYTE offsets of the index/data pairs used for indirect registers
+	// through the PCI BAR (resolved once on first use, see -O use_pci)
+	struct {
+		int resolved;
+		struct umr_ind_pair {
+			int ok;
+			uint32_t index, data, index_hi;  // index_hi == 0 if not present
+		} smc, pcie;
+	} ind_regs;
+	// BYTE offsets of the MM_INDEX/MM_INDEX_HI/MM_DATA VRAM window (resolved
+	// once on first use, see umr_access_vram_via_mmio())
+	struct {
+		int resolved;
+		uint32_t index, index_hi, data;
+	} mm_index;
 	struct umr_options options;
 	struct umr_dma_maps *maps;
 	struct umr_memory_access_funcs mem_funcs;
 	struct umr_register_access_funcs reg_funcs;
 	struct umr_wave_access_funcs wave_funcs;
 	struct umr_shader_disasm_funcs shader_disasm_funcs;
+	struct umr_disasm_cache *disasm_cache; // LLVM disassembler contexts, see umr_shader_disasm()
+	struct umr_disasm_text_cache *disasm_text; // disassembled shaders, see umr_shader_disasm_cached()
 	struct umr_read_gpr_funcs gpr_read_funcs;
 	struct umr_mmio_accel_data *mmio_accel;
 	struct umr_read_ring_func ring_func;
+	struct umr_ring_handle *ring_handles; // ring files kept open, see umr_read_ring_header()
+	struct umr_packet_arena *packet_arena; // set while a packet stream is decoded, see umr_packet_alloc()
+	struct umr_ib_cache *ib_cache;         // IBs read by that decode, see umr_packet_fetch_ib()
+	const struct umr_packet_filter *packet_filter; // packets kept by PM4 decodes, see umr_packet_filter_parse()
+	struct umr_decode_session *decode_session; // set while a session decodes, see umr_decode_session_create()
+	struct umr_capture *capture;           // accesses being recorded, see umr_capture_start()
+	struct umr_uring *uring; // optional io_uring backend (see -O use_io_uring)
+	struct umr_uq_registry *uq_registry; // user queue clients, see umr_uq_registry_refresh()
+	// /proc/<pid>/mem of the user queue process kept open between accesses
+	struct {
+		int fd;
+		uint32_t pid; // 0 if fd is not open
+	} proc_mem;
 	uint32_t mmio_accel_size;
+	uint32_t **mmio_pages, mmio_no_pages;
+	struct umr_reg_name_index *reg_index;
+	uint32_t reg_index_mask, reg_index_used;
+	int all_regs_loaded;        // no IP block has a pending source
+	struct umr_timing startup_timing; // set by umr_enumerate_device_list()
+	struct umr_io_stats io_stats; // always on, see umr_io_stats_get()
+	struct umr_wave_field_cache *wave_fields;
+	struct umr_wave_units *wave_units;      // CUs/WGPs that are not harvested, see umr_scan_wave_data()
+	struct umr_core_reg_cache *core_regs;   // see umr_core_reg()
+	struct umr_sysfs_cache *sysfs_cache;    // open sysfs files, see umr_sysfs_read()
+	struct umr_pp_cache *pp_cache;          // see umr_pp_cache_get()
+	struct umr_clock_cache *clock_cache;    // parsed pp_dpm_* files, see umr_read_clock()
+	struct umr_gfxoff_guard *gfxoff_guard;  // see umr_gfxoff_hold()
+	struct umr_drm_query_cache *drm_query_cache; // static AMDGPU_INFO results, see umr_query_drm()
+	struct umr_config_dirs *config_dirs;    // see umr_scan_config()
+	struct umr_vm_reg_cache *vm_regs;       // VM registers per hub/VMID
+	struct umr_vm_tlb *vm_tlb;              // cached VM translations, see umr_vm_tlb_flush()
+	struct {
+		int depth;                          // > 0 while VM registers read are reused
+		unsigned generation;                // bumped to re-read them, see umr_vm_context_begin()
+	} vm_context;
+	struct umr_reg_search_index *reg_search;
+	struct umr_ip_index ip_index;           // see umr_ip_block_by_kind()
 	int (*err_msg)(const char *fmt, ...);
 	int (*std_msg)(const char *fmt, ...);
 };
@@ -776,6 +1220,7 @@ struct umr_shaders_pgm {
 #include <umr_ih.h>
 #include <umr_vm.h>
 #include <umr_test_harness.h>
+#include <umr_capture.h>
 #include <umr_clock.h>
 #include <umr_database_discovery.h>
 
@@ -796,6 +1241,17 @@ struct umr_shaders_pgm {
 #define RST     (asic->options.use_colour ? "\x1b[0m" : "")
 
 void umr_bitfield_default(struct umr_asic *asic, char *asicname, char *ipname, char *regname, char *bitname, int start, int stop, uint32_t value);
+void umr_bitfield_print(struct umr_asic *asic, struct umr_ip_block *ip, struct umr_reg *reg, int bit, uint32_t value);
+void umr_bitfield_print_all(struct umr_asic *asic, struct umr_ip_block *ip, struct umr_reg *reg, uint64_t value);
+
+/* buffered output of the printers */
+struct umr_output *umr_output_open(int fd, size_t size, int threaded);
+void umr_output_flush(struct umr_output *out);
+void umr_output_close(struct umr_output *out);
+FILE *umr_output_begin(struct umr_asic *asic);
+FILE *umr_output_stream(struct umr_asic *asic);
+void umr_output_end(struct umr_asic *asic);
+FILE *umr_output_redirect(FILE *f);
 
 #if UMR_SERVER
 #include "parson.h"
@@ -803,14 +1259,27 @@ JSON_Value *umr_process_json_request(JSON_Object *request, void **raw_data, unsi
 void umr_run_gui(const char *url);
 #endif
 
+// a device as listed by umr_enumerate_device_ids()
+struct umr_device_id {
+	char pci_name[32];
+	uint32_t did;
+	int instance;
+};
+
+int umr_enumerate_device_ids(umr_err_output errout, struct umr_device_id **ids, int *no_ids);
 int umr_enumerate_device_list(umr_err_output errout, const char *database_path, struct umr_options *global_options, struct umr_asic ***asics, int *no_asics, int xgmi_scan);
 void umr_enumerate_device_list_free(struct umr_asic **asics);
 
 int umr_init_clientid(struct umr_asic *asic);
 struct umr_user_queue umr_parse_clientid(struct umr_asic *asic, const char *cid);
 int umr_read_user_queue_buffer(struct umr_asic *asic, uint32_t start, uint32_t end, uint32_t *buf, uint32_t *len);
+int umr_user_queue_view(struct umr_asic *asic, uint32_t start, uint32_t end, struct umr_ring_view *rv);
+uint64_t umr_ring_view_addr(const struct umr_ring_view *rv, uint32_t idx);
+void umr_ring_view_free(struct umr_ring_view *rv);
 
 struct umr_user_queue *umr_enumerate_user_queue_clients(struct umr_asic *asic);
 void umr_user_queue_free(struct umr_user_queue *uq);
+int umr_uq_registry_refresh(struct umr_asic *asic);
+void umr_uq_registry_free(struct umr_asic *asic);
 
 #endif
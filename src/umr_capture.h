@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#ifndef UMR_CAPTURE_H_
+#define UMR_CAPTURE_H_
+
+// capture bundles, everything a run reads from the hardware recorded in
+// one binary file that can be replayed on a machine without the GPU
+struct umr_capture_bundle;
+
+int umr_capture_start(struct umr_asic *asic);
+int umr_capture_write(struct umr_asic *asic, const char *fname);
+void umr_capture_stop(struct umr_asic *asic);
+
+struct umr_capture_bundle *umr_load_capture_bundle(const char *fname);
+const char *umr_capture_bundle_asicname(struct umr_capture_bundle *bundle);
+void umr_attach_capture_bundle(struct umr_capture_bundle *bundle, struct umr_asic *asic);
+void umr_free_capture_bundle(struct umr_capture_bundle *bundle);
+
+#endif
@@ -38,10 +38,28 @@ struct umr_asic_clocks {
 	struct umr_clock_source clocks[UMR_CLOCK_MAX];
 };
 
+// every clock domain and the performance level read at once
+struct umr_clock_snapshot {
+	struct umr_clock_source clocks[UMR_CLOCK_MAX]; // by UMR_CLOCK_*, clock_level is 0 if the domain is missing
+	char performance_level[32];                    // empty if it can't be read
+	uint32_t changed;  // (1 << UMR_CLOCK_*) of the files that changed since the last read, (1 << UMR_CLOCK_MAX) for the level
+};
+
 int umr_read_clock(struct umr_asic *asic, char* clockname, struct umr_clock_source* clock);
+int umr_read_clock_snapshot(struct umr_asic *asic, struct umr_clock_snapshot *snap);
+void umr_clock_cache_free(struct umr_asic *asic);
 int umr_set_clock(struct umr_asic *asic, const char* clock_name, void* value);
 void umr_set_clock_performance(struct umr_asic *asic, const char* operation);
 int umr_check_clock_performance(struct umr_asic *asic, char* name, uint32_t len);
 void umr_gfxoff_read(struct umr_asic *asic);
+void umr_gfxoff_hold(struct umr_asic *asic);
+void umr_gfxoff_release(struct umr_asic *asic);
+void umr_gfxoff_set_linger(struct umr_asic *asic, uint64_t linger_ns);
+void umr_gfxoff_guard_free(struct umr_asic *asic);
+
+// sysfs/debugfs text files kept open and re-read in place
+int umr_sysfs_read(struct umr_asic *asic, const char *path, char *buf, int size);
+int umr_sysfs_cache_refresh_start(struct umr_asic *asic, uint64_t period_ns);
+void umr_sysfs_cache_free(struct umr_asic *asic);
 
 #endif
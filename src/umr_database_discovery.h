@@ -41,6 +41,14 @@ struct umr_database_scan_item {
 	char path[256], fname[128], ipname[128];
 	int maj, min, rev;
 	struct umr_database_scan_item *next;
+	struct umr_database_scan_item *next_ip;      // next item with the same ipname
+	struct umr_database_scan_index *index;       // only set in the list head
+};
+
+// IP name hash over a scan list (see umr_database_scan())
+struct umr_database_scan_index {
+	uint32_t mask;
+	struct umr_database_scan_item **first;       // first item of each ipname
 };
 
 #define UMR_SOC15_MAX_INST 256
@@ -52,6 +60,13 @@ struct umr_soc15_database {
 	struct umr_soc15_database *next;
 };
 
+// where the registers of an IP block that has not been loaded yet come from
+struct umr_ip_block_source {
+	char *regpath;
+	uint64_t *seg;              // segment offsets for MMIO registers (or NULL)
+	int no_seg;
+};
+
 // vbios
 struct umr_vbios_info {
 	uint8_t name[64];
@@ -62,18 +77,42 @@ struct umr_vbios_info {
 	uint8_t date[32];
 };
 
+// the powerplay table and VBIOS info of a device, see umr_pp_cache_get()
+struct umr_pp_cache {
+	uint64_t hash;                // of the raw table and the VBIOS version
+	uint8_t *pp_table;            // raw pp_table (NULL if there is none)
+	uint32_t pp_table_size;
+	int have_vbios;
+	struct umr_vbios_info vbios;
+};
+
 struct umr_discovery_table_entry *umr_parse_ip_discovery(int instance, int *nblocks, umr_err_output errout);
 
 FILE *umr_database_open(char *path, char *filename, int binary);
+FILE *umr_database_open_path(char *path, char *filename, int binary, char *found, size_t len);
 struct umr_database_scan_item *umr_database_scan(char *path);
 struct umr_database_scan_item *umr_database_find_ip(
 	struct umr_database_scan_item *db,
 	char *ipname, int maj, int min, int rev,
 	char *desired_path);
 void umr_database_free_scan_items(struct umr_database_scan_item *it);
+struct umr_database_scan_item *umr_database_scan_find_ipname(struct umr_database_scan_item *db, const char *ipname);
 
 struct umr_soc15_database *umr_database_read_soc15(char *path, char *filename, umr_err_output errout);
 struct umr_ip_block *umr_database_read_ipblock(struct umr_soc15_database *soc15, char *path, char *filename, char *cmnname, char *soc15name, int inst, umr_err_output errout);
+int umr_database_read_ipblock_bin(const char *regpath, struct umr_ip_block *ip, uint8_t **segidx);
+void umr_database_free_ipblock_bin(struct umr_ip_block *ip);
+int umr_database_read_ipblock_regs(struct umr_ip_block *ip, const char *regpath, const uint64_t *seg, int no_seg, umr_err_output errout);
+void umr_database_free_ipblock_regs(struct umr_ip_block *ip);
+int umr_database_defer_ipblock(struct umr_ip_block *ip, const char *regpath, const uint64_t *seg, int no_seg);
+int umr_database_load_ipblock(struct umr_ip_block *ip, umr_err_output errout);
+void umr_database_free_ipblock_source(struct umr_ip_block_source *src);
+
+// interned register/bitfield name storage
+struct umr_name_pool *umr_name_pool_create(void);
+char *umr_name_pool_intern(struct umr_name_pool *pool, const char *name);
+void *umr_name_pool_alloc(struct umr_name_pool *pool, size_t size);
+void umr_name_pool_free(struct umr_name_pool *pool);
 struct umr_asic *umr_database_read_asic(struct umr_options *options, char *filename, umr_err_output errout);
 void umr_database_free_soc15(struct umr_soc15_database *soc15);
 
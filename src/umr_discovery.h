@@ -43,6 +43,21 @@ void umr_close_asic(struct umr_asic *asic); // call this to close a fully open a
 
 int umr_query_drm(struct umr_asic *asic, int field, void *ret, int size);
 int umr_query_drm_vbios(struct umr_asic *asic, int field, int type, void *ret, int size);
+void umr_query_drm_cache_free(struct umr_asic *asic);
+
+// one AMDGPU_INFO query of umr_query_drm_batch()
+struct umr_drm_query {
+	int field,
+	    type;      // the vbios_info type for AMDGPU_INFO_VBIOS, otherwise 0
+	void *ret;
+	int size,
+	    r;         // set to what umr_query_drm() returned
+};
+int umr_query_drm_batch(struct umr_asic *asic, struct umr_drm_query *q, int n);
+
+// the powerplay table and VBIOS info of a device, cached per asic
+const struct umr_pp_cache *umr_pp_cache_get(struct umr_asic *asic, int recheck);
+void umr_pp_cache_free(struct umr_asic *asic);
 
 int umr_get_ip_revision(struct umr_asic *asic, const char *ipname, int *maj, int *min, int *rev);
 
@@ -50,10 +65,38 @@ int umr_gfx_get_ip_ver(struct umr_asic *asic, int *maj, int *min);
 int umr_sdma_get_ip_ver(struct umr_asic *asic, int *maj, int *min);
 int umr_osssys_get_ip_ver(struct umr_asic *asic, int *maj, int *min);
 
+// groups of umr_scan_config_fields(), the hive is only read with xgmi_scan
+enum umr_config_scan {
+	UMR_CONFIG_SCAN_MEM       = 1 << 0, // VRAM/GTT sizes
+	UMR_CONFIG_SCAN_XGMI      = 1 << 1, // XGMI device ID
+	UMR_CONFIG_SCAN_XGMI_HIVE = 1 << 2, // the other nodes of the hive
+	UMR_CONFIG_SCAN_VBIOS     = 1 << 3, // VBIOS version
+	UMR_CONFIG_SCAN_FW        = 1 << 4, // firmware versions
+	UMR_CONFIG_SCAN_GCA       = 1 << 5, // amdgpu_gca_config
+
+	UMR_CONFIG_SCAN_DEFAULT   = UMR_CONFIG_SCAN_MEM | UMR_CONFIG_SCAN_XGMI |
+	                            UMR_CONFIG_SCAN_XGMI_HIVE | UMR_CONFIG_SCAN_GCA,
+	UMR_CONFIG_SCAN_ALL       = UMR_CONFIG_SCAN_DEFAULT | UMR_CONFIG_SCAN_VBIOS | UMR_CONFIG_SCAN_FW,
+};
+
 int umr_scan_config(struct umr_asic *asic, int xgmi_scan);
+int umr_scan_config_fields(struct umr_asic *asic, int xgmi_scan, unsigned want);
+void umr_free_config_dirs(struct umr_asic *asic);
 void umr_scan_config_gca_data(struct umr_asic *asic);
+// startup phase timing, the counters are process wide and always on
+void umr_timing_begin(enum umr_timing_phase phase);
+void umr_timing_end(enum umr_timing_phase phase);
+void umr_timing_count(enum umr_timing_phase phase, uint64_t files, uint64_t bytes);
+void umr_timing_get(struct umr_timing *t);
+void umr_timing_get_thread(struct umr_timing *t);
+void umr_timing_sub(struct umr_timing *t, const struct umr_timing *start);
+const char *umr_timing_phase_name(enum umr_timing_phase phase);
+void umr_timing_print(const struct umr_timing *t, FILE *f);
+
 void umr_apply_callbacks(struct umr_asic *asic,
 			 struct umr_memory_access_funcs *mems,
 			 struct umr_register_access_funcs *regs);
+int umr_xgmi_no_nodes(struct umr_asic *asic);
+struct umr_asic *umr_xgmi_node(struct umr_asic *asic, int n);
 
 #endif
@@ -54,5 +54,60 @@ struct umr_ih_decode_ui {
 
 // decode interrupt vectors
 int umr_ih_decode_vectors(struct umr_asic *asic, struct umr_ih_decode_ui *ui, uint32_t *ih_data, uint32_t length);
+int umr_ih_decode_vector(struct umr_asic *asic, struct umr_ih_decode_ui *ui, uint32_t *ih_data, uint32_t off);
+
+/* the fields of an interrupt vector used to filter and count them */
+struct umr_ih_vector {
+	uint32_t client_id, source_id, ring_id,
+		vmid, vmid_type, pasid;
+	uint64_t timestamp;
+	uint32_t context[4];
+};
+
+/* match any value with -1 */
+struct umr_ih_filter {
+	int client_id, source_id, vmid, pasid;
+};
+
+// vectors per second of a ClientID/SourceID pair over the last
+// UMR_IH_RATE_SLOTS seconds
+#define UMR_IH_RATE_SLOTS 8
+struct umr_ih_source_rate {
+	uint32_t client_id, source_id;
+	uint64_t total;
+	uint32_t slots[UMR_IH_RATE_SLOTS];
+};
+
+/* a live reader of the IH ring, see umr_ih_ring_init() */
+struct umr_ih_ring {
+	struct umr_reg *cntl, *base, *base_hi, *rptr, *wptr;
+
+	uint64_t addr;        // bus address or GPU address (vmid 0 of the MM hub)
+	int bus_addr;
+	uint32_t size,        // in bytes
+		vector_size,      // in bytes
+		cursor;           // byte offset of the next vector to decode
+
+	struct umr_ih_filter filter;
+
+	uint64_t vectors,     // decoded
+		filtered,         // decoded but not passed to the ui
+		overflows;        // times the hardware reported it lapped the reader
+
+	uint64_t now_sec;     // the second slots[now_sec % UMR_IH_RATE_SLOTS] counts
+	struct umr_ih_source_rate *rates; // sorted by client_id/source_id
+	int no_rates;
+
+	uint32_t *buf;
+};
+
+int umr_ih_vector_size(struct umr_asic *asic);
+int umr_ih_parse_vector(struct umr_asic *asic, const uint32_t *data, struct umr_ih_vector *v);
+int umr_ih_filter_match(const struct umr_ih_filter *f, const struct umr_ih_vector *v);
+int umr_ih_ring_init(struct umr_asic *asic, struct umr_ih_ring *ih, int from_rptr);
+int umr_ih_ring_poll(struct umr_asic *asic, struct umr_ih_ring *ih, struct umr_ih_decode_ui *ui);
+int umr_ih_ring_decode(struct umr_asic *asic, struct umr_ih_ring *ih, uint32_t wptr, uint64_t now_sec, struct umr_ih_decode_ui *ui);
+uint32_t umr_ih_source_rate(const struct umr_ih_source_rate *r);
+void umr_ih_ring_free(struct umr_ih_ring *ih);
 
 #endif
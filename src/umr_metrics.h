@@ -1050,4 +1050,18 @@ struct umr_key_value {
 
 struct umr_key_value *umr_dump_metrics(struct umr_asic *asic, const void *table, uint32_t size);
 
+// where the fields of one revision and size of the GPU metrics table are
+struct umr_metrics_layout {
+	uint32_t version, size;
+	int no_fields;
+	struct {
+		const char *prefix, *name;
+		uint32_t size, offset;
+	} fields[UMR_MAX_KEYS];
+};
+
+int umr_metrics_resolve_layout(struct umr_asic *asic, const void *table, uint32_t size, struct umr_metrics_layout *layout);
+int umr_metrics_decode(const struct umr_metrics_layout *layout, const void *table, uint32_t size,
+		       uint64_t *values, uint8_t *changed);
+
 #endif
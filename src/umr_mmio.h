@@ -28,11 +28,20 @@
 /* ==== MMIO Functions ====
  * These functions deal with looking up, reading, and writing registers and bitslices.
  */
-// init the mmio lookup table
+// init the mmio lookup table (also builds the register name index)
 int umr_create_mmio_accel(struct umr_asic *asic);
+int umr_create_reg_name_index(struct umr_asic *asic);
+uint32_t umr_reg_name_hash(const char *regname);
 
 // find ip block with optional instance
 struct umr_ip_block *umr_find_ip_block(const struct umr_asic *asic, const char *ipname, int instance);
+struct umr_ip_block *umr_ip_block_by_kind(const struct umr_asic *asic, enum umr_ip_kind ip, int instance);
+int umr_ip_version_by_kind(const struct umr_asic *asic, enum umr_ip_kind ip, int instance, int *maj, int *min, int *rev);
+struct umr_ip_block *umr_ip_block_containing(const struct umr_asic *asic, const char *ipname);
+
+// load the registers of IP blocks created without them (NULL == all blocks)
+int umr_load_ip_block(struct umr_asic *asic, struct umr_ip_block *ip);
+int umr_load_ip_blocks(struct umr_asic *asic, const char *ipname);
 
 // find the word address of a register
 uint32_t umr_find_reg(struct umr_asic *asic, const char *regname);
@@ -40,9 +49,15 @@ uint32_t umr_find_reg(struct umr_asic *asic, const char *regname);
 // wildcard searches
 struct umr_find_reg_iter *umr_find_reg_wild_first(struct umr_asic *asic, const char *ip, const char *reg);
 struct umr_find_reg_iter_result umr_find_reg_wild_next(struct umr_find_reg_iter **iterp);
+void umr_free_reg_search_index(struct umr_asic *asic);
 
 // find a register and return a printable name (used for human readable output)
 char *umr_reg_name(struct umr_asic *asic, uint64_t addr);
+// same but thread-safe, the name is written to @buf
+char *umr_reg_name_r(struct umr_asic *asic, uint64_t addr, char *buf, size_t len);
+
+// find the MMIO accel entry (register, IP block, flags) for a DWORD address
+struct umr_mmio_accel_data *umr_find_mmio_accel(struct umr_asic *asic, uint64_t addr);
 
 // find the register data for a register
 struct umr_reg* umr_find_reg_data_by_ip_by_instance_with_ip(struct umr_asic* asic, const char* ip, int inst, const char* regname, struct umr_ip_block **ipp);
@@ -53,9 +68,215 @@ struct umr_reg *umr_find_reg_by_name(struct umr_asic *asic, const char *regname,
 struct umr_reg *umr_find_reg_by_addr(struct umr_asic *asic, uint64_t addr, struct umr_ip_block **ip);
 
 // read/write a 32-bit register given a BYTE address
+// the register BAR used with -O use_pci, mapped on first use
+uint32_t *umr_pci_map_regs(struct umr_asic *asic);
+void umr_pci_unmap_regs(struct umr_asic *asic);
+static inline uint32_t *umr_pci_regs(struct umr_asic *asic)
+{
+	if (!asic->pci.mem && asic->options.use_pci && !asic->pci.map_tried)
+		return umr_pci_map_regs(asic);
+	return asic->pci.mem;
+}
+
+// libpciaccess shared by every asic that needs it
+int umr_pci_system_get(void);
+void umr_pci_system_put(void);
+
+// threads working on a device run on its local CPUs
+void umr_affinity_init(struct umr_asic *asic);
+int umr_affinity_apply(struct umr_asic *asic);
+
+// long lived tables and large buffers on huge pages where the system allows it
+void *umr_huge_alloc(size_t size);
+void umr_huge_free(void *p);
+
 uint32_t umr_read_reg(struct umr_asic *asic, uint64_t addr, enum regclass type);
 int umr_write_reg(struct umr_asic *asic, uint64_t addr, uint32_t value, enum regclass type);
 
+// read/write a 64-bit LO/HI register pair with a single access where possible
+uint64_t umr_read_reg64(struct umr_asic *asic, uint64_t addr, enum regclass type);
+int umr_write_reg64(struct umr_asic *asic, uint64_t addr, uint64_t value, enum regclass type);
+
+// read/write a register (both halves if bit64) through asic->reg_funcs
+uint64_t umr_read_reg_by_reg(struct umr_asic *asic, struct umr_reg *reg);
+int umr_write_reg_by_reg(struct umr_asic *asic, struct umr_reg *reg, uint64_t value);
+
+// batched register access, entries are grouped by bank state so each group
+// costs a single bank select on the regs2 interface
+struct umr_reg_batch {
+	uint64_t addr;              // BYTE address
+	enum regclass type;
+	int use_bank;               // 0 == none, 1 == GRBM, 2 == SRBM (same as options.use_bank)
+	union umr_bank_select bank;
+	uint32_t value;             // value read or value to write
+};
+int umr_read_regs_batch(struct umr_asic *asic, struct umr_reg_batch *regs, int no_regs);
+int umr_write_regs_batch(struct umr_asic *asic, struct umr_reg_batch *regs, int no_regs);
+
+// bitfields of many registers set with one read and one write per register
+struct umr_field_update {
+	struct umr_reg *reg;
+	const char *bitname;        // NULL to set the whole register
+	uint64_t value;             // value of the field (not shifted)
+	int use_bank;               // 0 == none, 1 == GRBM, 2 == SRBM (as umr_reg_batch)
+	union umr_bank_select bank;
+	uint64_t result;            // register value written (or read back), see umr_write_fields()
+};
+#define UMR_WRITE_FIELDS_VERIFY 1
+int umr_write_fields(struct umr_asic *asic, struct umr_field_update *updates, int no_updates, int flags);
+
+// whole IP block register snapshots
+struct umr_reg_snapshot {
+	int no_blocks;
+	struct {
+		struct umr_ip_block *ip;
+		uint64_t *values;           // indexed like ip->regs[]
+		uint8_t *valid;             // non-zero if values[] holds a captured value
+	} *blocks;
+};
+struct umr_reg_snapshot *umr_reg_snapshot_create(struct umr_asic *asic, const char *ipname);
+struct umr_reg_snapshot *umr_reg_snapshot_capture(struct umr_asic *asic, const char *ipname);
+struct umr_reg_snapshot *umr_reg_snapshot_load(struct umr_asic *asic, const char *ipname, const char *path);
+int umr_reg_snapshot_save(struct umr_asic *asic, struct umr_reg_snapshot *snap, const char *path);
+int umr_reg_snapshot_diff(struct umr_asic *asic, struct umr_reg_snapshot *a, struct umr_reg_snapshot *b, FILE *out);
+void umr_reg_snapshot_free(struct umr_reg_snapshot *snap);
+
+// free running counter of a GPU mapped onto CLOCK_MONOTONIC_RAW
+struct umr_gpu_clock {
+	struct umr_reg_handle lo, hi;
+	int valid;
+	uint64_t anchor_ticks, anchor_ns;   // first calibration point
+	uint64_t base_ticks, base_ns;       // latest calibration point
+	double ns_per_tick;
+};
+int umr_gpu_clock_init(struct umr_asic *asic, struct umr_gpu_clock *clk);
+int umr_gpu_clock_calibrate(struct umr_asic *asic, struct umr_gpu_clock *clk);
+uint64_t umr_gpu_clock_read(struct umr_asic *asic, const struct umr_gpu_clock *clk);
+uint64_t umr_gpu_clock_to_ns(const struct umr_gpu_clock *clk, uint64_t ticks);
+uint64_t umr_gpu_clock_now(struct umr_asic *asic, const struct umr_gpu_clock *clk);
+
+// sampling step that follows the activity of the GPU, see umr_sample_rate_update()
+struct umr_sample_rate {
+	uint64_t min_ns, max_ns, step_ns;
+	unsigned cpu_budget;        // percent of one CPU, 0 for no limit
+	double mean, var;           // of the activity reported
+	double cpu_share;           // of the sampling thread
+	uint64_t last_ns;           // CLOCK_MONOTONIC time of the last report
+	uint64_t last_cpu_ns;
+};
+void umr_sample_rate_init(struct umr_sample_rate *sr, uint64_t min_ns, uint64_t max_ns, unsigned cpu_budget);
+uint64_t umr_sample_rate_update(struct umr_sample_rate *sr, double activity);
+
+// register bitfields summed over time on a thread of their own
+struct umr_reg_sampler;
+struct umr_reg_sampler *umr_reg_sampler_start(struct umr_asic *asic, struct umr_reg **regs, int no_regs,
+					      uint64_t step_ns, uint64_t period_ns);
+struct umr_reg_sampler *umr_reg_sampler_start_adaptive(struct umr_asic *asic, struct umr_reg **regs, int no_regs,
+						       const struct umr_sample_rate *rate, uint64_t period_ns);
+int umr_reg_sampler_read(struct umr_reg_sampler *s, uint64_t *counters, uint64_t *samples, uint64_t *missed);
+int umr_reg_sampler_fields(struct umr_reg_sampler *s);
+void umr_reg_sampler_wait(struct umr_reg_sampler *s);
+void umr_reg_sampler_stop(struct umr_reg_sampler *s);
+
+// per VF activity of an SR-IOV device sampled from the PF
+#define UMR_SRIOV_MAX_VFS 31        // the PF is bit 31 of the RLC IOV status registers
+struct umr_sriov_vf {
+	int index;                  // VF number, its bit in the RLC IOV status registers
+	char pci_name[32];          // dddd:bb:ss.f
+	int instance;               // debugfs DRI instance if bound to amdgpu on the host, else -1
+};
+struct umr_sriov_fcn_stats {
+	uint64_t active,            // samples in which the function owned the GFX engine
+		 gfx_busy,          // samples with its VM busy
+		 sdma_busy,         // samples with any of its SDMA queues busy
+		 doorbell,          // samples with a doorbell of it pending
+		 switches;          // world switches to the function
+	int has_rings;              // the fences below could be read (VF instance on the host)
+	uint64_t fences;            // fences signaled on its kernel rings
+};
+int umr_sriov_list_vfs(struct umr_asic *asic, struct umr_sriov_vf *vfs, int max);
+struct umr_sriov_sampler;
+struct umr_sriov_sampler *umr_sriov_sampler_open(struct umr_asic *asic, const struct umr_sriov_vf *vfs, int no_vfs);
+int umr_sriov_sampler_sample(struct umr_sriov_sampler *s);
+int umr_sriov_sampler_take(struct umr_sriov_sampler *s, struct umr_sriov_fcn_stats *stats, uint64_t *samples);
+void umr_sriov_sampler_close(struct umr_sriov_sampler *s);
+
+// registers polled for trigger conditions, a snapshot is taken on each hit
+enum umr_reg_watch_edge {
+	UMR_REG_WATCH_LEVEL = 0,    // every poll where (value & mask) == match
+	UMR_REG_WATCH_RISING,       // polls where it becomes true
+	UMR_REG_WATCH_FALLING,      // polls where it becomes false
+	UMR_REG_WATCH_CHANGE,       // polls where (value & mask) changed
+};
+struct umr_reg_watch_trigger {
+	int reg;                    // index in umr_reg_watch_config.regs
+	uint64_t mask, match;
+	enum umr_reg_watch_edge edge;
+	int stop;                   // stop the watch when this fires
+};
+struct umr_reg_watch_config {
+	struct umr_reg **regs;      // polled, read without any bank selected
+	int no_regs;
+	struct umr_reg_watch_trigger *triggers;
+	int no_triggers;
+	struct umr_reg **snap_regs; // read when a trigger fires
+	int no_snap_regs;
+	char **rings;               // rings whose pointers are read when a trigger fires
+	int no_rings;
+	int waves;                  // scan the waves when a trigger fires (slow)
+	uint64_t step_ns;           // time between polls, 0 polls back to back
+	uint64_t period_ns;         // how long to poll, 0 until stopped
+	int capacity;               // hits kept, the oldest are overwritten (0 == 64)
+};
+struct umr_reg_watch_hit {
+	uint64_t time_ns;           // CLOCK_MONOTONIC of the poll that fired
+	uint64_t poll;              // which poll fired
+	int trigger;                // which trigger fired
+	uint64_t *values;           // the polled registers at that poll
+	uint64_t *snap_values;      // the snapshot registers
+	uint32_t (*ring_ptrs)[3];   // rptr/wptr/dwptr of each ring
+	struct umr_wave_data *waves;
+	uint64_t capture_ns;        // poll to registers and rings captured
+	uint64_t gpu_ns;            // GPU time of the capture, see umr_gpu_clock_now(), 0 if unknown
+};
+struct umr_reg_watch;
+struct umr_reg_watch *umr_reg_watch_start(struct umr_asic *asic, const struct umr_reg_watch_config *cfg);
+int umr_reg_watch_status(struct umr_reg_watch *w, uint64_t *polls, uint64_t *hits);
+void umr_reg_watch_wait(struct umr_reg_watch *w);
+void umr_reg_watch_stop(struct umr_reg_watch *w);
+const struct umr_reg_watch_hit *umr_reg_watch_get(struct umr_reg_watch *w, int n);
+void umr_reg_watch_free(struct umr_reg_watch *w);
+
+// io_uring backend for debugfs register/memory access
+struct umr_uring_op {
+	int fd, write_en;
+	uint64_t offset;
+	void *buf;
+	uint32_t len;
+	int res;                    // bytes transferred or -errno
+};
+int umr_uring_init(struct umr_asic *asic);
+void umr_uring_fini(struct umr_asic *asic);
+int umr_uring_submit(struct umr_asic *asic, struct umr_uring_op *ops, int no_ops);
+uint32_t umr_read_reg_uring(struct umr_asic *asic, uint64_t addr, enum regclass type);
+int umr_write_reg_uring(struct umr_asic *asic, uint64_t addr, uint32_t value, enum regclass type);
+
+// syscall accounting (see struct umr_io_stats), the wrappers behave like
+// the calls they are named after
+struct iovec;
+uint64_t umr_io_now(void);
+void umr_io_account(struct umr_asic *asic, enum umr_io_class cls, enum umr_io_op op, int64_t bytes, uint64_t ns);
+enum umr_io_class umr_io_class_of_fd(struct umr_asic *asic, int fd);
+ssize_t umr_io_read(struct umr_asic *asic, enum umr_io_class cls, int fd, void *buf, size_t size);
+ssize_t umr_io_write(struct umr_asic *asic, enum umr_io_class cls, int fd, const void *buf, size_t size);
+ssize_t umr_io_pread(struct umr_asic *asic, enum umr_io_class cls, int fd, void *buf, size_t size, off_t offset);
+ssize_t umr_io_pwrite(struct umr_asic *asic, enum umr_io_class cls, int fd, const void *buf, size_t size, off_t offset);
+ssize_t umr_io_preadv(struct umr_asic *asic, enum umr_io_class cls, int fd, const struct iovec *iov, int iovcnt, off_t offset);
+int umr_io_ioctl(struct umr_asic *asic, enum umr_io_class cls, int fd, unsigned long request, void *arg);
+void umr_io_stats_get(struct umr_asic *asic, struct umr_io_stats *st);
+const char *umr_io_class_name(enum umr_io_class cls);
+void umr_io_stats_print(const struct umr_io_stats *st, FILE *f);
+
 // read/write a register given a name
 uint64_t umr_read_reg_by_name(struct umr_asic *asic, char *name);
 int umr_write_reg_by_name(struct umr_asic *asic, char *name, uint64_t value);
@@ -74,6 +295,7 @@ uint64_t umr_bitslice_reg_quiet(struct umr_asic *asic, struct umr_reg *reg, char
 uint64_t umr_bitslice_reg_by_name(struct umr_asic *asic, char *regname, char *bitname, uint64_t regvalue);
 uint64_t umr_bitslice_reg_by_name_by_ip(struct umr_asic *asic, char *ip, char *regname, char *bitname, uint64_t regvalue);
 uint64_t umr_bitslice_reg_by_name_by_ip_by_instance(struct umr_asic *asic, char *ip, int instance, char *regname, char *bitname, uint64_t regvalue);
+int umr_bitslice_all(struct umr_reg *reg, uint64_t regvalue, uint64_t *out);
 
 // compose a 64-bit register with a value and a bitfield
 uint64_t umr_bitslice_compose_value(struct umr_asic *asic, struct umr_reg *reg, char *bitname, uint64_t regvalue);
@@ -81,8 +303,109 @@ uint64_t umr_bitslice_compose_value_by_name(struct umr_asic *asic, char *reg, ch
 uint64_t umr_bitslice_compose_value_by_name_by_ip(struct umr_asic *asic, char *ip, char *regname, char *bitname, uint64_t regvalue);
 uint64_t umr_bitslice_compose_value_by_name_by_ip_by_instance(struct umr_asic *asic, char *ip, int instance, char *regname, char *bitname, uint64_t regvalue);
 
+// pre-resolved register/bitfield handles for hot paths
+int umr_reg_handle_resolve(struct umr_asic *asic, const char *ip, int inst, const char *regname, struct umr_reg_handle *h);
+int umr_field_handle_resolve(struct umr_asic *asic, struct umr_reg *reg, const char *bitname, struct umr_field_handle *fh);
+uint64_t umr_reg_handle_read(struct umr_asic *asic, const struct umr_reg_handle *h);
+
+static inline uint64_t umr_field_get(const struct umr_field_handle *fh, uint64_t regvalue)
+{
+	return (regvalue >> fh->shift) & fh->mask;
+}
+
+static inline uint64_t umr_field_compose(const struct umr_field_handle *fh, uint64_t value)
+{
+	return (value & fh->mask) << fh->shift;
+}
+
+// registers hot paths use by a fixed name, resolved once per device
+// (and GFX instance) then found by ID, see umr_core_reg()
+enum umr_core_reg_id {
+	UMR_CORE_SQ_CMD = 0,
+	UMR_CORE_CP_HQD_ACTIVE,
+	UMR_CORE_CP_HQD_VMID,
+	UMR_CORE_CP_HQD_PQ_BASE,
+	UMR_CORE_CP_HQD_PQ_BASE_HI,
+	UMR_CORE_CP_HQD_PQ_RPTR,
+	UMR_CORE_CP_HQD_PQ_WPTR,
+	UMR_CORE_CP_HQD_PQ_WPTR_LO,
+	UMR_CORE_CP_HQD_PQ_WPTR_HI,
+	UMR_CORE_CP_HQD_PQ_RPTR_REPORT_ADDR,
+	UMR_CORE_CP_HQD_PQ_RPTR_REPORT_ADDR_HI,
+	UMR_CORE_CP_HQD_PQ_CONTROL,
+	UMR_CORE_CP_HQD_EOP_BASE_ADDR,
+	UMR_CORE_CP_HQD_EOP_BASE_ADDR_HI,
+	UMR_CORE_CP_HQD_EOP_RPTR,
+	UMR_CORE_CP_HQD_EOP_WPTR,
+	UMR_CORE_CP_HQD_EOP_WPTR_MEM,
+	UMR_CORE_CP_MQD_BASE_ADDR,
+	UMR_CORE_CP_MQD_BASE_ADDR_HI,
+	UMR_CORE_CP_HQD_DEQUEUE_REQUEST,
+	UMR_CORE_CP_HQD_IQ_TIMER,
+	UMR_CORE_CP_HQD_AQL_CONTROL,
+	UMR_CORE_CP_HQD_CTX_SAVE_BASE_ADDR_LO,
+	UMR_CORE_CP_HQD_CTX_SAVE_BASE_ADDR_HI,
+	UMR_CORE_CP_HQD_CTX_SAVE_SIZE,
+	UMR_CORE_CP_HQD_CNTL_STACK_OFFSET,
+	UMR_CORE_CP_HQD_CNTL_STACK_SIZE,
+	UMR_CORE_CP_GFX_HQD_CNTL,
+	UMR_CORE_SDMA0_QUEUE0_RB_CNTL,
+
+	UMR_CORE_REG_MAX,
+};
+struct umr_reg *umr_core_reg(struct umr_asic *asic, enum umr_core_reg_id id);
+uint64_t umr_read_core_reg(struct umr_asic *asic, enum umr_core_reg_id id);
+uint64_t umr_bitslice_core_reg(struct umr_asic *asic, enum umr_core_reg_id id, char *bitname, uint64_t regvalue);
+const char *umr_core_reg_name(enum umr_core_reg_id id);
+void umr_free_core_regs(struct umr_asic *asic);
+
+// HQD state of every CP queue read in one batch, see umr_cp_queues_read()
+enum umr_cp_queue_kind {
+	UMR_CP_QUEUES_COMPUTE = 0,  // MEC (and MES) queues
+	UMR_CP_QUEUES_GFX,          // ME (gfx) queues
+};
+struct umr_cp_queue_state {
+	uint32_t me, pipe, queue;
+	uint32_t active, vmid;
+	uint64_t base;              // ring base in bytes (PQ_BASE or GFX_HQD_BASE)
+	uint64_t wptr, rptr_addr, mqd_base;
+	uint32_t rptr, cntl, deq_req, iq_timer;
+	// compute only
+	uint64_t eop_base, save_base;
+	uint32_t eop_rptr, eop_wptr, eop_wptr_mem, aql_cntl;
+	uint32_t save_size, stack_offset, stack_size;
+	// gfx only
+	uint32_t csmd_rptr, offset;
+};
+struct umr_cp_pipe_state {
+	uint32_t me, pipe;
+	uint32_t instr_pntr, int_stat_debug;
+	uint8_t has_iptr, has_istat;
+};
+struct umr_cp_queues {
+	enum umr_cp_queue_kind kind;
+	int no_queues, no_pipes;
+	struct umr_cp_queue_state *queues;
+	struct umr_cp_pipe_state *pipes;
+};
+int umr_cp_queues_read(struct umr_asic *asic, enum umr_cp_queue_kind kind, struct umr_cp_queues *cq);
+void umr_cp_queues_free(struct umr_cp_queues *cq);
+
 // bank switching
 uint64_t umr_apply_bank_selection_address(struct umr_asic *asic);
+void umr_mmio2_invalidate_bank(struct umr_asic *asic);
+
+// per-thread register access contexts (bank, pg_lock, partition and regs2 file)
+struct umr_access_ctx *umr_access_ctx_create(struct umr_asic *asic);
+void umr_access_ctx_free(struct umr_access_ctx *ctx);
+struct umr_access_ctx *umr_access_ctx_bind(struct umr_access_ctx *ctx);
+struct umr_access_ctx *umr_access_ctx_current(struct umr_asic *asic);
+
+// work on every XCC of a partitioned device at once (see umr_xcc_run())
+typedef int (*umr_xcc_fn)(struct umr_asic *asic, void *data);
+int umr_xcc_count(struct umr_asic *asic);
+int umr_xcc_current(void);
+int umr_xcc_run(struct umr_asic *asic, umr_xcc_fn fn, void *data);
 
 // select a GRBM_GFX_IDX
 int umr_grbm_select_index(struct umr_asic *asic, uint32_t se, uint32_t sh, uint32_t instance);
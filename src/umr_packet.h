@@ -195,8 +195,38 @@ struct umr_packet_stream {
 	void *cont;
 
 	struct umr_stream_decode_ui *ui;
+
+	// owns every node of the stream if set, see umr_packet_alloc()
+	struct umr_packet_arena *arena;
 };
 
+// memory for decoded packets, taken from the arena of the decode in progress if any
+void *umr_packet_alloc(struct umr_asic *asic, size_t size);
+void umr_packet_release(struct umr_asic *asic, void *p);
+
+// IBs and shader sizes referenced by packets, read once per decode
+uint32_t *umr_packet_fetch_ib(struct umr_asic *asic, int vm_partition, uint32_t vmid, uint64_t addr, uint32_t size);
+void umr_packet_release_ib(struct umr_asic *asic, uint32_t *words);
+uint32_t umr_packet_shader_size(struct umr_asic *asic, int vm_partition, struct umr_shaders_pgm *shader);
+
+// packets to keep while decoding, set asic->packet_filter to apply one
+#define UMR_PACKET_FILTER_OPCODE 1  // PM4 type 3 opcode in opcodes[]
+#define UMR_PACKET_FILTER_REG    2  // writes a register in [reg_lo, reg_hi]
+#define UMR_PACKET_FILTER_VA     4  // references memory in [va_lo, va_hi]
+#define UMR_PACKET_FILTER_VMID   8  // submitted in vmid
+struct umr_packet_filter {
+	unsigned flags;
+	uint32_t opcodes[8];
+	uint32_t reg_lo, reg_hi;
+	uint64_t va_lo, va_hi;
+	uint32_t vmid;
+};
+
+void umr_packet_filter_init(struct umr_packet_filter *f);
+void umr_packet_filter_add_opcode(struct umr_packet_filter *f, uint32_t opcode);
+int umr_packet_filter_parse(struct umr_asic *asic, const char *spec, struct umr_packet_filter *f);
+int umr_packet_filter_ib_pruned(const struct umr_packet_filter *f, uint32_t vmid);
+
 // decode an array of dwords into a packet stream
 struct umr_packet_stream *umr_packet_decode_buffer_ex(struct umr_asic *asic, struct umr_stream_decode_ui *ui,
 	uint32_t from_vmid, uint64_t from_addr,
@@ -206,6 +236,10 @@ struct umr_packet_stream *umr_packet_decode_buffer(struct umr_asic *asic, struct
 	uint32_t from_vmid, uint64_t from_addr,
 	uint32_t *stream, uint32_t nwords, enum umr_ring_type rt, void *queue_data);
 
+// decode the span of a ring read with umr_user_queue_view()
+struct umr_packet_stream *umr_packet_decode_view(struct umr_asic *asic, struct umr_stream_decode_ui *ui,
+	uint32_t from_vmid, const struct umr_ring_view *rv, enum umr_ring_type rt, void *queue_data, int32_t ip_version);
+
 // decode a ring file (debugfs) into a packet stream
 struct umr_packet_stream *umr_packet_decode_ring(struct umr_asic *asic, struct umr_stream_decode_ui *ui,
 	char *ringname, int halt_waves, int *start, int *stop, enum umr_ring_type rt, void *queue_data);
@@ -214,6 +248,31 @@ struct umr_packet_stream *umr_packet_decode_ring(struct umr_asic *asic, struct u
 struct umr_packet_stream *umr_packet_decode_ring_ex(struct umr_asic *asic, struct umr_stream_decode_ui *ui,
 	char *ringname, int halt_waves, int *start, int *stop, enum umr_ring_type rt, void *queue_data, int32_t ip_version);
 
+// the type of packets a kernel ring carries, UMR_RING_UNK if not known
+enum umr_ring_type umr_ring_type_by_name(const char *ringname);
+
+// several kernel rings and the CP queue state read in one wave halt, see umr_ring_capture()
+struct umr_ring_capture_ring {
+	char name[64];
+	enum umr_ring_type rt;
+	int ok;                     // the ring could be read
+	uint32_t rptr, wptr, dwptr; // reduced modulo the ring size
+	uint32_t *words, nwords;    // the whole ring
+};
+struct umr_ring_capture {
+	struct umr_ring_capture_ring *rings;
+	int no_rings;
+	struct umr_cp_queues compute, gfx;
+	int have_compute, have_gfx;
+	int halted;
+	uint64_t halt_us;           // how long the waves were halted for
+};
+struct umr_ring_capture *umr_ring_capture(struct umr_asic *asic, char **ringnames, int no_rings, int workers);
+uint32_t *umr_ring_capture_span(const struct umr_ring_capture_ring *ring, uint32_t *nwords);
+struct umr_packet_stream *umr_ring_capture_decode(struct umr_asic *asic, struct umr_stream_decode_ui *ui,
+	struct umr_ring_capture *cap, int idx, void *queue_data);
+void umr_ring_capture_free(struct umr_ring_capture *cap);
+
 // decode a GPU mapped buffer into a packet stream
 struct umr_packet_stream *umr_packet_decode_vm_buffer_ex(struct umr_asic *asic, struct umr_stream_decode_ui *ui,
 	uint32_t vmid, uint64_t addr, uint32_t nwords, enum umr_ring_type rt, void *queue_data, int32_t ip_version);
@@ -224,6 +283,57 @@ struct umr_packet_stream *umr_packet_decode_vm_buffer_ex(struct umr_asic *asic,
 // free a (umr) packet stream from memory
 void umr_packet_free(struct umr_packet_stream *stream);
 
+// decode many buffers or ring snapshots of one type against shared state
+enum umr_decode_session_flags {
+	UMR_DECODE_SESSION_KEEP = 1, // keep IBs, shader sizes and the VM setup until umr_decode_session_invalidate()
+};
+
+struct umr_decode_session;
+
+struct umr_decode_session *umr_decode_session_create(struct umr_asic *asic, struct umr_stream_decode_ui *ui,
+	enum umr_ring_type rt, int32_t ip_version, unsigned flags);
+struct umr_packet_stream *umr_decode_session_buffer(struct umr_decode_session *sess, uint32_t from_vmid, uint64_t from_addr,
+	uint32_t *stream, uint32_t nwords, void *queue_data);
+struct umr_packet_stream *umr_decode_session_ring(struct umr_decode_session *sess, char *ringname, int halt_waves,
+	int *start, int *stop, void *queue_data);
+void umr_decode_session_release(struct umr_decode_session *sess, struct umr_packet_stream *stream);
+void umr_decode_session_invalidate(struct umr_decode_session *sess);
+void umr_decode_session_free(struct umr_decode_session *sess);
+
+// decode a buffer handed over in pieces, presenting packets as they complete
+struct umr_packet_feed;
+
+struct umr_packet_feed *umr_packet_feed_create(struct umr_asic *asic, struct umr_stream_decode_ui *ui,
+	enum umr_ring_type rt, int32_t ip_version, uint32_t from_vmid, uint64_t from_addr,
+	void (*present)(struct umr_packet_stream *str, uint64_t addr, uint32_t vmid, void *data), void *data);
+int umr_packet_feed_push(struct umr_packet_feed *feed, const uint32_t *words, uint32_t nwords);
+int umr_packet_feed_finish(struct umr_packet_feed *feed);
+int umr_packet_feed_file(struct umr_packet_feed *feed, const char *filename);
+void umr_packet_feed_free(struct umr_packet_feed *feed);
+
+// where the packets of a buffer are, see umr_packet_index_buffer()
+struct umr_packet_index_entry {
+	uint32_t offset,	// in words from the start of the buffer
+		 nwords,	// including the header
+		 header,
+		 opcode,
+		 subop;
+	int pkttype;
+	const char *name;	// NULL if the packet has no name
+};
+
+struct umr_packet_index {
+	enum umr_ring_type rt;
+	struct umr_packet_index_entry *entries;
+	uint32_t no_entries, max_entries;
+};
+
+// frame the packets of a buffer now and decode them later
+struct umr_packet_index *umr_packet_index_buffer(struct umr_asic *asic, uint32_t *stream, uint32_t nwords, enum umr_ring_type rt);
+int umr_packet_decode_index(struct umr_asic *asic, struct umr_stream_decode_ui *ui, struct umr_packet_index *idx,
+			    uint32_t first, uint32_t count, uint32_t *stream, uint32_t from_vmid, uint64_t from_addr, int follow);
+void umr_packet_index_free(struct umr_packet_index *idx);
+
 // find a compute/gfx shader program in a packet stream
 struct umr_shaders_pgm *umr_packet_find_shader(struct umr_asic *asic, struct umr_packet_stream *stream, unsigned vmid, uint64_t addr);
 
@@ -236,7 +346,58 @@ int umr_packet_disassemble_opcodes_vm(struct umr_asic *asic, struct umr_stream_d
 
 // determine if a ring is halted for at least 500 ms
 int umr_ring_is_halted(struct umr_asic *asic, char *ringname);
+int umr_ring_is_halted_by(struct umr_asic *asic, char *ringname, uint64_t deadline);
+uint64_t umr_ring_halt_window(struct umr_asic *asic);
+uint64_t umr_ring_now_us(void);
 void *umr_read_ring_data(struct umr_asic *asic, char *ringname, uint32_t *ringsize);
+int umr_read_ring_header(struct umr_asic *asic, char *ringname, uint32_t *ptrs, uint32_t *ringsize);
+uint32_t *umr_read_ring_window(struct umr_asic *asic, char *ringname, uint32_t start, uint32_t stop, uint32_t *nwords);
+void umr_close_ring_handles(struct umr_asic *asic);
+
+// fence progress of one kernel ring, see umr_fence_tracker_read()
+struct umr_ring_fence {
+	char name[32];
+	uint32_t signaled, emitted;                   // last signaled and emitted fence
+	uint32_t trailing_signaled, trailing_emitted; // only if has_trailing (gfx rings)
+	int has_trailing;
+	uint64_t progress_ns;                         // when signaled last moved or nothing was pending
+};
+
+struct umr_fence_snapshot {
+	struct umr_ring_fence *rings;
+	int no_rings, max_rings;
+	uint64_t time_ns;                             // CLOCK_MONOTONIC of the read
+};
+
+// fences of a ring between two snapshots, see umr_fence_snapshot_delta()
+struct umr_ring_fence_delta {
+	const char *name;                             // points into the newer snapshot
+	uint32_t signaled, emitted;
+	uint32_t pending;                             // emitted but not signaled in the newer snapshot
+};
+
+// amdgpu_fence_info kept open and parsed into snapshots
+struct umr_fence_tracker;
+struct umr_fence_tracker *umr_fence_tracker_open(struct umr_asic *asic);
+struct umr_fence_tracker *umr_fence_tracker_open_instance(struct umr_asic *asic, int instance);
+int umr_fence_tracker_read(struct umr_fence_tracker *ft, struct umr_fence_snapshot *snap);
+int umr_fence_tracker_poll(struct umr_fence_tracker *ft, uint64_t period_ns, uint64_t stall_ns,
+			   uint64_t timeout_ns, char *ringname, int size);
+void umr_fence_tracker_close(struct umr_fence_tracker *ft);
+int umr_fence_info_parse(const char *text, struct umr_fence_snapshot *snap);
+struct umr_ring_fence *umr_fence_snapshot_find(const struct umr_fence_snapshot *snap, const char *name, int hint);
+int umr_fence_snapshot_delta(const struct umr_fence_snapshot *before, const struct umr_fence_snapshot *after,
+			     struct umr_ring_fence_delta *deltas);
+void umr_fence_snapshot_free(struct umr_fence_snapshot *snap);
+
+// the runlist of every KFD node in the debugfs 'rls' hex dump
+struct umr_kfd_runlist {
+	int node;
+	uint32_t gpu_id;
+	uint32_t *words, no_words;
+};
+int umr_kfd_rls_parse(const char *text, size_t len, struct umr_kfd_runlist **rls);
+void umr_kfd_rls_free(struct umr_kfd_runlist *rls, int no_rls);
 
 #include <umr_packet_pm4.h>
 #include <umr_packet_sdma.h>
@@ -246,15 +407,57 @@ void *umr_read_ring_data(struct umr_asic *asic, char *ringname, uint32_t *ringsi
 #include <umr_packet_hsa.h>
 #include <umr_packet_mqd.h>
 #include <umr_packet_vcn.h>
+#include <umr_packet_log.h>
 
 /* shader disassembly */
+
+// a disassembled shader in one allocation, one line per 32-bit word
+#define UMR_DISASM_CONT    0xFFFFFFFFUL // the word continues the instruction above it
+#define UMR_DISASM_INVALID 0xFFFFFFFEUL // the word could not be disassembled
+struct umr_disasm_block {
+	uint32_t no_lines, text_len;
+	uint32_t *line; // offset of the text of each line or one of the above
+	char *text;
+};
+
+// used by disassemblers to build a umr_disasm_block
+struct umr_disasm_builder {
+	uint32_t no_lines, *line;
+	char *text;
+	uint32_t len, size;
+	int err;
+};
+
+int umr_disasm_builder_init(struct umr_disasm_builder *b, uint32_t no_lines);
+void umr_disasm_builder_add(struct umr_disasm_builder *b, uint32_t line, const char *str);
+struct umr_disasm_block *umr_disasm_builder_finish(struct umr_disasm_builder *b);
+void umr_disasm_builder_fini(struct umr_disasm_builder *b);
+const char *umr_disasm_line(const struct umr_disasm_block *b, uint32_t line);
+char **umr_disasm_block_to_strs(const struct umr_disasm_block *b);
+struct umr_disasm_block *umr_disasm_block_from_strs(char **strs, uint32_t no_lines);
+struct umr_disasm_block *umr_disasm_block_dup(const struct umr_disasm_block *b);
+
+struct umr_disasm_block *umr_shader_disasm_block(struct umr_asic *asic, uint8_t *inst, unsigned inst_bytes, uint64_t PC);
 int umr_shader_disasm(struct umr_asic *asic,
 		    uint8_t *inst, unsigned inst_bytes,
 		    uint64_t PC,
 		    char ***disasm_text);
+void umr_shader_disasm_fini(struct umr_asic *asic);
+struct umr_disasm_block *umr_shader_disasm_block_cached(struct umr_asic *asic, unsigned vmid,
+							const uint32_t *inst, unsigned inst_bytes, uint64_t PC);
+int umr_shader_disasm_cached(struct umr_asic *asic, unsigned vmid,
+			     const uint32_t *inst, unsigned inst_bytes,
+			     uint64_t PC, char ***disasm_text);
+void umr_shader_disasm_cache_free(struct umr_asic *asic);
 int umr_vm_disasm_to_str(struct umr_asic *asic, int vm_partition, unsigned vmid, uint64_t addr, uint64_t PC, uint32_t size, uint32_t start_offset, char ***out);
 int umr_vm_disasm(struct umr_asic *asic, FILE *output, int vm_partition, unsigned vmid, uint64_t addr, uint64_t PC, uint32_t size, uint32_t start_offset, struct umr_wave_data *wd);
 uint32_t umr_compute_shader_size(struct umr_asic *asic, int vm_partition, struct umr_shaders_pgm *shader);
 
+/* vectorized DWORD buffer scans */
+#define UMR_DWORD_FIND_MAX 4 // values umr_dword_find() compares per vector
+uint32_t umr_dword_find(const uint32_t *buf, uint32_t nwords, const uint32_t *values, int no_values);
+uint32_t umr_dword_span(const uint32_t *buf, uint32_t nwords, uint32_t value);
+uint32_t umr_dword_count(const uint32_t *buf, uint32_t nwords, uint32_t value);
+
 
 #endif
@@ -53,9 +53,31 @@ struct umr_hsa_stream {
 	struct umr_hsa_stream *prev, *next;
 };
 
+// view of one 64-byte AQL packet read in place from a queue buffer
+struct umr_aql_view {
+	const uint32_t *words; // the 16 words of the packet in the caller's buffer
+	uint32_t slot;         // packet index in the buffer
+
+	uint16_t header;
+	uint8_t type, barrier, acquire_fence_scope, release_fence_scope;
+
+	// HSA_KERNEL_DISPATCH only, zero for the other types
+	struct {
+		uint16_t setup_dimensions, workgroup_size[3];
+		uint32_t grid_size[3], private_segment_size, group_segment_size;
+		uint64_t kernel_object, kernarg_address;
+	} dispatch;
+
+	uint64_t completion_signal; // all but HSA_INVALID and vendor packets
+};
+
+// only return packets that are not HSA_INVALID
+#define UMR_AQL_VIEW_ACTIVE 1
+
 struct umr_hsa_stream *umr_hsa_decode_stream(struct umr_asic *asic, uint32_t *stream, uint32_t nwords, int32_t ip_version);
 struct umr_hsa_stream *umr_hsa_decode_stream_opcodes(struct umr_asic *asic, struct umr_stream_decode_ui *ui, struct umr_hsa_stream *stream, uint64_t ib_addr, uint32_t ib_vmid, unsigned long opcodes);
 void umr_free_hsa_stream(struct umr_hsa_stream *stream);
 struct umr_shaders_pgm *umr_find_shader_in_hsa_stream(struct umr_asic *asic, struct umr_hsa_stream *stream, unsigned vmid, uint64_t addr);
+int umr_aql_view_next(const uint32_t *buf, uint32_t nwords, uint32_t *slot, int flags, struct umr_aql_view *view);
 
 #endif
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#ifndef UMR_PACKET_LOG_H_
+#define UMR_PACKET_LOG_H_
+
+// Packet log library, records the callbacks of a decode in a compact
+// binary log that can be walked or replayed into another UI later
+enum umr_packet_log_type {
+	UMR_PACKET_LOG_END = 0,
+	UMR_PACKET_LOG_START_IB,
+	UMR_PACKET_LOG_UNHANDLED_DWORD,
+	UMR_PACKET_LOG_START_OPCODE,
+	UMR_PACKET_LOG_FIELD,
+	UMR_PACKET_LOG_SHADER,
+	UMR_PACKET_LOG_DATA,
+	UMR_PACKET_LOG_TAINT,
+	UMR_PACKET_LOG_DONE,
+};
+
+struct umr_packet_log {
+	// pass this to the decoder, its data points back to the log
+	struct umr_stream_decode_ui ui;
+
+	// the events
+	uint8_t *buf;
+	size_t len, size;
+	uint64_t last_addr;
+
+	// field, opcode and value names, an event refers to them by index
+	char *names;
+	uint32_t names_len, names_size;
+	uint32_t *name_off, no_names, max_names;
+	uint32_t *name_hash, hash_size;
+};
+
+// one event of a log, the pointers stay valid until the log is freed
+struct umr_packet_log_event {
+	enum umr_packet_log_type type;
+	uint64_t addr;
+	uint32_t vmid;
+
+	union {
+		struct {
+			uint64_t from_addr;
+			uint32_t from_vmid, size;
+			int type;
+		} ib;
+		uint32_t dword;
+		struct {
+			int pkttype;
+			uint32_t opcode, subop, nwords, header, no_raw;
+			const char *name;
+			const uint32_t *raw;
+		} opcode;
+		struct {
+			const char *name, *str;
+			uint64_t value;
+			int radix, size;
+		} field;
+		struct umr_shaders_pgm shader;
+		struct {
+			uint64_t addr, etype;
+			uint32_t vmid;
+			enum UMR_DATABLOCK_ENUM type;
+		} data;
+	};
+};
+
+struct umr_packet_log_reader {
+	const struct umr_packet_log *log;
+	size_t pos;
+	uint64_t last_addr;
+	uint32_t *raw, raw_size;
+};
+
+struct umr_packet_log *umr_packet_log_create(enum umr_ring_type rt);
+void umr_packet_log_reset(struct umr_packet_log *log);
+void umr_packet_log_free(struct umr_packet_log *log);
+
+void umr_packet_log_reader_init(struct umr_packet_log_reader *reader, const struct umr_packet_log *log);
+int umr_packet_log_next(struct umr_packet_log_reader *reader, struct umr_packet_log_event *ev);
+void umr_packet_log_reader_fini(struct umr_packet_log_reader *reader);
+int umr_packet_log_replay(const struct umr_packet_log *log, struct umr_asic *asic, struct umr_stream_decode_ui *ui);
+
+#endif
@@ -42,4 +42,42 @@ struct umr_mes_stream *umr_mes_decode_stream(struct umr_asic *asic, uint32_t *st
 struct umr_mes_stream *umr_mes_decode_stream_opcodes(struct umr_asic *asic, struct umr_stream_decode_ui *ui, struct umr_mes_stream *stream, uint64_t ib_addr, uint32_t ib_vmid, unsigned long opcodes);
 void umr_free_mes_stream(struct umr_mes_stream *stream);
 
+// MES packets indexed by the queue, gang and process they refer to
+#define UMR_MES_INDEX_NONE 0xFFFFFFFFUL // no such field/no more entries
+
+struct umr_mes_index_entry {
+	uint64_t addr;				// address of the packet header
+	uint32_t opcode, nwords;
+	const char *name;
+
+	// IDs the packet refers to, UMR_MES_INDEX_NONE (0 for the
+	// addresses) if the packet does not have the field
+	uint32_t doorbell_offset, queue_id, pipe_id, process_id;
+	uint64_t gang_context_addr, process_context_addr;
+
+	// next entry with the same doorbell_offset/gang_context_addr
+	uint32_t next_doorbell, next_gang;
+};
+
+// key -> first/last entry of its chain, open addressed
+struct umr_mes_index_map {
+	struct {
+		uint64_t key;
+		uint32_t first, last;
+	} *slots;
+	uint32_t size, used;
+};
+
+struct umr_mes_index {
+	struct umr_mes_index_entry *entries;
+	uint32_t no_entries, max_entries;
+	struct umr_mes_index_map doorbells, gangs;
+};
+
+struct umr_mes_index *umr_mes_index_create(void);
+int umr_mes_index_feed(struct umr_asic *asic, struct umr_mes_index *idx, uint32_t *words, uint32_t nwords, uint64_t addr);
+uint32_t umr_mes_index_find_doorbell(const struct umr_mes_index *idx, uint32_t doorbell_offset);
+uint32_t umr_mes_index_find_gang(const struct umr_mes_index *idx, uint64_t gang_context_addr);
+void umr_mes_index_free(struct umr_mes_index *idx);
+
 #endif
@@ -42,8 +42,30 @@ struct umr_mqd_fields {
 	char *label;
 };
 
+// a field of an MQD as returned by umr_mqd_field_next()
+struct umr_mqd_field {
+	uint32_t row,        // in the field table, the same for every MQD of an engine/family
+		offset;          // in words
+	const char *label;   // points into the static field table
+	uint32_t value,
+		prev_value;      // when diffing against an older MQD
+};
+
+// the fields of an engine/family selected by label, see umr_mqd_filter_init()
+struct umr_mqd_filter {
+	const struct umr_mqd_fields *table;
+	uint32_t rows;
+	uint8_t *sel; // bitmap of the selected rows, NULL for all
+};
+
 uint32_t umr_mqd_decode_size(enum umr_mqd_engine_sel eng, enum chipfamily fam);
 uint32_t umr_mqd_decode_rows(enum umr_mqd_engine_sel eng, enum chipfamily fam);
 char **umr_mqd_decode_data(enum umr_mqd_engine_sel eng, enum chipfamily fam, uint32_t *data, char *match);
 
+const struct umr_mqd_fields *umr_mqd_fields_table(enum umr_mqd_engine_sel eng, enum chipfamily fam, uint32_t *rows);
+int umr_mqd_filter_init(struct umr_mqd_filter *f, enum umr_mqd_engine_sel eng, enum chipfamily fam, const char *match);
+void umr_mqd_filter_free(struct umr_mqd_filter *f);
+int umr_mqd_field_next(const struct umr_mqd_filter *f, const uint32_t *data, uint32_t nwords, const uint32_t *prev, uint32_t *row, struct umr_mqd_field *field);
+int umr_mqd_field_format(const struct umr_mqd_field *field, char *buf, size_t size);
+
 #endif
@@ -56,6 +56,8 @@ struct umr_pm4_stream *umr_pm4_decode_stream(struct umr_asic *asic, int vm_parti
 void umr_free_pm4_stream(struct umr_pm4_stream *stream);
 struct umr_shaders_pgm *umr_find_shader_in_pm4_stream(struct umr_asic *asic, struct umr_pm4_stream *stream, unsigned vmid, uint64_t addr);
 const char *umr_pm4_opcode_to_str(uint32_t header);
+int umr_pm4_filter_match(const struct umr_packet_filter *f, uint32_t vmid, const struct umr_pm4_stream *ps);
+int umr_pm4_filter_wants_shaders(const struct umr_packet_filter *f, uint32_t vmid, const struct umr_pm4_stream *ps);
 
 struct umr_pm4_stream *umr_pm4_decode_stream_opcodes(struct umr_asic *asic, struct umr_stream_decode_ui *ui, struct umr_pm4_stream *stream, uint64_t ib_addr, uint32_t ib_vmid, uint64_t from_addr, uint64_t from_vmid, unsigned long opcodes, int follow);
 
@@ -63,7 +65,8 @@ void umr_free_shader_reg_pairs(struct umr_shader_reg_pair *regs);
 void umr_shader_add_reg_pair(struct umr_shader_reg_pair **head, const char *regname, uint32_t value, uint32_t ib_vmid, uint64_t ib_addr);
 struct umr_shader_reg_pair *umr_shader_find_regpair(struct umr_shader_reg_pair *head, const char *regname);
 struct umr_shader_reg_pair *umr_shader_find_partial_regpair(struct umr_shader_reg_pair *head, const char *regname);
-struct umr_shader_reg_pair *umr_copy_regpairs(struct umr_shader_reg_pair *head);
+struct umr_shader_reg_pair *umr_copy_regpairs(struct umr_asic *asic, struct umr_shader_reg_pair *head);
+void umr_free_regpairs_copy(struct umr_shader_reg_pair *regs);
 
 // PM4-lite
 struct umr_pm4_stream *umr_pm4_lite_decode_stream(struct umr_asic *asic, int vm_partition, uint32_t vmid, uint32_t *stream, uint32_t nwords, int32_t ip_version);
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2025 Advanced Micro Devices, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Authors: Tom St Denis <tom.stdenis@amd.com>
+ *
+ */
+#ifndef UMR_REGDB_H_
+#define UMR_REGDB_H_
+
+#include <stdint.h>
+
+/* ==== Compiled register database ====
+ * Binary form of an IP block .reg file (see 'compiler -b' in comp/).
+ * The file is a header followed by flat arrays of registers, bitfields
+ * and a string table so it can be mapped straight into memory.  All
+ * name fields are offsets into the string table.  The .reg text file
+ * stays the source of truth, its size and mtime are recorded so a stale
+ * compiled file is ignored.
+ */
+#define UMR_REGDB_MAGIC   0x42445255UL  // "URDB"
+#define UMR_REGDB_VERSION 1
+#define UMR_REGDB_SUFFIX  ".rdb"        // gc_10_1_0.reg => gc_10_1_0.rdb
+
+struct umr_regdb_header {
+	uint32_t magic, version;
+	uint64_t src_size, src_mtime;       // of the .reg file this was compiled from
+	uint32_t no_regs, no_bits;
+	uint32_t strtab_size, pad;
+};
+
+struct umr_regdb_reg {
+	uint64_t addr;                      // before adding the segment offset
+	uint32_t name, type, no_bits, bit64;
+	uint32_t idx;                       // segment index
+	uint32_t first_bit;                 // index into the bitfield array
+};
+
+struct umr_regdb_bit {
+	uint32_t name;
+	int32_t start, stop;
+};
+
+#endif
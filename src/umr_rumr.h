@@ -26,9 +26,10 @@
 #define RUMR_H_
 
 #include <stdint.h>
+#include <stdio.h>
 
 // version of RUMR protocol
-#define RUMR_VERSION 0x03
+#define RUMR_VERSION 0x0C
 
 // amount of preheader space used by comms
 // layer this allows transmitting "once"
@@ -45,8 +46,84 @@ enum rumr_opcodes {
 	RUMR_OP_RING_ACCESS,
 	RUMR_OP_USER_QUEUE_PARSE,
 	RUMR_OP_GOODBYE,
+	RUMR_OP_BATCH,
+	RUMR_OP_WAVE_SCAN,
+	RUMR_OP_VM_ACCESS,
+	RUMR_OP_STATS,
+	RUMR_OP_RING_DECODE,
 };
 
+// RUMR_OP_BATCH carries a count followed by that many sub-ops, each
+// an opcode, the number of words of its packet and the packet itself
+// (REG/MEM/WAVE/GPR_ACCESS only).  The reply has the size in bytes
+// of each sub-op's reply followed by that reply, 0 if it failed.
+#define RUMR_BATCH_MAX 1024
+
+// RUMR_OP_DISCOVER carries the codecs (below) then the number of
+// serialized asics the client has cached and their hashes (see
+// rumr_serialized_asic_hash()).  The reply has the codecs, the hash of
+// the server's serialized asic and 1 if it was one of them, followed by
+// only its head (see rumr_serialized_asic_head()), or 0 followed by all
+// of it.
+#define RUMR_DISCOVER_MAX_HASHES 16
+
+// RUMR_OP_WAVE_SCAN runs umr_scan_wave_data() on the server, it carries
+// RUMR_WAVE_SCAN_* flags and the reply has the number of waves followed
+// by each wave: se, sh, cu, simd, wave, num_threads, the sq_info busy
+// and wave_level words, the status registers, then 1 and the SGPRs,
+// have_vgprs and (if set) the VGPRs of each thread if the GPRs were
+// read or 0.  Every register array is sent as a count of words without
+// the trailing zeros followed by those words.
+#define RUMR_WAVE_SCAN_GPRS		(1UL << 0) // read the GPRs of halted waves
+#define RUMR_WAVE_SCAN_SKIP_GPRS	(1UL << 1) // as with the skip_gprs option
+
+// RUMR_OP_VM_ACCESS runs umr_access_vram() on a VM hub on the server,
+// it carries the address, vmid, partition, RUMR_VM_* flags and size
+// followed by the data to write.  The reply has the status, the
+// struct umr_vm_pagewalk if asked for and the data read.
+#define RUMR_VM_WRITE		(1UL << 0)
+#define RUMR_VM_PAGEWALK	(1UL << 1)
+
+// RUMR_OP_STATS returns the status, RUMR_STATS_OPS and a struct
+// rumr_op_summary of each opcode the server handled, every field sent
+// as its low then high word.
+#define RUMR_STATS_OPS		16
+#define RUMR_STATS_BUCKETS	256
+
+// RUMR_OP_RING_DECODE runs umr_packet_decode_ring() on a PM4 ring on
+// the server so the IBs are read there, it carries the ring name (128
+// bytes), start, stop, RUMR_RING_DECODE_* flags and, with
+// RUMR_RING_DECODE_FILTER, a struct umr_packet_filter as flags,
+// opcodes[8], reg_lo, reg_hi, va_lo and va_hi (low then high word) and
+// vmid.  The reply has the status, the start and stop used and the
+// packets of the ring (see the RUMR_PM4_* layout below).
+#define RUMR_RING_DECODE_NO_FOLLOW_IB		(1UL << 0)
+#define RUMR_RING_DECODE_NO_FOLLOW_CHAINED_IB	(1UL << 1)
+#define RUMR_RING_DECODE_NO_FOLLOW_SHADER	(1UL << 2)
+#define RUMR_RING_DECODE_FILTER			(1UL << 3)
+
+// a stream of PM4 packets is sent as the number of packets then, per
+// packet, the header, ib_offset, n_words and the words, RUMR_PM4_*
+// flags, the shaders (count then vmid, size, type, addr, src.ib_base
+// and src.ib_offset each) if RUMR_PM4_SHADER and the IB address, vmid
+// and stream if RUMR_PM4_IB, 64-bit values as their low then high word
+#define RUMR_PM4_SHADER		(1UL << 0)
+#define RUMR_PM4_IB		(1UL << 1)
+#define RUMR_PM4_INVALID	(1UL << 2)
+
+// bit 9 of the header word marks a compressed message (see
+// rumr_buffer_compress()), RUMR_OP_DISCOVER carries the codecs the
+// client supports and the reply starts with the codecs the server
+// supports, messages are only compressed with a codec both have
+#define RUMR_HDR_COMPRESSED	(1UL << 9)
+#define RUMR_CODEC_RLE32	(1UL << 0)
+#define RUMR_CODEC_ZSTD		(1UL << 1)
+#define RUMR_COMPRESS_MIN	4096
+
+// memory writes at least this large are sent (uncompressed) straight
+// from the caller's memory if the comms have txv()
+#define RUMR_TXV_MIN		(256 * 1024)
+
 struct rumr_buffer{
 	uint8_t *data;
 	uint32_t size, roffset, woffset;
@@ -69,7 +146,8 @@ struct rumr_comm_funcs {
 	// transmit buffer
 	int (*tx)(struct rumr_comm_funcs *cf, struct rumr_buffer *buf);
 
-	// receive buffer
+	// receive buffer, the server side may return 1 if there was
+	// nothing to receive after all (woken by epoll for nothing)
 	int (*rx)(struct rumr_comm_funcs *cf, struct rumr_buffer **buf);
 
 	// close connections (when terminating)
@@ -78,20 +156,71 @@ struct rumr_comm_funcs {
 	// close client connect on server side
 	int (*closeconn)(struct rumr_comm_funcs *cf);
 
-	// status
+	// status, on the server side of a client > 0 means another packet
+	// is (about to be) there and rx won't block for long
 	int (*status)(struct rumr_comm_funcs *cf);
 
 	// logging messages
 	int (*log_msg)(const char *fmt, ...);
+
+	// accept a client into its own channel @conn (a copy of these
+	// functions) so a server can keep several clients at once
+	int (*accept_conn)(struct rumr_comm_funcs *cf, struct rumr_comm_funcs *conn);
+
+	// descriptor to wait on for new clients (bound) or packets (client)
+	int (*get_fd)(struct rumr_comm_funcs *cf);
+
+	// transmit buffer followed by @size bytes of @data as one packet,
+	// without copying @data (optional)
+	int (*txv)(struct rumr_comm_funcs *cf, struct rumr_buffer *buf, const void *data, uint32_t size);
+
+	// receive buffer but, if the packet is not compressed and has
+	// exactly @size bytes past its first @head, receive those straight
+	// into @dst and set *direct (optional)
+	int (*rx_into)(struct rumr_comm_funcs *cf, struct rumr_buffer **buf, uint32_t head, void *dst, uint32_t size, int *direct);
+};
+
+// per opcode counters, clients time the round trip and servers the
+// handling of the request (from receiving it to sending the reply),
+// latencies are kept in buckets a quarter of a power of two wide
+struct rumr_op_stats {
+	uint64_t count, ns, bytes_tx, bytes_rx;
+	uint64_t hist[RUMR_STATS_BUCKETS];
+};
+
+struct rumr_stats {
+	struct rumr_op_stats op[RUMR_STATS_OPS];
+};
+
+struct rumr_op_summary {
+	uint64_t count, ns, bytes_tx, bytes_rx, p50_ns, p99_ns;
 };
 
+struct rumr_server_conn;
 struct rumr_server_state {
 	struct rumr_buffer *serialized_asic;
+	uint64_t serialized_hash; // of the IP blocks in serialized_asic
+	uint32_t serialized_head; // bytes before the IP blocks
 	void *asic;
 	struct rumr_comm_funcs comm;
+	uint32_t codecs; // compression codecs shared with the current client
+	struct rumr_stats *stats; // shared by all clients, returned by RUMR_OP_STATS
 	int (*log_msg)(const char *fmt, ...);
+
+	// handles one request for rumr_server_run(), NULL == rumr_server_loop()
+	int (*handle)(struct rumr_server_state *state);
+	struct rumr_server_conn *conn; // set on the per client copies made by rumr_server_run()
 };
 
+// threads rumr_server_run() serves requests with, and the largest piece
+// of a memory read done before letting other clients of the asic in
+#define RUMR_SERVER_WORKERS	4
+#define RUMR_SERVER_CHUNK	(1024 * 1024)
+
+// requests a worker serves back to back while comm.status() says the
+// next one is there before it lets the other clients in
+#define RUMR_SERVER_BURST	64
+
 // RUMR_SERVER_ONLY allows the inclusion
 // of the rumr header without bringing in the umr
 // headers as well for say backend servers not based on
@@ -100,9 +229,15 @@ struct rumr_server_state {
 
 #include <umr.h>
 
+struct rumr_client_cache;
 struct rumr_client_state {
 	struct rumr_comm_funcs comm;
 	struct umr_asic *asic;
+	uint32_t codecs; // compression codecs shared with the server
+	struct rumr_client_cache *cache; // reads cached with -O rumr_cache
+	struct rumr_stats *stats; // round trips of the requests sent
+	uint64_t sent_ns; // request awaiting its reply
+	uint32_t sent_opcode, sent_bytes;
 	int (*log_msg)(const char *fmt, ...);
 };
 
@@ -110,11 +245,15 @@ struct rumr_client_state {
 int rumr_client_connect(struct rumr_client_state *state, struct rumr_comm_funcs *cf, char *addr, struct umr_options *options);
 void rumr_client_close(struct rumr_client_state *state);
 int rumr_client_discover(struct rumr_client_state *state);
+void rumr_client_cache_flush(struct rumr_client_state *state);
 int rumr_client_user_queue_parse(struct umr_asic *asic);
+int rumr_client_server_stats(struct rumr_client_state *state, struct rumr_op_summary *sum, struct umr_io_stats *io);
+void rumr_client_print_stats(struct rumr_client_state *state, FILE *f);
 #endif
 
 // buffer functions
 struct rumr_buffer *rumr_buffer_init(void);
+int rumr_buffer_reserve(struct rumr_buffer *buf, uint32_t size);
 
 void rumr_buffer_add_buffer(struct rumr_buffer *buf, struct rumr_buffer *srcbuf);
 void rumr_buffer_add_data(struct rumr_buffer *buf, void *data, uint32_t size);
@@ -124,6 +263,11 @@ void rumr_buffer_read_data(struct rumr_buffer *buf, void *data, uint32_t size);
 uint32_t rumr_buffer_read_uint32(struct rumr_buffer *buf);
 
 void rumr_buffer_free(struct rumr_buffer *buf);
+void rumr_buffer_pool_flush(void);
+
+uint32_t rumr_codecs_supported(void);
+int rumr_buffer_compress(struct rumr_buffer *buf, uint32_t codecs);
+int rumr_buffer_decompress(struct rumr_buffer *buf);
 
 struct rumr_buffer *rumr_buffer_load_file(const char *fname, char *database_path);
 
@@ -131,17 +275,32 @@ struct rumr_buffer *rumr_buffer_load_file(const char *fname, char *database_path
 int rumr_server_bind(struct rumr_server_state *state, struct rumr_comm_funcs *cf, char *host);
 int rumr_server_accept(struct rumr_server_state *state);
 int rumr_server_loop(struct rumr_server_state *state);
+int rumr_server_run(struct rumr_server_state *state);
+void rumr_server_lock(struct rumr_server_state *state);
+void rumr_server_unlock(struct rumr_server_state *state);
 void rumr_server_close(struct rumr_server_state *state);
 
+// stats functions
+uint64_t rumr_stats_now(void);
+void rumr_stats_add(struct rumr_stats *stats, uint32_t opcode, uint64_t ns, uint32_t bytes_tx, uint32_t bytes_rx);
+void rumr_stats_summarize(struct rumr_stats *stats, struct rumr_op_summary *sum);
+void rumr_stats_print(const struct rumr_op_summary *sum, const char *title, FILE *f);
+const char *rumr_opcode_name(uint32_t opcode);
 
 // serialized asic functions
 struct rumr_buffer *rumr_serialize_asic(struct umr_asic *asic);
 struct umr_asic *rumr_parse_serialized_asic(struct rumr_buffer *buf);
 int rumr_save_serialized_asic(struct umr_asic *asic, struct rumr_buffer *buf);
 struct rumr_buffer *rumr_load_serialized_asic(const char *fname, char *database_path);
+uint32_t rumr_serialized_asic_head(struct rumr_buffer *buf);
+uint64_t rumr_serialized_asic_hash(struct rumr_buffer *buf);
 
 // EXTERNS
 // comms
 extern const struct rumr_comm_funcs rumr_tcp_funcs;
+extern const struct rumr_comm_funcs rumr_unix_funcs;
+extern const struct rumr_comm_funcs rumr_shm_funcs;
+
+const struct rumr_comm_funcs *rumr_comm_lookup(char *url, char **addr);
 
 #endif
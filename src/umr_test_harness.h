@@ -34,4 +34,32 @@ int umr_test_harness_get_config_data(struct umr_asic *asic, uint8_t *dst);
 int umr_test_harness_get_userqueue(struct umr_asic *asic, uint8_t *dst);
 void *umr_test_harness_get_ring_data(struct umr_asic *asic, uint32_t *ringsize);
 
+// what a test vector record holds
+enum umr_test_vector_type {
+	UMR_TV_GCACONFIG = 1,
+	UMR_TV_DISCOVERY,
+	UMR_TV_USERQUEUE,
+	UMR_TV_SYSRAM,
+	UMR_TV_VRAM,
+	UMR_TV_MMIO,
+	UMR_TV_SQ,
+	UMR_TV_VGPR,
+	UMR_TV_SGPR,
+	UMR_TV_WAVESTATUS,
+	UMR_TV_RINGDATA,
+	UMR_TV_NUM,
+};
+
+// writing test vectors, text to options->test_log_fd or binary to options->test_log_bin
+struct umr_test_vector_writer *umr_test_vector_open(const char *fname);
+int umr_test_vector_close(struct umr_test_vector_writer *w);
+FILE *umr_test_vector_stream(struct umr_test_vector_writer *w);
+void umr_test_log_bytes(struct umr_options *options, enum umr_test_vector_type type, uint64_t address, const void *data, uint32_t size);
+void umr_test_log_words(struct umr_options *options, enum umr_test_vector_type type, uint64_t address, const uint32_t *data, uint32_t nwords, const char *comment);
+
+// binary test vectors
+int umr_is_binary_test_vector(const char *fname);
+struct umr_test_harness *umr_create_test_harness_binary(const char *fname);
+int umr_test_vector_convert(const char *src, const char *dst);
+
 #endif
@@ -48,16 +48,96 @@ struct umr_vm_pagewalk {
 	pte_fields_t pte_fields;
 };
 
+// a run of VA mapped by umr_vm_map()
+struct umr_vm_mapping {
+	uint64_t
+		va,               // first virtual address
+		size,             // number of bytes mapped
+		pa;               // physical address (linear VRAM or system) of va
+	int system;           // pa is a system memory address
+	pte_fields_t pte_fields; // fields of the first PTE of the run
+};
+
+// what umr_vm_translate() found for a VA
+enum umr_vm_translation_flags {
+	UMR_VM_XLATE_VALID   = 1,  // pa is mapped by a valid page
+	UMR_VM_XLATE_SYSTEM  = 2,  // pa is a system memory address
+	UMR_VM_XLATE_PRT     = 4,  // the page is partially resident
+	UMR_VM_XLATE_FURTHER = 8,  // a PTE-as-PDE was walked (it is in pde[])
+	UMR_VM_XLATE_LINEAR  = 16, // not translated (linear hub or VMID 0 outside the page table)
+};
+
+// a VA translated by umr_vm_translate()
+struct umr_vm_translation {
+	uint64_t
+		va,
+		pa,               // linear VRAM or system address of va if UMR_VM_XLATE_VALID
+		page_size,        // bytes mapped by the PTE
+		pde[8],           // raw PDEs walked, pde[0] is the page table base
+		pte;              // raw PTE (0 if the walk stopped at a PDE)
+	uint32_t
+		levels,           // how many pde[] were walked
+		flags;            // UMR_VM_XLATE_*
+};
+
+// a VA mapping a physical address, see umr_vm_rmap_build()
+#define UMR_VM_RMAP_NO_VMID 0xFFFFFFFFU // vmid of the mappings of a user queue client
+struct umr_vm_rmap_entry {
+	uint64_t
+		pa,               // physical address (linear VRAM or system) of va
+		size,             // number of bytes mapped
+		va;
+	uint32_t
+		vmid,             // VMID and hub walked or UMR_VM_RMAP_NO_VMID
+		pid;              // PID of the user queue client (0 for a VMID)
+	int system;           // pa is a system memory address
+};
+
+// mappings of several VMs sorted by (system, pa)
+struct umr_vm_rmap {
+	struct umr_vm_rmap_entry *entries;
+	uint64_t
+		*max_end,         // highest pa + size of entries[0..x] with the same system
+		no_entries;
+};
+
+// what umr_vm_rmap_lookup() found for a physical address
+struct umr_vm_rmap_hit {
+	uint64_t va;
+	uint32_t vmid, pid;
+};
+
 int umr_access_vram_via_mmio(struct umr_asic *asic, uint64_t address, uint32_t size, void *dst, int write_en);
 uint64_t umr_vm_dma_to_phys(struct umr_asic *asic, uint64_t dma_addr);
 int umr_access_sram(struct umr_asic *asic, uint64_t address, uint32_t size, void *dst, int write_en);
 int umr_access_vram(struct umr_asic *asic, int partition, uint32_t vmid, uint64_t address, uint32_t size, void *data, int write_en, struct umr_vm_pagewalk *vmdata);
 int umr_access_linear_vram(struct umr_asic *asic, uint64_t address, uint32_t size, void *data, int write_en);
+int umr_access_sram_uring(struct umr_asic *asic, uint64_t address, uint32_t size, void *dst, int write_en);
+int umr_access_linear_vram_uring(struct umr_asic *asic, uint64_t address, uint32_t size, void *data, int write_en);
+int umr_access_user_memv(struct umr_asic *asic, const uint64_t *va, const uint32_t *size, void **data, int n, int write_en);
+void umr_close_proc_mem(struct umr_asic *asic);
+int umr_access_linear_vram_via_bar(struct umr_asic *asic, uint64_t address, uint32_t size, void *data, int write_en);
+// bulk reads of buffer objects by SDMA copies through GTT, see umr_sdma_read_dmabuf()
+typedef int (*umr_sdma_sink)(void *data, const void *buf, uint64_t len);
+int umr_sdma_read_dmabuf(struct umr_asic *asic, int dmabuf_fd, uint64_t offset, uint64_t size,
+			 umr_sdma_sink sink, void *data);
+int umr_sdma_export_client_bo(struct umr_asic *asic, int pid, int fd, uint32_t handle);
 #define umr_read_vram(asic, partition, vmid, address, size, dst) umr_access_vram(asic, partition, vmid, address, size, dst, 0, NULL)
 #define umr_write_vram(asic, partition, vmid, address, size, src) umr_access_vram(asic, partition, vmid, address, size, src, 1, NULL)
 
+// the PTE/PDE decoders of a gfx generation, see umr_vm_get_decoder()
+struct umr_vm_decoder {
+	pte_fields_t (*pte)(uint64_t entry);
+	pde_fields_t (*pde)(uint64_t entry);
+	void (*pte_batch)(const uint64_t *entries, pte_fields_t *fields, int n);
+	void (*pde_batch)(const uint64_t *entries, pde_fields_t *fields, int n);
+};
+
 pte_fields_t umr_decode_pte_entry(const struct umr_asic *asic, uint64_t pte_entry);
 pde_fields_t umr_decode_pde_entry(const struct umr_asic *asic, uint64_t pde_entry);
+int umr_vm_get_decoder(const struct umr_asic *asic, struct umr_vm_decoder *dec);
+void umr_vm_pte_decoder(int maj, int min, struct umr_vm_decoder *dec);
+void umr_vm_pde_decoder(int maj, int min, struct umr_vm_decoder *dec);
 
 int umr_access_vram_vi(struct umr_asic *asic, uint32_t vmid,
 			      uint64_t address, uint32_t size,
@@ -66,6 +146,26 @@ int umr_access_vram_vi(struct umr_asic *asic, uint32_t vmid,
 int umr_access_vram_ai(struct umr_asic *asic, int partition,
 				  uint32_t vmid, uint64_t address, uint32_t size,
 			      void *dst, int write_en, struct umr_vm_pagewalk *vmdata);
+int umr_vm_map_ai(struct umr_asic *asic, int partition, uint32_t vmid,
+		  struct umr_vm_mapping **maps, uint64_t *no_maps);
+int umr_vm_map(struct umr_asic *asic, int partition, uint32_t vmid,
+	       struct umr_vm_mapping **maps, uint64_t *no_maps);
+int umr_vm_translate_ai(struct umr_asic *asic, int partition, uint32_t vmid,
+			const uint64_t *va, uint32_t n, struct umr_vm_translation *out);
+int umr_vm_translate(struct umr_asic *asic, int partition, uint32_t vmid,
+		     const uint64_t *va, uint32_t n, struct umr_vm_translation *out);
+struct umr_vm_rmap *umr_vm_rmap_build(struct umr_asic *asic, int partition, uint32_t hub);
+int umr_vm_rmap_update_vmid(struct umr_asic *asic, struct umr_vm_rmap *rmap, int partition, uint32_t vmid);
+int umr_vm_rmap_update_client(struct umr_asic *asic, struct umr_vm_rmap *rmap, int partition, uint32_t hub,
+			      const struct umr_user_queue *uq);
+uint64_t umr_vm_rmap_lookup(const struct umr_vm_rmap *rmap, uint64_t pa, int system,
+			    struct umr_vm_rmap_hit *hits, uint64_t max_hits);
+void umr_vm_rmap_free(struct umr_vm_rmap *rmap);
+void umr_free_vm_reg_cache(struct umr_asic *asic);
+void umr_vm_tlb_flush(struct umr_asic *asic);
+void umr_vm_context_begin(struct umr_asic *asic);
+void umr_vm_context_end(struct umr_asic *asic);
+void umr_vm_context_refresh(struct umr_asic *asic);
 
 
 #endif
@@ -31,11 +31,55 @@
 int umr_get_wave_status_raw(struct umr_asic *asic, unsigned se, unsigned sh, unsigned cu, unsigned simd, unsigned wave, uint32_t *buf);
 int umr_get_wave_status(struct umr_asic *asic, unsigned se, unsigned sh, unsigned cu, unsigned simd, unsigned wave, struct umr_wave_status *ws);
 int umr_get_wave_status_via_mmio(struct umr_asic *asic, unsigned se, unsigned sh, unsigned cu, unsigned simd, unsigned wave, struct umr_wave_status *ws);
+int umr_get_wave_status_bulk(struct umr_asic *asic, unsigned se, unsigned sh, unsigned cu, unsigned simd, unsigned no_waves, struct umr_wave_status *ws);
+int umr_get_wave_status_via_mmio_bulk(struct umr_asic *asic, unsigned se, unsigned sh, unsigned cu, unsigned simd, unsigned no_waves, struct umr_wave_status *ws);
 struct umr_wave_data *umr_scan_wave_data(struct umr_asic *asic);
+void umr_free_wave_data(struct umr_wave_data *wd);
+int umr_wave_data_fetch_gprs(struct umr_asic *asic, struct umr_wave_data *wd);
+int umr_wave_data_prefetch_gprs(struct umr_asic *asic, struct umr_wave_data *wd);
+struct umr_wave_data *umr_wave_list_append(struct umr_asic *asic, struct umr_wave_list *wl);
+
+// PC of a running wave, see umr_sample_wave_pcs()
+struct umr_wave_pc_sample {
+	uint32_t se, sh, cu, simd, wave, vmid;
+	uint64_t pc;
+};
+int umr_sample_wave_pcs(struct umr_asic *asic, struct umr_wave_data *wd,
+			struct umr_wave_pc_sample *samples, int max_samples);
 
 int umr_wave_data_init(struct umr_asic *asic, struct umr_wave_data *wd);
 uint32_t umr_wave_data_get_value(struct umr_asic *asic, struct umr_wave_data *wd, const char *regname);
 uint32_t umr_wave_data_get_bits(struct umr_asic *asic, struct umr_wave_data *wd, const char *regname, const char *bitname);
+int umr_wave_data_resolve_field(struct umr_asic *asic, struct umr_wave_data *wd, const char *regname, const char *bitname, struct umr_wave_field *wf);
+
+// WAVE STATUS fields hot paths use, resolved once per register list (and
+// GFX instance) then read by ID, see umr_wave_data_get_field_id()
+enum umr_wave_field_id {
+	UMR_WAVE_FIELD_VALID = 0,
+	UMR_WAVE_FIELD_HALT,
+	UMR_WAVE_FIELD_FATAL_HALT,
+	UMR_WAVE_FIELD_PRIV,
+	UMR_WAVE_FIELD_TRAP_EN,
+	UMR_WAVE_FIELD_WAVE64,
+	UMR_WAVE_FIELD_SE_ID,
+	UMR_WAVE_FIELD_SH_ID,    // SA_ID on gfx10+
+	UMR_WAVE_FIELD_CU_ID,    // WGP_ID on gfx10+
+	UMR_WAVE_FIELD_SIMD_ID,
+	UMR_WAVE_FIELD_WAVE_ID,
+	UMR_WAVE_FIELD_VM_ID,
+	UMR_WAVE_FIELD_SGPR_SIZE,
+	UMR_WAVE_FIELD_VGPR_SIZE,
+	UMR_WAVE_FIELD_PC_LO,    // whole register
+	UMR_WAVE_FIELD_PC_HI,    // whole register
+
+	UMR_WAVE_FIELD_MAX
+};
+uint32_t umr_wave_data_get_field_id(struct umr_asic *asic, struct umr_wave_data *wd, enum umr_wave_field_id id);
+void umr_wave_data_free_field_cache(struct umr_asic *asic);
+static inline uint32_t umr_wave_data_get_field(const struct umr_wave_data *wd, const struct umr_wave_field *wf)
+{
+	return (wd->ws.reg_values[wf->idx] >> wf->field.shift) & wf->field.mask;
+}
 int umr_wave_data_get_bit_info(struct umr_asic *asic, struct umr_wave_data *wd, const char *regname, int *no_bits, struct umr_bitfield **bits);
 int umr_wave_data_get_shader_pc_vmid(struct umr_asic *asic, struct umr_wave_data *wd, uint32_t *vmid, uint64_t *addr);
 uint32_t umr_wave_data_num_of_sgprs(struct umr_asic *asic, struct umr_wave_data *wd);
@@ -63,7 +107,39 @@ int umr_read_sgprs_via_mmio(struct umr_asic *asic, struct umr_wave_data *wd, uin
 int umr_read_vgprs_via_mmio(struct umr_asic *asic, struct umr_wave_data *wd, uint32_t thread, uint32_t *dst);
 int umr_read_sensor(struct umr_asic *asic, int sensor, void *dst, int *size);
 
+// powerplay sensors read without an asic, e.g. from a polling thread
+struct umr_sensor_ctx {
+	int fd;			// amdgpu_sensors debugfs file
+	int no_ranges;		// the kernel refused a read spanning several sensors
+	struct umr_asic *asic;	// reads are counted in its io_stats if set
+};
+int umr_sensor_ctx_open(struct umr_sensor_ctx *ctx, int instance);
+void umr_sensor_ctx_close(struct umr_sensor_ctx *ctx);
+int umr_read_sensors_batch(struct umr_sensor_ctx *ctx, const int *sensors, uint32_t *dst, int no_sensors);
+
 int umr_singlestep_wave(struct umr_asic *asic, struct umr_wave_data *wd);
+
+// GPRs are compared in blocks of this many registers (VGPR blocks cover
+// the same registers of every thread)
+#define UMR_WAVE_GPR_BLOCK 16
+
+// state of a wave as last seen by umr_wave_snapshot_update()
+struct umr_wave_snapshot {
+	int valid, se, sh, cu, simd, wave, have_gprs, have_vgprs;
+	uint32_t reg_values[64];
+	uint64_t sgpr_hash[1024 / UMR_WAVE_GPR_BLOCK],
+		 vgpr_hash[256 / UMR_WAVE_GPR_BLOCK];
+};
+
+// what changed since the previous snapshot, bit x of each mask is set
+// if ws.reg_values[x] or GPR block x changed
+struct umr_wave_delta {
+	uint64_t regs, sgpr_blocks;
+	uint32_t vgpr_blocks;
+};
+
+int umr_wave_snapshot_update(struct umr_asic *asic, struct umr_wave_snapshot *snap,
+			     struct umr_wave_data *wd, struct umr_wave_delta *delta);
 int umr_linux_read_gpr_gprwave_raw(struct umr_asic *asic, int v_or_s,
 								   uint32_t thread, uint32_t se, uint32_t sh, uint32_t cu, uint32_t wave, uint32_t simd,
 								   uint32_t offset, uint32_t size, uint32_t *dst);
@@ -71,6 +147,7 @@ int umr_get_wave_status_raw(struct umr_asic *asic, unsigned se, unsigned sh, uns
 
 // halt/resume SQ waves
 int umr_sq_cmd_halt_waves(struct umr_asic *asic, enum umr_sq_cmd_halt_resume mode, int max_retries);
+int umr_sq_cmd_halt_waves_within(struct umr_asic *asic, uint64_t budget_us);
 int umr_sq_cmd_singlestep(struct umr_asic *asic, uint32_t se, uint32_t sh, uint32_t wgp, uint32_t simd, uint32_t wave);
 
 #endif
@@ -29,27 +29,64 @@ extern const char *libumrcore_rev;
 
 /* Application functions */
 
+/* -O options */
+int umr_parse_options(struct umr_options *options, char *str);
+
+/* --jsonl output, one JSON object per line */
+void umr_jsonl_begin(const char *type);
+void umr_jsonl_end(void);
+void umr_jsonl_object(const char *key, int array);
+void umr_jsonl_close(void);
+void umr_jsonl_str(const char *key, const char *value);
+void umr_jsonl_u64(const char *key, uint64_t value);
+void umr_jsonl_int(const char *key, int64_t value);
+void umr_jsonl_hex(const char *key, uint64_t value);
+void umr_jsonl_bool(const char *key, int value);
+void umr_jsonl_flush(void);
+
 /* scan functions */
 int umr_scan_asic(struct umr_asic *asic, char *asicname, char *ipname, char *regname);
 
 /* set register */
 int umr_set_register(struct umr_asic *asic, char *regpath, char *regvalue);
 int umr_set_register_bit(struct umr_asic *asic, char *regpath, char *regvalue);
+int umr_set_register_bits(struct umr_asic *asic, char *regpath, char *fields);
+
+/* register watchpoints */
+int umr_reg_watch_print(struct umr_asic *asic, char *triggers, char *captures, unsigned ms);
+
+/* per VF activity of an SR-IOV device sampled from the PF */
+int umr_sriov_sample_print(struct umr_asic *asic, unsigned ms, unsigned count);
 
 /* Read and display a ring buffer */
 void umr_read_ring_stream(struct umr_asic *asic, char *ringpath);
+void umr_read_ring_stream_to(struct umr_asic *asic, char *ringpath, FILE *out);
+void umr_ring_capture_print(struct umr_asic *asic, char *ringlist);
+void umr_follow_ring_stream(struct umr_asic *asic, char *ringname);
 void umr_ib_read(struct umr_asic *asic, unsigned vmid, uint64_t addr, uint32_t len, int pm);
 void umr_ib_read_file(struct umr_asic *asic, char *filename, int pm);
 void umr_ring_stream_present(struct umr_asic *asic, char *ringname, int start, int end, uint32_t vmid, uint64_t addr, uint32_t *words, uint32_t nwords, enum umr_ring_type rt);
 
 void umr_lookup(struct umr_asic *asic, char *address, char *value);
 void umr_scan_log(struct umr_asic *asic, int use_new);
+int umr_scan_log_file(struct umr_asic *asic, const char *path, const char *filter, int histogram);
+int umr_follow_log(struct umr_asic *asic, int use_new, int top_n);
 void umr_top(struct umr_asic *asic);
+void umr_top_all(struct umr_options *options);
+int umr_top_export(struct umr_options *options, const char *spec);
+int umr_top_log_to_csv(const char *path);
 
 void umr_print_config(struct umr_asic *asic);
 void umr_print_waves(struct umr_asic *asic);
-void umr_profiler(struct umr_asic *asic, int samples, int shader_target);
-void umr_profiler(struct umr_asic *asic, int samples, int delay);
+/* profiler export formats */
+enum umr_profiler_export_format {
+	UMR_PROFILER_EXPORT_NONE = 0,
+	UMR_PROFILER_EXPORT_PPROF,
+	UMR_PROFILER_EXPORT_COLLAPSED,
+};
+/* --profiler rate that follows the activity of the waves */
+#define UMR_PROFILER_RATE_AUTO (-2)
+void umr_profiler(struct umr_asic *asic, int samples, int shader_target, int rate, int export_format, const char *export_path);
 void umr_print_cpg(struct umr_asic *asic);
 void umr_print_cpc(struct umr_asic *asic);
 void umr_print_sdma(struct umr_asic *asic);
@@ -75,3 +112,10 @@ int umr_kfd_topo_get_pci_busaddr(int node, char *busaddr);
 void umr_handle_scriptware(umr_err_output errout, char *database_path, char **argv, int argc);
 void umr_print_uq_info(struct umr_asic *asic);
 void umr_list_uqs(struct umr_asic *asic);
+void umr_follow_uqs(struct umr_asic *asic);
+int umr_ih_tail(struct umr_asic *asic, const char *filter);
+
+/* daemon mode, a client only needs daemon_client.c */
+#define UMR_DAEMON_MAGIC 0x444D5255 // "UMRD"
+int umr_daemon_run(struct umr_asic *asic, const char *path, int (*run)(int argc, char **argv));
+int umr_daemon_forward(const char *path, int argc, char **argv);
@@ -3,6 +3,10 @@ if [ "${UMRTESTPATH}" == "" ]; then
 	UMRTESTPATH="src/test/umrtest"
 fi
 
+if [ "${UMRKATPATH}" == "" ]; then
+	UMRKATPATH="src/test/umrkat"
+fi
+
 if [ "${UMRAPPPATH}" == "" ]; then
 	UMRAPPPATH="src/app/umr"
 fi
@@ -26,7 +30,14 @@ echo
 echo
 echo Running KAT tests...
 
-# run more complicated KATs
+# run more complicated KATs, in parallel when the runner was built
+if [ -x "${UMRKATPATH}" ]; then
+	${UMRKATPATH} ${UMRVECTORSPATH}
+	if [ $? -ne 0 ]; then
+		echo "FAILED."
+		exit 1
+	fi
+else
 for f in ${UMRVECTORSPATH}/kat/*.cmd; do
 	txt=`echo $f | sed -e 's/.cmd/.txt/'`
 	kat=`echo $f | sed -e 's/.cmd/.answer/'`
@@ -52,6 +63,7 @@ for f in ${UMRVECTORSPATH}/kat/*.cmd; do
 		exit 1;
 	fi
 done
+fi
 echo PASSED.
 
 # run simple KATs